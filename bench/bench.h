@@ -0,0 +1,81 @@
+/*
+ * bench.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Helpers shared by all host benchmark translation units. */
+
+#pragma once
+
+#ifndef __NXDT_BENCH_H__
+#define __NXDT_BENCH_H__
+
+#include <core/nxdt_utils.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_MIB   0x100000
+
+/// Accumulates timings for a single benchmarked operation.
+typedef struct {
+    const char *name;
+    u64 total_ns;
+    u64 op_count;
+    u64 byte_count;
+} BenchTimer;
+
+/// Prints the average time per operation and the throughput (if 'byte_count' is non-zero) for the provided timer. Timers without operations are skipped.
+void benchTimerReport(const BenchTimer *timer);
+
+/// Loads a whole file into a dynamically allocated buffer, which must be freed by the caller.
+bool benchLoadFile(const char *path, u8 **out_buf, u64 *out_size);
+
+/// Returns a dynamically allocated buffer filled with repeatable pseudorandom data, which must be freed by the caller.
+u8 *benchGenerateSyntheticData(u64 size);
+
+/// Bucket Tree storage benchmarks. See bench_bktr.c.
+bool benchRunBucketTree(const char *path, u32 iterations);
+
+/// Helper inline functions.
+
+NX_INLINE u64 benchGetTimeNs(void)
+{
+    return armTicksToNs(armGetSystemTick());
+}
+
+NX_INLINE void benchTimerStart(BenchTimer *timer, u64 *start)
+{
+    NX_IGNORE_ARG(timer);
+    *start = benchGetTimeNs();
+}
+
+NX_INLINE void benchTimerStop(BenchTimer *timer, u64 start, u64 op_count, u64 byte_count)
+{
+    timer->total_ns += (benchGetTimeNs() - start);
+    timer->op_count += op_count;
+    timer->byte_count += byte_count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NXDT_BENCH_H__ */
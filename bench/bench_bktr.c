@@ -0,0 +1,755 @@
+/*
+ * bench_bktr.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Bucket Tree storage benchmarks. */
+/* bktr.c is built as part of this translation unit (instead of on its own), which gives us direct access to its static lookup and visitor functions. */
+
+#include "../source/core/bktr.c"
+#include <core/lz4.h>
+
+#include "bench.h"
+#include "shim/storage_shim.h"
+
+#define BENCH_BKTR_DATA_SIZE                0x2000000   /* 32 MiB. Physical data region size used by all synthetic storages. */
+
+#define BENCH_BKTR_LOOKUP_COUNT             0x10000     /* Entry lookups per iteration. */
+#define BENCH_BKTR_READ_SIZE                0x10000     /* 64 KiB. */
+#define BENCH_BKTR_SEQUENTIAL_READ_SPAN     0x4000000   /* 64 MiB. Caps the virtual range covered by sequential reads on each iteration. */
+#define BENCH_BKTR_RANDOM_READ_COUNT        0x400       /* Random reads per iteration. */
+
+#define BENCH_BKTR_MIN_ENTRY_SIZE           0x200       /* Virtual size range for Indirect, Sparse and uncompressed Compressed storage entries. */
+#define BENCH_BKTR_MAX_ENTRY_SIZE           0x8000
+
+#define BENCH_BKTR_PATCH_ENTRY_RATIO        50          /* Percentage of Indirect / Sparse storage entries that use storage index #1. Patch-heavy titles are the worst case. */
+#define BENCH_BKTR_LZ4_ENTRY_RATIO          40          /* Percentage of Compressed storage entries compressed with LZ4. */
+#define BENCH_BKTR_ZERO_ENTRY_RATIO         20          /* Percentage of Compressed storage entries filled with zeroes. The rest are stored as-is. */
+#define BENCH_BKTR_LZ4_ENTRY_SIZE           0x10000     /* 64 KiB. Decompressed size for all LZ4 entries. */
+
+#define BENCH_BKTR_AES_CTR_EX_ENTRY_COUNT   4096        /* AesCtrEx storage entries used as storage index #1 by synthetic Indirect storages. */
+
+#define BENCH_BKTR_RANDOM_SEED              0x9E3779B97F4A7C15ULL
+
+/* Type definitions. */
+
+/// Holds a Bucket Tree storage along with everything needed to read it.
+typedef struct {
+    NcaContext nca_ctx, base_nca_ctx;
+    NcaFsSectionContext nca_fs_ctx, base_nca_fs_ctx;    ///< The base NCA FS section is only used by Indirect storages.
+    u8 *image, *base_image;
+    BucketTreeContext bktr_ctx;
+    BucketTreeContext aes_ctr_ex_ctx;                   ///< Storage index #1 for synthetic Indirect storages.
+    bool readable;                                      ///< Set to false for captured tables, which come without any data to read.
+} BenchBucketTreeStorage;
+
+/* Global variables. */
+
+static const char *g_benchBucketTreeTypeNames[BucketTreeStorageType_Count] = {
+    [BucketTreeStorageType_Indirect]   = "indirect",
+    [BucketTreeStorageType_AesCtrEx]   = "aesctrex",
+    [BucketTreeStorageType_Compressed] = "compressed",
+    [BucketTreeStorageType_Sparse]     = "sparse"
+};
+
+/* The biggest entry count roughly matches the Indirect storage from a large title with lots of patched data. */
+static const u8 g_benchBucketTreeTypes[] = { BucketTreeStorageType_Indirect, BucketTreeStorageType_AesCtrEx, BucketTreeStorageType_Sparse, BucketTreeStorageType_Compressed };
+static const u32 g_benchBucketTreeEntryCounts[] = { 1024, 16384, 262144 };
+
+/* Keeps the compiler from optimizing away lookups whose results are otherwise unused. */
+static volatile u64 g_benchBucketTreeSink = 0;
+
+/* Function prototypes. */
+
+static bool benchGenerateBucketTreeStorage(BenchBucketTreeStorage *out, u8 storage_type, u32 entry_count);
+static bool benchLoadBucketTreeStorage(BenchBucketTreeStorage *out, const char *arg);
+static bool benchInitializeBucketTreeStorage(BenchBucketTreeStorage *storage, u8 storage_type, u64 table_offset, u64 table_size, u32 entry_count);
+static void benchFreeBucketTreeStorage(BenchBucketTreeStorage *storage);
+
+static void *benchGenerateIndirectStorageEntries(u32 entry_count, bool is_sparse, u64 patch_size, u64 *out_end_offset);
+static void *benchGenerateAesCtrExStorageEntries(u32 entry_count, u64 data_size, u64 *out_end_offset);
+static void *benchGenerateCompressedStorageEntries(u32 entry_count, u32 lz4_physical_size, u64 *out_end_offset);
+
+static u64 benchGetBucketTreeTableSize(u64 entry_size, u32 entry_count);
+static void benchWriteBucketTreeTable(u8 *out, const void *entries, u64 entry_size, u32 entry_count, u64 end_offset);
+
+static bool benchRunBucketTreeStorage(BenchBucketTreeStorage *storage, u32 iterations);
+static bool benchRunBucketTreeLookups(BucketTreeContext *ctx, const u64 *offsets, u32 offset_count, bool use_flat_index, BenchTimer *timer);
+static bool benchRunBucketTreeIteration(BucketTreeContext *ctx, BenchTimer *timer, u32 *out_entry_count);
+static bool benchRunBucketTreeSequentialReads(BenchBucketTreeStorage *storage, u8 *buf, bool use_cursor, BenchTimer *timer);
+static bool benchRunBucketTreeRandomReads(BenchBucketTreeStorage *storage, u8 *buf, const u64 *offsets, u32 offset_count, BenchTimer *timer);
+static bool benchRunBucketTreeExtentQueries(BenchBucketTreeStorage *storage, const u64 *offsets, u32 offset_count, BenchTimer *timer);
+
+NX_INLINE u64 benchGetBucketTreeEntrySize(u8 storage_type);
+NX_INLINE u64 benchGetRandomValue(u64 *state);
+
+bool benchRunBucketTree(const char *path, u32 iterations)
+{
+    BenchBucketTreeStorage *storage = calloc(1, sizeof(BenchBucketTreeStorage));
+    bool success = true;
+
+    if (!storage)
+    {
+        fprintf(stderr, "Failed to allocate memory for Bucket Tree storage!\n");
+        return false;
+    }
+
+    if (path)
+    {
+        success = (benchLoadBucketTreeStorage(storage, path) && benchRunBucketTreeStorage(storage, iterations));
+        benchFreeBucketTreeStorage(storage);
+    } else {
+        for(u32 i = 0; success && i < MAX_ELEMENTS(g_benchBucketTreeTypes); i++)
+        {
+            for(u32 j = 0; success && j < MAX_ELEMENTS(g_benchBucketTreeEntryCounts); j++)
+            {
+                success = (benchGenerateBucketTreeStorage(storage, g_benchBucketTreeTypes[i], g_benchBucketTreeEntryCounts[j]) && benchRunBucketTreeStorage(storage, iterations));
+                benchFreeBucketTreeStorage(storage);
+            }
+        }
+    }
+
+    free(storage);
+
+    return success;
+}
+
+static bool benchGenerateBucketTreeStorage(BenchBucketTreeStorage *out, u8 storage_type, u32 entry_count)
+{
+    const u64 entry_size = benchGetBucketTreeEntrySize(storage_type), table_size = benchGetBucketTreeTableSize(entry_size, entry_count);
+    const u64 aes_ctr_ex_table_size = (storage_type == BucketTreeStorageType_Indirect ? benchGetBucketTreeTableSize(BKTR_AES_CTR_EX_ENTRY_SIZE, BENCH_BKTR_AES_CTR_EX_ENTRY_COUNT) : 0);
+
+    void *entries = NULL, *aes_ctr_ex_entries = NULL;
+    u8 *lz4_data = NULL;
+    u64 end_offset = 0, aes_ctr_ex_end_offset = 0;
+    int lz4_physical_size = 0;
+
+    bool success = false;
+
+    memset(out, 0, sizeof(BenchBucketTreeStorage));
+
+    /* Synthetic tables never use L2 nodes. */
+    if (!table_size || (storage_type == BucketTreeStorageType_Indirect && !aes_ctr_ex_table_size))
+    {
+        fprintf(stderr, "Synthetic %s storages with %u entries would need L2 nodes, which aren't supported!\n", g_benchBucketTreeTypeNames[storage_type], entry_count);
+        return false;
+    }
+
+    /* Physical data is placed at the start of the image, followed by the table(s). */
+    /* Indirect storages get an additional base NCA FS section image, which holds the data for storage index #0. */
+    if (!(out->image = benchGenerateSyntheticData(BENCH_BKTR_DATA_SIZE + table_size + aes_ctr_ex_table_size)) || \
+        (storage_type == BucketTreeStorageType_Indirect && !(out->base_image = benchGenerateSyntheticData(BENCH_BKTR_DATA_SIZE))))
+    {
+        fprintf(stderr, "Failed to allocate memory for synthetic %s storage image!\n", g_benchBucketTreeTypeNames[storage_type]);
+        goto end;
+    }
+
+    /* Generate storage entries. */
+    switch(storage_type)
+    {
+        case BucketTreeStorageType_Indirect:
+            /* The AesCtrEx storage goes first, since its size caps the physical offsets used by Patch entries. */
+            if (!(aes_ctr_ex_entries = benchGenerateAesCtrExStorageEntries(BENCH_BKTR_AES_CTR_EX_ENTRY_COUNT, BENCH_BKTR_DATA_SIZE, &aes_ctr_ex_end_offset))) break;
+            benchWriteBucketTreeTable(out->image + BENCH_BKTR_DATA_SIZE + table_size, aes_ctr_ex_entries, BKTR_AES_CTR_EX_ENTRY_SIZE, BENCH_BKTR_AES_CTR_EX_ENTRY_COUNT, \
+                                      aes_ctr_ex_end_offset);
+
+            entries = benchGenerateIndirectStorageEntries(entry_count, false, aes_ctr_ex_end_offset, &end_offset);
+            break;
+        case BucketTreeStorageType_Sparse:
+            entries = benchGenerateIndirectStorageEntries(entry_count, true, 0, &end_offset);
+            break;
+        case BucketTreeStorageType_AesCtrEx:
+            entries = benchGenerateAesCtrExStorageEntries(entry_count, BENCH_BKTR_DATA_SIZE, &end_offset);
+            break;
+        case BucketTreeStorageType_Compressed:
+            /* All LZ4 entries point to the same compressed block, placed at the start of the image. */
+            if (!(lz4_data = benchGenerateSyntheticData(BENCH_BKTR_LZ4_ENTRY_SIZE))) break;
+
+            lz4_physical_size = LZ4_compress_default((const char*)lz4_data, (char*)out->image, BENCH_BKTR_LZ4_ENTRY_SIZE, LZ4_compressBound(BENCH_BKTR_LZ4_ENTRY_SIZE));
+            if (lz4_physical_size <= 0) break;
+
+            entries = benchGenerateCompressedStorageEntries(entry_count, (u32)lz4_physical_size, &end_offset);
+            break;
+        default:
+            break;
+    }
+
+    if (!entries)
+    {
+        fprintf(stderr, "Failed to generate synthetic %s storage entries!\n", g_benchBucketTreeTypeNames[storage_type]);
+        goto end;
+    }
+
+    benchWriteBucketTreeTable(out->image + BENCH_BKTR_DATA_SIZE, entries, entry_size, entry_count, end_offset);
+
+    /* Register NCA FS section images. */
+    if (!shimRegisterNcaFsSectionImage(&(out->nca_ctx), &(out->nca_fs_ctx), (storage_type == BucketTreeStorageType_Indirect || storage_type == BucketTreeStorageType_AesCtrEx) ? \
+                                       NcaFsSectionType_PatchRomFs : NcaFsSectionType_RomFs, out->image, BENCH_BKTR_DATA_SIZE + table_size + aes_ctr_ex_table_size) || \
+        (out->base_image && !shimRegisterNcaFsSectionImage(&(out->base_nca_ctx), &(out->base_nca_fs_ctx), NcaFsSectionType_RomFs, out->base_image, BENCH_BKTR_DATA_SIZE)))
+    {
+        fprintf(stderr, "Failed to register synthetic %s storage image!\n", g_benchBucketTreeTypeNames[storage_type]);
+        goto end;
+    }
+
+    if (storage_type == BucketTreeStorageType_Indirect)
+    {
+        NcaBucketInfo *aes_ctr_ex_bucket = &(out->nca_fs_ctx.header.patch_info.aes_ctr_ex_bucket);
+
+        aes_ctr_ex_bucket->offset = (BENCH_BKTR_DATA_SIZE + table_size);
+        aes_ctr_ex_bucket->size = aes_ctr_ex_table_size;
+        aes_ctr_ex_bucket->header.magic = __builtin_bswap32(NCA_BKTR_MAGIC);
+        aes_ctr_ex_bucket->header.version = NCA_BKTR_VERSION;
+        aes_ctr_ex_bucket->header.entry_count = BENCH_BKTR_AES_CTR_EX_ENTRY_COUNT;
+
+        if (!bktrInitializeContext(&(out->aes_ctr_ex_ctx), &(out->nca_fs_ctx), BucketTreeStorageType_AesCtrEx) || \
+            !bktrSetRegularSubStorage(&(out->aes_ctr_ex_ctx), &(out->nca_fs_ctx))) goto end;
+    }
+
+    /* Initialize Bucket Tree context. */
+    if (!benchInitializeBucketTreeStorage(out, storage_type, BENCH_BKTR_DATA_SIZE, table_size, entry_count)) goto end;
+
+    /* Set substorages. Compressed storages get theirs while being initialized. */
+    switch(storage_type)
+    {
+        case BucketTreeStorageType_Indirect:
+            success = (bktrSetRegularSubStorage(&(out->bktr_ctx), &(out->base_nca_fs_ctx)) && bktrSetBucketTreeSubStorage(&(out->bktr_ctx), &(out->aes_ctr_ex_ctx), 1));
+            break;
+        case BucketTreeStorageType_AesCtrEx:
+        case BucketTreeStorageType_Sparse:
+            success = bktrSetRegularSubStorage(&(out->bktr_ctx), &(out->nca_fs_ctx));
+            break;
+        default:
+            success = true;
+            break;
+    }
+
+    out->readable = success;
+
+end:
+    if (lz4_data) free(lz4_data);
+    if (aes_ctr_ex_entries) free(aes_ctr_ex_entries);
+    if (entries) free(entries);
+
+    return success;
+}
+
+static bool benchLoadBucketTreeStorage(BenchBucketTreeStorage *out, const char *arg)
+{
+    const char *path = strchr(arg, ':');
+    u8 storage_type = BucketTreeStorageType_Count;
+    u64 image_size = 0, entry_size = 0, entry_offset = 0;
+    u32 entry_set_count = 0, entry_count = 0;
+
+    memset(out, 0, sizeof(BenchBucketTreeStorage));
+
+    /* Captured tables are provided as "<type>:<path>". */
+    for(u8 i = 0; path && i < BucketTreeStorageType_Count; i++)
+    {
+        if (strlen(g_benchBucketTreeTypeNames[i]) != (size_t)(path - arg) || strncmp(g_benchBucketTreeTypeNames[i], arg, (size_t)(path - arg)) != 0) continue;
+        storage_type = i;
+        break;
+    }
+
+    if (storage_type >= BucketTreeStorageType_Count)
+    {
+        fprintf(stderr, "Captured Bucket Tree tables must be provided as <type>:<file>, where <type> is one of: indirect, aesctrex, sparse, compressed.\n");
+        return false;
+    }
+
+    if (!benchLoadFile(++path, &(out->image), &image_size)) return false;
+
+    /* Captured tables don't come with their bucket info, so the entry count is calculated from the entry node headers. */
+    /* The table size only depends on the entry node count, so the maximum entry count is enough to find out where entry nodes start. */
+    entry_size = benchGetBucketTreeEntrySize(storage_type);
+
+    if (image_size >= BKTR_NODE_SIZE) entry_set_count = ((BucketTreeOffsetNode*)out->image)->header.count;
+
+    if (entry_set_count && ((u64)entry_set_count * bktrGetEntryCount(BKTR_NODE_SIZE, entry_size)) <= UINT32_MAX)
+    {
+        u64 max_entry_count = ((u64)entry_set_count * bktrGetEntryCount(BKTR_NODE_SIZE, entry_size));
+        entry_offset = bktrQueryNodeStorageSize(BKTR_NODE_SIZE, entry_size, (u32)max_entry_count);
+    }
+
+    if (!entry_offset || ((u64)entry_set_count * BKTR_NODE_SIZE) > (image_size - MIN(entry_offset, image_size)))
+    {
+        fprintf(stderr, "\"%s\" doesn't hold a valid %s storage table!\n", path, g_benchBucketTreeTypeNames[storage_type]);
+        return false;
+    }
+
+    for(u32 i = 0; i < entry_set_count; i++) entry_count += ((BucketTreeNodeHeader*)(out->image + entry_offset + ((u64)i * BKTR_NODE_SIZE)))->count;
+
+    if (!shimRegisterNcaFsSectionImage(&(out->nca_ctx), &(out->nca_fs_ctx), (storage_type == BucketTreeStorageType_Indirect || storage_type == BucketTreeStorageType_AesCtrEx) ? \
+                                       NcaFsSectionType_PatchRomFs : NcaFsSectionType_RomFs, out->image, image_size)) return false;
+
+    return benchInitializeBucketTreeStorage(out, storage_type, 0, image_size, entry_count);
+}
+
+static bool benchInitializeBucketTreeStorage(BenchBucketTreeStorage *storage, u8 storage_type, u64 table_offset, u64 table_size, u32 entry_count)
+{
+    NcaFsSectionContext *nca_fs_ctx = &(storage->nca_fs_ctx);
+    NcaBucketInfo *bucket = NULL;
+    bool success = false;
+
+    switch(storage_type)
+    {
+        case BucketTreeStorageType_Indirect:
+            bucket = &(nca_fs_ctx->header.patch_info.indirect_bucket);
+            break;
+        case BucketTreeStorageType_AesCtrEx:
+            bucket = &(nca_fs_ctx->header.patch_info.aes_ctr_ex_bucket);
+            break;
+        case BucketTreeStorageType_Sparse:
+            bucket = &(nca_fs_ctx->header.sparse_info.bucket);
+            nca_fs_ctx->has_sparse_layer = true;
+            nca_fs_ctx->sparse_table_offset = table_offset;
+            break;
+        case BucketTreeStorageType_Compressed:
+            bucket = &(nca_fs_ctx->header.compression_info.bucket);
+            nca_fs_ctx->has_compression_layer = true;
+            break;
+        default:
+            return false;
+    }
+
+    bucket->offset = table_offset;
+    bucket->size = table_size;
+    bucket->header.magic = __builtin_bswap32(NCA_BKTR_MAGIC);
+    bucket->header.version = NCA_BKTR_VERSION;
+    bucket->header.entry_count = entry_count;
+
+    if (storage_type == BucketTreeStorageType_Compressed)
+    {
+        BucketTreeSubStorage substorage = {
+            .index = 0,
+            .nca_fs_ctx = nca_fs_ctx,
+            .type = BucketTreeSubStorageType_Regular,
+            .bktr_ctx = NULL
+        };
+
+        success = bktrInitializeCompressedStorageContext(&(storage->bktr_ctx), &substorage);
+    } else {
+        success = bktrInitializeContext(&(storage->bktr_ctx), nca_fs_ctx, storage_type);
+    }
+
+    if (!success) fprintf(stderr, "Failed to initialize %s storage context!\n", g_benchBucketTreeTypeNames[storage_type]);
+
+    return success;
+}
+
+static void benchFreeBucketTreeStorage(BenchBucketTreeStorage *storage)
+{
+    shimUnregisterNcaFsSectionImage(&(storage->nca_fs_ctx));
+    shimUnregisterNcaFsSectionImage(&(storage->base_nca_fs_ctx));
+
+    bktrFreeContext(&(storage->bktr_ctx));
+    bktrFreeContext(&(storage->aes_ctr_ex_ctx));
+
+    if (storage->image) free(storage->image);
+    if (storage->base_image) free(storage->base_image);
+
+    memset(storage, 0, sizeof(BenchBucketTreeStorage));
+}
+
+static void *benchGenerateIndirectStorageEntries(u32 entry_count, bool is_sparse, u64 patch_size, u64 *out_end_offset)
+{
+    BucketTreeIndirectStorageEntry *entries = calloc(entry_count, sizeof(BucketTreeIndirectStorageEntry));
+    if (!entries) return NULL;
+
+    u64 state = BENCH_BKTR_RANDOM_SEED, virtual_offset = 0, patch_offset = 0;
+
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        BucketTreeIndirectStorageEntry *entry = &(entries[i]);
+        u64 size = (BENCH_BKTR_MIN_ENTRY_SIZE * (1 + (benchGetRandomValue(&state) % (BENCH_BKTR_MAX_ENTRY_SIZE / BENCH_BKTR_MIN_ENTRY_SIZE))));
+
+        entry->virtual_offset = virtual_offset;
+
+        if ((benchGetRandomValue(&state) % 100) < BENCH_BKTR_PATCH_ENTRY_RATIO)
+        {
+            /* Patch entries are laid out sequentially within the AesCtrEx storage, wrapping around once its end is reached. */
+            /* Physical offsets are irrelevant for Sparse storages, since this is their ZeroStorage. */
+            entry->storage_index = BucketTreeIndirectStorageIndex_Patch;
+
+            if (!is_sparse)
+            {
+                if ((patch_offset + size) > patch_size) patch_offset = 0;
+                entry->physical_offset = patch_offset;
+                patch_offset += size;
+            }
+        } else {
+            /* Consecutive Original entries are physically contiguous most of the time, which lets reads span multiple entries. */
+            entry->storage_index = BucketTreeIndirectStorageIndex_Original;
+            entry->physical_offset = (virtual_offset % (BENCH_BKTR_DATA_SIZE - BENCH_BKTR_MAX_ENTRY_SIZE));
+        }
+
+        virtual_offset += size;
+    }
+
+    *out_end_offset = virtual_offset;
+
+    return entries;
+}
+
+static void *benchGenerateAesCtrExStorageEntries(u32 entry_count, u64 data_size, u64 *out_end_offset)
+{
+    BucketTreeAesCtrExStorageEntry *entries = calloc(entry_count, sizeof(BucketTreeAesCtrExStorageEntry));
+    if (!entries) return NULL;
+
+    /* Entry sizes are picked so the whole storage fits within the first 3/4 of the physical data region. */
+    const u64 avg_size = MAX(ALIGN_DOWN((data_size / 2) / entry_count, AES_BLOCK_SIZE), AES_BLOCK_SIZE);
+    u64 state = BENCH_BKTR_RANDOM_SEED, virtual_offset = 0;
+
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        BucketTreeAesCtrExStorageEntry *entry = &(entries[i]);
+
+        entry->offset = virtual_offset;
+        entry->encryption = ((benchGetRandomValue(&state) % 8) ? BucketTreeAesCtrExStorageEncryption_Enabled : BucketTreeAesCtrExStorageEncryption_Disabled);
+        entry->generation = (i / 64);
+
+        virtual_offset += MAX(ALIGN_UP((avg_size / 2) + (benchGetRandomValue(&state) % avg_size), AES_BLOCK_SIZE), AES_BLOCK_SIZE);
+    }
+
+    *out_end_offset = virtual_offset;
+
+    return entries;
+}
+
+static void *benchGenerateCompressedStorageEntries(u32 entry_count, u32 lz4_physical_size, u64 *out_end_offset)
+{
+    BucketTreeCompressedStorageEntry *entries = calloc(entry_count, sizeof(BucketTreeCompressedStorageEntry));
+    if (!entries) return NULL;
+
+    u64 state = BENCH_BKTR_RANDOM_SEED, virtual_offset = 0;
+
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        BucketTreeCompressedStorageEntry *entry = &(entries[i]);
+        u64 type_value = (benchGetRandomValue(&state) % 100), size = 0;
+
+        entry->virtual_offset = (s64)virtual_offset;
+
+        if (type_value < BENCH_BKTR_LZ4_ENTRY_RATIO)
+        {
+            entry->compression_type = BucketTreeCompressedStorageCompressionType_LZ4;
+            entry->compression_level = BKTR_COMPRESSION_LEVEL_DEFAULT;
+            entry->physical_offset = 0;
+            entry->physical_size = lz4_physical_size;
+            size = BENCH_BKTR_LZ4_ENTRY_SIZE;
+        } else {
+            size = (BENCH_BKTR_MIN_ENTRY_SIZE * (1 + (benchGetRandomValue(&state) % (BENCH_BKTR_MAX_ENTRY_SIZE / BENCH_BKTR_MIN_ENTRY_SIZE))));
+
+            if (type_value < (BENCH_BKTR_LZ4_ENTRY_RATIO + BENCH_BKTR_ZERO_ENTRY_RATIO))
+            {
+                entry->compression_type = BucketTreeCompressedStorageCompressionType_Zero;
+                entry->physical_size = 0;
+            } else {
+                entry->compression_type = BucketTreeCompressedStorageCompressionType_None;
+                entry->physical_offset = (s64)ALIGN_DOWN(virtual_offset % (BENCH_BKTR_DATA_SIZE - BENCH_BKTR_MAX_ENTRY_SIZE), BKTR_COMPRESSION_PHYS_ALIGNMENT);
+                entry->physical_size = BKTR_COMPRESSION_INVALID_PHYS_SIZE;
+            }
+        }
+
+        virtual_offset += size;
+    }
+
+    *out_end_offset = virtual_offset;
+
+    return entries;
+}
+
+static u64 benchGetBucketTreeTableSize(u64 entry_size, u32 entry_count)
+{
+    /* L2 nodes are only needed if there are more entry nodes than offsets within the offset node. */
+    if (!entry_count || bktrGetEntrySetCount(BKTR_NODE_SIZE, entry_size, entry_count) > bktrGetOffsetCount(BKTR_NODE_SIZE)) return 0;
+    return (bktrQueryNodeStorageSize(BKTR_NODE_SIZE, entry_size, entry_count) + bktrQueryEntryStorageSize(BKTR_NODE_SIZE, entry_size, entry_count));
+}
+
+static void benchWriteBucketTreeTable(u8 *out, const void *entries, u64 entry_size, u32 entry_count, u64 end_offset)
+{
+    /* The first field from all entry types holds its virtual offset. */
+    const u8 *entries_ptr = (const u8*)entries;
+    const u32 entry_count_per_node = bktrGetEntryCount(BKTR_NODE_SIZE, entry_size), entry_set_count = bktrGetEntrySetCount(BKTR_NODE_SIZE, entry_size, entry_count);
+    BucketTreeOffsetNode *offset_node = (BucketTreeOffsetNode*)out;
+
+    memset(out, 0, benchGetBucketTreeTableSize(entry_size, entry_count));
+
+    offset_node->header.index = 0;
+    offset_node->header.count = entry_set_count;
+    offset_node->header.offset = end_offset;
+
+    for(u32 i = 0; i < entry_set_count; i++)
+    {
+        BucketTreeNodeHeader *node_header = (BucketTreeNodeHeader*)(out + ((u64)(i + 1) * BKTR_NODE_SIZE));
+        const u32 first_entry_idx = (i * entry_count_per_node), node_entry_count = MIN(entry_count_per_node, entry_count - first_entry_idx);
+        u64 node_start_offset = 0, node_end_offset = end_offset;
+
+        /* Each entry node ends right where the next one starts. */
+        memcpy(&node_start_offset, entries_ptr + ((u64)first_entry_idx * entry_size), sizeof(u64));
+        if ((i + 1) < entry_set_count) memcpy(&node_end_offset, entries_ptr + ((u64)(first_entry_idx + entry_count_per_node) * entry_size), sizeof(u64));
+
+        node_header->index = i;
+        node_header->count = node_entry_count;
+        node_header->offset = node_end_offset;
+        memcpy((u8*)node_header + BKTR_NODE_HEADER_SIZE, entries_ptr + ((u64)first_entry_idx * entry_size), (u64)node_entry_count * entry_size);
+
+        offset_node->offsets[i] = node_start_offset;
+    }
+}
+
+static bool benchRunBucketTreeStorage(BenchBucketTreeStorage *storage, u32 iterations)
+{
+    BucketTreeContext *ctx = &(storage->bktr_ctx);
+    const u64 virtual_size = (ctx->end_offset - ctx->start_offset);
+
+    BenchTimer flat_random_timer = { .name = "Lookup (flat, random)" }, tree_random_timer = { .name = "Lookup (tree, random)" };
+    BenchTimer flat_seq_timer = { .name = "Lookup (flat, seq)" }, tree_seq_timer = { .name = "Lookup (tree, seq)" };
+    BenchTimer iteration_timer = { .name = "Visitor iteration" };
+    BenchTimer seq_read_timer = { .name = "Read (seq)" }, seq_read_no_cursor_timer = { .name = "Read (seq, no cursor)" }, random_read_timer = { .name = "Read (random)" };
+    BenchTimer extent_query_timer = { .name = "Extent query (random)" };
+
+    u64 *random_offsets = NULL, *seq_offsets = NULL, *read_offsets = NULL, state = BENCH_BKTR_RANDOM_SEED;
+    u8 *read_buf = NULL;
+    u32 entry_count = 0;
+
+    bool success = false;
+
+    if (!(random_offsets = malloc(BENCH_BKTR_LOOKUP_COUNT * sizeof(u64))) || !(seq_offsets = malloc(BENCH_BKTR_LOOKUP_COUNT * sizeof(u64))) || \
+        !(read_offsets = malloc(BENCH_BKTR_RANDOM_READ_COUNT * sizeof(u64))) || !(read_buf = malloc(BENCH_BKTR_READ_SIZE)))
+    {
+        fprintf(stderr, "Failed to allocate memory for Bucket Tree benchmark buffers!\n");
+        goto end;
+    }
+
+    /* Sequential lookups are evenly spread across the whole storage. Random reads never cross the storage end. */
+    for(u32 i = 0; i < BENCH_BKTR_LOOKUP_COUNT; i++)
+    {
+        random_offsets[i] = (ctx->start_offset + (benchGetRandomValue(&state) % virtual_size));
+        seq_offsets[i] = (ctx->start_offset + ((virtual_size / BENCH_BKTR_LOOKUP_COUNT) * i));
+    }
+
+    for(u32 i = 0; i < BENCH_BKTR_RANDOM_READ_COUNT; i++)
+    {
+        read_offsets[i] = (virtual_size > BENCH_BKTR_READ_SIZE ? (ctx->start_offset + ALIGN_DOWN(benchGetRandomValue(&state) % (virtual_size - BENCH_BKTR_READ_SIZE), 0x200)) : \
+                           ctx->start_offset);
+    }
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        if (!benchRunBucketTreeLookups(ctx, random_offsets, BENCH_BKTR_LOOKUP_COUNT, true, &flat_random_timer) || \
+            !benchRunBucketTreeLookups(ctx, random_offsets, BENCH_BKTR_LOOKUP_COUNT, false, &tree_random_timer) || \
+            !benchRunBucketTreeLookups(ctx, seq_offsets, BENCH_BKTR_LOOKUP_COUNT, true, &flat_seq_timer) || \
+            !benchRunBucketTreeLookups(ctx, seq_offsets, BENCH_BKTR_LOOKUP_COUNT, false, &tree_seq_timer) || \
+            !benchRunBucketTreeIteration(ctx, &iteration_timer, &entry_count)) goto end;
+
+        if (!storage->readable) continue;
+
+        if (!benchRunBucketTreeSequentialReads(storage, read_buf, true, &seq_read_timer) || \
+            !benchRunBucketTreeSequentialReads(storage, read_buf, false, &seq_read_no_cursor_timer) || \
+            !benchRunBucketTreeRandomReads(storage, read_buf, read_offsets, BENCH_BKTR_RANDOM_READ_COUNT, &random_read_timer) || \
+            !benchRunBucketTreeExtentQueries(storage, read_offsets, BENCH_BKTR_RANDOM_READ_COUNT, &extent_query_timer)) goto end;
+    }
+
+    printf("  %s: %u entries, %u entry node(s), 0x%lX-byte long virtual range%s.\n", g_benchBucketTreeTypeNames[ctx->storage_type], entry_count, ctx->entry_set_count, \
+           virtual_size, ctx->flat_index.entry_count ? "" : ", no flat index");
+
+    benchTimerReport(&flat_random_timer);
+    benchTimerReport(&tree_random_timer);
+    benchTimerReport(&flat_seq_timer);
+    benchTimerReport(&tree_seq_timer);
+    benchTimerReport(&iteration_timer);
+    benchTimerReport(&seq_read_timer);
+    benchTimerReport(&seq_read_no_cursor_timer);
+    benchTimerReport(&random_read_timer);
+    benchTimerReport(&extent_query_timer);
+
+    success = true;
+
+end:
+    if (read_buf) free(read_buf);
+    if (read_offsets) free(read_offsets);
+    if (seq_offsets) free(seq_offsets);
+    if (random_offsets) free(random_offsets);
+
+    return success;
+}
+
+static bool benchRunBucketTreeLookups(BucketTreeContext *ctx, const u64 *offsets, u32 offset_count, bool use_flat_index, BenchTimer *timer)
+{
+    const u32 flat_index_entry_count = ctx->flat_index.entry_count;
+    BucketTreeVisitor visitor = {0};
+    u64 start = 0, sink = 0;
+    bool success = true;
+
+    /* Nothing to do if the flat index couldn't be built. */
+    if (use_flat_index && !flat_index_entry_count) return true;
+
+    /* Tree lookups are forced by temporarily hiding the flat index. */
+    if (!use_flat_index) ctx->flat_index.entry_count = 0;
+
+    benchTimerStart(timer, &start);
+
+    for(u32 i = 0; i < offset_count; i++)
+    {
+        if (!(success = bktrFindStorageEntry(ctx, offsets[i], &visitor))) break;
+        sink += visitor.entry_index;
+    }
+
+    benchTimerStop(timer, start, offset_count, 0);
+
+    ctx->flat_index.entry_count = flat_index_entry_count;
+    g_benchBucketTreeSink += sink;
+
+    if (!success) fprintf(stderr, "Failed to look up %s storage entry!\n", g_benchBucketTreeTypeNames[ctx->storage_type]);
+
+    return success;
+}
+
+static bool benchRunBucketTreeIteration(BucketTreeContext *ctx, BenchTimer *timer, u32 *out_entry_count)
+{
+    BucketTreeVisitor visitor = {0};
+    u64 start = 0;
+    u32 entry_count = 1;
+    bool success = false;
+
+    benchTimerStart(timer, &start);
+
+    if ((success = bktrFindStorageEntry(ctx, ctx->start_offset, &visitor)))
+    {
+        while(bktrVisitorCanMoveNext(&visitor))
+        {
+            if (!(success = bktrVisitorMoveNext(&visitor))) break;
+            entry_count++;
+        }
+    }
+
+    benchTimerStop(timer, start, entry_count, 0);
+
+    if (success)
+    {
+        *out_entry_count = entry_count;
+    } else {
+        fprintf(stderr, "Failed to iterate through %s storage entries!\n", g_benchBucketTreeTypeNames[ctx->storage_type]);
+    }
+
+    return success;
+}
+
+static bool benchRunBucketTreeSequentialReads(BenchBucketTreeStorage *storage, u8 *buf, bool use_cursor, BenchTimer *timer)
+{
+    BucketTreeContext *ctx = &(storage->bktr_ctx);
+    const u64 end_offset = MIN(ctx->end_offset, ctx->start_offset + BENCH_BKTR_SEQUENTIAL_READ_SPAN);
+    u64 start = 0, offset = ctx->start_offset, op_count = 0;
+    bool success = true;
+
+    /* Always start from scratch. Disabling the cursor also covers the AesCtrEx substorage used by Indirect storages. */
+    bktrInvalidateCursor(ctx);
+    bktrInvalidateCursor(&(storage->aes_ctr_ex_ctx));
+
+    benchTimerStart(timer, &start);
+
+    while(offset < end_offset)
+    {
+        const u64 read_size = MIN(BENCH_BKTR_READ_SIZE, end_offset - offset);
+
+        if (!use_cursor)
+        {
+            bktrInvalidateCursor(ctx);
+            bktrInvalidateCursor(&(storage->aes_ctr_ex_ctx));
+        }
+
+        if (!(success = bktrReadStorage(ctx, buf, read_size, offset))) break;
+
+        offset += read_size;
+        op_count++;
+    }
+
+    benchTimerStop(timer, start, op_count, offset - ctx->start_offset);
+
+    if (!success) fprintf(stderr, "Failed to read %s storage data at offset 0x%lX!\n", g_benchBucketTreeTypeNames[ctx->storage_type], offset);
+
+    return success;
+}
+
+static bool benchRunBucketTreeRandomReads(BenchBucketTreeStorage *storage, u8 *buf, const u64 *offsets, u32 offset_count, BenchTimer *timer)
+{
+    BucketTreeContext *ctx = &(storage->bktr_ctx);
+    const u64 read_size = MIN(BENCH_BKTR_READ_SIZE, ctx->end_offset - ctx->start_offset);
+    u64 start = 0;
+    u32 i = 0;
+    bool success = true;
+
+    benchTimerStart(timer, &start);
+
+    for(i = 0; i < offset_count; i++)
+    {
+        if (!(success = bktrReadStorage(ctx, buf, read_size, offsets[i]))) break;
+    }
+
+    benchTimerStop(timer, start, i, (u64)i * read_size);
+
+    if (!success) fprintf(stderr, "Failed to read %s storage data at offset 0x%lX!\n", g_benchBucketTreeTypeNames[ctx->storage_type], offsets[i]);
+
+    return success;
+}
+
+static bool benchRunBucketTreeExtentQueries(BenchBucketTreeStorage *storage, const u64 *offsets, u32 offset_count, BenchTimer *timer)
+{
+    BucketTreeContext *ctx = &(storage->bktr_ctx);
+    const u64 query_size = MIN(BENCH_BKTR_READ_SIZE, ctx->end_offset - ctx->start_offset);
+    StorageExtentList list = {0};
+    u64 start = 0, extent_count = 0;
+    u32 i = 0;
+    bool success = true;
+
+    benchTimerStart(timer, &start);
+
+    for(i = 0; i < offset_count; i++)
+    {
+        /* Reuse the same extent array for every query. */
+        list.count = 0;
+        if (!(success = bktrQueryStorageExtents(ctx, &list, query_size, offsets[i]))) break;
+        extent_count += list.count;
+    }
+
+    benchTimerStop(timer, start, i, 0);
+
+    storageExtentListFree(&list);
+    g_benchBucketTreeSink += extent_count;
+
+    if (!success) fprintf(stderr, "Failed to query %s storage extents at offset 0x%lX!\n", g_benchBucketTreeTypeNames[ctx->storage_type], offsets[i]);
+
+    return success;
+}
+
+NX_INLINE u64 benchGetBucketTreeEntrySize(u8 storage_type)
+{
+    return (storage_type == BucketTreeStorageType_AesCtrEx ? BKTR_AES_CTR_EX_ENTRY_SIZE : \
+           (storage_type == BucketTreeStorageType_Compressed ? BKTR_COMPRESSED_ENTRY_SIZE : BKTR_INDIRECT_ENTRY_SIZE));
+}
+
+NX_INLINE u64 benchGetRandomValue(u64 *state)
+{
+    /* xorshift64. */
+    u64 x = *state;
+    x ^= (x << 13);
+    x ^= (x >> 7);
+    x ^= (x << 17);
+    return (*state = x);
+}
@@ -0,0 +1,1077 @@
+/*
+ * bench_main.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Host benchmark runner for platform-independent core modules. See README.md for usage. */
+
+#include <core/nxdt_utils.h>
+#include <core/pfs.h>
+#include <core/romfs.h>
+#include <core/hfs.h>
+#include <core/gamecard.h>
+#include <core/sha3.h>
+#include <core/lz4.h>
+
+#ifdef BENCH_ARM_CRYPTO
+#include <core/aes.h>
+#include <core/crc32_fast.h>
+#include <core/sha256_mb.h>
+#endif
+
+#include "bench.h"
+#include "shim/storage_shim.h"
+
+#define BENCH_DEFAULT_ITERATIONS            10
+
+#define BENCH_SYNTHETIC_PFS_ENTRY_COUNT     4096
+#define BENCH_SYNTHETIC_PFS_ENTRY_SIZE      0x200
+
+#define BENCH_SYNTHETIC_ROMFS_DIR_COUNT     32          /* Directories right below the root directory. */
+#define BENCH_SYNTHETIC_ROMFS_SUBDIR_COUNT  8           /* Subdirectories within each directory. */
+#define BENCH_SYNTHETIC_ROMFS_FILE_COUNT    16          /* Files within each subdirectory. */
+#define BENCH_SYNTHETIC_ROMFS_FILE_SIZE     0x100
+
+#define BENCH_SYNTHETIC_XCI_HFS_OFFSET      0xF000      /* Root Hash FS header offset used by most gamecards. */
+#define BENCH_SYNTHETIC_XCI_ENTRY_COUNT     256         /* Entries within each child Hash FS partition. */
+#define BENCH_SYNTHETIC_XCI_ENTRY_SIZE      0x1000
+
+#define BENCH_ROMFS_ENTRY_HASH_SEED         123456789   /* Must match ROMFS_ENTRY_HASH_SEED from romfs.c. */
+
+#define BENCH_SYNTHETIC_DATA_SIZE           0x1000000   /* 16 MiB. */
+
+#define BENCH_HASH_BLOCK_SIZE               0x4000      /* 16 KiB. Matches the HierarchicalSha256 block size used by most ExeFS sections. */
+
+/* Type definitions. */
+
+typedef bool (*BenchModeFunction)(const char *path, u32 iterations);
+
+typedef struct {
+    const char *name;
+    const char *description;
+    bool needs_file;
+    BenchModeFunction func;
+} BenchMode;
+
+/* Function prototypes. */
+
+static bool benchRunPartitionFs(const char *path, u32 iterations);
+static bool benchRunRomFs(const char *path, u32 iterations);
+static bool benchRunGameCard(const char *path, u32 iterations);
+static bool benchRunLz4(const char *path, u32 iterations);
+static bool benchRunSha3(const char *path, u32 iterations);
+
+#ifdef BENCH_ARM_CRYPTO
+static bool benchRunCrc32(const char *path, u32 iterations);
+static bool benchRunSha256Blocks(const char *path, u32 iterations);
+static bool benchRunAes(const char *path, u32 iterations);
+#endif
+
+static void benchPrintUsage(const char *argv0);
+
+static bool benchGetInputData(const char *path, u8 **out_buf, u64 *out_size);
+static u8 *benchGenerateSyntheticPartitionFs(u64 *out_size);
+static u8 *benchGenerateSyntheticRomFs(u64 *out_size);
+static u32 benchAddSyntheticRomFsEntry(u32 *bucket, u32 bucket_count, u32 entry_offset, u32 parent_offset, const char *name, u32 name_len, char *out_name, u32 *out_name_len);
+
+static u8 *benchGenerateSyntheticGameCardImage(u64 *out_size);
+static u64 benchWriteSyntheticHashFs(u8 *out, u32 entry_count, const char * const *names, const u64 *sizes, u64 *out_header_size);
+
+static HashFileSystemContext *benchInitializeHashFileSystemContext(const char *name, u64 offset);
+
+/* Global variables. */
+
+static const BenchMode g_benchModes[] = {
+    { "pfs",    "Partition FS header parsing and entry lookups (NSP, ExeFS or decrypted PFS section image)", false, benchRunPartitionFs },
+    { "romfs",  "RomFS table parsing, path generation and path lookups (decrypted RomFS section image)",    false, benchRunRomFs },
+    { "xci",    "Hash FS header parsing, entry lookups and read plan generation (XCI image without key area)", false, benchRunGameCard },
+    { "lz4",    "LZ4 block compression and decompression round trip",                                      false, benchRunLz4 },
+    { "sha3",   "SHA3-256 checksum calculation",                                                            false, benchRunSha3 },
+    { "bktr",   "Bucket Tree lookups, entry iteration and storage reads (<type>:<file> with a captured table)", false, benchRunBucketTree },
+#ifdef BENCH_ARM_CRYPTO
+    { "crc32",  "CRC32 checksum calculation (ARMv8 CRC32 instructions)",                                    false, benchRunCrc32 },
+    { "sha256", "Multi-buffer SHA-256 block hash calculation (ARMv8 SHA-2 instructions)",                  false, benchRunSha256Blocks },
+    { "aes",    "AES-128-ECB block encryption (ARMv8 AES instructions)",                                    false, benchRunAes },
+#endif
+};
+
+static const u32 g_benchModeCount = MAX_ELEMENTS(g_benchModes);
+
+int main(int argc, char **argv)
+{
+    u32 iterations = BENCH_DEFAULT_ITERATIONS;
+    const BenchMode *mode = NULL;
+    const char *path = NULL;
+    int arg_idx = 1, ret = EXIT_FAILURE;
+
+    if (arg_idx < argc && !strcmp(argv[arg_idx], "-i"))
+    {
+        if ((arg_idx + 1) >= argc || !(iterations = (u32)strtoul(argv[arg_idx + 1], NULL, 10)))
+        {
+            benchPrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        arg_idx += 2;
+    }
+
+    if (arg_idx >= argc)
+    {
+        benchPrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for(u32 i = 0; i < g_benchModeCount; i++)
+    {
+        if (strcmp(g_benchModes[i].name, argv[arg_idx]) != 0) continue;
+        mode = &(g_benchModes[i]);
+        break;
+    }
+
+    if (!mode)
+    {
+        fprintf(stderr, "Unknown benchmark mode \"%s\".\n\n", argv[arg_idx]);
+        benchPrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (++arg_idx < argc) path = argv[arg_idx];
+
+    if (mode->needs_file && !path)
+    {
+        fprintf(stderr, "Benchmark mode \"%s\" requires an input file.\n", mode->name);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s (%s), %u iteration(s).\n", mode->name, path ? path : "synthetic data", iterations);
+
+    if (mode->func(path, iterations)) ret = EXIT_SUCCESS;
+
+    bufferPoolExit();
+
+    return ret;
+}
+
+static bool benchRunPartitionFs(const char *path, u32 iterations)
+{
+    NcaContext nca_ctx = {0};
+    NcaFsSectionContext nca_fs_ctx = {0};
+    PartitionFileSystemContext pfs_ctx = {0};
+
+    BenchTimer parse_timer = { .name = "Header parsing" }, lookup_timer = { .name = "Entry lookup" }, size_timer = { .name = "Total data size" };
+    u64 start = 0, image_size = 0;
+    u8 *image = NULL;
+
+    bool success = false;
+
+    /* Load or generate the Partition FS image. */
+    image = (path ? (benchLoadFile(path, &image, &image_size) ? image : NULL) : benchGenerateSyntheticPartitionFs(&image_size));
+    if (!image || !shimRegisterNcaFsSectionImage(&nca_ctx, &nca_fs_ctx, NcaFsSectionType_PartitionFs, image, image_size)) goto end;
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        benchTimerStart(&parse_timer, &start);
+
+        if (!pfsInitializeContext(&pfs_ctx, &nca_fs_ctx))
+        {
+            fprintf(stderr, "Failed to initialize Partition FS context!\n");
+            goto end;
+        }
+
+        benchTimerStop(&parse_timer, start, 1, pfs_ctx.header_size);
+
+        /* Look up every single entry by name. The first lookup also builds the name index. */
+        u32 entry_count = pfsGetEntryCount(&pfs_ctx);
+
+        benchTimerStart(&lookup_timer, &start);
+
+        for(u32 j = 0; j < entry_count; j++)
+        {
+            const char *entry_name = pfsGetEntryNameByIndex(&pfs_ctx, j);
+            u32 entry_idx = 0;
+
+            if (!entry_name || !pfsGetEntryIndexByName(&pfs_ctx, entry_name, &entry_idx) || entry_idx != j)
+            {
+                fprintf(stderr, "Failed to look up Partition FS entry #%u!\n", j);
+                goto end;
+            }
+        }
+
+        benchTimerStop(&lookup_timer, start, entry_count, 0);
+
+        u64 total_size = 0;
+
+        benchTimerStart(&size_timer, &start);
+        bool size_ok = pfsGetTotalDataSize(&pfs_ctx, &total_size);
+        benchTimerStop(&size_timer, start, 1, 0);
+
+        if (!size_ok)
+        {
+            fprintf(stderr, "Failed to calculate Partition FS total data size!\n");
+            goto end;
+        }
+
+        if (!i) printf("%u entries, 0x%lX bytes of data.\n", entry_count, total_size);
+
+        pfsFreeContext(&pfs_ctx);
+    }
+
+    benchTimerReport(&parse_timer);
+    benchTimerReport(&lookup_timer);
+    benchTimerReport(&size_timer);
+
+    success = true;
+
+end:
+    pfsFreeContext(&pfs_ctx);
+
+    shimUnregisterNcaFsSectionImage(&nca_fs_ctx);
+
+    if (image) free(image);
+
+    return success;
+}
+
+static bool benchRunRomFs(const char *path, u32 iterations)
+{
+    NcaContext nca_ctx = {0};
+    NcaFsSectionContext nca_fs_ctx = {0};
+    RomFileSystemContext romfs_ctx = {0};
+    RomFileSystemPathMemo *memo = NULL;
+
+    BenchTimer parse_timer = { .name = "Table parsing" }, plan_timer = { .name = "Read plan generation" }, path_timer = { .name = "Path generation (memo)" };
+    BenchTimer index_timer = { .name = "Path index build" }, lookup_timer = { .name = "Path lookup (index)" };
+    u64 start = 0, image_size = 0;
+    u8 *image = NULL;
+
+    u32 *file_entry_offsets = NULL, file_entry_count = 0;
+    char path_buf[FS_MAX_PATH] = {0};
+
+    bool success = false;
+
+    /* Load or generate the RomFS image. */
+    image = (path ? (benchLoadFile(path, &image, &image_size) ? image : NULL) : benchGenerateSyntheticRomFs(&image_size));
+    if (!image || !shimRegisterNcaFsSectionImage(&nca_ctx, &nca_fs_ctx, NcaFsSectionType_RomFs, image, image_size)) goto end;
+
+    /* Path memos are too big to be placed on the stack alongside everything else. */
+    memo = calloc(1, sizeof(RomFileSystemPathMemo));
+    if (!memo) goto end;
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        benchTimerStart(&parse_timer, &start);
+
+        if (!romfsInitializeContext(&romfs_ctx, &nca_fs_ctx, NULL))
+        {
+            fprintf(stderr, "Failed to initialize RomFS context!\n");
+            goto end;
+        }
+
+        benchTimerStop(&parse_timer, start, 1, romfs_ctx.dir_table_size + romfs_ctx.file_table_size);
+
+        benchTimerStart(&plan_timer, &start);
+
+        if (!romfsGenerateFileEntryReadPlan(&romfs_ctx, false, &file_entry_offsets, &file_entry_count))
+        {
+            fprintf(stderr, "Failed to generate RomFS read plan!\n");
+            goto end;
+        }
+
+        benchTimerStop(&plan_timer, start, file_entry_count, 0);
+
+        if (!i) printf("%u file entries.\n", file_entry_count);
+
+        /* Generate paths for all file entries in read plan order, just like a full RomFS extraction would. */
+        romfsInitializePathMemo(memo);
+
+        benchTimerStart(&path_timer, &start);
+
+        for(u32 j = 0; j < file_entry_count; j++)
+        {
+            RomFileSystemFileEntry *file_entry = romfsGetFileEntryByOffset(&romfs_ctx, file_entry_offsets[j]);
+
+            if (!file_entry || !romfsGeneratePathFromFileEntryWithMemo(&romfs_ctx, file_entry, memo, path_buf, sizeof(path_buf), RomFileSystemPathIllegalCharReplaceType_IllegalFsChars))
+            {
+                fprintf(stderr, "Failed to generate path for RomFS file entry at offset 0x%X!\n", file_entry_offsets[j]);
+                goto end;
+            }
+        }
+
+        benchTimerStop(&path_timer, start, file_entry_count, 0);
+
+        benchTimerStart(&index_timer, &start);
+
+        if (!romfsBuildPathIndex(&romfs_ctx))
+        {
+            fprintf(stderr, "Failed to build RomFS path index!\n");
+            goto end;
+        }
+
+        benchTimerStop(&index_timer, start, 1, 0);
+
+        /* Resolve every file entry path back to its entry. Path generation isn't accounted for here. */
+        for(u32 j = 0; j < file_entry_count; j++)
+        {
+            RomFileSystemFileEntry *file_entry = romfsGetFileEntryByOffset(&romfs_ctx, file_entry_offsets[j]);
+
+            if (!romfsGeneratePathFromFileEntry(&romfs_ctx, file_entry, path_buf, sizeof(path_buf), RomFileSystemPathIllegalCharReplaceType_None))
+            {
+                fprintf(stderr, "Failed to generate path for RomFS file entry at offset 0x%X!\n", file_entry_offsets[j]);
+                goto end;
+            }
+
+            benchTimerStart(&lookup_timer, &start);
+            RomFileSystemFileEntry *found_entry = romfsGetFileEntryByPath(&romfs_ctx, path_buf);
+            benchTimerStop(&lookup_timer, start, 1, 0);
+
+            if (found_entry != file_entry)
+            {
+                fprintf(stderr, "Failed to look up RomFS file entry \"%s\"!\n", path_buf);
+                goto end;
+            }
+        }
+
+        free(file_entry_offsets);
+        file_entry_offsets = NULL;
+
+        romfsFreeContext(&romfs_ctx);
+    }
+
+    benchTimerReport(&parse_timer);
+    benchTimerReport(&plan_timer);
+    benchTimerReport(&path_timer);
+    benchTimerReport(&index_timer);
+    benchTimerReport(&lookup_timer);
+
+    success = true;
+
+end:
+    if (file_entry_offsets) free(file_entry_offsets);
+
+    romfsFreeContext(&romfs_ctx);
+
+    shimUnregisterNcaFsSectionImage(&nca_fs_ctx);
+
+    if (memo) free(memo);
+
+    if (image) free(image);
+
+    return success;
+}
+
+static bool benchRunGameCard(const char *path, u32 iterations)
+{
+    GameCardHeader *gc_header = NULL;
+    HashFileSystemContext *hfs_ctx[HashFileSystemPartitionType_Count] = {0};
+    u32 hfs_count = 0;
+
+    BenchTimer parse_timer = { .name = "Header parsing" }, lookup_timer = { .name = "Entry lookup" }, plan_timer = { .name = "Read plan generation" };
+    u64 start = 0, image_size = 0;
+    u8 *image = NULL;
+
+    bool success = false;
+
+    /* Load or generate the XCI image. */
+    image = (path ? (benchLoadFile(path, &image, &image_size) ? image : NULL) : benchGenerateSyntheticGameCardImage(&image_size));
+    if (!image) goto end;
+
+    gc_header = (GameCardHeader*)image;
+    if (image_size < sizeof(GameCardHeader) || __builtin_bswap32(gc_header->magic) != GAMECARD_HEAD_MAGIC)
+    {
+        fprintf(stderr, "Invalid gamecard header! Make sure the XCI image doesn't include a key area.\n");
+        goto end;
+    }
+
+    shimSetGameCardImage(image, image_size);
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        u32 entry_count = 0;
+
+        /* Parse the root Hash FS header, followed by the headers from every partition it references. */
+        benchTimerStart(&parse_timer, &start);
+
+        if (!(hfs_ctx[0] = benchInitializeHashFileSystemContext(NULL, gc_header->partition_fs_header_address)))
+        {
+            fprintf(stderr, "Failed to initialize root Hash FS context!\n");
+            goto end;
+        }
+
+        hfs_count = 1;
+
+        for(u32 j = 0; j < hfsGetEntryCount(hfs_ctx[0]) && hfs_count < HashFileSystemPartitionType_Count; j++)
+        {
+            HashFileSystemEntry *hfs_entry = hfsGetEntryByIndex(hfs_ctx[0], j);
+            const char *hfs_entry_name = hfsGetEntryName(hfs_ctx[0], hfs_entry);
+            u64 hfs_entry_offset = (hfs_ctx[0]->offset + hfs_ctx[0]->header_size + hfs_entry->offset);
+
+            if (!(hfs_ctx[hfs_count] = benchInitializeHashFileSystemContext(hfs_entry_name, hfs_entry_offset)))
+            {
+                fprintf(stderr, "Failed to initialize \"%s\" Hash FS context!\n", hfs_entry_name);
+                goto end;
+            }
+
+            hfs_count++;
+        }
+
+        benchTimerStop(&parse_timer, start, hfs_count, 0);
+
+        for(u32 j = 0; j < hfs_count; j++)
+        {
+            HashFileSystemReadPlan plan = {0};
+            u32 hfs_entry_count = hfsGetEntryCount(hfs_ctx[j]);
+
+            benchTimerStart(&lookup_timer, &start);
+
+            for(u32 k = 0; k < hfs_entry_count; k++)
+            {
+                const char *entry_name = hfsGetEntryNameByIndex(hfs_ctx[j], k);
+                u32 entry_idx = 0;
+
+                if (!entry_name || !hfsGetEntryIndexByName(hfs_ctx[j], entry_name, &entry_idx) || entry_idx != k)
+                {
+                    fprintf(stderr, "Failed to look up \"%s\" Hash FS entry #%u!\n", hfs_ctx[j]->name, k);
+                    goto end;
+                }
+            }
+
+            benchTimerStop(&lookup_timer, start, hfs_entry_count, 0);
+
+            benchTimerStart(&plan_timer, &start);
+            bool plan_ok = hfsGenerateReadPlan(hfs_ctx[j], &plan);
+            benchTimerStop(&plan_timer, start, 1, 0);
+
+            if (!plan_ok)
+            {
+                fprintf(stderr, "Failed to generate \"%s\" Hash FS read plan!\n", hfs_ctx[j]->name);
+                goto end;
+            }
+
+            if (!i) printf("%s: %u entries, %u read run(s).\n", hfs_ctx[j]->name, hfs_entry_count, plan.run_count);
+
+            hfsFreeReadPlan(&plan);
+            entry_count += hfs_entry_count;
+        }
+
+        for(u32 j = 0; j < hfs_count; j++)
+        {
+            hfsFreeContext(hfs_ctx[j]);
+            free(hfs_ctx[j]);
+            hfs_ctx[j] = NULL;
+        }
+
+        hfs_count = 0;
+    }
+
+    benchTimerReport(&parse_timer);
+    benchTimerReport(&lookup_timer);
+    benchTimerReport(&plan_timer);
+
+    success = true;
+
+end:
+    for(u32 i = 0; i < hfs_count; i++)
+    {
+        if (!hfs_ctx[i]) continue;
+        hfsFreeContext(hfs_ctx[i]);
+        free(hfs_ctx[i]);
+    }
+
+    shimSetGameCardImage(NULL, 0);
+
+    if (image) free(image);
+
+    return success;
+}
+
+static bool benchRunLz4(const char *path, u32 iterations)
+{
+    BenchTimer compress_timer = { .name = "Compression" }, decompress_timer = { .name = "Decompression" };
+    u64 start = 0, data_size = 0;
+    u8 *data = NULL, *compressed = NULL, *decompressed = NULL;
+    int compressed_size = 0;
+
+    bool success = false;
+
+    if (!benchGetInputData(path, &data, &data_size)) goto end;
+
+    if (data_size > LZ4_MAX_INPUT_SIZE)
+    {
+        fprintf(stderr, "Input data is too big for a single LZ4 block!\n");
+        goto end;
+    }
+
+    int bound = LZ4_compressBound((int)data_size);
+
+    compressed = malloc((size_t)bound);
+    decompressed = malloc(data_size);
+    if (!compressed || !decompressed) goto end;
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        benchTimerStart(&compress_timer, &start);
+        compressed_size = LZ4_compress_default((const char*)data, (char*)compressed, (int)data_size, bound);
+        benchTimerStop(&compress_timer, start, 1, data_size);
+
+        if (compressed_size <= 0)
+        {
+            fprintf(stderr, "LZ4 compression failed!\n");
+            goto end;
+        }
+
+        benchTimerStart(&decompress_timer, &start);
+        int decompressed_size = LZ4_decompress_safe((const char*)compressed, (char*)decompressed, compressed_size, (int)data_size);
+        benchTimerStop(&decompress_timer, start, 1, data_size);
+
+        if (decompressed_size != (int)data_size || memcmp(data, decompressed, data_size) != 0)
+        {
+            fprintf(stderr, "LZ4 round trip mismatch!\n");
+            goto end;
+        }
+    }
+
+    printf("0x%lX bytes -> 0x%X bytes (%.2f%%).\n", data_size, compressed_size, ((double)compressed_size * 100.0) / (double)data_size);
+
+    benchTimerReport(&compress_timer);
+    benchTimerReport(&decompress_timer);
+
+    success = true;
+
+end:
+    if (decompressed) free(decompressed);
+
+    if (compressed) free(compressed);
+
+    if (data) free(data);
+
+    return success;
+}
+
+static bool benchRunSha3(const char *path, u32 iterations)
+{
+    BenchTimer hash_timer = { .name = "SHA3-256" };
+    u64 start = 0, data_size = 0;
+    u8 *data = NULL, hash[SHA3_HASH_SIZE_BYTES(256)] = {0};
+
+    if (!benchGetInputData(path, &data, &data_size)) return false;
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        benchTimerStart(&hash_timer, &start);
+        sha3256CalculateHash(hash, data, data_size);
+        benchTimerStop(&hash_timer, start, 1, data_size);
+    }
+
+    benchTimerReport(&hash_timer);
+
+    free(data);
+
+    return true;
+}
+
+#ifdef BENCH_ARM_CRYPTO
+
+static bool benchRunCrc32(const char *path, u32 iterations)
+{
+    BenchTimer crc_timer = { .name = "CRC32" };
+    u64 start = 0, data_size = 0;
+    u8 *data = NULL;
+    u32 crc = 0;
+
+    if (!benchGetInputData(path, &data, &data_size)) return false;
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        benchTimerStart(&crc_timer, &start);
+        crc = crc32FastCalculate(data, data_size);
+        benchTimerStop(&crc_timer, start, 1, data_size);
+    }
+
+    printf("CRC32: %08X.\n", crc);
+
+    benchTimerReport(&crc_timer);
+
+    free(data);
+
+    return true;
+}
+
+static bool benchRunSha256Blocks(const char *path, u32 iterations)
+{
+    BenchTimer hash_timer = { .name = "SHA-256 block hashes" };
+    u64 start = 0, data_size = 0, hash_count = 0;
+    u8 *data = NULL, *hashes = NULL;
+
+    bool success = false;
+
+    if (!benchGetInputData(path, &data, &data_size)) goto end;
+
+    hash_count = ((data_size + BENCH_HASH_BLOCK_SIZE - 1) / BENCH_HASH_BLOCK_SIZE);
+
+    hashes = malloc(hash_count * SHA256_HASH_SIZE);
+    if (!hashes) goto end;
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        benchTimerStart(&hash_timer, &start);
+        sha256CalculateBlockHashes(hashes, data, data_size, BENCH_HASH_BLOCK_SIZE);
+        benchTimerStop(&hash_timer, start, hash_count, data_size);
+    }
+
+    benchTimerReport(&hash_timer);
+
+    success = true;
+
+end:
+    if (hashes) free(hashes);
+
+    if (data) free(data);
+
+    return success;
+}
+
+static bool benchRunAes(const char *path, u32 iterations)
+{
+    BenchTimer aes_timer = { .name = "AES-128-ECB" };
+    u64 start = 0, data_size = 0;
+    u8 *data = NULL, key[AES_128_KEY_SIZE] = {0};
+
+    if (!benchGetInputData(path, &data, &data_size)) return false;
+
+    data_size = ALIGN_DOWN(data_size, AES_BLOCK_SIZE);
+
+    for(u32 i = 0; i < iterations; i++)
+    {
+        benchTimerStart(&aes_timer, &start);
+        for(u64 j = 0; j < data_size; j += AES_BLOCK_SIZE) aes128EcbCrypt(data + j, data + j, key, true);
+        benchTimerStop(&aes_timer, start, data_size / AES_BLOCK_SIZE, data_size);
+    }
+
+    benchTimerReport(&aes_timer);
+
+    free(data);
+
+    return true;
+}
+
+#endif  /* BENCH_ARM_CRYPTO */
+
+static void benchPrintUsage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-i iterations] <mode> [file]\n\nAvailable modes:\n", argv0);
+
+    for(u32 i = 0; i < g_benchModeCount; i++)
+    {
+        const BenchMode *mode = &(g_benchModes[i]);
+        fprintf(stderr, "    %-8s %s.%s\n", mode->name, mode->description, mode->needs_file ? "" : " Uses synthetic data if no file is provided.");
+    }
+}
+
+void benchTimerReport(const BenchTimer *timer)
+{
+    if (!timer->op_count) return;
+
+    double ns_per_op = ((double)timer->total_ns / (double)timer->op_count);
+    printf("    %-24s %14.1f ns/op", timer->name, ns_per_op);
+
+    if (timer->byte_count && timer->total_ns) printf(" %10.1f MiB/s", ((double)timer->byte_count * 1000000000.0) / ((double)timer->total_ns * (double)BENCH_MIB));
+
+    printf(" (%lu ops, %.3f ms total)\n", timer->op_count, (double)timer->total_ns / 1000000.0);
+}
+
+bool benchLoadFile(const char *path, u8 **out_buf, u64 *out_size)
+{
+    FILE *fp = NULL;
+    long file_size = 0;
+    u8 *buf = NULL;
+    bool success = false;
+
+    if (!(fp = fopen(path, "rb")))
+    {
+        fprintf(stderr, "Failed to open \"%s\"!\n", path);
+        return false;
+    }
+
+    if (fseek(fp, 0, SEEK_END) != 0 || (file_size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0)
+    {
+        fprintf(stderr, "Failed to retrieve file size for \"%s\"!\n", path);
+        goto end;
+    }
+
+    if (!(buf = malloc((size_t)file_size)) || fread(buf, 1, (size_t)file_size, fp) != (size_t)file_size)
+    {
+        fprintf(stderr, "Failed to read 0x%lX bytes from \"%s\"!\n", file_size, path);
+        goto end;
+    }
+
+    *out_buf = buf;
+    *out_size = (u64)file_size;
+
+    success = true;
+
+end:
+    if (!success && buf) free(buf);
+
+    fclose(fp);
+
+    return success;
+}
+
+static bool benchGetInputData(const char *path, u8 **out_buf, u64 *out_size)
+{
+    if (path) return benchLoadFile(path, out_buf, out_size);
+
+    if (!(*out_buf = benchGenerateSyntheticData(BENCH_SYNTHETIC_DATA_SIZE))) return false;
+    *out_size = BENCH_SYNTHETIC_DATA_SIZE;
+
+    return true;
+}
+
+u8 *benchGenerateSyntheticData(u64 size)
+{
+    u8 *buf = malloc(size);
+    if (!buf) return NULL;
+
+    /* Mix short repeated runs with pseudorandom bytes, which roughly resembles the compressibility of typical NCA data. */
+    /* A fixed seed keeps results repeatable across runs. */
+    u32 state = 0x12345678;
+
+    for(u64 i = 0; i < size; i++)
+    {
+        state = ((state * 1103515245) + 12345);
+        buf[i] = ((state >> 16) & 0x30 ? (u8)(i >> 6) : (u8)(state >> 24));
+    }
+
+    return buf;
+}
+
+static u8 *benchGenerateSyntheticPartitionFs(u64 *out_size)
+{
+    PartitionFileSystemImageContext pfs_img_ctx = {0};
+    char entry_name[0x40] = {0};
+    u64 header_size = 0, image_size = 0;
+    u8 *image = NULL;
+
+    bool success = false;
+
+    /* Build a Partition FS image with lots of entries and names of varying length, which is what NSPs with many NCAs and ExeFS sections look like. */
+    pfsInitializeImageContext(&pfs_img_ctx);
+
+    for(u32 i = 0; i < BENCH_SYNTHETIC_PFS_ENTRY_COUNT; i++)
+    {
+        snprintf(entry_name, sizeof(entry_name), "%08x%0*x.nca", i * 0x9E3779B1, (int)(i % 24), i);
+        if (!pfsAddEntryInformationToImageContext(&pfs_img_ctx, entry_name, BENCH_SYNTHETIC_PFS_ENTRY_SIZE, NULL)) goto end;
+    }
+
+    image_size = (sizeof(PartitionFileSystemHeader) + (pfs_img_ctx.header.entry_count * sizeof(PartitionFileSystemEntry)) + pfs_img_ctx.header.name_table_size + pfs_img_ctx.fs_size);
+    if (!(image = calloc(1, image_size))) goto end;
+
+    if (!pfsWriteImageContextHeaderToMemoryBuffer(&pfs_img_ctx, image, image_size, &header_size)) goto end;
+
+    *out_size = (header_size + pfs_img_ctx.fs_size);
+
+    success = true;
+
+end:
+    if (!success)
+    {
+        fprintf(stderr, "Failed to generate synthetic Partition FS image!\n");
+
+        if (image)
+        {
+            free(image);
+            image = NULL;
+        }
+    }
+
+    pfsFreeImageContext(&pfs_img_ctx);
+
+    return image;
+}
+
+static u8 *benchGenerateSyntheticRomFs(u64 *out_size)
+{
+    /* Directory and file names have a fixed length, which makes it possible to calculate all entry offsets beforehand. */
+    const u32 dir_name_len = 6, file_name_len = 13;
+    const u32 dir_entry_size = (u32)(sizeof(RomFileSystemDirectoryEntry) + ALIGN_UP(dir_name_len, ROMFS_TABLE_ENTRY_ALIGNMENT));
+    const u32 file_entry_size = (u32)(sizeof(RomFileSystemFileEntry) + ALIGN_UP(file_name_len, ROMFS_TABLE_ENTRY_ALIGNMENT));
+
+    const u32 subdir_total = (BENCH_SYNTHETIC_ROMFS_DIR_COUNT * BENCH_SYNTHETIC_ROMFS_SUBDIR_COUNT);
+    const u32 dir_total = (1 + BENCH_SYNTHETIC_ROMFS_DIR_COUNT + subdir_total), file_total = (subdir_total * BENCH_SYNTHETIC_ROMFS_FILE_COUNT);
+
+    const u32 root_entry_size = (u32)sizeof(RomFileSystemDirectoryEntry);
+    const u32 subdir_base_offset = (root_entry_size + (BENCH_SYNTHETIC_ROMFS_DIR_COUNT * dir_entry_size));
+
+    RomFileSystemInformation info = {0};
+    char name[0x10] = {0};
+    u8 *image = NULL;
+
+    info.header_size = ROMFS_HEADER_SIZE;
+    info.directory_bucket_offset = ROMFS_HEADER_SIZE;
+    info.directory_bucket_size = (dir_total * sizeof(u32));
+    info.directory_entry_offset = (info.directory_bucket_offset + info.directory_bucket_size);
+    info.directory_entry_size = (subdir_base_offset + (subdir_total * dir_entry_size));
+    info.file_bucket_offset = (info.directory_entry_offset + info.directory_entry_size);
+    info.file_bucket_size = (file_total * sizeof(u32));
+    info.file_entry_offset = (info.file_bucket_offset + info.file_bucket_size);
+    info.file_entry_size = (file_total * file_entry_size);
+    info.body_offset = ALIGN_UP(info.file_entry_offset + info.file_entry_size, 0x200);
+
+    *out_size = (info.body_offset + ((u64)file_total * BENCH_SYNTHETIC_ROMFS_FILE_SIZE));
+
+    if (!(image = calloc(1, *out_size)))
+    {
+        fprintf(stderr, "Failed to generate synthetic RomFS image!\n");
+        return NULL;
+    }
+
+    memcpy(image, &info, sizeof(RomFileSystemInformation));
+
+    u32 *dir_bucket = (u32*)(image + info.directory_bucket_offset), *file_bucket = (u32*)(image + info.file_bucket_offset);
+    u8 *dir_table = (image + info.directory_entry_offset), *file_table = (image + info.file_entry_offset);
+
+    memset(dir_bucket, 0xFF, info.directory_bucket_size);
+    memset(file_bucket, 0xFF, info.file_bucket_size);
+
+    /* Root directory. */
+    RomFileSystemDirectoryEntry *root_dir_entry = (RomFileSystemDirectoryEntry*)dir_table;
+    root_dir_entry->bucket_offset = benchAddSyntheticRomFsEntry(dir_bucket, dir_total, 0, 0, "", 0, root_dir_entry->name, &(root_dir_entry->name_length));
+    root_dir_entry->next_offset = ROMFS_VOID_ENTRY;
+    root_dir_entry->directory_offset = root_entry_size;
+    root_dir_entry->file_offset = ROMFS_VOID_ENTRY;
+
+    for(u32 i = 0; i < BENCH_SYNTHETIC_ROMFS_DIR_COUNT; i++)
+    {
+        u32 dir_offset = (root_entry_size + (i * dir_entry_size));
+
+        RomFileSystemDirectoryEntry *dir_entry = (RomFileSystemDirectoryEntry*)(dir_table + dir_offset);
+        snprintf(name, sizeof(name), "dir_%02u", i);
+        dir_entry->parent_offset = 0;
+        dir_entry->bucket_offset = benchAddSyntheticRomFsEntry(dir_bucket, dir_total, dir_offset, 0, name, dir_name_len, dir_entry->name, &(dir_entry->name_length));
+        dir_entry->next_offset = ((i + 1) < BENCH_SYNTHETIC_ROMFS_DIR_COUNT ? (dir_offset + dir_entry_size) : ROMFS_VOID_ENTRY);
+        dir_entry->directory_offset = (subdir_base_offset + (i * BENCH_SYNTHETIC_ROMFS_SUBDIR_COUNT * dir_entry_size));
+        dir_entry->file_offset = ROMFS_VOID_ENTRY;
+
+        for(u32 j = 0; j < BENCH_SYNTHETIC_ROMFS_SUBDIR_COUNT; j++)
+        {
+            u32 subdir_idx = ((i * BENCH_SYNTHETIC_ROMFS_SUBDIR_COUNT) + j), subdir_offset = (subdir_base_offset + (subdir_idx * dir_entry_size));
+
+            RomFileSystemDirectoryEntry *subdir_entry = (RomFileSystemDirectoryEntry*)(dir_table + subdir_offset);
+            snprintf(name, sizeof(name), "sub_%02u", j);
+            subdir_entry->parent_offset = dir_offset;
+            subdir_entry->bucket_offset = benchAddSyntheticRomFsEntry(dir_bucket, dir_total, subdir_offset, dir_offset, name, dir_name_len, subdir_entry->name, &(subdir_entry->name_length));
+            subdir_entry->next_offset = ((j + 1) < BENCH_SYNTHETIC_ROMFS_SUBDIR_COUNT ? (subdir_offset + dir_entry_size) : ROMFS_VOID_ENTRY);
+            subdir_entry->directory_offset = ROMFS_VOID_ENTRY;
+            subdir_entry->file_offset = (subdir_idx * BENCH_SYNTHETIC_ROMFS_FILE_COUNT * file_entry_size);
+
+            for(u32 k = 0; k < BENCH_SYNTHETIC_ROMFS_FILE_COUNT; k++)
+            {
+                u32 file_idx = ((subdir_idx * BENCH_SYNTHETIC_ROMFS_FILE_COUNT) + k), file_offset = (file_idx * file_entry_size);
+
+                RomFileSystemFileEntry *file_entry = (RomFileSystemFileEntry*)(file_table + file_offset);
+                snprintf(name, sizeof(name), "file_%04u.bin", file_idx);
+                file_entry->parent_offset = subdir_offset;
+                file_entry->bucket_offset = benchAddSyntheticRomFsEntry(file_bucket, file_total, file_offset, subdir_offset, name, file_name_len, file_entry->name, &(file_entry->name_length));
+
+                /* Lay out file data in reverse order, which gives the read plan some actual sorting to do. */
+                file_entry->next_offset = ((k + 1) < BENCH_SYNTHETIC_ROMFS_FILE_COUNT ? (file_offset + file_entry_size) : ROMFS_VOID_ENTRY);
+                file_entry->offset = ((u64)(file_total - file_idx - 1) * BENCH_SYNTHETIC_ROMFS_FILE_SIZE);
+                file_entry->size = BENCH_SYNTHETIC_ROMFS_FILE_SIZE;
+            }
+        }
+    }
+
+    return image;
+}
+
+static u32 benchAddSyntheticRomFsEntry(u32 *bucket, u32 bucket_count, u32 entry_offset, u32 parent_offset, const char *name, u32 name_len, char *out_name, u32 *out_name_len)
+{
+    u32 hash = (parent_offset ^ BENCH_ROMFS_ENTRY_HASH_SEED), prev_offset = 0;
+
+    for(u32 i = 0; i < name_len; i++) hash = (((hash >> 5) | (hash << 27)) ^ name[i]);
+    hash %= bucket_count;
+
+    /* Chain the new entry into its bucket. */
+    prev_offset = bucket[hash];
+    bucket[hash] = entry_offset;
+
+    memcpy(out_name, name, name_len);
+    *out_name_len = name_len;
+
+    return prev_offset;
+}
+
+static u8 *benchGenerateSyntheticGameCardImage(u64 *out_size)
+{
+    static const char *root_names[] = { "update", "normal", "secure" };
+    static const u32 child_entry_counts[] = { BENCH_SYNTHETIC_XCI_ENTRY_COUNT / 4, 1, BENCH_SYNTHETIC_XCI_ENTRY_COUNT };
+
+    const u32 root_entry_count = MAX_ELEMENTS(root_names);
+
+    char (*child_names)[0x30] = NULL;
+    const char **child_name_ptrs = NULL;
+    u64 *child_sizes = NULL, root_sizes[MAX_ELEMENTS(root_names)] = {0};
+
+    u64 image_size = 0, child_size = 0, child_offset = 0, root_header_size = 0;
+    u8 *image = NULL, *child_data = NULL;
+
+    bool success = false;
+
+    /* Every child partition holds NCA-like entries, so their names are 32 hex characters long followed by the extension. Data is left zeroed. */
+    if (!(child_names = calloc(BENCH_SYNTHETIC_XCI_ENTRY_COUNT, sizeof(*child_names))) || !(child_name_ptrs = calloc(BENCH_SYNTHETIC_XCI_ENTRY_COUNT, sizeof(char*))) || \
+        !(child_sizes = calloc(BENCH_SYNTHETIC_XCI_ENTRY_COUNT, sizeof(u64)))) goto end;
+
+    for(u32 i = 0; i < BENCH_SYNTHETIC_XCI_ENTRY_COUNT; i++)
+    {
+        snprintf(child_names[i], sizeof(child_names[i]), "%08x%08x%08x%08x.nca", i * 0x9E3779B1, i, ~i, i * 0x85EBCA6B);
+        child_name_ptrs[i] = child_names[i];
+        child_sizes[i] = (BENCH_SYNTHETIC_XCI_ENTRY_SIZE * ((i % 4) + 1));
+        child_size += (child_sizes[i] + sizeof(HashFileSystemEntry) + sizeof(child_names[i]));
+    }
+
+    /* Child partitions are written to a separate buffer first, since the root Hash FS header size isn't known until all of them are available. */
+    child_size = (root_entry_count * (ALIGN_UP(child_size, GAMECARD_PAGE_SIZE) + GAMECARD_PAGE_SIZE));
+    if (!(child_data = calloc(1, child_size))) goto end;
+
+    for(u32 i = 0; i < root_entry_count; i++)
+    {
+        root_sizes[i] = ALIGN_UP(benchWriteSyntheticHashFs(child_data + child_offset, child_entry_counts[i], child_name_ptrs, child_sizes, NULL), GAMECARD_PAGE_SIZE);
+        child_offset += root_sizes[i];
+    }
+
+    image_size = (BENCH_SYNTHETIC_XCI_HFS_OFFSET + ALIGN_UP(sizeof(HashFileSystemHeader) + (root_entry_count * (sizeof(HashFileSystemEntry) + 0x10)), GAMECARD_PAGE_SIZE) + child_offset);
+    if (!(image = calloc(1, image_size))) goto end;
+
+    /* Write the root Hash FS header, followed by the child partitions. */
+    benchWriteSyntheticHashFs(image + BENCH_SYNTHETIC_XCI_HFS_OFFSET, root_entry_count, root_names, root_sizes, &root_header_size);
+    memcpy(image + BENCH_SYNTHETIC_XCI_HFS_OFFSET + root_header_size, child_data, child_offset);
+
+    /* Write the gamecard header. */
+    GameCardHeader *gc_header = (GameCardHeader*)image;
+    gc_header->magic = __builtin_bswap32(GAMECARD_HEAD_MAGIC);
+    gc_header->partition_fs_header_address = BENCH_SYNTHETIC_XCI_HFS_OFFSET;
+    gc_header->partition_fs_header_size = root_header_size;
+
+    *out_size = (BENCH_SYNTHETIC_XCI_HFS_OFFSET + root_header_size + child_offset);
+
+    success = true;
+
+end:
+    if (!success)
+    {
+        fprintf(stderr, "Failed to generate synthetic gamecard image!\n");
+
+        if (image)
+        {
+            free(image);
+            image = NULL;
+        }
+    }
+
+    if (child_data) free(child_data);
+
+    if (child_sizes) free(child_sizes);
+
+    if (child_name_ptrs) free(child_name_ptrs);
+
+    if (child_names) free(child_names);
+
+    return image;
+}
+
+static u64 benchWriteSyntheticHashFs(u8 *out, u32 entry_count, const char * const *names, const u64 *sizes, u64 *out_header_size)
+{
+    HashFileSystemHeader *hfs_header = (HashFileSystemHeader*)out;
+    HashFileSystemEntry *hfs_entries = (HashFileSystemEntry*)(out + sizeof(HashFileSystemHeader));
+    char *name_table = (char*)(hfs_entries + entry_count);
+    u64 data_offset = 0;
+    u32 name_offset = 0;
+
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        size_t name_len = strlen(names[i]);
+
+        hfs_entries[i].offset = data_offset;
+        hfs_entries[i].size = sizes[i];
+        hfs_entries[i].name_offset = name_offset;
+
+        memcpy(name_table + name_offset, names[i], name_len + 1);
+
+        data_offset += sizes[i];
+        name_offset += (u32)(name_len + 1);
+    }
+
+    /* Pad the name table to make the full header size a multiple of the gamecard page size, just like real gamecards do. */
+    u64 header_size = ALIGN_UP(sizeof(HashFileSystemHeader) + (entry_count * sizeof(HashFileSystemEntry)) + name_offset, GAMECARD_PAGE_SIZE);
+
+    hfs_header->magic = __builtin_bswap32(HFS0_MAGIC);
+    hfs_header->entry_count = entry_count;
+    hfs_header->name_table_size = (u32)(header_size - sizeof(HashFileSystemHeader) - (entry_count * sizeof(HashFileSystemEntry)));
+
+    if (out_header_size) *out_header_size = header_size;
+
+    return (header_size + data_offset);
+}
+
+static HashFileSystemContext *benchInitializeHashFileSystemContext(const char *name, u64 offset)
+{
+    HashFileSystemHeader hfs_header = {0};
+    HashFileSystemContext *hfs_ctx = NULL;
+    bool success = false;
+
+    /* Simplified version of the Hash FS context initialization performed by gamecard.c. Header hashes aren't verified. */
+    if (!(hfs_ctx = calloc(1, sizeof(HashFileSystemContext))) || \
+        !(hfs_ctx->name = strdup(name ? name : hfsGetPartitionNameString(HashFileSystemPartitionType_Root)))) goto end;
+
+    for(u8 i = HashFileSystemPartitionType_Root; i < HashFileSystemPartitionType_Count; i++)
+    {
+        const char *hfs_partition_name = hfsGetPartitionNameString(i);
+        if (!hfs_partition_name || strcmp(hfs_partition_name, hfs_ctx->name) != 0) continue;
+        hfs_ctx->type = i;
+        break;
+    }
+
+    if (!hfs_ctx->type || !gamecardReadStorage(&hfs_header, sizeof(HashFileSystemHeader), offset) || __builtin_bswap32(hfs_header.magic) != HFS0_MAGIC) goto end;
+
+    hfs_ctx->offset = offset;
+    hfs_ctx->header_size = (sizeof(HashFileSystemHeader) + (hfs_header.entry_count * sizeof(HashFileSystemEntry)) + hfs_header.name_table_size);
+
+    if (!(hfs_ctx->header = malloc(hfs_ctx->header_size)) || !gamecardReadStorage(hfs_ctx->header, hfs_ctx->header_size, offset)) goto end;
+
+    /* Calculate the partition size using the last entry. */
+    HashFileSystemEntry *hfs_entries = (HashFileSystemEntry*)(hfs_ctx->header + sizeof(HashFileSystemHeader));
+
+    for(u32 i = 0; i < hfs_header.entry_count; i++)
+    {
+        HashFileSystemEntry *hfs_entry = &(hfs_entries[i]);
+        hfs_ctx->size = MAX(hfs_ctx->size, hfs_ctx->header_size + hfs_entry->offset + hfs_entry->size);
+    }
+
+    success = true;
+
+end:
+    if (!success && hfs_ctx)
+    {
+        hfsFreeContext(hfs_ctx);
+        free(hfs_ctx);
+        hfs_ctx = NULL;
+    }
+
+    return hfs_ctx;
+}
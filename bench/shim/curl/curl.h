@@ -0,0 +1,16 @@
+/* Minimal libcurl shim used by host benchmark builds. Only provides the types referenced by core headers. */
+
+#pragma once
+
+#ifndef __NXDT_BENCH_CURL_H__
+#define __NXDT_BENCH_CURL_H__
+
+#include <stddef.h>
+
+typedef void CURL;
+typedef long long curl_off_t;
+
+typedef size_t (*curl_write_callback)(char *buffer, size_t size, size_t nitems, void *outstream);
+typedef int (*curl_xferinfo_callback)(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
+#endif /* __NXDT_BENCH_CURL_H__ */
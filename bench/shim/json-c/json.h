@@ -0,0 +1,29 @@
+/* Minimal json-c shim used by host benchmark builds. Only declares what's referenced by inline functions from core headers. Nothing is ever linked against it. */
+
+#pragma once
+
+#ifndef __NXDT_BENCH_JSON_H__
+#define __NXDT_BENCH_JSON_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct json_object;
+
+typedef enum json_type {
+    json_type_null,
+    json_type_boolean,
+    json_type_double,
+    json_type_int,
+    json_type_object,
+    json_type_array,
+    json_type_string
+} json_type;
+
+int json_object_is_type(const struct json_object *obj, enum json_type type);
+int32_t json_object_get_int(const struct json_object *obj);
+int json_object_get_string_len(const struct json_object *obj);
+int json_object_object_length(const struct json_object *obj);
+size_t json_object_array_length(const struct json_object *obj);
+
+#endif /* __NXDT_BENCH_JSON_H__ */
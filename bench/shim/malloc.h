@@ -0,0 +1,24 @@
+/* macOS doesn't provide <malloc.h>. memalign() is emulated using posix_memalign() in that case. */
+
+#pragma once
+
+#ifndef __NXDT_BENCH_MALLOC_H__
+#define __NXDT_BENCH_MALLOC_H__
+
+#ifdef __APPLE__
+
+#include <stdlib.h>
+
+static inline void *memalign(size_t alignment, size_t size)
+{
+    void *ptr = NULL;
+    return (posix_memalign(&ptr, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) == 0 ? ptr : NULL);
+}
+
+#else
+
+#include_next <malloc.h>
+
+#endif
+
+#endif /* __NXDT_BENCH_MALLOC_H__ */
@@ -0,0 +1,406 @@
+/*
+ * shim.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* libnx and application-level functions needed by the benchmarked core modules. */
+
+#include <core/nxdt_utils.h>
+
+#include <sched.h>
+
+#define SHIM_TICK_FREQ  19200000ULL /* Switch system counter frequency. */
+
+/* Type definitions. */
+
+typedef struct {
+    u32 state[8];
+    u8 block[0x40];
+    size_t block_size;
+    u64 total_size;
+} ShimSha256Context;
+
+static_assert(sizeof(ShimSha256Context) <= sizeof(Sha256Context), "ShimSha256Context doesn't fit within Sha256Context!");
+
+/* Global variables. */
+
+static const u32 g_shimSha256RoundConstants[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+/* Function prototypes. */
+
+static void shimSha256ProcessBlock(ShimSha256Context *ctx, const u8 *block);
+
+/* Synchronization primitives. */
+
+void mutexLock(Mutex *m)
+{
+    while(!mutexTryLock(m)) sched_yield();
+}
+
+bool mutexTryLock(Mutex *m)
+{
+    u32 expected = 0;
+    return __atomic_compare_exchange_n(m, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void mutexUnlock(Mutex *m)
+{
+    __atomic_store_n(m, 0, __ATOMIC_RELEASE);
+}
+
+bool mutexIsLockedByCurrentThread(const Mutex *m)
+{
+    /* Good enough for a single-threaded runner. */
+    return (__atomic_load_n(m, __ATOMIC_ACQUIRE) != 0);
+}
+
+Result condvarWaitTimeout(CondVar *c, Mutex *m, u64 timeout)
+{
+    NX_IGNORE_ARG(c);
+    NX_IGNORE_ARG(timeout);
+
+    /* Spurious wakeups are allowed, so just give other threads a chance to run. */
+    mutexUnlock(m);
+    sched_yield();
+    mutexLock(m);
+
+    return 0;
+}
+
+void condvarWakeOne(CondVar *c)
+{
+    NX_IGNORE_ARG(c);
+}
+
+void condvarWakeAll(CondVar *c)
+{
+    NX_IGNORE_ARG(c);
+}
+
+/* Threads. */
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem, size_t stack_sz, int prio, int cpuid)
+{
+    NX_IGNORE_ARG(t);
+    NX_IGNORE_ARG(entry);
+    NX_IGNORE_ARG(arg);
+    NX_IGNORE_ARG(stack_mem);
+    NX_IGNORE_ARG(stack_sz);
+    NX_IGNORE_ARG(prio);
+    NX_IGNORE_ARG(cpuid);
+    return SHIM_RESULT_NOT_SUPPORTED;
+}
+
+Result threadStart(Thread *t)
+{
+    NX_IGNORE_ARG(t);
+    return SHIM_RESULT_NOT_SUPPORTED;
+}
+
+Result threadWaitForExit(Thread *t)
+{
+    NX_IGNORE_ARG(t);
+    return SHIM_RESULT_NOT_SUPPORTED;
+}
+
+Result threadClose(Thread *t)
+{
+    NX_IGNORE_ARG(t);
+    return 0;
+}
+
+void svcSleepThread(s64 nano)
+{
+    if (nano <= 0)
+    {
+        sched_yield();
+        return;
+    }
+
+    struct timespec ts = { .tv_sec = (time_t)(nano / 1000000000), .tv_nsec = (long)(nano % 1000000000) };
+    nanosleep(&ts, NULL);
+}
+
+u32 svcGetCurrentProcessorNumber(void)
+{
+    return 0;
+}
+
+void threadExit(void)
+{
+    /* Never reached: threads can't be created. */
+    abort();
+}
+
+bool utilsCreateThread(Thread *out_thread, ThreadFunc func, void *arg, int cpu_id)
+{
+    NX_IGNORE_ARG(out_thread);
+    NX_IGNORE_ARG(func);
+    NX_IGNORE_ARG(arg);
+    NX_IGNORE_ARG(cpu_id);
+    return false;
+}
+
+void utilsJoinThread(Thread *thread)
+{
+    NX_IGNORE_ARG(thread);
+}
+
+/* System tick. */
+
+u64 armGetSystemTick(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return armNsToTicks(((u64)ts.tv_sec * 1000000000ULL) + (u64)ts.tv_nsec);
+}
+
+u64 armGetSystemTickFreq(void)
+{
+    return SHIM_TICK_FREQ;
+}
+
+u64 armTicksToNs(u64 tick)
+{
+    return (u64)(((__uint128_t)tick * 1000000000ULL) / SHIM_TICK_FREQ);
+}
+
+u64 armNsToTicks(u64 ns)
+{
+    return (u64)(((__uint128_t)ns * SHIM_TICK_FREQ) / 1000000000ULL);
+}
+
+/* Crypto. */
+
+void sha256ContextCreate(Sha256Context *out)
+{
+    ShimSha256Context *ctx = (ShimSha256Context*)out;
+    static const u32 initial_state[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+
+    memset(ctx, 0, sizeof(ShimSha256Context));
+    memcpy(ctx->state, initial_state, sizeof(initial_state));
+}
+
+void sha256ContextUpdate(Sha256Context *ctx, const void *src, size_t size)
+{
+    ShimSha256Context *shim_ctx = (ShimSha256Context*)ctx;
+    const u8 *src_u8 = (const u8*)src;
+
+    shim_ctx->total_size += size;
+
+    /* Fill the pending block first. */
+    if (shim_ctx->block_size)
+    {
+        size_t copy_size = MIN(size, sizeof(shim_ctx->block) - shim_ctx->block_size);
+        memcpy(shim_ctx->block + shim_ctx->block_size, src_u8, copy_size);
+        shim_ctx->block_size += copy_size;
+        src_u8 += copy_size;
+        size -= copy_size;
+
+        if (shim_ctx->block_size < sizeof(shim_ctx->block)) return;
+
+        shimSha256ProcessBlock(shim_ctx, shim_ctx->block);
+        shim_ctx->block_size = 0;
+    }
+
+    for(; size >= sizeof(shim_ctx->block); src_u8 += sizeof(shim_ctx->block), size -= sizeof(shim_ctx->block)) shimSha256ProcessBlock(shim_ctx, src_u8);
+
+    memcpy(shim_ctx->block, src_u8, size);
+    shim_ctx->block_size = size;
+}
+
+void sha256ContextGetHash(Sha256Context *ctx, void *dst)
+{
+    ShimSha256Context *shim_ctx = (ShimSha256Context*)ctx;
+    size_t size = shim_ctx->block_size;
+    u8 *dst_u8 = (u8*)dst;
+
+    /* Pad the last block. */
+    shim_ctx->block[size++] = 0x80;
+
+    if (size > (sizeof(shim_ctx->block) - sizeof(u64)))
+    {
+        memset(shim_ctx->block + size, 0, sizeof(shim_ctx->block) - size);
+        shimSha256ProcessBlock(shim_ctx, shim_ctx->block);
+        size = 0;
+    }
+
+    memset(shim_ctx->block + size, 0, sizeof(shim_ctx->block) - size);
+
+    u64 bit_size = __builtin_bswap64(shim_ctx->total_size * 8);
+    memcpy(shim_ctx->block + sizeof(shim_ctx->block) - sizeof(u64), &bit_size, sizeof(u64));
+    shimSha256ProcessBlock(shim_ctx, shim_ctx->block);
+
+    for(u32 i = 0; i < 8; i++)
+    {
+        u32 word = __builtin_bswap32(shim_ctx->state[i]);
+        memcpy(dst_u8 + (i * sizeof(u32)), &word, sizeof(u32));
+    }
+}
+
+void sha256CalculateHash(void *dst, const void *src, size_t size)
+{
+    Sha256Context ctx = {0};
+    sha256ContextCreate(&ctx);
+    sha256ContextUpdate(&ctx, src, size);
+    sha256ContextGetHash(&ctx, dst);
+}
+
+void hmacSha256CalculateMac(void *dst, const void *key, size_t key_size, const void *src, size_t size)
+{
+    /* Only used to validate savefile MACs, which are never checked by the benchmark runner. */
+    NX_IGNORE_ARG(key);
+    NX_IGNORE_ARG(key_size);
+    NX_IGNORE_ARG(src);
+    NX_IGNORE_ARG(size);
+    memset(dst, 0, SHA256_HASH_SIZE);
+}
+
+void cmacAes128CalculateMac(void *dst, const void *key, const void *src, size_t size)
+{
+    /* Same as above. */
+    NX_IGNORE_ARG(key);
+    NX_IGNORE_ARG(src);
+    NX_IGNORE_ARG(size);
+    memset(dst, 0, AES_BLOCK_SIZE);
+}
+
+void aes128CtrContextCreate(Aes128CtrContext *out, const void *key, const void *ctr)
+{
+    NX_IGNORE_ARG(key);
+    NX_IGNORE_ARG(ctr);
+    memset(out, 0, sizeof(Aes128CtrContext));
+}
+
+void aes128CtrContextResetCtr(Aes128CtrContext *ctx, const void *ctr)
+{
+    NX_IGNORE_ARG(ctx);
+    NX_IGNORE_ARG(ctr);
+}
+
+void aes128CtrCrypt(Aes128CtrContext *ctx, void *dst, const void *src, size_t size)
+{
+    /* Benchmark images are always decrypted beforehand, so this is a plain copy. */
+    NX_IGNORE_ARG(ctx);
+    if (dst != src) memmove(dst, src, size);
+}
+
+/* Application-level functions. */
+
+u64 utilsGetBudgetedBufferSize(u64 size, u64 min_size)
+{
+    NX_IGNORE_ARG(min_size);
+    return size;
+}
+
+u32 utilsGetBudgetedBufferCount(u32 count, u32 min_count)
+{
+    NX_IGNORE_ARG(min_count);
+    return count;
+}
+
+void utilsReplaceIllegalCharacters(char *str, bool ascii_only)
+{
+    if (!str) return;
+
+    for(char *ptr = str; *ptr; ptr++)
+    {
+        if (strchr("\\/:*?\"<>|", *ptr) || (u8)*ptr < 0x20 || (ascii_only && (u8)*ptr >= 0x7F)) *ptr = '_';
+    }
+}
+
+#if LOG_LEVEL < LOG_LEVEL_NONE
+
+__attribute__((format(printf, 5, 6))) void logWriteFormattedStringToLogFile(u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...)
+{
+    NX_IGNORE_ARG(file_name);
+    NX_IGNORE_ARG(line);
+
+    va_list args;
+    va_start(args, fmt);
+
+    fprintf(stderr, "[%u] %s: ", level, func_name);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+
+    va_end(args);
+}
+
+__attribute__((format(printf, 7, 8))) void logWriteBinaryDataToLogFile(const void *data, size_t data_size, u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...)
+{
+    NX_IGNORE_ARG(data);
+    NX_IGNORE_ARG(file_name);
+    NX_IGNORE_ARG(line);
+
+    va_list args;
+    va_start(args, fmt);
+
+    fprintf(stderr, "[%u] %s: ", level, func_name);
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, " (0x%zX bytes)\n", data_size);
+
+    va_end(args);
+}
+
+#endif  /* LOG_LEVEL < LOG_LEVEL_NONE */
+
+static void shimSha256ProcessBlock(ShimSha256Context *ctx, const u8 *block)
+{
+    #define ROR(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+
+    u32 w[64] = {0}, s[8] = {0};
+
+    for(u32 i = 0; i < 16; i++)
+    {
+        memcpy(&(w[i]), block + (i * sizeof(u32)), sizeof(u32));
+        w[i] = __builtin_bswap32(w[i]);
+    }
+
+    for(u32 i = 16; i < 64; i++)
+    {
+        u32 s0 = (ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3));
+        u32 s1 = (ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10));
+        w[i] = (w[i - 16] + s0 + w[i - 7] + s1);
+    }
+
+    memcpy(s, ctx->state, sizeof(s));
+
+    for(u32 i = 0; i < 64; i++)
+    {
+        u32 t1 = (s[7] + (ROR(s[4], 6) ^ ROR(s[4], 11) ^ ROR(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + g_shimSha256RoundConstants[i] + w[i]);
+        u32 t2 = ((ROR(s[0], 2) ^ ROR(s[0], 13) ^ ROR(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2])));
+
+        memmove(s + 1, s, 7 * sizeof(u32));
+        s[4] += t1;
+        s[0] = (t1 + t2);
+    }
+
+    for(u32 i = 0; i < 8; i++) ctx->state[i] += s[i];
+
+    #undef ROR
+}
@@ -0,0 +1,284 @@
+/*
+ * storage_shim.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "storage_shim.h"
+#include <core/nca_storage.h>
+
+#define SHIM_NCA_FS_SECTION_IMAGE_COUNT 4
+
+/* Type definitions. */
+
+typedef struct {
+    NcaFsSectionContext *nca_fs_ctx;
+    const u8 *data;
+    u64 size;
+} ShimNcaFsSectionImage;
+
+/* Global variables. */
+
+static ShimNcaFsSectionImage g_shimNcaFsSectionImages[SHIM_NCA_FS_SECTION_IMAGE_COUNT] = {0};
+
+static const u8 *g_shimGameCardImage = NULL;
+static u64 g_shimGameCardImageSize = 0;
+
+/* Function prototypes. */
+
+static ShimNcaFsSectionImage *shimGetNcaFsSectionImage(NcaFsSectionContext *nca_fs_ctx);
+
+bool shimRegisterNcaFsSectionImage(NcaContext *nca_ctx, NcaFsSectionContext *nca_fs_ctx, u8 section_type, const void *image, u64 image_size)
+{
+    if (!nca_ctx || !nca_fs_ctx || (section_type != NcaFsSectionType_PartitionFs && section_type != NcaFsSectionType_RomFs && section_type != NcaFsSectionType_PatchRomFs) || \
+        !image || !image_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    ShimNcaFsSectionImage *entry = shimGetNcaFsSectionImage(NULL);
+    if (!entry)
+    {
+        LOG_MSG_ERROR("NCA FS section image table is full!");
+        return false;
+    }
+
+    memset(nca_fs_ctx, 0, sizeof(NcaFsSectionContext));
+
+    if (!nca_ctx->format_version) nca_ctx->format_version = NcaVersion_Nca3;
+
+    nca_fs_ctx->enabled = true;
+    nca_fs_ctx->nca_ctx = nca_ctx;
+    nca_fs_ctx->section_size = image_size;
+    nca_fs_ctx->section_type = section_type;
+    nca_fs_ctx->hash_type = (section_type == NcaFsSectionType_PartitionFs ? NcaHashType_HierarchicalSha256 : NcaHashType_HierarchicalIntegrity);
+    nca_fs_ctx->encryption_type = NcaEncryptionType_None;
+
+    entry->nca_fs_ctx = nca_fs_ctx;
+    entry->data = (const u8*)image;
+    entry->size = image_size;
+
+    return true;
+}
+
+void shimUnregisterNcaFsSectionImage(NcaFsSectionContext *nca_fs_ctx)
+{
+    ShimNcaFsSectionImage *entry = (nca_fs_ctx ? shimGetNcaFsSectionImage(nca_fs_ctx) : NULL);
+    if (entry) memset(entry, 0, sizeof(ShimNcaFsSectionImage));
+}
+
+void shimSetGameCardImage(const void *image, u64 image_size)
+{
+    g_shimGameCardImage = (image ? (const u8*)image : NULL);
+    g_shimGameCardImageSize = (image ? image_size : 0);
+}
+
+/* NCA storage functions. Only the regular base storage type is supported. */
+
+bool ncaStorageInitializeContext(NcaStorageContext *out, NcaFsSectionContext *nca_fs_ctx, NcaStorageContext *base_ctx)
+{
+    if (!out || !nca_fs_ctx || base_ctx || !shimGetNcaFsSectionImage(nca_fs_ctx))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    memset(out, 0, sizeof(NcaStorageContext));
+    out->base_storage_type = NcaStorageBaseStorageType_Regular;
+    out->nca_fs_ctx = nca_fs_ctx;
+
+    return true;
+}
+
+bool ncaStorageGetHashTargetExtents(NcaStorageContext *ctx, u64 *out_offset, u64 *out_size)
+{
+    ShimNcaFsSectionImage *entry = (ncaStorageIsValidContext(ctx) ? shimGetNcaFsSectionImage(ctx->nca_fs_ctx) : NULL);
+    if (!entry || (!out_offset && !out_size)) return false;
+
+    if (out_offset) *out_offset = 0;
+    if (out_size) *out_size = entry->size;
+
+    return true;
+}
+
+bool ncaStorageRead(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    ShimNcaFsSectionImage *entry = (ncaStorageIsValidContext(ctx) ? shimGetNcaFsSectionImage(ctx->nca_fs_ctx) : NULL);
+    if (!entry || !out || !read_size || offset >= entry->size || read_size > (entry->size - offset))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    memcpy(out, entry->data + offset, read_size);
+
+    return true;
+}
+
+bool ncaStorageQueryExtents(NcaStorageContext *ctx, StorageExtentList *out, u64 size, u64 offset)
+{
+    /* Shim images are flat, so the whole range maps to a single extent. */
+    if (!ncaStorageIsValidContext(ctx) || !out || !size) return false;
+
+    StorageExtent extent = {
+        .offset = offset,
+        .size = size,
+        .type = StorageExtentType_Data,
+        .source = StorageExtentSource_NcaFsSection,
+        .source_ctx = ctx->nca_fs_ctx,
+        .physical_offset = offset,
+        .physical_size = size
+    };
+
+    return storageExtentListAppend(out, &extent);
+}
+
+bool ncaStorageGetPhysicalOffset(NcaStorageContext *ctx, u64 offset, u64 *out_offset)
+{
+    if (!ncaStorageIsValidContext(ctx) || !out_offset) return false;
+    *out_offset = offset;
+    return true;
+}
+
+bool ncaStorageBuildPatchCoverageMap(NcaStorageContext *ctx)
+{
+    NX_IGNORE_ARG(ctx);
+    return false;
+}
+
+bool ncaStorageIsBlockWithinPatchStorageRange(NcaStorageContext *ctx, u64 offset, u64 size, bool *out)
+{
+    NX_IGNORE_ARG(ctx);
+    NX_IGNORE_ARG(offset);
+    NX_IGNORE_ARG(size);
+    if (out) *out = false;
+    return false;
+}
+
+bool ncaStorageBuildZeroRangeMap(NcaStorageContext *ctx)
+{
+    /* Shim images are flat, so they never hold zero-filled ranges. */
+    if (!ncaStorageIsValidContext(ctx)) return false;
+    ctx->zero_ranges_available = true;
+    return true;
+}
+
+bool ncaStorageIsBlockZeroFilled(NcaStorageContext *ctx, u64 offset, u64 size, bool *out)
+{
+    NX_IGNORE_ARG(offset);
+    NX_IGNORE_ARG(size);
+    if (!ncaStorageIsValidContext(ctx) || !out) return false;
+    *out = false;
+    return true;
+}
+
+void ncaStorageFreeContext(NcaStorageContext *ctx)
+{
+    if (ctx) memset(ctx, 0, sizeof(NcaStorageContext));
+}
+
+/* NCA functions. Patch generation is unsupported. */
+
+bool ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    ShimNcaFsSectionImage *entry = (ctx ? shimGetNcaFsSectionImage(ctx) : NULL);
+    if (!entry || !out || !read_size || offset >= entry->size || read_size > (entry->size - offset)) return false;
+
+    memcpy(out, entry->data + offset, read_size);
+
+    return true;
+}
+
+bool ncaReadContentFile(NcaContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    /* The first section image registered with the provided NCA context doubles as the whole content file. */
+    ShimNcaFsSectionImage *entry = NULL;
+
+    for(u32 i = 0; ctx && i < SHIM_NCA_FS_SECTION_IMAGE_COUNT; i++)
+    {
+        if (!g_shimNcaFsSectionImages[i].nca_fs_ctx || g_shimNcaFsSectionImages[i].nca_fs_ctx->nca_ctx != ctx) continue;
+        entry = &(g_shimNcaFsSectionImages[i]);
+        break;
+    }
+
+    if (!entry || !out || !read_size || offset >= entry->size || read_size > (entry->size - offset)) return false;
+
+    memcpy(out, entry->data + offset, read_size);
+
+    return true;
+}
+
+bool ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt)
+{
+    NX_IGNORE_ARG(ctr_val);
+    NX_IGNORE_ARG(decrypt);
+    return ncaReadFsSection(ctx, out, read_size, offset);
+}
+
+bool ncaReadAesCtrExStorageRanges(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, const NcaAesCtrExRange *ranges, u32 range_count)
+{
+    NX_IGNORE_ARG(ranges);
+    NX_IGNORE_ARG(range_count);
+    return ncaReadFsSection(ctx, out, read_size, offset);
+}
+
+bool ncaGenerateHierarchicalSha256Patch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalSha256Patch *out)
+{
+    NX_IGNORE_ARG(ctx);
+    NX_IGNORE_ARG(data);
+    NX_IGNORE_ARG(data_size);
+    NX_IGNORE_ARG(data_offset);
+    NX_IGNORE_ARG(out);
+    return false;
+}
+
+bool ncaGenerateHierarchicalIntegrityPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalIntegrityPatch *out)
+{
+    NX_IGNORE_ARG(ctx);
+    NX_IGNORE_ARG(data);
+    NX_IGNORE_ARG(data_size);
+    NX_IGNORE_ARG(data_offset);
+    NX_IGNORE_ARG(out);
+    return false;
+}
+
+/* Gamecard functions. */
+
+bool gamecardReadStorage(void *out, u64 read_size, u64 offset)
+{
+    if (!g_shimGameCardImage || !out || !read_size || offset >= g_shimGameCardImageSize || read_size > (g_shimGameCardImageSize - offset))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    memcpy(out, g_shimGameCardImage + offset, read_size);
+
+    return true;
+}
+
+static ShimNcaFsSectionImage *shimGetNcaFsSectionImage(NcaFsSectionContext *nca_fs_ctx)
+{
+    for(u32 i = 0; i < SHIM_NCA_FS_SECTION_IMAGE_COUNT; i++)
+    {
+        if (g_shimNcaFsSectionImages[i].nca_fs_ctx == nca_fs_ctx) return &(g_shimNcaFsSectionImages[i]);
+    }
+
+    return NULL;
+}
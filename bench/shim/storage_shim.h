@@ -0,0 +1,53 @@
+/*
+ * storage_shim.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* In-memory NCA FS section and gamecard storage used by host benchmark builds. */
+/* NCA FS section images must be fully decrypted beforehand (e.g. extracted with hactool), since no crypto takes place here. */
+
+#pragma once
+
+#ifndef __NXDT_BENCH_STORAGE_SHIM_H__
+#define __NXDT_BENCH_STORAGE_SHIM_H__
+
+#include <core/nxdt_utils.h>
+#include <core/nca.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Sets up a fake NCA FS section context backed by the provided decrypted section image, which must remain valid until shimUnregisterNcaFsSectionImage() is called.
+/// 'section_type' must be NcaFsSectionType_PartitionFs, NcaFsSectionType_RomFs or NcaFsSectionType_PatchRomFs. The right hash type is set accordingly.
+/// The whole image is treated as the hash target layer, so it must start with the actual Partition FS / RomFS header.
+/// AesCtrEx storage reads are plain section reads. The first image registered with a given NCA context is also used for raw content file reads (e.g. Sparse tables).
+bool shimRegisterNcaFsSectionImage(NcaContext *nca_ctx, NcaFsSectionContext *nca_fs_ctx, u8 section_type, const void *image, u64 image_size);
+
+/// Unregisters an NCA FS section image registered with shimRegisterNcaFsSectionImage().
+void shimUnregisterNcaFsSectionImage(NcaFsSectionContext *nca_fs_ctx);
+
+/// Sets the XCI image used by gamecardReadStorage(). The image must not include the key area. Pass NULL to clear it.
+void shimSetGameCardImage(const void *image, u64 image_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NXDT_BENCH_STORAGE_SHIM_H__ */
@@ -0,0 +1,170 @@
+/*
+ * switch.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Thin libnx shim used by host benchmark builds. Only provides the types, macros and functions needed by the core modules listed in bench/Makefile. */
+/* Nothing here talks to real hardware: services, threads and hardware crypto are either emulated in software or stubbed out (see shim.c). */
+
+#pragma once
+
+#ifndef __NXDT_BENCH_SWITCH_H__
+#define __NXDT_BENCH_SWITCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Types. */
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef u32 Result;
+typedef u32 Handle;
+
+/* Macros. */
+
+#define NX_INLINE                   static inline
+#define NX_CONSTEXPR                static inline
+#define NX_PACKED                   __attribute__((packed))
+#define NX_IGNORE_ARG(x)            (void)(x)
+
+#define BIT(n)                      (1U << (n))
+#define BITL(n)                     (1UL << (n))
+
+#define INVALID_HANDLE              ((Handle)0)
+#define CUR_THREAD_HANDLE           ((Handle)0xFFFF8000)
+#define CUR_PROCESS_HANDLE          ((Handle)0xFFFF8001)
+
+#define R_SUCCEEDED(res)            ((res) == 0)
+#define R_FAILED(res)               ((res) != 0)
+
+#define MAKERESULT(module, descr)   ((((module) & 0x1FF)) | ((descr) & 0x1FFF) << 9)
+#define SHIM_RESULT_NOT_SUPPORTED   MAKERESULT(345, 1)  /* LibnxError_NotImplemented-like value. */
+
+#define FS_MAX_PATH                 0x301
+
+#define SHA1_HASH_SIZE              0x14
+#define SHA256_HASH_SIZE            0x20
+#define AES_BLOCK_SIZE              0x10
+#define AES_128_KEY_SIZE            0x10
+
+/* Synchronization primitives. Emulated using atomic spinlocks, since the benchmark runner is single-threaded. */
+
+typedef u32 Mutex;
+typedef u32 CondVar;
+typedef struct { Mutex mutex; u32 readers; } RwLock;
+
+void mutexLock(Mutex *m);
+bool mutexTryLock(Mutex *m);
+void mutexUnlock(Mutex *m);
+bool mutexIsLockedByCurrentThread(const Mutex *m);
+
+Result condvarWaitTimeout(CondVar *c, Mutex *m, u64 timeout);
+void condvarWakeOne(CondVar *c);
+void condvarWakeAll(CondVar *c);
+
+NX_INLINE void condvarInit(CondVar *c)
+{
+    *c = 0;
+}
+
+NX_INLINE Result condvarWait(CondVar *c, Mutex *m)
+{
+    return condvarWaitTimeout(c, m, UINT64_MAX);
+}
+
+/* Threads. Thread creation always fails, which makes callers fall back to synchronous code paths. */
+
+typedef struct { Handle handle; } Thread;
+typedef void (*ThreadFunc)(void *arg);
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem, size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread *t);
+Result threadWaitForExit(Thread *t);
+Result threadClose(Thread *t);
+
+void svcSleepThread(s64 nano);
+u32 svcGetCurrentProcessorNumber(void);
+void threadExit(void);
+
+/* System tick. Backed by a monotonic clock running at the same frequency as the Switch system counter (19.2 MHz). */
+
+u64 armGetSystemTick(void);
+u64 armGetSystemTickFreq(void);
+u64 armTicksToNs(u64 tick);
+u64 armNsToTicks(u64 ns);
+
+/* Opaque service objects referenced by core headers. */
+
+typedef struct { u32 opaque; } UEvent, NcmContentStorage, NcmContentMetaDatabase, FsFileSystem, FsStorage, FsFile, FsDir, FsEventNotifier, FsDeviceOperator;
+typedef struct { u32 value; } FsGameCardHandle;
+
+typedef struct { u8 c[0x10]; } FsRightsId;
+typedef struct { u8 c[0x10]; } NcmContentId;
+
+typedef struct {
+    u64 id;
+    u32 version;
+    u8 type;
+    u8 install_type;
+    u8 padding[2];
+} NcmContentMetaKey;
+
+typedef struct {
+    NcmContentId content_id;
+    u32 size_low;
+    u8 size_high;
+    u8 attr;
+    u8 content_type;
+    u8 id_offset;
+} NcmContentInfo;
+
+/* Crypto. SHA-256 is implemented in software. Every other primitive is stubbed out, since none of the benchmarked code paths need it. */
+
+typedef struct { u8 opaque[0x200]; } Sha1Context, Sha256Context, Aes128Context, Aes128CtrContext, Aes128XtsContext;
+
+void sha256ContextCreate(Sha256Context *out);
+void sha256ContextUpdate(Sha256Context *ctx, const void *src, size_t size);
+void sha256ContextGetHash(Sha256Context *ctx, void *dst);
+void sha256CalculateHash(void *dst, const void *src, size_t size);
+void hmacSha256CalculateMac(void *dst, const void *key, size_t key_size, const void *src, size_t size);
+void cmacAes128CalculateMac(void *dst, const void *key, const void *src, size_t size);
+
+void aes128CtrContextCreate(Aes128CtrContext *out, const void *key, const void *ctr);
+void aes128CtrContextResetCtr(Aes128CtrContext *ctx, const void *ctr);
+void aes128CtrCrypt(Aes128CtrContext *ctx, void *dst, const void *src, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NXDT_BENCH_SWITCH_H__ */
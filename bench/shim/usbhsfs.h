@@ -0,0 +1,26 @@
+/* Minimal libusbhsfs shim used by host benchmark builds. Only provides the types referenced by core headers. */
+
+#pragma once
+
+#ifndef __NXDT_BENCH_USBHSFS_H__
+#define __NXDT_BENCH_USBHSFS_H__
+
+#include <switch.h>
+
+typedef struct {
+    s32 usb_if_id;
+    u8 lun;
+    u32 fs_idx;
+    bool write_protect;
+    u16 vid;
+    u16 pid;
+    char manufacturer[64];
+    char product_name[64];
+    char serial_number[64];
+    u64 capacity;
+    char name[32];
+    u8 fs_type;
+    u32 flags;
+} UsbHsFsDevice;
+
+#endif /* __NXDT_BENCH_USBHSFS_H__ */
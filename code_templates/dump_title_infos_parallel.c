@@ -0,0 +1,217 @@
+#define TITLE_INFOS_THREAD_COUNT        3
+#define TITLE_INFOS_STREAM_BUFFER_SIZE  0x100000    /* 1 MiB. Output text is only flushed to the SD card once this buffer fills up. */
+#define TITLE_INFOS_TEXT_BLOCK_SIZE     0x400       /* Per-title text buffers grow in 1 KiB blocks. */
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} TitleInfosText;
+
+typedef struct {
+    Mutex mutex;
+    CondVar cond;
+    atomic_uint next_idx;               ///< Next title to be picked up by a worker thread.
+    TitleInfosText *texts;              ///< One entry per title. Filled by worker threads, streamed to the output file by the main thread in title order.
+    bool *ready;                        ///< Set once the text for a title is complete, even if it couldn't be fully generated.
+} TitleInfosThreadData;
+
+static void titleInfosAppend(TitleInfosText *text, const char *fmt, ...)
+{
+    va_list args;
+    int len = 0;
+
+    va_start(args, fmt);
+    len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (len <= 0) return;
+
+    /* Grow the text buffer, if needed. Titles whose text can't be fully generated are just truncated. */
+    if ((text->size + (size_t)len + 1) > text->capacity)
+    {
+        size_t capacity = ALIGN_UP(text->size + (size_t)len + 1, TITLE_INFOS_TEXT_BLOCK_SIZE);
+        char *tmp = realloc(text->data, capacity);
+        if (!tmp) return;
+
+        text->data = tmp;
+        text->capacity = capacity;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(text->data + text->size, text->capacity - text->size, fmt, args);
+    va_end(args);
+
+    text->size += (size_t)len;
+}
+
+static void titleInfosGenerateText(TitleInfo *title_info, TitleInfosText *text)
+{
+    char icon_path[FS_MAX_PATH] = {0};
+    FILE *icon_jpg = NULL;
+
+    titleInfosAppend(text, "Storage ID: 0x%02X\r\n", title_info->storage_id);
+    titleInfosAppend(text, "Title ID: %016lX\r\n", title_info->meta_key.id);
+    titleInfosAppend(text, "Version: %u (%u.%u.%u-%u.%u)\r\n", title_info->meta_key.version, title_info->version.major, title_info->version.minor, title_info->version.micro, \
+                     title_info->version.major_relstep, title_info->version.minor_relstep);
+    titleInfosAppend(text, "Type: 0x%02X\r\n", title_info->meta_key.type);
+    titleInfosAppend(text, "Install Type: 0x%02X\r\n", title_info->meta_key.install_type);
+    titleInfosAppend(text, "Title Size: %s (0x%lX)\r\n", title_info->size_str, title_info->size);
+
+    titleInfosAppend(text, "Content Count: %u\r\n", title_info->content_count);
+    for(u32 j = 0; j < title_info->content_count; j++)
+    {
+        char content_id_str[SHA256_HASH_SIZE + 1] = {0};
+        utilsGenerateHexStringFromData(content_id_str, sizeof(content_id_str), title_info->content_infos[j].content_id.c, sizeof(title_info->content_infos[j].content_id.c), false);
+
+        u64 content_size = 0;
+        ncmContentInfoSizeToU64(&(title_info->content_infos[j]), &content_size);
+
+        char content_size_str[32] = {0};
+        utilsGenerateFormattedSizeString(content_size, content_size_str, sizeof(content_size_str));
+
+        titleInfosAppend(text, "    Content #%u:\r\n", j + 1);
+        titleInfosAppend(text, "        Content ID: %s\r\n", content_id_str);
+        titleInfosAppend(text, "        Content Size: %s (0x%lX)\r\n", content_size_str, content_size);
+        titleInfosAppend(text, "        Content Type: 0x%02X\r\n", title_info->content_infos[j].content_type);
+        titleInfosAppend(text, "        ID Offset: 0x%02X\r\n", title_info->content_infos[j].id_offset);
+    }
+
+    if (title_info->app_metadata)
+    {
+        TitleApplicationMetadata *app_metadata = title_info->app_metadata;
+
+        if (strlen(app_metadata->lang_entry.name)) titleInfosAppend(text, "Name: %s\r\n", app_metadata->lang_entry.name);
+        if (strlen(app_metadata->lang_entry.author)) titleInfosAppend(text, "Author: %s\r\n", app_metadata->lang_entry.author);
+
+        if (title_info->meta_key.type == NcmContentMetaType_Application && app_metadata->icon_size && app_metadata->icon)
+        {
+            titleInfosAppend(text, "JPEG Icon Size: 0x%X\r\n", app_metadata->icon_size);
+
+            /* Icons are written by the worker threads themselves. SD card changes are only committed once, after all titles have been processed. */
+            sprintf(icon_path, "sdmc:/records/%016lX.jpg", app_metadata->title_id);
+
+            icon_jpg = fopen(icon_path, "wb");
+            if (icon_jpg)
+            {
+                fwrite(app_metadata->icon, 1, app_metadata->icon_size, icon_jpg);
+                fclose(icon_jpg);
+                icon_jpg = NULL;
+            }
+        }
+    }
+
+    if (title_info->meta_key.type == NcmContentMetaType_Patch || title_info->meta_key.type == NcmContentMetaType_AddOnContent)
+    {
+        if (title_info->previous) titleInfosAppend(text, "Previous %s ID: %016lX\r\n", title_info->meta_key.type == NcmContentMetaType_Patch ? "Patch" : "AOC", title_info->previous->meta_key.id);
+        if (title_info->next) titleInfosAppend(text, "Next %s ID: %016lX\r\n", title_info->meta_key.type == NcmContentMetaType_Patch ? "Patch" : "AOC", title_info->next->meta_key.id);
+    }
+
+    titleInfosAppend(text, "\r\n");
+}
+
+static void titleInfosThreadFunc(void *arg)
+{
+    TitleInfosThreadData *thread_data = (TitleInfosThreadData*)arg;
+    u32 idx = 0;
+
+    /* Titles are handed out one at a time, so a few large titles don't leave the rest of the worker threads idle. */
+    while((idx = atomic_fetch_add(&(thread_data->next_idx), 1)) < g_titleInfoCount)
+    {
+        titleInfosGenerateText(&(g_titleInfo[idx]), &(thread_data->texts[idx]));
+
+        SCOPED_LOCK(&(thread_data->mutex))
+        {
+            thread_data->ready[idx] = true;
+            condvarWakeAll(&(thread_data->cond));
+        }
+    }
+
+    threadExit();
+}
+
+static void dumpTitleInfosParallel(void)
+{
+    if (!g_titleInfo || !g_titleInfoCount) return;
+
+    TitleInfosThreadData thread_data = {0};
+    Thread threads[TITLE_INFOS_THREAD_COUNT] = {0};
+    u32 thread_count = 0;
+
+    FILE *title_infos_txt = NULL;
+    char *stream_buf = NULL;
+
+    mkdir("sdmc:/records", 0777);
+
+    mutexInit(&(thread_data.mutex));
+    condvarInit(&(thread_data.cond));
+    atomic_init(&(thread_data.next_idx), 0);
+
+    thread_data.texts = calloc(g_titleInfoCount, sizeof(TitleInfosText));
+    thread_data.ready = calloc(g_titleInfoCount, sizeof(bool));
+    if (!thread_data.texts || !thread_data.ready) goto end;
+
+    title_infos_txt = fopen("sdmc:/records/title_infos.txt", "wb");
+    if (!title_infos_txt) goto end;
+
+    /* Use a single large buffer for the whole output file, instead of flushing it after each title. */
+    if ((stream_buf = malloc(TITLE_INFOS_STREAM_BUFFER_SIZE)) != NULL) setvbuf(title_infos_txt, stream_buf, _IOFBF, TITLE_INFOS_STREAM_BUFFER_SIZE);
+
+    /* Start worker threads, one per core. The main thread only takes care of writing the output file. */
+    for(u32 i = 0; i < TITLE_INFOS_THREAD_COUNT; i++)
+    {
+        if (!utilsCreateThread(&(threads[i]), titleInfosThreadFunc, &thread_data, (int)i)) break;
+        thread_count++;
+    }
+
+    /* Fall back to generating everything from the main thread if no worker threads could be created. */
+    if (!thread_count)
+    {
+        for(u32 i = 0; i < g_titleInfoCount; i++)
+        {
+            titleInfosGenerateText(&(g_titleInfo[i]), &(thread_data.texts[i]));
+            thread_data.ready[i] = true;
+        }
+    }
+
+    /* Stream per-title text in title order as soon as it becomes available. Each buffer is freed right after being written. */
+    for(u32 i = 0; i < g_titleInfoCount; i++)
+    {
+        SCOPED_LOCK(&(thread_data.mutex))
+        {
+            while(!thread_data.ready[i]) condvarWait(&(thread_data.cond), &(thread_data.mutex));
+        }
+
+        TitleInfosText *text = &(thread_data.texts[i]);
+
+        if (text->data)
+        {
+            if (text->size) fwrite(text->data, 1, text->size, title_infos_txt);
+            free(text->data);
+            text->data = NULL;
+        }
+    }
+
+end:
+    for(u32 i = 0; i < thread_count; i++) utilsJoinThread(&(threads[i]));
+
+    if (title_infos_txt)
+    {
+        fclose(title_infos_txt);
+        utilsCommitSdCardFileSystemChanges();
+    }
+
+    if (stream_buf) free(stream_buf);
+
+    if (thread_data.texts)
+    {
+        for(u32 i = 0; i < g_titleInfoCount; i++)
+        {
+            if (thread_data.texts[i].data) free(thread_data.texts[i].data);
+        }
+
+        free(thread_data.texts);
+    }
+
+    if (thread_data.ready) free(thread_data.ready);
+}
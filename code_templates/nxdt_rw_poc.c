@@ -36,6 +36,24 @@
 #define WAIT_TIME_LIMIT 30
 #define OUTDIR          APP_TITLE
 
+#define EXTRACTED_ROMFS_SLOT_SIZE           0x100000    /* 1 MiB. */
+#define EXTRACTED_ROMFS_SLOT_COUNT          8
+#define EXTRACTED_ROMFS_SLOT_MAX_SEGMENTS   0x100
+#define EXTRACTED_ROMFS_SMALL_FILE_SIZE     0x20000     /* 128 KiB. Files up to this size are packed together into a single arena slot. */
+#define EXTRACTED_ROMFS_WRITER_COUNT        3
+
+#define NSP_PIPELINE_BUFFER_COUNT           4           /* Must be a power of two. Each buffer is BLOCK_SIZE bytes long. */
+#define NSP_PIPELINE_WAIT_TIMEOUT           1000000     /* 1 ms. Upper bound for a missed wakeup while a pipeline stage waits for a buffer. */
+
+#define NSP_PARALLEL_WORKER_COUNT           3
+
+#define NULL_SINK_DEVICE_NAME               "null"      /* Devoptab device used by the benchmark suite to discard output data. */
+
+#define BENCHMARK_OUTDIR                    OUTDIR "/benchmark"
+#define BENCHMARK_CSV_PATH                  DEVOPTAB_SDMC_DEVICE "/" OUTDIR "/benchmark.csv"
+#define BENCHMARK_HEAP_SAMPLE_INTERVAL      10000000    /* 10 ms. */
+#define BENCHMARK_SIZE_MIB                  0x100000    /* 1 MiB. */
+
 /* Type definitions. */
 
 typedef struct _Menu Menu;
@@ -97,11 +115,21 @@ typedef struct
     size_t data_size;
     size_t data_written;
     size_t total_size;
+    bool data_zero_filled;  ///< Set by the read thread if the current data chunk is zero-filled and the output file has already been sized. File writes seek past it.
     bool read_error;
     bool write_error;
     bool transfer_cancelled;
 } SharedThreadData;
 
+/// Used to generate a checksum manifest while extracting a filesystem. Only accessed by the read thread, which hashes each data chunk right after handing it
+/// off to the write thread. This way, checksum calculation overlaps with write operations instead of delaying them.
+typedef struct {
+    StringBuilder sb;           ///< Manifest contents. Holds a line per extracted file entry.
+    Sha256Context sha256_ctx;   ///< SHA-256 context for the current file entry.
+    u32 crc;                    ///< CRC32 checksum for the current file entry.
+    u64 size;                   ///< Data size processed so far for the current file entry.
+} ExtractedFsManifest;
+
 typedef struct {
     SharedThreadData shared_thread_data;
     u32 xci_crc, full_xci_crc;
@@ -110,6 +138,9 @@ typedef struct {
 typedef struct {
     SharedThreadData shared_thread_data;
     HashFileSystemContext *hfs_ctx;
+    ExtractedFsManifest manifest;
+    bool verify_hashes;
+    HashFileSystemHashVerifier verifier;
 } HfsThreadData;
 
 typedef struct {
@@ -120,6 +151,84 @@ typedef struct {
     bool transfer_cancelled;
 } NspThreadData;
 
+/// Holds a NACP patch whose generation has been deferred to the streaming pass of an NSP dump.
+/// NCA patches don't change the NSP size, so they only need to be generated right before reading the NCA they belong to.
+typedef struct {
+    NacpContext *nacp_ctx;      ///< NACP context to initialize. NULL if there's no pending patch for this NCA.
+    bool patch_sua;
+    bool patch_screenshot;
+    bool patch_video_capture;
+    bool patch_hdcp;
+} NspDeferredNcaPatch;
+
+typedef enum {
+    NspPipelineStage_Read  = 0,     ///< Reads and decrypts NCA data. Runs on the NSP dump thread.
+    NspPipelineStage_Patch = 1,     ///< Updates the clean SHA-256 hash and applies NCA header / content type patches.
+    NspPipelineStage_Hash  = 2,     ///< Updates the dirty SHA-256 hash and updates the CNMT / PFS entry data once an NCA has been fully processed.
+    NspPipelineStage_Write = 3,     ///< Writes NCA data to the output file or sends it to the USB host, then returns the buffer to the read stage.
+    NspPipelineStage_Count = 4      ///< Total values supported by this enum.
+} NspPipelineStage;
+
+typedef struct {
+    u8 *data;                               ///< BLOCK_SIZE bytes long.
+    u64 size;                               ///< Chunk size.
+    u64 offset;                             ///< Chunk offset, relative to the start of the NCA.
+    u32 nca_idx;                            ///< NCA index.
+    bool eos;                               ///< Set on the last buffer sent through the pipeline, which holds no data.
+    char entry_name[0x40];                  ///< PFS entry name for this NCA. Only set on the first chunk from each NCA.
+    u8 clean_hash[SHA256_HASH_SIZE];        ///< Clean SHA-256 hash for this NCA. Only set on the last chunk from each NCA.
+    bool hash_shared;                       ///< Set if no patches have been applied to this NCA so far, which means the dirty SHA-256 hash is identical to the clean one up to this chunk.
+    bool hash_fork;                         ///< Set on the first chunk that may hold patched data. 'fork_ctx' must be used as the starting point for the dirty SHA-256 hash.
+    Sha256Context fork_ctx;                 ///< Clean SHA-256 context snapshot, taken right before this chunk was hashed. Only valid if 'hash_fork' is set.
+} NspPipelineBuffer;
+
+/// Single-producer, single-consumer ring of buffer indexes. Head and tail counters are only written by the producer and the consumer, respectively.
+/// Its capacity matches the total number of pipeline buffers, so pushing a buffer never blocks.
+typedef struct {
+    u32 buffer_idx[NSP_PIPELINE_BUFFER_COUNT];
+    atomic_uint head;
+    atomic_uint tail;
+    Mutex mutex;
+    CondVar condvar;
+} NspPipelineRing;
+
+/// Each stage takes buffers from its own ring and passes them to the ring from the next stage. The write stage passes them back to the read stage.
+typedef struct {
+    NspThreadData *nsp_thread_data;
+    NcaContext *nca_ctx;
+    ContentMetaContext *cnmt_ctx;
+    PartitionFileSystemImageContext *pfs_img_ctx;
+    FILE *fp;
+    u32 dev_idx;
+    u8 *data;
+    NspPipelineBuffer buffers[NSP_PIPELINE_BUFFER_COUNT];
+    NspPipelineRing rings[NspPipelineStage_Count];
+    Thread threads[NspPipelineStage_Count];         ///< Entry for NspPipelineStage_Read is unused.
+    bool threads_created[NspPipelineStage_Count];
+    atomic_bool abort;
+} NspPipeline;
+
+/// Used to process multiple NCAs at once while dumping an NSP to a seekable output file. Each worker thread processes a whole NCA at a time.
+/// The mutex protects the output file, the CNMT and PFS image contexts and all the fields below it.
+typedef struct {
+    NspThreadData *nsp_thread_data;
+    NcaContext *nca_ctx;
+    u32 nca_count;                                  ///< Number of NCAs processed by the worker threads. The Meta NCA is excluded.
+    ContentMetaContext *cnmt_ctx;
+    PartitionFileSystemImageContext *pfs_img_ctx;
+    NspDeferredNcaPatch *deferred_patches;
+    FILE *fp;
+    u64 nsp_header_size;
+    Mutex mutex;
+    u32 next_nca_idx;
+    bool error;
+} NspParallelContext;
+
+typedef struct {
+    NspParallelContext *parallel_ctx;
+    u8 *buf;
+} NspParallelWorkerData;
+
 typedef struct {
     TitleInfo *title_info;
     u32 content_idx;
@@ -134,14 +243,53 @@ typedef struct {
     SharedThreadData shared_thread_data;
     PartitionFileSystemContext *pfs_ctx;
     bool use_layeredfs_dir;
+    ExtractedFsManifest manifest;
 } PfsThreadData;
 
+typedef struct {
+    u32 file_entry_offset;  ///< RomFS file entry offset.
+    u32 buf_offset;         ///< Data offset, relative to the start of the slot buffer.
+    u32 size;               ///< Data size.
+} ExtractedRomFsSegment;
+
+typedef struct {
+    u8 *buf;
+    size_t buf_used;
+    u32 segment_count;
+    ExtractedRomFsSegment segments[EXTRACTED_ROMFS_SLOT_MAX_SEGMENTS];
+} ExtractedRomFsSlot;
+
+/// Shared arena used by the multi-threaded extracted RomFS dumper. Protected by g_fileMutex.
+/// The read thread fills free slots and queues them to a writer thread. Chunks from files bigger than EXTRACTED_ROMFS_SMALL_FILE_SIZE are always
+/// queued to the same writer thread, which keeps them in order. Smaller files are packed into shared slots, which are queued in a round-robin fashion.
+typedef struct {
+    u8 *data;
+    ExtractedRomFsSlot slots[EXTRACTED_ROMFS_SLOT_COUNT];
+    u32 free_slots[EXTRACTED_ROMFS_SLOT_COUNT];
+    u32 free_slot_count;
+    u32 queues[EXTRACTED_ROMFS_WRITER_COUNT][EXTRACTED_ROMFS_SLOT_COUNT];
+    u32 queue_heads[EXTRACTED_ROMFS_WRITER_COUNT];
+    u32 queue_counts[EXTRACTED_ROMFS_WRITER_COUNT];
+    char *base_path;
+    size_t base_path_len;
+    u8 illegal_char_replace_type;
+    bool read_done;
+} ExtractedRomFsArena;
+
 typedef struct {
     SharedThreadData shared_thread_data;
     RomFileSystemContext *romfs_ctx;
     bool use_layeredfs_dir;
+    bool only_updated;      ///< Only extract file entries with data backed by the Patch storage. Skipped file entries are listed in a manifest file.
+    ExtractedRomFsArena *arena;
+    ExtractedFsManifest manifest;
 } RomFsThreadData;
 
+typedef struct {
+    RomFsThreadData *romfs_thread_data;
+    u32 writer_idx;
+} ExtractedRomFsWriterData;
+
 typedef struct {
     bool highlight;
     size_t size;
@@ -167,6 +315,41 @@ typedef struct {
     SystemUpdateDumpContext *sys_upd_dump_ctx;
 } SystemUpdateThreadData;
 
+typedef struct {
+    u64 offset;     ///< Current file offset.
+    u64 size;       ///< Current file size.
+} NullSinkFileState;
+
+typedef enum {
+    BenchmarkSink_Null    = 0,  ///< Output data is discarded by the null sink device.
+    BenchmarkSink_SdCard  = 1,  ///< Output data is written to the SD card, then deleted.
+    BenchmarkSink_UsbHost = 2,  ///< Output data is sent to the USB host. Skipped if there's no active USB session.
+    BenchmarkSink_Count   = 3   ///< Total values supported by this enum.
+} BenchmarkSink;
+
+typedef struct {
+    const char *name;                               ///< Case name written to the CSV file.
+    MenuElementFunction task_func;                  ///< Dump function to benchmark.
+    void *userdata;                                 ///< Passed to task_func as its only argument.
+    MenuElementOptionSetterFunction setter_func;    ///< Called with 'option' right before task_func. Used to choose between raw and extracted dumps. Should be set to NULL if not used.
+    u32 option;
+    const char *skip_reason;                        ///< If set, task_func isn't called and a skipped row is written instead.
+} BenchmarkCase;
+
+typedef struct {
+    const char *result;                             ///< "ok", "failed" or "skipped".
+    u64 elapsed_ns;
+    u64 read_size;                                  ///< Data read from gamecard, NCM and BIS storages.
+    u64 write_size;                                 ///< Data received by the sink.
+    u64 cpu_ns[ThreadPlacementStage_Count];         ///< CPU time from all dump threads joined while the case was running, grouped by pipeline stage.
+    u64 peak_heap_size;                             ///< Highest heap usage sampled while the case was running.
+} BenchmarkResult;
+
+typedef struct {
+    atomic_bool stop;
+    u64 peak_heap_size;
+} BenchmarkHeapSampler;
+
 /* Function prototypes. */
 
 static void utilsScanPads(void);
@@ -221,6 +404,8 @@ static bool saveGameCardUid(void *userdata);
 static bool saveGameCardHfsPartition(void *userdata);
 static bool saveGameCardRawHfsPartition(HashFileSystemContext *hfs_ctx);
 static bool saveGameCardExtractedHfsPartition(HashFileSystemContext *hfs_ctx);
+static bool saveGameCardHfsPartitionPrepareVerifier(HfsThreadData *hfs_thread_data);
+static bool saveGameCardHfsPartitionFinalizeVerifier(HfsThreadData *hfs_thread_data);
 static bool browseGameCardHfsPartition(void *userdata);
 
 static bool saveConsoleLafwBlob(void *userdata);
@@ -249,12 +434,21 @@ static bool saveRawPartitionFsSection(PartitionFileSystemContext *pfs_ctx, bool
 static bool saveExtractedPartitionFsSection(PartitionFileSystemContext *pfs_ctx, bool use_layeredfs_dir);
 
 static bool saveRawRomFsSection(RomFileSystemContext *romfs_ctx, bool use_layeredfs_dir);
+
+static bool enableRawNcaFsSectionVerification(NcaFsSectionContext *nca_fs_ctx);
 static bool saveExtractedRomFsSection(RomFileSystemContext *romfs_ctx, bool use_layeredfs_dir);
 
 static void xciReadThreadFunc(void *arg);
 
+static void extractedFsManifestStartEntry(ExtractedFsManifest *manifest);
+static void extractedFsManifestUpdateEntry(ExtractedFsManifest *manifest, const void *data, size_t data_size);
+static bool extractedFsManifestFinishEntry(ExtractedFsManifest *manifest, const char *path);
+static bool extractedFsManifestSave(ExtractedFsManifest *manifest, const char *base_path, u32 dev_idx);
+
 static void rawHfsReadThreadFunc(void *arg);
 static void extractedHfsReadThreadFunc(void *arg);
+static bool extractedHfsOpenOutputFile(HfsThreadData *hfs_thread_data, u32 entry_idx, char *hfs_path, const char *filename, size_t filename_len, u32 dev_idx);
+static bool extractedHfsQueueDataChunk(SharedThreadData *shared_thread_data, void *data, size_t data_size);
 
 static void ncaReadThreadFunc(void *arg);
 
@@ -263,6 +457,19 @@ static void extractedPartitionFsReadThreadFunc(void *arg);
 
 static void rawRomFsReadThreadFunc(void *arg);
 static void extractedRomFsReadThreadFunc(void *arg);
+static bool extractedRomFsCreateOutputFiles(RomFileSystemContext *romfs_ctx, bool only_updated, char *romfs_path, size_t romfs_path_size, size_t filename_len, u8 romfs_illegal_char_replace_type, u32 dev_idx);
+static bool extractedRomFsIsFileEntrySkipped(RomFileSystemContext *romfs_ctx, bool only_updated, RomFileSystemFileEntry *romfs_file_entry, bool *out);
+static void extractedRomFsWriteSkippedFilesManifest(RomFsThreadData *romfs_thread_data, const char *base_path, u8 romfs_illegal_char_replace_type, u32 dev_idx);
+static char *generateExtractedRomFsOutputPath(RomFsThreadData *romfs_thread_data);
+
+static bool extractedRomFsAllocateArena(ExtractedRomFsArena **out);
+static void extractedRomFsFreeArena(ExtractedRomFsArena *arena);
+static void extractedRomFsBatchReadThreadFunc(void *arg);
+static void extractedRomFsBatchWriteThreadFunc(void *arg);
+static void extractedRomFsWriterThreadFunc(void *arg);
+static void extractedRomFsWriterLoop(RomFsThreadData *romfs_thread_data, u32 writer_idx);
+static ExtractedRomFsSlot *extractedRomFsAcquireSlot(RomFsThreadData *romfs_thread_data, u32 *out_slot_idx);
+static void extractedRomFsQueueSlot(ExtractedRomFsArena *arena, u32 slot_idx, u32 writer_idx);
 
 static void fsBrowserFileReadThreadFunc(void *arg);
 static void fsBrowserHighlightedEntriesReadThreadFunc(void *arg);
@@ -276,6 +483,46 @@ static bool spanDumpThreads(ThreadFunc read_func, ThreadFunc write_func, void *a
 
 static void nspThreadFunc(void *arg);
 
+static bool nspPipelineInitialize(NspPipeline *pipeline, NspThreadData *nsp_thread_data, NcaContext *nca_ctx, ContentMetaContext *cnmt_ctx, PartitionFileSystemImageContext *pfs_img_ctx, FILE *fp, u32 dev_idx);
+static bool nspPipelineFinalize(NspPipeline *pipeline, bool abort);
+static bool nspPipelineWaitForDrain(NspPipeline *pipeline);
+static NspPipelineBuffer *nspPipelineRingPop(NspPipeline *pipeline, u32 stage);
+static void nspPipelineRingPush(NspPipeline *pipeline, u32 stage, NspPipelineBuffer *buffer);
+static void nspPipelinePatchThreadFunc(void *arg);
+static void nspPipelineHashThreadFunc(void *arg);
+static void nspPipelineWriteThreadFunc(void *arg);
+
+static bool nspProcessNcasInParallel(NspThreadData *nsp_thread_data, NcaContext *nca_ctx, u32 nca_count, ContentMetaContext *cnmt_ctx, PartitionFileSystemImageContext *pfs_img_ctx, NspDeferredNcaPatch *deferred_patches, FILE *fp, u64 nsp_header_size);
+static void nspParallelWorkerThreadFunc(void *arg);
+
+static void nspApplyNcaPatches(NcaContext *nca_ctx, ContentMetaContext *cnmt_ctx, u8 *buf, u64 size, u64 offset, bool *dirty_header);
+static bool nspFinalizeNcaHash(NcaContext *nca_ctx, u32 nca_idx, ContentMetaContext *cnmt_ctx, PartitionFileSystemImageContext *pfs_img_ctx, const u8 *clean_hash, const u8 *dirty_hash);
+static bool nspGenerateDeferredNcaPatch(NcaContext *nca_ctx, NspDeferredNcaPatch *deferred_patch);
+
+NX_INLINE u8 getDumpThreadWriteStage(void);
+static void joinDumpThread(Thread *thread, u8 stage);
+
+static int     nullDevOpen(struct _reent *r, void *fd, const char *path, int flags, int mode);
+static int     nullDevClose(struct _reent *r, void *fd);
+static ssize_t nullDevWrite(struct _reent *r, void *fd, const char *ptr, size_t len);
+static ssize_t nullDevRead(struct _reent *r, void *fd, char *ptr, size_t len);
+static off_t   nullDevSeek(struct _reent *r, void *fd, off_t pos, int dir);
+static int     nullDevFstat(struct _reent *r, void *fd, struct stat *st);
+static int     nullDevStat(struct _reent *r, const char *file, struct stat *st);
+static int     nullDevUnlink(struct _reent *r, const char *name);
+static int     nullDevMkdir(struct _reent *r, const char *path, int mode);
+static int     nullDevStatvfs(struct _reent *r, const char *path, struct statvfs *buf);
+static int     nullDevFtruncate(struct _reent *r, void *fd, off_t len);
+static int     nullDevFsync(struct _reent *r, void *fd);
+static int     nullDevRmdir(struct _reent *r, const char *name);
+
+static bool benchmarkGameCard(void *userdata);
+static bool benchmarkTitle(void *userdata);
+static bool benchmarkRunSuite(const char *target, const BenchmarkCase *cases, u32 case_count);
+static void benchmarkRunCase(const BenchmarkCase *bench_case, u8 sink, BenchmarkResult *out);
+static void benchmarkWriteCsvRow(FILE *fp, const char *target, const char *case_name, u8 sink, const BenchmarkResult *res);
+static void benchmarkHeapSamplerThreadFunc(void *arg);
+
 static u32 getOutputStorageOption(void);
 static void setOutputStorageOption(u32 idx);
 
@@ -294,6 +541,9 @@ static void setGameCardCalculateChecksumOption(u32 idx);
 static u32 getGameCardWriteRawHfsPartitionOption(void);
 static void setGameCardWriteRawHfsPartitionOption(u32 idx);
 
+static u32 getGameCardVerifyHfsHashesOption(void);
+static void setGameCardVerifyHfsHashesOption(u32 idx);
+
 static u32 getNspSetDownloadDistributionOption(void);
 static void setNspSetDownloadDistributionOption(u32 idx);
 
@@ -327,6 +577,12 @@ static void setNcaFsWriteRawSectionOption(u32 idx);
 static u32 getNcaFsUseLayeredFsDirOption(void);
 static void setNcaFsUseLayeredFsDirOption(u32 idx);
 
+static u32 getNcaFsOnlyUpdatedFilesOption(void);
+static void setNcaFsOnlyUpdatedFilesOption(u32 idx);
+
+static u32 getNcaFsVerifyRawSectionOption(void);
+static void setNcaFsVerifyRawSectionOption(u32 idx);
+
 static bool resetSettings(void *userdata);
 
 /* Global variables. */
@@ -337,6 +593,31 @@ static PadState g_padState = {0};
 
 static char *g_noYesStrings[] = { "no", "yes", NULL };
 
+static const char *g_outputBaseDir = OUTDIR;    // Changed by the benchmark suite to keep its SD card output apart from regular dumps
+
+static atomic_uint_fast64_t g_dumpStageCpuTicks[ThreadPlacementStage_Count];
+static atomic_uint_fast64_t g_nullSinkWriteSize;
+
+static const devoptab_t g_nullSinkDevoptab = {
+    .name         = NULL_SINK_DEVICE_NAME,
+    .structSize   = sizeof(NullSinkFileState),
+    .open_r       = nullDevOpen,
+    .close_r      = nullDevClose,
+    .write_r      = nullDevWrite,
+    .read_r       = nullDevRead,
+    .seek_r       = nullDevSeek,
+    .fstat_r      = nullDevFstat,
+    .stat_r       = nullDevStat,
+    .unlink_r     = nullDevUnlink,
+    .mkdir_r      = nullDevMkdir,
+    .statvfs_r    = nullDevStatvfs,
+    .ftruncate_r  = nullDevFtruncate,
+    .fsync_r      = nullDevFsync,
+    .rmdir_r      = nullDevRmdir
+};
+
+static const char *g_benchmarkSinkNames[BenchmarkSink_Count] = { "null", "sd", "usb" };
+
 static bool g_appletStatus = true;
 
 static UsbHsFsDevice *g_umsDevices = NULL;
@@ -478,6 +759,19 @@ static MenuElement *g_gameCardHfsDumpMenuElements[] = {
         },
         .userdata = NULL
     },
+    &(MenuElement){
+        .str = "verify hfs entry hashes",
+        .child_menu = NULL,
+        .task_func = NULL,
+        .element_options = &(MenuElementOption){
+            .selected = 0,
+            .retrieved = false,
+            .getter_func = &getGameCardVerifyHfsHashesOption,
+            .setter_func = &setGameCardVerifyHfsHashesOption,
+            .options = g_noYesStrings
+        },
+        .userdata = NULL
+    },
     &g_storageMenuElement,
     NULL
 };
@@ -618,6 +912,13 @@ static MenuElement *g_gameCardMenuElements[] = {
         .element_options = NULL,
         .userdata = NULL
     },
+    &(MenuElement){
+        .str = "benchmark all dump paths (optional)",
+        .child_menu = NULL,
+        .task_func = &benchmarkGameCard,
+        .element_options = NULL,
+        .userdata = NULL
+    },
     &g_storageMenuElement,
     NULL
 };
@@ -630,6 +931,13 @@ static MenuElement *g_nspMenuElements[] = {
         .element_options = NULL,
         .userdata = NULL    // Dynamically set to the TitleInfo object from the title to dump
     },
+    &(MenuElement){
+        .str = "benchmark all dump paths",
+        .child_menu = NULL,
+        .task_func = &benchmarkTitle,
+        .element_options = NULL,
+        .userdata = NULL    // Dynamically set to the TitleInfo object from the title to dump
+    },
     &(MenuElement){
         .str = "nca: set content distribution type to \"download\"",
         .child_menu = NULL,
@@ -838,6 +1146,32 @@ static MenuElement *g_ncaFsSectionsSubMenuElements[] = {
         },
         .userdata = NULL
     },
+    &(MenuElement){
+        .str = "only extract updated romfs files",
+        .child_menu = NULL,
+        .task_func = NULL,
+        .element_options = &(MenuElementOption){
+            .selected = 0,
+            .retrieved = false,
+            .getter_func = &getNcaFsOnlyUpdatedFilesOption,
+            .setter_func = &setNcaFsOnlyUpdatedFilesOption,
+            .options = g_noYesStrings
+        },
+        .userdata = NULL
+    },
+    &(MenuElement){
+        .str = "verify raw section hashes",
+        .child_menu = NULL,
+        .task_func = NULL,
+        .element_options = &(MenuElementOption){
+            .selected = 0,
+            .retrieved = false,
+            .getter_func = &getNcaFsVerifyRawSectionOption,
+            .setter_func = &setNcaFsVerifyRawSectionOption,
+            .options = g_noYesStrings
+        },
+        .userdata = NULL
+    },
     &g_storageMenuElement,
     NULL
 };
@@ -1215,7 +1549,7 @@ int main(int argc, char *argv[])
                 consolePrint("size: %s\n", title_info->size_str);
                 consolePrint("______________________________\n\n");
 
-                if (cur_menu->id == MenuId_Nsp) g_nspMenuElements[0]->userdata = title_info;
+                if (cur_menu->id == MenuId_Nsp) g_nspMenuElements[0]->userdata = g_nspMenuElements[1]->userdata = title_info;
 
                 if (cur_menu->id == MenuId_Ticket) g_ticketMenuElements[0]->userdata = title_info;
 
@@ -1576,7 +1910,7 @@ int main(int argc, char *argv[])
             } else
             if (cur_menu->id == MenuId_Nsp)
             {
-                g_nspMenuElements[0]->userdata = NULL;
+                g_nspMenuElements[0]->userdata = g_nspMenuElements[1]->userdata = NULL;
             } else
             if (cur_menu->id == MenuId_Ticket)
             {
@@ -2450,7 +2784,7 @@ static char *generateOutputGameCardFileName(const char *subdir, const char *exte
         goto end;
     }
 
-    if (dev_idx != 1) sprintf(prefix, "%s/" OUTDIR, dev_idx == 0 ? DEVOPTAB_SDMC_DEVICE : g_umsDevices[dev_idx - 2].name);
+    if (dev_idx != 1) sprintf(prefix, "%s/%s", dev_idx == 0 ? DEVOPTAB_SDMC_DEVICE : g_umsDevices[dev_idx - 2].name, g_outputBaseDir);
 
     if (subdir)
     {
@@ -2486,7 +2820,7 @@ static char *generateOutputTitleFileName(TitleInfo *title_info, const char *subd
         goto end;
     }
 
-    if (dev_idx != 1) sprintf(prefix, "%s/" OUTDIR, dev_idx == 0 ? DEVOPTAB_SDMC_DEVICE : g_umsDevices[dev_idx - 2].name);
+    if (dev_idx != 1) sprintf(prefix, "%s/%s", dev_idx == 0 ? DEVOPTAB_SDMC_DEVICE : g_umsDevices[dev_idx - 2].name, g_outputBaseDir);
 
     if (subdir)
     {
@@ -2992,6 +3326,8 @@ static bool saveGameCardRawHfsPartition(HashFileSystemContext *hfs_ctx)
     hfs_thread_data.hfs_ctx = hfs_ctx;
     shared_thread_data->total_size = hfs_ctx->size;
 
+    if (!saveGameCardHfsPartitionPrepareVerifier(&hfs_thread_data)) goto end;
+
     utilsGenerateFormattedSizeString((double)hfs_ctx->size, size_str, sizeof(size_str));
     consolePrint("raw %s hfs partition size: 0x%lX (%s)\n", hfs_ctx->name, hfs_ctx->size, size_str);
 
@@ -3057,6 +3393,9 @@ static bool saveGameCardRawHfsPartition(HashFileSystemContext *hfs_ctx)
         consoleRefresh();
     }
 
+    /* The output file is kept even if verification fails, since it holds exactly what the gamecard returned. */
+    if (success) success = saveGameCardHfsPartitionFinalizeVerifier(&hfs_thread_data);
+
 end:
     if (shared_thread_data->fp)
     {
@@ -3077,6 +3416,8 @@ end:
 
     if (filename) free(filename);
 
+    hfsFreeHashVerifier(&(hfs_thread_data.verifier));
+
     return success;
 }
 
@@ -3105,13 +3446,55 @@ static bool saveGameCardExtractedHfsPartition(HashFileSystemContext *hfs_ctx)
     hfs_thread_data.hfs_ctx = hfs_ctx;
     shared_thread_data->total_size = data_size;
 
+    if (!saveGameCardHfsPartitionPrepareVerifier(&hfs_thread_data)) goto end;
+
     utilsGenerateFormattedSizeString((double)data_size, size_str, sizeof(size_str));
     consolePrint("extracted %s hfs partition size: 0x%lX (%s)\n", hfs_ctx->name, data_size, size_str);
     consoleRefresh();
 
     success = spanDumpThreads(extractedHfsReadThreadFunc, genericWriteThreadFunc, &hfs_thread_data);
+    if (success) success = saveGameCardHfsPartitionFinalizeVerifier(&hfs_thread_data);
 
 end:
+    hfsFreeHashVerifier(&(hfs_thread_data.verifier));
+
+    return success;
+}
+
+static bool saveGameCardHfsPartitionPrepareVerifier(HfsThreadData *hfs_thread_data)
+{
+    HashFileSystemContext *hfs_ctx = hfs_thread_data->hfs_ctx;
+
+    hfs_thread_data->verify_hashes = (bool)getGameCardVerifyHfsHashesOption();
+    if (!hfs_thread_data->verify_hashes) return true;
+
+    if (!hfsAddHashVerifierContext(&(hfs_thread_data->verifier), hfs_ctx))
+    {
+        consolePrint("failed to retrieve hashed regions from %s hfs partition!\n", hfs_ctx->name);
+        return false;
+    }
+
+    consolePrint("verifying %u hashed region(s) from %s hfs partition\n", hfs_thread_data->verifier.region_count, hfs_ctx->name);
+
+    return true;
+}
+
+static bool saveGameCardHfsPartitionFinalizeVerifier(HfsThreadData *hfs_thread_data)
+{
+    HashFileSystemHashVerifier *verifier = &(hfs_thread_data->verifier);
+
+    if (!hfs_thread_data->verify_hashes) return true;
+
+    bool success = hfsFinalizeHashVerifier(verifier);
+
+    for(u32 i = 0; i < verifier->region_count; i++)
+    {
+        if (verifier->regions[i].status == HashFileSystemHashStatus_Failed) consolePrint("hash mismatch: \"%s\"\n", verifier->regions[i].name);
+    }
+
+    consolePrint("hfs hash verification: %u passed, %u failed, %u skipped\n", verifier->passed_count, verifier->failed_count, verifier->skipped_count);
+    consoleRefresh();
+
     return success;
 }
 
@@ -3257,7 +3640,7 @@ static bool saveNintendoSubmissionPackage(void *userdata)
 
     if (nsp_thread_data.error)
     {
-        utilsJoinThread(&dump_thread);
+        joinDumpThread(&dump_thread, ThreadPlacementStage_Read);
         return false;
     }
 
@@ -3321,7 +3704,7 @@ static bool saveNintendoSubmissionPackage(void *userdata)
     consolePrint("\nwaiting for thread to join\n");
     consoleRefresh();
 
-    utilsJoinThread(&dump_thread);
+    joinDumpThread(&dump_thread, ThreadPlacementStage_Read);
     consolePrint("dump_thread done: %lu\n", time(NULL));
 
     if (nsp_thread_data.error)
@@ -3705,6 +4088,9 @@ static bool saveSystemUpdateDump(void *userdata)
         goto end;
     }
 
+    /* Read upcoming NCAs ahead of time. Not fatal if it fails. */
+    if (!systemUpdateEnableDumpContextPrefetch(&sys_upd_dump_ctx)) consolePrint("system update prefetch disabled\n");
+
     sys_upd_thread_data.sys_upd_dump_ctx = &sys_upd_dump_ctx;
     shared_thread_data->total_size = sys_upd_dump_ctx.total_size;
 
@@ -4426,7 +4812,7 @@ static bool saveRawPartitionFsSection(PartitionFileSystemContext *pfs_ctx, bool
     char subdir[0x20] = {0}, *filename = NULL;
     u32 dev_idx = g_storageMenuElementOption.selected;
 
-    bool success = false;
+    bool verify_reads = false, success = false;
 
     pfs_thread_data.pfs_ctx = pfs_ctx;
     pfs_thread_data.use_layeredfs_dir = use_layeredfs_dir;
@@ -4500,6 +4886,9 @@ static bool saveRawPartitionFsSection(PartitionFileSystemContext *pfs_ctx, bool
         ftruncate(fileno(shared_thread_data->fp), (off_t)shared_thread_data->total_size);
     }
 
+    /* Only the hash target region is dumped. Skipped hash layers may be used to verify it while it's being read. */
+    if (getNcaFsVerifyRawSectionOption()) verify_reads = enableRawNcaFsSectionVerification(nca_fs_ctx);
+
     consoleRefresh();
 
     success = spanDumpThreads(rawPartitionFsReadThreadFunc, genericWriteThreadFunc, &pfs_thread_data);
@@ -4530,6 +4919,8 @@ end:
 
     if (filename) free(filename);
 
+    if (verify_reads) ncaSetFsSectionReadVerification(nca_fs_ctx, false);
+
     return success;
 }
 
@@ -4586,7 +4977,7 @@ static bool saveRawRomFsSection(RomFileSystemContext *romfs_ctx, bool use_layere
     char subdir[0x20] = {0}, *filename = NULL;
     u32 dev_idx = g_storageMenuElementOption.selected;
 
-    bool success = false;
+    bool verify_reads = false, success = false;
 
     romfs_thread_data.romfs_ctx = romfs_ctx;
     romfs_thread_data.use_layeredfs_dir = use_layeredfs_dir;
@@ -4660,6 +5051,9 @@ static bool saveRawRomFsSection(RomFileSystemContext *romfs_ctx, bool use_layere
         ftruncate(fileno(shared_thread_data->fp), (off_t)shared_thread_data->total_size);
     }
 
+    /* Only the hash target region is dumped. Skipped hash layers may be used to verify it while it's being read. */
+    if (getNcaFsVerifyRawSectionOption()) verify_reads = enableRawNcaFsSectionVerification(nca_fs_ctx);
+
     consoleRefresh();
 
     success = spanDumpThreads(rawRomFsReadThreadFunc, genericWriteThreadFunc, &romfs_thread_data);
@@ -4690,9 +5084,26 @@ end:
 
     if (filename) free(filename);
 
+    if (verify_reads) ncaSetFsSectionReadVerification(nca_fs_ctx, false);
+
     return success;
 }
 
+static bool enableRawNcaFsSectionVerification(NcaFsSectionContext *nca_fs_ctx)
+{
+    /* Hash layers are read and verified right away. Data blocks are verified against their parent hashes while being read, so the dump fails at the first bad block. */
+    /* Not a fatal error if this fails -- sections with sparse, compression or patch layers can't be verified this way. */
+    if (!ncaSetFsSectionReadVerification(nca_fs_ctx, true))
+    {
+        consolePrint("hash verification unavailable for this section, dumping without it\n");
+        return false;
+    }
+
+    consolePrint("hash layers verified, section data will be verified while dumping\n");
+
+    return true;
+}
+
 static bool saveExtractedRomFsSection(RomFileSystemContext *romfs_ctx, bool use_layeredfs_dir)
 {
     u64 data_size = 0;
@@ -4701,9 +5112,16 @@ static bool saveExtractedRomFsSection(RomFileSystemContext *romfs_ctx, bool use_
     RomFsThreadData romfs_thread_data = {0};
     SharedThreadData *shared_thread_data = &(romfs_thread_data.shared_thread_data);
 
-    bool success = false;
+    bool only_updated = (bool)getNcaFsOnlyUpdatedFilesOption(), success = false;
+
+    /* Override the updated files flag, if needed. File entries can only be matched against the Patch storage if we're dealing with a Patch RomFS section. */
+    if (only_updated && (!romfs_ctx->is_patch || romfs_ctx->default_storage_ctx->nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs))
+    {
+        consolePrint("updated files setting disabled (not a patch romfs section)\n");
+        only_updated = false;
+    }
 
-    if (!romfsGetTotalDataSize(romfs_ctx, false, &data_size))
+    if (!romfsGetTotalDataSize(romfs_ctx, only_updated, &data_size))
     {
         consolePrint("failed to calculate extracted romfs section size!\n");
         goto end;
@@ -4711,19 +5129,27 @@ static bool saveExtractedRomFsSection(RomFileSystemContext *romfs_ctx, bool use_
 
     if (!data_size)
     {
-        consolePrint("romfs section is empty!\n");
+        consolePrint(only_updated ? "no updated files available in romfs section!\n" : "romfs section is empty!\n");
         goto end;
     }
 
     romfs_thread_data.romfs_ctx = romfs_ctx;
     romfs_thread_data.use_layeredfs_dir = use_layeredfs_dir;
+    romfs_thread_data.only_updated = only_updated;
     shared_thread_data->total_size = data_size;
 
     utilsGenerateFormattedSizeString((double)data_size, size_str, sizeof(size_str));
     consolePrint("extracted romfs section size: 0x%lX (%s)\n", data_size, size_str);
     consoleRefresh();
 
-    success = spanDumpThreads(extractedRomFsReadThreadFunc, genericWriteThreadFunc, &romfs_thread_data);
+    /* Use the multi-threaded dumper for local storage. Fall back to the single writer thread if the shared arena can't be allocated. */
+    if (!useUsbHost() && extractedRomFsAllocateArena(&(romfs_thread_data.arena)))
+    {
+        success = spanDumpThreads(extractedRomFsBatchReadThreadFunc, extractedRomFsBatchWriteThreadFunc, &romfs_thread_data);
+        extractedRomFsFreeArena(romfs_thread_data.arena);
+    } else {
+        success = spanDumpThreads(extractedRomFsReadThreadFunc, genericWriteThreadFunc, &romfs_thread_data);
+    }
 
 end:
     return success;
@@ -4811,6 +5237,75 @@ end:
     threadExit();
 }
 
+static void extractedFsManifestStartEntry(ExtractedFsManifest *manifest)
+{
+    sha256ContextCreate(&(manifest->sha256_ctx));
+    manifest->crc = 0;
+    manifest->size = 0;
+}
+
+static void extractedFsManifestUpdateEntry(ExtractedFsManifest *manifest, const void *data, size_t data_size)
+{
+    sha256ContextUpdate(&(manifest->sha256_ctx), data, data_size);
+    manifest->crc = crc32FastCalculateWithSeed(manifest->crc, data, data_size);
+    manifest->size += data_size;
+}
+
+static bool extractedFsManifestFinishEntry(ExtractedFsManifest *manifest, const char *path)
+{
+    u8 hash[SHA256_HASH_SIZE] = {0};
+    char hash_str[(SHA256_HASH_SIZE * 2) + 1] = {0};
+
+    sha256ContextGetHash(&(manifest->sha256_ctx), hash);
+    utilsGenerateHexString(hash_str, sizeof(hash_str), hash, sizeof(hash), false);
+
+    /* Add a header line before the first entry. Paths are relative to the output directory. */
+    if (!manifest->sb.length && !stringBuilderAppend(&(manifest->sb), "# sha256 crc32 size path\r\n")) return false;
+
+    return stringBuilderAppendFormatted(&(manifest->sb), "%s %08X %lu %s\r\n", hash_str, manifest->crc, manifest->size, path);
+}
+
+static bool extractedFsManifestSave(ExtractedFsManifest *manifest, const char *base_path, u32 dev_idx)
+{
+    char manifest_path[FS_MAX_PATH] = {0};
+    FILE *fp = NULL;
+    bool success = false;
+
+    /* Nothing to do if no file entries were extracted. */
+    if (!manifest->sb.length) return true;
+
+    /* The manifest is stored right next to the output directory, so it doesn't end up as part of a LayeredFS directory. */
+    snprintf(manifest_path, MAX_ELEMENTS(manifest_path), "%s_checksums.txt", base_path);
+
+    if (dev_idx == 1)
+    {
+        /* Send the manifest as an additional file. This must take place before ending the extracted FS dump. */
+        success = usbSendFileProperties(manifest->sb.length, manifest_path);
+
+        for(size_t offset = 0, blksize = BLOCK_SIZE; success && offset < manifest->sb.length; offset += blksize)
+        {
+            if (blksize > (manifest->sb.length - offset)) blksize = (manifest->sb.length - offset);
+            success = usbSendFileData(manifest->sb.data + offset, blksize);
+        }
+    } else {
+        if ((fp = fopen(manifest_path, "wb")) != NULL)
+        {
+            success = (fwrite(manifest->sb.data, 1, manifest->sb.length, fp) == manifest->sb.length);
+            fclose(fp);
+            if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+        }
+    }
+
+    if (success)
+    {
+        consolePrint("checksums saved to \"%s\"\n", manifest_path);
+    } else {
+        consolePrint("failed to save checksum manifest to \"%s\"!\n", manifest_path);
+    }
+
+    return success;
+}
+
 static void rawHfsReadThreadFunc(void *arg)
 {
     void *buf1 = NULL, *buf2 = NULL;
@@ -4871,6 +5366,9 @@ static void rawHfsReadThreadFunc(void *arg)
         /* Wake up the write thread to continue writing data. */
         mutexUnlock(&g_fileMutex);
         condvarWakeAll(&g_writeCondvar);
+
+        /* Check hashed regions covered by the current chunk while the write thread takes care of it. */
+        if (hfs_thread_data->verify_hashes) hfsUpdateHashVerifier(&(hfs_thread_data->verifier), buf2, blksize, hfs_ctx->offset + offset);
     }
 
 end:
@@ -4882,19 +5380,19 @@ end:
 
 static void extractedHfsReadThreadFunc(void *arg)
 {
-    void *buf1 = NULL, *buf2 = NULL;
+    void *buf1 = NULL, *buf2 = NULL, *tmp_buf = NULL;
     HfsThreadData *hfs_thread_data = (HfsThreadData*)arg;
     SharedThreadData *shared_thread_data = &(hfs_thread_data->shared_thread_data);
 
     HashFileSystemContext *hfs_ctx = hfs_thread_data->hfs_ctx;
     u32 hfs_entry_count = hfsGetEntryCount(hfs_ctx);
 
+    HashFileSystemReadPlan read_plan = {0};
+    ExtractedFsManifest *manifest = &(hfs_thread_data->manifest);
+
     char hfs_path[FS_MAX_PATH] = {0}, *filename = NULL;
     size_t filename_len = 0;
 
-    HashFileSystemEntry *hfs_entry = NULL;
-    char *hfs_entry_name = NULL;
-
     u64 free_space = 0;
     u32 dev_idx = g_storageMenuElementOption.selected;
 
@@ -4911,6 +5409,14 @@ static void extractedHfsReadThreadFunc(void *arg)
         goto end;
     }
 
+    /* Generate read plan. This lets us extract the whole partition using large, sequential gamecard reads instead of issuing separate read requests for each entry. */
+    if (!hfsGenerateReadPlan(hfs_ctx, &read_plan))
+    {
+        consolePrint("failed to generate hfs read plan\n");
+        shared_thread_data->read_error = true;
+        goto end;
+    }
+
     if (dev_idx != 1)
     {
         if (!utilsGetFileSystemStatsByPath(filename, NULL, &free_space))
@@ -4938,145 +5444,80 @@ static void extractedHfsReadThreadFunc(void *arg)
         goto end;
     }
 
-    /* Loop through all file entries. */
-    for(u32 i = 0; i < hfs_entry_count; i++)
+    /* Create all empty files first. They aren't covered by any read run. */
+    for(u32 i = 0; i < read_plan.empty_entry_count; i++)
     {
         /* Check if the transfer has been cancelled by the user. */
-        if (shared_thread_data->transfer_cancelled)
-        {
-            condvarWakeAll(&g_writeCondvar);
-            break;
-        }
+        if (shared_thread_data->transfer_cancelled) break;
 
-        if (dev_idx != 1)
-        {
-            /* Wait until the previous data chunk has been written */
-            mutexLock(&g_fileMutex);
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
-            mutexUnlock(&g_fileMutex);
+        if (!extractedHfsOpenOutputFile(hfs_thread_data, read_plan.entries[i].entry_idx, hfs_path, filename, filename_len, dev_idx)) break;
+    }
 
-            if (shared_thread_data->write_error) break;
+    /* Loop through all read runs. */
+    for(u32 i = 0; i < read_plan.run_count; i++)
+    {
+        if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
 
-            /* Close file. */
-            if (shared_thread_data->fp)
-            {
-                fclose(shared_thread_data->fp);
-                shared_thread_data->fp = NULL;
-                if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
-            }
-        }
+        HashFileSystemReadRun *read_run = &(read_plan.runs[i]);
+        u32 cur_entry = read_run->entry_start, run_entry_end = (read_run->entry_start + read_run->entry_count);
 
-        /* Retrieve Hash FS file entry information. */
-        shared_thread_data->read_error = ((hfs_entry = hfsGetEntryByIndex(hfs_ctx, i)) == NULL || (hfs_entry_name = hfsGetEntryName(hfs_ctx, hfs_entry)) == NULL);
-        if (shared_thread_data->read_error)
+        for(u64 offset = 0, blksize = BLOCK_SIZE; offset < read_run->size; offset += blksize)
         {
-            condvarWakeAll(&g_writeCondvar);
-            break;
-        }
-
-        /* Generate output path. */
-        snprintf(hfs_path, MAX_ELEMENTS(hfs_path), "%s/%s", filename, hfs_entry_name);
-        utilsReplaceIllegalCharacters(hfs_path + filename_len + 1, dev_idx == 0);
+            if (blksize > (read_run->size - offset)) blksize = (read_run->size - offset);
 
-        if (dev_idx == 1)
-        {
-            /* Wait until the previous data chunk has been written */
-            mutexLock(&g_fileMutex);
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
-            mutexUnlock(&g_fileMutex);
+            u64 chunk_start = (read_run->offset + offset), chunk_end = (chunk_start + blksize);
 
-            if (shared_thread_data->write_error) break;
+            /* Check if the transfer has been cancelled by the user. */
+            if (shared_thread_data->transfer_cancelled) break;
 
-            /* Send current file properties */
-            shared_thread_data->read_error = !usbSendFileProperties(hfs_entry->size, hfs_path);
-        } else {
-            /* Create directory tree. */
-            utilsCreateDirectoryTree(hfs_path, false);
+            /* Read current data chunk. It may hold data from multiple entries. */
+            shared_thread_data->read_error = !hfsReadPartitionData(hfs_ctx, buf1, blksize, chunk_start);
+            if (shared_thread_data->read_error) break;
 
-            if (dev_idx == 0)
+            /* Hand off every entry data segment covered by the current chunk to the write thread, in order. */
+            while(cur_entry < run_entry_end)
             {
-                /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
-                if (hfs_entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(hfs_path))
-                {
-                    consolePrint("failed to create concatenation file for \"%s\"!\n", hfs_path);
-                    shared_thread_data->read_error = true;
-                }
-            } else {
-                /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
-                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && hfs_entry->size > FAT32_FILESIZE_LIMIT)
-                {
-                    consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
-                    shared_thread_data->read_error = true;
-                }
-            }
+                HashFileSystemReadPlanEntry *plan_entry = &(read_plan.entries[cur_entry]);
+                u64 entry_end = (plan_entry->offset + plan_entry->size);
 
-            if (!shared_thread_data->read_error)
-            {
-                /* Open output file. */
-                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(hfs_path, "wb")) == NULL);
-                if (!shared_thread_data->read_error)
+                if (plan_entry->offset >= chunk_end) break;
+
+                u64 segment_start = MAX(plan_entry->offset, chunk_start), segment_end = MIN(entry_end, chunk_end);
+
+                /* Open the output file for this entry if its data starts within the current chunk. */
+                if (segment_start == plan_entry->offset)
                 {
-                    /* Set file size. */
-                    setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
-                    ftruncate(fileno(shared_thread_data->fp), (off_t)hfs_entry->size);
-                } else {
-                    consolePrint("failed to open \"%s\" for writing!\n", hfs_path);
+                    if (!extractedHfsOpenOutputFile(hfs_thread_data, plan_entry->entry_idx, hfs_path, filename, filename_len, dev_idx)) break;
+                    extractedFsManifestStartEntry(manifest);
                 }
-            }
-        }
 
-        if (shared_thread_data->read_error)
-        {
-            condvarWakeAll(&g_writeCondvar);
-            break;
-        }
-
-        for(u64 offset = 0, blksize = BLOCK_SIZE; offset < hfs_entry->size; offset += blksize)
-        {
-            if (blksize > (hfs_entry->size - offset)) blksize = (hfs_entry->size - offset);
-
-            /* Check if the transfer has been cancelled by the user. */
-            if (shared_thread_data->transfer_cancelled)
-            {
-                condvarWakeAll(&g_writeCondvar);
-                break;
-            }
+                u8 *segment_data = ((u8*)buf1 + (segment_start - chunk_start));
+                if (!extractedHfsQueueDataChunk(shared_thread_data, segment_data, segment_end - segment_start)) break;
 
-            /* Read current file data chunk. */
-            shared_thread_data->read_error = !hfsReadEntryData(hfs_ctx, hfs_entry, buf1, blksize, offset);
-            if (shared_thread_data->read_error)
-            {
-                condvarWakeAll(&g_writeCondvar);
-                break;
-            }
+                /* Update checksums while the write thread takes care of this segment. */
+                extractedFsManifestUpdateEntry(manifest, segment_data, segment_end - segment_start);
+                if (hfs_thread_data->verify_hashes) hfsUpdateHashVerifier(&(hfs_thread_data->verifier), segment_data, segment_end - segment_start, hfs_ctx->offset + segment_start);
 
-            /* Wait until the previous file data chunk has been written. */
-            mutexLock(&g_fileMutex);
+                /* Bail out if this entry continues in the next chunk. */
+                if (segment_end < entry_end) break;
 
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+                shared_thread_data->read_error = !extractedFsManifestFinishEntry(manifest, hfs_path + filename_len + 1);
+                if (shared_thread_data->read_error) break;
 
-            if (shared_thread_data->write_error)
-            {
-                mutexUnlock(&g_fileMutex);
-                break;
+                cur_entry++;
             }
 
-            /* Update shared object. */
-            shared_thread_data->data = buf1;
-            shared_thread_data->data_size = blksize;
+            if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
 
-            /* Swap buffers. */
+            /* Swap buffers. The write thread may still be writing the last segment from the current chunk. */
+            tmp_buf = buf1;
             buf1 = buf2;
-            buf2 = shared_thread_data->data;
-
-            /* Wake up the write thread to continue writing data. */
-            mutexUnlock(&g_fileMutex);
-            condvarWakeAll(&g_writeCondvar);
+            buf2 = tmp_buf;
         }
-
-        if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
     }
 
+    if (shared_thread_data->read_error || shared_thread_data->transfer_cancelled) condvarWakeAll(&g_writeCondvar);
+
     if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
     {
         /* Wait until the previous file data chunk has been written. */
@@ -5084,6 +5525,12 @@ static void extractedHfsReadThreadFunc(void *arg)
         if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
         mutexUnlock(&g_fileMutex);
 
+        /* Save checksum manifest. A failed manifest transfer leaves the USB host in an inconsistent state, so it's treated as an error. */
+        if (!extractedFsManifestSave(manifest, filename, dev_idx) && dev_idx == 1) shared_thread_data->read_error = true;
+    }
+
+    if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
+    {
         if (dev_idx == 1) usbEndExtractedFsDump();
 
         consolePrint("successfully saved extracted hfs partition data to \"%s\"\n", filename);
@@ -5103,6 +5550,10 @@ end:
         }
     }
 
+    hfsFreeReadPlan(&read_plan);
+
+    stringBuilderFree(&(manifest->sb));
+
     if (filename) free(filename);
 
     if (buf2) free(buf2);
@@ -5111,6 +5562,105 @@ end:
     threadExit();
 }
 
+static bool extractedHfsOpenOutputFile(HfsThreadData *hfs_thread_data, u32 entry_idx, char *hfs_path, const char *filename, size_t filename_len, u32 dev_idx)
+{
+    SharedThreadData *shared_thread_data = &(hfs_thread_data->shared_thread_data);
+    HashFileSystemContext *hfs_ctx = hfs_thread_data->hfs_ctx;
+
+    HashFileSystemEntry *hfs_entry = NULL;
+    char *hfs_entry_name = NULL;
+
+    /* Wait until the previous data chunk has been written. */
+    mutexLock(&g_fileMutex);
+    if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+    mutexUnlock(&g_fileMutex);
+
+    if (shared_thread_data->write_error) return false;
+
+    /* Close file. */
+    if (dev_idx != 1 && shared_thread_data->fp)
+    {
+        fclose(shared_thread_data->fp);
+        shared_thread_data->fp = NULL;
+        if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+    }
+
+    /* Retrieve Hash FS file entry information. */
+    shared_thread_data->read_error = ((hfs_entry = hfsGetEntryByIndex(hfs_ctx, entry_idx)) == NULL || (hfs_entry_name = hfsGetEntryName(hfs_ctx, hfs_entry)) == NULL);
+    if (shared_thread_data->read_error) return false;
+
+    /* Generate output path. */
+    snprintf(hfs_path, FS_MAX_PATH, "%s/%s", filename, hfs_entry_name);
+    utilsReplaceIllegalCharacters(hfs_path + filename_len + 1, dev_idx == 0);
+
+    if (dev_idx == 1)
+    {
+        /* Send current file properties */
+        shared_thread_data->read_error = !usbSendFileProperties(hfs_entry->size, hfs_path);
+        return !shared_thread_data->read_error;
+    }
+
+    /* Create directory tree. */
+    utilsCreateDirectoryTree(hfs_path, false);
+
+    if (dev_idx == 0)
+    {
+        /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
+        if (hfs_entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(hfs_path))
+        {
+            consolePrint("failed to create concatenation file for \"%s\"!\n", hfs_path);
+            shared_thread_data->read_error = true;
+        }
+    } else {
+        /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
+        if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && hfs_entry->size > FAT32_FILESIZE_LIMIT)
+        {
+            consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
+            shared_thread_data->read_error = true;
+        }
+    }
+
+    if (!shared_thread_data->read_error)
+    {
+        /* Open output file. */
+        shared_thread_data->read_error = ((shared_thread_data->fp = fopen(hfs_path, "wb")) == NULL);
+        if (!shared_thread_data->read_error)
+        {
+            /* Set file size. */
+            setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
+            ftruncate(fileno(shared_thread_data->fp), (off_t)hfs_entry->size);
+        } else {
+            consolePrint("failed to open \"%s\" for writing!\n", hfs_path);
+        }
+    }
+
+    return !shared_thread_data->read_error;
+}
+
+static bool extractedHfsQueueDataChunk(SharedThreadData *shared_thread_data, void *data, size_t data_size)
+{
+    /* Wait until the previous data chunk has been written. */
+    mutexLock(&g_fileMutex);
+
+    if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+
+    if (shared_thread_data->write_error)
+    {
+        mutexUnlock(&g_fileMutex);
+        return false;
+    }
+
+    /* Update shared object. */
+    shared_thread_data->data = data;
+    shared_thread_data->data_size = data_size;
+
+    /* Wake up the write thread to continue writing data. */
+    mutexUnlock(&g_fileMutex);
+    condvarWakeAll(&g_writeCondvar);
+
+    return true;
+}
+
 static void ncaReadThreadFunc(void *arg)
 {
     void *buf1 = NULL, *buf2 = NULL;
@@ -5251,7 +5801,7 @@ end:
 
 static void extractedPartitionFsReadThreadFunc(void *arg)
 {
-    void *buf1 = NULL, *buf2 = NULL;
+    void *buf1 = NULL, *buf2 = NULL, *window_buf = NULL;
     PfsThreadData *pfs_thread_data = (PfsThreadData*)arg;
     SharedThreadData *shared_thread_data = &(pfs_thread_data->shared_thread_data);
 
@@ -5264,17 +5814,24 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
     PartitionFileSystemEntry *pfs_entry = NULL;
     char *pfs_entry_name = NULL;
 
+    ExtractedFsManifest *manifest = &(pfs_thread_data->manifest);
+
     NcaFsSectionContext *nca_fs_ctx = pfs_ctx->nca_fs_ctx;
     NcaContext *nca_ctx = nca_fs_ctx->nca_ctx;
 
     u64 title_id = nca_ctx->title_id;
     u8 title_type = nca_ctx->title_type;
 
+    /* Read-ahead window over the Partition FS data region. Offsets are relative to the start of the data region. */
+    /* File data is read in large sequential blocks and split into output files in memory, instead of issuing a separate aligned read for each file. */
+    u64 data_region_size = (pfs_ctx->size - pfs_ctx->header_size), window_offset = 0, window_size = 0;
+
     u64 free_space = 0;
     u32 dev_idx = g_storageMenuElementOption.selected;
 
     buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
     buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    window_buf = malloc(BLOCK_SIZE);
 
     if (pfs_thread_data->use_layeredfs_dir)
     {
@@ -5293,7 +5850,7 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
 
     filename_len = (filename ? strlen(filename) : 0);
 
-    if (!shared_thread_data->total_size || !pfs_entry_count || !buf1 || !buf2 || !filename)
+    if (!shared_thread_data->total_size || !pfs_entry_count || !buf1 || !buf2 || !window_buf || !filename)
     {
         shared_thread_data->read_error = true;
         goto end;
@@ -5419,9 +5976,20 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
             break;
         }
 
-        for(u64 offset = 0, blksize = BLOCK_SIZE; offset < pfs_entry->size; offset += blksize)
+        extractedFsManifestStartEntry(manifest);
+
+        /* Safety check. */
+        if (pfs_entry->offset > data_region_size || pfs_entry->size > (data_region_size - pfs_entry->offset))
+        {
+            consolePrint("partitionfs entry \"%s\" exceeds data region boundaries!\n", pfs_entry_name);
+            shared_thread_data->read_error = true;
+            condvarWakeAll(&g_writeCondvar);
+            break;
+        }
+
+        for(u64 offset = 0, blksize = 0; offset < pfs_entry->size; offset += blksize)
         {
-            if (blksize > (pfs_entry->size - offset)) blksize = (pfs_entry->size - offset);
+            u64 data_offset = (pfs_entry->offset + offset);
 
             /* Check if the transfer has been cancelled by the user. */
             if (shared_thread_data->transfer_cancelled)
@@ -5430,14 +5998,25 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
                 break;
             }
 
-            /* Read current file data chunk. */
-            shared_thread_data->read_error = !pfsReadEntryData(pfs_ctx, pfs_entry, buf1, blksize, offset);
-            if (shared_thread_data->read_error)
+            /* Refill the read-ahead window if the current file data chunk isn't within it. */
+            /* Entries are usually stored back-to-back, so this results in a single sequential pass over the whole data region. */
+            if (data_offset < window_offset || data_offset >= (window_offset + window_size))
             {
-                condvarWakeAll(&g_writeCondvar);
-                break;
+                window_offset = data_offset;
+                window_size = MIN(BLOCK_SIZE, data_region_size - window_offset);
+
+                shared_thread_data->read_error = !pfsReadPartitionData(pfs_ctx, window_buf, window_size, pfs_ctx->header_size + window_offset);
+                if (shared_thread_data->read_error)
+                {
+                    condvarWakeAll(&g_writeCondvar);
+                    break;
+                }
             }
 
+            /* Split current file data chunk from the read-ahead window. */
+            blksize = MIN(pfs_entry->size - offset, window_offset + window_size - data_offset);
+            memcpy(buf1, (u8*)window_buf + (data_offset - window_offset), blksize);
+
             /* Wait until the previous file data chunk has been written. */
             mutexLock(&g_fileMutex);
 
@@ -5460,9 +6039,23 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
             /* Wake up the write thread to continue writing data. */
             mutexUnlock(&g_fileMutex);
             condvarWakeAll(&g_writeCondvar);
+
+            /* Update checksums while the write thread takes care of this chunk. */
+            extractedFsManifestUpdateEntry(manifest, buf2, blksize);
         }
 
         if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
+
+        /* Empty files are left out of the checksum manifest. */
+        if (pfs_entry->size)
+        {
+            shared_thread_data->read_error = !extractedFsManifestFinishEntry(manifest, pfs_path + filename_len + 1);
+            if (shared_thread_data->read_error)
+            {
+                condvarWakeAll(&g_writeCondvar);
+                break;
+            }
+        }
     }
 
     if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
@@ -5472,6 +6065,12 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
         if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
         mutexUnlock(&g_fileMutex);
 
+        /* Save checksum manifest. A failed manifest transfer leaves the USB host in an inconsistent state, so it's treated as an error. */
+        if (!extractedFsManifestSave(manifest, filename, dev_idx) && dev_idx == 1) shared_thread_data->read_error = true;
+    }
+
+    if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
+    {
         if (dev_idx == 1) usbEndExtractedFsDump();
 
         consolePrint("successfully saved extracted partitionfs section data to \"%s\"\n", filename);
@@ -5491,8 +6090,11 @@ end:
         }
     }
 
+    stringBuilderFree(&(manifest->sb));
+
     if (filename) free(filename);
 
+    if (window_buf) free(window_buf);
     if (buf2) free(buf2);
     if (buf1) free(buf1);
 
@@ -5529,8 +6131,23 @@ static void rawRomFsReadThreadFunc(void *arg)
             break;
         }
 
+        /* Check if the current data chunk is zero-filled. If so, there's no need to read it. USB hosts still need to receive the actual data. */
+        bool zero_filled = false;
+        shared_thread_data->read_error = !romfsIsFileSystemDataZeroFilled(romfs_ctx, offset, blksize, &zero_filled);
+
         /* Read current data chunk */
-        shared_thread_data->read_error = !romfsReadFileSystemData(romfs_ctx, buf1, blksize, offset);
+        if (!shared_thread_data->read_error)
+        {
+            if (!zero_filled)
+            {
+                shared_thread_data->read_error = !romfsReadFileSystemData(romfs_ctx, buf1, blksize, offset);
+            } else
+            if (useUsbHost())
+            {
+                memset(buf1, 0, blksize);
+            }
+        }
+
         if (shared_thread_data->read_error)
         {
             condvarWakeAll(&g_writeCondvar);
@@ -5551,6 +6168,7 @@ static void rawRomFsReadThreadFunc(void *arg)
         /* Update shared object. */
         shared_thread_data->data = buf1;
         shared_thread_data->data_size = blksize;
+        shared_thread_data->data_zero_filled = (zero_filled && !useUsbHost());
 
         /* Swap buffers. */
         buf1 = buf2;
@@ -5578,14 +6196,13 @@ static void extractedRomFsReadThreadFunc(void *arg)
     RomFileSystemFileEntry *romfs_file_entry = NULL;
     u64 cur_entry_offset = 0;
 
-    char romfs_path[FS_MAX_PATH] = {0}, subdir[0x20] = {0}, *filename = NULL;
-    size_t filename_len = 0;
+    u32 *read_plan = NULL, read_plan_count = 0, read_plan_idx = 0;
 
-    NcaFsSectionContext *nca_fs_ctx = romfs_ctx->default_storage_ctx->nca_fs_ctx;
-    NcaContext *nca_ctx = nca_fs_ctx->nca_ctx;
+    RomFileSystemPathMemo path_memo = {0};
+    char romfs_path[FS_MAX_PATH] = {0}, *filename = NULL;
+    size_t filename_len = 0;
 
-    u64 title_id = nca_ctx->title_id;
-    u8 title_type = nca_ctx->title_type;
+    ExtractedFsManifest *manifest = &(romfs_thread_data->manifest);
 
     u64 free_space = 0;
     u32 dev_idx = g_storageMenuElementOption.selected;
@@ -5594,21 +6211,9 @@ static void extractedRomFsReadThreadFunc(void *arg)
     buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
     buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
 
-    if (romfs_thread_data->use_layeredfs_dir)
-    {
-        /* Only use base title IDs if we're dealing with patches. */
-        title_id = (title_type == NcmContentMetaType_Patch ? titleGetApplicationIdByPatchId(title_id) : \
-                   (title_type == NcmContentMetaType_DataPatch ? titleGetAddOnContentIdByDataPatchId(title_id) : title_id));
-
-        filename = generateOutputLayeredFsFileName(title_id + nca_ctx->id_offset, NULL, "romfs");
-    } else {
-        snprintf(subdir, MAX_ELEMENTS(subdir), NCA_FS_SUBDIR "/%s/Extracted", nca_ctx->storage_id == NcmStorageId_BuiltInSystem ? "System" : "User");
-        snprintf(romfs_path, MAX_ELEMENTS(romfs_path), "/%s #%u/%u", titleGetNcmContentTypeName(nca_ctx->content_type), nca_ctx->id_offset, nca_fs_ctx->section_idx);
-
-        TitleInfo *title_info = (title_id == g_ncaUserTitleInfo->meta_key.id ? g_ncaUserTitleInfo : g_ncaBasePatchTitleInfo);
-        filename = generateOutputTitleFileName(title_info, subdir, romfs_path);
-    }
+    romfsInitializePathMemo(&path_memo);
 
+    filename = generateExtractedRomFsOutputPath(romfs_thread_data);
     filename_len = (filename ? strlen(filename) : 0);
 
     if (!shared_thread_data->total_size || !buf1 || !buf2 || !filename)
@@ -5640,6 +6245,20 @@ static void extractedRomFsReadThreadFunc(void *arg)
         }
     }
 
+    /* Read file entries sorted by their physical offsets if we're not dealing with a USB host, in order to keep the read stream as sequential as possible. */
+    /* All output files are created beforehand in file entries table order. USB hosts create files as they receive them, so we just stick to table order for them. */
+    if (!shared_thread_data->read_error && dev_idx != 1)
+    {
+        if (!romfsGenerateFileEntryReadPlan(romfs_ctx, romfs_thread_data->only_updated, &read_plan, &read_plan_count))
+        {
+            consolePrint("failed to generate romfs read plan\n");
+            shared_thread_data->read_error = true;
+        } else {
+            shared_thread_data->read_error = !extractedRomFsCreateOutputFiles(romfs_ctx, romfs_thread_data->only_updated, romfs_path, sizeof(romfs_path), filename_len, \
+                                                                              romfs_illegal_char_replace_type, dev_idx);
+        }
+    }
+
     if (shared_thread_data->read_error)
     {
         condvarWakeAll(&g_writeCondvar);
@@ -5647,8 +6266,11 @@ static void extractedRomFsReadThreadFunc(void *arg)
     }
 
     /* Loop through all file entries. */
-    while(shared_thread_data->data_written < shared_thread_data->total_size && cur_entry_offset < romfs_ctx->file_table_size)
+    while(shared_thread_data->data_written < shared_thread_data->total_size && (read_plan ? read_plan_idx < read_plan_count : cur_entry_offset < romfs_ctx->file_table_size))
     {
+        /* Get the offset for the current file entry from the read plan, if available. */
+        if (read_plan) cur_entry_offset = read_plan[read_plan_idx];
+
         /* Check if the transfer has been cancelled by the user. */
         if (shared_thread_data->transfer_cancelled)
         {
@@ -5674,9 +6296,34 @@ static void extractedRomFsReadThreadFunc(void *arg)
             }
         }
 
-        /* Retrieve RomFS file entry information and generate output path. */
-        shared_thread_data->read_error = (!(romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, cur_entry_offset)) || \
-                                           !romfsGeneratePathFromFileEntry(romfs_ctx, romfs_file_entry, romfs_path + filename_len, sizeof(romfs_path) - filename_len, romfs_illegal_char_replace_type));
+        /* Retrieve RomFS file entry information. */
+        shared_thread_data->read_error = !(romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, cur_entry_offset));
+        if (shared_thread_data->read_error)
+        {
+            condvarWakeAll(&g_writeCondvar);
+            break;
+        }
+
+        /* Skip file entries that haven't been updated, if needed. The read plan already excludes them. */
+        bool skipped = false;
+        if (!read_plan)
+        {
+            shared_thread_data->read_error = !extractedRomFsIsFileEntrySkipped(romfs_ctx, romfs_thread_data->only_updated, romfs_file_entry, &skipped);
+            if (shared_thread_data->read_error)
+            {
+                condvarWakeAll(&g_writeCondvar);
+                break;
+            }
+        }
+
+        if (skipped)
+        {
+            cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+            continue;
+        }
+
+        /* Generate output path. */
+        shared_thread_data->read_error = !romfsGeneratePathFromFileEntryWithMemo(romfs_ctx, romfs_file_entry, &path_memo, romfs_path + filename_len, sizeof(romfs_path) - filename_len, romfs_illegal_char_replace_type);
         if (shared_thread_data->read_error)
         {
             condvarWakeAll(&g_writeCondvar);
@@ -5695,38 +6342,13 @@ static void extractedRomFsReadThreadFunc(void *arg)
             /* Send current file properties */
             shared_thread_data->read_error = !usbSendFileProperties(romfs_file_entry->size, romfs_path);
         } else {
-            /* Create directory tree. */
-            utilsCreateDirectoryTree(romfs_path, false);
-
-            if (dev_idx == 0)
-            {
-                /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
-                if (romfs_file_entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(romfs_path))
-                {
-                    consolePrint("failed to create concatenation file for \"%s\"!\n", romfs_path);
-                    shared_thread_data->read_error = true;
-                }
-            } else {
-                /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
-                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && romfs_file_entry->size > FAT32_FILESIZE_LIMIT)
-                {
-                    consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
-                    shared_thread_data->read_error = true;
-                }
-            }
-
+            /* Open output file. It has already been created with the right size. */
+            shared_thread_data->read_error = ((shared_thread_data->fp = fopen(romfs_path, "r+b")) == NULL);
             if (!shared_thread_data->read_error)
             {
-                /* Open output file. */
-                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(romfs_path, "wb")) == NULL);
-                if (!shared_thread_data->read_error)
-                {
-                    /* Set file size. */
-                    setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
-                    ftruncate(fileno(shared_thread_data->fp), (off_t)romfs_file_entry->size);
-                } else {
-                    consolePrint("failed to open \"%s\" for writing!\n", romfs_path);
-                }
+                setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
+            } else {
+                consolePrint("failed to open \"%s\" for writing!\n", romfs_path);
             }
         }
 
@@ -5736,6 +6358,8 @@ static void extractedRomFsReadThreadFunc(void *arg)
             break;
         }
 
+        extractedFsManifestStartEntry(manifest);
+
         for(u64 offset = 0, blksize = BLOCK_SIZE; offset < romfs_file_entry->size; offset += blksize)
         {
             if (blksize > (romfs_file_entry->size - offset)) blksize = (romfs_file_entry->size - offset);
@@ -5747,8 +6371,22 @@ static void extractedRomFsReadThreadFunc(void *arg)
                 break;
             }
 
+            /* Check if the current file data chunk is zero-filled. If so, there's no need to read it. */
+            /* The buffer is still cleared, since the checksum manifest needs to be updated with the actual data. */
+            bool zero_filled = false;
+            shared_thread_data->read_error = !romfsIsFileEntryDataZeroFilled(romfs_ctx, romfs_file_entry, offset, blksize, &zero_filled);
+
             /* Read current file data chunk. */
-            shared_thread_data->read_error = !romfsReadFileEntryData(romfs_ctx, romfs_file_entry, buf1, blksize, offset);
+            if (!shared_thread_data->read_error)
+            {
+                if (!zero_filled)
+                {
+                    shared_thread_data->read_error = !romfsReadFileEntryData(romfs_ctx, romfs_file_entry, buf1, blksize, offset);
+                } else {
+                    memset(buf1, 0, blksize);
+                }
+            }
+
             if (shared_thread_data->read_error)
             {
                 condvarWakeAll(&g_writeCondvar);
@@ -5766,9 +6404,10 @@ static void extractedRomFsReadThreadFunc(void *arg)
                 break;
             }
 
-            /* Update shared object. */
+            /* Update shared object. Output files have already been created with the right size. */
             shared_thread_data->data = buf1;
             shared_thread_data->data_size = blksize;
+            shared_thread_data->data_zero_filled = (zero_filled && dev_idx != 1);
 
             /* Swap buffers. */
             buf1 = buf2;
@@ -5777,12 +6416,31 @@ static void extractedRomFsReadThreadFunc(void *arg)
             /* Wake up the write thread to continue writing data. */
             mutexUnlock(&g_fileMutex);
             condvarWakeAll(&g_writeCondvar);
+
+            /* Update checksums while the write thread takes care of this chunk. */
+            extractedFsManifestUpdateEntry(manifest, buf2, blksize);
         }
 
         if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
 
+        /* Empty files are left out of the checksum manifest. */
+        if (romfs_file_entry->size)
+        {
+            shared_thread_data->read_error = !extractedFsManifestFinishEntry(manifest, romfs_path + filename_len + 1);
+            if (shared_thread_data->read_error)
+            {
+                condvarWakeAll(&g_writeCondvar);
+                break;
+            }
+        }
+
         /* Get the offset for the next file entry. */
-        cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+        if (read_plan)
+        {
+            read_plan_idx++;
+        } else {
+            cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+        }
     }
 
     if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
@@ -5792,8 +6450,16 @@ static void extractedRomFsReadThreadFunc(void *arg)
         if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
         mutexUnlock(&g_fileMutex);
 
+        /* Save checksum manifest. A failed manifest transfer leaves the USB host in an inconsistent state, so it's treated as an error. */
+        if (!extractedFsManifestSave(manifest, filename, dev_idx) && dev_idx == 1) shared_thread_data->read_error = true;
+    }
+
+    if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
+    {
         if (dev_idx == 1) usbEndExtractedFsDump();
 
+        if (romfs_thread_data->only_updated) extractedRomFsWriteSkippedFilesManifest(romfs_thread_data, filename, romfs_illegal_char_replace_type, dev_idx);
+
         consolePrint("successfully saved extracted romfs section data to \"%s\"\n", filename);
         consoleRefresh();
     }
@@ -5811,6 +6477,10 @@ end:
         }
     }
 
+    stringBuilderFree(&(manifest->sb));
+
+    if (read_plan) free(read_plan);
+
     if (filename) free(filename);
 
     if (buf2) free(buf2);
@@ -5819,432 +6489,782 @@ end:
     threadExit();
 }
 
-static void fsBrowserFileReadThreadFunc(void *arg)
+static bool extractedRomFsCreateOutputFiles(RomFileSystemContext *romfs_ctx, bool only_updated, char *romfs_path, size_t romfs_path_size, size_t filename_len, u8 romfs_illegal_char_replace_type, u32 dev_idx)
 {
-    void *buf1 = NULL, *buf2 = NULL;
-    FsBrowserFileThreadData *fs_browser_thread_data = (FsBrowserFileThreadData*)arg;
-    SharedThreadData *shared_thread_data = &(fs_browser_thread_data->shared_thread_data);
-    FILE *src = fs_browser_thread_data->src;
+    RomFileSystemFileEntry *romfs_file_entry = NULL;
+    RomFileSystemPathMemo path_memo = {0};
+    u64 cur_entry_offset = 0;
+    FILE *fp = NULL;
+    bool success = true;
 
-    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-
-    if (!shared_thread_data->total_size || !src || !buf1 || !buf2)
-    {
-        shared_thread_data->read_error = true;
-        goto end;
-    }
+    romfsInitializePathMemo(&path_memo);
 
-    shared_thread_data->data = NULL;
-    shared_thread_data->data_size = 0;
-
-    for(u64 offset = 0, blksize = BLOCK_SIZE; offset < shared_thread_data->total_size; offset += blksize)
+    /* Loop through all file entries in table order. */
+    while(cur_entry_offset < romfs_ctx->file_table_size)
     {
-        if (blksize > (shared_thread_data->total_size - offset)) blksize = (shared_thread_data->total_size - offset);
+        bool skipped = false;
 
-        /* Check if the transfer has been cancelled by the user */
-        if (shared_thread_data->transfer_cancelled)
+        /* Retrieve RomFS file entry information. Skip file entries that haven't been updated, if needed. */
+        if (!(romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, cur_entry_offset)) || !extractedRomFsIsFileEntrySkipped(romfs_ctx, only_updated, romfs_file_entry, &skipped))
         {
-            condvarWakeAll(&g_writeCondvar);
+            consolePrint("failed to retrieve romfs file entry at offset 0x%lX!\n", cur_entry_offset);
+            success = false;
             break;
         }
 
-        /* Read current data chunk */
-        shared_thread_data->read_error = (fread(buf1, 1, blksize, src) != blksize);
-        if (shared_thread_data->read_error)
+        if (skipped)
         {
-            condvarWakeAll(&g_writeCondvar);
+            cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+            continue;
+        }
+
+        /* Generate output path. */
+        if (!romfsGeneratePathFromFileEntryWithMemo(romfs_ctx, romfs_file_entry, &path_memo, romfs_path + filename_len, romfs_path_size - filename_len, romfs_illegal_char_replace_type))
+        {
+            consolePrint("failed to generate output path for romfs file entry at offset 0x%lX!\n", cur_entry_offset);
+            success = false;
             break;
         }
 
-        /* Wait until the previous data chunk has been written */
-        mutexLock(&g_fileMutex);
+        /* Create directory tree. */
+        utilsCreateDirectoryTree(romfs_path, false);
 
-        if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+        if (dev_idx == 0)
+        {
+            /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
+            if (romfs_file_entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(romfs_path))
+            {
+                consolePrint("failed to create concatenation file for \"%s\"!\n", romfs_path);
+                success = false;
+                break;
+            }
+        } else {
+            /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
+            if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && romfs_file_entry->size > FAT32_FILESIZE_LIMIT)
+            {
+                consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
+                success = false;
+                break;
+            }
+        }
 
-        if (shared_thread_data->write_error)
+        /* Create output file and set its size. */
+        if (!(fp = fopen(romfs_path, "wb")))
         {
-            mutexUnlock(&g_fileMutex);
+            consolePrint("failed to open \"%s\" for writing!\n", romfs_path);
+            success = false;
             break;
         }
 
-        /* Update shared object. */
-        shared_thread_data->data = buf1;
-        shared_thread_data->data_size = blksize;
+        ftruncate(fileno(fp), (off_t)romfs_file_entry->size);
+        fclose(fp);
+        fp = NULL;
 
-        /* Swap buffers. */
-        buf1 = buf2;
-        buf2 = shared_thread_data->data;
+        /* Get the offset for the next file entry. */
+        cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+    }
 
-        /* Wake up the write thread to continue writing data. */
-        mutexUnlock(&g_fileMutex);
-        condvarWakeAll(&g_writeCondvar);
+    if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+
+    return success;
+}
+
+static bool extractedRomFsIsFileEntrySkipped(RomFileSystemContext *romfs_ctx, bool only_updated, RomFileSystemFileEntry *romfs_file_entry, bool *out)
+{
+    bool updated = false;
+
+    *out = false;
+    if (!only_updated) return true;
+
+    /* Empty file entries aren't backed by any data, so they're always skipped. They're still listed in the skipped files manifest. */
+    if (!romfs_file_entry->size)
+    {
+        *out = true;
+        return true;
     }
 
-end:
-    if (buf2) free(buf2);
-    if (buf1) free(buf1);
+    if (!romfsIsFileEntryUpdated(romfs_ctx, romfs_file_entry, &updated)) return false;
 
-    threadExit();
+    *out = !updated;
+
+    return true;
 }
 
-static void fsBrowserHighlightedEntriesReadThreadFunc(void *arg)
+static void extractedRomFsWriteSkippedFilesManifest(RomFsThreadData *romfs_thread_data, const char *base_path, u8 romfs_illegal_char_replace_type, u32 dev_idx)
 {
-    void *buf1 = NULL, *buf2 = NULL;
-    FsBrowserHighlightedEntriesThreadData *fs_browser_thread_data = (FsBrowserHighlightedEntriesThreadData*)arg;
-    SharedThreadData *shared_thread_data = &(fs_browser_thread_data->shared_thread_data);
+    RomFileSystemContext *romfs_ctx = romfs_thread_data->romfs_ctx;
+    RomFileSystemFileEntry *romfs_file_entry = NULL;
+    RomFileSystemPathMemo path_memo = {0};
+    u64 cur_entry_offset = 0;
+    u32 skipped_count = 0;
 
-    const char *dir_path = fs_browser_thread_data->dir_path;
-    const FsBrowserEntry *entries = fs_browser_thread_data->entries;
-    u32 entries_count = fs_browser_thread_data->entries_count;
-    const char *base_out_path = fs_browser_thread_data->base_out_path;
+    char manifest_path[FS_MAX_PATH] = {0}, romfs_path[FS_MAX_PATH] = {0};
+    FILE *fp = NULL;
 
-    u32 dev_idx = g_storageMenuElementOption.selected;
+    /* USB hosts only receive the extracted files. */
+    if (dev_idx == 1) return;
 
-    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    /* The manifest is stored right next to the output directory, so it doesn't end up as part of a LayeredFS RomFS. */
+    snprintf(manifest_path, MAX_ELEMENTS(manifest_path), "%s_skipped_files.txt", base_path);
 
-    if (!shared_thread_data->total_size || !dir_path || !*dir_path || !entries || !entries_count || !base_out_path || !*base_out_path || !buf1 || !buf2)
+    if (!(fp = fopen(manifest_path, "wb")))
     {
-        shared_thread_data->read_error = true;
-        goto end;
+        consolePrint("failed to open \"%s\" for writing!\n", manifest_path);
+        return;
     }
 
-    if (dev_idx != 1)
+    romfsInitializePathMemo(&path_memo);
+
+    /* List all skipped file entries in table order. Their data is read from the base RomFS, so they're not needed by LayeredFS mods. */
+    while(cur_entry_offset < romfs_ctx->file_table_size)
     {
-        u64 free_space = 0;
+        bool skipped = false;
 
-        if (!utilsGetFileSystemStatsByPath(base_out_path, NULL, &free_space))
+        if (!(romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, cur_entry_offset)) || \
+            !extractedRomFsIsFileEntrySkipped(romfs_ctx, true, romfs_file_entry, &skipped) || \
+            (skipped && !romfsGeneratePathFromFileEntryWithMemo(romfs_ctx, romfs_file_entry, &path_memo, romfs_path, sizeof(romfs_path), romfs_illegal_char_replace_type)))
         {
-            consolePrint("failed to retrieve free space from selected device\n");
-            shared_thread_data->read_error = true;
+            consolePrint("failed to generate skipped files manifest entry for romfs file entry at offset 0x%lX!\n", cur_entry_offset);
+            break;
         }
 
-        if (!shared_thread_data->read_error && shared_thread_data->total_size >= free_space)
-        {
-            consolePrint("dump size exceeds free space\n");
-            shared_thread_data->read_error = true;
-        }
-    } else {
-        if (!usbStartExtractedFsDump(shared_thread_data->total_size, base_out_path))
+        if (skipped)
         {
-            consolePrint("failed to send extracted fs info to host\n");
-            shared_thread_data->read_error = true;
+            fprintf(fp, "%s\r\n", romfs_path);
+            skipped_count++;
         }
+
+        cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
     }
 
-    if (!shared_thread_data->read_error)
-    {
-        /* Dump highlighted entries. */
-        fsBrowserHighlightedEntriesReadThreadLoop(shared_thread_data, dir_path, entries, entries_count, base_out_path, buf1, buf2);
+    fclose(fp);
 
-        if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
-        {
-            if (dev_idx == 1) usbEndExtractedFsDump();
+    if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
 
-            consolePrint("successfully saved dumped data to \"%s\"\n", base_out_path);
-            consoleRefresh();
-        }
+    consolePrint("%u skipped file(s) listed in \"%s\"\n", skipped_count, manifest_path);
+}
+
+static char *generateExtractedRomFsOutputPath(RomFsThreadData *romfs_thread_data)
+{
+    RomFileSystemContext *romfs_ctx = romfs_thread_data->romfs_ctx;
+    NcaFsSectionContext *nca_fs_ctx = romfs_ctx->default_storage_ctx->nca_fs_ctx;
+    NcaContext *nca_ctx = nca_fs_ctx->nca_ctx;
+
+    char romfs_path[FS_MAX_PATH] = {0}, subdir[0x20] = {0}, *filename = NULL;
+
+    u64 title_id = nca_ctx->title_id;
+    u8 title_type = nca_ctx->title_type;
+
+    if (romfs_thread_data->use_layeredfs_dir)
+    {
+        /* Only use base title IDs if we're dealing with patches. */
+        title_id = (title_type == NcmContentMetaType_Patch ? titleGetApplicationIdByPatchId(title_id) : \
+                   (title_type == NcmContentMetaType_DataPatch ? titleGetAddOnContentIdByDataPatchId(title_id) : title_id));
+
+        filename = generateOutputLayeredFsFileName(title_id + nca_ctx->id_offset, NULL, "romfs");
     } else {
-        condvarWakeAll(&g_writeCondvar);
+        snprintf(subdir, MAX_ELEMENTS(subdir), NCA_FS_SUBDIR "/%s/Extracted", nca_ctx->storage_id == NcmStorageId_BuiltInSystem ? "System" : "User");
+        snprintf(romfs_path, MAX_ELEMENTS(romfs_path), "/%s #%u/%u", titleGetNcmContentTypeName(nca_ctx->content_type), nca_ctx->id_offset, nca_fs_ctx->section_idx);
+
+        TitleInfo *title_info = (title_id == g_ncaUserTitleInfo->meta_key.id ? g_ncaUserTitleInfo : g_ncaBasePatchTitleInfo);
+        filename = generateOutputTitleFileName(title_info, subdir, romfs_path);
     }
 
-end:
-    if (buf2) free(buf2);
-    if (buf1) free(buf1);
+    return filename;
+}
 
-    threadExit();
+static bool extractedRomFsAllocateArena(ExtractedRomFsArena **out)
+{
+    ExtractedRomFsArena *arena = NULL;
+
+    if (!(arena = calloc(1, sizeof(ExtractedRomFsArena))) || !(arena->data = malloc(EXTRACTED_ROMFS_SLOT_SIZE * EXTRACTED_ROMFS_SLOT_COUNT)))
+    {
+        consolePrint("failed to allocate extracted romfs arena, falling back to a single writer thread\n");
+        extractedRomFsFreeArena(arena);
+        return false;
+    }
+
+    /* All slots start out as free. */
+    for(u32 i = 0; i < EXTRACTED_ROMFS_SLOT_COUNT; i++)
+    {
+        arena->slots[i].buf = (arena->data + (i * EXTRACTED_ROMFS_SLOT_SIZE));
+        arena->free_slots[i] = i;
+    }
+
+    arena->free_slot_count = EXTRACTED_ROMFS_SLOT_COUNT;
+
+    *out = arena;
+
+    return true;
 }
 
-static bool fsBrowserHighlightedEntriesReadThreadLoop(SharedThreadData *shared_thread_data, const char *dir_path, const FsBrowserEntry *entries, u32 entries_count, const char *base_out_path, void *buf1, void *buf2)
+static void extractedRomFsFreeArena(ExtractedRomFsArena *arena)
 {
-    bool append_path_sep = (dir_path[strlen(dir_path) - 1] != '/');
+    if (!arena) return;
+
+    if (arena->base_path) free(arena->base_path);
+    if (arena->data) free(arena->data);
+
+    free(arena);
+}
+
+static void extractedRomFsBatchReadThreadFunc(void *arg)
+{
+    RomFsThreadData *romfs_thread_data = (RomFsThreadData*)arg;
+    SharedThreadData *shared_thread_data = &(romfs_thread_data->shared_thread_data);
+    ExtractedRomFsArena *arena = romfs_thread_data->arena;
+
+    RomFileSystemContext *romfs_ctx = romfs_thread_data->romfs_ctx;
+    RomFileSystemFileEntry *romfs_file_entry = NULL;
+
+    u32 *read_plan = NULL, read_plan_count = 0;
+
+    ExtractedRomFsSlot *slot = NULL, *batch_slot = NULL;
+    u32 slot_idx = 0, batch_slot_idx = 0, writer_idx = 0, next_writer_idx = 0;
+
+    RomFileSystemPathMemo path_memo = {0};
+    char romfs_path[FS_MAX_PATH] = {0};
+
+    ExtractedFsManifest *manifest = &(romfs_thread_data->manifest);
+
+    u64 free_space = 0;
     u32 dev_idx = g_storageMenuElementOption.selected;
-    bool is_topmost = (entries && entries_count); /* If entry data is provided, it means we're dealing with the topmost directory. */
-    const char *dir_path_start = (strchr(dir_path, '/') + 1);
 
-    char *tmp_path = NULL;
-    FILE *src = NULL;
+    arena->base_path = generateExtractedRomFsOutputPath(romfs_thread_data);
+    arena->base_path_len = (arena->base_path ? strlen(arena->base_path) : 0);
+    arena->illegal_char_replace_type = (dev_idx != 0 ? RomFileSystemPathIllegalCharReplaceType_IllegalFsChars : RomFileSystemPathIllegalCharReplaceType_KeepAsciiCharsOnly);
 
-    /* Allocate memory for our temporary path. */
-    tmp_path = calloc(sizeof(char), FS_MAX_PATH);
-    if ((shared_thread_data->read_error = (tmp_path == NULL)))
+    romfsInitializePathMemo(&path_memo);
+
+    if (!shared_thread_data->total_size || !arena->base_path)
     {
-        consolePrint("failed to allocate memory for path!\n");
-        condvarWakeAll(&g_writeCondvar);
+        shared_thread_data->read_error = true;
         goto end;
     }
 
-    /* Get directory entries, if needed. */
-    if (!is_topmost && (shared_thread_data->read_error = !fsBrowserGetDirEntries(dir_path, (FsBrowserEntry**)&entries, &entries_count)))
+    snprintf(romfs_path, MAX_ELEMENTS(romfs_path), "%s", arena->base_path);
+
+    if (!utilsGetFileSystemStatsByPath(arena->base_path, NULL, &free_space))
     {
-        condvarWakeAll(&g_writeCondvar);
+        consolePrint("failed to retrieve free space from selected device\n");
+        shared_thread_data->read_error = true;
         goto end;
     }
 
-    /* Loop through all highlighted entries. */
-    for(u32 i = 0; i < entries_count; i++)
+    if (shared_thread_data->total_size >= free_space)
     {
-        /* Get current entry. */
-        const FsBrowserEntry *entry = &(entries[i]);
-        if (is_topmost && !entry->highlight) continue;
+        consolePrint("dump size exceeds free space\n");
+        shared_thread_data->read_error = true;
+        goto end;
+    }
 
-        /* Check if the transfer has been cancelled by the user. */
-        if (shared_thread_data->transfer_cancelled)
+    /* Generate read plan and create all output files beforehand. Writer threads only take care of writing file data. */
+    if (!romfsGenerateFileEntryReadPlan(romfs_ctx, romfs_thread_data->only_updated, &read_plan, &read_plan_count))
+    {
+        consolePrint("failed to generate romfs read plan\n");
+        shared_thread_data->read_error = true;
+        goto end;
+    }
+
+    if (!extractedRomFsCreateOutputFiles(romfs_ctx, romfs_thread_data->only_updated, romfs_path, sizeof(romfs_path), arena->base_path_len, arena->illegal_char_replace_type, dev_idx))
+    {
+        shared_thread_data->read_error = true;
+        goto end;
+    }
+
+    /* Loop through all file entries. */
+    for(u32 i = 0; i < read_plan_count; i++)
+    {
+        /* Check if the transfer has been cancelled by the user or if a writer thread failed. */
+        if (shared_thread_data->transfer_cancelled || shared_thread_data->write_error) break;
+
+        /* Retrieve RomFS file entry information. */
+        if (!(romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, read_plan[i])))
         {
-            condvarWakeAll(&g_writeCondvar);
+            consolePrint("failed to retrieve romfs file entry at offset 0x%X!\n", read_plan[i]);
+            shared_thread_data->read_error = true;
             break;
         }
 
-        if (dev_idx != 1)
+        /* Empty files have already been created. They're also left out of the checksum manifest. */
+        if (!romfs_file_entry->size) continue;
+
+        /* Generate the relative path for the checksum manifest. */
+        if (!romfsGeneratePathFromFileEntryWithMemo(romfs_ctx, romfs_file_entry, &path_memo, romfs_path + arena->base_path_len, sizeof(romfs_path) - arena->base_path_len, arena->illegal_char_replace_type))
         {
-            /* Wait until the previous data chunk has been written */
-            mutexLock(&g_fileMutex);
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
-            mutexUnlock(&g_fileMutex);
+            consolePrint("failed to generate path for romfs file entry at offset 0x%X!\n", read_plan[i]);
+            shared_thread_data->read_error = true;
+            break;
+        }
 
-            if (shared_thread_data->write_error) break;
+        extractedFsManifestStartEntry(manifest);
 
-            /* Close file. */
-            if (shared_thread_data->fp)
+        if (romfs_file_entry->size <= EXTRACTED_ROMFS_SMALL_FILE_SIZE)
+        {
+            /* Queue the current batch slot if it can't hold this file. */
+            if (batch_slot && (batch_slot->segment_count >= EXTRACTED_ROMFS_SLOT_MAX_SEGMENTS || romfs_file_entry->size > (EXTRACTED_ROMFS_SLOT_SIZE - batch_slot->buf_used)))
             {
-                fclose(shared_thread_data->fp);
-                shared_thread_data->fp = NULL;
-                if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+                extractedRomFsQueueSlot(arena, batch_slot_idx, next_writer_idx);
+                next_writer_idx = ((next_writer_idx + 1) % EXTRACTED_ROMFS_WRITER_COUNT);
+                batch_slot = NULL;
             }
-        }
 
-        /* Generate input path. */
-        snprintf(tmp_path, FS_MAX_PATH, "%s%s%s", dir_path, append_path_sep ? "/" : "", entry->dt.d_name);
+            if (!batch_slot && !(batch_slot = extractedRomFsAcquireSlot(romfs_thread_data, &batch_slot_idx))) break;
+
+            /* Read file data right into the batch slot. */
+            ExtractedRomFsSegment *segment = &(batch_slot->segments[batch_slot->segment_count]);
+
+            if (!romfsReadFileEntryData(romfs_ctx, romfs_file_entry, batch_slot->buf + batch_slot->buf_used, romfs_file_entry->size, 0))
+            {
+                shared_thread_data->read_error = true;
+                break;
+            }
+
+            segment->file_entry_offset = read_plan[i];
+            segment->buf_offset = (u32)batch_slot->buf_used;
+            segment->size = (u32)romfs_file_entry->size;
+
+            batch_slot->buf_used += romfs_file_entry->size;
+            batch_slot->segment_count++;
+
+            /* The batch slot is queued later on, so writer threads are kept busy with previously queued slots in the meantime. */
+            extractedFsManifestUpdateEntry(manifest, batch_slot->buf + segment->buf_offset, segment->size);
+
+            shared_thread_data->read_error = !extractedFsManifestFinishEntry(manifest, romfs_path + arena->base_path_len + 1);
+            if (shared_thread_data->read_error) break;
 
-        if (entry->dt.d_type == DT_DIR)
-        {
-            /* Dump directory. */
-            if (!fsBrowserHighlightedEntriesReadThreadLoop(shared_thread_data, tmp_path, NULL, 0, base_out_path, buf1, buf2)) break;
             continue;
         }
 
-        /* Open input file. */
-        src = fopen(tmp_path, "rb");
-        if ((shared_thread_data->read_error = (src == NULL)))
-        {
-            consolePrint("failed to open file \"%s\" for reading!\n", tmp_path);
-            condvarWakeAll(&g_writeCondvar);
-            break;
-        }
+        /* Bigger files are split into slot-sized chunks, all of them queued to the same writer thread. */
+        writer_idx = next_writer_idx;
+        next_writer_idx = ((next_writer_idx + 1) % EXTRACTED_ROMFS_WRITER_COUNT);
 
-        setvbuf(src, NULL, _IONBF, 0);
-
-        /* Generate output path. */
-        if (*dir_path_start)
+        for(u64 offset = 0, blksize = EXTRACTED_ROMFS_SLOT_SIZE; offset < romfs_file_entry->size; offset += blksize)
         {
-            snprintf(tmp_path, FS_MAX_PATH, "%s/%s/%s", base_out_path, dir_path_start, entry->dt.d_name);
-        } else {
-            snprintf(tmp_path, FS_MAX_PATH, "%s/%s", base_out_path, entry->dt.d_name);
+            if (blksize > (romfs_file_entry->size - offset)) blksize = (romfs_file_entry->size - offset);
+
+            if (!(slot = extractedRomFsAcquireSlot(romfs_thread_data, &slot_idx))) break;
+
+            /* Read current file data chunk. */
+            if (!romfsReadFileEntryData(romfs_ctx, romfs_file_entry, slot->buf, blksize, offset))
+            {
+                shared_thread_data->read_error = true;
+                break;
+            }
+
+            slot->segments[0].file_entry_offset = read_plan[i];
+            slot->segments[0].buf_offset = 0;
+            slot->segments[0].size = (u32)blksize;
+
+            slot->buf_used = blksize;
+            slot->segment_count = 1;
+
+            extractedRomFsQueueSlot(arena, slot_idx, writer_idx);
+
+            /* Update checksums while the writer thread takes care of this chunk. Released slots are only reused once this thread acquires them again. */
+            extractedFsManifestUpdateEntry(manifest, slot->buf, blksize);
         }
 
-        if (dev_idx == 1)
+        if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
+
+        shared_thread_data->read_error = !extractedFsManifestFinishEntry(manifest, romfs_path + arena->base_path_len + 1);
+        if (shared_thread_data->read_error) break;
+    }
+
+    /* Queue the last batch slot. */
+    if (batch_slot && !shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled) extractedRomFsQueueSlot(arena, batch_slot_idx, next_writer_idx);
+
+end:
+    /* Let writer threads know no more slots will be queued. */
+    mutexLock(&g_fileMutex);
+    arena->read_done = true;
+    mutexUnlock(&g_fileMutex);
+    condvarWakeAll(&g_writeCondvar);
+
+    if (read_plan) free(read_plan);
+
+    threadExit();
+}
+
+static void extractedRomFsBatchWriteThreadFunc(void *arg)
+{
+    RomFsThreadData *romfs_thread_data = (RomFsThreadData*)arg;
+    SharedThreadData *shared_thread_data = &(romfs_thread_data->shared_thread_data);
+    ExtractedRomFsArena *arena = romfs_thread_data->arena;
+
+    Thread writer_threads[EXTRACTED_ROMFS_WRITER_COUNT - 1] = {0};
+    ExtractedRomFsWriterData writer_data[EXTRACTED_ROMFS_WRITER_COUNT - 1] = {0};
+    u32 writer_thread_count = 0, dev_idx = g_storageMenuElementOption.selected;
+
+    /* Spawn additional writer threads. The first writer runs on this thread. */
+    for(u32 i = 0; i < (EXTRACTED_ROMFS_WRITER_COUNT - 1); i++)
+    {
+        writer_data[i].romfs_thread_data = romfs_thread_data;
+        writer_data[i].writer_idx = (i + 1);
+
+        if (!utilsCreateThread(&(writer_threads[i]), extractedRomFsWriterThreadFunc, &(writer_data[i]), 1))
         {
-            /* Wait until the previous data chunk has been written */
+            consolePrint("failed to create writer thread #%u\n", i + 1);
+
             mutexLock(&g_fileMutex);
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+            shared_thread_data->write_error = true;
             mutexUnlock(&g_fileMutex);
 
-            if (shared_thread_data->write_error) break;
+            condvarWakeAll(&g_readCondvar);
+            condvarWakeAll(&g_writeCondvar);
+            break;
+        }
 
-            /* Send current file properties */
-            shared_thread_data->read_error = !usbSendFileProperties(entry->size, tmp_path);
-        } else {
-            /* Create directory tree. */
-            utilsCreateDirectoryTree(tmp_path, false);
+        writer_thread_count++;
+    }
 
-            if (dev_idx == 0)
-            {
-                /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
-                if (entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(tmp_path))
-                {
-                    consolePrint("failed to create concatenation file for \"%s\"!\n", tmp_path);
-                    shared_thread_data->read_error = true;
-                }
-            } else {
-                /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
-                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && entry->size > FAT32_FILESIZE_LIMIT)
-                {
-                    consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
-                    shared_thread_data->read_error = true;
-                }
-            }
+    if (!shared_thread_data->write_error) extractedRomFsWriterLoop(romfs_thread_data, 0);
 
-            if (!shared_thread_data->read_error)
-            {
-                /* Open output file. */
-                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(tmp_path, "wb")) == NULL);
-                if (!shared_thread_data->read_error)
-                {
-                    /* Set file size. */
-                    setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
-                    ftruncate(fileno(shared_thread_data->fp), (off_t)entry->size);
-                } else {
-                    consolePrint("failed to open \"%s\" for writing!\n", tmp_path);
-                }
-            }
-        }
+    for(u32 i = 0; i < writer_thread_count; i++) joinDumpThread(&(writer_threads[i]), getDumpThreadWriteStage());
 
-        if (shared_thread_data->read_error)
+    /* Wait until the read thread is done before touching the output directory. */
+    mutexLock(&g_fileMutex);
+    while(!arena->read_done) condvarWait(&g_writeCondvar, &g_fileMutex);
+    mutexUnlock(&g_fileMutex);
+
+    if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled)
+    {
+        if (arena->base_path) utilsDeleteDirectoryRecursively(arena->base_path);
+    } else {
+        /* The checksum manifest is no longer touched by the read thread at this point. */
+        extractedFsManifestSave(&(romfs_thread_data->manifest), arena->base_path, dev_idx);
+
+        if (romfs_thread_data->only_updated) extractedRomFsWriteSkippedFilesManifest(romfs_thread_data, arena->base_path, arena->illegal_char_replace_type, dev_idx);
+
+        consolePrint("successfully saved extracted romfs section data to \"%s\"\n", arena->base_path);
+        consoleRefresh();
+    }
+
+    if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+
+    stringBuilderFree(&(romfs_thread_data->manifest.sb));
+
+    threadExit();
+}
+
+static void extractedRomFsWriterThreadFunc(void *arg)
+{
+    ExtractedRomFsWriterData *writer_data = (ExtractedRomFsWriterData*)arg;
+    extractedRomFsWriterLoop(writer_data->romfs_thread_data, writer_data->writer_idx);
+    threadExit();
+}
+
+static void extractedRomFsWriterLoop(RomFsThreadData *romfs_thread_data, u32 writer_idx)
+{
+    SharedThreadData *shared_thread_data = &(romfs_thread_data->shared_thread_data);
+    ExtractedRomFsArena *arena = romfs_thread_data->arena;
+    RomFileSystemContext *romfs_ctx = romfs_thread_data->romfs_ctx;
+
+    RomFileSystemFileEntry *romfs_file_entry = NULL;
+    ExtractedRomFsSlot *slot = NULL;
+    u32 slot_idx = 0, cur_file_entry_offset = 0;
+
+    RomFileSystemPathMemo path_memo = {0};
+    char romfs_path[FS_MAX_PATH] = {0};
+    FILE *fp = NULL;
+    bool write_error = false;
+
+    romfsInitializePathMemo(&path_memo);
+
+    while(true)
+    {
+        /* Wait until a slot has been queued to this writer. */
+        mutexLock(&g_fileMutex);
+
+        while(!arena->queue_counts[writer_idx] && !arena->read_done && !shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled) condvarWait(&g_writeCondvar, &g_fileMutex);
+
+        if (!arena->queue_counts[writer_idx] || shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled)
         {
-            condvarWakeAll(&g_writeCondvar);
+            mutexUnlock(&g_fileMutex);
             break;
         }
 
-        /* Dump file. */
-        for(u64 offset = 0, blksize = BLOCK_SIZE; offset < entry->size; offset += blksize)
+        slot_idx = arena->queues[writer_idx][arena->queue_heads[writer_idx]];
+        arena->queue_heads[writer_idx] = ((arena->queue_heads[writer_idx] + 1) % EXTRACTED_ROMFS_SLOT_COUNT);
+        arena->queue_counts[writer_idx]--;
+
+        mutexUnlock(&g_fileMutex);
+
+        slot = &(arena->slots[slot_idx]);
+
+        /* Write all segments from this slot. */
+        for(u32 i = 0; i < slot->segment_count && !write_error; i++)
         {
-            if (blksize > (entry->size - offset)) blksize = (entry->size - offset);
+            ExtractedRomFsSegment *segment = &(slot->segments[i]);
 
-            /* Check if the transfer has been cancelled by the user. */
-            if (shared_thread_data->transfer_cancelled)
+            /* Open the output file, unless we're writing the next chunk from the current one. Output files have already been created with the right size. */
+            if (!fp || segment->file_entry_offset != cur_file_entry_offset)
             {
-                condvarWakeAll(&g_writeCondvar);
-                break;
-            }
+                if (fp)
+                {
+                    fclose(fp);
+                    fp = NULL;
+                }
 
-            /* Read current file data chunk. */
-            shared_thread_data->read_error = (fread(buf1, 1, blksize, src) != blksize);
-            if (shared_thread_data->read_error)
-            {
-                condvarWakeAll(&g_writeCondvar);
-                break;
-            }
+                snprintf(romfs_path, MAX_ELEMENTS(romfs_path), "%s", arena->base_path);
 
-            /* Wait until the previous file data chunk has been written. */
-            mutexLock(&g_fileMutex);
+                if (!(romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, segment->file_entry_offset)) || \
+                    !romfsGeneratePathFromFileEntryWithMemo(romfs_ctx, romfs_file_entry, &path_memo, romfs_path + arena->base_path_len, sizeof(romfs_path) - arena->base_path_len, arena->illegal_char_replace_type))
+                {
+                    consolePrint("failed to generate output path for romfs file entry at offset 0x%X!\n", segment->file_entry_offset);
+                    write_error = true;
+                    break;
+                }
 
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+                if (!(fp = fopen(romfs_path, "r+b")))
+                {
+                    consolePrint("failed to open \"%s\" for writing!\n", romfs_path);
+                    write_error = true;
+                    break;
+                }
 
-            if (shared_thread_data->write_error)
-            {
-                mutexUnlock(&g_fileMutex);
-                break;
+                setvbuf(fp, NULL, _IONBF, 0);
+                cur_file_entry_offset = segment->file_entry_offset;
             }
 
-            /* Update shared object. */
-            shared_thread_data->data = buf1;
-            shared_thread_data->data_size = blksize;
+            write_error = (fwrite(slot->buf + segment->buf_offset, 1, segment->size, fp) != segment->size);
+        }
 
-            /* Swap buffers. */
-            buf1 = buf2;
-            buf2 = shared_thread_data->data;
+        /* Release slot. */
+        mutexLock(&g_fileMutex);
 
-            /* Wake up the write thread to continue writing data. */
-            mutexUnlock(&g_fileMutex);
-            condvarWakeAll(&g_writeCondvar);
+        if (write_error)
+        {
+            shared_thread_data->write_error = true;
+        } else {
+            shared_thread_data->data_written += slot->buf_used;
         }
 
-        /* Close input file. */
-        fclose(src);
-        src = NULL;
-
-        if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
-    }
+        arena->free_slots[arena->free_slot_count++] = slot_idx;
 
-    if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
-    {
-        /* Wait until the previous file data chunk has been written. */
-        mutexLock(&g_fileMutex);
-        if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
         mutexUnlock(&g_fileMutex);
-    }
 
-end:
-    if (shared_thread_data->fp)
-    {
-        fclose(shared_thread_data->fp);
-        shared_thread_data->fp = NULL;
+        /* Wake up the read thread to continue reading data. */
+        condvarWakeAll(&g_readCondvar);
 
-        if ((shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) && dev_idx != 1)
-        {
-            utilsDeleteDirectoryRecursively(base_out_path);
-            if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
-        }
+        if (write_error) break;
     }
 
-    if (src) fclose(src);
+    if (fp) fclose(fp);
 
-    if (!is_topmost && entries) free((FsBrowserEntry*)entries);
+    /* Make sure nobody is left waiting on a writer thread that has exited. */
+    condvarWakeAll(&g_readCondvar);
+    condvarWakeAll(&g_writeCondvar);
+}
 
-    if (tmp_path) free(tmp_path);
+static ExtractedRomFsSlot *extractedRomFsAcquireSlot(RomFsThreadData *romfs_thread_data, u32 *out_slot_idx)
+{
+    SharedThreadData *shared_thread_data = &(romfs_thread_data->shared_thread_data);
+    ExtractedRomFsArena *arena = romfs_thread_data->arena;
+    ExtractedRomFsSlot *slot = NULL;
 
-    return !shared_thread_data->read_error;
+    /* Wait until a slot has been released by a writer thread. */
+    mutexLock(&g_fileMutex);
+
+    while(!arena->free_slot_count && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled) condvarWait(&g_readCondvar, &g_fileMutex);
+
+    if (arena->free_slot_count && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
+    {
+        *out_slot_idx = arena->free_slots[--arena->free_slot_count];
+        slot = &(arena->slots[*out_slot_idx]);
+        slot->buf_used = 0;
+        slot->segment_count = 0;
+    }
+
+    mutexUnlock(&g_fileMutex);
+
+    return slot;
 }
 
-static void systemUpdateReadThreadFunc(void *arg)
+static void extractedRomFsQueueSlot(ExtractedRomFsArena *arena, u32 slot_idx, u32 writer_idx)
 {
-    void *buf1 = NULL, *buf2 = NULL;
-    SystemUpdateThreadData *sys_upd_thread_data = (SystemUpdateThreadData*)arg;
-    SharedThreadData *shared_thread_data = &(sys_upd_thread_data->shared_thread_data);
+    mutexLock(&g_fileMutex);
 
-    SystemUpdateDumpContext *sys_upd_dump_ctx = sys_upd_thread_data->sys_upd_dump_ctx;
+    u32 queue_idx = ((arena->queue_heads[writer_idx] + arena->queue_counts[writer_idx]) % EXTRACTED_ROMFS_SLOT_COUNT);
+    arena->queues[writer_idx][queue_idx] = slot_idx;
+    arena->queue_counts[writer_idx]++;
 
-    char sys_upd_path[FS_MAX_PATH] = {0}, *filename = NULL;
-    size_t filename_len = 0;
+    mutexUnlock(&g_fileMutex);
 
-    u64 free_space = 0;
-    u32 dev_idx = g_storageMenuElementOption.selected;
+    /* Wake up writer threads. */
+    condvarWakeAll(&g_writeCondvar);
+}
 
-    u64 nca_filesize = 0;
-    char *nca_filename = NULL;
+static void fsBrowserFileReadThreadFunc(void *arg)
+{
+    void *buf1 = NULL, *buf2 = NULL;
+    FsBrowserFileThreadData *fs_browser_thread_data = (FsBrowserFileThreadData*)arg;
+    SharedThreadData *shared_thread_data = &(fs_browser_thread_data->shared_thread_data);
+    FILE *src = fs_browser_thread_data->src;
 
     buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
     buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
 
-    snprintf(sys_upd_path, MAX_ELEMENTS(sys_upd_path), "/%.*s (%s)", (int)sizeof(sys_upd_dump_ctx->version_file.display_title),
-                                                                     sys_upd_dump_ctx->version_file.display_title, utilsIsDevelopmentUnit() ? "Dev" : "Prod");
-    filename = generateOutputGameCardFileName(SYSTEM_UPDATE_SUBDIR, sys_upd_path, false);
-    filename_len = (filename ? strlen(filename) : 0);
-
-    if (!shared_thread_data->total_size || !buf1 || !buf2 || !filename)
+    if (!shared_thread_data->total_size || !src || !buf1 || !buf2)
     {
         shared_thread_data->read_error = true;
         goto end;
     }
 
-    utilsReplaceIllegalCharacters(strrchr(filename, '/') + 1, dev_idx == 0);
+    shared_thread_data->data = NULL;
+    shared_thread_data->data_size = 0;
 
-    if (dev_idx != 1)
+    for(u64 offset = 0, blksize = BLOCK_SIZE; offset < shared_thread_data->total_size; offset += blksize)
     {
-        if (!utilsGetFileSystemStatsByPath(filename, NULL, &free_space))
+        if (blksize > (shared_thread_data->total_size - offset)) blksize = (shared_thread_data->total_size - offset);
+
+        /* Check if the transfer has been cancelled by the user */
+        if (shared_thread_data->transfer_cancelled)
         {
-            consolePrint("failed to retrieve free space from selected device\n");
-            shared_thread_data->read_error = true;
+            condvarWakeAll(&g_writeCondvar);
+            break;
         }
 
-        if (!shared_thread_data->read_error && shared_thread_data->total_size >= free_space)
+        /* Read current data chunk */
+        shared_thread_data->read_error = (fread(buf1, 1, blksize, src) != blksize);
+        if (shared_thread_data->read_error)
         {
-            consolePrint("dump size exceeds free space\n");
-            shared_thread_data->read_error = true;
+            condvarWakeAll(&g_writeCondvar);
+            break;
         }
-    } else {
-        if (!usbStartExtractedFsDump(shared_thread_data->total_size, filename))
-        {
-            consolePrint("failed to send extracted fs info to host\n");
-            shared_thread_data->read_error = true;
+
+        /* Wait until the previous data chunk has been written */
+        mutexLock(&g_fileMutex);
+
+        if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+
+        if (shared_thread_data->write_error)
+        {
+            mutexUnlock(&g_fileMutex);
+            break;
         }
+
+        /* Update shared object. */
+        shared_thread_data->data = buf1;
+        shared_thread_data->data_size = blksize;
+
+        /* Swap buffers. */
+        buf1 = buf2;
+        buf2 = shared_thread_data->data;
+
+        /* Wake up the write thread to continue writing data. */
+        mutexUnlock(&g_fileMutex);
+        condvarWakeAll(&g_writeCondvar);
     }
 
-    if (shared_thread_data->read_error)
+end:
+    if (buf2) free(buf2);
+    if (buf1) free(buf1);
+
+    threadExit();
+}
+
+static void fsBrowserHighlightedEntriesReadThreadFunc(void *arg)
+{
+    void *buf1 = NULL, *buf2 = NULL;
+    FsBrowserHighlightedEntriesThreadData *fs_browser_thread_data = (FsBrowserHighlightedEntriesThreadData*)arg;
+    SharedThreadData *shared_thread_data = &(fs_browser_thread_data->shared_thread_data);
+
+    const char *dir_path = fs_browser_thread_data->dir_path;
+    const FsBrowserEntry *entries = fs_browser_thread_data->entries;
+    u32 entries_count = fs_browser_thread_data->entries_count;
+    const char *base_out_path = fs_browser_thread_data->base_out_path;
+
+    u32 dev_idx = g_storageMenuElementOption.selected;
+
+    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+
+    if (!shared_thread_data->total_size || !dir_path || !*dir_path || !entries || !entries_count || !base_out_path || !*base_out_path || !buf1 || !buf2)
     {
-        condvarWakeAll(&g_writeCondvar);
+        shared_thread_data->read_error = true;
         goto end;
     }
 
-    /* Loop through all file entries. */
-    while(sys_upd_dump_ctx->content_idx < sys_upd_dump_ctx->content_count)
+    if (dev_idx != 1)
     {
-        if (nca_filename)
+        u64 free_space = 0;
+
+        if (!utilsGetFileSystemStatsByPath(base_out_path, NULL, &free_space))
         {
-            free(nca_filename);
-            nca_filename = NULL;
+            consolePrint("failed to retrieve free space from selected device\n");
+            shared_thread_data->read_error = true;
+        }
+
+        if (!shared_thread_data->read_error && shared_thread_data->total_size >= free_space)
+        {
+            consolePrint("dump size exceeds free space\n");
+            shared_thread_data->read_error = true;
+        }
+    } else {
+        if (!usbStartExtractedFsDump(shared_thread_data->total_size, base_out_path))
+        {
+            consolePrint("failed to send extracted fs info to host\n");
+            shared_thread_data->read_error = true;
+        }
+    }
+
+    if (!shared_thread_data->read_error)
+    {
+        /* Dump highlighted entries. */
+        fsBrowserHighlightedEntriesReadThreadLoop(shared_thread_data, dir_path, entries, entries_count, base_out_path, buf1, buf2);
+
+        if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
+        {
+            if (dev_idx == 1) usbEndExtractedFsDump();
+
+            consolePrint("successfully saved dumped data to \"%s\"\n", base_out_path);
+            consoleRefresh();
         }
+    } else {
+        condvarWakeAll(&g_writeCondvar);
+    }
+
+end:
+    if (buf2) free(buf2);
+    if (buf1) free(buf1);
+
+    threadExit();
+}
+
+static bool fsBrowserHighlightedEntriesReadThreadLoop(SharedThreadData *shared_thread_data, const char *dir_path, const FsBrowserEntry *entries, u32 entries_count, const char *base_out_path, void *buf1, void *buf2)
+{
+    bool append_path_sep = (dir_path[strlen(dir_path) - 1] != '/');
+    u32 dev_idx = g_storageMenuElementOption.selected;
+    bool is_topmost = (entries && entries_count); /* If entry data is provided, it means we're dealing with the topmost directory. */
+    const char *dir_path_start = (strchr(dir_path, '/') + 1);
+
+    char *tmp_path = NULL;
+    FILE *src = NULL;
+
+    /* Allocate memory for our temporary path. */
+    tmp_path = calloc(sizeof(char), FS_MAX_PATH);
+    if ((shared_thread_data->read_error = (tmp_path == NULL)))
+    {
+        consolePrint("failed to allocate memory for path!\n");
+        condvarWakeAll(&g_writeCondvar);
+        goto end;
+    }
+
+    /* Get directory entries, if needed. */
+    if (!is_topmost && (shared_thread_data->read_error = !fsBrowserGetDirEntries(dir_path, (FsBrowserEntry**)&entries, &entries_count)))
+    {
+        condvarWakeAll(&g_writeCondvar);
+        goto end;
+    }
+
+    /* Loop through all highlighted entries. */
+    for(u32 i = 0; i < entries_count; i++)
+    {
+        /* Get current entry. */
+        const FsBrowserEntry *entry = &(entries[i]);
+        if (is_topmost && !entry->highlight) continue;
 
         /* Check if the transfer has been cancelled by the user. */
         if (shared_thread_data->transfer_cancelled)
@@ -6271,18 +7291,34 @@ static void systemUpdateReadThreadFunc(void *arg)
             }
         }
 
-        /* Retrieve system update content file information. */
-        shared_thread_data->read_error = (!systemUpdateGetCurrentContentFileSizeFromDumpContext(sys_upd_dump_ctx, &nca_filesize) || !nca_filesize || \
-                                          !(nca_filename = systemUpdateGetCurrentContentFileNameFromDumpContext(sys_upd_dump_ctx)));
-        if (shared_thread_data->read_error)
+        /* Generate input path. */
+        snprintf(tmp_path, FS_MAX_PATH, "%s%s%s", dir_path, append_path_sep ? "/" : "", entry->dt.d_name);
+
+        if (entry->dt.d_type == DT_DIR)
+        {
+            /* Dump directory. */
+            if (!fsBrowserHighlightedEntriesReadThreadLoop(shared_thread_data, tmp_path, NULL, 0, base_out_path, buf1, buf2)) break;
+            continue;
+        }
+
+        /* Open input file. */
+        src = fopen(tmp_path, "rb");
+        if ((shared_thread_data->read_error = (src == NULL)))
         {
+            consolePrint("failed to open file \"%s\" for reading!\n", tmp_path);
             condvarWakeAll(&g_writeCondvar);
             break;
         }
 
+        setvbuf(src, NULL, _IONBF, 0);
+
         /* Generate output path. */
-        snprintf(sys_upd_path, MAX_ELEMENTS(sys_upd_path), "%s/%s", filename, nca_filename);
-        utilsReplaceIllegalCharacters(sys_upd_path + filename_len + 1, dev_idx == 0);
+        if (*dir_path_start)
+        {
+            snprintf(tmp_path, FS_MAX_PATH, "%s/%s/%s", base_out_path, dir_path_start, entry->dt.d_name);
+        } else {
+            snprintf(tmp_path, FS_MAX_PATH, "%s/%s", base_out_path, entry->dt.d_name);
+        }
 
         if (dev_idx == 1)
         {
@@ -6294,22 +7330,22 @@ static void systemUpdateReadThreadFunc(void *arg)
             if (shared_thread_data->write_error) break;
 
             /* Send current file properties */
-            shared_thread_data->read_error = !usbSendFileProperties(nca_filesize, sys_upd_path);
+            shared_thread_data->read_error = !usbSendFileProperties(entry->size, tmp_path);
         } else {
             /* Create directory tree. */
-            utilsCreateDirectoryTree(sys_upd_path, false);
+            utilsCreateDirectoryTree(tmp_path, false);
 
             if (dev_idx == 0)
             {
                 /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
-                if (nca_filesize > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(sys_upd_path))
+                if (entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(tmp_path))
                 {
-                    consolePrint("failed to create concatenation file for \"%s\"!\n", sys_upd_path);
+                    consolePrint("failed to create concatenation file for \"%s\"!\n", tmp_path);
                     shared_thread_data->read_error = true;
                 }
             } else {
                 /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
-                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && nca_filesize > FAT32_FILESIZE_LIMIT)
+                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && entry->size > FAT32_FILESIZE_LIMIT)
                 {
                     consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
                     shared_thread_data->read_error = true;
@@ -6319,14 +7355,14 @@ static void systemUpdateReadThreadFunc(void *arg)
             if (!shared_thread_data->read_error)
             {
                 /* Open output file. */
-                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(sys_upd_path, "wb")) == NULL);
+                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(tmp_path, "wb")) == NULL);
                 if (!shared_thread_data->read_error)
                 {
                     /* Set file size. */
                     setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
-                    ftruncate(fileno(shared_thread_data->fp), (off_t)nca_filesize);
+                    ftruncate(fileno(shared_thread_data->fp), (off_t)entry->size);
                 } else {
-                    consolePrint("failed to open \"%s\" for writing!\n", sys_upd_path);
+                    consolePrint("failed to open \"%s\" for writing!\n", tmp_path);
                 }
             }
         }
@@ -6337,9 +7373,10 @@ static void systemUpdateReadThreadFunc(void *arg)
             break;
         }
 
-        for(u64 offset = 0, blksize = BLOCK_SIZE; offset < nca_filesize; offset += blksize)
+        /* Dump file. */
+        for(u64 offset = 0, blksize = BLOCK_SIZE; offset < entry->size; offset += blksize)
         {
-            if (blksize > (nca_filesize - offset)) blksize = (nca_filesize - offset);
+            if (blksize > (entry->size - offset)) blksize = (entry->size - offset);
 
             /* Check if the transfer has been cancelled by the user. */
             if (shared_thread_data->transfer_cancelled)
@@ -6349,7 +7386,7 @@ static void systemUpdateReadThreadFunc(void *arg)
             }
 
             /* Read current file data chunk. */
-            shared_thread_data->read_error = !systemUpdateReadCurrentContentFileFromDumpContext(sys_upd_dump_ctx, buf1, blksize);
+            shared_thread_data->read_error = (fread(buf1, 1, blksize, src) != blksize);
             if (shared_thread_data->read_error)
             {
                 condvarWakeAll(&g_writeCondvar);
@@ -6380,6 +7417,10 @@ static void systemUpdateReadThreadFunc(void *arg)
             condvarWakeAll(&g_writeCondvar);
         }
 
+        /* Close input file. */
+        fclose(src);
+        src = NULL;
+
         if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
     }
 
@@ -6389,18 +7430,6 @@ static void systemUpdateReadThreadFunc(void *arg)
         mutexLock(&g_fileMutex);
         if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
         mutexUnlock(&g_fileMutex);
-
-        if (dev_idx == 1) usbEndExtractedFsDump();
-
-        shared_thread_data->read_error = !systemUpdateIsDumpContextFinished(sys_upd_dump_ctx);
-        if (!shared_thread_data->read_error)
-        {
-            consolePrint("successfully saved system update data to \"%s\"\n", filename);
-        } else {
-            consolePrint("unexpected sys upd dump ctx error\n");
-        }
-
-        consoleRefresh();
     }
 
 end:
@@ -6411,44 +7440,297 @@ end:
 
         if ((shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) && dev_idx != 1)
         {
-            utilsDeleteDirectoryRecursively(filename);
+            utilsDeleteDirectoryRecursively(base_out_path);
             if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
         }
     }
 
-    if (nca_filename) free(nca_filename);
+    if (src) fclose(src);
 
-    if (filename) free(filename);
+    if (!is_topmost && entries) free((FsBrowserEntry*)entries);
 
-    if (buf2) free(buf2);
-    if (buf1) free(buf1);
+    if (tmp_path) free(tmp_path);
 
-    threadExit();
+    return !shared_thread_data->read_error;
 }
 
-static void genericWriteThreadFunc(void *arg)
+static void systemUpdateReadThreadFunc(void *arg)
 {
-    SharedThreadData *shared_thread_data = (SharedThreadData*)arg; // UB but we don't care
+    void *buf1 = NULL, *buf2 = NULL;
+    SystemUpdateThreadData *sys_upd_thread_data = (SystemUpdateThreadData*)arg;
+    SharedThreadData *shared_thread_data = &(sys_upd_thread_data->shared_thread_data);
 
-    while(shared_thread_data->data_written < shared_thread_data->total_size)
+    SystemUpdateDumpContext *sys_upd_dump_ctx = sys_upd_thread_data->sys_upd_dump_ctx;
+
+    char sys_upd_path[FS_MAX_PATH] = {0}, *filename = NULL;
+    size_t filename_len = 0;
+
+    u64 free_space = 0;
+    u32 dev_idx = g_storageMenuElementOption.selected;
+
+    u64 nca_filesize = 0;
+    char *nca_filename = NULL;
+
+    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+
+    snprintf(sys_upd_path, MAX_ELEMENTS(sys_upd_path), "/%.*s (%s)", (int)sizeof(sys_upd_dump_ctx->version_file.display_title),
+                                                                     sys_upd_dump_ctx->version_file.display_title, utilsIsDevelopmentUnit() ? "Dev" : "Prod");
+    filename = generateOutputGameCardFileName(SYSTEM_UPDATE_SUBDIR, sys_upd_path, false);
+    filename_len = (filename ? strlen(filename) : 0);
+
+    if (!shared_thread_data->total_size || !buf1 || !buf2 || !filename)
     {
-        /* Wait until the current file data chunk has been read */
-        mutexLock(&g_fileMutex);
+        shared_thread_data->read_error = true;
+        goto end;
+    }
 
-        if (!shared_thread_data->data_size && !shared_thread_data->read_error) condvarWait(&g_writeCondvar, &g_fileMutex);
+    utilsReplaceIllegalCharacters(strrchr(filename, '/') + 1, dev_idx == 0);
 
-        if (shared_thread_data->read_error || shared_thread_data->transfer_cancelled || (!useUsbHost() && !shared_thread_data->fp))
+    if (dev_idx != 1)
+    {
+        if (!utilsGetFileSystemStatsByPath(filename, NULL, &free_space))
         {
-            if (useUsbHost() && shared_thread_data->transfer_cancelled) usbCancelFileTransfer();
-            mutexUnlock(&g_fileMutex);
-            break;
+            consolePrint("failed to retrieve free space from selected device\n");
+            shared_thread_data->read_error = true;
         }
 
-        /* Write current file data chunk */
-        if (useUsbHost())
+        if (!shared_thread_data->read_error && shared_thread_data->total_size >= free_space)
         {
-            shared_thread_data->write_error = !usbSendFileData(shared_thread_data->data, shared_thread_data->data_size);
-        } else {
+            consolePrint("dump size exceeds free space\n");
+            shared_thread_data->read_error = true;
+        }
+    } else {
+        if (!usbStartExtractedFsDump(shared_thread_data->total_size, filename))
+        {
+            consolePrint("failed to send extracted fs info to host\n");
+            shared_thread_data->read_error = true;
+        }
+    }
+
+    if (shared_thread_data->read_error)
+    {
+        condvarWakeAll(&g_writeCondvar);
+        goto end;
+    }
+
+    /* Loop through all file entries. */
+    while(sys_upd_dump_ctx->content_idx < sys_upd_dump_ctx->content_count)
+    {
+        if (nca_filename)
+        {
+            free(nca_filename);
+            nca_filename = NULL;
+        }
+
+        /* Check if the transfer has been cancelled by the user. */
+        if (shared_thread_data->transfer_cancelled)
+        {
+            condvarWakeAll(&g_writeCondvar);
+            break;
+        }
+
+        if (dev_idx != 1)
+        {
+            /* Wait until the previous data chunk has been written */
+            mutexLock(&g_fileMutex);
+            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+            mutexUnlock(&g_fileMutex);
+
+            if (shared_thread_data->write_error) break;
+
+            /* Close file. */
+            if (shared_thread_data->fp)
+            {
+                fclose(shared_thread_data->fp);
+                shared_thread_data->fp = NULL;
+                if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+            }
+        }
+
+        /* Retrieve system update content file information. */
+        shared_thread_data->read_error = (!systemUpdateGetCurrentContentFileSizeFromDumpContext(sys_upd_dump_ctx, &nca_filesize) || !nca_filesize || \
+                                          !(nca_filename = systemUpdateGetCurrentContentFileNameFromDumpContext(sys_upd_dump_ctx)));
+        if (shared_thread_data->read_error)
+        {
+            condvarWakeAll(&g_writeCondvar);
+            break;
+        }
+
+        /* Generate output path. */
+        snprintf(sys_upd_path, MAX_ELEMENTS(sys_upd_path), "%s/%s", filename, nca_filename);
+        utilsReplaceIllegalCharacters(sys_upd_path + filename_len + 1, dev_idx == 0);
+
+        if (dev_idx == 1)
+        {
+            /* Wait until the previous data chunk has been written */
+            mutexLock(&g_fileMutex);
+            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+            mutexUnlock(&g_fileMutex);
+
+            if (shared_thread_data->write_error) break;
+
+            /* Send current file properties */
+            shared_thread_data->read_error = !usbSendFileProperties(nca_filesize, sys_upd_path);
+        } else {
+            /* Create directory tree. */
+            utilsCreateDirectoryTree(sys_upd_path, false);
+
+            if (dev_idx == 0)
+            {
+                /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
+                if (nca_filesize > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(sys_upd_path))
+                {
+                    consolePrint("failed to create concatenation file for \"%s\"!\n", sys_upd_path);
+                    shared_thread_data->read_error = true;
+                }
+            } else {
+                /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
+                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && nca_filesize > FAT32_FILESIZE_LIMIT)
+                {
+                    consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
+                    shared_thread_data->read_error = true;
+                }
+            }
+
+            if (!shared_thread_data->read_error)
+            {
+                /* Open output file. */
+                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(sys_upd_path, "wb")) == NULL);
+                if (!shared_thread_data->read_error)
+                {
+                    /* Set file size. */
+                    setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
+                    ftruncate(fileno(shared_thread_data->fp), (off_t)nca_filesize);
+                } else {
+                    consolePrint("failed to open \"%s\" for writing!\n", sys_upd_path);
+                }
+            }
+        }
+
+        if (shared_thread_data->read_error)
+        {
+            condvarWakeAll(&g_writeCondvar);
+            break;
+        }
+
+        for(u64 offset = 0, blksize = BLOCK_SIZE; offset < nca_filesize; offset += blksize)
+        {
+            if (blksize > (nca_filesize - offset)) blksize = (nca_filesize - offset);
+
+            /* Check if the transfer has been cancelled by the user. */
+            if (shared_thread_data->transfer_cancelled)
+            {
+                condvarWakeAll(&g_writeCondvar);
+                break;
+            }
+
+            /* Read current file data chunk. */
+            shared_thread_data->read_error = !systemUpdateReadCurrentContentFileFromDumpContext(sys_upd_dump_ctx, buf1, blksize);
+            if (shared_thread_data->read_error)
+            {
+                condvarWakeAll(&g_writeCondvar);
+                break;
+            }
+
+            /* Wait until the previous file data chunk has been written. */
+            mutexLock(&g_fileMutex);
+
+            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+
+            if (shared_thread_data->write_error)
+            {
+                mutexUnlock(&g_fileMutex);
+                break;
+            }
+
+            /* Update shared object. */
+            shared_thread_data->data = buf1;
+            shared_thread_data->data_size = blksize;
+
+            /* Swap buffers. */
+            buf1 = buf2;
+            buf2 = shared_thread_data->data;
+
+            /* Wake up the write thread to continue writing data. */
+            mutexUnlock(&g_fileMutex);
+            condvarWakeAll(&g_writeCondvar);
+        }
+
+        if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
+    }
+
+    if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
+    {
+        /* Wait until the previous file data chunk has been written. */
+        mutexLock(&g_fileMutex);
+        if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
+        mutexUnlock(&g_fileMutex);
+
+        if (dev_idx == 1) usbEndExtractedFsDump();
+
+        shared_thread_data->read_error = !systemUpdateIsDumpContextFinished(sys_upd_dump_ctx);
+        if (!shared_thread_data->read_error)
+        {
+            consolePrint("successfully saved system update data to \"%s\"\n", filename);
+        } else {
+            consolePrint("unexpected sys upd dump ctx error\n");
+        }
+
+        consoleRefresh();
+    }
+
+end:
+    if (shared_thread_data->fp)
+    {
+        fclose(shared_thread_data->fp);
+        shared_thread_data->fp = NULL;
+
+        if ((shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) && dev_idx != 1)
+        {
+            utilsDeleteDirectoryRecursively(filename);
+            if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+        }
+    }
+
+    if (nca_filename) free(nca_filename);
+
+    if (filename) free(filename);
+
+    if (buf2) free(buf2);
+    if (buf1) free(buf1);
+
+    threadExit();
+}
+
+static void genericWriteThreadFunc(void *arg)
+{
+    SharedThreadData *shared_thread_data = (SharedThreadData*)arg; // UB but we don't care
+
+    while(shared_thread_data->data_written < shared_thread_data->total_size)
+    {
+        /* Wait until the current file data chunk has been read */
+        mutexLock(&g_fileMutex);
+
+        if (!shared_thread_data->data_size && !shared_thread_data->read_error) condvarWait(&g_writeCondvar, &g_fileMutex);
+
+        if (shared_thread_data->read_error || shared_thread_data->transfer_cancelled || (!useUsbHost() && !shared_thread_data->fp))
+        {
+            if (useUsbHost() && shared_thread_data->transfer_cancelled) usbCancelFileTransfer();
+            mutexUnlock(&g_fileMutex);
+            break;
+        }
+
+        /* Write current file data chunk */
+        if (useUsbHost())
+        {
+            shared_thread_data->write_error = !usbSendFileData(shared_thread_data->data, shared_thread_data->data_size);
+        } else
+        if (shared_thread_data->data_zero_filled)
+        {
+            /* Leave a hole. The output file has already been sized, so this area reads back as zeroes. */
+            shared_thread_data->write_error = (fseek(shared_thread_data->fp, (long)shared_thread_data->data_size, SEEK_CUR) != 0);
+        } else {
             shared_thread_data->write_error = (fwrite(shared_thread_data->data, 1, shared_thread_data->data_size, shared_thread_data->fp) != shared_thread_data->data_size);
         }
 
@@ -6456,6 +7738,7 @@ static void genericWriteThreadFunc(void *arg)
         {
             shared_thread_data->data_written += shared_thread_data->data_size;
             shared_thread_data->data_size = 0;
+            shared_thread_data->data_zero_filled = false;
         }
 
         /* Wake up the read thread to continue reading data */
@@ -6545,10 +7828,10 @@ static bool spanDumpThreads(ThreadFunc read_func, ThreadFunc write_func, void *a
     consolePrint("\nwaiting for threads to join\n");
     consoleRefresh();
 
-    utilsJoinThread(&read_thread);
+    joinDumpThread(&read_thread, ThreadPlacementStage_Read);
     consolePrint("read_thread done: %lu\n", time(NULL));
 
-    utilsJoinThread(&write_thread);
+    joinDumpThread(&write_thread, getDumpThreadWriteStage());
     consolePrint("write_thread done: %lu\n", time(NULL));
 
     if (shared_thread_data->read_error || shared_thread_data->write_error)
@@ -6603,6 +7886,8 @@ static void nspThreadFunc(void *arg)
     NacpContext *nacp_ctx = NULL;
     u32 control_idx = 0, control_count = 0;
 
+    NspDeferredNcaPatch *deferred_patches = NULL;
+
     LegalInfoContext *legal_info_ctx = NULL;
     u32 legal_info_idx = 0, legal_info_count = 0;
 
@@ -6620,8 +7905,9 @@ static void nspThreadFunc(void *arg)
     char size_str[16] = {0};
     char *tmp_name = NULL;
 
-    Sha256Context clean_sha256_ctx = {0}, dirty_sha256_ctx = {0};
-    u8 clean_sha256_hash[SHA256_HASH_SIZE] = {0}, dirty_sha256_hash[SHA256_HASH_SIZE] = {0};
+    NspPipeline pipeline = {0};
+    NspPipelineBuffer *pipeline_buf = NULL;
+    u32 first_nca_idx = 0;
 
     if (!nsp_thread_data || !(title_info = (TitleInfo*)nsp_thread_data->data) || !title_info->content_count || !title_info->content_infos) goto end;
 
@@ -6669,6 +7955,13 @@ static void nspThreadFunc(void *arg)
             consolePrint("nacp ctx calloc failed\n");
             goto end;
         }
+
+        // nacp patches don't affect the nsp size, so their generation can be deferred to the streaming pass if we don't need to generate any xml files
+        if (control_count && !generate_authoringtool_data && !(deferred_patches = calloc(title_info->content_count, sizeof(NspDeferredNcaPatch))))
+        {
+            consolePrint("deferred patches calloc failed\n");
+            goto end;
+        }
     }
 
     // determine if we should initialize legalinfo ctx
@@ -6804,6 +8097,21 @@ static void nspThreadFunc(void *arg)
 
                     NacpContext *cur_nacp_ctx = &(nacp_ctx[control_idx]);
 
+                    // defer nacp patch generation, if possible
+                    if (deferred_patches)
+                    {
+                        NspDeferredNcaPatch *deferred_patch = &(deferred_patches[j]);
+                        deferred_patch->nacp_ctx = cur_nacp_ctx;
+                        deferred_patch->patch_sua = patch_sua;
+                        deferred_patch->patch_screenshot = patch_screenshot;
+                        deferred_patch->patch_video_capture = patch_video_capture;
+                        deferred_patch->patch_hdcp = patch_hdcp;
+
+                        control_idx++;
+
+                        break;
+                    }
+
                     if (!nacpInitializeContext(cur_nacp_ctx, cur_nca_ctx))
                     {
                         consolePrint("initialize nacp ctx failed (%s)\n", cur_nca_ctx->content_id_str);
@@ -7065,34 +8373,56 @@ static void nspThreadFunc(void *arg)
     // set nsp size
     nsp_thread_data->total_size = nsp_size;
 
-    // write ncas
-    for(u32 i = 0; i < title_info->content_count; i++)
+    // process all ncas except for the meta nca in parallel if we're dealing with a seekable output file
+    // only the meta nca has to wait for the rest, since its cnmt patch depends on their updated content ids and hashes
+    if (dev_idx != 1 && title_info->content_count > 2)
     {
-        NcaContext *cur_nca_ctx = &(nca_ctx[i]);
-        u64 blksize = BLOCK_SIZE;
+        first_nca_idx = (title_info->content_count - 1);
 
-        sha256ContextCreate(&clean_sha256_ctx);
-        sha256ContextCreate(&dirty_sha256_ctx);
+        if (!nspProcessNcasInParallel(nsp_thread_data, nca_ctx, first_nca_idx, &cnmt_ctx, &pfs_img_ctx, deferred_patches, fp, nsp_header_size)) goto end;
 
-        if (cur_nca_ctx->content_type == NcmContentType_Meta && (!cnmtGenerateNcaPatch(&cnmt_ctx) || !ncaEncryptHeader(cur_nca_ctx)))
+        for(u32 i = 0; i < first_nca_idx; i++) nsp_offset += nca_ctx[i].content_size;
+
+        // seek to the meta nca offset
+        if (fseek(fp, (long)(nsp_header_size + pfs_img_ctx.entries[first_nca_idx].offset), SEEK_SET) != 0)
         {
-            consolePrint("cnmt generate patch failed\n");
+            consolePrint("meta nca seek failed
+");
             goto end;
         }
+    }
 
-        bool dirty_header = ncaIsHeaderDirty(cur_nca_ctx);
+    // start nca processing pipeline
+    if (!nspPipelineInitialize(&pipeline, nsp_thread_data, nca_ctx, &cnmt_ctx, &pfs_img_ctx, fp, dev_idx))
+    {
+        consolePrint("nsp pipeline initialize failed\n");
+        goto end;
+    }
 
-        if (dev_idx == 1)
-        {
-            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, i);
-            if (!usbSendFileProperties(cur_nca_ctx->content_size, tmp_name))
-            {
-                consolePrint("usb send file properties \"%s\" failed\n", tmp_name);
+    // read ncas
+    // the remaining pipeline stages take care of patching, hashing and writing the data we read
+    for(u32 i = first_nca_idx; i < title_info->content_count; i++)
+    {
+        NcaContext *cur_nca_ctx = &(nca_ctx[i]);
+        u64 blksize = BLOCK_SIZE;
+
+        if (cur_nca_ctx->content_type == NcmContentType_Meta)
+        {
+            // wait until all the other ncas have been fully processed, since the cnmt patch depends on their updated content ids and hashes
+            if (!nspPipelineWaitForDrain(&pipeline)) goto end;
+
+            if (!cnmtGenerateNcaPatch(&cnmt_ctx) || !ncaEncryptHeader(cur_nca_ctx))
+            {
+                consolePrint("cnmt generate patch failed\n");
                 goto end;
             }
+        } else
+        if (deferred_patches && !nspGenerateDeferredNcaPatch(cur_nca_ctx, &(deferred_patches[i])))
+        {
+            goto end;
         }
 
-        for(u64 offset = 0; offset < cur_nca_ctx->content_size; offset += blksize, nsp_offset += blksize, nsp_thread_data->data_written += blksize)
+        for(u64 offset = 0; offset < cur_nca_ctx->content_size; offset += blksize)
         {
             mutexLock(&g_fileMutex);
             bool cancelled = nsp_thread_data->transfer_cancelled;
@@ -7102,330 +8432,1342 @@ static void nspThreadFunc(void *arg)
 
             if ((cur_nca_ctx->content_size - offset) < blksize) blksize = (cur_nca_ctx->content_size - offset);
 
+            // get a free buffer
+            if (!(pipeline_buf = nspPipelineRingPop(&pipeline, NspPipelineStage_Read))) goto end;
+
+            pipeline_buf->size = blksize;
+            pipeline_buf->offset = offset;
+            pipeline_buf->nca_idx = i;
+            pipeline_buf->eos = false;
+
+            // take a snapshot of the pfs entry name, since the hash stage may update it before the write stage gets to this nca
+            if (!offset) snprintf(pipeline_buf->entry_name, sizeof(pipeline_buf->entry_name), "%s", pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, i));
+
             // read nca chunk
-            if (!ncaReadContentFile(cur_nca_ctx, buf, blksize, offset))
+            if (!ncaReadContentFile(cur_nca_ctx, pipeline_buf->data, blksize, offset))
             {
                 consolePrint("nca read failed at 0x%lX for \"%s\"\n", offset, cur_nca_ctx->content_id_str);
                 goto end;
             }
 
-            // update clean hash calculation
-            sha256ContextUpdate(&clean_sha256_ctx, buf, blksize);
+            // pass chunk to the patch stage
+            nspPipelineRingPush(&pipeline, NspPipelineStage_Patch, pipeline_buf);
+        }
 
-            if ((offset + blksize) >= cur_nca_ctx->content_size)
-            {
-                // get clean hash
-                sha256ContextGetHash(&clean_sha256_ctx, clean_sha256_hash);
+        nsp_offset += cur_nca_ctx->content_size;
+    }
 
-                // validate clean hash
-                if (!cnmtVerifyContentHash(&cnmt_ctx, cur_nca_ctx, clean_sha256_hash))
-                {
-                    consolePrint("sha256 checksum mismatch for nca \"%s\"\nplease check for corrupted data using the data management menu\n", cur_nca_ctx->content_id_str);
-                    goto end;
-                }
+    // signal the end of the stream and wait for all pipeline stages to finish
+    if (!(pipeline_buf = nspPipelineRingPop(&pipeline, NspPipelineStage_Read))) goto end;
+
+    pipeline_buf->size = 0;
+    pipeline_buf->eos = true;
+    nspPipelineRingPush(&pipeline, NspPipelineStage_Patch, pipeline_buf);
+
+    if (!nspPipelineFinalize(&pipeline, false)) goto end;
+
+    if (generate_authoringtool_data)
+    {
+        // regenerate cnmt xml
+        if (!cnmtGenerateAuthoringToolXml(&cnmt_ctx, nca_ctx, title_info->content_count))
+        {
+            consolePrint("cnmt xml #2 failed\n");
+            goto end;
+        }
+
+        // write cnmt xml
+        if (dev_idx == 1)
+        {
+            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, meta_nca_ctx->content_type_ctx_data_idx);
+            if (!usbSendFileProperties(cnmt_ctx.authoring_tool_xml_size, tmp_name) || !usbSendFileData(cnmt_ctx.authoring_tool_xml, cnmt_ctx.authoring_tool_xml_size))
+            {
+                consolePrint("send \"%s\" failed\n", tmp_name);
+                goto end;
             }
+        } else {
+            fwrite(cnmt_ctx.authoring_tool_xml, 1, cnmt_ctx.authoring_tool_xml_size, fp);
+        }
+
+        nsp_offset += cnmt_ctx.authoring_tool_xml_size;
+        nsp_thread_data->data_written += cnmt_ctx.authoring_tool_xml_size;
+
+        // update cnmt xml pfs entry name
+        if (!pfsUpdateEntryNameFromImageContext(&pfs_img_ctx, meta_nca_ctx->content_type_ctx_data_idx, meta_nca_ctx->content_id_str))
+        {
+            consolePrint("pfs update entry name cnmt xml failed\n");
+            goto end;
+        }
+    }
+
+    // write content type ctx data
+    for(u32 i = 0; i < limit; i++)
+    {
+        NcaContext *cur_nca_ctx = &(nca_ctx[i]);
+        if (!cur_nca_ctx->content_type_ctx) continue;
+
+        char *authoring_tool_xml = NULL;
+        u64 authoring_tool_xml_size = 0;
+        u32 data_idx = cur_nca_ctx->content_type_ctx_data_idx;
 
-            if (dirty_header)
+        switch(cur_nca_ctx->content_type)
+        {
+            case NcmContentType_Program:
+            {
+                ProgramInfoContext *cur_program_info_ctx = (ProgramInfoContext*)cur_nca_ctx->content_type_ctx;
+                authoring_tool_xml = cur_program_info_ctx->authoring_tool_xml;
+                authoring_tool_xml_size = cur_program_info_ctx->authoring_tool_xml_size;
+                break;
+            }
+            case NcmContentType_Control:
             {
-                // write re-encrypted headers
-                if (!cur_nca_ctx->header_written) ncaWriteEncryptedHeaderDataToMemoryBuffer(cur_nca_ctx, buf, blksize, offset);
+                NacpContext *cur_nacp_ctx = (NacpContext*)cur_nca_ctx->content_type_ctx;
+                authoring_tool_xml = cur_nacp_ctx->authoring_tool_xml;
+                authoring_tool_xml_size = cur_nacp_ctx->authoring_tool_xml_size;
 
-                if (cur_nca_ctx->content_type_ctx_patch)
+                // loop through available icons
+                for(u8 j = 0; j < cur_nacp_ctx->icon_count; j++)
                 {
-                    // write content type context patch
-                    switch(cur_nca_ctx->content_type)
+                    NacpIconContext *icon_ctx = &(cur_nacp_ctx->icon_ctx[j]);
+
+                    // write icon
+                    if (dev_idx == 1)
                     {
-                        case NcmContentType_Meta:
-                            cnmtWriteNcaPatch(&cnmt_ctx, buf, blksize, offset);
-                            break;
-                        case NcmContentType_Control:
-                            nacpWriteNcaPatch((NacpContext*)cur_nca_ctx->content_type_ctx, buf, blksize, offset);
-                            break;
-                        default:
-                            break;
+                        tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, data_idx);
+                        if (!usbSendFileProperties(icon_ctx->icon_size, tmp_name) || !usbSendFileData(icon_ctx->icon_data, icon_ctx->icon_size))
+                        {
+                            consolePrint("send \"%s\" failed\n", tmp_name);
+                            goto end;
+                        }
+                    } else {
+                        fwrite(icon_ctx->icon_data, 1, icon_ctx->icon_size, fp);
+                    }
+
+                    nsp_offset += icon_ctx->icon_size;
+                    nsp_thread_data->data_written += icon_ctx->icon_size;
+
+                    // update pfs entry name
+                    if (!pfsUpdateEntryNameFromImageContext(&pfs_img_ctx, data_idx++, cur_nca_ctx->content_id_str))
+                    {
+                        consolePrint("pfs update entry name failed for icon \"%s\" (%u)\n", cur_nca_ctx->content_id_str, icon_ctx->language);
+                        goto end;
                     }
                 }
 
-                // update flag to avoid entering this code block if it's not needed anymore
-                dirty_header = (!cur_nca_ctx->header_written || cur_nca_ctx->content_type_ctx_patch);
+                break;
             }
+            case NcmContentType_LegalInformation:
+            {
+                LegalInfoContext *cur_legal_info_ctx = (LegalInfoContext*)cur_nca_ctx->content_type_ctx;
+                authoring_tool_xml = cur_legal_info_ctx->authoring_tool_xml;
+                authoring_tool_xml_size = cur_legal_info_ctx->authoring_tool_xml_size;
+                break;
+            }
+            default:
+                break;
+        }
 
-            // update dirty hash calculation
-            sha256ContextUpdate(&dirty_sha256_ctx, buf, blksize);
-
-            // write nca chunk
-            if (dev_idx == 1)
+        // write xml
+        if (dev_idx == 1)
+        {
+            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, data_idx);
+            if (!usbSendFileProperties(authoring_tool_xml_size, tmp_name) || !usbSendFileData(authoring_tool_xml, authoring_tool_xml_size))
             {
-                if (!usbSendFileData(buf, blksize))
-                {
-                    consolePrint("send file data failed\n");
-                    goto end;
-                }
-            } else {
-                fwrite(buf, 1, blksize, fp);
+                consolePrint("send \"%s\" failed\n", tmp_name);
+                goto end;
             }
+        } else {
+            fwrite(authoring_tool_xml, 1, authoring_tool_xml_size, fp);
         }
 
-        // get dirty hash
-        sha256ContextGetHash(&dirty_sha256_ctx, dirty_sha256_hash);
+        nsp_offset += authoring_tool_xml_size;
+        nsp_thread_data->data_written += authoring_tool_xml_size;
 
-        if (memcmp(clean_sha256_hash, dirty_sha256_hash, SHA256_HASH_SIZE) != 0)
+        // update pfs entry name
+        if (!pfsUpdateEntryNameFromImageContext(&pfs_img_ctx, data_idx, cur_nca_ctx->content_id_str))
         {
-            // update content id and hash
-            ncaUpdateContentIdAndHash(cur_nca_ctx, dirty_sha256_hash);
+            consolePrint("pfs update entry name failed for xml \"%s\"\n", cur_nca_ctx->content_id_str);
+            goto end;
+        }
+    }
 
-            // update cnmt
-            if (!cnmtUpdateContentInfo(&cnmt_ctx, cur_nca_ctx))
+    if (retrieve_tik_cert)
+    {
+        // write ticket
+        if (dev_idx == 1)
+        {
+            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, pfs_img_ctx.header.entry_count - 2);
+            if (!usbSendFileProperties(tik.size, tmp_name) || !usbSendFileData(tik.data, tik.size))
             {
-                consolePrint("cnmt update content info failed\n");
+                consolePrint("send \"%s\" failed\n", tmp_name);
                 goto end;
             }
+        } else {
+            fwrite(tik.data, 1, tik.size, fp);
+        }
+
+        nsp_offset += tik.size;
+        nsp_thread_data->data_written += tik.size;
 
-            // update pfs entry name
-            if (!pfsUpdateEntryNameFromImageContext(&pfs_img_ctx, i, cur_nca_ctx->content_id_str))
+        // write cert
+        if (dev_idx == 1)
+        {
+            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, pfs_img_ctx.header.entry_count - 1);
+            if (!usbSendFileProperties(raw_cert_chain_size, tmp_name) || !usbSendFileData(raw_cert_chain, raw_cert_chain_size))
             {
-                consolePrint("pfs update entry name failed for nca \"%s\"\n", cur_nca_ctx->content_id_str);
+                consolePrint("send \"%s\" failed\n", tmp_name);
                 goto end;
             }
+        } else {
+            fwrite(raw_cert_chain, 1, raw_cert_chain_size, fp);
+        }
+
+        nsp_offset += raw_cert_chain_size;
+        nsp_thread_data->data_written += raw_cert_chain_size;
+    }
+
+    // write new pfs0 header
+    if (!pfsWriteImageContextHeaderToMemoryBuffer(&pfs_img_ctx, buf, BLOCK_SIZE, &nsp_header_size))
+    {
+        consolePrint("pfs write header to mem #2 failed\n");
+        goto end;
+    }
+
+    if (dev_idx == 1)
+    {
+        if (!usbSendNspHeader(buf, (u32)nsp_header_size))
+        {
+            consolePrint("send nsp header failed\n");
+            goto end;
+        }
+    } else {
+        rewind(fp);
+        fwrite(buf, 1, nsp_header_size, fp);
+    }
+
+    nsp_thread_data->data_written += nsp_header_size;
+
+    success = true;
+
+end:
+    // stop the pipeline threads, if needed
+    nspPipelineFinalize(&pipeline, true);
+
+    consoleRefresh();
+
+    mutexLock(&g_fileMutex);
+    if (!success && !nsp_thread_data->transfer_cancelled) nsp_thread_data->error = true;
+    mutexUnlock(&g_fileMutex);
+
+    if (fp)
+    {
+        fclose(fp);
+
+        if (!success)
+        {
+            if (dev_idx == 0)
+            {
+                utilsRemoveConcatenationFile(filename);
+                utilsCommitSdCardFileSystemChanges();
+            } else {
+                remove(filename);
+            }
+        }
+    }
+
+    if (!success && dev_idx == 1) usbCancelFileTransfer();
+
+    pfsFreeImageContext(&pfs_img_ctx);
+
+    if (raw_cert_chain) free(raw_cert_chain);
+
+    if (legal_info_ctx)
+    {
+        for(u32 i = 0; i < legal_info_count; i++) legalInfoFreeContext(&(legal_info_ctx[i]));
+        free(legal_info_ctx);
+    }
+
+    if (deferred_patches) free(deferred_patches);
+
+    if (nacp_ctx)
+    {
+        for(u32 i = 0; i < control_count; i++) nacpFreeContext(&(nacp_ctx[i]));
+        free(nacp_ctx);
+    }
+
+    if (program_info_ctx)
+    {
+        for(u32 i = 0; i < program_count; i++) programInfoFreeContext(&(program_info_ctx[i]));
+        free(program_info_ctx);
+    }
+
+    cnmtFreeContext(&cnmt_ctx);
+
+    if (nca_ctx) free(nca_ctx);
+
+    if (filename) free(filename);
+
+    if (buf) free(buf);
+
+    threadExit();
+}
+
+static bool nspPipelineInitialize(NspPipeline *pipeline, NspThreadData *nsp_thread_data, NcaContext *nca_ctx, ContentMetaContext *cnmt_ctx, PartitionFileSystemImageContext *pfs_img_ctx, FILE *fp, u32 dev_idx)
+{
+    /* Each stage runs on its own core, except for the write stage, which mostly waits on I/O and shares core 0 with the patch stage and the UI. */
+    /* The read stage runs on the NSP dump thread (core 2). */
+    static const ThreadFunc stage_funcs[NspPipelineStage_Count] = { NULL, nspPipelinePatchThreadFunc, nspPipelineHashThreadFunc, nspPipelineWriteThreadFunc };
+    static const int stage_cpu_ids[NspPipelineStage_Count] = { 2, 0, 1, 0 };
+
+    pipeline->nsp_thread_data = nsp_thread_data;
+    pipeline->nca_ctx = nca_ctx;
+    pipeline->cnmt_ctx = cnmt_ctx;
+    pipeline->pfs_img_ctx = pfs_img_ctx;
+    pipeline->fp = fp;
+    pipeline->dev_idx = dev_idx;
+
+    atomic_store(&(pipeline->abort), false);
+
+    /* Allocate pipeline buffers. */
+    if (!(pipeline->data = usbAllocatePageAlignedBuffer(BLOCK_SIZE * NSP_PIPELINE_BUFFER_COUNT)))
+    {
+        consolePrint("nsp pipeline buffers alloc failed\n");
+        return false;
+    }
+
+    /* Initialize rings. All buffers start out in the ring from the read stage. */
+    for(u32 i = 0; i < NspPipelineStage_Count; i++)
+    {
+        NspPipelineRing *ring = &(pipeline->rings[i]);
+
+        mutexInit(&(ring->mutex));
+        condvarInit(&(ring->condvar));
+
+        atomic_store(&(ring->head), i == NspPipelineStage_Read ? NSP_PIPELINE_BUFFER_COUNT : 0);
+        atomic_store(&(ring->tail), 0);
+    }
+
+    for(u32 i = 0; i < NSP_PIPELINE_BUFFER_COUNT; i++)
+    {
+        pipeline->buffers[i].data = (pipeline->data + (i * BLOCK_SIZE));
+        pipeline->rings[NspPipelineStage_Read].buffer_idx[i] = i;
+    }
+
+    /* Create stage threads. */
+    for(u32 i = (NspPipelineStage_Read + 1); i < NspPipelineStage_Count; i++)
+    {
+        if (!(pipeline->threads_created[i] = utilsCreateThread(&(pipeline->threads[i]), stage_funcs[i], pipeline, stage_cpu_ids[i])))
+        {
+            consolePrint("nsp pipeline thread #%u creation failed\n", i);
+            nspPipelineFinalize(pipeline, true);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool nspPipelineFinalize(NspPipeline *pipeline, bool abort)
+{
+    if (abort) atomic_store(&(pipeline->abort), true);
+
+    /* Wait for all stage threads to exit. */
+    for(u32 i = (NspPipelineStage_Read + 1); i < NspPipelineStage_Count; i++)
+    {
+        if (!pipeline->threads_created[i]) continue;
+        joinDumpThread(&(pipeline->threads[i]), i == NspPipelineStage_Patch ? ThreadPlacementStage_Decrypt : (i == NspPipelineStage_Hash ? ThreadPlacementStage_Hash : getDumpThreadWriteStage()));
+        pipeline->threads_created[i] = false;
+    }
+
+    if (pipeline->data)
+    {
+        free(pipeline->data);
+        pipeline->data = NULL;
+    }
+
+    return !atomic_load(&(pipeline->abort));
+}
+
+static bool nspPipelineWaitForDrain(NspPipeline *pipeline)
+{
+    NspPipelineRing *ring = &(pipeline->rings[NspPipelineStage_Read]);
+    u32 tail = atomic_load_explicit(&(ring->tail), memory_order_relaxed);
+
+    /* Wait until all buffers have made it back to the read stage. */
+    while((atomic_load_explicit(&(ring->head), memory_order_acquire) - tail) < NSP_PIPELINE_BUFFER_COUNT)
+    {
+        if (atomic_load(&(pipeline->abort))) return false;
+
+        mutexLock(&(ring->mutex));
+        condvarWaitTimeout(&(ring->condvar), &(ring->mutex), NSP_PIPELINE_WAIT_TIMEOUT);
+        mutexUnlock(&(ring->mutex));
+    }
+
+    return true;
+}
+
+static NspPipelineBuffer *nspPipelineRingPop(NspPipeline *pipeline, u32 stage)
+{
+    NspPipelineRing *ring = &(pipeline->rings[stage]);
+    u32 tail = atomic_load_explicit(&(ring->tail), memory_order_relaxed), buffer_idx = 0;
+
+    while(atomic_load_explicit(&(ring->head), memory_order_acquire) == tail)
+    {
+        if (atomic_load(&(pipeline->abort))) return NULL;
+
+        /* The producer never takes the ring mutex, so a wakeup may be missed right before we start waiting. A timeout is used to work around this. */
+        mutexLock(&(ring->mutex));
+        if (atomic_load_explicit(&(ring->head), memory_order_acquire) == tail) condvarWaitTimeout(&(ring->condvar), &(ring->mutex), NSP_PIPELINE_WAIT_TIMEOUT);
+        mutexUnlock(&(ring->mutex));
+    }
+
+    buffer_idx = ring->buffer_idx[tail & (NSP_PIPELINE_BUFFER_COUNT - 1)];
+    atomic_store_explicit(&(ring->tail), tail + 1, memory_order_release);
+
+    return &(pipeline->buffers[buffer_idx]);
+}
+
+static void nspPipelineRingPush(NspPipeline *pipeline, u32 stage, NspPipelineBuffer *buffer)
+{
+    NspPipelineRing *ring = &(pipeline->rings[stage]);
+    u32 head = atomic_load_explicit(&(ring->head), memory_order_relaxed);
+
+    ring->buffer_idx[head & (NSP_PIPELINE_BUFFER_COUNT - 1)] = (u32)(buffer - pipeline->buffers);
+    atomic_store_explicit(&(ring->head), head + 1, memory_order_release);
+
+    condvarWakeOne(&(ring->condvar));
+}
+
+static void nspPipelinePatchThreadFunc(void *arg)
+{
+    NspPipeline *pipeline = (NspPipeline*)arg;
+    NspPipelineBuffer *buffer = NULL;
+    NcaContext *cur_nca_ctx = NULL;
+
+    Sha256Context clean_sha256_ctx = {0};
+    bool dirty_header = false, hash_shared = false, eos = false;
+
+    while(!eos && (buffer = nspPipelineRingPop(pipeline, NspPipelineStage_Patch)))
+    {
+        eos = buffer->eos;
+
+        if (!eos)
+        {
+            cur_nca_ctx = &(pipeline->nca_ctx[buffer->nca_idx]);
+
+            if (!buffer->offset)
+            {
+                sha256ContextCreate(&clean_sha256_ctx);
+                dirty_header = ncaIsHeaderDirty(cur_nca_ctx);
+                hash_shared = true;
+            }
+
+            // fork the dirty hash calculation right before the first chunk that may get patched
+            // both hashes are identical up to this point, so the hash stage doesn't need to process any of the previous chunks
+            buffer->hash_fork = (hash_shared && dirty_header);
+            if (buffer->hash_fork)
+            {
+                memcpy(&(buffer->fork_ctx), &clean_sha256_ctx, sizeof(Sha256Context));
+                hash_shared = false;
+            }
+
+            buffer->hash_shared = hash_shared;
+
+            // update clean hash calculation
+            sha256ContextUpdate(&clean_sha256_ctx, buffer->data, buffer->size);
+
+            // get clean hash
+            // it's validated by the hash stage
+            if ((buffer->offset + buffer->size) >= cur_nca_ctx->content_size) sha256ContextGetHash(&clean_sha256_ctx, buffer->clean_hash);
+
+            // apply patches
+            nspApplyNcaPatches(cur_nca_ctx, pipeline->cnmt_ctx, buffer->data, buffer->size, buffer->offset, &dirty_header);
+        }
+
+        // pass chunk to the hash stage
+        nspPipelineRingPush(pipeline, NspPipelineStage_Hash, buffer);
+    }
+
+    threadExit();
+}
+
+static void nspPipelineHashThreadFunc(void *arg)
+{
+    NspPipeline *pipeline = (NspPipeline*)arg;
+    NspPipelineBuffer *buffer = NULL;
+    NcaContext *cur_nca_ctx = NULL;
+
+    Sha256Context dirty_sha256_ctx = {0};
+    u8 dirty_sha256_hash[SHA256_HASH_SIZE] = {0};
+    bool eos = false;
+
+    while(!eos && (buffer = nspPipelineRingPop(pipeline, NspPipelineStage_Hash)))
+    {
+        eos = buffer->eos;
+
+        if (!eos)
+        {
+            cur_nca_ctx = &(pipeline->nca_ctx[buffer->nca_idx]);
+
+            // pick up the clean hash state if the dirty hash calculation was forked on this chunk
+            if (buffer->hash_fork) memcpy(&dirty_sha256_ctx, &(buffer->fork_ctx), sizeof(Sha256Context));
+
+            // update dirty hash calculation
+            // skip it altogether if no patches have been applied so far
+            if (!buffer->hash_shared) sha256ContextUpdate(&dirty_sha256_ctx, buffer->data, buffer->size);
+
+            if ((buffer->offset + buffer->size) >= cur_nca_ctx->content_size)
+            {
+                // get dirty hash
+                if (buffer->hash_shared)
+                {
+                    memcpy(dirty_sha256_hash, buffer->clean_hash, SHA256_HASH_SIZE);
+                } else {
+                    sha256ContextGetHash(&dirty_sha256_ctx, dirty_sha256_hash);
+                }
+
+                // validate clean hash and update nca / cnmt / pfs data, if needed
+                if (!nspFinalizeNcaHash(cur_nca_ctx, buffer->nca_idx, pipeline->cnmt_ctx, pipeline->pfs_img_ctx, buffer->clean_hash, dirty_sha256_hash)) break;
+            }
+        }
+
+        // pass chunk to the write stage
+        nspPipelineRingPush(pipeline, NspPipelineStage_Write, buffer);
+        buffer = NULL;
+    }
+
+    // abort the pipeline if we bailed out early
+    if (buffer) atomic_store(&(pipeline->abort), true);
+
+    threadExit();
+}
+
+static void nspPipelineWriteThreadFunc(void *arg)
+{
+    NspPipeline *pipeline = (NspPipeline*)arg;
+    NspPipelineBuffer *buffer = NULL;
+    NcaContext *cur_nca_ctx = NULL;
+    bool write_ok = true;
+
+    while((buffer = nspPipelineRingPop(pipeline, NspPipelineStage_Write)))
+    {
+        if (buffer->eos) break;
+
+        cur_nca_ctx = &(pipeline->nca_ctx[buffer->nca_idx]);
+
+        if (pipeline->dev_idx == 1)
+        {
+            // send file properties right before the first chunk
+            if (!buffer->offset && !usbSendFileProperties(cur_nca_ctx->content_size, buffer->entry_name))
+            {
+                consolePrint("usb send file properties \"%s\" failed\n", buffer->entry_name);
+                write_ok = false;
+                break;
+            }
+
+            // write nca chunk
+            if (!usbSendFileData(buffer->data, buffer->size))
+            {
+                consolePrint("send file data failed\n");
+                write_ok = false;
+                break;
+            }
+        } else {
+            if (fwrite(buffer->data, 1, buffer->size, pipeline->fp) != buffer->size)
+            {
+                consolePrint("fwrite failed\n");
+                write_ok = false;
+                break;
+            }
+        }
+
+        pipeline->nsp_thread_data->data_written += buffer->size;
+
+        // return buffer to the read stage
+        nspPipelineRingPush(pipeline, NspPipelineStage_Read, buffer);
+    }
+
+    if (!write_ok) atomic_store(&(pipeline->abort), true);
+
+    threadExit();
+}
+
+static bool nspProcessNcasInParallel(NspThreadData *nsp_thread_data, NcaContext *nca_ctx, u32 nca_count, ContentMetaContext *cnmt_ctx, PartitionFileSystemImageContext *pfs_img_ctx, NspDeferredNcaPatch *deferred_patches, FILE *fp, u64 nsp_header_size)
+{
+    NspParallelContext parallel_ctx = {0};
+    NspParallelWorkerData worker_data[NSP_PARALLEL_WORKER_COUNT] = {0};
+    Thread worker_threads[NSP_PARALLEL_WORKER_COUNT] = {0};
+    bool worker_created[NSP_PARALLEL_WORKER_COUNT] = {0};
+
+    u8 *data = NULL;
+    u32 worker_count = MIN(nca_count, NSP_PARALLEL_WORKER_COUNT);
+    bool success = false;
+
+    parallel_ctx.nsp_thread_data = nsp_thread_data;
+    parallel_ctx.nca_ctx = nca_ctx;
+    parallel_ctx.nca_count = nca_count;
+    parallel_ctx.cnmt_ctx = cnmt_ctx;
+    parallel_ctx.pfs_img_ctx = pfs_img_ctx;
+    parallel_ctx.deferred_patches = deferred_patches;
+    parallel_ctx.fp = fp;
+    parallel_ctx.nsp_header_size = nsp_header_size;
+    mutexInit(&(parallel_ctx.mutex));
+
+    /* Allocate worker buffers. */
+    if (!(data = malloc(BLOCK_SIZE * worker_count)))
+    {
+        consolePrint("nsp worker buffers alloc failed\n");
+        goto end;
+    }
+
+    /* Create worker threads. Cores 0, 1 and 2 are used, while the NSP dump thread just waits for them to finish. */
+    for(u32 i = 0; i < worker_count; i++)
+    {
+        worker_data[i].parallel_ctx = &parallel_ctx;
+        worker_data[i].buf = (data + (i * BLOCK_SIZE));
+
+        if (!(worker_created[i] = utilsCreateThread(&(worker_threads[i]), nspParallelWorkerThreadFunc, &(worker_data[i]), (int)i)))
+        {
+            consolePrint("nsp worker thread #%u creation failed\n", i);
+
+            mutexLock(&(parallel_ctx.mutex));
+            parallel_ctx.error = true;
+            mutexUnlock(&(parallel_ctx.mutex));
+
+            break;
+        }
+    }
+
+    /* Wait for all worker threads to exit. */
+    for(u32 i = 0; i < worker_count; i++)
+    {
+        if (worker_created[i]) joinDumpThread(&(worker_threads[i]), ThreadPlacementStage_Read);
+    }
+
+    success = !parallel_ctx.error;
+
+end:
+    if (data) free(data);
+
+    return success;
+}
+
+static void nspParallelWorkerThreadFunc(void *arg)
+{
+    NspParallelWorkerData *worker_data = (NspParallelWorkerData*)arg;
+    NspParallelContext *parallel_ctx = worker_data->parallel_ctx;
+    NspThreadData *nsp_thread_data = parallel_ctx->nsp_thread_data;
+    u8 *buf = worker_data->buf;
+
+    Sha256Context clean_sha256_ctx = {0}, dirty_sha256_ctx = {0};
+    u8 clean_sha256_hash[SHA256_HASH_SIZE] = {0}, dirty_sha256_hash[SHA256_HASH_SIZE] = {0};
+
+    bool error = false;
+
+    while(!error)
+    {
+        NcaContext *cur_nca_ctx = NULL;
+        PartitionFileSystemEntry *pfs_entry = NULL;
+        u32 nca_idx = 0;
+        u64 nca_offset = 0, blksize = BLOCK_SIZE;
+        bool dirty_header = false, hash_shared = true;
+
+        /* Get the next NCA to process. */
+        mutexLock(&(parallel_ctx->mutex));
+
+        if (!parallel_ctx->error && parallel_ctx->next_nca_idx < parallel_ctx->nca_count)
+        {
+            nca_idx = parallel_ctx->next_nca_idx++;
+            cur_nca_ctx = &(parallel_ctx->nca_ctx[nca_idx]);
+            pfs_entry = pfsGetEntryByIndexFromImageContext(parallel_ctx->pfs_img_ctx, nca_idx);
+        }
+
+        mutexUnlock(&(parallel_ctx->mutex));
+
+        if (!cur_nca_ctx || !pfs_entry) break;
+
+        /* Calculate the NCA offset within the NSP. Its size is already known, so it can be written at its final position right away. */
+        nca_offset = (parallel_ctx->nsp_header_size + pfs_entry->offset);
+
+        // generate deferred patches for this nca, if needed
+        if (parallel_ctx->deferred_patches && !nspGenerateDeferredNcaPatch(cur_nca_ctx, &(parallel_ctx->deferred_patches[nca_idx])))
+        {
+            error = true;
+            break;
+        }
+
+        sha256ContextCreate(&clean_sha256_ctx);
+
+        dirty_header = ncaIsHeaderDirty(cur_nca_ctx);
+
+        for(u64 offset = 0; offset < cur_nca_ctx->content_size; offset += blksize)
+        {
+            mutexLock(&g_fileMutex);
+            bool cancelled = nsp_thread_data->transfer_cancelled;
+            mutexUnlock(&g_fileMutex);
+
+            if (cancelled)
+            {
+                error = true;
+                break;
+            }
+
+            if ((cur_nca_ctx->content_size - offset) < blksize) blksize = (cur_nca_ctx->content_size - offset);
+
+            // read nca chunk
+            if (!ncaReadContentFile(cur_nca_ctx, buf, blksize, offset))
+            {
+                consolePrint("nca read failed at 0x%lX for \"%s\"\n", offset, cur_nca_ctx->content_id_str);
+                error = true;
+                break;
+            }
+
+            // fork the dirty hash calculation right before the first chunk that may get patched
+            // both hashes are identical up to this point
+            if (hash_shared && dirty_header)
+            {
+                memcpy(&dirty_sha256_ctx, &clean_sha256_ctx, sizeof(Sha256Context));
+                hash_shared = false;
+            }
+
+            // update clean hash calculation
+            sha256ContextUpdate(&clean_sha256_ctx, buf, blksize);
+
+            // apply patches
+            nspApplyNcaPatches(cur_nca_ctx, parallel_ctx->cnmt_ctx, buf, blksize, offset, &dirty_header);
+
+            // update dirty hash calculation
+            if (!hash_shared) sha256ContextUpdate(&dirty_sha256_ctx, buf, blksize);
+
+            // write nca chunk at its final position
+            mutexLock(&(parallel_ctx->mutex));
+
+            error = (parallel_ctx->error || fseek(parallel_ctx->fp, (long)(nca_offset + offset), SEEK_SET) != 0 || fwrite(buf, 1, blksize, parallel_ctx->fp) != blksize);
+            if (!error) nsp_thread_data->data_written += blksize;
+
+            mutexUnlock(&(parallel_ctx->mutex));
+
+            if (error) break;
+        }
+
+        if (error) break;
+
+        // get hashes
+        sha256ContextGetHash(&clean_sha256_ctx, clean_sha256_hash);
+
+        if (hash_shared)
+        {
+            memcpy(dirty_sha256_hash, clean_sha256_hash, SHA256_HASH_SIZE);
+        } else {
+            sha256ContextGetHash(&dirty_sha256_ctx, dirty_sha256_hash);
+        }
+
+        // validate clean hash and update nca / cnmt / pfs data, if needed
+        mutexLock(&(parallel_ctx->mutex));
+        error = !nspFinalizeNcaHash(cur_nca_ctx, nca_idx, parallel_ctx->cnmt_ctx, parallel_ctx->pfs_img_ctx, clean_sha256_hash, dirty_sha256_hash);
+        mutexUnlock(&(parallel_ctx->mutex));
+    }
+
+    if (error)
+    {
+        mutexLock(&(parallel_ctx->mutex));
+        parallel_ctx->error = true;
+        mutexUnlock(&(parallel_ctx->mutex));
+    }
+
+    threadExit();
+}
+
+static void nspApplyNcaPatches(NcaContext *nca_ctx, ContentMetaContext *cnmt_ctx, u8 *buf, u64 size, u64 offset, bool *dirty_header)
+{
+    if (!*dirty_header) return;
+
+    // write re-encrypted headers
+    if (!nca_ctx->header_written) ncaWriteEncryptedHeaderDataToMemoryBuffer(nca_ctx, buf, size, offset);
+
+    if (nca_ctx->content_type_ctx_patch)
+    {
+        // write content type context patch
+        switch(nca_ctx->content_type)
+        {
+            case NcmContentType_Meta:
+                cnmtWriteNcaPatch(cnmt_ctx, buf, size, offset);
+                break;
+            case NcmContentType_Control:
+                nacpWriteNcaPatch((NacpContext*)nca_ctx->content_type_ctx, buf, size, offset);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // update flag to avoid entering this code block if it's not needed anymore
+    *dirty_header = (!nca_ctx->header_written || nca_ctx->content_type_ctx_patch);
+}
+
+static bool nspFinalizeNcaHash(NcaContext *nca_ctx, u32 nca_idx, ContentMetaContext *cnmt_ctx, PartitionFileSystemImageContext *pfs_img_ctx, const u8 *clean_hash, const u8 *dirty_hash)
+{
+    // validate clean hash
+    if (!cnmtVerifyContentHash(cnmt_ctx, nca_ctx, clean_hash))
+    {
+        consolePrint("sha256 checksum mismatch for nca \"%s\"\nplease check for corrupted data using the data management menu\n", nca_ctx->content_id_str);
+        return false;
+    }
+
+    if (!memcmp(clean_hash, dirty_hash, SHA256_HASH_SIZE)) return true;
+
+    // update content id and hash
+    ncaUpdateContentIdAndHash(nca_ctx, dirty_hash);
+
+    // update cnmt
+    if (!cnmtUpdateContentInfo(cnmt_ctx, nca_ctx))
+    {
+        consolePrint("cnmt update content info failed\n");
+        return false;
+    }
+
+    // update pfs entry name
+    if (!pfsUpdateEntryNameFromImageContext(pfs_img_ctx, nca_idx, nca_ctx->content_id_str))
+    {
+        consolePrint("pfs update entry name failed for nca \"%s\"\n", nca_ctx->content_id_str);
+        return false;
+    }
+
+    return true;
+}
+
+static bool nspGenerateDeferredNcaPatch(NcaContext *nca_ctx, NspDeferredNcaPatch *deferred_patch)
+{
+    NacpContext *nacp_ctx = deferred_patch->nacp_ctx;
+    if (!nacp_ctx) return true;
+
+    deferred_patch->nacp_ctx = NULL;
+
+    if (!nacpInitializeContext(nacp_ctx, nca_ctx))
+    {
+        consolePrint("initialize nacp ctx failed (%s)\n", nca_ctx->content_id_str);
+        return false;
+    }
+
+    if (!nacpGenerateNcaPatch(nacp_ctx, deferred_patch->patch_sua, deferred_patch->patch_screenshot, deferred_patch->patch_video_capture, deferred_patch->patch_hdcp))
+    {
+        consolePrint("nacp nca patch failed (%s)\n", nca_ctx->content_id_str);
+        return false;
+    }
+
+    // re-encrypt nca header, since the nacp patch updates the fs section hash data
+    if (!ncaEncryptHeader(nca_ctx))
+    {
+        consolePrint("%s #%u encrypt nca header failed\n", titleGetNcmContentTypeName(nca_ctx->content_type), nca_ctx->id_offset);
+        return false;
+    }
+
+    return true;
+}
+
+NX_INLINE u8 getDumpThreadWriteStage(void)
+{
+    return (useUsbHost() ? ThreadPlacementStage_Usb : ThreadPlacementStage_Write);
+}
+
+static void joinDumpThread(Thread *thread, u8 stage)
+{
+    u64 cpu_ticks = 0;
+
+    /* The thread handle must still be open to retrieve its CPU time. */
+    if (thread && thread->handle != INVALID_HANDLE && stage < ThreadPlacementStage_Count && R_SUCCEEDED(threadWaitForExit(thread)) && \
+        R_SUCCEEDED(svcGetInfo(&cpu_ticks, InfoType_ThreadTickCount, thread->handle, (u64)-1)))
+    {
+        atomic_fetch_add_explicit(&(g_dumpStageCpuTicks[stage]), cpu_ticks, memory_order_relaxed);
+    }
+
+    utilsJoinThread(thread);
+}
+
+static int nullDevOpen(struct _reent *r, void *fd, const char *path, int flags, int mode)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(path);
+    NX_IGNORE_ARG(flags);
+    NX_IGNORE_ARG(mode);
+
+    memset(fd, 0, sizeof(NullSinkFileState));
+
+    return 0;
+}
+
+static int nullDevClose(struct _reent *r, void *fd)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(fd);
+
+    return 0;
+}
+
+static ssize_t nullDevWrite(struct _reent *r, void *fd, const char *ptr, size_t len)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(ptr);
+
+    NullSinkFileState *file = (NullSinkFileState*)fd;
+
+    file->offset += len;
+    file->size = MAX(file->size, file->offset);
+
+    atomic_fetch_add_explicit(&g_nullSinkWriteSize, len, memory_order_relaxed);
+
+    return (ssize_t)len;
+}
+
+static ssize_t nullDevRead(struct _reent *r, void *fd, char *ptr, size_t len)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(fd);
+    NX_IGNORE_ARG(ptr);
+    NX_IGNORE_ARG(len);
+
+    /* Nothing is ever stored, so every read hits EOF. */
+    return 0;
+}
+
+static off_t nullDevSeek(struct _reent *r, void *fd, off_t pos, int dir)
+{
+    NullSinkFileState *file = (NullSinkFileState*)fd;
+    off_t offset = 0;
+
+    switch(dir)
+    {
+        case SEEK_SET:
+            offset = pos;
+            break;
+        case SEEK_CUR:
+            offset = ((off_t)file->offset + pos);
+            break;
+        case SEEK_END:
+            offset = ((off_t)file->size + pos);
+            break;
+        default:
+            r->_errno = EINVAL;
+            return -1;
+    }
+
+    if (offset < 0)
+    {
+        r->_errno = EINVAL;
+        return -1;
+    }
+
+    file->offset = (u64)offset;
+
+    return offset;
+}
+
+static int nullDevFstat(struct _reent *r, void *fd, struct stat *st)
+{
+    NX_IGNORE_ARG(r);
+
+    NullSinkFileState *file = (NullSinkFileState*)fd;
+
+    memset(st, 0, sizeof(struct stat));
+    st->st_mode = (S_IFREG | S_IRUSR | S_IWUSR);
+    st->st_size = (off_t)file->size;
+    st->st_nlink = 1;
+
+    return 0;
+}
+
+static int nullDevStat(struct _reent *r, const char *file, struct stat *st)
+{
+    NX_IGNORE_ARG(file);
+    NX_IGNORE_ARG(st);
+
+    /* Output files never exist beforehand. */
+    r->_errno = ENOENT;
+
+    return -1;
+}
+
+static int nullDevUnlink(struct _reent *r, const char *name)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(name);
+
+    return 0;
+}
+
+static int nullDevMkdir(struct _reent *r, const char *path, int mode)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(path);
+    NX_IGNORE_ARG(mode);
+
+    return 0;
+}
+
+static int nullDevStatvfs(struct _reent *r, const char *path, struct statvfs *buf)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(path);
+
+    /* Report 16 TiB of free space, which is more than enough for any dump. */
+    memset(buf, 0, sizeof(struct statvfs));
+    buf->f_bsize = buf->f_frsize = 0x10000;
+    buf->f_blocks = buf->f_bfree = buf->f_bavail = 0x10000000;
+    buf->f_namemax = FS_MAX_PATH;
+
+    return 0;
+}
+
+static int nullDevFtruncate(struct _reent *r, void *fd, off_t len)
+{
+    NullSinkFileState *file = (NullSinkFileState*)fd;
+
+    if (len < 0)
+    {
+        r->_errno = EINVAL;
+        return -1;
+    }
+
+    file->size = (u64)len;
+
+    return 0;
+}
+
+static int nullDevFsync(struct _reent *r, void *fd)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(fd);
+
+    return 0;
+}
+
+static int nullDevRmdir(struct _reent *r, const char *name)
+{
+    NX_IGNORE_ARG(r);
+    NX_IGNORE_ARG(name);
+
+    return 0;
+}
+
+static bool benchmarkGameCard(void *userdata)
+{
+    NX_IGNORE_ARG(userdata);
+
+    const BenchmarkCase cases[] = {
+        { "xci", &saveGameCardImage, NULL, NULL, 0, NULL },
+        { "secure_hfs_raw", &saveGameCardHfsPartition, &g_hfsSecurePartition, &setGameCardWriteRawHfsPartitionOption, 1, NULL },
+        { "secure_hfs_extracted", &saveGameCardHfsPartition, &g_hfsSecurePartition, &setGameCardWriteRawHfsPartitionOption, 0, NULL },
+        { "system_update", &saveSystemUpdateDump, NULL, NULL, 0, NULL }
+    };
+
+    return benchmarkRunSuite("gamecard", cases, MAX_ELEMENTS(cases));
+}
+
+static bool benchmarkTitle(void *userdata)
+{
+    if (!userdata) return false;
+
+    TitleInfo *title_info = (TitleInfo*)userdata;
+    TitleInfo *user_title_info_bkp = g_ncaUserTitleInfo, *base_patch_title_info_bkp = g_ncaBasePatchTitleInfo;
+    NcaUserData nca_user_data = { .title_info = title_info, .content_idx = 0 };
+    NcaContext *nca_ctx = NULL;
+    NcaFsSectionContext *romfs_nca_fs_ctx = NULL;
+    const char *romfs_skip_reason = "no romfs section available";
+    u64 content_size = 0, max_content_size = 0;
+    char target[0x20] = {0};
+    bool success = false;
+
+    /* Pick the Program NCA. Fall back to the largest NCA if there's none. */
+    for(u32 i = 0; i < title_info->content_count; i++)
+    {
+        NcmContentInfo *content_info = &(title_info->content_infos[i]);
+
+        if (content_info->content_type == NcmContentType_Program)
+        {
+            nca_user_data.content_idx = i;
+            break;
         }
+
+        ncmContentInfoSizeToU64(content_info, &content_size);
+        if (content_size <= max_content_size) continue;
+
+        nca_user_data.content_idx = i;
+        max_content_size = content_size;
     }
 
-    if (generate_authoringtool_data)
+    /* Look for a RomFS section that can be dumped without a base / patch title. */
+    nca_ctx = calloc(1, sizeof(NcaContext));
+    if (nca_ctx && ncaInitializeContext(nca_ctx, title_info->storage_id, (title_info->storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : 0), \
+                                        &(title_info->meta_key), &(title_info->content_infos[nca_user_data.content_idx]), NULL))
     {
-        // regenerate cnmt xml
-        if (!cnmtGenerateAuthoringToolXml(&cnmt_ctx, nca_ctx, title_info->content_count))
+        for(u32 i = 0; i < NCA_FS_HEADER_COUNT; i++)
         {
-            consolePrint("cnmt xml #2 failed\n");
-            goto end;
-        }
+            NcaFsSectionContext *nca_fs_ctx = &(nca_ctx->fs_ctx[i]);
+            if (!nca_fs_ctx->enabled) continue;
 
-        // write cnmt xml
-        if (dev_idx == 1)
-        {
-            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, meta_nca_ctx->content_type_ctx_data_idx);
-            if (!usbSendFileProperties(cnmt_ctx.authoring_tool_xml_size, tmp_name) || !usbSendFileData(cnmt_ctx.authoring_tool_xml, cnmt_ctx.authoring_tool_xml_size))
+            if (nca_fs_ctx->section_type == NcaFsSectionType_PatchRomFs || nca_fs_ctx->has_sparse_layer)
             {
-                consolePrint("send \"%s\" failed\n", tmp_name);
-                goto end;
+                romfs_skip_reason = "romfs section requires a base / patch title";
+                continue;
             }
-        } else {
-            fwrite(cnmt_ctx.authoring_tool_xml, 1, cnmt_ctx.authoring_tool_xml_size, fp);
-        }
 
-        nsp_offset += cnmt_ctx.authoring_tool_xml_size;
-        nsp_thread_data->data_written += cnmt_ctx.authoring_tool_xml_size;
+            if (nca_fs_ctx->section_type != NcaFsSectionType_RomFs && nca_fs_ctx->section_type != NcaFsSectionType_Nca0RomFs) continue;
 
-        // update cnmt xml pfs entry name
-        if (!pfsUpdateEntryNameFromImageContext(&pfs_img_ctx, meta_nca_ctx->content_type_ctx_data_idx, meta_nca_ctx->content_id_str))
-        {
-            consolePrint("pfs update entry name cnmt xml failed\n");
-            goto end;
+            romfs_nca_fs_ctx = nca_fs_ctx;
+            romfs_skip_reason = NULL;
+            break;
         }
+    } else {
+        romfs_skip_reason = "failed to initialize nca ctx";
     }
 
-    // write content type ctx data
-    for(u32 i = 0; i < limit; i++)
-    {
-        NcaContext *cur_nca_ctx = &(nca_ctx[i]);
-        if (!cur_nca_ctx->content_type_ctx) continue;
-
-        char *authoring_tool_xml = NULL;
-        u64 authoring_tool_xml_size = 0;
-        u32 data_idx = cur_nca_ctx->content_type_ctx_data_idx;
-
-        switch(cur_nca_ctx->content_type)
-        {
-            case NcmContentType_Program:
-            {
-                ProgramInfoContext *cur_program_info_ctx = (ProgramInfoContext*)cur_nca_ctx->content_type_ctx;
-                authoring_tool_xml = cur_program_info_ctx->authoring_tool_xml;
-                authoring_tool_xml_size = cur_program_info_ctx->authoring_tool_xml_size;
-                break;
-            }
-            case NcmContentType_Control:
-            {
-                NacpContext *cur_nacp_ctx = (NacpContext*)cur_nca_ctx->content_type_ctx;
-                authoring_tool_xml = cur_nacp_ctx->authoring_tool_xml;
-                authoring_tool_xml_size = cur_nacp_ctx->authoring_tool_xml_size;
+    const BenchmarkCase cases[] = {
+        { "nsp", &saveNintendoSubmissionPackage, title_info, NULL, 0, NULL },
+        { "nca", &saveNintendoContentArchive, &nca_user_data, NULL, 0, NULL },
+        { "romfs_raw", &saveNintendoContentArchiveFsSection, romfs_nca_fs_ctx, &setNcaFsWriteRawSectionOption, 1, romfs_skip_reason },
+        { "romfs_extracted", &saveNintendoContentArchiveFsSection, romfs_nca_fs_ctx, &setNcaFsWriteRawSectionOption, 0, romfs_skip_reason },
+        { "system_update", &saveSystemUpdateDump, NULL, NULL, 0, NULL }
+    };
 
-                // loop through available icons
-                for(u8 j = 0; j < cur_nacp_ctx->icon_count; j++)
-                {
-                    NacpIconContext *icon_ctx = &(cur_nacp_ctx->icon_ctx[j]);
+    /* Only dump the RomFS section from the selected title. */
+    g_ncaUserTitleInfo = title_info;
+    g_ncaBasePatchTitleInfo = NULL;
 
-                    // write icon
-                    if (dev_idx == 1)
-                    {
-                        tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, data_idx);
-                        if (!usbSendFileProperties(icon_ctx->icon_size, tmp_name) || !usbSendFileData(icon_ctx->icon_data, icon_ctx->icon_size))
-                        {
-                            consolePrint("send \"%s\" failed\n", tmp_name);
-                            goto end;
-                        }
-                    } else {
-                        fwrite(icon_ctx->icon_data, 1, icon_ctx->icon_size, fp);
-                    }
+    sprintf(target, "%016lX", title_info->meta_key.id);
+    success = benchmarkRunSuite(target, cases, MAX_ELEMENTS(cases));
 
-                    nsp_offset += icon_ctx->icon_size;
-                    nsp_thread_data->data_written += icon_ctx->icon_size;
+    g_ncaUserTitleInfo = user_title_info_bkp;
+    g_ncaBasePatchTitleInfo = base_patch_title_info_bkp;
 
-                    // update pfs entry name
-                    if (!pfsUpdateEntryNameFromImageContext(&pfs_img_ctx, data_idx++, cur_nca_ctx->content_id_str))
-                    {
-                        consolePrint("pfs update entry name failed for icon \"%s\" (%u)\n", cur_nca_ctx->content_id_str, icon_ctx->language);
-                        goto end;
-                    }
-                }
+    if (nca_ctx) free(nca_ctx);
 
-                break;
-            }
-            case NcmContentType_LegalInformation:
-            {
-                LegalInfoContext *cur_legal_info_ctx = (LegalInfoContext*)cur_nca_ctx->content_type_ctx;
-                authoring_tool_xml = cur_legal_info_ctx->authoring_tool_xml;
-                authoring_tool_xml_size = cur_legal_info_ctx->authoring_tool_xml_size;
-                break;
-            }
-            default:
-                break;
-        }
+    return success;
+}
 
-        // write xml
-        if (dev_idx == 1)
-        {
-            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, data_idx);
-            if (!usbSendFileProperties(authoring_tool_xml_size, tmp_name) || !usbSendFileData(authoring_tool_xml, authoring_tool_xml_size))
-            {
-                consolePrint("send \"%s\" failed\n", tmp_name);
-                goto end;
-            }
-        } else {
-            fwrite(authoring_tool_xml, 1, authoring_tool_xml_size, fp);
-        }
+static bool benchmarkRunSuite(const char *target, const BenchmarkCase *cases, u32 case_count)
+{
+    u32 dev_idx_bkp = g_storageMenuElementOption.selected;
+    u32 write_raw_hfs_bkp = getGameCardWriteRawHfsPartitionOption(), write_raw_section_bkp = getNcaFsWriteRawSectionOption();
+    u32 use_layeredfs_dir_bkp = getNcaFsUseLayeredFsDirOption(), only_updated_files_bkp = getNcaFsOnlyUpdatedFilesOption();
+    u32 verify_raw_section_bkp = getNcaFsVerifyRawSectionOption();
 
-        nsp_offset += authoring_tool_xml_size;
-        nsp_thread_data->data_written += authoring_tool_xml_size;
+    UsbHsFsDevice *ums_devices = NULL;
+    FILE *csv_fd = NULL;
+    struct stat st = {0};
+    bool null_sink_added = false, write_header = false, success = false;
 
-        // update pfs entry name
-        if (!pfsUpdateEntryNameFromImageContext(&pfs_img_ctx, data_idx, cur_nca_ctx->content_id_str))
-        {
-            consolePrint("pfs update entry name failed for xml \"%s\"\n", cur_nca_ctx->content_id_str);
-            goto end;
-        }
+    /* Register the null sink device. */
+    if (AddDevice(&g_nullSinkDevoptab) < 0)
+    {
+        consolePrint("failed to add null sink device!\n");
+        goto end;
     }
 
-    if (retrieve_tik_cert)
-    {
-        // write ticket
-        if (dev_idx == 1)
-        {
-            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, pfs_img_ctx.header.entry_count - 2);
-            if (!usbSendFileProperties(tik.size, tmp_name) || !usbSendFileData(tik.data, tik.size))
-            {
-                consolePrint("send \"%s\" failed\n", tmp_name);
-                goto end;
-            }
-        } else {
-            fwrite(tik.data, 1, tik.size, fp);
-        }
+    null_sink_added = true;
 
-        nsp_offset += tik.size;
-        nsp_thread_data->data_written += tik.size;
+    /* Append a fake UMS device entry right after the real ones, without updating the UMS device count. */
+    /* Dump functions treat the null sink just like any other UMS device. updateStorageList() gets rid of this entry. */
+    ums_devices = realloc(g_umsDevices, (g_umsDeviceCount + 1) * sizeof(UsbHsFsDevice));
+    if (!ums_devices)
+    {
+        consolePrint("failed to allocate memory for null sink device entry!\n");
+        goto end;
+    }
 
-        // write cert
-        if (dev_idx == 1)
-        {
-            tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, pfs_img_ctx.header.entry_count - 1);
-            if (!usbSendFileProperties(raw_cert_chain_size, tmp_name) || !usbSendFileData(raw_cert_chain, raw_cert_chain_size))
-            {
-                consolePrint("send \"%s\" failed\n", tmp_name);
-                goto end;
-            }
-        } else {
-            fwrite(raw_cert_chain, 1, raw_cert_chain_size, fp);
-        }
+    g_umsDevices = ums_devices;
+    memset(&(g_umsDevices[g_umsDeviceCount]), 0, sizeof(UsbHsFsDevice));
+    snprintf(g_umsDevices[g_umsDeviceCount].name, sizeof(g_umsDevices[g_umsDeviceCount].name), NULL_SINK_DEVICE_NAME ":");
+    g_umsDevices[g_umsDeviceCount].fs_type = UsbHsFsDeviceFileSystemType_exFAT;
 
-        nsp_offset += raw_cert_chain_size;
-        nsp_thread_data->data_written += raw_cert_chain_size;
-    }
+    /* Open CSV file. Results from previous runs are kept. */
+    utilsCreateDirectoryTree(BENCHMARK_CSV_PATH, false);
+    write_header = (stat(BENCHMARK_CSV_PATH, &st) != 0 || !st.st_size);
 
-    // write new pfs0 header
-    if (!pfsWriteImageContextHeaderToMemoryBuffer(&pfs_img_ctx, buf, BLOCK_SIZE, &nsp_header_size))
+    csv_fd = fopen(BENCHMARK_CSV_PATH, "ab");
+    if (!csv_fd)
     {
-        consolePrint("pfs write header to mem #2 failed\n");
+        consolePrint("failed to open \"%s\" for writing!\n", BENCHMARK_CSV_PATH);
         goto end;
     }
 
-    if (dev_idx == 1)
+    if (write_header) fprintf(csv_fd, "build,timestamp,target,case,sink,result,seconds,read_mib,read_mib_s,written_mib,write_mib_s,cpu_read_ms,cpu_decrypt_ms,cpu_hash_ms,cpu_write_ms,cpu_usb_ms,peak_heap_mib\n");
+
+    /* LayeredFS paths, partial RomFS dumps and raw section verification would skew the results. */
+    setNcaFsUseLayeredFsDirOption(0);
+    setNcaFsOnlyUpdatedFilesOption(0);
+    setNcaFsVerifyRawSectionOption(0);
+
+    g_outputBaseDir = BENCHMARK_OUTDIR;
+
+    for(u32 i = 0; i < case_count && g_appletStatus; i++)
     {
-        if (!usbSendNspHeader(buf, (u32)nsp_header_size))
+        for(u8 j = 0; j < BenchmarkSink_Count && g_appletStatus; j++)
         {
-            consolePrint("send nsp header failed\n");
-            goto end;
+            BenchmarkResult res = {0};
+
+            benchmarkRunCase(&(cases[i]), j, &res);
+            benchmarkWriteCsvRow(csv_fd, target, cases[i].name, j, &res);
+
+            /* Flush each row right away, so results aren't lost if a later case crashes. */
+            fflush(csv_fd);
         }
-    } else {
-        rewind(fp);
-        fwrite(buf, 1, nsp_header_size, fp);
     }
 
-    nsp_thread_data->data_written += nsp_header_size;
+    g_outputBaseDir = OUTDIR;
 
-    success = true;
+    setGameCardWriteRawHfsPartitionOption(write_raw_hfs_bkp);
+    setNcaFsWriteRawSectionOption(write_raw_section_bkp);
+    setNcaFsUseLayeredFsDirOption(use_layeredfs_dir_bkp);
+    setNcaFsOnlyUpdatedFilesOption(only_updated_files_bkp);
+    setNcaFsVerifyRawSectionOption(verify_raw_section_bkp);
+
+    success = g_appletStatus;
+    if (success) consolePrint("\nbenchmark results saved to \"%s\"\n", BENCHMARK_CSV_PATH);
 
 end:
-    consoleRefresh();
+    if (csv_fd)
+    {
+        fclose(csv_fd);
+        utilsCommitSdCardFileSystemChanges();
+    }
 
-    mutexLock(&g_fileMutex);
-    if (!success && !nsp_thread_data->transfer_cancelled) nsp_thread_data->error = true;
-    mutexUnlock(&g_fileMutex);
+    g_storageMenuElementOption.selected = dev_idx_bkp;
 
-    if (fp)
+    if (null_sink_added) RemoveDevice(NULL_SINK_DEVICE_NAME ":");
+
+    return success;
+}
+
+static void benchmarkRunCase(const BenchmarkCase *bench_case, u8 sink, BenchmarkResult *out)
+{
+    BenchmarkHeapSampler sampler = {0};
+    Thread sampler_thread = {0};
+    StatsSnapshot stats = {0};
+    char bench_path[FS_MAX_PATH] = {0};
+    u64 start_tick = 0;
+    bool sampler_created = false, success = false;
+
+    out->result = "skipped";
+
+    if (bench_case->skip_reason)
     {
-        fclose(fp);
+        consolePrint("\n%s (%s): skipped (%s)\n", bench_case->name, g_benchmarkSinkNames[sink], bench_case->skip_reason);
+        return;
+    }
 
-        if (!success)
-        {
-            if (dev_idx == 0)
+    /* Select sink. */
+    switch(sink)
+    {
+        case BenchmarkSink_Null:
+            g_storageMenuElementOption.selected = (2 + g_umsDeviceCount);
+            break;
+        case BenchmarkSink_SdCard:
+            g_storageMenuElementOption.selected = 0;
+            break;
+        case BenchmarkSink_UsbHost:
+            if (usbIsReady() == UsbHostSpeed_None)
             {
-                utilsRemoveConcatenationFile(filename);
-                utilsCommitSdCardFileSystemChanges();
-            } else {
-                remove(filename);
+                consolePrint("\n%s (%s): skipped (no usb session)\n", bench_case->name, g_benchmarkSinkNames[sink]);
+                return;
             }
-        }
+
+            g_storageMenuElementOption.selected = 1;
+            break;
+        default:
+            return;
     }
 
-    if (!success && dev_idx == 1) usbCancelFileTransfer();
+    if (bench_case->setter_func) bench_case->setter_func(bench_case->option);
 
-    pfsFreeImageContext(&pfs_img_ctx);
+    consolePrint("\n%s (%s):\n\n", bench_case->name, g_benchmarkSinkNames[sink]);
+    consoleRefresh();
 
-    if (raw_cert_chain) free(raw_cert_chain);
+    /* Reset counters. */
+    statsResetCounters();
+    atomic_store(&g_nullSinkWriteSize, 0);
+    for(u32 i = 0; i < ThreadPlacementStage_Count; i++) atomic_store(&(g_dumpStageCpuTicks[i]), 0);
 
-    if (legal_info_ctx)
-    {
-        for(u32 i = 0; i < legal_info_count; i++) legalInfoFreeContext(&(legal_info_ctx[i]));
-        free(legal_info_ctx);
-    }
+    /* Start heap sampler. Not fatal if it fails. */
+    atomic_store(&(sampler.stop), false);
+    sampler.peak_heap_size = (u64)mallinfo().uordblks;
+    sampler_created = utilsCreateThread(&sampler_thread, benchmarkHeapSamplerThreadFunc, &sampler, -2);
 
-    if (nacp_ctx)
+    /* Run dump. */
+    start_tick = armGetSystemTick();
+    success = bench_case->task_func(bench_case->userdata);
+    out->elapsed_ns = armTicksToNs(armGetSystemTick() - start_tick);
+
+    if (sampler_created)
     {
-        for(u32 i = 0; i < control_count; i++) nacpFreeContext(&(nacp_ctx[i]));
-        free(nacp_ctx);
+        atomic_store(&(sampler.stop), true);
+        utilsJoinThread(&sampler_thread);
     }
 
-    if (program_info_ctx)
+    out->peak_heap_size = MAX(sampler.peak_heap_size, (u64)mallinfo().uordblks);
+
+    /* Source data throughput doesn't depend on how each dump path lays out its output. */
+    statsGetSnapshot(&stats);
+    out->read_size = (stats.counters[StatsCounterType_GameCardRead].byte_count + stats.counters[StatsCounterType_NcmRead].byte_count + \
+                      stats.counters[StatsCounterType_BisRead].byte_count);
+
+    for(u32 i = 0; i < ThreadPlacementStage_Count; i++) out->cpu_ns[i] = armTicksToNs(atomic_load(&(g_dumpStageCpuTicks[i])));
+
+    switch(sink)
     {
-        for(u32 i = 0; i < program_count; i++) programInfoFreeContext(&(program_info_ctx[i]));
-        free(program_info_ctx);
+        case BenchmarkSink_Null:
+            out->write_size = atomic_load(&g_nullSinkWriteSize);
+            break;
+        case BenchmarkSink_SdCard:
+            /* Get rid of the dumped data once it has been measured. */
+            sprintf(bench_path, DEVOPTAB_SDMC_DEVICE "/" BENCHMARK_OUTDIR);
+            utilsGetDirectorySize(bench_path, &(out->write_size));
+            utilsDeleteDirectoryRecursively(bench_path);
+            utilsCommitSdCardFileSystemChanges();
+            break;
+        case BenchmarkSink_UsbHost:
+            out->write_size = stats.counters[StatsCounterType_UsbTransfer].byte_count;
+            break;
+        default:
+            break;
     }
 
-    cnmtFreeContext(&cnmt_ctx);
+    out->result = (success ? "ok" : "failed");
 
-    if (nca_ctx) free(nca_ctx);
+    consolePrint("%s (%s): %s | %.2f MiB/s read | %.2f MiB/s written | peak heap: %.2f MiB\n", bench_case->name, g_benchmarkSinkNames[sink], out->result, \
+                 out->elapsed_ns ? (((double)out->read_size / (double)BENCHMARK_SIZE_MIB) / ((double)out->elapsed_ns / 1000000000.0)) : 0.0, \
+                 out->elapsed_ns ? (((double)out->write_size / (double)BENCHMARK_SIZE_MIB) / ((double)out->elapsed_ns / 1000000000.0)) : 0.0, \
+                 (double)out->peak_heap_size / (double)BENCHMARK_SIZE_MIB);
+    consoleRefresh();
+}
 
-    if (filename) free(filename);
+static void benchmarkWriteCsvRow(FILE *fp, const char *target, const char *case_name, u8 sink, const BenchmarkResult *res)
+{
+    time_t now = time(NULL);
+    struct tm ts = {0};
+    char timestamp[0x20] = {0};
 
-    if (buf) free(buf);
+    double seconds = ((double)res->elapsed_ns / 1000000000.0);
+    double read_mib = ((double)res->read_size / (double)BENCHMARK_SIZE_MIB), written_mib = ((double)res->write_size / (double)BENCHMARK_SIZE_MIB);
+
+    localtime_r(&now, &ts);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &ts);
+
+    fprintf(fp, APP_VERSION "-" GIT_REV ",%s,%s,%s,%s,%s,%.3f,%.2f,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f\n", timestamp, target, case_name, g_benchmarkSinkNames[sink], \
+            res->result, seconds, read_mib, seconds > 0.0 ? (read_mib / seconds) : 0.0, written_mib, seconds > 0.0 ? (written_mib / seconds) : 0.0, \
+            (double)res->cpu_ns[ThreadPlacementStage_Read] / 1000000.0, (double)res->cpu_ns[ThreadPlacementStage_Decrypt] / 1000000.0, \
+            (double)res->cpu_ns[ThreadPlacementStage_Hash] / 1000000.0, (double)res->cpu_ns[ThreadPlacementStage_Write] / 1000000.0, \
+            (double)res->cpu_ns[ThreadPlacementStage_Usb] / 1000000.0, (double)res->peak_heap_size / (double)BENCHMARK_SIZE_MIB);
+}
+
+static void benchmarkHeapSamplerThreadFunc(void *arg)
+{
+    BenchmarkHeapSampler *sampler = (BenchmarkHeapSampler*)arg;
+
+    while(!atomic_load(&(sampler->stop)))
+    {
+        u64 heap_size = (u64)mallinfo().uordblks;
+        if (heap_size > sampler->peak_heap_size) sampler->peak_heap_size = heap_size;
+        svcSleepThread(BENCHMARK_HEAP_SAMPLE_INTERVAL);
+    }
 
     threadExit();
 }
@@ -7490,6 +9832,16 @@ static void setGameCardWriteRawHfsPartitionOption(u32 idx)
     configSetBoolean("gamecard/write_raw_hfs_partition", (bool)idx);
 }
 
+static u32 getGameCardVerifyHfsHashesOption(void)
+{
+    return (u32)configGetBoolean("gamecard/verify_hfs_hashes");
+}
+
+static void setGameCardVerifyHfsHashesOption(u32 idx)
+{
+    configSetBoolean("gamecard/verify_hfs_hashes", (bool)idx);
+}
+
 static u32 getNspSetDownloadDistributionOption(void)
 {
     return (u32)configGetBoolean("nsp/set_download_distribution");
@@ -7600,6 +9952,26 @@ static void setNcaFsUseLayeredFsDirOption(u32 idx)
     configSetBoolean("nca_fs/use_layeredfs_dir", (bool)idx);
 }
 
+static u32 getNcaFsOnlyUpdatedFilesOption(void)
+{
+    return (u32)configGetBoolean("nca_fs/only_updated_files");
+}
+
+static void setNcaFsOnlyUpdatedFilesOption(u32 idx)
+{
+    configSetBoolean("nca_fs/only_updated_files", (bool)idx);
+}
+
+static u32 getNcaFsVerifyRawSectionOption(void)
+{
+    return (u32)configGetBoolean("nca_fs/verify_raw_section");
+}
+
+static void setNcaFsVerifyRawSectionOption(u32 idx)
+{
+    configSetBoolean("nca_fs/verify_raw_section", (bool)idx);
+}
+
 static bool resetSettings(void *userdata)
 {
     NX_IGNORE_ARG(userdata);
@@ -75,38 +75,12 @@ static void writeFile(void *buf, size_t buf_size, const char *path)
     {
         fwrite(buf, 1, buf_size, fd);
         fclose(fd);
-        utilsCommitSdCardFileSystemChanges();
     }
 }
 
-int main(int argc, char *argv[])
+static bool generateUserApplicationXmls(const TitleApplicationMetadata *app_metadata, TitleUserApplicationData *user_app_data, bool verbose)
 {
-    NX_IGNORE_ARG(argc);
-    NX_IGNORE_ARG(argv);
-
-    int ret = EXIT_SUCCESS;
-
-    if (!utilsInitializeResources())
-    {
-        ret = EXIT_FAILURE;
-        goto out;
-    }
-
-    /* Configure input. */
-    /* Up to 8 different, full controller inputs. */
-    /* Individual Joy-Cons not supported. */
-    padConfigureInput(8, HidNpadStyleSet_NpadFullCtrl);
-    padInitializeWithMask(&g_padState, 0x1000000FFUL);
-
-    consoleInit(NULL);
-
-    u32 app_count = 0;
-    TitleApplicationMetadata **app_metadata = NULL;
-    TitleUserApplicationData user_app_data = {0};
-
-    u32 selected_idx = 0, page_size = 30, scroll = 0;
-    bool applet_status = true, exit_prompt = true;
-
+    /* Each NCA from the selected title is only initialized once. All XMLs are then generated from the same set of NCA and content type contexts. */
     NcaContext *nca_ctx = NULL;
     Ticket tik = {0};
 
@@ -123,174 +97,54 @@ int main(int argc, char *argv[])
     LegalInfoContext *legal_info_ctx = NULL;
 
     char path[FS_MAX_PATH] = {0};
+    bool success = false;
 
-    app_metadata = titleGetApplicationMetadataEntries(false, &app_count);
-    if (!app_metadata || !app_count)
-    {
-        consolePrint("app metadata failed\n");
-        goto out2;
-    }
-
-    consolePrint("app metadata succeeded\n");
-
-    utilsSleep(1);
-
-    while((applet_status = appletMainLoop()))
-    {
-        consoleClear();
-        printf("select a user application to generate xmls for.\npress b to exit.\n\n");
-        printf("title: %u / %u\n", selected_idx + 1, app_count);
-        printf("selected title: %016lX - %s\n\n", app_metadata[selected_idx]->title_id, app_metadata[selected_idx]->lang_entry.name);
-
-        for(u32 i = scroll; i < app_count; i++)
-        {
-            if (i >= (scroll + page_size)) break;
-            printf("%s%016lX - %s\n", i == selected_idx ? " -> " : "    ", app_metadata[i]->title_id, app_metadata[i]->lang_entry.name);
-        }
-
-        printf("\n");
-
-        consoleUpdate(NULL);
-
-        u64 btn_down = 0, btn_held = 0;
-        while((applet_status = appletMainLoop()))
-        {
-            utilsScanPads();
-            btn_down = utilsGetButtonsDown();
-            btn_held = utilsGetButtonsHeld();
-            if (btn_down || btn_held) break;
-
-            if (titleIsGameCardInfoUpdated())
-            {
-                free(app_metadata);
-
-                app_metadata = titleGetApplicationMetadataEntries(false, &app_count);
-                if (!app_metadata)
-                {
-                    consolePrint("\napp metadata failed\n");
-                    goto out2;
-                }
-
-                selected_idx = scroll = 0;
-                break;
-            }
-        }
-
-        if (!applet_status) break;
-
-        if (btn_down & HidNpadButton_A)
-        {
-            if (!titleGetUserApplicationData(app_metadata[selected_idx]->title_id, &user_app_data) || !user_app_data.app_info)
-            {
-                consolePrint("\nthe selected title doesn't have available base content.\n");
-                utilsSleep(3);
-                titleFreeUserApplicationData(&user_app_data);
-                continue;
-            }
-
-            break;
-        } else
-        if ((btn_down & HidNpadButton_Down) || (btn_held & (HidNpadButton_StickLDown | HidNpadButton_StickRDown)))
-        {
-            selected_idx++;
-
-            if (selected_idx >= app_count)
-            {
-                if (btn_down & HidNpadButton_Down)
-                {
-                    selected_idx = scroll = 0;
-                } else {
-                    selected_idx = (app_count - 1);
-                }
-            } else
-            if (selected_idx >= (scroll + (page_size / 2)) && app_count > (scroll + page_size))
-            {
-                scroll++;
-            }
-        } else
-        if ((btn_down & HidNpadButton_Up) || (btn_held & (HidNpadButton_StickLUp | HidNpadButton_StickRUp)))
-        {
-            selected_idx--;
-
-            if (selected_idx == UINT32_MAX)
-            {
-                if (btn_down & HidNpadButton_Up)
-                {
-                    selected_idx = (app_count - 1);
-                    scroll = (app_count >= page_size ? (app_count - page_size) : 0);
-                } else {
-                    selected_idx = 0;
-                }
-            } else
-            if (selected_idx < (scroll + (page_size / 2)) && scroll > 0)
-            {
-                scroll--;
-            }
-        } else
-        if (btn_down & HidNpadButton_B)
-        {
-            exit_prompt = false;
-            goto out2;
-        }
-
-        if (btn_held & (HidNpadButton_StickLDown | HidNpadButton_StickRDown | HidNpadButton_StickLUp | HidNpadButton_StickRUp)) svcSleepThread(50000000); // 50 ms
-    }
-
-    if (!applet_status)
-    {
-        exit_prompt = false;
-        goto out2;
-    }
-
-    consoleClear();
-    consolePrint("selected title:\n%s (%016lX)\n\n", app_metadata[selected_idx]->lang_entry.name, app_metadata[selected_idx]->title_id);
-
-    nca_ctx = calloc(user_app_data.app_info->content_count, sizeof(NcaContext));
+    nca_ctx = calloc(user_app_data->app_info->content_count, sizeof(NcaContext));
     if (!nca_ctx)
     {
         consolePrint("nca ctx calloc failed\n");
-        goto out2;
+        goto end;
     }
 
-    consolePrint("nca ctx calloc succeeded\n");
+    if (verbose) consolePrint("nca ctx calloc succeeded\n");
 
-    meta_idx = (user_app_data.app_info->content_count - 1);
+    meta_idx = (user_app_data->app_info->content_count - 1);
 
-    program_count = titleGetContentCountByType(user_app_data.app_info, NcmContentType_Program);
+    program_count = titleGetContentCountByType(user_app_data->app_info, NcmContentType_Program);
     if (program_count && !(program_info_ctx = calloc(program_count, sizeof(ProgramInfoContext))))
     {
         consolePrint("program info ctx calloc failed\n");
-        goto out2;
+        goto end;
     }
 
-    control_count = titleGetContentCountByType(user_app_data.app_info, NcmContentType_Control);
+    control_count = titleGetContentCountByType(user_app_data->app_info, NcmContentType_Control);
     if (control_count && !(nacp_ctx = calloc(control_count, sizeof(NacpContext))))
     {
         consolePrint("nacp ctx calloc failed\n");
-        goto out2;
+        goto end;
     }
 
-    legal_info_count = titleGetContentCountByType(user_app_data.app_info, NcmContentType_LegalInformation);
+    legal_info_count = titleGetContentCountByType(user_app_data->app_info, NcmContentType_LegalInformation);
     if (legal_info_count && !(legal_info_ctx = calloc(legal_info_count, sizeof(LegalInfoContext))))
     {
         consolePrint("legal info ctx calloc failed\n");
-        goto out2;
+        goto end;
     }
 
-    for(u32 i = 0, j = 0; i < user_app_data.app_info->content_count; i++)
+    for(u32 i = 0, j = 0; i < user_app_data->app_info->content_count; i++)
     {
         // set meta nca as the last nca
-        NcmContentInfo *content_info = &(user_app_data.app_info->content_infos[i]);
+        NcmContentInfo *content_info = &(user_app_data->app_info->content_infos[i]);
         if (content_info->content_type == NcmContentType_Meta) continue;
 
-        if (!ncaInitializeContext(&(nca_ctx[j]), user_app_data.app_info->storage_id, (user_app_data.app_info->storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : 0), \
-                                  &(user_app_data.app_info->meta_key), content_info, &tik))
+        if (!ncaInitializeContext(&(nca_ctx[j]), user_app_data->app_info->storage_id, (user_app_data->app_info->storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : 0), \
+                                  &(user_app_data->app_info->meta_key), content_info, &tik))
         {
             consolePrint("%s #%u initialize nca ctx failed\n", titleGetNcmContentTypeName(content_info->content_type), content_info->id_offset);
-            goto out2;
+            goto end;
         }
 
-        consolePrint("%s #%u initialize nca ctx succeeded\n", titleGetNcmContentTypeName(content_info->content_type), content_info->id_offset);
+        if (verbose) consolePrint("%s #%u initialize nca ctx succeeded\n", titleGetNcmContentTypeName(content_info->content_type), content_info->id_offset);
 
         if (nca_ctx[j].fs_ctx[0].has_sparse_layer) continue;
 
@@ -300,7 +154,7 @@ int main(int argc, char *argv[])
                 if (!programInfoInitializeContext(&(program_info_ctx[program_idx]), &(nca_ctx[j])))
                 {
                     consolePrint("initialize program info ctx failed (%s)\n", nca_ctx[j].content_id_str);
-                    goto out2;
+                    goto end;
                 }
 
                 nca_ctx[j].content_type_ctx = &(program_info_ctx[program_idx++]);
@@ -310,7 +164,7 @@ int main(int argc, char *argv[])
                 if (!nacpInitializeContext(&(nacp_ctx[control_idx]), &(nca_ctx[j])))
                 {
                     consolePrint("initialize nacp ctx failed (%s)\n", nca_ctx[j].content_id_str);
-                    goto out2;
+                    goto end;
                 }
 
                 nca_ctx[j].content_type_ctx = &(nacp_ctx[control_idx++]);
@@ -320,7 +174,7 @@ int main(int argc, char *argv[])
                 if (!legalInfoInitializeContext(&(legal_info_ctx[legal_info_idx]), &(nca_ctx[j])))
                 {
                     consolePrint("initialize legal info ctx failed (%s)\n", nca_ctx[j].content_id_str);
-                    goto out2;
+                    goto end;
                 }
 
                 nca_ctx[j].content_type_ctx = &(legal_info_ctx[legal_info_idx++]);
@@ -333,37 +187,37 @@ int main(int argc, char *argv[])
         j++;
     }
 
-    if (!ncaInitializeContext(&(nca_ctx[meta_idx]), user_app_data.app_info->storage_id, (user_app_data.app_info->storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : 0), \
-                              &(user_app_data.app_info->meta_key), titleGetContentInfoByTypeAndIdOffset(user_app_data.app_info, NcmContentType_Meta, 0), &tik))
+    if (!ncaInitializeContext(&(nca_ctx[meta_idx]), user_app_data->app_info->storage_id, (user_app_data->app_info->storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : 0), \
+                              &(user_app_data->app_info->meta_key), titleGetContentInfoByTypeAndIdOffset(user_app_data->app_info, NcmContentType_Meta, 0), &tik))
     {
         consolePrint("meta nca initialize ctx failed\n");
-        goto out2;
+        goto end;
     }
 
-    consolePrint("meta nca initialize ctx succeeded\n");
+    if (verbose) consolePrint("meta nca initialize ctx succeeded\n");
 
     if (!cnmtInitializeContext(&cnmt_ctx, &(nca_ctx[meta_idx])))
     {
         consolePrint("cnmt initialize ctx failed\n");
-        goto out2;
+        goto end;
     }
 
-    consolePrint("cnmt initialize ctx succeeded\n");
+    if (verbose) consolePrint("cnmt initialize ctx succeeded\n");
 
-    sprintf(path, "sdmc:/at_xml/%016lX", app_metadata[selected_idx]->title_id);
+    sprintf(path, "sdmc:/at_xml/%016lX", app_metadata->title_id);
     utilsCreateDirectoryTree(path, true);
 
-    if (cnmtGenerateAuthoringToolXml(&cnmt_ctx, nca_ctx, user_app_data.app_info->content_count))
+    if (cnmtGenerateAuthoringToolXml(&cnmt_ctx, nca_ctx, user_app_data->app_info->content_count))
     {
-        consolePrint("cnmt xml succeeded\n");
+        if (verbose) consolePrint("cnmt xml succeeded\n");
 
-        sprintf(path, "sdmc:/at_xml/%016lX/%s.cnmt.xml", app_metadata[selected_idx]->title_id, cnmt_ctx.nca_ctx->content_id_str);
+        sprintf(path, "sdmc:/at_xml/%016lX/%s.cnmt.xml", app_metadata->title_id, cnmt_ctx.nca_ctx->content_id_str);
         writeFile(cnmt_ctx.authoring_tool_xml, cnmt_ctx.authoring_tool_xml_size, path);
     } else {
         consolePrint("cnmt xml failed\n");
     }
 
-    for(u32 i = 0; i < user_app_data.app_info->content_count; i++)
+    for(u32 i = 0; i < user_app_data->app_info->content_count; i++)
     {
         NcaContext *cur_nca_ctx = &(nca_ctx[i]);
 
@@ -377,12 +231,12 @@ int main(int argc, char *argv[])
                 if (!programInfoGenerateAuthoringToolXml(cur_program_info_ctx))
                 {
                     consolePrint("program info xml failed (%s | id offset #%u)\n", cur_nca_ctx->content_id_str, cur_nca_ctx->id_offset);
-                    goto out2;
+                    goto end;
                 }
 
-                consolePrint("program info xml succeeded (%s | id offset #%u)\n", cur_nca_ctx->content_id_str, cur_nca_ctx->id_offset);
+                if (verbose) consolePrint("program info xml succeeded (%s | id offset #%u)\n", cur_nca_ctx->content_id_str, cur_nca_ctx->id_offset);
 
-                sprintf(path, "sdmc:/at_xml/%016lX/%s.programinfo.xml", app_metadata[selected_idx]->title_id, cur_nca_ctx->content_id_str);
+                sprintf(path, "sdmc:/at_xml/%016lX/%s.programinfo.xml", app_metadata->title_id, cur_nca_ctx->content_id_str);
                 writeFile(cur_program_info_ctx->authoring_tool_xml, cur_program_info_ctx->authoring_tool_xml_size, path);
 
                 break;
@@ -390,24 +244,24 @@ int main(int argc, char *argv[])
             case NcmContentType_Control:
             {
                 NacpContext *cur_nacp_ctx = (NacpContext*)cur_nca_ctx->content_type_ctx;
-                if (!nacpGenerateAuthoringToolXml(cur_nacp_ctx, user_app_data.app_info->version.value, cnmtGetRequiredTitleVersion(&cnmt_ctx)))
+                if (!nacpGenerateAuthoringToolXml(cur_nacp_ctx, user_app_data->app_info->version.value, cnmtGetRequiredTitleVersion(&cnmt_ctx)))
                 {
                     consolePrint("nacp xml failed (%s | id offset #%u)\n", cur_nca_ctx->content_id_str, cur_nca_ctx->id_offset);
-                    goto out2;
+                    goto end;
                 }
 
-                consolePrint("nacp xml succeeded (%s | id offset #%u)\n", cur_nca_ctx->content_id_str, cur_nca_ctx->id_offset);
+                if (verbose) consolePrint("nacp xml succeeded (%s | id offset #%u)\n", cur_nca_ctx->content_id_str, cur_nca_ctx->id_offset);
 
-                //sprintf(path, "sdmc:/at_xml/%016lX/%s.nacp", app_metadata[selected_idx]->title_id, cur_nca_ctx->content_id_str);
+                //sprintf(path, "sdmc:/at_xml/%016lX/%s.nacp", app_metadata->title_id, cur_nca_ctx->content_id_str);
                 //writeFile(cur_nacp_ctx->data, sizeof(_NacpStruct), path);
 
-                sprintf(path, "sdmc:/at_xml/%016lX/%s.nacp.xml", app_metadata[selected_idx]->title_id, cur_nca_ctx->content_id_str);
+                sprintf(path, "sdmc:/at_xml/%016lX/%s.nacp.xml", app_metadata->title_id, cur_nca_ctx->content_id_str);
                 writeFile(cur_nacp_ctx->authoring_tool_xml, cur_nacp_ctx->authoring_tool_xml_size, path);
 
                 for(u8 j = 0; j < cur_nacp_ctx->icon_count; j++)
                 {
                     NacpIconContext *icon_ctx = &(cur_nacp_ctx->icon_ctx[j]);
-                    sprintf(path, "sdmc:/at_xml/%016lX/%s.nx.%s.jpg", app_metadata[selected_idx]->title_id, cur_nca_ctx->content_id_str, nacpGetLanguageString(icon_ctx->language));
+                    sprintf(path, "sdmc:/at_xml/%016lX/%s.nx.%s.jpg", app_metadata->title_id, cur_nca_ctx->content_id_str, nacpGetLanguageString(icon_ctx->language));
                     writeFile(icon_ctx->icon_data, icon_ctx->icon_size, path);
                 }
 
@@ -417,10 +271,10 @@ int main(int argc, char *argv[])
             {
                 LegalInfoContext *cur_legal_info_ctx = (LegalInfoContext*)cur_nca_ctx->content_type_ctx;
 
-                sprintf(path, "sdmc:/at_xml/%016lX/%s.legalinfo.xml", app_metadata[selected_idx]->title_id, cur_nca_ctx->content_id_str);
+                sprintf(path, "sdmc:/at_xml/%016lX/%s.legalinfo.xml", app_metadata->title_id, cur_nca_ctx->content_id_str);
                 writeFile(cur_legal_info_ctx->authoring_tool_xml, cur_legal_info_ctx->authoring_tool_xml_size, path);
 
-                consolePrint("legal info xml succeeded (%s | id offset #%u)\n", cur_nca_ctx->content_id_str, cur_nca_ctx->id_offset);
+                if (verbose) consolePrint("legal info xml succeeded (%s | id offset #%u)\n", cur_nca_ctx->content_id_str, cur_nca_ctx->id_offset);
 
                 break;
             }
@@ -429,12 +283,11 @@ int main(int argc, char *argv[])
         }
     }
 
-out2:
-    if (exit_prompt)
-    {
-        consolePrint("press any button to exit\n");
-        utilsWaitForButtonPress(0);
-    }
+    success = true;
+
+end:
+    /* SD card changes are only committed once per title. */
+    utilsCommitSdCardFileSystemChanges();
 
     if (legal_info_ctx)
     {
@@ -458,6 +311,210 @@ out2:
 
     if (nca_ctx) free(nca_ctx);
 
+    return success;
+}
+
+static void generateLibraryXmls(TitleApplicationMetadata **app_metadata, u32 app_count)
+{
+    u32 success_count = 0, fail_count = 0, skip_count = 0;
+
+    /* Export the whole library in a single pass. Only the current title and any failures are printed, which keeps console updates to a minimum. */
+    for(u32 i = 0; i < app_count; i++)
+    {
+        if (!appletMainLoop()) break;
+
+        TitleUserApplicationData user_app_data = {0};
+
+        if (!titleGetUserApplicationData(app_metadata[i]->title_id, &user_app_data) || !user_app_data.app_info)
+        {
+            titleFreeUserApplicationData(&user_app_data);
+            skip_count++;
+            continue;
+        }
+
+        consolePrint("(%u / %u) %016lX - %s\n", i + 1, app_count, app_metadata[i]->title_id, app_metadata[i]->lang_entry.name);
+
+        if (generateUserApplicationXmls(app_metadata[i], &user_app_data, false))
+        {
+            success_count++;
+        } else {
+            fail_count++;
+        }
+
+        titleFreeUserApplicationData(&user_app_data);
+    }
+
+    consolePrint("\nbatch xml generation finished (%u succeeded, %u failed, %u without base content).\n", success_count, fail_count, skip_count);
+}
+
+int main(int argc, char *argv[])
+{
+    NX_IGNORE_ARG(argc);
+    NX_IGNORE_ARG(argv);
+
+    int ret = EXIT_SUCCESS;
+
+    if (!utilsInitializeResources())
+    {
+        ret = EXIT_FAILURE;
+        goto out;
+    }
+
+    /* Configure input. */
+    /* Up to 8 different, full controller inputs. */
+    /* Individual Joy-Cons not supported. */
+    padConfigureInput(8, HidNpadStyleSet_NpadFullCtrl);
+    padInitializeWithMask(&g_padState, 0x1000000FFUL);
+
+    consoleInit(NULL);
+
+    u32 app_count = 0;
+    TitleApplicationMetadata **app_metadata = NULL;
+    TitleUserApplicationData user_app_data = {0};
+
+    u32 selected_idx = 0, page_size = 30, scroll = 0;
+    bool applet_status = true, exit_prompt = true, batch = false;
+
+    app_metadata = titleGetApplicationMetadataEntries(false, &app_count);
+    if (!app_metadata || !app_count)
+    {
+        consolePrint("app metadata failed\n");
+        goto out2;
+    }
+
+    consolePrint("app metadata succeeded\n");
+
+    utilsSleep(1);
+
+    while((applet_status = appletMainLoop()))
+    {
+        consoleClear();
+        printf("select a user application to generate xmls for.\npress y to generate xmls for all user applications.\npress b to exit.\n\n");
+        printf("title: %u / %u\n", selected_idx + 1, app_count);
+        printf("selected title: %016lX - %s\n\n", app_metadata[selected_idx]->title_id, app_metadata[selected_idx]->lang_entry.name);
+
+        for(u32 i = scroll; i < app_count; i++)
+        {
+            if (i >= (scroll + page_size)) break;
+            printf("%s%016lX - %s\n", i == selected_idx ? " -> " : "    ", app_metadata[i]->title_id, app_metadata[i]->lang_entry.name);
+        }
+
+        printf("\n");
+
+        consoleUpdate(NULL);
+
+        u64 btn_down = 0, btn_held = 0;
+        while((applet_status = appletMainLoop()))
+        {
+            utilsScanPads();
+            btn_down = utilsGetButtonsDown();
+            btn_held = utilsGetButtonsHeld();
+            if (btn_down || btn_held) break;
+
+            if (titleIsGameCardInfoUpdated())
+            {
+                free(app_metadata);
+
+                app_metadata = titleGetApplicationMetadataEntries(false, &app_count);
+                if (!app_metadata)
+                {
+                    consolePrint("\napp metadata failed\n");
+                    goto out2;
+                }
+
+                selected_idx = scroll = 0;
+                break;
+            }
+        }
+
+        if (!applet_status) break;
+
+        if (btn_down & HidNpadButton_A)
+        {
+            if (!titleGetUserApplicationData(app_metadata[selected_idx]->title_id, &user_app_data) || !user_app_data.app_info)
+            {
+                consolePrint("\nthe selected title doesn't have available base content.\n");
+                utilsSleep(3);
+                titleFreeUserApplicationData(&user_app_data);
+                continue;
+            }
+
+            break;
+        } else
+        if (btn_down & HidNpadButton_Y)
+        {
+            batch = true;
+            break;
+        } else
+        if ((btn_down & HidNpadButton_Down) || (btn_held & (HidNpadButton_StickLDown | HidNpadButton_StickRDown)))
+        {
+            selected_idx++;
+
+            if (selected_idx >= app_count)
+            {
+                if (btn_down & HidNpadButton_Down)
+                {
+                    selected_idx = scroll = 0;
+                } else {
+                    selected_idx = (app_count - 1);
+                }
+            } else
+            if (selected_idx >= (scroll + (page_size / 2)) && app_count > (scroll + page_size))
+            {
+                scroll++;
+            }
+        } else
+        if ((btn_down & HidNpadButton_Up) || (btn_held & (HidNpadButton_StickLUp | HidNpadButton_StickRUp)))
+        {
+            selected_idx--;
+
+            if (selected_idx == UINT32_MAX)
+            {
+                if (btn_down & HidNpadButton_Up)
+                {
+                    selected_idx = (app_count - 1);
+                    scroll = (app_count >= page_size ? (app_count - page_size) : 0);
+                } else {
+                    selected_idx = 0;
+                }
+            } else
+            if (selected_idx < (scroll + (page_size / 2)) && scroll > 0)
+            {
+                scroll--;
+            }
+        } else
+        if (btn_down & HidNpadButton_B)
+        {
+            exit_prompt = false;
+            goto out2;
+        }
+
+        if (btn_held & (HidNpadButton_StickLDown | HidNpadButton_StickRDown | HidNpadButton_StickLUp | HidNpadButton_StickRUp)) svcSleepThread(50000000); // 50 ms
+    }
+
+    if (!applet_status)
+    {
+        exit_prompt = false;
+        goto out2;
+    }
+
+    consoleClear();
+
+    if (batch)
+    {
+        generateLibraryXmls(app_metadata, app_count);
+    } else {
+        consolePrint("selected title:\n%s (%016lX)\n\n", app_metadata[selected_idx]->lang_entry.name, app_metadata[selected_idx]->title_id);
+        generateUserApplicationXmls(app_metadata[selected_idx], &user_app_data, true);
+    }
+
+out2:
+    if (exit_prompt)
+    {
+        consolePrint("press any button to exit\n");
+        utilsWaitForButtonPress(0);
+    }
+
     titleFreeUserApplicationData(&user_app_data);
 
     if (app_metadata) free(app_metadata);
@@ -23,6 +23,7 @@
 
 # This script depends on PyUSB and tqdm.
 # Optionally, comtypes may also be installed under Windows to provide taskbar progress functionality.
+# lz4 is optional as well. It's only needed to receive compressed USB transfers from nxdumptool.
 
 # Use `pip -r requirements.txt` under Linux or MacOS to install these dependencies.
 # Windows users may just double-click `windows_install_deps.py` to achieve the same result.
@@ -38,12 +39,15 @@ import sys
 import os
 import platform
 import threading
+import multiprocessing
 import traceback
 import logging
 import queue
 import shutil
 import time
 import struct
+import hashlib
+import zlib
 import usb.core
 import usb.util
 import warnings
@@ -57,7 +61,15 @@ from tqdm import tqdm
 
 from argparse import ArgumentParser
 
-from io import BufferedWriter
+from io import BufferedWriter, FileIO
+
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# LZ4 support is optional. Compressed transfers are only advertised to nxdumptool if the lz4 module is available.
+try:
+    import lz4.block as lz4_block
+except ImportError:
+    lz4_block = None
 from typing import Generator, Any, Callable
 
 # Scaling factors.
@@ -85,9 +97,25 @@ USB_DEV_PRODUCT = 'nxdumptool'
 # USB timeout (milliseconds).
 USB_TRANSFER_TIMEOUT = 10000
 
-# USB transfer block size.
+# USB transfer block size. Used as an upper limit during the StartSession handshake.
 USB_TRANSFER_BLOCK_SIZE = 0x800000
 
+# Smallest USB transfer block size we can negotiate with nxdumptool.
+USB_TRANSFER_MIN_BLOCK_SIZE = 0x100000
+
+# Preferred USB transfer block size and number of in-flight transfers, per endpoint max packet size (link speed).
+USB_TRANSFER_PARAMS = {
+    0x40:  (0x100000, 2), # USB 1.x (FullSpeed).
+    0x200: (0x200000, 4), # USB 2.0 (HighSpeed).
+    0x400: (0x800000, 4)  # USB 3.0 (SuperSpeed).
+}
+
+# Fraction of the available host memory we're allowed to use for a single USB transfer block.
+USB_TRANSFER_MEMORY_DIVISOR = 16
+
+# Max number of received data chunks waiting to be written to disk. Used to bound the queue between the USB reader and the file writer thread.
+FILE_WRITER_QUEUE_SIZE = 4
+
 # USB transfer threshold. Used to determine whether a progress bar should be displayed or not.
 USB_TRANSFER_THRESHOLD = (USB_TRANSFER_BLOCK_SIZE * 4)
 
@@ -96,7 +124,7 @@ USB_MAGIC_WORD = b'NXDT'
 
 # Supported USB ABI version.
 USB_ABI_VERSION_MAJOR = 1
-USB_ABI_VERSION_MINOR = 2
+USB_ABI_VERSION_MINOR = 13
 
 # USB command header size.
 USB_CMD_HEADER_SIZE = 0x10
@@ -109,11 +137,44 @@ USB_CMD_SEND_NSP_HEADER         = 3
 USB_CMD_END_SESSION             = 4
 USB_CMD_START_EXTRACTED_FS_DUMP = 5
 USB_CMD_END_EXTRACTED_FS_DUMP   = 6
+USB_CMD_SEND_FILE_REFERENCE     = 7
+USB_CMD_SEND_FILE_BATCH         = 8
+USB_CMD_VERIFY_FILE_CHECKSUM    = 9
+USB_CMD_RESUME_FILE             = 10
+USB_CMD_START_NSP_LAYOUT        = 11
+USB_CMD_SEND_NSP_LAYOUT_DATA    = 12
+USB_CMD_START_LINK_BENCHMARK    = 13
+USB_CMD_START_FILE_DELTA        = 14
+USB_CMD_GET_FILE_DELTA_HASHES   = 15
+USB_CMD_SEND_FILE_DELTA_DATA    = 16
+USB_CMD_END_FILE_DELTA          = 17
 
 # USB command block sizes.
 USB_CMD_BLOCK_SIZE_START_SESSION           = 0x10
 USB_CMD_BLOCK_SIZE_SEND_FILE_PROPERTIES    = 0x320
 USB_CMD_BLOCK_SIZE_START_EXTRACTED_FS_DUMP = 0x310
+USB_CMD_BLOCK_SIZE_SEND_FILE_REFERENCE     = 0x620
+USB_CMD_BLOCK_SIZE_VERIFY_FILE_CHECKSUM    = 0x30
+USB_CMD_BLOCK_SIZE_RESUME_FILE             = 0x318
+USB_CMD_BLOCK_SIZE_SEND_NSP_LAYOUT_DATA    = 0x20
+USB_CMD_BLOCK_SIZE_START_LINK_BENCHMARK    = 0x10
+USB_CMD_BLOCK_SIZE_START_FILE_DELTA        = 0x318
+USB_CMD_BLOCK_SIZE_GET_FILE_DELTA_HASHES   = 0x10
+USB_CMD_BLOCK_SIZE_SEND_FILE_DELTA_DATA    = 0x18
+
+# SendFileBatch command block header and file record sizes. File records are variable-length.
+USB_FILE_BATCH_HEADER_SIZE = 0x10
+USB_FILE_BATCH_RECORD_SIZE = 0x10
+
+# Max number of file entries within a single SendFileBatch command.
+USB_FILE_BATCH_MAX_ENTRY_COUNT = 0x2000
+
+# StartNspLayout command block header and region record sizes.
+USB_NSP_LAYOUT_HEADER_SIZE = 0x318
+USB_NSP_LAYOUT_RECORD_SIZE = 0x10
+
+# Max number of regions within a single StartNspLayout command, including the NSP header.
+USB_NSP_LAYOUT_MAX_ENTRY_COUNT = 0x100
 
 # Max filename length (file properties).
 USB_FILE_PROPERTIES_MAX_NAME_LENGTH = 0x300
@@ -125,6 +186,53 @@ USB_STATUS_UNSUPPORTED_CMD         = 5
 USB_STATUS_UNSUPPORTED_ABI_VERSION = 6
 USB_STATUS_MALFORMED_CMD           = 7
 USB_STATUS_HOST_IO_ERROR           = 8
+USB_STATUS_CHECKSUM_MISMATCH       = 9
+
+# Checksum types requested by nxdumptool through SendFileProperties.
+USB_CHECKSUM_TYPE_NONE   = 0
+USB_CHECKSUM_TYPE_CRC32  = 1
+USB_CHECKSUM_TYPE_SHA256 = 2
+
+# Compression types requested by nxdumptool through SendFileProperties. Also used in file data frame headers.
+USB_COMPRESSION_TYPE_NONE = 0
+USB_COMPRESSION_TYPE_LZ4  = 1
+
+# File data frame header size. Only used under compressed transfers.
+USB_FILE_DATA_FRAME_HEADER_SIZE = 0x10
+
+# Size of the block sent right after the status response for a ResumeFile command.
+USB_RESUME_INFO_SIZE = 0x30
+
+# Required alignment for StartLinkBenchmark chunk sizes. Always a multiple of the endpoint max packet size, so no ZLT packets are involved.
+USB_LINK_BENCHMARK_CHUNK_ALIGNMENT = 0x1000
+
+# Max number of bytes from an incomplete file covered by the check hash sent to nxdumptool through ResumeFile.
+USB_RESUME_CHECK_SIZE = 0x100000
+
+# Size of each SHA-256 block checksum sent right after the status response for a GetFileDeltaHashes command.
+USB_FILE_DELTA_HASH_SIZE = 0x20
+
+# Progress files used to resume interrupted file transfers. Stored next to each incomplete output file.
+RESUME_INFO_FILE_EXTENSION = '.nxdtpart'
+RESUME_INFO_FILE_MAGIC = b'NXRP'
+RESUME_INFO_FILE_SIZE = 0x18
+
+# Amount of data written to an output file in-between progress file updates.
+RESUME_INFO_UPDATE_INTERVAL = 0x10000000
+
+# Compressed output files generated by nxdumptool (".nxz"). See README.md for a description of the container layout.
+NXZ_FILE_EXTENSION = '.nxz'
+NXZ_HEADER_MAGIC = b'NXDZ'
+NXZ_FOOTER_MAGIC = b'NXZI'
+NXZ_CONTAINER_VERSION = 1
+NXZ_HEADER_SIZE = 0x20
+NXZ_BLOCK_ENTRY_SIZE = 0x10
+NXZ_FOOTER_SIZE = 0x10
+
+# Block types used by compressed output files.
+NXZ_BLOCK_TYPE_STORED = 0
+NXZ_BLOCK_TYPE_LZ4    = 1
+NXZ_BLOCK_TYPE_FILL   = 2
 
 # Script title.
 SCRIPT_TITLE = f'{USB_DEV_PRODUCT} host script v{APP_VERSION}'
@@ -135,6 +243,27 @@ COPYRIGHT_TEXT = f'Copyright (c) {COPYRIGHT_YEAR}, {USB_DEV_MANUFACTURER}'
 # Messages displayed as labels.
 SERVER_START_MSG = f'Please connect a Nintendo Switch console running {USB_DEV_PRODUCT}.'
 SERVER_STOP_MSG = f'Exit {USB_DEV_PRODUCT} on your console or disconnect it at any time to stop the server.'
+MULTI_SERVER_START_MSG = f'Connect any number of Nintendo Switch consoles running {USB_DEV_PRODUCT}.'
+
+# Multi-console server timings (seconds).
+# Connected consoles are enumerated once per poll interval. Sessions report transferred data once per progress interval, and per-console throughput is logged once per stats interval.
+MULTI_SERVER_POLL_INTERVAL = 1.0
+MULTI_SERVER_PROGRESS_INTERVAL = 0.25
+MULTI_SERVER_STATS_INTERVAL = 10.0
+
+# Daemon mode metrics endpoint defaults. The endpoint is only reachable from the local machine by default.
+DAEMON_METRICS_ADDR = '127.0.0.1'
+DAEMON_METRICS_PORT = 9480
+
+# Daemon mode metrics sampling interval (seconds). Transfer rates are calculated once per interval, and session processes send their metrics to the multi-console server once per interval.
+DAEMON_SAMPLE_INTERVAL = 1.0
+
+# Console name used for metrics under single console mode.
+DAEMON_DEFAULT_CONSOLE = 'default'
+
+# Daemon mode metric names. Counters are accumulated across sessions, while gauges only reflect the current state.
+DAEMON_METRICS_COUNTERS = ('bytes', 'chunks', 'usb_wait', 'disk_write', 'transfers', 'errors')
+DAEMON_METRICS_GAUGES = ('max_usb_wait', 'transfer_size', 'transfer_offset', 'active')
 
 # Default directory paths.
 INITIAL_DIR = os.path.dirname(os.path.abspath(os.path.expanduser(os.path.expandvars(sys.argv[0]))))
@@ -320,6 +449,7 @@ g_tkServerButton: tk.Button | None = None
 g_tkTipMessage: int = 0
 g_tkScrolledTextLog: scrolledtext.ScrolledText | None = None
 g_tkVerboseCheckbox: tk.Checkbutton | None = None
+g_tkMultiCheckbox: tk.Checkbutton | None = None
 
 g_logger: logging.Logger | None = None
 
@@ -328,10 +458,27 @@ g_stopEvent: threading.Event | None = None
 g_tlb: Any = None
 g_taskbar: Any = None
 
+g_multiMode: bool = False
+g_daemonMode: bool = False
+g_metrics: DaemonMetrics | None = None
+g_metricsConsole: str = DAEMON_DEFAULT_CONSOLE
+g_multiIntVar: tk.IntVar | None = None
+g_sessionManager: SessionManager | None = None
+
+# Physical location of the only console a session process is allowed to claim (see usbGetDeviceLocation()). Unused outside of session processes.
+g_usbDevLocation: str | None = None
+
 g_usbEpIn: Any = None
 g_usbEpOut: Any = None
 g_usbEpMaxPacketSize: int = 0
 
+# Dedicated file data endpoint pair. Only available under HOS 5.0.0+, and only used if both sides agree on it during StartSession.
+g_usbDataEpIn: Any = None
+g_usbDataEpOut: Any = None
+g_usbDataEpEnabled: bool = False
+g_usbTransferBlockSize: int = USB_TRANSFER_BLOCK_SIZE
+g_usbPendingTransfers: int = 0
+
 g_nxdtVersionMajor: int = 0
 g_nxdtVersionMinor: int = 0
 g_nxdtVersionMicro: int = 0
@@ -343,9 +490,28 @@ g_nspTransferMode: bool = False
 g_nspSize: int = 0
 g_nspHeaderSize: int = 0
 g_nspRemainingSize: int = 0
-g_nspFile: BufferedWriter | None = None
+g_nspFile: FileIO | None = None
 g_nspFilePath: str = ''
 
+# NSP layout mode. Each region is held as an (offset, size) tuple, along with the amount of data received for it so far.
+# Checksums requested for a region are held as (checksum type, hasher, next offset) tuples, indexed by region.
+g_nspLayoutMode: bool = False
+g_nspLayout: list[tuple[int, int]] = []
+g_nspLayoutReceived: list[int] = []
+g_nspLayoutHashers: dict[int, tuple[int, Any, int]] = {}
+
+# File delta mode. Blocks past the size of the file we already held when it started never match, so nxdumptool always sends them.
+g_fileDeltaMode: bool = False
+g_fileDeltaSize: int = 0
+g_fileDeltaExistingSize: int = 0
+g_fileDeltaBlockSize: int = 0
+g_fileDeltaProcessedSize: int = 0
+g_fileDeltaReceivedSize: int = 0
+g_fileDeltaFile: FileIO | None = None
+g_fileDeltaFilePath: str = ''
+
+g_lastFileChecksum: tuple[int, bytes] | None = None
+
 # Reference: https://beenje.github.io/blog/posts/logging-to-a-tkinter-scrolledtext-widget.
 class LogQueueHandler(logging.Handler):
     def __init__(self, log_queue: queue.Queue) -> None:
@@ -359,6 +525,22 @@ class LogQueueHandler(logging.Handler):
         else:
             self.log_queue.put(record)
 
+class SessionLogHandler(logging.Handler):
+    """
+    Forwards log messages from a session process to the multi-console server process, which displays them prefixed with the console location.
+    """
+
+    def __init__(self, event_queue: Any, location: str) -> None:
+        super().__init__()
+        self.event_queue = event_queue
+        self.location = location
+
+    def emit(self, record: logging.LogRecord) -> None:
+        try:
+            self.event_queue.put(('log', self.location, record.levelno, self.format(record)))
+        except:
+            pass
+
 # Reference: https://beenje.github.io/blog/posts/logging-to-a-tkinter-scrolledtext-widget.
 class LogConsole:
     def __init__(self, scrolled_text: scrolledtext.ScrolledText | None = None) -> None:
@@ -576,7 +758,386 @@ class ProgressBarWindow:
     def set_prefix(self, prefix) -> None:
         self.prefix = prefix
 
-g_progressBarWindow: ProgressBarWindow | None = None
+class DaemonProgressReporter:
+    """
+    Drop-in replacement for ProgressBarWindow used under daemon mode. Nothing is displayed: the current transfer state is just stored in the daemon metrics object (if available).
+    No rates are calculated here, which keeps per-chunk overhead to a minimum. The metrics object samples them at a fixed rate instead.
+    """
+
+    def start(self, total: int, n: int = 0, prefix: str = '') -> None:
+        if (total <= 0) or (n < 0):
+            raise Exception('Invalid arguments!')
+
+        if g_metrics is not None:
+            g_metrics.add(g_metricsConsole, transfers=1)
+            g_metrics.set(g_metricsConsole, transfer_size=total, transfer_offset=n, active=1)
+
+    def update(self, n: int) -> None:
+        if g_metrics is not None:
+            g_metrics.add(g_metricsConsole, transfer_offset=n)
+
+    def end(self) -> None:
+        if g_metrics is not None:
+            g_metrics.set(g_metricsConsole, transfer_size=0, transfer_offset=0, active=0)
+
+    def set_prefix(self, prefix) -> None:
+        pass
+
+class SessionProgressReporter(DaemonProgressReporter):
+    """
+    Drop-in replacement for ProgressBarWindow used by session processes. Nothing is displayed: transferred sizes are periodically sent to the multi-console server process instead.
+    """
+
+    def __init__(self, event_queue: Any, location: str) -> None:
+        self.event_queue = event_queue
+        self.location = location
+        self.pending: int = 0
+        self.prev_report_time: float = 0
+
+    def _report(self, active: bool, force: bool = False) -> None:
+        cur_time = time.time()
+        if (not force) and ((cur_time - self.prev_report_time) < MULTI_SERVER_PROGRESS_INTERVAL):
+            return
+
+        self.event_queue.put(('progress', self.location, self.pending, active))
+        self.pending = 0
+        self.prev_report_time = cur_time
+
+    def start(self, total: int, n: int = 0, prefix: str = '') -> None:
+        super().start(total, n, prefix)
+        self._report(True, True)
+
+    def update(self, n: int) -> None:
+        super().update(n)
+        self.pending += n
+        self._report(True)
+
+    def end(self) -> None:
+        super().end()
+        self._report(False, True)
+
+g_progressBarWindow: ProgressBarWindow | DaemonProgressReporter | None = None
+
+class Crc32Hasher:
+    """
+    Provides a hashlib-like interface for CRC32 checksums. The digest is stored in little endian order, just like nxdumptool does.
+    """
+
+    def __init__(self) -> None:
+        self.crc = 0
+
+    def update(self, data: bytes) -> None:
+        self.crc = zlib.crc32(data, self.crc)
+
+    def digest(self) -> bytes:
+        return struct.pack('<I', self.crc)
+
+class ResumeTracker:
+    """
+    Keeps track of the amount of data written to an output file and its CRC32 checksum, so nxdumptool can resume an interrupted file transfer through ResumeFile.
+    Progress is periodically saved to a small file stored next to the output file. Data is flushed to disk beforehand, so we never claim to hold data we don't have.
+    """
+
+    def __init__(self, fullpath: str, file_size: int, offset: int = 0, crc: int = 0) -> None:
+        self.fullpath = fullpath
+        self.file_size = file_size
+        self.offset = offset
+        self.crc = crc
+        self.saved_offset = offset
+
+    def update(self, file: Any, chunk: bytes) -> None:
+        self.crc = zlib.crc32(chunk, self.crc)
+        self.offset += len(chunk)
+
+        if (self.offset - self.saved_offset) >= RESUME_INFO_UPDATE_INTERVAL:
+            os.fsync(file.fileno())
+            self.save()
+
+    def save(self) -> None:
+        # Best effort. There's nothing worth saving if we haven't written anything.
+        if not self.offset:
+            return
+
+        try:
+            with open(self.fullpath + RESUME_INFO_FILE_EXTENSION, 'wb') as file:
+                file.write(struct.pack('<4sIQQ', RESUME_INFO_FILE_MAGIC, self.crc, self.file_size, self.offset))
+            self.saved_offset = self.offset
+        except:
+            utilsLogException(traceback.format_exc())
+
+    def remove(self) -> None:
+        ResumeTracker.discard(self.fullpath)
+
+    @staticmethod
+    def load(fullpath: str, file_size: int) -> tuple[int, int] | None:
+        # Returns the offset and CRC32 checksum saved for an incomplete output file with the provided size, or None if it can't be resumed.
+        try:
+            with open(fullpath + RESUME_INFO_FILE_EXTENSION, 'rb') as file:
+                (magic, crc, saved_file_size, offset) = struct.unpack('<4sIQQ', file.read(RESUME_INFO_FILE_SIZE))
+
+            if (magic != RESUME_INFO_FILE_MAGIC) or (saved_file_size != file_size) or (not offset) or (offset >= file_size) or (os.path.getsize(fullpath) < offset):
+                return None
+        except:
+            return None
+
+        return (offset, crc)
+
+    @staticmethod
+    def discard(fullpath: str) -> None:
+        try:
+            os.remove(fullpath + RESUME_INFO_FILE_EXTENSION)
+        except FileNotFoundError:
+            pass
+        except:
+            utilsLogException(traceback.format_exc())
+
+class TransferStats:
+    """
+    Keeps track of where time is spent during a single file data transfer, so we can tell which side is slowing it down.
+    USB wait time covers every usbRead() call from the data transfer stage, while disk time covers every file write (and resume progress file update).
+    """
+
+    def __init__(self) -> None:
+        self.start_time = time.perf_counter()
+        self.chunk_count = 0
+        self.size = 0
+        self.usb_time = 0.0
+        self.max_usb_time = 0.0
+        self.disk_time = 0.0
+        self.max_queue_depth = 0
+
+    def addChunk(self, size: int, usb_time: float) -> None:
+        self.chunk_count += 1
+        self.size += size
+        self.usb_time += usb_time
+        if usb_time > self.max_usb_time:
+            self.max_usb_time = usb_time
+
+        if g_metrics is not None:
+            g_metrics.addChunk(g_metricsConsole, size, usb_time)
+
+    def addDiskTime(self, disk_time: float) -> None:
+        self.disk_time += disk_time
+
+        if g_metrics is not None:
+            g_metrics.add(g_metricsConsole, disk_write=disk_time)
+
+    def updateQueueDepth(self, depth: int) -> None:
+        if depth > self.max_queue_depth:
+            self.max_queue_depth = depth
+
+    def log(self, label: str) -> None:
+        if (g_logger is None) or (not self.chunk_count):
+            return
+
+        elapsed_time = max(time.perf_counter() - self.start_time, 1e-6)
+        speed = (self.size / elapsed_time / (1024 * 1024))
+        avg_usb_time = (self.usb_time / self.chunk_count)
+
+        g_logger.debug(f'{label} stats: {self.chunk_count} chunk(s), 0x{self.size:X} bytes in {elapsed_time:.3f} s ({speed:.2f} MiB/s). ' \
+                       f'USB wait: {self.usb_time:.3f} s (avg {avg_usb_time * 1000:.3f} ms, max {self.max_usb_time * 1000:.3f} ms per chunk). ' \
+                       f'Disk write: {self.disk_time:.3f} s. Max writer queue depth: {self.max_queue_depth}.')
+
+class DaemonMetrics:
+    """
+    Holds the metrics exposed by the daemon mode HTTP endpoint, grouped by console, using the Prometheus text exposition format.
+    Counters are updated by the transfer code paths as data comes in, while transfer rates are sampled at a fixed rate by a background thread.
+    Session processes hold their own DaemonMetrics object, and periodically send counter deltas and gauge values to the multi-console server process, which merges them.
+    """
+
+    METRICS_INFO = (
+        # Metric name, type, key, help string.
+        ('nxdt_received_bytes_total',           'counter', 'bytes',           'Amount of file data received from nxdumptool.'),
+        ('nxdt_received_chunks_total',          'counter', 'chunks',          'Number of file data chunks received from nxdumptool.'),
+        ('nxdt_receive_rate_bytes_per_second',  'gauge',   'rate',            'File data receive rate, sampled at a fixed interval.'),
+        ('nxdt_usb_wait_seconds_total',         'counter', 'usb_wait',        'Time spent waiting on USB reads during data transfer stages.'),
+        ('nxdt_usb_wait_max_seconds',           'gauge',   'max_usb_wait',    'Longest wait on a single USB read during a data transfer stage.'),
+        ('nxdt_disk_write_seconds_total',       'counter', 'disk_write',      'Time spent writing received data to disk.'),
+        ('nxdt_transfers_total',                'counter', 'transfers',       'Number of file transfers started with a progress display.'),
+        ('nxdt_errors_total',                   'counter', 'errors',          'Number of errors logged.'),
+        ('nxdt_transfer_active',                'gauge',   'active',          'Whether a file transfer is currently in progress.'),
+        ('nxdt_transfer_size_bytes',            'gauge',   'transfer_size',   'Size of the file transfer in progress.'),
+        ('nxdt_transfer_offset_bytes',          'gauge',   'transfer_offset', 'Amount of data received for the file transfer in progress.')
+    )
+
+    def __init__(self) -> None:
+        self.lock = threading.Lock()
+        self.start_time = time.time()
+        self.consoles: dict[str, dict[str, float]] = {}
+        self.prev_bytes: dict[str, float] = {}
+        self.prev_sample_time = time.perf_counter()
+
+    def _get(self, console: str) -> dict[str, float]:
+        # Must be called with the lock held.
+        entry = self.consoles.get(console)
+        if entry is None:
+            entry = self.consoles[console] = dict.fromkeys(DAEMON_METRICS_COUNTERS + DAEMON_METRICS_GAUGES + ('rate',), 0)
+
+        return entry
+
+    def add(self, console: str, **values: float) -> None:
+        with self.lock:
+            entry = self._get(console)
+            for (key, value) in values.items():
+                entry[key] += value
+
+    def set(self, console: str, **values: float) -> None:
+        with self.lock:
+            self._get(console).update(values)
+
+    def addChunk(self, console: str, size: int, usb_time: float) -> None:
+        with self.lock:
+            entry = self._get(console)
+            entry['bytes'] += size
+            entry['chunks'] += 1
+            entry['usb_wait'] += usb_time
+            if usb_time > entry['max_usb_wait']:
+                entry['max_usb_wait'] = usb_time
+
+    def takeDeltas(self, console: str) -> dict[str, float]:
+        # Returns all counter values accumulated since the last call, as well as all current gauge values. Used by session processes.
+        with self.lock:
+            entry = self._get(console)
+            snapshot = dict(entry)
+            for key in DAEMON_METRICS_COUNTERS:
+                entry[key] = 0
+
+        return snapshot
+
+    def merge(self, console: str, snapshot: dict[str, float]) -> None:
+        # Merges a snapshot returned by takeDeltas() from a session process.
+        with self.lock:
+            entry = self._get(console)
+
+            for key in DAEMON_METRICS_COUNTERS:
+                entry[key] += snapshot[key]
+
+            for key in DAEMON_METRICS_GAUGES:
+                entry[key] = (max(entry[key], snapshot[key]) if key == 'max_usb_wait' else snapshot[key])
+
+    def sample(self) -> None:
+        cur_time = time.perf_counter()
+        elapsed_time = max(cur_time - self.prev_sample_time, 1e-6)
+        self.prev_sample_time = cur_time
+
+        with self.lock:
+            for (console, entry) in self.consoles.items():
+                entry['rate'] = ((entry['bytes'] - self.prev_bytes.get(console, 0)) / elapsed_time)
+                self.prev_bytes[console] = entry['bytes']
+
+    def render(self) -> str:
+        lines = [
+            '# HELP nxdt_uptime_seconds Time since the host script was started.',
+            '# TYPE nxdt_uptime_seconds gauge',
+            f'nxdt_uptime_seconds {time.time() - self.start_time:.3f}'
+        ]
+
+        with self.lock:
+            consoles = sorted(self.consoles.items())
+
+            for (name, metric_type, key, help_str) in DaemonMetrics.METRICS_INFO:
+                lines.append(f'# HELP {name} {help_str}')
+                lines.append(f'# TYPE {name} {metric_type}')
+
+                for (console, entry) in consoles:
+                    value = entry[key]
+                    value_str = (f'{value:.6f}' if isinstance(value, float) else str(value))
+                    lines.append(f'{name}{{console="{console}"}} {value_str}')
+
+        return '\n'.join(lines) + '\n'
+
+class MetricsLogHandler(logging.Handler):
+    """
+    Counts error messages logged under single console daemon mode.
+    """
+
+    def __init__(self) -> None:
+        super().__init__(logging.ERROR)
+
+    def emit(self, record: logging.LogRecord) -> None:
+        if g_metrics is not None:
+            g_metrics.add(g_metricsConsole, errors=1)
+
+class MetricsRequestHandler(BaseHTTPRequestHandler):
+    def do_GET(self) -> None:
+        if (g_metrics is None) or (self.path.split('?')[0] not in ('/', '/metrics')):
+            self.send_error(404)
+            return
+
+        body = g_metrics.render().encode('utf-8')
+
+        self.send_response(200)
+        self.send_header('Content-Type', 'text/plain; version=0.0.4; charset=utf-8')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, format: str, *args: Any) -> None:
+        # Don't clutter our log with scrape requests.
+        pass
+
+class FileWriterThread:
+    """
+    Writes data chunks to a file object from a background thread, so disk stalls on our end don't throttle USB transfers.
+    Chunks are queued in order by the USB reader thread. The queue is bounded, so the reader blocks if the disk can't keep up.
+    If a hasher object and/or a resume tracker are provided, they're updated with each chunk from the same background thread.
+    If a TransferStats object is provided, disk write times and queue depths are accounted for in it.
+    """
+
+    def __init__(self, file: Any, max_pending: int = FILE_WRITER_QUEUE_SIZE, hasher: Any = None, tracker: ResumeTracker | None = None, stats: TransferStats | None = None) -> None:
+        self.file = file
+        self.hasher = hasher
+        self.tracker = tracker
+        self.stats = stats
+        self.queue: queue.Queue = queue.Queue(maxsize=max_pending)
+        self.error: str | None = None
+
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def _run(self) -> None:
+        while True:
+            chunk = self.queue.get()
+            if chunk is None:
+                break
+
+            # Keep draining the queue after an error, so the reader thread never blocks on it.
+            if self.error is not None:
+                continue
+
+            try:
+                start_time = time.perf_counter()
+                utilsWriteFile(self.file, chunk)
+                if self.tracker is not None:
+                    self.tracker.update(self.file, chunk)
+                if self.stats is not None:
+                    self.stats.addDiskTime(time.perf_counter() - start_time)
+
+                if self.hasher is not None:
+                    self.hasher.update(chunk)
+            except:
+                self.error = traceback.format_exc()
+
+    def write(self, chunk: bytes) -> bool:
+        if self.error is not None:
+            return False
+
+        self.queue.put(chunk)
+        if self.stats is not None:
+            self.stats.updateQueueDepth(self.queue.qsize())
+
+        return True
+
+    def close(self) -> bool:
+        # Wait until all queued chunks have been written.
+        self.queue.put(None)
+        self.thread.join()
+
+        if self.error is not None:
+            utilsLogException(self.error)
+            return False
+
+        return True
 
 def eprint(*args, **kwargs) -> None:
     print(*args, file=sys.stderr, **kwargs)
@@ -589,6 +1150,34 @@ def utilsLogException(exception_str: str) -> None:
     if (not g_cliMode) and (g_logger is not None):
         g_logger.debug(exception_str)
 
+def utilsGetChecksumHasher(checksum_type: int) -> Any:
+    # Returns a hasher object for the provided checksum type, or None if no checksum was requested.
+    if checksum_type == USB_CHECKSUM_TYPE_CRC32:
+        return Crc32Hasher()
+
+    if checksum_type == USB_CHECKSUM_TYPE_SHA256:
+        return hashlib.sha256()
+
+    return None
+
+def utilsWriteFile(file: Any, data: bytes) -> None:
+    # Unbuffered file objects may perform partial writes.
+    view = memoryview(data)
+    while view:
+        wr = file.write(view)
+        view = view[wr:]
+
+def utilsPreallocateFile(file: Any, size: int) -> None:
+    # Best effort. This reduces fragmentation, and lets us know right away if the output volume can't hold the whole file.
+    # The file pointer isn't moved.
+    try:
+        if hasattr(os, 'posix_fallocate'):
+            os.posix_fallocate(file.fileno(), 0, size)
+        else:
+            file.truncate(size)
+    except:
+        pass
+
 def utilsGetPath(path_arg: str, fallback_path: str, is_file: bool, create: bool = False) -> str:
     path = os.path.abspath(os.path.expanduser(os.path.expandvars(path_arg if path_arg else fallback_path)))
 
@@ -600,11 +1189,163 @@ def utilsGetPath(path_arg: str, fallback_path: str, is_file: bool, create: bool
 
     return path
 
+class NxzContainerReader:
+    # Provides random access to a compressed output file. Split files (directories holding part files named "00", "01", etc.) are transparently handled.
+    def __init__(self, path: str) -> None:
+        self._parts: list[tuple[int, int, str]] = []
+        self._size = 0
+
+        if os.path.isdir(path):
+            part_idx = 0
+            while os.path.isfile(part_path := os.path.join(path, f'{part_idx:02d}')):
+                self._add_part(part_path)
+                part_idx += 1
+        else:
+            self._add_part(path)
+
+        if not self._parts:
+            raise Exception(f'Error: "{path}" doesn\'t hold any part files.')
+
+        self._files = [open(part[2], 'rb') for part in self._parts]
+
+    def _add_part(self, path: str) -> None:
+        part_size = os.path.getsize(path)
+        self._parts.append((self._size, part_size, path))
+        self._size += part_size
+
+    @property
+    def size(self) -> int:
+        return self._size
+
+    def read(self, offset: int, size: int) -> bytes:
+        if (offset + size) > self._size:
+            raise Exception(f'Error: read request (0x{offset:X}, 0x{size:X}) exceeds container size (0x{self._size:X}).')
+
+        chunks: list[bytes] = []
+
+        for (part_offset, part_size, _), file in zip(self._parts, self._files):
+            if not size:
+                break
+
+            if offset >= (part_offset + part_size):
+                continue
+
+            chunk_size = min(size, part_offset + part_size - offset)
+            file.seek(offset - part_offset)
+            chunks.append(file.read(chunk_size))
+
+            offset += chunk_size
+            size -= chunk_size
+
+        return b''.join(chunks)
+
+    def close(self) -> None:
+        for file in self._files:
+            file.close()
+
+def utilsDecompressNxzFile(input_path: str, output_path: str | None) -> int:
+    # Decompresses a compressed output file generated by nxdumptool. Returns a process exit code.
+    input_path = os.path.abspath(os.path.expanduser(os.path.expandvars(input_path)))
+    if not output_path:
+        output_path = (input_path[:-len(NXZ_FILE_EXTENSION)] if input_path.lower().endswith(NXZ_FILE_EXTENSION) else (input_path + '.bin'))
+
+    output_path = os.path.abspath(os.path.expanduser(os.path.expandvars(output_path)))
+
+    reader: NxzContainerReader | None = None
+    success = False
+
+    try:
+        reader = NxzContainerReader(input_path)
+        if reader.size < (NXZ_HEADER_SIZE + NXZ_FOOTER_SIZE):
+            raise Exception('Error: container is too small.')
+
+        # Parse header and footer.
+        (magic, version, block_size, block_count, uncompressed_size) = struct.unpack_from('<4sB3xIIQ', reader.read(0, NXZ_HEADER_SIZE))
+        if (magic != NXZ_HEADER_MAGIC) or (version != NXZ_CONTAINER_VERSION) or (not block_size):
+            raise Exception('Error: invalid container header.')
+
+        (index_offset, footer_block_count, footer_magic) = struct.unpack('<QI4s', reader.read(reader.size - NXZ_FOOTER_SIZE, NXZ_FOOTER_SIZE))
+        if (footer_magic != NXZ_FOOTER_MAGIC) or (footer_block_count != block_count) or (block_count != ((uncompressed_size + block_size - 1) // block_size)) or \
+           ((index_offset + (block_count * NXZ_BLOCK_ENTRY_SIZE)) != (reader.size - NXZ_FOOTER_SIZE)):
+            raise Exception('Error: invalid container footer. The file may be incomplete.')
+
+        index = reader.read(index_offset, block_count * NXZ_BLOCK_ENTRY_SIZE)
+
+        print(f'Decompressing "{input_path}" ({block_count} blocks, 0x{uncompressed_size:X} bytes) to "{output_path}"...')
+
+        with open(output_path, 'wb') as file:
+            utilsPreallocateFile(file, uncompressed_size)
+
+            for i in range(block_count):
+                (offset, size, block_type, fill_value) = struct.unpack_from('<QIBB2x', index, i * NXZ_BLOCK_ENTRY_SIZE)
+                raw_size = min(block_size, uncompressed_size - (i * block_size))
+
+                if block_type == NXZ_BLOCK_TYPE_FILL:
+                    data = bytes([fill_value]) * raw_size
+                elif block_type == NXZ_BLOCK_TYPE_STORED:
+                    data = reader.read(offset, size)
+                elif block_type == NXZ_BLOCK_TYPE_LZ4:
+                    if lz4_block is None:
+                        raise Exception('Error: the lz4 module is needed to decompress this file.')
+                    data = lz4_block.decompress(reader.read(offset, size), uncompressed_size=raw_size)
+                else:
+                    raise Exception(f'Error: invalid type for block #{i} ({block_type}).')
+
+                if len(data) != raw_size:
+                    raise Exception(f'Error: block #{i} holds 0x{len(data):X} bytes (expected 0x{raw_size:X}).')
+
+                utilsWriteFile(file, data)
+
+            file.truncate(uncompressed_size)
+
+        success = True
+        print('Successfully decompressed file.')
+    except:
+        eprint(traceback.format_exc())
+        if os.path.isfile(output_path):
+            os.remove(output_path)
+    finally:
+        if reader:
+            reader.close()
+
+    return (0 if success else 1)
+
 def utilsIsValueAlignedToEndpointPacketSize(value: int) -> bool:
     return bool((value & (g_usbEpMaxPacketSize - 1)) == 0)
 
+def utilsGetAvailableMemory() -> int | None:
+    # Returns the amount of available physical memory, in bytes. Returns None if it can't be retrieved.
+    try:
+        if g_isWindows:
+            import ctypes
+
+            class MEMORYSTATUSEX(ctypes.Structure):
+                _fields_ = [
+                    ('dwLength', ctypes.c_ulong),
+                    ('dwMemoryLoad', ctypes.c_ulong),
+                    ('ullTotalPhys', ctypes.c_ulonglong),
+                    ('ullAvailPhys', ctypes.c_ulonglong),
+                    ('ullTotalPageFile', ctypes.c_ulonglong),
+                    ('ullAvailPageFile', ctypes.c_ulonglong),
+                    ('ullTotalVirtual', ctypes.c_ulonglong),
+                    ('ullAvailVirtual', ctypes.c_ulonglong),
+                    ('ullAvailExtendedVirtual', ctypes.c_ulonglong)
+                ]
+
+            status = MEMORYSTATUSEX()
+            status.dwLength = ctypes.sizeof(MEMORYSTATUSEX)
+            if not ctypes.windll.kernel32.GlobalMemoryStatusEx(ctypes.byref(status)):
+                return None
+
+            return int(status.ullAvailPhys)
+
+        return (os.sysconf('SC_AVPHYS_PAGES') * os.sysconf('SC_PAGE_SIZE'))
+    except:
+        # Not available on every platform (e.g. macOS).
+        return None
+
 def utilsResetNspInfo(delete: bool = False) -> None:
-    global g_nspTransferMode, g_nspSize, g_nspHeaderSize, g_nspRemainingSize, g_nspFile, g_nspFilePath
+    global g_nspTransferMode, g_nspSize, g_nspHeaderSize, g_nspRemainingSize, g_nspFile, g_nspFilePath, g_nspLayoutMode, g_nspLayout, g_nspLayoutReceived, g_nspLayoutHashers
 
     if g_nspFile:
         g_nspFile.close()
@@ -619,6 +1360,30 @@ def utilsResetNspInfo(delete: bool = False) -> None:
     g_nspFile = None
     g_nspFilePath = ''
 
+    # Reset NSP layout mode info.
+    g_nspLayoutMode = False
+    g_nspLayout = []
+    g_nspLayoutReceived = []
+    g_nspLayoutHashers = {}
+
+def utilsResetFileDeltaInfo(delete: bool = False) -> None:
+    global g_fileDeltaMode, g_fileDeltaSize, g_fileDeltaExistingSize, g_fileDeltaBlockSize, g_fileDeltaProcessedSize, g_fileDeltaReceivedSize, g_fileDeltaFile, g_fileDeltaFilePath
+
+    # The previous file contents are already gone at this point if any data was received, so there's nothing worth keeping after a cancellation.
+    if g_fileDeltaFile:
+        g_fileDeltaFile.close()
+        if delete:
+            os.remove(g_fileDeltaFilePath)
+
+    g_fileDeltaMode = False
+    g_fileDeltaSize = 0
+    g_fileDeltaExistingSize = 0
+    g_fileDeltaBlockSize = 0
+    g_fileDeltaProcessedSize = 0
+    g_fileDeltaReceivedSize = 0
+    g_fileDeltaFile = None
+    g_fileDeltaFilePath = ''
+
 def utilsGetSizeUnitAndDivisor(size: int) -> tuple[str, int]:
     size_suffixes = [ 'B', 'KiB', 'MiB', 'GiB' ]
     size_suffixes_count = len(size_suffixes)
@@ -633,8 +1398,21 @@ def utilsGetSizeUnitAndDivisor(size: int) -> tuple[str, int]:
 
     return ret
 
+def usbGetDeviceLocation(dev: usb.core.Device) -> str:
+    # Port numbers remain the same across device resets and reconnections to the same physical port, unlike device addresses.
+    # nxdumptool uses its version string as the USB serial number, so it can't be used to tell consoles apart.
+    try:
+        ports = dev.port_numbers
+    except:
+        ports = None
+
+    if ports:
+        return f'{dev.bus}-{".".join(str(port) for port in ports)}'
+
+    return f'{dev.bus}-addr{dev.address}'
+
 def usbGetDeviceEndpoints() -> bool:
-    global g_usbEpIn, g_usbEpOut, g_usbEpMaxPacketSize
+    global g_usbEpIn, g_usbEpOut, g_usbEpMaxPacketSize, g_usbDataEpIn, g_usbDataEpOut, g_usbDataEpEnabled
 
     assert g_logger is not None
 
@@ -657,8 +1435,12 @@ def usbGetDeviceEndpoints() -> bool:
 
         # Find a connected USB device with a matching VID/PID pair.
         # Using == here to compare both device instances would also compare the backend, so we'll just compare certain elements manually.
+        # Session processes only look for the console they were started for.
         try:
-            cur_dev = usb.core.find(find_all=False, idVendor=USB_DEV_VID, idProduct=USB_DEV_PID)
+            if g_usbDevLocation is None:
+                cur_dev = usb.core.find(find_all=False, idVendor=USB_DEV_VID, idProduct=USB_DEV_PID)
+            else:
+                cur_dev = usb.core.find(find_all=False, idVendor=USB_DEV_VID, idProduct=USB_DEV_PID, custom_match=lambda dev: usbGetDeviceLocation(dev) == g_usbDevLocation)
         except:
             if not g_cliMode:
                 utilsLogException(traceback.format_exc())
@@ -695,15 +1477,22 @@ def usbGetDeviceEndpoints() -> bool:
         # Get default interface descriptor.
         intf = cfg[(0,0)]
 
-        # Retrieve endpoints.
-        g_usbEpIn = usb.util.find_descriptor(intf, custom_match=usb_ep_in_lambda)
-        g_usbEpOut = usb.util.find_descriptor(intf, custom_match=usb_ep_out_lambda)
+        # Retrieve endpoints. The first pair is always used for commands and status responses.
+        # If a second pair is available, it may be used for file data (see usbHandleStartSession()).
+        ep_in_list = list(usb.util.find_descriptor(intf, find_all=True, custom_match=usb_ep_in_lambda))
+        ep_out_list = list(usb.util.find_descriptor(intf, find_all=True, custom_match=usb_ep_out_lambda))
 
-        if (g_usbEpIn is None) or (g_usbEpOut is None):
+        if (not ep_in_list) or (not ep_out_list):
             g_logger.error(f'Invalid endpoint addresses! (bus {cur_dev.bus}, address {cur_dev.address}).')
             time.sleep(0.1)
             continue
 
+        g_usbEpIn = ep_in_list[0]
+        g_usbEpOut = ep_out_list[0]
+
+        (g_usbDataEpIn, g_usbDataEpOut) = ((ep_in_list[1], ep_out_list[1]) if ((len(ep_in_list) > 1) and (len(ep_out_list) > 1)) else (None, None))
+        g_usbDataEpEnabled = False
+
         # Save endpoint max packet size and USB version.
         g_usbEpMaxPacketSize = g_usbEpIn.wMaxPacketSize
         usb_version = cur_dev.bcdUSB
@@ -711,19 +1500,23 @@ def usbGetDeviceEndpoints() -> bool:
         break
 
     g_logger.debug(f'Successfully retrieved USB endpoints! (bus {cur_dev.bus}, address {cur_dev.address}).')
-    g_logger.debug(f'Max packet size: 0x{g_usbEpMaxPacketSize:X} (USB {usb_version >> 8}.{(usb_version & 0xFF) >> 4}).\n')
+    g_logger.debug(f'Max packet size: 0x{g_usbEpMaxPacketSize:X} (USB {usb_version >> 8}.{(usb_version & 0xFF) >> 4}).')
+    g_logger.debug(f'File data endpoints: {"available" if (g_usbDataEpIn is not None) else "unavailable"}.\n')
 
     if g_cliMode:
         g_logger.info(SERVER_STOP_MSG)
 
     return True
 
-def usbRead(size: int, timeout: int = -1) -> bytes:
+def usbRead(size: int, timeout: int = -1, file_data: bool = False) -> bytes:
     rd = b''
 
+    # File data is read from the dedicated endpoint, if it's being used.
+    ep = (g_usbDataEpIn if (file_data and g_usbDataEpEnabled) else g_usbEpIn)
+
     try:
         # Convert read data to a bytes object for easier handling.
-        rd = bytes(g_usbEpIn.read(size, timeout))
+        rd = bytes(ep.read(size, timeout))
     except usb.core.USBError:
         if not g_cliMode:
             utilsLogException(traceback.format_exc())
@@ -733,11 +1526,14 @@ def usbRead(size: int, timeout: int = -1) -> bytes:
 
     return rd
 
-def usbWrite(data: bytes, timeout: int = -1) -> int:
+def usbWrite(data: bytes, timeout: int = -1, file_data: bool = False) -> int:
     wr = 0
 
+    # Echoed benchmark chunks are written to the dedicated endpoint, if it's being used. Status responses always go through the main one.
+    ep = (g_usbDataEpOut if (file_data and g_usbDataEpEnabled) else g_usbEpOut)
+
     try:
-        wr = g_usbEpOut.write(data, timeout)
+        wr = ep.write(data, timeout)
     except usb.core.USBError:
         if not g_cliMode:
             utilsLogException(traceback.format_exc())
@@ -748,11 +1544,33 @@ def usbWrite(data: bytes, timeout: int = -1) -> int:
     return wr
 
 def usbSendStatus(code: int) -> bool:
-    status = struct.pack('<4sIH6x', USB_MAGIC_WORD, code, g_usbEpMaxPacketSize)
+    # The negotiated transfer parameters and the compression mask are only checked by nxdumptool in StartSession responses.
+    compression_mask = ((1 << USB_COMPRESSION_TYPE_LZ4) if (lz4_block is not None) else 0)
+    status = struct.pack('<4sIHHBBBx', USB_MAGIC_WORD, code, g_usbEpMaxPacketSize, g_usbTransferBlockSize // 1024, g_usbPendingTransfers, compression_mask, int(g_usbDataEpEnabled))
     return bool(usbWrite(status, USB_TRANSFER_TIMEOUT) == len(status))
 
+def usbNegotiateTransferParams(max_block_size: int, max_pending_transfers: int) -> tuple[int, int]:
+    assert g_logger is not None
+
+    # Get preferred values for the current link speed.
+    (block_size, pending_transfers) = USB_TRANSFER_PARAMS.get(g_usbEpMaxPacketSize, (USB_TRANSFER_MIN_BLOCK_SIZE, 1))
+
+    # Make sure we don't exceed the values supported by nxdumptool (or our own).
+    block_size = max(min(block_size, max_block_size, USB_TRANSFER_BLOCK_SIZE), USB_TRANSFER_MIN_BLOCK_SIZE)
+    pending_transfers = max(min(pending_transfers, max_pending_transfers), 1)
+
+    # Halve the block size if it takes up too much of the available host memory.
+    avail_mem = utilsGetAvailableMemory()
+    if avail_mem is not None:
+        while (block_size > USB_TRANSFER_MIN_BLOCK_SIZE) and ((block_size * USB_TRANSFER_MEMORY_DIVISOR) > avail_mem):
+            block_size //= 2
+
+    g_logger.debug(f'Transfer parameters: block size 0x{block_size:X}, {pending_transfers} pending transfer(s) (available memory: {"unknown" if avail_mem is None else f"0x{avail_mem:X}"}).')
+
+    return (block_size, pending_transfers)
+
 def usbHandleStartSession(cmd_block: bytes) -> int:
-    global g_nxdtVersionMajor, g_nxdtVersionMinor, g_nxdtVersionMicro, g_nxdtAbiVersionMajor, g_nxdtAbiVersionMinor, g_nxdtGitCommit
+    global g_nxdtVersionMajor, g_nxdtVersionMinor, g_nxdtVersionMicro, g_nxdtAbiVersionMajor, g_nxdtAbiVersionMinor, g_nxdtGitCommit, g_usbTransferBlockSize, g_usbPendingTransfers, g_usbDataEpEnabled
 
     assert g_logger is not None
 
@@ -762,7 +1580,7 @@ def usbHandleStartSession(cmd_block: bytes) -> int:
     g_logger.debug(f'Received StartSession ({USB_CMD_START_SESSION:02X}) command.')
 
     # Parse command block.
-    (g_nxdtVersionMajor, g_nxdtVersionMinor, g_nxdtVersionMicro, abi_version, git_commit) = struct.unpack_from('<BBBB8s', cmd_block, 0)
+    (g_nxdtVersionMajor, g_nxdtVersionMinor, g_nxdtVersionMicro, abi_version, git_commit, max_block_size, max_pending_transfers, data_endpoints) = struct.unpack_from('<BBBB8sHBB', cmd_block, 0)
     g_nxdtGitCommit = git_commit.decode('utf-8').strip('\x00')
 
     # Unpack ABI version.
@@ -777,11 +1595,79 @@ def usbHandleStartSession(cmd_block: bytes) -> int:
         g_logger.error('Unsupported ABI version!')
         return USB_STATUS_UNSUPPORTED_ABI_VERSION
 
+    # Negotiate transfer parameters. The block size is expressed in KiB.
+    (g_usbTransferBlockSize, g_usbPendingTransfers) = usbNegotiateTransferParams(max_block_size * 1024, max_pending_transfers)
+
+    # Use the dedicated file data endpoint pair if both sides have it. Commands and status responses keep going through the main one.
+    g_usbDataEpEnabled = (bool(data_endpoints) and (g_usbDataEpIn is not None) and (g_usbDataEpOut is not None))
+    g_logger.debug(f'File data endpoints: {"enabled" if g_usbDataEpEnabled else "disabled"}.')
+
     # Return status code.
     return USB_STATUS_SUCCESS
 
+def usbIsCancelFileTransferChunk(chunk: bytes, blksize: int, compressed: bool) -> bool:
+    # nxdumptool may abort an in-flight data chunk to cancel a file transfer right away. In that case, whatever it already sent is followed by a CancelFileTransfer command header.
+    # Partial chunks are always aligned to the endpoint max packet size, and they're always shorter than a full chunk. Under compressed transfers, well-formed frames are never taken into account.
+    chunk_size = len(chunk)
+    if chunk_size < USB_CMD_HEADER_SIZE:
+        return False
+
+    partial_size = (chunk_size - USB_CMD_HEADER_SIZE)
+    if partial_size:
+        if not utilsIsValueAlignedToEndpointPacketSize(partial_size):
+            return False
+
+        if compressed:
+            (_, stored_size, _) = struct.unpack_from('<IIB', chunk, 0)
+            if (partial_size >= (USB_FILE_DATA_FRAME_HEADER_SIZE + blksize)) or ((USB_FILE_DATA_FRAME_HEADER_SIZE + stored_size) == chunk_size):
+                return False
+        elif chunk_size >= blksize:
+            return False
+
+    (magic, cmd_id, _) = struct.unpack_from('<4sII', chunk, partial_size)
+    return (magic == USB_MAGIC_WORD) and (cmd_id == USB_CMD_CANCEL_FILE_TRANSFER)
+
+def usbUnpackFileDataFrame(frame: bytes, max_raw_size: int) -> bytes | memoryview | None:
+    assert g_logger is not None
+
+    frame_size = len(frame)
+    if frame_size <= USB_FILE_DATA_FRAME_HEADER_SIZE:
+        g_logger.error(f'Received truncated 0x{frame_size:X}-byte long file data frame!')
+        return None
+
+    (raw_size, stored_size, compression_type) = struct.unpack_from('<IIB', frame, 0)
+    if (not raw_size) or (raw_size > max_raw_size) or (stored_size > raw_size) or ((USB_FILE_DATA_FRAME_HEADER_SIZE + stored_size) != frame_size):
+        g_logger.error(f'Received malformed file data frame! (raw size: 0x{raw_size:X}, stored size: 0x{stored_size:X}, frame size: 0x{frame_size:X}).')
+        return None
+
+    payload = memoryview(frame)[USB_FILE_DATA_FRAME_HEADER_SIZE:]
+
+    if compression_type == USB_COMPRESSION_TYPE_NONE:
+        if stored_size != raw_size:
+            g_logger.error('Received raw file data frame with mismatching sizes!')
+            return None
+
+        # Avoid copying raw data.
+        return payload
+
+    if (compression_type != USB_COMPRESSION_TYPE_LZ4) or (lz4_block is None):
+        g_logger.error(f'Received file data frame with unsupported compression type {compression_type}!')
+        return None
+
+    try:
+        data = lz4_block.decompress(payload, uncompressed_size=raw_size)
+    except:
+        utilsLogException(traceback.format_exc())
+        data = b''
+
+    if len(data) != raw_size:
+        g_logger.error(f'Failed to decompress 0x{stored_size:X}-byte long file data frame!')
+        return None
+
+    return data
+
 def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
-    global g_nspTransferMode, g_nspSize, g_nspHeaderSize, g_nspRemainingSize, g_nspFile, g_nspFilePath, g_outputDir, g_tkRoot, g_progressBarWindow
+    global g_nspTransferMode, g_nspSize, g_nspHeaderSize, g_nspRemainingSize, g_nspFile, g_nspFilePath, g_outputDir, g_tkRoot, g_progressBarWindow, g_lastFileChecksum
 
     assert g_logger is not None
     assert g_progressBarWindow is not None
@@ -794,11 +1680,22 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
     # Parse command block.
     (file_size, filename_length, nsp_header_size, raw_filename) = struct.unpack_from(f'<QII{USB_FILE_PROPERTIES_MAX_NAME_LENGTH}s', cmd_block, 0)
     filename = raw_filename.decode('utf-8').strip('\x00')
+    (checksum_type, compression_type) = struct.unpack_from('<BB', cmd_block, 0x311)
+    (resume_offset,) = struct.unpack_from('<Q', cmd_block, 0x318)
+
+    # Forget about the checksum from the previous file.
+    g_lastFileChecksum = None
 
     # Print info.
     dbg_str = f'File size: 0x{file_size:X} | Filename length: 0x{filename_length:X}'
     if nsp_header_size > 0:
         dbg_str += f' | NSP header size: 0x{nsp_header_size:X}'
+    if checksum_type != USB_CHECKSUM_TYPE_NONE:
+        dbg_str += f' | Checksum type: {checksum_type}'
+    if compression_type != USB_COMPRESSION_TYPE_NONE:
+        dbg_str += f' | Compression type: {compression_type}'
+    if resume_offset > 0:
+        dbg_str += f' | Resume offset: 0x{resume_offset:X}'
     g_logger.debug(dbg_str + '.')
 
     file_type_str = ('file' if (not g_nspTransferMode) else 'NSP file entry')
@@ -807,6 +1704,10 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
         g_logger.info(f'Receiving {file_type_str}: "{filename}".')
 
     # Perform sanity checks.
+    if g_nspLayoutMode:
+        g_logger.error('SendFileProperties received under NSP layout mode!\n')
+        return USB_STATUS_MALFORMED_CMD
+
     if (not g_nspTransferMode) and file_size and (nsp_header_size >= file_size):
         g_logger.error('NSP header size must be smaller than the full NSP size!\n')
         return USB_STATUS_MALFORMED_CMD
@@ -819,6 +1720,20 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
         g_logger.error('Invalid filename length!\n')
         return USB_STATUS_MALFORMED_CMD
 
+    hasher = utilsGetChecksumHasher(checksum_type)
+    if (checksum_type != USB_CHECKSUM_TYPE_NONE) and ((hasher is None) or (nsp_header_size > 0)):
+        g_logger.error('Invalid checksum type!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    compressed = (compression_type == USB_COMPRESSION_TYPE_LZ4)
+    if (compression_type != USB_COMPRESSION_TYPE_NONE) and ((not compressed) or (lz4_block is None) or (not file_size) or (nsp_header_size > 0)):
+        g_logger.error('Invalid compression type!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    if resume_offset and (g_nspTransferMode or (nsp_header_size > 0) or (hasher is not None) or (resume_offset >= file_size)):
+        g_logger.error('Invalid resume offset!\n')
+        return USB_STATUS_MALFORMED_CMD
+
     # Enable NSP transfer mode (if needed).
     if (not g_nspTransferMode) and file_size and nsp_header_size:
         g_nspTransferMode = True
@@ -847,15 +1762,35 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
             g_logger.error(f'Output filepath points to an existing directory! ("{printable_fullpath}").\n')
             return USB_STATUS_HOST_IO_ERROR
 
-        # Make sure we have enough free space.
+        # Make sure we still hold the incomplete file nxdumptool wants to resume.
+        if resume_offset:
+            resume_info = ResumeTracker.load(fullpath, file_size)
+            if (resume_info is None) or (resume_info[0] != resume_offset):
+                g_logger.error(f'No incomplete file available to resume from offset 0x{resume_offset:X}! ("{printable_fullpath}").\n')
+                return USB_STATUS_MALFORMED_CMD
+
+            (_, resume_crc) = resume_info
+
+        # Make sure we have enough free space. Incomplete files were already preallocated.
         (_, _, free_space) = shutil.disk_usage(dirpath)
-        if free_space <= file_size:
+        if (not resume_offset) and (free_space <= file_size):
             utilsResetNspInfo()
             g_logger.error('Not enough free space available in output volume!\n')
             return USB_STATUS_HOST_IO_ERROR
 
-        # Get file object.
-        file = open(fullpath, "wb")
+        # Get unbuffered file object. Data chunks are large enough to be written straight to disk.
+        if resume_offset:
+            file = open(fullpath, "r+b", buffering=0)
+            file.seek(resume_offset)
+        else:
+            file = open(fullpath, "wb", buffering=0)
+
+            # Preallocate the whole output file.
+            utilsPreallocateFile(file, g_nspSize if g_nspTransferMode else file_size)
+
+            # Forget about any previous incomplete file.
+            if not g_nspTransferMode:
+                ResumeTracker.discard(fullpath)
 
         if g_nspTransferMode:
             # Update NSP file object.
@@ -865,7 +1800,7 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
             g_nspFilePath = fullpath
 
             # Write NSP header padding right away.
-            file.write(b'\0' * g_nspHeaderSize)
+            utilsWriteFile(file, b'\0' * g_nspHeaderSize)
     else:
         # Retrieve what we need using global variables.
         file = g_nspFile
@@ -879,6 +1814,10 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
         if not g_nspTransferMode:
             file.close()
 
+        # Empty files still get a checksum, if requested.
+        if (hasher is not None) and (not file_size):
+            g_lastFileChecksum = (checksum_type, hasher.digest())
+
         # Let the command handler take care of sending the status response for us.
         return USB_STATUS_SUCCESS
 
@@ -888,8 +1827,8 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
     # Start data transfer stage.
     g_logger.debug(f'Data transfer started. {"Saving" if file_type_str == "file" else "Writing"} {file_type_str} to: "{printable_fullpath}".')
 
-    offset = 0
-    blksize = USB_TRANSFER_BLOCK_SIZE
+    offset = resume_offset
+    blksize = g_usbTransferBlockSize
 
     # Check if we should use the progress bar window.
     use_pbar = (((not g_nspTransferMode) and (file_size > USB_TRANSFER_THRESHOLD)) or (g_nspTransferMode and (g_nspSize > USB_TRANSFER_THRESHOLD)))
@@ -903,8 +1842,8 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
 
         if (not g_nspTransferMode) or g_nspRemainingSize == (g_nspSize - g_nspHeaderSize):
             if not g_nspTransferMode:
-                # Set current progress to zero and the maximum value to the provided file size.
-                pbar_n = 0
+                # Set current progress to the resume offset and the maximum value to the provided file size.
+                pbar_n = resume_offset
                 pbar_file_size = file_size
             else:
                 # Set current progress to the NSP header size and the maximum value to the provided NSP size.
@@ -918,16 +1857,44 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
             g_progressBarWindow.set_prefix(prefix)
 
     def cancelTransfer():
+        # Wait for the file writer thread to finish before getting rid of the file.
+        writer.close()
+
         # Cancel file transfer.
         if g_nspTransferMode:
             utilsResetNspInfo(True)
         else:
             file.close()
             os.remove(fullpath)
+            tracker.remove()
+
+        if use_pbar and (g_progressBarWindow is not None):
+            g_progressBarWindow.end()
+
+    def interruptTransfer():
+        # NSPs can't be resumed.
+        if g_nspTransferMode:
+            cancelTransfer()
+            return
+
+        # Keep the incomplete file around, so nxdumptool can resume it later through ResumeFile.
+        writer.close()
+        file.close()
+        tracker.save()
+
+        if tracker.offset:
+            g_logger.warning(f'Kept incomplete file (0x{tracker.offset:X} / 0x{file_size:X} bytes). The transfer can be resumed later.')
 
         if use_pbar and (g_progressBarWindow is not None):
             g_progressBarWindow.end()
 
+    # Keep track of the amount of data written to regular files.
+    tracker = ResumeTracker(fullpath, file_size, resume_offset, resume_crc if resume_offset else 0)
+
+    # Start file writer thread. Received data chunks are written to disk while we keep reading from the USB endpoint.
+    stats = TransferStats()
+    writer = FileWriterThread(file, hasher=hasher, tracker=(None if g_nspTransferMode else tracker), stats=stats)
+
     # Start transfer process.
     start_time = time.time()
 
@@ -937,39 +1904,63 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
         if blksize > diff: blksize = diff
 
         # Set block size and handle Zero-Length Termination packet (if needed).
-        rd_size = blksize
-        if ((offset + blksize) >= file_size) and utilsIsValueAlignedToEndpointPacketSize(blksize):
-            rd_size += 1
+        # Under compressed transfers, each frame is variable-sized and terminated by a short packet or a ZLT packet, so we just read as much as the largest possible frame plus one byte.
+        if compressed:
+            rd_size = (USB_FILE_DATA_FRAME_HEADER_SIZE + blksize + 1)
+        else:
+            rd_size = blksize
+            if ((offset + blksize) >= file_size) and utilsIsValueAlignedToEndpointPacketSize(blksize):
+                rd_size += 1
 
         # Read current chunk.
-        chunk = usbRead(rd_size, USB_TRANSFER_TIMEOUT)
+        usb_start_time = time.perf_counter()
+        chunk = usbRead(rd_size, USB_TRANSFER_TIMEOUT, True)
+        usb_time = (time.perf_counter() - usb_start_time)
+
         if not chunk:
             g_logger.error(f'Failed to read 0x{rd_size:X}-byte long data chunk!')
 
-            # Cancel file transfer.
-            cancelTransfer()
+            # Interrupt file transfer.
+            interruptTransfer()
 
             # Returning None will make the command handler exit right away.
             return None
 
         chunk_size = len(chunk)
+        stats.addChunk(chunk_size, usb_time)
 
         # Check if we're dealing with a CancelFileTransfer command.
-        if chunk_size == USB_CMD_HEADER_SIZE:
-            (magic, cmd_id, _) = struct.unpack_from('<4sII', chunk, 0)
-            if (magic == USB_MAGIC_WORD) and (cmd_id == USB_CMD_CANCEL_FILE_TRANSFER):
-                # Cancel file transfer.
-                cancelTransfer()
+        if usbIsCancelFileTransferChunk(chunk, blksize, compressed):
+            # Cancel file transfer.
+            cancelTransfer()
+
+            g_logger.debug(f'Received CancelFileTransfer ({USB_CMD_CANCEL_FILE_TRANSFER:02X}) command.')
+            g_logger.warning('Transfer cancelled.')
+
+            # Let the command handler take care of sending the status response for us.
+            return USB_STATUS_SUCCESS
 
-                g_logger.debug(f'Received CancelFileTransfer ({USB_CMD_CANCEL_FILE_TRANSFER:02X}) command.')
-                g_logger.warning('Transfer cancelled.')
+        # Unpack the current frame (if needed). Frames are never smaller than a command header.
+        if compressed:
+            chunk = usbUnpackFileDataFrame(chunk, blksize)
+            if chunk is None:
+                # Interrupt file transfer. Everything we received before this frame is still valid.
+                interruptTransfer()
 
-                # Let the command handler take care of sending the status response for us.
-                return USB_STATUS_SUCCESS
+                # Returning None will make the command handler exit right away.
+                return None
 
-        # Write current chunk.
-        file.write(chunk)
-        file.flush()
+            chunk_size = len(chunk)
+
+        # Queue current chunk.
+        if not writer.write(chunk):
+            g_logger.error(f'Failed to write data chunk to "{printable_fullpath}"!')
+
+            # Cancel file transfer.
+            cancelTransfer()
+
+            # Returning None will make the command handler exit right away.
+            return None
 
         # Update current offset.
         offset = (offset + chunk_size)
@@ -982,12 +1973,34 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
         if use_pbar:
             g_progressBarWindow.update(chunk_size)
 
-    elapsed_time = round(time.time() - start_time)
-    g_logger.debug(f'File transfer successfully completed in {tqdm.format_interval(elapsed_time)}!\n')
+    # Wait for the file writer thread to write all queued chunks.
+    if not writer.close():
+        g_logger.error(f'Failed to write data to "{printable_fullpath}"!\n')
 
-    # Close file handle (if needed).
-    if not g_nspTransferMode:
-        file.close()
+        if g_nspTransferMode:
+            utilsResetNspInfo(True)
+        else:
+            file.close()
+            os.remove(fullpath)
+            tracker.remove()
+
+        if use_pbar:
+            g_progressBarWindow.end()
+
+        return USB_STATUS_HOST_IO_ERROR
+
+    elapsed_time = round(time.time() - start_time)
+    stats.log('File transfer')
+    g_logger.debug(f'File transfer successfully completed in {tqdm.format_interval(elapsed_time)}!\n')
+
+    # Keep the checksum around until nxdumptool asks us to verify it.
+    if hasher is not None:
+        g_lastFileChecksum = (checksum_type, hasher.digest())
+
+    # Close file handle and get rid of the progress file (if needed).
+    if not g_nspTransferMode:
+        file.close()
+        tracker.remove()
 
     # Hide progress bar window (if needed).
     if use_pbar and ((not g_nspTransferMode) or (not g_nspRemainingSize)):
@@ -995,85 +2008,1086 @@ def usbHandleSendFileProperties(cmd_block: bytes) -> int | None:
 
     return USB_STATUS_SUCCESS
 
-def usbHandleCancelFileTransfer(cmd_block: bytes) -> int:
+def usbHandleCancelFileTransfer(cmd_block: bytes) -> int:
+    assert g_logger is not None
+
+    g_logger.debug(f'Received CancelFileTransfer ({USB_CMD_START_SESSION:02X}) command.')
+
+    if g_nspTransferMode or g_nspLayoutMode:
+        if (g_nspSize > USB_TRANSFER_THRESHOLD) and (g_progressBarWindow is not None):
+            g_progressBarWindow.end()
+
+        utilsResetNspInfo(True)
+
+        g_logger.warning('Transfer cancelled.')
+        return USB_STATUS_SUCCESS
+    elif g_fileDeltaMode:
+        if (g_fileDeltaSize > USB_TRANSFER_THRESHOLD) and (g_progressBarWindow is not None):
+            g_progressBarWindow.end()
+
+        utilsResetFileDeltaInfo(True)
+
+        g_logger.warning('Transfer cancelled.')
+        return USB_STATUS_SUCCESS
+    else:
+        g_logger.error('Unexpected transfer cancellation.')
+        return USB_STATUS_MALFORMED_CMD
+
+def usbHandleSendNspHeader(cmd_block: bytes) -> int:
+    global g_nspTransferMode, g_nspHeaderSize, g_nspRemainingSize, g_nspFile, g_nspFilePath
+
+    assert g_logger is not None
+    assert g_nspFile is not None
+
+    nsp_header_size = len(cmd_block)
+
+    g_logger.debug(f'Received SendNspHeader ({USB_CMD_SEND_NSP_HEADER:02X}) command.')
+
+    # Validity checks.
+    if not g_nspTransferMode:
+        g_logger.error('Received NSP header out of NSP transfer mode!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    if g_nspRemainingSize:
+        g_logger.error(f'Received NSP header before receiving all NSP data! (missing 0x{g_nspRemainingSize:X} byte[s]).\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    if nsp_header_size != g_nspHeaderSize:
+        g_logger.error(f'NSP header size mismatch! (0x{nsp_header_size:X} != 0x{g_nspHeaderSize:X}).\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Write NSP header.
+    g_nspFile.seek(0)
+    utilsWriteFile(g_nspFile, cmd_block)
+
+    g_logger.debug(f'Successfully wrote 0x{nsp_header_size:X}-byte long NSP header to "{g_nspFilePath}".\n')
+
+    # Disable NSP transfer mode.
+    utilsResetNspInfo()
+
+    return USB_STATUS_SUCCESS
+
+def usbHandleEndSession(cmd_block: bytes) -> int:
+    assert g_logger is not None
+    g_logger.debug(f'Received EndSession ({USB_CMD_END_SESSION:02X}) command.')
+    return USB_STATUS_SUCCESS
+
+def usbHandleSendFileBatch(cmd_block: bytes) -> int | None:
+    assert g_logger is not None
+    assert g_progressBarWindow is not None
+
+    if g_cliMode:
+        print()
+
+    g_logger.debug(f'Received SendFileBatch ({USB_CMD_SEND_FILE_BATCH:02X}) command.')
+
+    if g_nspTransferMode or g_nspLayoutMode:
+        g_logger.error('SendFileBatch received mid NSP transfer.\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Parse command block header.
+    (total_size, entry_count) = struct.unpack_from('<QI4x', cmd_block, 0)
+    g_logger.debug(f'Total size: 0x{total_size:X} | Entry count: {entry_count}.')
+
+    if (not entry_count) or (entry_count > USB_FILE_BATCH_MAX_ENTRY_COUNT):
+        g_logger.error('Invalid file batch entry count!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Parse file records. Each one is padded to an 8-byte boundary.
+    entries: list[tuple[int, str]] = []
+    offset = USB_FILE_BATCH_HEADER_SIZE
+    records_size = 0
+
+    for _ in range(entry_count):
+        if (offset + USB_FILE_BATCH_RECORD_SIZE) > len(cmd_block):
+            g_logger.error('File batch record exceeds command block boundaries!\n')
+            return USB_STATUS_MALFORMED_CMD
+
+        (file_size, filename_length) = struct.unpack_from('<QI4x', cmd_block, offset)
+        offset += USB_FILE_BATCH_RECORD_SIZE
+
+        if (not filename_length) or (filename_length > USB_FILE_PROPERTIES_MAX_NAME_LENGTH) or ((offset + filename_length) > len(cmd_block)):
+            g_logger.error('Invalid filename length!\n')
+            return USB_STATUS_MALFORMED_CMD
+
+        filename = cmd_block[offset:offset + filename_length].decode('utf-8')
+        offset += ((filename_length + 7) & ~7)
+
+        # Generate full, absolute path to the destination file.
+        fullpath = os.path.abspath(g_outputDir + os.path.sep + filename)
+        entries.append((file_size, fullpath))
+        records_size += file_size
+
+    if records_size != total_size:
+        g_logger.error('File batch total size doesn\'t match the sum of all file sizes!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Create full directory trees and make sure no output filepath points to an existing directory.
+    for (_, fullpath) in entries:
+        os.makedirs(os.path.dirname(fullpath), exist_ok=True)
+
+        if os.path.exists(fullpath) and (not os.path.isfile(fullpath)):
+            printable_fullpath = (fullpath[4:] if g_isWindows else fullpath)
+            g_logger.error(f'Output filepath points to an existing directory! ("{printable_fullpath}").\n')
+            return USB_STATUS_HOST_IO_ERROR
+
+    # Make sure we have enough free space.
+    (_, _, free_space) = shutil.disk_usage(os.path.dirname(entries[0][1]))
+    if free_space <= total_size:
+        g_logger.error('Not enough free space available in output volume!\n')
+        return USB_STATUS_HOST_IO_ERROR
+
+    entry_idx = 0
+    file: BufferedWriter | None = None
+    file_fullpath = ''
+    file_remaining = 0
+
+    def openNextFile() -> None:
+        nonlocal entry_idx, file, file_fullpath, file_remaining
+
+        # Create files in order, until we find one that's not empty.
+        while entry_idx < len(entries):
+            (file_size, file_fullpath) = entries[entry_idx]
+            entry_idx += 1
+
+            g_logger.info(f'Receiving file: "{(file_fullpath[4:] if g_isWindows else file_fullpath)}".')
+
+            file = open(file_fullpath, 'wb')
+            if file_size:
+                file_remaining = file_size
+                return
+
+            file.close()
+            file = None
+
+    # Create all empty files at the start of the batch, as well as the first one with actual data.
+    openNextFile()
+
+    if not total_size:
+        # Let the command handler take care of sending the status response for us.
+        return USB_STATUS_SUCCESS
+
+    # Send status response before entering the data transfer stage.
+    usbSendStatus(USB_STATUS_SUCCESS)
+
+    # Start data transfer stage.
+    g_logger.debug(f'Data transfer started. Receiving {entry_count} file(s).')
+
+    offset = 0
+    blksize = g_usbTransferBlockSize
+
+    # Check if we should use the progress bar window.
+    use_pbar = (total_size > USB_TRANSFER_THRESHOLD)
+    if use_pbar:
+        prefix = ('' if g_cliMode else f'Current file batch: {entry_count} file(s).\nUse your console to cancel the file transfer if you wish to do so.')
+        g_progressBarWindow.start(total_size, 0, prefix)
+
+    def cancelTransfer():
+        # Only the file that was being received is removed. Files from this batch that were already completed are kept.
+        if file is not None:
+            file.close()
+            os.remove(file_fullpath)
+
+        if use_pbar and (g_progressBarWindow is not None):
+            g_progressBarWindow.end()
+
+    # Start transfer process.
+    stats = TransferStats()
+    start_time = time.time()
+
+    while offset < total_size:
+        # Update block size (if needed).
+        diff = (total_size - offset)
+        if blksize > diff: blksize = diff
+
+        # Set block size and handle Zero-Length Termination packet (if needed).
+        rd_size = blksize
+        if ((offset + blksize) >= total_size) and utilsIsValueAlignedToEndpointPacketSize(blksize):
+            rd_size += 1
+
+        # Read current chunk.
+        usb_start_time = time.perf_counter()
+        chunk = usbRead(rd_size, USB_TRANSFER_TIMEOUT, True)
+        usb_time = (time.perf_counter() - usb_start_time)
+
+        if not chunk:
+            g_logger.error(f'Failed to read 0x{rd_size:X}-byte long data chunk!')
+
+            # Cancel file transfer.
+            cancelTransfer()
+
+            # Returning None will make the command handler exit right away.
+            return None
+
+        chunk_size = len(chunk)
+        stats.addChunk(chunk_size, usb_time)
+
+        # Check if we're dealing with a CancelFileTransfer command.
+        if usbIsCancelFileTransferChunk(chunk, blksize, False):
+            # Cancel file transfer.
+            cancelTransfer()
+
+            g_logger.debug(f'Received CancelFileTransfer ({USB_CMD_CANCEL_FILE_TRANSFER:02X}) command.')
+            g_logger.warning('Transfer cancelled.')
+
+            # Let the command handler take care of sending the status response for us.
+            return USB_STATUS_SUCCESS
+
+        # Split current chunk across all the files it covers.
+        view = memoryview(chunk)
+        chunk_offset = 0
+        disk_start_time = time.perf_counter()
+
+        while (chunk_offset < chunk_size) and (file is not None):
+            wr_size = min(file_remaining, chunk_size - chunk_offset)
+            file.write(view[chunk_offset:chunk_offset + wr_size])
+
+            chunk_offset += wr_size
+            file_remaining -= wr_size
+
+            if not file_remaining:
+                # Close current file and move on to the next one.
+                file.close()
+                file = None
+                openNextFile()
+
+        stats.addDiskTime(time.perf_counter() - disk_start_time)
+
+        # Update current offset.
+        offset = (offset + chunk_size)
+
+        # Update progress bar window (if needed).
+        if use_pbar:
+            g_progressBarWindow.update(chunk_size)
+
+    elapsed_time = round(time.time() - start_time)
+    stats.log('File batch transfer')
+    g_logger.debug(f'File batch transfer successfully completed in {tqdm.format_interval(elapsed_time)}!\n')
+
+    # Hide progress bar window (if needed).
+    if use_pbar:
+        g_progressBarWindow.end()
+
+    return USB_STATUS_SUCCESS
+
+def usbHandleStartExtractedFsDump(cmd_block: bytes) -> int:
+    assert g_logger is not None
+
+    g_logger.debug(f'Received StartExtractedFsDump ({USB_CMD_START_EXTRACTED_FS_DUMP:02X}) command.')
+
+    if g_nspTransferMode or g_nspLayoutMode:
+        g_logger.error('StartExtractedFsDump received mid NSP transfer.')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Parse command block.
+    (extracted_fs_size, extracted_fs_root_path) = struct.unpack_from(f'<Q{USB_FILE_PROPERTIES_MAX_NAME_LENGTH}s', cmd_block, 0)
+    extracted_fs_root_path = extracted_fs_root_path.decode('utf-8').strip('\x00')
+
+    g_logger.info(f'Starting extracted FS dump (size 0x{extracted_fs_size:X}, output relative path "{extracted_fs_root_path}").')
+
+    # Return status code.
+    return USB_STATUS_SUCCESS
+
+def usbHandleEndExtractedFsDump(cmd_block: bytes) -> int:
+    assert g_logger is not None
+    g_logger.debug(f'Received EndExtractedFsDump ({USB_CMD_END_EXTRACTED_FS_DUMP:02X}) command.')
+    g_logger.info(f'Finished extracted FS dump.')
+    return USB_STATUS_SUCCESS
+
+def usbHandleSendFileReference(cmd_block: bytes) -> int:
+    global g_nspRemainingSize, g_nspLayoutReceived
+
+    assert g_logger is not None
+    assert g_progressBarWindow is not None
+
+    g_logger.debug(f'Received SendFileReference ({USB_CMD_SEND_FILE_REFERENCE:02X}) command.')
+
+    # Parse command block.
+    (file_size, src_offset, filename_length, src_filename_length, raw_filename, raw_src_filename) = struct.unpack_from(f'<QQII{USB_FILE_PROPERTIES_MAX_NAME_LENGTH + 1}s{USB_FILE_PROPERTIES_MAX_NAME_LENGTH + 1}s', cmd_block, 0)
+    filename = raw_filename.decode('utf-8').strip('\x00')
+    src_filename = raw_src_filename.decode('utf-8').strip('\x00')
+    (layout_entry_idx,) = struct.unpack_from('<I', cmd_block, 0x61C)
+
+    g_logger.debug(f'File size: 0x{file_size:X} | Source offset: 0x{src_offset:X} | Source file: "{src_filename}"' + (f' | Layout entry: {layout_entry_idx}.' if g_nspLayoutMode else '.'))
+
+    if not g_cliMode:
+        g_logger.info(f'Copying NSP file entry: "{filename}".')
+
+    # Perform sanity checks.
+    if (not (g_nspTransferMode or g_nspLayoutMode)) or (g_nspFile is None):
+        g_logger.error('Received file reference out of NSP transfer mode!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    if (not file_size) or (file_size > g_nspRemainingSize):
+        g_logger.error('Invalid file reference size!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Under NSP layout mode, the referenced data fills a whole region. The NSP header region can't be referenced.
+    if g_nspLayoutMode and ((not layout_entry_idx) or (layout_entry_idx >= len(g_nspLayout)) or g_nspLayoutReceived[layout_entry_idx] or \
+                            (g_nspLayout[layout_entry_idx][1] != file_size)):
+        g_logger.error('Invalid file reference layout entry!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    if (not filename_length) or (filename_length > USB_FILE_PROPERTIES_MAX_NAME_LENGTH) or (not src_filename_length) or (src_filename_length > USB_FILE_PROPERTIES_MAX_NAME_LENGTH):
+        g_logger.error('Invalid filename length!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Generate full, absolute path to the source file. It must have been previously received in full.
+    src_fullpath = os.path.abspath(g_outputDir + os.path.sep + src_filename)
+    if (src_fullpath == g_nspFilePath) or (not os.path.isfile(src_fullpath)) or (os.path.getsize(src_fullpath) < (src_offset + file_size)):
+        utilsResetNspInfo(True)
+        g_logger.error(f'Invalid file reference source! ("{src_filename}").\n')
+        return USB_STATUS_HOST_IO_ERROR
+
+    # Check if we should use the progress bar window.
+    use_pbar = (g_nspSize > USB_TRANSFER_THRESHOLD)
+    if use_pbar:
+        if g_cliMode:
+            # We're not using dynamic tqdm prefixes under CLI mode.
+            prefix = ''
+        else:
+            prefix = f'Current NSP file entry: "{os.path.basename(filename)}".\n'
+            prefix += 'Use your console to cancel the file transfer if you wish to do so.'
+
+        if (not g_nspLayoutMode) and (g_nspRemainingSize == (g_nspSize - g_nspHeaderSize)):
+            # Set current progress to the NSP header size and the maximum value to the provided NSP size.
+            g_progressBarWindow.start(g_nspSize, g_nspHeaderSize, prefix)
+        else:
+            # Set current prefix (holds the filename for the current NSP file entry).
+            g_progressBarWindow.set_prefix(prefix)
+
+    # Copy referenced data. Under NSP layout mode, it goes straight into its final offset.
+    offset = 0
+    blksize = g_usbTransferBlockSize
+
+    if g_nspLayoutMode:
+        g_nspFile.seek(g_nspLayout[layout_entry_idx][0])
+
+    with open(src_fullpath, 'rb') as src_file:
+        src_file.seek(src_offset)
+
+        while offset < file_size:
+            # Update block size (if needed).
+            diff = (file_size - offset)
+            if blksize > diff: blksize = diff
+
+            chunk = src_file.read(blksize)
+            if len(chunk) != blksize:
+                if use_pbar:
+                    g_progressBarWindow.end()
+                utilsResetNspInfo(True)
+                g_logger.error(f'Failed to read 0x{blksize:X}-byte long data chunk from "{src_filename}"!\n')
+                return USB_STATUS_HOST_IO_ERROR
+
+            utilsWriteFile(g_nspFile, chunk)
+            offset = (offset + blksize)
+
+    # Update remaining NSP data size.
+    g_nspRemainingSize -= file_size
+    if g_nspLayoutMode:
+        g_nspLayoutReceived[layout_entry_idx] = file_size
+
+    # Update progress bar window (if needed).
+    if use_pbar:
+        g_progressBarWindow.update(file_size)
+        if not g_nspRemainingSize:
+            g_progressBarWindow.end()
+
+    g_logger.debug(f'Successfully copied 0x{file_size:X} byte(s) from "{src_filename}".\n')
+
+    # Finish NSP layout mode if this was the last region.
+    if g_nspLayoutMode and (not g_nspRemainingSize):
+        usbFinishNspLayout()
+
+    return USB_STATUS_SUCCESS
+
+def usbHandleVerifyFileChecksum(cmd_block: bytes) -> int:
+    global g_lastFileChecksum
+
+    assert g_logger is not None
+
+    g_logger.debug(f'Received VerifyFileChecksum ({USB_CMD_VERIFY_FILE_CHECKSUM:02X}) command.')
+
+    # Parse command block.
+    (checksum_type,) = struct.unpack_from('<B', cmd_block, 0)
+    checksum = cmd_block[0x10:0x30]
+
+    # Only a single verification is allowed per file.
+    last_checksum = g_lastFileChecksum
+    g_lastFileChecksum = None
+
+    if (last_checksum is None) or (last_checksum[0] != checksum_type):
+        g_logger.error('No matching checksum available for the last received file!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    (_, digest) = last_checksum
+    expected = checksum[:len(digest)]
+
+    g_logger.debug(f'Calculated checksum: {digest.hex().upper()} | Expected checksum: {expected.hex().upper()}.\n')
+
+    if digest != expected:
+        g_logger.error('Checksum mismatch! The last received file is corrupted.\n')
+        return USB_STATUS_CHECKSUM_MISMATCH
+
+    return USB_STATUS_SUCCESS
+
+def usbHandleResumeFile(cmd_block: bytes) -> tuple[int, bytes]:
+    assert g_logger is not None
+
+    g_logger.debug(f'Received ResumeFile ({USB_CMD_RESUME_FILE:02X}) command.')
+
+    # Parse command block.
+    (file_size, filename_length, raw_filename) = struct.unpack_from(f'<QI4x{USB_FILE_PROPERTIES_MAX_NAME_LENGTH}s', cmd_block, 0)
+    filename = raw_filename.decode('utf-8').strip('\x00')
+
+    g_logger.debug(f'File size: 0x{file_size:X} | Filename length: 0x{filename_length:X}.')
+
+    # Perform sanity checks.
+    if (not file_size) or (not filename_length) or (filename_length > USB_FILE_PROPERTIES_MAX_NAME_LENGTH) or g_nspTransferMode or g_nspLayoutMode:
+        g_logger.error('Invalid ResumeFile command!\n')
+        return (USB_STATUS_MALFORMED_CMD, b'')
+
+    # Generate full, absolute path to the destination file.
+    fullpath = os.path.abspath(g_outputDir + os.path.sep + filename)
+    printable_fullpath = (fullpath[4:] if g_isWindows else fullpath)
+
+    # Reply with a zeroed block if there's nothing to resume.
+    no_resume_info = bytes(USB_RESUME_INFO_SIZE)
+
+    resume_info = ResumeTracker.load(fullpath, file_size)
+    if resume_info is None:
+        g_logger.debug('No incomplete file available.\n')
+        return (USB_STATUS_SUCCESS, no_resume_info)
+
+    (offset, crc) = resume_info
+
+    # Hash the last block we hold, so nxdumptool can make sure it's dealing with the same data.
+    check_size = min(offset, USB_RESUME_CHECK_SIZE)
+
+    try:
+        with open(fullpath, 'rb') as file:
+            file.seek(offset - check_size)
+            check_data = file.read(check_size)
+    except:
+        utilsLogException(traceback.format_exc())
+        return (USB_STATUS_SUCCESS, no_resume_info)
+
+    if len(check_data) != check_size:
+        return (USB_STATUS_SUCCESS, no_resume_info)
+
+    g_logger.info(f'Found incomplete file: "{printable_fullpath}" (0x{offset:X} / 0x{file_size:X} bytes).\n')
+
+    return (USB_STATUS_SUCCESS, struct.pack('<QII32s', offset, crc, check_size, hashlib.sha256(check_data).digest()))
+
+def usbFinishNspLayout() -> None:
+    assert g_logger is not None
+
+    g_logger.debug(f'Successfully assembled NSP: "{g_nspFilePath}".\n')
+
+    # Disable NSP layout mode. The NSP is complete at this point.
+    utilsResetNspInfo()
+
+def usbHandleStartNspLayout(cmd_block: bytes) -> int:
+    global g_nspLayoutMode, g_nspLayout, g_nspLayoutReceived, g_nspLayoutHashers, g_nspSize, g_nspHeaderSize, g_nspRemainingSize, g_nspFile, g_nspFilePath, g_lastFileChecksum
+
+    assert g_logger is not None
+    assert g_progressBarWindow is not None
+
+    if g_cliMode:
+        print()
+
+    g_logger.debug(f'Received StartNspLayout ({USB_CMD_START_NSP_LAYOUT:02X}) command.')
+
+    if g_nspTransferMode or g_nspLayoutMode:
+        g_logger.error('StartNspLayout received mid NSP transfer.\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Parse command block header.
+    (nsp_size, filename_length, entry_count, raw_filename) = struct.unpack_from(f'<QII{USB_FILE_PROPERTIES_MAX_NAME_LENGTH}s', cmd_block, 0)
+    filename = raw_filename.decode('utf-8').strip('\x00')
+
+    g_logger.debug(f'NSP size: 0x{nsp_size:X} | Filename length: 0x{filename_length:X} | Region count: {entry_count}.')
+
+    # Forget about the checksum from the previous file.
+    g_lastFileChecksum = None
+
+    # Perform sanity checks.
+    if (not filename_length) or (filename_length > USB_FILE_PROPERTIES_MAX_NAME_LENGTH):
+        g_logger.error('Invalid filename length!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    if (entry_count < 2) or (entry_count > USB_NSP_LAYOUT_MAX_ENTRY_COUNT) or (len(cmd_block) != (USB_NSP_LAYOUT_HEADER_SIZE + (entry_count * USB_NSP_LAYOUT_RECORD_SIZE))):
+        g_logger.error('Invalid NSP layout region count!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Parse region records. They must be contiguous and they must cover the whole NSP. The first one always holds the NSP header.
+    layout: list[tuple[int, int]] = []
+    offset = 0
+
+    for i in range(entry_count):
+        (entry_offset, entry_size) = struct.unpack_from('<QQ', cmd_block, USB_NSP_LAYOUT_HEADER_SIZE + (i * USB_NSP_LAYOUT_RECORD_SIZE))
+        if (entry_offset != offset) or ((not i) and (not entry_size)):
+            g_logger.error(f'Invalid NSP layout region #{i}! (offset 0x{entry_offset:X}, size 0x{entry_size:X}).\n')
+            return USB_STATUS_MALFORMED_CMD
+
+        layout.append((entry_offset, entry_size))
+        offset += entry_size
+
+    if (not nsp_size) or (offset != nsp_size):
+        g_logger.error(f'NSP layout size mismatch! (0x{offset:X} != 0x{nsp_size:X}).\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    g_logger.info(f'Receiving NSP: "{filename}".')
+
+    # Generate full, absolute path to the destination file.
+    fullpath = os.path.abspath(g_outputDir + os.path.sep + filename)
+    printable_fullpath = (fullpath[4:] if g_isWindows else fullpath)
+
+    # Get parent directory path.
+    dirpath = os.path.dirname(fullpath)
+
+    # Create full directory tree.
+    os.makedirs(dirpath, exist_ok=True)
+
+    # Make sure the output filepath doesn't point to an existing directory.
+    if os.path.exists(fullpath) and (not os.path.isfile(fullpath)):
+        g_logger.error(f'Output filepath points to an existing directory! ("{printable_fullpath}").\n')
+        return USB_STATUS_HOST_IO_ERROR
+
+    # Make sure we have enough free space.
+    (_, _, free_space) = shutil.disk_usage(dirpath)
+    if free_space <= nsp_size:
+        g_logger.error('Not enough free space available in output volume!\n')
+        return USB_STATUS_HOST_IO_ERROR
+
+    # Get unbuffered file object, then preallocate the whole NSP. Every region is written straight into its final offset.
+    file = open(fullpath, "wb", buffering=0)
+    utilsPreallocateFile(file, nsp_size)
+
+    # Enable NSP layout mode. Empty regions are already complete.
+    g_nspLayoutMode = True
+    g_nspLayout = layout
+    g_nspLayoutReceived = [0] * entry_count
+    g_nspLayoutHashers = {}
+    g_nspSize = nsp_size
+    g_nspHeaderSize = layout[0][1]
+    g_nspRemainingSize = nsp_size
+    g_nspFile = file
+    g_nspFilePath = fullpath
+
+    g_logger.debug(f'NSP layout mode enabled! Writing NSP to: "{printable_fullpath}".\n')
+
+    # Display progress bar window (if needed). Regions may arrive in any order, so the progress bar only reflects the amount of data received so far.
+    if nsp_size > USB_TRANSFER_THRESHOLD:
+        if g_cliMode:
+            prefix = ''
+        else:
+            prefix = f'Current NSP: "{os.path.basename(filename)}".\n'
+            prefix += 'Use your console to cancel the file transfer if you wish to do so.'
+
+        g_progressBarWindow.start(nsp_size, 0, prefix)
+
+    return USB_STATUS_SUCCESS
+
+def usbHandleSendNspLayoutData(cmd_block: bytes) -> int | None:
+    global g_nspRemainingSize, g_lastFileChecksum
+
+    assert g_logger is not None
+    assert g_progressBarWindow is not None
+
+    g_logger.debug(f'Received SendNspLayoutData ({USB_CMD_SEND_NSP_LAYOUT_DATA:02X}) command.')
+
+    # Parse command block.
+    (entry_idx, checksum_type, compression_type, entry_offset, data_size) = struct.unpack_from('<IBB2xQQ', cmd_block, 0)
+
+    dbg_str = f'Region: {entry_idx} | Region offset: 0x{entry_offset:X} | Data size: 0x{data_size:X}'
+    if checksum_type != USB_CHECKSUM_TYPE_NONE:
+        dbg_str += f' | Checksum type: {checksum_type}'
+    if compression_type != USB_COMPRESSION_TYPE_NONE:
+        dbg_str += f' | Compression type: {compression_type}'
+    g_logger.debug(dbg_str + '.')
+
+    # Perform sanity checks.
+    if (not g_nspLayoutMode) or (g_nspFile is None):
+        g_logger.error('Received NSP layout data out of NSP layout mode!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    if (entry_idx >= len(g_nspLayout)) or (not data_size):
+        g_logger.error('Invalid NSP layout region!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    (region_offset, region_size) = g_nspLayout[entry_idx]
+    if ((entry_offset + data_size) > region_size) or ((g_nspLayoutReceived[entry_idx] + data_size) > region_size):
+        g_logger.error('NSP layout data exceeds the region size!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    hasher = utilsGetChecksumHasher(checksum_type)
+    if (checksum_type != USB_CHECKSUM_TYPE_NONE) and ((hasher is None) or entry_offset):
+        g_logger.error('Invalid checksum type!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    compressed = (compression_type == USB_COMPRESSION_TYPE_LZ4)
+    if (compression_type != USB_COMPRESSION_TYPE_NONE) and ((not compressed) or (lz4_block is None)):
+        g_logger.error('Invalid compression type!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Keep calculating the checksum for this region as long as its data arrives in order. Otherwise, it can't be verified.
+    if hasher is not None:
+        g_nspLayoutHashers[entry_idx] = (checksum_type, hasher, 0)
+    elif entry_idx in g_nspLayoutHashers:
+        (checksum_type, hasher, next_offset) = g_nspLayoutHashers[entry_idx]
+        if entry_offset != next_offset:
+            g_logger.warning(f'NSP layout region #{entry_idx} data received out of order. Its checksum won\'t be available.')
+            del g_nspLayoutHashers[entry_idx]
+            hasher = None
+
+    # Send status response before entering the data transfer stage.
+    usbSendStatus(USB_STATUS_SUCCESS)
+
+    use_pbar = (g_nspSize > USB_TRANSFER_THRESHOLD)
+
+    def cancelTransfer():
+        # Wait for the file writer thread to finish before getting rid of the file. NSPs can't be resumed.
+        writer.close()
+        utilsResetNspInfo(True)
+
+        if use_pbar and (g_progressBarWindow is not None):
+            g_progressBarWindow.end()
+
+    # Write data straight into its final offset within the NSP.
+    g_nspFile.seek(region_offset + entry_offset)
+
+    # Start file writer thread. Received data chunks are written to disk while we keep reading from the USB endpoint.
+    stats = TransferStats()
+    writer = FileWriterThread(g_nspFile, hasher=hasher, stats=stats)
+
+    offset = 0
+    blksize = g_usbTransferBlockSize
+
+    while offset < data_size:
+        # Update block size (if needed).
+        diff = (data_size - offset)
+        if blksize > diff: blksize = diff
+
+        # Set block size and handle Zero-Length Termination packet (if needed). Works just like a SendFileProperties data transfer stage.
+        if compressed:
+            rd_size = (USB_FILE_DATA_FRAME_HEADER_SIZE + blksize + 1)
+        else:
+            rd_size = blksize
+            if ((offset + blksize) >= data_size) and utilsIsValueAlignedToEndpointPacketSize(blksize):
+                rd_size += 1
+
+        # Read current chunk.
+        usb_start_time = time.perf_counter()
+        chunk = usbRead(rd_size, USB_TRANSFER_TIMEOUT, True)
+        usb_time = (time.perf_counter() - usb_start_time)
+
+        if not chunk:
+            g_logger.error(f'Failed to read 0x{rd_size:X}-byte long data chunk!')
+            cancelTransfer()
+            return None
+
+        stats.addChunk(len(chunk), usb_time)
+
+        # Check if we're dealing with a CancelFileTransfer command.
+        if usbIsCancelFileTransferChunk(chunk, blksize, compressed):
+            cancelTransfer()
+
+            g_logger.debug(f'Received CancelFileTransfer ({USB_CMD_CANCEL_FILE_TRANSFER:02X}) command.')
+            g_logger.warning('Transfer cancelled.')
+
+            # Let the command handler take care of sending the status response for us.
+            return USB_STATUS_SUCCESS
+
+        # Unpack the current frame (if needed).
+        if compressed:
+            chunk = usbUnpackFileDataFrame(chunk, blksize)
+            if chunk is None:
+                cancelTransfer()
+                return None
+
+        chunk_size = len(chunk)
+
+        # Queue current chunk.
+        if not writer.write(chunk):
+            g_logger.error(f'Failed to write data chunk to "{g_nspFilePath}"!')
+            cancelTransfer()
+            return None
+
+        offset = (offset + chunk_size)
+
+        if use_pbar:
+            g_progressBarWindow.update(chunk_size)
+
+    # Wait for the file writer thread to write all queued chunks.
+    if not writer.close():
+        g_logger.error(f'Failed to write data to "{g_nspFilePath}"!\n')
+
+        utilsResetNspInfo(True)
+
+        if use_pbar:
+            g_progressBarWindow.end()
+
+        return USB_STATUS_HOST_IO_ERROR
+
+    stats.log('NSP layout data transfer')
+
+    # Update region info.
+    g_nspLayoutReceived[entry_idx] += data_size
+    g_nspRemainingSize -= data_size
+
+    if entry_idx in g_nspLayoutHashers:
+        (checksum_type, hasher, _) = g_nspLayoutHashers[entry_idx]
+        if g_nspLayoutReceived[entry_idx] == region_size:
+            # Keep the checksum around until nxdumptool asks us to verify it.
+            g_lastFileChecksum = (checksum_type, hasher.digest())
+            del g_nspLayoutHashers[entry_idx]
+        else:
+            g_nspLayoutHashers[entry_idx] = (checksum_type, hasher, entry_offset + data_size)
+
+    # Finish NSP layout mode if this was the last region data.
+    if not g_nspRemainingSize:
+        if use_pbar:
+            g_progressBarWindow.end()
+
+        usbFinishNspLayout()
+
+    return USB_STATUS_SUCCESS
+
+def usbHandleStartFileDelta(cmd_block: bytes) -> int:
+    global g_fileDeltaMode, g_fileDeltaSize, g_fileDeltaExistingSize, g_fileDeltaBlockSize, g_fileDeltaProcessedSize, g_fileDeltaReceivedSize, g_fileDeltaFile, g_fileDeltaFilePath, g_lastFileChecksum
+
+    assert g_logger is not None
+    assert g_progressBarWindow is not None
+
+    if g_cliMode:
+        print()
+
+    g_logger.debug(f'Received StartFileDelta ({USB_CMD_START_FILE_DELTA:02X}) command.')
+
+    if g_nspTransferMode or g_nspLayoutMode or g_fileDeltaMode:
+        g_logger.error('StartFileDelta received mid file transfer.\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Parse command block.
+    (file_size, filename_length, block_size, raw_filename) = struct.unpack_from(f'<QII{USB_FILE_PROPERTIES_MAX_NAME_LENGTH}s', cmd_block, 0)
+    filename = raw_filename.decode('utf-8').strip('\x00')
+
+    g_logger.debug(f'File size: 0x{file_size:X} | Filename length: 0x{filename_length:X} | Block size: 0x{block_size:X}.')
+
+    # Forget about the checksum from the previous file.
+    g_lastFileChecksum = None
+
+    # Perform sanity checks.
+    if (not file_size) or (not filename_length) or (filename_length > USB_FILE_PROPERTIES_MAX_NAME_LENGTH) or (not block_size) or (block_size > USB_TRANSFER_BLOCK_SIZE):
+        g_logger.error('Invalid StartFileDelta command!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    g_logger.info(f'Receiving file (delta transfer): "{filename}".')
+
+    # Generate full, absolute path to the destination file.
+    fullpath = os.path.abspath(g_outputDir + os.path.sep + filename)
+    printable_fullpath = (fullpath[4:] if g_isWindows else fullpath)
+
+    # Get parent directory path.
+    dirpath = os.path.dirname(fullpath)
+
+    # Create full directory tree.
+    os.makedirs(dirpath, exist_ok=True)
+
+    # Make sure the output filepath doesn't point to an existing directory.
+    if os.path.exists(fullpath) and (not os.path.isfile(fullpath)):
+        g_logger.error(f'Output filepath points to an existing directory! ("{printable_fullpath}").\n')
+        return USB_STATUS_HOST_IO_ERROR
+
+    existing_size = (os.path.getsize(fullpath) if os.path.exists(fullpath) else 0)
+
+    # Make sure we have enough free space.
+    (_, _, free_space) = shutil.disk_usage(dirpath)
+    if (file_size > existing_size) and (free_space <= (file_size - existing_size)):
+        g_logger.error('Not enough free space available in output volume!\n')
+        return USB_STATUS_HOST_IO_ERROR
+
+    # Keep the data we already hold, then resize the file. Resume info saved for it is no longer valid.
+    try:
+        file = open(fullpath, ('r+b' if existing_size else 'wb'), buffering=0)
+        file.truncate(file_size)
+    except:
+        utilsLogException(traceback.format_exc())
+        return USB_STATUS_HOST_IO_ERROR
+
+    ResumeTracker.discard(fullpath)
+
+    # Enable file delta mode.
+    g_fileDeltaMode = True
+    g_fileDeltaSize = file_size
+    g_fileDeltaExistingSize = min(existing_size, file_size)
+    g_fileDeltaBlockSize = block_size
+    g_fileDeltaProcessedSize = 0
+    g_fileDeltaReceivedSize = 0
+    g_fileDeltaFile = file
+    g_fileDeltaFilePath = fullpath
+
+    g_logger.debug(f'File delta mode enabled! Comparing against 0x{g_fileDeltaExistingSize:X} bytes from: "{printable_fullpath}".\n')
+
+    # Display progress bar window (if needed). It's updated as soon as nxdumptool moves on to the next batch of blocks, regardless of how many of them were actually sent.
+    if file_size > USB_TRANSFER_THRESHOLD:
+        if g_cliMode:
+            prefix = ''
+        else:
+            prefix = f'Current file: "{os.path.basename(filename)}".\n'
+            prefix += 'Use your console to cancel the file transfer if you wish to do so.'
+
+        g_progressBarWindow.start(file_size, 0, prefix)
+
+    return USB_STATUS_SUCCESS
+
+def usbUpdateFileDeltaProgress(offset: int) -> None:
+    global g_fileDeltaProcessedSize
+
+    if offset <= g_fileDeltaProcessedSize:
+        return
+
+    if (g_fileDeltaSize > USB_TRANSFER_THRESHOLD) and (g_progressBarWindow is not None):
+        g_progressBarWindow.update(offset - g_fileDeltaProcessedSize)
+
+    g_fileDeltaProcessedSize = offset
+
+def usbHandleGetFileDeltaHashes(cmd_block: bytes) -> tuple[int, bytes]:
     assert g_logger is not None
 
-    g_logger.debug(f'Received CancelFileTransfer ({USB_CMD_START_SESSION:02X}) command.')
+    # Parse command block.
+    (block_idx, block_count) = struct.unpack_from('<QI4x', cmd_block, 0)
 
-    if g_nspTransferMode:
-        if (g_nspSize > USB_TRANSFER_THRESHOLD) and (g_progressBarWindow is not None):
-            g_progressBarWindow.end()
+    g_logger.debug(f'Received GetFileDeltaHashes ({USB_CMD_GET_FILE_DELTA_HASHES:02X}) command. Block index: {block_idx} | Block count: {block_count}.')
 
-        utilsResetNspInfo(True)
+    # Perform sanity checks.
+    if (not g_fileDeltaMode) or (g_fileDeltaFile is None):
+        g_logger.error('Received GetFileDeltaHashes out of file delta mode!\n')
+        return (USB_STATUS_MALFORMED_CMD, b'')
 
-        g_logger.warning('Transfer cancelled.')
-        return USB_STATUS_SUCCESS
-    else:
-        g_logger.error('Unexpected transfer cancellation.')
-        return USB_STATUS_MALFORMED_CMD
+    start_offset = (block_idx * g_fileDeltaBlockSize)
+    if (not block_count) or ((block_count * g_fileDeltaBlockSize) > USB_TRANSFER_BLOCK_SIZE) or (start_offset >= g_fileDeltaSize) or \
+       ((start_offset + ((block_count - 1) * g_fileDeltaBlockSize)) >= g_fileDeltaSize):
+        g_logger.error('Invalid file delta block range!\n')
+        return (USB_STATUS_MALFORMED_CMD, b'')
 
-def usbHandleSendNspHeader(cmd_block: bytes) -> int:
-    global g_nspTransferMode, g_nspHeaderSize, g_nspRemainingSize, g_nspFile, g_nspFilePath
+    # nxdumptool processes the file in order, so everything before the requested blocks is already done.
+    usbUpdateFileDeltaProgress(start_offset)
+
+    hashes = bytearray()
+
+    try:
+        g_fileDeltaFile.seek(start_offset)
+
+        for i in range(block_count):
+            block_offset = (start_offset + (i * g_fileDeltaBlockSize))
+            block_size = min(g_fileDeltaBlockSize, g_fileDeltaSize - block_offset)
+
+            # Blocks we didn't fully hold get zeroed checksums, so they never match.
+            if (block_offset + block_size) > g_fileDeltaExistingSize:
+                hashes += bytes(USB_FILE_DELTA_HASH_SIZE)
+                continue
+
+            data = g_fileDeltaFile.read(block_size)
+            hashes += (hashlib.sha256(data).digest() if len(data) == block_size else bytes(USB_FILE_DELTA_HASH_SIZE))
+    except:
+        utilsLogException(traceback.format_exc())
+        return (USB_STATUS_HOST_IO_ERROR, b'')
+
+    return (USB_STATUS_SUCCESS, bytes(hashes))
+
+def usbHandleSendFileDeltaData(cmd_block: bytes) -> int | None:
+    global g_fileDeltaReceivedSize
 
     assert g_logger is not None
-    assert g_nspFile is not None
 
-    nsp_header_size = len(cmd_block)
+    # Parse command block.
+    (offset, data_size, compression_type) = struct.unpack_from('<QQB7x', cmd_block, 0)
 
-    g_logger.debug(f'Received SendNspHeader ({USB_CMD_SEND_NSP_HEADER:02X}) command.')
+    dbg_str = f'Received SendFileDeltaData ({USB_CMD_SEND_FILE_DELTA_DATA:02X}) command. Offset: 0x{offset:X} | Data size: 0x{data_size:X}'
+    if compression_type != USB_COMPRESSION_TYPE_NONE:
+        dbg_str += f' | Compression type: {compression_type}'
+    g_logger.debug(dbg_str + '.')
 
-    # Validity checks.
-    if not g_nspTransferMode:
-        g_logger.error('Received NSP header out of NSP transfer mode!\n')
+    # Perform sanity checks.
+    if (not g_fileDeltaMode) or (g_fileDeltaFile is None):
+        g_logger.error('Received file delta data out of file delta mode!\n')
         return USB_STATUS_MALFORMED_CMD
 
-    if g_nspRemainingSize:
-        g_logger.error(f'Received NSP header before receiving all NSP data! (missing 0x{g_nspRemainingSize:X} byte[s]).\n')
+    if (not data_size) or ((offset + data_size) > g_fileDeltaSize):
+        g_logger.error('File delta data exceeds the file size!\n')
         return USB_STATUS_MALFORMED_CMD
 
-    if nsp_header_size != g_nspHeaderSize:
-        g_logger.error(f'NSP header size mismatch! (0x{nsp_header_size:X} != 0x{g_nspHeaderSize:X}).\n')
+    compressed = (compression_type == USB_COMPRESSION_TYPE_LZ4)
+    if (compression_type != USB_COMPRESSION_TYPE_NONE) and ((not compressed) or (lz4_block is None)):
+        g_logger.error('Invalid compression type!\n')
         return USB_STATUS_MALFORMED_CMD
 
-    # Write NSP header.
-    g_nspFile.seek(0)
-    g_nspFile.write(cmd_block)
+    # Send status response before entering the data transfer stage.
+    usbSendStatus(USB_STATUS_SUCCESS)
 
-    g_logger.debug(f'Successfully wrote 0x{nsp_header_size:X}-byte long NSP header to "{g_nspFilePath}".\n')
+    def cancelTransfer():
+        # Wait for the file writer thread to finish before getting rid of the file.
+        writer.close()
 
-    # Disable NSP transfer mode.
-    utilsResetNspInfo()
+        if (g_fileDeltaSize > USB_TRANSFER_THRESHOLD) and (g_progressBarWindow is not None):
+            g_progressBarWindow.end()
 
-    return USB_STATUS_SUCCESS
+        utilsResetFileDeltaInfo(True)
+
+    # Write data straight into its final offset within the file.
+    g_fileDeltaFile.seek(offset)
+
+    # Start file writer thread. Received data chunks are written to disk while we keep reading from the USB endpoint.
+    stats = TransferStats()
+    writer = FileWriterThread(g_fileDeltaFile, stats=stats)
+
+    cur_offset = 0
+    blksize = g_usbTransferBlockSize
+
+    while cur_offset < data_size:
+        # Update block size (if needed).
+        diff = (data_size - cur_offset)
+        if blksize > diff: blksize = diff
+
+        # Set block size and handle Zero-Length Termination packet (if needed). Works just like a SendFileProperties data transfer stage.
+        if compressed:
+            rd_size = (USB_FILE_DATA_FRAME_HEADER_SIZE + blksize + 1)
+        else:
+            rd_size = blksize
+            if ((cur_offset + blksize) >= data_size) and utilsIsValueAlignedToEndpointPacketSize(blksize):
+                rd_size += 1
+
+        # Read current chunk.
+        usb_start_time = time.perf_counter()
+        chunk = usbRead(rd_size, USB_TRANSFER_TIMEOUT, True)
+        usb_time = (time.perf_counter() - usb_start_time)
+
+        if not chunk:
+            g_logger.error(f'Failed to read 0x{rd_size:X}-byte long data chunk!')
+            cancelTransfer()
+            return None
+
+        stats.addChunk(len(chunk), usb_time)
+
+        # Check if we're dealing with a CancelFileTransfer command.
+        if usbIsCancelFileTransferChunk(chunk, blksize, compressed):
+            cancelTransfer()
+
+            g_logger.debug(f'Received CancelFileTransfer ({USB_CMD_CANCEL_FILE_TRANSFER:02X}) command.')
+            g_logger.warning('Transfer cancelled.')
+
+            # Let the command handler take care of sending the status response for us.
+            return USB_STATUS_SUCCESS
+
+        # Unpack the current frame (if needed).
+        if compressed:
+            chunk = usbUnpackFileDataFrame(chunk, blksize)
+            if chunk is None:
+                cancelTransfer()
+                return None
+
+        chunk_size = len(chunk)
+
+        # Queue current chunk.
+        if not writer.write(chunk):
+            g_logger.error(f'Failed to write data chunk to "{g_fileDeltaFilePath}"!')
+            cancelTransfer()
+            return None
+
+        cur_offset = (cur_offset + chunk_size)
+
+    # Wait for the file writer thread to write all queued chunks.
+    if not writer.close():
+        g_logger.error(f'Failed to write data to "{g_fileDeltaFilePath}"!\n')
+
+        if (g_fileDeltaSize > USB_TRANSFER_THRESHOLD) and (g_progressBarWindow is not None):
+            g_progressBarWindow.end()
+
+        utilsResetFileDeltaInfo(True)
+
+        return USB_STATUS_HOST_IO_ERROR
+
+    stats.log('File delta data transfer')
+
+    g_fileDeltaReceivedSize += data_size
 
-def usbHandleEndSession(cmd_block: bytes) -> int:
-    assert g_logger is not None
-    g_logger.debug(f'Received EndSession ({USB_CMD_END_SESSION:02X}) command.')
     return USB_STATUS_SUCCESS
 
-def usbHandleStartExtractedFsDump(cmd_block: bytes) -> int:
+def usbHandleEndFileDelta(cmd_block: bytes) -> int:
     assert g_logger is not None
 
-    g_logger.debug(f'Received StartExtractedFsDump ({USB_CMD_START_EXTRACTED_FS_DUMP:02X}) command.')
+    g_logger.debug(f'Received EndFileDelta ({USB_CMD_END_FILE_DELTA:02X}) command.')
 
-    if g_nspTransferMode:
-        g_logger.error('StartExtractedFsDump received mid NSP transfer.')
+    if (not g_fileDeltaMode) or (g_fileDeltaFile is None):
+        g_logger.error('Received EndFileDelta out of file delta mode!\n')
         return USB_STATUS_MALFORMED_CMD
 
-    # Parse command block.
-    (extracted_fs_size, extracted_fs_root_path) = struct.unpack_from(f'<Q{USB_FILE_PROPERTIES_MAX_NAME_LENGTH}s', cmd_block, 0)
-    extracted_fs_root_path = extracted_fs_root_path.decode('utf-8').strip('\x00')
+    usbUpdateFileDeltaProgress(g_fileDeltaSize)
 
-    g_logger.info(f'Starting extracted FS dump (size 0x{extracted_fs_size:X}, output relative path "{extracted_fs_root_path}").')
+    if (g_fileDeltaSize > USB_TRANSFER_THRESHOLD) and (g_progressBarWindow is not None):
+        g_progressBarWindow.end()
+
+    g_logger.info(f'File delta transfer complete: 0x{g_fileDeltaReceivedSize:X} out of 0x{g_fileDeltaSize:X} bytes received, ' \
+                  f'0x{g_fileDeltaSize - g_fileDeltaReceivedSize:X} bytes reused from "{g_fileDeltaFilePath}".\n')
+
+    utilsResetFileDeltaInfo()
 
-    # Return status code.
     return USB_STATUS_SUCCESS
 
-def usbHandleEndExtractedFsDump(cmd_block: bytes) -> int:
+def usbHandleStartLinkBenchmark(cmd_block: bytes) -> tuple[int, bytes] | None:
     assert g_logger is not None
-    g_logger.debug(f'Received EndExtractedFsDump ({USB_CMD_END_EXTRACTED_FS_DUMP:02X}) command.')
-    g_logger.info(f'Finished extracted FS dump.')
-    return USB_STATUS_SUCCESS
+
+    g_logger.debug(f'Received StartLinkBenchmark ({USB_CMD_START_LINK_BENCHMARK:02X}) command.')
+
+    # Parse command block.
+    (data_size, chunk_size, queue_depth, echo) = struct.unpack_from('<QIBB2x', cmd_block, 0)
+    echo = bool(echo)
+
+    g_logger.debug(f'Data size: 0x{data_size:X} | Chunk size: 0x{chunk_size:X} | Queue depth: {queue_depth} | Echo: {echo}.')
+
+    # Perform sanity checks.
+    if (not data_size) or (not chunk_size) or (chunk_size > USB_TRANSFER_BLOCK_SIZE) or (chunk_size % USB_LINK_BENCHMARK_CHUNK_ALIGNMENT) or (data_size % chunk_size) or \
+       (not queue_depth) or (echo and (queue_depth != 1)) or g_nspTransferMode or g_nspLayoutMode or g_fileDeltaMode:
+        g_logger.error('Invalid StartLinkBenchmark command!\n')
+        return (USB_STATUS_MALFORMED_CMD, b'')
+
+    # Let nxdumptool know we're ready to start receiving data.
+    usbSendStatus(USB_STATUS_SUCCESS)
+
+    chunk_count = (data_size // chunk_size)
+    min_latency = max_latency = total_latency = 0
+
+    # Received data is never written anywhere. Under echo mode, each chunk is sent back to nxdumptool right away.
+    start_time = time.perf_counter_ns()
+
+    for _ in range(chunk_count):
+        chunk_start_time = time.perf_counter_ns()
+
+        chunk = usbRead(chunk_size, USB_TRANSFER_TIMEOUT, True)
+        if len(chunk) != chunk_size:
+            g_logger.error(f'Failed to read 0x{chunk_size:X}-byte long benchmark chunk!\n')
+
+            # Returning None will make the command handler exit right away.
+            return None
+
+        if echo and (usbWrite(chunk, USB_TRANSFER_TIMEOUT, True) != chunk_size):
+            g_logger.error(f'Failed to write 0x{chunk_size:X}-byte long echoed benchmark chunk!\n')
+            return None
+
+        latency = (time.perf_counter_ns() - chunk_start_time)
+        min_latency = (latency if ((not min_latency) or (latency < min_latency)) else min_latency)
+        max_latency = max(latency, max_latency)
+        total_latency += latency
+
+    elapsed_time = max(time.perf_counter_ns() - start_time, 1)
+    speed = ((data_size * 1000000000) / elapsed_time / (1024 * 1024))
+
+    g_logger.info(f'Link benchmark ({"echo" if echo else "discard"}, 0x{data_size:X} bytes, 0x{chunk_size:X}-byte chunks, queue depth {queue_depth}): {speed:.2f} MiB/s. ' \
+                  f'Latency: avg {total_latency / chunk_count / 1000000:.3f} ms, min {min_latency / 1000000:.3f} ms, max {max_latency / 1000000:.3f} ms.\n')
+
+    return (USB_STATUS_SUCCESS, struct.pack('<QQQQ', elapsed_time, min_latency, max_latency, total_latency))
 
 def usbCommandHandler() -> None:
     assert g_logger is not None
@@ -1085,7 +3099,18 @@ def usbCommandHandler() -> None:
         USB_CMD_SEND_NSP_HEADER:         usbHandleSendNspHeader,
         USB_CMD_END_SESSION:             usbHandleEndSession,
         USB_CMD_START_EXTRACTED_FS_DUMP: usbHandleStartExtractedFsDump,
-        USB_CMD_END_EXTRACTED_FS_DUMP:   usbHandleEndExtractedFsDump
+        USB_CMD_END_EXTRACTED_FS_DUMP:   usbHandleEndExtractedFsDump,
+        USB_CMD_SEND_FILE_REFERENCE:     usbHandleSendFileReference,
+        USB_CMD_SEND_FILE_BATCH:         usbHandleSendFileBatch,
+        USB_CMD_VERIFY_FILE_CHECKSUM:    usbHandleVerifyFileChecksum,
+        USB_CMD_RESUME_FILE:             usbHandleResumeFile,
+        USB_CMD_START_NSP_LAYOUT:        usbHandleStartNspLayout,
+        USB_CMD_SEND_NSP_LAYOUT_DATA:    usbHandleSendNspLayoutData,
+        USB_CMD_START_LINK_BENCHMARK:    usbHandleStartLinkBenchmark,
+        USB_CMD_START_FILE_DELTA:        usbHandleStartFileDelta,
+        USB_CMD_GET_FILE_DELTA_HASHES:   usbHandleGetFileDeltaHashes,
+        USB_CMD_SEND_FILE_DELTA_DATA:    usbHandleSendFileDeltaData,
+        USB_CMD_END_FILE_DELTA:          usbHandleEndFileDelta
     }
 
     # Get device endpoints.
@@ -1105,6 +3130,9 @@ def usbCommandHandler() -> None:
     # Reset NSP info.
     utilsResetNspInfo()
 
+    # Reset file delta info.
+    utilsResetFileDeltaInfo()
+
     while True:
         # Read command header.
         cmd_header = usbRead(USB_CMD_HEADER_SIZE)
@@ -1147,15 +3175,32 @@ def usbCommandHandler() -> None:
         if (cmd_id == USB_CMD_START_SESSION and cmd_block_size != USB_CMD_BLOCK_SIZE_START_SESSION) or \
            (cmd_id == USB_CMD_SEND_FILE_PROPERTIES and cmd_block_size != USB_CMD_BLOCK_SIZE_SEND_FILE_PROPERTIES) or \
            (cmd_id == USB_CMD_SEND_NSP_HEADER and not cmd_block_size) or \
-           (cmd_id == USB_CMD_START_EXTRACTED_FS_DUMP and cmd_block_size != USB_CMD_BLOCK_SIZE_START_EXTRACTED_FS_DUMP):
+           (cmd_id == USB_CMD_START_EXTRACTED_FS_DUMP and cmd_block_size != USB_CMD_BLOCK_SIZE_START_EXTRACTED_FS_DUMP) or \
+           (cmd_id == USB_CMD_SEND_FILE_REFERENCE and cmd_block_size != USB_CMD_BLOCK_SIZE_SEND_FILE_REFERENCE) or \
+           (cmd_id == USB_CMD_SEND_FILE_BATCH and cmd_block_size < (USB_FILE_BATCH_HEADER_SIZE + USB_FILE_BATCH_RECORD_SIZE)) or \
+           (cmd_id == USB_CMD_VERIFY_FILE_CHECKSUM and cmd_block_size != USB_CMD_BLOCK_SIZE_VERIFY_FILE_CHECKSUM) or \
+           (cmd_id == USB_CMD_RESUME_FILE and cmd_block_size != USB_CMD_BLOCK_SIZE_RESUME_FILE) or \
+           (cmd_id == USB_CMD_START_NSP_LAYOUT and cmd_block_size < (USB_NSP_LAYOUT_HEADER_SIZE + (2 * USB_NSP_LAYOUT_RECORD_SIZE))) or \
+           (cmd_id == USB_CMD_SEND_NSP_LAYOUT_DATA and cmd_block_size != USB_CMD_BLOCK_SIZE_SEND_NSP_LAYOUT_DATA) or \
+           (cmd_id == USB_CMD_START_LINK_BENCHMARK and cmd_block_size != USB_CMD_BLOCK_SIZE_START_LINK_BENCHMARK) or \
+           (cmd_id == USB_CMD_START_FILE_DELTA and cmd_block_size != USB_CMD_BLOCK_SIZE_START_FILE_DELTA) or \
+           (cmd_id == USB_CMD_GET_FILE_DELTA_HASHES and cmd_block_size != USB_CMD_BLOCK_SIZE_GET_FILE_DELTA_HASHES) or \
+           (cmd_id == USB_CMD_SEND_FILE_DELTA_DATA and cmd_block_size != USB_CMD_BLOCK_SIZE_SEND_FILE_DELTA_DATA) or \
+           (cmd_id == USB_CMD_END_FILE_DELTA and cmd_block_size):
             g_logger.error(f'Invalid command block size for command ID {cmd_id:02X}! (0x{cmd_block_size:X}).\n')
             usbSendStatus(USB_STATUS_MALFORMED_CMD)
             continue
 
         # Run command handler function.
-        # Send status response afterwards. Bail out if requested.
+        # Send status response afterwards, followed by any additional response block returned by the handler. Bail out if requested.
         status = cmd_func(cmd_block)
-        if (status is None) or (not usbSendStatus(status)) or (cmd_id == USB_CMD_END_SESSION) or (status == USB_STATUS_UNSUPPORTED_ABI_VERSION):
+
+        response = b''
+        if isinstance(status, tuple):
+            (status, response) = status
+
+        if (status is None) or (not usbSendStatus(status)) or (response and (usbWrite(response, USB_TRANSFER_TIMEOUT) != len(response))) or \
+           (cmd_id == USB_CMD_END_SESSION) or (status == USB_STATUS_UNSUPPORTED_ABI_VERSION):
             break
 
     g_logger.info('\nStopping server.')
@@ -1164,11 +3209,239 @@ def usbCommandHandler() -> None:
         # Update UI.
         uiToggleElements(True)
 
+def sessionProcessMain(location: str, output_dir: str, log_level: int, event_queue: Any, metrics: bool) -> None:
+    global g_cliMode, g_outputDir, g_usbDevLocation, g_isWindows, g_logger, g_progressBarWindow, g_metrics, g_metricsConsole
+
+    # We're running in a brand new process, so all global state is our own. Session processes behave just like the CLI mode, but they only claim a single console.
+    g_cliMode = True
+    g_outputDir = output_dir
+    g_usbDevLocation = location
+    g_isWindows = (platform.system() == 'Windows')
+
+    warnings.filterwarnings("ignore")
+
+    # Forward all log messages to the multi-console server process.
+    g_logger = logging.getLogger()
+    for handler in list(g_logger.handlers):
+        g_logger.removeHandler(handler)
+
+    log_handler = SessionLogHandler(event_queue, location)
+    log_handler.setFormatter(logging.Formatter('%(message)s'))
+    g_logger.addHandler(log_handler)
+    g_logger.setLevel(log_level)
+
+    g_progressBarWindow = SessionProgressReporter(event_queue, location)
+
+    # Periodically send our metrics to the multi-console server process, if needed. Errors are counted by the multi-console server process itself.
+    if metrics:
+        g_metrics = DaemonMetrics()
+        g_metricsConsole = location
+
+        def send_metrics() -> None:
+            assert g_metrics is not None
+            while True:
+                time.sleep(DAEMON_SAMPLE_INTERVAL)
+                event_queue.put(('metrics', location, g_metrics.takeDeltas(location)))
+
+        threading.Thread(target=send_metrics, daemon=True).start()
+
+    try:
+        os.makedirs(g_outputDir, exist_ok=True)
+        usbCommandHandler()
+    except KeyboardInterrupt:
+        pass
+    except:
+        utilsLogException(traceback.format_exc())
+
+    # Send any metrics we've accumulated since the last update.
+    if g_metrics is not None:
+        event_queue.put(('metrics', location, g_metrics.takeDeltas(location)))
+
+class SessionManager:
+    """
+    Runs an independent session for each connected console, each one within its own process and with its own output subdirectory (named after the console location).
+    Each session process holds its own USB endpoints, command handler loop and file writer threads, so a slow console or output storage never holds the rest back.
+    Session processes are restarted as long as their console remains connected, which lets consoles start new sessions at any time.
+    """
+
+    def __init__(self, output_dir: str, log_level: int) -> None:
+        self.output_dir = output_dir
+        self.log_level = log_level
+
+        # Spawned processes don't inherit any Tkinter or libusb state from us.
+        self.mp_ctx = multiprocessing.get_context('spawn')
+        self.event_queue = self.mp_ctx.Queue()
+
+        self.lock = threading.Lock()
+        self.stop_event = threading.Event()
+        self.sessions: dict[str, Any] = {}
+
+        # Per-console transfer state, used to calculate throughput values. Each entry holds the size transferred since the last sample and an active transfer flag.
+        self.transfers: dict[str, list] = {}
+        self.rates: dict[str, float] = {}
+        self.prev_sample_time = time.perf_counter()
+        self.prev_log_time = self.prev_sample_time
+
+        self.poll_thread = threading.Thread(target=self._poll, daemon=True)
+        self.event_thread = threading.Thread(target=self._pump_events, daemon=True)
+
+    def start(self) -> None:
+        assert g_logger is not None
+        g_logger.info(MULTI_SERVER_START_MSG)
+
+        self.poll_thread.start()
+        self.event_thread.start()
+
+    def stop(self) -> None:
+        self.stop_event.set()
+        self.poll_thread.join()
+
+        with self.lock:
+            for proc in self.sessions.values():
+                proc.terminate()
+                proc.join()
+
+            self.sessions.clear()
+            self.transfers.clear()
+            self.rates.clear()
+
+        # Unblock the event thread.
+        self.event_queue.put(None)
+        self.event_thread.join()
+
+    def wait(self) -> None:
+        # Only used under CLI mode. Periodically samples throughput values until interrupted.
+        while not self.stop_event.wait(MULTI_SERVER_POLL_INTERVAL):
+            self.sample()
+
+    def _poll(self) -> None:
+        assert g_logger is not None
+
+        while not self.stop_event.is_set():
+            try:
+                locations = set(usbGetDeviceLocation(dev) for dev in usb.core.find(find_all=True, idVendor=USB_DEV_VID, idProduct=USB_DEV_PID))
+            except:
+                utilsLogException(traceback.format_exc())
+                g_logger.error('Fatal error ocurred while enumerating USB devices.')
+                locations = set()
+
+            with self.lock:
+                # Stop sessions for disconnected consoles, then start (or restart) sessions for connected ones.
+                for location in list(self.sessions.keys()):
+                    proc = self.sessions[location]
+                    if (location not in locations) or (not proc.is_alive()):
+                        if proc.is_alive():
+                            proc.terminate()
+                        proc.join()
+
+                        del self.sessions[location]
+                        self.transfers.pop(location, None)
+                        self.rates.pop(location, None)
+
+                for location in locations:
+                    if location in self.sessions:
+                        continue
+
+                    proc = self.mp_ctx.Process(target=sessionProcessMain, args=(location, os.path.join(self.output_dir, location), self.log_level, self.event_queue, g_metrics is not None), \
+                                               daemon=True)
+                    proc.start()
+
+                    self.sessions[location] = proc
+                    g_logger.debug(f'[{location}] Started session process (PID {proc.pid}).')
+
+            self.stop_event.wait(MULTI_SERVER_POLL_INTERVAL)
+
+    def _pump_events(self) -> None:
+        assert g_logger is not None
+
+        while True:
+            event = self.event_queue.get()
+            if event is None:
+                break
+
+            if event[0] == 'log':
+                (_, location, level, msg) = event
+                for line in msg.strip('\n').split('\n'):
+                    g_logger.log(level, f'[{location}] {line}')
+
+                if (g_metrics is not None) and (level >= logging.ERROR):
+                    g_metrics.add(location, errors=1)
+            elif event[0] == 'metrics':
+                if g_metrics is not None:
+                    g_metrics.merge(event[1], event[2])
+            elif event[0] == 'progress':
+                (_, location, size, active) = event
+                with self.lock:
+                    transfer = self.transfers.setdefault(location, [0, False])
+                    transfer[0] += size
+                    transfer[1] = active
+
+    def sample(self) -> tuple[float, dict[str, float]]:
+        # Returns the aggregate throughput and the throughput for each console with an active transfer, expressed in MiB/s.
+        assert g_logger is not None
+
+        cur_time = time.perf_counter()
+        elapsed_time = max(cur_time - self.prev_sample_time, 1e-6)
+        self.prev_sample_time = cur_time
+
+        with self.lock:
+            for (location, transfer) in self.transfers.items():
+                self.rates[location] = (transfer[0] / elapsed_time / (1024 * 1024))
+                transfer[0] = 0
+
+            rates = { location: rate for (location, rate) in sorted(self.rates.items()) if self.transfers[location][1] or rate }
+
+        total = sum(rates.values())
+
+        if rates and ((cur_time - self.prev_log_time) >= MULTI_SERVER_STATS_INTERVAL):
+            per_console = ', '.join(f'{location}: {rate:.2f} MiB/s' for (location, rate) in rates.items())
+            g_logger.info(f'Throughput: {total:.2f} MiB/s total ({per_console}).')
+            self.prev_log_time = cur_time
+
+        return (total, rates)
+
+    def get_session_count(self) -> int:
+        with self.lock:
+            return len(self.sessions)
+
 def uiStopServer() -> None:
+    global g_sessionManager
+
+    # Stop all session processes if the multi-console server is running.
+    if g_sessionManager is not None:
+        g_sessionManager.stop()
+        g_sessionManager = None
+
+        assert g_logger is not None
+        g_logger.info('\nStopping server.')
+
+        uiToggleElements(True)
+        return
+
     # Signal the shared stop event.
     assert g_stopEvent is not None
     g_stopEvent.set()
 
+def uiUpdateMultiServerStatus() -> None:
+    # Display the aggregate and per-console throughput under the server button while the multi-console server is running.
+    if g_sessionManager is None:
+        return
+
+    assert g_tkRoot is not None
+    assert g_tkCanvas is not None
+
+    (total, rates) = g_sessionManager.sample()
+
+    msg = f'{g_sessionManager.get_session_count()} console(s) connected.'
+    if rates:
+        per_console = ' | '.join(f'{location}: {rate:.1f}' for (location, rate) in rates.items())
+        msg += f' {total:.1f} MiB/s total ({per_console}).'
+    else:
+        msg += f' {MULTI_SERVER_START_MSG}'
+
+    g_tkCanvas.itemconfigure(g_tkTipMessage, state='normal', text=msg)
+    g_tkRoot.after(int(MULTI_SERVER_POLL_INTERVAL * 1000), uiUpdateMultiServerStatus)
+
 def uiStartServer() -> None:
     global g_outputDir
 
@@ -1195,16 +3468,32 @@ def uiStartServer() -> None:
     # Update UI.
     uiToggleElements(False)
 
+    # Start the multi-console server, if needed.
+    if (g_multiIntVar is not None) and g_multiIntVar.get():
+        uiStartMultiServer()
+        return
+
     # Create background server thread.
     server_thread = threading.Thread(target=usbCommandHandler, daemon=True)
     server_thread.start()
 
+def uiStartMultiServer() -> None:
+    global g_sessionManager
+
+    assert g_logger is not None
+
+    g_sessionManager = SessionManager(g_outputDir, g_logger.getEffectiveLevel())
+    g_sessionManager.start()
+
+    uiUpdateMultiServerStatus()
+
 def uiToggleElements(flag: bool) -> None:
     assert g_tkRoot is not None
     assert g_tkChooseDirButton is not None
     assert g_tkServerButton is not None
     assert g_tkCanvas is not None
     assert g_tkVerboseCheckbox is not None
+    assert g_tkMultiCheckbox is not None
 
     if flag:
         g_tkRoot.protocol('WM_DELETE_WINDOW', uiHandleExitProtocol)
@@ -1214,6 +3503,7 @@ def uiToggleElements(flag: bool) -> None:
         g_tkCanvas.itemconfigure(g_tkTipMessage, state='hidden', text='')
 
         g_tkVerboseCheckbox.configure(state='normal')
+        g_tkMultiCheckbox.configure(state='normal')
     else:
         assert g_tkScrolledTextLog is not None
 
@@ -1228,6 +3518,7 @@ def uiToggleElements(flag: bool) -> None:
         g_tkScrolledTextLog.configure(state='disabled')
 
         g_tkVerboseCheckbox.configure(state='disabled')
+        g_tkMultiCheckbox.configure(state='disabled')
 
 def uiChooseDirectory() -> None:
     dir = filedialog.askdirectory(parent=g_tkRoot, title='Select an output directory', initialdir=INITIAL_DIR, mustexist=True)
@@ -1257,8 +3548,8 @@ def uiHandleVerboseCheckbox() -> None:
     g_logger.setLevel(g_logLevelIntVar.get())
 
 def uiInitialize() -> None:
-    global SCALE, g_logLevelIntVar
-    global g_tkRoot, g_tkCanvas, g_tkDirText, g_tkChooseDirButton, g_tkServerButton, g_tkTipMessage, g_tkScrolledTextLog, g_tkVerboseCheckbox
+    global SCALE, g_logLevelIntVar, g_multiIntVar
+    global g_tkRoot, g_tkCanvas, g_tkDirText, g_tkChooseDirButton, g_tkServerButton, g_tkTipMessage, g_tkScrolledTextLog, g_tkVerboseCheckbox, g_tkMultiCheckbox
     global g_stopEvent, g_tlb, g_taskbar, g_progressBarWindow
 
     # Setup thread event.
@@ -1375,6 +3666,10 @@ def uiInitialize() -> None:
     g_tkVerboseCheckbox = tk.Checkbutton(g_tkRoot, text='Verbose output', variable=g_logLevelIntVar, onvalue=logging.DEBUG, offvalue=logging.INFO, command=uiHandleVerboseCheckbox)
     g_tkCanvas.create_window(uiScaleMeasure(WINDOW_WIDTH - 55), uiScaleMeasure(WINDOW_HEIGHT - 10), window=g_tkVerboseCheckbox, anchor=tk.CENTER)
 
+    g_multiIntVar = tk.IntVar(value=int(g_multiMode))
+    g_tkMultiCheckbox = tk.Checkbutton(g_tkRoot, text='Multiple consoles', variable=g_multiIntVar, onvalue=1, offvalue=0)
+    g_tkCanvas.create_window(uiScaleMeasure(WINDOW_WIDTH - 170), uiScaleMeasure(WINDOW_HEIGHT - 10), window=g_tkMultiCheckbox, anchor=tk.CENTER)
+
     # Initialize console logger.
     console = LogConsole(g_tkScrolledTextLog)
 
@@ -1386,7 +3681,39 @@ def uiInitialize() -> None:
     g_tkRoot.lift()
     g_tkRoot.mainloop()
 
-def cliInitialize() -> None:
+def daemonStartMetricsServer(addr: str, port: int) -> bool:
+    global g_metrics
+
+    assert g_logger is not None
+
+    g_metrics = DaemonMetrics()
+    if not port:
+        return True
+
+    try:
+        server = ThreadingHTTPServer((addr, port), MetricsRequestHandler)
+        server.daemon_threads = True
+    except:
+        utilsLogException(traceback.format_exc())
+        g_logger.error(f'Failed to start metrics endpoint at {addr}:{port}!')
+        return False
+
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    # Sample transfer rates at a fixed interval.
+    def sample_metrics() -> None:
+        assert g_metrics is not None
+        while True:
+            time.sleep(DAEMON_SAMPLE_INTERVAL)
+            g_metrics.sample()
+
+    threading.Thread(target=sample_metrics, daemon=True).start()
+
+    g_logger.info(f'Metrics endpoint available at http://{addr}:{port}/metrics.')
+
+    return True
+
+def cliInitialize(metrics_addr: str = DAEMON_METRICS_ADDR, metrics_port: int = DAEMON_METRICS_PORT) -> None:
     global g_progressBarWindow, g_outputDir
 
     assert g_logger is not None
@@ -1394,9 +3721,12 @@ def cliInitialize() -> None:
     # Initialize console logger.
     console = LogConsole()
 
-    # Initialize progress bar window object.
-    bar_format = '{percentage:.2f}% |{bar}| {n:.2f}/{total:.2f} {unit} [{elapsed}<{remaining}, __custom_rate_fmt__]'
-    g_progressBarWindow = ProgressBarWindow(bar_format)
+    # Initialize progress bar window object. Nothing is displayed under daemon mode.
+    if g_daemonMode:
+        g_progressBarWindow = DaemonProgressReporter()
+    else:
+        bar_format = '{percentage:.2f}% |{bar}| {n:.2f}/{total:.2f} {unit} [{elapsed}<{remaining}, __custom_rate_fmt__]'
+        g_progressBarWindow = ProgressBarWindow(bar_format)
 
     # Print info.
     g_logger.info(f'\n{SCRIPT_TITLE}. {COPYRIGHT_TEXT}.')
@@ -1406,11 +3736,36 @@ def cliInitialize() -> None:
     if g_isWindows:
         g_outputDir = '\\\\?\\' + g_outputDir
 
-    # Start USB command handler directly.
-    usbCommandHandler()
+    # Start the metrics endpoint under daemon mode. Errors are counted by the multi-console server itself if it's used.
+    if g_daemonMode:
+        if not daemonStartMetricsServer(metrics_addr, metrics_port):
+            return
+
+        if not g_multiMode:
+            g_logger.addHandler(MetricsLogHandler())
+
+    # Start the multi-console server, if needed. It runs until the script is interrupted.
+    if g_multiMode:
+        session_manager = SessionManager(g_outputDir, g_logger.getEffectiveLevel())
+        session_manager.start()
+
+        try:
+            session_manager.wait()
+        finally:
+            session_manager.stop()
+
+        return
+
+    # Start USB command handler directly. Under daemon mode, we keep serving new sessions until the script is interrupted.
+    while True:
+        usbCommandHandler()
+        if not g_daemonMode:
+            break
+
+        time.sleep(DAEMON_SAMPLE_INTERVAL)
 
 def main() -> int:
-    global g_cliMode, g_outputDir, g_osType, g_osVersion, g_isWindows, g_isWindowsVista, g_isWindows7, g_logger
+    global g_cliMode, g_multiMode, g_daemonMode, g_outputDir, g_osType, g_osVersion, g_isWindows, g_isWindowsVista, g_isWindows7, g_logger
 
     # Disable warnings.
     warnings.filterwarnings("ignore")
@@ -1419,11 +3774,24 @@ def main() -> int:
     parser = ArgumentParser(description=f'{SCRIPT_TITLE}. {COPYRIGHT_TEXT}.')
     parser.add_argument('-c', '--cli', required=False, action='store_true', default=False, help='Start the script in CLI mode.')
     parser.add_argument('-o', '--outdir', required=False, type=str, metavar='DIR', help=f'Path to output directory. Defaults to "{DEFAULT_DIR}".')
+    parser.add_argument('-m', '--multi', required=False, action='store_true', default=False, help='Serve all connected consoles at the same time. Each one gets its own session and output subdirectory.')
+    parser.add_argument('--daemon', required=False, action='store_true', default=False, help='Start the script in headless daemon mode. Implies --cli. No progress bars are displayed, ' \
+                        'new sessions are served until the script is interrupted and transfer metrics are exposed through a local HTTP endpoint.')
+    parser.add_argument('--metrics-addr', required=False, type=str, metavar='ADDR', default=DAEMON_METRICS_ADDR, help=f'Daemon mode metrics endpoint address. Defaults to "{DAEMON_METRICS_ADDR}".')
+    parser.add_argument('--metrics-port', required=False, type=int, metavar='PORT', default=DAEMON_METRICS_PORT, help=f'Daemon mode metrics endpoint port. Defaults to {DAEMON_METRICS_PORT}. Use 0 to disable it.')
     parser.add_argument('-v', '--verbose', required=False, action='store_true', default=False, help='Enable verbose output.')
+    parser.add_argument('-d', '--decompress', required=False, type=str, metavar='FILE', help=f'Decompress a "{NXZ_FILE_EXTENSION}" file (or split directory) generated by {USB_DEV_PRODUCT}, then exit.')
+    parser.add_argument('--output', required=False, type=str, metavar='FILE', help=f'Output path for the decompressed file. Defaults to the input path without the "{NXZ_FILE_EXTENSION}" extension.')
     args = parser.parse_args()
 
+    # Decompress the provided file right away, if needed.
+    if args.decompress:
+        return utilsDecompressNxzFile(args.decompress, args.output)
+
     # Update global flags.
-    g_cliMode = args.cli
+    g_daemonMode = args.daemon
+    g_cliMode = (args.cli or g_daemonMode)
+    g_multiMode = args.multi
     g_outputDir = utilsGetPath(args.outdir, DEFAULT_DIR, False, True)
 
     # Get OS information.
@@ -1451,7 +3819,7 @@ def main() -> int:
 
     if g_cliMode:
         # Initialize CLI.
-        cliInitialize()
+        cliInitialize(args.metrics_addr, args.metrics_port)
     else:
         # Initialize UI.
         uiInitialize()
@@ -38,6 +38,19 @@ void aes128EcbCrypt(void *dst, const void *src, const void *key, bool encrypt);
 /// 'dst' and 'src' can both point to the same address.
 size_t aes128XtsNintendoCrypt(Aes128XtsContext *ctx, void *dst, const void *src, size_t size, u64 sector, size_t sector_size, bool encrypt);
 
+/// Buffers smaller than this are always processed by aes128CtrCryptParallel() using a single core.
+#define AES_CTR_PARALLEL_MIN_SIZE   0x40000 /* 256 KiB. */
+
+/// Resets the counter from the provided Aes128CtrContext element to 'ctr', then performs an AES-128-CTR crypto operation on a big buffer using multiple cores.
+/// The buffer is split into AES-block-aligned chunks, each one with its own counter, which are processed by worker threads placed on every core but the caller's own one.
+/// The context is left in the same state a single aes128CtrCrypt() call would leave it in. Falls back to aes128CtrCrypt() if the buffer is smaller than AES_CTR_PARALLEL_MIN_SIZE,
+/// or if another thread is already using the worker threads. Worker threads are created on first use.
+/// 'dst' and 'src' can both point to the same address.
+void aes128CtrCryptParallel(Aes128CtrContext *ctx, const u8 *ctr, void *dst, const void *src, size_t size);
+
+/// Stops the worker threads used by aes128CtrCryptParallel(). Called by utilsCloseResources().
+void aes128CtrParallelExit(void);
+
 /// Initializes an output AES partial counter using an initial CTR value and an offset.
 /// The sizes for 'out' and 'ctr' should be at least AES_BLOCK_SIZE and 8 bytes, respectively.
 NX_INLINE void aes128CtrInitializePartialCtr(u8 *out, const u8 *ctr, u64 offset)
@@ -0,0 +1,114 @@
+/*
+ * async_io.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#ifndef __ASYNC_IO_H__
+#define __ASYNC_IO_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ASYNC_IO_WORKER_COUNT   4   ///< Number of threads within the shared I/O thread pool. Also the highest queue depth that can be set for a backend.
+
+/// Storage backends supported by the async I/O interface. Each one has its own queue depth, which caps the number of its requests being serviced at the same time.
+typedef enum {
+    AsyncIoBackend_GameCard            = 0, ///< gamecardReadStorage(). 'ctx' is ignored. Default queue depth: 1 (gamecard reads are serialized anyway).
+    AsyncIoBackend_NcaContent          = 1, ///< ncaReadContentFile(). 'ctx' must point to an NcaContext. Default queue depth: 2.
+    AsyncIoBackend_BucketTree          = 2, ///< bktrReadStorage(). 'ctx' must point to a BucketTreeContext. Default queue depth: 2.
+    AsyncIoBackend_SaveAllocationTable = 3, ///< save_allocation_table_storage_read(). 'ctx' must point to an allocation_table_storage_ctx_t. Default queue depth: 1.
+    AsyncIoBackend_Custom              = 4, ///< 'custom_read' is called with 'ctx'. Default queue depth: 2.
+    AsyncIoBackend_Count               = 5  ///< Total values supported by this enum.
+} AsyncIoBackend;
+
+/// Read function used by AsyncIoBackend_Custom requests. Must be safe to call from multiple threads at once if the backend queue depth is greater than 1.
+typedef bool (*AsyncIoReadFunction)(void *ctx, void *out, u64 read_size, u64 offset);
+
+struct AsyncIoRequest;
+struct AsyncIoQueue;
+
+/// Completion callback. Called from an I/O worker thread right after the read is done, before the request is posted to its completion queue.
+/// Must not block, since it keeps the worker thread from servicing other requests.
+typedef void (*AsyncIoCallback)(struct AsyncIoRequest *request, void *user_data);
+
+/// Async read request. Must be filled by the caller, and it must remain valid until it's retrieved from its completion queue.
+typedef struct AsyncIoRequest {
+    u8 backend;                         ///< AsyncIoBackend.
+    void *ctx;                          ///< Backend context. See AsyncIoBackend.
+    AsyncIoReadFunction custom_read;    ///< Only used by AsyncIoBackend_Custom requests.
+    void *out;                          ///< Output buffer. Must be at least 'read_size' bytes long.
+    u64 read_size;
+    u64 offset;
+    AsyncIoCallback callback;           ///< Optional.
+    void *user_data;                    ///< Passed to 'callback'.
+
+    bool success;                       ///< Set by the async I/O interface once the request is complete.
+    struct AsyncIoQueue *queue;         ///< Set by the async I/O interface.
+    struct AsyncIoRequest *next;        ///< Set by the async I/O interface.
+} AsyncIoRequest;
+
+/// Completion queue. Requests submitted through the same queue can complete out of order, since they may be serviced by different worker threads.
+/// Each request is posted to the queue it was submitted with once it's complete, regardless of its result.
+typedef struct AsyncIoQueue {
+    Mutex mutex;
+    CondVar cond;
+    u32 pending_count;                  ///< Submitted requests that haven't been retrieved yet.
+    AsyncIoRequest *completed_head;
+    AsyncIoRequest *completed_tail;
+} AsyncIoQueue;
+
+/// Initializes the provided completion queue.
+void asyncIoInitializeQueue(AsyncIoQueue *queue);
+
+/// Submits a read request. The shared I/O thread pool is started on first use.
+/// Requests are serviced in submission order, unless their backend has already hit its queue depth. Returns false if the request is invalid.
+bool asyncIoSubmit(AsyncIoQueue *queue, AsyncIoRequest *request);
+
+/// Blocks until a request submitted through the provided queue is complete, then returns it.
+/// Returns NULL if there are no pending requests left within the queue.
+AsyncIoRequest *asyncIoWaitCompletion(AsyncIoQueue *queue);
+
+/// Same as asyncIoWaitCompletion(), but returns NULL right away if no request has been completed yet.
+AsyncIoRequest *asyncIoPollCompletion(AsyncIoQueue *queue);
+
+/// Waits until all pending requests from the provided queue are complete, then discards them.
+/// Must be called before freeing any output buffers used by requests that may still be in flight (e.g. on error paths).
+void asyncIoDrainQueue(AsyncIoQueue *queue);
+
+/// Sets the queue depth for the provided backend. Values are clamped to the [1, ASYNC_IO_WORKER_COUNT] range.
+void asyncIoSetQueueDepth(u8 backend, u32 depth);
+
+/// Returns the queue depth for the provided backend, or zero if an invalid backend is provided.
+u32 asyncIoGetQueueDepth(u8 backend);
+
+/// Stops the shared I/O thread pool. Requests that haven't been serviced yet are completed with 'success' set to false.
+/// Must be called before deinitializing any of the interfaces used by the supported backends.
+void asyncIoExit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ASYNC_IO_H__ */
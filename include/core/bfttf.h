@@ -47,13 +47,14 @@ typedef struct {
     void *address;  ///< Font data address.
 } BfttfFontData;
 
-/// Initializes the BFTTF interface.
+/// Initializes the BFTTF interface. Font data isn't loaded at this point.
 bool bfttfInitialize(void);
 
 /// Closes the BFTTF interface.
 void bfttfExit(void);
 
 /// Returns a specific BFTTF font using the provided BfttfFontType.
+/// Font data is loaded and decoded the first time each font is requested, then cached until bfttfExit() is called.
 bool bfttfGetFontByType(BfttfFontData *font, u8 font_type);
 
 #ifdef __cplusplus
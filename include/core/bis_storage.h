@@ -28,6 +28,15 @@
 extern "C" {
 #endif
 
+/// Holds the cluster allocation status from a mounted eMMC BIS partition. Generated by bisStorageGetClusterBitmap().
+typedef struct {
+    u64 data_offset;        ///< BIS storage offset for the first cluster from the data area.
+    u64 cluster_size;       ///< Cluster size, in bytes.
+    u32 cluster_count;      ///< Number of clusters within the data area.
+    u32 allocated_count;    ///< Number of allocated clusters.
+    u8 *bitmap;             ///< Dynamically allocated. One bit per cluster, LSB first. Set bits represent allocated clusters.
+} BisStorageClusterBitmap;
+
 /// Mounts the eMMC partitions with IDs `CalibrationFile` (28) through `System` (31) and makes it possible to perform read-only FS operations with them.
 /// The mount name for each partition can be retrieved via bisStorageGetMountNameByBisPartitionId().
 bool bisStorageInitialize(void);
@@ -51,9 +60,39 @@ const char *bisStorageGetSystemInitializerPartitionNameByBisPartitionId(u8 bis_p
 /// Returns NULL if the eMMC BIS storage interface hasn't been initialized yet, or if an unsupported eMMC BIS partition ID is provided.
 const char *bisStorageGetMountNameByBisPartitionId(u8 bis_partition_id);
 
-/// Returns a pointer to a FsStorage object that matches the provided FatFs drive number, or NULL if it hasn't been mounted.
+/// Reads data from the BIS storage that matches the provided FatFs drive number. Returns false if it hasn't been mounted, or if a read error occurs.
+/// Partial block reads are served through a small per-partition LRU block cache, which also reads ahead the rest of each block. Whole blocks are read directly.
 /// Only used by FatFs's diskio operations.
-FsStorage *bisStorageGetFsStorageByFatFsDriveNumber(u8 drive_number);
+bool bisStorageReadFatFsDrive(u8 drive_number, void *out, u64 offset, u64 size);
+
+/// Retrieves the raw storage size from the provided eMMC BIS partition ID.
+/// Only eMMC BIS partition IDs `CalibrationFile` (28) through `System` (31) are supported.
+bool bisStorageGetPartitionSize(u8 bis_partition_id, u64 *out_size);
+
+/// Reads raw data from the provided eMMC BIS partition ID. Data returned by the FS sysmodule is already decrypted.
+/// Unlike bisStorageReadFatFsDrive(), this never goes through the block cache. Meant to be used with large sequential reads (e.g. partition dumps).
+/// Only eMMC BIS partition IDs `CalibrationFile` (28) through `System` (31) are supported.
+bool bisStorageReadPartition(u8 bis_partition_id, void *out, u64 offset, u64 size);
+
+/// Generates a cluster allocation bitmap for the provided eMMC BIS partition ID, using its FAT (FAT16 / FAT32) or its allocation bitmap (exFAT).
+/// FAT12 partitions are reported as fully allocated.
+/// Only eMMC BIS partition IDs `CalibrationFile` (28) through `System` (31) are supported.
+/// The generated bitmap must be freed with bisStorageFreeClusterBitmap() once it's no longer needed.
+bool bisStorageGetClusterBitmap(u8 bis_partition_id, BisStorageClusterBitmap *out);
+
+/// Frees a BisStorageClusterBitmap element.
+NX_INLINE void bisStorageFreeClusterBitmap(BisStorageClusterBitmap *bitmap)
+{
+    if (!bitmap) return;
+    if (bitmap->bitmap) free(bitmap->bitmap);
+    memset(bitmap, 0, sizeof(BisStorageClusterBitmap));
+}
+
+/// Returns true if the provided cluster index (relative to the start of the data area) is allocated.
+NX_INLINE bool bisStorageIsClusterAllocated(const BisStorageClusterBitmap *bitmap, u32 cluster_idx)
+{
+    return (bitmap && bitmap->bitmap && cluster_idx < bitmap->cluster_count && (bitmap->bitmap[cluster_idx >> 3] & (1U << (cluster_idx & 7))));
+}
 
 /// (Un)locks the BIS storage mutex. Can be used to block other threads and prevent them from altering the internal status of this interface.
 /// Use with caution.
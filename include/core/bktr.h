@@ -50,6 +50,16 @@ extern "C" {
 
 #define BKTR_MAX_SUBSTORAGE_COUNT           2
 
+#define BKTR_CURSOR_MAX_MOVE_COUNT          8                           /* Maximum number of entries the storage cursor may be moved forward before falling back to a tree lookup. */
+
+#define BKTR_FLAT_INDEX_BLOCK_SIZE          16                          /* Number of virtual offsets per flat index block. Must be a multiple of 2. */
+
+#define BKTR_AES_CTR_EX_RANGE_BATCH_COUNT   64                          /* Maximum number of AesCtrEx sub-ranges handled by a single NCA read. */
+
+#define BKTR_LZ4_CACHE_ENTRY_COUNT          4
+#define BKTR_LZ4_CACHE_MAX_DATA_SIZE        0x40000                     /* 256 KiB. LZ4 entries with a bigger decompressed size bypass the cache. */
+#define BKTR_LZ4_CACHE_BUFFER_SIZE          LZ4_DECOMPRESS_INPLACE_BUFFER_SIZE(BKTR_LZ4_CACHE_MAX_DATA_SIZE)
+
 /// Used as the header for both BucketTreeOffsetNode and BucketTreeEntryNode.
 typedef struct {
     u32 index;  ///< BucketTreeOffsetNode / BucketTreeEntryNode index.
@@ -162,9 +172,59 @@ typedef enum {
     BucketTreeSubStorageType_Count      = 4     ///< Total values supported by this enum.
 } BucketTreeSubStorageType;
 
+/// Holds a decompressed LZ4 entry from a Compressed storage.
+typedef struct {
+    u8 *buffer;             ///< Buffer with size BKTR_LZ4_CACHE_BUFFER_SIZE, leased from the shared buffer pool on first use, then reused by subsequent entries.
+    u64 virtual_offset;     ///< Virtual offset of the cached entry.
+    u64 size;               ///< Decompressed size of the cached entry. Set to zero if this cache slot holds no valid data.
+    u64 last_used;          ///< Value from the LRU counter when this cache slot was last accessed.
+} BucketTreeLz4CacheEntry;
+
+/// Flattened lookup index built from all the entry nodes in a Bucket Tree storage.
+/// Virtual offsets from all entries are stored in a contiguous array, split into BKTR_FLAT_INDEX_BLOCK_SIZE-sized blocks.
+/// Lookups perform a binary search over the first virtual offset from each block, followed by a vectorized search within the selected block.
+typedef struct {
+    u32 entry_count;                ///< Total number of entries.
+    u32 block_count;                ///< Total number of blocks.
+    u64 *offsets;                   ///< Virtual offsets from all entries. Padded with UINT64_MAX up to (block_count * BKTR_FLAT_INDEX_BLOCK_SIZE) elements.
+    u64 *block_offsets;             ///< First virtual offset from each block.
+    u32 *entry_set_indices;         ///< Entry node index for each entry.
+    u32 *entry_set_first_indices;   ///< Index of the first entry from each entry node, relative to the start of the 'offsets' array.
+} BucketTreeFlatIndex;
+
 // Forward declaration for BucketTreeSubStorage.
 typedef struct _BucketTreeContext BucketTreeContext;
 
+/// Used to represent a virtual range within a Bucket Tree storage.
+typedef struct {
+    u64 offset;
+    u64 size;
+} BucketTreeVirtualRange;
+
+/// Entry node header used by BucketTreeVisitor. Mirrors the first bytes from a BucketTreeEntryNode.
+typedef struct {
+    BucketTreeNodeHeader header;
+    u64 start;
+} BucketTreeEntrySetHeader;
+
+NXDT_ASSERT(BucketTreeEntrySetHeader, BKTR_NODE_HEADER_SIZE + 0x8);
+
+/// Used to iterate through the entries from a Bucket Tree storage.
+typedef struct {
+    BucketTreeContext *bktr_ctx;
+    BucketTreeEntrySetHeader entry_set;
+    u32 entry_index;
+    void *entry;
+} BucketTreeVisitor;
+
+/// Keeps track of the Bucket Tree storage entry used by the last read operation, in order to avoid performing a full tree lookup on each sequential read.
+typedef struct {
+    bool valid;                     ///< Set to true if this cursor holds a valid visitor.
+    BucketTreeVisitor visitor;      ///< Visitor pointing to the last used entry.
+    u64 entry_offset;               ///< Virtual offset from the last used entry.
+    u64 next_entry_offset;          ///< Virtual offset from the entry that follows the last used entry (or the storage end offset, if there's none).
+} BucketTreeCursor;
+
 typedef struct {
     u8 index;                           ///< Substorage index.
     NcaFsSectionContext *nca_fs_ctx;    ///< NCA FS section context. Used to perform operations on the target NCA.
@@ -185,6 +245,12 @@ struct _BucketTreeContext {
     u64 start_offset;                                               ///< Virtual storage start offset.
     u64 end_offset;                                                 ///< Virtual storage end offset.
     BucketTreeSubStorage substorages[BKTR_MAX_SUBSTORAGE_COUNT];    ///< Substorages required for this BucketTree storage. May be set after initializing this context.
+    BucketTreeFlatIndex flat_index;                                 ///< Flattened lookup index. Built while initializing this context. Storage lookups fall back to the tree if it's unavailable.
+    Mutex cursor_mutex;                                             ///< Used to lock access to the storage cursor.
+    BucketTreeCursor cursor;                                        ///< Storage cursor. Updated by bktrReadStorage().
+    Mutex lz4_cache_mutex;                                          ///< Used to lock access to the LZ4 cache. Only used by BucketTreeStorageType_Compressed.
+    u64 lz4_cache_counter;                                          ///< LRU counter for the LZ4 cache.
+    BucketTreeLz4CacheEntry lz4_cache[BKTR_LZ4_CACHE_ENTRY_COUNT];  ///< Decompressed LZ4 entry cache. Only used by BucketTreeStorageType_Compressed.
 };
 
 /// Initializes a Bucket Tree context using the provided NCA FS section context and a storage type.
@@ -210,12 +276,55 @@ bool bktrReadStorage(BucketTreeContext *ctx, void *out, u64 read_size, u64 offse
 /// The storage type from the provided BucketTreeContext may only be BucketTreeStorageType_Indirect or BucketTreeStorageType_Compressed (with an underlying Indirect substorage).
 bool bktrIsBlockWithinIndirectStorageRange(BucketTreeContext *ctx, u64 offset, u64 size, bool *out);
 
+/// Translates a virtual offset from the provided BucketTreeContext into an effective physical offset, going through all the underlying Bucket Tree substorages.
+/// 'out_storage_index' is set to the BucketTreeIndirectStorageIndex value from the last Indirect / Sparse Storage entry that was processed (BucketTreeIndirectStorageIndex_Original if there were none).
+/// The storage type from the provided BucketTreeContext may only be BucketTreeStorageType_Indirect, BucketTreeStorageType_Sparse or BucketTreeStorageType_Compressed.
+/// Useful to sort read operations by their physical location.
+bool bktrGetPhysicalOffset(BucketTreeContext *ctx, u64 virtual_offset, u64 *out_offset, u8 *out_storage_index);
+
+/// Retrieves a sorted array of non-overlapping virtual ranges backed by the Patch storage index from the provided BucketTreeContext's Indirect Storage.
+/// Adjacent ranges are merged. The results match the ones from bktrIsBlockWithinIndirectStorageRange(), but they can be looked up without walking the tree.
+/// The storage type from the provided BucketTreeContext may only be BucketTreeStorageType_Indirect or BucketTreeStorageType_Compressed (with an underlying Indirect substorage).
+/// The returned pointer must be freed by the caller. 'out_count' may be set to zero (with a NULL 'out_ranges') if there are no Patch-backed ranges.
+bool bktrGetPatchStorageRanges(BucketTreeContext *ctx, BucketTreeVirtualRange **out_ranges, u32 *out_count);
+
+/// Retrieves a sorted array of non-overlapping virtual ranges from the provided BucketTreeContext that are always read back as zeroes, without touching any substorage.
+/// Sparse: ranges backed by the ZeroStorage (storage index 1). Compressed: ranges from Zero entries.
+/// Adjacent ranges are merged. The storage type from the provided BucketTreeContext may only be BucketTreeStorageType_Sparse or BucketTreeStorageType_Compressed.
+/// The returned pointer must be freed by the caller. 'out_count' may be set to zero (with a NULL 'out_ranges') if there are no zero-filled ranges.
+bool bktrGetZeroFilledRanges(BucketTreeContext *ctx, BucketTreeVirtualRange **out_ranges, u32 *out_count);
+
+/// Appends extents to the provided StorageExtentList describing where the provided virtual range from a Bucket Tree storage actually lives, going through all the underlying substorages.
+/// Extent offsets are relative to the start of the Bucket Tree storage. Data extents from Indirect storages may point to the base NCA.
+/// Nothing is read besides the Bucket Tree tables, which are already loaded in memory.
+bool bktrQueryStorageExtents(BucketTreeContext *ctx, StorageExtentList *out, u64 size, u64 offset);
+
 /// Helper inline functions.
 
+/// Invalidates the storage cursor from the provided BucketTreeContext, forcing the next read operation to perform a full tree lookup.
+NX_INLINE void bktrInvalidateCursor(BucketTreeContext *ctx)
+{
+    if (!ctx) return;
+    mutexLock(&(ctx->cursor_mutex));
+    ctx->cursor.valid = false;
+    mutexUnlock(&(ctx->cursor_mutex));
+}
+
 NX_INLINE void bktrFreeContext(BucketTreeContext *ctx)
 {
     if (!ctx) return;
     if (ctx->storage_table) free(ctx->storage_table);
+
+    if (ctx->flat_index.offsets) free(ctx->flat_index.offsets);
+    if (ctx->flat_index.block_offsets) free(ctx->flat_index.block_offsets);
+    if (ctx->flat_index.entry_set_indices) free(ctx->flat_index.entry_set_indices);
+    if (ctx->flat_index.entry_set_first_indices) free(ctx->flat_index.entry_set_first_indices);
+
+    for(u8 i = 0; i < BKTR_LZ4_CACHE_ENTRY_COUNT; i++)
+    {
+        if (ctx->lz4_cache[i].buffer) bufferPoolReturn(ctx->lz4_cache[i].buffer);
+    }
+
     memset(ctx, 0, sizeof(BucketTreeContext));
 }
 
@@ -235,6 +344,48 @@ NX_INLINE bool bktrIsBlockWithinStorageRange(BucketTreeContext *ctx, u64 size, u
     return (bktrIsValidContext(ctx) && size > 0 && ctx->start_offset <= offset && size <= (ctx->end_offset - offset));
 }
 
+/// Returns the index of the first range from the provided sorted, non-overlapping virtual ranges that ends past the provided offset, using a binary search.
+/// Returns 'range_count' if there are no such ranges.
+NX_INLINE u32 bktrFindVirtualRangeIndex(const BucketTreeVirtualRange *ranges, u32 range_count, u64 offset)
+{
+    u32 low = 0, high = range_count;
+
+    while(low < high)
+    {
+        u32 mid = (low + ((high - low) / 2));
+
+        if ((ranges[mid].offset + ranges[mid].size) <= offset)
+        {
+            low = (mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/// Checks if the provided block extents overlap with any of the provided sorted, non-overlapping virtual ranges, using a binary search.
+NX_INLINE bool bktrIsBlockWithinVirtualRanges(const BucketTreeVirtualRange *ranges, u32 range_count, u64 offset, u64 size)
+{
+    if (!ranges || !range_count || !size) return false;
+
+    u32 idx = bktrFindVirtualRangeIndex(ranges, range_count, offset);
+
+    return (idx < range_count && ranges[idx].offset < (offset + size));
+}
+
+/// Checks if the provided block extents are fully contained within a single range from the provided sorted, non-overlapping virtual ranges, using a binary search.
+/// Adjacent ranges must have been merged beforehand.
+NX_INLINE bool bktrIsBlockContainedInVirtualRanges(const BucketTreeVirtualRange *ranges, u32 range_count, u64 offset, u64 size)
+{
+    if (!ranges || !range_count || !size) return false;
+
+    u32 idx = bktrFindVirtualRangeIndex(ranges, range_count, offset);
+
+    return (idx < range_count && ranges[idx].offset <= offset && (offset + size) <= (ranges[idx].offset + ranges[idx].size));
+}
+
 NX_INLINE bool bktrIsValidSubStorage(BucketTreeSubStorage *substorage)
 {
     return (substorage && substorage->index < BKTR_MAX_SUBSTORAGE_COUNT && substorage->nca_fs_ctx && substorage->type < BucketTreeSubStorageType_Count && \
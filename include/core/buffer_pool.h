@@ -0,0 +1,74 @@
+/*
+ * buffer_pool.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUFFER_POOL_ALIGNMENT   0x1000  ///< All leased buffers are page aligned, which makes them suitable for USB transfers.
+
+/// Buffer pool statistics.
+typedef struct {
+    u64 in_flight_size; ///< Total size of all leased buffers.
+    u64 peak_size;      ///< Highest in-flight size reached so far.
+    u64 cached_size;    ///< Total size of all idle buffers kept around for reuse.
+    u64 max_size;       ///< In-flight size cap, determined by the memory budget.
+    u32 lease_count;    ///< Number of leased buffers.
+} BufferPoolStats;
+
+/// Leases a page-aligned buffer with at least 'size' bytes from the shared buffer pool. Buffer contents are undefined.
+/// Requested sizes are rounded up to 64 KiB size classes. Idle buffers from the same size class (or a slightly bigger one) are reused before allocating new ones.
+/// If the in-flight size cap is hit, or if memory allocation fails:
+///     - 'wait' set to true: blocks until another short-lived lease is returned. If there are none, the cap is ignored and NULL is only returned if memory allocation fails.
+///     - 'wait' set to false: returns NULL right away, which lets callers degrade gracefully (e.g. by using fewer buffers).
+/// Leases requested with 'wait' set to true must always be short-lived (e.g. returned before the current read operation finishes), and they must never be nested.
+/// The returned buffer must be handed back with bufferPoolReturn(). It must never be freed directly.
+void *bufferPoolLease(size_t size, bool wait);
+
+/// Same as bufferPoolLease(), but the actual buffer size is saved to 'out_size' (if provided).
+void *bufferPoolLeaseWithSize(size_t size, bool wait, size_t *out_size);
+
+/// Hands a buffer leased with bufferPoolLease() back to the shared buffer pool. Passing NULL is a no-op.
+/// The buffer is kept around for reuse if there's room for it within the idle buffer cache. Otherwise, it's freed right away.
+void bufferPoolReturn(void *buf);
+
+/// Frees all idle buffers from the shared buffer pool. Leased buffers are left untouched.
+void bufferPoolTrim(void);
+
+/// Fills the provided BufferPoolStats element.
+void bufferPoolGetStats(BufferPoolStats *out_stats);
+
+/// Frees all idle buffers and logs a warning for each buffer that was never returned.
+/// Must only be called once all modules that lease buffers have been deinitialized.
+void bufferPoolExit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BUFFER_POOL_H__ */
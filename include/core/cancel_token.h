@@ -0,0 +1,76 @@
+/*
+ * cancel_token.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __CANCEL_TOKEN_H__
+#define __CANCEL_TOKEN_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CANCEL_TOKEN_CHUNK_SIZE     0x200000    ///< Maximum amount of data read by core storage loops between two cancellation checks while a token is bound. Keeps cancel latency well below 100 ms.
+
+/// Binds a cancellation token to the calling thread until the end of the current scope. The previously bound token is restored afterwards, which makes nested scopes safe.
+/// Should be placed at the very top of a block, before any goto statements that could jump past it.
+#define CANCEL_TOKEN_SCOPE(token)   CancelToken *ANONYMOUS_VARIABLE(cancel_token_prev_) CLEANUP(cancelTokenRestoreCurrent) = cancelTokenBindCurrent(token)
+
+/// Cancellation token. May be cancelled from any thread.
+/// Core read loops (NCA content reads, BucketTree / RomFS storage reads and title storage scans) check the token bound to the calling thread at chunk boundaries,
+/// and fail right away once it has been cancelled. This keeps the core API intact: long operations are cancelled by binding a token before calling them.
+/// Threads spawned by core modules don't inherit the token bound to their parent thread, unless the module passes it along using cancelTokenGetCurrent().
+typedef struct {
+    u32 cancelled;  ///< Must only be accessed through the functions below.
+} CancelToken;
+
+/// Clears the cancel flag from the provided token.
+void cancelTokenReset(CancelToken *token);
+
+/// Cancels the provided token. Does nothing if it has already been cancelled.
+void cancelTokenCancel(CancelToken *token);
+
+/// Returns true if the provided token has been cancelled.
+bool cancelTokenIsCancelled(const CancelToken *token);
+
+/// Binds the provided token to the calling thread and returns the previously bound one. A NULL token may be used to unbind it.
+/// Use CANCEL_TOKEN_SCOPE() instead, unless the binding needs to outlive the current scope.
+CancelToken *cancelTokenBindCurrent(CancelToken *token);
+
+/// Returns the token bound to the calling thread, or NULL if there's none. Core modules use it to bind the same token to their own worker threads.
+CancelToken *cancelTokenGetCurrent(void);
+
+/// Restores a previously bound token. Used by CANCEL_TOKEN_SCOPE().
+void cancelTokenRestoreCurrent(CancelToken **prev_token);
+
+/// Returns true if a token has been bound to the calling thread and it has been cancelled.
+bool cancelTokenIsCurrentCancelled(void);
+
+/// Returns true if a token has been bound to the calling thread. Used by core read loops to decide if long reads should be split at CANCEL_TOKEN_CHUNK_SIZE boundaries.
+bool cancelTokenIsCurrentBound(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CANCEL_TOKEN_H__ */
@@ -156,6 +156,11 @@ u8 *certGenerateRawCertificateChainBySignatureIssuer(const char *issuer, u64 *ou
 /// Returns NULL if an error occurs.
 u8 *certRetrieveRawCertificateChainFromGameCardByRightsId(const FsRightsId *id, u64 *out_size);
 
+/// The ES certificate system savefile is kept open between certificate retrieval calls, and is only reopened after staying idle for a while.
+/// Certificate chains retrieved by signature issuer are also cached for the rest of the session.
+/// This closes the savefile and frees the certificate chain cache. Must be called before the eMMC BIS storage interface is closed.
+void certCloseCachedSaveFile(void);
+
 /// General purpose helper inline functions.
 
 NX_INLINE bool certIsValidPublicKeyType(u32 type)
@@ -47,6 +47,8 @@ void configResetSettings(void);
 
 /// Getters and setters for various data types.
 /// Path elements must be separated using forward slashes.
+/// Values are cached by path on first access, so repeated calls don't need to walk the JSON object.
+/// Changes are batched and written to the SD card by a background thread once no settings have been changed for a short while. configExit() flushes pending changes.
 
 bool configGetBoolean(const char *path);
 void configSetBoolean(const char *path, bool value);
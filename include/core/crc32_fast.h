@@ -0,0 +1,52 @@
+/*
+ * crc32_fast.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#ifndef __CRC32_FAST_H__
+#define __CRC32_FAST_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Calculates a CRC32 checksum over the provided buffer, using the standard CRC32 polynomial.
+/// Large buffers are split into three interleaved lanes processed using ARMv8 CRC32 instructions, which are then merged to produce the final checksum.
+/// Output values are always identical to the ones returned by crc32Calculate().
+u32 crc32FastCalculate(const void *src, size_t size);
+
+/// Same as crc32FastCalculate(), but uses a previously calculated CRC32 checksum as the seed. Useful to process data in consecutive chunks.
+/// Output values are always identical to the ones returned by crc32CalculateWithSeed().
+u32 crc32FastCalculateWithSeed(u32 seed, const void *src, size_t size);
+
+/// Returns the CRC32 checksum of the concatenation of two data blocks, using the CRC32 checksums of both blocks and the length of the second block.
+/// This makes it possible to calculate checksums over large areas in separate chunks (or in a different order) without hashing the same data more than once.
+/// Both checksums must be calculated using the standard CRC32 polynomial (e.g. crc32FastCalculate() / crc32FastCalculateWithSeed()).
+u32 crc32Combine(u32 crc1, u32 crc2, u64 len2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CRC32_FAST_H__ */
@@ -35,6 +35,9 @@ extern "C" {
 
 #define DEVOPTAB_MOUNT_NAME_LENGTH      32  // Including NULL terminator.
 
+#define DEVOPTAB_READ_AHEAD_MIN_SIZE    0x10000     // 64 KiB.
+#define DEVOPTAB_READ_AHEAD_MAX_SIZE    0x100000    // 1 MiB.
+
 #define DEVOPTAB_INIT_ERROR_STATE       r->_errno = 0
 #define DEVOPTAB_DECL_DEV_CTX           DevoptabDeviceContext *dev_ctx = (DevoptabDeviceContext*)r->deviceData
 #define DEVOPTAB_DECL_FS_CTX(type)      type *fs_ctx = (type*)dev_ctx->fs_ctx
@@ -57,9 +60,9 @@ do { \
 #define DEVOPTAB_RETURN_UNSUPPORTED_OP  r->_errno = ENOSYS; \
                                         return -1
 
-#define DEVOPTAB_INIT_VARS              devoptabControlMutex(true); \
-                                        DEVOPTAB_INIT_ERROR_STATE; \
+#define DEVOPTAB_INIT_VARS              DEVOPTAB_INIT_ERROR_STATE; \
                                         DEVOPTAB_DECL_DEV_CTX; \
+                                        devoptabControlDeviceMutex(dev_ctx, true); \
                                         if (!dev_ctx->initialized) DEVOPTAB_SET_ERROR_AND_EXIT(ENODEV)
 
 #define DEVOPTAB_INIT_FILE_VARS(type)   DEVOPTAB_INIT_VARS; \
@@ -69,9 +72,10 @@ do { \
                                         if (!dirState) DEVOPTAB_SET_ERROR_AND_EXIT(EINVAL); \
                                         DEVOPTAB_DECL_DIR_STATE(type)
 
-#define DEVOPTAB_DEINIT_VARS            devoptabControlMutex(false)
+#define DEVOPTAB_DEINIT_VARS            devoptabControlDeviceMutex(dev_ctx, false)
 
 typedef struct {
+    Mutex mutex;                            ///< Device mutex. Serializes filesystem operations on this device only, so other mounted devices can be accessed concurrently.
     bool initialized;                       ///< Device initialization flag.
     char name[DEVOPTAB_MOUNT_NAME_LENGTH];  ///< Mount name string, without a trailing colon (:).
     time_t mount_time;                      ///< Mount time.
@@ -79,6 +83,20 @@ typedef struct {
     void *fs_ctx;                           ///< Pointer to actual type-specific filesystem context (PartitionFileSystemContext, HashFileSystemContext, RomFileSystemContext, FATFS).
 } DevoptabDeviceContext;
 
+/// Callback used by devoptabReadEntryData() to read data from a filesystem entry.
+typedef bool (*DevoptabReadEntryDataFunction)(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
+
+/// Per-file read-ahead buffer used by filesystem-specific devoptab interfaces.
+/// Must be zeroed before being used for the first time, and freed via devoptabFreeReadAheadBuffer() once the file is closed.
+typedef struct {
+    u8 *data;           ///< Dynamically allocated.
+    u64 capacity;       ///< Allocated buffer size.
+    u64 offset;         ///< Buffered data offset, relative to the start of the filesystem entry.
+    u64 size;           ///< Buffered data size.
+    u64 window_size;    ///< Current read-ahead window size. Doubled on each sequential read (up to DEVOPTAB_READ_AHEAD_MAX_SIZE), reset on random access.
+    u64 next_offset;    ///< Offset expected from the next sequential read.
+} DevoptabReadAheadBuffer;
+
 /// Mounts a virtual Partition FS device using the provided Partition FS context and a mount name.
 bool devoptabMountPartitionFileSystemDevice(PartitionFileSystemContext *pfs_ctx, const char *name);
 
@@ -86,6 +104,7 @@ bool devoptabMountPartitionFileSystemDevice(PartitionFileSystemContext *pfs_ctx,
 bool devoptabMountHashFileSystemDevice(HashFileSystemContext *hfs_ctx, const char *name);
 
 /// Mounts a virtual RomFS device using the provided RomFS context and a mount name.
+/// Paged RomFS contexts (see romfsInitializePagedContext()) aren't supported.
 bool devoptabMountRomFileSystemDevice(RomFileSystemContext *romfs_ctx, const char *name);
 
 /// Mounts a virtual FatFs device using the provided FATFS object and a mount name.
@@ -97,8 +116,17 @@ void devoptabUnmountDevice(const char *name);
 /// Unmounts all previously mounted virtual devices.
 void devoptabUnmountAllDevices(void);
 
-/// (Un)locks the devoptab mutex. Used by filesystem-specific devoptab interfaces.
-void devoptabControlMutex(bool lock);
+/// Reads data from a filesystem entry using the provided read-ahead buffer and read callback.
+/// Small reads are served from the read-ahead buffer, which is refilled as needed. Reads that don't fit within the current read-ahead window bypass it.
+/// 'entry_size' is used to clamp read-ahead at the end of the filesystem entry. The requested data must be fully located within it.
+bool devoptabReadEntryData(DevoptabReadAheadBuffer *ra_buf, DevoptabReadEntryDataFunction read_func, void *fs_ctx, void *fs_entry, u64 entry_size, void *out, u64 read_size, u64 offset);
+
+/// Frees a read-ahead buffer.
+void devoptabFreeReadAheadBuffer(DevoptabReadAheadBuffer *ra_buf);
+
+/// (Un)locks the mutex from the provided devoptab device. Used by filesystem-specific devoptab interfaces.
+/// The global devoptab mutex is only used while mounting and unmounting devices.
+void devoptabControlDeviceMutex(DevoptabDeviceContext *dev_ctx, bool lock);
 
 #ifdef __cplusplus
 }
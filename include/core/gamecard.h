@@ -43,6 +43,8 @@ extern "C" {
 
 #define GAMECARD_CERT_OFFSET            0x7000
 
+#define GAMECARD_STAGED_STORAGE_MAX_SIZE    0x1000000                   /* 16 MiB. */
+
 /// Encrypted using AES-128-ECB with the common titlekek generator key (stored in the .rodata segment from the Lotus firmware).
 typedef struct {
     union {
@@ -340,6 +342,20 @@ typedef struct {
 
 NXDT_ASSERT(LotusAsicFirmwareBlob, 0x7800);
 
+/// Read cache statistics. Counters are cumulative, and they're only reset if the read cache is resized.
+typedef struct {
+    u64 cache_size;         ///< Current read cache size. Zero if the read cache is disabled.
+    u64 hit_count;          ///< Number of cache line lookups that were satisfied by the read cache.
+    u64 miss_count;         ///< Number of cache line lookups that required a gamecard read.
+    u64 readahead_count;    ///< Number of additional cache lines fetched after detecting a sequential access pattern.
+} GameCardReadCacheStats;
+
+/// Used with gamecardStageStorage().
+typedef struct {
+    u64 offset; ///< Region offset, relative to the start of the gamecard image.
+    u64 size;   ///< Region size.
+} GameCardStorageRegion;
+
 /// Initializes data needed to access raw gamecard storage areas.
 /// Also spans a background thread to automatically detect gamecard status changes and to cache data from the inserted gamecard.
 bool gamecardInitialize(void);
@@ -352,6 +368,11 @@ void gamecardExit(void);
 /// If the gamecard interface hasn't been initialized, this returns NULL.
 UEvent *gamecardGetStatusChangeUserEvent(void);
 
+/// Returns a user-mode gamecard status update event, which is signaled every time the gamecard status is updated -- including the switch to GameCardStatus_Processing.
+/// Meant to be used by a single UI consumer, since the event returned by gamecardGetStatusChangeUserEvent() is already consumed by the title interface.
+/// If the gamecard interface hasn't been initialized, this returns NULL.
+UEvent *gamecardGetStatusUpdateUserEvent(void);
+
 /// Returns the current GameCardStatus value.
 u8 gamecardGetStatus(void);
 
@@ -372,6 +393,28 @@ bool gamecardGetLotusAsicFirmwareBlob(LotusAsicFirmwareBlob *out_lafw_blob, u64
 /// 'offset' + 'read_size' must not exceed the value returned by gamecardGetTotalSize().
 bool gamecardReadStorage(void *out, u64 read_size, u64 offset);
 
+/// Appends a single extent to the provided StorageExtentList describing the provided range from the inserted gamecard.
+/// Gamecard storage areas are laid out linearly, so offsets from the output extent always match physical gamecard image offsets.
+/// 'offset' + 'size' must not exceed the value returned by gamecardGetTotalSize().
+bool gamecardQueryStorageExtents(StorageExtentList *out, u64 size, u64 offset);
+
+/// Resizes the page-granular read cache used by gamecardReadStorage() to speed up small, scattered reads (e.g. FS headers, Partition FS / RomFS tables, etc.).
+/// The provided size is rounded down to a multiple of the cache line size. Setting it to zero disables the read cache. Statistics are reset by this function.
+/// The read cache is automatically invalidated each time the inserted gamecard changes.
+bool gamecardSetReadCacheSize(u64 size);
+
+/// Fills the provided GameCardReadCacheStats pointer.
+void gamecardGetReadCacheStats(GameCardReadCacheStats *out);
+
+/// Reads the provided gamecard image regions using a single request per region, then keeps their data in memory until gamecardReleaseStagedStorage() is called.
+/// Any gamecard reads fully contained within a staged region are served from memory, which makes it possible to parse lots of small, scattered structures (e.g. Meta NCAs) in a single coalesced pass.
+/// Regions must be sorted by offset and they must not overlap. The total staged size is capped at GAMECARD_STAGED_STORAGE_MAX_SIZE.
+/// Previously staged data is always released by this function. Staged data is also released each time the inserted gamecard changes.
+bool gamecardStageStorage(const GameCardStorageRegion *regions, u32 region_count);
+
+/// Releases all data staged by gamecardStageStorage().
+void gamecardReleaseStagedStorage(void);
+
 /// Fills the provided GameCardHeader pointer.
 /// This area can also be read using gamecardReadStorage(), starting at offset 0.
 bool gamecardGetHeader(GameCardHeader *out);
@@ -386,6 +429,9 @@ bool gamecardGetCertificate(FsGameCardCertificate *out);
 /// Fills the provided u64 pointer with the total gamecard size, which is the size taken by both Normal and Secure storage areas.
 bool gamecardGetTotalSize(u64 *out);
 
+/// Fills the provided u64 pointer with the Normal storage area size. Offsets at or past this value are read from the Secure storage area by gamecardReadStorage().
+bool gamecardGetNormalAreaSize(u64 *out);
+
 /// Fills the provided u64 pointer with the trimmed gamecard size, which is the same as the size returned by gamecardGetTotalSize() but using the trimmed Secure storage area size.
 bool gamecardGetTrimmedSize(u64 *out);
 
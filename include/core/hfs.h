@@ -28,7 +28,9 @@
 extern "C" {
 #endif
 
-#define HFS0_MAGIC  0x48465330  /* "HFS0". */
+#define HFS0_MAGIC              0x48465330  /* "HFS0". */
+
+#define HFS_READ_PLAN_MAX_GAP   0x10000     /* Maximum number of padding bytes between two entries merged into the same read run. */
 
 typedef struct {
     u32 magic;              ///< "HFS0".
@@ -63,14 +65,70 @@ typedef enum {
 /// Internally used by gamecard functions.
 /// Use gamecardGetHashFileSystemContext() to retrieve a Hash FS context.
 typedef struct {
-    u8 type;            ///< HashFileSystemPartitionType.
-    char *name;         ///< Dynamically allocated partition name.
-    u64 offset;         ///< Partition offset (relative to the start of gamecard image).
-    u64 size;           ///< Partition size.
-    u64 header_size;    ///< Full header size.
-    u8 *header;         ///< HashFileSystemHeader + (HashFileSystemEntry * entry_count) + Name Table.
+    u8 type;                    ///< HashFileSystemPartitionType.
+    char *name;                 ///< Dynamically allocated partition name.
+    u64 offset;                 ///< Partition offset (relative to the start of gamecard image).
+    u64 size;                   ///< Partition size.
+    u64 header_size;            ///< Full header size.
+    u8 *header;                 ///< HashFileSystemHeader + (HashFileSystemEntry * entry_count) + Name Table.
+    u32 name_index_capacity;    ///< Name index slot count. Always a power of two.
+    u32 *name_index;            ///< Name -> entry index hash table. Lazily built by hfsGetEntryIndexByName(). Unused slots are set to UINT32_MAX.
 } HashFileSystemContext;
 
+/// Holds information about a single Hash FS entry within a read plan.
+typedef struct {
+    u64 offset;     ///< Entry data offset, relative to the start of the Hash FS.
+    u64 size;       ///< Entry data size.
+    u32 entry_idx;  ///< Hash FS entry index.
+} HashFileSystemReadPlanEntry;
+
+/// Holds information about a contiguous Hash FS data area that covers one or more entries and must be read as a whole.
+typedef struct {
+    u64 offset;         ///< Read offset, relative to the start of the Hash FS. Aligned to GAMECARD_PAGE_SIZE, relative to the start of the gamecard image.
+    u64 size;           ///< Read size. Aligned to GAMECARD_PAGE_SIZE, unless the run reaches the end of the Hash FS partition.
+    u32 entry_start;    ///< Index of the first read plan entry covered by this run.
+    u32 entry_count;    ///< Number of read plan entries covered by this run. These never overlap each other.
+} HashFileSystemReadRun;
+
+/// Generated by hfsGenerateReadPlan() and hfsGenerateReadPlanForEntries().
+typedef struct {
+    HashFileSystemReadPlanEntry *entries;   ///< Dynamically allocated array with all Hash FS entries, sorted by offset. Empty entries are placed first.
+    u32 entry_count;                        ///< Number of read plan entries.
+    u32 empty_entry_count;                  ///< Number of empty entries at the start of the read plan entry array. These aren't covered by any run.
+    HashFileSystemReadRun *runs;            ///< Dynamically allocated array with read runs, sorted by offset.
+    u32 run_count;                          ///< Number of read runs.
+} HashFileSystemReadPlan;
+
+typedef enum {
+    HashFileSystemHashStatus_Pending = 0,
+    HashFileSystemHashStatus_Passed  = 1,
+    HashFileSystemHashStatus_Failed  = 2,
+    HashFileSystemHashStatus_Skipped = 3    ///< Hashed region data wasn't fully processed (e.g. resumed dumps).
+} HashFileSystemHashStatus;
+
+/// Holds information about a single hashed Hash FS entry region within a verifier.
+typedef struct {
+    u64 offset;                 ///< Hashed region offset, relative to the start of the gamecard image.
+    u64 size;                   ///< Hashed region size.
+    u64 processed_size;         ///< Hashed region size processed so far.
+    u8 hash[SHA256_HASH_SIZE];  ///< Expected SHA-256 checksum, taken from the Hash FS entry.
+    u8 hfs_partition_type;      ///< HashFileSystemPartitionType.
+    u8 status;                  ///< HashFileSystemHashStatus.
+    char *name;                 ///< Dynamically allocated Hash FS entry name.
+    Sha256Context sha256_ctx;
+} HashFileSystemHashRegion;
+
+/// Used to verify Hash FS entry hashes while reading gamecard data sequentially (e.g. while dumping a gamecard image or a Hash FS partition).
+/// Each hashed region is checked as soon as its last byte goes through hfsUpdateHashVerifier(). Hashed regions from multiple Hash FS partitions can be added to the same verifier.
+typedef struct {
+    HashFileSystemHashRegion *regions;      ///< Dynamically allocated array with all hashed regions, sorted by offset.
+    u32 region_count;                       ///< Number of hashed regions.
+    u32 cur_region;                         ///< Index of the first hashed region that hasn't been completed yet.
+    u32 passed_count;                       ///< Number of hashed regions that passed verification.
+    u32 failed_count;                       ///< Number of hashed regions that failed verification.
+    u32 skipped_count;                      ///< Number of hashed regions that weren't fully processed.
+} HashFileSystemHashVerifier;
+
 /// Reads raw partition data using a Hash FS context.
 /// Input offset must be relative to the start of the Hash FS.
 bool hfsReadPartitionData(HashFileSystemContext *ctx, void *out, u64 read_size, u64 offset);
@@ -83,9 +141,33 @@ bool hfsReadEntryData(HashFileSystemContext *ctx, HashFileSystemEntry *fs_entry,
 /// If the target partition is empty, 'out_size' will be set to zero and true will be returned.
 bool hfsGetTotalDataSize(HashFileSystemContext *ctx, u64 *out_size);
 
+/// Generates a read plan for all entries from the provided Hash FS context, which makes it possible to extract the whole partition using large, sequential gamecard reads.
+/// Entries are sorted by offset, and adjacent entries separated by no more than HFS_READ_PLAN_MAX_GAP bytes are merged into a single read run.
+/// The padding between merged entries is read and discarded. The provided read plan must be freed with hfsFreeReadPlan() afterwards.
+bool hfsGenerateReadPlan(HashFileSystemContext *ctx, HashFileSystemReadPlan *out);
+
+/// Same as hfsGenerateReadPlan(), but the read plan only covers the Hash FS entries referenced by the provided index array.
+/// Useful to fetch lots of small, scattered entries (e.g. Meta NCAs) using as few gamecard reads as possible. Indices must not be repeated.
+bool hfsGenerateReadPlanForEntries(HashFileSystemContext *ctx, const u32 *entry_indices, u32 entry_index_count, HashFileSystemReadPlan *out);
+
 /// Retrieves a Hash FS entry index by its name.
+/// A name index is built the first time this function is called on a Hash FS with lots of entries, which makes any subsequent lookups O(1).
 bool hfsGetEntryIndexByName(HashFileSystemContext *ctx, const char *name, u32 *out_idx);
 
+/// Adds the hashed regions from all entries within the provided Hash FS context to a verifier. The verifier must have been zeroed out before its first use.
+/// Entries with no hashed region are skipped. This must be called before feeding any data to the verifier.
+bool hfsAddHashVerifierContext(HashFileSystemHashVerifier *verifier, HashFileSystemContext *ctx);
+
+/// Feeds a block of gamecard data to a verifier. Input offset must be relative to the start of the gamecard image, and blocks must be fed in ascending offset order.
+/// Gaps between blocks are allowed, but any hashed region that isn't fully covered is marked as skipped. Returns false if a hashed region failed verification within this block.
+bool hfsUpdateHashVerifier(HashFileSystemHashVerifier *verifier, const void *data, u64 data_size, u64 offset);
+
+/// Marks all pending hashed regions from a verifier as skipped. Returns true if no hashed region failed verification.
+bool hfsFinalizeHashVerifier(HashFileSystemHashVerifier *verifier);
+
+/// Frees a verifier populated by hfsAddHashVerifierContext().
+void hfsFreeHashVerifier(HashFileSystemHashVerifier *verifier);
+
 /// Takes a HashFileSystemPartitionType value. Returns a pointer to a string that represents the partition name that matches the provided Hash FS partition type.
 /// Returns NULL if the provided value is out of range.
 const char *hfsGetPartitionNameString(u8 hfs_partition_type);
@@ -97,9 +179,18 @@ NX_INLINE void hfsFreeContext(HashFileSystemContext *ctx)
     if (!ctx) return;
     if (ctx->name) free(ctx->name);
     if (ctx->header) free(ctx->header);
+    if (ctx->name_index) free(ctx->name_index);
     memset(ctx, 0, sizeof(HashFileSystemContext));
 }
 
+NX_INLINE void hfsFreeReadPlan(HashFileSystemReadPlan *plan)
+{
+    if (!plan) return;
+    if (plan->entries) free(plan->entries);
+    if (plan->runs) free(plan->runs);
+    memset(plan, 0, sizeof(HashFileSystemReadPlan));
+}
+
 NX_INLINE bool hfsIsValidContext(HashFileSystemContext *ctx)
 {
     return (ctx && ctx->type > HashFileSystemPartitionType_None && ctx->type < HashFileSystemPartitionType_Count && ctx->name && ctx->size && ctx->header_size && ctx->header);
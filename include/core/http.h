@@ -65,6 +65,14 @@ bool httpPerformGetRequest(const char *url, bool force_https, size_t *outsize, H
 /// Returns false if the request fails.
 bool httpDownloadFile(const char *path, const char *url, bool force_https, HttpProgressCallback progress_cb, void *progress_ptr);
 
+/// Downloads a file using multiple concurrent HTTP range requests, as long as the server supports them and the file is big enough. Falls back to httpDownloadFile() otherwise.
+/// Progress is saved to a sidecar state file ("<path>.state"). If the download fails or gets cancelled, both the incomplete output file and the state file are kept around,
+/// and calling this function again with the same arguments resumes the download. Dropped segment requests are also retried from their current offset.
+/// If 'expected_size' is non-zero, it is checked against the remote file size and the size of the downloaded file.
+/// If 'expected_sha256' is provided, the SHA-256 checksum of the downloaded file is verified against it. The output file is deleted if any of these checks fail.
+/// Returns false if the request fails.
+bool httpDownloadFileRanged(const char *path, const char *url, bool force_https, u64 expected_size, const u8 *expected_sha256, HttpProgressCallback progress_cb, void *progress_ptr);
+
 /// Wrapper for httpPerformGetRequest() + httpWriteBufferCallback() that manages a HttpBuffer element on its own.
 /// Returns a pointer to a dynamically allocated buffer that holds the downloaded data, which must be freed by the user. This buffer is not NULL terminated.
 /// Providing 'outsize' is mandatory. Returns NULL if the request fails.
@@ -29,6 +29,8 @@
 extern "C" {
 #endif
 
+#define MEM_SCAN_MAX_PATTERN_SIZE   0x1000  ///< Used with memScanProgramMemory(). Much smaller than the scan chunk size.
+
 typedef enum {
     MemoryProgramSegmentType_None   = 0,
     MemoryProgramSegmentType_Text   = BIT(0),
@@ -45,6 +47,22 @@ typedef struct {
     u64 data_size;
 } MemoryLocation;
 
+/// Used by memScanProgramMemory() to look for a pattern within a chunk of program memory.
+/// Must check every offset within [0, data_size - pattern_size] and return true as soon as a match is found, which stops the scan.
+/// Called while the target program is being debugged: it must not log anything or perform any FS I/O.
+typedef bool (*MemoryScanCallback)(const u8 *data, u64 data_size, void *user_data);
+
+typedef struct {
+    u64 program_id;
+    u32 perm;                       ///< Perm flags each memory mapping must have. Perm_R is always required.
+    u64 type_mask;                  ///< Bitmask of accepted memory types (BITL(MemType_*)). Set to zero to accept any memory type.
+    u64 min_size;                   ///< Memory mappings smaller than this are skipped.
+    u64 max_size;                   ///< Memory mappings bigger than this are skipped. Set to zero to disable this check.
+    u64 pattern_size;               ///< Size of the pattern looked for by the callback. Must not exceed MEM_SCAN_MAX_PATTERN_SIZE.
+    MemoryScanCallback callback;
+    void *user_data;                ///< Passed to the callback.
+} MemoryScanFilter;
+
 /// Retrieves memory segment (.text, .rodata, .data) data from a running program.
 /// These are memory pages with read permission (Perm_R) enabled, with type MemType_CodeStatic or MemType_CodeMutable and no MemoryAttribute flag set.
 bool memRetrieveProgramMemorySegment(MemoryLocation *location);
@@ -54,6 +72,13 @@ bool memRetrieveProgramMemorySegment(MemoryLocation *location);
 /// MemType_Unmapped, MemType_Io, MemType_ThreadLocal and MemType_Reserved memory pages are excluded if FS program memory is being retrieved, in order to avoid hangs.
 bool memRetrieveFullProgramMemory(MemoryLocation *location);
 
+/// Scans memory from a running program using the provided filter, without retrieving all of it at once.
+/// Each memory mapping that matches the filter is read in bounded chunks, which are passed to the callback. Scanning stops at the first match.
+/// Consecutive chunks from the same memory mapping overlap by 'pattern_size - 1' bytes, so matches spanning chunk boundaries aren't missed. Matches spanning multiple memory mappings are never reported.
+/// MemType_Unmapped, MemType_Io, MemType_ThreadLocal and MemType_Reserved memory pages are always excluded if FS program memory is being scanned, in order to avoid hangs.
+/// Returns true if a match was found.
+bool memScanProgramMemory(const MemoryScanFilter *filter);
+
 /// Frees a populated MemoryLocation element.
 NX_INLINE void memFreeMemoryLocation(MemoryLocation *location)
 {
@@ -65,6 +65,8 @@ extern "C" {
 #define NCA_HFS_REGULAR_NAME_LENGTH                 (NCA_CONTENT_ID_STR_LENGTH + 4) /* Content ID + ".nca". */
 #define NCA_HFS_META_NAME_LENGTH                    (NCA_CONTENT_ID_STR_LENGTH + 9) /* Content ID + ".cnmt.nca". */
 
+#define NCA_HEADER_CACHE_ENTRY_COUNT                32                              /* Validated NCA headers kept in memory by ncaInitializeContext(). Least recently used entries are evicted first. */
+
 typedef enum {
     NcaDistributionType_Download = 0,
     NcaDistributionType_GameCard = 1,
@@ -379,9 +381,15 @@ typedef enum {
 // Forward declaration for NcaFsSectionContext.
 typedef struct _NcaContext NcaContext;
 
+// Forward declaration for NcaFsSectionReadFunction.
+typedef struct _NcaFsSectionContext NcaFsSectionContext;
+
+/// Read function used internally by NCA functions to read FS section data. Specialized per FS section during its initialization.
+typedef bool (*NcaFsSectionReadFunction)(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf);
+
 /// Unlike NCA contexts, we don't need to keep a hash for the NCA FS section header in NCA FS section contexts.
 /// This is because the functions that modify the NCA FS section header also update the NCA FS section header hash stored in the NCA header.
-typedef struct {
+struct _NcaFsSectionContext {
     bool enabled;                       ///< Set to true if this NCA FS section has passed all validation checks and can be safely used.
     NcaContext *nca_ctx;                ///< NcaContext. Used to perform NCA reads.
     NcaFsHeader header;                 ///< Plaintext NCA FS section header.
@@ -416,10 +424,17 @@ typedef struct {
     Aes128CtrContext ctr_ctx;           ///< Used internally by NCA functions to perform AES-128-CTR crypto.
     Aes128XtsContext xts_decrypt_ctx;   ///< Used internally by NCA functions to perform AES-128-XTS decryption.
     Aes128XtsContext xts_encrypt_ctx;   ///< Used internally by NCA functions to perform AES-128-XTS encryption.
+    Mutex crypto_mutex;                 ///< Used internally by NCA functions to serialize crypto operations on this FS section, since they modify the AES contexts.
+    NcaFsSectionReadFunction read_func; ///< Used internally by NCA functions. Picked based on the encryption type, the sparse layer and the plaintext hash region, so reads don't re-check them.
+
+    ///< Verified-read-related fields.
+    bool verify_reads;                  ///< Set to true if data layer reads are verified against the hash layers. Use ncaSetFsSectionReadVerification() to update this.
+    u8 *verify_hash_layer;              ///< Verified parent hash layer for the data layer. Used internally by NCA functions if verify_reads is true.
+    u64 verify_hash_layer_size;         ///< Size for the verified parent hash layer.
 
     ///< NSP-related fields.
     bool header_written;                ///< Set to true after this FS section header has been written to an output dump.
-} NcaFsSectionContext;
+};
 
 typedef enum {
     NcaVersion_Nca0  = 0,
@@ -467,7 +482,10 @@ struct _NcaContext {
     NcaHeader encrypted_header;                         ///< Encrypted NCA header. If the plaintext NCA header is modified, this will hold an encrypted copy of it.
                                                         ///< Otherwise, this holds the unmodified, encrypted NCA header.
     NcaDecryptedKeyArea decrypted_key_area;
-    NcaFsSectionContext fs_ctx[NCA_FS_HEADER_COUNT];
+    NcaFsSectionContext fs_ctx[NCA_FS_HEADER_COUNT];   ///< Use ncaGetFsSectionContext() to access these if the NCA context was initialized with ncaInitializeContextLazy().
+    bool lazy_fs_section_init;                          ///< Set to true if the NCA context was initialized with ncaInitializeContextLazy().
+    u8 fs_section_init_mask;                            ///< Bitmask holding the NCA FS section contexts that have already been initialized. Only used if lazy_fs_section_init is true.
+    Mutex fs_section_init_mutex;                        ///< Used to serialize lazy NCA FS section context initialization.
 
     ///< NSP-related fields.
     bool header_written;                                ///< Set to true after the NCA header and the FS section headers have been written to an output dump.
@@ -476,6 +494,43 @@ struct _NcaContext {
     u32 content_type_ctx_data_idx;                      ///< Start index for the data generated by the content type context. Used while creating NSPs.
 };
 
+/// Used by ncaReadContentFileVectored().
+typedef struct {
+    void *out;      ///< Output buffer.
+    u64 size;       ///< Read size.
+    u64 offset;     ///< Read offset. Relative to the start of the NCA content file.
+} NcaContentReadRequest;
+
+/// Used by ncaReadAesCtrExStorageRanges().
+typedef struct {
+    u64 size;       ///< Sub-range size. Sub-ranges are laid out back-to-back, starting at the read offset.
+    u32 ctr_val;    ///< AesCtrEx CTR value for this sub-range.
+    bool decrypt;   ///< Set to false for plaintext sub-ranges.
+} NcaAesCtrExRange;
+
+/// Used by NcaPatchOverlayIndex.
+typedef struct {
+    const void *data;   ///< Patch data. Not owned by the overlay index.
+    u64 size;           ///< Patch data size.
+    u64 offset;         ///< Patch data offset. Relative to the start of the NCA content file.
+} NcaPatchOverlayEntry;
+
+/// Holds patch data entries sorted by offset, which can be used to only apply the patches that intersect a given NCA block.
+/// Must be zeroed out before adding any entries to it, and freed with ncaFreePatchOverlayIndex() once it's no longer needed.
+/// The patch data referenced by the index must remain valid throughout its lifetime.
+typedef struct {
+    NcaPatchOverlayEntry *entries;
+    u32 entry_count;
+    bool sorted;
+} NcaPatchOverlayIndex;
+
+/// Used to provide multiple non-overlapping data ranges to ncaGenerateHierarchicalSha256PatchFromRanges() and ncaGenerateHierarchicalIntegrityPatchFromRanges().
+typedef struct {
+    const void *data;   ///< Replacement data.
+    u64 size;           ///< Replacement data size.
+    u64 offset;         ///< Replacement data offset. Relative to the start of the last hash layer (actual underlying FS).
+} NcaHashDataPatchRange;
+
 typedef struct {
     bool written;   ///< Set to true if this patch has already been written.
     u64 offset;     ///< New data offset (relative to the start of the NCA content file).
@@ -496,11 +551,22 @@ typedef struct {
     NcaHashDataPatch hash_level_patch[NCA_IVFC_LEVEL_COUNT];
 } NcaHierarchicalIntegrityPatch;
 
-/// Functions to control the internal heap buffer used by NCA FS section crypto operations.
-/// Must be called at startup.
+/// Functions to control the crypto buffers used by NCA FS section crypto operations. These are short-lived leases from the shared buffer pool (see bufferPoolLease()).
+/// ncaAllocateCryptoBuffer() must be called at startup. It determines the crypto buffer size according to the memory budget (see utilsGetBudgetedBufferSize()).
+/// The number of crypto buffers used at the same time by multiple threads is only limited by the in-flight size cap from the shared buffer pool.
 bool ncaAllocateCryptoBuffer(void);
 void ncaFreeCryptoBuffer(void);
 
+/// Invalidates all cached NCA header entries that match the provided NcmStorageId value. NcmStorageId_Any may be used to invalidate all entries.
+/// Validated NCA header state is cached by ncaInitializeContext() and ncaInitializeContextByHashFileSystemEntry(), so NCAs that are initialized more than once
+/// don't need to be read, decrypted and verified again.
+void ncaInvalidateHeaderCache(u8 storage_id);
+
+/// Frees all hash data patches cached by the patch generation functions during this session.
+/// Patches generated by ncaGenerateHierarchicalSha256Patch() and ncaGenerateHierarchicalIntegrityPatch() (and their FromRanges variants) are cached alongside the FS section header
+/// state they produce, so dumping the same title more than once with the same replacement data (e.g. NACP / CNMT patches) doesn't recalculate every hash layer again.
+void ncaFreeHashDataPatchCache(void);
+
 /// Initializes a NCA context.
 /// If 'storage_id' == NcmStorageId_GameCard, the 'hfs_partition_type' argument must be a valid HashFileSystemPartitionType value.
 /// If the NCA holds a populated Rights ID field, ticket data will need to be retrieved.
@@ -509,6 +575,11 @@ void ncaFreeCryptoBuffer(void);
 /// If ticket data can't be retrieved, the context will still be initialized, but anything that involves working with encrypted NCA FS section blocks won't be possible (e.g. ncaReadFsSection()).
 bool ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik);
 
+/// Same as ncaInitializeContext(), but NCA FS section contexts aren't parsed right away. Instead, each one of them is parsed on first access through ncaGetFsSectionContext().
+/// Useful for callers that only need a single NCA FS section (e.g. Control -> RomFS, Meta -> PFS).
+/// NCA FS section contexts from NCA contexts initialized with this function must *not* be accessed directly.
+bool ncaInitializeContextLazy(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik);
+
 /// Initializes a NCA context using a Hash FS context and a Hash FS file entry.
 /// If the NCA holds a populated Rights ID field, ticket data will need to be retrieved.
 /// If the 'tik' argument points to a valid Ticket element, it will either be updated (if it's empty) or used to read ticket data that has already been retrieved.
@@ -518,10 +589,35 @@ bool ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type,
 /// in the returned NCA context.
 bool ncaInitializeContextByHashFileSystemEntry(NcaContext *out, HashFileSystemContext *hfs_ctx, HashFileSystemEntry *hfs_entry, Ticket *tik);
 
+/// Returns a pointer to the NCA FS section context with the provided index, parsing it first if the NCA context was initialized with ncaInitializeContextLazy().
+/// Returns NULL if the NCA FS section context is invalid.
+NcaFsSectionContext *ncaGetFsSectionContext(NcaContext *ctx, u8 section_idx);
+
 /// Reads raw encrypted data from a NCA using an input context, previously initialized by ncaInitializeContext().
 /// Input offset must be relative to the start of the NCA content file.
 bool ncaReadContentFile(NcaContext *ctx, void *out, u64 read_size, u64 offset);
 
+/// Performs multiple raw encrypted data reads from a NCA using an input context and an array of read requests, which may be provided in any order.
+/// Requests that are close to each other are coalesced into a single underlying read, in order to reduce the number of ncm / gamecard storage operations.
+bool ncaReadContentFileVectored(NcaContext *ctx, const NcaContentReadRequest *requests, u32 request_count);
+
+/// Opaque striped reader used to keep more than one ncm read request in flight for a single NCA. See ncaCreateStripedReader().
+typedef struct NcaStripedReader NcaStripedReader;
+
+/// Creates a striped reader for NCAs from the provided NcmStorageId value, which must not be NcmStorageId_GameCard nor NcmStorageId_Any.
+/// Each striped reader worker uses its own worker thread and ncm storage session. Returns NULL if an error occurs.
+/// Use ncaFreeStripedReader() to free the returned pointer.
+NcaStripedReader *ncaCreateStripedReader(u8 storage_id);
+
+/// Frees a striped reader created by ncaCreateStripedReader().
+void ncaFreeStripedReader(NcaStripedReader *reader);
+
+/// Same as ncaReadContentFile(), but large reads are split into multiple stripes, which are read at the same time by the calling thread and the striped reader workers.
+/// eMMC and SD card read bandwidth can only be saturated with more than one outstanding request, which single-block ncm reads can't provide.
+/// Falls back to ncaReadContentFile() if 'reader' is NULL, if the read is too small to be split or if the NCA doesn't belong to the storage the striped reader was created for.
+/// A single striped reader must not be used by more than one thread at the same time.
+bool ncaStripedReaderReadContentFile(NcaStripedReader *reader, NcaContext *ctx, void *out, u64 read_size, u64 offset);
+
 /// Retrieves the FS section's hierarchical hash target layer extents.
 /// Output offset is relative to the start of the FS section.
 /// Either 'out_offset' or 'out_size' can be NULL, but at least one of them must be a valid pointer.
@@ -530,18 +626,48 @@ bool ncaGetFsSectionHashTargetExtents(NcaFsSectionContext *ctx, u64 *out_offset,
 /// Reads decrypted data from a NCA FS section using an input context.
 /// Input offset must be relative to the start of the NCA FS section.
 /// If dealing with Patch RomFS sections, this function should only be used when *not* reading AesCtrEx storage data. Use ncaReadAesCtrExStorage() for that.
+/// If verified reads have been enabled with ncaSetFsSectionReadVerification(), all data layer blocks overlapped by the read are verified against their parent hashes.
+/// In that case, this function fails right away if a hash mismatch is detected.
 bool ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset);
 
+/// Appends a single extent to the provided StorageExtentList describing where the provided range from a NCA FS section lives within its NCA.
+/// Input offset must be relative to the start of the NCA FS section. The output extent offset uses the same base.
+/// Bucket Tree layers (Sparse, Indirect, AesCtrEx, Compressed) aren't taken into account here. Use bktrQueryStorageExtents() or ncaStorageQueryExtents() for that.
+bool ncaQueryFsSectionExtents(NcaFsSectionContext *ctx, StorageExtentList *out, u64 size, u64 offset);
+
+/// Enables or disables verified reads for a NCA FS section with a HierarchicalSha256 or HierarchicalIntegrity hash layer.
+/// Enabling verified reads reads and verifies the whole hash layer chain up to the master hash once, then keeps the parent hash layer for the data layer cached.
+/// Afterwards, ncaReadFsSection() checks each data block against its parent hash while it is being read, so corrupted data is detected at the first bad block.
+/// Not supported by FS sections with sparse, compression or patch layers.
+/// This function must be called with 'enable' set to false once verified reads are no longer needed, in order to free the cached hash layer.
+bool ncaSetFsSectionReadVerification(NcaFsSectionContext *ctx, bool enable);
+
+/// Verifies raw NCA FS section data previously retrieved with ncaReadContentFile() against its parent hashes, without reading it again.
+/// Input offset must be relative to the start of the NCA FS section. Only the data layer part of the input buffer is verified.
+/// The input buffer is decrypted in place, so its contents must no longer be needed by the caller.
+/// Data layer blocks that are only partially covered by the input buffer are read on their own.
+/// Verified reads must have been enabled with ncaSetFsSectionReadVerification() beforehand.
+bool ncaVerifyRawFsSectionData(NcaFsSectionContext *ctx, void *data, u64 data_size, u64 offset);
+
 /// Reads plaintext AesCtrEx storage data from a NCA Patch RomFS section using an input context and an AesCtrEx CTR value.
 /// Input offset must be relative to the start of the NCA FS section.
 bool ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt);
 
+/// Same as ncaReadAesCtrExStorage(), but the read spans multiple back-to-back sub-ranges, each one with its own AesCtrEx CTR value.
+/// The crypto mutex is only locked once, and all AES block aligned data is retrieved using a single NCA read before decrypting each sub-range in place.
+/// Sub-range sizes must add up to 'read_size'. Falls back to per-sub-range reads if a boundary between sub-ranges isn't aligned to the AES block size.
+bool ncaReadAesCtrExStorageRanges(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, const NcaAesCtrExRange *ranges, u32 range_count);
+
 /// Generates HierarchicalSha256 FS section patch data, which can be used to seamlessly replace NCA data.
 /// Input offset must be relative to the start of the last HierarchicalSha256 hash region (actual underlying FS).
 /// Bear in mind that this function recalculates both the NcaHashData block master hash and the NCA FS header hash from the NCA header.
 /// As such, this function is not designed to generate more than one patch per HierarchicalSha256 FS section.
 bool ncaGenerateHierarchicalSha256Patch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalSha256Patch *out);
 
+/// Same as ncaGenerateHierarchicalSha256Patch(), but generates a single patch for multiple data ranges in one pass.
+/// 'ranges' must be sorted by offset in ascending order, and they must not overlap. The generated patch also covers the unmodified data between them.
+bool ncaGenerateHierarchicalSha256PatchFromRanges(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, NcaHierarchicalSha256Patch *out);
+
 /// Overwrites block(s) from a buffer holding raw NCA data using previously initialized NcaContext and NcaHierarchicalSha256Patch.
 /// 'buf_offset' must hold the raw NCA offset where the data stored in 'buf' was read from.
 /// The 'written' fields from the input NcaHierarchicalSha256Patch and its underlying NcaHashDataPatch elements are updated by this function.
@@ -553,11 +679,37 @@ void ncaWriteHierarchicalSha256PatchToMemoryBuffer(NcaContext *ctx, NcaHierarchi
 /// As such, this function is not designed to generate more than one patch per HierarchicalIntegrity FS section.
 bool ncaGenerateHierarchicalIntegrityPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalIntegrityPatch *out);
 
+/// Same as ncaGenerateHierarchicalIntegrityPatch(), but generates a single patch for multiple data ranges in one pass.
+/// 'ranges' must be sorted by offset in ascending order, and they must not overlap. The generated patch also covers the unmodified data between them.
+bool ncaGenerateHierarchicalIntegrityPatchFromRanges(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, NcaHierarchicalIntegrityPatch *out);
+
 /// Overwrites block(s) from a buffer holding raw NCA data using a previously initialized NcaContext and NcaHierarchicalIntegrityPatch.
 /// 'buf_offset' must hold the raw NCA offset where the data stored in 'buf' was read from.
 /// The 'written' fields from the input NcaHierarchicalIntegrityPatch and its underlying NcaHashDataPatch elements are updated by this function.
 void ncaWriteHierarchicalIntegrityPatchToMemoryBuffer(NcaContext *ctx, NcaHierarchicalIntegrityPatch *patch, void *buf, u64 buf_size, u64 buf_offset);
 
+/// Adds the encrypted NCA header and NCA FS section headers from the provided NCA context to a patch overlay index.
+/// Bear in mind this should only be called once the headers have been re-encrypted with ncaEncryptHeader().
+bool ncaPatchOverlayIndexAddEncryptedHeaderData(NcaPatchOverlayIndex *index, NcaContext *ctx);
+
+/// Adds all the layer patches from the provided NcaHierarchicalSha256Patch / NcaHierarchicalIntegrityPatch to a patch overlay index.
+bool ncaPatchOverlayIndexAddHierarchicalSha256Patch(NcaPatchOverlayIndex *index, NcaHierarchicalSha256Patch *patch);
+bool ncaPatchOverlayIndexAddHierarchicalIntegrityPatch(NcaPatchOverlayIndex *index, NcaHierarchicalIntegrityPatch *patch);
+
+/// Overwrites block(s) from a buffer holding raw NCA data using the patches from a patch overlay index.
+/// A binary search is used to locate the first patch that intersects the buffer, so only intersecting patches are processed.
+/// 'buf_offset' must hold the raw NCA offset where the data stored in 'buf' was read from.
+/// Unlike the *WriteToMemoryBuffer() functions, this doesn't update the 'written' fields from any patch, so it can be called for any block, in any order.
+void ncaWritePatchOverlayIndexToMemoryBuffer(NcaContext *ctx, NcaPatchOverlayIndex *index, void *buf, u64 buf_size, u64 buf_offset);
+
+/// Frees a patch overlay index.
+NX_INLINE void ncaFreePatchOverlayIndex(NcaPatchOverlayIndex *index)
+{
+    if (!index) return;
+    if (index->entries) free(index->entries);
+    memset(index, 0, sizeof(NcaPatchOverlayIndex));
+}
+
 /// Sets the distribution type field from the underlying NCA header in the provided NCA context to NcaDistributionType_Download.
 /// Needed for NSP dumps from gamecard titles.
 void ncaSetDownloadDistributionType(NcaContext *ctx);
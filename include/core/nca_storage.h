@@ -30,6 +30,9 @@
 extern "C" {
 #endif
 
+#define NCA_STORAGE_CACHE_BLOCK_SIZE    0x10000 /* 64 KiB. Matches the smallest buffer pool size class. */
+#define NCA_STORAGE_CACHE_BLOCK_COUNT   4
+
 typedef enum {
     NcaStorageBaseStorageType_Invalid    = 0,   ///< Placeholder.
     NcaStorageBaseStorageType_Regular    = 1,
@@ -39,6 +42,14 @@ typedef enum {
     NcaStorageBaseStorageType_Count      = 5    ///< Total values supported by this enum.
 } NcaStorageBaseStorageType;
 
+/// Used to hold a single block from the NCA storage read cache.
+typedef struct {
+    u8 *data;               ///< Buffer with size NCA_STORAGE_CACHE_BLOCK_SIZE, leased from the shared buffer pool on first use.
+    u64 offset;             ///< Block-aligned virtual offset, relative to the start of the NCA FS section.
+    u64 size;               ///< Block data size. Only smaller than NCA_STORAGE_CACHE_BLOCK_SIZE for the last block from the storage. Zero if unused.
+    u64 last_used;          ///< Value from the LRU counter when this block was last accessed.
+} NcaStorageCacheBlock;
+
 /// Used to perform multi-layered reads within a single NCA FS section.
 typedef struct {
     u8 base_storage_type;                   ///< NcaStorageBaseStorageType.
@@ -47,6 +58,15 @@ typedef struct {
     BucketTreeContext *aes_ctr_ex_storage;  ///< AesCtrEx storage context.
     BucketTreeContext *indirect_storage;    ///< Indirect storage context.
     BucketTreeContext *compressed_storage;  ///< Compressed storage context.
+    bool patch_ranges_available;            ///< Set to true if the Patch storage coverage map has been built.
+    BucketTreeVirtualRange *patch_ranges;   ///< Patch storage coverage map. Sorted array of virtual ranges backed by the Patch storage.
+    u32 patch_range_count;                  ///< Number of elements in 'patch_ranges'.
+    bool zero_ranges_available;             ///< Set to true if the zero-filled range map has been built.
+    BucketTreeVirtualRange *zero_ranges;    ///< Zero-filled range map. Sorted array of virtual ranges that are always read back as zeroes. May be NULL.
+    u32 zero_range_count;                   ///< Number of elements in 'zero_ranges'.
+    Mutex cache_mutex;                                          ///< Used to lock access to the read cache.
+    u64 cache_counter;                                          ///< LRU counter for the read cache.
+    NcaStorageCacheBlock cache[NCA_STORAGE_CACHE_BLOCK_COUNT];  ///< Decrypted block cache, keyed by virtual offset. Sits on top of all storage layers.
 } NcaStorageContext;
 
 /// Initializes a NCA storage context using a NCA FS section context, optionally providing a pointer to a base NcaStorageContext.
@@ -60,11 +80,35 @@ bool ncaStorageInitializeContext(NcaStorageContext *out, NcaFsSectionContext *nc
 bool ncaStorageGetHashTargetExtents(NcaStorageContext *ctx, u64 *out_offset, u64 *out_size);
 
 /// Reads data from the NCA storage using a previously initialized NcaStorageContext.
+/// Reads smaller than NCA_STORAGE_CACHE_BLOCK_SIZE are served through a small LRU block cache holding fully processed data (decrypted, patched and decompressed).
+/// This lets repeated small reads (e.g. RomFS tables, file headers, etc.) bypass all the underlying storage layers. Bigger reads always go straight to the base storage.
 bool ncaStorageRead(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset);
 
+/// Appends extents to the provided StorageExtentList describing where the provided range from the NCA storage actually lives, going through all the underlying storage layers.
+/// Extent offsets are relative to the start of the NCA FS section. Data extents from Patch storages may point to the base NCA.
+bool ncaStorageQueryExtents(NcaStorageContext *ctx, StorageExtentList *out, u64 size, u64 offset);
+
+/// Translates an offset from the provided NcaStorageContext into an effective physical offset, going through all the underlying Bucket Tree storages.
+/// The returned value can be used as a sort key: offsets from the Patch storage are always placed after offsets from the original data storage.
+/// For Regular storages, the provided offset is returned as-is.
+bool ncaStorageGetPhysicalOffset(NcaStorageContext *ctx, u64 offset, u64 *out_offset);
+
+/// Builds a Patch storage coverage map for the provided Patch NcaStorageContext. This walks the whole Indirect Storage once.
+/// Once built, ncaStorageIsBlockWithinPatchStorageRange() performs binary searches over this map instead of walking the Indirect Storage on each call.
+bool ncaStorageBuildPatchCoverageMap(NcaStorageContext *ctx);
+
 /// Checks if the provided block extents are within the provided Patch NcaStorageContext's Indirect Storage.
 bool ncaStorageIsBlockWithinPatchStorageRange(NcaStorageContext *ctx, u64 offset, u64 size, bool *out);
 
+/// Builds a zero-filled range map for the provided NcaStorageContext. This walks the whole Sparse / Compressed Storage once.
+/// Sparse storages contribute their ZeroStorage ranges, while Compressed storages contribute their Zero entries. Other base storage types never have zero-filled ranges.
+/// Once built, ncaStorageRead() fills zero-filled blocks right away, without going through any of the underlying storage layers.
+bool ncaStorageBuildZeroRangeMap(NcaStorageContext *ctx);
+
+/// Checks if the provided block extents are fully contained within a zero-filled range from the provided NcaStorageContext.
+/// Dumpers can use this to skip reads, writes or compression for these blocks. Always sets 'out' to false if the zero-filled range map hasn't been built.
+bool ncaStorageIsBlockZeroFilled(NcaStorageContext *ctx, u64 offset, u64 size, bool *out);
+
 /// Frees a previously initialized NCA storage context.
 void ncaStorageFreeContext(NcaStorageContext *ctx);
 
@@ -0,0 +1,83 @@
+/*
+ * nointro.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __NOINTRO_H__
+#define __NOINTRO_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NOINTRO_INDEX_MAGIC             0x4E494442  /* "NIDB". */
+#define NOINTRO_INDEX_VERSION           1
+
+#define NOINTRO_RECORD_NAME_LENGTH      0x100
+
+/// Offline No-Intro checksum index file layout:
+///     - NoIntroIndexHeader.
+///     - NoIntroIndexEntry array with 'entry_count' elements, sorted by CRC32 checksum in ascending order.
+///     - Name table with 'name_table_size' bytes, made out of NULL-terminated UTF-8 strings.
+typedef struct {
+    u32 magic;              ///< NOINTRO_INDEX_MAGIC.
+    u32 version;            ///< NOINTRO_INDEX_VERSION.
+    u32 entry_count;        ///< Number of NoIntroIndexEntry elements.
+    u32 name_table_size;    ///< Name table size.
+} NoIntroIndexHeader;
+
+NXDT_ASSERT(NoIntroIndexHeader, 0x10);
+
+typedef struct {
+    u32 crc32;                  ///< CRC32 checksum calculated over the plain XCI image (no KeyArea, no certificate, untrimmed).
+    u32 name_offset;            ///< Record name offset, relative to the start of the name table.
+    u64 title_id;               ///< Base application title ID.
+    u8 sha1[SHA1_HASH_SIZE];    ///< SHA-1 checksum calculated over the plain XCI image.
+    u8 reserved[0x4];
+} NoIntroIndexEntry;
+
+NXDT_ASSERT(NoIntroIndexEntry, 0x28);
+
+/// Holds a record retrieved from the offline No-Intro checksum index.
+typedef struct {
+    char name[NOINTRO_RECORD_NAME_LENGTH];  ///< NULL-terminated record name.
+    u64 title_id;                           ///< Base application title ID.
+    u8 sha1[SHA1_HASH_SIZE];                ///< SHA-1 checksum.
+} NoIntroRecord;
+
+/// Frees the offline No-Intro checksum index, if it was previously loaded.
+void noIntroExit(void);
+
+/// Looks up the provided CRC32 checksum within the offline No-Intro checksum index, which is stored at NOINTRO_INDEX_PATH.
+/// The index is loaded into memory the first time this function is called, and a binary search is used to perform the actual lookup.
+/// If 'sha1' is provided, it is used to disambiguate between multiple records sharing the same CRC32 checksum.
+/// Returns false if the index isn't available or if no matching record exists. 'out' may be NULL.
+bool noIntroLookupChecksum(u32 crc32, const u8 *sha1, NoIntroRecord *out);
+
+/// Downloads an updated offline No-Intro checksum index from the provided URL, validates it and replaces the one stored at NOINTRO_INDEX_PATH.
+/// The current index is only replaced if the downloaded one is valid. This is the only operation that requires an Internet connection.
+bool noIntroRefreshIndex(const char *url);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NOINTRO_H__ */
@@ -63,6 +63,9 @@
 /* File/socket based logger. */
 #include "nxdt_log.h"
 
+/* Hot-path tracing spans. */
+#include "nxdt_trace.h"
+
 /* Configuration handler. */
 #include "config.h"
 
@@ -75,6 +78,30 @@
 /* SHA3 checksum calculator. */
 #include "sha3.h"
 
+/* Multi-buffer SHA-256 checksum calculator. */
+#include "sha256_mb.h"
+
+/* Interleaved CRC32 checksum calculator. */
+#include "crc32_fast.h"
+
+/* Growable string builder. */
+#include "string_builder.h"
+
+/* Storage extent lists. */
+#include "storage_extent.h"
+
+/* Shared page-aligned buffer pool. */
+#include "buffer_pool.h"
+
+/* Pipeline stage thread placement. */
+#include "thread_placement.h"
+
+/* I/O and crypto counters. */
+#include "nxdt_stats.h"
+
+/* Cancellation tokens for long core operations. */
+#include "cancel_token.h"
+
 /* LZ4 (dec)compression. */
 #define LZ4_STATIC_LINKING_ONLY /* Required by LZ4 to enable in-place decompression. */
 #include "lz4.h"
@@ -26,10 +26,75 @@
 
 #include <json-c/json.h>
 
+#include "string_builder.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define JSON_STREAM_MAX_DEPTH       32
+#define JSON_STREAM_MAX_PATH_LENGTH 0x400
+
+typedef enum {
+    JsonStreamValueType_String  = 0,    ///< Unescaped UTF-8 string.
+    JsonStreamValueType_Number  = 1,    ///< Number, exactly as it appears in the JSON data.
+    JsonStreamValueType_Boolean = 2,    ///< Either "true" or "false".
+    JsonStreamValueType_Null    = 3     ///< Always "null".
+} JsonStreamValueType;
+
+/// Callback used by JsonStreamReader to report each scalar value as soon as it has been fully parsed.
+/// 'path' holds the full path to the value, using the same format as jsonGetObjectByPath() -- e.g. "assets/0/name". Array elements use decimal indexes.
+/// 'value' is always NULL-terminated. Both pointers are only valid during the callback.
+/// Returning false stops the reader right away, which is useful if all the needed values have already been retrieved.
+typedef bool (*JsonStreamValueCallback)(void *user_data, const char *path, u8 type, const char *value, size_t value_len);
+
+/// Used to parse JSON data in chunks, as it is received, without building a JSON object tree.
+/// Only keeps track of the current path and the current token, which means memory usage doesn't depend on the JSON data size.
+/// Must be initialized using jsonStreamReaderInitialize() and freed using jsonStreamReaderFree().
+typedef struct {
+    JsonStreamValueCallback callback;
+    void *user_data;
+    u8 state;
+    u8 depth;
+    bool container_start;                                   ///< Set right after an opening bracket or brace, which allows empty containers.
+    bool is_key;                                            ///< Set while parsing an object key.
+    u8 unicode_digit_count;
+    u32 unicode_codepoint;
+    u32 unicode_high_surrogate;
+    struct {
+        bool is_array;
+        size_t path_length;                                 ///< Path length right before the current element.
+        u32 index;
+    } stack[JSON_STREAM_MAX_DEPTH];
+    char path[JSON_STREAM_MAX_PATH_LENGTH];
+    size_t path_length;
+    StringBuilder token;
+    bool stopped;                                           ///< Set if the callback requested the reader to stop.
+    bool error;
+} JsonStreamReader;
+
+/// Initializes a JsonStreamReader element with the provided callback.
+void jsonStreamReaderInitialize(JsonStreamReader *reader, JsonStreamValueCallback callback, void *user_data);
+
+/// Feeds JSON data to the provided JsonStreamReader. Chunk boundaries may fall anywhere, including the middle of a token.
+/// Returns false if a syntax error is found, or if the callback asked the reader to stop.
+bool jsonStreamReaderFeed(JsonStreamReader *reader, const char *data, size_t size);
+
+/// Makes sure the provided JsonStreamReader has parsed a complete JSON value. Returns false otherwise.
+bool jsonStreamReaderFinish(JsonStreamReader *reader);
+
+/// Frees a JsonStreamReader element.
+NX_INLINE void jsonStreamReaderFree(JsonStreamReader *reader)
+{
+    if (!reader) return;
+    stringBuilderFree(&(reader->token));
+    memset(reader, 0, sizeof(JsonStreamReader));
+}
+
+/// Feeds downloaded data to a JsonStreamReader. May be used as the write callback for httpPerformGetRequest().
+/// Expects 'outstream' / 'write_ptr' to be a pointer to a JsonStreamReader element. The transfer is aborted if the reader stops.
+size_t jsonStreamReaderHttpWriteCallback(char *buffer, size_t size, size_t nitems, void *outstream);
+
 /// Parses a JSON object using the provided string.
 /// If 'size' is zero, strlen() is used to retrieve the input string length.
 /// json_object_put() must be used to free the returned JSON object.
@@ -43,6 +108,11 @@ struct json_object *jsonParseFromString(const char *str, size_t size);
 /// Returns NULL if an error occurs.
 struct json_object *jsonGetObjectByPath(const struct json_object *obj, const char *path, char **out_last_element);
 
+/// Returns a pointer to a dynamically allocated buffer that holds a quoted and escaped JSON representation of the provided UTF-8 string.
+/// Useful to generate JSON output on the fly without building a JSON object tree first.
+/// Returns NULL if an error occurs.
+char *jsonGenerateEscapedString(const char *str);
+
 /// Logs the last JSON error, if available.
 void jsonLogLastError(void);
 
@@ -36,9 +36,12 @@ extern "C" {
 #define LOG_LEVEL_NONE      4
 
 /// Defines the log level used throughout the application.
-/// Log messages with a log value lower than this one won't be compiled into the binary.
+/// Log messages with a log value lower than this one won't be compiled into the binary, including the evaluation of their arguments.
 /// If a value lower than LOG_LEVEL_DEBUG or equal to/greater than LOG_LEVEL_NONE is used, logfile output will be entirely disabled.
+/// Can be overridden at build time, e.g. `make LOG_LEVEL=WARNING`.
+#ifndef LOG_LEVEL
 #define LOG_LEVEL           LOG_LEVEL_DEBUG /* TODO: change before release (warning?). */
+#endif
 
 #if (LOG_LEVEL >= LOG_LEVEL_DEBUG) && (LOG_LEVEL < LOG_LEVEL_NONE)
 
@@ -89,25 +92,25 @@ extern "C" {
 #endif  /* LOG_LEVEL <= LOG_LEVEL_ERROR */
 
 /// Writes the provided string to the logfile.
-/// If the logfile hasn't been created and/or opened, this function takes care of it.
+/// The string is copied into a lock-free log ring, which is written to the logfile by a low-priority background thread. This thread is started on the first call to any logging function.
+/// If the log ring is full, the string is dropped. The number of dropped messages is written to the logfile once there's room again.
+/// Strings that don't fit in a single log ring record are written right away. If the logfile hasn't been created and/or opened, this function takes care of it.
 void logWriteStringToLogFile(const char *src);
 
-/// Writes a formatted log string to the logfile.
-/// If the logfile hasn't been created and/or opened, this function takes care of it.
+/// Writes a formatted log string to the logfile. Works just like logWriteStringToLogFile().
 __attribute__((format(printf, 5, 6))) void logWriteFormattedStringToLogFile(u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...);
 
 /// Writes a formatted log string to the provided buffer.
 /// If the buffer isn't big enough to hold both its current contents and the new formatted string, it will be resized.
 __attribute__((format(printf, 7, 8))) void logWriteFormattedStringToBuffer(char **dst, size_t *dst_size, u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...);
 
-/// Writes a formatted log string + a hex string representation of the provided binary data to the logfile.
-/// If the logfile hasn't been created and/or opened, this function takes care of it.
+/// Writes a formatted log string + a hex string representation of the provided binary data to the logfile. Works just like logWriteStringToLogFile().
 __attribute__((format(printf, 7, 8))) void logWriteBinaryDataToLogFile(const void *data, size_t data_size, u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...);
 
-/// Forces a flush operation on the logfile.
+/// Writes all pending log ring records to the logfile, then forces a flush operation on it.
 void logFlushLogFile(void);
 
-/// Write any pending data to the logfile, flushes it and then closes it.
+/// Stops the log flush thread, writes any pending data to the logfile, flushes it and then closes it.
 void logCloseLogFile(void);
 
 /// Returns a pointer to a dynamically allocated buffer that holds the last error message string, or NULL if there's none.
@@ -115,6 +118,7 @@ void logCloseLogFile(void);
 char *logGetLastMessage(void);
 
 /// (Un)locks the log mutex. Can be used to block other threads and prevent them from writing data to the logfile.
+/// Messages logged by other threads in the meantime are kept in the log ring (or dropped, if it fills up).
 /// Use with caution.
 void logControlMutex(bool lock);
 
@@ -0,0 +1,109 @@
+/*
+ * nxdt_stats.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __NXDT_STATS_H__
+#define __NXDT_STATS_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// I/O and crypto counters. Each one tracks both the number of calls and the number of bytes processed by a single backend.
+/// Counters are global and lock-free, which makes them safe to update from any thread. Comparing them helps figuring out which layer dominates a slow dump.
+typedef enum {
+    StatsCounterType_GameCardRead = 0,  ///< fsStorageRead() calls on the gamecard storage.
+    StatsCounterType_NcmRead      = 1,  ///< ncmContentStorageReadContentIdFile() calls.
+    StatsCounterType_BisRead      = 2,  ///< fsStorageRead() calls on BIS storages.
+    StatsCounterType_AesXts       = 3,  ///< AES-128-XTS crypto operations.
+    StatsCounterType_AesCtr       = 4,  ///< AES-128-CTR crypto operations on NCA data.
+    StatsCounterType_Sha256       = 5,  ///< SHA-256 checksum calculations on NCA / dump data.
+    StatsCounterType_Sha3         = 6,  ///< SHA3 checksum calculations.
+    StatsCounterType_Crc32        = 7,  ///< CRC32 checksum calculations.
+    StatsCounterType_UsbTransfer  = 8,  ///< USB transfers. Each call matches a single URB.
+    StatsCounterType_SdCardWrite  = 9,  ///< Output file writes to the SD card.
+    StatsCounterType_UmsWrite     = 10, ///< Output file writes to UMS devices.
+    StatsCounterType_Count        = 11  ///< Total values supported by this enum.
+} StatsCounterType;
+
+#define STATS_LATENCY_BUCKET_COUNT  24  ///< Log2 latency buckets, in microseconds. Bucket 0 holds calls under 1 us, while bucket N holds calls within [2^(N-1), 2^N) us. The last bucket also holds anything slower.
+
+/// Service-backed calls with a latency histogram. Issuing lots of tiny IPC calls usually shows up as a big call count stuck within the lowest buckets.
+typedef enum {
+    StatsLatencyType_GameCardRead = 0,  ///< fsStorageRead() calls on the gamecard storage.
+    StatsLatencyType_NcmRead      = 1,  ///< ncmContentStorageReadContentIdFile() calls.
+    StatsLatencyType_BisRead      = 2,  ///< fsStorageRead() calls on BIS storages.
+    StatsLatencyType_EsCall       = 3,  ///< ES service calls.
+    StatsLatencyType_Count        = 4   ///< Total values supported by this enum.
+} StatsLatencyType;
+
+/// Holds the value of a single counter.
+typedef struct {
+    u64 call_count;
+    u64 byte_count;
+} StatsCounter;
+
+/// Holds the value of every counter, along with the time elapsed since they were last reset.
+typedef struct {
+    StatsCounter counters[StatsCounterType_Count];
+    u64 elapsed_ns;
+} StatsSnapshot;
+
+/// Holds a single latency histogram.
+typedef struct {
+    u64 bucket_count[STATS_LATENCY_BUCKET_COUNT];
+    u64 call_count;
+    u64 total_ns;
+    u64 max_ns;
+} StatsLatencyHistogram;
+
+/// Adds a single call with the provided size to a counter.
+void statsAddCounter(u8 type, u64 size);
+
+/// Adds a single call to a latency histogram. 'start_tick' must hold the armGetSystemTick() value taken right before the call was issued.
+void statsRecordLatency(u8 type, u64 start_tick);
+
+/// Fills the provided StatsLatencyHistogram element with the current values from a latency histogram.
+void statsGetLatencyHistogram(u8 type, StatsLatencyHistogram *out_histogram);
+
+/// Returns a human-readable name for the provided counter type, or NULL if it's invalid.
+const char *statsGetCounterName(u8 type);
+
+/// Returns a human-readable name for the provided latency histogram type, or NULL if it's invalid.
+const char *statsGetLatencyName(u8 type);
+
+/// Logs every non-empty latency histogram, along with the average call size from its matching counter.
+void statsLogLatencyHistograms(void);
+
+/// Fills the provided StatsSnapshot element. Counters may be updated by other threads while this takes place, so each one is only consistent on its own.
+void statsGetSnapshot(StatsSnapshot *out_snapshot);
+
+/// Resets all counters and latency histograms. Also called by every data transfer task before it starts, which makes each snapshot cover a single task.
+void statsResetCounters(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NXDT_STATS_H__ */
@@ -0,0 +1,88 @@
+/*
+ * nxdt_trace.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __NXDT_TRACE_H__
+#define __NXDT_TRACE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Enables hot-path tracing spans. Disabled by default, since recording events takes a small amount of time on every instrumented call.
+/// Can be enabled at build time, e.g. `make TRACE=1`.
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED   0
+#endif
+
+#if TRACE_ENABLED == 1
+
+/// Helper macros.
+
+/// Opens a tracing span that lasts until the end of the current scope. The provided name must have static storage duration (e.g. a string literal or __func__).
+/// Should be placed at the very top of a block, before any goto statements that could jump past it.
+#define TRACE_SCOPE(name)   TraceSpan ANONYMOUS_VARIABLE(trace_span_) CLEANUP(traceEndSpan) = traceBeginSpan(name)
+
+/// Opens a tracing span named after the current function.
+#define TRACE_FUNC()        TRACE_SCOPE(__func__)
+
+/// Used by tracing spans.
+typedef struct {
+    const char *name;
+    u64 start_tick;
+} TraceSpan;
+
+/// Closes the provided tracing span and records it as a complete event, along with the current thread handle.
+/// Events are held by a ring buffer. If it's full, the oldest event is overwritten.
+void traceEndSpan(TraceSpan *span);
+
+/// Writes all recorded events to TRACE_FILE_PATH using the Chrome trace event JSON format (viewable with chrome://tracing or Perfetto), then clears the event buffer.
+/// Does nothing if no events have been recorded.
+void traceWriteChromeTraceFile(void);
+
+/// Writes the most recent recorded events to TRACE_CRASH_FILE_PATH, using the same format as traceWriteChromeTraceFile(). The event buffer is left untouched.
+/// Meant to be called from the exception handler: no locks are taken, so events recorded by other threads in the meantime may be skipped.
+void traceWriteCrashTraceFile(void);
+
+/// Opens a tracing span. Use TRACE_SCOPE() / TRACE_FUNC() instead.
+NX_INLINE TraceSpan traceBeginSpan(const char *name)
+{
+    return (TraceSpan){ name, armGetSystemTick() };
+}
+
+#else   /* TRACE_ENABLED == 1 */
+
+/// Helper macros.
+
+#define TRACE_SCOPE(name)               do {} while(0)
+#define TRACE_FUNC()                    do {} while(0)
+
+#define traceWriteChromeTraceFile(...)  do {} while(0)
+#define traceWriteCrashTraceFile(...)   do {} while(0)
+
+#endif  /* TRACE_ENABLED == 1 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NXDT_TRACE_H__ */
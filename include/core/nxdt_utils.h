@@ -56,12 +56,14 @@ typedef enum {
 /// Used to handle parsed data from a GitHub release JSON.
 /// All strings are dynamically allocated.
 typedef struct {
-    struct json_object *obj;    ///< JSON object. Must be freed using json_object_put().
-    const char *version;        ///< Pointer to the version string, referenced by obj.
-    const char *commit_hash;    ///< Pointer to the commit hash string, referenced by obj.
+    char *version;              ///< Version string.
+    char *commit_hash;          ///< Commit hash string.
     struct tm date;             ///< Release date.
-    const char *changelog;      ///< Pointer to the changelog string, referenced by obj.
-    const char *download_url;   ///< Pointer to the download URL string, referenced by obj.
+    char *changelog;            ///< Changelog string.
+    char *download_url;         ///< NRO asset download URL.
+    u64 download_size;          ///< NRO asset size. Zero if unavailable.
+    bool has_download_sha256;   ///< Set to true if the release JSON provides a SHA-256 digest for the NRO asset.
+    u8 download_sha256[SHA256_HASH_SIZE];
 } UtilsGitHubReleaseJsonData;
 
 /// Resource initialization.
@@ -114,13 +116,44 @@ bool utilsIsTerraUnit(void);
 /// Returns true if the application is running under applet mode.
 bool utilsIsAppletMode(void);
 
+/// Memory budget functions.
+/// The free heap size is retrieved once during utilsInitializeResources(), before any large buffers are allocated, and it's used to size them accordingly.
+/// Under low memory conditions (e.g. applet mode), large buffer sizes and ring depths are scaled down, so allocations don't fail in the middle of a dump.
+/// Sizes should be powers of two, in order to keep scaled down values properly aligned.
+u64 utilsGetMemoryBudgetHeapFree(void);
+bool utilsIsMemoryBudgetReduced(void);
+
+/// Returns 'size' scaled down according to the memory budget, but never below 'min_size'.
+u64 utilsGetBudgetedBufferSize(u64 size, u64 min_size);
+
+/// Returns 'count' scaled down according to the memory budget, but never below 'min_count'. Meant to be used with buffer rings.
+u32 utilsGetBudgetedBufferCount(u32 count, u32 min_count);
+
+/// Allocates a buffer using the size returned by utilsGetBudgetedBufferSize(). If the allocation fails, it's retried with halved sizes until 'min_size' is reached.
+/// Uses memalign() if 'alignment' is non-zero, or malloc() otherwise. The actual buffer size is saved to 'out_size', if provided. The returned pointer must be freed by the caller.
+void *utilsAllocateBudgetedBuffer(u64 size, u64 min_size, u64 alignment, u64 *out_size);
+
 /// Blocks HOME button presses, disables screen dimming and auto sleep and overclocks system CPU/MEM.
 /// Must be called before starting long-running processes.
 /// If state is set to false, regular system behavior is restored.
 void utilsSetLongRunningProcessState(bool state);
 
+/// Clock boost hints, provided by data transfer pipelines that know which stage is holding them back.
+typedef enum {
+    UtilsClockBoostHint_None     = 0,   ///< Nothing known about the current workload. The system is overclocked during the whole long-running process.
+    UtilsClockBoostHint_CpuBound = 1,   ///< CPU-bound stages (e.g. decryption, hashing or LZ4 compression) are the bottleneck.
+    UtilsClockBoostHint_IoBound  = 2,   ///< I/O-bound stages (e.g. storage reads, SD card writes or USB transfers) are the bottleneck.
+    UtilsClockBoostHint_Count    = 3    ///< Total values supported by this enum.
+} UtilsClockBoostHint;
+
+/// Updates the clock boost hint for the current long-running process. Only has an effect if both "overclock" and "adaptive_overclock" settings are enabled.
+/// I/O-bound hints restore normal clocks until a different hint is provided, since overclocking wouldn't speed anything up. The hint is reset along with the long-running process state.
+void utilsSetClockBoostHint(u8 hint);
+
 /// Thread management functions.
+/// utilsCreateThread() uses priority 0x3B, which enables preemptive multithreading. utilsCreateThreadWithPriority() takes any priority within [0x2C, 0x3F].
 bool utilsCreateThread(Thread *out_thread, ThreadFunc func, void *arg, int cpu_id);
+bool utilsCreateThreadWithPriority(Thread *out_thread, ThreadFunc func, void *arg, int cpu_id, int priority);
 void utilsJoinThread(Thread *thread);
 
 /// Formats a string and appends it to the provided buffer.
@@ -161,6 +194,10 @@ void utilsGenerateFormattedSizeString(double size, char *dst, size_t dst_size);
 /// Returns false if there's an error.
 bool utilsGetFileSystemStatsByPath(const char *path, u64 *out_total, u64 *out_free);
 
+/// Saves the cluster size from the filesystem pointed to by the input path (e.g. "ums0:/") to 'out_cluster_size'.
+/// Returns false if there's an error, or if the underlying devoptab driver doesn't report it (e.g. the SD card).
+bool utilsGetFileSystemClusterSizeByPath(const char *path, u64 *out_cluster_size);
+
 /// Returns true if a file exists.
 bool utilsCheckIfFileExists(const char *path);
 
@@ -200,7 +237,7 @@ bool utilsGetApplicationUpdatedState(void);
 /// Sets the application updated state to true, which makes utilsCloseResources() replace the application NRO.
 void utilsSetApplicationUpdatedState(void);
 
-/// Parses the provided GitHub release JSON data buffer.
+/// Parses the provided GitHub release JSON data buffer using a JsonStreamReader, which means no JSON object tree is built.
 /// The data from the output buffer must be freed using utilsFreeGitHubReleaseJsonData().
 bool utilsParseGitHubReleaseJsonData(const char *json_buf, size_t json_buf_size, UtilsGitHubReleaseJsonData *out);
 
@@ -212,7 +249,10 @@ bool utilsIsApplicationUpdatable(const char *version, const char *commit_hash);
 NX_INLINE void utilsFreeGitHubReleaseJsonData(UtilsGitHubReleaseJsonData *data)
 {
     if (!data) return;
-    if (data->obj) json_object_put(data->obj);
+    if (data->version) free(data->version);
+    if (data->commit_hash) free(data->commit_hash);
+    if (data->changelog) free(data->changelog);
+    if (data->download_url) free(data->download_url);
     memset(data, 0, sizeof(UtilsGitHubReleaseJsonData));
 }
 
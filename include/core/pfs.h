@@ -59,6 +59,8 @@ typedef struct {
     bool is_exefs;                      ///< ExeFS flag.
     u64 header_size;                    ///< Full header size.
     u8 *header;                         ///< PartitionFileSystemHeader + (PartitionFileSystemEntry * entry_count) + Name Table.
+    u32 name_index_capacity;            ///< Name index slot count. Always a power of two.
+    u32 *name_index;                    ///< Name -> entry index hash table. Lazily built by pfsGetEntryIndexByName(). Unused slots are set to UINT32_MAX.
 } PartitionFileSystemContext;
 
 /// Used to generate Partition FS images (e.g. NSPs).
@@ -67,6 +69,9 @@ typedef struct {
     PartitionFileSystemEntry *entries;  ///< Partition FS entries.
     char *name_table;                   ///< Name table.
     u64 fs_size;                        ///< Partition FS data size. Updated each time a new entry is added.
+    u32 entry_capacity;                 ///< Number of entries that fit into the 'entries' buffer. Grows geometrically.
+    u32 name_table_capacity;            ///< 'name_table' buffer size. Grows geometrically, and any data past the used name table area is always zeroed.
+    u32 name_table_used;                ///< Unpadded name table size, including the NULL terminator from the last entry name.
 } PartitionFileSystemImageContext;
 
 /// Initializes a Partition FS context.
@@ -81,6 +86,7 @@ bool pfsReadPartitionData(PartitionFileSystemContext *ctx, void *out, u64 read_s
 bool pfsReadEntryData(PartitionFileSystemContext *ctx, PartitionFileSystemEntry *fs_entry, void *out, u64 read_size, u64 offset);
 
 /// Retrieves a Partition FS entry index by its name.
+/// A name index is built the first time this function is called on a Partition FS with lots of entries, which makes any subsequent lookups O(1).
 bool pfsGetEntryIndexByName(PartitionFileSystemContext *ctx, const char *name, u32 *out_idx);
 
 /// Calculates the extracted Partition FS size.
@@ -111,6 +117,7 @@ NX_INLINE void pfsFreeContext(PartitionFileSystemContext *ctx)
     if (!ctx) return;
     ncaStorageFreeContext(&(ctx->storage_ctx));
     if (ctx->header) free(ctx->header);
+    if (ctx->name_index) free(ctx->name_index);
     memset(ctx, 0, sizeof(PartitionFileSystemContext));
 }
 
@@ -37,6 +37,10 @@ extern "C" {
 
 #define ROMFS_TABLE_ENTRY_ALIGNMENT 0x4
 
+#define ROMFS_TABLE_PAGE_SIZE           0x4000  /* 16 KiB. */
+#define ROMFS_TABLE_PAGE_OVERLAP        0x400   /* Extra data loaded past the end of each page, so entries starting near the end of a page are always contiguous in memory. */
+#define ROMFS_TABLE_PAGE_CACHE_COUNT    16
+
 /// Header used by NCA0 RomFS sections.
 typedef struct {
     u32 header_size;                ///< Header size. Must be equal to ROMFS_OLD_HEADER_SIZE.
@@ -108,8 +112,37 @@ typedef struct {
 
 NXDT_ASSERT(RomFileSystemFileEntry, 0x20);
 
+/// Full path hash table entry.
+typedef struct {
+    u32 hash;       ///< Full path hash.
+    u32 offset;     ///< Entry offset within its table. Set to ROMFS_VOID_ENTRY if this slot is unused.
+} RomFileSystemPathIndexEntry;
+
+/// Full path hash table. Uses open addressing with linear probing.
+typedef struct {
+    u32 capacity;                           ///< Number of slots. Always a power of two.
+    RomFileSystemPathIndexEntry *entries;   ///< Dynamically allocated slot array.
+} RomFileSystemPathIndex;
+
+/// Table page loaded into memory by a paged RomFS context.
+typedef struct {
+    u64 page_offset;    ///< Page offset, relative to the start of its table.
+    u64 size;           ///< Loaded data size. Set to zero if this page is unused.
+    u64 last_used;      ///< Value from the cache counter at the time this page was last accessed.
+    u8 *data;           ///< Dynamically allocated buffer. Holds up to ROMFS_TABLE_PAGE_SIZE + ROMFS_TABLE_PAGE_OVERLAP bytes.
+} RomFileSystemTablePage;
+
+/// LRU page cache used by paged RomFS contexts to load directory / file entries tables on demand.
+typedef struct {
+    Mutex mutex;                                                ///< Protects all the fields below.
+    u64 table_offset;                                           ///< Table offset, relative to the start of the RomFS.
+    u64 counter;                                                ///< Access counter.
+    RomFileSystemTablePage pages[ROMFS_TABLE_PAGE_CACHE_COUNT]; ///< Cached pages.
+} RomFileSystemTablePageCache;
+
 typedef struct {
     bool is_patch;                          ///< Set to true if this we're dealing with a Patch RomFS.
+    bool is_paged;                          ///< Set to true if this context was initialized with romfsInitializePagedContext().
     NcaStorageContext storage_ctx[2];       ///< Used to read NCA FS section data. Index 0: base storage. Index 1: patch storage.
     NcaStorageContext *default_storage_ctx; ///< Default NCA storage context. Points to one of the two contexts from 'storage_ctx'. Placed here for convenience.
     u64 offset;                             ///< RomFS offset (relative to the start of the NCA FS section).
@@ -124,6 +157,10 @@ typedef struct {
     u64 file_table_size;                    ///< RomFS file entries table size.
     RomFileSystemFileEntry *file_table;     ///< RomFS file entries table.
     u64 body_offset;                        ///< RomFS file data body offset (relative to the start of the RomFS).
+    RomFileSystemPathIndex dir_path_index;  ///< Optional full path hash table for directory entries. Built by romfsBuildPathIndex().
+    RomFileSystemPathIndex file_path_index; ///< Optional full path hash table for file entries. Built by romfsBuildPathIndex().
+    RomFileSystemTablePageCache *dir_table_cache;   ///< Directory entries table page cache. Only used by paged contexts, in which case 'dir_table' is NULL.
+    RomFileSystemTablePageCache *file_table_cache;  ///< File entries table page cache. Only used by paged contexts, in which case 'file_table' is NULL.
 } RomFileSystemContext;
 
 typedef struct {
@@ -133,6 +170,15 @@ typedef struct {
     NcaHierarchicalIntegrityPatch cur_format_patch; ///< Used with NCA2/NCA3 RomFS sections.
 } RomFileSystemFileEntryPatch;
 
+/// Directory path memo used by romfsGeneratePathFromFileEntryWithMemo().
+/// Holds the last parent directory path generated through it, which is reused as-is by files from the same directory, or extended by files from a child directory.
+typedef struct {
+    u32 dir_offset;                 ///< Memoized directory entry offset. Set to ROMFS_VOID_ENTRY if the memo is empty.
+    u8 illegal_char_replace_type;   ///< RomFileSystemPathIllegalCharReplaceType value used to generate the memoized path.
+    size_t path_len;                ///< Memoized path length.
+    char path[FS_MAX_PATH];         ///< Memoized directory path.
+} RomFileSystemPathMemo;
+
 typedef enum {
     RomFileSystemPathIllegalCharReplaceType_None               = 0,
     RomFileSystemPathIllegalCharReplaceType_IllegalFsChars     = 1,
@@ -145,6 +191,12 @@ typedef enum {
 /// 'patch_nca_fs_ctx' shall be NULL if not dealing with a Patch RomFS.
 bool romfsInitializeContext(RomFileSystemContext *out, NcaFsSectionContext *base_nca_fs_ctx, NcaFsSectionContext *patch_nca_fs_ctx);
 
+/// Same as romfsInitializeContext(), but directory and file entries tables aren't loaded into memory. Table pages are loaded on demand through a small LRU cache instead.
+/// Memory usage for both tables is bounded to 2 * ROMFS_TABLE_PAGE_CACHE_COUNT * (ROMFS_TABLE_PAGE_SIZE + ROMFS_TABLE_PAGE_OVERLAP) bytes, regardless of the RomFS size.
+/// Entry pointers returned for a paged context are only guaranteed to remain valid until ROMFS_TABLE_PAGE_CACHE_COUNT other pages from the same table have been loaded.
+/// Thus, paged contexts are meant for short-lived lookups (e.g. retrieving a handful of files from a large RomFS). They can't be shared between threads nor mounted as devoptab devices.
+bool romfsInitializePagedContext(RomFileSystemContext *out, NcaFsSectionContext *base_nca_fs_ctx, NcaFsSectionContext *patch_nca_fs_ctx);
+
 /// Reads raw filesystem data using a RomFS context.
 /// Input offset must be relative to the start of the RomFS.
 bool romfsReadFileSystemData(RomFileSystemContext *ctx, void *out, u64 read_size, u64 offset);
@@ -153,6 +205,13 @@ bool romfsReadFileSystemData(RomFileSystemContext *ctx, void *out, u64 read_size
 /// Input offset must be relative to the start of the RomFS file entry data.
 bool romfsReadFileEntryData(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, void *out, u64 read_size, u64 offset);
 
+/// Appends extents to the provided StorageExtentList describing where the provided range of raw filesystem data from a RomFS context actually lives.
+/// Extent offsets are relative to the start of the RomFS. Physical offsets go through all the underlying storage layers (see ncaStorageQueryExtents()).
+bool romfsQueryFileSystemDataExtents(RomFileSystemContext *ctx, StorageExtentList *out, u64 size, u64 offset);
+
+/// Same as romfsQueryFileSystemDataExtents(), but the provided offset and the output extent offsets are relative to the start of the file entry data.
+bool romfsQueryFileEntryExtents(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, StorageExtentList *out, u64 size, u64 offset);
+
 /// Calculates the extracted RomFS size.
 /// If 'only_updated' is set to true and the provided RomFS context was initialized as a Patch RomFS context, only files modified by the update will be considered.
 bool romfsGetTotalDataSize(RomFileSystemContext *ctx, bool only_updated, u64 *out_size);
@@ -160,6 +219,11 @@ bool romfsGetTotalDataSize(RomFileSystemContext *ctx, bool only_updated, u64 *ou
 /// Calculates the extracted size from a RomFS directory.
 bool romfsGetDirectoryDataSize(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry, u64 *out_size);
 
+/// Builds full path hash tables for all directory and file entries from the provided RomFS context.
+/// Once built, romfsGetDirectoryEntryByPath() and romfsGetFileEntryByPath() resolve paths using a single hash table probe instead of walking each path element.
+/// This is optional, and it's only worth it if a large number of path lookups is expected to take place.
+bool romfsBuildPathIndex(RomFileSystemContext *ctx);
+
 /// Retrieves a RomFS directory entry by path.
 /// Input path must have a leading slash ('/'). If just a single slash is provided, a pointer to the root directory entry shall be returned.
 RomFileSystemDirectoryEntry *romfsGetDirectoryEntryByPath(RomFileSystemContext *ctx, const char *path);
@@ -174,16 +238,62 @@ bool romfsGeneratePathFromDirectoryEntry(RomFileSystemContext *ctx, RomFileSyste
 /// Generates a path string from a RomFS file entry.
 bool romfsGeneratePathFromFileEntry(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, char *out_path, size_t out_path_size, u8 illegal_char_replace_type);
 
+/// Same as romfsGeneratePathFromFileEntry(), but the parent directory path is taken from the provided memo whenever possible, which is updated afterwards.
+/// Meant to be used while generating paths for lots of file entries (e.g. full RomFS extraction), which avoids rebuilding the same directory paths over and over.
+/// The memo must be initialized with romfsInitializePathMemo() and it must only be used with a single RomFS context.
+bool romfsGeneratePathFromFileEntryWithMemo(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, RomFileSystemPathMemo *memo, char *out_path, size_t out_path_size, u8 illegal_char_replace_type);
+
+/// Generates a read plan for all file entries from the provided RomFS context: a dynamically allocated array of file entry offsets sorted by their effective physical offset.
+/// Physical offsets are calculated through all the underlying Indirect / Compressed storage layers, which makes reading file data in plan order as sequential as possible.
+/// Empty file entries are placed first. The returned pointer must be freed by the caller.
+/// If 'only_updated' is true, only non-empty file entries with data backed by the Patch storage are included (see romfsIsFileEntryUpdated()), which is only valid for Patch RomFS contexts.
+/// In that case, a zero entry count is considered valid, and no array is returned if nothing has been updated.
+bool romfsGenerateFileEntryReadPlan(RomFileSystemContext *ctx, bool only_updated, u32 **out_file_entry_offsets, u32 *out_count);
+
 /// Checks if a RomFS file entry is updated by the Patch RomFS.
 /// Only works if the provided RomFileSystemContext was initialized as a Patch RomFS context.
 bool romfsIsFileEntryUpdated(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, bool *out);
 
+/// Checks if a raw filesystem data block from a RomFS context is fully zero-filled (e.g. backed by a SparseStorage's ZeroStorage), without reading it.
+/// Dumpers can use this to skip reads and writes for these blocks.
+bool romfsIsFileSystemDataZeroFilled(RomFileSystemContext *ctx, u64 offset, u64 size, bool *out);
+
+/// Same as romfsIsFileSystemDataZeroFilled(), but the provided offset is relative to the start of the file entry data.
+bool romfsIsFileEntryDataZeroFilled(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, u64 offset, u64 size, bool *out);
+
 /// Generates HierarchicalSha256 (NCA0) / HierarchicalIntegrity (NCA2/NCA3) FS section patch data using a RomFS context + file entry, which can be used to seamlessly replace NCA data.
 /// Input offset must be relative to the start of the RomFS file entry data.
 /// This function shares the same limitations as ncaGenerateHierarchicalSha256Patch() / ncaGenerateHierarchicalIntegrityPatch().
 /// Use the romfsWriteFileEntryPatchToMemoryBuffer() wrapper to write patch data generated by this function.
 bool romfsGenerateFileEntryPatch(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, const void *data, u64 data_size, u64 data_offset, RomFileSystemFileEntryPatch *out);
 
+/// Retrieves a pointer to a directory / file entry from a paged RomFS context, loading its table page if needed.
+/// Use the romfsGetDirectoryEntryByOffset() / romfsGetFileEntryByOffset() wrappers instead of calling this function directly.
+void *romfsGetPagedEntryByOffset(RomFileSystemContext *ctx, bool is_file, u64 entry_offset);
+
+/// Frees a RomFS table page cache.
+NX_INLINE void romfsFreeTablePageCache(RomFileSystemTablePageCache *cache)
+{
+    if (!cache) return;
+
+    for(u32 i = 0; i < ROMFS_TABLE_PAGE_CACHE_COUNT; i++)
+    {
+        if (cache->pages[i].data) free(cache->pages[i].data);
+    }
+
+    free(cache);
+}
+
+/// Initializes a RomFileSystemPathMemo.
+NX_INLINE void romfsInitializePathMemo(RomFileSystemPathMemo *memo)
+{
+    if (!memo) return;
+    memo->dir_offset = ROMFS_VOID_ENTRY;
+    memo->illegal_char_replace_type = RomFileSystemPathIllegalCharReplaceType_None;
+    memo->path_len = 0;
+    *(memo->path) = '\0';
+}
+
 /// Resets a previously initialized RomFileSystemContext.
 NX_INLINE void romfsFreeContext(RomFileSystemContext *ctx)
 {
@@ -194,14 +304,19 @@ NX_INLINE void romfsFreeContext(RomFileSystemContext *ctx)
     if (ctx->dir_table) free(ctx->dir_table);
     if (ctx->file_bucket) free(ctx->file_bucket);
     if (ctx->file_table) free(ctx->file_table);
+    if (ctx->dir_path_index.entries) free(ctx->dir_path_index.entries);
+    if (ctx->file_path_index.entries) free(ctx->file_path_index.entries);
+    romfsFreeTablePageCache(ctx->dir_table_cache);
+    romfsFreeTablePageCache(ctx->file_table_cache);
     memset(ctx, 0, sizeof(RomFileSystemContext));
 }
 
 /// Checks if the provided RomFileSystemContext is valid.
 NX_INLINE bool romfsIsValidContext(RomFileSystemContext *ctx)
 {
-    return (ctx && ncaStorageIsValidContext(ctx->default_storage_ctx) && ctx->size && ctx->dir_bucket_size && ctx->dir_bucket && ctx->dir_table_size && ctx->dir_table && \
-            ctx->file_bucket_size && ctx->file_bucket && ctx->file_table_size && ctx->file_table && ctx->body_offset >= ctx->header.old_format.header_size && \
+    return (ctx && ncaStorageIsValidContext(ctx->default_storage_ctx) && ctx->size && ctx->dir_bucket_size && ctx->dir_bucket && ctx->dir_table_size && \
+            (ctx->is_paged ? ctx->dir_table_cache != NULL : ctx->dir_table != NULL) && ctx->file_bucket_size && ctx->file_bucket && ctx->file_table_size && \
+            (ctx->is_paged ? ctx->file_table_cache != NULL : ctx->file_table != NULL) && ctx->body_offset >= ctx->header.old_format.header_size && \
             ctx->body_offset < ctx->size);
 }
 
@@ -215,11 +330,13 @@ NX_INLINE void *romfsGetEntryByOffset(RomFileSystemContext *ctx, void *entry_tab
 
 NX_INLINE RomFileSystemDirectoryEntry *romfsGetDirectoryEntryByOffset(RomFileSystemContext *ctx, u64 dir_entry_offset)
 {
+    if (ctx && ctx->is_paged) return (RomFileSystemDirectoryEntry*)romfsGetPagedEntryByOffset(ctx, false, dir_entry_offset);
     return (ctx ? (RomFileSystemDirectoryEntry*)romfsGetEntryByOffset(ctx, ctx->dir_table, ctx->dir_table_size, sizeof(RomFileSystemDirectoryEntry), dir_entry_offset) : NULL);
 }
 
 NX_INLINE RomFileSystemFileEntry *romfsGetFileEntryByOffset(RomFileSystemContext *ctx, u64 file_entry_offset)
 {
+    if (ctx && ctx->is_paged) return (RomFileSystemFileEntry*)romfsGetPagedEntryByOffset(ctx, true, file_entry_offset);
     return (ctx ? (RomFileSystemFileEntry*)romfsGetEntryByOffset(ctx, ctx->file_table, ctx->file_table_size, sizeof(RomFileSystemFileEntry), file_entry_offset) : NULL);
 }
 
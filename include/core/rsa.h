@@ -35,13 +35,18 @@ extern "C" {
 #define RSA2048_SIG_SIZE    RSA2048_BYTES
 #define RSA2048_PUBKEY_SIZE RSA2048_BYTES
 
+/// Saves the signature verification cache to RSA_SIG_CACHE_PATH (if it was modified) and frees it.
+void rsaExit(void);
+
 /// Verifies a RSA-2048-PSS with SHA-256 signature.
 /// Suitable for NCA and NPDM signatures.
+/// Successfully verified signatures are stored in a persistent cache, which is used to skip the RSA operation altogether if the same signature is verified again.
 /// The provided signature and modulus must have sizes of at least RSA2048_SIG_SIZE and RSA2048_PUBKEY_SIZE, respectively.
 bool rsa2048VerifySha256BasedPssSignature(const void *data, size_t data_size, const void *signature, const void *modulus, const void *public_exponent, size_t public_exponent_size);
 
 /// Verifies a RSA-2048-PKCS#1 v1.5 with SHA-256 signature.
 /// Suitable for ticket and certificate chain signatures.
+/// Shares the same persistent cache used by rsa2048VerifySha256BasedPssSignature().
 /// The provided signature and modulus must have sizes of at least RSA2048_SIG_SIZE and RSA2048_PUBKEY_SIZE, respectively.
 bool rsa2048VerifySha256BasedPkcs1v15Signature(const void *data, size_t data_size, const void *signature, const void *modulus, const void *public_exponent, size_t public_exponent_size);
 
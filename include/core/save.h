@@ -35,6 +35,7 @@ extern "C" {
 #define SAVE_FAT_ENTRY_SIZE             8
 #define SAVE_FS_LIST_MAX_NAME_LENGTH    0x40
 #define SAVE_FS_LIST_ENTRY_SIZE         0x60
+#define SAVE_FAT_STORAGE_MAX_EXTENTS    64
 
 #define MAGIC_DISF                      0x46534944
 #define MAGIC_DPFS                      0x53465044
@@ -44,6 +45,7 @@ extern "C" {
 #define MAGIC_IVFC                      0x43465649
 
 #define ACTION_VERIFY                   (1 << 2)
+#define ACTION_LAZY                     (1 << 3)    /* Reads duplex data layer blocks on demand instead of loading both copies up front. Ignored if ACTION_VERIFY is set. */
 
 typedef enum {
     VALIDITY_UNCHECKED = 0,
@@ -180,6 +182,7 @@ NXDT_ASSERT(remap_header_t, 0x40);
 
 typedef struct remap_segment_ctx_t remap_segment_ctx_t;
 typedef struct remap_entry_ctx_t remap_entry_ctx_t;
+typedef struct remap_storage_ctx_t remap_storage_ctx_t;
 
 #pragma pack(push, 1)
 struct remap_entry_ctx_t {
@@ -214,6 +217,9 @@ typedef struct {
     u8 *data_b;
     duplex_bitmap_t bitmap;
     u64 _length;
+    remap_storage_ctx_t *base_storage;  /* Used to read data on demand if data_a and data_b are NULL. */
+    u64 base_offset_a;
+    u64 base_offset_b;
 } duplex_storage_ctx_t;
 
 enum base_storage_type {
@@ -223,15 +229,16 @@ enum base_storage_type {
     STORAGE_JOURNAL = 3
 };
 
-typedef struct {
+struct remap_storage_ctx_t {
     remap_header_t *header;
     remap_entry_ctx_t *map_entries;
     remap_segment_ctx_t *segments;
+    remap_entry_ctx_t *last_entry;  /* Last map entry returned by a lookup. Speeds up sequential access. */
     enum base_storage_type type;
     u64 base_storage_offset;
     duplex_storage_ctx_t *duplex;
     FILE *file;
-} remap_storage_ctx_t;
+};
 
 typedef struct {
     u64 title_id;
@@ -303,6 +310,9 @@ typedef struct {
     u8 *data_a;
     u8 *data_b;
     duplex_info_t info;
+    remap_storage_ctx_t *base_storage;  /* Only set for lazily read layers. */
+    u64 base_offset_a;
+    u64 base_offset_b;
 } duplex_fs_layer_info_t;
 
 typedef struct {
@@ -361,6 +371,9 @@ struct integrity_verification_storage_ctx_t {
     u32 sector_count;
     u64 _length;
     integrity_verification_storage_ctx_t *next_level;
+    u8 *block_cache;    /* Salt + last block read from this level. */
+    u64 block_cache_index;
+    bool block_cached;
 };
 
 typedef struct {
@@ -382,12 +395,21 @@ typedef struct {
     fat_header_t *header;
 } allocation_table_ctx_t;
 
+typedef struct {
+    u32 virtual_block;
+    u32 physical_block;
+    u32 block_count;
+} allocation_table_extent_t;
+
 typedef struct {
     hierarchical_integrity_verification_storage_ctx_t *base_storage;
     u32 block_size;
     u32 initial_block;
     allocation_table_ctx_t *fat;
     u64 _length;
+    u32 extent_count;
+    bool extents_complete;  /* Set to false if the FAT chain holds more than SAVE_FAT_STORAGE_MAX_EXTENTS segments. */
+    allocation_table_extent_t extents[SAVE_FAT_STORAGE_MAX_EXTENTS];
 } allocation_table_storage_ctx_t;
 
 typedef struct {
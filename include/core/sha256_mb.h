@@ -0,0 +1,48 @@
+/*
+ * sha256_mb.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __SHA256_MB_H__
+#define __SHA256_MB_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Calculates SHA-256 checksums for 'count' independent buffers at once.
+/// SHA-256 instructions are interleaved across pairs of buffers in order to hide their latency, which is a lot faster than hashing each buffer on its own.
+/// 'dst' must point to a buffer that's at least (count * SHA256_HASH_SIZE) bytes long. 'src' and 'size' must both point to arrays with 'count' elements.
+/// Equally sized buffers get the biggest performance boost, but any size combination is supported.
+void sha256CalculateMultiBufferHash(void *dst, const void * const *src, const size_t *size, size_t count);
+
+/// Calculates a SHA-256 checksum for each 'block_size'-byte long block from the provided buffer, using sha256CalculateMultiBufferHash().
+/// The last block is truncated if 'size' isn't a multiple of 'block_size'.
+/// 'dst' must point to a buffer that's at least ((ALIGN_UP(size, block_size) / block_size) * SHA256_HASH_SIZE) bytes long.
+void sha256CalculateBlockHashes(void *dst, const void *src, size_t size, size_t block_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SHA256_MB_H__ */
@@ -0,0 +1,84 @@
+/*
+ * storage_extent.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#ifndef __STORAGE_EXTENT_H__
+#define __STORAGE_EXTENT_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    StorageExtentType_Data       = 0,   ///< Plain data, stored as-is (besides encryption) at the provided physical location.
+    StorageExtentType_Zero       = 1,   ///< Zero-filled data. Not backed by any physical storage.
+    StorageExtentType_Compressed = 2,   ///< Compressed data. The physical location points to the whole compressed block this extent belongs to.
+    StorageExtentType_Patched    = 3,   ///< Data stored within a Patch NCA's AesCtrEx storage.
+    StorageExtentType_Count      = 4    ///< Total values supported by this enum.
+} StorageExtentType;
+
+typedef enum {
+    StorageExtentSource_None         = 0,   ///< No physical source. Only used by StorageExtentType_Zero extents.
+    StorageExtentSource_GameCard     = 1,   ///< Physical offset is relative to the start of the gamecard image. 'source_ctx' is always NULL.
+    StorageExtentSource_NcaFsSection = 2,   ///< Physical offset is relative to the start of the NCA that holds the FS section pointed to by 'source_ctx' (NcaFsSectionContext).
+    StorageExtentSource_Count        = 3    ///< Total values supported by this enum.
+} StorageExtentSource;
+
+/// Describes where a virtual range from a storage actually lives.
+typedef struct {
+    u64 offset;                 ///< Virtual offset, relative to the start of the queried storage (or file entry).
+    u64 size;                   ///< Virtual size.
+    u8 type;                    ///< StorageExtentType.
+    u8 source;                  ///< StorageExtentSource.
+    const void *source_ctx;     ///< Source context. Its type depends on the StorageExtentSource value.
+    u64 physical_offset;        ///< Physical offset within the source. Zero for StorageExtentSource_None.
+    u64 physical_size;          ///< Physical size. Matches the virtual size for Data and Patched extents, and it's zero for Zero extents.
+} StorageExtent;
+
+/// Growable list of storage extents, sorted by virtual offset. Must be zero-initialized before use.
+/// Extents are appended by the extent query functions from each storage layer (e.g. gamecardQueryStorageExtents(), bktrQueryStorageExtents(), etc.).
+typedef struct {
+    StorageExtent *extents;     ///< Dynamically allocated array.
+    u32 count;                  ///< Number of extents in the array.
+    u32 capacity;               ///< Allocated array capacity.
+} StorageExtentList;
+
+/// Appends a storage extent to the provided list. It's merged with the last extent from the list if both of them are contiguous, both virtually and physically.
+/// Compressed extents are never merged.
+bool storageExtentListAppend(StorageExtentList *list, const StorageExtent *extent);
+
+/// Frees the extents held by the provided list and resets it.
+NX_INLINE void storageExtentListFree(StorageExtentList *list)
+{
+    if (!list) return;
+    if (list->extents) free(list->extents);
+    memset(list, 0, sizeof(StorageExtentList));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STORAGE_EXTENT_H__ */
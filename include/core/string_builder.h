@@ -0,0 +1,81 @@
+/*
+ * string_builder.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#ifndef __STRING_BUILDER_H__
+#define __STRING_BUILDER_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Growable string buffer. Must be zero-initialized before use.
+/// Its capacity is grown geometrically, which means repeated appends only trigger a handful of reallocations.
+/// The string held in 'data' is always NULL-terminated, as long as it has been allocated.
+typedef struct {
+    char *data;         ///< Dynamically allocated buffer.
+    size_t length;      ///< String length, not including the NULL terminator.
+    size_t capacity;    ///< Allocated buffer size.
+} StringBuilder;
+
+/// Makes sure the provided string builder has enough room to hold at least 'extra' more characters, plus a NULL terminator.
+/// Can be used to provide a size hint right before appending a lot of data.
+bool stringBuilderReserve(StringBuilder *sb, size_t extra);
+
+/// Appends a NULL-terminated string to the provided string builder.
+bool stringBuilderAppend(StringBuilder *sb, const char *str);
+
+/// Appends 'len' characters from the provided string to the provided string builder.
+bool stringBuilderAppendWithLength(StringBuilder *sb, const char *str, size_t len);
+
+/// Formats a string and appends it to the provided string builder.
+/// The string is directly formatted into the free space from the buffer, which is only grown if it's not big enough.
+__attribute__((format(printf, 2, 3))) bool stringBuilderAppendFormatted(StringBuilder *sb, const char *fmt, ...);
+
+/// Appends the decimal representation of the provided value to the provided string builder, without using printf.
+bool stringBuilderAppendUnsigned(StringBuilder *sb, u64 value);
+
+/// Appends the hexadecimal representation of the provided value to the provided string builder, without using printf.
+/// The output is left padded with zeroes up to 'min_digits' characters. No '0x' prefix is added.
+bool stringBuilderAppendHex(StringBuilder *sb, u64 value, u8 min_digits, bool uppercase);
+
+/// Returns a pointer to the string held by the provided string builder, which is reset afterwards. The returned pointer must be freed by the caller.
+/// If 'out_length' is provided, the string length is saved to it.
+/// Returns NULL if nothing has been appended to the string builder.
+char *stringBuilderDetach(StringBuilder *sb, size_t *out_length);
+
+/// Frees the string held by the provided string builder and resets it.
+NX_INLINE void stringBuilderFree(StringBuilder *sb)
+{
+    if (!sb) return;
+    if (sb->data) free(sb->data);
+    memset(sb, 0, sizeof(StringBuilder));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STRING_BUILDER_H__ */
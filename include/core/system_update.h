@@ -32,6 +32,9 @@
 extern "C" {
 #endif
 
+/// Opaque prefetch state. Only allocated if systemUpdateEnableDumpContextPrefetch() is successfully called.
+typedef struct SystemUpdatePrefetchContext SystemUpdatePrefetchContext;
+
 typedef struct {
     u64 cur_size;                   ///< Current dump size.
     u64 total_size;                 ///< Total dump size.
@@ -41,6 +44,7 @@ typedef struct {
     Sha256Context sha256_ctx;       ///< SHA-256 hash context. Used to verify dumped NCAs.
     NcaContext **nca_ctxs;          ///< NCA context pointer array for all system update contents. Used to read content data.
     SystemVersionFile version_file; ///< File data from the SystemVersion title.
+    SystemUpdatePrefetchContext *prefetch_ctx;  ///< Prefetch state. NULL if prefetching hasn't been enabled.
 } SystemUpdateDumpContext;
 
 /// Initializes the system update interface.
@@ -64,14 +68,26 @@ char *systemUpdateGetCurrentContentFileNameFromDumpContext(SystemUpdateDumpConte
 /// Reads raw data from the current NCA pointed to by the provided system update dump context.
 /// The internal content offset variable is used to keep track of the current file position.
 /// Use systemUpdateGetCurrentContentFileSizeFromDumpContext() to get the size for the current NCA.
+/// If prefetching has been enabled, data is copied from the prefetch buffer for the current NCA whenever possible.
 bool systemUpdateReadCurrentContentFileFromDumpContext(SystemUpdateDumpContext *ctx, void *out, u64 read_size);
 
+/// Enables multi-file prefetching on the provided system update dump context, which must not have been partially processed.
+/// Worker threads read the upcoming NCAs ahead of time, using a fixed memory budget split into one buffer per NCA. NCAs larger than a single buffer are only partially prefetched.
+/// Reads are transparently served from these buffers by systemUpdateReadCurrentContentFileFromDumpContext(), so callers don't need to change anything else.
+/// Returns false if prefetching couldn't be enabled, in which case the dump context can still be used as usual.
+bool systemUpdateEnableDumpContextPrefetch(SystemUpdateDumpContext *ctx);
+
+/// Stops all prefetch worker threads from the provided system update dump context and frees its prefetch state. Called by systemUpdateFreeDumpContext().
+void systemUpdateDisableDumpContextPrefetch(SystemUpdateDumpContext *ctx);
+
 /// Helper inline functions.
 
 NX_INLINE void systemUpdateFreeDumpContext(SystemUpdateDumpContext *ctx)
 {
     if (!ctx) return;
 
+    systemUpdateDisableDumpContextPrefetch(ctx);
+
     if (ctx->nca_ctxs)
     {
         for(u16 i = 0; i < ctx->content_count; i++)
@@ -0,0 +1,98 @@
+/*
+ * thread_placement.h
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#ifndef __THREAD_PLACEMENT_H__
+#define __THREAD_PLACEMENT_H__
+
+#include <switch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define THREAD_PLACEMENT_CORE_COUNT 3   ///< Cores 0, 1 and 2. Core 3 is reserved for HOS.
+
+/// Pipeline stages that can be placed on a CPU core.
+typedef enum {
+    ThreadPlacementStage_Read    = 0,   ///< Storage / gamecard reads.
+    ThreadPlacementStage_Decrypt = 1,   ///< AES decryption / reencryption and patching.
+    ThreadPlacementStage_Hash    = 2,   ///< Checksum calculation and hash tree verification.
+    ThreadPlacementStage_Write   = 3,   ///< Output file writes.
+    ThreadPlacementStage_Usb     = 4,   ///< USB transfers.
+    ThreadPlacementStage_Count   = 5    ///< Total values supported by this enum.
+} ThreadPlacementStage;
+
+/// Placement statistics for a single pipeline stage. Only covers threads that have already been joined / stages that have already been exited.
+typedef struct {
+    u32 run_count;      ///< Number of times the stage has been placed.
+    u64 wall_ns;        ///< Total time spent by the stage, from placement to join / exit.
+    u64 cpu_ns;         ///< Total CPU time actually used by the stage during that period.
+    u32 core_count[THREAD_PLACEMENT_CORE_COUNT];    ///< Number of times the stage was placed on each core.
+} ThreadPlacementStats;
+
+/// Each pipeline stage is placed on the least loaded core from a per-device profile, which is picked on first use.
+/// The profile lists preferred cores for each stage, and it's built from the process core mask, the core the UI thread runs on and the current launch mode
+/// (applet mode significantly reduces the CPU time available to the UI thread, so its core gets an even bigger penalty).
+/// The core load is calculated using a weight for each stage currently placed on it, which keeps multi-stage pipelines from stacking up on a single core.
+
+/// Returns the core the provided stage would be placed on right now. Doesn't reserve it.
+int threadPlacementGetCore(u8 stage);
+
+/// Creates a thread for the provided pipeline stage using utilsCreateThread(), on the least loaded core from the current profile.
+/// Threads created this way must be joined using threadPlacementJoinThread().
+bool threadPlacementCreateThread(Thread *out_thread, ThreadFunc func, void *arg, u8 stage);
+
+/// Joins a thread created by threadPlacementCreateThread(), then updates the statistics for its stage.
+void threadPlacementJoinThread(Thread *thread);
+
+/// Used to place the current thread (e.g. a task thread) on a core for the duration of a pipeline stage.
+typedef struct {
+    u8 stage;
+    int core;
+    s32 prev_core;
+    u64 prev_mask;
+    u64 start_tick;
+    u64 start_cpu_tick;
+    bool active;
+} ThreadPlacementScope;
+
+/// Moves the current thread to the least loaded core for the provided stage. Its previous affinity is saved to 'out_scope'.
+/// Returns false if the thread couldn't be moved, in which case it keeps running where it was. threadPlacementExitStage() is still safe to call.
+bool threadPlacementEnterStage(u8 stage, ThreadPlacementScope *out_scope);
+
+/// Restores the affinity saved by threadPlacementEnterStage(), then updates the statistics for its stage.
+void threadPlacementExitStage(ThreadPlacementScope *scope);
+
+/// Fills the provided ThreadPlacementStats element with the statistics for the provided stage.
+void threadPlacementGetStats(u8 stage, ThreadPlacementStats *out_stats);
+
+/// Logs the statistics for every stage, along with its CPU usage. A CPU usage well below 100% on a busy stage points to contention:
+/// either the stage shares its core with something else, or it spends most of its time waiting for other stages.
+void threadPlacementLogStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THREAD_PLACEMENT_H__ */
@@ -189,12 +189,22 @@ typedef struct {
 /// Titlekey is also RSA-OAEP unwrapped (if needed) and titlekek-decrypted right away.
 bool tikRetrieveTicketByRightsId(Ticket *dst, const FsRightsId *id, u8 key_generation, bool use_gamecard);
 
+/// Retrieves multiple tickets at once. 'dst', 'ids' and 'key_generations' must all hold 'count' elements.
+/// ES ticket lookups are sorted by ticket.bin offset, and each ES ticket system savefile is read sequentially.
+/// Returns the number of tickets that were successfully retrieved. Tickets that couldn't be retrieved are zeroed out (check them with tikIsValidTicket()).
+u32 tikRetrieveTicketsByRightsIds(Ticket *dst, const FsRightsId *ids, const u8 *key_generations, u32 count, bool use_gamecard);
+
 /// Converts a TikTitleKeyType_Personalized ticket into a TikTitleKeyType_Common ticket and optionally generates a raw certificate chain for the new signature issuer.
 /// Bear in mind the 'size' member from the Ticket parameter will be updated by this function to remove any possible references to ESV1/ESV2 records.
 /// If both 'out_raw_cert_chain' and 'out_raw_cert_chain_size' pointers are provided, raw certificate chain data will be saved to them.
 /// certGenerateRawCertificateChainBySignatureIssuer() is used internally, so the output buffer must be freed by the user.
 bool tikConvertPersonalizedTicketToCommonTicket(Ticket *tik, u8 **out_raw_cert_chain, u64 *out_raw_cert_chain_size);
 
+/// ES ticket system savefiles are kept open between tikRetrieveTicketByRightsId() calls, alongside a rights ID index built from their ticket_list.bin files.
+/// Both are regenerated after staying idle for a while, or if the ES ticket count changes.
+/// This closes them. Must be called before the eMMC BIS storage interface is closed.
+void tikCloseCachedSaveFiles(void);
+
 /// Helper inline functions for signed ticket blobs.
 
 NX_INLINE TikCommonBlock *tikGetCommonBlockFromSignedTicketBlob(void *buf)
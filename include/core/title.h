@@ -81,6 +81,28 @@ typedef struct {
     TitleInfo *aoc_patch_info;  ///< Pointer to a TitleInfo element for the first detected add-on content patch entry matching the provided application ID.
 } TitleUserApplicationData;
 
+/// Output formats supported by titleExportTitleRecords().
+typedef enum {
+    TitleRecordsFormat_Csv   = 0,
+    TitleRecordsFormat_Json  = 1,   ///< JSON array with a single object per title record.
+    TitleRecordsFormat_Count = 2    ///< Total values supported by this enum.
+} TitleRecordsFormat;
+
+/// Write callback used by titleExportTitleRecords(). 'data' isn't NULL-terminated.
+/// Must return false if the provided data couldn't be written, which aborts the export.
+typedef bool (*TitleRecordsWriteCallback)(const void *data, size_t data_size, void *user_data);
+
+/// Used with titleQueryApplicationMetadataEntries() to filter application metadata entries.
+/// All filters are optional. Entries must match every provided filter in order to be returned.
+typedef struct {
+    const char *name;           ///< If provided, only entries with a name that holds this substring are returned. Case-insensitive for ASCII characters.
+    const char *author;         ///< If provided, only entries with a publisher name that holds this substring are returned. Case-insensitive for ASCII characters.
+    u8 storage_id;              ///< NcmStorageId. If set to anything other than NcmStorageId_None or NcmStorageId_Any, only entries with at least one title in this storage are returned.
+    u8 content_meta_type;       ///< NcmContentMetaType. If set to anything other than NcmContentMetaType_Unknown, only entries with at least one title of this type are returned.
+    u64 min_size;               ///< If non-zero, only entries with a combined title size greater than or equal to this value are returned.
+    u64 max_size;               ///< If non-zero, only entries with a combined title size lower than or equal to this value are returned.
+} TitleQueryFilter;
+
 typedef enum {
     TitleNamingConvention_Full             = 0, ///< Individual titles: "{Name} [{Id}][v{Version}][{Type}]".
                                                 ///< Gamecards: "{Name1} [{Id1}][v{Version1}] + ... + {NameN} [{IdN}][v{VersionN}]".
@@ -114,6 +136,13 @@ NcmContentStorage *titleGetNcmStorageByStorageId(u8 storage_id);
 /// The allocated buffer must be freed by the caller using free().
 TitleApplicationMetadata **titleGetApplicationMetadataEntries(bool is_system, u32 *out_count);
 
+/// Returns a pointer to a dynamically allocated array of pointers to the TitleApplicationMetadata entries that match the provided filter, as well as their count.
+/// Entries are picked from the same set returned by titleGetApplicationMetadataEntries(), and they're returned in the same order.
+/// Returns NULL if an error occurs, or if no entries match the provided filter. 'out_count' is set to zero in the latter case.
+/// The secondary indexes used by this function are built on its first call, and rebuilt after each title list update.
+/// The allocated buffer must be freed by the caller using free().
+TitleApplicationMetadata **titleQueryApplicationMetadataEntries(bool is_system, const TitleQueryFilter *filter, u32 *out_count);
+
 /// Returns a pointer to a dynamically allocated array of TitleGameCardApplicationMetadata elements generated from gamecard user titles, as well as their count.
 /// Returns NULL if an error occurs.
 /// The allocated buffer must be freed by the caller using free().
@@ -121,13 +150,16 @@ TitleGameCardApplicationMetadata *titleGetGameCardApplicationMetadataEntries(u32
 
 /// Returns a pointer to a dynamically allocated TitleInfo element with a matching storage ID and title ID. Returns NULL if an error occurs.
 /// If NcmStorageId_Any is used, the first entry with a matching title ID is returned.
+/// The returned data is a shared, read-only snapshot of the title database (including its linked list), which must not be modified.
 /// Use titleFreeTitleInfo() to free the returned data.
 TitleInfo *titleGetTitleInfoEntryFromStorageByTitleId(u8 storage_id, u64 title_id);
 
-/// Frees a dynamically allocated TitleInfo element.
+/// Releases a TitleInfo snapshot. Only pointers returned by the title interface may be passed into this function.
+/// Snapshots remain valid until released, even if the title database is updated in the meantime.
 void titleFreeTitleInfo(TitleInfo **info);
 
 /// Populates a TitleUserApplicationData element with dynamically allocated data using a user application ID.
+/// Just like titleGetTitleInfoEntryFromStorageByTitleId(), populated TitleInfo pointers are shared, read-only snapshots.
 /// Use titleFreeUserApplicationData() to free the populated data.
 bool titleGetUserApplicationData(u64 app_id, TitleUserApplicationData *out);
 
@@ -140,6 +172,12 @@ void titleFreeUserApplicationData(TitleUserApplicationData *user_app_data);
 /// Use titleFreeTitleInfo() to free the returned data.
 TitleInfo *titleGetAddOnContentBaseOrPatchList(TitleInfo *title_info);
 
+/// Parses every Meta NCA from the inserted gamecard's update partition in a single coalesced pass, then returns a linked list of TitleInfo elements (sorted by title ID) for all of its system update titles.
+/// Returned elements use NcmStorageId_GameCard, but their contents are located within the update partition: HashFileSystemPartitionType_Update must be used to access them (e.g. with ncaInitializeContext()).
+/// Returns NULL if an error occurs, if no gamecard is inserted or if the update partition holds no titles.
+/// Use titleFreeTitleInfo() to free the returned data.
+TitleInfo *titleGetGameCardUpdateTitleInfoList(void);
+
 /// Returns true if orphan titles are available.
 /// Orphan titles are patches or add-on contents with no NsApplicationControlData available for their parent user application ID.
 bool titleAreOrphanTitlesAvailable(void);
@@ -151,6 +189,11 @@ TitleInfo **titleGetOrphanTitles(u32 *out_count);
 /// Frees orphan title info data returned by titleGetInfoFromOrphanTitles().
 void titleFreeOrphanTitles(TitleInfo ***orphan_info);
 
+/// Checks if user application metadata that wasn't available in the SD card cache has been retrieved by the background gamecard title info thread.
+/// titleInitialize() only loads cached user application metadata, which means user titles with no cached metadata will only become available after this function returns true.
+/// If this function returns true, data returned by titleGetApplicationMetadataEntries() and titleGetOrphanTitles() must be retrieved again.
+bool titleIsUserTitleInfoUpdated(void);
+
 /// Checks if a gamecard status update has been detected by the background gamecard title info thread (e.g. after a new gamecard has been inserted, of after the current one has been taken out).
 /// If this function returns true and functions such as titleGetTitleInfoEntryFromStorageByTitleId(), titleGetUserApplicationData() or titleGetInfoFromOrphanTitles() have been previously called:
 ///     1. Their returned data must be freed.
@@ -173,6 +216,15 @@ char *titleGenerateGameCardFileName(u8 naming_convention, u8 illegal_char_replac
 /// Returns NULL if an error occurs.
 char *titleGenerateTitleRecordsCsv(size_t *out_csv_size, u32 *out_proc_title_cnt, bool is_system, bool use_gamecard);
 
+/// Streams all available user/system title records through the provided write callback, depending on the 'is_system' argument. 'format' must be a TitleRecordsFormat value.
+/// Records are handed over to the callback in chunks of about 64 KiB as soon as they're ready, so the whole output is never held in memory at once.
+/// 'is_system' and 'use_gamecard' behave just like they do with titleGenerateTitleRecordsCsv(). Orphan title records are also appended in the same way.
+/// 'out_proc_title_cnt' may optionally be provided. If available, it will be used to store the number of processed title records.
+/// The title interface stays locked while the callback runs, so it must not call any other title functions.
+/// If the output size is needed beforehand (e.g. FileWriter, USB transfers), this function can be called twice: the first time with a callback that only adds up 'data_size'.
+/// Returns false if an error occurs, if the write callback fails or if no title records were processed.
+bool titleExportTitleRecords(u8 format, bool is_system, bool use_gamecard, TitleRecordsWriteCallback write_cb, void *user_data, u32 *out_proc_title_cnt);
+
 /// Returns a pointer to a string holding a user-friendly name for the provided NcmStorageId value. Returns NULL if the provided value is invalid.
 const char *titleGetNcmStorageIdName(u8 storage_id);
 
@@ -30,6 +30,14 @@
 extern "C" {
 #endif
 
+/// Holds the results from the speed probe performed on each writable USB Mass Storage device right after it's mounted.
+typedef struct {
+    u32 block_size;     ///< Write block size that yielded the best throughput.
+    u32 queue_depth;    ///< Number of 'block_size' writes that should be kept queued to absorb the worst write stall seen during the probe.
+    u64 write_speed;    ///< Write throughput using 'block_size', in bytes per second.
+    u64 read_speed;     ///< Read throughput using 'block_size', in bytes per second.
+} UmsDeviceProfile;
+
 /// Initializes the USB Mass Storage interface.
 bool umsInitialize(void);
 
@@ -39,10 +47,18 @@ void umsExit(void);
 /// Returns true if USB Mass Storage device info has been updated.
 bool umsIsDeviceInfoUpdated(void);
 
+/// Returns a user-mode event that's signaled each time USB Mass Storage device info is updated, which can be used to wait for device changes on other threads.
+/// If the USB Mass Storage interface hasn't been initialized, this returns NULL.
+UEvent *umsGetDeviceInfoUpdateUserEvent(void);
+
 /// Returns a pointer to a dynamically allocated array of UsbHsFsDevice elements. The allocated buffer must be freed by the caller.
 /// Returns NULL if an error occurs.
 UsbHsFsDevice *umsGetDevices(u32 *out_count);
 
+/// Retrieves the speed probe results for the USB Mass Storage device that holds the provided path (e.g. "ums0:/file.bin").
+/// Returns false if the device can't be found, or if it hasn't been successfully probed (yet).
+bool umsGetDeviceProfileByPath(const char *path, UmsDeviceProfile *out_profile);
+
 /// Unmounts a USB Mass Storage device using a UsbHsFsDevice element.
 /// If successful, USB Mass Storage device info will be automatically reloaded, and the next call to umsIsDeviceInfoUpdated() shall return true.
 bool umsUnmountDevice(const UsbHsFsDevice *device);
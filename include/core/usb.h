@@ -31,7 +31,17 @@
 extern "C" {
 #endif
 
-#define USB_TRANSFER_BUFFER_SIZE    0x800000    /* 8 MiB. */
+#define USB_TRANSFER_BUFFER_SIZE    0x800000    /* 8 MiB. The host device may ask for smaller transfers at session start, in which case larger data chunks are split accordingly. */
+#define USB_MAX_PENDING_TRANSFERS   4           /* Maximum number of asynchronous file data transfers that can be in flight at the same time. The host device may ask for less. */
+
+#define USB_FILE_BATCH_MAX_ENTRY_COUNT  0x2000  /* Maximum number of file entries that can be sent with a single usbSendFileBatch() call. */
+#define USB_NSP_LAYOUT_MAX_ENTRY_COUNT  0x100   /* Maximum number of regions that can be sent with a single usbStartNspLayout() call, including the NSP header. */
+
+#define USB_LINK_BENCHMARK_MIN_CHUNK_SIZE   0x40000     /* 256 KiB. Smallest chunk size tried by usbRunLinkBenchmarkSweep(). */
+
+#define USB_FILE_DELTA_BLOCK_SIZE           0x100000    /* 1 MiB. Granularity used to compare file data against the file held by the host device under file delta mode. */
+#define USB_FILE_DELTA_HASH_BATCH_COUNT     8           /* Maximum number of block checksums that can be retrieved with a single usbGetFileDeltaHashes() call. */
+#define USB_FILE_DELTA_BATCH_SIZE           (USB_FILE_DELTA_BLOCK_SIZE * USB_FILE_DELTA_HASH_BATCH_COUNT)
 
 /// Used to indicate the USB speed selected by the host device.
 typedef enum {
@@ -42,13 +52,81 @@ typedef enum {
     UsbHostSpeed_Count      = 4     ///< Total values supported by this enum.
 } UsbHostSpeed;
 
+/// Checksum types that can be calculated by the host device on our behalf.
+typedef enum {
+    UsbChecksumType_None   = 0,
+    UsbChecksumType_Crc32  = 1,
+    UsbChecksumType_Sha256 = 2,
+    UsbChecksumType_Count  = 3  ///< Total values supported by this enum.
+} UsbChecksumType;
+
+/// Used by usbSendFileDataAsync() to signal the completion of an asynchronous file data transfer. 'success' is false if the transfer failed or was cancelled.
+/// Callbacks are issued in submission order from whichever thread is calling into the USB interface at that moment, and must not call any USB interface functions.
+typedef void (*UsbFileDataTransferCallback)(void *user_data, bool success);
+
+/// Used by usbSendFileBatch() to describe a single file entry.
+typedef struct {
+    u64 file_size;
+    const char *filename;   ///< Same conventions as the filename passed to usbSendFileProperties().
+} UsbFileBatchEntry;
+
+/// Used by usbStartNspLayout() to describe a single NSP region. The first one always holds the NSP header, while the rest of them hold the NSP file entries, in order.
+typedef struct {
+    u64 offset;             ///< Relative to the start of the NSP.
+    u64 size;
+} UsbNspLayoutEntry;
+
+/// Holds the properties of an incomplete file left behind on the host device by an interrupted file transfer. Filled by usbGetFileResumeInfo().
+typedef struct {
+    u64 offset;             ///< Number of bytes from the file already held by the host device. Zero if there's nothing to resume.
+    u32 crc;                ///< CRC32 checksum calculated over all the data up to 'offset'.
+    u32 check_size;         ///< Number of bytes right before 'offset' covered by 'check_hash'. Never exceeds 'offset'.
+    u8 check_hash[0x20];    ///< SHA-256 checksum calculated over the last 'check_size' bytes before 'offset'. Used to make sure the data held by the host device matches ours.
+} UsbFileResumeInfo;
+
+/// File data transfer statistics. Used to find out which side is slowing file data transfers down. All times are expressed in nanoseconds.
+/// Counters are cumulative, and they're only reset by usbResetTransferStats() or each time a new USB session is established.
+typedef struct {
+    u64 chunk_count;            ///< Number of file data chunks sent to the host device. Data chunks larger than the negotiated chunk size are split into multiple chunks.
+    u64 chunk_size;             ///< Total size of all file data chunks, as sent through the USB endpoint (e.g. compressed frames are accounted for using their actual size).
+    u64 total_latency;          ///< Sum of all submit -> complete latencies. Asynchronous chunks are considered complete as soon as we're done waiting for them.
+    u64 min_latency;
+    u64 max_latency;
+    u64 stall_count;            ///< Number of times a producer had to wait for an in-flight chunk to complete before submitting a new one.
+    u64 stall_time;             ///< Total time spent by producers waiting for in-flight chunks to complete.
+    u64 async_chunk_count;      ///< Number of file data chunks submitted asynchronously.
+    u64 queue_depth_sum;        ///< Sum of the number of in-flight chunks right after each asynchronous submission. Divide it by 'async_chunk_count' to get the average queue depth.
+    u32 max_queue_depth;        ///< Max number of in-flight chunks.
+    u8 reserved[0x4];
+} UsbTransferStats;
+
+/// USB link benchmark results. Filled by usbRunLinkBenchmark(). All times are expressed in nanoseconds.
+/// Console-side latencies are measured from the moment each chunk is posted until we're done waiting for it (or until it has been read back, under echo mode), so they're upper bounds.
+typedef struct {
+    u64 data_size;
+    u32 chunk_size;
+    u32 queue_depth;
+    bool echo;
+    u8 reserved[0x3];
+    u32 echo_mismatch_count;    ///< Number of chunks whose echoed data didn't match the data we sent. Always zero if 'echo' is false.
+    u64 elapsed_time;           ///< Time spent by the console, from the first posted chunk until the last completed one.
+    u64 min_latency;
+    u64 max_latency;
+    u64 avg_latency;
+    u64 host_elapsed_time;      ///< Same as 'elapsed_time', but measured by the host device.
+    u64 host_min_latency;
+    u64 host_max_latency;
+    u64 host_avg_latency;
+} UsbLinkBenchmarkResult;
+
 /// Initializes the USB interface, input and output endpoints and allocates an internal transfer buffer.
 bool usbInitialize(void);
 
 /// Closes the USB interface, input and output endpoints and frees the transfer buffer.
 void usbExit(void);
 
-/// Returns a pointer to a dynamically allocated, page aligned memory buffer that's suitable for USB transfers.
+/// Returns a pointer to a dynamically allocated, page aligned memory buffer that's suitable for USB transfers. It must be freed by the caller.
+/// Large I/O buffers should be leased from the shared buffer pool instead (see bufferPoolLease()), which hands out buffers with the same alignment.
 void *usbAllocatePageAlignedBuffer(size_t size);
 
 /// Used to check if the console has been connected to a USB host device and if a valid USB session has been established.
@@ -59,8 +137,22 @@ u8 usbIsReady(void);
 /// 'file_size' may be zero if an empty file shall be created, in which case no file data transfer will be necessary.
 /// Calling this function before finishing an ongoing file data transfer will result in an error.
 /// Under NSP transfer mode, this function must be called right before transferring data from each NSP file entry to the host device, which should in turn write it all to the same output file.
+/// If the "usb_compression" configuration setting is enabled and the host device supports it, file data is transparently sent using LZ4-compressed frames.
 bool usbSendFileProperties(u64 file_size, const char *filename);
 
+/// Same as usbSendFileProperties(), but also asks the host device to calculate a checksum over the file data as it arrives, which can then be checked with usbVerifyFileChecksum().
+/// Saves us from hashing data that's only going to be verified. 'checksum_type' must be a value from the UsbChecksumType enum. UsbChecksumType_None behaves just like usbSendFileProperties().
+bool usbSendFilePropertiesWithChecksum(u64 file_size, const char *filename, u8 checksum_type);
+
+/// Asks the host device about an incomplete file with the provided properties, left behind by an interrupted file transfer (e.g. if the console was disconnected).
+/// 'out' is zeroed if there's nothing to resume. Not available under NSP transfer mode, nor while a file data transfer is ongoing.
+/// Data held by the host device must be validated by the caller using 'check_hash' before resuming the file transfer with usbSendFilePropertiesWithResumeOffset().
+bool usbGetFileResumeInfo(u64 file_size, const char *filename, UsbFileResumeInfo *out);
+
+/// Same as usbSendFileProperties(), but makes the host device keep the first 'resume_offset' bytes from the incomplete file it already holds.
+/// 'resume_offset' must match the offset returned by usbGetFileResumeInfo(), and must be smaller than 'file_size'. Only the remaining file data must then be transferred.
+bool usbSendFilePropertiesWithResumeOffset(u64 file_size, const char *filename, u64 resume_offset);
+
 /// Sends NSP properties to the host device and enables NSP transfer mode. If needed, it must be called before usbSendFileData().
 /// Both 'nsp_size' and 'nsp_header_size' must be greater than zero. 'nsp_size' must also be greater than 'nsp_header_size'.
 /// Calling this function after NSP transfer mode has already been enabled will result in an error.
@@ -73,14 +165,108 @@ bool usbSendNspProperties(u64 nsp_size, const char *filename, u32 nsp_header_siz
 /// Calling this function if there's no remaining data to transfer will result in an error.
 bool usbSendFileData(const void *data, u64 data_size);
 
+/// Same as usbSendFileData(), but returns as soon as the data chunk has been posted to the USB endpoint, so the next chunk can be queued while the previous one is still in flight.
+/// Up to USB_MAX_PENDING_TRANSFERS transfers (or the number negotiated with the host device, if lower) may be in flight at the same time. If that limit has been reached, this function waits for the oldest one to complete first.
+/// 'data' must be page aligned (e.g. allocated with usbAllocatePageAlignedBuffer()) and must remain untouched until 'callback' is issued for it. 'callback' may be NULL.
+/// The last data chunk for a file is always sent synchronously, after all pending chunks, and its callback is issued before this function returns.
+/// 'callback' is only issued for chunks accepted by this function (i.e. if it returns true). Every other USB interface function waits for pending chunks before doing anything else.
+bool usbSendFileDataAsync(const void *data, u64 data_size, UsbFileDataTransferCallback callback, void *user_data);
+
+/// Waits for all pending asynchronous file data transfers to complete. Returns false if any of them failed, in which case the ongoing file transfer is aborted.
+bool usbFlushFileDataTransfers(void);
+
 /// Used to gracefully cancel an ongoing file transfer. The current USB session is kept alive.
 void usbCancelFileTransfer(void);
 
+/// Interrupts the file data transfer a different thread may be blocked on, as well as every pending asynchronous transfer, without waiting for them.
+/// Doesn't lock the USB interface, so it can be safely called from any thread (e.g. the UI thread, right after cancelling a task). The ongoing file transfer fails right away.
+/// usbCancelFileTransfer() must still be called afterwards to let the host device know about it.
+void usbAbortFileTransfer(void);
+
 /// Sends NSP header data to the host device, making it rewind the NSP file pointer to write this data, essentially finishing the NSP transfer process.
 /// Must be called after the data from all NSP file entries has been transferred using both usbSendNspProperties() and usbSendFileData() calls.
 /// If the NSP header size is aligned to the endpoint max packet size, the host device should expect a Zero Length Termination (ZLT) packet.
 bool usbSendNspHeader(const void *nsp_header, u32 nsp_header_size);
 
+/// Sends a reference to data that was already transferred to the host device as part of a previous, complete file. Only valid under NSP transfer mode.
+/// Can be used instead of usbSendFileProperties() + usbSendFileData() for a NSP file entry. The host device should copy 'file_size' bytes from 'src_filename', starting at 'src_offset'.
+/// 'src_filename' follows the same conventions as the filename passed to usbSendNspProperties(). No file data transfer follows this call.
+bool usbSendFileReference(u64 file_size, const char *filename, const char *src_filename, u64 src_offset);
+
+/// Sends the layout from a NSP to the host device and enables NSP layout mode, in which the host device assembles the NSP on its own.
+/// The host device preallocates the whole NSP, then writes the data sent for each region straight into its final offset. Thus, regions may be sent in any order.
+/// 'entries' must cover the whole NSP without gaps, in order. The first entry must start at offset zero and hold the NSP header.
+/// NSP layout mode ends on its own as soon as the data for every region has been sent. Not available under NSP transfer mode.
+bool usbStartNspLayout(u64 nsp_size, const char *filename, const UsbNspLayoutEntry *entries, u32 entry_count);
+
+/// Starts a data transfer stage for 'data_size' bytes from the NSP region with index 'entry_idx', starting at 'entry_offset'. Only valid under NSP layout mode.
+/// The data must then be transferred using usbSendFileData() / usbSendFileDataAsync() calls, just like with a file sent with usbSendFileProperties().
+/// Each region may be split across multiple calls, as long as no byte is sent twice. Calls for different regions may be freely interleaved.
+/// If 'checksum_type' isn't UsbChecksumType_None, 'entry_offset' must be zero and the host device calculates a checksum over the whole region, as long as the rest of its data is sent in order.
+/// That checksum can be checked with usbVerifyFileChecksum() right after the last data chunk from the region has been transferred.
+bool usbSendNspLayoutData(u32 entry_idx, u64 entry_offset, u64 data_size, u8 checksum_type);
+
+/// Same as usbSendFileReference(), but the referenced data is used to fill the whole NSP region with index 'entry_idx'. Only valid under NSP layout mode.
+/// Must not be used for a region that already got any data through usbSendNspLayoutData().
+bool usbSendNspLayoutReference(u32 entry_idx, const char *entry_name, const char *src_filename, u64 src_offset);
+
+/// Enables file delta mode, in which only the parts of a file that differ from an existing file with the same name held by the host device are transferred.
+/// The host device keeps its existing file (creating an empty one if there's none) and resizes it to 'file_size'. Not available under NSP transfer mode, nor under NSP layout mode.
+/// The file must then be processed in USB_FILE_DELTA_BLOCK_SIZE blocks: usbGetFileDeltaHashes() retrieves the SHA-256 checksums calculated by the host device over the blocks it holds,
+/// and usbSendFileDeltaData() is used to send the blocks whose checksums don't match ours. usbEndFileDelta() must be called once the whole file has been processed.
+/// Calling usbCancelFileTransfer() at any point disables file delta mode, and makes the host device delete the file.
+bool usbStartFileDelta(u64 file_size, const char *filename);
+
+/// Retrieves the SHA-256 checksums for 'block_count' blocks, starting at block 'block_idx'. Only valid under file delta mode.
+/// 'block_count' must not exceed USB_FILE_DELTA_HASH_BATCH_COUNT. 'out_hashes' must be at least 'block_count' * SHA256_HASH_SIZE bytes long.
+/// Blocks the host device didn't fully hold before file delta mode was enabled get zeroed checksums, so they never match. The last block may be shorter than USB_FILE_DELTA_BLOCK_SIZE.
+/// Checksums must be retrieved before sending any data for the blocks they cover.
+bool usbGetFileDeltaHashes(u64 block_idx, u32 block_count, u8 *out_hashes);
+
+/// Starts a data transfer stage for 'data_size' bytes, which the host device writes at file offset 'offset'. Only valid under file delta mode.
+/// The data must then be transferred using usbSendFileData() / usbSendFileDataAsync() calls, just like with a file sent with usbSendFileProperties().
+bool usbSendFileDeltaData(u64 offset, u64 data_size);
+
+/// Disables file delta mode. The host device closes the file, which is complete at this point.
+bool usbEndFileDelta(void);
+
+/// Sends the properties for multiple files at once. Not available under NSP transfer mode, nor under NSP layout mode.
+/// Meant to be used during extracted filesystem dumps with lots of small files, since a single command + status round trip takes care of the whole batch.
+/// The data from all file entries must then be sent in order using usbSendFileData() / usbSendFileDataAsync() calls, as if it were a single file whose size is the sum of all file sizes.
+/// Empty files are allowed. If all file entries are empty, no file data transfer will be necessary.
+/// The host device should split the incoming data on its own, creating each file as soon as its data starts to arrive.
+bool usbSendFileBatch(const UsbFileBatchEntry *entries, u32 entry_count);
+
+/// Asks the host device to compare the checksum it calculated over the last file sent with usbSendFilePropertiesWithChecksum() against the provided one.
+/// Must be called right after all the data from that file has been transferred. 'checksum' must point to a u32 (CRC32) or a SHA256_HASH_SIZE long buffer (SHA-256).
+/// Returns false if a communication error occurs. Otherwise, 'out_match' is set to true if both checksums match.
+bool usbVerifyFileChecksum(u8 checksum_type, const void *checksum, bool *out_match);
+
+/// Fills the provided UsbTransferStats pointer with the statistics from the current USB session (or from the last one, if the console was disconnected).
+/// Summaries are also logged each time a file transfer is completed, and each time a USB session ends.
+void usbGetTransferStats(UsbTransferStats *out);
+
+/// Resets all file data transfer statistics from the current USB session.
+void usbResetTransferStats(void);
+
+/// Measures the USB link throughput by streaming 'data_size' bytes of generated data to the host device, using 'chunk_size' bytes long transfers with up to 'queue_depth' of them in flight.
+/// 'chunk_size' must be a multiple of 4 KiB no larger than USB_TRANSFER_BUFFER_SIZE, 'data_size' must be a multiple of 'chunk_size', and 'queue_depth' must not exceed USB_MAX_PENDING_TRANSFERS.
+/// If 'echo' is true, the host device writes each chunk back to us and 'queue_depth' is ignored, which makes it possible to measure round trip latencies and to check data integrity.
+/// Results are logged and saved to 'out'. Not available while a file transfer is ongoing. Nothing is written to disk by the host device.
+bool usbRunLinkBenchmark(u64 data_size, u32 chunk_size, u32 queue_depth, bool echo, UsbLinkBenchmarkResult *out);
+
+/// Runs usbRunLinkBenchmark() in discard mode for every power of two chunk size between USB_LINK_BENCHMARK_MIN_CHUNK_SIZE and USB_TRANSFER_BUFFER_SIZE, and for every power of two queue depth up to USB_MAX_PENDING_TRANSFERS.
+/// 'data_size' is rounded up to each chunk size. The results with the highest sustained throughput are saved to 'out_best', preferring smaller chunk sizes and queue depths if the difference is negligible.
+/// Meant to be used to pick sensible defaults for the file data chunk size and the number of in-flight chunks negotiated with the host device.
+bool usbRunLinkBenchmarkSweep(u64 data_size, UsbLinkBenchmarkResult *out_best);
+
+/// Returns the sustained throughput from a link benchmark run, in MiB/s. If 'host' is true, the measurements from the host device are used.
+NX_INLINE double usbGetLinkBenchmarkThroughput(const UsbLinkBenchmarkResult *result, bool host)
+{
+    u64 elapsed_time = (result ? (host ? result->host_elapsed_time : result->elapsed_time) : 0);
+    return (elapsed_time ? (((double)result->data_size / (double)elapsed_time) * (1000000000.0 / 1048576.0)) : 0.0);
+}
+
 /// Informs the host device that an extracted filesystem dump (e.g. HFS, PFS, RomFS) is about to begin.
 bool usbStartExtractedFsDump(u64 extracted_fs_size, const char *extracted_fs_root_path);
 
@@ -103,9 +103,37 @@
 #define PROD_KEYS_FILE_PATH             DEVOPTAB_SDMC_DEVICE HBMENU_BASE_PATH "prod.keys"               /* Retail unit keys. */
 #define DEV_KEYS_FILE_PATH              DEVOPTAB_SDMC_DEVICE HBMENU_BASE_PATH "dev.keys"                /* Development unit keys. */
 
+#define NOINTRO_INDEX_PATH              DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "nointro.bin"                 /* Offline No-Intro checksum index. */
+#define NOINTRO_INDEX_TMP_PATH          NOINTRO_INDEX_PATH ".tmp"
+
+#define DUMP_QUEUE_PATH                 DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "dump_queue.bin"              /* Persistent batch dump queue. */
+#define DUMP_QUEUE_TMP_PATH             DUMP_QUEUE_PATH ".tmp"
+
+#define RSA_SIG_CACHE_PATH              DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "rsa_sig_cache.bin"           /* Persistent RSA signature verification cache. */
+#define RSA_SIG_CACHE_TMP_PATH          RSA_SIG_CACHE_PATH ".tmp"
+
+#define TITLE_METADATA_CACHE_PATH       DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "title_metadata_cache.bin"    /* Persistent user application metadata cache. */
+#define TITLE_METADATA_CACHE_TMP_PATH   TITLE_METADATA_CACHE_PATH ".tmp"
+
+#define KEYSET_CACHE_PATH               DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "keyset_cache.bin"            /* Encrypted derived keyset cache. */
+#define KEYSET_CACHE_TMP_PATH           KEYSET_CACHE_PATH ".tmp"
+
+#define LAFW_CACHE_PATH                 DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "lafw_cache.bin"              /* Persistent Lotus ASIC firmware blob cache. */
+#define LAFW_CACHE_TMP_PATH             LAFW_CACHE_PATH ".tmp"
+
+#define OUTPUT_BENCHMARK_PATH           DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "output_benchmark.bin"        /* Persistent output storage benchmark results. */
+#define OUTPUT_BENCHMARK_TMP_PATH       OUTPUT_BENCHMARK_PATH ".tmp"
+
+#define TRACE_FILE_PATH                 DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "trace.json"                  /* Chrome trace event JSON file. Only written if tracing is enabled at build time. */
+#define TRACE_CRASH_FILE_PATH           DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "crash_trace.json"            /* Most recent tracing spans, written by the exception handler. Only written if tracing is enabled at build time. */
+#define CRASH_SNAPSHOT_PATH             DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "crash_snapshot.txt"          /* Pipeline stage states and I/O counters, written by the exception handler. */
+
 #define LOG_FILE_NAME                   APP_TITLE ".log"
 #define LOG_BUF_SIZE                    0x400000                                                        /* 4 MiB. */
 #define LOG_FORCE_FLUSH                 0                                                               /* Forces a log buffer flush each time the logfile is written to. */
+#define LOG_RING_SIZE                   0x100000                                                        /* 1 MiB. Must be a power of two. */
+#define LOG_FLUSH_INTERVAL              100000000ULL                                                    /* 100 ms, in nanoseconds. Used by the log flush thread. */
+#define LOG_DEFERRED_FORMAT             1                                                               /* Defers log string prefix generation (timestamp, function name) until log data is written to the logfile. */
 
 #define BIS_FAT_PARTITION_COUNT         4
 
@@ -117,6 +145,7 @@
 
 #define REPEATING_TASK_INTERVAL         250                                                             /* 250 milliseconds. */
 #define DATA_TRANSFER_TASK_INTERVAL     100                                                             /* 100 milliseconds. */
+#define USER_EVENT_TASK_INTERVAL        50                                                              /* 50 milliseconds. Only used to consume flags latched by UserEventWaiter threads. */
 
 #define HTTP_USER_AGENT                 APP_TITLE "/" APP_VERSION " (Nintendo Switch)"
 #define HTTP_CONNECT_TIMEOUT            10L                                                             /* 10 seconds. */
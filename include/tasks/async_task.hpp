@@ -31,6 +31,8 @@
 #include <future>
 #include <mutex>
 
+#include "thread_pool.hpp"
+
 namespace nxdt::tasks
 {
     /* Used by AsyncTask to throw exceptions whenever required. */
@@ -72,6 +74,7 @@ namespace nxdt::tasks
             Progress m_progress{};
             bool m_cancelled = false, m_rethrowException = false;
             std::exception_ptr m_exceptionPtr{};
+            CancelToken m_cancelToken{};
 
             /* Runs on the calling thread after DoInBackground() finishes execution. */
             void Finish(Result&& result)
@@ -151,6 +154,13 @@ namespace nxdt::tasks
                 this->m_progress = progress;
             }
 
+            /* Returns the cancellation token used by this task. Bound to the asynchronous task thread while DoInBackground() runs, which lets long core operations return early. */
+            /* Tasks that spawn their own worker threads may bind it to them using CANCEL_TOKEN_SCOPE(). */
+            CancelToken *GetCancelToken(void) noexcept
+            {
+                return &(this->m_cancelToken);
+            }
+
             /* Returns the current progress. May run on both threads. */
             Progress GetProgress(void)
             {
@@ -171,6 +181,9 @@ namespace nxdt::tasks
 
                 /* Update cancel flag. */
                 this->m_cancelled = true;
+
+                /* Cancel any in-progress core operation. */
+                cancelTokenCancel(&(this->m_cancelToken));
             }
 
             /* Starts the asynchronous task. Runs on the calling thread. */
@@ -196,8 +209,10 @@ namespace nxdt::tasks
                 /* Run pre-execution callback. */
                 this->OnPreExecute();
 
-                /* Start asynchronous task on a new thread. */
-                this->m_future = std::async(std::launch::async, [this](const Params&... params) -> Result {
+                auto task_func = [this](const Params&... params) -> Result {
+                    /* Bind our cancellation token to the asynchronous task thread. Shared worker threads get it unbound as soon as we're done. */
+                    CANCEL_TOKEN_SCOPE(&(this->m_cancelToken));
+
                     /* Catch any exceptions thrown by the asynchronous task. */
                     try {
                         return this->PostResult(this->DoInBackground(params...));
@@ -209,7 +224,14 @@ namespace nxdt::tasks
                     }
 
                     return {};
-                }, params...);
+                };
+
+                /* Start asynchronous task on a shared worker thread. Parameters are copied, just like std::async() does. */
+                /* Tasks use the default process core and the same priority as std::async() threads, so they behave just like before. */
+                this->m_future = ThreadPool::GetInstance().Submit([task_func, params...]() -> Result { return task_func(params...); }, -2, ThreadPriority::High);
+
+                /* Fall back to a new thread if the job couldn't be scheduled. */
+                if (!this->m_future.valid()) this->m_future = std::async(std::launch::async, task_func, params...);
 
                 return *this;
             }
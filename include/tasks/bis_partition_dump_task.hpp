@@ -0,0 +1,130 @@
+/*
+ * bis_partition_dump_task.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#ifndef __BIS_PARTITION_DUMP_TASK_HPP__
+#define __BIS_PARTITION_DUMP_TASK_HPP__
+
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+
+#include "data_transfer_task.hpp"
+#include "../utils/file_writer.hpp"
+#include "../core/bis_storage.h"
+
+namespace nxdt::tasks
+{
+    typedef std::optional<std::string> BisPartitionDumpTaskError;
+
+    /* Generates a raw image dump out of an eMMC BIS partition. Data returned by the FS sysmodule is already decrypted. */
+    /* If unallocated clusters are skipped, their data is never read from the eMMC and zeroes are written in their place. */
+    /* If checksum calculation is enabled, the SHA-256 checksum for the partition image is calculated by the hash thread while the dump is in progress. */
+    class BisPartitionDumpTask: public DataTransferTask<BisPartitionDumpTaskError, std::string, u8, bool, bool>
+    {
+        private:
+            /* Number of page-aligned buffers shared by the read, write and hash threads. */
+            static constexpr size_t DumpBufferCount = 2;
+
+            /* Used to hold a single partition image block within the dump buffer ring. */
+            typedef struct {
+                void *data;         ///< Page-aligned buffer leased with bufferPoolLease().
+                size_t size;        ///< Block size.
+                size_t offset;      ///< Block offset, relative to the start of the partition.
+                size_t data_size;   ///< Number of bytes actually read from the eMMC. Any remaining bytes were zeroed out.
+            } DumpBuffer;
+
+            std::mutex task_mtx;
+            bool calculate_checksum = false;
+            u8 image_hash[SHA256_HASH_SIZE] = {0};
+            Sha256Context image_sha256_ctx{};
+
+            /* Cluster allocation bitmap. Only populated if unallocated clusters are supposed to be skipped. */
+            BisStorageClusterBitmap cluster_bitmap{};
+
+            /* Dump buffer ring. Filled by the read thread (DoInBackground), then consumed in parallel by the write thread and the hash thread. */
+            /* Monotonic block counters are used to keep track of each stage. A ring slot can only be reused after both consumers are done with it. */
+            std::mutex ring_mtx;
+            std::condition_variable ring_read_cv, ring_consume_cv;
+            std::array<DumpBuffer, DumpBufferCount> ring{};
+            size_t ring_committed_cnt = 0, ring_written_cnt = 0, ring_hashed_cnt = 0;
+            bool read_finished = false, write_failed = false;
+            size_t failed_write_size = 0, failed_write_offset = 0;
+
+            nxdt::utils::FileWriter *file = nullptr;
+            DataTransferProgress progress{};
+
+            /* Write thread function. Writes every filled block from the dump buffer ring to the output file and publishes the transfer progress. */
+            static void WriteThreadFunc(void *arg);
+
+            /* Hash thread function. Updates the SHA-256 checksum for the partition image with every filled block from the dump buffer ring. */
+            static void HashThreadFunc(void *arg);
+
+            /* Reads a partition image block into the provided buffer. Unallocated cluster runs are zeroed out instead of being read, if the cluster bitmap is available. */
+            /* Returns the number of bytes actually read from the eMMC through 'data_size'. */
+            bool ReadPartitionBlock(u8 bis_partition_id, u8 *buf, size_t offset, size_t size, size_t& data_size);
+
+            /* Called by the read thread to wait for an empty ring slot. Returns nullptr if the write thread failed. */
+            DumpBuffer *GetEmptyDumpBuffer(void);
+
+            /* Called by the read thread to hand a filled ring slot over to the consumer threads. */
+            void CommitDumpBuffer(void);
+
+            /* Called by the read thread to signal the consumer threads there's no more data to be read. */
+            void FinishDumpBufferRing(void);
+
+            /* Called by a consumer thread to wait for the next filled ring slot. Returns nullptr if there's nothing left to consume. */
+            DumpBuffer *GetFilledDumpBuffer(size_t& consumed_cnt);
+
+            /* Called by a consumer thread to release a ring slot. */
+            void ReleaseDumpBuffer(size_t& consumed_cnt);
+
+            /* Updates the buffer count for each stage within the pipeline stats object. Must be called with the ring mutex held. */
+            void UpdatePipelineStats(void);
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(BisPartitionDumpTask);
+            NON_MOVEABLE(BisPartitionDumpTask);
+
+            /* Runs in the background thread. */
+            BisPartitionDumpTaskError DoInBackground(const std::string& output_path, const u8& bis_partition_id, const bool& skip_unallocated,
+                                                     const bool& calculate_checksum) override final;
+
+        public:
+            BisPartitionDumpTask() = default;
+
+            /* Copies the SHA-256 checksum calculated over the partition image to the provided buffer, which must be at least SHA256_HASH_SIZE bytes long. */
+            /* Returns false if checksum calculation wasn't enabled, if the task hasn't finished yet or if the task was cancelled. */
+            ALWAYS_INLINE bool GetImageHash(u8 *out)
+            {
+                std::scoped_lock lock(this->task_mtx);
+                if (!out || !this->calculate_checksum || !this->IsFinished() || this->IsCancelled()) return false;
+                memcpy(out, this->image_hash, sizeof(this->image_hash));
+                return true;
+            }
+    };
+}
+
+#endif  /* __BIS_PARTITION_DUMP_TASK_HPP__ */
@@ -0,0 +1,185 @@
+/*
+ * content_verify_task.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __CONTENT_VERIFY_TASK_HPP__
+#define __CONTENT_VERIFY_TASK_HPP__
+
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+#include <vector>
+
+#include "data_transfer_task.hpp"
+#include "../core/title.h"
+#include "../core/cnmt.h"
+
+namespace nxdt::tasks
+{
+    typedef std::optional<std::string> ContentVerifyTaskError;
+
+    /* Holds a single title to verify. */
+    typedef struct {
+        u8 storage_id;  ///< NcmStorageId.
+        u64 title_id;
+    } ContentVerifyTarget;
+
+    typedef enum : u8 {
+        ContentVerifyStatus_Skipped = 0,    ///< Check not performed (e.g. missing titlekey, or no FS sections with a supported hash layer).
+        ContentVerifyStatus_Passed  = 1,
+        ContentVerifyStatus_Failed  = 2
+    } ContentVerifyStatus;
+
+    /* Holds the verification results for a single NCA. */
+    /* Titles that couldn't be processed at all are reported using a single entry with a zeroed content ID. */
+    typedef struct {
+        u8 storage_id;          ///< NcmStorageId.
+        u64 title_id;
+        NcmContentId content_id;
+        u8 content_type;        ///< NcmContentType.
+        u8 id_offset;
+        u64 content_size;
+        u8 hash_status;         ///< ContentVerifyStatus. SHA-256 checksum check against the CNMT (or the content ID, for Meta NCAs).
+        u8 fs_status;           ///< ContentVerifyStatus. Hash tree check for every FS section with a HierarchicalSha256 or HierarchicalIntegrity layer.
+        std::string error;      ///< Empty if both checks either passed or were skipped.
+    } ContentVerifyResult;
+
+    /* Verifies NCAs from the provided titles by reading them the same way they're read while generating NSP dumps. Nothing is written anywhere. */
+    /* Each NCA is checked against the SHA-256 checksum from its CNMT record, while its FS sections are checked against their hash trees. */
+    /* Raw NCA data is only read once: hashing and hash tree verification take place on separate threads, using the same buffers filled by the read loop. */
+    /* Verifying every title from an inserted gamecard covers the contents from its XCI image. */
+    class ContentVerifyTask: public DataTransferTask<ContentVerifyTaskError, std::vector<ContentVerifyTarget>>
+    {
+        private:
+            /* Number of page-aligned buffers shared by all pipeline stages. Scaled down according to the memory budget, but never below VerifyBufferMinCount. */
+            static constexpr size_t VerifyBufferCount = 4;
+            static constexpr size_t VerifyBufferMinCount = 2;
+
+            /* NCA data flows through these stages in order. The read stage runs on the task thread, while every other stage runs on its own thread. */
+            typedef enum : u8 {
+                Read  = 0,
+                Hash  = 1,  ///< Calculates the SHA-256 checksum over raw NCA data.
+                Fs    = 2,  ///< Decrypts raw NCA data in place, then verifies it against the FS section hash trees.
+                Count = 3
+            } VerifyStage;
+
+            /* Maps each verify stage to the pipeline stage reported to the UI. */
+            static constexpr std::array<DataTransferStage, VerifyStage::Count> VerifyStageMap = { DataTransferStage_Read, DataTransferStage_Hash, DataTransferStage_Decrypt };
+
+            /* Used to hold a single NCA block within the verify buffer ring. */
+            typedef struct {
+                void *data;         ///< Page-aligned buffer leased with bufferPoolLease().
+                size_t size;        ///< Block size.
+                size_t offset;      ///< Block offset, relative to the start of the NCA.
+                u32 nca_idx;        ///< NCA context index.
+            } VerifyBuffer;
+
+            std::mutex task_mtx, result_mtx;
+            std::vector<ContentVerifyResult> results{};
+            size_t failed_count = 0;
+
+            /* Set while processing each title. */
+            TitleInfo *title_info = nullptr;
+            Ticket tik{};
+            std::vector<NcaContext> nca_ctx{};
+            std::vector<size_t> nca_result_idx{};
+            std::vector<std::array<bool, NCA_FS_HEADER_COUNT>> nca_fs_verify{};
+            ContentMetaContext cnmt_ctx{};
+
+            /* Verify buffer ring. Works just like the dump buffer ring from NspDumper. */
+            std::mutex ring_mtx;
+            std::condition_variable ring_cv;
+            std::array<VerifyBuffer, VerifyBufferCount> ring{};
+            size_t ring_depth = VerifyBufferCount;  ///< Number of ring slots actually in use.
+            std::array<size_t, VerifyStage::Count> ring_stage_cnt{};
+            bool read_finished = false;
+
+            DataTransferProgress progress{};
+
+            /* Verifies all NCAs from a single title. Returns false if the task was cancelled. */
+            bool VerifyTitle(const ContentVerifyTarget& target);
+
+            /* Frees all the data allocated by VerifyTitle(). Must only be called once all pipeline stages are done with the current title. */
+            void FreeTitleData(void);
+
+            /* Enables verified reads for every FS section from the provided NCA with a supported hash layer. Returns false if a hash layer couldn't be verified. */
+            bool EnableFsSectionVerification(u32 nca_idx);
+
+            /* Hash thread function. Calculates the SHA-256 checksum over every NCA block, then validates it once each NCA is complete. */
+            static void HashThreadFunc(void *arg);
+
+            /* FS thread function. Verifies every NCA block against the FS section hash trees. */
+            static void FsThreadFunc(void *arg);
+
+            /* Waits for the next ring slot available to the provided stage. Returns nullptr if there's nothing left to process. */
+            VerifyBuffer *GetVerifyBuffer(VerifyStage stage);
+
+            /* Hands the current ring slot for the provided stage over to the next stage. */
+            void ReleaseVerifyBuffer(VerifyStage stage);
+
+            /* Updates the buffer count for each stage within the pipeline stats object. Must be called with the ring mutex held. */
+            void UpdatePipelineStats(void);
+
+            /* Called by the read thread to signal the other stages there's no more data to be read. */
+            void FinishVerifyBufferRing(void);
+
+            /* Called by the read thread to wait until every block it committed has gone through all stages. */
+            void WaitForVerifyBuffers(void);
+
+            /* Adds a new result entry. Returns its index. */
+            size_t AddResult(const ContentVerifyResult& result);
+
+            /* Updates the status for a single check from the provided result entry. Errors are only stored if none were previously set. */
+            void SetResultStatus(size_t result_idx, bool fs_check, ContentVerifyStatus status, const std::string& error = std::string());
+
+            /* Called by the read thread and the FS thread each time data is processed or skipped. */
+            void UpdateProgress(size_t size);
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(ContentVerifyTask);
+            NON_MOVEABLE(ContentVerifyTask);
+
+            /* Runs in the background thread. */
+            ContentVerifyTaskError DoInBackground(const std::vector<ContentVerifyTarget>& targets) override final;
+
+        public:
+            ContentVerifyTask() = default;
+
+            /* Returns verification targets for all the titles that belong to the provided user application ID, filtered by storage ID. */
+            /* NcmStorageId_Any can be used to retrieve targets from all storages. */
+            static std::vector<ContentVerifyTarget> GetApplicationTargets(u64 app_id, u8 storage_id);
+
+            /* Returns verification targets for all the titles from the inserted gamecard. */
+            static std::vector<ContentVerifyTarget> GetGameCardTargets(void);
+
+            /* Returns a snapshot of all verification results available so far. Safe to call while the task is running. */
+            ALWAYS_INLINE std::vector<ContentVerifyResult> GetResults(void)
+            {
+                std::scoped_lock lock(this->result_mtx);
+                return this->results;
+            }
+    };
+}
+
+#endif  /* __CONTENT_VERIFY_TASK_HPP__ */
@@ -24,6 +24,8 @@
 #ifndef __DATA_TRANSFER_TASK_HPP__
 #define __DATA_TRANSFER_TASK_HPP__
 
+#include <array>
+#include <atomic>
 #include <borealis.hpp>
 
 #include "../core/nxdt_utils.h"
@@ -31,6 +33,22 @@
 
 namespace nxdt::tasks
 {
+    /* Pipeline stages reported by data transfer tasks that process data using multiple threads. */
+    typedef enum : u8 {
+        DataTransferStage_Read    = 0,
+        DataTransferStage_Decrypt = 1,  ///< Decryption, patching and/or re-encryption.
+        DataTransferStage_Hash    = 2,
+        DataTransferStage_Write   = 3,
+        DataTransferStage_Count   = 4
+    } DataTransferStage;
+
+    /* Used to hold progress info for a single pipeline stage. */
+    typedef struct {
+        bool enabled;       ///< Set to false if the current pipeline doesn't use this stage.
+        double speed;       ///< Current stage speed expressed in bytes per second.
+        int occupancy;      ///< Percentage of pipeline buffers available to this stage (waiting to be processed or being processed). Free buffers count towards the read stage.
+    } DataTransferStageProgress;
+
     /* Used to hold data transfer progress info. */
     typedef struct {
         size_t total_size;  ///< Total size for the data transfer process.
@@ -38,8 +56,103 @@ namespace nxdt::tasks
         int percentage;     ///< Progress percentage.
         double speed;       ///< Current speed expressed in bytes per second.
         std::string eta;    ///< Formatted ETA string.
+        bool has_stages;    ///< Set to true if per-stage progress info is available.
+        std::array<DataTransferStageProgress, DataTransferStage_Count> stages;
     } DataTransferProgress;
 
+    /* Lock-free pipeline instrumentation. Updated by pipeline stages on any thread, read by DataTransferTask on the UI thread. */
+    /* Pipelines must call Enable() before processing any data, then report processed sizes and buffer counts as each stage releases a buffer. */
+    /* The last enabled object is also registered as the active pipeline, so the exception handler can save its state if the application crashes mid-dump. */
+    class DataTransferPipelineStats
+    {
+        private:
+            static inline std::atomic<DataTransferPipelineStats*> active{nullptr};
+
+            std::atomic<size_t> buffer_count = 0;
+            std::atomic<u32> stage_mask = 0, cpu_bound_stage_mask = 0;
+            std::array<std::atomic<size_t>, DataTransferStage_Count> stage_size{}, stage_queued{};
+            std::array<std::atomic<u64>, DataTransferStage_Count> stage_tick{};
+
+        public:
+            /* Stages that are CPU-bound by default. Pipelines that compress data while writing it should add the write stage to the CPU-bound stage mask. */
+            static constexpr u32 DefaultCpuBoundStageMask = (BIT(DataTransferStage_Decrypt) | BIT(DataTransferStage_Hash));
+
+            DataTransferPipelineStats() = default;
+
+            ~DataTransferPipelineStats()
+            {
+                DataTransferPipelineStats *self = this;
+                active.compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+            }
+
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(DataTransferPipelineStats);
+            NON_MOVEABLE(DataTransferPipelineStats);
+
+            /* Enables per-stage progress reporting, using the provided buffer count and stage mask (one bit per DataTransferStage value). Sizes are kept across calls. */
+            /* The CPU-bound stage mask is used to pick a clock boost hint whenever one of those stages becomes the bottleneck (see utilsSetClockBoostHint()). */
+            ALWAYS_INLINE void Enable(size_t buffer_count, u32 stage_mask, u32 cpu_bound_stage_mask = DefaultCpuBoundStageMask)
+            {
+                this->stage_mask.store(stage_mask, std::memory_order_relaxed);
+                this->cpu_bound_stage_mask.store(cpu_bound_stage_mask, std::memory_order_relaxed);
+                this->buffer_count.store(buffer_count, std::memory_order_release);
+
+                /* Stages that haven't released a buffer yet are considered to be active since the pipeline was enabled. */
+                u64 cur_tick = armGetSystemTick();
+                for(auto& tick : this->stage_tick) tick.store(cur_tick, std::memory_order_relaxed);
+
+                active.store(this, std::memory_order_release);
+            }
+
+            ALWAYS_INLINE void AddStageSize(DataTransferStage stage, size_t size)
+            {
+                this->stage_size[stage].fetch_add(size, std::memory_order_relaxed);
+                this->stage_tick[stage].store(armGetSystemTick(), std::memory_order_relaxed);
+            }
+
+            ALWAYS_INLINE void SetStageQueued(DataTransferStage stage, size_t count)
+            {
+                this->stage_queued[stage].store(count, std::memory_order_relaxed);
+            }
+
+            ALWAYS_INLINE size_t GetBufferCount(void)
+            {
+                return this->buffer_count.load(std::memory_order_acquire);
+            }
+
+            ALWAYS_INLINE bool IsStageEnabled(DataTransferStage stage)
+            {
+                return ((this->stage_mask.load(std::memory_order_relaxed) & BIT(stage)) != 0);
+            }
+
+            ALWAYS_INLINE bool IsStageCpuBound(DataTransferStage stage)
+            {
+                return ((this->cpu_bound_stage_mask.load(std::memory_order_relaxed) & BIT(stage)) != 0);
+            }
+
+            ALWAYS_INLINE size_t GetStageSize(DataTransferStage stage)
+            {
+                return this->stage_size[stage].load(std::memory_order_relaxed);
+            }
+
+            ALWAYS_INLINE size_t GetStageQueued(DataTransferStage stage)
+            {
+                return this->stage_queued[stage].load(std::memory_order_relaxed);
+            }
+
+            /* Returns the system tick value from the last time the provided stage released a buffer (or from the last Enable() call, if it hasn't released any yet). */
+            ALWAYS_INLINE u64 GetStageTick(DataTransferStage stage)
+            {
+                return this->stage_tick[stage].load(std::memory_order_relaxed);
+            }
+
+            /* Returns the active pipeline, or nullptr if there's none. Only meant to be used by the exception handler, since the object may be destroyed at any time. */
+            ALWAYS_INLINE static DataTransferPipelineStats *GetActive(void)
+            {
+                return active.load(std::memory_order_acquire);
+            }
+    };
+
     /* Custom event type used to push data transfer progress updates. */
     typedef brls::Event<const DataTransferProgress&> DataTransferProgressEvent;
 
@@ -47,6 +160,8 @@ namespace nxdt::tasks
     /* Automatically allocates and registers a RepeatingTask on its own, which is started along with the actual task when AsyncTask::execute() is called. */
     /* This internal RepeatingTask is guaranteed to work on the UI thread, and it is also automatically unregistered on object destruction. */
     /* Progress updates are pushed through a DataTransferProgressEvent. Make sure to register all event listeners before executing the task. */
+    /* Progress sizes are published through atomic counters instead of the AsyncTask progress object, so per-block progress reporting never takes a lock. */
+    /* Percentage, speed and ETA values are only calculated on the UI thread, at the task handler rate. */
     template<typename Result, typename... Params>
     class DataTransferTask: public AsyncTask<DataTransferProgress, Result, Params...>
     {
@@ -85,6 +200,18 @@ namespace nxdt::tasks
             DataTransferProgressEvent progress_event{};
             Handler *task_handler = nullptr;
 
+            std::atomic<size_t> progress_total_size = 0, progress_xfer_size = 0;
+
+            /* Number of consecutive progress updates that must agree on the pipeline bottleneck before the clock boost hint changes. */
+            /* Keeps short bursts (e.g. a single slow block) from toggling clock rates back and forth. */
+            static constexpr u32 ClockBoostHintDebounceCount = 3;
+
+            DataTransferPipelineStats pipeline_stats{};
+            std::array<size_t, DataTransferStage_Count> prev_stage_size{};
+
+            u8 clock_boost_hint = UtilsClockBoostHint_None, pending_clock_boost_hint = UtilsClockBoostHint_None;
+            u32 pending_clock_boost_hint_cnt = 0;
+
             SteadyTimePoint start_time{}, prev_time{}, end_time{};
             size_t prev_xfer_size = 0;
             bool first_publish_progress = true;
@@ -94,6 +221,46 @@ namespace nxdt::tasks
                 return fmt::format("{:02.0F}H{:02.0F}M{:02.0F}S", std::fmod(seconds, 86400.0) / 3600.0, std::fmod(seconds, 3600.0) / 60.0, std::fmod(seconds, 60.0));
             }
 
+            /* Generates a progress object using the current values from the atomic counters. */
+            ALWAYS_INLINE DataTransferProgress LoadProgress(void)
+            {
+                DataTransferProgress progress{};
+
+                progress.total_size = this->progress_total_size.load(std::memory_order_relaxed);
+                progress.xfer_size = this->progress_xfer_size.load(std::memory_order_acquire);
+                progress.percentage = (progress.total_size ? static_cast<int>((progress.xfer_size * 100) / progress.total_size) : 0);
+
+                return progress;
+            }
+
+            /* Picks a clock boost hint using the per-stage buffer occupancy from the provided progress object. Runs on the calling thread. */
+            /* The pipeline bottleneck is the stage holding the most buffers: every other stage ends up waiting on it. */
+            void UpdateClockBoostHint(const DataTransferProgress& progress)
+            {
+                int max_occupancy = -1;
+                u8 hint = UtilsClockBoostHint_None;
+
+                for(u8 i = 0; progress.has_stages && i < DataTransferStage_Count; i++)
+                {
+                    const DataTransferStageProgress& stage_progress = progress.stages[i];
+                    if (!stage_progress.enabled || stage_progress.occupancy <= max_occupancy) continue;
+
+                    max_occupancy = stage_progress.occupancy;
+                    hint = (this->pipeline_stats.IsStageCpuBound(static_cast<DataTransferStage>(i)) ? UtilsClockBoostHint_CpuBound : UtilsClockBoostHint_IoBound);
+                }
+
+                if (hint != this->pending_clock_boost_hint)
+                {
+                    this->pending_clock_boost_hint = hint;
+                    this->pending_clock_boost_hint_cnt = 0;
+                }
+
+                if (++(this->pending_clock_boost_hint_cnt) < ClockBoostHintDebounceCount || hint == this->clock_boost_hint) return;
+
+                this->clock_boost_hint = hint;
+                utilsSetClockBoostHint(hint);
+            }
+
             void PostExecutionCallback(void)
             {
                 /* Set end time. */
@@ -107,7 +274,7 @@ namespace nxdt::tasks
 
                 /* Update progress one last time. */
                 /* This will effectively invoke the callbacks from all of our progress event subscribers. */
-                this->OnProgressUpdate(this->GetProgress());
+                this->OnProgressUpdate(this->LoadProgress());
 
                 /* Unset long running process state. */
                 utilsSetLongRunningProcessState(false);
@@ -142,6 +309,9 @@ namespace nxdt::tasks
                 /* Set long running process state. */
                 utilsSetLongRunningProcessState(true);
 
+                /* Reset I/O and crypto counters. This way, they only cover the current task. */
+                statsResetCounters();
+
                 /* Start task handler. */
                 this->task_handler->start();
 
@@ -149,9 +319,39 @@ namespace nxdt::tasks
                 this->start_time = this->prev_time = CurrentSteadyTimePoint();
             }
 
-            /* Runs on the calling thread. */
-            void OnProgressUpdate(const DataTransferProgress& progress) override final
+            /* Stores the total and transferred sizes from the provided progress object. Lock-free. Runs on the asynchronous task thread. */
+            /* Any other fields from the provided object are ignored, since they're calculated by OnProgressUpdate(). */
+            void PublishProgress(const DataTransferProgress& progress) override final
+            {
+                this->progress_total_size.store(progress.total_size, std::memory_order_relaxed);
+                this->progress_xfer_size.store(progress.xfer_size, std::memory_order_release);
+            }
+
+            /* Updates the total transfer size. Lock-free. Runs on the asynchronous task thread. */
+            ALWAYS_INLINE void PublishTotalSize(size_t total_size)
+            {
+                this->progress_total_size.store(total_size, std::memory_order_release);
+            }
+
+            /* Adds the provided size to the transferred size. Lock-free, meant to be called for every processed block. May be used by multiple threads at once. */
+            ALWAYS_INLINE void AddTransferredSize(size_t size)
+            {
+                this->progress_xfer_size.fetch_add(size, std::memory_order_release);
+            }
+
+            /* Returns a pointer to the pipeline instrumentation object, which can be handed over to any pipeline used by the task. */
+            ALWAYS_INLINE DataTransferPipelineStats *GetPipelineStats(void)
+            {
+                return &(this->pipeline_stats);
+            }
+
+            /* Runs on the calling thread. The provided progress object is ignored -- current values are loaded from the atomic counters. */
+            void OnProgressUpdate(const DataTransferProgress& unused) override final
             {
+                NX_IGNORE_ARG(unused);
+
+                DataTransferProgress progress = this->LoadProgress();
+
                 /* Return immediately if there has been no progress at all. */
                 bool proceed = (progress.xfer_size > prev_xfer_size || (progress.xfer_size == prev_xfer_size && (!progress.total_size || progress.xfer_size >= progress.total_size ||
                                 this->first_publish_progress)));
@@ -175,6 +375,26 @@ namespace nxdt::tasks
                 DataTransferProgress new_progress = progress;
                 new_progress.speed = speed;
 
+                /* Calculate per-stage speeds and buffer occupancy, if available. */
+                size_t buffer_count = this->pipeline_stats.GetBufferCount();
+                new_progress.has_stages = (buffer_count > 0);
+
+                for(u8 i = 0; new_progress.has_stages && i < DataTransferStage_Count; i++)
+                {
+                    DataTransferStage stage = static_cast<DataTransferStage>(i);
+                    DataTransferStageProgress& stage_progress = new_progress.stages[i];
+                    size_t stage_size = this->pipeline_stats.GetStageSize(stage);
+
+                    stage_progress.enabled = this->pipeline_stats.IsStageEnabled(stage);
+                    stage_progress.speed = (static_cast<double>(stage_size - this->prev_stage_size[i]) / diff_time);
+                    stage_progress.occupancy = static_cast<int>((std::min(this->pipeline_stats.GetStageQueued(stage), buffer_count) * 100) / buffer_count);
+
+                    this->prev_stage_size[i] = stage_size;
+                }
+
+                /* Update clock boost hint. */
+                if (status == AsyncTaskStatus::RUNNING) this->UpdateClockBoostHint(new_progress);
+
                 if (progress.total_size && speed > 0.0)
                 {
                     /* Calculate remaining data size and ETA if we know the total size. */
@@ -24,6 +24,8 @@
 #ifndef __DOWNLOAD_FILE_TASK_HPP__
 #define __DOWNLOAD_FILE_TASK_HPP__
 
+#include <vector>
+
 #include "download_task.hpp"
 
 namespace nxdt::tasks
@@ -46,6 +48,27 @@ namespace nxdt::tasks
         public:
             DownloadFileTask() = default;
     };
+
+    /* Asynchronous task used to download a file using an output path, a URL, its expected size and its expected SHA-256 checksum. */
+    /* Relies on httpDownloadFileRanged(), which means incomplete downloads are resumed the next time the same file is requested. */
+    /* Both the expected size and checksum are optional: zero and an empty vector may be used, respectively. */
+    class DownloadRangedFileTask: public DownloadTask<bool, std::string, std::string, bool, u64, std::vector<u8>>
+    {
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(DownloadRangedFileTask);
+            NON_MOVEABLE(DownloadRangedFileTask);
+
+            /* Runs in the background thread. */
+            bool DoInBackground(const std::string& path, const std::string& url, const bool& force_https, const u64& expected_size, const std::vector<u8>& expected_sha256) override final
+            {
+                const u8 *hash = (expected_sha256.size() == SHA256_HASH_SIZE ? expected_sha256.data() : nullptr);
+                return httpDownloadFileRanged(path.c_str(), url.c_str(), force_https, expected_size, hash, DownloadRangedFileTask::HttpProgressCallback, this);
+            }
+
+        public:
+            DownloadRangedFileTask() = default;
+    };
 }
 
 #endif  /* __DOWNLOAD_FILE_TASK_HPP__ */
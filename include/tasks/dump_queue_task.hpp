@@ -0,0 +1,157 @@
+/*
+ * dump_queue_task.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __DUMP_QUEUE_TASK_HPP__
+#define __DUMP_QUEUE_TASK_HPP__
+
+#include <optional>
+#include <mutex>
+#include <vector>
+
+#include "data_transfer_task.hpp"
+#include "nsp_dump_task.hpp"
+
+namespace nxdt::tasks
+{
+    typedef std::optional<std::string> DumpQueueTaskError;
+
+    typedef enum : u8 {
+        DumpQueueJobType_Nsp = 0    ///< NSP dump. Works with titles from any storage, including gamecards.
+    } DumpQueueJobType;
+
+    typedef enum : u8 {
+        DumpQueueJobStatus_Pending   = 0,
+        DumpQueueJobStatus_Running   = 1,
+        DumpQueueJobStatus_Done      = 2,
+        DumpQueueJobStatus_Failed    = 3,
+        DumpQueueJobStatus_Cancelled = 4
+    } DumpQueueJobStatus;
+
+    /* Holds a single dump queue job. Stored as-is in the dump queue file, so it must remain a POD type. */
+    typedef struct {
+        u8 type;                        ///< DumpQueueJobType.
+        u8 storage_id;                  ///< NcmStorageId.
+        u8 status;                      ///< DumpQueueJobStatus.
+        u8 reserved_1;
+        u32 reserved_2;
+        u64 title_id;
+        NspDumpOptions nsp_options;     ///< Only used by DumpQueueJobType_Nsp.
+        u64 total_size;                 ///< Output size. Estimated from the title size until the job is prepared.
+        u64 xfer_size;                  ///< Number of bytes written so far.
+        char output_path[FS_MAX_PATH];
+    } DumpQueueJob;
+
+    NXDT_ASSERT(DumpQueueJob, 0x330);
+
+    /* Holds a summary of the current dump queue state. */
+    typedef struct {
+        size_t job_count;
+        size_t pending_count;
+        size_t done_count;
+        size_t failed_count;
+        size_t cancelled_count;
+        size_t total_size;              ///< Sum of all job sizes.
+        size_t xfer_size;               ///< Sum of all bytes written so far.
+    } DumpQueueSummary;
+
+    /* Runs dump queue jobs back to back. Jobs marked as done are skipped, which lets interrupted queues be resumed from the dump queue file. */
+    /* The next job is prepared (NCA headers, CNMT, NACP, ticket and certificate chain) on a separate thread while the current one is being written. */
+    /* Resources that can be reused across NSP dumps are shared by all jobs. The dump queue file is updated each time a job changes its status. */
+    class DumpQueueTask: public DataTransferTask<DumpQueueTaskError, std::vector<DumpQueueJob>>
+    {
+        private:
+            /* Dump queue file properties. */
+            static constexpr u32 DumpQueueMagic = 0x4E584451;      /* "NXDQ". */
+            static constexpr u32 DumpQueueVersion = 1;
+
+            typedef struct {
+                u32 magic;      ///< DumpQueueMagic.
+                u32 version;    ///< DumpQueueVersion.
+                u32 job_count;  ///< Number of DumpQueueJob entries right after this header.
+                u32 reserved;
+            } DumpQueueHeader;
+
+            NXDT_ASSERT(DumpQueueHeader, 0x10);
+
+            std::mutex task_mtx, job_mtx;
+            std::vector<DumpQueueJob> jobs{};
+            std::vector<std::string> job_errors{};
+            size_t cur_job_idx = 0;
+
+            NspDumpSharedResources *shared_res = nullptr;
+
+            DataTransferProgress progress{};
+
+            /* Prepares the provided job using the provided dumper. Doesn't touch the task progress. */
+            NspDumpTaskError PrepareJob(NspDumper *dumper, size_t job_idx);
+
+            /* Updates the status for the provided job, then saves the dump queue file. */
+            void SetJobStatus(size_t job_idx, DumpQueueJobStatus status, const NspDumpTaskError& error = std::nullopt);
+
+            /* Called by the NSP dumper each time data is written. */
+            void UpdateProgress(size_t size);
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(DumpQueueTask);
+            NON_MOVEABLE(DumpQueueTask);
+
+            /* Runs in the background thread. */
+            DumpQueueTaskError DoInBackground(const std::vector<DumpQueueJob>& jobs) override final;
+
+        public:
+            DumpQueueTask() = default;
+
+            /* Loads jobs from the dump queue file. Jobs that were running when the queue was interrupted are marked as pending. */
+            /* Returns false if the dump queue file doesn't exist or if it's invalid. */
+            static bool LoadQueue(std::vector<DumpQueueJob>& out_jobs);
+
+            /* Saves the provided jobs to the dump queue file. The dump queue file is removed if no jobs are provided. */
+            static bool SaveQueue(const std::vector<DumpQueueJob>& jobs);
+
+            /* Generates NSP dump jobs for every title from the inserted gamecard (user applications, patches, add-on contents and add-on content patches) using the provided NSP options. */
+            /* Jobs are sorted by the physical offset of their first NCA, and each NSP dump reads its own NCAs in physical card order. NCAs shared by multiple titles are only read once */
+            /* (see NspDumpSharedResources). Together, these turn a full card dump into a near-sequential sweep across the secure partition, instead of jumping around the card. */
+            /* Output paths are generated within the provided output directory. Returns false if no gamecard titles are available or if an error occurs. */
+            static bool GenerateGameCardJobs(const NspDumpOptions& options, const std::string& output_dir, std::vector<DumpQueueJob>& out_jobs);
+
+            /* Returns a snapshot of all dump queue jobs, including their current status and progress. Safe to call while the task is running. */
+            ALWAYS_INLINE std::vector<DumpQueueJob> GetJobs(void)
+            {
+                std::scoped_lock lock(this->job_mtx);
+                return this->jobs;
+            }
+
+            /* Returns the error message for the provided job, or an empty string if it didn't fail. Safe to call while the task is running. */
+            ALWAYS_INLINE std::string GetJobError(size_t job_idx)
+            {
+                std::scoped_lock lock(this->job_mtx);
+                return (job_idx < this->job_errors.size() ? this->job_errors[job_idx] : std::string());
+            }
+
+            /* Returns a summary of the current dump queue state. Safe to call while the task is running. */
+            DumpQueueSummary GetSummary(void);
+    };
+}
+
+#endif  /* __DUMP_QUEUE_TASK_HPP__ */
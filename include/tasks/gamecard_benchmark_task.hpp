@@ -0,0 +1,104 @@
+/*
+ * gamecard_benchmark_task.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __GAMECARD_BENCHMARK_TASK_HPP__
+#define __GAMECARD_BENCHMARK_TASK_HPP__
+
+#include <optional>
+#include <mutex>
+#include <vector>
+
+#include "data_transfer_task.hpp"
+
+namespace nxdt::tasks
+{
+    typedef std::optional<std::string> GameCardBenchmarkTaskError;
+
+    /* Holds the results from a single benchmark pass. Latencies are expressed in microseconds. */
+    typedef struct {
+        size_t block_size;      ///< Read block size.
+        size_t alignment;       ///< Misalignment applied to each read offset, relative to the gamecard page size.
+        size_t read_count;      ///< Number of reads issued during this pass.
+        double speed;           ///< Throughput, expressed in MiB/s.
+        u64 p50_latency;        ///< Median read latency.
+        u64 p90_latency;        ///< 90th percentile read latency.
+        u64 p99_latency;        ///< 99th percentile read latency.
+        u64 max_latency;        ///< Maximum read latency.
+    } GameCardBenchmarkResult;
+
+    /* Measures raw gamecard read throughput at several block sizes and alignments using gamecardReadStorage(). Nothing is written anywhere. */
+    /* Results are also written to the logfile as machine-readable lines, each one starting with "gcbench". */
+    class GameCardBenchmarkTask: public DataTransferTask<GameCardBenchmarkTaskError>
+    {
+        private:
+            /* Maximum amount of data read during a single benchmark pass. */
+            static constexpr size_t BenchmarkPassSize = 0x2000000;      /* 32 MiB. */
+
+            /* Maximum number of reads issued during a single benchmark pass. Keeps small block size passes short. */
+            static constexpr size_t BenchmarkMaxReadCount = 0x1000;
+
+            /* Number of normal -> secure storage area switches used to estimate the switch cost. */
+            static constexpr size_t BenchmarkSwitchCount = 16;
+
+            std::mutex task_mtx;
+            std::vector<GameCardBenchmarkResult> results{};
+            u64 switch_cost = 0;
+
+            DataTransferProgress progress{};
+
+            /* Performs a single benchmark pass. Returns false if a read error occurs. */
+            bool RunPass(void *buf, size_t base_offset, size_t pass_size, size_t block_size, size_t alignment, GameCardBenchmarkResult& out);
+
+            /* Estimates the normal -> secure storage area switch cost. Returns false if a read error occurs. */
+            bool MeasureSwitchCost(void *buf, size_t secure_offset, size_t block_size);
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(GameCardBenchmarkTask);
+            NON_MOVEABLE(GameCardBenchmarkTask);
+
+            /* Runs in the background thread. */
+            GameCardBenchmarkTaskError DoInBackground(void) override final;
+
+        public:
+            GameCardBenchmarkTask() = default;
+
+            /* Returns the results from all benchmark passes. */
+            /* Returns an empty vector if the task hasn't finished yet or if the task was cancelled. */
+            ALWAYS_INLINE std::vector<GameCardBenchmarkResult> GetBenchmarkResults(void)
+            {
+                std::scoped_lock lock(this->task_mtx);
+                return ((this->IsFinished() && !this->IsCancelled()) ? this->results : std::vector<GameCardBenchmarkResult>());
+            }
+
+            /* Returns the estimated normal -> secure storage area switch cost, expressed in microseconds. */
+            /* Returns zero if the task hasn't finished yet or if the task was cancelled. */
+            ALWAYS_INLINE u64 GetSwitchCost(void)
+            {
+                std::scoped_lock lock(this->task_mtx);
+                return ((this->IsFinished() && !this->IsCancelled()) ? this->switch_cost : 0);
+            }
+    };
+}
+
+#endif  /* __GAMECARD_BENCHMARK_TASK_HPP__ */
@@ -26,20 +26,128 @@
 
 #include <optional>
 #include <mutex>
+#include <condition_variable>
+#include <array>
 
 #include "data_transfer_task.hpp"
+#include "../utils/file_writer.hpp"
+#include "../core/hfs.h"
 
 namespace nxdt::tasks
 {
     typedef std::optional<std::string> GameCardDumpTaskError;
 
     /* Generates an image dump out of the inserted gamecard. */
-    class GameCardImageDumpTask: public DataTransferTask<GameCardDumpTaskError, std::string, bool, bool, bool, bool, bool>
+    /* If a mirror output path is provided, the same gamecard image is written to both output paths at once. Checkpoints and resuming are disabled in that case. */
+    /* If HFS hash verification is enabled, every hashed HFS entry region is checked by the hash thread while the dump is in progress. */
+    class GameCardImageDumpTask: public DataTransferTask<GameCardDumpTaskError, std::string, bool, bool, bool, bool, bool, bool, bool, std::string, bool>
     {
         private:
+            /* Number of page-aligned buffers shared by the read and write threads. */
+            static constexpr size_t DumpBufferCount = 2;
+
+            /* Used to hold a single gamecard image block within the dump buffer ring. */
+            typedef struct {
+                void *data;     ///< Page-aligned buffer leased with bufferPoolLease().
+                size_t size;        ///< Block size.
+                size_t offset;      ///< Block offset, relative to the start of the gamecard image.
+                size_t data_size;   ///< Number of bytes actually read from the gamecard. Any remaining bytes up to 'size' hold generated 0xFF padding.
+                u32 crc;            ///< Running gamecard image checksum right after this block. Only set if checksum calculation is enabled.
+            } DumpBuffer;
+
+            /* Checkpoint file properties. Checkpoints are stored next to the output file and are used to resume interrupted dumps. */
+            static constexpr u32 DumpCheckpointMagic = 0x4E584350;          /* "NXCP". */
+            static constexpr u32 DumpCheckpointVersion = 1;
+            static constexpr size_t DumpCheckpointInterval = 0x10000000;    /* 256 MiB. */
+
+            /* Used to hold checkpoint data. Everything before 'offset' must match the current dump parameters for a checkpoint to be considered valid. */
+            typedef struct {
+                u32 magic;                      ///< DumpCheckpointMagic.
+                u32 version;                    ///< DumpCheckpointVersion.
+                FsGameCardIdSet card_id_set;    ///< Used to make sure the same gamecard is inserted.
+                u8 prepend_key_area;
+                u8 keep_certificate;
+                u8 trim_dump;
+                u8 calculate_checksum;
+                u64 image_size;                 ///< Gamecard image size, excluding the key area.
+                u64 offset;                     ///< Gamecard image offset up to which data has been written (and hashed, if needed). Always aligned to the dump buffer size.
+                u32 crc;                        ///< Running gamecard image checksum at 'offset'.
+                u32 reserved;
+            } DumpCheckpoint;
+
+            NXDT_ASSERT(DumpCheckpoint, 0x30);
+
             std::mutex task_mtx;
-            bool calculate_checksum = false, lookup_checksum = false;
+            bool calculate_checksum = false, lookup_checksum = false, verify_hfs_hashes = false;
+            bool use_hash_thread = false;   ///< Set if either checksum calculation or HFS hash verification is enabled.
             u32 gc_img_crc = 0, full_gc_img_crc = 0;
+            std::optional<std::string> checksum_lookup_result = std::nullopt;
+
+            /* Holds the hashed regions from all HFS partitions. Only accessed by the hash thread while the dump is in progress. */
+            HashFileSystemHashVerifier hfs_verifier{};
+
+            /* CRC32 checksum of a full dump buffer filled with 0xFF padding. Used to update the image checksum without hashing padding blocks. */
+            u32 padding_block_crc = 0;
+
+            /* Dump buffer ring. Filled by the read thread (DoInBackground), then consumed in parallel by the write thread and the hash thread. */
+            /* Monotonic block counters are used to keep track of each stage. A ring slot can only be reused after both consumers are done with it. */
+            std::mutex ring_mtx;
+            std::condition_variable ring_read_cv, ring_consume_cv;
+            std::array<DumpBuffer, DumpBufferCount> ring{};
+            size_t ring_committed_cnt = 0, ring_written_cnt = 0, ring_hashed_cnt = 0;
+            bool read_finished = false, write_failed = false;
+            size_t failed_write_size = 0, failed_write_offset = 0;
+
+            /* Checkpoint state. Updated with the ring mutex held each time a block has been processed by all consumer threads. */
+            DumpCheckpoint checkpoint{};
+            size_t ring_checkpoint_cnt = 0;
+            bool checkpoint_enabled = false;
+            std::string checkpoint_path{};
+
+            nxdt::utils::FileWriter *file = nullptr;
+            DataTransferProgress progress{};
+
+            /* Write thread function. Writes every filled block from the dump buffer ring to the output file and publishes the transfer progress. */
+            static void WriteThreadFunc(void *arg);
+
+            /* Hash thread function. Calculates the CRC32 checksum over every filled block from the dump buffer ring, and/or checks it against the HFS entry hashes. */
+            static void HashThreadFunc(void *arg);
+
+            /* Adds the hashed regions from every HFS partition within the inserted gamecard to the HFS verifier. */
+            bool InitializeHfsVerifier(void);
+
+            /* Called by the read thread to wait for an empty ring slot. Returns nullptr if the write thread failed. */
+            DumpBuffer *GetEmptyDumpBuffer(void);
+
+            /* Called by the read thread to hand a filled ring slot over to the consumer threads. */
+            void CommitDumpBuffer(void);
+
+            /* Called by the read thread to signal the consumer threads there's no more data to be read. */
+            void FinishDumpBufferRing(void);
+
+            /* Called by a consumer thread to wait for the next filled ring slot. Returns nullptr if there's nothing left to consume. */
+            DumpBuffer *GetFilledDumpBuffer(size_t& consumed_cnt);
+
+            /* Called by a consumer thread to release a ring slot. */
+            void ReleaseDumpBuffer(size_t& consumed_cnt);
+
+            /* Updates the buffer count for each stage within the pipeline stats object. Must be called with the ring mutex held. */
+            void UpdatePipelineStats(void);
+
+            /* Asks the USB host about an incomplete gamecard image left behind by an interrupted dump, then regenerates its last block to make sure it matches the inserted gamecard. */
+            /* 'gc_img_size' must include the key area size, if needed. Returns the gamecard image offset the dump can be resumed from, or zero if it has to start over. */
+            /* The running gamecard image checksum is restored if the dump can be resumed. */
+            size_t GetUsbHostResumeOffset(const std::string& output_path, size_t gc_img_size, size_t gc_trimmed_size, const GameCardSecurityInformation *gc_security_information,
+                                          bool keep_certificate);
+
+            /* Overwrites the portion of the gamecard certificate covered by the provided gamecard image block with 0xFF padding, if any. */
+            static void RemoveCertificate(void *buf, size_t offset, size_t size);
+
+            /* Loads the checkpoint file and validates it against the current checkpoint data. Returns false if it's unavailable or if it doesn't match. */
+            bool LoadDumpCheckpoint(void);
+
+            /* Saves the current checkpoint data to the checkpoint file. Returns the saved offset, or zero if nothing was saved. */
+            size_t SaveDumpCheckpoint(void);
 
         protected:
             /* Set class as non-copyable and non-moveable. */
@@ -48,7 +156,8 @@ namespace nxdt::tasks
 
             /* Runs in the background thread. */
             GameCardDumpTaskError DoInBackground(const std::string& output_path, const bool& prepend_key_area, const bool& keep_certificate, const bool& trim_dump,
-                                                 const bool& calculate_checksum, const bool& lookup_checksum) override final;
+                                                 const bool& skip_padding, const bool& calculate_checksum, const bool& lookup_checksum, const bool& compress_output,
+                                                 const std::string& mirror_output_path, const bool& verify_hfs_hashes) override final;
 
         public:
             GameCardImageDumpTask() = default;
@@ -68,6 +177,14 @@ namespace nxdt::tasks
                 std::scoped_lock lock(this->task_mtx);
                 return ((this->calculate_checksum && this->IsFinished() && !this->IsCancelled()) ? this->full_gc_img_crc : 0);
             }
+
+            /* Returns the name of the offline No-Intro index record matching the calculated gamecard image checksum, or an empty string if no match was found. */
+            /* Returns std::nullopt if no lookup was performed, if the task hasn't finished yet or if the task was cancelled. */
+            ALWAYS_INLINE std::optional<std::string> GetChecksumLookupResult(void)
+            {
+                std::scoped_lock lock(this->task_mtx);
+                return ((this->IsFinished() && !this->IsCancelled()) ? this->checksum_lookup_result : std::nullopt);
+            }
     };
 }
 
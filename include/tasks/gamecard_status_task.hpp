@@ -28,6 +28,7 @@
 
 #include "../core/nxdt_utils.h"
 #include "../core/gamecard.h"
+#include "user_event_waiter.hpp"
 
 namespace nxdt::tasks
 {
@@ -36,10 +37,12 @@ namespace nxdt::tasks
 
     /* Gamecard status task. */
     /* Its event provides a const reference to a GameCardStatus value. */
+    /* The gamecard status is only retrieved after the gamecard status update user event has been signaled. */
     class GameCardStatusTask: public brls::RepeatingTask
     {
         private:
             GameCardStatusEvent gc_status_event;
+            UserEventWaiter gc_status_waiter;
             GameCardStatus cur_gc_status = GameCardStatus_NotInserted;
             GameCardStatus prev_gc_status = GameCardStatus_NotInserted;
             bool skip_notification = true;
@@ -0,0 +1,293 @@
+/*
+ * nsp_dump_task.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __NSP_DUMP_TASK_HPP__
+#define __NSP_DUMP_TASK_HPP__
+
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+
+#include "data_transfer_task.hpp"
+#include "../utils/file_writer.hpp"
+#include "../core/title.h"
+#include "../core/cnmt.h"
+#include "../core/nacp.h"
+#include "../core/program_info.h"
+#include "../core/legal_info.h"
+
+namespace nxdt::tasks
+{
+    typedef std::optional<std::string> NspDumpTaskError;
+
+    /* Holds NSP generation options. */
+    typedef struct {
+        bool set_download_type;             ///< Set download distribution type.
+        bool remove_console_data;           ///< Remove console specific data.
+        bool remove_titlekey_crypto;        ///< Remove titlekey crypto.
+        bool patch_sua;                     ///< Disable linked account requirement.
+        bool patch_screenshot;              ///< Enable screenshots.
+        bool patch_video_capture;           ///< Enable video capture.
+        bool patch_hdcp;                    ///< Disable HDCP.
+        bool generate_authoringtool_data;   ///< Generate AuthoringTool data.
+        bool offload_hash_verification;     ///< Let the USB host verify unmodified NCAs against their CNMT hashes. Only used if the NSP is being sent to a USB host.
+    } NspDumpOptions;
+
+    /* Holds resources that can be reused across multiple NSP dumps. Thread-safe. */
+    class NspDumpSharedResources
+    {
+        public:
+            /* Holds the location of a NCA that was fully written by a previous NSP dump. */
+            typedef struct {
+                std::string output_path;                            ///< Output path from the NSP that holds this NCA.
+                nxdt::utils::FileWriter::StorageType storage_type;  ///< Output storage type from the NSP that holds this NCA.
+                size_t offset;                                      ///< NCA offset within the NSP.
+                size_t size;                                        ///< NCA size.
+                NcmContentId content_id;                            ///< Content ID from the written NCA.
+                u8 hash[SHA256_HASH_SIZE];                          ///< Hash from the written NCA.
+            } NcaDedupEntry;
+
+        private:
+            std::mutex res_mtx;
+            std::map<std::string, std::vector<u8>> cert_chains{};
+            std::map<std::string, NcaDedupEntry> nca_dedup_entries{};
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(NspDumpSharedResources);
+            NON_MOVEABLE(NspDumpSharedResources);
+
+        public:
+            NspDumpSharedResources() = default;
+
+            /* Returns a dynamically allocated copy of the raw certificate chain for the provided signature issuer, which must be freed by the caller using free(). */
+            /* The ES certificate savefile is only accessed the first time each signature issuer is requested. Returns nullptr if an error occurs. */
+            u8 *GetRawCertificateChain(const char *issuer, u64 *out_size);
+
+            /* Looks for a previously written NCA using the provided deduplication key. Returns false if it isn't available. */
+            bool GetNcaDedupEntry(const std::string& key, NcaDedupEntry& out_entry);
+
+            /* Registers a NCA that was fully written as part of a complete NSP. Existing entries aren't replaced. */
+            void AddNcaDedupEntry(const std::string& key, const NcaDedupEntry& entry);
+    };
+
+    /* Generates a NSP dump out of the title matching the provided storage ID and title ID. */
+    /* Prepare() only reads metadata, so it can be safely called while another NspDumper object is busy with Dump(). */
+    class NspDumper
+    {
+        public:
+            /* Returns true if the dump process should end prematurely. */
+            typedef std::function<bool(void)> CancelCallback;
+
+            /* Called each time NSP data is written to the output file. Receives the number of bytes that were written. May run on a different thread. */
+            typedef std::function<void(size_t)> ProgressCallback;
+
+        private:
+            /* Number of page-aligned buffers shared by all pipeline stages. Scaled down according to the memory budget, but never below DumpBufferMinCount. */
+            static constexpr size_t DumpBufferCount = 4;
+            static constexpr size_t DumpBufferMinCount = 2;
+
+            /* NCA data flows through these stages in order. The read stage runs on the thread that calls Dump(), while every other stage runs on its own thread. */
+            typedef enum : u8 {
+                Read  = 0,
+                Patch = 1,  ///< Calculates the clean SHA-256 checksum and applies NCA patches.
+                Hash  = 2,  ///< Calculates the dirty SHA-256 checksum and updates content IDs.
+                Write = 3,
+                Count = 4
+            } DumpStage;
+
+            /* Maps each dump stage to the pipeline stage reported to the UI. */
+            static constexpr std::array<DataTransferStage, DumpStage::Count> DumpStageMap = { DataTransferStage_Read, DataTransferStage_Decrypt, DataTransferStage_Hash, DataTransferStage_Write };
+
+            /* Used to hold a single NCA block within the dump buffer ring. */
+            typedef struct {
+                void *data;                         ///< Page-aligned buffer leased with bufferPoolLease().
+                size_t size;                        ///< Block size.
+                size_t offset;                      ///< Block offset, relative to the start of the NCA.
+                u32 nca_idx;                        ///< NCA context index.
+                bool hash_shared;                   ///< Set to true if no patches have been applied to the current NCA up to this block.
+                bool hash_fork;                     ///< Set to true if the dirty hash calculation must be forked from 'fork_ctx' on this block.
+                Sha256Context fork_ctx;             ///< Clean hash state right before this block. Only valid if 'hash_fork' is true.
+                u8 clean_hash[SHA256_HASH_SIZE];    ///< Clean NCA hash. Only valid on the last block from each NCA.
+                char entry_name[0x40];              ///< PFS entry name snapshot. Only valid on the first block from each NCA.
+                bool dedup;                         ///< Set to true if this block was copied from a previously written NCA. Skips the patch and hash stages.
+                bool hash_offload;                  ///< Set to true if the USB host verifies the current NCA on our behalf, which is only possible if it's never patched. Skips the patch and hash stages.
+            } DumpBuffer;
+
+            CancelCallback cancel_cb{};
+            ProgressCallback progress_cb{};
+            DataTransferPipelineStats *pipeline_stats = nullptr;
+
+            /* Set by Prepare(). */
+            NspDumpOptions options{};
+            TitleInfo *title_info = nullptr;
+            std::vector<NcaContext> nca_ctx{};
+            std::vector<ProgramInfoContext> program_info_ctx{};
+            std::vector<NacpContext> nacp_ctx{};
+            std::vector<LegalInfoContext> legal_info_ctx{};
+            std::vector<NacpContext*> deferred_nacp_ctx{};
+            ContentMetaContext cnmt_ctx{};
+            PartitionFileSystemImageContext pfs_img_ctx{};
+            Ticket tik{};
+            bool retrieve_tik_cert = false;
+            u8 *raw_cert_chain = nullptr;
+            u64 raw_cert_chain_size = 0;
+            std::vector<u8> nsp_header{};
+            size_t nsp_size = 0;
+            bool prepared = false;
+
+            /* Used to skip NCAs that were already written by a previous NSP dump from the same session. Only set if shared resources were provided. */
+            NspDumpSharedResources *shared_res = nullptr;
+            std::vector<std::string> nca_dedup_keys{};
+            std::vector<std::array<u8, SHA256_HASH_SIZE>> nca_hashes{};
+
+            /* Dump buffer ring. Monotonic block counters are used to keep track of each stage. */
+            /* A block can only be processed by a stage once the previous one is done with it, and a ring slot can only be reused after it has been written. */
+            std::mutex ring_mtx;
+            std::condition_variable ring_cv;
+            std::array<DumpBuffer, DumpBufferCount> ring{};
+            size_t ring_depth = DumpBufferCount;    ///< Number of ring slots actually in use.
+            std::array<size_t, DumpStage::Count> ring_stage_cnt{};
+            size_t ring_posted_cnt = 0;     ///< Blocks handed over to the output file by the write stage. Only blocks that have actually been written count towards ring_stage_cnt[DumpStage::Write].
+            bool read_finished = false, pipeline_failed = false;
+            std::string pipeline_error{};
+
+            nxdt::utils::FileWriter *file = nullptr;
+
+            /* Frees all the data allocated by Prepare(). */
+            void FreeData(void);
+
+            /* Patch thread function. Calculates the clean SHA-256 checksum over every NCA block, then applies NCA patches to it. */
+            static void PatchThreadFunc(void *arg);
+
+            /* Hash thread function. Calculates the dirty SHA-256 checksum over every NCA block, then validates and updates NCA hashes once each NCA is complete. */
+            static void HashThreadFunc(void *arg);
+
+            /* Write thread function. Writes every processed NCA block to the output file. USB transfers are queued asynchronously. */
+            static void WriteThreadFunc(void *arg);
+
+            /* Issued by the output file once the oldest block handed over by the write stage has been written. Releases its ring slot. */
+            static void WriteCompletionCallback(void *user_data, bool success);
+
+            /* Waits for the next ring slot available to the provided stage. Returns nullptr if there's nothing left to process or if the pipeline failed. */
+            /* The write stage flushes its pending writes before waiting, since their completion is what frees up ring slots. */
+            DumpBuffer *GetDumpBuffer(DumpStage stage);
+
+            /* Hands the current ring slot for the provided stage over to the next stage. */
+            void ReleaseDumpBuffer(DumpStage stage);
+
+            /* Updates the buffer count for each stage within the pipeline stats object, if available. Must be called with the ring mutex held. */
+            void UpdatePipelineStats(void);
+
+            /* Called by the read thread to signal the other stages there's no more data to be read. */
+            void FinishDumpBufferRing(void);
+
+            /* Called by the read thread to wait until every block it committed has gone through the provided stage. Returns false if the pipeline failed. */
+            bool WaitForDumpBuffers(DumpStage stage);
+
+            /* Called by any stage to stop the whole pipeline. */
+            void FailDumpBufferRing(const std::string& error_msg);
+
+            /* Writes a whole non-NCA PFS entry to the output file. */
+            bool WriteEntryData(u32 entry_idx, const void *data, size_t data_size);
+
+            /* Generates a deferred NACP patch for the provided NCA. */
+            bool GenerateDeferredNacpPatch(NcaContext *cur_nca_ctx, NacpContext *cur_nacp_ctx);
+
+            /* Validates the clean NCA hash, then calls UpdateNcaHash(). */
+            NspDumpTaskError FinalizeNcaHash(u32 nca_idx, const u8 *clean_hash, const u8 *dirty_hash);
+
+            /* Updates the NCA content ID and hash, the CNMT and the PFS entry name using the provided hash. */
+            NspDumpTaskError UpdateNcaHash(u32 nca_idx, const u8 *hash);
+
+            /* Returns the CNMT content record for the provided NCA, or nullptr if it can't be found. */
+            NcmPackagedContentInfo *GetPackagedContentInfo(NcaContext *nca_ctx);
+
+            /* Generates a deduplication key for the provided NCA, using its original content ID and hash, as well as the options that affect its output data. */
+            /* Returns an empty string if the NCA can't be deduplicated. */
+            std::string GenerateNcaDedupKey(NcaContext *nca_ctx);
+
+            ALWAYS_INLINE bool IsCancelled(void)
+            {
+                return (this->cancel_cb && this->cancel_cb());
+            }
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(NspDumper);
+            NON_MOVEABLE(NspDumper);
+
+        public:
+            /* If 'pipeline_stats' is provided, it's updated by every pipeline stage while Dump() runs. */
+            NspDumper(CancelCallback cancel_cb, ProgressCallback progress_cb, DataTransferPipelineStats *pipeline_stats = nullptr) : cancel_cb(cancel_cb), progress_cb(progress_cb), pipeline_stats(pipeline_stats) { }
+            ~NspDumper();
+
+            /* Initializes all the contexts needed to generate the NSP and calculates its size. Nothing is written anywhere. */
+            /* If 'shared_res' is provided, it's used to reuse data retrieved by other NspDumper objects. */
+            NspDumpTaskError Prepare(u8 storage_id, u64 title_id, const NspDumpOptions& options, NspDumpSharedResources *shared_res = nullptr);
+
+            /* Generates the NSP and writes it to the provided output path. Must be called after a successful Prepare() call, and only once. */
+            /* Returns std::nullopt if the dump was cancelled, so the cancel callback should be checked by the caller. */
+            NspDumpTaskError Dump(const std::string& output_path);
+
+            /* Returns the physical offset for the provided secure partition content from the inserted gamecard, relative to the start of the gamecard image. Returns zero if it can't be retrieved. */
+            /* Used to read gamecard NCAs in physical card order. */
+            static u64 GetGameCardContentOffset(const NcmContentInfo *content_info);
+
+            /* Returns the full NSP size, or zero if Prepare() hasn't been successfully called. */
+            ALWAYS_INLINE size_t GetNspSize(void)
+            {
+                return (this->prepared ? this->nsp_size : 0);
+            }
+    };
+
+    /* Generates a NSP dump out of the title matching the provided storage ID and title ID. */
+    /* Parameters: output path, storage ID, title ID, set download distribution type, remove console specific data, remove titlekey crypto, */
+    /* disable linked account requirement, enable screenshots, enable video capture, disable HDCP, generate AuthoringTool data and offload hash verification. */
+    class NspDumpTask: public DataTransferTask<NspDumpTaskError, std::string, u8, u64, bool, bool, bool, bool, bool, bool, bool, bool, bool>
+    {
+        private:
+            std::mutex task_mtx;
+            DataTransferProgress progress{};
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(NspDumpTask);
+            NON_MOVEABLE(NspDumpTask);
+
+            /* Runs in the background thread. */
+            NspDumpTaskError DoInBackground(const std::string& output_path, const u8& storage_id, const u64& title_id, const bool& set_download_type, const bool& remove_console_data,
+                                            const bool& remove_titlekey_crypto, const bool& patch_sua, const bool& patch_screenshot, const bool& patch_video_capture,
+                                            const bool& patch_hdcp, const bool& generate_authoringtool_data, const bool& offload_hash_verification) override final;
+
+        public:
+            NspDumpTask() = default;
+    };
+}
+
+#endif  /* __NSP_DUMP_TASK_HPP__ */
@@ -0,0 +1,144 @@
+/*
+ * output_storage_benchmark_task.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __OUTPUT_STORAGE_BENCHMARK_TASK_HPP__
+#define __OUTPUT_STORAGE_BENCHMARK_TASK_HPP__
+
+#include <optional>
+#include <mutex>
+#include <vector>
+
+#include "data_transfer_task.hpp"
+
+namespace nxdt::tasks
+{
+    typedef std::optional<std::string> OutputStorageBenchmarkTaskError;
+
+    /* Holds the results from a full output storage benchmark. Speeds are expressed in bytes per second. */
+    /* Split file speeds are zero if the output storage doesn't need split files (e.g. exFAT UMS volumes). */
+    typedef struct {
+        char target_id[0x80];       ///< Identifies the benchmarked output storage. See OutputStorageBenchmarkTask::GetTargetId().
+        u64 timestamp;              ///< POSIX timestamp for the benchmark run.
+        u64 seq_write_speed;        ///< Sequential write throughput, using large blocks.
+        u64 seq_read_speed;         ///< Sequential read throughput, using large blocks.
+        u64 storm_write_speed;      ///< Small file write throughput.
+        u64 storm_read_speed;       ///< Small file read throughput.
+        u64 storm_files_per_sec;    ///< Number of small files written per second.
+        u64 split_write_speed;      ///< Split file write throughput.
+        u64 split_read_speed;       ///< Split file read throughput.
+    } OutputStorageBenchmarkResult;
+
+    NXDT_ASSERT(OutputStorageBenchmarkResult, 0xC0);
+
+    /* Measures write and read back throughput for an output storage (the SD card or a UMS volume). Temporary files are written through FileWriter, then deleted. */
+    /* Three passes are performed: large sequential blocks, a storm of small files and split file mode. Results are stored on the SD card, one entry per output storage. */
+    /* The input parameter must be the root for the output storage (e.g. "sdmc:" or "ums0:"). USB hosts aren't supported. */
+    class OutputStorageBenchmarkTask: public DataTransferTask<OutputStorageBenchmarkTaskError, std::string>
+    {
+        private:
+            static constexpr u32 BenchmarkResultsMagic = 0x4E584F42;    /* "NXOB". */
+            static constexpr u32 BenchmarkResultsVersion = 1;
+
+            /* Sequential pass file size. */
+            static constexpr size_t BenchmarkSequentialSize = 0x8000000;    /* 128 MiB. */
+
+            /* Small file storm pass properties. */
+            static constexpr size_t BenchmarkStormFileCount = 512;
+            static constexpr size_t BenchmarkStormFileSize = 0x4000;        /* 16 KiB. */
+
+            /* Split file pass file size. Split mode is forced, so there's no need to write more than 4 GiB of data. */
+            static constexpr size_t BenchmarkSplitSize = 0x4000000;         /* 64 MiB. */
+
+            typedef struct {
+                u32 magic;          ///< BenchmarkResultsMagic.
+                u32 version;        ///< BenchmarkResultsVersion.
+                u32 result_count;   ///< Number of OutputStorageBenchmarkResult entries that follow this header.
+                u8 reserved[0x4];
+            } OutputStorageBenchmarkResultsHeader;
+
+            NXDT_ASSERT(OutputStorageBenchmarkResultsHeader, 0x10);
+
+            std::mutex task_mtx;
+            OutputStorageBenchmarkResult result{};
+            bool split_supported = false;
+
+            DataTransferProgress progress{};
+
+            /* Writes a file filled with a verifiable pattern through FileWriter. Returns the elapsed time in seconds through 'elapsed', or an error string. */
+            /* Split mode is forced if 'split' is true. 'file_idx' is used to generate a different pattern for each file. */
+            OutputStorageBenchmarkTaskError WriteFile(const std::string& path, void *buf, size_t size, size_t file_idx, bool split, double& elapsed);
+
+            /* Reads back a file written by WriteFile() and verifies its contents. Returns the elapsed time in seconds through 'elapsed', or an error string. */
+            OutputStorageBenchmarkTaskError ReadFile(const std::string& path, void *buf, size_t size, size_t file_idx, double& elapsed);
+
+            /* Fills a block with the pattern for the provided file index and block offset. */
+            static void FillBlock(u8 *buf, size_t size, size_t file_idx, size_t offset);
+
+            /* Reads all stored benchmark results. */
+            static bool LoadResults(std::vector<OutputStorageBenchmarkResult>& out_results);
+
+            /* Stores a benchmark result, replacing any previous entry for the same output storage. */
+            static bool SaveResult(const OutputStorageBenchmarkResult& result);
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(OutputStorageBenchmarkTask);
+            NON_MOVEABLE(OutputStorageBenchmarkTask);
+
+            /* Runs in the background thread. */
+            OutputStorageBenchmarkTaskError DoInBackground(const std::string& storage_root) override final;
+
+        public:
+            OutputStorageBenchmarkTask() = default;
+
+            /* Returns the benchmark result. */
+            /* Returns false if the task hasn't finished yet or if the task was cancelled. */
+            ALWAYS_INLINE bool GetBenchmarkResult(OutputStorageBenchmarkResult& out)
+            {
+                std::scoped_lock lock(this->task_mtx);
+                if (!this->IsFinished() || this->IsCancelled() || !this->result.timestamp) return false;
+                out = this->result;
+                return true;
+            }
+
+            /* Returns true if the split file pass was performed. */
+            ALWAYS_INLINE bool IsSplitFileSupported(void)
+            {
+                std::scoped_lock lock(this->task_mtx);
+                return this->split_supported;
+            }
+
+            /* Generates an identifier for the output storage that holds the provided path, which remains the same across UMS device reconnections. */
+            /* Returns an empty string if the output storage isn't supported. */
+            static std::string GetTargetId(const std::string& path);
+
+            /* Retrieves the stored benchmark result for the output storage that holds the provided path. */
+            static bool GetStoredResult(const std::string& path, OutputStorageBenchmarkResult& out);
+
+            /* Estimates the time needed to write 'size' bytes to the provided output path, in seconds, using stored benchmark results. */
+            /* Split file speeds are used if the dump would be split on this output storage. Returns zero if no benchmark result is available. */
+            static u64 EstimateWriteTime(const std::string& path, size_t size);
+    };
+}
+
+#endif  /* __OUTPUT_STORAGE_BENCHMARK_TASK_HPP__ */
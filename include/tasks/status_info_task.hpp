@@ -38,6 +38,7 @@ namespace nxdt::tasks
         bool connected;
         NifmInternetConnectionType connection_type;
         char ip_addr[16];
+        StatsSnapshot stats;    ///< I/O and crypto counters.
     } StatusInfoData;
 
     /* Custom event type. */
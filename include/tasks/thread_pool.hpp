@@ -0,0 +1,117 @@
+/*
+ * thread_pool.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * Based on attcs' C++ implementation at:
+ * https://github.com/attcs/AsyncTask/blob/master/asynctask.h.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+
+#pragma once
+
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+#include "../core/nxdt_utils.h"
+
+namespace nxdt::tasks
+{
+    /* Priority classes used by ThreadPool workers. Lower values mean higher priorities. */
+    enum class ThreadPriority: int
+    {
+        High   = 0x2C,  ///< Main thread priority. Also used by std::async / pthread threads.
+        Normal = 0x3B,  ///< Preemptive priority used by utilsCreateThread().
+        Low    = 0x3F   ///< Lowest preemptive priority. Meant for background housekeeping.
+    };
+
+    /* Shared worker thread pool. */
+    /* Workers are grouped into slots: one for each CPU core usable by utilsCreateThread() (0, 1, 2 and the default process core) and each priority class. */
+    /* Workers are created on demand using an explicit core affinity, and they're kept around once they finish a job. Scheduling a job only creates a new thread */
+    /* if all the workers from the target slot are busy -- and even then, only up to MaxWorkersPerSlot workers are created. Jobs wait in the slot queue past that point. */
+    class ThreadPool
+    {
+        public:
+            typedef std::function<void(void)> Job;
+
+        private:
+            static constexpr size_t CoreSlotCount = 4;      ///< Cores 0, 1 and 2, plus the default process core (-2). Core 3 is reserved for HOS.
+            static constexpr size_t PrioritySlotCount = 3;
+            static constexpr size_t MaxWorkersPerSlot = 8;
+
+            struct Slot {
+                std::mutex mtx;
+                std::condition_variable cv;
+                std::deque<Job> jobs{};
+                std::list<Thread> workers{};    ///< std::list is used to keep Thread objects at a fixed address.
+                size_t idle_count = 0;
+                bool exit = false;
+            };
+
+            std::array<Slot, CoreSlotCount * PrioritySlotCount> slots{};
+
+            ThreadPool() = default;
+            ~ThreadPool();
+
+            /* Returns a pointer to the slot that matches the provided core and priority, or nullptr if they're invalid. */
+            Slot *GetSlot(int cpu_id, ThreadPriority priority);
+
+            /* Adds the provided job to the queue from the slot that matches the provided core and priority. Creates a new worker if needed. */
+            /* Returns false if the job couldn't be scheduled. */
+            bool Enqueue(Job&& job, int cpu_id, ThreadPriority priority);
+
+            /* Worker thread function. Runs jobs from its slot queue until the pool is destroyed. */
+            static void WorkerThreadFunc(void *arg);
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(ThreadPool);
+            NON_MOVEABLE(ThreadPool);
+
+        public:
+            /* Returns the shared thread pool instance. Workers are joined on program exit. */
+            static ThreadPool& GetInstance(void);
+
+            /* Schedules the provided callable on a worker running on the provided core, using the provided priority class. */
+            /* 'cpu_id' follows the same convention as utilsCreateThread(): 0 to 2 selects a specific core, -2 selects the default process core. */
+            /* Returns a std::future that holds the value returned by the callable (or the exception it throws). */
+            /* An invalid std::future is returned if the job couldn't be scheduled -- make sure to check it using std::future::valid(). */
+            template<typename Func>
+            auto Submit(Func&& func, int cpu_id = -2, ThreadPriority priority = ThreadPriority::Normal) -> std::future<std::invoke_result_t<std::decay_t<Func>>>
+            {
+                using Result = std::invoke_result_t<std::decay_t<Func>>;
+
+                /* std::function requires copyable targets, so the packaged task is shared with the job. */
+                auto task = std::make_shared<std::packaged_task<Result(void)>>(std::forward<Func>(func));
+                std::future<Result> future = task->get_future();
+
+                if (!this->Enqueue([task]() { (*task)(); }, cpu_id, priority)) return {};
+
+                return future;
+            }
+    };
+}
+
+#endif  /* __THREAD_POOL_HPP__ */
@@ -28,6 +28,7 @@
 
 #include "../core/nxdt_utils.h"
 #include "../core/ums.h"
+#include "user_event_waiter.hpp"
 
 namespace nxdt::tasks
 {
@@ -40,10 +41,12 @@ namespace nxdt::tasks
 
     /* USB Mass Storage task. */
     /* Its event provides a const reference to a UmsDeviceVector. */
+    /* UMS device info is only retrieved after the UMS device info update user event has been signaled. */
     class UmsTask: public brls::RepeatingTask
     {
         private:
             UmsEvent ums_event;
+            UserEventWaiter ums_waiter;
 
             UsbHsFsDevice *ums_devices = nullptr;
             u32 ums_devices_count = 0;
@@ -0,0 +1,70 @@
+/*
+ * user_event_waiter.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * Based on attcs' C++ implementation at:
+ * https://github.com/attcs/AsyncTask/blob/master/asynctask.h.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+
+#pragma once
+
+#ifndef __USER_EVENT_WAITER_HPP__
+#define __USER_EVENT_WAITER_HPP__
+
+#include <atomic>
+
+#include "../core/nxdt_utils.h"
+
+namespace nxdt::tasks
+{
+    /* Waits on a user-mode event using a background thread, then latches a flag that can be cheaply consumed by UI thread tasks. */
+    /* This lets RepeatingTask-based status tasks react to core interface events without calling into the core interfaces on every run() call. */
+    class UserEventWaiter
+    {
+        private:
+            UEvent *event = nullptr, exit_event{};
+            Thread thread{};
+            bool thread_created = false;
+            std::atomic<bool> signaled = false;
+
+            static void ThreadFunc(void *arg);
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(UserEventWaiter);
+            NON_MOVEABLE(UserEventWaiter);
+
+        public:
+            /* The provided event must outlive this object. A null event means the waiter thread isn't created at all. */
+            UserEventWaiter(UEvent *event);
+            ~UserEventWaiter();
+
+            /* Returns false if the waiter thread couldn't be created, in which case callers should fall back to polling. */
+            ALWAYS_INLINE bool IsActive(void)
+            {
+                return this->thread_created;
+            }
+
+            /* Returns true if the event has been signaled since the last call to this function. */
+            ALWAYS_INLINE bool Consume(void)
+            {
+                return this->signaled.exchange(false, std::memory_order_acq_rel);
+            }
+    };
+}
+
+#endif  /* __USER_EVENT_WAITER_HPP__ */
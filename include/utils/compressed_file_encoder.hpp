@@ -0,0 +1,115 @@
+/*
+ * compressed_file_encoder.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#ifndef __COMPRESSED_FILE_ENCODER_HPP__
+#define __COMPRESSED_FILE_ENCODER_HPP__
+
+#include <vector>
+
+#include "../core/nxdt_utils.h"
+
+namespace nxdt::utils
+{
+    /* Generates a seekable compressed container out of sequentially provided data. Used by FileWriter to write compressed output files. */
+    /* Input data is split into fixed-size blocks, each one of them compressed on its own using LZ4. Blocks that don't get any smaller are stored as-is. */
+    /* Blocks filled with a single byte value (e.g. zeroes or 0xFF padding) take up no space at all: the byte value is kept in the block index. */
+    /* Container layout: header, block data, block index (one entry per block) and footer. All fields are little endian. */
+    class CompressedFileEncoder
+    {
+        public:
+            static constexpr u32 HeaderMagic = 0x5A44584E;     /* "NXDZ". */
+            static constexpr u32 FooterMagic = 0x495A584E;     /* "NXZI". */
+            static constexpr u8 ContainerVersion = 1;
+            static constexpr u32 DefaultBlockSize = 0x100000;   /* 1 MiB. */
+
+            typedef enum : u8 {
+                Stored = 0,
+                Lz4    = 1,
+                Fill   = 2
+            } BlockType;
+
+            typedef struct {
+                u32 magic;                  ///< HeaderMagic.
+                u8 version;                 ///< ContainerVersion.
+                u8 reserved_1[3];
+                u32 block_size;             ///< Uncompressed block size. The last block may be smaller.
+                u32 block_count;
+                u64 uncompressed_size;
+                u64 reserved_2;
+            } Header;
+
+            NXDT_ASSERT(Header, 0x20);
+
+            typedef struct {
+                u64 offset;                 ///< Block data offset, relative to the start of the container. Points to the next block for fill blocks.
+                u32 size;                   ///< Stored block data size. Always zero for fill blocks.
+                u8 type;                    ///< BlockType.
+                u8 fill_value;              ///< Only used by fill blocks.
+                u8 reserved[2];
+            } BlockEntry;
+
+            NXDT_ASSERT(BlockEntry, 0x10);
+
+            typedef struct {
+                u64 index_offset;           ///< Block index offset, relative to the start of the container.
+                u32 block_count;
+                u32 magic;                  ///< FooterMagic.
+            } Footer;
+
+            NXDT_ASSERT(Footer, 0x10);
+
+        private:
+            size_t input_size = 0, input_offset = 0, output_offset = 0;
+            u32 block_size = 0;
+
+            std::vector<u8> block_buf{}, compressed_buf{};
+            std::vector<BlockEntry> block_index{};
+            void *lz4_state = nullptr;
+
+            /* Appends data to the provided output buffer and updates the container offset. */
+            void Append(std::vector<u8>& out, const void *data, const size_t& data_size);
+
+            /* Compresses a single block and appends it to the provided output buffer. */
+            bool EncodeBlock(const u8 *data, const size_t& data_size, std::vector<u8>& out);
+
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(CompressedFileEncoder);
+            NON_MOVEABLE(CompressedFileEncoder);
+
+        public:
+            /* 'input_size' must hold the total amount of data that's going to be provided to Encode(). */
+            CompressedFileEncoder(const size_t& input_size, const u32& block_size = DefaultBlockSize);
+            ~CompressedFileEncoder();
+
+            /* Encodes the provided data and appends the resulting container data to 'out', which is never cleared. Input data that doesn't fill a whole block is kept until more data is provided. */
+            /* The block index and footer are appended right away once all input data has been provided. */
+            bool Encode(const void *data, const size_t& data_size, std::vector<u8>& out);
+
+            /* Returns the container size for the provided input size in the worst case scenario (every single block being stored as-is). */
+            static size_t GetMaxContainerSize(const size_t& input_size, const u32& block_size = DefaultBlockSize);
+    };
+}
+
+#endif  /* __COMPRESSED_FILE_ENCODER_HPP__ */
@@ -26,14 +26,24 @@
 
 #include <borealis.hpp>
 #include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
 
 #include "../core/nxdt_utils.h"
 #include "../core/usb.h"
+#include "compressed_file_encoder.hpp"
 
 namespace nxdt::utils
 {
     /* Writes output files to different storage locations based on the provided input path. */
     /* It also handles file splitting in FAT-based UMS volumes. */
+    /* Data written to the SD card or a UMS device is copied to a bounded write-behind queue, then written by a background I/O thread. Write errors are reported by the next call. */
+    /* Queued writes are merged into batches aligned to the cluster size from the target filesystem. */
+    /* Output files may be mirrored to other storage locations (see AddMirror()), so a single read pass feeds all of them. */
+    /* Output files may also be written as seekable LZ4 block containers (see CompressedFileEncoder). Compression takes place on the producer thread, before data is queued. */
     class FileWriter
     {
         public:
@@ -46,50 +56,240 @@ namespace nxdt::utils
             } StorageType;
 
         private:
+            /* Max amount of data that may be held by the write-behind queue. A single write larger than this is still accepted if the queue is empty. */
+            /* UMS devices with a speed probe profile (see umsGetDeviceProfileByPath()) may use a bigger queue, up to WriteQueueMaxSizeLimit. */
+            /* Either way, the queue size is scaled down according to the memory budget (see utilsGetBudgetedBufferSize()). */
+            static constexpr size_t WriteQueueMaxSize = (USB_TRANSFER_BUFFER_SIZE * 2);
+            static constexpr size_t WriteQueueMaxSizeLimit = (WriteQueueMaxSize * 2);
+
+            /* Write granularity used if the cluster size from the target filesystem can't be retrieved (e.g. the SD card). */
+            /* Matches the default exFAT cluster size for SDXC cards, which is also a multiple of every FAT32 cluster size. */
+            static constexpr size_t DefaultClusterSize = 0x20000;
+
+            /* Used to hold a single write-behind queue entry. */
+            typedef struct {
+                std::vector<u8> data;
+                size_t offset;          ///< Output file offset. Only used for logging purposes.
+            } WriteRequest;
+
+            /* Used to hold a single mirror output file. Each mirror is written by its own I/O thread, using source buffers shared with all the other mirrors. */
+            typedef struct {
+                FileWriter *parent;
+                FileWriter *writer;     ///< Carries out writes synchronously (no write-behind queue).
+                std::deque<std::shared_ptr<const WriteRequest>> queue;
+                size_t queue_size;
+                bool failed;
+                Thread thread;
+            } MirrorTarget;
+
             std::string output_path{};
             size_t total_size = 0, cur_size = 0;
 
             u32 nsp_header_size = 0;
             bool nsp_header_written = false;
 
+            /* Copy of the initial NSP header written to SD card and UMS output files, if provided. Lets WriteNspHeader() skip the rewrite pass if it didn't change. */
+            std::vector<u8> initial_nsp_header{};
+
+            /* NSP layout sent to the USB host, if provided. The first region holds the NSP header, while the rest of them hold the NSP file entries. */
+            std::vector<UsbNspLayoutEntry> nsp_layout{};
+
             StorageType storage_type = StorageType::None;
 
-            bool split_file = false, file_created = false, file_closed = false;
+            /* Set if the USB host is comparing this file against a previous dump (see usbStartFileDelta()). Data is staged until a whole USB_FILE_DELTA_BATCH_SIZE batch is available. */
+            bool usb_delta = false;
+            std::vector<u8> usb_delta_buf{};
+            size_t usb_delta_offset = 0, usb_delta_sent_size = 0;
+
+            bool split_file = false, file_created = false, file_closed = false, keep_incomplete_file = false;
 
             FILE *fp = nullptr;
+
+            /* SD card output files are written through the SD card filesystem object instead of newlib, so there's no devoptab overhead. */
+            FsFile sd_file{};
+            bool sd_file_open = false;
+            size_t sd_file_offset = 0;
             u8 split_file_part_cnt = 0, split_file_part_idx = 0;
             size_t split_file_part_size = 0;
 
+            /* Page-aligned buffer handed over to producers by AcquireBuffer(). Allocated on demand, then reused by later leases. */
+            void *lease_buf = nullptr;
+            size_t lease_buf_size = 0;
+            bool lease_active = false;
+
+            /* Write-behind queue. Never used with USB hosts: callers interleave USB commands with file data, and WriteAsync() already overlaps USB transfers. */
+            std::mutex queue_mtx;
+            std::condition_variable queue_cv;
+            std::deque<WriteRequest> queue{};
+            std::vector<std::vector<u8>> queue_spare_bufs{};
+            size_t queue_size = 0;
+            bool queue_failed = false, queue_exit = false;
+            Thread io_thread{};
+
+            /* Small or unaligned writes are merged here until they reach a cluster boundary within the output file, so queued requests always cover whole clusters. */
+            /* Whatever is left is queued by Flush(), WriteNspHeader() and Close(), or as soon as the last chunk of data is written. */
+            size_t cluster_size = DefaultClusterSize;
+            WriteRequest staging{};
+
+            /* Tuned using the speed probe profile from the target UMS device, if available. A zero write block size means data is written in a single call. */
+            size_t queue_max_size = WriteQueueMaxSize, write_block_size = 0;
+
+            /* Mirror output files. All mirror I/O threads share the same mutex and condition variable. */
+            std::mutex mirror_mtx;
+            std::condition_variable mirror_cv;
+            std::vector<std::unique_ptr<MirrorTarget>> mirrors{};
+            bool mirror_exit = false;
+
+            /* Compressed container encoder. If set, 'total_size' and 'cur_size' refer to the container data, while input data is tracked separately. */
+            std::unique_ptr<CompressedFileEncoder> encoder{};
+            std::vector<u8> encoder_out{};
+            size_t input_total_size = 0, input_cur_size = 0;
+
             std::optional<std::string> CheckFreeSpace(void);
 
             void CloseCurrentFile(void);
 
+            /* Opens the output file from the SD card using its native filesystem object. The file is replaced, unless 'resume' is true. */
+            bool OpenSdCardFile(bool resume);
+
+            ALWAYS_INLINE bool IsCurrentFileOpen(void)
+            {
+                return (this->storage_type == StorageType::SdCard ? this->sd_file_open : (this->fp != nullptr));
+            }
+
             bool OpenNextFile(void);
 
+            /* Extends the current output file (or part file) to its final size. Also used to trim compressed output files down to their actual size. */
+            void PreallocateCurrentFile(void);
+
             bool CreateInitialFile(void);
 
+            bool ResumeInitialFile(const size_t& resume_offset);
+
+            /* Writes data to the output file as-is. Takes care of seamlessly switching to a new part file if needed. Used by Write(). */
+            bool WriteOutput(const void *data, const size_t& data_size);
+
+            /* Compresses data, then writes the resulting container data to the output file. Used by Write(). */
+            bool WriteCompressedData(const void *data, const size_t& data_size);
+
+            /* Writes data to the output file right away. 'offset' is only used for logging purposes. */
+            bool WriteData(const void *data, const size_t& data_size, const size_t& offset);
+
+            /* Stages data sent to a USB host under file delta mode. Only blocks whose checksums differ from the ones provided by the USB host are transferred. Used by WriteData(). */
+            bool WriteDeltaData(const void *data, const size_t& data_size);
+
+            /* Compares the staged USB_FILE_DELTA_BLOCK_SIZE blocks against the ones held by the USB host, then sends runs of consecutive mismatching blocks. Used by WriteDeltaData(). */
+            bool SendDeltaBatch(void);
+
+            /* Writes data to the current UMS file stream, using the preferred write block size. */
+            bool WriteFileStream(const void *data, const size_t& data_size);
+
+            /* Starts the background I/O thread, if needed. Writes are carried out synchronously if it can't be started. */
+            void StartIoThread(void);
+
+            /* Queues all staged data, waits until all queued writes have been carried out, then joins the background I/O thread. */
+            void StopIoThread(void);
+
+            /* Queues staged data up to the last cluster boundary it reaches, or all of it if 'all' is true. The rest is kept staged. */
+            bool QueueStagedData(bool all);
+
+            /* Waits until there's enough room in the queue, then queues the provided request. Returns false if a previously queued write failed. */
+            bool QueueWriteRequest(WriteRequest&& request);
+
+            /* Retrieves a spare buffer from the queue, if available. Must be called with the queue mutex held. */
+            std::vector<u8> GetSpareBuffer(void);
+
+            /* Queues all staged data, then waits until all queued writes have been carried out. Returns false if any of them failed. */
+            bool WaitForWriteQueue(void);
+
+            /* I/O thread function. Writes queued data in order. */
+            static void IoThreadFunc(void *arg);
+
+            /* Hands a single copy of the provided data over to all mirror I/O threads. Returns false if a previous mirror write failed. */
+            bool WriteMirrors(const void *data, const size_t& data_size);
+
+            /* Waits until all mirror writes have been carried out. Returns false if any of them failed. */
+            bool WaitForMirrors(void);
+
+            /* Waits for all mirror writes, joins the mirror I/O threads and closes all mirror files. */
+            void CloseMirrors(bool force_delete);
+
+            /* Mirror I/O thread function. Writes shared data to a single mirror file, in order. */
+            static void MirrorThreadFunc(void *arg);
+
         protected:
             /* Set class as non-copyable and non-moveable. */
             NON_COPYABLE(FileWriter);
             NON_MOVEABLE(FileWriter);
 
         public:
-            FileWriter(const std::string& output_path, const size_t& total_size, const u32& nsp_header_size = 0);
+            /* If 'resume_offset' is non-zero, a previously created, incomplete output file is reopened and data is appended at the provided offset. */
+            /* Resuming is only supported for non-NSP files. USB hosts must already hold 'resume_offset' bytes from the file (see usbGetFileResumeInfo()). */
+            /* If 'nsp_header' is provided, it's written in place of the zeroed NSP header placeholder. It must be 'nsp_header_size' bytes long. */
+            /* If 'compress' is true, the output file is written as a compressed container. 'total_size' still refers to the uncompressed data size. */
+            /* Compression isn't supported for USB hosts, NSP files, resumed files nor empty files. */
+            /* If 'nsp_layout' is provided, NSP files sent to a USB host are assembled by the host itself, which lets NSP file entries and the NSP header be written in any order (see usbStartNspLayout()). */
+            /* It's ignored for any other storage type. */
+            /* If 'force_split' is true, the output file is split regardless of its size, as long as the target storage needs split files for big dumps (e.g. FAT-based UMS volumes). */
+            /* Only meant to be used to measure the overhead from split files without having to write more than 4 GiB of data (see OutputStorageBenchmarkTask). */
+            FileWriter(const std::string& output_path, const size_t& total_size, const u32& nsp_header_size = 0, const size_t& resume_offset = 0, const void *nsp_header = nullptr,
+                       const bool& compress = false, const std::vector<UsbNspLayoutEntry>& nsp_layout = {}, const bool& force_split = false);
             ~FileWriter();
 
             /* Writes data to the output file. */
             /* Takes care of seamlessly switching to a new part file if needed. */
+            /* Under the SD card and UMS devices, data is queued and this returns right away. 'data' may be reused as soon as this returns. */
             bool Write(const void *data, const size_t& data_size);
 
+            /* Leases a page-aligned, USB-ready buffer with room for at least 'size' bytes, so producers can generate data in place instead of having it copied later on. */
+            /* Only a single lease may be active at a time, and 'size' must not exceed USB_TRANSFER_BUFFER_SIZE. Returns nullptr if there's an error. */
+            void *AcquireBuffer(const size_t& size);
+
+            /* Writes the first 'data_size' bytes from the leased buffer to the output file, then ends the lease. A zero 'data_size' just ends the lease. */
+            bool Commit(const size_t& data_size);
+
+            /* Same as Write(), but data sent to a USB host is transferred asynchronously. USB transfers complete in order, and 'callback' is issued once each one is done. */
+            /* 'data' must be page aligned and must remain untouched until then. For any other storage type, data is queued right away (see Write()) and 'callback' is issued before returning. */
+            /* 'callback' is only issued if this method returns true. */
+            bool WriteAsync(const void *data, const size_t& data_size, UsbFileDataTransferCallback callback, void *user_data);
+
+            /* Waits for all pending asynchronous and queued writes to complete. Returns false if any of them failed. */
+            bool Flush(void);
+
+            /* Must be called right before writing the data from each NSP file entry. Only does something if dealing with a NSP file sent to a USB host. */
+            /* Sends the entry properties under NSP transfer mode, or starts a data transfer stage for the whole entry under NSP layout mode. */
+            /* If 'checksum_type' isn't UsbChecksumType_None, the USB host calculates a checksum over the entry data, which can then be checked with usbVerifyFileChecksum(). */
+            bool StartNspEntry(const u32& entry_idx, const char *entry_name, const size_t& data_size, const u8& checksum_type = UsbChecksumType_None);
+
+            /* Makes the USB host append 'data_size' bytes from a previously transferred file, starting at 'src_offset', instead of sending them. */
+            /* Only valid if dealing with a NSP file sent to a USB host. 'entry_idx' and 'entry_name' refer to the NSP file entry being written. */
+            bool WriteReference(const u32& entry_idx, const char *entry_name, const std::string& src_path, const size_t& src_offset, const size_t& data_size);
+
             /* Writes NSP header data to offset 0. */
-            /* Only valid if dealing with a NSP file. */
+            /* Only valid if dealing with a NSP file. Nothing is rewritten if it matches the initial NSP header provided to the constructor. */
             bool WriteNspHeader(const void *nsp_header, const u32& nsp_header_size);
 
-            /* Closes the file and deletes it if it's incomplete (or if forcefully requested). */
+            /* Waits for all queued writes, then closes the file and deletes it if it's incomplete, if a queued write failed (or if forcefully requested). */
+            /* Mirror files are closed as well. Each one of them is deleted if it's incomplete on its own. */
             void Close(bool force_delete = false);
 
+            /* Creates a mirror output file with the same size at the provided path. Everything written to this file from now on is also written to the mirror file, by its own I/O thread. */
+            /* Must be called before writing any data. Not supported for NSP files, resumed files nor compressed files. Only a single USB host may be used across all output files. */
+            /* Mirror files are never kept if incomplete. Returns an error string if the mirror file can't be created. */
+            std::optional<std::string> AddMirror(const std::string& output_path);
+
+            /* Controls whether an incomplete file should be kept on Close() instead of being deleted, so it can be resumed later. */
+            /* Has no effect on forced deletions, on files sent to a USB host, on compressed files, nor on mirror files. */
+            void SetKeepIncompleteFile(bool keep);
+
+            /* Returns the current output file offset. For compressed files, this is the amount of input data provided so far. */
+            size_t GetCurrentOffset(void);
+
             /* Returns the storage type for this file. */
             StorageType GetStorageType(void);
+
+            /* Returns the storage type that would be used for the provided output path. */
+            static StorageType GetStorageTypeByPath(const std::string& output_path);
     };
 }
 
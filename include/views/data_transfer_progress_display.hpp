@@ -29,11 +29,12 @@
 namespace nxdt::views
 {
     /* Used to display the progress of an ongoing data transfer task. Shows a progress bar, a spinner, a percentage value, the process speed and an ETA value. */
+    /* Per-stage speeds and buffer occupancy values are also displayed for tasks that process data using a multithreaded pipeline. */
     class DataTransferProgressDisplay: public brls::View
     {
         private:
             brls::ProgressDisplay *progress_display = nullptr;
-            brls::Label *size_lbl = nullptr, *speed_eta_lbl = nullptr;
+            brls::Label *size_lbl = nullptr, *speed_eta_lbl = nullptr, *stages_lbl = nullptr;
 
             std::string GetFormattedSizeString(double size);
 
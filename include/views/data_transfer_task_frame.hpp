@@ -24,6 +24,7 @@
 #ifndef __DATA_TRANSFER_TASK_FRAME_HPP__
 #define __DATA_TRANSFER_TASK_FRAME_HPP__
 
+#include "../core/usb.h"
 #include "../utils/is_base_of_template.hpp"
 #include "error_frame.hpp"
 #include "data_transfer_progress_display.hpp"
@@ -95,7 +96,7 @@ namespace nxdt::views
                         if (ret)
                         {
                             /* Store notification message. */
-                            this->notification = brls::i18n::getStr("generic/process_complete");
+                            this->notification = this->GetTaskCompletionMessage();
 
                             /* Pop view. */
                             this->onCancel();
@@ -126,6 +127,10 @@ namespace nxdt::views
                 /* Cancel background task. This will have no effect if the background task already finished or if it was already cancelled. */
                 this->task.Cancel();
 
+                /* Interrupt the USB file data transfer the background task may be blocked on, if any. */
+                /* Otherwise, it could take up to USB_TRANSFER_TIMEOUT seconds for the task to notice it was cancelled. */
+                if (!this->task.IsFinished()) usbAbortFileTransfer();
+
                 /* Pop view. This will invoke this class' destructor. */
                 brls::Application::popView(brls::ViewAnimation::SLIDE_RIGHT);
 
@@ -136,6 +141,12 @@ namespace nxdt::views
             /* If the task failed, false shall be returned and `error_msg` shall be updated to reflect the error reason. */
             virtual bool GetTaskResult(std::string& error_msg) = 0;
 
+            /* May be overridden by derived classes to customize the notification message displayed after the background task succeeds. */
+            virtual std::string GetTaskCompletionMessage(void)
+            {
+                return brls::i18n::getStr("generic/process_complete");
+            }
+
         public:
             template<typename... Params>
             DataTransferTaskFrame(const std::string& title, const Params&... params) : brls::AppletFrame(true, true)
@@ -41,6 +41,7 @@ namespace nxdt::views
             brls::List *list = nullptr;
             brls::InputListItem *filename = nullptr;
             brls::SelectListItem *output_storage = nullptr;
+            brls::SelectListItem *mirror_storage = nullptr;
             brls::GenericEvent *button_click_event = nullptr;
 
             nxdt::tasks::UmsEvent::Subscription ums_task_sub;
@@ -53,8 +54,15 @@ namespace nxdt::views
 
             std::vector<std::string> GenerateOutputStoragesVector(const nxdt::tasks::UmsDeviceVector& ums_devices);
 
+            /* Same as GenerateOutputStoragesVector(), but a "None" value is placed at the start. */
+            std::vector<std::string> GenerateMirrorStoragesVector(const nxdt::tasks::UmsDeviceVector& ums_devices);
+
+            std::string GetStoragePrefix(u32 selected);
+
             void UpdateStoragePrefix(u32 selected);
 
+            bool GenerateOutputFilePath(const std::string& storage_prefix, u32 selected, const std::string& extension, std::string& output);
+
         protected:
             DumpOptionsFrame(RootView *root_view, const std::string& title, const std::string& base_output_path, const std::string& raw_filename);
             DumpOptionsFrame(RootView *root_view, const std::string& title, brls::Image *icon, const std::string& base_output_path, const std::string& raw_filename);
@@ -66,12 +74,25 @@ namespace nxdt::views
 
             bool GetOutputFilePath(const std::string& extension, std::string& output);
 
+            /* Adds a "Mirror storage" SelectListItem right where it's called, which lets the user write the dumped data to an additional output storage. */
+            /* Only meant to be used by dump types that support FileWriter mirroring. */
+            void AddMirrorStorageItem(void);
+
+            /* Generates the mirror output path. 'output' is left empty if no mirror storage was selected. Returns false if there's an error. */
+            bool GetMirrorOutputFilePath(const std::string& extension, std::string& output);
+
+            /* Displays a notification if stored output storage benchmark results suggest writing 'dump_size' bytes to 'output_path' would take an hour or more. */
+            void NotifySlowOutputStorage(const std::string& output_path, size_t dump_size);
+
             ALWAYS_INLINE brls::GenericEvent::Subscription RegisterButtonListener(brls::GenericEvent::Callback cb)
             {
                 return this->button_click_event->subscribe([this, cb](brls::View *view){
-                    /* Check if the USB host is currently selected as the output storage. */
+                    /* Check if the USB host is currently selected as the output storage (or the mirror storage). */
                     /* If so, we'll prevent the provided callback from running. */
-                    if (this->output_storage->getSelectedValue() == ConfigOutputStorage_UsbHost && this->root_view->GetUsbHostSpeed() == UsbHostSpeed_None)
+                    bool usb_host_selected = (this->output_storage->getSelectedValue() == ConfigOutputStorage_UsbHost || \
+                                              (this->mirror_storage && this->mirror_storage->getSelectedValue() == (ConfigOutputStorage_UsbHost + 1)));
+
+                    if (usb_host_selected && this->root_view->GetUsbHostSpeed() == UsbHostSpeed_None)
                     {
                         brls::Application::notify(brls::i18n::getStr("dump_options/notifications/usb_host_unavailable"));
                         return;
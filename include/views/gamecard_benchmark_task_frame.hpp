@@ -0,0 +1,72 @@
+/*
+ * gamecard_benchmark_task_frame.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __GAMECARD_BENCHMARK_TASK_FRAME_HPP__
+#define __GAMECARD_BENCHMARK_TASK_FRAME_HPP__
+
+#include <algorithm>
+
+#include "data_transfer_task_frame.hpp"
+#include "../tasks/gamecard_benchmark_task.hpp"
+
+namespace nxdt::views
+{
+    class GameCardBenchmarkTaskFrame: public DataTransferTaskFrame<nxdt::tasks::GameCardBenchmarkTask>
+    {
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(GameCardBenchmarkTaskFrame);
+            NON_MOVEABLE(GameCardBenchmarkTaskFrame);
+
+            bool GetTaskResult(std::string& error_msg) override final
+            {
+                auto res = this->task.GetResult();
+                if (res.has_value())
+                {
+                    error_msg = res.value();
+                    return false;
+                }
+
+                return true;
+            }
+
+            std::string GetTaskCompletionMessage(void) override final
+            {
+                auto results = this->task.GetBenchmarkResults();
+                if (results.empty()) return brls::i18n::getStr("generic/process_complete");
+
+                /* Display a short summary using the fastest benchmark pass. Full results are available in the logfile. */
+                auto best = std::max_element(results.begin(), results.end(), [](const auto& a, const auto& b) { return (a.speed < b.speed); });
+
+                char block_size_str[0x40] = {0};
+                utilsGenerateFormattedSizeString(static_cast<double>(best->block_size), block_size_str, sizeof(block_size_str));
+
+                return brls::i18n::getStr("tasks/gamecard/benchmark/complete", best->speed, block_size_str, this->task.GetSwitchCost());
+            }
+
+        public:
+            GameCardBenchmarkTaskFrame(void) : DataTransferTaskFrame<nxdt::tasks::GameCardBenchmarkTask>(brls::i18n::getStr("gamecard_tab/list/benchmark_card_reads/label")) { }
+    };
+}
+
+#endif  /* __GAMECARD_BENCHMARK_TASK_FRAME_HPP__ */
@@ -37,8 +37,11 @@ namespace nxdt::views
             brls::ToggleListItem *prepend_key_area = nullptr;
             brls::ToggleListItem *keep_certificate = nullptr;
             brls::ToggleListItem *trim_dump = nullptr;
+            brls::ToggleListItem *skip_padding = nullptr;
             brls::ToggleListItem *calculate_checksum = nullptr;
             brls::ToggleListItem *lookup_checksum = nullptr;
+            brls::ToggleListItem *compress_output = nullptr;
+            brls::ToggleListItem *verify_hfs_hashes = nullptr;
 
         public:
             GameCardImageDumpOptionsFrame(RootView *root_view, std::string raw_filename);
@@ -48,6 +48,15 @@ namespace nxdt::views
                 return true;
             }
 
+            std::string GetTaskCompletionMessage(void) override final
+            {
+                auto res = this->task.GetChecksumLookupResult();
+                if (!res.has_value()) return brls::i18n::getStr("generic/process_complete");
+
+                return (res.value().empty() ? brls::i18n::getStr("tasks/gamecard/image/checksum_lookup_no_match") : \
+                                              brls::i18n::getStr("tasks/gamecard/image/checksum_lookup_match", res.value()));
+            }
+
         public:
             template<typename... Params>
             GameCardImageDumpTaskFrame(Params... params) :
@@ -44,7 +44,7 @@ namespace nxdt::views
             brls::List *changelog_list = nullptr;                   /// Second stage.
             DataTransferProgressDisplay *update_progress = nullptr; /// Third stage.
 
-            nxdt::tasks::DownloadFileTask nro_task;
+            nxdt::tasks::DownloadRangedFileTask nro_task;
 
             void DisplayChangelog(void);
             void DisplayUpdateProgress(void);
@@ -58,6 +58,24 @@ namespace nxdt::views
             ~OptionsTabUpdateApplicationFrame();
     };
 
+    /* I/O and crypto counters frame. Values are refreshed each time the status info task fires its event. */
+    class OptionsTabDiagnosticsFrame: public brls::AppletFrame
+    {
+        private:
+            RootView *root_view = nullptr;
+            nxdt::tasks::StatusInfoEvent::Subscription status_info_task_sub;
+
+            brls::List *list = nullptr;
+            brls::ListItem *elapsed_time = nullptr;
+            std::array<brls::ListItem*, StatsCounterType_Count> counters{};
+
+            void UpdateCounters(const StatsSnapshot& stats);
+
+        public:
+            OptionsTabDiagnosticsFrame(RootView *root_view);
+            ~OptionsTabDiagnosticsFrame();
+    };
+
     class OptionsTab: public brls::List
     {
         private:
@@ -0,0 +1,74 @@
+/*
+ * output_storage_benchmark_task_frame.hpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __OUTPUT_STORAGE_BENCHMARK_TASK_FRAME_HPP__
+#define __OUTPUT_STORAGE_BENCHMARK_TASK_FRAME_HPP__
+
+#include "data_transfer_task_frame.hpp"
+#include "../tasks/output_storage_benchmark_task.hpp"
+
+namespace nxdt::views
+{
+    class OutputStorageBenchmarkTaskFrame: public DataTransferTaskFrame<nxdt::tasks::OutputStorageBenchmarkTask>
+    {
+        protected:
+            /* Set class as non-copyable and non-moveable. */
+            NON_COPYABLE(OutputStorageBenchmarkTaskFrame);
+            NON_MOVEABLE(OutputStorageBenchmarkTaskFrame);
+
+            bool GetTaskResult(std::string& error_msg) override final
+            {
+                auto res = this->task.GetResult();
+                if (res.has_value())
+                {
+                    error_msg = res.value();
+                    return false;
+                }
+
+                return true;
+            }
+
+            std::string GetTaskCompletionMessage(void) override final
+            {
+                nxdt::tasks::OutputStorageBenchmarkResult result{};
+                if (!this->task.GetBenchmarkResult(result)) return brls::i18n::getStr("generic/process_complete");
+
+                auto to_mib = [](u64 speed) -> double { return (static_cast<double>(speed) / 1048576.0); };
+
+                if (!this->task.IsSplitFileSupported())
+                {
+                    return brls::i18n::getStr("tasks/output_benchmark/complete_no_split", to_mib(result.seq_write_speed), to_mib(result.seq_read_speed), to_mib(result.storm_write_speed),
+                                              result.storm_files_per_sec);
+                }
+
+                return brls::i18n::getStr("tasks/output_benchmark/complete", to_mib(result.seq_write_speed), to_mib(result.seq_read_speed), to_mib(result.storm_write_speed),
+                                          result.storm_files_per_sec, to_mib(result.split_write_speed), to_mib(result.split_read_speed));
+            }
+
+        public:
+            OutputStorageBenchmarkTaskFrame(const std::string& storage_root) :
+                DataTransferTaskFrame<nxdt::tasks::OutputStorageBenchmarkTask>(brls::i18n::getStr("options_tab/benchmark_output_storage/label"), storage_root) { }
+    };
+}
+
+#endif  /* __OUTPUT_STORAGE_BENCHMARK_TASK_FRAME_HPP__ */
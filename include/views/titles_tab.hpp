@@ -24,6 +24,8 @@
 #ifndef __TITLES_TAB_HPP__
 #define __TITLES_TAB_HPP__
 
+#include <list>
+
 #include "root_view.hpp"
 #include "layered_error_frame.hpp"
 
@@ -45,15 +47,34 @@ namespace nxdt::views
     };
 
     /* Expanded ListItem class to hold application metadata. */
+    /* Icons are only decoded while the item is on screen or close to it, and decoded icons are kept in a LRU cache shared by all items. */
     class TitlesTabItem: public brls::ListItem
     {
         private:
+            /* Maximum number of decoded icons held by all TitlesTabItem objects at once. */
+            static constexpr size_t IconCacheCapacity = 64;
+
+            /* Items with a decoded icon, sorted from most to least recently drawn. */
+            static std::list<TitlesTabItem*> icon_cache;
+
             const TitleApplicationMetadata *app_metadata = nullptr;
             bool is_system = false;
             bool click_anim = true;
 
+            bool icon_loaded = false;
+            std::list<TitlesTabItem*>::iterator icon_cache_it{};
+
+            /* Decodes the application icon (if needed) and marks it as the most recently used one. Evicts the least recently used icon if the cache is full. */
+            void LoadIcon(void);
+
+            /* Frees the decoded application icon, if available. */
+            void UnloadIcon(void);
+
         public:
             TitlesTabItem(const TitleApplicationMetadata *app_metadata, bool is_system, bool click_anim = true);
+            ~TitlesTabItem();
+
+            void draw(NVGcontext* vg, int x, int y, unsigned width, unsigned height, brls::Style* style, brls::FrameContext* ctx) override;
 
             void playClickAnimation(void) override;
 
@@ -68,19 +89,32 @@ namespace nxdt::views
             }
     };
 
+    /* List items are created in batches, as the visible area gets close to the last created item. Titles that are never scrolled into view never get a list item. */
     class TitlesTab: public LayeredErrorFrame
     {
         private:
+            /* Number of list items created at once. Must cover more than a screen's worth of items. */
+            static constexpr u32 ItemBatchSize = 32;
+
             RootView *root_view = nullptr;
 
             nxdt::tasks::UserTitleEvent::Subscription title_task_sub;
             bool is_system = false;
 
+            /* Application metadata used to create list items. Owned by the title metadata task. */
+            TitleApplicationMetadata **app_metadata = nullptr;
+            u32 app_metadata_count = 0, app_metadata_idx = 0;
+
             void PopulateList(const nxdt::tasks::TitleApplicationMetadataInfo& app_metadata_info);
 
+            /* Creates list items for the next batch of application metadata entries, if there are any left. */
+            void AppendListItems(void);
+
         public:
             TitlesTab(RootView *root_view, bool is_system);
             ~TitlesTab();
+
+            void draw(NVGcontext* vg, int x, int y, unsigned width, unsigned height, brls::Style* style, brls::FrameContext* ctx) override;
     };
 }
 
@@ -20,6 +20,53 @@
  */
 
 #include <core/nxdt_utils.h>
+#include <arm_neon.h>
+
+#define AES_XTS_BATCH_BLOCK_COUNT   4   /* Number of AES blocks processed in parallel by the batched AES-XTS kernel. */
+
+#define AES_CTR_PARALLEL_CORE_COUNT 3   /* Cores 0, 1 and 2. Each one gets its own worker thread, which is only used while the calling thread runs on a different core. */
+
+/* Type definitions. */
+
+typedef enum {
+    AesCtrParallelWorkerState_Idle    = 0,
+    AesCtrParallelWorkerState_Pending = 1,
+    AesCtrParallelWorkerState_Done    = 2
+} AesCtrParallelWorkerState;
+
+typedef struct {
+    Thread thread;
+    bool created;
+    u8 state;                   ///< AesCtrParallelWorkerState.
+    Aes128CtrContext ctr_ctx;   ///< Copy of the caller's context. Its counter is reset to the start of the assigned chunk.
+    void *dst;
+    const void *src;
+    size_t size;
+} AesCtrParallelWorker;
+
+/* Global variables. */
+
+static Mutex g_aesCtrParallelMutex = 0;     /* Held by the thread that currently owns the workers. Other threads fall back to single-core crypto. */
+static Mutex g_aesCtrParallelWorkerMutex = 0;
+static CondVar g_aesCtrParallelWorkerCondvar = 0;
+static bool g_aesCtrParallelInit = false, g_aesCtrParallelExit = false;
+static AesCtrParallelWorker g_aesCtrParallelWorkers[AES_CTR_PARALLEL_CORE_COUNT] = {0};
+
+/* Function prototypes. */
+
+static void aes128CtrParallelInitialize(void);
+static void aes128CtrParallelWorkerThreadFunc(void *arg);
+
+NX_INLINE void aes128CtrAddBlockCount(u8 *ctr, u64 block_count);
+
+NX_INLINE void aes128LoadRoundKeys(uint8x16_t *out, const Aes128Context *ctx);
+NX_INLINE uint8x16_t aes128EncryptBlockNeon(uint8x16_t block, const uint8x16_t *round_keys);
+
+NX_INLINE uint8x16_t aes128XtsGetNintendoTweak(u64 sector, const uint8x16_t *tweak_round_keys);
+NX_INLINE uint8x16_t aes128XtsMultiplyTweak(uint8x16_t tweak);
+
+NX_INLINE void aes128XtsEncryptBlockBatch(uint8x16_t *blocks, const uint8x16_t *round_keys);
+NX_INLINE void aes128XtsDecryptBlockBatch(uint8x16_t *blocks, const uint8x16_t *round_keys);
 
 void aes128EcbCrypt(void *dst, const void *src, const void *key, bool encrypt)
 {
@@ -47,16 +94,298 @@ size_t aes128XtsNintendoCrypt(Aes128XtsContext *ctx, void *dst, const void *src,
     size_t i, crypt_res = 0;
     u64 cur_sector = sector;
 
+    statsAddCounter(StatsCounterType_AesXts, size);
+
     u8 *dst_u8 = (u8*)dst;
     const u8 *src_u8 = (const u8*)src;
 
+    /* Fallback to the libnx implementation if the sector size can't be handled by the batched kernel. */
+    if ((sector_size % (AES_BLOCK_SIZE * AES_XTS_BATCH_BLOCK_COUNT)) != 0)
+    {
+        for(i = 0; i < size; i += sector_size, cur_sector++)
+        {
+            /* We have to force a sector reset on each new sector to actually enable Nintendo AES-XTS cipher tweak. */
+            aes128XtsContextResetSector(ctx, cur_sector, true);
+            crypt_res = (encrypt ? aes128XtsEncrypt(ctx, dst_u8 + i, src_u8 + i, sector_size) : aes128XtsDecrypt(ctx, dst_u8 + i, src_u8 + i, sector_size));
+            if (crypt_res != sector_size) break;
+        }
+
+        return i;
+    }
+
+    /* Load round keys once. They're kept in NEON registers across all sectors. */
+    uint8x16_t data_round_keys[AES_128_NUM_ROUNDS + 1], tweak_round_keys[AES_128_NUM_ROUNDS + 1];
+    aes128LoadRoundKeys(data_round_keys, &(ctx->aes_ctx));
+    aes128LoadRoundKeys(tweak_round_keys, &(ctx->tweak_ctx));
+
     for(i = 0; i < size; i += sector_size, cur_sector++)
     {
-        /* We have to force a sector reset on each new sector to actually enable Nintendo AES-XTS cipher tweak. */
-        aes128XtsContextResetSector(ctx, cur_sector, true);
-        crypt_res = (encrypt ? aes128XtsEncrypt(ctx, dst_u8 + i, src_u8 + i, sector_size) : aes128XtsDecrypt(ctx, dst_u8 + i, src_u8 + i, sector_size));
-        if (crypt_res != sector_size) break;
+        /* Calculate the Nintendo AES-XTS tweak for the current sector. */
+        uint8x16_t tweak = aes128XtsGetNintendoTweak(cur_sector, tweak_round_keys);
+
+        for(size_t j = 0; j < sector_size; j += (AES_BLOCK_SIZE * AES_XTS_BATCH_BLOCK_COUNT))
+        {
+            uint8x16_t blocks[AES_XTS_BATCH_BLOCK_COUNT], tweaks[AES_XTS_BATCH_BLOCK_COUNT];
+
+            /* Load input blocks and XOR them with their tweaks. */
+            for(u32 k = 0; k < AES_XTS_BATCH_BLOCK_COUNT; k++)
+            {
+                tweaks[k] = tweak;
+                blocks[k] = veorq_u8(vld1q_u8(src_u8 + i + j + (k * AES_BLOCK_SIZE)), tweak);
+                tweak = aes128XtsMultiplyTweak(tweak);
+            }
+
+            /* Process all blocks in parallel. */
+            if (encrypt)
+            {
+                aes128XtsEncryptBlockBatch(blocks, data_round_keys);
+            } else {
+                aes128XtsDecryptBlockBatch(blocks, data_round_keys);
+            }
+
+            /* XOR output blocks with their tweaks and store them. */
+            for(u32 k = 0; k < AES_XTS_BATCH_BLOCK_COUNT; k++) vst1q_u8(dst_u8 + i + j + (k * AES_BLOCK_SIZE), veorq_u8(blocks[k], tweaks[k]));
+        }
     }
 
     return i;
 }
+
+void aes128CtrCryptParallel(Aes128CtrContext *ctx, const u8 *ctr, void *dst, const void *src, size_t size)
+{
+    if (!ctx || !ctr || !dst || !src || !size) return;
+
+    AesCtrParallelWorker *workers[AES_CTR_PARALLEL_CORE_COUNT] = {0};
+    u32 worker_count = 0;
+    s32 cur_core = -1;
+
+    u8 chunk_ctr[AES_BLOCK_SIZE] = {0};
+    size_t chunk_size = 0, offset = 0;
+
+    /* Use a single core for small buffers, or if another thread is already using the workers. */
+    if (size < AES_CTR_PARALLEL_MIN_SIZE || !mutexTryLock(&g_aesCtrParallelMutex))
+    {
+        aes128CtrContextResetCtr(ctx, ctr);
+        aes128CtrCrypt(ctx, dst, src, size);
+        return;
+    }
+
+    /* Start the worker threads, if needed. Only the workers placed on cores other than our own are used. */
+    if (!g_aesCtrParallelInit) aes128CtrParallelInitialize();
+
+    cur_core = (s32)svcGetCurrentProcessorNumber();
+
+    for(u32 i = 0; i < AES_CTR_PARALLEL_CORE_COUNT; i++)
+    {
+        if (g_aesCtrParallelWorkers[i].created && (s32)i != cur_core) workers[worker_count++] = &(g_aesCtrParallelWorkers[i]);
+    }
+
+    /* Split the buffer into AES-block-aligned chunks: one per worker, plus the last one, which is processed by the calling thread. */
+    /* Each chunk gets its own counter, calculated from its offset within the buffer. */
+    chunk_size = ALIGN_UP(size / (worker_count + 1), AES_BLOCK_SIZE);
+
+    SCOPED_LOCK(&g_aesCtrParallelWorkerMutex)
+    {
+        for(u32 i = 0; i < worker_count && (offset + chunk_size) < size; i++, offset += chunk_size)
+        {
+            AesCtrParallelWorker *worker = workers[i];
+
+            memcpy(chunk_ctr, ctr, AES_BLOCK_SIZE);
+            aes128CtrAddBlockCount(chunk_ctr, offset / AES_BLOCK_SIZE);
+
+            memcpy(&(worker->ctr_ctx), ctx, sizeof(Aes128CtrContext));
+            aes128CtrContextResetCtr(&(worker->ctr_ctx), chunk_ctr);
+
+            worker->dst = ((u8*)dst + offset);
+            worker->src = ((const u8*)src + offset);
+            worker->size = chunk_size;
+            worker->state = AesCtrParallelWorkerState_Pending;
+        }
+
+        condvarWakeAll(&g_aesCtrParallelWorkerCondvar);
+    }
+
+    /* Process the last chunk on our own while the workers take care of the rest. This leaves the provided context in the same state a single aes128CtrCrypt() call would. */
+    memcpy(chunk_ctr, ctr, AES_BLOCK_SIZE);
+    aes128CtrAddBlockCount(chunk_ctr, offset / AES_BLOCK_SIZE);
+
+    aes128CtrContextResetCtr(ctx, chunk_ctr);
+    aes128CtrCrypt(ctx, (u8*)dst + offset, (const u8*)src + offset, size - offset);
+
+    /* Wait for the workers. */
+    SCOPED_LOCK(&g_aesCtrParallelWorkerMutex)
+    {
+        for(u32 i = 0; i < worker_count; i++)
+        {
+            AesCtrParallelWorker *worker = workers[i];
+            while(worker->state == AesCtrParallelWorkerState_Pending) condvarWait(&g_aesCtrParallelWorkerCondvar, &g_aesCtrParallelWorkerMutex);
+            worker->state = AesCtrParallelWorkerState_Idle;
+        }
+    }
+
+    mutexUnlock(&g_aesCtrParallelMutex);
+}
+
+void aes128CtrParallelExit(void)
+{
+    SCOPED_LOCK(&g_aesCtrParallelMutex)
+    {
+        if (!g_aesCtrParallelInit) break;
+
+        /* Ask the worker threads to exit. */
+        SCOPED_LOCK(&g_aesCtrParallelWorkerMutex)
+        {
+            g_aesCtrParallelExit = true;
+            condvarWakeAll(&g_aesCtrParallelWorkerCondvar);
+        }
+
+        for(u32 i = 0; i < AES_CTR_PARALLEL_CORE_COUNT; i++)
+        {
+            AesCtrParallelWorker *worker = &(g_aesCtrParallelWorkers[i]);
+            if (!worker->created) continue;
+
+            utilsJoinThread(&(worker->thread));
+            worker->created = false;
+        }
+
+        g_aesCtrParallelExit = g_aesCtrParallelInit = false;
+    }
+}
+
+static void aes128CtrParallelInitialize(void)
+{
+    u32 worker_count = 0;
+
+    condvarInit(&g_aesCtrParallelWorkerCondvar);
+
+    /* Create a worker thread on each core. Stick to the workers we already have if we run into any errors. */
+    for(u32 i = 0; i < AES_CTR_PARALLEL_CORE_COUNT; i++)
+    {
+        AesCtrParallelWorker *worker = &(g_aesCtrParallelWorkers[i]);
+        worker->state = AesCtrParallelWorkerState_Idle;
+
+        if (!utilsCreateThread(&(worker->thread), aes128CtrParallelWorkerThreadFunc, worker, (int)i))
+        {
+            LOG_MSG_WARNING("Failed to create AES-CTR worker thread for core #%u!", i);
+            continue;
+        }
+
+        worker->created = true;
+        worker_count++;
+    }
+
+    /* Don't try again if no worker threads could be created. Every aes128CtrCryptParallel() call will just use the calling thread. */
+    if (worker_count)
+    {
+        LOG_MSG_DEBUG("AES-CTR worker threads created (%u worker[s]).", worker_count);
+    } else {
+        LOG_MSG_ERROR("Failed to create any AES-CTR worker threads!");
+    }
+
+    g_aesCtrParallelInit = true;
+}
+
+static void aes128CtrParallelWorkerThreadFunc(void *arg)
+{
+    AesCtrParallelWorker *worker = (AesCtrParallelWorker*)arg;
+
+    while(true)
+    {
+        bool exit_requested = false;
+
+        SCOPED_LOCK(&g_aesCtrParallelWorkerMutex)
+        {
+            /* Wait for new work. */
+            while(!(exit_requested = g_aesCtrParallelExit) && worker->state != AesCtrParallelWorkerState_Pending) condvarWait(&g_aesCtrParallelWorkerCondvar, &g_aesCtrParallelWorkerMutex);
+        }
+
+        if (exit_requested) break;
+
+        /* Process the assigned chunk without holding the mutex. Nobody else touches this worker while its chunk is pending. */
+        aes128CtrCrypt(&(worker->ctr_ctx), worker->dst, worker->src, worker->size);
+
+        SCOPED_LOCK(&g_aesCtrParallelWorkerMutex)
+        {
+            worker->state = AesCtrParallelWorkerState_Done;
+            condvarWakeAll(&g_aesCtrParallelWorkerCondvar);
+        }
+    }
+
+    threadExit();
+}
+
+NX_INLINE void aes128CtrAddBlockCount(u8 *ctr, u64 block_count)
+{
+    /* Counters are stored in big endian order. Propagate the carry through the whole block. */
+    for(u8 i = AES_BLOCK_SIZE; i > 0 && block_count; i--)
+    {
+        u64 sum = ((u64)ctr[i - 1] + (block_count & 0xFF));
+        ctr[i - 1] = (u8)(sum & 0xFF);
+        block_count = ((block_count >> 8) + (sum >> 8));
+    }
+}
+
+NX_INLINE void aes128LoadRoundKeys(uint8x16_t *out, const Aes128Context *ctx)
+{
+    for(u32 i = 0; i <= AES_128_NUM_ROUNDS; i++) out[i] = vld1q_u8(ctx->round_keys[i]);
+}
+
+NX_INLINE uint8x16_t aes128EncryptBlockNeon(uint8x16_t block, const uint8x16_t *round_keys)
+{
+    #pragma GCC unroll 16
+    for(u32 i = 0; i < (AES_128_NUM_ROUNDS - 1); i++) block = vaesmcq_u8(vaeseq_u8(block, round_keys[i]));
+
+    block = vaeseq_u8(block, round_keys[AES_128_NUM_ROUNDS - 1]);
+
+    return veorq_u8(block, round_keys[AES_128_NUM_ROUNDS]);
+}
+
+NX_INLINE uint8x16_t aes128XtsGetNintendoTweak(u64 sector, const uint8x16_t *tweak_round_keys)
+{
+    /* The Nintendo AES-XTS tweak stores the sector number in big endian order, within the upper half of the block. */
+    uint8x16_t tweak = vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(0), vcreate_u64(__builtin_bswap64(sector))));
+    return aes128EncryptBlockNeon(tweak, tweak_round_keys);
+}
+
+NX_INLINE uint8x16_t aes128XtsMultiplyTweak(uint8x16_t tweak)
+{
+    /* Multiply the tweak by alpha in GF(2^128), using the XTS polynomial. */
+    const int64x2_t poly = vcombine_s64(vcreate_s64(0x87), vcreate_s64(1));
+
+    int64x2_t value = vreinterpretq_s64_u8(tweak);
+    int64x2_t carry = vshrq_n_s64(value, 63);
+
+    carry = vandq_s64(vextq_s64(carry, carry, 1), poly);
+    value = vshlq_n_s64(value, 1);
+
+    return vreinterpretq_u8_s64(veorq_s64(value, carry));
+}
+
+NX_INLINE void aes128XtsEncryptBlockBatch(uint8x16_t *blocks, const uint8x16_t *round_keys)
+{
+    /* Interleave rounds across all blocks to hide AESE/AESMC latency. */
+    #pragma GCC unroll 16
+    for(u32 i = 0; i < (AES_128_NUM_ROUNDS - 1); i++)
+    {
+        #pragma GCC unroll 4
+        for(u32 j = 0; j < AES_XTS_BATCH_BLOCK_COUNT; j++) blocks[j] = vaesmcq_u8(vaeseq_u8(blocks[j], round_keys[i]));
+    }
+
+    #pragma GCC unroll 4
+    for(u32 j = 0; j < AES_XTS_BATCH_BLOCK_COUNT; j++) blocks[j] = veorq_u8(vaeseq_u8(blocks[j], round_keys[AES_128_NUM_ROUNDS - 1]), round_keys[AES_128_NUM_ROUNDS]);
+}
+
+NX_INLINE void aes128XtsDecryptBlockBatch(uint8x16_t *blocks, const uint8x16_t *round_keys)
+{
+    /* libnx already applies InvMixColumns to the inner round keys from decryption contexts, so they're used in reverse order as-is (equivalent inverse cipher). */
+    /* Interleave rounds across all blocks to hide AESD/AESIMC latency. */
+    #pragma GCC unroll 16
+    for(u32 i = AES_128_NUM_ROUNDS; i > 1; i--)
+    {
+        #pragma GCC unroll 4
+        for(u32 j = 0; j < AES_XTS_BATCH_BLOCK_COUNT; j++) blocks[j] = vaesimcq_u8(vaesdq_u8(blocks[j], round_keys[i]));
+    }
+
+    #pragma GCC unroll 4
+    for(u32 j = 0; j < AES_XTS_BATCH_BLOCK_COUNT; j++) blocks[j] = veorq_u8(vaesdq_u8(blocks[j], round_keys[1]), round_keys[0]);
+}
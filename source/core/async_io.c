@@ -0,0 +1,363 @@
+/*
+ * async_io.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <core/nxdt_utils.h>
+#include <core/async_io.h>
+#include <core/gamecard.h>
+#include <core/nca.h>
+#include <core/bktr.h>
+#include <core/save.h>
+
+/* Global variables. */
+
+static Mutex g_asyncIoMutex = 0;
+static CondVar g_asyncIoWorkerCondVar = 0;
+
+static Thread g_asyncIoWorkers[ASYNC_IO_WORKER_COUNT] = {0};
+static bool g_asyncIoWorkersStarted = false, g_asyncIoWorkersExit = false;
+
+/* Submission FIFO, shared by all completion queues. */
+static AsyncIoRequest *g_asyncIoSubmitHead = NULL, *g_asyncIoSubmitTail = NULL;
+
+static u32 g_asyncIoQueueDepths[AsyncIoBackend_Count] = {
+    [AsyncIoBackend_GameCard]            = 1,
+    [AsyncIoBackend_NcaContent]          = 2,
+    [AsyncIoBackend_BucketTree]          = 2,
+    [AsyncIoBackend_SaveAllocationTable] = 1,
+    [AsyncIoBackend_Custom]              = 2
+};
+
+static u32 g_asyncIoInFlightCounts[AsyncIoBackend_Count] = {0};
+
+/* Function prototypes. */
+
+static bool asyncIoStartWorkers(void);
+static void asyncIoWorkerThreadFunc(void *arg);
+
+static AsyncIoRequest *asyncIoTakeNextRequest(void);
+static bool asyncIoPerformRead(AsyncIoRequest *request);
+static void asyncIoCompleteRequest(AsyncIoRequest *request, bool success);
+
+static AsyncIoRequest *asyncIoGetCompletedRequest(AsyncIoQueue *queue, bool wait);
+
+void asyncIoInitializeQueue(AsyncIoQueue *queue)
+{
+    if (!queue) return;
+
+    memset(queue, 0, sizeof(AsyncIoQueue));
+    mutexInit(&(queue->mutex));
+    condvarInit(&(queue->cond));
+}
+
+bool asyncIoSubmit(AsyncIoQueue *queue, AsyncIoRequest *request)
+{
+    if (!queue || !request || request->backend >= AsyncIoBackend_Count || (request->backend == AsyncIoBackend_Custom && !request->custom_read) || \
+        (request->backend != AsyncIoBackend_GameCard && request->backend != AsyncIoBackend_Custom && !request->ctx) || !request->out || !request->read_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    bool ret = false;
+
+    request->success = false;
+    request->queue = queue;
+    request->next = NULL;
+
+    /* Account for the new request before it can be completed by a worker thread. */
+    SCOPED_LOCK(&(queue->mutex)) queue->pending_count++;
+
+    SCOPED_LOCK(&g_asyncIoMutex)
+    {
+        /* Start the shared I/O thread pool, if needed. */
+        if (!g_asyncIoWorkersStarted && !asyncIoStartWorkers()) break;
+
+        /* Append request to the submission FIFO. */
+        if (g_asyncIoSubmitTail)
+        {
+            g_asyncIoSubmitTail->next = request;
+        } else {
+            g_asyncIoSubmitHead = request;
+        }
+
+        g_asyncIoSubmitTail = request;
+
+        condvarWakeOne(&g_asyncIoWorkerCondVar);
+
+        ret = true;
+    }
+
+    if (!ret) SCOPED_LOCK(&(queue->mutex)) queue->pending_count--;
+
+    return ret;
+}
+
+AsyncIoRequest *asyncIoWaitCompletion(AsyncIoQueue *queue)
+{
+    return asyncIoGetCompletedRequest(queue, true);
+}
+
+AsyncIoRequest *asyncIoPollCompletion(AsyncIoQueue *queue)
+{
+    return asyncIoGetCompletedRequest(queue, false);
+}
+
+void asyncIoDrainQueue(AsyncIoQueue *queue)
+{
+    while(asyncIoWaitCompletion(queue));
+}
+
+void asyncIoSetQueueDepth(u8 backend, u32 depth)
+{
+    if (backend >= AsyncIoBackend_Count) return;
+
+    SCOPED_LOCK(&g_asyncIoMutex)
+    {
+        g_asyncIoQueueDepths[backend] = MIN(MAX(depth, 1), ASYNC_IO_WORKER_COUNT);
+
+        /* Wake up all worker threads. Requests held back by the previous queue depth may be eligible now. */
+        condvarWakeAll(&g_asyncIoWorkerCondVar);
+    }
+}
+
+u32 asyncIoGetQueueDepth(u8 backend)
+{
+    u32 ret = 0;
+
+    if (backend < AsyncIoBackend_Count)
+    {
+        SCOPED_LOCK(&g_asyncIoMutex) ret = g_asyncIoQueueDepths[backend];
+    }
+
+    return ret;
+}
+
+void asyncIoExit(void)
+{
+    AsyncIoRequest *request = NULL;
+
+    SCOPED_LOCK(&g_asyncIoMutex)
+    {
+        if (!g_asyncIoWorkersStarted) break;
+
+        g_asyncIoWorkersExit = true;
+        condvarWakeAll(&g_asyncIoWorkerCondVar);
+    }
+
+    /* Wait for all worker threads to finish their current requests. The mutex can't be held here. */
+    for(u32 i = 0; i < ASYNC_IO_WORKER_COUNT; i++)
+    {
+        if (g_asyncIoWorkers[i].handle == INVALID_HANDLE) continue;
+        threadPlacementJoinThread(&(g_asyncIoWorkers[i]));
+    }
+
+    SCOPED_LOCK(&g_asyncIoMutex)
+    {
+        /* Take every request that hasn't been serviced. */
+        request = g_asyncIoSubmitHead;
+        g_asyncIoSubmitHead = g_asyncIoSubmitTail = NULL;
+
+        memset(g_asyncIoWorkers, 0, sizeof(g_asyncIoWorkers));
+        memset(g_asyncIoInFlightCounts, 0, sizeof(g_asyncIoInFlightCounts));
+        g_asyncIoWorkersStarted = g_asyncIoWorkersExit = false;
+    }
+
+    /* Fail leftover requests, so nobody waits on them forever. */
+    while(request)
+    {
+        AsyncIoRequest *next = request->next;
+        asyncIoCompleteRequest(request, false);
+        request = next;
+    }
+}
+
+static bool asyncIoStartWorkers(void)
+{
+    for(u32 i = 0; i < ASYNC_IO_WORKER_COUNT; i++)
+    {
+        g_asyncIoWorkers[i].handle = INVALID_HANDLE;
+        if (threadPlacementCreateThread(&(g_asyncIoWorkers[i]), asyncIoWorkerThreadFunc, NULL, ThreadPlacementStage_Read)) continue;
+
+        LOG_MSG_ERROR("Failed to create async I/O worker thread #%u!", i);
+
+        /* Stop the worker threads that were already created. We're holding the mutex, so they can't grab any requests in the meantime. */
+        g_asyncIoWorkersExit = true;
+        condvarWakeAll(&g_asyncIoWorkerCondVar);
+        mutexUnlock(&g_asyncIoMutex);
+
+        for(u32 j = 0; j < i; j++) threadPlacementJoinThread(&(g_asyncIoWorkers[j]));
+
+        mutexLock(&g_asyncIoMutex);
+        memset(g_asyncIoWorkers, 0, sizeof(g_asyncIoWorkers));
+        g_asyncIoWorkersExit = false;
+
+        return false;
+    }
+
+    g_asyncIoWorkersStarted = true;
+
+    return true;
+}
+
+static void asyncIoWorkerThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    AsyncIoRequest *request = NULL;
+
+    mutexLock(&g_asyncIoMutex);
+
+    while(!g_asyncIoWorkersExit)
+    {
+        /* Wait until there's a request we're allowed to service. */
+        if (!(request = asyncIoTakeNextRequest()))
+        {
+            condvarWait(&g_asyncIoWorkerCondVar, &g_asyncIoMutex);
+            continue;
+        }
+
+        u8 backend = request->backend;
+        g_asyncIoInFlightCounts[backend]++;
+
+        /* Perform the read without holding the mutex, so other worker threads can service requests in the meantime. */
+        mutexUnlock(&g_asyncIoMutex);
+        asyncIoCompleteRequest(request, asyncIoPerformRead(request));
+        mutexLock(&g_asyncIoMutex);
+
+        g_asyncIoInFlightCounts[backend]--;
+
+        /* Wake up all worker threads. A request held back by this backend's queue depth may be eligible now. */
+        condvarWakeAll(&g_asyncIoWorkerCondVar);
+    }
+
+    mutexUnlock(&g_asyncIoMutex);
+
+    threadExit();
+}
+
+static AsyncIoRequest *asyncIoTakeNextRequest(void)
+{
+    AsyncIoRequest *prev = NULL, *request = g_asyncIoSubmitHead;
+
+    /* Pick the oldest request whose backend hasn't hit its queue depth. */
+    while(request && g_asyncIoInFlightCounts[request->backend] >= g_asyncIoQueueDepths[request->backend])
+    {
+        prev = request;
+        request = request->next;
+    }
+
+    if (!request) return NULL;
+
+    /* Unlink request from the submission FIFO. */
+    if (prev)
+    {
+        prev->next = request->next;
+    } else {
+        g_asyncIoSubmitHead = request->next;
+    }
+
+    if (g_asyncIoSubmitTail == request) g_asyncIoSubmitTail = prev;
+
+    request->next = NULL;
+
+    return request;
+}
+
+static bool asyncIoPerformRead(AsyncIoRequest *request)
+{
+    bool ret = false;
+
+    switch(request->backend)
+    {
+        case AsyncIoBackend_GameCard:
+            ret = gamecardReadStorage(request->out, request->read_size, request->offset);
+            break;
+        case AsyncIoBackend_NcaContent:
+            ret = ncaReadContentFile((NcaContext*)request->ctx, request->out, request->read_size, request->offset);
+            break;
+        case AsyncIoBackend_BucketTree:
+            ret = bktrReadStorage((BucketTreeContext*)request->ctx, request->out, request->read_size, request->offset);
+            break;
+        case AsyncIoBackend_SaveAllocationTable:
+            ret = (save_allocation_table_storage_read((allocation_table_storage_ctx_t*)request->ctx, request->out, request->offset, request->read_size) == request->read_size);
+            break;
+        case AsyncIoBackend_Custom:
+            ret = request->custom_read(request->ctx, request->out, request->read_size, request->offset);
+            break;
+        default:
+            break;
+    }
+
+    if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX-byte long block at offset 0x%lX! (backend %u).", request->read_size, request->offset, request->backend);
+
+    return ret;
+}
+
+static void asyncIoCompleteRequest(AsyncIoRequest *request, bool success)
+{
+    AsyncIoQueue *queue = request->queue;
+
+    request->success = success;
+
+    /* Call the completion callback, if available. */
+    if (request->callback) request->callback(request, request->user_data);
+
+    /* Post request to its completion queue. */
+    SCOPED_LOCK(&(queue->mutex))
+    {
+        request->next = NULL;
+
+        if (queue->completed_tail)
+        {
+            queue->completed_tail->next = request;
+        } else {
+            queue->completed_head = request;
+        }
+
+        queue->completed_tail = request;
+
+        condvarWakeAll(&(queue->cond));
+    }
+}
+
+static AsyncIoRequest *asyncIoGetCompletedRequest(AsyncIoQueue *queue, bool wait)
+{
+    if (!queue) return NULL;
+
+    AsyncIoRequest *request = NULL;
+
+    SCOPED_LOCK(&(queue->mutex))
+    {
+        while(queue->pending_count && !queue->completed_head && wait) condvarWait(&(queue->cond), &(queue->mutex));
+
+        if (!(request = queue->completed_head)) break;
+
+        /* Unlink request from the completion queue. */
+        queue->completed_head = request->next;
+        if (!queue->completed_head) queue->completed_tail = NULL;
+
+        request->next = NULL;
+        queue->pending_count--;
+    }
+
+    return request;
+}
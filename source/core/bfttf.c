@@ -28,10 +28,11 @@
 /* Type definitions. */
 
 typedef struct {
-    u64 title_id;   ///< System title ID.
-    char path[64];  ///< Path to BFTTF file inside the RomFS section from the system title.
+    u64 title_id;       ///< System title ID.
+    char path[64];      ///< Path to BFTTF file inside the RomFS section from the system title.
     u32 size;
     u8 *data;
+    bool load_failed;   ///< Set if the font couldn't be loaded, in order to avoid retrying each time it's requested.
 } BfttfFontInfo;
 
 /* Global variables. */
@@ -40,12 +41,12 @@ static Mutex g_bfttfMutex = 0;
 static bool g_bfttfInterfaceInit = false;
 
 static BfttfFontInfo g_fontInfo[] = {
-    { 0x0100000000000811, "/nintendo_udsg-r_std_003.bfttf", 0, NULL },          /* FontStandard. */
-    { 0x0100000000000810, "/nintendo_ext_003.bfttf", 0, NULL },                 /* FontNintendoExtension. There's a secondary entry at "/nintendo_ext2_003.bfttf", but it's identical to this one. */
-    { 0x0100000000000812, "/nintendo_udsg-r_ko_003.bfttf", 0, NULL },           /* FontKorean. */
-    { 0x0100000000000814, "/nintendo_udsg-r_org_zh-cn_003.bfttf", 0, NULL },    /* FontChineseSimplified (1). */
-    { 0x0100000000000814, "/nintendo_udsg-r_ext_zh-cn_003.bfttf", 0, NULL },    /* FontChineseSimplified (2). */
-    { 0x0100000000000813, "/nintendo_udjxh-db_zh-tw_003.bfttf", 0, NULL }       /* FontChineseTraditional. */
+    { 0x0100000000000811, "/nintendo_udsg-r_std_003.bfttf", 0, NULL, false },          /* FontStandard. */
+    { 0x0100000000000810, "/nintendo_ext_003.bfttf", 0, NULL, false },                 /* FontNintendoExtension. There's a secondary entry at "/nintendo_ext2_003.bfttf", but it's identical to this one. */
+    { 0x0100000000000812, "/nintendo_udsg-r_ko_003.bfttf", 0, NULL, false },           /* FontKorean. */
+    { 0x0100000000000814, "/nintendo_udsg-r_org_zh-cn_003.bfttf", 0, NULL, false },    /* FontChineseSimplified (1). */
+    { 0x0100000000000814, "/nintendo_udsg-r_ext_zh-cn_003.bfttf", 0, NULL, false },    /* FontChineseSimplified (2). */
+    { 0x0100000000000813, "/nintendo_udjxh-db_zh-tw_003.bfttf", 0, NULL, false }       /* FontChineseTraditional. */
 };
 
 static const u32 g_fontInfoCount = MAX_ELEMENTS(g_fontInfo);
@@ -54,12 +55,11 @@ static const u32 g_bfttfKey = 0x06186249;
 
 /* Function prototypes. */
 
+static bool bfttfLoadFont(BfttfFontInfo *font_info);
 static bool bfttfDecodeFont(BfttfFontInfo *font_info);
 
 bool bfttfInitialize(void)
 {
-    NcaContext *nca_ctx = NULL;
-    RomFileSystemContext romfs_ctx = {0};
     bool ret = false;
 
     SCOPED_LOCK(&g_bfttfMutex)
@@ -67,120 +67,20 @@ bool bfttfInitialize(void)
         ret = g_bfttfInterfaceInit;
         if (ret) break;
 
-        u32 count = 0;
-        u64 prev_title_id = 0;
-
-        /* Allocate memory for a temporary NCA context. */
-        nca_ctx = calloc(1, sizeof(NcaContext));
-        if (!nca_ctx)
+        /* Fonts are loaded and decoded on demand by bfttfGetFontByType(), so we just make sure the system title that holds the standard font is available. */
+        TitleInfo *title_info = titleGetTitleInfoEntryFromStorageByTitleId(NcmStorageId_BuiltInSystem, g_fontInfo[BfttfFontType_Standard].title_id);
+        if (!title_info)
         {
-            LOG_MSG_ERROR("Failed to allocate memory for temporary NCA context!");
+            LOG_MSG_ERROR("Failed to get title info for %016lX!", g_fontInfo[BfttfFontType_Standard].title_id);
             break;
         }
 
-        /* Retrieve BFTTF data. */
-        for(u32 i = 0; i < g_fontInfoCount; i++)
-        {
-            BfttfFontInfo *font_info = &(g_fontInfo[i]);
-            RomFileSystemFileEntry *romfs_file_entry = NULL;
-
-            /* Check if the title ID for the current font container matches the one from the previous font container. */
-            /* We won't have to reinitialize both NCA and RomFS contexts if that's the case. */
-            if (font_info->title_id != prev_title_id)
-            {
-                TitleInfo *title_info = NULL;
-
-                /* Get title info. */
-                if (!(title_info = titleGetTitleInfoEntryFromStorageByTitleId(NcmStorageId_BuiltInSystem, font_info->title_id)))
-                {
-                    LOG_MSG_ERROR("Failed to get title info for %016lX!", font_info->title_id);
-                    continue;
-                }
-
-                /* Initialize NCA context. */
-                /* NCA contexts don't need to be freed beforehand. */
-                /* Don't allow invalid NCA signatures. */
-                bool nca_ctx_init = (ncaInitializeContext(nca_ctx, NcmStorageId_BuiltInSystem, 0, &(title_info->meta_key), \
-                                                          titleGetContentInfoByTypeAndIdOffset(title_info, NcmContentType_Data, 0), NULL) && nca_ctx->valid_main_signature);
-
-                /* Free title info. */
-                titleFreeTitleInfo(&title_info);
-
-                /* Check if NCA context initialization succeeded. */
-                if (!nca_ctx_init)
-                {
-                    LOG_MSG_ERROR("Failed to initialize Data NCA context for %016lX!", font_info->title_id);
-                    continue;
-                }
-
-                /* Initialize RomFS context. */
-                /* This will also free a previous RomFS context, if available. */
-                if (!romfsInitializeContext(&romfs_ctx, &(nca_ctx->fs_ctx[0]), NULL))
-                {
-                    LOG_MSG_ERROR("Failed to initialize RomFS context for Data NCA from %016lX!", font_info->title_id);
-                    continue;
-                }
-
-                /* Update previous title ID. */
-                prev_title_id = font_info->title_id;
-            }
-
-            /* Get RomFS file entry. */
-            if (!(romfs_file_entry = romfsGetFileEntryByPath(&romfs_ctx, font_info->path)))
-            {
-                LOG_MSG_ERROR("Failed to retrieve RomFS file entry in %016lX!", font_info->title_id);
-                continue;
-            }
-
-            /* Check file size. */
-            if (!romfs_file_entry->size)
-            {
-                LOG_MSG_ERROR("File size for \"%s\" in %016lX is zero!", font_info->path, font_info->title_id);
-                continue;
-            }
-
-            /* Allocate memory for BFTTF data. */
-            if (!(font_info->data = malloc(romfs_file_entry->size)))
-            {
-                LOG_MSG_ERROR("Failed to allocate 0x%lX bytes for \"%s\" in %016lX!", romfs_file_entry->size, font_info->path, font_info->title_id);
-                continue;
-            }
-
-            /* Read BFTFF data. */
-            if (!romfsReadFileEntryData(&romfs_ctx, romfs_file_entry, font_info->data, romfs_file_entry->size, 0))
-            {
-                LOG_MSG_ERROR("Failed to read 0x%lX bytes long \"%s\" in %016lX!", romfs_file_entry->size, font_info->path, font_info->title_id);
-                free(font_info->data);
-                font_info->data = NULL;
-                continue;
-            }
-
-            /* Update BFTTF size. */
-            font_info->size = (u32)romfs_file_entry->size;
-
-            /* Decode BFTTF data. */
-            if (!bfttfDecodeFont(font_info))
-            {
-                LOG_MSG_ERROR("Failed to decode 0x%lX bytes long \"%s\" in %016lX!", romfs_file_entry->size, font_info->path, font_info->title_id);
-                free(font_info->data);
-                font_info->data = NULL;
-                font_info->size = 0;
-                continue;
-            }
-
-            /* Increase retrieved BFTTF count. */
-            count++;
-        }
+        titleFreeTitleInfo(&title_info);
 
         /* Update flags. */
-        ret = g_bfttfInterfaceInit = (count > 0);
-        if (!ret) LOG_MSG_ERROR("No BFTTF fonts retrieved!");
+        ret = g_bfttfInterfaceInit = true;
     }
 
-    romfsFreeContext(&romfs_ctx);
-
-    if (nca_ctx) free(nca_ctx);
-
     return ret;
 }
 
@@ -194,6 +94,7 @@ void bfttfExit(void)
             BfttfFontInfo *font_info = &(g_fontInfo[i]);
 
             font_info->size = 0;
+            font_info->load_failed = false;
 
             if (font_info->data)
             {
@@ -218,7 +119,13 @@ bool bfttfGetFontByType(BfttfFontData *font_data, u8 font_type)
 
     SCOPED_LOCK(&g_bfttfMutex)
     {
+        if (!g_bfttfInterfaceInit) break;
+
         BfttfFontInfo *font_info = &(g_fontInfo[font_type]);
+
+        /* Load and decode font data on first use. It's kept around afterwards. */
+        if (!font_info->data && !font_info->load_failed && !bfttfLoadFont(font_info)) font_info->load_failed = true;
+
         if (font_info->size <= 8 || !font_info->data)
         {
             LOG_MSG_ERROR("BFTTF font data unavailable for type 0x%02X!", font_type);
@@ -235,6 +142,103 @@ bool bfttfGetFontByType(BfttfFontData *font_data, u8 font_type)
     return ret;
 }
 
+static bool bfttfLoadFont(BfttfFontInfo *font_info)
+{
+    TitleInfo *title_info = NULL;
+    NcaContext *nca_ctx = NULL;
+    RomFileSystemContext romfs_ctx = {0};
+    RomFileSystemFileEntry *romfs_file_entry = NULL;
+    bool success = false;
+
+    /* Get title info. */
+    if (!(title_info = titleGetTitleInfoEntryFromStorageByTitleId(NcmStorageId_BuiltInSystem, font_info->title_id)))
+    {
+        LOG_MSG_ERROR("Failed to get title info for %016lX!", font_info->title_id);
+        goto end;
+    }
+
+    /* Allocate memory for a temporary NCA context. */
+    if (!(nca_ctx = calloc(1, sizeof(NcaContext))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for temporary NCA context!");
+        goto end;
+    }
+
+    /* Initialize NCA context. */
+    /* Don't allow invalid NCA signatures. */
+    if (!ncaInitializeContextLazy(nca_ctx, NcmStorageId_BuiltInSystem, 0, &(title_info->meta_key), titleGetContentInfoByTypeAndIdOffset(title_info, NcmContentType_Data, 0), NULL) || \
+        !nca_ctx->valid_main_signature)
+    {
+        LOG_MSG_ERROR("Failed to initialize Data NCA context for %016lX!", font_info->title_id);
+        goto end;
+    }
+
+    /* Initialize RomFS context. */
+    if (!romfsInitializeContext(&romfs_ctx, ncaGetFsSectionContext(nca_ctx, 0), NULL))
+    {
+        LOG_MSG_ERROR("Failed to initialize RomFS context for Data NCA from %016lX!", font_info->title_id);
+        goto end;
+    }
+
+    /* Get RomFS file entry. */
+    if (!(romfs_file_entry = romfsGetFileEntryByPath(&romfs_ctx, font_info->path)))
+    {
+        LOG_MSG_ERROR("Failed to retrieve RomFS file entry in %016lX!", font_info->title_id);
+        goto end;
+    }
+
+    /* Check file size. */
+    if (!romfs_file_entry->size)
+    {
+        LOG_MSG_ERROR("File size for \"%s\" in %016lX is zero!", font_info->path, font_info->title_id);
+        goto end;
+    }
+
+    /* Allocate memory for BFTTF data. */
+    if (!(font_info->data = malloc(romfs_file_entry->size)))
+    {
+        LOG_MSG_ERROR("Failed to allocate 0x%lX bytes for \"%s\" in %016lX!", romfs_file_entry->size, font_info->path, font_info->title_id);
+        goto end;
+    }
+
+    /* Read BFTFF data. */
+    if (!romfsReadFileEntryData(&romfs_ctx, romfs_file_entry, font_info->data, romfs_file_entry->size, 0))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes long \"%s\" in %016lX!", romfs_file_entry->size, font_info->path, font_info->title_id);
+        goto end;
+    }
+
+    /* Update BFTTF size. */
+    font_info->size = (u32)romfs_file_entry->size;
+
+    /* Decode BFTTF data. */
+    if (!bfttfDecodeFont(font_info))
+    {
+        LOG_MSG_ERROR("Failed to decode 0x%lX bytes long \"%s\" in %016lX!", romfs_file_entry->size, font_info->path, font_info->title_id);
+        goto end;
+    }
+
+    LOG_MSG_DEBUG("Loaded \"%s\" from %016lX (0x%X bytes).", font_info->path, font_info->title_id, font_info->size);
+
+    success = true;
+
+end:
+    if (!success)
+    {
+        if (font_info->data) free(font_info->data);
+        font_info->data = NULL;
+        font_info->size = 0;
+    }
+
+    romfsFreeContext(&romfs_ctx);
+
+    if (nca_ctx) free(nca_ctx);
+
+    titleFreeTitleInfo(&title_info);
+
+    return success;
+}
+
 static bool bfttfDecodeFont(BfttfFontInfo *font_info)
 {
     if (!font_info || font_info->size <= 8 || !IS_ALIGNED(font_info->size, 4) || !font_info->data)
@@ -31,6 +31,12 @@
 
 #define BIS_STORAGE_FATFS_CTX(type)     g_bisStorageContexts[BIS_STORAGE_INDEX(type)]
 
+#define BIS_STORAGE_CACHE_BLOCK_SIZE    0x20000 /* 128 KiB. Each cache miss reads a whole aligned block, which doubles as read-ahead for FAT / directory sector walks. */
+#define BIS_STORAGE_CACHE_BLOCK_COUNT   8
+
+#define BIS_STORAGE_SECTOR_SIZE         FF_MAX_SS
+#define BIS_STORAGE_FAT_CHUNK_SIZE      0x100000    /* 1 MiB. Used while reading FATs / allocation bitmaps to generate cluster bitmaps. */
+
 #define BIS_GET_NAME_FUNC(property, field) \
 const char *bisStorageGet##property##ByBisPartitionId(u8 bis_partition_id) { \
     const char *ret = NULL; \
@@ -45,6 +51,13 @@ const char *bisStorageGet##property##ByBisPartitionId(u8 bis_partition_id) { \
 
 /* Type definitions. */
 
+typedef struct {
+    u64 offset;                         ///< Block-aligned BIS storage offset.
+    u64 size;                           ///< Block data size. Only smaller than BIS_STORAGE_CACHE_BLOCK_SIZE for the last block from the storage. Zero if unused.
+    u64 last_access;                    ///< Used to evict the least recently used block.
+    u8 *data;                           ///< Dynamically allocated.
+} BisStorageCacheBlock;
+
 typedef struct {
     u8 bis_partition_id;                ///< FsBisPartitionId.
     const char *gpt_name;
@@ -52,7 +65,10 @@ typedef struct {
     const char *devoptab_mount_name;
     char fatfs_mount_name[4];
     FsStorage bis_storage;
+    u64 bis_storage_size;
     FATFS fatfs;
+    BisStorageCacheBlock cache[BIS_STORAGE_CACHE_BLOCK_COUNT];
+    u64 cache_access_count;
 } BisStorageFatFsContext;
 
 /* Global variables. */
@@ -92,6 +108,15 @@ static void bisStorageUnmountPartition(u8 bis_partition_id);
 
 static void bisStorageFreeFatFsContext(BisStorageFatFsContext **bis_fatfs_ctx);
 
+static bool bisStorageReadCachedData(BisStorageFatFsContext *bis_fatfs_ctx, u8 *out, u64 offset, u64 size);
+static BisStorageCacheBlock *bisStorageGetCacheBlock(BisStorageFatFsContext *bis_fatfs_ctx, u64 block_offset);
+static void bisStorageFreeCache(BisStorageFatFsContext *bis_fatfs_ctx);
+
+static bool bisStorageReadRawData(BisStorageFatFsContext *bis_fatfs_ctx, void *out, u64 offset, u64 size);
+
+static bool bisStorageGenerateFatClusterBitmap(BisStorageFatFsContext *bis_fatfs_ctx, BisStorageClusterBitmap *out);
+static bool bisStorageGenerateExFatClusterBitmap(BisStorageFatFsContext *bis_fatfs_ctx, BisStorageClusterBitmap *out);
+
 bool bisStorageInitialize(void)
 {
     bool ret = false;
@@ -125,17 +150,143 @@ BIS_GET_NAME_FUNC(SystemInitializerPartitionName, sysinit_name);
 
 BIS_GET_NAME_FUNC(MountName, devoptab_mount_name);
 
-FsStorage *bisStorageGetFsStorageByFatFsDriveNumber(u8 drive_number)
+bool bisStorageReadFatFsDrive(u8 drive_number, void *out, u64 offset, u64 size)
+{
+    if (drive_number >= BIS_FAT_PARTITION_COUNT || !out || !size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    bool ret = false;
+
+    /* FatFs calls may already hold the BIS storage mutex (e.g. while mounting a partition), so we don't use SCOPED_LOCK here. */
+    bool locked = mutexIsLockedByCurrentThread(&g_bisStorageMutex);
+    if (!locked) mutexLock(&g_bisStorageMutex);
+
+    BisStorageFatFsContext *bis_fatfs_ctx = g_bisStorageContexts[drive_number];
+    if (bis_fatfs_ctx)
+    {
+        ret = bisStorageReadCachedData(bis_fatfs_ctx, (u8*)out, offset, size);
+    } else {
+        LOG_MSG_ERROR("Drive number %u hasn't been mounted!", drive_number);
+    }
+
+    if (!locked) mutexUnlock(&g_bisStorageMutex);
+
+    return ret;
+}
+
+bool bisStorageGetPartitionSize(u8 bis_partition_id, u64 *out_size)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_bisStorageMutex)
+    {
+        BisStorageFatFsContext *bis_fatfs_ctx = NULL;
+
+        if (!g_bisStorageInterfaceInit || bis_partition_id < FsBisPartitionId_CalibrationFile || bis_partition_id > FsBisPartitionId_System || \
+            !(bis_fatfs_ctx = BIS_STORAGE_FATFS_CTX(bis_partition_id)) || !out_size)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        *out_size = bis_fatfs_ctx->bis_storage_size;
+        ret = true;
+    }
+
+    return ret;
+}
+
+bool bisStorageReadPartition(u8 bis_partition_id, void *out, u64 offset, u64 size)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_bisStorageMutex)
+    {
+        BisStorageFatFsContext *bis_fatfs_ctx = NULL;
+
+        if (!g_bisStorageInterfaceInit || bis_partition_id < FsBisPartitionId_CalibrationFile || bis_partition_id > FsBisPartitionId_System || \
+            !(bis_fatfs_ctx = BIS_STORAGE_FATFS_CTX(bis_partition_id)) || !out || !size)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        ret = bisStorageReadRawData(bis_fatfs_ctx, out, offset, size);
+    }
+
+    return ret;
+}
+
+bool bisStorageGetClusterBitmap(u8 bis_partition_id, BisStorageClusterBitmap *out)
 {
-    FsStorage *bis_storage = NULL;
+    bool ret = false;
 
     SCOPED_LOCK(&g_bisStorageMutex)
     {
-        if (drive_number >= BIS_FAT_PARTITION_COUNT || !g_bisStorageContexts[drive_number]) break;
-        bis_storage = &(g_bisStorageContexts[drive_number]->bis_storage);
+        BisStorageFatFsContext *bis_fatfs_ctx = NULL;
+        FATFS *fatfs = NULL;
+
+        if (!g_bisStorageInterfaceInit || bis_partition_id < FsBisPartitionId_CalibrationFile || bis_partition_id > FsBisPartitionId_System || \
+            !(bis_fatfs_ctx = BIS_STORAGE_FATFS_CTX(bis_partition_id)) || !out)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        fatfs = &(bis_fatfs_ctx->fatfs);
+        if (!fatfs->fs_type || !fatfs->csize || fatfs->n_fatent <= 2)
+        {
+            LOG_MSG_ERROR("Invalid FatFs object for %s partition!", bis_fatfs_ctx->gpt_name);
+            break;
+        }
+
+        /* Fill basic cluster info. */
+        memset(out, 0, sizeof(BisStorageClusterBitmap));
+        out->data_offset = ((u64)fatfs->database * BIS_STORAGE_SECTOR_SIZE);
+        out->cluster_size = ((u64)fatfs->csize * BIS_STORAGE_SECTOR_SIZE);
+        out->cluster_count = (fatfs->n_fatent - 2);
+
+        /* Allocate bitmap. */
+        out->bitmap = calloc(ALIGN_UP(out->cluster_count, 8) / 8, sizeof(u8));
+        if (!out->bitmap)
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for %s partition cluster bitmap! (%u clusters).", bis_fatfs_ctx->gpt_name, out->cluster_count);
+            break;
+        }
+
+        switch(fatfs->fs_type)
+        {
+            case FS_FAT16:
+            case FS_FAT32:
+                ret = bisStorageGenerateFatClusterBitmap(bis_fatfs_ctx, out);
+                break;
+            case FS_EXFAT:
+                ret = bisStorageGenerateExFatClusterBitmap(bis_fatfs_ctx, out);
+                break;
+            default:
+                /* FAT12 entries are too small to bother with. Just report every cluster as allocated. */
+                memset(out->bitmap, 0xFF, ALIGN_UP(out->cluster_count, 8) / 8);
+                out->allocated_count = out->cluster_count;
+                ret = true;
+                break;
+        }
+
+        if (ret)
+        {
+            /* Clear unused bits past the last cluster. */
+            if (out->cluster_count & 7) out->bitmap[out->cluster_count >> 3] &= (u8)((1U << (out->cluster_count & 7)) - 1);
+
+            LOG_MSG_DEBUG("%s partition cluster bitmap: %u / %u allocated cluster(s) (0x%lX-byte long clusters).", bis_fatfs_ctx->gpt_name, out->allocated_count, \
+                          out->cluster_count, out->cluster_size);
+        } else {
+            bisStorageFreeClusterBitmap(out);
+        }
     }
 
-    return bis_storage;
+    return ret;
 }
 
 void bisStorageControlMutex(bool lock)
@@ -213,6 +364,14 @@ static bool bisStorageMountPartition(u8 bis_partition_id)
         goto end;
     }
 
+    /* Get BIS storage size. Used to clamp cached reads at the end of the storage. */
+    rc = fsStorageGetSize(&(bis_fatfs_ctx->bis_storage), (s64*)&(bis_fatfs_ctx->bis_storage_size));
+    if (R_FAILED(rc) || !bis_fatfs_ctx->bis_storage_size)
+    {
+        LOG_MSG_ERROR("Failed to get BIS storage size for %s partition! (0x%X).", bis_fatfs_ctx->gpt_name, rc);
+        goto end;
+    }
+
     /* Update context array. */
     /* FatFs diskio demands we do this here. */
     BIS_STORAGE_FATFS_CTX(bis_partition_id) = bis_fatfs_ctx;
@@ -278,6 +437,232 @@ static void bisStorageFreeFatFsContext(BisStorageFatFsContext **bis_fatfs_ctx)
 
     if (serviceIsActive(&(ctx->bis_storage.s))) fsStorageClose(&(ctx->bis_storage));
 
+    bisStorageFreeCache(ctx);
+
     free(ctx);
     ctx = *bis_fatfs_ctx = NULL;
 }
+
+static bool bisStorageReadCachedData(BisStorageFatFsContext *bis_fatfs_ctx, u8 *out, u64 offset, u64 size)
+{
+    if (offset >= bis_fatfs_ctx->bis_storage_size || size > (bis_fatfs_ctx->bis_storage_size - offset))
+    {
+        LOG_MSG_ERROR("Requested 0x%lX-byte long block at offset 0x%lX is out of bounds for %s partition!", size, offset, bis_fatfs_ctx->gpt_name);
+        return false;
+    }
+
+    Result rc = 0;
+
+    while(size)
+    {
+        u64 block_offset = ALIGN_DOWN(offset, BIS_STORAGE_CACHE_BLOCK_SIZE);
+        u64 block_data_offset = (offset - block_offset);
+
+        /* Read whole aligned blocks directly into the output buffer. Sequential file reads from FatFs end up here, and caching them would only evict metadata blocks. */
+        if (!block_data_offset && size >= BIS_STORAGE_CACHE_BLOCK_SIZE)
+        {
+            u64 direct_size = ALIGN_DOWN(size, BIS_STORAGE_CACHE_BLOCK_SIZE);
+
+            statsAddCounter(StatsCounterType_BisRead, direct_size);
+            u64 start_tick = armGetSystemTick();
+            rc = fsStorageRead(&(bis_fatfs_ctx->bis_storage), (s64)offset, out, direct_size);
+            statsRecordLatency(StatsLatencyType_BisRead, start_tick);
+            if (R_FAILED(rc))
+            {
+                LOG_MSG_ERROR("Failed to read 0x%lX-byte long block at offset 0x%lX from %s partition! (0x%X).", direct_size, offset, bis_fatfs_ctx->gpt_name, rc);
+                return false;
+            }
+
+            out += direct_size;
+            offset += direct_size;
+            size -= direct_size;
+            continue;
+        }
+
+        /* Get cache block. This reads it from the BIS storage if needed. */
+        BisStorageCacheBlock *block = bisStorageGetCacheBlock(bis_fatfs_ctx, block_offset);
+        if (!block) return false;
+
+        u64 copy_size = MIN(size, block->size - block_data_offset);
+        memcpy(out, block->data + block_data_offset, copy_size);
+
+        out += copy_size;
+        offset += copy_size;
+        size -= copy_size;
+    }
+
+    return true;
+}
+
+static BisStorageCacheBlock *bisStorageGetCacheBlock(BisStorageFatFsContext *bis_fatfs_ctx, u64 block_offset)
+{
+    BisStorageCacheBlock *block = NULL;
+    Result rc = 0;
+
+    /* Look for a cache hit. Pick the least recently used block (or an unused one) as the eviction candidate along the way. */
+    for(u32 i = 0; i < BIS_STORAGE_CACHE_BLOCK_COUNT; i++)
+    {
+        BisStorageCacheBlock *cur_block = &(bis_fatfs_ctx->cache[i]);
+
+        if (cur_block->size && cur_block->offset == block_offset)
+        {
+            cur_block->last_access = ++(bis_fatfs_ctx->cache_access_count);
+            return cur_block;
+        }
+
+        if (!block || (block->size && (!cur_block->size || cur_block->last_access < block->last_access))) block = cur_block;
+    }
+
+    /* Allocate block buffer, if needed. */
+    if (!block->data && !(block->data = malloc(BIS_STORAGE_CACHE_BLOCK_SIZE)))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for BIS storage cache block! (%s partition).", bis_fatfs_ctx->gpt_name);
+        return NULL;
+    }
+
+    /* Read block. */
+    block->size = 0;
+    u64 block_size = MIN(BIS_STORAGE_CACHE_BLOCK_SIZE, bis_fatfs_ctx->bis_storage_size - block_offset);
+
+    statsAddCounter(StatsCounterType_BisRead, block_size);
+    u64 start_tick = armGetSystemTick();
+    rc = fsStorageRead(&(bis_fatfs_ctx->bis_storage), (s64)block_offset, block->data, block_size);
+    statsRecordLatency(StatsLatencyType_BisRead, start_tick);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX-byte long block at offset 0x%lX from %s partition! (0x%X).", block_size, block_offset, bis_fatfs_ctx->gpt_name, rc);
+        return NULL;
+    }
+
+    /* Update block. */
+    block->offset = block_offset;
+    block->size = block_size;
+    block->last_access = ++(bis_fatfs_ctx->cache_access_count);
+
+    return block;
+}
+
+static void bisStorageFreeCache(BisStorageFatFsContext *bis_fatfs_ctx)
+{
+    for(u32 i = 0; i < BIS_STORAGE_CACHE_BLOCK_COUNT; i++)
+    {
+        BisStorageCacheBlock *block = &(bis_fatfs_ctx->cache[i]);
+        if (block->data) free(block->data);
+        memset(block, 0, sizeof(BisStorageCacheBlock));
+    }
+
+    bis_fatfs_ctx->cache_access_count = 0;
+}
+
+static bool bisStorageReadRawData(BisStorageFatFsContext *bis_fatfs_ctx, void *out, u64 offset, u64 size)
+{
+    if (offset >= bis_fatfs_ctx->bis_storage_size || size > (bis_fatfs_ctx->bis_storage_size - offset))
+    {
+        LOG_MSG_ERROR("Requested 0x%lX-byte long block at offset 0x%lX is out of bounds for %s partition!", size, offset, bis_fatfs_ctx->gpt_name);
+        return false;
+    }
+
+    statsAddCounter(StatsCounterType_BisRead, size);
+    u64 start_tick = armGetSystemTick();
+    Result rc = fsStorageRead(&(bis_fatfs_ctx->bis_storage), (s64)offset, out, size);
+    statsRecordLatency(StatsLatencyType_BisRead, start_tick);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX-byte long block at offset 0x%lX from %s partition! (0x%X).", size, offset, bis_fatfs_ctx->gpt_name, rc);
+        return false;
+    }
+
+    return true;
+}
+
+static bool bisStorageGenerateFatClusterBitmap(BisStorageFatFsContext *bis_fatfs_ctx, BisStorageClusterBitmap *out)
+{
+    FATFS *fatfs = &(bis_fatfs_ctx->fatfs);
+    bool is_fat32 = (fatfs->fs_type == FS_FAT32);
+    u32 entry_size = (is_fat32 ? sizeof(u32) : sizeof(u16));
+
+    u64 fat_offset = ((u64)fatfs->fatbase * BIS_STORAGE_SECTOR_SIZE);
+    u64 fat_size = ALIGN_UP((u64)fatfs->n_fatent * entry_size, BIS_STORAGE_SECTOR_SIZE);
+
+    u8 *buf = NULL;
+    bool success = false;
+
+    buf = malloc(BIS_STORAGE_FAT_CHUNK_SIZE);
+    if (!buf)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for FAT chunk buffer! (%s partition).", bis_fatfs_ctx->gpt_name);
+        goto end;
+    }
+
+    /* Only the first FAT is used. Entries 0 and 1 are reserved, so cluster bitmap indexes are shifted by two. */
+    for(u64 cur_offset = 0; cur_offset < fat_size; cur_offset += BIS_STORAGE_FAT_CHUNK_SIZE)
+    {
+        u64 chunk_size = MIN(BIS_STORAGE_FAT_CHUNK_SIZE, fat_size - cur_offset);
+        if (!bisStorageReadRawData(bis_fatfs_ctx, buf, fat_offset + cur_offset, chunk_size)) goto end;
+
+        u32 first_entry = (u32)(cur_offset / entry_size);
+        u32 entry_count = MIN((u32)(chunk_size / entry_size), fatfs->n_fatent - first_entry);
+
+        for(u32 i = 0; i < entry_count; i++)
+        {
+            u32 entry_idx = (first_entry + i);
+            if (entry_idx < 2) continue;
+
+            /* Free clusters are always zero. Anything else (including bad clusters) is treated as allocated. */
+            u32 value = (is_fat32 ? (((u32*)buf)[i] & 0x0FFFFFFF) : ((u16*)buf)[i]);
+            if (!value) continue;
+
+            u32 cluster_idx = (entry_idx - 2);
+            out->bitmap[cluster_idx >> 3] |= (u8)(1U << (cluster_idx & 7));
+            out->allocated_count++;
+        }
+    }
+
+    success = true;
+
+end:
+    if (buf) free(buf);
+
+    return success;
+}
+
+static bool bisStorageGenerateExFatClusterBitmap(BisStorageFatFsContext *bis_fatfs_ctx, BisStorageClusterBitmap *out)
+{
+    FATFS *fatfs = &(bis_fatfs_ctx->fatfs);
+
+    u64 bitmap_offset = ((u64)fatfs->bitbase * BIS_STORAGE_SECTOR_SIZE);
+    u64 bitmap_size = (ALIGN_UP(out->cluster_count, 8) / 8);
+    u64 aligned_bitmap_size = ALIGN_UP(bitmap_size, BIS_STORAGE_SECTOR_SIZE);
+
+    u8 *buf = NULL;
+    bool success = false;
+
+    buf = malloc(BIS_STORAGE_FAT_CHUNK_SIZE);
+    if (!buf)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for allocation bitmap chunk buffer! (%s partition).", bis_fatfs_ctx->gpt_name);
+        goto end;
+    }
+
+    /* The exFAT allocation bitmap already uses the same layout as our cluster bitmap. */
+    for(u64 cur_offset = 0; cur_offset < aligned_bitmap_size; cur_offset += BIS_STORAGE_FAT_CHUNK_SIZE)
+    {
+        u64 chunk_size = MIN(BIS_STORAGE_FAT_CHUNK_SIZE, aligned_bitmap_size - cur_offset);
+        if (!bisStorageReadRawData(bis_fatfs_ctx, buf, bitmap_offset + cur_offset, chunk_size)) goto end;
+
+        u64 copy_size = MIN(chunk_size, bitmap_size - cur_offset);
+        memcpy(out->bitmap + cur_offset, buf, copy_size);
+    }
+
+    /* Clear unused bits past the last cluster before counting allocated clusters. */
+    if (out->cluster_count & 7) out->bitmap[out->cluster_count >> 3] &= (u8)((1U << (out->cluster_count & 7)) - 1);
+
+    for(u64 i = 0; i < bitmap_size; i++) out->allocated_count += (u32)__builtin_popcount(out->bitmap[i]);
+
+    success = true;
+
+end:
+    if (buf) free(buf);
+
+    return success;
+}
@@ -24,6 +24,11 @@
 #include <core/bktr.h>
 #include <core/aes.h>
 
+/* NEON is always available on the Switch. The scalar fallback is only used by host builds (see bench/). */
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
 /* Type definitions. */
 
 typedef struct {
@@ -37,20 +42,6 @@ typedef struct {
     u32 index;
 } BucketTreeStorageNode;
 
-typedef struct {
-    BucketTreeNodeHeader header;
-    u64 start;
-} BucketTreeEntrySetHeader;
-
-NXDT_ASSERT(BucketTreeEntrySetHeader, BKTR_NODE_HEADER_SIZE + 0x8);
-
-typedef struct {
-    BucketTreeContext *bktr_ctx;
-    BucketTreeEntrySetHeader entry_set;
-    u32 entry_index;
-    void *entry;
-} BucketTreeVisitor;
-
 typedef struct {
     void *buffer;
     u64 offset;
@@ -78,6 +69,13 @@ static const char *g_bktrStorageTypeNames[] = {
 static const char *bktrGetStorageTypeName(u8 storage_type);
 #endif
 
+static bool bktrCollectVirtualRanges(BucketTreeContext *ctx, bool zero_filled, BucketTreeVirtualRange **out_ranges, u32 *out_count);
+static bool bktrAppendVirtualRange(BucketTreeVirtualRange **ranges, u32 *range_count, u32 *range_capacity, u64 offset, u64 size);
+
+static bool bktrQueryStorageExtentsInternal(BucketTreeContext *ctx, StorageExtentList *out, u64 size, u64 offset, u64 virtual_offset, u8 type);
+static bool bktrQuerySubStorageExtents(BucketTreeSubStorage *substorage, StorageExtentList *out, u64 size, u64 offset, u64 virtual_offset, u8 type);
+static bool bktrQueryCompressedBlockExtent(BucketTreeContext *ctx, const BucketTreeCompressedStorageEntry *entry, StorageExtentList *out, u64 size, u64 virtual_offset);
+
 static bool bktrInitializeIndirectStorageContext(BucketTreeContext *out, NcaFsSectionContext *nca_fs_ctx, bool is_sparse);
 static bool bktrGetIndirectStorageEntryExtents(BucketTreeVisitor *visitor, u64 offset, BucketTreeIndirectStorageEntry *out_cur_entry, u64 *out_next_entry_offset);
 static bool bktrReadIndirectStorage(BucketTreeVisitor *visitor, void *out, u64 read_size, u64 offset);
@@ -88,8 +86,14 @@ static bool bktrReadAesCtrExStorage(BucketTreeVisitor *visitor, void *out, u64 r
 
 static bool bktrGetCompressedStorageEntryExtents(BucketTreeVisitor *visitor, u64 offset, BucketTreeCompressedStorageEntry *out_cur_entry, u64 *out_next_entry_offset);
 static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64 read_size, u64 offset);
+static bool bktrReadCompressedStorageLz4Entry(BucketTreeContext *ctx, const BucketTreeCompressedStorageEntry *entry, u64 entry_size, void *out, u64 read_size, u64 offset);
+static bool bktrDecompressLz4Entry(BucketTreeContext *ctx, const BucketTreeCompressedStorageEntry *entry, u64 entry_size, u8 *buffer, u64 buffer_size);
 
 static bool bktrReadSubStorage(BucketTreeSubStorage *substorage, BucketTreeSubStorageReadParams *params);
+
+static bool bktrSeekCursor(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor);
+static void bktrUpdateCursor(BucketTreeContext *ctx, const BucketTreeVisitor *visitor, u64 entry_offset, u64 next_entry_offset);
+NX_INLINE u64 bktrGetVisitorEntryVirtualOffset(BucketTreeVisitor *visitor);
 NX_INLINE void bktrInitializeSubStorageReadParams(BucketTreeSubStorageReadParams *out, void *buffer, u64 offset, u64 size, u64 virtual_offset, u32 ctr_val, bool aes_ctr_ex_crypt, u8 parent_storage_type);
 
 static bool bktrVerifyBucketInfo(NcaBucketInfo *bucket, u64 node_size, u64 entry_size, u64 *out_node_storage_size, u64 *out_entry_storage_size);
@@ -109,6 +113,10 @@ NX_INLINE const u64 *bktrGetOffsetNodeArray(const BucketTreeOffsetNode *offset_n
 NX_INLINE const u64 *bktrGetOffsetNodeBegin(const BucketTreeOffsetNode *offset_node);
 NX_INLINE const u64 *bktrGetOffsetNodeEnd(const BucketTreeOffsetNode *offset_node);
 
+static bool bktrBuildFlatIndex(BucketTreeContext *ctx);
+static bool bktrFindFlatIndexEntry(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor);
+NX_INLINE u32 bktrCountFlatIndexBlockEntries(const u64 *block, u64 virtual_offset);
+
 static bool bktrFindStorageEntry(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor);
 static bool bktrGetTreeNodeEntryIndex(const u64 *start_ptr, const u64 *end_ptr, u64 virtual_offset, u32 *out_index);
 static bool bktrGetEntryNodeEntryIndex(const BucketTreeNodeHeader *node_header, u64 entry_size, u64 virtual_offset, u32 *out_index);
@@ -118,6 +126,7 @@ static const BucketTreeNodeHeader *bktrGetTreeNodeHeader(BucketTreeContext *ctx,
 NX_INLINE u32 bktrGetEntrySetIndex(BucketTreeContext *ctx, u32 node_index, u32 offset_index);
 
 static bool bktrFindEntry(BucketTreeContext *ctx, BucketTreeVisitor *out_visitor, u64 virtual_offset, u32 entry_set_index);
+static bool bktrGetEntry(BucketTreeContext *ctx, BucketTreeVisitor *out_visitor, const BucketTreeNodeHeader *entry_set_header, u32 entry_set_index, u32 entry_index);
 static const BucketTreeNodeHeader *bktrGetEntryNodeHeader(BucketTreeContext *ctx, u32 entry_set_index);
 
 NX_INLINE u64 bktrGetEntryNodeEntryOffset(u64 entry_set_offset, u64 entry_size, u32 entry_index);
@@ -164,8 +173,14 @@ bool bktrInitializeContext(BucketTreeContext *out, NcaFsSectionContext *nca_fs_c
             break;
     }
 
-    if (!success) LOG_MSG_ERROR("Failed to initialize Bucket Tree %s storage for FS section #%u in \"%s\".", bktrGetStorageTypeName(storage_type), nca_fs_ctx->section_idx, \
-                                nca_fs_ctx->nca_ctx->content_id_str);
+    if (success)
+    {
+        /* Build flat index. Not a fatal error if this fails. */
+        if (!bktrBuildFlatIndex(out)) LOG_MSG_WARNING("Failed to build flat index for Bucket Tree %s storage. Falling back to tree lookups.", bktrGetStorageTypeName(storage_type));
+    } else {
+        LOG_MSG_ERROR("Failed to initialize Bucket Tree %s storage for FS section #%u in \"%s\".", bktrGetStorageTypeName(storage_type), nca_fs_ctx->section_idx, \
+                      nca_fs_ctx->nca_ctx->content_id_str);
+    }
 
     return success;
 }
@@ -241,6 +256,9 @@ bool bktrInitializeCompressedStorageContext(BucketTreeContext *out, BucketTreeSu
 
     memcpy(&(out->substorages[0]), substorage, sizeof(BucketTreeSubStorage));
 
+    /* Build flat index. Not a fatal error if this fails. */
+    if (!bktrBuildFlatIndex(out)) LOG_MSG_WARNING("Failed to build flat index for Bucket Tree Compressed storage. Falling back to tree lookups.");
+
     /* Update return value. */
     success = true;
 
@@ -309,6 +327,8 @@ bool bktrSetBucketTreeSubStorage(BucketTreeContext *parent_ctx, BucketTreeContex
 
 bool bktrReadStorage(BucketTreeContext *ctx, void *out, u64 read_size, u64 offset)
 {
+    TRACE_FUNC();
+
     if (!bktrIsBlockWithinStorageRange(ctx, read_size, offset) || !out)
     {
         LOG_MSG_ERROR("Invalid parameters!");
@@ -318,8 +338,8 @@ bool bktrReadStorage(BucketTreeContext *ctx, void *out, u64 read_size, u64 offse
     BucketTreeVisitor visitor = {0};
     bool success = false;
 
-    /* Find storage entry. */
-    if (!bktrFindStorageEntry(ctx, offset, &visitor))
+    /* Find storage entry. Try to reuse the storage cursor first. */
+    if (!bktrSeekCursor(ctx, offset, &visitor) && !bktrFindStorageEntry(ctx, offset, &visitor))
     {
         LOG_MSG_ERROR("Unable to find %s storage entry for offset 0x%lX!", bktrGetStorageTypeName(ctx->storage_type), offset);
         goto end;
@@ -360,8 +380,8 @@ bool bktrIsBlockWithinIndirectStorageRange(BucketTreeContext *ctx, u64 offset, u
     BucketTreeVisitor visitor = {0};
     bool updated = false, success = false;
 
-    /* Find storage entry. */
-    if (!bktrFindStorageEntry(ctx, offset, &visitor))
+    /* Find storage entry. Try to reuse the storage cursor first. */
+    if (!bktrSeekCursor(ctx, offset, &visitor) && !bktrFindStorageEntry(ctx, offset, &visitor))
     {
         LOG_MSG_ERROR("Unable to find %s storage entry for offset 0x%lX!", bktrGetStorageTypeName(ctx->storage_type), offset);
         goto end;
@@ -500,6 +520,107 @@ end:
     return success;
 }
 
+bool bktrGetPhysicalOffset(BucketTreeContext *ctx, u64 virtual_offset, u64 *out_offset, u8 *out_storage_index)
+{
+    if (!bktrIsOffsetWithinStorageRange(ctx, virtual_offset) || ctx->storage_type == BucketTreeStorageType_AesCtrEx || !out_offset || !out_storage_index)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    BucketTreeVisitor visitor = {0};
+    BucketTreeSubStorage *substorage = NULL;
+    u64 physical_offset = 0;
+    u8 storage_index = BucketTreeIndirectStorageIndex_Original;
+
+    /* Find storage entry. */
+    if (!bktrFindStorageEntry(ctx, virtual_offset, &visitor))
+    {
+        LOG_MSG_ERROR("Unable to find %s storage entry for offset 0x%lX!", bktrGetStorageTypeName(ctx->storage_type), virtual_offset);
+        return false;
+    }
+
+    if (ctx->storage_type == BucketTreeStorageType_Compressed)
+    {
+        const BucketTreeCompressedStorageEntry *entry = (const BucketTreeCompressedStorageEntry*)visitor.entry;
+        if ((u64)entry->virtual_offset > virtual_offset)
+        {
+            LOG_MSG_ERROR("Invalid Compressed Storage entry! (0x%lX).", (u64)entry->virtual_offset);
+            return false;
+        }
+
+        /* Only non-compressed entries can be randomly accessed. Use the entry start offset for everything else. */
+        physical_offset = (ctx->nca_fs_ctx->hash_region.size + (u64)entry->physical_offset);
+        if (entry->compression_type == BucketTreeCompressedStorageCompressionType_None) physical_offset += (virtual_offset - (u64)entry->virtual_offset);
+
+        substorage = &(ctx->substorages[0]);
+    } else {
+        const BucketTreeIndirectStorageEntry *entry = (const BucketTreeIndirectStorageEntry*)visitor.entry;
+        if (entry->virtual_offset > virtual_offset || entry->storage_index > BucketTreeIndirectStorageIndex_Patch)
+        {
+            LOG_MSG_ERROR("Invalid Indirect Storage entry! (0x%lX).", entry->virtual_offset);
+            return false;
+        }
+
+        physical_offset = (entry->physical_offset + (virtual_offset - entry->virtual_offset));
+        storage_index = (u8)entry->storage_index;
+
+        /* Only the original data storage may have additional Bucket Tree layers worth translating. */
+        if (storage_index == BucketTreeIndirectStorageIndex_Original) substorage = &(ctx->substorages[0]);
+    }
+
+    /* Translate the physical offset using the underlying substorage, if needed. */
+    if (substorage && bktrIsValidSubStorage(substorage) && (substorage->type == BucketTreeSubStorageType_Indirect || substorage->type == BucketTreeSubStorageType_Sparse) && \
+        bktrIsOffsetWithinStorageRange(substorage->bktr_ctx, physical_offset))
+    {
+        u8 sub_storage_index = BucketTreeIndirectStorageIndex_Original;
+        if (!bktrGetPhysicalOffset(substorage->bktr_ctx, physical_offset, &physical_offset, &sub_storage_index)) return false;
+
+        /* Keep the Patch storage index from this layer if the underlying substorage doesn't provide it. */
+        if (substorage->type == BucketTreeSubStorageType_Indirect) storage_index = sub_storage_index;
+    }
+
+    /* Update output values. */
+    *out_offset = physical_offset;
+    *out_storage_index = storage_index;
+
+    return true;
+}
+
+bool bktrGetPatchStorageRanges(BucketTreeContext *ctx, BucketTreeVirtualRange **out_ranges, u32 *out_count)
+{
+    if (!bktrIsValidContext(ctx) || (ctx->storage_type != BucketTreeStorageType_Indirect && ctx->storage_type != BucketTreeStorageType_Compressed) || \
+        (ctx->storage_type == BucketTreeStorageType_Compressed && ctx->substorages[0].type != BucketTreeSubStorageType_Indirect) || !out_ranges || !out_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    return bktrCollectVirtualRanges(ctx, false, out_ranges, out_count);
+}
+
+bool bktrGetZeroFilledRanges(BucketTreeContext *ctx, BucketTreeVirtualRange **out_ranges, u32 *out_count)
+{
+    if (!bktrIsValidContext(ctx) || (ctx->storage_type != BucketTreeStorageType_Sparse && ctx->storage_type != BucketTreeStorageType_Compressed) || !out_ranges || !out_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    return bktrCollectVirtualRanges(ctx, true, out_ranges, out_count);
+}
+
+bool bktrQueryStorageExtents(BucketTreeContext *ctx, StorageExtentList *out, u64 size, u64 offset)
+{
+    if (!bktrIsBlockWithinStorageRange(ctx, size, offset) || !out)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    return bktrQueryStorageExtentsInternal(ctx, out, size, offset, offset, StorageExtentType_Data);
+}
+
 #if LOG_LEVEL <= LOG_LEVEL_ERROR
 static const char *bktrGetStorageTypeName(u8 storage_type)
 {
@@ -507,6 +628,311 @@ static const char *bktrGetStorageTypeName(u8 storage_type)
 }
 #endif
 
+static bool bktrCollectVirtualRanges(BucketTreeContext *ctx, bool zero_filled, BucketTreeVirtualRange **out_ranges, u32 *out_count)
+{
+    BucketTreeVisitor visitor = {0};
+    BucketTreeVirtualRange *ranges = NULL, *indirect_ranges = NULL;
+    u32 range_count = 0, range_capacity = 0, indirect_range_count = 0;
+    bool success = false;
+
+    /* Retrieve the Patch-backed ranges from the underlying Indirect Storage, if needed. */
+    if (!zero_filled && ctx->storage_type == BucketTreeStorageType_Compressed && \
+        !bktrGetPatchStorageRanges(ctx->substorages[0].bktr_ctx, &indirect_ranges, &indirect_range_count)) goto end;
+
+    /* Find the first storage entry. */
+    if (!bktrFindStorageEntry(ctx, ctx->start_offset, &visitor))
+    {
+        LOG_MSG_ERROR("Unable to find %s storage entry for offset 0x%lX!", bktrGetStorageTypeName(ctx->storage_type), ctx->start_offset);
+        goto end;
+    }
+
+    /* Loop through all storage entries. */
+    while(true)
+    {
+        /* The virtual offset is always the first field from every Bucket Tree storage entry type. */
+        const void *cur_entry = visitor.entry;
+        const u64 cur_entry_offset = bktrGetVisitorEntryVirtualOffset(&visitor);
+        u64 next_entry_offset = ctx->end_offset;
+        bool updated = false;
+
+        if (!bktrIsOffsetWithinStorageRange(ctx, cur_entry_offset))
+        {
+            LOG_MSG_ERROR("Invalid %s Storage entry! (0x%lX).", bktrGetStorageTypeName(ctx->storage_type), cur_entry_offset);
+            goto end;
+        }
+
+        /* Retrieve the next entry, if available. */
+        bool has_next_entry = bktrVisitorCanMoveNext(&visitor);
+        if (has_next_entry)
+        {
+            if (!bktrVisitorMoveNext(&visitor))
+            {
+                LOG_MSG_ERROR("Failed to retrieve next %s Storage entry!", bktrGetStorageTypeName(ctx->storage_type));
+                goto end;
+            }
+
+            next_entry_offset = bktrGetVisitorEntryVirtualOffset(&visitor);
+            if (next_entry_offset <= cur_entry_offset || next_entry_offset > ctx->end_offset)
+            {
+                LOG_MSG_ERROR("Invalid %s Storage entry! (0x%lX).", bktrGetStorageTypeName(ctx->storage_type), next_entry_offset);
+                goto end;
+            }
+        }
+
+        if (zero_filled)
+        {
+            /* Compressed: Zero entries never touch the underlying substorage. */
+            /* Sparse: entries from storage index 1 are backed by the ZeroStorage. */
+            if (ctx->storage_type == BucketTreeStorageType_Compressed)
+            {
+                updated = (((const BucketTreeCompressedStorageEntry*)cur_entry)->compression_type == BucketTreeCompressedStorageCompressionType_Zero);
+            } else {
+                updated = (((const BucketTreeIndirectStorageEntry*)cur_entry)->storage_index == BucketTreeIndirectStorageIndex_Patch);
+            }
+        } else
+        if (ctx->storage_type == BucketTreeStorageType_Compressed)
+        {
+            /* Check if the Indirect Storage block pointed to by this Compressed Storage entry overlaps with at least one Patch-backed range. */
+            /* This uses the same block extents calculated by bktrIsBlockWithinIndirectStorageRange(). */
+            const BucketTreeCompressedStorageEntry *compressed_entry = (const BucketTreeCompressedStorageEntry*)cur_entry;
+            const u64 indirect_block_offset = (ctx->nca_fs_ctx->hash_region.size + (u64)compressed_entry->physical_offset);
+            updated = bktrIsBlockWithinVirtualRanges(indirect_ranges, indirect_range_count, indirect_block_offset, next_entry_offset - cur_entry_offset);
+        } else {
+            updated = (((const BucketTreeIndirectStorageEntry*)cur_entry)->storage_index == BucketTreeIndirectStorageIndex_Patch);
+        }
+
+        if (updated && !bktrAppendVirtualRange(&ranges, &range_count, &range_capacity, cur_entry_offset, next_entry_offset - cur_entry_offset)) goto end;
+
+        if (!has_next_entry) break;
+    }
+
+    /* Update output values. */
+    *out_ranges = ranges;
+    *out_count = range_count;
+    success = true;
+
+end:
+    if (!success && ranges) free(ranges);
+
+    if (indirect_ranges) free(indirect_ranges);
+
+    return success;
+}
+
+static bool bktrAppendVirtualRange(BucketTreeVirtualRange **ranges, u32 *range_count, u32 *range_capacity, u64 offset, u64 size)
+{
+    BucketTreeVirtualRange *tmp_ranges = NULL;
+
+    /* Merge this range with the previous one if they're adjacent. */
+    if (*range_count)
+    {
+        BucketTreeVirtualRange *prev_range = &((*ranges)[*range_count - 1]);
+        if ((prev_range->offset + prev_range->size) == offset)
+        {
+            prev_range->size += size;
+            return true;
+        }
+    }
+
+    /* Reallocate range array, if needed. */
+    if (*range_count >= *range_capacity)
+    {
+        u32 new_capacity = (*range_capacity ? (*range_capacity * 2) : 64);
+
+        tmp_ranges = realloc(*ranges, new_capacity * sizeof(BucketTreeVirtualRange));
+        if (!tmp_ranges)
+        {
+            LOG_MSG_ERROR("Failed to reallocate virtual range array!");
+            return false;
+        }
+
+        *ranges = tmp_ranges;
+        *range_capacity = new_capacity;
+    }
+
+    /* Append new range. */
+    BucketTreeVirtualRange *new_range = &((*ranges)[(*range_count)++]);
+    new_range->offset = offset;
+    new_range->size = size;
+
+    return true;
+}
+
+static bool bktrQueryStorageExtentsInternal(BucketTreeContext *ctx, StorageExtentList *out, u64 size, u64 offset, u64 virtual_offset, u8 type)
+{
+    /* AesCtrEx storages only hold crypto parameters. Their data always lives within the same NCA, using the same offsets. */
+    if (ctx->storage_type == BucketTreeStorageType_AesCtrEx) return bktrQuerySubStorageExtents(&(ctx->substorages[0]), out, size, offset, virtual_offset, StorageExtentType_Patched);
+
+    BucketTreeVisitor visitor = {0};
+    u64 accum = 0;
+    bool success = false;
+
+    /* Find the storage entry that holds the provided offset. */
+    if (!bktrFindStorageEntry(ctx, offset, &visitor))
+    {
+        LOG_MSG_ERROR("Unable to find %s storage entry for offset 0x%lX!", bktrGetStorageTypeName(ctx->storage_type), offset);
+        return false;
+    }
+
+    /* Loop through all storage entries within the provided range. */
+    while(accum < size)
+    {
+        /* The virtual offset is always the first field from every Bucket Tree storage entry type. */
+        const void *cur_entry = visitor.entry;
+        const u64 cur_entry_offset = bktrGetVisitorEntryVirtualOffset(&visitor);
+        const u64 block_offset = (offset + accum);
+        u64 next_entry_offset = ctx->end_offset;
+
+        if (!bktrIsOffsetWithinStorageRange(ctx, cur_entry_offset) || cur_entry_offset > block_offset)
+        {
+            LOG_MSG_ERROR("Invalid %s Storage entry! (0x%lX).", bktrGetStorageTypeName(ctx->storage_type), cur_entry_offset);
+            goto end;
+        }
+
+        /* Retrieve the next entry, if available. */
+        bool has_next_entry = bktrVisitorCanMoveNext(&visitor);
+        if (has_next_entry)
+        {
+            if (!bktrVisitorMoveNext(&visitor))
+            {
+                LOG_MSG_ERROR("Failed to retrieve next %s Storage entry!", bktrGetStorageTypeName(ctx->storage_type));
+                goto end;
+            }
+
+            next_entry_offset = bktrGetVisitorEntryVirtualOffset(&visitor);
+            if (next_entry_offset <= cur_entry_offset || next_entry_offset > ctx->end_offset)
+            {
+                LOG_MSG_ERROR("Invalid %s Storage entry! (0x%lX).", bktrGetStorageTypeName(ctx->storage_type), next_entry_offset);
+                goto end;
+            }
+        }
+
+        const u64 block_size = MIN(size - accum, next_entry_offset - block_offset);
+        const u64 block_virtual_offset = (virtual_offset + accum);
+        StorageExtent zero_extent = { .offset = block_virtual_offset, .size = block_size, .type = StorageExtentType_Zero, .source = StorageExtentSource_None };
+        bool ret = false;
+
+        if (ctx->storage_type == BucketTreeStorageType_Compressed)
+        {
+            const BucketTreeCompressedStorageEntry *compressed_entry = (const BucketTreeCompressedStorageEntry*)cur_entry;
+
+            switch(compressed_entry->compression_type)
+            {
+                case BucketTreeCompressedStorageCompressionType_None:
+                {
+                    /* Non-compressed entries can be randomly accessed. */
+                    u64 sub_offset = (ctx->nca_fs_ctx->hash_region.size + (u64)compressed_entry->physical_offset + (block_offset - cur_entry_offset));
+                    ret = bktrQuerySubStorageExtents(&(ctx->substorages[0]), out, block_size, sub_offset, block_virtual_offset, type);
+                    break;
+                }
+                case BucketTreeCompressedStorageCompressionType_Zero:
+                    ret = storageExtentListAppend(out, &zero_extent);
+                    break;
+                default:
+                    ret = bktrQueryCompressedBlockExtent(ctx, compressed_entry, out, block_size, block_virtual_offset);
+                    break;
+            }
+        } else {
+            const BucketTreeIndirectStorageEntry *indirect_entry = (const BucketTreeIndirectStorageEntry*)cur_entry;
+            u64 sub_offset = (indirect_entry->physical_offset + (block_offset - cur_entry_offset));
+
+            if (indirect_entry->storage_index == BucketTreeIndirectStorageIndex_Original)
+            {
+                /* Indirect: original data from the base NCA. Sparse: data from this very same NCA. */
+                ret = bktrQuerySubStorageExtents(&(ctx->substorages[0]), out, block_size, sub_offset, block_virtual_offset, type);
+            } else
+            if (ctx->storage_type == BucketTreeStorageType_Sparse)
+            {
+                /* SparseStorage's ZeroStorage. */
+                ret = storageExtentListAppend(out, &zero_extent);
+            } else {
+                /* AesCtrEx storage within this very same NCA. */
+                ret = bktrQuerySubStorageExtents(&(ctx->substorages[1]), out, block_size, sub_offset, block_virtual_offset, StorageExtentType_Patched);
+            }
+        }
+
+        if (!ret) goto end;
+
+        accum += block_size;
+
+        if (!has_next_entry) break;
+    }
+
+    /* Update return value. */
+    success = (accum == size);
+    if (!success) LOG_MSG_ERROR("Failed to query 0x%lX-byte long block from offset 0x%lX! (%s).", size, offset, bktrGetStorageTypeName(ctx->storage_type));
+
+end:
+    return success;
+}
+
+static bool bktrQuerySubStorageExtents(BucketTreeSubStorage *substorage, StorageExtentList *out, u64 size, u64 offset, u64 virtual_offset, u8 type)
+{
+    if (!bktrIsValidSubStorage(substorage))
+    {
+        LOG_MSG_ERROR("Invalid substorage! Base NCA data may be missing.");
+        return false;
+    }
+
+    /* Query the underlying Bucket Tree storage, if needed. */
+    if (substorage->type != BucketTreeSubStorageType_Regular) return bktrQueryStorageExtentsInternal(substorage->bktr_ctx, out, size, offset, virtual_offset, type);
+
+    NcaFsSectionContext *nca_fs_ctx = substorage->nca_fs_ctx;
+
+    if ((offset + size) > nca_fs_ctx->section_size)
+    {
+        LOG_MSG_ERROR("0x%lX-byte long block at offset 0x%lX exceeds FS section boundaries!", size, offset);
+        return false;
+    }
+
+    /* Regular substorages map section-relative offsets straight to the NCA. */
+    StorageExtent extent = {
+        .offset = virtual_offset,
+        .size = size,
+        .type = type,
+        .source = StorageExtentSource_NcaFsSection,
+        .source_ctx = nca_fs_ctx,
+        .physical_offset = (nca_fs_ctx->section_offset + offset),
+        .physical_size = size
+    };
+
+    return storageExtentListAppend(out, &extent);
+}
+
+static bool bktrQueryCompressedBlockExtent(BucketTreeContext *ctx, const BucketTreeCompressedStorageEntry *entry, StorageExtentList *out, u64 size, u64 virtual_offset)
+{
+    const u64 compressed_data_offset = (ctx->nca_fs_ctx->hash_region.size + (u64)entry->physical_offset);
+    const u64 compressed_data_size = (u64)entry->physical_size;
+
+    StorageExtentList sub_list = {0};
+    bool success = false;
+
+    /* Locate the compressed block within the underlying substorage. */
+    if (!compressed_data_size || !bktrQuerySubStorageExtents(&(ctx->substorages[0]), &sub_list, compressed_data_size, compressed_data_offset, 0, StorageExtentType_Data) || !sub_list.count)
+    {
+        LOG_MSG_ERROR("Failed to locate 0x%lX-byte long compressed block at offset 0x%lX!", compressed_data_size, compressed_data_offset);
+        goto end;
+    }
+
+    /* Compressed blocks can't be split, so the whole block is always referenced. Its physical location is taken from the first underlying extent. */
+    StorageExtent extent = {
+        .offset = virtual_offset,
+        .size = size,
+        .type = StorageExtentType_Compressed,
+        .source = sub_list.extents[0].source,
+        .source_ctx = sub_list.extents[0].source_ctx,
+        .physical_offset = sub_list.extents[0].physical_offset,
+        .physical_size = compressed_data_size
+    };
+
+    success = storageExtentListAppend(out, &extent);
+
+end:
+    storageExtentListFree(&sub_list);
+
+    return success;
+}
+
 static bool bktrInitializeIndirectStorageContext(BucketTreeContext *out, NcaFsSectionContext *nca_fs_ctx, bool is_sparse)
 {
     if ((!is_sparse && nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs) || (is_sparse && !nca_fs_ctx->has_sparse_layer))
@@ -682,6 +1108,7 @@ static bool bktrReadIndirectStorage(BucketTreeVisitor *visitor, void *out, u64 r
 
     BucketTreeIndirectStorageEntry cur_entry = {0};
     BucketTreeSubStorageReadParams params = {0};
+    BucketTreeVisitor cur_visitor = {0};
     u64 cur_entry_offset = 0, next_entry_offset = 0, accum = 0;
 
     bool success = false;
@@ -698,10 +1125,20 @@ static bool bktrReadIndirectStorage(BucketTreeVisitor *visitor, void *out, u64 r
     /* Perform Indirect Storage reads until we reach the requested size. */
     while(accum < read_size)
     {
+        /* Check if the read has been cancelled. */
+        if (cancelTokenIsCurrentCancelled())
+        {
+            LOG_MSG_DEBUG("Indirect Storage read cancelled at offset 0x%lX.", offset + accum);
+            goto end;
+        }
+
         u8 *out_ptr = ((u8*)out + accum);
         const u64 indirect_block_offset = (offset + accum);
         u64 indirect_block_size = 0, indirect_block_read_size = 0, indirect_block_read_offset = 0, read_size_diff = 0;
 
+        /* Keep a copy of the visitor pointing to the current entry. It'll be used to update the storage cursor. */
+        memcpy(&cur_visitor, visitor, sizeof(BucketTreeVisitor));
+
         /* Get current Indirect Storage entry and the start offset for the next one. */
         if (!bktrGetIndirectStorageEntryExtents(visitor, indirect_block_offset, &cur_entry, &next_entry_offset))
         {
@@ -718,6 +1155,27 @@ static bool bktrReadIndirectStorage(BucketTreeVisitor *visitor, void *out, u64 r
         indirect_block_read_size = (read_size_diff > indirect_block_size ? indirect_block_size : read_size_diff);
         indirect_block_read_offset = (indirect_block_offset - cur_entry_offset + cur_entry.physical_offset);
 
+        /* Coalesce adjacent entries that point to physically contiguous data within the same substorage, in order to issue a single substorage read. */
+        /* Physical offsets are irrelevant for SparseStorage's ZeroStorage. */
+        while((accum + indirect_block_read_size) < read_size && next_entry_offset < ctx->end_offset)
+        {
+            const BucketTreeIndirectStorageEntry *next_entry = (const BucketTreeIndirectStorageEntry*)visitor->entry;
+            if (next_entry->storage_index != cur_entry.storage_index || (!(is_sparse && cur_entry.storage_index == BucketTreeIndirectStorageIndex_Patch) && \
+                next_entry->physical_offset != (indirect_block_read_offset + indirect_block_read_size))) break;
+
+            memcpy(&cur_visitor, visitor, sizeof(BucketTreeVisitor));
+
+            if (!bktrGetIndirectStorageEntryExtents(visitor, next_entry_offset, &cur_entry, &next_entry_offset))
+            {
+                LOG_MSG_ERROR("Failed to get Indirect Storage entry extents for offset 0x%lX!", indirect_block_offset + indirect_block_read_size);
+                goto end;
+            }
+
+            cur_entry_offset = cur_entry.virtual_offset;
+            read_size_diff = (read_size - accum - indirect_block_read_size);
+            indirect_block_read_size += MIN(next_entry_offset - cur_entry_offset, read_size_diff);
+        }
+
         /* Perform read operation within the current Indirect Storage entry. */
         bktrInitializeSubStorageReadParams(&params, out_ptr, indirect_block_read_offset, indirect_block_read_size, indirect_block_offset, 0, false, ctx->storage_type);
 
@@ -756,6 +1214,9 @@ static bool bktrReadIndirectStorage(BucketTreeVisitor *visitor, void *out, u64 r
         accum += indirect_block_read_size;
     }
 
+    /* Update storage cursor. */
+    bktrUpdateCursor(ctx, &cur_visitor, cur_entry_offset, next_entry_offset);
+
     /* Update flag. */
     success = true;
 
@@ -910,9 +1371,13 @@ static bool bktrReadAesCtrExStorage(BucketTreeVisitor *visitor, void *out, u64 r
     BucketTreeContext *ctx = visitor->bktr_ctx;
 
     BucketTreeAesCtrExStorageEntry cur_entry = {0};
-    BucketTreeSubStorageReadParams params = {0};
+    BucketTreeVisitor cur_visitor = {0};
     u64 cur_entry_offset = 0, next_entry_offset = 0, accum = 0;
 
+    NcaAesCtrExRange ranges[BKTR_AES_CTR_EX_RANGE_BATCH_COUNT] = {0};
+    u32 range_count = 0;
+    u64 batch_offset = offset, batch_size = 0;
+
     bool success = false;
 
     if (!out || !bktrIsValidSubStorage(&(ctx->substorages[0])) || ctx->substorages[0].type != BucketTreeSubStorageType_Regular || (offset + read_size) > ctx->end_offset)
@@ -924,10 +1389,19 @@ static bool bktrReadAesCtrExStorage(BucketTreeVisitor *visitor, void *out, u64 r
     /* Perform AesCtrEx Storage reads until we reach the requested size. */
     while(accum < read_size)
     {
-        u8 *out_ptr = ((u8*)out + accum);
+        /* Check if the read has been cancelled. */
+        if (cancelTokenIsCurrentCancelled())
+        {
+            LOG_MSG_DEBUG("AesCtrEx Storage read cancelled at offset 0x%lX.", offset + accum);
+            goto end;
+        }
+
         const u64 aes_ctr_ex_block_offset = (offset + accum);
         u64 aes_ctr_ex_block_size = 0, aes_ctr_ex_block_read_size = 0, read_size_diff = 0;
 
+        /* Keep a copy of the visitor pointing to the current entry. It'll be used to update the storage cursor. */
+        memcpy(&cur_visitor, visitor, sizeof(BucketTreeVisitor));
+
         /* Get current AesCtrEx Storage entry and the start offset for the next one. */
         if (!bktrGetAesCtrExStorageEntryExtents(visitor, aes_ctr_ex_block_offset, &cur_entry, &next_entry_offset))
         {
@@ -943,20 +1417,54 @@ static bool bktrReadAesCtrExStorage(BucketTreeVisitor *visitor, void *out, u64 r
         read_size_diff = (read_size - accum);
         aes_ctr_ex_block_read_size = (read_size_diff > aes_ctr_ex_block_size ? aes_ctr_ex_block_size : read_size_diff);
 
-        /* Perform read operation within the current AesCtrEx Storage entry. */
-        bool aes_ctr_ex_crypt = (cur_entry.encryption == BucketTreeAesCtrExStorageEncryption_Enabled);
-        bktrInitializeSubStorageReadParams(&params, out_ptr, aes_ctr_ex_block_offset, aes_ctr_ex_block_read_size, 0, cur_entry.generation, aes_ctr_ex_crypt, ctx->storage_type);
-
-        if (!bktrReadSubStorage(&(ctx->substorages[0]), &params))
+        /* Coalesce adjacent entries that share the same encryption setting and counter generation into a single sub-range. */
+        while((accum + aes_ctr_ex_block_read_size) < read_size && next_entry_offset < ctx->end_offset)
         {
-            LOG_MSG_ERROR("Failed to read 0x%lX-byte long chunk at offset 0x%lX from AesCtrEx storage!", aes_ctr_ex_block_read_size, aes_ctr_ex_block_offset);
-            goto end;
+            const BucketTreeAesCtrExStorageEntry *next_entry = (const BucketTreeAesCtrExStorageEntry*)visitor->entry;
+            if (next_entry->encryption != cur_entry.encryption || (cur_entry.encryption == BucketTreeAesCtrExStorageEncryption_Enabled && \
+                next_entry->generation != cur_entry.generation)) break;
+
+            memcpy(&cur_visitor, visitor, sizeof(BucketTreeVisitor));
+
+            if (!bktrGetAesCtrExStorageEntryExtents(visitor, next_entry_offset, &cur_entry, &next_entry_offset))
+            {
+                LOG_MSG_ERROR("Failed to get AesCtrEx Storage entry extents for offset 0x%lX!", aes_ctr_ex_block_offset + aes_ctr_ex_block_read_size);
+                goto end;
+            }
+
+            cur_entry_offset = cur_entry.offset;
+            read_size_diff = (read_size - accum - aes_ctr_ex_block_read_size);
+            aes_ctr_ex_block_read_size += MIN(next_entry_offset - cur_entry_offset, read_size_diff);
         }
 
-        /* Update accumulator. */
+        /* Add a sub-range for the current AesCtrEx Storage block. */
+        ranges[range_count].size = aes_ctr_ex_block_read_size;
+        ranges[range_count].ctr_val = cur_entry.generation;
+        ranges[range_count].decrypt = (cur_entry.encryption == BucketTreeAesCtrExStorageEncryption_Enabled);
+        range_count++;
+
+        /* Update accumulators. */
+        batch_size += aes_ctr_ex_block_read_size;
         accum += aes_ctr_ex_block_read_size;
+
+        /* Read all collected sub-ranges at once, decrypting each one with its own CTR value. */
+        if (range_count == BKTR_AES_CTR_EX_RANGE_BATCH_COUNT || accum >= read_size)
+        {
+            if (!ncaReadAesCtrExStorageRanges(ctx->substorages[0].nca_fs_ctx, (u8*)out + (batch_offset - offset), batch_size, batch_offset, ranges, range_count))
+            {
+                LOG_MSG_ERROR("Failed to read 0x%lX-byte long chunk at offset 0x%lX from AesCtrEx storage! (%u sub-range[s]).", batch_size, batch_offset, range_count);
+                goto end;
+            }
+
+            batch_offset += batch_size;
+            batch_size = 0;
+            range_count = 0;
+        }
     }
 
+    /* Update storage cursor. */
+    bktrUpdateCursor(ctx, &cur_visitor, cur_entry_offset, next_entry_offset);
+
     /* Update flag. */
     success = true;
 
@@ -1049,6 +1557,7 @@ static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64
 
     BucketTreeCompressedStorageEntry cur_entry = {0};
     BucketTreeSubStorageReadParams params = {0};
+    BucketTreeVisitor cur_visitor = {0};
     u64 cur_entry_offset = 0, next_entry_offset = 0, accum = 0;
 
     bool success = false;
@@ -1063,10 +1572,20 @@ static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64
     /* Perform Compressed Storage reads until we reach the requested size. */
     while(accum < read_size)
     {
+        /* Check if the read has been cancelled. */
+        if (cancelTokenIsCurrentCancelled())
+        {
+            LOG_MSG_DEBUG("Compressed Storage read cancelled at offset 0x%lX.", offset + accum);
+            goto end;
+        }
+
         u8 *out_ptr = ((u8*)out + accum);
         const u64 compressed_block_offset = (offset + accum);
         u64 compressed_block_size = 0, compressed_block_read_size = 0, compressed_block_read_offset = 0, read_size_diff = 0;
 
+        /* Keep a copy of the visitor pointing to the current entry. It'll be used to update the storage cursor. */
+        memcpy(&cur_visitor, visitor, sizeof(BucketTreeVisitor));
+
         /* Get current Compressed Storage entry and the start offset for the next one. */
         if (!bktrGetCompressedStorageEntryExtents(visitor, compressed_block_offset, &cur_entry, &next_entry_offset))
         {
@@ -1109,66 +1628,137 @@ static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64
             case BucketTreeCompressedStorageCompressionType_LZ4:
             {
                 /* We can't randomly access data that's compressed. */
-                /* Let's be lazy and allocate memory for the full entry, read it and then decompress it. */
-                compressed_block_read_offset = (compressed_storage_base_offset + (u64)cur_entry.physical_offset);
+                /* Decompress the full entry (or retrieve it from the LZ4 cache) and copy the data we need. */
+                if (!bktrReadCompressedStorageLz4Entry(ctx, &cur_entry, next_entry_offset - cur_entry_offset, out_ptr, compressed_block_read_size, compressed_block_offset - cur_entry_offset)) goto end;
+                break;
+            }
+            default:
+                break;
+        }
 
-                const u64 compressed_data_size = (u64)cur_entry.physical_size;
-                const u64 decompressed_data_size = (next_entry_offset - cur_entry_offset);
-                const u64 buffer_size = LZ4_DECOMPRESS_INPLACE_BUFFER_SIZE(decompressed_data_size);
+        /* Update accumulator. */
+        accum += compressed_block_read_size;
+    }
 
-                u8 *buffer = NULL, *read_ptr = NULL;
+    /* Update storage cursor. */
+    bktrUpdateCursor(ctx, &cur_visitor, cur_entry_offset, next_entry_offset);
 
-                buffer = calloc(1, buffer_size);
-                if (!buffer)
-                {
-                    LOG_MSG_ERROR("Failed to allocate 0x%lX-byte long buffer for data decompression! (0x%lX).", buffer_size, decompressed_data_size);
-                    goto end;
-                }
+    /* Update flag. */
+    success = true;
 
-                /* Adjust read pointer. This will let us use the same buffer for storing read data and decompressing it. */
-                read_ptr = (buffer + (buffer_size - compressed_data_size));
-                bktrInitializeSubStorageReadParams(&params, read_ptr, compressed_block_read_offset, compressed_data_size, 0, 0, false, ctx->storage_type);
+end:
+    return success;
+}
 
-                /* Read compressed LZ4 block. */
-                if (!bktrReadSubStorage(&(ctx->substorages[0]), &params))
-                {
-                    LOG_MSG_ERROR("Failed to read 0x%lX-byte long compressed block from offset 0x%lX!", compressed_data_size, compressed_block_read_offset);
-                    free(buffer);
-                    goto end;
-                }
+static bool bktrReadCompressedStorageLz4Entry(BucketTreeContext *ctx, const BucketTreeCompressedStorageEntry *entry, u64 entry_size, void *out, u64 read_size, u64 offset)
+{
+    BucketTreeLz4CacheEntry *cache_entry = NULL;
+    u8 *buffer = NULL;
+    bool success = false;
 
-                /* Decompress LZ4 block. */
-                int lz4_res = LZ4_decompress_safe((char*)read_ptr, (char*)buffer, (int)compressed_data_size, (int)buffer_size);
-                if (lz4_res != (int)decompressed_data_size)
-                {
-                    LOG_MSG_ERROR("Failed to decompress 0x%lX-byte long compressed block! (%d).", compressed_data_size, lz4_res);
-                    free(buffer);
-                    goto end;
-                }
+    /* Entries that are too big for the LZ4 cache are decompressed into a temporary buffer. */
+    if (entry_size > BKTR_LZ4_CACHE_MAX_DATA_SIZE)
+    {
+        const u64 buffer_size = LZ4_DECOMPRESS_INPLACE_BUFFER_SIZE(entry_size);
+
+        buffer = bufferPoolLease(buffer_size, false);
+        if (!buffer)
+        {
+            LOG_MSG_ERROR("Failed to allocate 0x%lX-byte long buffer for data decompression! (0x%lX).", buffer_size, entry_size);
+            return false;
+        }
+
+        success = bktrDecompressLz4Entry(ctx, entry, entry_size, buffer, buffer_size);
+        if (success) memcpy(out, buffer + offset, read_size);
+
+        bufferPoolReturn(buffer);
+
+        return success;
+    }
 
-                /* Copy the data we need. */
-                memcpy(out_ptr, buffer + (compressed_block_offset - cur_entry_offset), compressed_block_read_size);
+    /* Use fewer cache slots under low memory conditions. */
+    const u8 cache_entry_count = (u8)utilsGetBudgetedBufferCount(BKTR_LZ4_CACHE_ENTRY_COUNT, 1);
 
-                /* Free allocated buffer. */
-                free(buffer);
+    SCOPED_LOCK(&(ctx->lz4_cache_mutex))
+    {
+        /* Look for the requested entry within the LZ4 cache. Pick the least recently used slot as a replacement candidate along the way. */
+        for(u8 i = 0; i < cache_entry_count; i++)
+        {
+            BucketTreeLz4CacheEntry *cur_cache_entry = &(ctx->lz4_cache[i]);
 
+            if (cur_cache_entry->size && cur_cache_entry->virtual_offset == (u64)entry->virtual_offset && cur_cache_entry->size == entry_size)
+            {
+                cache_entry = cur_cache_entry;
+                success = true;
                 break;
             }
-            default:
+
+            if (!cache_entry || cur_cache_entry->last_used < cache_entry->last_used) cache_entry = cur_cache_entry;
+        }
+
+        if (!success)
+        {
+            /* Cache miss. Allocate memory for the selected cache slot, if needed. */
+            if (!cache_entry->buffer && !(cache_entry->buffer = bufferPoolLease(BKTR_LZ4_CACHE_BUFFER_SIZE, false)))
+            {
+                LOG_MSG_ERROR("Failed to allocate memory for LZ4 cache buffer!");
                 break;
+            }
+
+            /* Invalidate the selected cache slot before decompressing data into it. */
+            cache_entry->size = 0;
+
+            if (!bktrDecompressLz4Entry(ctx, entry, entry_size, cache_entry->buffer, BKTR_LZ4_CACHE_BUFFER_SIZE)) break;
+
+            cache_entry->virtual_offset = (u64)entry->virtual_offset;
+            cache_entry->size = entry_size;
+            success = true;
         }
 
-        /* Update accumulator. */
-        accum += compressed_block_read_size;
+        /* Update LRU counter and copy the data we need. */
+        cache_entry->last_used = ++(ctx->lz4_cache_counter);
+        memcpy(out, cache_entry->buffer + offset, read_size);
     }
 
-    /* Update flag. */
-    success = true;
-
-end:
     return success;
 }
 
+static bool bktrDecompressLz4Entry(BucketTreeContext *ctx, const BucketTreeCompressedStorageEntry *entry, u64 entry_size, u8 *buffer, u64 buffer_size)
+{
+    const u64 compressed_data_offset = (ctx->nca_fs_ctx->hash_region.size + (u64)entry->physical_offset);
+    const u64 compressed_data_size = (u64)entry->physical_size;
+
+    BucketTreeSubStorageReadParams params = {0};
+    u8 *read_ptr = NULL;
+
+    if (compressed_data_size > buffer_size)
+    {
+        LOG_MSG_ERROR("Compressed block size exceeds decompression buffer size! (0x%lX > 0x%lX).", compressed_data_size, buffer_size);
+        return false;
+    }
+
+    /* Adjust read pointer. This will let us use the same buffer for storing read data and decompressing it. */
+    read_ptr = (buffer + (buffer_size - compressed_data_size));
+    bktrInitializeSubStorageReadParams(&params, read_ptr, compressed_data_offset, compressed_data_size, 0, 0, false, ctx->storage_type);
+
+    /* Read compressed LZ4 block. */
+    if (!bktrReadSubStorage(&(ctx->substorages[0]), &params))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX-byte long compressed block from offset 0x%lX!", compressed_data_size, compressed_data_offset);
+        return false;
+    }
+
+    /* Decompress LZ4 block. */
+    int lz4_res = LZ4_decompress_safe((char*)read_ptr, (char*)buffer, (int)compressed_data_size, (int)buffer_size);
+    if (lz4_res != (int)entry_size)
+    {
+        LOG_MSG_ERROR("Failed to decompress 0x%lX-byte long compressed block! (%d).", compressed_data_size, lz4_res);
+        return false;
+    }
+
+    return true;
+}
+
 static bool bktrReadSubStorage(BucketTreeSubStorage *substorage, BucketTreeSubStorageReadParams *params)
 {
     if (!bktrIsValidSubStorage(substorage) || !params || !params->buffer || !params->size)
@@ -1204,6 +1794,59 @@ static bool bktrReadSubStorage(BucketTreeSubStorage *substorage, BucketTreeSubSt
     return success;
 }
 
+static bool bktrSeekCursor(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor)
+{
+    BucketTreeVisitor visitor = {0}, next_visitor = {0};
+    u64 next_entry_offset = 0;
+    bool success = false;
+
+    SCOPED_LOCK(&(ctx->cursor_mutex))
+    {
+        /* The storage cursor can only be moved forward. */
+        if (!ctx->cursor.valid || virtual_offset < ctx->cursor.entry_offset) break;
+
+        memcpy(&visitor, &(ctx->cursor.visitor), sizeof(BucketTreeVisitor));
+        next_entry_offset = ctx->cursor.next_entry_offset;
+        success = true;
+    }
+
+    if (!success) return false;
+
+    /* Move the visitor forward until we find the entry that holds the provided virtual offset. */
+    for(u32 i = 0; virtual_offset >= next_entry_offset; i++)
+    {
+        if (i >= BKTR_CURSOR_MAX_MOVE_COUNT || !bktrVisitorCanMoveNext(&visitor)) return false;
+
+        /* Move onto the next entry. */
+        if (!bktrVisitorMoveNext(&visitor)) return false;
+
+        /* Peek the entry that follows it to get its end offset. */
+        memcpy(&next_visitor, &visitor, sizeof(BucketTreeVisitor));
+        next_entry_offset = ((bktrVisitorCanMoveNext(&next_visitor) && bktrVisitorMoveNext(&next_visitor)) ? bktrGetVisitorEntryVirtualOffset(&next_visitor) : ctx->end_offset);
+    }
+
+    memcpy(out_visitor, &visitor, sizeof(BucketTreeVisitor));
+
+    return true;
+}
+
+static void bktrUpdateCursor(BucketTreeContext *ctx, const BucketTreeVisitor *visitor, u64 entry_offset, u64 next_entry_offset)
+{
+    SCOPED_LOCK(&(ctx->cursor_mutex))
+    {
+        memcpy(&(ctx->cursor.visitor), visitor, sizeof(BucketTreeVisitor));
+        ctx->cursor.entry_offset = entry_offset;
+        ctx->cursor.next_entry_offset = next_entry_offset;
+        ctx->cursor.valid = true;
+    }
+}
+
+NX_INLINE u64 bktrGetVisitorEntryVirtualOffset(BucketTreeVisitor *visitor)
+{
+    /* The virtual offset is always the first field from every Bucket Tree storage entry type. */
+    return *((const u64*)visitor->entry);
+}
+
 NX_INLINE void bktrInitializeSubStorageReadParams(BucketTreeSubStorageReadParams *out, void *buffer, u64 offset, u64 size, u64 virtual_offset, u32 ctr_val, bool aes_ctr_ex_crypt, u8 parent_storage_type)
 {
     out->buffer = buffer;
@@ -1342,6 +1985,149 @@ NX_INLINE const u64 *bktrGetOffsetNodeEnd(const BucketTreeOffsetNode *offset_nod
     return (bktrGetOffsetNodeArray(offset_node) + offset_node->header.count);
 }
 
+static bool bktrBuildFlatIndex(BucketTreeContext *ctx)
+{
+    BucketTreeFlatIndex *flat_index = &(ctx->flat_index);
+    u32 entry_count = 0, block_count = 0, cur_entry = 0;
+    u64 prev_offset = 0;
+    bool success = false;
+
+    /* Calculate total entry count. */
+    for(u32 i = 0; i < ctx->entry_set_count; i++)
+    {
+        const BucketTreeNodeHeader *entry_set_header = bktrGetEntryNodeHeader(ctx, i);
+        if (!entry_set_header) return false;
+        entry_count += entry_set_header->count;
+    }
+
+    if (!entry_count) return false;
+
+    block_count = (u32)(ALIGN_UP((u64)entry_count, BKTR_FLAT_INDEX_BLOCK_SIZE) / BKTR_FLAT_INDEX_BLOCK_SIZE);
+
+    /* Allocate memory for the flat index. */
+    flat_index->offsets = malloc((u64)block_count * BKTR_FLAT_INDEX_BLOCK_SIZE * sizeof(u64));
+    flat_index->block_offsets = malloc((u64)block_count * sizeof(u64));
+    flat_index->entry_set_indices = malloc((u64)entry_count * sizeof(u32));
+    flat_index->entry_set_first_indices = malloc((u64)ctx->entry_set_count * sizeof(u32));
+
+    if (!flat_index->offsets || !flat_index->block_offsets || !flat_index->entry_set_indices || !flat_index->entry_set_first_indices)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the flat index!");
+        goto end;
+    }
+
+    /* Fill flat index. */
+    for(u32 i = 0; i < ctx->entry_set_count; i++)
+    {
+        const BucketTreeNodeHeader *entry_set_header = bktrGetEntryNodeHeader(ctx, i);
+        const u64 entry_set_offset = (ctx->node_storage_size + ((u64)i * ctx->node_size));
+
+        flat_index->entry_set_first_indices[i] = cur_entry;
+
+        for(u32 j = 0; j < entry_set_header->count; j++, cur_entry++)
+        {
+            /* The virtual offset is always the first field from every Bucket Tree storage entry type. */
+            const u64 entry_offset = bktrGetEntryNodeEntryOffset(entry_set_offset, ctx->entry_size, j);
+            const u64 cur_offset = *((const u64*)((u8*)ctx->storage_table + entry_offset));
+
+            /* Virtual offsets must be sorted. */
+            if (cur_entry > 0 && cur_offset <= prev_offset)
+            {
+                LOG_MSG_ERROR("Invalid virtual offset for Bucket Tree entry #%u! (0x%lX).", cur_entry, cur_offset);
+                goto end;
+            }
+
+            flat_index->offsets[cur_entry] = prev_offset = cur_offset;
+            flat_index->entry_set_indices[cur_entry] = i;
+        }
+    }
+
+    /* Pad the last block. */
+    for(u32 i = entry_count; i < (block_count * BKTR_FLAT_INDEX_BLOCK_SIZE); i++) flat_index->offsets[i] = UINT64_MAX;
+
+    /* Fill block offsets. */
+    for(u32 i = 0; i < block_count; i++) flat_index->block_offsets[i] = flat_index->offsets[i * BKTR_FLAT_INDEX_BLOCK_SIZE];
+
+    flat_index->entry_count = entry_count;
+    flat_index->block_count = block_count;
+
+    success = true;
+
+end:
+    if (!success)
+    {
+        if (flat_index->offsets) free(flat_index->offsets);
+        if (flat_index->block_offsets) free(flat_index->block_offsets);
+        if (flat_index->entry_set_indices) free(flat_index->entry_set_indices);
+        if (flat_index->entry_set_first_indices) free(flat_index->entry_set_first_indices);
+        memset(flat_index, 0, sizeof(BucketTreeFlatIndex));
+    }
+
+    return success;
+}
+
+static bool bktrFindFlatIndexEntry(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor)
+{
+    BucketTreeFlatIndex *flat_index = &(ctx->flat_index);
+
+    /* Perform a binary search to find the last block whose first virtual offset is lower than or equal to the provided one. */
+    u32 low = 0, high = flat_index->block_count;
+
+    while(low < high)
+    {
+        u32 mid = (low + ((high - low) / 2));
+
+        if (flat_index->block_offsets[mid] <= virtual_offset)
+        {
+            low = (mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+
+    if (!low)
+    {
+        LOG_MSG_ERROR("Virtual offset 0x%lX precedes the first Bucket Tree entry!", virtual_offset);
+        return false;
+    }
+
+    /* Find the last entry within the selected block whose virtual offset is lower than or equal to the provided one. */
+    const u32 block_index = (low - 1);
+    const u32 count = bktrCountFlatIndexBlockEntries(flat_index->offsets + ((u64)block_index * BKTR_FLAT_INDEX_BLOCK_SIZE), virtual_offset);
+    const u32 flat_entry_index = ((block_index * BKTR_FLAT_INDEX_BLOCK_SIZE) + count - 1);
+
+    /* Get the entry. */
+    const u32 entry_set_index = flat_index->entry_set_indices[flat_entry_index];
+    const u32 entry_index = (flat_entry_index - flat_index->entry_set_first_indices[entry_set_index]);
+
+    const BucketTreeNodeHeader *entry_set_header = bktrGetEntryNodeHeader(ctx, entry_set_index);
+    if (!entry_set_header)
+    {
+        LOG_MSG_ERROR("Failed to retrieve entry node header at index 0x%X!", entry_set_index);
+        return false;
+    }
+
+    return bktrGetEntry(ctx, out_visitor, entry_set_header, entry_set_index, entry_index);
+}
+
+NX_INLINE u32 bktrCountFlatIndexBlockEntries(const u64 *block, u64 virtual_offset)
+{
+    /* Count the virtual offsets within this block that are lower than or equal to the provided one. */
+#ifdef __ARM_NEON
+    /* Each matching lane holds an all-ones mask (-1), so subtracting it from the accumulator increases the count by one. */
+    const uint64x2_t target = vdupq_n_u64(virtual_offset);
+    uint64x2_t accum = vdupq_n_u64(0);
+
+    for(u32 i = 0; i < BKTR_FLAT_INDEX_BLOCK_SIZE; i += 2) accum = vsubq_u64(accum, vcleq_u64(vld1q_u64(block + i), target));
+
+    return (u32)vaddvq_u64(accum);
+#else
+    u32 count = 0;
+    for(u32 i = 0; i < BKTR_FLAT_INDEX_BLOCK_SIZE; i++) count += (block[i] <= virtual_offset);
+    return count;
+#endif
+}
+
 static bool bktrFindStorageEntry(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor)
 {
     if (!ctx || virtual_offset >= ctx->storage_table->offset_node.header.offset || !out_visitor)
@@ -1350,6 +2136,9 @@ static bool bktrFindStorageEntry(BucketTreeContext *ctx, u64 virtual_offset, Buc
         return false;
     }
 
+    /* Use the flat index, if available. */
+    if (ctx->flat_index.entry_count) return bktrFindFlatIndexEntry(ctx, virtual_offset, out_visitor);
+
     /* Get the node. */
     const BucketTreeOffsetNode *offset_node = &(ctx->storage_table->offset_node);
 
@@ -1536,19 +2325,24 @@ static bool bktrFindEntry(BucketTreeContext *ctx, BucketTreeVisitor *out_visitor
         return false;
     }
 
-    /* Calculate entry node extents. */
-    const u64 entry_size = ctx->entry_size;
-    const u64 entry_set_size = ctx->node_size;
-    const u64 entry_set_offset = (ctx->node_storage_size + (entry_set_index * entry_set_size));
-
     /* Get entry node entry index. */
     u32 entry_index = 0;
-    if (!bktrGetEntryNodeEntryIndex(entry_set_header, entry_size, virtual_offset, &entry_index))
+    if (!bktrGetEntryNodeEntryIndex(entry_set_header, ctx->entry_size, virtual_offset, &entry_index))
     {
         LOG_MSG_ERROR("Failed to get entry node entry index!");
         return false;
     }
 
+    return bktrGetEntry(ctx, out_visitor, entry_set_header, entry_set_index, entry_index);
+}
+
+static bool bktrGetEntry(BucketTreeContext *ctx, BucketTreeVisitor *out_visitor, const BucketTreeNodeHeader *entry_set_header, u32 entry_set_index, u32 entry_index)
+{
+    /* Calculate entry node extents. */
+    const u64 entry_size = ctx->entry_size;
+    const u64 entry_set_size = ctx->node_size;
+    const u64 entry_set_offset = (ctx->node_storage_size + (entry_set_index * entry_set_size));
+
     /* Get entry node entry offset and validate it. */
     u64 entry_offset = bktrGetEntryNodeEntryOffset(entry_set_offset, entry_size, entry_index);
     if ((entry_offset + entry_size) > (ctx->node_storage_size + ctx->entry_storage_size))
@@ -0,0 +1,290 @@
+/*
+ * buffer_pool.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <core/nxdt_utils.h>
+
+#define BUFFER_POOL_SIZE_CLASS          0x10000     /* 64 KiB. */
+
+#define BUFFER_POOL_MAX_LEASE_COUNT     64
+#define BUFFER_POOL_MAX_IDLE_COUNT      8
+
+#define BUFFER_POOL_MAX_SIZE            0x6000000   /* 96 MiB. In-flight size cap. Scaled down according to the memory budget (see utilsGetBudgetedBufferSize()). */
+#define BUFFER_POOL_MIN_SIZE            0x2000000   /* 32 MiB. */
+
+#define BUFFER_POOL_MAX_IDLE_SIZE       0x2000000   /* 32 MiB. Idle buffer cache size cap. Scaled down according to the memory budget as well. */
+#define BUFFER_POOL_MIN_IDLE_SIZE       0x800000    /* 8 MiB. */
+
+/* Type definitions. */
+
+typedef struct {
+    void *ptr;
+    size_t size;
+    bool short_lived;   ///< Only used by leased buffers. Set if the buffer was leased with 'wait' set to true.
+} BufferPoolEntry;
+
+/* Global variables. */
+
+static Mutex g_bufferPoolMutex = 0;
+static CondVar g_bufferPoolCondVar = 0;
+
+static BufferPoolEntry g_bufferPoolLeases[BUFFER_POOL_MAX_LEASE_COUNT] = {0};
+static BufferPoolEntry g_bufferPoolIdle[BUFFER_POOL_MAX_IDLE_COUNT] = {0};
+
+static u64 g_bufferPoolInFlightSize = 0, g_bufferPoolPeakSize = 0, g_bufferPoolCachedSize = 0;
+static u32 g_bufferPoolLeaseCount = 0, g_bufferPoolShortLivedCount = 0;
+
+/* Function prototypes. */
+
+static BufferPoolEntry *bufferPoolGetFreeLeaseEntry(void);
+static void *bufferPoolTakeIdleBuffer(size_t size, size_t *out_size);
+static void *bufferPoolAllocateBuffer(size_t size);
+static void _bufferPoolTrim(void);
+
+void *bufferPoolLease(size_t size, bool wait)
+{
+    return bufferPoolLeaseWithSize(size, wait, NULL);
+}
+
+void *bufferPoolLeaseWithSize(size_t size, bool wait, size_t *out_size)
+{
+    if (!size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    size_t class_size = ALIGN_UP(size, BUFFER_POOL_SIZE_CLASS), buf_size = class_size;
+    BufferPoolEntry *lease = NULL;
+    void *buf = NULL;
+
+    mutexLock(&g_bufferPoolMutex);
+
+    while(true)
+    {
+        /* Look for a free lease entry. */
+        if (!(lease = bufferPoolGetFreeLeaseEntry()))
+        {
+            LOG_MSG_ERROR("Lease table is full! (0x%lX).", size);
+            break;
+        }
+
+        /* Check if the in-flight size cap has been hit. Short-lived leases wait for other short-lived leases to be returned. */
+        /* There's no point in waiting if none are available, though. Long-lived leases fail right away in this case. */
+        if ((g_bufferPoolInFlightSize + class_size) > utilsGetBudgetedBufferSize(BUFFER_POOL_MAX_SIZE, BUFFER_POOL_MIN_SIZE))
+        {
+            if (!wait) break;
+
+            if (g_bufferPoolShortLivedCount)
+            {
+                condvarWait(&g_bufferPoolCondVar, &g_bufferPoolMutex);
+                continue;
+            }
+        }
+
+        /* Reuse an idle buffer, if possible. Allocate a new one otherwise. */
+        buf_size = class_size;
+        if (!(buf = bufferPoolTakeIdleBuffer(class_size, &buf_size))) buf = bufferPoolAllocateBuffer(class_size);
+
+        if (buf) break;
+
+        /* Wait until another short-lived lease is returned. */
+        if (!wait || !g_bufferPoolShortLivedCount) break;
+        condvarWait(&g_bufferPoolCondVar, &g_bufferPoolMutex);
+    }
+
+    if (buf)
+    {
+        /* Update lease table. */
+        lease->ptr = buf;
+        lease->size = buf_size;
+        lease->short_lived = wait;
+
+        g_bufferPoolInFlightSize += buf_size;
+        if (g_bufferPoolInFlightSize > g_bufferPoolPeakSize) g_bufferPoolPeakSize = g_bufferPoolInFlightSize;
+
+        g_bufferPoolLeaseCount++;
+        if (wait) g_bufferPoolShortLivedCount++;
+    }
+
+    mutexUnlock(&g_bufferPoolMutex);
+
+    if (buf)
+    {
+        if (out_size) *out_size = buf_size;
+    } else {
+        LOG_MSG_ERROR("Failed to lease 0x%lX-byte long buffer!", size);
+    }
+
+    return buf;
+}
+
+void bufferPoolReturn(void *buf)
+{
+    if (!buf) return;
+
+    SCOPED_LOCK(&g_bufferPoolMutex)
+    {
+        BufferPoolEntry *lease = NULL;
+
+        for(u32 i = 0; i < BUFFER_POOL_MAX_LEASE_COUNT; i++)
+        {
+            if (g_bufferPoolLeases[i].ptr != buf) continue;
+            lease = &(g_bufferPoolLeases[i]);
+            break;
+        }
+
+        if (!lease)
+        {
+            LOG_MSG_ERROR("Buffer %p wasn't leased from the buffer pool!", buf);
+            break;
+        }
+
+        g_bufferPoolInFlightSize -= lease->size;
+        g_bufferPoolLeaseCount--;
+        if (lease->short_lived) g_bufferPoolShortLivedCount--;
+
+        /* Keep the buffer around for reuse if there's room for it within the idle buffer cache. */
+        bool cached = false;
+
+        if ((g_bufferPoolCachedSize + lease->size) <= utilsGetBudgetedBufferSize(BUFFER_POOL_MAX_IDLE_SIZE, BUFFER_POOL_MIN_IDLE_SIZE))
+        {
+            for(u32 i = 0; i < BUFFER_POOL_MAX_IDLE_COUNT; i++)
+            {
+                if (g_bufferPoolIdle[i].ptr) continue;
+
+                g_bufferPoolIdle[i].ptr = lease->ptr;
+                g_bufferPoolIdle[i].size = lease->size;
+                g_bufferPoolCachedSize += lease->size;
+
+                cached = true;
+                break;
+            }
+        }
+
+        if (!cached) free(lease->ptr);
+
+        memset(lease, 0, sizeof(BufferPoolEntry));
+
+        /* Wake up all waiting threads. The returned buffer may fit any of them. */
+        condvarWakeAll(&g_bufferPoolCondVar);
+    }
+}
+
+void bufferPoolTrim(void)
+{
+    SCOPED_LOCK(&g_bufferPoolMutex) _bufferPoolTrim();
+}
+
+void bufferPoolGetStats(BufferPoolStats *out_stats)
+{
+    if (!out_stats) return;
+
+    SCOPED_LOCK(&g_bufferPoolMutex)
+    {
+        out_stats->in_flight_size = g_bufferPoolInFlightSize;
+        out_stats->peak_size = g_bufferPoolPeakSize;
+        out_stats->cached_size = g_bufferPoolCachedSize;
+        out_stats->max_size = utilsGetBudgetedBufferSize(BUFFER_POOL_MAX_SIZE, BUFFER_POOL_MIN_SIZE);
+        out_stats->lease_count = g_bufferPoolLeaseCount;
+    }
+}
+
+void bufferPoolExit(void)
+{
+    SCOPED_LOCK(&g_bufferPoolMutex)
+    {
+        _bufferPoolTrim();
+
+        for(u32 i = 0; i < BUFFER_POOL_MAX_LEASE_COUNT; i++)
+        {
+            BufferPoolEntry *lease = &(g_bufferPoolLeases[i]);
+            if (!lease->ptr) continue;
+
+            LOG_MSG_WARNING("0x%lX-byte long buffer %p was never returned to the buffer pool!", lease->size, lease->ptr);
+            free(lease->ptr);
+            memset(lease, 0, sizeof(BufferPoolEntry));
+        }
+
+        LOG_MSG_DEBUG("Buffer pool peak in-flight size: 0x%lX.", g_bufferPoolPeakSize);
+
+        g_bufferPoolInFlightSize = g_bufferPoolPeakSize = 0;
+        g_bufferPoolLeaseCount = g_bufferPoolShortLivedCount = 0;
+    }
+}
+
+static BufferPoolEntry *bufferPoolGetFreeLeaseEntry(void)
+{
+    for(u32 i = 0; i < BUFFER_POOL_MAX_LEASE_COUNT; i++)
+    {
+        if (!g_bufferPoolLeases[i].ptr) return &(g_bufferPoolLeases[i]);
+    }
+
+    return NULL;
+}
+
+static void *bufferPoolTakeIdleBuffer(size_t size, size_t *out_size)
+{
+    BufferPoolEntry *best_entry = NULL;
+    void *buf = NULL;
+
+    /* Pick the smallest idle buffer that can hold the requested size, as long as it isn't more than 25% bigger. */
+    for(u32 i = 0; i < BUFFER_POOL_MAX_IDLE_COUNT; i++)
+    {
+        BufferPoolEntry *cur_entry = &(g_bufferPoolIdle[i]);
+        if (!cur_entry->ptr || cur_entry->size < size || cur_entry->size > (size + (size / 4))) continue;
+        if (!best_entry || cur_entry->size < best_entry->size) best_entry = cur_entry;
+    }
+
+    if (!best_entry) return NULL;
+
+    buf = best_entry->ptr;
+    *out_size = best_entry->size;
+    g_bufferPoolCachedSize -= best_entry->size;
+
+    memset(best_entry, 0, sizeof(BufferPoolEntry));
+
+    return buf;
+}
+
+static void *bufferPoolAllocateBuffer(size_t size)
+{
+    void *buf = memalign(BUFFER_POOL_ALIGNMENT, size);
+    if (buf || !g_bufferPoolCachedSize) return buf;
+
+    /* Free all idle buffers and try again. */
+    LOG_MSG_WARNING("Failed to allocate 0x%lX-byte long buffer! Freeing idle buffers and retrying.", size);
+    _bufferPoolTrim();
+
+    return memalign(BUFFER_POOL_ALIGNMENT, size);
+}
+
+static void _bufferPoolTrim(void)
+{
+    /* Must be called with the buffer pool mutex held. */
+    for(u32 i = 0; i < BUFFER_POOL_MAX_IDLE_COUNT; i++)
+    {
+        if (!g_bufferPoolIdle[i].ptr) continue;
+        free(g_bufferPoolIdle[i].ptr);
+        memset(&(g_bufferPoolIdle[i]), 0, sizeof(BufferPoolEntry));
+    }
+
+    g_bufferPoolCachedSize = 0;
+}
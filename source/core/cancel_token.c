@@ -0,0 +1,68 @@
+/*
+ * cancel_token.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <core/nxdt_utils.h>
+
+/* Global variables. */
+
+static __thread CancelToken *g_cancelTokenCurrent = NULL;
+
+void cancelTokenReset(CancelToken *token)
+{
+    if (token) __atomic_store_n(&(token->cancelled), 0, __ATOMIC_RELEASE);
+}
+
+void cancelTokenCancel(CancelToken *token)
+{
+    if (token) __atomic_store_n(&(token->cancelled), 1, __ATOMIC_RELEASE);
+}
+
+bool cancelTokenIsCancelled(const CancelToken *token)
+{
+    return (token && __atomic_load_n(&(token->cancelled), __ATOMIC_ACQUIRE) != 0);
+}
+
+CancelToken *cancelTokenBindCurrent(CancelToken *token)
+{
+    CancelToken *prev_token = g_cancelTokenCurrent;
+    g_cancelTokenCurrent = token;
+    return prev_token;
+}
+
+CancelToken *cancelTokenGetCurrent(void)
+{
+    return g_cancelTokenCurrent;
+}
+
+void cancelTokenRestoreCurrent(CancelToken **prev_token)
+{
+    if (prev_token) g_cancelTokenCurrent = *prev_token;
+}
+
+bool cancelTokenIsCurrentCancelled(void)
+{
+    return cancelTokenIsCancelled(g_cancelTokenCurrent);
+}
+
+bool cancelTokenIsCurrentBound(void)
+{
+    return (g_cancelTokenCurrent != NULL);
+}
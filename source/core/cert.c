@@ -28,13 +28,29 @@
 #define CERT_BIS_SYSTEM_SAVEFILE_PATH   "/save/80000000000000e0"
 #define CERT_SAVEFILE_STORAGE_BASE_PATH "/certificate/"
 
+#define CERT_SAVEFILE_IDLE_TIMEOUT      30  /* Seconds. The cached ES certificate savefile is reopened after staying idle for this long. */
+
+#define CERT_CHAIN_CACHE_MAX_ENTRIES    8   /* Only a handful of distinct signature issuers are ever used. */
+
 #define CERT_TYPE(sig)                  (pub_key_type == CertPubKeyType_Rsa4096 ? CertType_Sig##sig##_PubKeyRsa4096 : \
                                         (pub_key_type == CertPubKeyType_Rsa2048 ? CertType_Sig##sig##_PubKeyRsa2048 : CertType_Sig##sig##_PubKeyEcc480))
 
+/* Type definitions. */
+
+/// Used to cache certificate chains retrieved from the ES certificate system savefile.
+typedef struct {
+    char issuer[0x40];
+    CertificateChain chain;
+} CertChainCacheEntry;
+
 /* Global variables. */
 
 static Mutex g_esCertSaveMutex = 0;
 static save_ctx_t *g_esCertSaveCtx = NULL;
+static u64 g_esCertSaveLastAccessTick = 0;
+
+static CertChainCacheEntry g_certChainCache[CERT_CHAIN_CACHE_MAX_ENTRIES] = {0};
+static u32 g_certChainCacheCount = 0, g_certChainCacheNextIdx = 0;
 
 /* Function prototypes. */
 
@@ -49,6 +65,10 @@ static u32 certGetCertificateCountInSignatureIssuer(const char *issuer);
 
 static void certCopyCertificateChainDataToMemoryBuffer(void *dst, const CertificateChain *chain);
 
+static CertificateChain *certGetCachedCertificateChain(const char *issuer);
+static bool certDuplicateCertificateChain(CertificateChain *dst, const CertificateChain *src);
+static void certFreeCertificateChainCache(void);
+
 bool certRetrieveCertificateByName(Certificate *dst, const char *name)
 {
     if (!dst || !name || !*name)
@@ -63,7 +83,9 @@ bool certRetrieveCertificateByName(Certificate *dst, const char *name)
     {
         if (!certOpenEsCertSaveFile()) break;
         ret = _certRetrieveCertificateByName(dst, name);
-        certCloseEsCertSaveFile();
+
+        /* Close the cached savefile if something went wrong. It'll be reopened on the next call. */
+        if (!ret) certCloseEsCertSaveFile();
     }
 
     return ret;
@@ -77,13 +99,16 @@ bool certRetrieveCertificateChainBySignatureIssuer(CertificateChain *dst, const
         return false;
     }
 
+    CertificateChain *chain = NULL;
     bool ret = false;
 
     SCOPED_LOCK(&g_esCertSaveMutex)
     {
-        if (!certOpenEsCertSaveFile()) break;
-        ret = _certRetrieveCertificateChainBySignatureIssuer(dst, issuer);
-        certCloseEsCertSaveFile();
+        /* Get cached certificate chain. */
+        if (!(chain = certGetCachedCertificateChain(issuer))) break;
+
+        /* Duplicate certificate chain. */
+        ret = certDuplicateCertificateChain(dst, chain);
     }
 
     return ret;
@@ -97,32 +122,32 @@ u8 *certGenerateRawCertificateChainBySignatureIssuer(const char *issuer, u64 *ou
         return NULL;
     }
 
-    CertificateChain chain = {0};
+    CertificateChain *chain = NULL;
     u8 *raw_chain = NULL;
 
-    /* Get full certificate chain using the provided issuer. */
-    if (!certRetrieveCertificateChainBySignatureIssuer(&chain, issuer))
-    {
-        LOG_MSG_ERROR("Error retrieving certificate chain for \"%s\"!", issuer);
-        goto end;
-    }
-
-    /* Allocate memory for the raw certificate chain. */
-    raw_chain = malloc(chain.size);
-    if (!raw_chain)
+    SCOPED_LOCK(&g_esCertSaveMutex)
     {
-        LOG_MSG_ERROR("Unable to allocate memory for raw \"%s\" certificate chain! (0x%lX).", issuer, chain.size);
-        goto end;
-    }
+        /* Get full certificate chain using the provided issuer. */
+        if (!(chain = certGetCachedCertificateChain(issuer)))
+        {
+            LOG_MSG_ERROR("Error retrieving certificate chain for \"%s\"!", issuer);
+            break;
+        }
 
-    /* Copy all certificates to the allocated buffer. */
-    certCopyCertificateChainDataToMemoryBuffer(raw_chain, &chain);
+        /* Allocate memory for the raw certificate chain. */
+        raw_chain = malloc(chain->size);
+        if (!raw_chain)
+        {
+            LOG_MSG_ERROR("Unable to allocate memory for raw \"%s\" certificate chain! (0x%lX).", issuer, chain->size);
+            break;
+        }
 
-    /* Update output size. */
-    *out_size = chain.size;
+        /* Copy all certificates to the allocated buffer. */
+        certCopyCertificateChainDataToMemoryBuffer(raw_chain, chain);
 
-end:
-    certFreeCertificateChain(&chain);
+        /* Update output size. */
+        *out_size = chain->size;
+    }
 
     return raw_chain;
 }
@@ -187,14 +212,34 @@ end:
     return raw_chain;
 }
 
-static bool certOpenEsCertSaveFile(void)
+void certCloseCachedSaveFile(void)
 {
-    if (g_esCertSaveCtx) return true;
+    SCOPED_LOCK(&g_esCertSaveMutex)
+    {
+        certCloseEsCertSaveFile();
+        certFreeCertificateChainCache();
+    }
+}
 
+static bool certOpenEsCertSaveFile(void)
+{
     const char *mount_name = NULL;
     char savefile_path[64] = {0};
+    u64 cur_tick = armGetSystemTick();
     bool success = false;
 
+    /* Reuse the cached savefile context, unless it has been idle for too long. */
+    if (g_esCertSaveCtx)
+    {
+        if (armTicksToNs(cur_tick - g_esCertSaveLastAccessTick) < (CERT_SAVEFILE_IDLE_TIMEOUT * 1000000000UL))
+        {
+            g_esCertSaveLastAccessTick = cur_tick;
+            return true;
+        }
+
+        certCloseEsCertSaveFile();
+    }
+
     /* Retrieve mount name for the eMMC BIS System partition. */
     if (!(mount_name = bisStorageGetMountNameByBisPartitionId(FsBisPartitionId_System)))
     {
@@ -206,13 +251,16 @@ static bool certOpenEsCertSaveFile(void)
     snprintf(savefile_path, sizeof(savefile_path), "%s:%s", mount_name, CERT_BIS_SYSTEM_SAVEFILE_PATH);
 
     /* Initialize savefile context. */
-    g_esCertSaveCtx = save_open_savefile(savefile_path, 0);
+    g_esCertSaveCtx = save_open_savefile(savefile_path, ACTION_LAZY);
     if (!g_esCertSaveCtx)
     {
         LOG_MSG_ERROR("Failed to open ES certificate system savefile!");
         goto end;
     }
 
+    /* Update last access tick. */
+    g_esCertSaveLastAccessTick = cur_tick;
+
     /* Update flag. */
     success = true;
 
@@ -225,6 +273,7 @@ static void certCloseEsCertSaveFile(void)
     if (!g_esCertSaveCtx) return;
 
     save_close_savefile(&g_esCertSaveCtx);
+    g_esCertSaveLastAccessTick = 0;
 }
 
 static bool _certRetrieveCertificateByName(Certificate *dst, const char *name)
@@ -420,3 +469,71 @@ static void certCopyCertificateChainDataToMemoryBuffer(void *dst, const Certific
         dst_u8 += cert->size;
     }
 }
+
+static CertificateChain *certGetCachedCertificateChain(const char *issuer)
+{
+    if (!issuer || strncmp(issuer, "Root-", 5) != 0)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    CertChainCacheEntry *entry = NULL;
+    CertificateChain chain = {0};
+
+    /* Look for a cached certificate chain with a matching signature issuer. */
+    for(u32 i = 0; i < g_certChainCacheCount; i++)
+    {
+        if (!strncmp(g_certChainCache[i].issuer, issuer, sizeof(g_certChainCache[i].issuer))) return &(g_certChainCache[i].chain);
+    }
+
+    /* Retrieve the certificate chain from the ES certificate system savefile. */
+    if (!certOpenEsCertSaveFile()) return NULL;
+
+    if (!_certRetrieveCertificateChainBySignatureIssuer(&chain, issuer))
+    {
+        /* Close the cached savefile. It'll be reopened on the next call. */
+        certCloseEsCertSaveFile();
+        return NULL;
+    }
+
+    /* Store the certificate chain. The oldest cache entry is replaced if the cache is full. */
+    entry = &(g_certChainCache[g_certChainCacheNextIdx]);
+    certFreeCertificateChain(&(entry->chain));
+
+    snprintf(entry->issuer, sizeof(entry->issuer), "%s", issuer);
+    memcpy(&(entry->chain), &chain, sizeof(CertificateChain));
+
+    if (g_certChainCacheCount < CERT_CHAIN_CACHE_MAX_ENTRIES) g_certChainCacheCount++;
+    g_certChainCacheNextIdx = ((g_certChainCacheNextIdx + 1) % CERT_CHAIN_CACHE_MAX_ENTRIES);
+
+    return &(entry->chain);
+}
+
+static bool certDuplicateCertificateChain(CertificateChain *dst, const CertificateChain *src)
+{
+    /* Free output context beforehand. */
+    certFreeCertificateChain(dst);
+
+    /* Allocate memory for all the certificates. */
+    dst->certs = calloc(src->count, sizeof(Certificate));
+    if (!dst->certs)
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for the certificate chain! (0x%lX).", src->count * sizeof(Certificate));
+        return false;
+    }
+
+    /* Copy certificate chain data. */
+    memcpy(dst->certs, src->certs, src->count * sizeof(Certificate));
+    dst->count = src->count;
+    dst->size = src->size;
+
+    return true;
+}
+
+static void certFreeCertificateChainCache(void)
+{
+    for(u32 i = 0; i < g_certChainCacheCount; i++) certFreeCertificateChain(&(g_certChainCache[i].chain));
+    memset(g_certChainCache, 0, sizeof(g_certChainCache));
+    g_certChainCacheCount = g_certChainCacheNextIdx = 0;
+}
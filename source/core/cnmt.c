@@ -26,7 +26,9 @@
 /* Helper macros. */
 
 #define CNMT_MINIMUM_FILENAME_LENGTH    23  /* Content Meta Type + "_" + Title ID + ".cnmt". */
-#define CNMT_ADD_FMT_STR(fmt, ...)      utilsAppendFormattedStringToBuffer(&xml_buf, &xml_buf_size, fmt, ##__VA_ARGS__)
+#define CNMT_XML_BASE_SIZE_HINT         0x800
+#define CNMT_XML_CONTENT_SIZE_HINT      0x180
+#define CNMT_ADD_FMT_STR(fmt, ...)      stringBuilderAppendFormatted(&xml_sb, fmt, ##__VA_ARGS__)
 
 /* Global variables. */
 
@@ -65,7 +67,7 @@ bool cnmtInitializeContext(ContentMetaContext *out, NcaContext *nca_ctx)
     cnmtFreeContext(out);
 
     /* Initialize Partition FS context. */
-    if (!pfsInitializeContext(&(out->pfs_ctx), &(nca_ctx->fs_ctx[0])))
+    if (!pfsInitializeContext(&(out->pfs_ctx), ncaGetFsSectionContext(nca_ctx, 0)))
     {
         LOG_MSG_ERROR("Failed to initialize Partition FS context!");
         goto end;
@@ -417,8 +419,7 @@ bool cnmtGenerateAuthoringToolXml(ContentMetaContext *cnmt_ctx, NcaContext *nca_
     }
 
     u32 i, j;
-    char *xml_buf = NULL;
-    u64 xml_buf_size = 0;
+    StringBuilder xml_sb = {0};
     char digest_str[SHA256_HASH_STR_SIZE] = {0};
     u8 count = 0, content_meta_type = cnmt_ctx->packaged_header->content_meta_type;
     bool success = false, invalid_nca = false;
@@ -428,6 +429,9 @@ bool cnmtGenerateAuthoringToolXml(ContentMetaContext *cnmt_ctx, NcaContext *nca_
     cnmt_ctx->authoring_tool_xml = NULL;
     cnmt_ctx->authoring_tool_xml_size = 0;
 
+    /* Reserve enough space for the whole XML right away. */
+    if (!stringBuilderReserve(&xml_sb, CNMT_XML_BASE_SIZE_HINT + (nca_ctx_count * CNMT_XML_CONTENT_SIZE_HINT))) goto end;
+
     if (!CNMT_ADD_FMT_STR("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" \
                           "<ContentMeta>\n" \
                           "  <Type>%s</Type>\n" \
@@ -480,20 +484,20 @@ bool cnmtGenerateAuthoringToolXml(ContentMetaContext *cnmt_ctx, NcaContext *nca_
             goto end;
         }
 
-        if (!CNMT_ADD_FMT_STR("  <Content>\n" \
-                              "    <Type>%s</Type>\n" \
-                              "    <Id>%s</Id>\n" \
-                              "    <Size>%lu</Size>\n" \
-                              "    <Hash>%s</Hash>\n" \
-                              "    <KeyGeneration>%u</KeyGeneration>\n" \
-                              "    <IdOffset>%u</IdOffset>\n" \
-                              "  </Content>\n", \
-                              titleGetNcmContentTypeName(cur_nca_ctx->content_type), \
-                              cur_nca_ctx->content_id_str, \
-                              cur_nca_ctx->content_size, \
-                              cur_nca_ctx->hash_str, \
-                              cur_nca_ctx->key_generation, \
-                              cur_nca_ctx->id_offset)) goto end;
+        /* Build this element piece by piece to avoid going through printf for every single NCA. */
+        if (!stringBuilderAppend(&xml_sb, "  <Content>\n    <Type>") || \
+            !stringBuilderAppend(&xml_sb, titleGetNcmContentTypeName(cur_nca_ctx->content_type)) || \
+            !stringBuilderAppend(&xml_sb, "</Type>\n    <Id>") || \
+            !stringBuilderAppend(&xml_sb, cur_nca_ctx->content_id_str) || \
+            !stringBuilderAppend(&xml_sb, "</Id>\n    <Size>") || \
+            !stringBuilderAppendUnsigned(&xml_sb, cur_nca_ctx->content_size) || \
+            !stringBuilderAppend(&xml_sb, "</Size>\n    <Hash>") || \
+            !stringBuilderAppend(&xml_sb, cur_nca_ctx->hash_str) || \
+            !stringBuilderAppend(&xml_sb, "</Hash>\n    <KeyGeneration>") || \
+            !stringBuilderAppendUnsigned(&xml_sb, cur_nca_ctx->key_generation) || \
+            !stringBuilderAppend(&xml_sb, "</KeyGeneration>\n    <IdOffset>") || \
+            !stringBuilderAppendUnsigned(&xml_sb, cur_nca_ctx->id_offset) || \
+            !stringBuilderAppend(&xml_sb, "</IdOffset>\n  </Content>\n")) goto end;
     }
 
     utilsGenerateHexString(digest_str, sizeof(digest_str), cnmt_ctx->digest, CNMT_DIGEST_SIZE, false);
@@ -541,13 +545,12 @@ bool cnmtGenerateAuthoringToolXml(ContentMetaContext *cnmt_ctx, NcaContext *nca_
     if (!(success = CNMT_ADD_FMT_STR("</ContentMeta>"))) goto end;
 
     /* Update CNMT context. */
-    cnmt_ctx->authoring_tool_xml = xml_buf;
-    cnmt_ctx->authoring_tool_xml_size = strlen(xml_buf);
+    cnmt_ctx->authoring_tool_xml = stringBuilderDetach(&xml_sb, &(cnmt_ctx->authoring_tool_xml_size));
 
 end:
     if (!success)
     {
-        if (xml_buf) free(xml_buf);
+        stringBuilderFree(&xml_sb);
         LOG_MSG_ERROR("Failed to generate CNMT AuthoringTool XML!");
     }
 
@@ -37,12 +37,22 @@ if (!strcmp(key, #name)) { \
     continue; \
 }
 
+#define CONFIG_WRITE_DELAY      500000000UL     /* 500 ms. Config JSON writes are deferred until no settings have been changed for this long. */
+#define CONFIG_CACHE_COUNT      64              /* Enough to hold every setting available in the config JSON. */
+
 #define CONFIG_GETTER(functype, vartype, ...) \
 vartype configGet##functype(const char *path) { \
     vartype ret = (vartype)0; \
     SCOPED_LOCK(&g_configMutex) { \
-        if (!g_configInterfaceInit) break; \
+        if (!g_configInterfaceInit || !path) break; \
+        u32 hash = configGetPathHash(path); \
+        ConfigCacheEntry *entry = configGetCacheEntry(path, hash, ConfigValueType_##functype); \
+        if (entry) { \
+            ret = entry->value_##functype; \
+            break; \
+        } \
         ret = jsonGet##functype(g_configJson, path); \
+        if ((entry = configAddCacheEntry(path, hash, ConfigValueType_##functype))) entry->value_##functype = ret; \
     } \
     return ret; \
 }
@@ -50,11 +60,33 @@ vartype configGet##functype(const char *path) { \
 #define CONFIG_SETTER(functype, vartype, ...) \
 void configSet##functype(const char *path, vartype value) { \
     SCOPED_LOCK(&g_configMutex) { \
-        if (!g_configInterfaceInit) break; \
-        if (jsonSet##functype(g_configJson, path, value)) configWriteConfigJson(); \
+        if (!g_configInterfaceInit || !path) break; \
+        if (!jsonSet##functype(g_configJson, path, value)) break; \
+        u32 hash = configGetPathHash(path); \
+        ConfigCacheEntry *entry = configGetCacheEntry(path, hash, ConfigValueType_##functype); \
+        if (!entry) entry = configAddCacheEntry(path, hash, ConfigValueType_##functype); \
+        if (entry) entry->value_##functype = value; \
+        configMarkConfigJsonAsDirty(); \
     } \
 }
 
+/* Type definitions. */
+
+typedef enum {
+    ConfigValueType_Boolean = 0,
+    ConfigValueType_Integer = 1
+} ConfigValueType;
+
+typedef struct {
+    const char *path;   ///< Dynamically allocated copy of the setting path. NULL if this entry is unused.
+    u32 hash;           ///< Setting path hash. Saves us from comparing path strings for most entries.
+    u8 type;            ///< ConfigValueType.
+    union {
+        bool value_Boolean;
+        int value_Integer;
+    };
+} ConfigCacheEntry;
+
 /* Global variables. */
 
 static Mutex g_configMutex = 0;
@@ -63,6 +95,15 @@ static bool g_configInterfaceInit = false;
 static char g_configJsonPath[FS_MAX_PATH] = {0};
 static struct json_object *g_configJson = NULL;
 
+static ConfigCacheEntry g_configCache[CONFIG_CACHE_COUNT] = {0};
+
+static Thread g_configWriterThread = {0};
+static bool g_configWriterThreadCreated = false, g_configWriterThreadExit = false;
+static CondVar g_configWriterCondVar = 0;
+
+static bool g_configJsonDirty = false;
+static u64 g_configJsonDirtyTick = 0;
+
 /* Function prototypes. */
 
 static bool configParseConfigJson(void);
@@ -70,6 +111,15 @@ static bool configResetConfigJson(void);
 static void configWriteConfigJson(void);
 static void configFreeConfigJson(void);
 
+static void configMarkConfigJsonAsDirty(void);
+static void configWriterThreadFunc(void *arg);
+static bool configWriteConfigJsonString(const char *str);
+
+static u32 configGetPathHash(const char *path);
+static ConfigCacheEntry *configGetCacheEntry(const char *path, u32 hash, u8 type);
+static ConfigCacheEntry *configAddCacheEntry(const char *path, u32 hash, u8 type);
+static void configClearCache(void);
+
 static bool configValidateJsonRootObject(const struct json_object *obj);
 static bool configValidateJsonGameCardObject(const struct json_object *obj);
 static bool configValidateJsonNspObject(const struct json_object *obj);
@@ -92,6 +142,11 @@ bool configInitialize(void)
             break;
         }
 
+        /* Create background writer thread. Setter functions write the config JSON on their own if this fails. */
+        g_configWriterThreadExit = g_configJsonDirty = false;
+        g_configWriterThreadCreated = utilsCreateThreadWithPriority(&g_configWriterThread, configWriterThreadFunc, NULL, -2, 0x3F);
+        if (!g_configWriterThreadCreated) LOG_MSG_WARNING("Failed to create config writer thread! Settings will be written right away.");
+
         /* Update flags. */
         ret = g_configInterfaceInit = true;
     }
@@ -101,11 +156,29 @@ bool configInitialize(void)
 
 void configExit(void)
 {
+    /* Stop the background writer thread. This must be done without holding the config mutex. */
+    SCOPED_LOCK(&g_configMutex)
+    {
+        if (!g_configWriterThreadCreated) break;
+        g_configWriterThreadExit = true;
+        condvarWakeAll(&g_configWriterCondVar);
+    }
+
+    if (g_configWriterThreadCreated)
+    {
+        utilsJoinThread(&g_configWriterThread);
+        g_configWriterThreadCreated = false;
+    }
+
     SCOPED_LOCK(&g_configMutex)
     {
-        /* Free JSON object. */
-        /* We don't need to write it back to the SD card - setter functions do that on their own. */
+        /* Flush pending changes. */
+        if (g_configJsonDirty) configWriteConfigJson();
+        g_configJsonDirty = false;
+
+        /* Free JSON object and cached settings. */
         configFreeConfigJson();
+        configClearCache();
 
         /* Update flag. */
         g_configInterfaceInit = false;
@@ -114,7 +187,11 @@ void configExit(void)
 
 void configResetSettings(void)
 {
-    configResetConfigJson();
+    SCOPED_LOCK(&g_configMutex)
+    {
+        if (!g_configInterfaceInit) break;
+        configResetConfigJson();
+    }
 }
 
 CONFIG_GETTER(Boolean, bool);
@@ -171,14 +248,22 @@ static bool configResetConfigJson(void)
 
     LOG_MSG_INFO("Loading default configuration.");
 
-    /* Free config JSON. */
+    /* Free config JSON and cached settings. */
     configFreeConfigJson();
+    configClearCache();
 
     /* Read default config JSON. */
     g_configJson = json_object_from_file(DEFAULT_CONFIG_PATH);
     if (g_configJson)
     {
-        configWriteConfigJson();
+        /* Write it right away if the background writer thread isn't available yet (e.g. while initializing the interface). */
+        if (g_configWriterThreadCreated)
+        {
+            configMarkConfigJsonAsDirty();
+        } else {
+            configWriteConfigJson();
+        }
+
         ret = true;
     } else {
         jsonLogLastError();
@@ -200,9 +285,141 @@ static void configFreeConfigJson(void)
     g_configJson = NULL;
 }
 
+static void configMarkConfigJsonAsDirty(void)
+{
+    /* Must be called with the config mutex held. */
+    if (!g_configWriterThreadCreated)
+    {
+        configWriteConfigJson();
+        return;
+    }
+
+    /* Restart the write delay each time a setting is changed, which batches consecutive changes into a single write. */
+    g_configJsonDirty = true;
+    g_configJsonDirtyTick = armGetSystemTick();
+    condvarWakeAll(&g_configWriterCondVar);
+}
+
+static void configWriterThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    mutexLock(&g_configMutex);
+
+    while(!g_configWriterThreadExit)
+    {
+        /* Wait until a setting is changed. */
+        if (!g_configJsonDirty)
+        {
+            condvarWait(&g_configWriterCondVar, &g_configMutex);
+            continue;
+        }
+
+        /* Wait until no settings have been changed for a while. configExit() flushes pending changes on its own. */
+        u64 elapsed = armTicksToNs(armGetSystemTick() - g_configJsonDirtyTick);
+        if (elapsed < CONFIG_WRITE_DELAY)
+        {
+            condvarWaitTimeout(&g_configWriterCondVar, &g_configMutex, CONFIG_WRITE_DELAY - elapsed);
+            continue;
+        }
+
+        /* Serialize the config JSON while holding the mutex, then write it without holding it. */
+        const char *str = (g_configJson ? json_object_to_json_string_ext(g_configJson, JSON_C_TO_STRING_SPACED | JSON_C_TO_STRING_PRETTY) : NULL);
+        char *dup_str = (str ? strdup(str) : NULL);
+
+        /* Keep the dirty flag set if we couldn't duplicate the string. configExit() will take care of it. */
+        if (!str || dup_str) g_configJsonDirty = false;
+        if (!dup_str) continue;
+
+        mutexUnlock(&g_configMutex);
+        configWriteConfigJsonString(dup_str);
+        free(dup_str);
+        mutexLock(&g_configMutex);
+    }
+
+    mutexUnlock(&g_configMutex);
+
+    threadExit();
+}
+
+static bool configWriteConfigJsonString(const char *str)
+{
+    FILE *fp = NULL;
+    size_t len = strlen(str);
+    bool ret = false;
+
+    if (!(fp = fopen(g_configJsonPath, "wb")))
+    {
+        LOG_MSG_ERROR("Failed to open \"%s\" for writing! (%d).", g_configJsonPath, errno);
+        return false;
+    }
+
+    ret = (fwrite(str, 1, len, fp) == len);
+    if (!ret) LOG_MSG_ERROR("Failed to write 0x%lX bytes to \"%s\"! (%d).", len, g_configJsonPath, errno);
+
+    fclose(fp);
+
+    return ret;
+}
+
+static u32 configGetPathHash(const char *path)
+{
+    /* FNV-1a. */
+    u32 hash = 0x811C9DC5;
+
+    for(; *path; path++)
+    {
+        hash ^= (u8)*path;
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+static ConfigCacheEntry *configGetCacheEntry(const char *path, u32 hash, u8 type)
+{
+    for(u32 i = 0; i < CONFIG_CACHE_COUNT; i++)
+    {
+        ConfigCacheEntry *entry = &(g_configCache[i]);
+        if (!entry->path) break;
+        if (entry->hash == hash && entry->type == type && !strcmp(entry->path, path)) return entry;
+    }
+
+    return NULL;
+}
+
+static ConfigCacheEntry *configAddCacheEntry(const char *path, u32 hash, u8 type)
+{
+    for(u32 i = 0; i < CONFIG_CACHE_COUNT; i++)
+    {
+        ConfigCacheEntry *entry = &(g_configCache[i]);
+        if (entry->path) continue;
+
+        /* Don't cache anything if we can't duplicate the path string. */
+        if (!(entry->path = strdup(path))) break;
+
+        entry->hash = hash;
+        entry->type = type;
+
+        return entry;
+    }
+
+    return NULL;
+}
+
+static void configClearCache(void)
+{
+    for(u32 i = 0; i < CONFIG_CACHE_COUNT; i++)
+    {
+        if (g_configCache[i].path) free((void*)g_configCache[i].path);
+    }
+
+    memset(g_configCache, 0, sizeof(g_configCache));
+}
+
 static bool configValidateJsonRootObject(const struct json_object *obj)
 {
-    bool ret = false, overclock_found = false, naming_convention_found = false, output_storage_found = false, gamecard_found = false;
+    bool ret = false, overclock_found = false, adaptive_overclock_found = false, naming_convention_found = false, output_storage_found = false, usb_compression_found = false, usb_delta_transfer_found = false, gamecard_found = false;
     bool nsp_found = false, ticket_found = false, nca_fs_found = false;
 
     if (!jsonValidateObject(obj)) goto end;
@@ -210,8 +427,11 @@ static bool configValidateJsonRootObject(const struct json_object *obj)
     json_object_object_foreach(obj, key, val)
     {
         CONFIG_VALIDATE_FIELD(Boolean, overclock);
+        CONFIG_VALIDATE_FIELD(Boolean, adaptive_overclock);
         CONFIG_VALIDATE_FIELD(Integer, naming_convention, TitleNamingConvention_Full, TitleNamingConvention_Count - 1);
         CONFIG_VALIDATE_FIELD(Integer, output_storage, ConfigOutputStorage_SdCard, ConfigOutputStorage_Count - 1);
+        CONFIG_VALIDATE_FIELD(Boolean, usb_compression);
+        CONFIG_VALIDATE_FIELD(Boolean, usb_delta_transfer);
         CONFIG_VALIDATE_OBJECT(GameCard, gamecard);
         CONFIG_VALIDATE_OBJECT(Nsp, nsp);
         CONFIG_VALIDATE_OBJECT(Ticket, ticket);
@@ -219,7 +439,7 @@ static bool configValidateJsonRootObject(const struct json_object *obj)
         goto end;
     }
 
-    ret = (overclock_found && naming_convention_found && output_storage_found && gamecard_found && nsp_found && ticket_found && nca_fs_found);
+    ret = (overclock_found && adaptive_overclock_found && naming_convention_found && output_storage_found && usb_compression_found && usb_delta_transfer_found && gamecard_found && nsp_found && ticket_found && nca_fs_found);
 
 end:
     return ret;
@@ -227,8 +447,8 @@ end:
 
 static bool configValidateJsonGameCardObject(const struct json_object *obj)
 {
-    bool ret = false, prepend_key_area_found = false, keep_certificate_found = false, trim_dump_found = false, calculate_checksum_found = false;
-    bool lookup_checksum_found = false, write_raw_hfs_partition_found = false;
+    bool ret = false, prepend_key_area_found = false, keep_certificate_found = false, trim_dump_found = false, skip_padding_found = false;
+    bool calculate_checksum_found = false, lookup_checksum_found = false, write_raw_hfs_partition_found = false, compress_output_found = false, verify_hfs_hashes_found = false;
 
     if (!jsonValidateObject(obj)) goto end;
 
@@ -237,13 +457,17 @@ static bool configValidateJsonGameCardObject(const struct json_object *obj)
         CONFIG_VALIDATE_FIELD(Boolean, prepend_key_area);
         CONFIG_VALIDATE_FIELD(Boolean, keep_certificate);
         CONFIG_VALIDATE_FIELD(Boolean, trim_dump);
+        CONFIG_VALIDATE_FIELD(Boolean, skip_padding);
         CONFIG_VALIDATE_FIELD(Boolean, calculate_checksum);
         CONFIG_VALIDATE_FIELD(Boolean, lookup_checksum);
         CONFIG_VALIDATE_FIELD(Boolean, write_raw_hfs_partition);
+        CONFIG_VALIDATE_FIELD(Boolean, compress_output);
+        CONFIG_VALIDATE_FIELD(Boolean, verify_hfs_hashes);
         goto end;
     }
 
-    ret = (prepend_key_area_found && keep_certificate_found && trim_dump_found && calculate_checksum_found && lookup_checksum_found && write_raw_hfs_partition_found);
+    ret = (prepend_key_area_found && keep_certificate_found && trim_dump_found && skip_padding_found && calculate_checksum_found && lookup_checksum_found && write_raw_hfs_partition_found && \
+           compress_output_found && verify_hfs_hashes_found);
 
 end:
     return ret;
@@ -253,7 +477,7 @@ static bool configValidateJsonNspObject(const struct json_object *obj)
 {
     bool ret = false, set_download_distribution_found = false, remove_console_data_found = false, remove_titlekey_crypto_found = false;
     bool disable_linked_account_requirement_found = false, enable_screenshots_found = false, enable_video_capture_found = false, disable_hdcp_found = false;
-    bool generate_authoringtool_data_found = false, lookup_checksum_found = false;
+    bool generate_authoringtool_data_found = false, lookup_checksum_found = false, offload_hash_verification_found = false;
 
     if (!jsonValidateObject(obj)) goto end;
 
@@ -268,11 +492,13 @@ static bool configValidateJsonNspObject(const struct json_object *obj)
         CONFIG_VALIDATE_FIELD(Boolean, disable_hdcp);
         CONFIG_VALIDATE_FIELD(Boolean, lookup_checksum);
         CONFIG_VALIDATE_FIELD(Boolean, generate_authoringtool_data);
+        CONFIG_VALIDATE_FIELD(Boolean, offload_hash_verification);
         goto end;
     }
 
     ret = (set_download_distribution_found && remove_console_data_found && remove_titlekey_crypto_found && disable_linked_account_requirement_found && \
-           enable_screenshots_found && enable_video_capture_found && disable_hdcp_found && generate_authoringtool_data_found && lookup_checksum_found);
+           enable_screenshots_found && enable_video_capture_found && disable_hdcp_found && generate_authoringtool_data_found && lookup_checksum_found && \
+           offload_hash_verification_found);
 
 end:
     return ret;
@@ -298,7 +524,7 @@ end:
 
 static bool configValidateJsonNcaFsObject(const struct json_object *obj)
 {
-    bool ret = false, write_raw_section_found = false, use_layeredfs_dir_found = false;
+    bool ret = false, write_raw_section_found = false, use_layeredfs_dir_found = false, only_updated_files_found = false, verify_raw_section_found = false;
 
     if (!jsonValidateObject(obj)) goto end;
 
@@ -306,10 +532,12 @@ static bool configValidateJsonNcaFsObject(const struct json_object *obj)
     {
         CONFIG_VALIDATE_FIELD(Boolean, write_raw_section);
         CONFIG_VALIDATE_FIELD(Boolean, use_layeredfs_dir);
+        CONFIG_VALIDATE_FIELD(Boolean, only_updated_files);
+        CONFIG_VALIDATE_FIELD(Boolean, verify_raw_section);
         goto end;
     }
 
-    ret = (write_raw_section_found && use_layeredfs_dir_found);
+    ret = (write_raw_section_found && use_layeredfs_dir_found && only_updated_files_found && verify_raw_section_found);
 
 end:
     return ret;
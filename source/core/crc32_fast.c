@@ -0,0 +1,138 @@
+/*
+ * crc32_fast.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <core/nxdt_utils.h>
+#include <arm_acle.h>
+
+#define CRC32_FAST_LANE_COUNT   3                                   /* CRC32X has a 3-cycle latency and a 1-cycle throughput on Cortex-A57. */
+#define CRC32_FAST_LANE_SIZE    0x2000
+#define CRC32_FAST_BLOCK_SIZE   (CRC32_FAST_LANE_SIZE * CRC32_FAST_LANE_COUNT)
+#define CRC32_FAST_LANE_SHIFT   0x83852D0F                          /* x^(8 * CRC32_FAST_LANE_SIZE) modulo the reflected CRC32 polynomial. */
+
+/* Function prototypes. */
+
+static u32 crc32FastUpdate(u32 crc, const u8 *src, size_t size);
+static u32 crc32FastUpdateLinear(u32 crc, const u8 *src, size_t size);
+
+static u32 crc32MultiplyModulo(u32 a, u32 b);
+
+u32 crc32FastCalculate(const void *src, size_t size)
+{
+    return crc32FastCalculateWithSeed(0, src, size);
+}
+
+u32 crc32FastCalculateWithSeed(u32 seed, const void *src, size_t size)
+{
+    if (!src || !size) return seed;
+    statsAddCounter(StatsCounterType_Crc32, size);
+    return ~crc32FastUpdate(~seed, (const u8*)src, size);
+}
+
+u32 crc32Combine(u32 crc1, u32 crc2, u64 len2)
+{
+    /* Reference: https://github.com/madler/zlib/blob/develop/crc32.c (crc32_combine64). */
+    /* Calculate x^(8 * len2) modulo the CRC32 polynomial using repeated squaring, then multiply crc1 by it. */
+    u32 p = BIT(31);    /* x^0. */
+    u32 sq = BIT(23);   /* x^8 (one byte). */
+
+    while(len2)
+    {
+        if (len2 & 1) p = crc32MultiplyModulo(sq, p);
+        len2 >>= 1;
+        if (len2) sq = crc32MultiplyModulo(sq, sq);
+    }
+
+    return (crc32MultiplyModulo(p, crc1) ^ crc2);
+}
+
+static u32 crc32FastUpdate(u32 crc, const u8 *src, size_t size)
+{
+    /* Process unaligned leading bytes, if needed. */
+    size_t head_size = MIN(ALIGN_UP((uintptr_t)src, sizeof(u64)) - (uintptr_t)src, size);
+    if (head_size)
+    {
+        crc = crc32FastUpdateLinear(crc, src, head_size);
+        src += head_size;
+        size -= head_size;
+    }
+
+    /* Process full blocks using three interleaved lanes. Since the CRC32 register is linear, the second and third lanes start from zero, */
+    /* and each lane is then shifted over the data that follows it by multiplying it with a precalculated x^(8 * CRC32_FAST_LANE_SIZE) constant. */
+    while(size >= CRC32_FAST_BLOCK_SIZE)
+    {
+        const u64 *lane0 = (const u64*)src;
+        const u64 *lane1 = (const u64*)(src + CRC32_FAST_LANE_SIZE);
+        const u64 *lane2 = (const u64*)(src + (CRC32_FAST_LANE_SIZE * 2));
+        u32 crc0 = crc, crc1 = 0, crc2 = 0;
+
+        #pragma GCC unroll 4
+        for(size_t i = 0; i < (CRC32_FAST_LANE_SIZE / sizeof(u64)); i++)
+        {
+            crc0 = __crc32d(crc0, lane0[i]);
+            crc1 = __crc32d(crc1, lane1[i]);
+            crc2 = __crc32d(crc2, lane2[i]);
+        }
+
+        crc = (crc32MultiplyModulo(CRC32_FAST_LANE_SHIFT, crc32MultiplyModulo(CRC32_FAST_LANE_SHIFT, crc0) ^ crc1) ^ crc2);
+
+        src += CRC32_FAST_BLOCK_SIZE;
+        size -= CRC32_FAST_BLOCK_SIZE;
+    }
+
+    /* Process remaining data. */
+    if (size) crc = crc32FastUpdateLinear(crc, src, size);
+
+    return crc;
+}
+
+static u32 crc32FastUpdateLinear(u32 crc, const u8 *src, size_t size)
+{
+    for(; size >= sizeof(u64); src += sizeof(u64), size -= sizeof(u64))
+    {
+        u64 val = 0;
+        memcpy(&val, src, sizeof(u64));
+        crc = __crc32d(crc, val);
+    }
+
+    for(; size; src++, size--) crc = __crc32b(crc, *src);
+
+    return crc;
+}
+
+static u32 crc32MultiplyModulo(u32 a, u32 b)
+{
+    /* Multiplies two polynomials modulo the reflected CRC32 polynomial. */
+    u32 m = BIT(31), p = 0;
+
+    while(true)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if (!(a & (m - 1))) break;
+        }
+
+        m >>= 1;
+        b = ((b & 1) ? ((b >> 1) ^ 0xEDB88320) : (b >> 1));
+    }
+
+    return p;
+}
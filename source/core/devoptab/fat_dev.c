@@ -31,6 +31,8 @@
 #define FAT_DEV_INIT_DIR_VARS   DEVOPTAB_INIT_DIR_VARS(FDIR)
 #define FAT_DEV_INIT_FS_ACCESS  DEVOPTAB_DECL_FS_CTX(FATFS)
 
+#define FAT_DEV_CLMT_INIT_SIZE  32  /* Initial cluster link map table size, in DWORDs. Enough for 15 fragments. */
+
 /* Function prototypes. */
 
 static int       fatdev_open(struct _reent *r, void *fd, const char *path, int flags, int mode);
@@ -48,6 +50,9 @@ static const char *fatdev_get_fixed_path(struct _reent *r, const char *path, FAT
 
 static void fatdev_fill_stat(struct stat *st, const FILINFO *info);
 
+static void fatdev_create_cluster_map(FIL *file);
+static void fatdev_free_cluster_map(FIL *file);
+
 static int fatdev_translate_error(FRESULT res);
 
 /* Global variables. */
@@ -117,7 +122,10 @@ static int fatdev_open(struct _reent *r, void *fd, const char *path, int flags,
 
     /* Open file. */
     res = f_open(file, path, fatdev_flags);
-    if (res != FR_OK) DEVOPTAB_SET_ERROR(fatdev_translate_error(res));
+    if (res != FR_OK) DEVOPTAB_SET_ERROR_AND_EXIT(fatdev_translate_error(res));
+
+    /* Enable fast seek mode. Errors are non-fatal: the file can still be accessed by following its cluster chain. */
+    fatdev_create_cluster_map(file);
 
 end:
     DEVOPTAB_DEINIT_VARS;
@@ -137,6 +145,10 @@ static int fatdev_close(struct _reent *r, void *fd)
 
     /* Close file. */
     res = f_close(file);
+
+    /* Free cluster link map table. */
+    fatdev_free_cluster_map(file);
+
     if (res != FR_OK) DEVOPTAB_SET_ERROR_AND_EXIT(fatdev_translate_error(res));
 
     /* Reset file descriptor. */
@@ -529,3 +541,51 @@ static int fatdev_translate_error(FRESULT res)
 
     return ret;
 }
+
+static void fatdev_create_cluster_map(FIL *file)
+{
+    FSIZE_t cluster_size = ((FSIZE_t)file->obj.fs->csize * FF_MAX_SS);
+    DWORD clmt_size = FAT_DEV_CLMT_INIT_SIZE;
+    FRESULT res = FR_OK;
+
+    /* Don't bother with files that fit within a single cluster. */
+    if (f_size(file) <= cluster_size) return;
+
+    while(true)
+    {
+        /* (Re)allocate cluster link map table. Its first item holds its size. */
+        DWORD *cltbl = realloc(file->cltbl, clmt_size * sizeof(DWORD));
+        if (!cltbl)
+        {
+            LOG_MSG_ERROR("Failed to allocate 0x%lX-byte long cluster link map table!", clmt_size * sizeof(DWORD));
+            break;
+        }
+
+        cltbl[0] = clmt_size;
+        file->cltbl = cltbl;
+
+        /* Build cluster link map table. If it's too small, FatFs stores the required size in its first item. */
+        res = f_lseek(file, CREATE_LINKMAP);
+        if (res == FR_OK) return;
+
+        if (res != FR_NOT_ENOUGH_CORE || file->cltbl[0] <= clmt_size)
+        {
+            LOG_MSG_ERROR("Failed to create cluster link map table! (%u).", res);
+            break;
+        }
+
+        clmt_size = file->cltbl[0];
+    }
+
+    /* Disable fast seek mode. */
+    fatdev_free_cluster_map(file);
+}
+
+static void fatdev_free_cluster_map(FIL *file)
+{
+    if (file->cltbl)
+    {
+        free(file->cltbl);
+        file->cltbl = NULL;
+    }
+}
@@ -48,33 +48,20 @@ DRESULT disk_read (
     UINT count		/* Number of sectors to read */
 )
 {
-    FsStorage *bis_storage = NULL;
     u64 offset = 0, size = 0;
-    Result rc = 0;
     DRESULT ret = RES_PARERR;
 
-    bisStorageControlMutex(true);
-
-    /* Get pointer to FsStorage object. */
-    bis_storage = bisStorageGetFsStorageByFatFsDriveNumber(pdrv);
-    if (!bis_storage)
-    {
-        LOG_MSG_ERROR("Failed to retrieve FsStorage object for drive number %u!", pdrv);
-        goto end;
-    }
+    if (!buff || !count) goto end;
 
     /* Calculate data offset and size. */
     offset = ((u64)FF_MAX_SS * (u64)sector);
     size = ((u64)FF_MAX_SS * (u64)count);
 
     /* Read BIS storage. */
-    rc = fsStorageRead(bis_storage, (s64)offset, buff, size);
-    ret = (R_SUCCEEDED(rc) ? RES_OK : RES_ERROR);
-    if (ret == RES_ERROR) LOG_MSG_ERROR("Failed to read 0x%lX-byte long block at offset 0x%lX from drive number %u!", offset, size, pdrv);
+    ret = (bisStorageReadFatFsDrive(pdrv, buff, offset, size) ? RES_OK : RES_ERROR);
+    if (ret == RES_ERROR) LOG_MSG_ERROR("Failed to read 0x%lX-byte long block at offset 0x%lX from drive number %u!", size, offset, pdrv);
 
 end:
-    bisStorageControlMutex(false);
-
     return ret;
 }
 
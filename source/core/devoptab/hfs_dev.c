@@ -38,6 +38,7 @@ typedef struct {
     HashFileSystemEntry *hfs_entry; ///< Hash FS entry metadata.
     const char *name;               ///< Entry name.
     u64 offset;                     ///< Current offset within Hash FS entry data.
+    DevoptabReadAheadBuffer ra_buf; ///< Read-ahead buffer.
 } HashFileSystemFileState;
 
 typedef struct {
@@ -63,6 +64,8 @@ static const char *hfsdev_get_truncated_path(struct _reent *r, const char *path)
 
 static void hfsdev_fill_stat(struct stat *st, u32 index, const HashFileSystemEntry *hfs_entry, time_t mount_time);
 
+static bool hfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
+
 /* Global variables. */
 
 static const devoptab_t hfsdev_devoptab = {
@@ -141,6 +144,9 @@ static int hfsdev_close(struct _reent *r, void *fd)
 
     //LOG_MSG_DEBUG("Closing \"%s:/%s\".", dev_ctx->name, file->name);
 
+    /* Free read-ahead buffer. */
+    devoptabFreeReadAheadBuffer(&(file->ra_buf));
+
     /* Reset file descriptor. */
     memset(file, 0, sizeof(HashFileSystemFileState));
 
@@ -159,8 +165,17 @@ static ssize_t hfsdev_read(struct _reent *r, void *fd, char *ptr, size_t len)
 
     //LOG_MSG_DEBUG("Reading 0x%lX byte(s) at offset 0x%lX from \"%s:/%s\".", len, file->offset, dev_ctx->name, file->name);
 
+    /* Clamp read size to the remaining entry data. */
+    if (file->offset >= file->hfs_entry->size)
+    {
+        len = 0;
+        DEVOPTAB_EXIT;
+    }
+
+    len = MIN(len, file->hfs_entry->size - file->offset);
+
     /* Read file data. */
-    if (!hfsReadEntryData(fs_ctx, file->hfs_entry, ptr, len, file->offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
+    if (!devoptabReadEntryData(&(file->ra_buf), hfsdev_read_entry_data, fs_ctx, file->hfs_entry, file->hfs_entry->size, ptr, len, file->offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
 
     /* Adjust offset. */
     file->offset += len;
@@ -461,3 +476,8 @@ static void hfsdev_fill_stat(struct stat *st, u32 index, const HashFileSystemEnt
     st->st_size = (off_t)hfs_entry->size;
     st->st_atime = st->st_mtime = st->st_ctime = mount_time;
 }
+
+static bool hfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset)
+{
+    return hfsReadEntryData((HashFileSystemContext*)fs_ctx, (HashFileSystemEntry*)fs_entry, out, read_size, offset);
+}
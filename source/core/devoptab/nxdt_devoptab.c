@@ -49,6 +49,7 @@ const devoptab_t *fatdev_get_devoptab();
 static bool devoptabMountDevice(void *fs_ctx, const char *name, u8 type);
 static DevoptabDeviceContext *devoptabFindDevice(const char *name);
 static void devoptabResetDevice(DevoptabDeviceContext *dev_ctx);
+static void devoptabClearDevice(DevoptabDeviceContext *dev_ctx);
 
 bool devoptabMountPartitionFileSystemDevice(PartitionFileSystemContext *pfs_ctx, const char *name)
 {
@@ -82,7 +83,8 @@ bool devoptabMountHashFileSystemDevice(HashFileSystemContext *hfs_ctx, const cha
 
 bool devoptabMountRomFileSystemDevice(RomFileSystemContext *romfs_ctx, const char *name)
 {
-    if (!romfsIsValidContext(romfs_ctx) || !name || !*name)
+    /* Paged RomFS contexts can't be mounted: devoptab operations keep entry pointers around for as long as a file or directory is open. */
+    if (!romfsIsValidContext(romfs_ctx) || romfs_ctx->is_paged || !name || !*name)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -90,6 +92,9 @@ bool devoptabMountRomFileSystemDevice(RomFileSystemContext *romfs_ctx, const cha
 
     bool ret = false;
 
+    /* Build the RomFS path index, since we can expect lots of path lookups to take place. Not a fatal error if this fails. */
+    if (!romfsBuildPathIndex(romfs_ctx)) LOG_MSG_WARNING("Failed to build RomFS path index! Path lookups will walk the entry tree.");
+
     SCOPED_LOCK(&g_devoptabMutex) ret = devoptabMountDevice(romfs_ctx, name, DevoptabDeviceType_RomFileSystem);
 
     return ret;
@@ -141,20 +146,95 @@ void devoptabUnmountAllDevices(void)
     }
 }
 
-void devoptabControlMutex(bool lock)
+void devoptabControlDeviceMutex(DevoptabDeviceContext *dev_ctx, bool lock)
 {
-    bool locked = mutexIsLockedByCurrentThread(&g_devoptabMutex);
+    if (!dev_ctx) return;
+
+    bool locked = mutexIsLockedByCurrentThread(&(dev_ctx->mutex));
 
     if (!locked && lock)
     {
-        mutexLock(&g_devoptabMutex);
+        mutexLock(&(dev_ctx->mutex));
     } else
     if (locked && !lock)
     {
-        mutexUnlock(&g_devoptabMutex);
+        mutexUnlock(&(dev_ctx->mutex));
     }
 }
 
+bool devoptabReadEntryData(DevoptabReadAheadBuffer *ra_buf, DevoptabReadEntryDataFunction read_func, void *fs_ctx, void *fs_entry, u64 entry_size, void *out, u64 read_size, u64 offset)
+{
+    if (!ra_buf || !read_func || !fs_ctx || !fs_entry || !out || !read_size || offset >= entry_size || read_size > (entry_size - offset))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u8 *out_u8 = (u8*)out;
+    bool sequential = (offset == ra_buf->next_offset);
+    u64 fill_size = 0;
+
+    ra_buf->next_offset = (offset + read_size);
+
+    /* Copy buffered data, if available. */
+    if (ra_buf->size && offset >= ra_buf->offset && offset < (ra_buf->offset + ra_buf->size))
+    {
+        u64 buf_data_offset = (offset - ra_buf->offset);
+        u64 copy_size = MIN(read_size, ra_buf->size - buf_data_offset);
+
+        memcpy(out_u8, ra_buf->data + buf_data_offset, copy_size);
+
+        out_u8 += copy_size;
+        offset += copy_size;
+        read_size -= copy_size;
+
+        if (!read_size) return true;
+
+        /* Whatever is left starts right where the buffered data ends. */
+        sequential = true;
+    }
+
+    /* Update read-ahead window size. */
+    ra_buf->window_size = ((sequential && ra_buf->window_size) ? MIN(ra_buf->window_size * 2, DEVOPTAB_READ_AHEAD_MAX_SIZE) : DEVOPTAB_READ_AHEAD_MIN_SIZE);
+
+    /* Read data straight into the output buffer if it doesn't fit within the read-ahead window. */
+    if (read_size >= ra_buf->window_size) return read_func(fs_ctx, fs_entry, out_u8, read_size, offset);
+
+    /* Grow read-ahead buffer, if needed. We'll just read data directly if this fails. */
+    fill_size = MIN(ra_buf->window_size, entry_size - offset);
+    if (ra_buf->capacity < fill_size)
+    {
+        u8 *data = realloc(ra_buf->data, fill_size);
+        if (!data)
+        {
+            LOG_MSG_ERROR("Failed to resize read-ahead buffer to 0x%lX bytes!", fill_size);
+            return read_func(fs_ctx, fs_entry, out_u8, read_size, offset);
+        }
+
+        ra_buf->data = data;
+        ra_buf->capacity = fill_size;
+    }
+
+    /* Refill read-ahead buffer. */
+    ra_buf->size = 0;
+    if (!read_func(fs_ctx, fs_entry, ra_buf->data, fill_size, offset)) return false;
+
+    ra_buf->offset = offset;
+    ra_buf->size = fill_size;
+
+    /* Copy the rest of the requested data. */
+    memcpy(out_u8, ra_buf->data, read_size);
+
+    return true;
+}
+
+void devoptabFreeReadAheadBuffer(DevoptabReadAheadBuffer *ra_buf)
+{
+    if (!ra_buf) return;
+    if (ra_buf->data) free(ra_buf->data);
+    memset(ra_buf, 0, sizeof(DevoptabReadAheadBuffer));
+}
+
 static bool devoptabMountDevice(void *fs_ctx, const char *name, u8 type)
 {
     if (!fs_ctx || !name || !*name || type >= DevoptabDeviceType_Count)
@@ -199,6 +279,9 @@ static bool devoptabMountDevice(void *fs_ctx, const char *name, u8 type)
         return false;
     }
 
+    /* Lock device mutex. Stale devoptab calls for a previously unmounted device may still be waiting on it. */
+    mutexLock(&(dev_ctx->mutex));
+
     /* Populate device entry. */
     snprintf(dev_ctx->name, MAX_ELEMENTS(dev_ctx->name), "%s", name);
 
@@ -224,7 +307,9 @@ static bool devoptabMountDevice(void *fs_ctx, const char *name, u8 type)
     ret = dev_ctx->initialized = true;
 
 end:
-    if (!ret) memset(dev_ctx, 0, sizeof(DevoptabDeviceContext));
+    if (!ret) devoptabClearDevice(dev_ctx);
+
+    mutexUnlock(&(dev_ctx->mutex));
 
     return ret;
 }
@@ -256,14 +341,30 @@ static DevoptabDeviceContext *devoptabFindDevice(const char *name)
 
 static void devoptabResetDevice(DevoptabDeviceContext *dev_ctx)
 {
-    if (!dev_ctx || !dev_ctx->initialized) return;
+    if (!dev_ctx) return;
+
+    /* Wait until any ongoing filesystem operation on this device is done. */
+    SCOPED_LOCK(&(dev_ctx->mutex))
+    {
+        if (!dev_ctx->initialized) break;
 
-    char tmp_name[DEVOPTAB_MOUNT_NAME_LENGTH + 2] = {0};
+        char tmp_name[DEVOPTAB_MOUNT_NAME_LENGTH + 2] = {0};
 
-    snprintf(tmp_name, MAX_ELEMENTS(tmp_name), "%s:", dev_ctx->name);
-    RemoveDevice(tmp_name);
+        snprintf(tmp_name, MAX_ELEMENTS(tmp_name), "%s:", dev_ctx->name);
+        RemoveDevice(tmp_name);
 
-    memset(dev_ctx, 0, sizeof(DevoptabDeviceContext));
+        devoptabClearDevice(dev_ctx);
 
-    LOG_MSG_DEBUG("Successfully unmounted device \"%s\".", tmp_name);
+        LOG_MSG_DEBUG("Successfully unmounted device \"%s\".", tmp_name);
+    }
+}
+
+static void devoptabClearDevice(DevoptabDeviceContext *dev_ctx)
+{
+    /* The device mutex is left untouched on purpose, since it's held by the caller. */
+    dev_ctx->initialized = false;
+    memset(dev_ctx->name, 0, sizeof(dev_ctx->name));
+    dev_ctx->mount_time = 0;
+    memset(&(dev_ctx->device), 0, sizeof(devoptab_t));
+    dev_ctx->fs_ctx = NULL;
 }
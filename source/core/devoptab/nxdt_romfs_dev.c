@@ -39,6 +39,7 @@
 typedef struct {
     RomFileSystemFileEntry *file_entry; ///< RomFS file entry metadata.
     u64 data_offset;                    ///< Current offset within RomFS file entry data.
+    DevoptabReadAheadBuffer ra_buf;     ///< Read-ahead buffer.
 } RomFileSystemFileState;
 
 typedef struct {
@@ -69,6 +70,8 @@ static void romfsdev_fill_dir_stat(struct stat *st, RomFileSystemContext *fs_ctx
 
 static nlink_t romfsdev_get_dir_nlink(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry);
 
+static bool romfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
+
 /* Global variables. */
 
 static const devoptab_t romfsdev_devoptab = {
@@ -146,6 +149,9 @@ static int romfsdev_close(struct _reent *r, void *fd)
 
     //LOG_MSG_DEBUG("Closing file \"%.*s\" from \"%s:\".", (int)file->file_entry->name_length, file->file_entry->name, dev_ctx->name);
 
+    /* Free read-ahead buffer. */
+    devoptabFreeReadAheadBuffer(&(file->ra_buf));
+
     /* Reset file descriptor. */
     memset(file, 0, sizeof(RomFileSystemFileState));
 
@@ -165,8 +171,17 @@ static ssize_t romfsdev_read(struct _reent *r, void *fd, char *ptr, size_t len)
     /*LOG_MSG_DEBUG("Reading 0x%lX byte(s) at offset 0x%lX from file \"%.*s\" in \"%s:\".", len, file->data_offset, (int)file->file_entry->name_length, file->file_entry->name, \
                                                                                           dev_ctx->name);*/
 
+    /* Clamp read size to the remaining entry data. */
+    if (file->data_offset >= file->file_entry->size)
+    {
+        len = 0;
+        DEVOPTAB_EXIT;
+    }
+
+    len = MIN(len, file->file_entry->size - file->data_offset);
+
     /* Read file data. */
-    if (!romfsReadFileEntryData(fs_ctx, file->file_entry, ptr, len, file->data_offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
+    if (!devoptabReadEntryData(&(file->ra_buf), romfsdev_read_entry_data, fs_ctx, file->file_entry, file->file_entry->size, ptr, len, file->data_offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
 
     /* Adjust offset. */
     file->data_offset += len;
@@ -537,3 +552,8 @@ static nlink_t romfsdev_get_dir_nlink(RomFileSystemContext *fs_ctx, RomFileSyste
 
     return count;
 }
+
+static bool romfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset)
+{
+    return romfsReadFileEntryData((RomFileSystemContext*)fs_ctx, (RomFileSystemFileEntry*)fs_entry, out, read_size, offset);
+}
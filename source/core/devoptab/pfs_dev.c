@@ -38,6 +38,7 @@ typedef struct {
     PartitionFileSystemEntry *pfs_entry;    ///< Partition FS entry metadata.
     const char *name;                       ///< Entry name.
     u64 offset;                             ///< Current offset within Partition FS entry data.
+    DevoptabReadAheadBuffer ra_buf;         ///< Read-ahead buffer.
 } PartitionFileSystemFileState;
 
 typedef struct {
@@ -63,6 +64,8 @@ static const char *pfsdev_get_truncated_path(struct _reent *r, const char *path)
 
 static void pfsdev_fill_stat(struct stat *st, u32 index, const PartitionFileSystemEntry *pfs_entry, time_t mount_time);
 
+static bool pfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
+
 /* Global variables. */
 
 static const devoptab_t pfsdev_devoptab = {
@@ -141,6 +144,9 @@ static int pfsdev_close(struct _reent *r, void *fd)
 
     //LOG_MSG_DEBUG("Closing \"%s:/%s\".", dev_ctx->name, file->name);
 
+    /* Free read-ahead buffer. */
+    devoptabFreeReadAheadBuffer(&(file->ra_buf));
+
     /* Reset file descriptor. */
     memset(file, 0, sizeof(PartitionFileSystemFileState));
 
@@ -159,8 +165,17 @@ static ssize_t pfsdev_read(struct _reent *r, void *fd, char *ptr, size_t len)
 
     //LOG_MSG_DEBUG("Reading 0x%lX byte(s) at offset 0x%lX from \"%s:/%s\".", len, file->offset, dev_ctx->name, file->name);
 
+    /* Clamp read size to the remaining entry data. */
+    if (file->offset >= file->pfs_entry->size)
+    {
+        len = 0;
+        DEVOPTAB_EXIT;
+    }
+
+    len = MIN(len, file->pfs_entry->size - file->offset);
+
     /* Read file data. */
-    if (!pfsReadEntryData(fs_ctx, file->pfs_entry, ptr, len, file->offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
+    if (!devoptabReadEntryData(&(file->ra_buf), pfsdev_read_entry_data, fs_ctx, file->pfs_entry, file->pfs_entry->size, ptr, len, file->offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
 
     /* Adjust offset. */
     file->offset += len;
@@ -461,3 +476,8 @@ static void pfsdev_fill_stat(struct stat *st, u32 index, const PartitionFileSyst
     st->st_size = (off_t)pfs_entry->size;
     st->st_atime = st->st_mtime = st->st_ctime = mount_time;
 }
+
+static bool pfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset)
+{
+    return pfsReadEntryData((PartitionFileSystemContext*)fs_ctx, (PartitionFileSystemEntry*)fs_entry, out, read_size, offset);
+}
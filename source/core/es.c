@@ -34,7 +34,9 @@ Result esCountCommonTicket(s32 *out_count)
         s32 num_tickets;
     } out;
 
+    u64 start_tick = armGetSystemTick();
     Result rc = serviceDispatchOut(&g_esSrv, 9, out);
+    statsRecordLatency(StatsLatencyType_EsCall, start_tick);
     if (R_SUCCEEDED(rc) && out_count) *out_count = out.num_tickets;
 
     return rc;
@@ -46,7 +48,9 @@ Result esCountPersonalizedTicket(s32 *out_count)
         s32 num_tickets;
     } out;
 
+    u64 start_tick = armGetSystemTick();
     Result rc = serviceDispatchOut(&g_esSrv, 10, out);
+    statsRecordLatency(StatsLatencyType_EsCall, start_tick);
     if (R_SUCCEEDED(rc) && out_count) *out_count = out.num_tickets;
 
     return rc;
@@ -58,10 +62,12 @@ Result esListCommonTicket(s32 *out_entries_written, FsRightsId *out_ids, s32 cou
         s32 num_rights_ids_written;
     } out;
 
+    u64 start_tick = armGetSystemTick();
     Result rc = serviceDispatchInOut(&g_esSrv, 11, *out_entries_written, out,
         .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
         .buffers = { { out_ids, (size_t)count * sizeof(FsRightsId) } }
     );
+    statsRecordLatency(StatsLatencyType_EsCall, start_tick);
 
     if (R_SUCCEEDED(rc) && out_entries_written) *out_entries_written = out.num_rights_ids_written;
 
@@ -74,10 +80,12 @@ Result esListPersonalizedTicket(s32 *out_entries_written, FsRightsId *out_ids, s
         s32 num_rights_ids_written;
     } out;
 
+    u64 start_tick = armGetSystemTick();
     Result rc = serviceDispatchInOut(&g_esSrv, 12, *out_entries_written, out,
         .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
         .buffers = { { out_ids, (size_t)count * sizeof(FsRightsId) } }
     );
+    statsRecordLatency(StatsLatencyType_EsCall, start_tick);
 
     if (R_SUCCEEDED(rc) && out_entries_written) *out_entries_written = out.num_rights_ids_written;
 
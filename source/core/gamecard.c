@@ -24,8 +24,13 @@
 #include <core/gamecard.h>
 #include <core/keys.h>
 #include <core/rsa.h>
+#include <core/nca.h>
 
-#define GAMECARD_READ_BUFFER_SIZE               0x800000                /* 8 MiB. */
+#define GAMECARD_READ_BUFFER_SIZE               0x10000                 /* 64 KiB. Only used as a bounce buffer for unaligned reads. */
+
+#define GAMECARD_READ_CACHE_LINE_SIZE           0x10000                 /* 64 KiB. Must be a multiple of GAMECARD_PAGE_SIZE. */
+#define GAMECARD_READ_CACHE_DEFAULT_SIZE        0x100000                /* 1 MiB (16 cache lines). */
+#define GAMECARD_READ_CACHE_READAHEAD_LINES     4                       /* Number of cache lines fetched at once after detecting a sequential access pattern. */
 
 #define GAMECARD_ACCESS_DELAY                   3                       /* Seconds. */
 
@@ -36,6 +41,11 @@
 
 #define LAFW_MAGIC                              0x4C414657              /* "LAFW". */
 
+#define LAFW_CACHE_MAGIC                        0x4C414643              /* "LAFC". */
+#define LAFW_CACHE_VERSION                      1
+
+#define GAMECARD_SECURITY_INFO_CACHE_COUNT      4                       /* Number of gamecards whose security information is kept around for the rest of the session. */
+
 /* Type definitions. */
 
 typedef enum {
@@ -44,6 +54,50 @@ typedef enum {
     GameCardStorageArea_Secure = 2
 } GameCardStorageArea;
 
+typedef struct {
+    u8 area;            ///< GameCardStorageArea. Set to GameCardStorageArea_None if this cache line holds no data.
+    u64 offset;         ///< Storage area offset. Always aligned to GAMECARD_READ_CACHE_LINE_SIZE.
+    u64 size;           ///< Valid data size. May be lower than GAMECARD_READ_CACHE_LINE_SIZE at the end of a storage area.
+    u64 last_access;    ///< Used to determine the least recently used cache line.
+    u8 *data;           ///< Points to a GAMECARD_READ_CACHE_LINE_SIZE area within the cache data buffer.
+} GameCardReadCacheLine;
+
+typedef struct {
+    u32 line_count;
+    GameCardReadCacheLine *lines;
+    u8 *data;                       ///< Cache line data buffer. Holds (line_count * GAMECARD_READ_CACHE_LINE_SIZE) bytes.
+    u8 *fetch_buf;                  ///< Used to fetch multiple cache lines at once. Holds up to (GAMECARD_READ_CACHE_READAHEAD_LINES * GAMECARD_READ_CACHE_LINE_SIZE) bytes.
+    u64 tick;                       ///< Incremented on each cache line access.
+    u8 last_fetch_area;             ///< Used for sequential access pattern detection.
+    u64 last_fetch_end;             ///< Used for sequential access pattern detection.
+    GameCardReadCacheStats stats;
+} GameCardReadCache;
+
+typedef struct {
+    u64 offset;     ///< Relative to the start of the gamecard image.
+    u64 size;
+    u8 *data;       ///< Points to an area within the staged data buffer.
+} GameCardStagedRegion;
+
+/// Followed by the cached LotusAsicFirmwareBlob. The LAFW blob is embedded into FS, so it's only valid for a specific system version and unit type.
+typedef struct {
+    u32 magic;                          ///< LAFW_CACHE_MAGIC.
+    u32 version;                        ///< LAFW_CACHE_VERSION.
+    u32 hos_version;                    ///< Matches the value returned by hosversionGet().
+    u8 dev_unit;                        ///< Set to true if the cache was generated under a development unit.
+    u8 reserved[0x3];
+    u8 blob_hash[SHA256_HASH_SIZE];     ///< SHA-256 checksum calculated over the cached LAFW blob.
+} LotusAsicFirmwareCacheHeader;
+
+NXDT_ASSERT(LotusAsicFirmwareCacheHeader, 0x30);
+
+typedef struct {
+    bool valid;
+    FsGameCardIdSet id_set;
+    u8 initial_data_hash[SHA256_HASH_SIZE];
+    GameCardSecurityInformation security_info;
+} GameCardSecurityInformationCacheEntry;
+
 typedef enum {
     GameCardCapacity_1GiB  = BITL(30),
     GameCardCapacity_2GiB  = BITL(31),
@@ -66,17 +120,28 @@ static bool g_openDeviceOperator = false, g_openEventNotifier = false, g_loadKer
 static LotusAsicFirmwareBlob *g_lafwBlob = NULL;
 static u64 g_lafwVersion = 0;
 
+static GameCardSecurityInformationCacheEntry g_gameCardSecurityInfoCache[GAMECARD_SECURITY_INFO_CACHE_COUNT] = {0};
+static u32 g_gameCardSecurityInfoCacheNextIdx = 0;
+
 static Thread g_gameCardDetectionThread = {0};
-static UEvent g_gameCardDetectionThreadExitEvent = {0}, g_gameCardStatusChangeEvent = {0};
+static UEvent g_gameCardDetectionThreadExitEvent = {0}, g_gameCardStatusChangeEvent = {0}, g_gameCardStatusUpdateEvent = {0};
 static bool g_gameCardDetectionThreadCreated = false;
 
 static atomic_uchar g_gameCardStatus = GameCardStatus_NotInserted;
 
 static FsGameCardHandle g_gameCardHandle = {0};
-static FsStorage g_gameCardStorage = {0};
+static FsStorage g_gameCardAreaStorages[2] = {0};   /* Indexed by (GameCardStorageArea - 1). */
+static FsStorage *g_gameCardStorage = NULL;          /* Points to the storage for the current area. */
 static u8 g_gameCardCurrentStorageArea = GameCardStorageArea_None;
+static bool g_gameCardDualStorageMode = false;      /* Keeps both storage areas open for the whole gamecard session, if possible. */
 static u8 *g_gameCardReadBuf = NULL;
 
+static GameCardReadCache g_gameCardReadCache = {0};
+
+static GameCardStagedRegion *g_gameCardStagedRegions = NULL;
+static u32 g_gameCardStagedRegionCount = 0;
+static u8 *g_gameCardStagedData = NULL;
+
 static GameCardHeader g_gameCardHeader = {0};
 static GameCardInfo g_gameCardInfoArea = {0};
 
@@ -120,6 +185,8 @@ static const char *g_lafwDeviceTypeStrings[LotusAsicDeviceType_Count] = {
 /* Function prototypes. */
 
 static bool gamecardReadLotusAsicFirmwareBlob(void);
+static bool gamecardLoadLotusAsicFirmwareBlobCache(bool dev_unit);
+static void gamecardSaveLotusAsicFirmwareBlobCache(bool dev_unit);
 
 static bool gamecardCreateDetectionThread(void);
 static void gamecardDestroyDetectionThread(void);
@@ -135,13 +202,29 @@ static bool gamecardReadHeader(void);
 static bool _gamecardGetPlaintextCardInfoArea(void);
 
 static bool gamecardReadSecurityInformation(GameCardSecurityInformation *out);
+static bool gamecardSecurityInformationScanCallback(const u8 *data, u64 data_size, void *user_data);
+static GameCardSecurityInformationCacheEntry *gamecardFindSecurityInformationCacheEntry(const FsGameCardIdSet *id_set);
 
 static bool gamecardGetHandleAndStorage(u32 partition);
 
 static bool gamecardOpenStorageArea(u8 area);
 static bool gamecardReadStorageArea(void *out, u64 read_size, u64 offset);
+static Result gamecardStorageRead(u8 area, u64 offset, void *out, u64 read_size);
+static bool gamecardReadStorageAreaUnalignedBlock(u8 area, void *out, u64 read_size, u64 base_offset);
 static void gamecardCloseStorageArea(void);
 
+static bool _gamecardSetReadCacheSize(u64 size);
+static void gamecardFreeReadCache(void);
+static void gamecardInvalidateReadCache(void);
+static bool gamecardReadStorageAreaCached(u8 area, void *out, u64 read_size, u64 base_offset);
+static GameCardReadCacheLine *gamecardFindReadCacheLine(u8 area, u64 line_offset);
+static GameCardReadCacheLine *gamecardGetReadCacheVictimLine(void);
+static GameCardReadCacheLine *gamecardFillReadCache(u8 area, u64 line_offset);
+
+static bool _gamecardStageStorage(const GameCardStorageRegion *regions, u32 region_count);
+static void gamecardFreeStagedStorage(void);
+static bool gamecardReadStagedStorage(void *out, u64 read_size, u64 offset);
+
 static bool gamecardGetStorageAreasSizes(void);
 NX_INLINE u64 gamecardGetCapacityFromRomSizeValue(u8 rom_size);
 
@@ -158,14 +241,17 @@ bool gamecardInitialize(void)
         ret = g_gameCardInterfaceInit;
         if (ret) break;
 
-        /* Allocate memory for the gamecard read buffer. */
-        g_gameCardReadBuf = malloc(GAMECARD_READ_BUFFER_SIZE);
+        /* Lease the gamecard read buffer from the shared buffer pool. */
+        g_gameCardReadBuf = bufferPoolLease(GAMECARD_READ_BUFFER_SIZE, false);
         if (!g_gameCardReadBuf)
         {
             LOG_MSG_ERROR("Unable to allocate memory for the gamecard read buffer!");
             break;
         }
 
+        /* Allocate memory for the gamecard read cache. */
+        if (!_gamecardSetReadCacheSize(GAMECARD_READ_CACHE_DEFAULT_SIZE)) break;
+
         /* Open device operator. */
         rc = fsOpenDeviceOperator(&g_deviceOperator);
         if (R_FAILED(rc))
@@ -202,6 +288,9 @@ bool gamecardInitialize(void)
         /* Create user-mode gamecard status change event. */
         ueventCreate(&g_gameCardStatusChangeEvent, true);
 
+        /* Create user-mode gamecard status update event. */
+        ueventCreate(&g_gameCardStatusUpdateEvent, true);
+
         /* Retrieve LAFW blob. */
         if (!gamecardReadLotusAsicFirmwareBlob()) break;
 
@@ -233,6 +322,10 @@ void gamecardExit(void)
             g_lafwBlob = NULL;
         }
 
+        /* Clear gamecard security information cache. */
+        memset(g_gameCardSecurityInfoCache, 0, sizeof(g_gameCardSecurityInfoCache));
+        g_gameCardSecurityInfoCacheNextIdx = 0;
+
         /* Close gamecard detection kernel event. */
         if (g_loadKernelEvent)
         {
@@ -254,13 +347,19 @@ void gamecardExit(void)
             g_openDeviceOperator = false;
         }
 
-        /* Free gamecard read buffer. */
+        /* Return gamecard read buffer. */
         if (g_gameCardReadBuf)
         {
-            free(g_gameCardReadBuf);
+            bufferPoolReturn(g_gameCardReadBuf);
             g_gameCardReadBuf = NULL;
         }
 
+        /* Free gamecard read cache. */
+        gamecardFreeReadCache();
+
+        /* Free staged gamecard storage. */
+        gamecardFreeStagedStorage();
+
         /* Make sure NS can access the gamecard. */
         /* Fixes gamecard launch errors after exiting the application. */
         /* TODO: find out why this doesn't work. */
@@ -283,14 +382,27 @@ UEvent *gamecardGetStatusChangeUserEvent(void)
     return event;
 }
 
+UEvent *gamecardGetStatusUpdateUserEvent(void)
+{
+    UEvent *event = NULL;
+
+    SCOPED_LOCK(&g_gameCardMutex)
+    {
+        if (g_gameCardInterfaceInit) event = &g_gameCardStatusUpdateEvent;
+    }
+
+    return event;
+}
+
 u8 gamecardGetStatus(void)
 {
     return atomic_load(&g_gameCardStatus);
 }
 
-/* Read full FS program memory to retrieve the GameCardSecurityInformation block. */
+/* Scan FS program memory to retrieve the GameCardSecurityInformation block. */
 /* In FS program memory, this is returned by Lotus command "ChangeToSecureMode" (0xF). */
 /* This means it is only available *after* the gamecard secure area has been mounted, which is taken care of in gamecardReadSecurityInformation(). */
+/* Retrieved blocks are cached for the rest of the session, keyed by gamecard ID set. */
 bool gamecardGetSecurityInformation(GameCardSecurityInformation *out)
 {
     bool ret = false;
@@ -336,12 +448,66 @@ bool gamecardGetLotusAsicFirmwareBlob(LotusAsicFirmwareBlob *out_lafw_blob, u64
 }
 
 bool gamecardReadStorage(void *out, u64 read_size, u64 offset)
+{
+    TRACE_FUNC();
+    bool ret = false;
+    SCOPED_LOCK(&g_gameCardMutex) ret = (gamecardReadStagedStorage(out, read_size, offset) || gamecardReadStorageArea(out, read_size, offset));
+    return ret;
+}
+
+bool gamecardQueryStorageExtents(StorageExtentList *out, u64 size, u64 offset)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_gameCardMutex)
+    {
+        if (!g_gameCardInterfaceInit || atomic_load(&g_gameCardStatus) != GameCardStatus_InsertedAndInfoLoaded || !out || !size || (offset + size) > g_gameCardTotalSize)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        StorageExtent extent = {
+            .offset = offset,
+            .size = size,
+            .type = StorageExtentType_Data,
+            .source = StorageExtentSource_GameCard,
+            .source_ctx = NULL,
+            .physical_offset = offset,
+            .physical_size = size
+        };
+
+        ret = storageExtentListAppend(out, &extent);
+    }
+
+    return ret;
+}
+
+bool gamecardSetReadCacheSize(u64 size)
+{
+    bool ret = false;
+    SCOPED_LOCK(&g_gameCardMutex) ret = _gamecardSetReadCacheSize(size);
+    return ret;
+}
+
+void gamecardGetReadCacheStats(GameCardReadCacheStats *out)
+{
+    if (!out) return;
+    SCOPED_LOCK(&g_gameCardMutex) memcpy(out, &(g_gameCardReadCache.stats), sizeof(GameCardReadCacheStats));
+}
+
+bool gamecardStageStorage(const GameCardStorageRegion *regions, u32 region_count)
 {
     bool ret = false;
-    SCOPED_LOCK(&g_gameCardMutex) ret = gamecardReadStorageArea(out, read_size, offset);
+    SCOPED_LOCK(&g_gameCardMutex) ret = _gamecardStageStorage(regions, region_count);
     return ret;
 }
 
+void gamecardReleaseStagedStorage(void)
+{
+    SCOPED_LOCK(&g_gameCardMutex) gamecardFreeStagedStorage();
+}
+
 bool gamecardGetHeader(GameCardHeader *out)
 {
     bool ret = false;
@@ -399,6 +565,19 @@ bool gamecardGetTotalSize(u64 *out)
     return ret;
 }
 
+bool gamecardGetNormalAreaSize(u64 *out)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_gameCardMutex)
+    {
+        ret = (g_gameCardInterfaceInit && atomic_load(&g_gameCardStatus) == GameCardStatus_InsertedAndInfoLoaded && out);
+        if (ret) *out = g_gameCardNormalAreaSize;
+    }
+
+    return ret;
+}
+
 bool gamecardGetTrimmedSize(u64 *out)
 {
     bool ret = false;
@@ -580,6 +759,13 @@ static bool gamecardReadLotusAsicFirmwareBlob(void)
         goto end;
     }
 
+    /* Try to load the LAFW blob from the SD card cache first. This avoids debugging FS on every startup. */
+    if (gamecardLoadLotusAsicFirmwareBlobCache(dev_unit))
+    {
+        fw_version = g_lafwBlob->fw_version;
+        goto version;
+    }
+
     /* Temporarily set the segment mask to .data. */
     g_fsProgramMemory.mask = MemoryProgramSegmentType_Data;
 
@@ -614,6 +800,10 @@ static bool gamecardReadLotusAsicFirmwareBlob(void)
         goto end;
     }
 
+    /* Update LAFW blob cache. */
+    gamecardSaveLotusAsicFirmwareBlobCache(dev_unit);
+
+version:
     /* Convert LAFW version bitmask to an integer. */
     g_lafwVersion = 0;
 
@@ -636,6 +826,93 @@ end:
     return ret;
 }
 
+static bool gamecardLoadLotusAsicFirmwareBlobCache(bool dev_unit)
+{
+    FILE *fp = NULL;
+    LotusAsicFirmwareCacheHeader header = {0};
+    u8 blob_hash[SHA256_HASH_SIZE] = {0};
+    u32 fw_type = (dev_unit ? LotusAsicFirmwareType_ReadDevFw : LotusAsicFirmwareType_ReadFw);
+    bool success = false;
+
+    /* Open cache file. */
+    if (!(fp = fopen(LAFW_CACHE_PATH, "rb")))
+    {
+        LOG_MSG_DEBUG("LAFW blob cache unavailable at \"" LAFW_CACHE_PATH "\".");
+        return false;
+    }
+
+    /* Read cache data. */
+    if (fread(&header, 1, sizeof(LotusAsicFirmwareCacheHeader), fp) != sizeof(LotusAsicFirmwareCacheHeader) || \
+        fread(g_lafwBlob, 1, sizeof(LotusAsicFirmwareBlob), fp) != sizeof(LotusAsicFirmwareBlob))
+    {
+        LOG_MSG_ERROR("Failed to read LAFW blob cache!");
+        goto end;
+    }
+
+    /* Make sure the cache was generated under the same system version and unit type. */
+    if (header.magic != __builtin_bswap32(LAFW_CACHE_MAGIC) || header.version != LAFW_CACHE_VERSION || header.hos_version != hosversionGet() || header.dev_unit != dev_unit)
+    {
+        LOG_MSG_INFO("LAFW blob cache is outdated. Discarding it.");
+        goto end;
+    }
+
+    /* Validate LAFW blob. */
+    sha256CalculateHash(blob_hash, g_lafwBlob, sizeof(LotusAsicFirmwareBlob));
+
+    if (memcmp(blob_hash, header.blob_hash, SHA256_HASH_SIZE) != 0 || __builtin_bswap32(g_lafwBlob->magic) != LAFW_MAGIC || g_lafwBlob->fw_type != fw_type)
+    {
+        LOG_MSG_ERROR("Invalid LAFW blob cache! Discarding it.");
+        goto end;
+    }
+
+    LOG_MSG_INFO("Loaded Lotus %s blob from \"" LAFW_CACHE_PATH "\".", dev_unit ? "ReadDevFw" : "ReadFw");
+
+    success = true;
+
+end:
+    if (!success) memset(g_lafwBlob, 0, sizeof(LotusAsicFirmwareBlob));
+
+    fclose(fp);
+
+    return success;
+}
+
+static void gamecardSaveLotusAsicFirmwareBlobCache(bool dev_unit)
+{
+    FILE *fp = NULL;
+    LotusAsicFirmwareCacheHeader header = { .magic = __builtin_bswap32(LAFW_CACHE_MAGIC), .version = LAFW_CACHE_VERSION, .hos_version = hosversionGet(), .dev_unit = dev_unit };
+    bool write_ok = false;
+
+    sha256CalculateHash(header.blob_hash, g_lafwBlob, sizeof(LotusAsicFirmwareBlob));
+
+    /* Write cache data to a temporary file, then replace the current cache file. */
+    utilsCreateDirectoryTree(LAFW_CACHE_PATH, false);
+
+    if (!(fp = fopen(LAFW_CACHE_TMP_PATH, "wb")))
+    {
+        LOG_MSG_ERROR("Failed to open \"" LAFW_CACHE_TMP_PATH "\" for writing!");
+        return;
+    }
+
+    write_ok = (fwrite(&header, 1, sizeof(LotusAsicFirmwareCacheHeader), fp) == sizeof(LotusAsicFirmwareCacheHeader) && \
+                fwrite(g_lafwBlob, 1, sizeof(LotusAsicFirmwareBlob), fp) == sizeof(LotusAsicFirmwareBlob));
+    fclose(fp);
+
+    if (!write_ok)
+    {
+        LOG_MSG_ERROR("Failed to write LAFW blob cache!");
+        remove(LAFW_CACHE_TMP_PATH);
+        return;
+    }
+
+    remove(LAFW_CACHE_PATH);
+    rename(LAFW_CACHE_TMP_PATH, LAFW_CACHE_PATH);
+
+    utilsCommitSdCardFileSystemChanges();
+
+    LOG_MSG_DEBUG("Saved LAFW blob cache.");
+}
+
 static bool gamecardCreateDetectionThread(void)
 {
     if (!utilsCreateThread(&g_gameCardDetectionThread, gamecardDetectionThreadFunc, NULL, 1))
@@ -673,10 +950,12 @@ static void gamecardDetectionThreadFunc(void *arg)
         if (gamecardIsInserted())
         {
             atomic_store(&g_gameCardStatus, GameCardStatus_Processing);
+            ueventSignal(&g_gameCardStatusUpdateEvent);
             gamecardLoadInfo();
         }
 
         ueventSignal(&g_gameCardStatusChangeEvent);
+        ueventSignal(&g_gameCardStatusUpdateEvent);
     }
 
     while(true)
@@ -696,6 +975,7 @@ static void gamecardDetectionThreadFunc(void *arg)
             /* Set initial gamecard status. */
             bool gc_inserted = gamecardIsInserted();
             atomic_store(&g_gameCardStatus, gc_inserted ? GameCardStatus_Processing : GameCardStatus_NotInserted);
+            ueventSignal(&g_gameCardStatusUpdateEvent);
 
             /* Delay gamecard access by GAMECARD_ACCESS_DELAY full seconds. This is done to to avoid conflicts with HOS / sysmodules. */
             /* We will periodically check if the gamecard is still inserted during this period. */
@@ -722,8 +1002,9 @@ static void gamecardDetectionThreadFunc(void *arg)
             /* Load gamecard info (if applicable). */
             if (gc_delay_passed) gamecardLoadInfo();
 
-            /* Signal user mode gamecard status change event. */
+            /* Signal user mode gamecard status change and update events. */
             ueventSignal(&g_gameCardStatusChangeEvent);
+            ueventSignal(&g_gameCardStatusUpdateEvent);
         }
     }
 
@@ -749,6 +1030,11 @@ static void gamecardLoadInfo(void)
     u32 root_hfs_entry_count = 0, root_hfs_name_table_size = 0;
     char *root_hfs_name_table = NULL;
 
+    /* Try to keep both storage areas open during this gamecard session. */
+    /* This avoids reopening storage areas each time a read moves between the normal and secure areas. */
+    /* Dual storage mode is automatically disabled if it isn't supported by the inserted gamecard. */
+    g_gameCardDualStorageMode = true;
+
     /* Read gamecard header. */
     /* This step *will* fail if the running CFW enabled the "nogc" patch. */
     /* gamecardGetHandleAndStorage() takes care of updating the gamecard status accordingly if this happens. */
@@ -879,6 +1165,14 @@ static void gamecardFreeInfo(bool clear_status)
 
     gamecardCloseStorageArea();
 
+    gamecardInvalidateReadCache();
+
+    gamecardFreeStagedStorage();
+
+    ncaInvalidateHeaderCache(NcmStorageId_GameCard);
+
+    g_gameCardDualStorageMode = false;
+
     if (clear_status) atomic_store(&g_gameCardStatus, GameCardStatus_NotInserted);
 }
 
@@ -895,7 +1189,7 @@ static bool gamecardReadHeader(void)
 
     /* Read gamecard header. */
     /* We don't use gamecardReadStorageArea() here because of its dependence on storage area sizes (which we haven't yet retrieved). */
-    rc = fsStorageRead(&g_gameCardStorage, 0, &g_gameCardHeader, sizeof(GameCardHeader));
+    rc = gamecardStorageRead(GameCardStorageArea_Normal, 0, &g_gameCardHeader, sizeof(GameCardHeader));
     if (R_FAILED(rc))
     {
         LOG_MSG_ERROR("fsStorageRead failed to read gamecard header! (0x%X).", rc);
@@ -915,7 +1209,7 @@ static bool gamecardReadHeader(void)
     if (g_gameCardHeader.flags & GameCardFlags_HasCa10Certificate)
     {
         /* Read the Header2 area. */
-        rc = fsStorageRead(&g_gameCardStorage, GAMECARD_HEADER2_OFFSET, &g_gameCardHeader2, sizeof(GameCardHeader2));
+        rc = gamecardStorageRead(GameCardStorageArea_Normal, GAMECARD_HEADER2_OFFSET, &g_gameCardHeader2, sizeof(GameCardHeader2));
         if (R_FAILED(rc))
         {
             LOG_MSG_ERROR("fsStorageRead failed to read gamecard Header2 area! (0x%X).", rc);
@@ -925,7 +1219,7 @@ static bool gamecardReadHeader(void)
         LOG_DATA_DEBUG(&g_gameCardHeader2, sizeof(GameCardHeader2), "Gamecard Header2 dump:");
 
         /* Read the Header2Certificate area. */
-        rc = fsStorageRead(&g_gameCardStorage, GAMECARD_HEADER2_CERT_OFFSET, &g_gameCardHeader2Cert, sizeof(GameCardHeader2Certificate));
+        rc = gamecardStorageRead(GameCardStorageArea_Normal, GAMECARD_HEADER2_CERT_OFFSET, &g_gameCardHeader2Cert, sizeof(GameCardHeader2Certificate));
         if (R_FAILED(rc))
         {
             LOG_MSG_ERROR("fsStorageRead failed to read gamecard Header2Certificate area! (0x%X).", rc);
@@ -987,9 +1281,29 @@ static bool gamecardReadSecurityInformation(GameCardSecurityInformation *out)
         return false;
     }
 
+    Result rc = 0;
+    FsGameCardIdSet id_set = {0};
+    GameCardSecurityInformationCacheEntry *cache_entry = NULL;
+
     /* Clear output. */
     memset(out, 0, sizeof(GameCardSecurityInformation));
 
+    /* Check if we already retrieved the security information for this gamecard during the current session. */
+    /* The gamecard ID set is only used as a lookup key. Cached entries must also match the initial data hash from the current gamecard header. */
+    rc = fsDeviceOperatorGetGameCardIdSet(&g_deviceOperator, &id_set, sizeof(FsGameCardIdSet), (s64)sizeof(FsGameCardIdSet));
+    if (R_SUCCEEDED(rc))
+    {
+        cache_entry = gamecardFindSecurityInformationCacheEntry(&id_set);
+        if (cache_entry && !memcmp(cache_entry->initial_data_hash, g_gameCardHeader.initial_data_hash, SHA256_HASH_SIZE))
+        {
+            LOG_MSG_DEBUG("Using cached gamecard security information.");
+            memcpy(out, &(cache_entry->security_info), sizeof(GameCardSecurityInformation));
+            return true;
+        }
+    } else {
+        LOG_MSG_ERROR("fsDeviceOperatorGetGameCardIdSet failed! (0x%X). Gamecard security information won't be cached.", rc);
+    }
+
     /* Open secure storage area. */
     if (!gamecardOpenStorageArea(GameCardStorageArea_Secure))
     {
@@ -997,39 +1311,78 @@ static bool gamecardReadSecurityInformation(GameCardSecurityInformation *out)
         return false;
     }
 
-    bool found = false;
-    u8 tmp_hash[SHA256_HASH_SIZE] = {0};
+    /* Scan FS program memory for the security information block. It's returned by a Lotus command, so it can only be found within writable memory. */
+    /* This avoids retrieving a full FS program memory dump. */
+    MemoryScanFilter filter = {
+        .program_id = FS_SYSMODULE_TID,
+        .perm = Perm_Rw,
+        .type_mask = 0,
+        .min_size = 0,
+        .max_size = 0,
+        .pattern_size = sizeof(GameCardSecurityInformation),
+        .callback = &gamecardSecurityInformationScanCallback,
+        .user_data = out
+    };
 
-    /* Retrieve full FS program memory dump. */
-    if (!memRetrieveFullProgramMemory(&g_fsProgramMemory))
+    if (!memScanProgramMemory(&filter))
     {
-        LOG_MSG_ERROR("Failed to retrieve full FS program memory dump!");
+        LOG_MSG_ERROR("Unable to locate gamecard security information in FS program memory!");
         return false;
     }
 
-    /* Look for the initial data block in the FS memory dump using the package ID and the initial data hash from the gamecard header. */
-    for(u64 offset = 0; offset < g_fsProgramMemory.data_size; offset++)
+    /* Update cache. Reuse the entry for this ID set if it's outdated, or evict the oldest one. */
+    if (R_SUCCEEDED(rc))
     {
-        if ((g_fsProgramMemory.data_size - offset) < sizeof(GameCardInitialData)) break;
+        if (!cache_entry)
+        {
+            cache_entry = &(g_gameCardSecurityInfoCache[g_gameCardSecurityInfoCacheNextIdx]);
+            g_gameCardSecurityInfoCacheNextIdx = ((g_gameCardSecurityInfoCacheNextIdx + 1) % GAMECARD_SECURITY_INFO_CACHE_COUNT);
+        }
 
-        if (memcmp(g_fsProgramMemory.data + offset, g_gameCardHeader.package_id, sizeof(g_gameCardHeader.package_id)) != 0) continue;
+        cache_entry->valid = true;
+        memcpy(&(cache_entry->id_set), &id_set, sizeof(FsGameCardIdSet));
+        memcpy(cache_entry->initial_data_hash, g_gameCardHeader.initial_data_hash, SHA256_HASH_SIZE);
+        memcpy(&(cache_entry->security_info), out, sizeof(GameCardSecurityInformation));
+    }
 
-        sha256CalculateHash(tmp_hash, g_fsProgramMemory.data + offset, sizeof(GameCardInitialData));
+    return true;
+}
+
+static GameCardSecurityInformationCacheEntry *gamecardFindSecurityInformationCacheEntry(const FsGameCardIdSet *id_set)
+{
+    for(u32 i = 0; i < GAMECARD_SECURITY_INFO_CACHE_COUNT; i++)
+    {
+        GameCardSecurityInformationCacheEntry *cache_entry = &(g_gameCardSecurityInfoCache[i]);
+        if (cache_entry->valid && !memcmp(&(cache_entry->id_set), id_set, sizeof(FsGameCardIdSet))) return cache_entry;
+    }
+
+    return NULL;
+}
+
+static bool gamecardSecurityInformationScanCallback(const u8 *data, u64 data_size, void *user_data)
+{
+    const u64 initial_data_offset = offsetof(GameCardSecurityInformation, initial_data);
+    u8 tmp_hash[SHA256_HASH_SIZE] = {0};
+
+    /* Look for the initial data block using the package ID and the initial data hash from the gamecard header. */
+    /* Only offsets with enough room for the whole security information block right before the end of the initial data block are checked. */
+    for(u64 offset = 0; offset <= (data_size - sizeof(GameCardSecurityInformation)); offset++)
+    {
+        const u8 *initial_data = (data + offset + initial_data_offset);
+
+        if (memcmp(initial_data, g_gameCardHeader.package_id, sizeof(g_gameCardHeader.package_id)) != 0) continue;
+
+        sha256CalculateHash(tmp_hash, initial_data, sizeof(GameCardInitialData));
 
         if (!memcmp(tmp_hash, g_gameCardHeader.initial_data_hash, SHA256_HASH_SIZE))
         {
             /* Jackpot. */
-            memcpy(out, g_fsProgramMemory.data + offset + sizeof(GameCardInitialData) - sizeof(GameCardSecurityInformation), sizeof(GameCardSecurityInformation));
-
-            found = true;
-            break;
+            memcpy(user_data, data + offset, sizeof(GameCardSecurityInformation));
+            return true;
         }
     }
 
-    /* Free FS memory dump. */
-    memFreeMemoryLocation(&g_fsProgramMemory);
-
-    return found;
+    return false;
 }
 
 static bool gamecardGetHandleAndStorage(u32 partition)
@@ -1061,7 +1414,7 @@ static bool gamecardGetHandleAndStorage(u32 partition)
         }
 
         /* If the previous call succeeded, let's try to open the desired gamecard storage area. */
-        rc = fsOpenGameCardStorage(&g_gameCardStorage, &g_gameCardHandle, partition);
+        rc = fsOpenGameCardStorage(&(g_gameCardAreaStorages[partition]), &g_gameCardHandle, partition);
         if (R_FAILED(rc))
         {
             LOG_MSG_DEBUG("fsOpenGameCardStorage failed to open %s storage area on try #%u! (0x%X).", GAMECARD_STORAGE_AREA_NAME(partition + 1), i + 1, rc);
@@ -1093,9 +1446,37 @@ static bool gamecardOpenStorageArea(u8 area)
     }
 
     /* Return right away if a valid handle has already been retrieved and the desired gamecard storage area is currently open. */
-    if (g_gameCardHandle.value && serviceIsActive(&(g_gameCardStorage.s)) && g_gameCardCurrentStorageArea == area) return true;
+    if (g_gameCardHandle.value && g_gameCardStorage && serviceIsActive(&(g_gameCardStorage->s)) && g_gameCardCurrentStorageArea == area) return true;
+
+    FsStorage *area_storage = &(g_gameCardAreaStorages[area - 1]); /* Zero-based index. */
+
+    if (g_gameCardDualStorageMode && g_gameCardHandle.value)
+    {
+        /* Dual storage mode: switch to the desired storage area right away if it was already opened during this gamecard session. */
+        /* Otherwise, try to open it using the current gamecard handle while keeping the other storage area open. */
+        Result rc = 0;
+
+        if (!serviceIsActive(&(area_storage->s)))
+        {
+            rc = fsOpenGameCardStorage(area_storage, &g_gameCardHandle, area - 1);
+            if (R_FAILED(rc))
+            {
+                LOG_MSG_WARNING("fsOpenGameCardStorage failed to open %s storage area using the current gamecard handle! (0x%X). Disabling dual storage mode.", \
+                                GAMECARD_STORAGE_AREA_NAME(area), rc);
+                g_gameCardDualStorageMode = false;
+            }
+        }
 
-    /* Close both the gamecard handle and the open storage area. */
+        if (R_SUCCEEDED(rc))
+        {
+            /* Update current gamecard storage area. */
+            g_gameCardStorage = area_storage;
+            g_gameCardCurrentStorageArea = area;
+            return true;
+        }
+    }
+
+    /* Close both the gamecard handle and all open storage areas. */
     gamecardCloseStorageArea();
 
     /* Retrieve both a new gamecard handle and a storage area handle. */
@@ -1106,6 +1487,7 @@ static bool gamecardOpenStorageArea(u8 area)
     }
 
     /* Update current gamecard storage area. */
+    g_gameCardStorage = area_storage;
     g_gameCardCurrentStorageArea = area;
 
     return true;
@@ -1154,10 +1536,15 @@ static bool gamecardReadStorageArea(void *out, u64 read_size, u64 offset)
     /* Calculate proper storage area offset. */
     u64 base_offset = (area == GameCardStorageArea_Normal ? offset : (offset - g_gameCardNormalAreaSize));
 
+    if (g_gameCardReadCache.line_count && read_size < GAMECARD_READ_CACHE_LINE_SIZE)
+    {
+        /* Small reads are served through the read cache. Bigger reads (e.g. full image dumps) bypass it altogether. */
+        success = gamecardReadStorageAreaCached(area, out_u8, read_size, base_offset);
+    } else
     if (!(base_offset % GAMECARD_PAGE_SIZE) && !(read_size % GAMECARD_PAGE_SIZE))
     {
         /* Optimization for reads that are already aligned to a GAMECARD_PAGE_SIZE boundary. */
-        rc = fsStorageRead(&g_gameCardStorage, base_offset, out_u8, read_size);
+        rc = gamecardStorageRead(area, base_offset, out_u8, read_size);
         if (R_FAILED(rc))
         {
             LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (aligned).", read_size, base_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
@@ -1171,36 +1558,422 @@ static bool gamecardReadStorageArea(void *out, u64 read_size, u64 offset)
         u64 block_end_offset = ALIGN_UP(base_offset + read_size, GAMECARD_PAGE_SIZE);
         u64 block_size = (block_end_offset - block_start_offset);
 
-        u64 data_start_offset = (base_offset - block_start_offset);
-        u64 chunk_size = (block_size > GAMECARD_READ_BUFFER_SIZE ? GAMECARD_READ_BUFFER_SIZE : block_size);
-        u64 out_chunk_size = (block_size > GAMECARD_READ_BUFFER_SIZE ? (GAMECARD_READ_BUFFER_SIZE - data_start_offset) : read_size);
+        if (block_size <= GAMECARD_READ_BUFFER_SIZE)
+        {
+            /* Small unaligned reads are handled using a single bounce buffer read. */
+            success = gamecardReadStorageAreaUnalignedBlock(area, out_u8, read_size, base_offset);
+            goto end;
+        }
+
+        /* Big unaligned reads are split into three parts: */
+        /*     1. An unaligned head, read through the bounce buffer. */
+        /*     2. An aligned middle section, read straight into the output buffer. */
+        /*     3. An unaligned tail, read through the bounce buffer. */
+        /* This avoids copying most of the data and issuing multiple reads for the same area. */
+        u64 head_size = (IS_ALIGNED(base_offset, GAMECARD_PAGE_SIZE) ? 0 : (ALIGN_UP(base_offset, GAMECARD_PAGE_SIZE) - base_offset));
+        u64 tail_size = ((base_offset + read_size) - ALIGN_DOWN(base_offset + read_size, GAMECARD_PAGE_SIZE));
+        u64 middle_size = (read_size - head_size - tail_size);
+
+        if (head_size && !gamecardReadStorageAreaUnalignedBlock(area, out_u8, head_size, base_offset)) goto end;
 
-        rc = fsStorageRead(&g_gameCardStorage, block_start_offset, g_gameCardReadBuf, chunk_size);
+        rc = gamecardStorageRead(area, base_offset + head_size, out_u8 + head_size, middle_size);
         if (R_FAILED(rc))
         {
-            LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (unaligned).", chunk_size, block_start_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
+            LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (unaligned middle).", middle_size, base_offset + head_size, \
+                          GAMECARD_STORAGE_AREA_NAME(area), rc);
             goto end;
         }
 
-        memcpy(out_u8, g_gameCardReadBuf + data_start_offset, out_chunk_size);
+        if (tail_size && !gamecardReadStorageAreaUnalignedBlock(area, out_u8 + head_size + middle_size, tail_size, base_offset + head_size + middle_size)) goto end;
 
-        success = (block_size > GAMECARD_READ_BUFFER_SIZE ? gamecardReadStorageArea(out_u8 + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size) : true);
+        success = true;
     }
 
 end:
     return success;
 }
 
+static bool gamecardReadStorageAreaUnalignedBlock(u8 area, void *out, u64 read_size, u64 base_offset)
+{
+    /* The currently open storage area must match the provided one. Aligned block size must not exceed the bounce buffer size. */
+    u64 block_start_offset = ALIGN_DOWN(base_offset, GAMECARD_PAGE_SIZE);
+    u64 block_size = (ALIGN_UP(base_offset + read_size, GAMECARD_PAGE_SIZE) - block_start_offset);
+
+    Result rc = gamecardStorageRead(area, block_start_offset, g_gameCardReadBuf, block_size);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (unaligned).", block_size, block_start_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
+        return false;
+    }
+
+    memcpy(out, g_gameCardReadBuf + (base_offset - block_start_offset), read_size);
+
+    return true;
+}
+
+static Result gamecardStorageRead(u8 area, u64 offset, void *out, u64 read_size)
+{
+    statsAddCounter(StatsCounterType_GameCardRead, read_size);
+
+    u64 start_tick = armGetSystemTick();
+    Result rc = fsStorageRead(g_gameCardStorage, (s64)offset, out, read_size);
+    statsRecordLatency(StatsLatencyType_GameCardRead, start_tick);
+
+    /* Opening a storage area may invalidate the other one while using dual storage mode. */
+    /* If a read fails under dual storage mode, disable it for the rest of the gamecard session, then reopen the storage area and try again. */
+    if (R_FAILED(rc) && g_gameCardDualStorageMode)
+    {
+        LOG_MSG_WARNING("fsStorageRead failed under dual storage mode! (0x%X). Disabling dual storage mode.", rc);
+
+        g_gameCardDualStorageMode = false;
+        gamecardCloseStorageArea();
+
+        if (gamecardOpenStorageArea(area))
+        {
+            start_tick = armGetSystemTick();
+            rc = fsStorageRead(g_gameCardStorage, (s64)offset, out, read_size);
+            statsRecordLatency(StatsLatencyType_GameCardRead, start_tick);
+        }
+    }
+
+    return rc;
+}
+
+static bool _gamecardSetReadCacheSize(u64 size)
+{
+    u32 line_count = (u32)(size / GAMECARD_READ_CACHE_LINE_SIZE);
+    u32 fetch_line_count = MIN(line_count, GAMECARD_READ_CACHE_READAHEAD_LINES);
+
+    /* Free current read cache. This also resets its statistics. */
+    gamecardFreeReadCache();
+
+    /* Return right away if the read cache is being disabled. */
+    if (!line_count)
+    {
+        LOG_MSG_DEBUG("Gamecard read cache disabled.");
+        return true;
+    }
+
+    /* Allocate memory for the read cache. */
+    g_gameCardReadCache.lines = calloc(line_count, sizeof(GameCardReadCacheLine));
+    g_gameCardReadCache.data = malloc((u64)line_count * GAMECARD_READ_CACHE_LINE_SIZE);
+    g_gameCardReadCache.fetch_buf = (fetch_line_count > 1 ? malloc((u64)fetch_line_count * GAMECARD_READ_CACHE_LINE_SIZE) : NULL);
+
+    if (!g_gameCardReadCache.lines || !g_gameCardReadCache.data || (fetch_line_count > 1 && !g_gameCardReadCache.fetch_buf))
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for a %u-line gamecard read cache!", line_count);
+        gamecardFreeReadCache();
+        return false;
+    }
+
+    for(u32 i = 0; i < line_count; i++) g_gameCardReadCache.lines[i].data = (g_gameCardReadCache.data + ((u64)i * GAMECARD_READ_CACHE_LINE_SIZE));
+
+    g_gameCardReadCache.line_count = line_count;
+    g_gameCardReadCache.stats.cache_size = ((u64)line_count * GAMECARD_READ_CACHE_LINE_SIZE);
+
+    LOG_MSG_DEBUG("Gamecard read cache size set to 0x%lX bytes (%u line[s]).", g_gameCardReadCache.stats.cache_size, line_count);
+
+    return true;
+}
+
+static void gamecardFreeReadCache(void)
+{
+    if (g_gameCardReadCache.lines) free(g_gameCardReadCache.lines);
+    if (g_gameCardReadCache.data) free(g_gameCardReadCache.data);
+    if (g_gameCardReadCache.fetch_buf) free(g_gameCardReadCache.fetch_buf);
+    memset(&g_gameCardReadCache, 0, sizeof(GameCardReadCache));
+}
+
+static void gamecardInvalidateReadCache(void)
+{
+    for(u32 i = 0; i < g_gameCardReadCache.line_count; i++)
+    {
+        GameCardReadCacheLine *line = &(g_gameCardReadCache.lines[i]);
+        line->area = GameCardStorageArea_None;
+        line->offset = line->size = line->last_access = 0;
+    }
+
+    g_gameCardReadCache.tick = 0;
+    g_gameCardReadCache.last_fetch_area = GameCardStorageArea_None;
+    g_gameCardReadCache.last_fetch_end = 0;
+}
+
+static bool _gamecardStageStorage(const GameCardStorageRegion *regions, u32 region_count)
+{
+    u8 status = atomic_load(&g_gameCardStatus);
+    u64 total_size = 0, prev_end = 0, data_offset = 0;
+    bool success = false;
+
+    /* Release previously staged data. */
+    gamecardFreeStagedStorage();
+
+    if (!g_gameCardInterfaceInit || status != GameCardStatus_InsertedAndInfoLoaded || !regions || !region_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Validate regions. */
+    for(u32 i = 0; i < region_count; i++)
+    {
+        const GameCardStorageRegion *region = &(regions[i]);
+
+        if (!region->size || region->offset < prev_end || region->size > (g_gameCardTotalSize - MIN(region->offset, g_gameCardTotalSize)) || \
+            region->size > (GAMECARD_STAGED_STORAGE_MAX_SIZE - total_size))
+        {
+            LOG_MSG_ERROR("Invalid gamecard storage region #%u! (0x%lX, 0x%lX).", i, region->offset, region->size);
+            return false;
+        }
+
+        prev_end = (region->offset + region->size);
+        total_size += region->size;
+    }
+
+    /* Allocate memory for the staged regions. */
+    if (!(g_gameCardStagedRegions = calloc(region_count, sizeof(GameCardStagedRegion))) || !(g_gameCardStagedData = malloc(total_size)))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for staged gamecard storage! (0x%lX).", total_size);
+        goto end;
+    }
+
+    /* Read each region using a single request. */
+    for(u32 i = 0; i < region_count; i++)
+    {
+        GameCardStagedRegion *staged_region = &(g_gameCardStagedRegions[i]);
+
+        staged_region->offset = regions[i].offset;
+        staged_region->size = regions[i].size;
+        staged_region->data = (g_gameCardStagedData + data_offset);
+
+        if (!gamecardReadStorageArea(staged_region->data, staged_region->size, staged_region->offset))
+        {
+            LOG_MSG_ERROR("Failed to read gamecard storage region #%u! (0x%lX, 0x%lX).", i, staged_region->offset, staged_region->size);
+            goto end;
+        }
+
+        data_offset += staged_region->size;
+    }
+
+    g_gameCardStagedRegionCount = region_count;
+    success = true;
+
+    LOG_MSG_DEBUG("Staged %u gamecard storage region(s) (0x%lX bytes).", region_count, total_size);
+
+end:
+    if (!success) gamecardFreeStagedStorage();
+
+    return success;
+}
+
+static void gamecardFreeStagedStorage(void)
+{
+    if (g_gameCardStagedRegions)
+    {
+        free(g_gameCardStagedRegions);
+        g_gameCardStagedRegions = NULL;
+    }
+
+    if (g_gameCardStagedData)
+    {
+        free(g_gameCardStagedData);
+        g_gameCardStagedData = NULL;
+    }
+
+    g_gameCardStagedRegionCount = 0;
+}
+
+static bool gamecardReadStagedStorage(void *out, u64 read_size, u64 offset)
+{
+    if (!g_gameCardStagedRegionCount || !out || !read_size) return false;
+
+    u32 low = 0, high = g_gameCardStagedRegionCount;
+
+    /* Look for the last staged region that starts at or before the provided offset. Staged regions are sorted by offset. */
+    while(low < high)
+    {
+        u32 mid = (low + (high - low) / 2);
+        if (g_gameCardStagedRegions[mid].offset <= offset)
+        {
+            low = (mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+
+    if (!low) return false;
+
+    GameCardStagedRegion *staged_region = &(g_gameCardStagedRegions[low - 1]);
+    u64 region_offset = (offset - staged_region->offset);
+
+    /* Only serve reads fully contained within a single staged region. */
+    if (region_offset >= staged_region->size || read_size > (staged_region->size - region_offset)) return false;
+
+    memcpy(out, staged_region->data + region_offset, read_size);
+
+    return true;
+}
+
+static bool gamecardReadStorageAreaCached(u8 area, void *out, u64 read_size, u64 base_offset)
+{
+    u8 *out_u8 = (u8*)out;
+
+    while(read_size)
+    {
+        u64 line_offset = ALIGN_DOWN(base_offset, GAMECARD_READ_CACHE_LINE_SIZE);
+
+        /* Look for a cache line that holds the data we need. Fetch it from the gamecard if we can't find one. */
+        GameCardReadCacheLine *line = gamecardFindReadCacheLine(area, line_offset);
+        if (line)
+        {
+            g_gameCardReadCache.stats.hit_count++;
+        } else {
+            line = gamecardFillReadCache(area, line_offset);
+            if (!line) return false;
+        }
+
+        u64 line_data_offset = (base_offset - line_offset);
+        if (line_data_offset >= line->size)
+        {
+            LOG_MSG_ERROR("Read at offset 0x%lX exceeds %s storage area boundaries!", base_offset, GAMECARD_STORAGE_AREA_NAME(area));
+            return false;
+        }
+
+        /* Copy cached data. */
+        u64 copy_size = MIN(read_size, line->size - line_data_offset);
+        memcpy(out_u8, line->data + line_data_offset, copy_size);
+
+        line->last_access = ++(g_gameCardReadCache.tick);
+
+        out_u8 += copy_size;
+        base_offset += copy_size;
+        read_size -= copy_size;
+    }
+
+    return true;
+}
+
+static GameCardReadCacheLine *gamecardFindReadCacheLine(u8 area, u64 line_offset)
+{
+    for(u32 i = 0; i < g_gameCardReadCache.line_count; i++)
+    {
+        GameCardReadCacheLine *line = &(g_gameCardReadCache.lines[i]);
+        if (line->area == area && line->offset == line_offset) return line;
+    }
+
+    return NULL;
+}
+
+static GameCardReadCacheLine *gamecardGetReadCacheVictimLine(void)
+{
+    GameCardReadCacheLine *victim = NULL;
+
+    for(u32 i = 0; i < g_gameCardReadCache.line_count; i++)
+    {
+        GameCardReadCacheLine *line = &(g_gameCardReadCache.lines[i]);
+
+        /* Unused cache lines are always picked first. */
+        if (line->area == GameCardStorageArea_None) return line;
+
+        if (!victim || line->last_access < victim->last_access) victim = line;
+    }
+
+    return victim;
+}
+
+static GameCardReadCacheLine *gamecardFillReadCache(u8 area, u64 line_offset)
+{
+    GameCardReadCache *cache = &g_gameCardReadCache;
+    GameCardReadCacheLine *first_line = NULL;
+    u64 area_size = (area == GameCardStorageArea_Normal ? g_gameCardNormalAreaSize : g_gameCardSecureAreaSize);
+    Result rc = 0;
+
+    if (line_offset >= area_size)
+    {
+        LOG_MSG_ERROR("Invalid cache line offset! (0x%lX, %s).", line_offset, GAMECARD_STORAGE_AREA_NAME(area));
+        return NULL;
+    }
+
+    /* Read multiple cache lines at once if this miss immediately follows the previous fetch from the same storage area. */
+    bool sequential = (cache->fetch_buf && cache->last_fetch_area == area && cache->last_fetch_end == line_offset);
+    u32 fetch_line_count = (sequential ? MIN(cache->line_count, GAMECARD_READ_CACHE_READAHEAD_LINES) : 1);
+
+    /* Storage area sizes are always aligned to GAMECARD_PAGE_SIZE, so the fetch size will be aligned as well. */
+    u64 fetch_size = MIN((u64)fetch_line_count * GAMECARD_READ_CACHE_LINE_SIZE, area_size - line_offset);
+    fetch_line_count = (u32)DIVIDE_UP(fetch_size, GAMECARD_READ_CACHE_LINE_SIZE);
+
+    cache->stats.miss_count++;
+
+    if (fetch_line_count == 1)
+    {
+        /* Read data straight into the least recently used cache line. */
+        first_line = gamecardGetReadCacheVictimLine();
+
+        rc = gamecardStorageRead(area, line_offset, first_line->data, fetch_size);
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (cache).", fetch_size, line_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
+            first_line->area = GameCardStorageArea_None;
+            return NULL;
+        }
+
+        first_line->area = area;
+        first_line->offset = line_offset;
+        first_line->size = fetch_size;
+        first_line->last_access = ++(cache->tick);
+    } else {
+        /* Read all cache lines using a single request. */
+        rc = gamecardStorageRead(area, line_offset, cache->fetch_buf, fetch_size);
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (cache readahead).", fetch_size, line_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
+            return NULL;
+        }
+
+        for(u32 i = 0; i < fetch_line_count; i++)
+        {
+            u64 cur_offset = (line_offset + ((u64)i * GAMECARD_READ_CACHE_LINE_SIZE));
+            u64 cur_size = MIN((u64)GAMECARD_READ_CACHE_LINE_SIZE, fetch_size - ((u64)i * GAMECARD_READ_CACHE_LINE_SIZE));
+
+            /* Reuse a cache line if it already holds this data. */
+            /* Freshly filled cache lines will never be picked as victims, since they're always the most recently used ones. */
+            GameCardReadCacheLine *line = gamecardFindReadCacheLine(area, cur_offset);
+            if (!line) line = gamecardGetReadCacheVictimLine();
+
+            memcpy(line->data, cache->fetch_buf + ((u64)i * GAMECARD_READ_CACHE_LINE_SIZE), cur_size);
+
+            line->area = area;
+            line->offset = cur_offset;
+            line->size = cur_size;
+            line->last_access = ++(cache->tick);
+
+            if (!first_line) first_line = line;
+        }
+
+        cache->stats.readahead_count += (fetch_line_count - 1);
+    }
+
+    /* Update sequential access pattern tracking. */
+    cache->last_fetch_area = area;
+    cache->last_fetch_end = (line_offset + fetch_size);
+
+    return first_line;
+}
+
 static void gamecardCloseStorageArea(void)
 {
     if (g_gameCardCurrentStorageArea == GameCardStorageArea_None) return;
 
-    if (serviceIsActive(&(g_gameCardStorage.s)))
+    for(u8 i = 0; i < MAX_ELEMENTS(g_gameCardAreaStorages); i++)
     {
-        fsStorageClose(&g_gameCardStorage);
-        memset(&g_gameCardStorage, 0, sizeof(FsStorage));
+        FsStorage *area_storage = &(g_gameCardAreaStorages[i]);
+        if (!serviceIsActive(&(area_storage->s))) continue;
+
+        fsStorageClose(area_storage);
+        memset(area_storage, 0, sizeof(FsStorage));
     }
 
+    g_gameCardStorage = NULL;
+
     g_gameCardHandle.value = 0;
 
     g_gameCardCurrentStorageArea = GameCardStorageArea_None;
@@ -1220,9 +1993,8 @@ static bool gamecardGetStorageAreasSizes(void)
             return false;
         }
 
-        rc = fsStorageGetSize(&g_gameCardStorage, (s64*)&area_size);
-
-        gamecardCloseStorageArea();
+        /* Don't close the storage area here. Under dual storage mode, both storage areas will be kept open. */
+        rc = fsStorageGetSize(g_gameCardStorage, (s64*)&area_size);
 
         if (R_FAILED(rc) || !area_size)
         {
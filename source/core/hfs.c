@@ -24,6 +24,8 @@
 
 #define HFS_PARTITION_NAME_INDEX(x) ((x) - 1)
 
+#define HFS_NAME_INDEX_MIN_ENTRY_COUNT  8
+
 static const char *g_hfsPartitionNames[] = {
     [HFS_PARTITION_NAME_INDEX(HashFileSystemPartitionType_Root)]   = "root",
     [HFS_PARTITION_NAME_INDEX(HashFileSystemPartitionType_Update)] = "update",
@@ -32,6 +34,17 @@ static const char *g_hfsPartitionNames[] = {
     [HFS_PARTITION_NAME_INDEX(HashFileSystemPartitionType_Secure)] = "secure"
 };
 
+/* Function prototypes. */
+
+static bool hfsBuildNameIndex(HashFileSystemContext *ctx);
+static bool hfsLookupNameIndex(HashFileSystemContext *ctx, const char *name, u32 *out_idx);
+NX_INLINE u32 hfsCalculateNameHash(const char *name);
+
+static void hfsFinishHashRegion(HashFileSystemHashVerifier *verifier, HashFileSystemHashRegion *region);
+
+static int hfsReadPlanEntrySortFunction(const void *a, const void *b);
+static int hfsHashRegionSortFunction(const void *a, const void *b);
+
 bool hfsReadPartitionData(HashFileSystemContext *ctx, void *out, u64 read_size, u64 offset)
 {
     if (!hfsIsValidContext(ctx) || !out || !read_size || (offset + read_size) > ctx->size)
@@ -96,6 +109,250 @@ bool hfsGetTotalDataSize(HashFileSystemContext *ctx, u64 *out_size)
     return true;
 }
 
+bool hfsGenerateReadPlan(HashFileSystemContext *ctx, HashFileSystemReadPlan *out)
+{
+    return hfsGenerateReadPlanForEntries(ctx, NULL, 0, out);
+}
+
+bool hfsGenerateReadPlanForEntries(HashFileSystemContext *ctx, const u32 *entry_indices, u32 entry_index_count, HashFileSystemReadPlan *out)
+{
+    u32 fs_entry_count = hfsGetEntryCount(ctx), entry_count = (entry_indices ? entry_index_count : fs_entry_count);
+
+    if (!fs_entry_count || !entry_count || !out)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    HashFileSystemReadPlan plan = {0};
+    HashFileSystemEntry *fs_entry = NULL;
+    HashFileSystemReadRun *cur_run = NULL;
+    u64 data_size = (ctx->size - ctx->header_size), prev_entry_end = 0;
+    bool success = false;
+
+    /* Allocate memory for the read plan. Each entry gets its own run in the worst case scenario. */
+    if (!(plan.entries = malloc(entry_count * sizeof(HashFileSystemReadPlanEntry))) || !(plan.runs = malloc(entry_count * sizeof(HashFileSystemReadRun))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for Hash FS read plan!");
+        goto end;
+    }
+
+    /* Populate read plan entries. */
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        HashFileSystemReadPlanEntry *plan_entry = &(plan.entries[i]);
+        u32 entry_idx = (entry_indices ? entry_indices[i] : i);
+
+        if (entry_idx >= fs_entry_count || !(fs_entry = hfsGetEntryByIndex(ctx, entry_idx)) || fs_entry->offset > data_size || fs_entry->size > (data_size - fs_entry->offset))
+        {
+            LOG_MSG_ERROR("Invalid Hash FS entry #%u!", entry_idx);
+            goto end;
+        }
+
+        plan_entry->offset = (ctx->header_size + fs_entry->offset);
+        plan_entry->size = fs_entry->size;
+        plan_entry->entry_idx = entry_idx;
+
+        if (!fs_entry->size) plan.empty_entry_count++;
+    }
+
+    plan.entry_count = entry_count;
+
+    /* Sort read plan entries. */
+    if (entry_count > 1) qsort(plan.entries, entry_count, sizeof(HashFileSystemReadPlanEntry), &hfsReadPlanEntrySortFunction);
+
+    /* Merge adjacent entries into read runs. */
+    for(u32 i = plan.empty_entry_count; i < entry_count; i++)
+    {
+        HashFileSystemReadPlanEntry *plan_entry = &(plan.entries[i]);
+        u64 entry_end = (plan_entry->offset + plan_entry->size);
+
+        /* Start a new run if this is the first non-empty entry, if this entry overlaps the previous one, or if the gap between both entries is too big. */
+        if (!cur_run || plan_entry->offset < prev_entry_end || (plan_entry->offset - prev_entry_end) > HFS_READ_PLAN_MAX_GAP)
+        {
+            /* Align the run start offset to the gamecard page size, relative to the start of the gamecard image. */
+            u64 aligned_offset = ALIGN_DOWN(ctx->offset + plan_entry->offset, GAMECARD_PAGE_SIZE);
+
+            cur_run = &(plan.runs[plan.run_count++]);
+            cur_run->offset = (aligned_offset >= ctx->offset ? (aligned_offset - ctx->offset) : 0);
+            cur_run->entry_start = i;
+            cur_run->entry_count = 0;
+        }
+
+        cur_run->entry_count++;
+
+        /* Update the run size, aligning its end offset as well. Let's make sure we don't read past the end of the partition. */
+        cur_run->size = (MIN(ALIGN_UP(ctx->offset + entry_end, GAMECARD_PAGE_SIZE) - ctx->offset, ctx->size) - cur_run->offset);
+
+        prev_entry_end = entry_end;
+    }
+
+    /* Update output read plan. */
+    memcpy(out, &plan, sizeof(HashFileSystemReadPlan));
+    success = true;
+
+    LOG_MSG_DEBUG("Generated Hash FS read plan for \"%s\" partition: %u entries, %u empty, %u run(s).", ctx->name, plan.entry_count, plan.empty_entry_count, plan.run_count);
+
+end:
+    if (!success) hfsFreeReadPlan(&plan);
+
+    return success;
+}
+
+bool hfsAddHashVerifierContext(HashFileSystemHashVerifier *verifier, HashFileSystemContext *ctx)
+{
+    u32 entry_count = hfsGetEntryCount(ctx);
+
+    if (!verifier || verifier->cur_region || !entry_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    HashFileSystemEntry *fs_entry = NULL;
+    HashFileSystemHashRegion *regions = NULL;
+    char *fs_entry_name = NULL;
+    u64 data_size = (ctx->size - ctx->header_size);
+    u32 region_count = verifier->region_count;
+    bool success = false;
+
+    /* Reallocate hashed region array. */
+    if (!(regions = realloc(verifier->regions, (region_count + entry_count) * sizeof(HashFileSystemHashRegion))))
+    {
+        LOG_MSG_ERROR("Failed to reallocate Hash FS hashed region array!");
+        return false;
+    }
+
+    verifier->regions = regions;
+
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        if (!(fs_entry = hfsGetEntryByIndex(ctx, i)) || !(fs_entry_name = hfsGetEntryName(ctx, fs_entry)))
+        {
+            LOG_MSG_ERROR("Failed to retrieve Hash FS entry #%u!", i);
+            goto end;
+        }
+
+        /* Skip entries with no hashed region. */
+        if (!fs_entry->hash_target_size) continue;
+
+        /* Make sure the hashed region is located within the entry data. */
+        if (fs_entry->offset > data_size || fs_entry->size > (data_size - fs_entry->offset) || fs_entry->hash_target_offset > fs_entry->size || \
+            fs_entry->hash_target_size > (fs_entry->size - fs_entry->hash_target_offset))
+        {
+            LOG_MSG_ERROR("Invalid hashed region for Hash FS entry \"%s\" (%s partition).", fs_entry_name, ctx->name);
+            goto end;
+        }
+
+        HashFileSystemHashRegion *region = &(regions[region_count]);
+        memset(region, 0, sizeof(HashFileSystemHashRegion));
+
+        if (!(region->name = strdup(fs_entry_name)))
+        {
+            LOG_MSG_ERROR("Failed to duplicate Hash FS entry name!");
+            goto end;
+        }
+
+        region->offset = (ctx->offset + ctx->header_size + fs_entry->offset + fs_entry->hash_target_offset);
+        region->size = fs_entry->hash_target_size;
+        memcpy(region->hash, fs_entry->hash, sizeof(fs_entry->hash));
+        region->hfs_partition_type = ctx->type;
+        region->status = HashFileSystemHashStatus_Pending;
+        sha256ContextCreate(&(region->sha256_ctx));
+
+        region_count++;
+    }
+
+    success = true;
+
+end:
+    /* Keep every region added so far, so they can be freed later. */
+    verifier->region_count = region_count;
+
+    /* Sort hashed regions by offset. */
+    if (success && region_count > 1) qsort(verifier->regions, region_count, sizeof(HashFileSystemHashRegion), &hfsHashRegionSortFunction);
+
+    return success;
+}
+
+bool hfsUpdateHashVerifier(HashFileSystemHashVerifier *verifier, const void *data, u64 data_size, u64 offset)
+{
+    if (!verifier || !data || !data_size) return true;
+
+    const u8 *data_u8 = (const u8*)data;
+    u64 data_end = (offset + data_size);
+    u32 failed_count = verifier->failed_count;
+
+    for(u32 i = verifier->cur_region; i < verifier->region_count; i++)
+    {
+        HashFileSystemHashRegion *region = &(verifier->regions[i]);
+        if (region->offset >= data_end) break;
+        if (region->status != HashFileSystemHashStatus_Pending) continue;
+
+        u64 region_end = (region->offset + region->size), next_offset = (region->offset + region->processed_size);
+
+        /* Mark this region as skipped if the provided block doesn't pick up right where the previous one left off. */
+        if (next_offset < offset)
+        {
+            region->status = HashFileSystemHashStatus_Skipped;
+            verifier->skipped_count++;
+            continue;
+        }
+
+        /* Hash the portion of the region covered by the provided block. Regions may overlap each other. */
+        u64 chunk_end = MIN(region_end, data_end);
+        if (next_offset < chunk_end)
+        {
+            sha256ContextUpdate(&(region->sha256_ctx), data_u8 + (next_offset - offset), chunk_end - next_offset);
+            region->processed_size += (chunk_end - next_offset);
+        }
+
+        if (region->processed_size == region->size) hfsFinishHashRegion(verifier, region);
+    }
+
+    /* Skip all completed regions. */
+    while(verifier->cur_region < verifier->region_count && verifier->regions[verifier->cur_region].status != HashFileSystemHashStatus_Pending) verifier->cur_region++;
+
+    return (verifier->failed_count == failed_count);
+}
+
+bool hfsFinalizeHashVerifier(HashFileSystemHashVerifier *verifier)
+{
+    if (!verifier) return false;
+
+    for(u32 i = verifier->cur_region; i < verifier->region_count; i++)
+    {
+        HashFileSystemHashRegion *region = &(verifier->regions[i]);
+        if (region->status != HashFileSystemHashStatus_Pending) continue;
+
+        region->status = HashFileSystemHashStatus_Skipped;
+        verifier->skipped_count++;
+    }
+
+    verifier->cur_region = verifier->region_count;
+
+    LOG_MSG_DEBUG("Hash FS verification results: %u passed, %u failed, %u skipped.", verifier->passed_count, verifier->failed_count, verifier->skipped_count);
+
+    return !verifier->failed_count;
+}
+
+void hfsFreeHashVerifier(HashFileSystemHashVerifier *verifier)
+{
+    if (!verifier) return;
+
+    if (verifier->regions)
+    {
+        for(u32 i = 0; i < verifier->region_count; i++)
+        {
+            if (verifier->regions[i].name) free(verifier->regions[i].name);
+        }
+
+        free(verifier->regions);
+    }
+
+    memset(verifier, 0, sizeof(HashFileSystemHashVerifier));
+}
+
 bool hfsGetEntryIndexByName(HashFileSystemContext *ctx, const char *name, u32 *out_idx)
 {
     HashFileSystemEntry *fs_entry = NULL;
@@ -117,6 +374,14 @@ bool hfsGetEntryIndexByName(HashFileSystemContext *ctx, const char *name, u32 *o
     }
 
     ret = false;
+
+    /* Use the name index if we're dealing with a big enough partition. It's built right before the first lookup takes place. */
+    if (entry_count >= HFS_NAME_INDEX_MIN_ENTRY_COUNT && (ctx->name_index || hfsBuildNameIndex(ctx)))
+    {
+        ret = hfsLookupNameIndex(ctx, name, out_idx);
+        goto end;
+    }
+
     name_table_size = ((HashFileSystemHeader*)ctx->header)->name_table_size;
 
     for(u32 i = 0; i < entry_count; i++)
@@ -150,3 +415,127 @@ const char *hfsGetPartitionNameString(u8 hfs_partition_type)
     return ((hfs_partition_type > HashFileSystemPartitionType_None && hfs_partition_type < HashFileSystemPartitionType_Count) ? \
             g_hfsPartitionNames[HFS_PARTITION_NAME_INDEX(hfs_partition_type)] : NULL);
 }
+
+static bool hfsBuildNameIndex(HashFileSystemContext *ctx)
+{
+    u32 entry_count = hfsGetEntryCount(ctx), name_table_size = ((HashFileSystemHeader*)ctx->header)->name_table_size, capacity = 16, mask = 0;
+    char *name_table = hfsGetNameTable(ctx);
+    u32 *name_index = NULL;
+
+    /* Keep the load factor at or below 50%. */
+    while(capacity < (entry_count * 2)) capacity <<= 1;
+    mask = (capacity - 1);
+
+    if (!(name_index = malloc(capacity * sizeof(u32))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for Hash FS name index!");
+        return false;
+    }
+
+    /* Mark all slots as unused. */
+    for(u32 i = 0; i < capacity; i++) name_index[i] = UINT32_MAX;
+
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        HashFileSystemEntry *fs_entry = hfsGetEntryByIndex(ctx, i);
+        if (!fs_entry || fs_entry->name_offset >= name_table_size)
+        {
+            /* Let the linear scan report the actual error. */
+            free(name_index);
+            return false;
+        }
+
+        /* Use linear probing. The load factor guarantees we'll always find a free slot. */
+        u32 slot = (hfsCalculateNameHash(name_table + fs_entry->name_offset) & mask);
+        while(name_index[slot] != UINT32_MAX) slot = ((slot + 1) & mask);
+
+        name_index[slot] = i;
+    }
+
+    ctx->name_index = name_index;
+    ctx->name_index_capacity = capacity;
+
+    return true;
+}
+
+static bool hfsLookupNameIndex(HashFileSystemContext *ctx, const char *name, u32 *out_idx)
+{
+    u32 mask = (ctx->name_index_capacity - 1);
+    char *name_table = hfsGetNameTable(ctx);
+
+    for(u32 slot = (hfsCalculateNameHash(name) & mask); ctx->name_index[slot] != UINT32_MAX; slot = ((slot + 1) & mask))
+    {
+        u32 idx = ctx->name_index[slot];
+        HashFileSystemEntry *fs_entry = hfsGetEntryByIndex(ctx, idx);
+
+        if (fs_entry && !strcmp(name_table + fs_entry->name_offset, name))
+        {
+            *out_idx = idx;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+NX_INLINE u32 hfsCalculateNameHash(const char *name)
+{
+    /* FNV-1a. */
+    u32 hash = 0x811C9DC5;
+
+    for(; *name; name++)
+    {
+        hash ^= (u8)*name;
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+static void hfsFinishHashRegion(HashFileSystemHashVerifier *verifier, HashFileSystemHashRegion *region)
+{
+    u8 hash[SHA256_HASH_SIZE] = {0};
+
+    sha256ContextGetHash(&(region->sha256_ctx), hash);
+
+    if (!memcmp(hash, region->hash, SHA256_HASH_SIZE))
+    {
+        region->status = HashFileSystemHashStatus_Passed;
+        verifier->passed_count++;
+    } else {
+        LOG_MSG_ERROR("Hash mismatch for Hash FS entry \"%s\" (%s partition)!", region->name, hfsGetPartitionNameString(region->hfs_partition_type));
+        region->status = HashFileSystemHashStatus_Failed;
+        verifier->failed_count++;
+    }
+}
+
+static int hfsReadPlanEntrySortFunction(const void *a, const void *b)
+{
+    const HashFileSystemReadPlanEntry *plan_entry_1 = (const HashFileSystemReadPlanEntry*)a;
+    const HashFileSystemReadPlanEntry *plan_entry_2 = (const HashFileSystemReadPlanEntry*)b;
+
+    /* Place empty entries first. */
+    if (!plan_entry_1->size && plan_entry_2->size)
+    {
+        return -1;
+    } else
+    if (plan_entry_1->size && !plan_entry_2->size)
+    {
+        return 1;
+    } else
+    if (plan_entry_1->size && plan_entry_1->offset != plan_entry_2->offset)
+    {
+        return (plan_entry_1->offset < plan_entry_2->offset ? -1 : 1);
+    }
+
+    /* Keep Hash FS entry table order for ties. */
+    return (plan_entry_1->entry_idx < plan_entry_2->entry_idx ? -1 : (plan_entry_1->entry_idx > plan_entry_2->entry_idx ? 1 : 0));
+}
+
+static int hfsHashRegionSortFunction(const void *a, const void *b)
+{
+    const HashFileSystemHashRegion *region_1 = (const HashFileSystemHashRegion*)a;
+    const HashFileSystemHashRegion *region_2 = (const HashFileSystemHashRegion*)b;
+
+    return (region_1->offset < region_2->offset ? -1 : (region_1->offset > region_2->offset ? 1 : 0));
+}
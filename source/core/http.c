@@ -22,11 +22,62 @@
 #include <core/nxdt_utils.h>
 #include <core/http.h>
 
+#define HTTP_RANGED_SEGMENT_COUNT       4           /* Number of concurrent ranged requests used by httpDownloadFileRanged(). */
+#define HTTP_RANGED_MIN_SIZE            0x100000    /* 1 MiB. Smaller files are downloaded using a single request. */
+#define HTTP_RANGED_MAX_RETRIES         5           /* Per segment. Retried requests resume from the last byte written by the segment. */
+#define HTTP_RANGED_STATE_INTERVAL      1000000000  /* 1 second. Minimum time between state file updates. */
+#define HTTP_RANGED_POLL_TIMEOUT        100         /* 100 ms. */
+
+#define HTTP_RANGED_STATE_MAGIC         0x53524E48  /* "HNRS". */
+#define HTTP_RANGED_STATE_EXT           ".state"
+
+/* Type definitions. */
+
+typedef struct {
+    u64 start;      ///< Segment start offset.
+    u64 end;        ///< Segment end offset (exclusive).
+    u64 offset;     ///< Current segment offset. Data up to this point has already been written.
+} HttpRangedSegmentState;
+
+/// Sidecar state file written next to the output file by httpDownloadFileRanged().
+typedef struct {
+    u32 magic;                                                      ///< HTTP_RANGED_STATE_MAGIC.
+    u32 segment_count;
+    u64 total_size;
+    u8 url_hash[SHA256_HASH_SIZE];                                  ///< SHA-256 checksum calculated over the download URL.
+    HttpRangedSegmentState segments[HTTP_RANGED_SEGMENT_COUNT];
+} HttpRangedState;
+
+typedef struct {
+    HttpRangedSegmentState *state;
+    FILE *fd;
+    CURL *curl;
+    u32 retries;
+    bool failed;
+} HttpRangedSegment;
+
 /* Global variables. */
 
 static Mutex g_httpMutex = 0;
 static bool g_httpInterfaceInit = false;
 
+/* Function prototypes. */
+
+static CURL *httpCreateCurlHandle(const char *url, bool force_https, char *curl_err_buf);
+static void httpLogCurlError(CURLcode res, char *curl_err_buf);
+
+static bool httpGetRemoteFileProperties(const char *url, bool force_https, u64 *out_size, bool *out_accept_ranges);
+static size_t httpHeadHeaderCallback(char *buffer, size_t size, size_t nitems, void *userdata);
+
+static bool httpPerformRangedDownload(const char *path, const char *url, bool force_https, u64 total_size, HttpProgressCallback progress_cb, void *progress_ptr);
+static bool httpStartRangedSegmentRequest(CURLM *multi, HttpRangedSegment *segment, const char *url, bool force_https, char *curl_err_buf);
+static size_t httpWriteRangedSegmentCallback(char *buffer, size_t size, size_t nitems, void *outstream);
+
+static bool httpLoadRangedState(const char *state_path, HttpRangedState *state, const char *path, const char *url, u64 total_size);
+static void httpSaveRangedState(const char *state_path, const HttpRangedState *state);
+
+static bool httpVerifyDownloadedFile(const char *path, u64 expected_size, const u8 *expected_sha256);
+
 bool httpInitialize(void)
 {
     bool ret = false;
@@ -105,30 +156,10 @@ bool httpPerformGetRequest(const char *url, bool force_https, size_t *outsize, H
         long http_code = 0;
         curl_off_t download_size = 0, content_length = 0;
         char curl_err_buf[CURL_ERROR_SIZE] = {0};
-        const char *error_str = NULL;
 
         /* Start CURL session. */
-        curl = curl_easy_init();
-        if (!curl)
-        {
-            LOG_MSG_ERROR("Failed to start CURL session for \"%s\"!", url);
-            break;
-        }
-
-        /* Set CURL options. */
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, HTTP_USER_AGENT);
-        curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_err_buf);
-        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-        curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 50L);
-        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
-        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, HTTP_CONNECT_TIMEOUT);
-        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, HTTP_LOW_SPEED_LIMIT);
-        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, HTTP_LOW_SPEED_TIME);
-        curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, HTTP_BUFFER_SIZE);
-        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)(force_https ? CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_1_1));
+        curl = httpCreateCurlHandle(url, force_https, curl_err_buf);
+        if (!curl) break;
 
         if (write_cb) curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
         if (write_ptr) curl_easy_setopt(curl, CURLOPT_WRITEDATA, write_ptr);
@@ -160,23 +191,7 @@ bool httpPerformGetRequest(const char *url, bool force_https, size_t *outsize, H
             if (outsize) *outsize = (size_t)download_size;
         } else {
             LOG_MSG_ERROR("curl_easy_perform failed for \"%s\"! (res %d, HTTP code %ld, download %ld, length %ld).", url, res, http_code, download_size, content_length);
-            if (res != CURLE_OK)
-            {
-                /* Log CURL error info. */
-                if (*curl_err_buf)
-                {
-                    size_t curl_err_buf_len = strlen(curl_err_buf);
-
-                    if (curl_err_buf[curl_err_buf_len - 1] == '\n') curl_err_buf[--curl_err_buf_len] = '\0';
-                    if (curl_err_buf[curl_err_buf_len - 1] == '\r') curl_err_buf[--curl_err_buf_len] = '\0';
-
-                    error_str = curl_err_buf;
-                } else {
-                    error_str = curl_easy_strerror(res);
-                }
-
-                if (error_str) LOG_MSG_INFO("CURL error info: \"%s\".", error_str);
-            }
+            if (res != CURLE_OK) httpLogCurlError(res, curl_err_buf);
         }
     }
 
@@ -240,3 +255,514 @@ char *httpDownloadData(size_t *outsize, const char *url, bool force_https, HttpP
 
     return http_buffer.data;
 }
+
+bool httpDownloadFileRanged(const char *path, const char *url, bool force_https, u64 expected_size, const u8 *expected_sha256, HttpProgressCallback progress_cb, void *progress_ptr)
+{
+    if (!path || !*path || !url || !*url)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u64 remote_size = 0, total_size = 0;
+    bool accept_ranges = false, ret = false;
+
+    /* Retrieve the remote file size, and check if the server supports ranged requests. */
+    if (httpGetRemoteFileProperties(url, force_https, &remote_size, &accept_ranges))
+    {
+        if (expected_size && remote_size && remote_size != expected_size)
+        {
+            LOG_MSG_ERROR("Remote file size for \"%s\" doesn't match the expected size! (0x%lX != 0x%lX).", url, remote_size, expected_size);
+            return false;
+        }
+
+        total_size = (expected_size ? expected_size : remote_size);
+    }
+
+    if (total_size >= HTTP_RANGED_MIN_SIZE && accept_ranges)
+    {
+        /* Perform ranged download. Incomplete output files are kept around alongside their state file, so the download can be resumed. */
+        ret = httpPerformRangedDownload(path, url, force_https, total_size, progress_cb, progress_ptr);
+    } else {
+        /* Fall back to a single request. */
+        LOG_MSG_DEBUG("Ranged requests unavailable for \"%s\" (size 0x%lX, ranges %u). Using a single request.", url, total_size, accept_ranges);
+        ret = httpDownloadFile(path, url, force_https, progress_cb, progress_ptr);
+    }
+
+    /* Verify downloaded file. */
+    if (ret && !(ret = httpVerifyDownloadedFile(path, expected_size, expected_sha256)))
+    {
+        remove(path);
+        utilsCommitSdCardFileSystemChanges();
+    }
+
+    return ret;
+}
+
+static CURL *httpCreateCurlHandle(const char *url, bool force_https, char *curl_err_buf)
+{
+    CURL *curl = curl_easy_init();
+    if (!curl)
+    {
+        LOG_MSG_ERROR("Failed to start CURL session for \"%s\"!", url);
+        return NULL;
+    }
+
+    /* Set CURL options. */
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, HTTP_USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_err_buf);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 50L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, HTTP_CONNECT_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, HTTP_LOW_SPEED_LIMIT);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, HTTP_LOW_SPEED_TIME);
+    curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, HTTP_BUFFER_SIZE);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)(force_https ? CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_1_1));
+
+    return curl;
+}
+
+static void httpLogCurlError(CURLcode res, char *curl_err_buf)
+{
+    const char *error_str = NULL;
+
+    /* Log CURL error info. */
+    if (*curl_err_buf)
+    {
+        size_t curl_err_buf_len = strlen(curl_err_buf);
+
+        if (curl_err_buf[curl_err_buf_len - 1] == '\n') curl_err_buf[--curl_err_buf_len] = '\0';
+        if (curl_err_buf[curl_err_buf_len - 1] == '\r') curl_err_buf[--curl_err_buf_len] = '\0';
+
+        error_str = curl_err_buf;
+    } else {
+        error_str = curl_easy_strerror(res);
+    }
+
+    if (error_str) LOG_MSG_INFO("CURL error info: \"%s\".", error_str);
+}
+
+static bool httpGetRemoteFileProperties(const char *url, bool force_https, u64 *out_size, bool *out_accept_ranges)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_httpMutex)
+    {
+        if (!g_httpInterfaceInit) break;
+
+        CURL *curl = NULL;
+        CURLcode res = CURLE_OK;
+        long http_code = 0;
+        curl_off_t content_length = 0;
+        char curl_err_buf[CURL_ERROR_SIZE] = {0};
+        bool accept_ranges = false;
+
+        /* Start CURL session. */
+        curl = httpCreateCurlHandle(url, force_https, curl_err_buf);
+        if (!curl) break;
+
+        /* Perform HEAD request. Headers from redirect responses are reset by the header callback. */
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, httpHeadHeaderCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &accept_ranges);
+
+        res = curl_easy_perform(curl);
+
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+
+        curl_easy_cleanup(curl);
+
+        ret = (res == CURLE_OK && http_code >= 200 && http_code <= 299);
+        if (ret)
+        {
+            *out_size = (content_length > 0 ? (u64)content_length : 0);
+            *out_accept_ranges = accept_ranges;
+        } else {
+            LOG_MSG_ERROR("HEAD request failed for \"%s\"! (res %d, HTTP code %ld).", url, res, http_code);
+            if (res != CURLE_OK) httpLogCurlError(res, curl_err_buf);
+        }
+    }
+
+    return ret;
+}
+
+static size_t httpHeadHeaderCallback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    size_t total_size = (size * nitems);
+    bool *accept_ranges = (bool*)userdata;
+
+    /* Status lines mark the start of a new response (e.g. after a redirect). */
+    if (total_size >= 5 && !strncmp(buffer, "HTTP/", 5))
+    {
+        *accept_ranges = false;
+    } else
+    if (total_size >= 20 && !strncasecmp(buffer, "accept-ranges: bytes", 20))
+    {
+        *accept_ranges = true;
+    }
+
+    return total_size;
+}
+
+static bool httpPerformRangedDownload(const char *path, const char *url, bool force_https, u64 total_size, HttpProgressCallback progress_cb, void *progress_ptr)
+{
+    char *state_path = NULL;
+    HttpRangedState state = {0};
+    HttpRangedSegment segments[HTTP_RANGED_SEGMENT_COUNT] = {0};
+    char curl_err_buf[HTTP_RANGED_SEGMENT_COUNT][CURL_ERROR_SIZE] = {0};
+    CURLM *multi = NULL;
+    FILE *fd = NULL;
+    bool resume = false, cancelled = false, ret = false;
+
+    /* Generate state file path. */
+    size_t state_path_size = (strlen(path) + sizeof(HTTP_RANGED_STATE_EXT));
+    if (!(state_path = malloc(state_path_size)))
+    {
+        LOG_MSG_ERROR("Failed to generate state file path for \"%s\"!", path);
+        return false;
+    }
+
+    snprintf(state_path, state_path_size, "%s" HTTP_RANGED_STATE_EXT, path);
+
+    SCOPED_LOCK(&g_httpMutex)
+    {
+        if (!g_httpInterfaceInit) break;
+
+        /* Check if we can resume a previous download. */
+        resume = httpLoadRangedState(state_path, &state, path, url, total_size);
+        if (resume)
+        {
+            LOG_MSG_INFO("Resuming download for \"%s\".", url);
+        } else {
+            /* Split the file into equally sized segments. */
+            u64 segment_size = ALIGN_UP(total_size / HTTP_RANGED_SEGMENT_COUNT, 0x1000);
+
+            memset(&state, 0, sizeof(HttpRangedState));
+            state.magic = HTTP_RANGED_STATE_MAGIC;
+            state.segment_count = HTTP_RANGED_SEGMENT_COUNT;
+            state.total_size = total_size;
+            sha256CalculateHash(state.url_hash, url, strlen(url));
+
+            for(u32 i = 0; i < HTTP_RANGED_SEGMENT_COUNT; i++)
+            {
+                HttpRangedSegmentState *seg_state = &(state.segments[i]);
+                seg_state->start = seg_state->offset = MIN(i * segment_size, total_size);
+                seg_state->end = (i == (HTTP_RANGED_SEGMENT_COUNT - 1) ? total_size : MIN((i + 1) * segment_size, total_size));
+            }
+        }
+
+        /* Open output file. Preallocate it if we're starting from scratch, which lets each segment write at its own offset. */
+        fd = fopen(path, resume ? "r+b" : "wb");
+        if (!fd)
+        {
+            LOG_MSG_ERROR("Failed to open \"%s\" for writing!", path);
+            break;
+        }
+
+        if (!resume && ftruncate(fileno(fd), (off_t)total_size) != 0)
+        {
+            LOG_MSG_ERROR("Failed to preallocate 0x%lX bytes for \"%s\"! (%d).", total_size, path, errno);
+            break;
+        }
+
+        /* Start CURL multi session. */
+        if (!(multi = curl_multi_init()))
+        {
+            LOG_MSG_ERROR("Failed to start CURL multi session for \"%s\"!", url);
+            break;
+        }
+
+        /* Start a ranged request for each incomplete segment. All of them are driven by the current thread. */
+        bool success = true;
+
+        for(u32 i = 0; i < HTTP_RANGED_SEGMENT_COUNT; i++)
+        {
+            HttpRangedSegment *segment = &(segments[i]);
+            segment->state = &(state.segments[i]);
+            segment->fd = fd;
+
+            if (segment->state->offset < segment->state->end && !(success = httpStartRangedSegmentRequest(multi, segment, url, force_https, curl_err_buf[i]))) break;
+        }
+
+        if (!success) break;
+
+        u64 last_state_tick = armGetSystemTick();
+        int running = 0;
+
+        do {
+            CURLMcode mc = curl_multi_perform(multi, &running);
+            if (mc != CURLM_OK)
+            {
+                LOG_MSG_ERROR("curl_multi_perform failed for \"%s\"! (%d).", url, mc);
+                success = false;
+                break;
+            }
+
+            /* Check finished requests. */
+            CURLMsg *msg = NULL;
+            int msg_count = 0;
+
+            while((msg = curl_multi_info_read(multi, &msg_count)))
+            {
+                if (msg->msg != CURLMSG_DONE) continue;
+
+                HttpRangedSegment *segment = NULL;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&segment);
+
+                u32 idx = (u32)(segment - segments);
+                CURLcode res = msg->data.result;
+
+                curl_multi_remove_handle(multi, segment->curl);
+                curl_easy_cleanup(segment->curl);
+                segment->curl = NULL;
+
+                if (segment->state->offset >= segment->state->end) continue;
+
+                /* Retry incomplete segments from their current offset. */
+                LOG_MSG_WARNING("Segment #%u for \"%s\" stopped at 0x%lX (end 0x%lX, res %d).", idx, url, segment->state->offset, segment->state->end, res);
+                if (res != CURLE_OK) httpLogCurlError(res, curl_err_buf[idx]);
+
+                if (segment->failed || ++(segment->retries) > HTTP_RANGED_MAX_RETRIES || !httpStartRangedSegmentRequest(multi, segment, url, force_https, curl_err_buf[idx]))
+                {
+                    success = false;
+                    break;
+                }
+
+                running++;
+            }
+
+            if (!success) break;
+
+            /* Update progress. */
+            if (progress_cb)
+            {
+                u64 downloaded = 0;
+                for(u32 i = 0; i < HTTP_RANGED_SEGMENT_COUNT; i++) downloaded += (state.segments[i].offset - state.segments[i].start);
+
+                if (progress_cb(progress_ptr, (curl_off_t)total_size, (curl_off_t)downloaded, 0, 0) != 0)
+                {
+                    cancelled = success = true;
+                    break;
+                }
+            }
+
+            /* Periodically flush the output file and update the state file. */
+            if (armTicksToNs(armGetSystemTick() - last_state_tick) >= HTTP_RANGED_STATE_INTERVAL)
+            {
+                fflush(fd);
+                httpSaveRangedState(state_path, &state);
+                last_state_tick = armGetSystemTick();
+            }
+
+            if (running) curl_multi_poll(multi, NULL, 0, HTTP_RANGED_POLL_TIMEOUT, NULL);
+        } while(running);
+
+        /* Check if all segments are complete. */
+        ret = (success && !cancelled);
+        for(u32 i = 0; ret && i < HTTP_RANGED_SEGMENT_COUNT; i++) ret = (state.segments[i].offset == state.segments[i].end);
+    }
+
+    /* Clean up CURL handles. */
+    for(u32 i = 0; i < HTTP_RANGED_SEGMENT_COUNT; i++)
+    {
+        if (!segments[i].curl) continue;
+        if (multi) curl_multi_remove_handle(multi, segments[i].curl);
+        curl_easy_cleanup(segments[i].curl);
+    }
+
+    if (multi) curl_multi_cleanup(multi);
+
+    if (fd)
+    {
+        fclose(fd);
+
+        /* Save the state file if the download didn't finish, so it can be resumed later. Delete it otherwise. */
+        if (ret)
+        {
+            remove(state_path);
+        } else {
+            httpSaveRangedState(state_path, &state);
+        }
+
+        utilsCommitSdCardFileSystemChanges();
+    }
+
+    free(state_path);
+
+    return ret;
+}
+
+static bool httpStartRangedSegmentRequest(CURLM *multi, HttpRangedSegment *segment, const char *url, bool force_https, char *curl_err_buf)
+{
+    char range[0x40] = {0};
+
+    *curl_err_buf = '\0';
+
+    if (!(segment->curl = httpCreateCurlHandle(url, force_https, curl_err_buf))) return false;
+
+    snprintf(range, sizeof(range), "%lu-%lu", segment->state->offset, segment->state->end - 1);
+
+    curl_easy_setopt(segment->curl, CURLOPT_RANGE, range);
+    curl_easy_setopt(segment->curl, CURLOPT_WRITEFUNCTION, httpWriteRangedSegmentCallback);
+    curl_easy_setopt(segment->curl, CURLOPT_WRITEDATA, segment);
+    curl_easy_setopt(segment->curl, CURLOPT_PRIVATE, segment);
+
+    if (curl_multi_add_handle(multi, segment->curl) != CURLM_OK)
+    {
+        LOG_MSG_ERROR("Failed to add ranged request for \"%s\" (%s)!", url, range);
+        curl_easy_cleanup(segment->curl);
+        segment->curl = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+static size_t httpWriteRangedSegmentCallback(char *buffer, size_t size, size_t nitems, void *outstream)
+{
+    size_t total_size = (size * nitems);
+    HttpRangedSegment *segment = (HttpRangedSegment*)outstream;
+    long http_code = 0;
+
+    if (!total_size) return 0;
+
+    /* Servers that ignore our range request reply with the whole file. Bail out if that's the case. */
+    curl_easy_getinfo(segment->curl, CURLINFO_RESPONSE_CODE, &http_code);
+    if (http_code != 206 || (segment->state->offset + total_size) > segment->state->end)
+    {
+        LOG_MSG_ERROR("Unexpected ranged response! (HTTP code %ld, offset 0x%lX, size 0x%lX, end 0x%lX).", http_code, segment->state->offset, total_size, segment->state->end);
+        segment->failed = true;
+        return 0;
+    }
+
+    /* All segments are driven by the same thread, so they can safely share the same file stream. */
+    if (fseek(segment->fd, (long)segment->state->offset, SEEK_SET) != 0 || fwrite(buffer, 1, total_size, segment->fd) != total_size)
+    {
+        LOG_MSG_ERROR("Failed to write 0x%lX bytes at offset 0x%lX!", total_size, segment->state->offset);
+        segment->failed = true;
+        return 0;
+    }
+
+    segment->state->offset += total_size;
+
+    return total_size;
+}
+
+static bool httpLoadRangedState(const char *state_path, HttpRangedState *state, const char *path, const char *url, u64 total_size)
+{
+    FILE *fd = NULL;
+    struct stat st = {0};
+    u8 url_hash[SHA256_HASH_SIZE] = {0};
+    bool ret = false;
+
+    /* The output file must still be around, and it must have been preallocated. */
+    if (stat(path, &st) != 0 || (u64)st.st_size != total_size) return false;
+
+    if (!(fd = fopen(state_path, "rb"))) return false;
+
+    ret = (fread(state, 1, sizeof(HttpRangedState), fd) == sizeof(HttpRangedState));
+
+    fclose(fd);
+
+    if (!ret) return false;
+
+    /* Make sure the state file matches the current download. */
+    sha256CalculateHash(url_hash, url, strlen(url));
+
+    ret = (state->magic == HTTP_RANGED_STATE_MAGIC && state->segment_count == HTTP_RANGED_SEGMENT_COUNT && state->total_size == total_size && \
+           !memcmp(state->url_hash, url_hash, SHA256_HASH_SIZE));
+
+    for(u32 i = 0; ret && i < HTTP_RANGED_SEGMENT_COUNT; i++)
+    {
+        const HttpRangedSegmentState *seg_state = &(state->segments[i]);
+        ret = (seg_state->start <= seg_state->offset && seg_state->offset <= seg_state->end && seg_state->end <= total_size);
+    }
+
+    if (!ret) LOG_MSG_WARNING("Discarding stale download state file \"%s\".", state_path);
+
+    return ret;
+}
+
+static void httpSaveRangedState(const char *state_path, const HttpRangedState *state)
+{
+    FILE *fd = fopen(state_path, "wb");
+    if (!fd)
+    {
+        LOG_MSG_ERROR("Failed to open \"%s\" for writing!", state_path);
+        return;
+    }
+
+    if (fwrite(state, 1, sizeof(HttpRangedState), fd) != sizeof(HttpRangedState)) LOG_MSG_ERROR("Failed to write download state file \"%s\"!", state_path);
+
+    fclose(fd);
+}
+
+static bool httpVerifyDownloadedFile(const char *path, u64 expected_size, const u8 *expected_sha256)
+{
+    FILE *fd = NULL;
+    u8 *buf = NULL, hash[SHA256_HASH_SIZE] = {0};
+    u64 file_size = 0;
+    size_t read_size = 0;
+    Sha256Context sha256_ctx = {0};
+    bool ret = false;
+
+    if (!expected_size && !expected_sha256) return true;
+
+    if (!(fd = fopen(path, "rb")))
+    {
+        LOG_MSG_ERROR("Failed to open \"%s\" for reading!", path);
+        return false;
+    }
+
+    if (expected_sha256 && !(buf = malloc(HTTP_BUFFER_SIZE)))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the hash buffer!");
+        goto end;
+    }
+
+    sha256ContextCreate(&sha256_ctx);
+
+    /* Calculate the file size and its checksum at the same time. */
+    if (buf)
+    {
+        while((read_size = fread(buf, 1, HTTP_BUFFER_SIZE, fd)) > 0)
+        {
+            sha256ContextUpdate(&sha256_ctx, buf, read_size);
+            file_size += read_size;
+        }
+    } else {
+        fseek(fd, 0, SEEK_END);
+        file_size = (u64)ftell(fd);
+    }
+
+    if (expected_size && file_size != expected_size)
+    {
+        LOG_MSG_ERROR("Size mismatch for \"%s\"! (0x%lX != 0x%lX).", path, file_size, expected_size);
+        goto end;
+    }
+
+    if (expected_sha256)
+    {
+        sha256ContextGetHash(&sha256_ctx, hash);
+
+        if (memcmp(hash, expected_sha256, SHA256_HASH_SIZE) != 0)
+        {
+            LOG_MSG_ERROR("SHA-256 checksum mismatch for \"%s\"!", path);
+            goto end;
+        }
+    }
+
+    ret = true;
+
+end:
+    if (buf) free(buf);
+
+    fclose(fd);
+
+    return ret;
+}
@@ -31,6 +31,11 @@
 
 #define ETICKET_RSA_DEVICE_KEY_PUBLIC_EXPONENT  0x10001
 
+#define KEYS_FILE_MAX_SIZE                      0x100000    /* Keys files hold a few hundred lines at most. */
+
+#define KEYSET_CACHE_MAGIC                      0x4B534554  /* "KSET". */
+#define KEYSET_CACHE_VERSION                    1
+
 /* Type definitions. */
 
 typedef struct {
@@ -82,6 +87,39 @@ typedef struct {
 
 NXDT_ASSERT(EticketRsaDeviceKey, 0x240);
 
+typedef enum {
+    KeysetCacheUnitFlags_DevelopmentUnit = BIT(0),
+    KeysetCacheUnitFlags_MarikoUnit      = BIT(1)
+} KeysetCacheUnitFlags;
+
+/// Derived keyset cache file layout:
+///     - KeysetCacheHeader.
+///     - KeysetCachePayload, encrypted using AES-128-CTR.
+/// Both the AES key and the HMAC-SHA256 key are derived from console-unique data. See keysGenerateKeysetCacheKeys().
+typedef struct {
+    u32 magic;                          ///< KEYSET_CACHE_MAGIC.
+    u32 version;                        ///< KEYSET_CACHE_VERSION.
+    u32 payload_size;                   ///< Must match sizeof(KeysetCachePayload).
+    u32 eticket_rsa_key_generation;
+    u8 ams_key_generation;
+    u8 hos_key_generation;
+    u8 current_master_key_index;
+    u8 unit_flags;                      ///< KeysetCacheUnitFlags.
+    u8 keys_file_hash[SHA256_HASH_SIZE];
+    u8 reserved[0xC];
+    u8 ctr[AES_128_KEY_SIZE];
+    u8 mac[SHA256_HASH_SIZE];           ///< HMAC-SHA256 calculated over the rest of the header and the encrypted payload.
+} KeysetCacheHeader;
+
+NXDT_ASSERT(KeysetCacheHeader, 0x70);
+
+typedef struct {
+    KeysNxKeyset keyset;
+    u8 tsec_root_key_available;
+    u8 mariko_kek_available;
+    u8 reserved[0xE];
+} KeysetCachePayload;
+
 /* Function prototypes. */
 
 NX_INLINE u8 keysGetHorizonOsKeyGeneration(void);
@@ -92,6 +130,13 @@ static int keysGetKeyAndValueFromFile(FILE *f, char **line, char **key, char **v
 static bool keysParseHexKey(u8 *out, size_t out_size, const char *key, const char *value);
 static bool keysReadKeysFromFile(void);
 
+static bool keysCalculateKeysFileHash(u8 *out_hash);
+static void keysGenerateKeysetCacheKeys(u8 *out_aes_key, u8 *out_mac_key);
+static void keysGenerateKeysetCacheHeader(KeysetCacheHeader *out, const u8 *keys_file_hash);
+static void keysCalculateKeysetCacheMac(u8 *out_mac, const u8 *mac_key, const KeysetCacheHeader *header, const KeysetCachePayload *enc_payload);
+static bool keysLoadKeysetCache(const u8 *keys_file_hash);
+static void keysSaveKeysetCache(const u8 *keys_file_hash);
+
 static bool keysDeriveMasterKeys(void);
 static bool keysDeriveCurrentMasterKey(void);
 static bool keysDeriveNcaHeaderKey(void);
@@ -146,6 +191,9 @@ static bool g_tsecRootKeyAvailable = false, g_marikoKekAvailable = false;
 
 static bool g_wipedSetCal = false;
 
+static const char *g_keysetCacheAesKeySalt = "nxdt derived keyset cache aes key";
+static const char *g_keysetCacheMacKeySalt = "nxdt derived keyset cache mac key";
+
 bool keysLoadKeyset(void)
 {
     bool ret = false;
@@ -183,23 +231,34 @@ bool keysLoadKeyset(void)
             break;
         }
 
-        /* Read data from the keys file. */
-        if (!keysReadKeysFromFile()) break;
+        /* Calculate the keys file checksum. It's used to validate the derived keyset cache. */
+        u8 keys_file_hash[SHA256_HASH_SIZE] = {0};
+        bool keys_file_hash_available = keysCalculateKeysFileHash(keys_file_hash);
 
-        /* Derive master keys. */
-        if (!keysDeriveMasterKeys()) break;
+        /* Try to load the derived keyset cache first. This lets us skip keys file parsing and key derivation altogether. */
+        if (!keys_file_hash_available || !keysLoadKeysetCache(keys_file_hash))
+        {
+            /* Read data from the keys file. */
+            if (!keysReadKeysFromFile()) break;
 
-        /* Derive NCA header key. */
-        if (!keysDeriveNcaHeaderKey()) break;
+            /* Derive master keys. */
+            if (!keysDeriveMasterKeys()) break;
 
-        /* Derive per-generation keys. */
-        if (!keysDerivePerGenerationKeys()) break;
+            /* Derive NCA header key. */
+            if (!keysDeriveNcaHeaderKey()) break;
 
-        /* Derive gamecard CardInfo key */
-        if (!keysDeriveGcCardInfoKey())
-        {
-            LOG_MSG_ERROR("Failed to derive gamecard CardInfo key!");
-            break;
+            /* Derive per-generation keys. */
+            if (!keysDerivePerGenerationKeys()) break;
+
+            /* Derive gamecard CardInfo key */
+            if (!keysDeriveGcCardInfoKey())
+            {
+                LOG_MSG_ERROR("Failed to derive gamecard CardInfo key!");
+                break;
+            }
+
+            /* Update derived keyset cache. This must be done before decrypting the eTicket RSA device key. */
+            if (keys_file_hash_available) keysSaveKeysetCache(keys_file_hash);
         }
 
         /* Get decrypted eTicket RSA device key. */
@@ -692,6 +751,220 @@ static bool keysReadKeysFromFile(void)
     return true;
 }
 
+static bool keysCalculateKeysFileHash(u8 *out_hash)
+{
+    FILE *keys_file = NULL;
+    char *buf = NULL;
+    u64 size = 0;
+    bool success = false;
+
+    const char *keys_file_path = (utilsIsDevelopmentUnit() ? DEV_KEYS_FILE_PATH : PROD_KEYS_FILE_PATH);
+
+    keys_file = fopen(keys_file_path, "rb");
+    if (!keys_file)
+    {
+        LOG_MSG_ERROR("Unable to open \"%s\" to calculate its checksum!", keys_file_path);
+        return false;
+    }
+
+    /* Get keys file size. */
+    fseek(keys_file, 0, SEEK_END);
+    size = ftell(keys_file);
+    rewind(keys_file);
+
+    if (!size || size > KEYS_FILE_MAX_SIZE)
+    {
+        LOG_MSG_ERROR("Invalid size for \"%s\"! (0x%lX).", keys_file_path, size);
+        goto end;
+    }
+
+    /* Read the whole file and hash it. */
+    if (!(buf = malloc(size)) || fread(buf, 1, size, keys_file) != size)
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes from \"%s\"!", size, keys_file_path);
+        goto end;
+    }
+
+    sha256CalculateHash(out_hash, buf, size);
+
+    success = true;
+
+end:
+    if (buf) free(buf);
+
+    fclose(keys_file);
+
+    return success;
+}
+
+static void keysGenerateKeysetCacheKeys(u8 *out_aes_key, u8 *out_mac_key)
+{
+    u8 tmp[SHA256_HASH_SIZE] = {0};
+
+    /* Both keys are derived from the eTicket RSA device key as stored in PRODINFO, which ties the cache to the current console. */
+    /* This must be called before the eTicket RSA device key is decrypted. */
+    hmacSha256CalculateMac(tmp, g_keysetCacheAesKeySalt, strlen(g_keysetCacheAesKeySalt), g_eTicketRsaDeviceKey.key, sizeof(g_eTicketRsaDeviceKey.key));
+    memcpy(out_aes_key, tmp, AES_128_KEY_SIZE);
+
+    hmacSha256CalculateMac(out_mac_key, g_keysetCacheMacKeySalt, strlen(g_keysetCacheMacKeySalt), g_eTicketRsaDeviceKey.key, sizeof(g_eTicketRsaDeviceKey.key));
+
+    memset(tmp, 0, sizeof(tmp));
+}
+
+static void keysGenerateKeysetCacheHeader(KeysetCacheHeader *out, const u8 *keys_file_hash)
+{
+    memset(out, 0, sizeof(KeysetCacheHeader));
+
+    out->magic = __builtin_bswap32(KEYSET_CACHE_MAGIC);
+    out->version = KEYSET_CACHE_VERSION;
+    out->payload_size = (u32)sizeof(KeysetCachePayload);
+    out->eticket_rsa_key_generation = g_eTicketRsaDeviceKey.generation;
+    out->ams_key_generation = g_atmosphereKeyGeneration;
+    out->hos_key_generation = g_hosKeyGeneration;
+    out->current_master_key_index = g_currentMasterKeyIndex;
+    out->unit_flags = ((utilsIsDevelopmentUnit() ? KeysetCacheUnitFlags_DevelopmentUnit : 0) | (utilsIsMarikoUnit() ? KeysetCacheUnitFlags_MarikoUnit : 0));
+    memcpy(out->keys_file_hash, keys_file_hash, SHA256_HASH_SIZE);
+}
+
+static void keysCalculateKeysetCacheMac(u8 *out_mac, const u8 *mac_key, const KeysetCacheHeader *header, const KeysetCachePayload *enc_payload)
+{
+    HmacSha256Context hmac_ctx = {0};
+
+    /* Covers the whole header (except for the MAC itself) as well as the encrypted payload. */
+    hmacSha256ContextCreate(&hmac_ctx, mac_key, SHA256_HASH_SIZE);
+    hmacSha256ContextUpdate(&hmac_ctx, header, offsetof(KeysetCacheHeader, mac));
+    hmacSha256ContextUpdate(&hmac_ctx, enc_payload, sizeof(KeysetCachePayload));
+    hmacSha256ContextGetMac(&hmac_ctx, out_mac);
+}
+
+static bool keysLoadKeysetCache(const u8 *keys_file_hash)
+{
+    FILE *fp = NULL;
+    KeysetCacheHeader header = {0}, expected_header = {0};
+    KeysetCachePayload payload = {0};
+    Aes128CtrContext aes_ctx = {0};
+    u8 aes_key[AES_128_KEY_SIZE] = {0}, mac_key[SHA256_HASH_SIZE] = {0}, mac[SHA256_HASH_SIZE] = {0};
+    bool success = false;
+
+    /* Open cache file. */
+    if (!(fp = fopen(KEYSET_CACHE_PATH, "rb")))
+    {
+        LOG_MSG_DEBUG("Derived keyset cache unavailable at \"" KEYSET_CACHE_PATH "\".");
+        return false;
+    }
+
+    /* Read cache data. */
+    if (fread(&header, 1, sizeof(KeysetCacheHeader), fp) != sizeof(KeysetCacheHeader) || fread(&payload, 1, sizeof(KeysetCachePayload), fp) != sizeof(KeysetCachePayload))
+    {
+        LOG_MSG_ERROR("Failed to read derived keyset cache!");
+        goto end;
+    }
+
+    /* Make sure the cache was generated from the current keys file, under the same console and system setup. */
+    /* Everything but the AES CTR and the MAC must match. */
+    keysGenerateKeysetCacheHeader(&expected_header, keys_file_hash);
+    memcpy(expected_header.ctr, header.ctr, sizeof(header.ctr));
+    memcpy(expected_header.mac, header.mac, sizeof(header.mac));
+
+    if (memcmp(&header, &expected_header, sizeof(KeysetCacheHeader)) != 0)
+    {
+        LOG_MSG_INFO("Derived keyset cache is outdated. Discarding it.");
+        goto end;
+    }
+
+    /* Authenticate cache data. */
+    keysGenerateKeysetCacheKeys(aes_key, mac_key);
+    keysCalculateKeysetCacheMac(mac, mac_key, &header, &payload);
+
+    if (memcmp(mac, header.mac, SHA256_HASH_SIZE) != 0)
+    {
+        LOG_MSG_ERROR("Derived keyset cache MAC mismatch! Discarding it.");
+        goto end;
+    }
+
+    /* Decrypt payload. */
+    aes128CtrContextCreate(&aes_ctx, aes_key, header.ctr);
+    aes128CtrCrypt(&aes_ctx, &payload, &payload, sizeof(KeysetCachePayload));
+
+    /* Update keyset. */
+    memcpy(&g_nxKeyset, &(payload.keyset), sizeof(KeysNxKeyset));
+    g_tsecRootKeyAvailable = payload.tsec_root_key_available;
+    g_marikoKekAvailable = payload.mariko_kek_available;
+
+    LOG_MSG_INFO("Loaded derived keyset from \"" KEYSET_CACHE_PATH "\".");
+
+    success = true;
+
+end:
+    memset(&payload, 0, sizeof(payload));
+    memset(&aes_ctx, 0, sizeof(aes_ctx));
+    memset(aes_key, 0, sizeof(aes_key));
+    memset(mac_key, 0, sizeof(mac_key));
+
+    fclose(fp);
+
+    return success;
+}
+
+static void keysSaveKeysetCache(const u8 *keys_file_hash)
+{
+    FILE *fp = NULL;
+    KeysetCacheHeader header = {0};
+    KeysetCachePayload payload = {0};
+    Aes128CtrContext aes_ctx = {0};
+    u8 aes_key[AES_128_KEY_SIZE] = {0}, mac_key[SHA256_HASH_SIZE] = {0};
+    bool write_ok = false;
+
+    /* Generate cache header. */
+    keysGenerateKeysetCacheHeader(&header, keys_file_hash);
+    randomGet(header.ctr, sizeof(header.ctr));
+
+    /* Generate cache payload. */
+    memcpy(&(payload.keyset), &g_nxKeyset, sizeof(KeysNxKeyset));
+    payload.tsec_root_key_available = g_tsecRootKeyAvailable;
+    payload.mariko_kek_available = g_marikoKekAvailable;
+
+    /* Encrypt payload, then calculate the MAC. */
+    keysGenerateKeysetCacheKeys(aes_key, mac_key);
+
+    aes128CtrContextCreate(&aes_ctx, aes_key, header.ctr);
+    aes128CtrCrypt(&aes_ctx, &payload, &payload, sizeof(KeysetCachePayload));
+
+    keysCalculateKeysetCacheMac(header.mac, mac_key, &header, &payload);
+
+    /* Write cache data to a temporary file, then replace the current cache file. */
+    utilsCreateDirectoryTree(KEYSET_CACHE_PATH, false);
+
+    if (!(fp = fopen(KEYSET_CACHE_TMP_PATH, "wb")))
+    {
+        LOG_MSG_ERROR("Failed to open \"" KEYSET_CACHE_TMP_PATH "\" for writing!");
+        goto end;
+    }
+
+    write_ok = (fwrite(&header, 1, sizeof(KeysetCacheHeader), fp) == sizeof(KeysetCacheHeader) && fwrite(&payload, 1, sizeof(KeysetCachePayload), fp) == sizeof(KeysetCachePayload));
+    fclose(fp);
+
+    if (!write_ok)
+    {
+        LOG_MSG_ERROR("Failed to write derived keyset cache!");
+        remove(KEYSET_CACHE_TMP_PATH);
+        goto end;
+    }
+
+    remove(KEYSET_CACHE_PATH);
+    rename(KEYSET_CACHE_TMP_PATH, KEYSET_CACHE_PATH);
+
+    utilsCommitSdCardFileSystemChanges();
+
+    LOG_MSG_DEBUG("Saved derived keyset cache.");
+
+end:
+    memset(&payload, 0, sizeof(payload));
+    memset(&aes_ctx, 0, sizeof(aes_ctx));
+    memset(aes_key, 0, sizeof(aes_key));
+    memset(mac_key, 0, sizeof(mac_key));
+}
+
 static bool keysDeriveMasterKeys(void)
 {
     u8 tmp[AES_128_KEY_SIZE] = {0}, current_mkey_index = g_currentMasterKeyIndex;
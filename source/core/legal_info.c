@@ -41,7 +41,7 @@ bool legalInfoInitializeContext(LegalInfoContext *out, NcaContext *nca_ctx)
     legalInfoFreeContext(out);
 
     /* Initialize RomFS context. */
-    if (!romfsInitializeContext(&romfs_ctx, &(nca_ctx->fs_ctx[0]), NULL))
+    if (!romfsInitializeContext(&romfs_ctx, ncaGetFsSectionContext(nca_ctx, 0), NULL))
     {
         LOG_MSG_ERROR("Failed to initialize RomFS context!");
         goto end;
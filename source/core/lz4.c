@@ -528,6 +528,68 @@ LZ4_wildCopy32(void* dstPtr, const void* srcPtr, void* dstEnd)
     do { LZ4_memcpy(d,s,16); LZ4_memcpy(d+16,s+16,16); d+=32; s+=32; } while (d<e);
 }
 
+/* LZ4_NEON_MATCH_COPY :
+ * Replicates short-offset match patterns into a full NEON register with a single table lookup,
+ * then stores 16 bytes at a time. Only used by the fast decode loop, which guarantees
+ * FASTLOOP_SAFE_DISTANCE writable bytes past the current output position.
+ * Can be defined externally to 0 in order to use the generic implementation. */
+#ifndef LZ4_NEON_MATCH_COPY
+#  if defined(__aarch64__) && defined(__ARM_NEON)
+#    define LZ4_NEON_MATCH_COPY 1
+#  else
+#    define LZ4_NEON_MATCH_COPY 0
+#  endif
+#endif
+
+#if LZ4_NEON_MATCH_COPY
+
+#include <arm_neon.h>
+
+/* Byte indexes used to replicate a pattern of 'offset' bytes across a 16-byte register. Row 0 is only used for invalid zero offsets. */
+static const BYTE LZ4_neonPatternTable[16][16] = {
+    {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    {  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    {  0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 },
+    {  0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+    {  0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 },
+    {  0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0 },
+    {  0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3 },
+    {  0, 1, 2, 3, 4, 5, 6, 0, 1, 2, 3, 4, 5, 6, 0, 1 },
+    {  0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 },
+    {  0, 1, 2, 3, 4, 5, 6, 7, 8, 0, 1, 2, 3, 4, 5, 6 },
+    {  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2, 3, 4, 5 },
+    {  0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10, 0, 1, 2, 3, 4 },
+    {  0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11, 0, 1, 2, 3 },
+    {  0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12, 0, 1, 2 },
+    {  0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13, 0, 1 },
+    {  0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14, 0 }
+};
+
+/* Largest multiple of 'offset' that fits in 16 bytes. Advancing by this amount keeps the replicated pattern in phase. */
+static const BYTE LZ4_neonPatternStep[16] = { 16, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15 };
+
+/* LZ4_memcpy_using_offset()  presumes :
+ * - offset < 16
+ * - dstEnd >= dstPtr + MINMATCH
+ * - there is at least 16 bytes available to write after dstEnd
+ * - 16 bytes can be read from srcPtr (always true within the fast decode loop, since srcPtr + offset == dstPtr) */
+LZ4_FORCE_INLINE void
+LZ4_memcpy_using_offset(BYTE* dstPtr, const BYTE* srcPtr, BYTE* dstEnd, const size_t offset)
+{
+    uint8x16_t const pattern = vqtbl1q_u8(vld1q_u8(srcPtr), vld1q_u8(LZ4_neonPatternTable[offset]));
+    size_t const step = LZ4_neonPatternStep[offset];
+
+    assert(offset < 16);
+    assert(dstEnd >= dstPtr + MINMATCH);
+
+    do {
+        vst1q_u8(dstPtr, pattern);
+        dstPtr += step;
+    } while (dstPtr < dstEnd);
+}
+
+#else /* !LZ4_NEON_MATCH_COPY */
+
 /* LZ4_memcpy_using_offset()  presumes :
  * - dstEnd >= dstPtr + MINMATCH
  * - there is at least 12 bytes available to write after dstEnd */
@@ -570,6 +632,9 @@ LZ4_memcpy_using_offset(BYTE* dstPtr, const BYTE* srcPtr, BYTE* dstEnd, const si
         dstPtr += 8;
     }
 }
+
+#endif /* LZ4_NEON_MATCH_COPY */
+
 #endif
 
 
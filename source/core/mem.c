@@ -22,12 +22,15 @@
 
 #include <core/nxdt_utils.h>
 #include <core/mem.h>
+#include <core/buffer_pool.h>
 
 #define MEMLOG_DEBUG(fmt, ...)              LOG_MSG_BUF_DEBUG(&g_memLogBuf, &g_memLogBufSize, fmt, ##__VA_ARGS__)
 #define MEMLOG_ERROR(fmt, ...)              LOG_MSG_BUF_ERROR(&g_memLogBuf, &g_memLogBufSize, fmt, ##__VA_ARGS__)
 
 #define MEM_PID_BUF_SIZE                    300
 
+#define MEM_SCAN_CHUNK_SIZE                 0x40000     /* 256 KiB. */
+
 #define MEM_INVALID_SEGMENT_PAGE_TYPE(x)    ((x) != MemType_CodeStatic && (x) != MemType_CodeMutable)
 
 #define MEM_INVALID_FS_PAGE_TYPE(x)         ((x) == MemType_Unmapped || (x) == MemType_Io || (x) == MemType_ThreadLocal || (x) == MemType_Reserved)
@@ -45,6 +48,11 @@ static size_t g_memLogBufSize = 0;
 /* Function prototypes. */
 
 static bool memRetrieveProgramMemory(MemoryLocation *location, bool is_segment);
+static bool _memScanProgramMemory(const MemoryScanFilter *filter, u8 *buf);
+
+static bool memIsDebugSvcAvailable(void);
+static void memFlushLogBuffer(void);
+
 static bool memRetrieveDebugHandleFromProgramById(Handle *out, u64 program_id);
 
 bool memRetrieveProgramMemorySegment(MemoryLocation *location)
@@ -73,6 +81,32 @@ bool memRetrieveFullProgramMemory(MemoryLocation *location)
     return ret;
 }
 
+bool memScanProgramMemory(const MemoryScanFilter *filter)
+{
+    if (!filter || !filter->program_id || (filter->max_size && filter->max_size < filter->min_size) || !filter->pattern_size || \
+        filter->pattern_size > MEM_SCAN_MAX_PATTERN_SIZE || !filter->callback)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u8 *buf = NULL;
+    bool ret = false;
+
+    /* Allocate the scan buffer right away. We can't do this once the target program is being debugged if it happens to be FS. */
+    if (!(buf = bufferPoolLease(MEM_SCAN_CHUNK_SIZE, false)))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the scan buffer!");
+        return false;
+    }
+
+    SCOPED_LOCK(&g_memMutex) ret = _memScanProgramMemory(filter, buf);
+
+    bufferPoolReturn(buf);
+
+    return ret;
+}
+
 static bool memRetrieveProgramMemory(MemoryLocation *location, bool is_segment)
 {
     Result rc = 0;
@@ -88,15 +122,7 @@ static bool memRetrieveProgramMemory(MemoryLocation *location, bool is_segment)
     bool success = true;
 
     /* Make sure we have access to debug SVC calls. */
-    if (!(envIsSyscallHinted(0x60) &&   /* svcDebugActiveProcess. */
-          envIsSyscallHinted(0x63) &&   /* svcGetDebugEvent. */
-          envIsSyscallHinted(0x65) &&   /* svcGetProcessList. */
-          envIsSyscallHinted(0x69) &&   /* svcQueryDebugProcessMemory. */
-          envIsSyscallHinted(0x6A)))    /* svcReadDebugProcessMemory. */
-    {
-        LOG_MSG_ERROR("Debug SVC permissions not available!");
-        return false;
-    }
+    if (!memIsDebugSvcAvailable()) return false;
 
     /* Clear output MemoryLocation element. */
     memFreeMemoryLocation(location);
@@ -229,6 +255,113 @@ end:
 
     if (!success) memFreeMemoryLocation(location);
 
+    memFlushLogBuffer();
+
+    return success;
+}
+
+static bool _memScanProgramMemory(const MemoryScanFilter *filter, u8 *buf)
+{
+    Result rc = 0;
+    Handle debug_handle = INVALID_HANDLE;
+
+    MemoryInfo mem_info = {0};
+
+    u32 page_info = 0;
+    u64 addr = 0, mapping_count = 0, scanned_size = 0;
+    u8 mem_type = 0;
+
+    bool found = false;
+
+    /* Make sure we have access to debug SVC calls. */
+    if (!memIsDebugSvcAvailable()) return false;
+
+    /* Same logging considerations from memRetrieveProgramMemory() apply here. */
+    logControlMutex(true);
+
+    /* Retrieve debug handle by program ID. */
+    if (!memRetrieveDebugHandleFromProgramById(&debug_handle, filter->program_id))
+    {
+        MEMLOG_ERROR("Unable to retrieve debug handle for program %016lX!", filter->program_id);
+        goto end;
+    }
+
+    do {
+        /* Query memory page info. */
+        rc = svcQueryDebugProcessMemory(&mem_info, &page_info, debug_handle, addr);
+        if (R_FAILED(rc))
+        {
+            MEMLOG_ERROR("svcQueryDebugProcessMemory failed for program %016lX! (0x%X).", filter->program_id, rc);
+            break;
+        }
+
+        mem_type = (u8)(mem_info.type & MemState_Type);
+        addr = (mem_info.addr + mem_info.size);
+
+        /* Filter out unwanted memory pages. */
+        if (mem_info.attr || !(mem_info.perm & Perm_R) || (mem_info.perm & filter->perm) != filter->perm || (filter->type_mask && (mem_type >= 64 || !(filter->type_mask & BITL(mem_type)))) || \
+            mem_info.size < filter->min_size || (filter->max_size && mem_info.size > filter->max_size) || mem_info.size < filter->pattern_size || \
+            (filter->program_id == FS_SYSMODULE_TID && MEM_INVALID_FS_PAGE_TYPE(mem_type))) continue;
+
+        mapping_count++;
+
+        /* Read the current memory mapping in chunks. Consecutive chunks overlap, so patterns spanning chunk boundaries can still be found. */
+        for(u64 offset = 0; offset < mem_info.size;)
+        {
+            u64 chunk_size = MIN(mem_info.size - offset, (u64)MEM_SCAN_CHUNK_SIZE);
+
+            rc = svcReadDebugProcessMemory(buf, debug_handle, mem_info.addr + offset, chunk_size);
+            if (R_FAILED(rc))
+            {
+                MEMLOG_ERROR("svcReadDebugProcessMemory failed for program %016lX at 0x%lX! (0x%X).", filter->program_id, mem_info.addr + offset, rc);
+                goto end;
+            }
+
+            scanned_size += chunk_size;
+
+            if ((found = filter->callback(buf, chunk_size, filter->user_data)))
+            {
+                MEMLOG_DEBUG("Pattern found in program %016lX memory mapping at 0x%lX (type 0x%X, perm 0x%X).", filter->program_id, mem_info.addr, mem_info.type, \
+                             mem_info.perm);
+                goto end;
+            }
+
+            if ((offset + chunk_size) >= mem_info.size) break;
+            offset += (chunk_size - (filter->pattern_size - 1));
+        }
+    } while(addr != 0);
+
+    MEMLOG_ERROR("Unable to find pattern in program %016lX memory! (%lu matching mapping[s], 0x%lX byte[s] scanned).", filter->program_id, mapping_count, scanned_size);
+
+end:
+    /* Close debug handle. */
+    if (debug_handle != INVALID_HANDLE) svcCloseHandle(debug_handle);
+
+    /* Unlock logfile mutex. */
+    logControlMutex(false);
+
+    memFlushLogBuffer();
+
+    return found;
+}
+
+static bool memIsDebugSvcAvailable(void)
+{
+    if (!(envIsSyscallHinted(0x60) &&   /* svcDebugActiveProcess. */
+          envIsSyscallHinted(0x63) &&   /* svcGetDebugEvent. */
+          envIsSyscallHinted(0x65) &&   /* svcGetProcessList. */
+          envIsSyscallHinted(0x69) &&   /* svcQueryDebugProcessMemory. */
+          envIsSyscallHinted(0x6A)))    /* svcReadDebugProcessMemory. */
+    {
+        LOG_MSG_ERROR("Debug SVC permissions not available!");
+        return false;
+    }
+
+    return true;
+}
+
+static void memFlushLogBuffer(void)
+{
 #if LOG_LEVEL < LOG_LEVEL_NONE
     /* Write log buffer data. This will do nothing if the log buffer length is zero. */
     logWriteStringToLogFile(g_memLogBuf);
@@ -242,8 +375,6 @@ end:
 
     g_memLogBufSize = 0;
 #endif
-
-    return success;
 }
 
 static bool memRetrieveDebugHandleFromProgramById(Handle *out, u64 program_id)
@@ -25,20 +25,16 @@
 
 /* Helper macros. */
 
-#define NACP_ADD_FMT_STR_T1(fmt, ...)                                                           utilsAppendFormattedStringToBuffer(&xml_buf, &xml_buf_size, fmt, ##__VA_ARGS__)
-#define NACP_ADD_FMT_STR_T2(fmt, ...)                                                           utilsAppendFormattedStringToBuffer(xml_buf, xml_buf_size, fmt, ##__VA_ARGS__)
-#define NACP_ADD_STR(tag_name, value)                                                           nacpAddStringFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value)
-#define NACP_ADD_ENUM(tag_name, value, str_func)                                                nacpAddEnumFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value, \
-                                                                                                                                   &str_func)
-#define NACP_ADD_BITFLAG(tag_name, flag, flag_width, max_flag_idx, str_func, allow_empty_str)   nacpAddBitflagFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, flag, \
-                                                                                                                                      flag_width, max_flag_idx, &(str_func), \
-                                                                                                                                      allow_empty_str)
-#define NACP_ADD_U16(tag_name, value, hex, prefix)                                              nacpAddU16FieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value, hex, \
-                                                                                                                                  prefix)
-#define NACP_ADD_U32(tag_name, value, hex, prefix)                                              nacpAddU32FieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value, hex, \
-                                                                                                                                  prefix)
-#define NACP_ADD_U64(tag_name, value, hex, prefix)                                              nacpAddU64FieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value, hex, \
-                                                                                                                                  prefix)
+#define NACP_XML_SIZE_HINT                                                                      0x3000
+
+#define NACP_ADD_FMT_STR(fmt, ...)                                                              stringBuilderAppendFormatted(&xml_sb, fmt, ##__VA_ARGS__)
+#define NACP_ADD_STR(tag_name, value)                                                           nacpAddStringFieldToAuthoringToolXml(&xml_sb, tag_name, value)
+#define NACP_ADD_ENUM(tag_name, value, str_func)                                                nacpAddEnumFieldToAuthoringToolXml(&xml_sb, tag_name, value, &str_func)
+#define NACP_ADD_BITFLAG(tag_name, flag, flag_width, max_flag_idx, str_func, allow_empty_str)   nacpAddBitflagFieldToAuthoringToolXml(&xml_sb, tag_name, flag, flag_width, max_flag_idx, \
+                                                                                                                                      &(str_func), allow_empty_str)
+#define NACP_ADD_U16(tag_name, value, hex, prefix)                                              nacpAddIntegerFieldToAuthoringToolXml(&xml_sb, tag_name, value, (hex) ? 4 : 0, prefix)
+#define NACP_ADD_U32(tag_name, value, hex, prefix)                                              nacpAddIntegerFieldToAuthoringToolXml(&xml_sb, tag_name, value, (hex) ? 8 : 0, prefix)
+#define NACP_ADD_U64(tag_name, value, hex, prefix)                                              nacpAddIntegerFieldToAuthoringToolXml(&xml_sb, tag_name, value, (hex) ? 16 : 0, prefix)
 
 /* Type definitions. */
 
@@ -220,12 +216,12 @@ static const char *g_nacpContentsAvailabilityTransitionPolicyStrings[NacpContent
 
 NX_INLINE bool nacpCheckBitflagField(const void *flag, u8 flag_bitcount, u8 idx);
 
-static bool nacpAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const char *value);
-static bool nacpAddEnumFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u8 value, NacpStringFunction str_func);
-static bool nacpAddBitflagFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const void *flag, u8 flag_width, u8 max_flag_idx, NacpStringFunction str_func, bool allow_empty_str);
-static bool nacpAddU16FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u16 value, bool hex, bool prefix);
-static bool nacpAddU32FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u32 value, bool hex, bool prefix);
-static bool nacpAddU64FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u64 value, bool hex, bool prefix);
+static bool nacpAddStringFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, const char *value);
+static bool nacpAddEnumFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, u8 value, NacpStringFunction str_func);
+static bool nacpAddBitflagFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, const void *flag, u8 flag_width, u8 max_flag_idx, NacpStringFunction str_func, bool allow_empty_str);
+static bool nacpAddIntegerFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, u64 value, u8 hex_digits, bool prefix);
+
+NX_INLINE bool nacpAddTaggedStringToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, const char *value);
 
 bool nacpInitializeContext(NacpContext *out, NcaContext *nca_ctx)
 {
@@ -248,7 +244,7 @@ bool nacpInitializeContext(NacpContext *out, NcaContext *nca_ctx)
     nacpFreeContext(out);
 
     /* Initialize RomFS context. */
-    if (!romfsInitializeContext(&(out->romfs_ctx), &(nca_ctx->fs_ctx[0]), NULL))
+    if (!romfsInitializeContext(&(out->romfs_ctx), ncaGetFsSectionContext(nca_ctx, 0), NULL))
     {
         LOG_MSG_ERROR("Failed to initialize RomFS context!");
         goto end;
@@ -453,8 +449,7 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
     Version app_ver = { .value = version };
 
     u8 i = 0, count = 0;
-    char *xml_buf = NULL;
-    u64 xml_buf_size = 0;
+    StringBuilder xml_sb = {0};
 
     u8 icon_hash[SHA256_HASH_SIZE] = {0};
     char icon_hash_str[SHA256_HASH_SIZE + 1] = {0};
@@ -476,8 +471,11 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
     nacp_ctx->authoring_tool_xml = NULL;
     nacp_ctx->authoring_tool_xml_size = 0;
 
-    if (!NACP_ADD_FMT_STR_T1("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" \
-                             "<Application>\n")) goto end;
+    /* Reserve enough space for the whole XML right away. */
+    if (!stringBuilderReserve(&xml_sb, NACP_XML_SIZE_HINT)) goto end;
+
+    if (!NACP_ADD_FMT_STR("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" \
+                          "<Application>\n")) goto end;
 
     /* Title. */
     for(i = 0, count = 0; i < NacpLanguage_Count; i++)
@@ -485,19 +483,19 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
         NacpTitle *title = &(nacp->title[i]);
         if (!*(title->name) || !*(title->publisher)) continue;
 
-        if (!NACP_ADD_FMT_STR_T1("  <Title>\n" \
-                                 "    <Language>%s</Language>\n" \
-                                 "    <Name>%s</Name>\n" \
-                                 "    <Publisher>%s</Publisher>\n" \
-                                 "  </Title>\n", \
-                                 nacpGetLanguageString(i), \
-                                 title->name, \
-                                 title->publisher)) goto end;
+        if (!NACP_ADD_FMT_STR("  <Title>\n" \
+                              "    <Language>%s</Language>\n" \
+                              "    <Name>%s</Name>\n" \
+                              "    <Publisher>%s</Publisher>\n" \
+                              "  </Title>\n", \
+                              nacpGetLanguageString(i), \
+                              title->name, \
+                              title->publisher)) goto end;
 
         count++;
     }
 
-    if (!count && !NACP_ADD_FMT_STR_T1("  <Title />\n")) goto end;
+    if (!count && !NACP_ADD_FMT_STR("  <Title />\n")) goto end;
 
     /* Isbn. */
     if (!NACP_ADD_STR("Isbn", nacp->isbn)) goto end;
@@ -539,17 +537,17 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
         s8 age = *(((s8*)&(nacp->rating_age)) + i);
         if (age < 0) continue;
 
-        if (!NACP_ADD_FMT_STR_T1("  <Rating>\n" \
-                                 "    <Organization>%s</Organization>\n" \
-                                 "    <Age>%d</Age>\n" \
-                                 "  </Rating>\n", \
-                                 nacpGetRatingAgeOrganizationString(i), \
-                                 age)) goto end;
+        if (!NACP_ADD_FMT_STR("  <Rating>\n" \
+                              "    <Organization>%s</Organization>\n" \
+                              "    <Age>%d</Age>\n" \
+                              "  </Rating>\n", \
+                              nacpGetRatingAgeOrganizationString(i), \
+                              age)) goto end;
 
         count++;
     }
 
-    if (!count && !NACP_ADD_FMT_STR_T1("  <Rating />\n")) goto end;
+    if (!count && !NACP_ADD_FMT_STR("  <Rating />\n")) goto end;
 
     /* DataLossConfirmation. */
     if (!NACP_ADD_ENUM("DataLossConfirmation", nacp->data_loss_confirmation, nacpGetDataLossConfirmationString)) goto end;
@@ -621,11 +619,11 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
         utilsGenerateHexString(icon_hash_str, sizeof(icon_hash_str), icon_hash, sizeof(icon_hash) / 2, false);
 
         /* Add XML element. */
-        if (!NACP_ADD_FMT_STR_T1("  <Icon>\n" \
-                                 "    <Language>%s</Language>\n" \
-                                 /*"    <IconPath />\n" \
-                                 "    <NxIconPath />\n" \
-                                 "    <RawIconHash />\n" \*/
+        if (!NACP_ADD_FMT_STR("  <Icon>\n" \
+                              "    <Language>%s</Language>\n" \
+                              /*"    <IconPath />\n" \
+                              "    <NxIconPath />\n" \
+                              "    <RawIconHash />\n" \*/
                                  "    <NxIconHash>%s</NxIconHash>\n" \
                                  "  </Icon>\n", \
                                  nacpGetLanguageString(icon_ctx->language), \
@@ -634,12 +632,12 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
         count++;
     }
 
-    if (!count && !NACP_ADD_FMT_STR_T1("  <Icon />\n")) goto end;
+    if (!count && !NACP_ADD_FMT_STR("  <Icon />\n")) goto end;
 
     /* HtmlDocumentPath, LegalInformationFilePath and AccessibleUrlsFilePath. Unused but kept anyway. */
-    if (!NACP_ADD_FMT_STR_T1("  <HtmlDocumentPath UseEnvironmentVariable=\"false\" />\n" \
-                             "  <LegalInformationFilePath UseEnvironmentVariable=\"false\" />\n" \
-                             "  <AccessibleUrlsFilePath UseEnvironmentVariable=\"false\" />\n")) goto end;
+    if (!NACP_ADD_FMT_STR("  <HtmlDocumentPath UseEnvironmentVariable=\"false\" />\n" \
+                          "  <LegalInformationFilePath UseEnvironmentVariable=\"false\" />\n" \
+                          "  <AccessibleUrlsFilePath UseEnvironmentVariable=\"false\" />\n")) goto end;
 
     /* SeedForPseudoDeviceId. */
     if (!NACP_ADD_U64("SeedForPseudoDeviceId", nacp->seed_for_pseudo_device_id, true, false)) goto end;
@@ -723,17 +721,17 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
 
     if (ndcc_sgc_available || ndcc_rgc_available)
     {
-        if (!NACP_ADD_FMT_STR_T1("  <NeighborDetectionClientConfiguration>\n")) goto end;
+        if (!NACP_ADD_FMT_STR("  <NeighborDetectionClientConfiguration>\n")) goto end;
 
         /* SendGroupConfiguration. */
         utilsGenerateHexString(key_str, sizeof(key_str), ndcc->send_group_configuration.key, sizeof(ndcc->send_group_configuration.key), false);
 
-        if (!NACP_ADD_FMT_STR_T1("    <SendGroupConfiguration>\n" \
-                                 "      <GroupId>0x%016lx</GroupId>\n" \
-                                 "      <Key>%s</Key>\n" \
-                                 "    </SendGroupConfiguration>\n", \
-                                 ndcc->send_group_configuration.group_id, \
-                                 key_str)) goto end;
+        if (!NACP_ADD_FMT_STR("    <SendGroupConfiguration>\n" \
+                              "      <GroupId>0x%016lx</GroupId>\n" \
+                              "      <Key>%s</Key>\n" \
+                              "    </SendGroupConfiguration>\n", \
+                              ndcc->send_group_configuration.group_id, \
+                              key_str)) goto end;
 
         /* ReceivableGroupConfiguration. */
         for(i = 0; i < 0x10; i++)
@@ -742,27 +740,27 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
 
             utilsGenerateHexString(key_str, sizeof(key_str), rgc->key, sizeof(rgc->key), false);
 
-            if (!NACP_ADD_FMT_STR_T1("    <ReceivableGroupConfiguration>\n" \
-                                     "      <GroupId>0x%016lx</GroupId>\n" \
-                                     "      <Key>%s</Key>\n" \
-                                     "    </ReceivableGroupConfiguration>\n", \
-                                     rgc->group_id, \
-                                     key_str)) goto end;
+            if (!NACP_ADD_FMT_STR("    <ReceivableGroupConfiguration>\n" \
+                                  "      <GroupId>0x%016lx</GroupId>\n" \
+                                  "      <Key>%s</Key>\n" \
+                                  "    </ReceivableGroupConfiguration>\n", \
+                                  rgc->group_id, \
+                                  key_str)) goto end;
         }
 
-        if (!NACP_ADD_FMT_STR_T1("  </NeighborDetectionClientConfiguration>\n")) goto end;
+        if (!NACP_ADD_FMT_STR("  </NeighborDetectionClientConfiguration>\n")) goto end;
     }
 
     /* JitConfiguration. */
-    if (!NACP_ADD_FMT_STR_T1("  <Jit>\n" \
-                             "    <IsEnabled>%s</IsEnabled>\n" \
-                             "    <MemorySize>%lu</MemorySize>\n" \
-                             "  </Jit>\n", \
-                             (nacp->jit_configuration.jit_configuration_flag & NacpJitConfigurationFlag_Enabled) ? "true" : "false", \
-                             nacp->jit_configuration.memory_size)) goto end;
+    if (!NACP_ADD_FMT_STR("  <Jit>\n" \
+                          "    <IsEnabled>%s</IsEnabled>\n" \
+                          "    <MemorySize>%lu</MemorySize>\n" \
+                          "  </Jit>\n", \
+                          (nacp->jit_configuration.jit_configuration_flag & NacpJitConfigurationFlag_Enabled) ? "true" : "false", \
+                          nacp->jit_configuration.memory_size)) goto end;
 
     /* History. */
-    //if (!NACP_ADD_FMT_STR_T1("  <History />\n")) goto end;
+    //if (!NACP_ADD_FMT_STR("  <History />\n")) goto end;
 
     /* RuntimeParameterDelivery. */
     if (!NACP_ADD_ENUM("RuntimeParameterDelivery", nacp->runtime_parameter_delivery, nacpGetRuntimeParameterDeliveryString)) goto end;
@@ -786,26 +784,26 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
 
     if (raocsbd_available)
     {
-        if (!NACP_ADD_FMT_STR_T1("  <RequiredAddOnContentsSet>\n")) goto end;
+        if (!NACP_ADD_FMT_STR("  <RequiredAddOnContentsSet>\n")) goto end;
 
         for(i = 0; i < 0x20; i++)
         {
             NacpRequiredAddOnContentsSetDescriptor *descriptor = &(raocsbd->descriptors[i]);
             if (!descriptor->index) continue;
 
-            if (!NACP_ADD_FMT_STR_T1("    <Index>%u</Index>\n", descriptor->index)) goto end;
+            if (!NACP_ADD_FMT_STR("    <Index>%u</Index>\n", descriptor->index)) goto end;
 
             if (descriptor->flag != NacpRequiredAddOnContentsSetDescriptorFlag_Continue) break;
         }
 
-        if (!NACP_ADD_FMT_STR_T1("  </RequiredAddOnContentsSet>\n")) goto end;
+        if (!NACP_ADD_FMT_STR("  </RequiredAddOnContentsSet>\n")) goto end;
     }
 
     /* PlayReportPermission. */
-    if (!NACP_ADD_FMT_STR_T1("  <PlayReportPermission>\n" \
-                             "    <TargetMarketing>%s</TargetMarketing>\n" \
-                             "  </PlayReportPermission>\n", \
-                             (nacp->play_report_permission & NacpPlayReportPermission_TargetMarketing) ? "Allow" : "Deny")) goto end;
+    if (!NACP_ADD_FMT_STR("  <PlayReportPermission>\n" \
+                          "    <TargetMarketing>%s</TargetMarketing>\n" \
+                          "  </PlayReportPermission>\n", \
+                          (nacp->play_report_permission & NacpPlayReportPermission_TargetMarketing) ? "Allow" : "Deny")) goto end;
 
     /* AccessibleLaunchRequiredVersion. */
     for(i = 0; i < 0x8; i++)
@@ -819,19 +817,19 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
 
     if (alrv_available)
     {
-        if (!NACP_ADD_FMT_STR_T1("  <AccessibleLaunchRequiredVersion>\n")) goto end;
+        if (!NACP_ADD_FMT_STR("  <AccessibleLaunchRequiredVersion>\n")) goto end;
 
         for(i = 0; i < 0x8; i++)
         {
             u64 id = nacp->accessible_launch_required_version.application_id[i];
             if (!id) continue;
 
-            if (!NACP_ADD_FMT_STR_T1("    <ApplicationId>0x%016lx</ApplicationId>\n", id)) goto end;
+            if (!NACP_ADD_FMT_STR("    <ApplicationId>0x%016lx</ApplicationId>\n", id)) goto end;
         }
 
-        if (!NACP_ADD_FMT_STR_T1("  </AccessibleLaunchRequiredVersion>\n")) goto end;
+        if (!NACP_ADD_FMT_STR("  </AccessibleLaunchRequiredVersion>\n")) goto end;
     } else {
-        if (!NACP_ADD_FMT_STR_T1("  <AccessibleLaunchRequiredVersion />\n")) goto end;
+        if (!NACP_ADD_FMT_STR("  <AccessibleLaunchRequiredVersion />\n")) goto end;
     }
 
     /* UndecidedParameter75b8b. */
@@ -841,32 +839,31 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
     //if (!NACP_ADD_U64("ApplicationId", nacp_ctx->nca_ctx->header.program_id, true, true)) goto end;
 
     /* FilterDescriptionFilePath and CompressionFileConfigurationFilePath. */
-    /*if (!NACP_ADD_FMT_STR_T1("  <FilterDescriptionFilePath />\n" \
+    /*if (!NACP_ADD_FMT_STR("  <FilterDescriptionFilePath />\n" \
                              "  <CompressionFileConfigurationFilePath />\n")) goto end;*/
 
     /* ContentsAvailabilityTransitionPolicy. */
     if (!NACP_ADD_ENUM("ContentsAvailabilityTransitionPolicy", nacp->contents_availability_transition_policy, nacpGetContentsAvailabilityTransitionPolicyString)) goto end;
 
     /* LimitedApplicationLicenseSettings. */
-    if (!NACP_ADD_FMT_STR_T1("  <LimitedApplicationLicenseSettings>\n" \
-                             "    <RuntimeUpgrade>%s</RuntimeUpgrade>\n" \
-                             "    <SupportingLimitedApplicationLicenses>\n" \
-                             "      <LimitedApplicationLicense>%s</LimitedApplicationLicense>\n" \
-                             "    </SupportingLimitedApplicationLicenses>\n" \
-                             "  </LimitedApplicationLicenseSettings>\n", \
-                             nacpGetRuntimeUpgradeString(nacp->runtime_upgrade), \
-                             (nacp->supporting_limited_application_licenses & NacpSupportingLimitedApplicationLicenses_Demo) ? "Demo" : "None")) goto end;
+    if (!NACP_ADD_FMT_STR("  <LimitedApplicationLicenseSettings>\n" \
+                          "    <RuntimeUpgrade>%s</RuntimeUpgrade>\n" \
+                          "    <SupportingLimitedApplicationLicenses>\n" \
+                          "      <LimitedApplicationLicense>%s</LimitedApplicationLicense>\n" \
+                          "    </SupportingLimitedApplicationLicenses>\n" \
+                          "  </LimitedApplicationLicenseSettings>\n", \
+                          nacpGetRuntimeUpgradeString(nacp->runtime_upgrade), \
+                          (nacp->supporting_limited_application_licenses & NacpSupportingLimitedApplicationLicenses_Demo) ? "Demo" : "None")) goto end;
 
-    if (!(success = NACP_ADD_FMT_STR_T1("</Application>"))) goto end;
+    if (!(success = NACP_ADD_FMT_STR("</Application>"))) goto end;
 
     /* Update NACP context. */
-    nacp_ctx->authoring_tool_xml = xml_buf;
-    nacp_ctx->authoring_tool_xml_size = strlen(xml_buf);
+    nacp_ctx->authoring_tool_xml = stringBuilderDetach(&xml_sb, &(nacp_ctx->authoring_tool_xml_size));
 
 end:
     if (!success)
     {
-        if (xml_buf) free(xml_buf);
+        stringBuilderFree(&xml_sb);
         LOG_MSG_ERROR("Failed to generate NACP AuthoringTool XML!");
     }
 
@@ -1019,35 +1016,37 @@ NX_INLINE bool nacpCheckBitflagField(const void *flag, u8 flag_bitcount, u8 idx)
     return (flag_u8[byte_idx] & bitmask);
 }
 
-static bool nacpAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const char *value)
+static bool nacpAddStringFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, const char *value)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name || !value)
+    if (!xml_sb || !tag_name || !*tag_name || !value)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    return (*value ? NACP_ADD_FMT_STR_T2("  <%s>%s</%s>\n", tag_name, value, tag_name) : NACP_ADD_FMT_STR_T2("  <%s />\n", tag_name));
+    if (*value) return nacpAddTaggedStringToAuthoringToolXml(xml_sb, tag_name, value);
+
+    return (stringBuilderAppend(xml_sb, "  <") && stringBuilderAppend(xml_sb, tag_name) && stringBuilderAppend(xml_sb, " />\n"));
 }
 
-static bool nacpAddEnumFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u8 value, NacpStringFunction str_func)
+static bool nacpAddEnumFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, u8 value, NacpStringFunction str_func)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name || !str_func)
+    if (!xml_sb || !tag_name || !*tag_name || !str_func)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    return NACP_ADD_FMT_STR_T2("  <%s>%s</%s>\n", tag_name, str_func(value), tag_name);
+    return nacpAddTaggedStringToAuthoringToolXml(xml_sb, tag_name, str_func(value));
 }
 
-static bool nacpAddBitflagFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const void *flag, u8 flag_width, u8 max_flag_idx, NacpStringFunction str_func, bool allow_empty_str)
+static bool nacpAddBitflagFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, const void *flag, u8 flag_width, u8 max_flag_idx, NacpStringFunction str_func, bool allow_empty_str)
 {
     u8 flag_bitcount = 0, i = 0, count = 0;
     const u8 *flag_u8 = (const u8*)flag;
     bool success = false, empty_flag = true;
 
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name || !flag || !flag_width || (flag_width > 1 && !IS_POWER_OF_TWO(flag_width)) || flag_width > 0x10 || \
+    if (!xml_sb || !tag_name || !*tag_name || !flag || !flag_width || (flag_width > 1 && !IS_POWER_OF_TWO(flag_width)) || flag_width > 0x10 || \
         (flag_bitcount = (flag_width * 8)) < max_flag_idx || !str_func)
     {
         LOG_MSG_ERROR("Invalid parameters!");
@@ -1068,7 +1067,7 @@ static bool nacpAddBitflagFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_s
         for(i = 0; i < max_flag_idx; i++)
         {
             if (!nacpCheckBitflagField(flag, flag_bitcount, i)) continue;
-            if (!NACP_ADD_FMT_STR_T2("  <%s>%s</%s>\n", tag_name, str_func(i), tag_name)) goto end;
+            if (!nacpAddTaggedStringToAuthoringToolXml(xml_sb, tag_name, str_func(i))) goto end;
             count++;
         }
 
@@ -1076,7 +1075,7 @@ static bool nacpAddBitflagFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_s
         if (!count) empty_flag = true;
     }
 
-    if (empty_flag && allow_empty_str && !NACP_ADD_FMT_STR_T2("  <%s />\n", tag_name)) goto end;
+    if (empty_flag && allow_empty_str && !nacpAddStringFieldToAuthoringToolXml(xml_sb, tag_name, "")) goto end;
 
     success = true;
 
@@ -1084,41 +1083,25 @@ end:
     return success;
 }
 
-static bool nacpAddU16FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u16 value, bool hex, bool prefix)
+static bool nacpAddIntegerFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, u64 value, u8 hex_digits, bool prefix)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name)
+    if (!xml_sb || !tag_name || !*tag_name)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    const char *str = (hex ? (prefix ? "  <%s>0x%04x</%s>\n" : "  <%s>%04x</%s>\n") : "  <%s>%u</%s>\n");
-
-    return NACP_ADD_FMT_STR_T2(str, tag_name, value, tag_name);
-}
-
-static bool nacpAddU32FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u32 value, bool hex, bool prefix)
-{
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name)
-    {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return false;
-    }
+    /* A zero 'hex_digits' value means the integer is printed in decimal notation. */
+    if (!stringBuilderAppend(xml_sb, "  <") || !stringBuilderAppend(xml_sb, tag_name) || !stringBuilderAppend(xml_sb, (hex_digits && prefix) ? ">0x" : ">")) return false;
 
-    const char *str = (hex ? (prefix ? "  <%s>0x%08x</%s>\n" : "  <%s>%08x</%s>\n") : "  <%s>%u</%s>\n");
+    if (!(hex_digits ? stringBuilderAppendHex(xml_sb, value, hex_digits, false) : stringBuilderAppendUnsigned(xml_sb, value))) return false;
 
-    return NACP_ADD_FMT_STR_T2(str, tag_name, value, tag_name);
+    return (stringBuilderAppend(xml_sb, "</") && stringBuilderAppend(xml_sb, tag_name) && stringBuilderAppend(xml_sb, ">\n"));
 }
 
-static bool nacpAddU64FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u64 value, bool hex, bool prefix)
+NX_INLINE bool nacpAddTaggedStringToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, const char *value)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name)
-    {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return false;
-    }
-
-    const char *str = (hex ? (prefix ? "  <%s>0x%016lx</%s>\n" : "  <%s>%016lx</%s>\n") : "  <%s>%lu</%s>\n");
-
-    return NACP_ADD_FMT_STR_T2(str, tag_name, value, tag_name);
+    return (stringBuilderAppend(xml_sb, "  <") && stringBuilderAppend(xml_sb, tag_name) && stringBuilderAppend(xml_sb, ">") && \
+            stringBuilderAppend(xml_sb, value) && stringBuilderAppend(xml_sb, "</") && stringBuilderAppend(xml_sb, tag_name) && \
+            stringBuilderAppend(xml_sb, ">\n"));
 }
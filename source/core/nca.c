@@ -27,13 +27,99 @@
 #include <core/gamecard.h>
 #include <core/title.h>
 
-#define NCA_CRYPTO_BUFFER_SIZE  0x800000    /* 8 MiB. */
+#define NCA_CRYPTO_BUFFER_SIZE      0x800000    /* 8 MiB. Scaled down according to the memory budget (see utilsGetBudgetedBufferSize()). */
+#define NCA_CRYPTO_BUFFER_MIN_SIZE  0x100000    /* 1 MiB. */
+
+#define NCA_PATCH_CACHE_ENTRY_COUNT     8
+#define NCA_PATCH_CACHE_MAX_DATA_SIZE   0x100000    /* 1 MiB. Larger patches aren't cached. */
+
+#define NCA_VERIFY_MAX_HASH_LAYER_SIZE  0x2000000   /* 32 MiB. */
+
+#define NCA_VECTORED_READ_MAX_GAP       0x10000     /* 64 KiB. Requests separated by smaller gaps are coalesced into a single read. */
+#define NCA_VECTORED_READ_MAX_SIZE      0x400000    /* 4 MiB. Maximum size for a single coalesced read. */
+
+#define NCA_STRIPED_READ_WORKER_COUNT       3           /* The calling thread reads the first stripe on its own. */
+#define NCA_STRIPED_READ_MIN_STRIPE_SIZE    0x100000    /* 1 MiB. Smaller reads aren't split. */
+#define NCA_STRIPED_READ_STRIPE_ALIGNMENT   0x1000
+
+/* Type definitions. */
+
+/// Holds validated NCA header state, which is restored into NCA contexts that are initialized more than once.
+typedef struct {
+    bool valid;
+    u64 last_use;                                           ///< Used to evict the least recently used entry.
+    NcmContentId content_id;
+    u8 storage_id;                                          ///< NcmStorageId.
+    u64 content_size;
+    u8 format_version;                                      ///< NcaVersion.
+    u8 key_generation;                                      ///< NcaKeyGeneration.
+    bool rights_id_available;
+    bool valid_main_signature;
+    NcaHeader header;
+    u8 header_hash[SHA256_HASH_SIZE];
+    NcaHeader encrypted_header;
+    NcaDecryptedKeyArea decrypted_key_area;
+    NcaFsHeader fs_header[NCA_FS_HEADER_COUNT];
+    NcaFsHeader fs_encrypted_header[NCA_FS_HEADER_COUNT];
+} NcaHeaderCacheEntry;
+
+/// Holds a generated hash data patch alongside the FS section header state it produced, which is restored when the same patch is requested again.
+/// Patches are identified by a hash calculated over the original FS section header and all input data ranges, so any change to the replacement data results in a cache miss.
+typedef struct {
+    bool valid;
+    u64 last_use;                                           ///< Used to evict the least recently used entry.
+    NcmContentId content_id;
+    u8 section_idx;
+    bool is_integrity_patch;
+    u8 input_hash[SHA256_HASH_SIZE];
+    NcaFsHeader header;                                     ///< Patched NCA FS section header.
+    u8 fs_header_hash[SHA256_HASH_SIZE];                    ///< Patched NCA FS section header hash.
+    union {
+        NcaHierarchicalSha256Patch hierarchical_sha256_patch;
+        NcaHierarchicalIntegrityPatch hierarchical_integrity_patch;
+    };
+} NcaHashDataPatchCacheEntry;
+
+typedef enum {
+    NcaStripedReadWorkerState_Idle    = 0,
+    NcaStripedReadWorkerState_Pending = 1,  ///< Waiting for the worker thread to read its stripe.
+    NcaStripedReadWorkerState_Done    = 2
+} NcaStripedReadWorkerState;
+
+typedef struct {
+    struct NcaStripedReader *reader;
+    Thread thread;
+    NcmContentStorage ncm_storage;  ///< Separate ncm storage session, so requests issued by different workers don't have to wait on each other.
+    u8 state;                       ///< NcaStripedReadWorkerState.
+    NcaContext *nca_ctx;
+    void *out;
+    u64 size;
+    u64 offset;
+    bool success;
+} NcaStripedReadWorker;
+
+struct NcaStripedReader {
+    Mutex mutex;
+    CondVar cond;
+    u8 storage_id;  ///< NcmStorageId.
+    bool exit;
+    u32 worker_count;
+    NcaStripedReadWorker workers[NCA_STRIPED_READ_WORKER_COUNT];
+};
 
 /* Global variables. */
 
-static u8 *g_ncaCryptoBuffer = NULL;
+static u64 g_ncaCryptoBufferSize = 0;
 static Mutex g_ncaCryptoBufferMutex = 0;
 
+static NcaHeaderCacheEntry g_ncaHeaderCache[NCA_HEADER_CACHE_ENTRY_COUNT] = {0};
+static u64 g_ncaHeaderCacheTick = 0;
+static Mutex g_ncaHeaderCacheMutex = 0;
+
+static NcaHashDataPatchCacheEntry g_ncaPatchCache[NCA_PATCH_CACHE_ENTRY_COUNT] = {0};
+static u64 g_ncaPatchCacheTick = 0;
+static Mutex g_ncaPatchCacheMutex = 0;
+
 /// Used to verify the NCA header main signature.
 static const u8 g_ncaHeaderMainSignaturePublicExponent[3] = { 0x01, 0x00, 0x01 };
 
@@ -127,7 +213,12 @@ static const u8 g_nca0KeyAreaHash[SHA256_HASH_SIZE] = {
 
 /* Function prototypes. */
 
-static bool ncaInitializeContextCommon(NcaContext *out, u8 storage_id, u8 hfs_partition_type, NcmContentStorage *ncm_storage, Ticket *tik);
+static bool _ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik, \
+                                  bool lazy_fs_section_init);
+static bool ncaInitializeContextCommon(NcaContext *out, u8 storage_id, u8 hfs_partition_type, NcmContentStorage *ncm_storage, Ticket *tik, bool lazy_fs_section_init);
+
+static bool ncaLoadCachedHeader(NcaContext *ctx);
+static void ncaStoreCachedHeader(NcaContext *ctx);
 
 NX_INLINE bool ncaIsFsInfoEntryValid(NcaFsInfo *fs_info);
 
@@ -143,76 +234,102 @@ NX_INLINE bool ncaCheckRightsIdAvailability(NcaContext *ctx);
 static bool ncaInitializeFsSectionContext(NcaContext *nca_ctx, u32 section_idx);
 static bool ncaFsSectionValidateHashDataBoundaries(NcaFsSectionContext *ctx);
 
-static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset);
+static u8 *ncaAcquireCryptoBuffer(void);
+static void ncaReleaseCryptoBuffer(u8 *buf);
+static bool _ncaAllocateCryptoBuffer(void);
+
+static void ncaFsSectionSelectReadFunction(NcaFsSectionContext *ctx);
+NX_INLINE bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf);
+static bool ncaReadFsSectionPlaintext(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf);
+static bool ncaReadFsSectionAesXts(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf);
+static bool ncaReadFsSectionAesCtr(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf);
+static bool ncaReadFsSectionGeneric(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf);
 static bool ncaFsSectionCheckPlaintextHashRegionAccess(NcaFsSectionContext *ctx, u64 offset, u64 size, NcaRegion *out_region);
 
-static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt);
+static u32 ncaFsSectionGetHashLayerCount(NcaFsSectionContext *ctx);
+static bool ncaFsSectionGetHashLayer(NcaFsSectionContext *ctx, u32 layer_idx, NcaRegion *out_region, u64 *out_block_size);
+static u8 *ncaFsSectionReadVerifiedHashLayer(NcaFsSectionContext *ctx, u32 layer_idx, const u8 *parent_layer, u8 *crypto_buf);
+static bool ncaVerifyFsSectionData(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 offset, u8 *crypto_buf);
+static bool ncaDecryptRawFsSectionData(NcaFsSectionContext *ctx, void *data, u64 data_size, u64 offset);
+
+static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt, u8 *crypto_buf);
+static bool _ncaReadAesCtrExStorageRanges(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, const NcaAesCtrExRange *ranges, u32 range_count, u8 *crypto_buf);
 
 static void ncaCalculateLayerHash(void *dst, const void *src, size_t size, bool use_sha3);
-static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, void *out, bool is_integrity_patch);
+static void ncaCalculateLayerBlockHashes(void *dst, const void *src, size_t size, size_t block_size, bool use_sha3);
+static bool ncaGenerateCachedHashDataPatch(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, void *out, bool is_integrity_patch);
+static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, void *out, bool is_integrity_patch, u8 *crypto_buf);
+
+static void ncaCalculateHashDataPatchInputHash(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, u8 *out);
+static bool ncaLoadCachedHashDataPatch(NcaFsSectionContext *ctx, const u8 *input_hash, void *out, bool is_integrity_patch);
+static void ncaStoreCachedHashDataPatch(NcaFsSectionContext *ctx, const u8 *input_hash, const void *patch, bool is_integrity_patch);
+static void ncaGetHashDataPatchArray(const void *patch, bool is_integrity_patch, NcaHashDataPatch **out_array, u32 *out_count);
+static bool ncaCopyHashDataPatch(void *dst, const void *src, bool is_integrity_patch);
+static void ncaFreeHashDataPatch(void *patch, bool is_integrity_patch);
+static bool ncaReadHashLayerBlock(NcaFsSectionContext *ctx, u8 *out, u64 layer_offset, u64 read_start_offset, u64 read_end_offset, const NcaHashDataPatchRange *ranges, \
+                                  u32 range_count, u8 *crypto_buf);
 static bool ncaWritePatchToMemoryBuffer(NcaContext *ctx, const void *patch, u64 patch_size, u64 patch_offset, void *buf, u64 buf_size, u64 buf_offset);
 
-static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, u64 *out_block_size, u64 *out_block_offset);
+static int ncaContentReadRequestSortFunction(const void *a, const void *b);
+
+static bool ncaReadNcmContentFile(NcaContext *ctx, NcmContentStorage *ncm_storage, void *out, u64 read_size, u64 offset);
+static void ncaStripedReadWorkerThreadFunc(void *arg);
+
+static bool ncaPatchOverlayIndexAddEntry(NcaPatchOverlayIndex *index, const void *data, u64 size, u64 offset);
+static int ncaPatchOverlayEntrySortFunction(const void *a, const void *b);
+
+static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, u64 *out_block_size, u64 *out_block_offset, u8 *crypto_buf);
 
 bool ncaAllocateCryptoBuffer(void)
 {
     bool ret = false;
 
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex)
-    {
-        if (!g_ncaCryptoBuffer) g_ncaCryptoBuffer = malloc(NCA_CRYPTO_BUFFER_SIZE);
-        ret = (g_ncaCryptoBuffer != NULL);
-    }
+    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = _ncaAllocateCryptoBuffer();
 
     return ret;
 }
 
 void ncaFreeCryptoBuffer(void)
 {
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex)
-    {
-        if (!g_ncaCryptoBuffer) break;
-        free(g_ncaCryptoBuffer);
-        g_ncaCryptoBuffer = NULL;
-    }
+    /* Crypto buffers are owned by the shared buffer pool, which frees them on its own. */
+    SCOPED_LOCK(&g_ncaCryptoBufferMutex) g_ncaCryptoBufferSize = 0;
 }
 
-bool ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik)
+void ncaInvalidateHeaderCache(u8 storage_id)
 {
-    NcmContentStorage *ncm_storage = NULL;
-
-    if (!out || (storage_id != NcmStorageId_GameCard && !(ncm_storage = titleGetNcmStorageByStorageId(storage_id))) || \
-        (storage_id == NcmStorageId_GameCard && (hfs_partition_type < HashFileSystemPartitionType_Root || hfs_partition_type >= HashFileSystemPartitionType_Count)) || \
-        !meta_key || !content_info || content_info->content_type >= NcmContentType_DeltaFragment)
+    SCOPED_LOCK(&g_ncaHeaderCacheMutex)
     {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return false;
+        for(u32 i = 0; i < NCA_HEADER_CACHE_ENTRY_COUNT; i++)
+        {
+            NcaHeaderCacheEntry *entry = &(g_ncaHeaderCache[i]);
+            if (entry->valid && (storage_id == NcmStorageId_Any || entry->storage_id == storage_id)) memset(entry, 0, sizeof(NcaHeaderCacheEntry));
+        }
     }
+}
 
-    /* Clear output NCA context. */
-    memset(out, 0, sizeof(NcaContext));
-
-    /* Fill NCA context. */
-    out->title_id = meta_key->id;
-    out->title_version.value = meta_key->version;
-    out->title_type = meta_key->type;
-
-    memcpy(&(out->content_id), &(content_info->content_id), sizeof(NcmContentId));
-    utilsGenerateHexString(out->content_id_str, sizeof(out->content_id_str), out->content_id.c, sizeof(out->content_id.c), false);
-
-    ncmContentInfoSizeToU64(content_info, &(out->content_size));
-    utilsGenerateFormattedSizeString((double)out->content_size, out->content_size_str, sizeof(out->content_size_str));
-
-    out->content_type = content_info->content_type;
-    out->id_offset = content_info->id_offset;
-
-    if (out->content_size < NCA_FULL_HEADER_LENGTH)
+void ncaFreeHashDataPatchCache(void)
+{
+    SCOPED_LOCK(&g_ncaPatchCacheMutex)
     {
-        LOG_MSG_ERROR("Invalid size for NCA \"%s\"!", out->content_id_str);
-        return false;
+        for(u32 i = 0; i < NCA_PATCH_CACHE_ENTRY_COUNT; i++)
+        {
+            NcaHashDataPatchCacheEntry *entry = &(g_ncaPatchCache[i]);
+            if (entry->valid) ncaFreeHashDataPatch(&(entry->hierarchical_sha256_patch), entry->is_integrity_patch);
+            memset(entry, 0, sizeof(NcaHashDataPatchCacheEntry));
+        }
+
+        g_ncaPatchCacheTick = 0;
     }
+}
+
+bool ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik)
+{
+    return _ncaInitializeContext(out, storage_id, hfs_partition_type, meta_key, content_info, tik, false);
+}
 
-    return ncaInitializeContextCommon(out, storage_id, hfs_partition_type, ncm_storage, tik);
+bool ncaInitializeContextLazy(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik)
+{
+    return _ncaInitializeContext(out, storage_id, hfs_partition_type, meta_key, content_info, tik, true);
 }
 
 bool ncaInitializeContextByHashFileSystemEntry(NcaContext *out, HashFileSystemContext *hfs_ctx, HashFileSystemEntry *hfs_entry, Ticket *tik)
@@ -250,11 +367,37 @@ bool ncaInitializeContextByHashFileSystemEntry(NcaContext *out, HashFileSystemCo
 
     if (hfs_entry_name_len == NCA_HFS_META_NAME_LENGTH) out->content_type = NcmContentType_Meta;    /* Set Meta as the content type if we know it. */
 
-    return ncaInitializeContextCommon(out, NcmStorageId_GameCard, hfs_ctx->type, NULL, tik);
+    return ncaInitializeContextCommon(out, NcmStorageId_GameCard, hfs_ctx->type, NULL, tik, false);
+}
+
+NcaFsSectionContext *ncaGetFsSectionContext(NcaContext *ctx, u8 section_idx)
+{
+    if (!ctx || section_idx >= NCA_FS_HEADER_COUNT)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    NcaFsSectionContext *fs_ctx = &(ctx->fs_ctx[section_idx]);
+
+    /* Initialize NCA FS section context on first access, if needed. */
+    if (ctx->lazy_fs_section_init)
+    {
+        SCOPED_LOCK(&(ctx->fs_section_init_mutex))
+        {
+            if (ctx->fs_section_init_mask & BIT(section_idx)) break;
+            ncaInitializeFsSectionContext(ctx, section_idx);
+            ctx->fs_section_init_mask |= BIT(section_idx);
+        }
+    }
+
+    return (fs_ctx->enabled ? fs_ctx : NULL);
 }
 
 bool ncaReadContentFile(NcaContext *ctx, void *out, u64 read_size, u64 offset)
 {
+    TRACE_FUNC();
+
     if (!ctx || !*(ctx->content_id_str) || (ctx->storage_id != NcmStorageId_GameCard && !ctx->ncm_storage) || (ctx->storage_id == NcmStorageId_GameCard && !ctx->gamecard_offset) || !out || \
         !read_size || (offset + read_size) > ctx->content_size)
     {
@@ -262,26 +405,260 @@ bool ncaReadContentFile(NcaContext *ctx, void *out, u64 read_size, u64 offset)
         return false;
     }
 
-    Result rc = 0;
     bool ret = false;
 
-    if (ctx->storage_id != NcmStorageId_GameCard)
+    /* Split big reads into smaller chunks if a cancellation token has been bound to the calling thread, so we can bail out between chunks. */
+    u64 chunk_size = (cancelTokenIsCurrentBound() ? CANCEL_TOKEN_CHUNK_SIZE : read_size);
+
+    for(u64 cur_offset = 0, cur_size = 0; cur_offset < read_size; cur_offset += cur_size)
     {
-        /* Retrieve NCA data normally. */
-        /* This strips NAX0 crypto from SD card NCAs (not used on eMMC NCAs). */
-        rc = ncmContentStorageReadContentIdFile(ctx->ncm_storage, out, read_size, &(ctx->content_id), offset);
-        ret = R_SUCCEEDED(rc);
-        if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX bytes block at offset 0x%lX from NCA \"%s\"! (ncm) (0x%X).", read_size, offset, ctx->content_id_str, rc);
-    } else {
-        /* Retrieve NCA data using raw gamecard reads. */
-        /* Fixes NCA read issues with gamecards under HOS < 4.0.0 when using ncmContentStorageReadContentIdFile(). */
-        ret = gamecardReadStorage(out, read_size, ctx->gamecard_offset + offset);
-        if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX bytes block at offset 0x%lX from NCA \"%s\"! (gamecard).", read_size, offset, ctx->content_id_str);
+        u8 *out_ptr = ((u8*)out + cur_offset);
+        cur_size = MIN(chunk_size, read_size - cur_offset);
+
+        if (cancelTokenIsCurrentCancelled())
+        {
+            LOG_MSG_DEBUG("NCA \"%s\" read cancelled at offset 0x%lX.", ctx->content_id_str, offset + cur_offset);
+            ret = false;
+            break;
+        }
+
+        if (ctx->storage_id != NcmStorageId_GameCard)
+        {
+            /* Retrieve NCA data normally. */
+            ret = ncaReadNcmContentFile(ctx, ctx->ncm_storage, out_ptr, cur_size, offset + cur_offset);
+        } else {
+            /* Retrieve NCA data using raw gamecard reads. */
+            /* Fixes NCA read issues with gamecards under HOS < 4.0.0 when using ncmContentStorageReadContentIdFile(). */
+            ret = gamecardReadStorage(out_ptr, cur_size, ctx->gamecard_offset + offset + cur_offset);
+            if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX bytes block at offset 0x%lX from NCA \"%s\"! (gamecard).", cur_size, offset + cur_offset, ctx->content_id_str);
+        }
+
+        if (!ret) break;
     }
 
     return ret;
 }
 
+NcaStripedReader *ncaCreateStripedReader(u8 storage_id)
+{
+    if (storage_id == NcmStorageId_GameCard || storage_id == NcmStorageId_Any)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    NcaStripedReader *reader = NULL;
+    Result rc = 0;
+
+    /* Allocate memory for the striped reader. */
+    reader = calloc(1, sizeof(NcaStripedReader));
+    if (!reader)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the striped reader!");
+        return NULL;
+    }
+
+    mutexInit(&(reader->mutex));
+    condvarInit(&(reader->cond));
+    reader->storage_id = storage_id;
+
+    /* Open a ncm storage session and create a worker thread for each worker. Stick to the workers we already have if we run into any errors. */
+    for(u32 i = 0; i < NCA_STRIPED_READ_WORKER_COUNT; i++)
+    {
+        NcaStripedReadWorker *worker = &(reader->workers[i]);
+        worker->reader = reader;
+
+        rc = ncmOpenContentStorage(&(worker->ncm_storage), storage_id);
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_WARNING("ncmOpenContentStorage failed for striped read worker #%u! (0x%X).", i, rc);
+            break;
+        }
+
+        if (!threadPlacementCreateThread(&(worker->thread), ncaStripedReadWorkerThreadFunc, worker, ThreadPlacementStage_Read))
+        {
+            LOG_MSG_WARNING("Failed to create striped read worker thread #%u!", i);
+            ncmContentStorageClose(&(worker->ncm_storage));
+            break;
+        }
+
+        reader->worker_count++;
+    }
+
+    if (!reader->worker_count)
+    {
+        LOG_MSG_ERROR("Failed to create any striped read workers!");
+        free(reader);
+        return NULL;
+    }
+
+    LOG_MSG_DEBUG("Striped reader created for %s (%u worker[s]).", titleGetNcmStorageIdName(storage_id), reader->worker_count);
+
+    return reader;
+}
+
+void ncaFreeStripedReader(NcaStripedReader *reader)
+{
+    if (!reader) return;
+
+    /* Ask the worker threads to exit. Any in-progress reads are completed first. */
+    SCOPED_LOCK(&(reader->mutex))
+    {
+        reader->exit = true;
+        condvarWakeAll(&(reader->cond));
+    }
+
+    for(u32 i = 0; i < reader->worker_count; i++)
+    {
+        NcaStripedReadWorker *worker = &(reader->workers[i]);
+        threadPlacementJoinThread(&(worker->thread));
+        ncmContentStorageClose(&(worker->ncm_storage));
+    }
+
+    free(reader);
+}
+
+bool ncaStripedReaderReadContentFile(NcaStripedReader *reader, NcaContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    /* Fall back to a regular read if this request can't be split. */
+    u32 stripe_count = (reader && ctx ? (u32)MIN((u64)(reader->worker_count + 1), read_size / NCA_STRIPED_READ_MIN_STRIPE_SIZE) : 0);
+
+    if (stripe_count < 2 || ctx->storage_id != reader->storage_id || !ctx->ncm_storage || !out || (offset + read_size) > ctx->content_size)
+    {
+        return ncaReadContentFile(ctx, out, read_size, offset);
+    }
+
+    TRACE_FUNC();
+
+    if (cancelTokenIsCurrentCancelled())
+    {
+        LOG_MSG_DEBUG("NCA \"%s\" striped read cancelled at offset 0x%lX.", ctx->content_id_str, offset);
+        return false;
+    }
+
+    u64 stripe_size = ALIGN_UP(read_size / stripe_count, NCA_STRIPED_READ_STRIPE_ALIGNMENT);
+    bool success = false;
+
+    /* Hand every stripe but the first one over to the workers. Each stripe is read straight into its own area from the output buffer, so data is reassembled in order as it arrives. */
+    SCOPED_LOCK(&(reader->mutex))
+    {
+        for(u32 i = 1; i < stripe_count; i++)
+        {
+            NcaStripedReadWorker *worker = &(reader->workers[i - 1]);
+            u64 stripe_offset = (i * stripe_size);
+
+            worker->nca_ctx = ctx;
+            worker->out = ((u8*)out + stripe_offset);
+            worker->size = (i < (stripe_count - 1) ? stripe_size : (read_size - stripe_offset));
+            worker->offset = (offset + stripe_offset);
+            worker->success = false;
+            worker->state = NcaStripedReadWorkerState_Pending;
+        }
+
+        condvarWakeAll(&(reader->cond));
+    }
+
+    /* Read the first stripe on our own while the workers take care of the rest. */
+    success = ncaReadNcmContentFile(ctx, ctx->ncm_storage, out, stripe_size, offset);
+
+    /* Wait for the workers. */
+    SCOPED_LOCK(&(reader->mutex))
+    {
+        for(u32 i = 1; i < stripe_count; i++)
+        {
+            NcaStripedReadWorker *worker = &(reader->workers[i - 1]);
+
+            while(worker->state == NcaStripedReadWorkerState_Pending) condvarWait(&(reader->cond), &(reader->mutex));
+
+            if (!worker->success) success = false;
+            worker->state = NcaStripedReadWorkerState_Idle;
+        }
+    }
+
+    return success;
+}
+
+bool ncaReadContentFileVectored(NcaContext *ctx, const NcaContentReadRequest *requests, u32 request_count)
+{
+    if (!ctx || !requests || !request_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    const NcaContentReadRequest **sorted_requests = NULL;
+    u8 *read_buf = NULL;
+    bool success = false;
+
+    /* Validate requests. */
+    for(u32 i = 0; i < request_count; i++)
+    {
+        const NcaContentReadRequest *request = &(requests[i]);
+        if (!request->out || !request->size || (request->offset + request->size) > ctx->content_size)
+        {
+            LOG_MSG_ERROR("Invalid read request #%u!", i);
+            return false;
+        }
+    }
+
+    /* Sort requests by offset without modifying the input array. */
+    sorted_requests = calloc(request_count, sizeof(NcaContentReadRequest*));
+    if (!sorted_requests)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for sorted read request array!");
+        goto end;
+    }
+
+    for(u32 i = 0; i < request_count; i++) sorted_requests[i] = &(requests[i]);
+    if (request_count > 1) qsort(sorted_requests, request_count, sizeof(NcaContentReadRequest*), &ncaContentReadRequestSortFunction);
+
+    for(u32 i = 0; i < request_count;)
+    {
+        /* Coalesce nearby requests into a single read. */
+        u64 read_start = sorted_requests[i]->offset, read_end = (read_start + sorted_requests[i]->size);
+        u32 j = (i + 1);
+
+        for(; j < request_count; j++)
+        {
+            const NcaContentReadRequest *request = sorted_requests[j];
+            u64 request_end = MAX(read_end, request->offset + request->size);
+
+            if (request->offset > (read_end + NCA_VECTORED_READ_MAX_GAP) || (request_end - read_start) > NCA_VECTORED_READ_MAX_SIZE) break;
+
+            read_end = request_end;
+        }
+
+        if (j == (i + 1))
+        {
+            /* Single request. Read data straight into its output buffer. */
+            if (!ncaReadContentFile(ctx, sorted_requests[i]->out, sorted_requests[i]->size, sorted_requests[i]->offset)) goto end;
+        } else {
+            /* Allocate memory for our coalesced read buffer, if needed. */
+            if (!read_buf && !(read_buf = malloc(NCA_VECTORED_READ_MAX_SIZE)))
+            {
+                LOG_MSG_ERROR("Failed to allocate memory for coalesced read buffer!");
+                goto end;
+            }
+
+            if (!ncaReadContentFile(ctx, read_buf, read_end - read_start, read_start)) goto end;
+
+            /* Scatter read data. */
+            for(u32 k = i; k < j; k++) memcpy(sorted_requests[k]->out, read_buf + (sorted_requests[k]->offset - read_start), sorted_requests[k]->size);
+        }
+
+        i = j;
+    }
+
+    success = true;
+
+end:
+    if (read_buf) free(read_buf);
+
+    if (sorted_requests) free(sorted_requests);
+
+    return success;
+}
+
 bool ncaGetFsSectionHashTargetExtents(NcaFsSectionContext *ctx, u64 *out_offset, u64 *out_size)
 {
     if (!ctx || (!out_offset && !out_size))
@@ -325,78 +702,378 @@ bool ncaGetFsSectionHashTargetExtents(NcaFsSectionContext *ctx, u64 *out_offset,
 
 bool ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset)
 {
-    bool ret = false;
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = _ncaReadFsSection(ctx, out, read_size, offset);
-    return ret;
-}
-
-bool ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt)
-{
-    bool ret = false;
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = _ncaReadAesCtrExStorage(ctx, out, read_size, offset, ctr_val, decrypt);
-    return ret;
-}
+    if (!ctx)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
 
-bool ncaGenerateHierarchicalSha256Patch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalSha256Patch *out)
-{
+    u8 *crypto_buf = ncaAcquireCryptoBuffer();
     bool ret = false;
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = ncaGenerateHashDataPatch(ctx, data, data_size, data_offset, out, false);
-    return ret;
-}
-
-void ncaWriteHierarchicalSha256PatchToMemoryBuffer(NcaContext *ctx, NcaHierarchicalSha256Patch *patch, void *buf, u64 buf_size, u64 buf_offset)
-{
-    if (!ctx || !*(ctx->content_id_str) || ctx->content_size < NCA_FULL_HEADER_LENGTH || !patch || patch->written || \
-        memcmp(&(patch->content_id), &(ctx->content_id), sizeof(NcmContentId)) != 0 || !patch->hash_region_count || \
-        patch->hash_region_count > NCA_HIERARCHICAL_SHA256_MAX_REGION_COUNT || !buf || !buf_size || (buf_offset + buf_size) > ctx->content_size) return;
-
-    patch->written = true;
 
-    for(u32 i = 0; i < patch->hash_region_count; i++)
+    SCOPED_LOCK(&(ctx->crypto_mutex))
     {
-        NcaHashDataPatch *hash_region_patch = &(patch->hash_region_patch[i]);
-        if (hash_region_patch->written) continue;
-
-        hash_region_patch->written = ncaWritePatchToMemoryBuffer(ctx, hash_region_patch->data, hash_region_patch->size, hash_region_patch->offset, buf, buf_size, buf_offset);
-        if (!hash_region_patch->written) patch->written = false;
+        ret = _ncaReadFsSection(ctx, out, read_size, offset, crypto_buf);
+        if (ret && ctx->verify_reads) ret = ncaVerifyFsSectionData(ctx, out, read_size, offset, crypto_buf);
     }
-}
 
-bool ncaGenerateHierarchicalIntegrityPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalIntegrityPatch *out)
-{
-    bool ret = false;
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = ncaGenerateHashDataPatch(ctx, data, data_size, data_offset, out, true);
+    ncaReleaseCryptoBuffer(crypto_buf);
+
     return ret;
 }
 
-void ncaWriteHierarchicalIntegrityPatchToMemoryBuffer(NcaContext *ctx, NcaHierarchicalIntegrityPatch *patch, void *buf, u64 buf_size, u64 buf_offset)
+bool ncaQueryFsSectionExtents(NcaFsSectionContext *ctx, StorageExtentList *out, u64 size, u64 offset)
 {
-    if (!ctx || !*(ctx->content_id_str) || ctx->content_size < NCA_FULL_HEADER_LENGTH || !patch || patch->written || \
-        memcmp(&(patch->content_id), &(ctx->content_id), sizeof(NcmContentId)) != 0 || !buf || !buf_size || (buf_offset + buf_size) > ctx->content_size) return;
-
-    patch->written = true;
-
-    for(u32 i = 0; i < NCA_IVFC_LEVEL_COUNT; i++)
+    if (!ctx || !ctx->enabled || !ctx->nca_ctx || !out || !size || (offset + size) > ctx->section_size)
     {
-        NcaHashDataPatch *hash_level_patch = &(patch->hash_level_patch[i]);
-        if (hash_level_patch->written) continue;
-
-        hash_level_patch->written = ncaWritePatchToMemoryBuffer(ctx, hash_level_patch->data, hash_level_patch->size, hash_level_patch->offset, buf, buf_size, buf_offset);
-        if (!hash_level_patch->written) patch->written = false;
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
     }
-}
 
-void ncaSetDownloadDistributionType(NcaContext *ctx)
-{
-    if (!ctx || ctx->content_size < NCA_FULL_HEADER_LENGTH || !*(ctx->content_id_str) || ctx->content_type > NcmContentType_DeltaFragment || \
-        ctx->header.distribution_type == NcaDistributionType_Download) return;
-    ctx->header.distribution_type = NcaDistributionType_Download;
-    LOG_MSG_INFO("Set download distribution type to %s NCA \"%s\".", titleGetNcmContentTypeName(ctx->content_type), ctx->content_id_str);
+    StorageExtent extent = {
+        .offset = offset,
+        .size = size,
+        .type = StorageExtentType_Data,
+        .source = StorageExtentSource_NcaFsSection,
+        .source_ctx = ctx,
+        .physical_offset = (ctx->section_offset + offset),
+        .physical_size = size
+    };
+
+    return storageExtentListAppend(out, &extent);
 }
 
-bool ncaRemoveTitleKeyCrypto(NcaContext *ctx)
+bool ncaSetFsSectionReadVerification(NcaFsSectionContext *ctx, bool enable)
 {
-    if (!ctx || ctx->content_size < NCA_FULL_HEADER_LENGTH || !*(ctx->content_id_str) || ctx->content_type > NcmContentType_DeltaFragment)
+    if (!ctx || (enable && (!ctx->enabled || !ctx->nca_ctx)))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u8 *crypto_buf = NULL;
+    bool ret = false;
+
+    /* Disable verified reads and free the cached hash layer. */
+    if (!enable)
+    {
+        SCOPED_LOCK(&(ctx->crypto_mutex))
+        {
+            if (ctx->verify_hash_layer) free(ctx->verify_hash_layer);
+            ctx->verify_hash_layer = NULL;
+            ctx->verify_hash_layer_size = 0;
+            ctx->verify_reads = false;
+        }
+
+        return true;
+    }
+
+    if (ctx->has_sparse_layer || ctx->has_compression_layer || ctx->has_patch_indirect_layer || ctx->has_patch_aes_ctr_ex_layer || ncaFsSectionGetHashLayerCount(ctx) < 2)
+    {
+        LOG_MSG_ERROR("Verified reads aren't supported by NCA \"%s\" FS section #%u!", ctx->nca_ctx->content_id_str, ctx->section_idx);
+        return false;
+    }
+
+    crypto_buf = ncaAcquireCryptoBuffer();
+
+    SCOPED_LOCK(&(ctx->crypto_mutex))
+    {
+        /* Check if verified reads have already been enabled. */
+        if (ctx->verify_reads)
+        {
+            ret = true;
+            break;
+        }
+
+        /* Read and verify each hash layer, starting from the master layer. */
+        /* Only the parent hash layer for the data layer is kept. Upper hash layers are discarded once their child layer has been verified. */
+        u32 layer_count = ncaFsSectionGetHashLayerCount(ctx);
+        u8 *layer = NULL;
+        NcaRegion layer_region = {0};
+
+        for(u32 i = 0; i < (layer_count - 1); i++)
+        {
+            u8 *child_layer = ncaFsSectionReadVerifiedHashLayer(ctx, i, layer, crypto_buf);
+            if (layer) free(layer);
+
+            layer = child_layer;
+            if (!layer) break;
+        }
+
+        if (!layer || !ncaFsSectionGetHashLayer(ctx, layer_count - 2, &layer_region, NULL))
+        {
+            LOG_MSG_ERROR("Failed to verify hash layers from NCA \"%s\" FS section #%u!", ctx->nca_ctx->content_id_str, ctx->section_idx);
+            if (layer) free(layer);
+            break;
+        }
+
+        /* Update context. */
+        ctx->verify_hash_layer = layer;
+        ctx->verify_hash_layer_size = layer_region.size;
+        ctx->verify_reads = ret = true;
+    }
+
+    ncaReleaseCryptoBuffer(crypto_buf);
+
+    return ret;
+}
+
+bool ncaVerifyRawFsSectionData(NcaFsSectionContext *ctx, void *data, u64 data_size, u64 offset)
+{
+    if (!ctx || !ctx->enabled || !ctx->nca_ctx || !data || !data_size || (offset + data_size) > ctx->section_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    NcaRegion data_region = {0};
+    u64 crypt_unit_size = (ctx->encryption_type == NcaEncryptionType_AesXts ? NCA_AES_XTS_SECTOR_SIZE : AES_BLOCK_SIZE);
+    u64 start_offset = 0, end_offset = 0;
+    u8 *crypto_buf = NULL;
+    bool ret = false;
+
+    SCOPED_LOCK(&(ctx->crypto_mutex))
+    {
+        if (!ctx->verify_reads || !ncaFsSectionGetHashLayer(ctx, ncaFsSectionGetHashLayerCount(ctx) - 1, &data_region, NULL))
+        {
+            LOG_MSG_ERROR("Verified reads haven't been enabled for NCA \"%s\" FS section #%u!", ctx->nca_ctx->content_id_str, ctx->section_idx);
+            break;
+        }
+
+        /* Only keep the part of the input buffer that overlaps the data layer. Hash layers are verified by ncaSetFsSectionReadVerification(). */
+        /* Its boundaries are then aligned to the crypto unit size, since partial AES-CTR blocks / AES-XTS sectors can't be decrypted on their own. */
+        /* Any data layer blocks left partially uncovered are read by ncaVerifyFsSectionData(). */
+        start_offset = ALIGN_UP(MAX(offset, data_region.offset), crypt_unit_size);
+        end_offset = ALIGN_DOWN(MIN(offset + data_size, data_region.offset + data_region.size), crypt_unit_size);
+
+        if (start_offset >= end_offset)
+        {
+            ret = true;
+            break;
+        }
+
+        u8 *start_ptr = ((u8*)data + (start_offset - offset));
+
+        if (!ncaDecryptRawFsSectionData(ctx, start_ptr, end_offset - start_offset, start_offset)) break;
+
+        crypto_buf = ncaAcquireCryptoBuffer();
+        ret = ncaVerifyFsSectionData(ctx, start_ptr, end_offset - start_offset, start_offset, crypto_buf);
+        ncaReleaseCryptoBuffer(crypto_buf);
+    }
+
+    return ret;
+}
+
+bool ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt)
+{
+    if (!ctx)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u8 *crypto_buf = ncaAcquireCryptoBuffer();
+    bool ret = false;
+
+    SCOPED_LOCK(&(ctx->crypto_mutex)) ret = _ncaReadAesCtrExStorage(ctx, out, read_size, offset, ctr_val, decrypt, crypto_buf);
+
+    ncaReleaseCryptoBuffer(crypto_buf);
+
+    return ret;
+}
+
+bool ncaReadAesCtrExStorageRanges(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, const NcaAesCtrExRange *ranges, u32 range_count)
+{
+    if (!ctx || !ranges || !range_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u8 *crypto_buf = ncaAcquireCryptoBuffer();
+    bool ret = false;
+
+    SCOPED_LOCK(&(ctx->crypto_mutex)) ret = _ncaReadAesCtrExStorageRanges(ctx, out, read_size, offset, ranges, range_count, crypto_buf);
+
+    ncaReleaseCryptoBuffer(crypto_buf);
+
+    return ret;
+}
+
+bool ncaGenerateHierarchicalSha256Patch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalSha256Patch *out)
+{
+    NcaHashDataPatchRange range = { .data = data, .size = data_size, .offset = data_offset };
+    return ncaGenerateHierarchicalSha256PatchFromRanges(ctx, &range, 1, out);
+}
+
+bool ncaGenerateHierarchicalSha256PatchFromRanges(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, NcaHierarchicalSha256Patch *out)
+{
+    if (!ctx)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    return ncaGenerateCachedHashDataPatch(ctx, ranges, range_count, out, false);
+}
+
+void ncaWriteHierarchicalSha256PatchToMemoryBuffer(NcaContext *ctx, NcaHierarchicalSha256Patch *patch, void *buf, u64 buf_size, u64 buf_offset)
+{
+    if (!ctx || !*(ctx->content_id_str) || ctx->content_size < NCA_FULL_HEADER_LENGTH || !patch || patch->written || \
+        memcmp(&(patch->content_id), &(ctx->content_id), sizeof(NcmContentId)) != 0 || !patch->hash_region_count || \
+        patch->hash_region_count > NCA_HIERARCHICAL_SHA256_MAX_REGION_COUNT || !buf || !buf_size || (buf_offset + buf_size) > ctx->content_size) return;
+
+    patch->written = true;
+
+    for(u32 i = 0; i < patch->hash_region_count; i++)
+    {
+        NcaHashDataPatch *hash_region_patch = &(patch->hash_region_patch[i]);
+        if (hash_region_patch->written) continue;
+
+        hash_region_patch->written = ncaWritePatchToMemoryBuffer(ctx, hash_region_patch->data, hash_region_patch->size, hash_region_patch->offset, buf, buf_size, buf_offset);
+        if (!hash_region_patch->written) patch->written = false;
+    }
+}
+
+bool ncaGenerateHierarchicalIntegrityPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalIntegrityPatch *out)
+{
+    NcaHashDataPatchRange range = { .data = data, .size = data_size, .offset = data_offset };
+    return ncaGenerateHierarchicalIntegrityPatchFromRanges(ctx, &range, 1, out);
+}
+
+bool ncaGenerateHierarchicalIntegrityPatchFromRanges(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, NcaHierarchicalIntegrityPatch *out)
+{
+    if (!ctx)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    return ncaGenerateCachedHashDataPatch(ctx, ranges, range_count, out, true);
+}
+
+void ncaWriteHierarchicalIntegrityPatchToMemoryBuffer(NcaContext *ctx, NcaHierarchicalIntegrityPatch *patch, void *buf, u64 buf_size, u64 buf_offset)
+{
+    if (!ctx || !*(ctx->content_id_str) || ctx->content_size < NCA_FULL_HEADER_LENGTH || !patch || patch->written || \
+        memcmp(&(patch->content_id), &(ctx->content_id), sizeof(NcmContentId)) != 0 || !buf || !buf_size || (buf_offset + buf_size) > ctx->content_size) return;
+
+    patch->written = true;
+
+    for(u32 i = 0; i < NCA_IVFC_LEVEL_COUNT; i++)
+    {
+        NcaHashDataPatch *hash_level_patch = &(patch->hash_level_patch[i]);
+        if (hash_level_patch->written) continue;
+
+        hash_level_patch->written = ncaWritePatchToMemoryBuffer(ctx, hash_level_patch->data, hash_level_patch->size, hash_level_patch->offset, buf, buf_size, buf_offset);
+        if (!hash_level_patch->written) patch->written = false;
+    }
+}
+
+bool ncaPatchOverlayIndexAddEncryptedHeaderData(NcaPatchOverlayIndex *index, NcaContext *ctx)
+{
+    if (!index || !ctx || ctx->content_size < NCA_FULL_HEADER_LENGTH)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Add NCA header. */
+    if (!ncaPatchOverlayIndexAddEntry(index, &(ctx->encrypted_header), sizeof(NcaHeader), 0)) return false;
+
+    /* Add NCA FS section headers. */
+    for(u8 i = 0; i < NCA_FS_HEADER_COUNT; i++)
+    {
+        NcaFsSectionContext *fs_ctx = (ctx->lazy_fs_section_init ? ncaGetFsSectionContext(ctx, i) : &(ctx->fs_ctx[i]));
+        if (!fs_ctx || !fs_ctx->enabled) continue;
+
+        u64 fs_header_offset = (ctx->format_version != NcaVersion_Nca0 ? (sizeof(NcaHeader) + (i * sizeof(NcaFsHeader))) : fs_ctx->section_offset);
+        if (!ncaPatchOverlayIndexAddEntry(index, &(fs_ctx->encrypted_header), sizeof(NcaFsHeader), fs_header_offset)) return false;
+    }
+
+    return true;
+}
+
+bool ncaPatchOverlayIndexAddHierarchicalSha256Patch(NcaPatchOverlayIndex *index, NcaHierarchicalSha256Patch *patch)
+{
+    if (!index || !patch || !patch->hash_region_count || patch->hash_region_count > NCA_HIERARCHICAL_SHA256_MAX_REGION_COUNT)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    for(u32 i = 0; i < patch->hash_region_count; i++)
+    {
+        NcaHashDataPatch *hash_region_patch = &(patch->hash_region_patch[i]);
+        if (hash_region_patch->data && !ncaPatchOverlayIndexAddEntry(index, hash_region_patch->data, hash_region_patch->size, hash_region_patch->offset)) return false;
+    }
+
+    return true;
+}
+
+bool ncaPatchOverlayIndexAddHierarchicalIntegrityPatch(NcaPatchOverlayIndex *index, NcaHierarchicalIntegrityPatch *patch)
+{
+    if (!index || !patch)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    for(u32 i = 0; i < NCA_IVFC_LEVEL_COUNT; i++)
+    {
+        NcaHashDataPatch *hash_level_patch = &(patch->hash_level_patch[i]);
+        if (hash_level_patch->data && !ncaPatchOverlayIndexAddEntry(index, hash_level_patch->data, hash_level_patch->size, hash_level_patch->offset)) return false;
+    }
+
+    return true;
+}
+
+void ncaWritePatchOverlayIndexToMemoryBuffer(NcaContext *ctx, NcaPatchOverlayIndex *index, void *buf, u64 buf_size, u64 buf_offset)
+{
+    if (!ctx || !index || !index->entry_count || !buf || !buf_size || (buf_offset + buf_size) > ctx->content_size) return;
+
+    /* Sort entries, if needed. */
+    if (!index->sorted)
+    {
+        if (index->entry_count > 1) qsort(index->entries, index->entry_count, sizeof(NcaPatchOverlayEntry), &ncaPatchOverlayEntrySortFunction);
+        index->sorted = true;
+    }
+
+    /* Perform a binary search to find the first entry that ends past the start of the buffer. */
+    /* Entries don't overlap, so their end offsets are sorted as well. */
+    u32 low = 0, high = index->entry_count;
+
+    while(low < high)
+    {
+        u32 mid = (low + ((high - low) / 2));
+        NcaPatchOverlayEntry *entry = &(index->entries[mid]);
+
+        if ((entry->offset + entry->size) <= buf_offset)
+        {
+            low = (mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+
+    /* Only apply the entries that intersect the provided buffer. */
+    for(u32 i = low; i < index->entry_count && index->entries[i].offset < (buf_offset + buf_size); i++)
+    {
+        NcaPatchOverlayEntry *entry = &(index->entries[i]);
+        ncaWritePatchToMemoryBuffer(ctx, entry->data, entry->size, entry->offset, buf, buf_size, buf_offset);
+    }
+}
+
+void ncaSetDownloadDistributionType(NcaContext *ctx)
+{
+    if (!ctx || ctx->content_size < NCA_FULL_HEADER_LENGTH || !*(ctx->content_id_str) || ctx->content_type > NcmContentType_DeltaFragment || \
+        ctx->header.distribution_type == NcaDistributionType_Download) return;
+    ctx->header.distribution_type = NcaDistributionType_Download;
+    LOG_MSG_INFO("Set download distribution type to %s NCA \"%s\".", titleGetNcmContentTypeName(ctx->content_type), ctx->content_id_str);
+}
+
+bool ncaRemoveTitleKeyCrypto(NcaContext *ctx)
+{
+    if (!ctx || ctx->content_size < NCA_FULL_HEADER_LENGTH || !*(ctx->content_id_str) || ctx->content_type > NcmContentType_DeltaFragment)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -508,8 +1185,8 @@ void ncaWriteEncryptedHeaderDataToMemoryBuffer(NcaContext *ctx, void *buf, u64 b
     /* Attempt to write NCA FS section headers. */
     for(u8 i = 0; i < NCA_FS_HEADER_COUNT; i++)
     {
-        NcaFsSectionContext *fs_ctx = &(ctx->fs_ctx[i]);
-        if (!fs_ctx->enabled || fs_ctx->header_written) continue;
+        NcaFsSectionContext *fs_ctx = (ctx->lazy_fs_section_init ? ncaGetFsSectionContext(ctx, i) : &(ctx->fs_ctx[i]));
+        if (!fs_ctx || !fs_ctx->enabled || fs_ctx->header_written) continue;
 
         u64 fs_header_offset = (ctx->format_version != NcaVersion_Nca0 ? (sizeof(NcaHeader) + (i * sizeof(NcaFsHeader))) : fs_ctx->section_offset);
         fs_ctx->header_written = ncaWritePatchToMemoryBuffer(ctx, &(fs_ctx->encrypted_header), sizeof(NcaFsHeader), fs_header_offset, buf, buf_size, buf_offset);
@@ -560,41 +1237,86 @@ const char *ncaGetFsSectionTypeName(NcaFsSectionContext *ctx)
     return str;
 }
 
-static bool ncaInitializeContextCommon(NcaContext *out, u8 storage_id, u8 hfs_partition_type, NcmContentStorage *ncm_storage, Ticket *tik)
+static bool _ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik, \
+                                  bool lazy_fs_section_init)
 {
-    if (!out || !*(out->content_id_str) || out->content_size < NCA_FULL_HEADER_LENGTH || (storage_id != NcmStorageId_GameCard && !ncm_storage))
+    NcmContentStorage *ncm_storage = NULL;
+
+    if (!out || (storage_id != NcmStorageId_GameCard && !(ncm_storage = titleGetNcmStorageByStorageId(storage_id))) || \
+        (storage_id == NcmStorageId_GameCard && (hfs_partition_type < HashFileSystemPartitionType_Root || hfs_partition_type >= HashFileSystemPartitionType_Count)) || \
+        !meta_key || !content_info || content_info->content_type >= NcmContentType_DeltaFragment)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    u8 valid_fs_section_cnt = 0;
+    /* Clear output NCA context. */
+    memset(out, 0, sizeof(NcaContext));
 
     /* Fill NCA context. */
-    out->storage_id = storage_id;
-    out->ncm_storage = (out->storage_id != NcmStorageId_GameCard ? ncm_storage : NULL);
+    out->title_id = meta_key->id;
+    out->title_version.value = meta_key->version;
+    out->title_type = meta_key->type;
 
-    utilsGenerateHexString(out->hash_str, sizeof(out->hash_str), out->hash, sizeof(out->hash), false);  /* Placeholder, needs to be manually calculated. */
+    memcpy(&(out->content_id), &(content_info->content_id), sizeof(NcmContentId));
+    utilsGenerateHexString(out->content_id_str, sizeof(out->content_id_str), out->content_id.c, sizeof(out->content_id.c), false);
 
-    if (storage_id == NcmStorageId_GameCard)
-    {
-        /* Generate gamecard NCA filename. */
-        char nca_filename[0x30] = {0};
-        sprintf(nca_filename, "%s.%s", out->content_id_str, out->content_type == NcmContentType_Meta ? "cnmt.nca" : "nca");
+    ncmContentInfoSizeToU64(content_info, &(out->content_size));
+    utilsGenerateFormattedSizeString((double)out->content_size, out->content_size_str, sizeof(out->content_size_str));
 
-        /* Retrieve gamecard NCA offset. */
-        if (!gamecardGetHashFileSystemEntryInfoByName(hfs_partition_type, nca_filename, &(out->gamecard_offset), NULL))
-        {
-            LOG_MSG_ERROR("Error retrieving offset for \"%s\" entry in %s hash FS partition!", nca_filename, hfsGetPartitionNameString(hfs_partition_type));
+    out->content_type = content_info->content_type;
+    out->id_offset = content_info->id_offset;
+
+    if (out->content_size < NCA_FULL_HEADER_LENGTH)
+    {
+        LOG_MSG_ERROR("Invalid size for NCA \"%s\"!", out->content_id_str);
+        return false;
+    }
+
+    return ncaInitializeContextCommon(out, storage_id, hfs_partition_type, ncm_storage, tik, lazy_fs_section_init);
+}
+
+static bool ncaInitializeContextCommon(NcaContext *out, u8 storage_id, u8 hfs_partition_type, NcmContentStorage *ncm_storage, Ticket *tik, bool lazy_fs_section_init)
+{
+    if (!out || !*(out->content_id_str) || out->content_size < NCA_FULL_HEADER_LENGTH || (storage_id != NcmStorageId_GameCard && !ncm_storage))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u8 valid_fs_section_cnt = 0;
+
+    /* Fill NCA context. */
+    out->storage_id = storage_id;
+    out->ncm_storage = (out->storage_id != NcmStorageId_GameCard ? ncm_storage : NULL);
+
+    utilsGenerateHexString(out->hash_str, sizeof(out->hash_str), out->hash, sizeof(out->hash), false);  /* Placeholder, needs to be manually calculated. */
+
+    if (storage_id == NcmStorageId_GameCard)
+    {
+        /* Generate gamecard NCA filename. */
+        char nca_filename[0x30] = {0};
+        sprintf(nca_filename, "%s.%s", out->content_id_str, out->content_type == NcmContentType_Meta ? "cnmt.nca" : "nca");
+
+        /* Retrieve gamecard NCA offset. */
+        if (!gamecardGetHashFileSystemEntryInfoByName(hfs_partition_type, nca_filename, &(out->gamecard_offset), NULL))
+        {
+            LOG_MSG_ERROR("Error retrieving offset for \"%s\" entry in %s hash FS partition!", nca_filename, hfsGetPartitionNameString(hfs_partition_type));
             return false;
         }
     }
 
     /* Read decrypted NCA header and NCA FS section headers. */
-    if (!ncaReadDecryptedHeader(out))
+    /* Validated header state is restored from the header cache if this NCA was previously initialized. */
+    if (!ncaLoadCachedHeader(out))
     {
-        LOG_MSG_ERROR("Failed to read decrypted NCA \"%s\" header!", out->content_id_str);
-        return false;
+        if (!ncaReadDecryptedHeader(out))
+        {
+            LOG_MSG_ERROR("Failed to read decrypted NCA \"%s\" header!", out->content_id_str);
+            return false;
+        }
+
+        ncaStoreCachedHeader(out);
     }
 
     if (out->rights_id_available)
@@ -616,10 +1338,13 @@ static bool ncaInitializeContextCommon(NcaContext *out, u8 storage_id, u8 hfs_pa
     }
 
     /* Parse NCA FS sections. */
+    /* If lazy initialization was requested, we'll only check which NCA FS sections are populated. They'll be parsed by ncaGetFsSectionContext() on first access. */
+    out->lazy_fs_section_init = lazy_fs_section_init;
+
     for(u8 i = 0; i < NCA_FS_HEADER_COUNT; i++)
     {
         /* Increase valid NCA FS section count if the FS section is valid. */
-        if (ncaInitializeFsSectionContext(out, i)) valid_fs_section_cnt++;
+        if ((lazy_fs_section_init && ncaIsFsInfoEntryValid(&(out->header.fs_info[i]))) || (!lazy_fs_section_init && ncaInitializeFsSectionContext(out, i))) valid_fs_section_cnt++;
     }
 
     if (!valid_fs_section_cnt) LOG_MSG_ERROR("Unable to identify any valid FS sections in NCA \"%s\"!", out->content_id_str);
@@ -627,6 +1352,92 @@ static bool ncaInitializeContextCommon(NcaContext *out, u8 storage_id, u8 hfs_pa
     return (valid_fs_section_cnt > 0);
 }
 
+static bool ncaLoadCachedHeader(NcaContext *ctx)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_ncaHeaderCacheMutex)
+    {
+        for(u32 i = 0; i < NCA_HEADER_CACHE_ENTRY_COUNT; i++)
+        {
+            NcaHeaderCacheEntry *entry = &(g_ncaHeaderCache[i]);
+
+            if (!entry->valid || entry->storage_id != ctx->storage_id || entry->content_size != ctx->content_size || \
+                memcmp(&(entry->content_id), &(ctx->content_id), sizeof(NcmContentId)) != 0) continue;
+
+            /* Restore header state. */
+            ctx->format_version = entry->format_version;
+            ctx->key_generation = entry->key_generation;
+            ctx->rights_id_available = entry->rights_id_available;
+            ctx->valid_main_signature = entry->valid_main_signature;
+
+            memcpy(&(ctx->header), &(entry->header), sizeof(NcaHeader));
+            memcpy(ctx->header_hash, entry->header_hash, sizeof(entry->header_hash));
+            memcpy(&(ctx->encrypted_header), &(entry->encrypted_header), sizeof(NcaHeader));
+            memcpy(&(ctx->decrypted_key_area), &(entry->decrypted_key_area), sizeof(NcaDecryptedKeyArea));
+
+            for(u8 j = 0; j < NCA_FS_HEADER_COUNT; j++)
+            {
+                memcpy(&(ctx->fs_ctx[j].header), &(entry->fs_header[j]), sizeof(NcaFsHeader));
+                memcpy(&(ctx->fs_ctx[j].encrypted_header), &(entry->fs_encrypted_header[j]), sizeof(NcaFsHeader));
+            }
+
+            entry->last_use = ++g_ncaHeaderCacheTick;
+            ret = true;
+
+            break;
+        }
+    }
+
+    return ret;
+}
+
+static void ncaStoreCachedHeader(NcaContext *ctx)
+{
+    SCOPED_LOCK(&g_ncaHeaderCacheMutex)
+    {
+        /* Pick an unused entry, or evict the least recently used one. */
+        NcaHeaderCacheEntry *entry = &(g_ncaHeaderCache[0]);
+
+        for(u32 i = 0; i < NCA_HEADER_CACHE_ENTRY_COUNT; i++)
+        {
+            NcaHeaderCacheEntry *cur_entry = &(g_ncaHeaderCache[i]);
+
+            if (!cur_entry->valid)
+            {
+                entry = cur_entry;
+                break;
+            }
+
+            if (cur_entry->last_use < entry->last_use) entry = cur_entry;
+        }
+
+        /* Store header state. */
+        entry->valid = true;
+        entry->last_use = ++g_ncaHeaderCacheTick;
+
+        memcpy(&(entry->content_id), &(ctx->content_id), sizeof(NcmContentId));
+        entry->storage_id = ctx->storage_id;
+        entry->content_size = ctx->content_size;
+
+        entry->format_version = ctx->format_version;
+        entry->key_generation = ctx->key_generation;
+        entry->rights_id_available = ctx->rights_id_available;
+        entry->valid_main_signature = ctx->valid_main_signature;
+
+        memcpy(&(entry->header), &(ctx->header), sizeof(NcaHeader));
+        memcpy(entry->header_hash, ctx->header_hash, sizeof(entry->header_hash));
+        memcpy(&(entry->encrypted_header), &(ctx->encrypted_header), sizeof(NcaHeader));
+        memcpy(&(entry->decrypted_key_area), &(ctx->decrypted_key_area), sizeof(NcaDecryptedKeyArea));
+
+        for(u8 i = 0; i < NCA_FS_HEADER_COUNT; i++)
+        {
+            memcpy(&(entry->fs_header[i]), &(ctx->fs_ctx[i].header), sizeof(NcaFsHeader));
+            memcpy(&(entry->fs_encrypted_header[i]), &(ctx->fs_ctx[i].encrypted_header), sizeof(NcaFsHeader));
+        }
+    }
+}
+
 NX_INLINE bool ncaIsFsInfoEntryValid(NcaFsInfo *fs_info)
 {
     if (!fs_info) return false;
@@ -1096,6 +1907,9 @@ static bool ncaInitializeFsSectionContext(NcaContext *nca_ctx, u32 section_idx)
         }
     }
 
+    /* Pick the read function for this FS section. */
+    ncaFsSectionSelectReadFunction(fs_ctx);
+
     /* Enable FS context if we got up to this point. */
     fs_ctx->enabled = success = true;
 
@@ -1188,9 +2002,186 @@ static bool ncaFsSectionValidateHashDataBoundaries(NcaFsSectionContext *ctx)
     return success;
 }
 
-static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset)
+static u8 *ncaAcquireCryptoBuffer(void)
+{
+    u8 *buf = NULL;
+    u64 buf_size = 0;
+
+    /* Make sure the crypto buffer size has already been determined. */
+    SCOPED_LOCK(&g_ncaCryptoBufferMutex)
+    {
+        if (g_ncaCryptoBufferSize || _ncaAllocateCryptoBuffer()) buf_size = g_ncaCryptoBufferSize;
+    }
+
+    /* Lease a short-lived buffer from the shared buffer pool. This blocks if the in-flight size cap has been hit, until another thread returns its own buffer. */
+    if (buf_size) buf = bufferPoolLease(buf_size, true);
+
+    if (!buf) LOG_MSG_ERROR("Failed to acquire NCA crypto buffer!");
+
+    return buf;
+}
+
+static void ncaReleaseCryptoBuffer(u8 *buf)
+{
+    bufferPoolReturn(buf);
+}
+
+static bool _ncaAllocateCryptoBuffer(void)
+{
+    /* Must be called with the crypto buffer mutex held. */
+    if (g_ncaCryptoBufferSize) return true;
+
+    /* Size crypto buffers according to the memory budget. Retry with halved sizes if we can't lease a buffer this big. */
+    /* The buffer is returned right away, which leaves it within the idle buffer cache from the shared buffer pool. */
+    u64 cur_size = utilsGetBudgetedBufferSize(NCA_CRYPTO_BUFFER_SIZE, NCA_CRYPTO_BUFFER_MIN_SIZE);
+    u8 *buf = NULL;
+
+    while(true)
+    {
+        buf = bufferPoolLease(cur_size, false);
+        if (buf || cur_size <= NCA_CRYPTO_BUFFER_MIN_SIZE) break;
+        cur_size = MAX(cur_size >> 1, NCA_CRYPTO_BUFFER_MIN_SIZE);
+    }
+
+    if (!buf) return false;
+
+    bufferPoolReturn(buf);
+    g_ncaCryptoBufferSize = cur_size;
+
+    LOG_MSG_DEBUG("NCA crypto buffer size: 0x%lX.", g_ncaCryptoBufferSize);
+
+    return true;
+}
+
+static void ncaFsSectionSelectReadFunction(NcaFsSectionContext *ctx)
+{
+    /* Sparse layers and plaintext hash regions need the generic read function: the former changes the IV offset, while the latter splits reads at the hash region boundary. */
+    if (ctx->has_sparse_layer || ctx->skip_hash_layer_crypto)
+    {
+        ctx->read_func = &ncaReadFsSectionGeneric;
+        return;
+    }
+
+    switch(ctx->encryption_type)
+    {
+        case NcaEncryptionType_None:
+            ctx->read_func = &ncaReadFsSectionPlaintext;
+            break;
+        case NcaEncryptionType_AesXts:
+            ctx->read_func = &ncaReadFsSectionAesXts;
+            break;
+        case NcaEncryptionType_AesCtr:
+        case NcaEncryptionType_AesCtrEx:
+            ctx->read_func = &ncaReadFsSectionAesCtr;
+            break;
+        default:
+            ctx->read_func = &ncaReadFsSectionGeneric;
+            break;
+    }
+}
+
+NX_INLINE bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf)
 {
-    if (!g_ncaCryptoBuffer || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
+    if (!ctx || !ctx->enabled || !ctx->read_func)
+    {
+        LOG_MSG_ERROR("Invalid NCA FS section header parameters!");
+        return false;
+    }
+
+    return ctx->read_func(ctx, out, read_size, offset, crypto_buf);
+}
+
+static bool ncaReadFsSectionPlaintext(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf)
+{
+    TRACE_FUNC();
+
+    if (!crypto_buf || !out || !read_size || (offset + read_size) > ctx->section_size)
+    {
+        LOG_MSG_ERROR("Invalid NCA FS section header parameters!");
+        return false;
+    }
+
+    u64 content_offset = (ctx->section_offset + offset);
+
+    if (!ncaReadContentFile(ctx->nca_ctx, out, read_size, content_offset))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (plaintext).", read_size, content_offset, ctx->nca_ctx->content_id_str, \
+                      ctx->section_idx);
+        return false;
+    }
+
+    return true;
+}
+
+static bool ncaReadFsSectionAesXts(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf)
+{
+    TRACE_FUNC();
+
+    if (!crypto_buf || !out || !read_size || (offset + read_size) > ctx->section_size)
+    {
+        LOG_MSG_ERROR("Invalid NCA FS section header parameters!");
+        return false;
+    }
+
+    NcaContext *nca_ctx = ctx->nca_ctx;
+    u64 content_offset = (ctx->section_offset + offset);
+
+    /* Unaligned reads go through the crypto buffer. */
+    if ((content_offset % NCA_AES_XTS_SECTOR_SIZE) || (read_size % NCA_AES_XTS_SECTOR_SIZE)) return ncaReadFsSectionGeneric(ctx, out, read_size, offset, crypto_buf);
+
+    if (!ncaReadContentFile(nca_ctx, out, read_size, content_offset))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (aligned).", read_size, content_offset, nca_ctx->content_id_str, ctx->section_idx);
+        return false;
+    }
+
+    u64 sector_num = ((nca_ctx->format_version != NcaVersion_Nca0 ? offset : (content_offset - sizeof(NcaHeader))) / NCA_AES_XTS_SECTOR_SIZE);
+
+    size_t crypt_res = aes128XtsNintendoCrypt(&(ctx->xts_decrypt_ctx), out, out, read_size, sector_num, NCA_AES_XTS_SECTOR_SIZE, false);
+    if (crypt_res != read_size)
+    {
+        LOG_MSG_ERROR("Failed to AES-XTS decrypt 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (aligned).", read_size, content_offset, nca_ctx->content_id_str, \
+                      ctx->section_idx);
+        return false;
+    }
+
+    return true;
+}
+
+static bool ncaReadFsSectionAesCtr(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf)
+{
+    TRACE_FUNC();
+
+    if (!crypto_buf || !out || !read_size || (offset + read_size) > ctx->section_size)
+    {
+        LOG_MSG_ERROR("Invalid NCA FS section header parameters!");
+        return false;
+    }
+
+    u64 content_offset = (ctx->section_offset + offset);
+
+    /* Unaligned reads go through the crypto buffer. */
+    if ((content_offset % AES_BLOCK_SIZE) || (read_size % AES_BLOCK_SIZE)) return ncaReadFsSectionGeneric(ctx, out, read_size, offset, crypto_buf);
+
+    if (!ncaReadContentFile(ctx->nca_ctx, out, read_size, content_offset))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (aligned).", read_size, content_offset, ctx->nca_ctx->content_id_str, \
+                      ctx->section_idx);
+        return false;
+    }
+
+    aes128CtrUpdatePartialCtr(ctx->ctr, content_offset);
+    statsAddCounter(StatsCounterType_AesCtr, read_size);
+    aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, out, out, read_size);
+
+    return true;
+}
+
+static bool ncaReadFsSectionGeneric(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u8 *crypto_buf)
+{
+    TRACE_FUNC();
+
+    if (!crypto_buf || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
         ctx->section_type >= NcaFsSectionType_Invalid || ctx->encryption_type == NcaEncryptionType_Auto || ctx->encryption_type >= NcaEncryptionType_Count || \
         !out || !read_size || (offset + read_size) > ctx->section_size)
     {
@@ -1209,6 +2200,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
 
     u64 block_start_offset = 0, block_end_offset = 0, block_size = 0;
     u64 data_start_offset = 0, chunk_size = 0, out_chunk_size = 0;
+    u64 crypt_unit_size = 0, chunk_sizes[3] = {0};
 
     NcaRegion plaintext_area = {0};
 
@@ -1232,7 +2224,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
         /* It may be plaintext or not depending on the returned hash region properties. */
         block_size = (plaintext_first ? plaintext_area.size : (plaintext_area.offset - offset));
 
-        if ((plaintext_first && !ncaReadContentFile(nca_ctx, out, block_size, content_offset)) || (!plaintext_first && !_ncaReadFsSection(ctx, out, block_size, offset)))
+        if ((plaintext_first && !ncaReadContentFile(nca_ctx, out, block_size, content_offset)) || (!plaintext_first && !ncaReadFsSectionGeneric(ctx, out, block_size, offset, crypto_buf)))
         {
             LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (plaintext hash region) (#1).", block_size, content_offset, \
                           nca_ctx->content_id_str, ctx->section_idx);
@@ -1247,7 +2239,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
 
         /* Read second chunk. */
         /* It may be plaintext or not depending on the returned hash region properties. */
-        if (read_size && ((plaintext_first && !_ncaReadFsSection(ctx, (u8*)out + block_size, read_size, offset)) || \
+        if (read_size && ((plaintext_first && !ncaReadFsSectionGeneric(ctx, (u8*)out + block_size, read_size, offset, crypto_buf)) || \
             (!plaintext_first && !ncaReadContentFile(nca_ctx, (u8*)out + block_size, read_size, content_offset))))
         {
             LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (plaintext hash region) (#2).", read_size, content_offset, \
@@ -1295,8 +2287,42 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
         if (ctx->encryption_type >= NcaEncryptionType_AesCtr && ctx->encryption_type <= NcaEncryptionType_AesCtrExSkipLayerHash)
         {
             aes128CtrUpdatePartialCtr(ctx->ctr, iv_offset);
-            aes128CtrContextResetCtr(&(ctx->ctr_ctx), ctx->ctr);
-            aes128CtrCrypt(&(ctx->ctr_ctx), out, out, read_size);
+            statsAddCounter(StatsCounterType_AesCtr, read_size);
+            aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, out, out, read_size);
+        }
+
+        ret = true;
+        goto end;
+    }
+
+    /* Calculate the sizes for the unaligned head, aligned interior and unaligned tail of this read. */
+    crypt_unit_size = (ctx->encryption_type == NcaEncryptionType_AesXts ? NCA_AES_XTS_SECTOR_SIZE : AES_BLOCK_SIZE);
+
+    chunk_sizes[0] = ((content_offset % crypt_unit_size) ? MIN(read_size, crypt_unit_size - (content_offset % crypt_unit_size)) : 0);
+    chunk_sizes[1] = ALIGN_DOWN(read_size - chunk_sizes[0], crypt_unit_size);
+    chunk_sizes[2] = (read_size - chunk_sizes[0] - chunk_sizes[1]);
+
+    /* Decrypt the aligned interior in place, using the output buffer. */
+    /* Only the partial AES-CTR block / AES-XTS sector at each end goes through the crypto buffer. */
+    if (chunk_sizes[1])
+    {
+        u64 sparse_base_offset = ctx->cur_sparse_virtual_offset, cur_offset = 0;
+
+        for(u32 i = 0; i < MAX_ELEMENTS(chunk_sizes); i++)
+        {
+            if (!chunk_sizes[i]) continue;
+
+            /* Restore the sparse virtual offset, since it is cleared by every ncaReadFsSectionGeneric() call. */
+            if (sparse_virtual_offset) ctx->cur_sparse_virtual_offset = (sparse_base_offset + cur_offset);
+
+            if (!ncaReadFsSectionGeneric(ctx, (u8*)out + cur_offset, chunk_sizes[i], offset + cur_offset, crypto_buf))
+            {
+                LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned) (#%u).", chunk_sizes[i], content_offset + cur_offset, \
+                              nca_ctx->content_id_str, ctx->section_idx, i + 1);
+                goto end;
+            }
+
+            cur_offset += chunk_sizes[i];
         }
 
         ret = true;
@@ -1304,16 +2330,16 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
     }
 
     /* Calculate offsets and block sizes. */
-    block_start_offset = ALIGN_DOWN(content_offset, ctx->encryption_type == NcaEncryptionType_AesXts ? NCA_AES_XTS_SECTOR_SIZE : AES_BLOCK_SIZE);
-    block_end_offset = ALIGN_UP(content_offset + read_size, ctx->encryption_type == NcaEncryptionType_AesXts ? NCA_AES_XTS_SECTOR_SIZE : AES_BLOCK_SIZE);
+    block_start_offset = ALIGN_DOWN(content_offset, crypt_unit_size);
+    block_end_offset = ALIGN_UP(content_offset + read_size, crypt_unit_size);
     block_size = (block_end_offset - block_start_offset);
 
     data_start_offset = (content_offset - block_start_offset);
-    chunk_size = (block_size > NCA_CRYPTO_BUFFER_SIZE ? NCA_CRYPTO_BUFFER_SIZE : block_size);
-    out_chunk_size = (block_size > NCA_CRYPTO_BUFFER_SIZE ? (NCA_CRYPTO_BUFFER_SIZE - data_start_offset) : read_size);
+    chunk_size = (block_size > g_ncaCryptoBufferSize ? g_ncaCryptoBufferSize : block_size);
+    out_chunk_size = (block_size > g_ncaCryptoBufferSize ? (g_ncaCryptoBufferSize - data_start_offset) : read_size);
 
     /* Read data. */
-    if (!ncaReadContentFile(nca_ctx, g_ncaCryptoBuffer, chunk_size, block_start_offset))
+    if (!ncaReadContentFile(nca_ctx, crypto_buf, chunk_size, block_start_offset))
     {
         LOG_MSG_ERROR("Failed to read 0x%lX bytes encrypted data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned).", chunk_size, block_start_offset, nca_ctx->content_id_str, \
                       ctx->section_idx);
@@ -1325,7 +2351,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
     {
         sector_num = ((nca_ctx->format_version != NcaVersion_Nca0 ? offset : (content_offset - sizeof(NcaHeader))) / NCA_AES_XTS_SECTOR_SIZE);
 
-        crypt_res = aes128XtsNintendoCrypt(&(ctx->xts_decrypt_ctx), g_ncaCryptoBuffer, g_ncaCryptoBuffer, chunk_size, sector_num, NCA_AES_XTS_SECTOR_SIZE, false);
+        crypt_res = aes128XtsNintendoCrypt(&(ctx->xts_decrypt_ctx), crypto_buf, crypto_buf, chunk_size, sector_num, NCA_AES_XTS_SECTOR_SIZE, false);
         if (crypt_res != chunk_size)
         {
             LOG_MSG_ERROR("Failed to AES-XTS decrypt 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned).", chunk_size, block_start_offset, nca_ctx->content_id_str, \
@@ -1336,16 +2362,16 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
     if (ctx->encryption_type >= NcaEncryptionType_AesCtr && ctx->encryption_type <= NcaEncryptionType_AesCtrExSkipLayerHash)
     {
         aes128CtrUpdatePartialCtr(ctx->ctr, ALIGN_DOWN(iv_offset, AES_BLOCK_SIZE));
-        aes128CtrContextResetCtr(&(ctx->ctr_ctx), ctx->ctr);
-        aes128CtrCrypt(&(ctx->ctr_ctx), g_ncaCryptoBuffer, g_ncaCryptoBuffer, chunk_size);
+        statsAddCounter(StatsCounterType_AesCtr, chunk_size);
+        aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, crypto_buf, crypto_buf, chunk_size);
     }
 
     /* Copy decrypted data. */
-    memcpy(out, g_ncaCryptoBuffer + data_start_offset, out_chunk_size);
+    memcpy(out, crypto_buf + data_start_offset, out_chunk_size);
 
     /* Perform another read if required. */
-    if (sparse_virtual_offset && block_size > NCA_CRYPTO_BUFFER_SIZE) ctx->cur_sparse_virtual_offset += out_chunk_size;
-    ret = (block_size > NCA_CRYPTO_BUFFER_SIZE ? _ncaReadFsSection(ctx, (u8*)out + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size) : true);
+    if (sparse_virtual_offset && block_size > g_ncaCryptoBufferSize) ctx->cur_sparse_virtual_offset += out_chunk_size;
+    ret = (block_size > g_ncaCryptoBufferSize ? ncaReadFsSectionGeneric(ctx, (u8*)out + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size, crypto_buf) : true);
 
 end:
     if (ctx->has_sparse_layer) ctx->cur_sparse_virtual_offset = 0;
@@ -1383,9 +2409,300 @@ static bool ncaFsSectionCheckPlaintextHashRegionAccess(NcaFsSectionContext *ctx,
     return ret;
 }
 
-static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt)
+static u32 ncaFsSectionGetHashLayerCount(NcaFsSectionContext *ctx)
+{
+    u32 layer_count = 0;
+
+    switch(ctx->hash_type)
+    {
+        case NcaHashType_HierarchicalSha256:
+        case NcaHashType_HierarchicalSha3256:
+            layer_count = ctx->header.hash_data.hierarchical_sha256_data.hash_region_count;
+            if (layer_count > NCA_HIERARCHICAL_SHA256_MAX_REGION_COUNT) layer_count = 0;
+            break;
+        case NcaHashType_HierarchicalIntegrity:
+        case NcaHashType_HierarchicalIntegritySha3:
+            layer_count = (ctx->header.hash_data.integrity_meta_info.info_level_hash.max_level_count - 1);
+            if (layer_count != NCA_IVFC_LEVEL_COUNT) layer_count = 0;
+            break;
+        default:
+            break;
+    }
+
+    return layer_count;
+}
+
+/* In these functions, the term "layer" is used as a generic way to refer to both HierarchicalSha256 hash regions and HierarchicalIntegrity verification levels. */
+static bool ncaFsSectionGetHashLayer(NcaFsSectionContext *ctx, u32 layer_idx, NcaRegion *out_region, u64 *out_block_size)
 {
-    if (!g_ncaCryptoBuffer || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
+    if (layer_idx >= ncaFsSectionGetHashLayerCount(ctx)) return false;
+
+    bool is_integrity = (ctx->hash_type == NcaHashType_HierarchicalIntegrity || ctx->hash_type == NcaHashType_HierarchicalIntegritySha3);
+    u64 offset = 0, size = 0, block_size = 0;
+
+    if (!is_integrity)
+    {
+        NcaHierarchicalSha256Data *hash_data = &(ctx->header.hash_data.hierarchical_sha256_data);
+        offset = hash_data->hash_region[layer_idx].offset;
+        size = hash_data->hash_region[layer_idx].size;
+        block_size = hash_data->hash_block_size;
+    } else {
+        NcaHierarchicalIntegrityVerificationLevelInformation *lvl_info = &(ctx->header.hash_data.integrity_meta_info.info_level_hash.level_information[layer_idx]);
+        offset = lvl_info->offset;
+        size = lvl_info->size;
+        block_size = NCA_IVFC_BLOCK_SIZE(lvl_info->block_order);
+    }
+
+    if (block_size <= 1 || !size || (offset + size) > ctx->section_size) return false;
+
+    if (out_region)
+    {
+        out_region->offset = offset;
+        out_region->size = size;
+    }
+
+    if (out_block_size) *out_block_size = block_size;
+
+    return true;
+}
+
+static u8 *ncaFsSectionReadVerifiedHashLayer(NcaFsSectionContext *ctx, u32 layer_idx, const u8 *parent_layer, u8 *crypto_buf)
+{
+    NcaRegion layer_region = {0};
+    u64 block_size = 0, alloc_size = 0;
+    u8 *layer = NULL, *hashes = NULL, hash[SHA256_HASH_SIZE] = {0};
+
+    bool is_integrity = (ctx->hash_type == NcaHashType_HierarchicalIntegrity || ctx->hash_type == NcaHashType_HierarchicalIntegritySha3);
+    bool use_sha3 = (ctx->hash_type == NcaHashType_HierarchicalSha3256 || ctx->hash_type == NcaHashType_HierarchicalIntegritySha3);
+    bool success = false;
+
+    if (!ncaFsSectionGetHashLayer(ctx, layer_idx, &layer_region, &block_size) || (layer_idx > 0 && !parent_layer) || layer_region.size > NCA_VERIFY_MAX_HASH_LAYER_SIZE)
+    {
+        LOG_MSG_ERROR("Invalid hierarchical layer #%u!", layer_idx);
+        goto end;
+    }
+
+    /* HierarchicalIntegrity blocks smaller than the hash block size are zero-padded before being hashed, so we'll allocate enough space for a full last block. */
+    alloc_size = (is_integrity ? ALIGN_UP(layer_region.size, block_size) : layer_region.size);
+
+    layer = calloc(alloc_size, sizeof(u8));
+    if (!layer)
+    {
+        LOG_MSG_ERROR("Unable to allocate 0x%lX bytes for hierarchical layer #%u!", alloc_size, layer_idx);
+        goto end;
+    }
+
+    if (!_ncaReadFsSection(ctx, layer, layer_region.size, layer_region.offset, crypto_buf))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes long hierarchical layer #%u from offset 0x%lX!", layer_region.size, layer_idx, layer_region.offset);
+        goto end;
+    }
+
+    if (!layer_idx)
+    {
+        /* The master layer is verified by the master hash from the HashData block in the NCA FS section header. */
+        const u8 *master_hash = (!is_integrity ? ctx->header.hash_data.hierarchical_sha256_data.master_hash : ctx->header.hash_data.integrity_meta_info.master_hash);
+
+        ncaCalculateLayerHash(hash, layer, layer_region.size, use_sha3);
+        if (memcmp(hash, master_hash, SHA256_HASH_SIZE) != 0)
+        {
+            LOG_MSG_ERROR("Master hash mismatch for hierarchical layer #0!");
+            goto end;
+        }
+    } else {
+        /* Hash all blocks at once, then verify each one of them against the parent layer. */
+        /* HierarchicalIntegrity blocks are always hashed in full, since the layer buffer is zero-padded up to the next block boundary. */
+        u64 hash_size = (is_integrity ? alloc_size : layer_region.size);
+        u64 block_count = ((hash_size + block_size - 1) / block_size);
+
+        hashes = malloc(block_count * SHA256_HASH_SIZE);
+        if (!hashes)
+        {
+            LOG_MSG_ERROR("Unable to allocate 0x%lX bytes for hierarchical layer #%u hashes!", block_count * SHA256_HASH_SIZE, layer_idx);
+            goto end;
+        }
+
+        ncaCalculateLayerBlockHashes(hashes, layer, hash_size, block_size, use_sha3);
+
+        for(u64 i = 0; i < block_count; i++)
+        {
+            if (memcmp(hashes + (i * SHA256_HASH_SIZE), parent_layer + (i * SHA256_HASH_SIZE), SHA256_HASH_SIZE) != 0)
+            {
+                LOG_MSG_ERROR("Hash mismatch for block #%lu from hierarchical layer #%u!", i, layer_idx);
+                goto end;
+            }
+        }
+    }
+
+    success = true;
+
+end:
+    if (hashes) free(hashes);
+
+    if (!success && layer)
+    {
+        free(layer);
+        layer = NULL;
+    }
+
+    return layer;
+}
+
+static bool ncaVerifyFsSectionData(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 offset, u8 *crypto_buf)
+{
+    NcaRegion data_region = {0};
+    u64 block_size = 0, start_offset = 0, end_offset = 0;
+    u8 *block = NULL, *hashes = NULL, hash[SHA256_HASH_SIZE] = {0};
+
+    bool is_integrity = (ctx->hash_type == NcaHashType_HierarchicalIntegrity || ctx->hash_type == NcaHashType_HierarchicalIntegritySha3);
+    bool use_sha3 = (ctx->hash_type == NcaHashType_HierarchicalSha3256 || ctx->hash_type == NcaHashType_HierarchicalIntegritySha3);
+    bool success = false;
+
+    if (!ctx->verify_hash_layer || !ncaFsSectionGetHashLayer(ctx, ncaFsSectionGetHashLayerCount(ctx) - 1, &data_region, &block_size))
+    {
+        LOG_MSG_ERROR("Invalid verified read state!");
+        return false;
+    }
+
+    /* Don't proceed if this read doesn't overlap the data layer (e.g. hash layer reads). */
+    start_offset = MAX(offset, data_region.offset);
+    end_offset = MIN(offset + data_size, data_region.offset + data_region.size);
+    if (start_offset >= end_offset) return true;
+
+    /* Make offsets relative to the start of the data layer, then align them to the hash block size. */
+    start_offset = ALIGN_DOWN(start_offset - data_region.offset, block_size);
+    end_offset -= data_region.offset;
+
+    for(u64 cur_offset = start_offset; cur_offset < end_offset; cur_offset += block_size)
+    {
+        u64 block_idx = (cur_offset / block_size);
+        u64 cur_block_size = MIN(block_size, data_region.size - cur_offset);
+        u64 block_data_offset = (data_region.offset + cur_offset);
+
+        if ((block_idx * SHA256_HASH_SIZE) >= ctx->verify_hash_layer_size)
+        {
+            LOG_MSG_ERROR("Block #%lu exceeds parent hash layer boundaries!", block_idx);
+            goto end;
+        }
+
+        if (block_data_offset >= offset && (block_data_offset + cur_block_size) <= (offset + data_size) && (!is_integrity || cur_block_size == block_size))
+        {
+            /* The whole block is available within the read buffer, and so may be the blocks that follow it. Hash all of them at once. */
+            /* A truncated block can only be part of this run if it's the last HierarchicalSha256 data layer block. */
+            u64 run_end_offset = MIN(offset + data_size - data_region.offset, data_region.size);
+            u64 run_size = ((run_end_offset == data_region.size && !is_integrity) ? (run_end_offset - cur_offset) : ALIGN_DOWN(run_end_offset - cur_offset, block_size));
+            u64 run_block_count = ((run_size + block_size - 1) / block_size);
+
+            if (((block_idx + run_block_count) * SHA256_HASH_SIZE) > ctx->verify_hash_layer_size)
+            {
+                LOG_MSG_ERROR("Block #%lu exceeds parent hash layer boundaries!", block_idx + run_block_count - 1);
+                goto end;
+            }
+
+            if (!hashes && !(hashes = malloc(((data_size + block_size - 1) / block_size) * SHA256_HASH_SIZE)))
+            {
+                LOG_MSG_ERROR("Unable to allocate memory for data block hashes!");
+                goto end;
+            }
+
+            ncaCalculateLayerBlockHashes(hashes, (const u8*)data + (block_data_offset - offset), run_size, block_size, use_sha3);
+
+            for(u64 i = 0; i < run_block_count; i++)
+            {
+                if (memcmp(hashes + (i * SHA256_HASH_SIZE), ctx->verify_hash_layer + ((block_idx + i) * SHA256_HASH_SIZE), SHA256_HASH_SIZE) != 0)
+                {
+                    LOG_MSG_ERROR("Hash mismatch for data block #%lu from NCA \"%s\" FS section #%u! (offset 0x%lX).", block_idx + i, ctx->nca_ctx->content_id_str, ctx->section_idx, \
+                                  block_data_offset + (i * block_size));
+                    goto end;
+                }
+            }
+
+            /* Skip every block from this run. */
+            cur_offset += ((run_block_count - 1) * block_size);
+            continue;
+        }
+
+        /* Read the whole block on our own. HierarchicalIntegrity blocks smaller than the hash block size are zero-padded before being hashed. */
+        if (!block && !(block = malloc(block_size)))
+        {
+            LOG_MSG_ERROR("Unable to allocate 0x%lX bytes for data block!", block_size);
+            goto end;
+        }
+
+        memset(block, 0, block_size);
+
+        if (!_ncaReadFsSection(ctx, block, cur_block_size, block_data_offset, crypto_buf))
+        {
+            LOG_MSG_ERROR("Failed to read 0x%lX bytes long data block from offset 0x%lX!", cur_block_size, block_data_offset);
+            goto end;
+        }
+
+        if (is_integrity) cur_block_size = block_size;
+
+        ncaCalculateLayerHash(hash, block, cur_block_size, use_sha3);
+        if (memcmp(hash, ctx->verify_hash_layer + (block_idx * SHA256_HASH_SIZE), SHA256_HASH_SIZE) != 0)
+        {
+            LOG_MSG_ERROR("Hash mismatch for data block #%lu from NCA \"%s\" FS section #%u! (offset 0x%lX).", block_idx, ctx->nca_ctx->content_id_str, ctx->section_idx, \
+                          block_data_offset);
+            goto end;
+        }
+    }
+
+    success = true;
+
+end:
+    if (hashes) free(hashes);
+
+    if (block) free(block);
+
+    return success;
+}
+
+static bool ncaDecryptRawFsSectionData(NcaFsSectionContext *ctx, void *data, u64 data_size, u64 offset)
+{
+    NcaContext *nca_ctx = ctx->nca_ctx;
+    u64 content_offset = (ctx->section_offset + offset);
+    u64 sector_num = 0;
+    size_t crypt_res = 0;
+
+    /* Sparse, compressed and patch sections can't be verified, so the raw data always maps to the physical section data. */
+    if (ctx->has_sparse_layer || ctx->has_compression_layer || ctx->has_patch_indirect_layer || ctx->has_patch_aes_ctr_ex_layer || (content_offset + data_size) > nca_ctx->content_size)
+    {
+        LOG_MSG_ERROR("Invalid NCA FS section header parameters!");
+        return false;
+    }
+
+    /* Return right away if we're dealing with a plaintext FS section. */
+    if (ctx->encryption_type == NcaEncryptionType_None) return true;
+
+    if (ctx->encryption_type == NcaEncryptionType_AesXts)
+    {
+        sector_num = ((nca_ctx->format_version != NcaVersion_Nca0 ? offset : (content_offset - sizeof(NcaHeader))) / NCA_AES_XTS_SECTOR_SIZE);
+
+        crypt_res = aes128XtsNintendoCrypt(&(ctx->xts_decrypt_ctx), data, data, data_size, sector_num, NCA_AES_XTS_SECTOR_SIZE, false);
+        if (crypt_res != data_size)
+        {
+            LOG_MSG_ERROR("Failed to AES-XTS decrypt 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u!", data_size, content_offset, nca_ctx->content_id_str, \
+                          ctx->section_idx);
+            return false;
+        }
+    } else
+    if (ctx->encryption_type >= NcaEncryptionType_AesCtr && ctx->encryption_type <= NcaEncryptionType_AesCtrExSkipLayerHash)
+    {
+        aes128CtrUpdatePartialCtr(ctx->ctr, content_offset);
+        statsAddCounter(StatsCounterType_AesCtr, data_size);
+        aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, data, data, data_size);
+    } else {
+        LOG_MSG_ERROR("Invalid encryption type for NCA \"%s\" FS section #%u!", nca_ctx->content_id_str, ctx->section_idx);
+        return false;
+    }
+
+    return true;
+}
+
+static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt, u8 *crypto_buf)
+{
+    if (!crypto_buf || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
         ctx->section_type != NcaFsSectionType_PatchRomFs || (ctx->encryption_type != NcaEncryptionType_None && ctx->encryption_type != NcaEncryptionType_AesCtrEx && \
         ctx->encryption_type != NcaEncryptionType_AesCtrExSkipLayerHash) || !out || !read_size || (offset + read_size) > ctx->section_size)
     {
@@ -1398,6 +2715,114 @@ static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 rea
 
     u64 block_start_offset = 0, block_end_offset = 0, block_size = 0;
     u64 data_start_offset = 0, chunk_size = 0, out_chunk_size = 0;
+    u64 chunk_sizes[3] = {0};
+
+    bool ret = false;
+
+    if (!*(nca_ctx->content_id_str) || (nca_ctx->storage_id != NcmStorageId_GameCard && !nca_ctx->ncm_storage) || (nca_ctx->storage_id == NcmStorageId_GameCard && !nca_ctx->gamecard_offset) || \
+        (content_offset + read_size) > nca_ctx->content_size)
+    {
+        LOG_MSG_ERROR("Invalid NCA header parameters!");
+        goto end;
+    }
+
+    /* Optimization for reads that are aligned to the AES-CTR sector size. */
+    if (!decrypt || (!(content_offset % AES_BLOCK_SIZE) && !(read_size % AES_BLOCK_SIZE)))
+    {
+        /* Read data. */
+        if (!ncaReadContentFile(nca_ctx, out, read_size, content_offset))
+        {
+            LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (aligned).", read_size, content_offset, nca_ctx->content_id_str, ctx->section_idx);
+            goto end;
+        }
+
+        /* Decrypt data, if needed. */
+        if (decrypt)
+        {
+            aes128CtrUpdatePartialCtrEx(ctx->ctr, ctr_val, content_offset);
+            statsAddCounter(StatsCounterType_AesCtr, read_size);
+            aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, out, out, read_size);
+        }
+
+        ret = true;
+        goto end;
+    }
+
+    /* Calculate the sizes for the unaligned head, aligned interior and unaligned tail of this read. */
+    chunk_sizes[0] = ((content_offset % AES_BLOCK_SIZE) ? MIN(read_size, AES_BLOCK_SIZE - (content_offset % AES_BLOCK_SIZE)) : 0);
+    chunk_sizes[1] = ALIGN_DOWN(read_size - chunk_sizes[0], AES_BLOCK_SIZE);
+    chunk_sizes[2] = (read_size - chunk_sizes[0] - chunk_sizes[1]);
+
+    /* Decrypt the aligned interior in place, using the output buffer. */
+    /* Only the partial AES-CTR block at each end goes through the crypto buffer. */
+    if (chunk_sizes[1])
+    {
+        u64 cur_offset = 0;
+
+        for(u32 i = 0; i < MAX_ELEMENTS(chunk_sizes); i++)
+        {
+            if (!chunk_sizes[i]) continue;
+
+            if (!_ncaReadAesCtrExStorage(ctx, (u8*)out + cur_offset, chunk_sizes[i], offset + cur_offset, ctr_val, decrypt, crypto_buf))
+            {
+                LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned) (#%u).", chunk_sizes[i], content_offset + cur_offset, \
+                              nca_ctx->content_id_str, ctx->section_idx, i + 1);
+                goto end;
+            }
+
+            cur_offset += chunk_sizes[i];
+        }
+
+        ret = true;
+        goto end;
+    }
+
+    /* Calculate offsets and block sizes. */
+    block_start_offset = ALIGN_DOWN(content_offset, AES_BLOCK_SIZE);
+    block_end_offset = ALIGN_UP(content_offset + read_size, AES_BLOCK_SIZE);
+    block_size = (block_end_offset - block_start_offset);
+
+    data_start_offset = (content_offset - block_start_offset);
+    chunk_size = (block_size > g_ncaCryptoBufferSize ? g_ncaCryptoBufferSize : block_size);
+    out_chunk_size = (block_size > g_ncaCryptoBufferSize ? (g_ncaCryptoBufferSize - data_start_offset) : read_size);
+
+    /* Read data. */
+    if (!ncaReadContentFile(nca_ctx, crypto_buf, chunk_size, block_start_offset))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes encrypted data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned).", chunk_size, block_start_offset, nca_ctx->content_id_str, \
+                      ctx->section_idx);
+        goto end;
+    }
+
+    /* Decrypt data. */
+    aes128CtrUpdatePartialCtrEx(ctx->ctr, ctr_val, block_start_offset);
+    statsAddCounter(StatsCounterType_AesCtr, chunk_size);
+    aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, crypto_buf, crypto_buf, chunk_size);
+
+    /* Copy decrypted data. */
+    memcpy(out, crypto_buf + data_start_offset, out_chunk_size);
+
+    ret = (block_size > g_ncaCryptoBufferSize ? _ncaReadAesCtrExStorage(ctx, (u8*)out + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size, ctr_val, decrypt, crypto_buf) : true);
+
+end:
+    return ret;
+}
+
+static bool _ncaReadAesCtrExStorageRanges(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, const NcaAesCtrExRange *ranges, u32 range_count, u8 *crypto_buf)
+{
+    if (!crypto_buf || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
+        ctx->section_type != NcaFsSectionType_PatchRomFs || (ctx->encryption_type != NcaEncryptionType_None && ctx->encryption_type != NcaEncryptionType_AesCtrEx && \
+        ctx->encryption_type != NcaEncryptionType_AesCtrExSkipLayerHash) || !out || !read_size || (offset + read_size) > ctx->section_size || !ranges || !range_count)
+    {
+        LOG_MSG_ERROR("Invalid NCA FS section header parameters!");
+        return false;
+    }
+
+    NcaContext *nca_ctx = ctx->nca_ctx;
+    u64 content_offset = (ctx->section_offset + offset);
+
+    u64 head_size = 0, tail_size = 0, body_size = 0, cur_offset = 0;
+    bool aligned_boundaries = true;
 
     bool ret = false;
 
@@ -1408,54 +2833,77 @@ static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 rea
         goto end;
     }
 
-    /* Optimization for reads that are aligned to the AES-CTR sector size. */
-    if (!decrypt || (!(content_offset % AES_BLOCK_SIZE) && !(read_size % AES_BLOCK_SIZE)))
+    /* Validate sub-ranges. AesCtrEx entries are always aligned to the AES block size, so boundaries between sub-ranges are expected to be aligned as well. */
+    for(u32 i = 0; i < range_count; i++)
     {
-        /* Read data. */
-        if (!ncaReadContentFile(nca_ctx, out, read_size, content_offset))
+        if (!ranges[i].size || ranges[i].size > (read_size - cur_offset))
         {
-            LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (aligned).", read_size, content_offset, nca_ctx->content_id_str, ctx->section_idx);
+            LOG_MSG_ERROR("Invalid size for AesCtrEx sub-range #%u! (0x%lX).", i, ranges[i].size);
             goto end;
         }
 
-        /* Decrypt data, if needed. */
-        if (decrypt)
+        cur_offset += ranges[i].size;
+        if (i < (range_count - 1) && ((content_offset + cur_offset) % AES_BLOCK_SIZE)) aligned_boundaries = false;
+    }
+
+    if (cur_offset != read_size)
+    {
+        LOG_MSG_ERROR("AesCtrEx sub-range sizes don't add up to the read size! (0x%lX != 0x%lX).", cur_offset, read_size);
+        goto end;
+    }
+
+    /* Calculate the sizes for the unaligned head, aligned body and unaligned tail of this read. */
+    /* If there's no aligned body to share between sub-ranges, or if a boundary isn't aligned, just read each sub-range on its own. */
+    head_size = ((content_offset % AES_BLOCK_SIZE) ? MIN(read_size, AES_BLOCK_SIZE - (content_offset % AES_BLOCK_SIZE)) : 0);
+    tail_size = ((read_size - head_size) % AES_BLOCK_SIZE);
+    body_size = (read_size - head_size - tail_size);
+
+    if (range_count == 1 || !body_size || !aligned_boundaries)
+    {
+        cur_offset = 0;
+
+        for(u32 i = 0; i < range_count; i++)
         {
-            aes128CtrUpdatePartialCtrEx(ctx->ctr, ctr_val, content_offset);
-            aes128CtrContextResetCtr(&(ctx->ctr_ctx), ctx->ctr);
-            aes128CtrCrypt(&(ctx->ctr_ctx), out, out, read_size);
+            if (!_ncaReadAesCtrExStorage(ctx, (u8*)out + cur_offset, ranges[i].size, offset + cur_offset, ranges[i].ctr_val, ranges[i].decrypt, crypto_buf)) goto end;
+            cur_offset += ranges[i].size;
         }
 
         ret = true;
         goto end;
     }
 
-    /* Calculate offsets and block sizes. */
-    block_start_offset = ALIGN_DOWN(content_offset, AES_BLOCK_SIZE);
-    block_end_offset = ALIGN_UP(content_offset + read_size, AES_BLOCK_SIZE);
-    block_size = (block_end_offset - block_start_offset);
+    /* The unaligned head always belongs to the first sub-range, and the unaligned tail always belongs to the last one. */
+    if (head_size && !_ncaReadAesCtrExStorage(ctx, out, head_size, offset, ranges[0].ctr_val, ranges[0].decrypt, crypto_buf)) goto end;
 
-    data_start_offset = (content_offset - block_start_offset);
-    chunk_size = (block_size > NCA_CRYPTO_BUFFER_SIZE ? NCA_CRYPTO_BUFFER_SIZE : block_size);
-    out_chunk_size = (block_size > NCA_CRYPTO_BUFFER_SIZE ? (NCA_CRYPTO_BUFFER_SIZE - data_start_offset) : read_size);
+    if (tail_size && !_ncaReadAesCtrExStorage(ctx, (u8*)out + head_size + body_size, tail_size, offset + head_size + body_size, ranges[range_count - 1].ctr_val, \
+                                              ranges[range_count - 1].decrypt, crypto_buf)) goto end;
 
-    /* Read data. */
-    if (!ncaReadContentFile(nca_ctx, g_ncaCryptoBuffer, chunk_size, block_start_offset))
+    /* Read the whole aligned body at once. */
+    if (!ncaReadContentFile(nca_ctx, (u8*)out + head_size, body_size, content_offset + head_size))
     {
-        LOG_MSG_ERROR("Failed to read 0x%lX bytes encrypted data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned).", chunk_size, block_start_offset, nca_ctx->content_id_str, \
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (ranges).", body_size, content_offset + head_size, nca_ctx->content_id_str, \
                       ctx->section_idx);
         goto end;
     }
 
-    /* Decrypt data. */
-    aes128CtrUpdatePartialCtrEx(ctx->ctr, ctr_val, block_start_offset);
-    aes128CtrContextResetCtr(&(ctx->ctr_ctx), ctx->ctr);
-    aes128CtrCrypt(&(ctx->ctr_ctx), g_ncaCryptoBuffer, g_ncaCryptoBuffer, chunk_size);
+    /* Decrypt each sub-range in place, using its own CTR value. */
+    cur_offset = 0;
 
-    /* Copy decrypted data. */
-    memcpy(out, g_ncaCryptoBuffer + data_start_offset, out_chunk_size);
+    for(u32 i = 0; i < range_count; i++)
+    {
+        u64 range_start = MAX(cur_offset, head_size);
+        u64 range_end = MIN(cur_offset + ranges[i].size, head_size + body_size);
+
+        cur_offset += ranges[i].size;
+
+        if (!ranges[i].decrypt || range_start >= range_end) continue;
+
+        aes128CtrUpdatePartialCtrEx(ctx->ctr, ranges[i].ctr_val, content_offset + range_start);
+        statsAddCounter(StatsCounterType_AesCtr, range_end - range_start);
+        aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, (u8*)out + range_start, (u8*)out + range_start, range_end - range_start);
+    }
 
-    ret = (block_size > NCA_CRYPTO_BUFFER_SIZE ? _ncaReadAesCtrExStorage(ctx, (u8*)out + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size, ctr_val, decrypt) : true);
+    ret = true;
 
 end:
     return ret;
@@ -1467,20 +2915,64 @@ static void ncaCalculateLayerHash(void *dst, const void *src, size_t size, bool
     {
         sha3256CalculateHash(dst, src, size);
     } else {
+        statsAddCounter(StatsCounterType_Sha256, size);
         sha256CalculateHash(dst, src, size);
     }
 }
 
+static void ncaCalculateLayerBlockHashes(void *dst, const void *src, size_t size, size_t block_size, bool use_sha3)
+{
+    /* SHA-256 blocks are hashed in pairs using interleaved SHA-256 instructions. */
+    if (!use_sha3)
+    {
+        sha256CalculateBlockHashes(dst, src, size, block_size);
+        return;
+    }
+
+    for(size_t i = 0, j = 0; i < size; i += block_size, j++) sha3256CalculateHash((u8*)dst + (j * SHA256_HASH_SIZE), (const u8*)src + i, MIN(block_size, size - i));
+}
+
 /* In this function, the term "layer" is used as a generic way to refer to both HierarchicalSha256 hash regions and HierarchicalIntegrity verification levels. */
-static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, void *out, bool is_integrity_patch)
+/* Only the hash blocks affected by the input ranges are processed at each layer. Furthermore, only the parts from these blocks that aren't overwritten are read from the NCA, */
+/* and parent layer hashes are never read, since all of them are recalculated from the current layer. */
+static bool ncaGenerateCachedHashDataPatch(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, void *out, bool is_integrity_patch)
+{
+    u8 input_hash[SHA256_HASH_SIZE] = {0};
+    u8 *crypto_buf = NULL;
+    bool ret = false;
+
+    SCOPED_LOCK(&(ctx->crypto_mutex))
+    {
+        /* Check if this exact patch was already generated during this session (e.g. the same title is being dumped more than once). */
+        /* Invalid parameters are left for ncaGenerateHashDataPatch() to report. */
+        bool cacheable = (ctx->enabled && ctx->nca_ctx && ranges && range_count && out);
+        if (cacheable)
+        {
+            ncaCalculateHashDataPatchInputHash(ctx, ranges, range_count, input_hash);
+            if ((ret = ncaLoadCachedHashDataPatch(ctx, input_hash, out, is_integrity_patch))) break;
+        }
+
+        crypto_buf = ncaAcquireCryptoBuffer();
+
+        ret = ncaGenerateHashDataPatch(ctx, ranges, range_count, out, is_integrity_patch, crypto_buf);
+        if (ret && cacheable) ncaStoreCachedHashDataPatch(ctx, input_hash, out, is_integrity_patch);
+
+        ncaReleaseCryptoBuffer(crypto_buf);
+    }
+
+    return ret;
+}
+
+static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, void *out, bool is_integrity_patch, u8 *crypto_buf)
 {
     NcaContext *nca_ctx = NULL;
     NcaHierarchicalSha256Patch *hierarchical_sha256_patch = (!is_integrity_patch ? ((NcaHierarchicalSha256Patch*)out) : NULL);
     NcaHierarchicalIntegrityPatch *hierarchical_integrity_patch = (is_integrity_patch ? ((NcaHierarchicalIntegrityPatch*)out) : NULL);
 
+    NcaHashDataPatchRange cur_range = {0};
     u8 *cur_data = NULL;
-    u64 cur_data_offset = data_offset;
-    u64 cur_data_size = data_size;
+    u64 cur_data_offset = 0;
+    u64 cur_data_size = 0;
 
     u32 layer_count = 0;
     u8 *parent_layer_block = NULL, *cur_layer_block = NULL;
@@ -1494,14 +2986,29 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
         layer_count > NCA_HIERARCHICAL_SHA256_MAX_REGION_COUNT || !(last_layer_size = ctx->header.hash_data.hierarchical_sha256_data.hash_region[layer_count - 1].size))) || \
         (is_integrity_patch && ((ctx->hash_type != NcaHashType_HierarchicalIntegrity && ctx->hash_type != NcaHashType_HierarchicalIntegritySha3) || \
         !(layer_count = (ctx->header.hash_data.integrity_meta_info.info_level_hash.max_level_count - 1)) || layer_count != NCA_IVFC_LEVEL_COUNT || \
-        !(last_layer_size = ctx->header.hash_data.integrity_meta_info.info_level_hash.level_information[NCA_IVFC_LEVEL_COUNT - 1].size))) || !data || !data_size || \
-        (data_offset + data_size) > last_layer_size || !out || ctx->encryption_type == NcaEncryptionType_Auto || ctx->encryption_type == NcaEncryptionType_AesCtrEx || \
-        ctx->encryption_type >= NcaEncryptionType_AesCtrExSkipLayerHash)
+        !(last_layer_size = ctx->header.hash_data.integrity_meta_info.info_level_hash.level_information[NCA_IVFC_LEVEL_COUNT - 1].size))) || !ranges || !range_count || \
+        !out || ctx->encryption_type == NcaEncryptionType_Auto || ctx->encryption_type == NcaEncryptionType_AesCtrEx || ctx->encryption_type >= NcaEncryptionType_AesCtrExSkipLayerHash)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         goto end;
     }
 
+    /* Validate input ranges. They must be sorted by offset in ascending order, and they must not overlap. */
+    for(u32 i = 0; i < range_count; i++)
+    {
+        const NcaHashDataPatchRange *range = &(ranges[i]);
+
+        if (!range->data || !range->size || (range->offset + range->size) > last_layer_size || (i > 0 && range->offset < (ranges[i - 1].offset + ranges[i - 1].size)))
+        {
+            LOG_MSG_ERROR("Invalid data range #%u!", i);
+            goto end;
+        }
+    }
+
+    /* The patch for the last layer covers all input ranges, including the unmodified data between them. */
+    cur_data_offset = ranges[0].offset;
+    cur_data_size = (ranges[range_count - 1].offset + ranges[range_count - 1].size - cur_data_offset);
+
     /* Clear output patch. */
     if (!is_integrity_patch)
     {
@@ -1558,25 +3065,30 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
         /* Retrieve pointer to the current layer patch. */
         cur_layer_patch = (!is_integrity_patch ? &(hierarchical_sha256_patch->hash_region_patch[i - 1]) : &(hierarchical_integrity_patch->hash_level_patch[i - 1]));
 
-        /* Calculate required offsets and sizes. */
+        /* Calculate required offsets and sizes. These are all relative to the start of the current layer. */
         if (i > 1)
         {
             /* HierarchicalSha256 hash region with index 1 through 4, or HierarchicalIntegrity verification level with index 1 through 5. */
-            cur_layer_read_start_offset = (cur_layer_offset + ALIGN_DOWN(cur_data_offset, hash_block_size));
-            cur_layer_read_end_offset = (cur_layer_offset + ALIGN_UP(cur_data_offset + cur_data_size, hash_block_size));
+            cur_layer_read_start_offset = ALIGN_DOWN(cur_data_offset, hash_block_size);
+            cur_layer_read_end_offset = ALIGN_UP(cur_data_offset + cur_data_size, hash_block_size);
             cur_layer_read_size = (cur_layer_read_end_offset - cur_layer_read_start_offset);
 
-            parent_layer_read_start_offset = ((cur_data_offset / hash_block_size) * SHA256_HASH_SIZE);
+            parent_layer_read_start_offset = ((cur_layer_read_start_offset / hash_block_size) * SHA256_HASH_SIZE);
             parent_layer_read_size = ((cur_layer_read_size / hash_block_size) * SHA256_HASH_SIZE);
+
+            if ((parent_layer_read_start_offset + parent_layer_read_size) > parent_layer_size)
+            {
+                LOG_MSG_ERROR("Hierarchical layer #%u block exceeds parent layer boundaries!", i - 1);
+                goto end;
+            }
         } else {
             /* HierarchicalSha256 master hash region, or HierarchicalIntegrity master verification level. Both with index 0. */
             /* The master hash is calculated over the whole layer and saved to the HashData block from the NCA FS section header. */
-            cur_layer_read_start_offset = cur_layer_offset;
-            cur_layer_read_end_offset = (cur_layer_offset + cur_layer_size);
-            cur_layer_read_size = cur_layer_size;
+            cur_layer_read_start_offset = 0;
+            cur_layer_read_end_offset = cur_layer_read_size = cur_layer_size;
         }
 
-        cur_layer_read_patch_offset = (cur_data_offset - ALIGN_DOWN(cur_data_offset, hash_block_size));
+        cur_layer_read_patch_offset = (cur_data_offset - cur_layer_read_start_offset);
 
         /* Allocate memory for our current layer block. */
         cur_layer_block = calloc(cur_layer_read_size, sizeof(u8));
@@ -1587,26 +3099,32 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
         }
 
         /* Adjust current layer read size to avoid read errors (if needed). */
-        if (cur_layer_read_end_offset > (cur_layer_offset + cur_layer_size))
+        if (cur_layer_read_end_offset > cur_layer_size)
         {
-            cur_layer_read_end_offset = (cur_layer_offset + cur_layer_size);
+            cur_layer_read_end_offset = cur_layer_size;
             cur_layer_read_size = (cur_layer_read_end_offset - cur_layer_read_start_offset);
         }
 
-        /* Read current layer block. */
-        if (!_ncaReadFsSection(ctx, cur_layer_block, cur_layer_read_size, cur_layer_read_start_offset))
+        /* Build current layer block. The input ranges are used for the last layer, while the hashes recalculated in the previous iteration are used for the rest. */
+        if (i != layer_count)
+        {
+            cur_range.data = cur_data;
+            cur_range.size = cur_data_size;
+            cur_range.offset = cur_data_offset;
+        }
+
+        if (!ncaReadHashLayerBlock(ctx, cur_layer_block, cur_layer_offset, cur_layer_read_start_offset, cur_layer_read_end_offset, (i == layer_count ? ranges : &cur_range), \
+                                   (i == layer_count ? range_count : 1), crypto_buf))
         {
             LOG_MSG_ERROR("Failed to read 0x%lX bytes long hierarchical layer #%u data block from offset 0x%lX! (current).", cur_layer_read_size, i - 1, cur_layer_read_start_offset);
             goto end;
         }
 
-        /* Replace current layer block data. */
-        memcpy(cur_layer_block + cur_layer_read_patch_offset, (i == layer_count ? data : cur_data), cur_data_size);
-
         /* Recalculate hashes. */
         if (i > 1)
         {
             /* Allocate memory for our parent layer block. */
+            /* There's no need to read it, since we're about to recalculate every single hash from it. */
             parent_layer_block = calloc(parent_layer_read_size, sizeof(u8));
             if (!parent_layer_block)
             {
@@ -1614,21 +3132,11 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
                 goto end;
             }
 
-            /* Read parent layer block. */
-            if (!_ncaReadFsSection(ctx, parent_layer_block, parent_layer_read_size, parent_layer_offset + parent_layer_read_start_offset))
-            {
-                LOG_MSG_ERROR("Failed to read 0x%lX bytes long hierarchical layer #%u data block from offset 0x%lX! (parent).", parent_layer_read_size, i - 2, parent_layer_read_start_offset);
-                goto end;
-            }
-
             /* HierarchicalSha256: size is truncated for blocks smaller than the hash block size. */
             /* HierarchicalIntegrity: size *isn't* truncated for blocks smaller than the hash block size, so we just keep using the same hash block size throughout the loop. */
             /*                        For these specific cases, the rest of the block should be filled with zeroes (already taken care of by using calloc()). */
-            for(u64 j = 0, k = 0; j < cur_layer_read_size; j += hash_block_size, k++)
-            {
-                if (!is_integrity_patch && hash_block_size > (cur_layer_read_size - j)) hash_block_size = (cur_layer_read_size - j);
-                ncaCalculateLayerHash(parent_layer_block + (k * SHA256_HASH_SIZE), cur_layer_block + j, hash_block_size, use_sha3);
-            }
+            ncaCalculateLayerBlockHashes(parent_layer_block, cur_layer_block, is_integrity_patch ? ALIGN_UP(cur_layer_read_size, hash_block_size) : cur_layer_read_size, \
+                                         hash_block_size, use_sha3);
         } else {
             /* Recalculate master hash from the HashData area. */
             u8 *master_hash = (!is_integrity_patch ? ctx->header.hash_data.hierarchical_sha256_data.master_hash : ctx->header.hash_data.integrity_meta_info.master_hash);
@@ -1639,7 +3147,7 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
         {
             /* Reencrypt current layer block (if needed). */
             cur_layer_patch->data = ncaGenerateEncryptedFsSectionBlock(ctx, cur_layer_block + cur_layer_read_patch_offset, cur_data_size, cur_layer_offset + cur_data_offset, \
-                                                                        &(cur_layer_patch->size), &(cur_layer_patch->offset));
+                                                                        &(cur_layer_patch->size), &(cur_layer_patch->offset), crypto_buf);
             if (!cur_layer_patch->data)
             {
                 LOG_MSG_ERROR("Failed to generate encrypted 0x%lX bytes long hierarchical layer #%u data block!", cur_data_size, i - 1);
@@ -1688,6 +3196,8 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
     success = true;
 
 end:
+    if (cur_data) free(cur_data);
+
     if (cur_layer_block) free(cur_layer_block);
 
     if (parent_layer_block) free(parent_layer_block);
@@ -1705,6 +3215,199 @@ end:
     return success;
 }
 
+static void ncaCalculateHashDataPatchInputHash(NcaFsSectionContext *ctx, const NcaHashDataPatchRange *ranges, u32 range_count, u8 *out)
+{
+    Sha256Context sha256_ctx = {0};
+    sha256ContextCreate(&sha256_ctx);
+
+    /* The original FS section header determines the hash layer layout and the master hash the patch is built on. */
+    sha256ContextUpdate(&sha256_ctx, &(ctx->header), sizeof(NcaFsHeader));
+
+    for(u32 i = 0; i < range_count; i++)
+    {
+        const NcaHashDataPatchRange *range = &(ranges[i]);
+        if (!range->data || !range->size) continue;
+
+        sha256ContextUpdate(&sha256_ctx, &(range->offset), sizeof(range->offset));
+        sha256ContextUpdate(&sha256_ctx, &(range->size), sizeof(range->size));
+        sha256ContextUpdate(&sha256_ctx, range->data, range->size);
+    }
+
+    sha256ContextGetHash(&sha256_ctx, out);
+}
+
+static bool ncaLoadCachedHashDataPatch(NcaFsSectionContext *ctx, const u8 *input_hash, void *out, bool is_integrity_patch)
+{
+    NcaContext *nca_ctx = ctx->nca_ctx;
+    bool ret = false;
+
+    SCOPED_LOCK(&g_ncaPatchCacheMutex)
+    {
+        for(u32 i = 0; i < NCA_PATCH_CACHE_ENTRY_COUNT; i++)
+        {
+            NcaHashDataPatchCacheEntry *entry = &(g_ncaPatchCache[i]);
+
+            if (!entry->valid || entry->section_idx != ctx->section_idx || entry->is_integrity_patch != is_integrity_patch || \
+                memcmp(&(entry->content_id), &(nca_ctx->content_id), sizeof(NcmContentId)) != 0 || memcmp(entry->input_hash, input_hash, SHA256_HASH_SIZE) != 0) continue;
+
+            /* Duplicate the cached patch. */
+            ncaFreeHashDataPatch(out, is_integrity_patch);
+            if (!ncaCopyHashDataPatch(out, &(entry->hierarchical_sha256_patch), is_integrity_patch)) break;
+
+            /* Restore the FS section header state produced by the patch. */
+            memcpy(&(ctx->header), &(entry->header), sizeof(NcaFsHeader));
+            memcpy(nca_ctx->header.fs_header_hash[ctx->section_idx].hash, entry->fs_header_hash, SHA256_HASH_SIZE);
+
+            entry->last_use = ++g_ncaPatchCacheTick;
+            ret = true;
+
+            LOG_MSG_DEBUG("Restored cached hash data patch for FS section #%u from NCA \"%s\".", ctx->section_idx, nca_ctx->content_id_str);
+
+            break;
+        }
+    }
+
+    return ret;
+}
+
+static void ncaStoreCachedHashDataPatch(NcaFsSectionContext *ctx, const u8 *input_hash, const void *patch, bool is_integrity_patch)
+{
+    NcaContext *nca_ctx = ctx->nca_ctx;
+    NcaHashDataPatch *patch_array = NULL;
+    u32 patch_count = 0;
+    u64 data_size = 0;
+
+    /* Don't keep large patches around. */
+    ncaGetHashDataPatchArray(patch, is_integrity_patch, &patch_array, &patch_count);
+    for(u32 i = 0; i < patch_count; i++) data_size += patch_array[i].size;
+    if (data_size > NCA_PATCH_CACHE_MAX_DATA_SIZE) return;
+
+    SCOPED_LOCK(&g_ncaPatchCacheMutex)
+    {
+        /* Pick an unused entry, or evict the least recently used one. */
+        NcaHashDataPatchCacheEntry *entry = &(g_ncaPatchCache[0]);
+
+        for(u32 i = 0; i < NCA_PATCH_CACHE_ENTRY_COUNT; i++)
+        {
+            NcaHashDataPatchCacheEntry *cur_entry = &(g_ncaPatchCache[i]);
+
+            if (!cur_entry->valid)
+            {
+                entry = cur_entry;
+                break;
+            }
+
+            if (cur_entry->last_use < entry->last_use) entry = cur_entry;
+        }
+
+        if (entry->valid) ncaFreeHashDataPatch(&(entry->hierarchical_sha256_patch), entry->is_integrity_patch);
+        memset(entry, 0, sizeof(NcaHashDataPatchCacheEntry));
+
+        /* Store patch state. */
+        if (!ncaCopyHashDataPatch(&(entry->hierarchical_sha256_patch), patch, is_integrity_patch)) break;
+
+        entry->valid = true;
+        entry->last_use = ++g_ncaPatchCacheTick;
+
+        memcpy(&(entry->content_id), &(nca_ctx->content_id), sizeof(NcmContentId));
+        entry->section_idx = ctx->section_idx;
+        entry->is_integrity_patch = is_integrity_patch;
+        memcpy(entry->input_hash, input_hash, SHA256_HASH_SIZE);
+
+        memcpy(&(entry->header), &(ctx->header), sizeof(NcaFsHeader));
+        memcpy(entry->fs_header_hash, nca_ctx->header.fs_header_hash[ctx->section_idx].hash, SHA256_HASH_SIZE);
+    }
+}
+
+static void ncaGetHashDataPatchArray(const void *patch, bool is_integrity_patch, NcaHashDataPatch **out_array, u32 *out_count)
+{
+    if (!is_integrity_patch)
+    {
+        NcaHierarchicalSha256Patch *hierarchical_sha256_patch = (NcaHierarchicalSha256Patch*)patch;
+        *out_array = hierarchical_sha256_patch->hash_region_patch;
+        *out_count = NCA_HIERARCHICAL_SHA256_MAX_REGION_COUNT;
+    } else {
+        NcaHierarchicalIntegrityPatch *hierarchical_integrity_patch = (NcaHierarchicalIntegrityPatch*)patch;
+        *out_array = hierarchical_integrity_patch->hash_level_patch;
+        *out_count = NCA_IVFC_LEVEL_COUNT;
+    }
+}
+
+static bool ncaCopyHashDataPatch(void *dst, const void *src, bool is_integrity_patch)
+{
+    NcaHashDataPatch *dst_array = NULL, *src_array = NULL;
+    u32 count = 0;
+
+    /* Copy the patch struct, then duplicate every data block. The copy is always marked as not written. */
+    memcpy(dst, src, !is_integrity_patch ? sizeof(NcaHierarchicalSha256Patch) : sizeof(NcaHierarchicalIntegrityPatch));
+
+    ncaGetHashDataPatchArray(dst, is_integrity_patch, &dst_array, &count);
+    ncaGetHashDataPatchArray(src, is_integrity_patch, &src_array, &count);
+
+    for(u32 i = 0; i < count; i++)
+    {
+        dst_array[i].written = false;
+        dst_array[i].data = NULL;
+    }
+
+    if (!is_integrity_patch)
+    {
+        ((NcaHierarchicalSha256Patch*)dst)->written = false;
+    } else {
+        ((NcaHierarchicalIntegrityPatch*)dst)->written = false;
+    }
+
+    for(u32 i = 0; i < count; i++)
+    {
+        if (!src_array[i].data || !src_array[i].size) continue;
+
+        dst_array[i].data = malloc(src_array[i].size);
+        if (!dst_array[i].data)
+        {
+            LOG_MSG_ERROR("Failed to allocate 0x%lX bytes long buffer for cached hash data patch #%u!", src_array[i].size, i);
+            ncaFreeHashDataPatch(dst, is_integrity_patch);
+            return false;
+        }
+
+        memcpy(dst_array[i].data, src_array[i].data, src_array[i].size);
+    }
+
+    return true;
+}
+
+static void ncaFreeHashDataPatch(void *patch, bool is_integrity_patch)
+{
+    if (!is_integrity_patch)
+    {
+        ncaFreeHierarchicalSha256Patch((NcaHierarchicalSha256Patch*)patch);
+    } else {
+        ncaFreeHierarchicalIntegrityPatch((NcaHierarchicalIntegrityPatch*)patch);
+    }
+}
+
+static bool ncaReadHashLayerBlock(NcaFsSectionContext *ctx, u8 *out, u64 layer_offset, u64 read_start_offset, u64 read_end_offset, const NcaHashDataPatchRange *ranges, \
+                                  u32 range_count, u8 *crypto_buf)
+{
+    u64 gap_start_offset = read_start_offset;
+
+    /* Only read the areas that aren't covered by any of the provided ranges, then copy the range data. */
+    for(u32 i = 0; i <= range_count; i++)
+    {
+        u64 gap_end_offset = (i < range_count ? ranges[i].offset : read_end_offset);
+
+        if (gap_end_offset > gap_start_offset && !_ncaReadFsSection(ctx, out + (gap_start_offset - read_start_offset), gap_end_offset - gap_start_offset, \
+                                                                    layer_offset + gap_start_offset, crypto_buf)) return false;
+
+        if (i < range_count)
+        {
+            memcpy(out + (ranges[i].offset - read_start_offset), ranges[i].data, ranges[i].size);
+            gap_start_offset = (ranges[i].offset + ranges[i].size);
+        }
+    }
+
+    return true;
+}
+
 static bool ncaWritePatchToMemoryBuffer(NcaContext *ctx, const void *patch, u64 patch_size, u64 patch_offset, void *buf, u64 buf_size, u64 buf_offset)
 {
     /* Return right away if we're dealing with invalid parameters, or if the buffer data is not part of the range covered by the patch (last two conditions). */
@@ -1728,17 +3431,125 @@ static bool ncaWritePatchToMemoryBuffer(NcaContext *ctx, const void *patch, u64
     return ((patch_block_offset + buf_block_size) == patch_size);
 }
 
+static bool ncaReadNcmContentFile(NcaContext *ctx, NcmContentStorage *ncm_storage, void *out, u64 read_size, u64 offset)
+{
+    /* This strips NAX0 crypto from SD card NCAs (not used on eMMC NCAs). */
+    statsAddCounter(StatsCounterType_NcmRead, read_size);
+    u64 start_tick = armGetSystemTick();
+    Result rc = ncmContentStorageReadContentIdFile(ncm_storage, out, read_size, &(ctx->content_id), offset);
+    statsRecordLatency(StatsLatencyType_NcmRead, start_tick);
+
+    bool ret = R_SUCCEEDED(rc);
+    if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX bytes block at offset 0x%lX from NCA \"%s\"! (ncm) (0x%X).", read_size, offset, ctx->content_id_str, rc);
+
+    return ret;
+}
+
+static void ncaStripedReadWorkerThreadFunc(void *arg)
+{
+    NcaStripedReadWorker *worker = (NcaStripedReadWorker*)arg;
+    NcaStripedReader *reader = worker->reader;
+
+    while(true)
+    {
+        bool exit_requested = false;
+
+        SCOPED_LOCK(&(reader->mutex))
+        {
+            /* Wait for new work. Pending stripes are always read before exiting. */
+            while(!(exit_requested = reader->exit) && worker->state != NcaStripedReadWorkerState_Pending) condvarWait(&(reader->cond), &(reader->mutex));
+            if (worker->state == NcaStripedReadWorkerState_Pending) exit_requested = false;
+        }
+
+        if (exit_requested) break;
+
+        /* Read NCA data without holding the mutex. Nobody else touches this worker while its stripe is pending. */
+        bool success = ncaReadNcmContentFile(worker->nca_ctx, &(worker->ncm_storage), worker->out, worker->size, worker->offset);
+
+        SCOPED_LOCK(&(reader->mutex))
+        {
+            worker->success = success;
+            worker->state = NcaStripedReadWorkerState_Done;
+            condvarWakeAll(&(reader->cond));
+        }
+    }
+
+    threadExit();
+}
+
+static int ncaContentReadRequestSortFunction(const void *a, const void *b)
+{
+    const NcaContentReadRequest *request_1 = *((const NcaContentReadRequest**)a);
+    const NcaContentReadRequest *request_2 = *((const NcaContentReadRequest**)b);
+
+    if (request_1->offset < request_2->offset)
+    {
+        return -1;
+    } else
+    if (request_1->offset > request_2->offset)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool ncaPatchOverlayIndexAddEntry(NcaPatchOverlayIndex *index, const void *data, u64 size, u64 offset)
+{
+    NcaPatchOverlayEntry *tmp_entries = NULL;
+
+    if (!data || !size) return true;
+
+    /* Reallocate entry array. */
+    tmp_entries = realloc(index->entries, (index->entry_count + 1) * sizeof(NcaPatchOverlayEntry));
+    if (!tmp_entries)
+    {
+        LOG_MSG_ERROR("Failed to reallocate patch overlay entry array!");
+        return false;
+    }
+
+    index->entries = tmp_entries;
+    tmp_entries = NULL;
+
+    /* Fill new entry. */
+    NcaPatchOverlayEntry *entry = &(index->entries[index->entry_count++]);
+    entry->data = data;
+    entry->size = size;
+    entry->offset = offset;
+
+    index->sorted = false;
+
+    return true;
+}
+
+static int ncaPatchOverlayEntrySortFunction(const void *a, const void *b)
+{
+    const NcaPatchOverlayEntry *entry_1 = (const NcaPatchOverlayEntry*)a;
+    const NcaPatchOverlayEntry *entry_2 = (const NcaPatchOverlayEntry*)b;
+
+    if (entry_1->offset < entry_2->offset)
+    {
+        return -1;
+    } else
+    if (entry_1->offset > entry_2->offset)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
 /// Returns a pointer to a dynamically allocated buffer used to encrypt the input plaintext data, based on the encryption type used by the input NCA FS section, as well as its offset and size.
 /// Input offset must be relative to the start of the NCA FS section.
 /// Output size and offset are guaranteed to be aligned to the AES sector size used by the encryption type from the FS section.
 /// Output offset is relative to the start of the NCA content file, making it easier to use the output encrypted block to seamlessly replace data while dumping a NCA.
 /// This function doesn't support Patch RomFS sections, nor sections with Sparse and/or Compressed storage.
-static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, u64 *out_block_size, u64 *out_block_offset)
+static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, u64 *out_block_size, u64 *out_block_offset, u8 *crypto_buf)
 {
     u8 *out = NULL;
     bool success = false;
 
-    if (!g_ncaCryptoBuffer || !ctx || !ctx->enabled || ctx->has_sparse_layer || ctx->has_compression_layer || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || \
+    if (!crypto_buf || !ctx || !ctx->enabled || ctx->has_sparse_layer || ctx->has_compression_layer || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || \
         ctx->section_offset < sizeof(NcaHeader) || ctx->hash_type <= NcaHashType_None || ctx->hash_type == NcaHashType_AutoSha3 || ctx->hash_type >= NcaHashType_Count || \
         ctx->encryption_type == NcaEncryptionType_Auto || ctx->encryption_type == NcaEncryptionType_AesCtrEx || ctx->encryption_type >= NcaEncryptionType_AesCtrExSkipLayerHash || \
         ctx->section_type >= NcaFsSectionType_Invalid || !data || !data_size || (data_offset + data_size) > ctx->section_size || !out_block_size || !out_block_offset)
@@ -1794,8 +3605,8 @@ static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const
         if (ctx->encryption_type == NcaEncryptionType_AesCtr || ctx->encryption_type == NcaEncryptionType_AesCtrSkipLayerHash)
         {
             aes128CtrUpdatePartialCtr(ctx->ctr, content_offset);
-            aes128CtrContextResetCtr(&(ctx->ctr_ctx), ctx->ctr);
-            aes128CtrCrypt(&(ctx->ctr_ctx), out, out, data_size);
+            statsAddCounter(StatsCounterType_AesCtr, data_size);
+            aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, out, out, data_size);
         }
 
         *out_block_size = data_size;
@@ -1821,8 +3632,59 @@ static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const
         goto end;
     }
 
+    if (ctx->encryption_type == NcaEncryptionType_AesCtr || ctx->encryption_type == NcaEncryptionType_AesCtrSkipLayerHash)
+    {
+        /* AES-CTR is a stream cipher, so there's no need to decrypt the whole block just to reencrypt it right away. */
+        /* The keystream is applied once over the replaced plaintext data, while the surrounding bytes from the partially covered AES blocks are taken straight from the encrypted NCA. */
+        u8 head_block[AES_BLOCK_SIZE] = {0}, tail_block[AES_BLOCK_SIZE] = {0};
+        u64 head_size = plain_chunk_offset, tail_size = (block_size - plain_chunk_offset - data_size);
+        bool single_block = (block_size == AES_BLOCK_SIZE);
+        NcaContentReadRequest requests[2] = {0};
+        u32 request_count = 0;
+
+        if (head_size || single_block)
+        {
+            requests[request_count].out = head_block;
+            requests[request_count].size = AES_BLOCK_SIZE;
+            requests[request_count++].offset = content_offset;
+        }
+
+        if (tail_size && !single_block)
+        {
+            requests[request_count].out = tail_block;
+            requests[request_count].size = AES_BLOCK_SIZE;
+            requests[request_count++].offset = (content_offset + block_size - AES_BLOCK_SIZE);
+        }
+
+        if (!ncaReadContentFileVectored(nca_ctx, requests, request_count))
+        {
+            LOG_MSG_ERROR("Failed to read encrypted NCA \"%s\" FS section #%u data block boundaries!", nca_ctx->content_id_str, ctx->section_idx);
+            goto end;
+        }
+
+        /* Both boundaries live within the same AES block. */
+        if (single_block) memcpy(tail_block, head_block, AES_BLOCK_SIZE);
+
+        /* Encrypt plaintext data. The boundary bytes are encrypted as well, but they're overwritten right afterwards. */
+        memcpy(out + plain_chunk_offset, data, data_size);
+
+        aes128CtrUpdatePartialCtr(ctx->ctr, content_offset);
+        statsAddCounter(StatsCounterType_AesCtr, block_size);
+        aes128CtrCryptParallel(&(ctx->ctr_ctx), ctx->ctr, out, out, block_size);
+
+        /* Restore the encrypted boundary bytes. */
+        if (head_size) memcpy(out, head_block, head_size);
+        if (tail_size) memcpy(out + block_size - tail_size, tail_block + AES_BLOCK_SIZE - tail_size, tail_size);
+
+        *out_block_size = block_size;
+        *out_block_offset = content_offset;
+
+        success = true;
+        goto end;
+    }
+
     /* Read decrypted data using aligned offset and size. */
-    if (!_ncaReadFsSection(ctx, out, block_size, block_start_offset))
+    if (!_ncaReadFsSection(ctx, out, block_size, block_start_offset, crypto_buf))
     {
         LOG_MSG_ERROR("Failed to read decrypted NCA \"%s\" FS section #%u data block!", nca_ctx->content_id_str, ctx->section_idx);
         goto end;
@@ -1842,12 +3704,6 @@ static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const
             LOG_MSG_ERROR("Failed to AES-XTS encrypt 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (aligned).", block_size, content_offset, nca_ctx->content_id_str, ctx->section_idx);
             goto end;
         }
-    } else
-    if (ctx->encryption_type == NcaEncryptionType_AesCtr || ctx->encryption_type == NcaEncryptionType_AesCtrSkipLayerHash)
-    {
-        aes128CtrUpdatePartialCtr(ctx->ctr, content_offset);
-        aes128CtrContextResetCtr(&(ctx->ctr_ctx), ctx->ctr);
-        aes128CtrCrypt(&(ctx->ctr_ctx), out, out, block_size);
     }
 
     *out_block_size = block_size;
@@ -28,6 +28,10 @@ static bool ncaStorageInitializeBucketTreeContext(BucketTreeContext **out, NcaFs
 static bool ncaStorageSetPatchOriginalSubStorage(NcaStorageContext *patch_ctx, NcaStorageContext *base_ctx);
 static bool ncaStorageInitializeCompressedStorageBucketTreeContext(NcaStorageContext *out, NcaFsSectionContext *nca_fs_ctx);
 
+static bool ncaStorageReadBaseStorage(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset);
+static bool ncaStorageReadCachedData(NcaStorageContext *ctx, u8 *out, u64 read_size, u64 offset);
+static u64 ncaStorageGetVirtualSize(NcaStorageContext *ctx);
+
 bool ncaStorageInitializeContext(NcaStorageContext *out, NcaFsSectionContext *nca_fs_ctx, NcaStorageContext *base_ctx)
 {
     if (!out || !nca_fs_ctx || !nca_fs_ctx->enabled || (nca_fs_ctx->section_type == NcaFsSectionType_PatchRomFs && \
@@ -149,31 +153,118 @@ bool ncaStorageRead(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset
         return false;
     }
 
+    /* Fill zero-filled blocks right away. */
+    if (ctx->zero_ranges_available && bktrIsBlockContainedInVirtualRanges(ctx->zero_ranges, ctx->zero_range_count, offset, read_size))
+    {
+        memset(out, 0, read_size);
+        return true;
+    }
+
+    /* Bigger reads are usually sequential file data reads. Caching them would only evict hot blocks. */
+    if (read_size >= NCA_STORAGE_CACHE_BLOCK_SIZE) return ncaStorageReadBaseStorage(ctx, out, read_size, offset);
+
+    return ncaStorageReadCachedData(ctx, (u8*)out, read_size, offset);
+}
+
+bool ncaStorageQueryExtents(NcaStorageContext *ctx, StorageExtentList *out, u64 size, u64 offset)
+{
+    if (!ncaStorageIsValidContext(ctx) || !out || !size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
     bool success = false;
 
     switch(ctx->base_storage_type)
     {
         case NcaStorageBaseStorageType_Regular:
-            success = ncaReadFsSection(ctx->nca_fs_ctx, out, read_size, offset);
+            success = ncaQueryFsSectionExtents(ctx->nca_fs_ctx, out, size, offset);
             break;
         case NcaStorageBaseStorageType_Sparse:
-            success = bktrReadStorage(ctx->sparse_storage, out, read_size, offset);
+            success = bktrQueryStorageExtents(ctx->sparse_storage, out, size, offset);
             break;
         case NcaStorageBaseStorageType_Indirect:
-            success = bktrReadStorage(ctx->indirect_storage, out, read_size, offset);
+            success = bktrQueryStorageExtents(ctx->indirect_storage, out, size, offset);
             break;
         case NcaStorageBaseStorageType_Compressed:
-            success = bktrReadStorage(ctx->compressed_storage, out, read_size, offset);
+            success = bktrQueryStorageExtents(ctx->compressed_storage, out, size, offset);
             break;
         default:
             break;
     }
 
-    if (!success) LOG_MSG_ERROR("Failed to read 0x%lX-byte long block from offset 0x%lX in base storage! (type: %u).", read_size, offset, ctx->base_storage_type);
+    if (!success) LOG_MSG_ERROR("Failed to query 0x%lX-byte long block from offset 0x%lX in base storage! (type: %u).", size, offset, ctx->base_storage_type);
 
     return success;
 }
 
+bool ncaStorageGetPhysicalOffset(NcaStorageContext *ctx, u64 offset, u64 *out_offset)
+{
+    if (!ncaStorageIsValidContext(ctx) || !out_offset)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    BucketTreeContext *bktr_ctx = NULL;
+    u64 physical_offset = 0;
+    u8 storage_index = BucketTreeIndirectStorageIndex_Original;
+    bool success = false;
+
+    switch(ctx->base_storage_type)
+    {
+        case NcaStorageBaseStorageType_Regular:
+            *out_offset = offset;
+            return true;
+        case NcaStorageBaseStorageType_Sparse:
+            bktr_ctx = ctx->sparse_storage;
+            break;
+        case NcaStorageBaseStorageType_Indirect:
+            bktr_ctx = ctx->indirect_storage;
+            break;
+        case NcaStorageBaseStorageType_Compressed:
+            bktr_ctx = ctx->compressed_storage;
+            break;
+        default:
+            break;
+    }
+
+    success = bktrGetPhysicalOffset(bktr_ctx, offset, &physical_offset, &storage_index);
+    if (success)
+    {
+        /* Place offsets from the Patch storage after the ones from the original data storage, since they belong to different NCAs. */
+        *out_offset = (storage_index == BucketTreeIndirectStorageIndex_Patch ? (physical_offset | BITL(63)) : physical_offset);
+    } else {
+        LOG_MSG_ERROR("Failed to translate offset 0x%lX from base storage! (type: %u).", offset, ctx->base_storage_type);
+    }
+
+    return success;
+}
+
+bool ncaStorageBuildPatchCoverageMap(NcaStorageContext *ctx)
+{
+    if (!ncaStorageIsValidContext(ctx) || ctx->nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs || (ctx->base_storage_type != NcaStorageBaseStorageType_Indirect && \
+        ctx->base_storage_type != NcaStorageBaseStorageType_Compressed) || (ctx->base_storage_type == NcaStorageBaseStorageType_Indirect && !ctx->indirect_storage) || \
+        (ctx->base_storage_type == NcaStorageBaseStorageType_Compressed && !ctx->compressed_storage))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Return right away if the coverage map has already been built. */
+    if (ctx->patch_ranges_available) return true;
+
+    /* Get base storage. */
+    BucketTreeContext *bktr_ctx = (ctx->base_storage_type == NcaStorageBaseStorageType_Indirect ? ctx->indirect_storage : ctx->compressed_storage);
+
+    /* Retrieve Patch storage ranges. */
+    ctx->patch_ranges_available = bktrGetPatchStorageRanges(bktr_ctx, &(ctx->patch_ranges), &(ctx->patch_range_count));
+    if (!ctx->patch_ranges_available) LOG_MSG_ERROR("Failed to build Patch storage coverage map!");
+
+    return ctx->patch_ranges_available;
+}
+
 bool ncaStorageIsBlockWithinPatchStorageRange(NcaStorageContext *ctx, u64 offset, u64 size, bool *out)
 {
     if (!ncaStorageIsValidContext(ctx) || ctx->nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs || (ctx->base_storage_type != NcaStorageBaseStorageType_Indirect && \
@@ -184,6 +275,13 @@ bool ncaStorageIsBlockWithinPatchStorageRange(NcaStorageContext *ctx, u64 offset
         return false;
     }
 
+    /* Use the Patch storage coverage map, if available. */
+    if (ctx->patch_ranges_available)
+    {
+        *out = bktrIsBlockWithinVirtualRanges(ctx->patch_ranges, ctx->patch_range_count, offset, size);
+        return true;
+    }
+
     /* Get base storage. */
     BucketTreeContext *bktr_ctx = (ctx->base_storage_type == NcaStorageBaseStorageType_Indirect ? ctx->indirect_storage : ctx->compressed_storage);
 
@@ -194,6 +292,47 @@ bool ncaStorageIsBlockWithinPatchStorageRange(NcaStorageContext *ctx, u64 offset
     return success;
 }
 
+bool ncaStorageBuildZeroRangeMap(NcaStorageContext *ctx)
+{
+    if (!ncaStorageIsValidContext(ctx) || (ctx->base_storage_type == NcaStorageBaseStorageType_Sparse && !ctx->sparse_storage) || \
+        (ctx->base_storage_type == NcaStorageBaseStorageType_Compressed && !ctx->compressed_storage))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Return right away if the zero-filled range map has already been built. */
+    if (ctx->zero_ranges_available) return true;
+
+    /* Get base storage. Regular and Indirect storages never hold zero-filled ranges on their own. */
+    BucketTreeContext *bktr_ctx = (ctx->base_storage_type == NcaStorageBaseStorageType_Sparse ? ctx->sparse_storage : \
+                                  (ctx->base_storage_type == NcaStorageBaseStorageType_Compressed ? ctx->compressed_storage : NULL));
+    if (!bktr_ctx)
+    {
+        ctx->zero_ranges_available = true;
+        return true;
+    }
+
+    /* Retrieve zero-filled ranges. */
+    ctx->zero_ranges_available = bktrGetZeroFilledRanges(bktr_ctx, &(ctx->zero_ranges), &(ctx->zero_range_count));
+    if (!ctx->zero_ranges_available) LOG_MSG_ERROR("Failed to build zero-filled range map!");
+
+    return ctx->zero_ranges_available;
+}
+
+bool ncaStorageIsBlockZeroFilled(NcaStorageContext *ctx, u64 offset, u64 size, bool *out)
+{
+    if (!ncaStorageIsValidContext(ctx) || !size || !out)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    *out = (ctx->zero_ranges_available && bktrIsBlockContainedInVirtualRanges(ctx->zero_ranges, ctx->zero_range_count, offset, size));
+
+    return true;
+}
+
 void ncaStorageFreeContext(NcaStorageContext *ctx)
 {
     if (!ctx) return;
@@ -222,6 +361,15 @@ void ncaStorageFreeContext(NcaStorageContext *ctx)
         free(ctx->compressed_storage);
     }
 
+    if (ctx->patch_ranges) free(ctx->patch_ranges);
+
+    if (ctx->zero_ranges) free(ctx->zero_ranges);
+
+    for(u8 i = 0; i < NCA_STORAGE_CACHE_BLOCK_COUNT; i++)
+    {
+        if (ctx->cache[i].data) bufferPoolReturn(ctx->cache[i].data);
+    }
+
     memset(ctx, 0, sizeof(NcaStorageContext));
 }
 
@@ -374,3 +522,129 @@ end:
 
     return success;
 }
+
+static bool ncaStorageReadBaseStorage(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    bool success = false;
+
+    switch(ctx->base_storage_type)
+    {
+        case NcaStorageBaseStorageType_Regular:
+            success = ncaReadFsSection(ctx->nca_fs_ctx, out, read_size, offset);
+            break;
+        case NcaStorageBaseStorageType_Sparse:
+            success = bktrReadStorage(ctx->sparse_storage, out, read_size, offset);
+            break;
+        case NcaStorageBaseStorageType_Indirect:
+            success = bktrReadStorage(ctx->indirect_storage, out, read_size, offset);
+            break;
+        case NcaStorageBaseStorageType_Compressed:
+            success = bktrReadStorage(ctx->compressed_storage, out, read_size, offset);
+            break;
+        default:
+            break;
+    }
+
+    if (!success) LOG_MSG_ERROR("Failed to read 0x%lX-byte long block from offset 0x%lX in base storage! (type: %u).", read_size, offset, ctx->base_storage_type);
+
+    return success;
+}
+
+static bool ncaStorageReadCachedData(NcaStorageContext *ctx, u8 *out, u64 read_size, u64 offset)
+{
+    const u64 storage_size = ncaStorageGetVirtualSize(ctx);
+
+    /* Let the base storage deal with out-of-bounds reads. */
+    if (offset >= storage_size || read_size > (storage_size - offset)) return ncaStorageReadBaseStorage(ctx, out, read_size, offset);
+
+    /* Use fewer cache blocks under low memory conditions. */
+    const u8 cache_block_count = (u8)utilsGetBudgetedBufferCount(NCA_STORAGE_CACHE_BLOCK_COUNT, 1);
+
+    bool success = true;
+
+    SCOPED_LOCK(&(ctx->cache_mutex))
+    {
+        while(read_size)
+        {
+            u64 block_offset = ALIGN_DOWN(offset, NCA_STORAGE_CACHE_BLOCK_SIZE);
+            u64 block_data_offset = (offset - block_offset);
+            NcaStorageCacheBlock *block = NULL;
+
+            /* Look for a cache hit. Pick the least recently used block (or an unused one) as the eviction candidate along the way. */
+            for(u8 i = 0; i < cache_block_count; i++)
+            {
+                NcaStorageCacheBlock *cur_block = &(ctx->cache[i]);
+
+                if (cur_block->size && cur_block->offset == block_offset)
+                {
+                    block = cur_block;
+                    break;
+                }
+
+                if (!block || (block->size && (!cur_block->size || cur_block->last_used < block->last_used))) block = cur_block;
+            }
+
+            if (!block->size || block->offset != block_offset)
+            {
+                /* Cache miss. Allocate memory for the selected block, if needed. */
+                if (!block->data && !(block->data = bufferPoolLease(NCA_STORAGE_CACHE_BLOCK_SIZE, false)))
+                {
+                    /* Degrade gracefully by reading the rest of the data straight from the base storage. */
+                    success = ncaStorageReadBaseStorage(ctx, out, read_size, offset);
+                    break;
+                }
+
+                /* Invalidate the selected block before reading data into it. */
+                block->size = 0;
+
+                u64 block_size = MIN(NCA_STORAGE_CACHE_BLOCK_SIZE, storage_size - block_offset);
+
+                if (!ncaStorageReadBaseStorage(ctx, block->data, block_size, block_offset))
+                {
+                    success = false;
+                    break;
+                }
+
+                block->offset = block_offset;
+                block->size = block_size;
+            }
+
+            /* Update LRU counter and copy the data we need. */
+            block->last_used = ++(ctx->cache_counter);
+
+            u64 copy_size = MIN(read_size, block->size - block_data_offset);
+            memcpy(out, block->data + block_data_offset, copy_size);
+
+            out += copy_size;
+            read_size -= copy_size;
+            offset += copy_size;
+        }
+    }
+
+    return success;
+}
+
+static u64 ncaStorageGetVirtualSize(NcaStorageContext *ctx)
+{
+    u64 size = 0;
+
+    switch(ctx->base_storage_type)
+    {
+        case NcaStorageBaseStorageType_Regular:
+            size = ctx->nca_fs_ctx->section_size;
+            break;
+        case NcaStorageBaseStorageType_Sparse:
+            size = ctx->sparse_storage->end_offset;
+            break;
+        case NcaStorageBaseStorageType_Indirect:
+            size = ctx->indirect_storage->end_offset;
+            break;
+        case NcaStorageBaseStorageType_Compressed:
+            size = ctx->compressed_storage->end_offset;
+            break;
+        default:
+            break;
+    }
+
+    return size;
+}
@@ -0,0 +1,287 @@
+/*
+ * nointro.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <core/nxdt_utils.h>
+#include <core/nointro.h>
+
+#define NOINTRO_INDEX_MAX_SIZE  (u64)0x4000000  /* 64 MiB. */
+
+/* Global variables. */
+
+static Mutex g_noIntroMutex = 0;
+static bool g_noIntroIndexLoaded = false;
+
+static u8 *g_noIntroIndexData = NULL;
+static const NoIntroIndexEntry *g_noIntroIndexEntries = NULL;
+static const char *g_noIntroIndexNameTable = NULL;
+static u32 g_noIntroIndexEntryCount = 0, g_noIntroIndexNameTableSize = 0;
+
+/* Function prototypes. */
+
+static bool noIntroLoadIndex(void);
+static void noIntroFreeIndex(void);
+
+static void noIntroSetIndexData(u8 *data);
+static bool noIntroValidateIndexData(const u8 *data, u64 size);
+
+void noIntroExit(void)
+{
+    SCOPED_LOCK(&g_noIntroMutex) noIntroFreeIndex();
+}
+
+bool noIntroLookupChecksum(u32 crc32, const u8 *sha1, NoIntroRecord *out)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_noIntroMutex)
+    {
+        /* Load index, if needed. */
+        if (!g_noIntroIndexLoaded && !noIntroLoadIndex()) break;
+
+        /* Perform a binary search to find the first entry matching the provided checksum. */
+        u32 low = 0, high = g_noIntroIndexEntryCount;
+
+        while(low < high)
+        {
+            u32 mid = (low + ((high - low) / 2));
+
+            if (g_noIntroIndexEntries[mid].crc32 < crc32)
+            {
+                low = (mid + 1);
+            } else {
+                high = mid;
+            }
+        }
+
+        /* Look for a matching entry. Multiple entries may share the same checksum. */
+        for(u32 i = low; i < g_noIntroIndexEntryCount && g_noIntroIndexEntries[i].crc32 == crc32; i++)
+        {
+            const NoIntroIndexEntry *entry = &(g_noIntroIndexEntries[i]);
+            if (sha1 && memcmp(entry->sha1, sha1, SHA1_HASH_SIZE) != 0) continue;
+
+            if (out)
+            {
+                snprintf(out->name, sizeof(out->name), "%s", g_noIntroIndexNameTable + entry->name_offset);
+                out->title_id = entry->title_id;
+                memcpy(out->sha1, entry->sha1, SHA1_HASH_SIZE);
+            }
+
+            ret = true;
+            break;
+        }
+
+        if (!ret) LOG_MSG_DEBUG("No-Intro index lookup failed for CRC32 %08X.", crc32);
+    }
+
+    return ret;
+}
+
+bool noIntroRefreshIndex(const char *url)
+{
+    if (!url || !*url)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u8 *data = NULL;
+    size_t size = 0;
+    FILE *fp = NULL;
+    bool ret = false;
+
+    SCOPED_LOCK(&g_noIntroMutex)
+    {
+        /* Download index data. */
+        if (!(data = (u8*)httpDownloadData(&size, url, true, NULL, NULL)))
+        {
+            LOG_MSG_ERROR("Failed to download No-Intro index from \"%s\"!", url);
+            break;
+        }
+
+        /* Validate index data before replacing anything. */
+        if (!noIntroValidateIndexData(data, size))
+        {
+            LOG_MSG_ERROR("Downloaded No-Intro index is invalid!");
+            break;
+        }
+
+        /* Write index data to a temporary file, then replace the current index file. */
+        utilsCreateDirectoryTree(NOINTRO_INDEX_PATH, false);
+
+        if (!(fp = fopen(NOINTRO_INDEX_TMP_PATH, "wb")))
+        {
+            LOG_MSG_ERROR("Failed to open \"" NOINTRO_INDEX_TMP_PATH "\" for writing!");
+            break;
+        }
+
+        bool write_ok = (fwrite(data, 1, size, fp) == size);
+        fclose(fp);
+
+        if (!write_ok)
+        {
+            LOG_MSG_ERROR("Failed to write 0x%lX bytes long No-Intro index!", size);
+            remove(NOINTRO_INDEX_TMP_PATH);
+            break;
+        }
+
+        remove(NOINTRO_INDEX_PATH);
+        rename(NOINTRO_INDEX_TMP_PATH, NOINTRO_INDEX_PATH);
+
+        /* Replace the index loaded into memory. Ownership of the downloaded buffer is transferred. */
+        noIntroFreeIndex();
+        noIntroSetIndexData(data);
+        data = NULL;
+
+        ret = true;
+
+        LOG_MSG_INFO("Successfully refreshed No-Intro index (%u entries).", g_noIntroIndexEntryCount);
+    }
+
+    if (data) free(data);
+
+    utilsCommitSdCardFileSystemChanges();
+
+    return ret;
+}
+
+static bool noIntroLoadIndex(void)
+{
+    FILE *fp = NULL;
+    u8 *data = NULL;
+    u64 size = 0;
+    bool success = false;
+
+    /* Open index file. */
+    if (!(fp = fopen(NOINTRO_INDEX_PATH, "rb")))
+    {
+        LOG_MSG_DEBUG("No-Intro index unavailable at \"" NOINTRO_INDEX_PATH "\".");
+        goto end;
+    }
+
+    /* Get index file size. */
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+
+    if (size < sizeof(NoIntroIndexHeader) || size > NOINTRO_INDEX_MAX_SIZE)
+    {
+        LOG_MSG_ERROR("Invalid No-Intro index size! (0x%lX).", size);
+        goto end;
+    }
+
+    /* Read the whole index into memory. */
+    if (!(data = malloc(size)))
+    {
+        LOG_MSG_ERROR("Failed to allocate 0x%lX bytes for the No-Intro index!", size);
+        goto end;
+    }
+
+    if (fread(data, 1, size, fp) != size)
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes long No-Intro index!", size);
+        goto end;
+    }
+
+    /* Validate index data. */
+    if (!noIntroValidateIndexData(data, size))
+    {
+        LOG_MSG_ERROR("No-Intro index at \"" NOINTRO_INDEX_PATH "\" is invalid!");
+        goto end;
+    }
+
+    /* Update global variables. Ownership of the buffer is transferred. */
+    noIntroSetIndexData(data);
+    data = NULL;
+
+    success = true;
+
+    LOG_MSG_INFO("Loaded No-Intro index (%u entries).", g_noIntroIndexEntryCount);
+
+end:
+    if (data) free(data);
+
+    if (fp) fclose(fp);
+
+    return success;
+}
+
+static void noIntroFreeIndex(void)
+{
+    if (g_noIntroIndexData) free(g_noIntroIndexData);
+    g_noIntroIndexData = NULL;
+
+    g_noIntroIndexEntries = NULL;
+    g_noIntroIndexNameTable = NULL;
+    g_noIntroIndexEntryCount = g_noIntroIndexNameTableSize = 0;
+
+    g_noIntroIndexLoaded = false;
+}
+
+static void noIntroSetIndexData(u8 *data)
+{
+    const NoIntroIndexHeader *header = (const NoIntroIndexHeader*)data;
+
+    g_noIntroIndexData = data;
+    g_noIntroIndexEntries = (const NoIntroIndexEntry*)(data + sizeof(NoIntroIndexHeader));
+    g_noIntroIndexNameTable = (const char*)(data + sizeof(NoIntroIndexHeader) + ((u64)header->entry_count * sizeof(NoIntroIndexEntry)));
+    g_noIntroIndexEntryCount = header->entry_count;
+    g_noIntroIndexNameTableSize = header->name_table_size;
+
+    g_noIntroIndexLoaded = true;
+}
+
+static bool noIntroValidateIndexData(const u8 *data, u64 size)
+{
+    if (!data || size < sizeof(NoIntroIndexHeader)) return false;
+
+    const NoIntroIndexHeader *header = (const NoIntroIndexHeader*)data;
+    const NoIntroIndexEntry *entries = (const NoIntroIndexEntry*)(data + sizeof(NoIntroIndexHeader));
+    const char *name_table = NULL;
+
+    /* Validate header. */
+    if (__builtin_bswap32(header->magic) != NOINTRO_INDEX_MAGIC || header->version != NOINTRO_INDEX_VERSION || !header->entry_count || !header->name_table_size || \
+        size != (sizeof(NoIntroIndexHeader) + ((u64)header->entry_count * sizeof(NoIntroIndexEntry)) + header->name_table_size))
+    {
+        LOG_MSG_ERROR("Invalid No-Intro index header!");
+        return false;
+    }
+
+    name_table = (const char*)(entries + header->entry_count);
+
+    /* Make sure the name table is NULL-terminated, which guarantees all name lookups are bounded. */
+    if (name_table[header->name_table_size - 1] != '\0')
+    {
+        LOG_MSG_ERROR("No-Intro index name table isn't NULL-terminated!");
+        return false;
+    }
+
+    /* Validate entries. Binary search relies on them being sorted. */
+    for(u32 i = 0; i < header->entry_count; i++)
+    {
+        if (entries[i].name_offset >= header->name_table_size || (i > 0 && entries[i].crc32 < entries[i - 1].crc32))
+        {
+            LOG_MSG_ERROR("Invalid No-Intro index entry #%u!", i);
+            return false;
+        }
+    }
+
+    return true;
+}
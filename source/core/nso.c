@@ -34,8 +34,8 @@ typedef enum {
 typedef struct {
     u8 type;                ///< NsoSegmentType.
     const char *name;       ///< Pointer to a string that holds the segment name.
-    NsoSegmentInfo info;    ///< Copied from the NSO header.
-    u8 *data;               ///< Dynamically allocated buffer for the decompressed segment data.
+    NsoSegmentInfo info;    ///< Copied from the NSO header. The size field only covers the decompressed data that's actually available if the segment was partially retrieved.
+    u8 *data;               ///< Buffer leased from the shared buffer pool, which holds the decompressed segment data.
 } NsoSegment;
 
 /* Global variables. */
@@ -50,7 +50,8 @@ static const char *g_nsoSegmentTypeNames[NsoSegmentType_Count] = {
 
 static bool nsoGetModuleName(NsoContext *nso_ctx);
 
-static bool nsoGetSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type);
+static bool nsoGetSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type, u32 max_size);
+static bool nsoGetPartialSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type, u32 out_size);
 NX_INLINE void nsoFreeSegment(NsoSegment *segment);
 
 NX_INLINE bool nsoIsNnSdkVersionWithinSegment(const NsoModStart *mod_start, const NsoSegment *segment, u32 nnsdk_version_memory_offset);
@@ -147,8 +148,8 @@ bool nsoInitializeContext(NsoContext *out, PartitionFileSystemContext *pfs_ctx,
     /* Get module name. */
     if (!nsoGetModuleName(out)) goto end;
 
-    /* Get .text segment. */
-    if (!nsoGetSegment(out, &segment, NsoSegmentType_Text)) goto end;
+    /* Get the start of the .text segment. Only the NsoModStart block is needed at this point. */
+    if (!nsoGetSegment(out, &segment, NsoSegmentType_Text, sizeof(NsoModStart)) || segment.info.size < sizeof(NsoModStart)) goto end;
 
     /* Get NsoModStart block. */
     memcpy(&mod_start, segment.data, sizeof(NsoModStart));
@@ -158,15 +159,21 @@ bool nsoInitializeContext(NsoContext *out, PartitionFileSystemContext *pfs_ctx,
     if (read_nnsdk_version)
     {
         /* Calculate memory offset for the NsoNnSdkVersion block. */
-        nnsdk_version_memory_offset = (segment.info.memory_offset + (u32)mod_start.nnsdk_version_offset);
+        const NsoSegmentInfo *text_segment_info = &(out->nso_header.text_segment_info);
+        nnsdk_version_memory_offset = (text_segment_info->memory_offset + (u32)mod_start.nnsdk_version_offset);
 
         /* Check if the NsoNnSdkVersion block is located within the .text segment. */
-        /* If so, we'll retrieve it immediately. */
-        if (nsoIsNnSdkVersionWithinSegment(&mod_start, &segment, nnsdk_version_memory_offset) && !nsoGetNnSdkVersion(out, &mod_start, &segment, nnsdk_version_memory_offset)) goto end;
+        /* If so, we'll retrieve it immediately, decompressing the .text segment up to the end of the block if it isn't available yet. */
+        if ((nnsdk_version_memory_offset + sizeof(NsoNnSdkVersion)) <= (text_segment_info->memory_offset + text_segment_info->size))
+        {
+            u32 text_size = (nnsdk_version_memory_offset - text_segment_info->memory_offset + (u32)sizeof(NsoNnSdkVersion));
+
+            if ((!nsoIsNnSdkVersionWithinSegment(&mod_start, &segment, nnsdk_version_memory_offset) && !nsoGetSegment(out, &segment, NsoSegmentType_Text, text_size)) ||                 !nsoGetNnSdkVersion(out, &mod_start, &segment, nnsdk_version_memory_offset)) goto end;
+        }
     }
 
-    /* Get .rodata segment. */
-    if (!nsoGetSegment(out, &segment, NsoSegmentType_RoData)) goto end;
+    /* Get .rodata segment. The whole segment is needed, but only the pieces we care about are kept once we're done with it. */
+    if (!nsoGetSegment(out, &segment, NsoSegmentType_RoData, 0)) goto end;
 
     /* Check if we didn't read the NsoNnSdkVersion block from the .text segment. */
     if (read_nnsdk_version && !out->nnsdk_version)
@@ -231,7 +238,7 @@ static bool nsoGetModuleName(NsoContext *nso_ctx)
     return true;
 }
 
-static bool nsoGetSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type)
+static bool nsoGetSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type, u32 max_size)
 {
     if (!nso_ctx || !out || type >= NsoSegmentType_Count)
     {
@@ -253,6 +260,10 @@ static bool nsoGetSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type)
     int lz4_res = 0;
     bool compressed = (nso_ctx->nso_header.flags & BIT(type)), verify = (nso_ctx->nso_header.flags & BIT(type + 3));
 
+    /* Only retrieve the first 'max_size' decompressed bytes, if requested. Not possible if the segment hash must be verified. */
+    u32 out_size = ((!max_size || max_size >= segment_info->size || verify) ? segment_info->size : max_size);
+    bool partial = (out_size < segment_info->size);
+
     u8 *buf = NULL;
     u32 buf_size = (compressed ? LZ4_DECOMPRESS_INPLACE_BUFFER_SIZE(segment_info->size) : segment_info->size);
 
@@ -266,8 +277,11 @@ static bool nsoGetSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type)
     /* Clear output struct. */
     nsoFreeSegment(out);
 
-    /* Allocate memory for the segment buffer. */
-    if (!(buf = calloc(buf_size, sizeof(u8))))
+    /* Take care of partial retrievals right away. */
+    if (partial) return nsoGetPartialSegment(nso_ctx, out, type, out_size);
+
+    /* Lease the segment buffer from the shared buffer pool. It doesn't need to be cleared, since it's fully overwritten by the actual segment data. */
+    if (!(buf = bufferPoolLease(buf_size, false))))
     {
         LOG_MSG_ERROR("Failed to allocate 0x%X bytes for the %s segment in NSO \"%s\"!", buf_size, segment_name, nso_ctx->nso_filename);
         return NULL;
@@ -309,7 +323,76 @@ static bool nsoGetSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type)
     success = true;
 
 end:
-    if (!success && buf) free(buf);
+    if (!success && buf) bufferPoolReturn(buf);
+
+    return success;
+}
+
+static bool nsoGetPartialSegment(NsoContext *nso_ctx, NsoSegment *out, u8 type, u32 out_size)
+{
+    const char *segment_name = g_nsoSegmentTypeNames[type];
+
+    const NsoSegmentInfo *segment_info = (type == NsoSegmentType_Text ? &(nso_ctx->nso_header.text_segment_info) : \
+                                         (type == NsoSegmentType_RoData ? &(nso_ctx->nso_header.rodata_segment_info) : &(nso_ctx->nso_header.data_segment_info)));
+
+    u32 segment_file_size = (type == NsoSegmentType_Text ? nso_ctx->nso_header.text_file_size : \
+                            (type == NsoSegmentType_RoData ? nso_ctx->nso_header.rodata_file_size : nso_ctx->nso_header.data_file_size));
+
+    int lz4_res = 0;
+    bool compressed = (nso_ctx->nso_header.flags & BIT(type));
+
+    u8 *buf = NULL, *compressed_buf = NULL;
+    bool success = false;
+
+    /* Lease the output buffer from the shared buffer pool. It doesn't need to be cleared, since it's fully overwritten by the actual segment data. */
+    if (!(buf = bufferPoolLease(out_size, false))))
+    {
+        LOG_MSG_ERROR("Failed to allocate 0x%X bytes for the %s segment in NSO \"%s\"!", out_size, segment_name, nso_ctx->nso_filename);
+        return false;
+    }
+
+    if (compressed)
+    {
+        /* Read compressed segment data into a separate buffer. Decompression stops as soon as 'out_size' bytes have been produced, so no in-place margin is needed. */
+        if (!(compressed_buf = bufferPoolLease(segment_file_size, false)))
+        {
+            LOG_MSG_ERROR("Failed to allocate 0x%X bytes for the compressed %s segment in NSO \"%s\"!", segment_file_size, segment_name, nso_ctx->nso_filename);
+            goto end;
+        }
+
+        if (!pfsReadEntryData(nso_ctx->pfs_ctx, nso_ctx->pfs_entry, compressed_buf, segment_file_size, segment_info->file_offset))
+        {
+            LOG_MSG_ERROR("Failed to read %s segment in NSO \"%s\"!", segment_name, nso_ctx->nso_filename);
+            goto end;
+        }
+
+        if ((lz4_res = LZ4_decompress_safe_partial((char*)compressed_buf, (char*)buf, (int)segment_file_size, (int)out_size, (int)out_size)) != (int)out_size)
+        {
+            LOG_MSG_ERROR("LZ4 partial decompression failed for %s segment in NSO \"%s\"! (%d).", segment_name, nso_ctx->nso_filename, lz4_res);
+            goto end;
+        }
+    } else {
+        /* Read the start of the segment. */
+        if (!pfsReadEntryData(nso_ctx->pfs_ctx, nso_ctx->pfs_entry, buf, out_size, segment_info->file_offset))
+        {
+            LOG_MSG_ERROR("Failed to read %s segment in NSO \"%s\"!", segment_name, nso_ctx->nso_filename);
+            goto end;
+        }
+    }
+
+    /* Fill output struct. */
+    out->type = type;
+    out->name = segment_name;
+    memcpy(&(out->info), segment_info, sizeof(NsoSegmentInfo));
+    out->info.size = out_size;
+    out->data = buf;
+
+    success = true;
+
+end:
+    if (compressed_buf) bufferPoolReturn(compressed_buf);
+
+    if (!success && buf) bufferPoolReturn(buf);
 
     return success;
 }
@@ -317,7 +400,7 @@ end:
 NX_INLINE void nsoFreeSegment(NsoSegment *segment)
 {
     if (!segment) return;
-    if (segment->data) free(segment->data);
+    if (segment->data) bufferPoolReturn(segment->data);
     memset(segment, 0, sizeof(NsoSegment));
 }
 
@@ -107,7 +107,7 @@ bool bfsarInitialize(void)
 
         /* Initialize NCA context. */
         /* Don't allow invalid NCA signatures. */
-        if (!ncaInitializeContext(nca_ctx, title_info->storage_id, 0, &(title_info->meta_key), titleGetContentInfoByTypeAndIdOffset(title_info, NcmContentType_Program, 0), NULL) || \
+        if (!ncaInitializeContextLazy(nca_ctx, title_info->storage_id, 0, &(title_info->meta_key), titleGetContentInfoByTypeAndIdOffset(title_info, NcmContentType_Program, 0), NULL) || \
             !nca_ctx->valid_main_signature)
         {
             LOG_MSG_ERROR("Failed to initialize qlaunch Program NCA context!");
@@ -115,7 +115,8 @@ bool bfsarInitialize(void)
         }
 
         /* Initialize RomFS context. */
-        if (!romfsInitializeContext(&romfs_ctx, &(nca_ctx->fs_ctx[1]), NULL))
+        /* We only need a single file, so there's no point in loading qlaunch's whole directory and file entries tables into memory. */
+        if (!romfsInitializePagedContext(&romfs_ctx, ncaGetFsSectionContext(nca_ctx, 1), NULL))
         {
             LOG_MSG_ERROR("Failed to initialize RomFS context for qlaunch Program NCA!");
             break;
@@ -41,6 +41,52 @@ bool jsonSet##functype(const struct json_object *obj, const char *path, vartype
     return ret; \
 }
 
+/* Type definitions. */
+
+typedef enum {
+    JsonStreamState_Value         = 0,  ///< Waiting for a value.
+    JsonStreamState_String        = 1,  ///< Parsing a string (either a key or a value).
+    JsonStreamState_StringEscape  = 2,  ///< Right after a backslash within a string.
+    JsonStreamState_StringUnicode = 3,  ///< Parsing the hex digits from a \uXXXX escape sequence.
+    JsonStreamState_Literal       = 4,  ///< Parsing a number, true, false or null.
+    JsonStreamState_AfterValue    = 5,  ///< Waiting for a comma or a closing bracket / brace.
+    JsonStreamState_ObjectKey     = 6,  ///< Waiting for an object key.
+    JsonStreamState_AfterKey      = 7,  ///< Waiting for a colon.
+    JsonStreamState_Done          = 8   ///< Top-level value fully parsed. Only whitespace may follow.
+} JsonStreamState;
+
+/* Function prototypes. */
+
+static bool jsonStreamReaderOpenContainer(JsonStreamReader *reader, bool is_array);
+static bool jsonStreamReaderCloseContainer(JsonStreamReader *reader, bool is_array);
+
+static bool jsonStreamReaderSetPathComponent(JsonStreamReader *reader, const char *component, size_t component_len);
+static bool jsonStreamReaderSetArrayIndex(JsonStreamReader *reader, u32 index);
+
+static bool jsonStreamReaderAppendCodepoint(JsonStreamReader *reader, u32 codepoint);
+static bool jsonStreamReaderFinishLiteral(JsonStreamReader *reader);
+static bool jsonStreamReaderEmitValue(JsonStreamReader *reader, u8 type);
+
+NX_INLINE bool jsonStreamIsWhitespace(char c)
+{
+    return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+NX_INLINE int jsonStreamGetHexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9') return (c - '0');
+    if (c >= 'a' && c <= 'f') return (c - 'a' + 10);
+    if (c >= 'A' && c <= 'F') return (c - 'A' + 10);
+    return -1;
+}
+
+NX_INLINE void jsonStreamReaderResetToken(JsonStreamReader *reader)
+{
+    /* Keep the allocated buffer around. */
+    reader->token.length = 0;
+    if (reader->token.data) *(reader->token.data) = '\0';
+}
+
 struct json_object *jsonParseFromString(const char *str, size_t size)
 {
     if (!str || !*str)
@@ -151,6 +197,33 @@ end:
     return child_obj;
 }
 
+char *jsonGenerateEscapedString(const char *str)
+{
+    if (!str)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    struct json_object *obj = NULL;
+    const char *obj_str = NULL;
+    char *out = NULL;
+
+    /* Let json-c take care of escaping the string. */
+    if (!(obj = json_object_new_string(str)))
+    {
+        LOG_MSG_ERROR("json_object_new_string failed!");
+        return NULL;
+    }
+
+    obj_str = json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE);
+    if (!obj_str || !(out = strdup(obj_str))) LOG_MSG_ERROR("Failed to generate escaped JSON string!");
+
+    json_object_put(obj);
+
+    return out;
+}
+
 void jsonLogLastError(void)
 {
     size_t str_len = 0;
@@ -218,3 +291,420 @@ end:
 
     return ret;
 }
+
+void jsonStreamReaderInitialize(JsonStreamReader *reader, JsonStreamValueCallback callback, void *user_data)
+{
+    if (!reader) return;
+
+    memset(reader, 0, sizeof(JsonStreamReader));
+    reader->callback = callback;
+    reader->user_data = user_data;
+    reader->state = JsonStreamState_Value;
+}
+
+bool jsonStreamReaderFeed(JsonStreamReader *reader, const char *data, size_t size)
+{
+    if (!reader || (!data && size))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    if (reader->error || reader->stopped) return false;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        char c = data[i];
+
+        switch(reader->state)
+        {
+            case JsonStreamState_Value:
+                if (jsonStreamIsWhitespace(c)) break;
+
+                /* Handle empty arrays. */
+                if (c == ']' && reader->container_start && reader->depth && reader->stack[reader->depth - 1].is_array)
+                {
+                    reader->container_start = false;
+                    if (!jsonStreamReaderCloseContainer(reader, true)) goto end;
+                    break;
+                }
+
+                reader->container_start = false;
+                jsonStreamReaderResetToken(reader);
+
+                if (c == '{' || c == '[')
+                {
+                    if (!jsonStreamReaderOpenContainer(reader, c == '[')) goto end;
+                } else
+                if (c == '"')
+                {
+                    reader->is_key = false;
+                    reader->state = JsonStreamState_String;
+                } else
+                if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n')
+                {
+                    if (!stringBuilderAppendWithLength(&(reader->token), &c, 1)) goto error;
+                    reader->state = JsonStreamState_Literal;
+                } else {
+                    goto error;
+                }
+
+                break;
+            case JsonStreamState_String:
+                if (c == '"')
+                {
+                    /* The token buffer is only allocated once something gets appended to it. */
+                    if (!reader->token.data && !stringBuilderReserve(&(reader->token), 0)) goto error;
+
+                    if (reader->is_key)
+                    {
+                        if (!jsonStreamReaderSetPathComponent(reader, reader->token.data, reader->token.length)) goto error;
+                        reader->state = JsonStreamState_AfterKey;
+                    } else {
+                        if (!jsonStreamReaderEmitValue(reader, JsonStreamValueType_String)) goto end;
+                    }
+                } else
+                if (c == '\\')
+                {
+                    reader->state = JsonStreamState_StringEscape;
+                } else
+                if ((u8)c < 0x20)
+                {
+                    goto error;
+                } else {
+                    if (!stringBuilderAppendWithLength(&(reader->token), &c, 1)) goto error;
+                }
+
+                break;
+            case JsonStreamState_StringEscape:
+            {
+                char escaped = 0;
+
+                switch(c)
+                {
+                    case '"':
+                    case '\\':
+                    case '/':
+                        escaped = c;
+                        break;
+                    case 'b':
+                        escaped = '\b';
+                        break;
+                    case 'f':
+                        escaped = '\f';
+                        break;
+                    case 'n':
+                        escaped = '\n';
+                        break;
+                    case 'r':
+                        escaped = '\r';
+                        break;
+                    case 't':
+                        escaped = '\t';
+                        break;
+                    case 'u':
+                        reader->unicode_digit_count = 0;
+                        reader->unicode_codepoint = 0;
+                        reader->state = JsonStreamState_StringUnicode;
+                        break;
+                    default:
+                        goto error;
+                }
+
+                if (escaped)
+                {
+                    if (!stringBuilderAppendWithLength(&(reader->token), &escaped, 1)) goto error;
+                    reader->state = JsonStreamState_String;
+                }
+
+                break;
+            }
+            case JsonStreamState_StringUnicode:
+            {
+                int digit = jsonStreamGetHexDigitValue(c);
+                if (digit < 0) goto error;
+
+                reader->unicode_codepoint = ((reader->unicode_codepoint << 4) | (u32)digit);
+                if (++(reader->unicode_digit_count) < 4) break;
+
+                if (!jsonStreamReaderAppendCodepoint(reader, reader->unicode_codepoint)) goto error;
+                reader->state = JsonStreamState_String;
+
+                break;
+            }
+            case JsonStreamState_Literal:
+                if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '.' || c == '+' || c == '-' || c == 'E')
+                {
+                    if (!stringBuilderAppendWithLength(&(reader->token), &c, 1)) goto error;
+                    break;
+                }
+
+                /* The literal ends here. Validate it, then reprocess the current character. */
+                if (!jsonStreamReaderFinishLiteral(reader)) goto end;
+                i--;
+
+                break;
+            case JsonStreamState_AfterValue:
+                if (jsonStreamIsWhitespace(c)) break;
+
+                if (c == ',')
+                {
+                    if (!reader->depth) goto error;
+
+                    if (reader->stack[reader->depth - 1].is_array)
+                    {
+                        if (!jsonStreamReaderSetArrayIndex(reader, reader->stack[reader->depth - 1].index + 1)) goto error;
+                        reader->state = JsonStreamState_Value;
+                    } else {
+                        reader->state = JsonStreamState_ObjectKey;
+                    }
+                } else
+                if (c == ']' || c == '}')
+                {
+                    if (!jsonStreamReaderCloseContainer(reader, c == ']')) goto end;
+                } else {
+                    goto error;
+                }
+
+                break;
+            case JsonStreamState_ObjectKey:
+                if (jsonStreamIsWhitespace(c)) break;
+
+                if (c == '}' && reader->container_start)
+                {
+                    reader->container_start = false;
+                    if (!jsonStreamReaderCloseContainer(reader, false)) goto end;
+                    break;
+                }
+
+                if (c != '"') goto error;
+
+                reader->container_start = false;
+                reader->is_key = true;
+                jsonStreamReaderResetToken(reader);
+                reader->state = JsonStreamState_String;
+
+                break;
+            case JsonStreamState_AfterKey:
+                if (jsonStreamIsWhitespace(c)) break;
+                if (c != ':') goto error;
+                reader->state = JsonStreamState_Value;
+                break;
+            case JsonStreamState_Done:
+                if (!jsonStreamIsWhitespace(c)) goto error;
+                break;
+            default:
+                goto error;
+        }
+    }
+
+    return true;
+
+error:
+    LOG_MSG_ERROR("JSON syntax error near \"%.*s\"!", (int)reader->path_length, reader->path);
+    reader->error = true;
+
+end:
+    return false;
+}
+
+bool jsonStreamReaderFinish(JsonStreamReader *reader)
+{
+    if (!reader || reader->error) return false;
+    if (reader->stopped) return true;
+
+    /* Top-level literals are only terminated by the end of the data. */
+    if (reader->state == JsonStreamState_Literal && !jsonStreamReaderFinishLiteral(reader)) return reader->stopped;
+
+    if (reader->state != JsonStreamState_Done)
+    {
+        LOG_MSG_ERROR("Incomplete JSON data!");
+        reader->error = true;
+        return false;
+    }
+
+    return true;
+}
+
+size_t jsonStreamReaderHttpWriteCallback(char *buffer, size_t size, size_t nitems, void *outstream)
+{
+    size_t total_size = (size * nitems);
+    return ((total_size && jsonStreamReaderFeed((JsonStreamReader*)outstream, buffer, total_size)) ? total_size : 0);
+}
+
+static bool jsonStreamReaderOpenContainer(JsonStreamReader *reader, bool is_array)
+{
+    if (reader->depth >= JSON_STREAM_MAX_DEPTH)
+    {
+        LOG_MSG_ERROR("Maximum JSON nesting depth exceeded!");
+        reader->error = true;
+        return false;
+    }
+
+    u8 idx = reader->depth++;
+    reader->stack[idx].is_array = is_array;
+    reader->stack[idx].path_length = reader->path_length;
+    reader->stack[idx].index = 0;
+
+    reader->container_start = true;
+
+    if (is_array)
+    {
+        if (!jsonStreamReaderSetArrayIndex(reader, 0))
+        {
+            reader->error = true;
+            return false;
+        }
+
+        reader->state = JsonStreamState_Value;
+    } else {
+        reader->state = JsonStreamState_ObjectKey;
+    }
+
+    return true;
+}
+
+static bool jsonStreamReaderCloseContainer(JsonStreamReader *reader, bool is_array)
+{
+    if (!reader->depth || reader->stack[reader->depth - 1].is_array != is_array)
+    {
+        LOG_MSG_ERROR("Mismatched JSON container terminator!");
+        reader->error = true;
+        return false;
+    }
+
+    /* Restore the path from the parent container. */
+    reader->path_length = reader->stack[--(reader->depth)].path_length;
+    reader->path[reader->path_length] = '\0';
+
+    reader->state = (reader->depth ? JsonStreamState_AfterValue : JsonStreamState_Done);
+
+    return true;
+}
+
+static bool jsonStreamReaderSetPathComponent(JsonStreamReader *reader, const char *component, size_t component_len)
+{
+    if (!reader->depth) return false;
+
+    /* Replace the last path component from the current container. */
+    size_t base_len = reader->stack[reader->depth - 1].path_length;
+    size_t sep_len = (base_len ? 1 : 0);
+
+    if ((base_len + sep_len + component_len) >= JSON_STREAM_MAX_PATH_LENGTH)
+    {
+        LOG_MSG_ERROR("Maximum JSON path length exceeded!");
+        return false;
+    }
+
+    if (sep_len) reader->path[base_len] = '/';
+    memcpy(reader->path + base_len + sep_len, component, component_len);
+
+    reader->path_length = (base_len + sep_len + component_len);
+    reader->path[reader->path_length] = '\0';
+
+    return true;
+}
+
+static bool jsonStreamReaderSetArrayIndex(JsonStreamReader *reader, u32 index)
+{
+    char index_str[0x10] = {0};
+    int index_len = snprintf(index_str, sizeof(index_str), "%u", index);
+
+    reader->stack[reader->depth - 1].index = index;
+
+    return jsonStreamReaderSetPathComponent(reader, index_str, (size_t)index_len);
+}
+
+static bool jsonStreamReaderAppendCodepoint(JsonStreamReader *reader, u32 codepoint)
+{
+    char utf8[4] = {0};
+    size_t utf8_len = 0;
+
+    /* Combine UTF-16 surrogate pairs. */
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+    {
+        if (reader->unicode_high_surrogate) return false;
+        reader->unicode_high_surrogate = codepoint;
+        return true;
+    }
+
+    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+    {
+        if (!reader->unicode_high_surrogate) return false;
+        codepoint = (0x10000 + ((reader->unicode_high_surrogate - 0xD800) << 10) + (codepoint - 0xDC00));
+        reader->unicode_high_surrogate = 0;
+    } else
+    if (reader->unicode_high_surrogate)
+    {
+        return false;
+    }
+
+    /* Encode codepoint as UTF-8. */
+    if (codepoint < 0x80)
+    {
+        utf8[utf8_len++] = (char)codepoint;
+    } else
+    if (codepoint < 0x800)
+    {
+        utf8[utf8_len++] = (char)(0xC0 | (codepoint >> 6));
+        utf8[utf8_len++] = (char)(0x80 | (codepoint & 0x3F));
+    } else
+    if (codepoint < 0x10000)
+    {
+        utf8[utf8_len++] = (char)(0xE0 | (codepoint >> 12));
+        utf8[utf8_len++] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[utf8_len++] = (char)(0x80 | (codepoint & 0x3F));
+    } else {
+        utf8[utf8_len++] = (char)(0xF0 | (codepoint >> 18));
+        utf8[utf8_len++] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+        utf8[utf8_len++] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[utf8_len++] = (char)(0x80 | (codepoint & 0x3F));
+    }
+
+    return stringBuilderAppendWithLength(&(reader->token), utf8, utf8_len);
+}
+
+static bool jsonStreamReaderFinishLiteral(JsonStreamReader *reader)
+{
+    const char *token = reader->token.data;
+    u8 type = JsonStreamValueType_Number;
+
+    if (!token) goto error;
+
+    if (!strcmp(token, "true") || !strcmp(token, "false"))
+    {
+        type = JsonStreamValueType_Boolean;
+    } else
+    if (!strcmp(token, "null"))
+    {
+        type = JsonStreamValueType_Null;
+    } else {
+        /* Make sure we're dealing with a valid number. */
+        char *end_ptr = NULL;
+        strtod(token, &end_ptr);
+        if (!end_ptr || *end_ptr || (*token != '-' && (*token < '0' || *token > '9'))) goto error;
+    }
+
+    return jsonStreamReaderEmitValue(reader, type);
+
+error:
+    LOG_MSG_ERROR("Invalid JSON literal \"%s\"!", token ? token : "");
+    reader->error = true;
+    return false;
+}
+
+static bool jsonStreamReaderEmitValue(JsonStreamReader *reader, u8 type)
+{
+    /* Empty strings don't allocate the token buffer. */
+    const char *value = (reader->token.data ? reader->token.data : "");
+
+    reader->state = (reader->depth ? JsonStreamState_AfterValue : JsonStreamState_Done);
+
+    if (reader->callback && !reader->callback(reader->user_data, reader->path, type, value, reader->token.length))
+    {
+        reader->stopped = true;
+        return false;
+    }
+
+    return true;
+}
@@ -23,11 +23,50 @@
 
 #if (LOG_LEVEL >= LOG_LEVEL_DEBUG) && (LOG_LEVEL < LOG_LEVEL_NONE)
 
+#define LOG_RING_MAX_RECORD_SIZE            (LOG_RING_SIZE / 4)
+#define LOG_RING_MAX_PAYLOAD_SIZE           (LOG_RING_MAX_RECORD_SIZE - sizeof(u64) - 1)
+
+#define LOG_RING_RECORD_SIZE(payload_size)  ALIGN_UP(sizeof(u64) + (payload_size) + 1, sizeof(u64))
+
+#define LOG_RING_RECORD_FLAG_DEFERRED       BIT(31) /* Set in the string length if the record starts with a LogRingDeferredInfo element. */
+
+#define LOG_RING_RECORD_HEADER(size, len)   (((u64)(len) << 32) | (u64)(size))
+#define LOG_RING_HEADER_RECORD_SIZE(hdr)    ((u32)(hdr))
+#define LOG_RING_HEADER_STR_LEN(hdr)        ((u32)((hdr) >> 32) & ~LOG_RING_RECORD_FLAG_DEFERRED)
+#define LOG_RING_HEADER_IS_DEFERRED(hdr)    (((u32)((hdr) >> 32) & LOG_RING_RECORD_FLAG_DEFERRED) != 0)
+
+#define LOG_DEFERRED_MSG_BUF_SIZE           0x400   /* Messages longer than this are formatted right away. */
+
+#define LOG_FLUSH_THREAD_PRIORITY           0x3F    /* Lowest preemptive priority. */
+
+/* Type definitions. */
+
+typedef enum {
+    LogFlushThreadState_None     = 0,
+    LogFlushThreadState_Starting = 1,
+    LogFlushThreadState_Running  = 2,
+    LogFlushThreadState_Failed   = 3
+} LogFlushThreadState;
+
+/* Used to hold everything needed to generate the log string prefix for a deferred log ring record, which is only done while draining. */
+/* File and function names are always string literals (__FILE__ / __PRETTY_FUNCTION__), so storing pointers to them is safe. */
+typedef struct {
+    struct timespec timestamp;
+    const char *file_name;
+    const char *func_name;
+    int line;
+    u8 level;
+    u8 reserved[3];
+} LogRingDeferredInfo;
+
+NXDT_ASSERT(LogRingDeferredInfo, 0x28);
+
 /* Global variables. */
 
-static Mutex g_logMutex = 0;
+static Mutex g_logMutex = 0, g_logLastMsgMutex = 0;
 
 static char *g_lastLogMsg = NULL;
+static const char *g_lastLogMsgFuncName = NULL;
 
 static FsFile g_logFile = {0};
 static s64 g_logFileOffset = 0;
@@ -35,6 +74,18 @@ static s64 g_logFileOffset = 0;
 static char *g_logBuffer = NULL;
 static size_t g_logBufferLength = 0;
 
+/* Multi-producer log ring. Each record starts with a 64-bit header (record size in the lower half, string length in the upper half), followed by a NULL-terminated string. */
+/* Writers reserve space by moving the head forward and publish their records by storing the header last. A zeroed header means the record isn't ready yet. */
+/* Records never wrap around: if there's not enough room left at the end of the ring, a padding record (string length set to zero) is used to skip it. */
+/* Only the consumer moves the tail forward, and it only does so while holding the log mutex. Consumed records are cleared before releasing their space. */
+static u8 g_logRing[LOG_RING_SIZE] __attribute__((aligned(8))) = {0};
+static u64 g_logRingHead = 0, g_logRingTail = 0;
+static u32 g_logRingDroppedCount = 0;
+
+static u8 g_logFlushThreadState = LogFlushThreadState_None;
+static Thread g_logFlushThread = {0};
+static UEvent g_logFlushThreadExitEvent = {0};
+
 static const char *g_logStrFormat = "[%d-%02d-%02d %02d:%02d:%02d.%09lu] %s %s|%d|%s -> ";
 static const char *g_logSessionSeparator = "________________________________________________________________\r\n";
 
@@ -47,8 +98,25 @@ static const char *g_logLevelNames[] = {
 
 /* Function prototypes. */
 
-static void _logWriteStringToLogFile(const char *src);
-static void _logWriteFormattedStringToLogFile(bool save, u8 level, const char *file_name, int line, const char *func_name, const char *fmt, va_list args);
+static void logWriteStringToLogRing(const char *src);
+static void logWriteFormattedStringToLogRing(bool save, u8 level, const char *file_name, int line, const char *func_name, const char *suffix, const char *fmt, va_list args);
+
+#if LOG_DEFERRED_FORMAT == 1
+static bool logWriteDeferredFormattedStringToLogRing(bool save, u8 level, const char *file_name, int line, const char *func_name, const struct timespec *now, const char *suffix, const char *fmt, va_list args);
+#endif
+
+static void logSetLastMessage(const char *func_name, char *msg);
+
+static void *logReserveLogRingRecord(size_t payload_size, u64 *out_pos);
+static void logCommitLogRingRecord(u64 pos, size_t payload_size, u32 str_len);
+static void logWriteOversizedString(const char *src, size_t src_len);
+
+static void logStartFlushThread(void);
+static void logFlushThreadFunc(void *arg);
+
+static void _logDrainLogRing(void);
+static void _logWriteDeferredRecordToLogFile(const LogRingDeferredInfo *info, const char *str, size_t str_len);
+static void _logWriteStringToLogFile(const char *src, size_t src_len);
 
 static void _logFlushLogFile(void);
 
@@ -61,14 +129,14 @@ static void logWriteStringToNxLink(const char *str);
 
 void logWriteStringToLogFile(const char *src)
 {
-    SCOPED_LOCK(&g_logMutex) _logWriteStringToLogFile(src);
+    logWriteStringToLogRing(src);
 }
 
 __attribute__((format(printf, 5, 6))) void logWriteFormattedStringToLogFile(u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...)
 {
     va_list args;
     va_start(args, fmt);
-    SCOPED_LOCK(&g_logMutex) _logWriteFormattedStringToLogFile(true, level, file_name, line, func_name, fmt, args);
+    logWriteFormattedStringToLogRing(true, level, file_name, line, func_name, NULL, fmt, args);
     va_end(args);
 }
 
@@ -157,16 +225,10 @@ __attribute__((format(printf, 7, 8))) void logWriteBinaryDataToLogFile(const voi
     utilsGenerateHexString(data_str, data_str_size, data, data_size, true);
     strcat(data_str, CRLF);
 
-    SCOPED_LOCK(&g_logMutex)
-    {
-        /* Write formatted string. */
-        va_start(args, fmt);
-        _logWriteFormattedStringToLogFile(false, level, file_name, line, func_name, fmt, args);
-        va_end(args);
-
-        /* Write hex string representation. */
-        _logWriteStringToLogFile(data_str);
-    }
+    /* Write formatted string + hex string representation as a single log record. */
+    va_start(args, fmt);
+    logWriteFormattedStringToLogRing(false, level, file_name, line, func_name, data_str, fmt, args);
+    va_end(args);
 
 end:
     if (data_str) free(data_str);
@@ -174,14 +236,30 @@ end:
 
 void logFlushLogFile(void)
 {
-    SCOPED_LOCK(&g_logMutex) _logFlushLogFile();
+    SCOPED_LOCK(&g_logMutex)
+    {
+        _logDrainLogRing();
+        _logFlushLogFile();
+    }
 }
 
 void logCloseLogFile(void)
 {
+    /* Stop the flush thread. We must not hold the log mutex while waiting for it to exit, since it locks it on its own. */
+    if (__atomic_load_n(&g_logFlushThreadState, __ATOMIC_ACQUIRE) == LogFlushThreadState_Running)
+    {
+        ueventSignal(&g_logFlushThreadExitEvent);
+        utilsJoinThread(&g_logFlushThread);
+        memset(&g_logFlushThread, 0, sizeof(Thread));
+    }
+
+    /* Let the flush thread be started again if more data is written afterwards. */
+    __atomic_store_n(&g_logFlushThreadState, LogFlushThreadState_None, __ATOMIC_RELEASE);
+
     SCOPED_LOCK(&g_logMutex)
     {
-        /* Flush log buffer. */
+        /* Write pending log ring records and flush log buffer. */
+        _logDrainLogRing();
         _logFlushLogFile();
 
         /* Close logfile. */
@@ -194,13 +272,6 @@ void logCloseLogFile(void)
             utilsCommitSdCardFileSystemChanges();
         }
 
-        /* Free last message bugger. */
-        if (g_lastLogMsg)
-        {
-            free(g_lastLogMsg);
-            g_lastLogMsg = NULL;
-        }
-
         /* Free log buffer. */
         if (g_logBuffer)
         {
@@ -211,17 +282,45 @@ void logCloseLogFile(void)
         /* Reset logfile offset. */
         g_logFileOffset = 0;
     }
+
+    SCOPED_LOCK(&g_logLastMsgMutex)
+    {
+        /* Free last message buffer. */
+        if (g_lastLogMsg)
+        {
+            free(g_lastLogMsg);
+            g_lastLogMsg = NULL;
+        }
+
+        g_lastLogMsgFuncName = NULL;
+    }
 }
 
 char *logGetLastMessage(void)
 {
-    char *ret = NULL;
+    char *msg = NULL, *ret = NULL;
+    const char *func_name = NULL;
+    char formatted_func_name[0x100] = {0};
+    size_t ret_size = 0;
 
-    SCOPED_LOCK(&g_logMutex)
+    SCOPED_LOCK(&g_logLastMsgMutex)
     {
-        if (g_lastLogMsg) ret = strdup(g_lastLogMsg);
+        if (!g_lastLogMsg) break;
+        msg = strdup(g_lastLogMsg);
+        func_name = g_lastLogMsgFuncName;
     }
 
+    if (!msg) return NULL;
+
+    /* The function name is only formatted here, so logging calls don't have to. */
+    logFormatFunctionName(func_name, formatted_func_name, MAX_ELEMENTS(formatted_func_name));
+
+    ret_size = (strlen(formatted_func_name) + strlen(msg) + 3);
+    ret = calloc(ret_size, sizeof(char));
+    if (ret) snprintf(ret, ret_size, "%s: %s", formatted_func_name, msg);
+
+    free(msg);
+
     return ret;
 }
 
@@ -239,82 +338,62 @@ void logControlMutex(bool lock)
     }
 }
 
-static void _logWriteStringToLogFile(const char *src)
+static void logWriteStringToLogRing(const char *src)
 {
-    /* Make sure we have allocated memory for the log buffer and opened the logfile. */
-    if (!src || !*src || !logAllocateLogBuffer() || !logOpenLogFile()) return;
-
-    Result rc = 0;
-    size_t src_len = strlen(src), tmp_len = 0;
-
-    /* Check if the formatted string length is lower than the log buffer size. */
-    if (src_len < LOG_BUF_SIZE)
-    {
-        /* Flush log buffer contents (if needed). */
-        if ((g_logBufferLength + src_len) >= LOG_BUF_SIZE)
-        {
-            _logFlushLogFile();
-            if (g_logBufferLength) return;
-        }
+    if (!src || !*src) return;
 
-        /* Copy string into the log buffer. */
-        strcpy(g_logBuffer + g_logBufferLength, src);
-        g_logBufferLength += src_len;
-    } else {
-        /* Flush log buffer. */
-        _logFlushLogFile();
-        if (g_logBufferLength) return;
+    size_t src_len = strlen(src);
+    u64 record_pos = 0;
+    char *record_str = NULL;
 
-        /* Write string data until it no longer exceeds the log buffer size. */
-        while(src_len >= LOG_BUF_SIZE)
-        {
-            rc = fsFileWrite(&g_logFile, g_logFileOffset, src + tmp_len, LOG_BUF_SIZE, FsWriteOption_Flush);
-            if (R_FAILED(rc)) return;
+    logStartFlushThread();
 
-            g_logFileOffset += LOG_BUF_SIZE;
-            tmp_len += LOG_BUF_SIZE;
-            src_len -= LOG_BUF_SIZE;
-        }
-
-        /* Copy any remaining data from the string into the log buffer. */
-        if (src_len)
-        {
-            strcpy(g_logBuffer, src + tmp_len);
-            g_logBufferLength = src_len;
-        }
+    /* Write the string on our own if it doesn't fit in a single log ring record. */
+    if (src_len > LOG_RING_MAX_PAYLOAD_SIZE)
+    {
+        logWriteOversizedString(src, src_len);
+        return;
     }
 
-    /* Write data to nxlink. */
-    logWriteStringToNxLink(src);
+    /* Reserve log ring record. */
+    record_str = logReserveLogRingRecord(src_len, &record_pos);
+    if (!record_str) return;
 
-#if LOG_FORCE_FLUSH == 1
-    /* Flush log buffer. */
-    _logFlushLogFile();
-#endif
+    /* Copy string and publish the record. */
+    memcpy(record_str, src, src_len + 1);
+    logCommitLogRingRecord(record_pos, src_len, (u32)src_len);
 }
 
-static void _logWriteFormattedStringToLogFile(bool save, u8 level, const char *file_name, int line, const char *func_name, const char *fmt, va_list args)
+static void logWriteFormattedStringToLogRing(bool save, u8 level, const char *file_name, int line, const char *func_name, const char *suffix, const char *fmt, va_list args)
 {
-    /* Make sure we have allocated memory for the log buffer and opened the logfile. */
-    if (level < LOG_LEVEL || !file_name || !*file_name || !func_name || !*func_name || !fmt || !*fmt || !logAllocateLogBuffer() || !logOpenLogFile()) return;
+    if (level < LOG_LEVEL || !file_name || !*file_name || !func_name || !*func_name || !fmt || !*fmt) return;
 
-    Result rc = 0;
+    va_list args_copy;
 
     int str1_len = 0, str2_len = 0;
-    size_t log_str_len = 0;
+    size_t suffix_len = 0, log_str_len = 0;
 
-    char *tmp_str = NULL;
-    size_t tmp_len = 0;
+    char *log_str = NULL, *tmp_str = NULL;
+    u64 record_pos = 0;
 
     struct tm ts = {0};
     struct timespec now = {0};
 
     char formatted_func_name[0x100] = {0};
-    logFormatFunctionName(func_name, formatted_func_name, MAX_ELEMENTS(formatted_func_name));
+
+    logStartFlushThread();
 
     /* Get current time with nanosecond precision. */
     clock_gettime(CLOCK_REALTIME, &now);
 
+#if LOG_DEFERRED_FORMAT == 1
+    /* Try to defer log string prefix generation until the record is written to the logfile. */
+    if (logWriteDeferredFormattedStringToLogRing(save, level, file_name, line, func_name, &now, suffix, fmt, args)) return;
+#endif
+
+    suffix_len = (suffix ? strlen(suffix) : 0);
+    logFormatFunctionName(func_name, formatted_func_name, MAX_ELEMENTS(formatted_func_name));
+
     /* Get local time. */
     localtime_r(&(now.tv_sec), &ts);
     ts.tm_year += 1900;
@@ -324,91 +403,343 @@ static void _logWriteFormattedStringToLogFile(bool save, u8 level, const char *f
     str1_len = snprintf(NULL, 0, g_logStrFormat, ts.tm_year, ts.tm_mon, ts.tm_mday, ts.tm_hour, ts.tm_min, ts.tm_sec, now.tv_nsec, g_logLevelNames[level], file_name, line, formatted_func_name);
     if (str1_len <= 0) return;
 
-    str2_len = vsnprintf(NULL, 0, fmt, args);
+    va_copy(args_copy, args);
+    str2_len = vsnprintf(NULL, 0, fmt, args_copy);
+    va_end(args_copy);
     if (str2_len <= 0) return;
 
-    log_str_len = (size_t)(str1_len + str2_len + 2);
+    log_str_len = ((size_t)(str1_len + str2_len) + 2 + suffix_len);
 
     /* Save log message (if needed). */
     if (save)
+    {
+        tmp_str = calloc((size_t)str2_len + 1, sizeof(char));
+        if (tmp_str)
+        {
+            va_copy(args_copy, args);
+            vsprintf(tmp_str, fmt, args_copy);
+            va_end(args_copy);
+        }
+
+        logSetLastMessage(func_name, tmp_str);
+        tmp_str = NULL;
+    }
+
+    if (log_str_len <= LOG_RING_MAX_PAYLOAD_SIZE)
+    {
+        /* Format the string right into a log ring record. */
+        log_str = logReserveLogRingRecord(log_str_len, &record_pos);
+        if (!log_str) return;
+    } else {
+        /* Allocate memory for a temporary buffer. This will hold the formatted string. */
+        tmp_str = calloc(log_str_len + 1, sizeof(char));
+        if (!tmp_str) return;
+
+        log_str = tmp_str;
+    }
+
+    /* Generate formatted string. */
+    sprintf(log_str, g_logStrFormat, ts.tm_year, ts.tm_mon, ts.tm_mday, ts.tm_hour, ts.tm_min, ts.tm_sec, now.tv_nsec, g_logLevelNames[level], file_name, line, formatted_func_name);
+    vsprintf(log_str + (size_t)str1_len, fmt, args);
+    memcpy(log_str + (size_t)(str1_len + str2_len), CRLF, 2);
+    if (suffix_len) memcpy(log_str + (size_t)(str1_len + str2_len) + 2, suffix, suffix_len);
+    log_str[log_str_len] = '\0';
+
+    if (tmp_str)
+    {
+        logWriteOversizedString(tmp_str, log_str_len);
+        free(tmp_str);
+    } else {
+        logCommitLogRingRecord(record_pos, log_str_len, (u32)log_str_len);
+    }
+}
+
+#if LOG_DEFERRED_FORMAT == 1
+static bool logWriteDeferredFormattedStringToLogRing(bool save, u8 level, const char *file_name, int line, const char *func_name, const struct timespec *now, const char *suffix, const char *fmt, va_list args)
+{
+    va_list args_copy;
+
+    char msg[LOG_DEFERRED_MSG_BUF_SIZE] = {0}, *str = NULL, *tmp_msg = NULL;
+    int msg_len = 0;
+    size_t suffix_len = (suffix ? strlen(suffix) : 0), str_len = 0, payload_size = 0;
+
+    LogRingDeferredInfo *info = NULL;
+    u64 record_pos = 0;
+
+    /* Format the message right away, using a single pass. Arguments may point to data that won't be around by the time the record is written to the logfile. */
+    va_copy(args_copy, args);
+    msg_len = vsnprintf(msg, sizeof(msg), fmt, args_copy);
+    va_end(args_copy);
+
+    if (msg_len <= 0) return true;
+
+    /* Let the caller format the whole string if the message doesn't fit in our buffer, or if the record would be too big. */
+    str_len = ((size_t)msg_len + 2 + suffix_len);
+    payload_size = (sizeof(LogRingDeferredInfo) + str_len);
+    if ((size_t)msg_len >= sizeof(msg) || payload_size > LOG_RING_MAX_PAYLOAD_SIZE) return false;
+
+    /* Save log message (if needed). */
+    if (save)
+    {
+        tmp_msg = strdup(msg);
+        logSetLastMessage(func_name, tmp_msg);
+    }
+
+    /* Reserve log ring record. */
+    info = logReserveLogRingRecord(payload_size, &record_pos);
+    if (!info) return true;
+
+    /* Fill record. */
+    info->timestamp = *now;
+    info->file_name = file_name;
+    info->func_name = func_name;
+    info->line = line;
+    info->level = level;
+
+    str = (char*)(info + 1);
+    memcpy(str, msg, (size_t)msg_len);
+    memcpy(str + msg_len, CRLF, 2);
+    if (suffix_len) memcpy(str + msg_len + 2, suffix, suffix_len);
+    str[str_len] = '\0';
+
+    /* Publish the record. */
+    logCommitLogRingRecord(record_pos, payload_size, (u32)str_len | LOG_RING_RECORD_FLAG_DEFERRED);
+
+    return true;
+}
+#endif
+
+static void logSetLastMessage(const char *func_name, char *msg)
+{
+    SCOPED_LOCK(&g_logLastMsgMutex)
     {
         if (g_lastLogMsg) free(g_lastLogMsg);
+        g_lastLogMsg = msg;
+        g_lastLogMsgFuncName = (msg ? func_name : NULL);
+    }
+}
 
-        tmp_len = (strlen(formatted_func_name) + 2);
+static void *logReserveLogRingRecord(size_t payload_size, u64 *out_pos)
+{
+    u64 record_size = LOG_RING_RECORD_SIZE(payload_size), head = __atomic_load_n(&g_logRingHead, __ATOMIC_RELAXED), offset = 0, padding_size = 0;
 
-        g_lastLogMsg = calloc(tmp_len + (size_t)str2_len + 1, sizeof(char));
-        if (g_lastLogMsg)
+    do {
+        /* Skip the rest of the ring if the record doesn't fit before its end. */
+        offset = (head & (LOG_RING_SIZE - 1));
+        padding_size = ((LOG_RING_SIZE - offset) < record_size ? (LOG_RING_SIZE - offset) : 0);
+
+        /* Drop the message if the ring is full. We never wait for the consumer. */
+        if ((head + padding_size + record_size - __atomic_load_n(&g_logRingTail, __ATOMIC_ACQUIRE)) > LOG_RING_SIZE)
         {
-            sprintf(g_lastLogMsg, "%s: ", formatted_func_name);
-            vsprintf(g_lastLogMsg + tmp_len, fmt, args);
+            __atomic_add_fetch(&g_logRingDroppedCount, 1, __ATOMIC_RELAXED);
+            return NULL;
         }
+    } while(!__atomic_compare_exchange_n(&g_logRingHead, &head, head + padding_size + record_size, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    /* Publish the padding record right away, if needed. */
+    if (padding_size) __atomic_store_n((u64*)(g_logRing + offset), LOG_RING_RECORD_HEADER(padding_size, 0), __ATOMIC_RELEASE);
+
+    *out_pos = (head + padding_size);
+
+    return (g_logRing + (*out_pos & (LOG_RING_SIZE - 1)) + sizeof(u64));
+}
 
-        tmp_len = 0;
+static void logCommitLogRingRecord(u64 pos, size_t payload_size, u32 str_len)
+{
+    /* Publish the record by storing its header. */
+    __atomic_store_n((u64*)(g_logRing + (pos & (LOG_RING_SIZE - 1))), LOG_RING_RECORD_HEADER(LOG_RING_RECORD_SIZE(payload_size), str_len), __ATOMIC_RELEASE);
+
+#if LOG_FORCE_FLUSH == 0
+    /* Only write the data on our own if the flush thread couldn't be started. */
+    if (__atomic_load_n(&g_logFlushThreadState, __ATOMIC_ACQUIRE) != LogFlushThreadState_Failed) return;
+#endif
+
+    /* Don't deadlock if the current thread is holding the log mutex. The record will be written once it's unlocked. */
+    if (!mutexIsLockedByCurrentThread(&g_logMutex)) logFlushLogFile();
+}
+
+static void logWriteOversizedString(const char *src, size_t src_len)
+{
+    if (mutexIsLockedByCurrentThread(&g_logMutex))
+    {
+        __atomic_add_fetch(&g_logRingDroppedCount, 1, __ATOMIC_RELAXED);
+        return;
     }
 
-    /* Check if the formatted string length is less than the log buffer size. */
-    if (log_str_len < LOG_BUF_SIZE)
+    SCOPED_LOCK(&g_logMutex)
+    {
+        /* Write pending log ring records first to preserve message order as much as possible. */
+        _logDrainLogRing();
+        _logWriteStringToLogFile(src, src_len);
+    }
+}
+
+static void logStartFlushThread(void)
+{
+    u8 state = LogFlushThreadState_None;
+    bool success = false;
+
+    /* Only a single caller gets to start the flush thread. Messages logged in the meantime go straight to the log ring. */
+    if (!__atomic_compare_exchange_n(&g_logFlushThreadState, &state, LogFlushThreadState_Starting, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) return;
+
+    /* Create user-mode exit event. */
+    ueventCreate(&g_logFlushThreadExitEvent, false);
+
+    /* Create flush thread using a low priority, so it doesn't get in the way of other threads. */
+    success = utilsCreateThreadWithPriority(&g_logFlushThread, logFlushThreadFunc, NULL, -2, LOG_FLUSH_THREAD_PRIORITY);
+
+    __atomic_store_n(&g_logFlushThreadState, success ? LogFlushThreadState_Running : LogFlushThreadState_Failed, __ATOMIC_RELEASE);
+}
+
+static void logFlushThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    Waiter exit_event_waiter = waiterForUEvent(&g_logFlushThreadExitEvent);
+    bool exit_thread = false;
+
+    while(!exit_thread)
+    {
+        /* Wait until the flush interval elapses or until we're asked to exit. */
+        exit_thread = R_SUCCEEDED(waitSingle(exit_event_waiter, LOG_FLUSH_INTERVAL));
+
+        /* Write pending log ring records. This blocks while other threads hold the log mutex through logControlMutex(). */
+        SCOPED_LOCK(&g_logMutex) _logDrainLogRing();
+    }
+
+    threadExit();
+}
+
+static void _logDrainLogRing(void)
+{
+    u64 tail = __atomic_load_n(&g_logRingTail, __ATOMIC_RELAXED), *record = NULL, header = 0;
+    u32 record_size = 0, str_len = 0, dropped_count = 0;
+    char dropped_str[0x80] = {0};
+    bool written = false;
+
+    /* Bail out early if there's nothing to write. */
+    if (tail == __atomic_load_n(&g_logRingHead, __ATOMIC_ACQUIRE) && !__atomic_load_n(&g_logRingDroppedCount, __ATOMIC_RELAXED)) return;
+
+    /* Make sure we have allocated memory for the log buffer and opened the logfile. */
+    if (!logAllocateLogBuffer() || !logOpenLogFile()) return;
+
+    while(true)
+    {
+        /* Stop at the first record that hasn't been published yet. */
+        record = (u64*)(g_logRing + (tail & (LOG_RING_SIZE - 1)));
+        header = __atomic_load_n(record, __ATOMIC_ACQUIRE);
+        if (!header) break;
+
+        record_size = LOG_RING_HEADER_RECORD_SIZE(header);
+        str_len = LOG_RING_HEADER_STR_LEN(header);
+
+        /* Write string (padding records don't have one). */
+        if (str_len)
+        {
+            if (LOG_RING_HEADER_IS_DEFERRED(header))
+            {
+                const LogRingDeferredInfo *info = (const LogRingDeferredInfo*)(record + 1);
+                _logWriteDeferredRecordToLogFile(info, (const char*)(info + 1), str_len);
+            } else {
+                _logWriteStringToLogFile((const char*)(record + 1), str_len);
+            }
+
+            written = true;
+        }
+
+        /* Clear record and release its space. */
+        memset(record, 0, record_size);
+        tail += record_size;
+        __atomic_store_n(&g_logRingTail, tail, __ATOMIC_RELEASE);
+    }
+
+    /* Report dropped messages. */
+    dropped_count = __atomic_exchange_n(&g_logRingDroppedCount, 0, __ATOMIC_RELAXED);
+    if (dropped_count)
+    {
+        snprintf(dropped_str, sizeof(dropped_str), "%u log message(s) dropped (log ring full)." CRLF, dropped_count);
+        _logWriteStringToLogFile(dropped_str, strlen(dropped_str));
+        written = true;
+    }
+
+    /* Flush log buffer. */
+    if (written) _logFlushLogFile();
+}
+
+static void _logWriteDeferredRecordToLogFile(const LogRingDeferredInfo *info, const char *str, size_t str_len)
+{
+    struct tm ts = {0};
+    char formatted_func_name[0x100] = {0}, prefix[0x300] = {0};
+    int prefix_len = 0;
+
+    logFormatFunctionName(info->func_name, formatted_func_name, MAX_ELEMENTS(formatted_func_name));
+
+    /* Get local time. */
+    localtime_r(&(info->timestamp.tv_sec), &ts);
+    ts.tm_year += 1900;
+    ts.tm_mon++;
+
+    /* Generate log string prefix. */
+    prefix_len = snprintf(prefix, sizeof(prefix), g_logStrFormat, ts.tm_year, ts.tm_mon, ts.tm_mday, ts.tm_hour, ts.tm_min, ts.tm_sec, info->timestamp.tv_nsec, g_logLevelNames[info->level], info->file_name, info->line, formatted_func_name);
+    if (prefix_len <= 0) return;
+
+    _logWriteStringToLogFile(prefix, MIN((size_t)prefix_len, sizeof(prefix) - 1));
+    _logWriteStringToLogFile(str, str_len);
+}
+
+static void _logWriteStringToLogFile(const char *src, size_t src_len)
+{
+    if (!src || !*src || !src_len || !logAllocateLogBuffer() || !logOpenLogFile()) return;
+
+    Result rc = 0;
+    const char *src_ptr = src;
+
+    /* Check if the string length is lower than the log buffer size. */
+    if (src_len < LOG_BUF_SIZE)
     {
         /* Flush log buffer contents (if needed). */
-        if ((g_logBufferLength + log_str_len) >= LOG_BUF_SIZE)
+        if ((g_logBufferLength + src_len) >= LOG_BUF_SIZE)
         {
             _logFlushLogFile();
             if (g_logBufferLength) return;
         }
 
-        /* Nice and easy string formatting using the log buffer. */
-        sprintf(g_logBuffer + g_logBufferLength, g_logStrFormat, ts.tm_year, ts.tm_mon, ts.tm_mday, ts.tm_hour, ts.tm_min, ts.tm_sec, now.tv_nsec, g_logLevelNames[level], file_name, line, formatted_func_name);
-        vsprintf(g_logBuffer + g_logBufferLength + (size_t)str1_len, fmt, args);
-        strcat(g_logBuffer, CRLF);
-
-        /* Write data to nxlink. */
-        logWriteStringToNxLink(g_logBuffer + g_logBufferLength);
-
-        /* Update log buffer length. */
-        g_logBufferLength += log_str_len;
+        /* Copy string into the log buffer. */
+        memcpy(g_logBuffer + g_logBufferLength, src, src_len);
+        g_logBufferLength += src_len;
+        g_logBuffer[g_logBufferLength] = '\0';
     } else {
         /* Flush log buffer. */
         _logFlushLogFile();
         if (g_logBufferLength) return;
 
-        /* Allocate memory for a temporary buffer. This will hold the formatted string. */
-        tmp_str = calloc(log_str_len + 1, sizeof(char));
-        if (!tmp_str) return;
-
-        /* Generate formatted string. */
-        sprintf(tmp_str, g_logStrFormat, ts.tm_year, ts.tm_mon, ts.tm_mday, ts.tm_hour, ts.tm_min, ts.tm_sec, now.tv_nsec, g_logLevelNames[level], file_name, line, formatted_func_name);
-        vsprintf(tmp_str + (size_t)str1_len, fmt, args);
-        strcat(tmp_str, CRLF);
-
-        /* Write data to nxlink. */
-        logWriteStringToNxLink(tmp_str);
-
-        /* Write formatted string data until it no longer exceeds the log buffer size. */
-        while(log_str_len >= LOG_BUF_SIZE)
+        /* Write string data until it no longer exceeds the log buffer size. */
+        while(src_len >= LOG_BUF_SIZE)
         {
-            rc = fsFileWrite(&g_logFile, g_logFileOffset, tmp_str + tmp_len, LOG_BUF_SIZE, FsWriteOption_Flush);
-            if (R_FAILED(rc)) goto end;
+            rc = fsFileWrite(&g_logFile, g_logFileOffset, src_ptr, LOG_BUF_SIZE, FsWriteOption_Flush);
+            if (R_FAILED(rc)) return;
 
             g_logFileOffset += LOG_BUF_SIZE;
-            tmp_len += LOG_BUF_SIZE;
-            log_str_len -= LOG_BUF_SIZE;
+            src_ptr += LOG_BUF_SIZE;
+            src_len -= LOG_BUF_SIZE;
         }
 
-        /* Copy any remaining data from the formatted string into the log buffer. */
-        if (log_str_len)
+        /* Copy any remaining data from the string into the log buffer. */
+        if (src_len)
         {
-            strcpy(g_logBuffer, tmp_str + tmp_len);
-            g_logBufferLength = log_str_len;
+            memcpy(g_logBuffer, src_ptr, src_len);
+            g_logBufferLength = src_len;
+            g_logBuffer[g_logBufferLength] = '\0';
         }
     }
 
+    /* Write data to nxlink. */
+    logWriteStringToNxLink(src);
+
 #if LOG_FORCE_FLUSH == 1
     /* Flush log buffer. */
     _logFlushLogFile();
 #endif
-
-end:
-    if (tmp_str) free(tmp_str);
 }
 
 static void _logFlushLogFile(void)
@@ -0,0 +1,211 @@
+/*
+ * nxdt_stats.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <core/nxdt_utils.h>
+
+/* Type definitions. */
+
+typedef struct {
+    atomic_uint_fast64_t call_count;
+    atomic_uint_fast64_t byte_count;
+} StatsAtomicCounter;
+
+typedef struct {
+    atomic_uint_fast64_t bucket_count[STATS_LATENCY_BUCKET_COUNT];
+    atomic_uint_fast64_t call_count;
+    atomic_uint_fast64_t total_ns;
+    atomic_uint_fast64_t max_ns;
+} StatsAtomicLatencyHistogram;
+
+typedef struct {
+    const char *name;
+    u8 counter_type;    ///< StatsCounterType. Used to calculate the average call size.
+} StatsLatencyTypeInfo;
+
+/* Global variables. */
+
+static StatsAtomicCounter g_statsCounters[StatsCounterType_Count] = {0};
+static StatsAtomicLatencyHistogram g_statsLatencyHistograms[StatsLatencyType_Count] = {0};
+static atomic_uint_fast64_t g_statsResetTick = 0;
+
+static const char *g_statsCounterNames[StatsCounterType_Count] = {
+    [StatsCounterType_GameCardRead] = "Gamecard storage read",
+    [StatsCounterType_NcmRead]      = "NCM content read",
+    [StatsCounterType_BisRead]      = "BIS storage read",
+    [StatsCounterType_AesXts]       = "AES-128-XTS",
+    [StatsCounterType_AesCtr]       = "AES-128-CTR",
+    [StatsCounterType_Sha256]       = "SHA-256",
+    [StatsCounterType_Sha3]         = "SHA3",
+    [StatsCounterType_Crc32]        = "CRC32",
+    [StatsCounterType_UsbTransfer]  = "USB transfer",
+    [StatsCounterType_SdCardWrite]  = "SD card write",
+    [StatsCounterType_UmsWrite]     = "UMS write"
+};
+
+static const StatsLatencyTypeInfo g_statsLatencyTypeInfo[StatsLatencyType_Count] = {
+    [StatsLatencyType_GameCardRead] = { "Gamecard storage read", StatsCounterType_GameCardRead },
+    [StatsLatencyType_NcmRead]      = { "NCM content read",      StatsCounterType_NcmRead      },
+    [StatsLatencyType_BisRead]      = { "BIS storage read",      StatsCounterType_BisRead      },
+    [StatsLatencyType_EsCall]       = { "ES call",               StatsCounterType_Count        }
+};
+
+/* Function prototypes. */
+
+NX_INLINE u8 statsGetLatencyBucket(u64 elapsed_ns);
+
+void statsAddCounter(u8 type, u64 size)
+{
+    if (type >= StatsCounterType_Count) return;
+
+    /* Relaxed ordering is enough: counters are only ever read as a whole by the UI, and they don't guard any other data. */
+    StatsAtomicCounter *counter = &(g_statsCounters[type]);
+    atomic_fetch_add_explicit(&(counter->call_count), 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&(counter->byte_count), size, memory_order_relaxed);
+}
+
+void statsRecordLatency(u8 type, u64 start_tick)
+{
+    if (type >= StatsLatencyType_Count) return;
+
+    StatsAtomicLatencyHistogram *histogram = &(g_statsLatencyHistograms[type]);
+    u64 elapsed_ns = armTicksToNs(armGetSystemTick() - start_tick);
+
+    atomic_fetch_add_explicit(&(histogram->bucket_count[statsGetLatencyBucket(elapsed_ns)]), 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&(histogram->call_count), 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&(histogram->total_ns), elapsed_ns, memory_order_relaxed);
+
+    /* Update max latency. Retry if another thread updated it in the meantime. */
+    u64 max_ns = atomic_load_explicit(&(histogram->max_ns), memory_order_relaxed);
+    while(elapsed_ns > max_ns && !atomic_compare_exchange_weak_explicit(&(histogram->max_ns), &max_ns, elapsed_ns, memory_order_relaxed, memory_order_relaxed));
+}
+
+void statsGetLatencyHistogram(u8 type, StatsLatencyHistogram *out_histogram)
+{
+    if (type >= StatsLatencyType_Count || !out_histogram) return;
+
+    StatsAtomicLatencyHistogram *histogram = &(g_statsLatencyHistograms[type]);
+
+    for(u8 i = 0; i < STATS_LATENCY_BUCKET_COUNT; i++) out_histogram->bucket_count[i] = atomic_load_explicit(&(histogram->bucket_count[i]), memory_order_relaxed);
+
+    out_histogram->call_count = atomic_load_explicit(&(histogram->call_count), memory_order_relaxed);
+    out_histogram->total_ns = atomic_load_explicit(&(histogram->total_ns), memory_order_relaxed);
+    out_histogram->max_ns = atomic_load_explicit(&(histogram->max_ns), memory_order_relaxed);
+}
+
+const char *statsGetCounterName(u8 type)
+{
+    return (type < StatsCounterType_Count ? g_statsCounterNames[type] : NULL);
+}
+
+const char *statsGetLatencyName(u8 type)
+{
+    return (type < StatsLatencyType_Count ? g_statsLatencyTypeInfo[type].name : NULL);
+}
+
+void statsLogLatencyHistograms(void)
+{
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+    StatsSnapshot snapshot = {0};
+    statsGetSnapshot(&snapshot);
+
+    for(u8 i = 0; i < StatsLatencyType_Count; i++)
+    {
+        const StatsLatencyTypeInfo *info = &(g_statsLatencyTypeInfo[i]);
+        StatsLatencyHistogram histogram = {0};
+        char buckets_str[0x300] = {0};
+        size_t buckets_str_len = 0;
+
+        statsGetLatencyHistogram(i, &histogram);
+        if (!histogram.call_count) continue;
+
+        /* Only list non-empty buckets, using their upper bound as a label. */
+        for(u8 j = 0; j < STATS_LATENCY_BUCKET_COUNT && buckets_str_len < sizeof(buckets_str); j++)
+        {
+            if (!histogram.bucket_count[j]) continue;
+
+            const char *prefix = (j == (STATS_LATENCY_BUCKET_COUNT - 1) ? ">=" : "<");
+            u64 bound_us = (1UL << (j == (STATS_LATENCY_BUCKET_COUNT - 1) ? (j - 1) : j));
+
+            buckets_str_len += (size_t)snprintf(buckets_str + buckets_str_len, sizeof(buckets_str) - buckets_str_len, "%s%s%lu us: %lu", buckets_str_len ? ", " : "", \
+                                                prefix, bound_us, histogram.bucket_count[j]);
+        }
+
+        /* Calls from this type may include more than a single counter (e.g. retries), but that's good enough for an average. */
+        u64 avg_size = 0;
+        if (info->counter_type < StatsCounterType_Count)
+        {
+            const StatsCounter *counter = &(snapshot.counters[info->counter_type]);
+            avg_size = (counter->call_count ? (counter->byte_count / counter->call_count) : 0);
+        }
+
+        LOG_MSG_INFO("%s latency: %lu call(s), %lu us average, %lu us max, 0x%lX bytes per call on average. Buckets: %s.", info->name, histogram.call_count, \
+                     (histogram.total_ns / histogram.call_count) / 1000, histogram.max_ns / 1000, avg_size, buckets_str);
+    }
+#endif  /* LOG_LEVEL <= LOG_LEVEL_INFO */
+}
+
+void statsGetSnapshot(StatsSnapshot *out_snapshot)
+{
+    if (!out_snapshot) return;
+
+    for(u8 i = 0; i < StatsCounterType_Count; i++)
+    {
+        StatsAtomicCounter *counter = &(g_statsCounters[i]);
+        out_snapshot->counters[i].call_count = atomic_load_explicit(&(counter->call_count), memory_order_relaxed);
+        out_snapshot->counters[i].byte_count = atomic_load_explicit(&(counter->byte_count), memory_order_relaxed);
+    }
+
+    u64 reset_tick = atomic_load_explicit(&g_statsResetTick, memory_order_relaxed);
+    out_snapshot->elapsed_ns = (reset_tick ? armTicksToNs(armGetSystemTick() - reset_tick) : 0);
+}
+
+void statsResetCounters(void)
+{
+    for(u8 i = 0; i < StatsCounterType_Count; i++)
+    {
+        StatsAtomicCounter *counter = &(g_statsCounters[i]);
+        atomic_store_explicit(&(counter->call_count), 0, memory_order_relaxed);
+        atomic_store_explicit(&(counter->byte_count), 0, memory_order_relaxed);
+    }
+
+    for(u8 i = 0; i < StatsLatencyType_Count; i++)
+    {
+        StatsAtomicLatencyHistogram *histogram = &(g_statsLatencyHistograms[i]);
+
+        for(u8 j = 0; j < STATS_LATENCY_BUCKET_COUNT; j++) atomic_store_explicit(&(histogram->bucket_count[j]), 0, memory_order_relaxed);
+
+        atomic_store_explicit(&(histogram->call_count), 0, memory_order_relaxed);
+        atomic_store_explicit(&(histogram->total_ns), 0, memory_order_relaxed);
+        atomic_store_explicit(&(histogram->max_ns), 0, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&g_statsResetTick, armGetSystemTick(), memory_order_relaxed);
+}
+
+NX_INLINE u8 statsGetLatencyBucket(u64 elapsed_ns)
+{
+    u64 elapsed_us = (elapsed_ns / 1000);
+    if (!elapsed_us) return 0;
+
+    /* Bucket N holds [2^(N-1), 2^N) us, which matches the bit width of the elapsed time. */
+    u8 bucket = (u8)(64 - __builtin_clzll(elapsed_us));
+    return MIN(bucket, (u8)(STATS_LATENCY_BUCKET_COUNT - 1));
+}
@@ -0,0 +1,150 @@
+/*
+ * nxdt_trace.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <core/nxdt_utils.h>
+
+#if TRACE_ENABLED == 1
+
+#define TRACE_EVENT_COUNT           0x10000     /* 2 MiB worth of events. Must be a power of two. */
+#define TRACE_CRASH_EVENT_COUNT     0x1000      /* Number of most recent events written by traceWriteCrashTraceFile(). */
+
+/* Type definitions. */
+
+/* Holds a single complete event. End ticks are stored last, so a zero value means the event isn't ready yet. */
+typedef struct {
+    const char *name;
+    u64 start_tick;
+    u64 end_tick;
+    u32 thread_handle;
+    u8 reserved[0x4];
+} TraceEvent;
+
+NXDT_ASSERT(TraceEvent, 0x20);
+
+/* Global variables. */
+
+static Mutex g_traceMutex = 0;
+
+/* Ring buffer. Once it wraps around, the oldest events are overwritten, so the most recent ones are always available. */
+static TraceEvent g_traceEvents[TRACE_EVENT_COUNT] = {0};
+static u64 g_traceEventCount = 0;
+
+/* Function prototypes. */
+
+static u32 traceWriteEvents(const char *path, u64 event_count, u64 max_event_count);
+
+void traceEndSpan(TraceSpan *span)
+{
+    u64 end_tick = armGetSystemTick(), idx = 0;
+    TraceEvent *event = NULL;
+
+    if (!span || !span->name) return;
+
+    /* Reserve an event slot. We never wait for anything here. */
+    idx = __atomic_fetch_add(&g_traceEventCount, 1, __ATOMIC_RELAXED);
+
+    /* Fill event. The slot may still hold an older event, so it's marked as not ready first. */
+    event = &(g_traceEvents[idx & (TRACE_EVENT_COUNT - 1)]);
+    __atomic_store_n(&(event->end_tick), 0, __ATOMIC_RELAXED);
+    event->name = span->name;
+    event->start_tick = span->start_tick;
+    event->thread_handle = threadGetCurHandle();
+    __atomic_store_n(&(event->end_tick), end_tick, __ATOMIC_RELEASE);
+}
+
+void traceWriteChromeTraceFile(void)
+{
+    SCOPED_LOCK(&g_traceMutex)
+    {
+        u64 event_count = __atomic_load_n(&g_traceEventCount, __ATOMIC_ACQUIRE);
+        if (!event_count) break;
+
+        u32 written_count = traceWriteEvents(TRACE_FILE_PATH, event_count, TRACE_EVENT_COUNT);
+        if (!written_count) break;
+
+        LOG_MSG_INFO("Wrote %u trace event(s) to \"%s\" (%lu overwritten).", written_count, TRACE_FILE_PATH, \
+                     event_count > TRACE_EVENT_COUNT ? (event_count - TRACE_EVENT_COUNT) : 0);
+
+        /* Clear event buffer. */
+        memset(g_traceEvents, 0, sizeof(g_traceEvents));
+        __atomic_store_n(&g_traceEventCount, 0, __ATOMIC_RELEASE);
+    }
+}
+
+void traceWriteCrashTraceFile(void)
+{
+    /* We don't take the mutex here: the crashing thread may already hold it. The event buffer is left untouched. */
+    u64 event_count = __atomic_load_n(&g_traceEventCount, __ATOMIC_ACQUIRE);
+    if (event_count) traceWriteEvents(TRACE_CRASH_FILE_PATH, event_count, TRACE_CRASH_EVENT_COUNT);
+}
+
+static u32 traceWriteEvents(const char *path, u64 event_count, u64 max_event_count)
+{
+    u64 first_idx = (event_count > max_event_count ? (event_count - max_event_count) : 0);
+    u64 overwritten_count = (event_count > TRACE_EVENT_COUNT ? (event_count - TRACE_EVENT_COUNT) : 0);
+    u64 base_tick = UINT64_MAX, end_tick = 0;
+    u32 written_count = 0;
+    FILE *fp = NULL;
+
+    /* Events that have already been overwritten can't be written. */
+    if (first_idx < overwritten_count) first_idx = overwritten_count;
+
+    /* Use the earliest start tick as the trace origin. */
+    for(u64 i = first_idx; i < event_count; i++)
+    {
+        TraceEvent *event = &(g_traceEvents[i & (TRACE_EVENT_COUNT - 1)]);
+        if (event->start_tick < base_tick) base_tick = event->start_tick;
+    }
+
+    fp = fopen(path, "w");
+    if (!fp)
+    {
+        LOG_MSG_ERROR("Unable to open \"%s\" for writing! (%d).", path, errno);
+        return 0;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"overwritten_events\":%lu,\"skipped_events\":%lu},\"traceEvents\":[", overwritten_count, \
+            first_idx - overwritten_count);
+
+    for(u64 i = first_idx; i < event_count; i++)
+    {
+        TraceEvent *event = &(g_traceEvents[i & (TRACE_EVENT_COUNT - 1)]);
+
+        /* Skip events that are still being written. */
+        end_tick = __atomic_load_n(&(event->end_tick), __ATOMIC_ACQUIRE);
+        if (!end_tick || !event->name || event->start_tick < base_tick || end_tick < event->start_tick) continue;
+
+        /* Timestamps and durations are expressed in microseconds. */
+        fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"nxdt\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", written_count ? "," : "", event->name, \
+                event->thread_handle, (double)armTicksToNs(event->start_tick - base_tick) / 1000.0, (double)armTicksToNs(end_tick - event->start_tick) / 1000.0);
+
+        written_count++;
+    }
+
+    fprintf(fp, "]}\n");
+    fclose(fp);
+
+    utilsCommitSdCardFileSystemChanges();
+
+    return written_count;
+}
+
+#endif  /* TRACE_ENABLED == 1 */
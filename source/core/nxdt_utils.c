@@ -22,6 +22,7 @@
 #include <sys/statvfs.h>
 
 #include <core/nxdt_utils.h>
+#include <core/aes.h>
 #include <core/keys.h>
 #include <core/gamecard.h>
 #include <core/services.h>
@@ -30,9 +31,18 @@
 #include <core/title.h>
 #include <core/bfttf.h>
 #include <core/nxdt_bfsar.h>
+#include <core/nointro.h>
+#include <core/rsa.h>
 #include <core/system_update.h>
 #include <core/devoptab/nxdt_devoptab.h>
 #include <core/bis_storage.h>
+#include <core/cert.h>
+#include <core/async_io.h>
+
+#define UTILS_MEMORY_BUDGET_FULL_THRESHOLD  0x40000000  /* 1 GiB. Large buffers are scaled down by half each time the free heap size falls below a halved threshold. */
+#define UTILS_MEMORY_BUDGET_MAX_SHIFT       3           /* Large buffers are never scaled down below an eighth of their preferred size. */
+
+#define UTILS_INIT_WORKER_COUNT             3           /* One per available CPU core. The calling thread runs initialization steps as well. */
 
 /* Type definitions. */
 
@@ -53,6 +63,49 @@ typedef struct {
     u32 micro;
 } UtilsApplicationVersion;
 
+/* Used by utilsParseGitHubReleaseJsonData() to keep track of the current asset while the release JSON is being parsed. */
+typedef struct {
+    UtilsGitHubReleaseJsonData *out;
+    char *published_at;
+    bool has_assets;
+    u32 asset_idx;
+    char *asset_name;
+    char *asset_url;
+    u64 asset_size;
+    bool asset_has_sha256;
+    u8 asset_sha256[SHA256_HASH_SIZE];
+    bool error;
+} UtilsGitHubReleaseParseState;
+
+typedef enum {
+    UtilsInitStep_Usb             = 0,
+    UtilsInitStep_Ums             = 1,
+    UtilsInitStep_Keys            = 2,
+    UtilsInitStep_NcaCryptoBuffer = 3,
+    UtilsInitStep_GameCard        = 4,
+    UtilsInitStep_Title           = 5,
+    UtilsInitStep_Bfttf           = 6,
+    UtilsInitStep_SystemUpdate    = 7,
+    UtilsInitStep_RomFs           = 8,
+    UtilsInitStep_Config          = 9,
+    UtilsInitStep_BisStorage      = 10,
+    UtilsInitStep_Count           = 11  ///< Total values supported by this enum.
+} UtilsInitStep;
+
+typedef struct {
+    const char *name;
+    bool (*func)(void);
+    u32 deps;           ///< Bitmask made out of UtilsInitStep values. All of these must have been completed before running this step.
+} UtilsInitStepInfo;
+
+typedef struct {
+    Mutex mutex;
+    CondVar cond;
+    u32 started;        ///< Bitmask made out of UtilsInitStep values.
+    u32 completed;      ///< Bitmask made out of UtilsInitStep values.
+    bool failed;
+} UtilsInitState;
+
 /* Global variables. */
 
 extern int __system_argc;
@@ -78,6 +131,11 @@ static AppletType g_programAppletType = AppletType_None;
 static AppletHookCookie g_systemOverclockCookie = {0};
 
 static bool g_longRunningProcess = false;
+static u8 g_clockBoostHint = UtilsClockBoostHint_None;
+static bool g_clockBoosted = false;
+
+static u64 g_memoryBudgetHeapFree = 0;
+static u8 g_memoryBudgetShift = 0;
 
 static const char *g_sizeSuffixes[] = { "B", "KiB", "MiB", "GiB", "TiB" };
 static const u32 g_sizeSuffixesCount = MAX_ELEMENTS(g_sizeSuffixes);
@@ -93,12 +151,22 @@ static const SplConfigItem SplConfigItem_ExosphereEmummcType = (SplConfigItem)65
 static UtilsExosphereApiVersion g_exosphereApiVersion = {0};
 static bool g_exosphereIsEmummc = false;
 
+static UtilsInitState g_initState = {0};
+
 /* Function prototypes. */
 
+static bool utilsAllocateNcaCryptoBuffer(void);
+static bool utilsMountRomFs(void);
+
+static bool utilsRunInitSteps(void);
+static void utilsInitWorkerThreadFunc(void *arg);
+
 static void _utilsGetLaunchPath(void);
 
 static bool _utilsGetSdCardFileSystemObject(void);
 
+static bool utilsGetFileSystemInfoByPath(const char *path, struct statvfs *out_info);
+
 static void _utilsGetNxLinkFileDescriptor(void);
 static void utilsCloseNxLinkFileDescriptor(void);
 
@@ -113,6 +181,8 @@ static bool utilsGetDevelopmentUnitFlag(void);
 
 static bool utilsGetTerraUnitFlag(void);
 
+static void utilsInitializeMemoryBudget(void);
+
 #if LOG_LEVEL <= LOG_LEVEL_INFO
 static void utilsLogEnvironmentInfo(void);
 #endif
@@ -124,6 +194,7 @@ static void utilsEnableVideoRecording(void);
 static void utilsPrintInitializationFailureMessage(void);
 
 static void utilsOverclockSystem(bool overclock);
+static void utilsUpdateClockBoost(bool force);
 static void utilsOverclockSystemAppletHook(AppletHookType hook, void *param);
 
 static void utilsChangeHomeButtonBlockStatus(bool block);
@@ -132,9 +203,27 @@ static size_t utilsGetUtf8StringLimit(const char *str, size_t str_size, size_t b
 
 static char utilsConvertHexDigitToBinary(char c);
 
+static bool utilsGitHubReleaseJsonValueCallback(void *user_data, const char *path, u8 type, const char *value, size_t value_len);
+static void utilsCommitGitHubReleaseAsset(UtilsGitHubReleaseParseState *state);
+static bool utilsReplaceString(char **dst, const char *value, size_t value_len);
+
+/* Initialization steps run by utilsRunInitSteps(). Steps without pending dependencies between each other may run concurrently. */
+static const UtilsInitStepInfo g_initSteps[UtilsInitStep_Count] = {
+    [UtilsInitStep_Usb]             = { "USB",               usbInitialize,                 0 },
+    [UtilsInitStep_Ums]             = { "USB Mass Storage",  umsInitialize,                 0 },
+    [UtilsInitStep_Keys]            = { "keyset",            keysLoadKeyset,                0 },
+    [UtilsInitStep_NcaCryptoBuffer] = { "NCA crypto buffer", utilsAllocateNcaCryptoBuffer,  0 },
+    [UtilsInitStep_GameCard]        = { "gamecard",          gamecardInitialize,            BIT(UtilsInitStep_Keys) | BIT(UtilsInitStep_NcaCryptoBuffer) },
+    [UtilsInitStep_Title]           = { "title",             titleInitialize,               BIT(UtilsInitStep_Keys) | BIT(UtilsInitStep_NcaCryptoBuffer) | BIT(UtilsInitStep_GameCard) },
+    [UtilsInitStep_Bfttf]           = { "BFTTF",             bfttfInitialize,               BIT(UtilsInitStep_Title) },
+    [UtilsInitStep_SystemUpdate]    = { "system update",     systemUpdateInitialize,        BIT(UtilsInitStep_Title) },
+    [UtilsInitStep_RomFs]           = { "RomFS",             utilsMountRomFs,               0 },
+    [UtilsInitStep_Config]          = { "configuration",     configInitialize,              BIT(UtilsInitStep_RomFs) },
+    [UtilsInitStep_BisStorage]      = { "eMMC BIS storage",  bisStorageInitialize,          BIT(UtilsInitStep_Keys) }
+};
+
 bool utilsInitializeResources(void)
 {
-    Result rc = 0;
     bool ret = false;
 
     SCOPED_LOCK(&g_resourcesMutex)
@@ -189,6 +278,9 @@ bool utilsInitializeResources(void)
         /* Get applet type. */
         g_programAppletType = appletGetAppletType();
 
+        /* Determine the memory budget for large buffers. This must take place before initializing any interface that allocates them. */
+        utilsInitializeMemoryBudget();
+
 #if LOG_LEVEL <= LOG_LEVEL_INFO
         /* Log environment information. */
         utilsLogEnvironmentInfo();
@@ -201,54 +293,16 @@ bool utilsInitializeResources(void)
         /* cURL must be initialized before starting any other threads. */
         if (!httpInitialize()) break;
 
-        /* Initialize USB interface. */
-        if (!usbInitialize()) break;
-
-        /* Initialize USB Mass Storage interface. */
-        if (!umsInitialize()) break;
-
-        /* Load keyset. */
-        if (!keysLoadKeyset()) break;
-
-        /* Allocate NCA crypto buffer. */
-        if (!ncaAllocateCryptoBuffer())
-        {
-            LOG_MSG_ERROR("Unable to allocate memory for NCA crypto buffer!");
-            break;
-        }
-
-        /* Initialize gamecard interface. */
-        if (!gamecardInitialize()) break;
-
-        /* Initialize title interface. */
-        if (!titleInitialize()) break;
-
-        /* Initialize BFTTF interface. */
-        if (!bfttfInitialize()) break;
+        /* Initialize USB, USB Mass Storage, keyset, NCA crypto buffer, gamecard, title, BFTTF, system update, RomFS, configuration and eMMC BIS storage interfaces. */
+        /* Independent steps run concurrently, since most of them just wait on IPC calls or SD card reads. See g_initSteps for the dependencies between them. */
+        if (!utilsRunInitSteps()) break;
 
         /* Initialize BFSAR interface. */
         //if (!bfsarInitialize()) break;
 
-        /* Initialize system update interface. */
-        if (!systemUpdateInitialize()) break;
-
-        /* Mount application RomFS. */
-        rc = romfsInit();
-        if (R_FAILED(rc))
-        {
-            LOG_MSG_ERROR("Failed to mount " APP_TITLE "'s RomFS container! (0x%X).", rc);
-            break;
-        }
-
-        /* Initialize configuration interface. */
-        if (!configInitialize()) break;
-
         /* Setup an applet hook to change the hardware clocks after a system mode change (docked <-> undocked). */
         appletHook(&g_systemOverclockCookie, utilsOverclockSystemAppletHook, NULL);
 
-        /* Initialize eMMC BIS storage interface. */
-        if (!bisStorageInitialize()) break;
-
         /* Enable video recording whenever possible. */
         utilsEnableVideoRecording();
 
@@ -268,6 +322,16 @@ void utilsCloseResources(void)
     {
         LOG_MSG_INFO("Shutting down...");
 
+        /* Write tracing spans (if enabled). */
+        traceWriteChromeTraceFile();
+
+        /* Stop async I/O worker threads. Queued reads may still target any of the interfaces below. */
+        asyncIoExit();
+
+        /* Close cached ES system savefiles. These live in the eMMC BIS System partition. */
+        tikCloseCachedSaveFiles();
+        certCloseCachedSaveFile();
+
         /* Close eMMC BIS storage interface. */
         bisStorageExit();
 
@@ -304,15 +368,30 @@ void utilsCloseResources(void)
         /* Free NCA crypto buffer. */
         ncaFreeCryptoBuffer();
 
+        /* Stop AES-CTR worker threads. */
+        aes128CtrParallelExit();
+
+        /* Free cached NCA hash data patches. */
+        ncaFreeHashDataPatchCache();
+
         /* Close USB Mass Storage interface. */
         umsExit();
 
         /* Close USB interface. */
         usbExit();
 
+        /* Free offline No-Intro checksum index. */
+        noIntroExit();
+
+        /* Save and free RSA signature verification cache. */
+        rsaExit();
+
         /* Close HTTP interface. */
         httpExit();
 
+        /* Free shared buffer pool. */
+        bufferPoolExit();
+
         /* Close nxlink socket. */
         utilsCloseNxLinkFileDescriptor();
 
@@ -337,6 +416,100 @@ void utilsCloseResources(void)
     }
 }
 
+static bool utilsAllocateNcaCryptoBuffer(void)
+{
+    bool ret = ncaAllocateCryptoBuffer();
+    if (!ret) LOG_MSG_ERROR("Unable to allocate memory for NCA crypto buffer!");
+    return ret;
+}
+
+static bool utilsMountRomFs(void)
+{
+    Result rc = romfsInit();
+    if (R_FAILED(rc)) LOG_MSG_ERROR("Failed to mount " APP_TITLE "'s RomFS container! (0x%X).", rc);
+    return R_SUCCEEDED(rc);
+}
+
+static bool utilsRunInitSteps(void)
+{
+    Thread threads[UTILS_INIT_WORKER_COUNT] = {0};
+    u32 thread_count = 0;
+    bool ret = false;
+
+    memset(&g_initState, 0, sizeof(UtilsInitState));
+    mutexInit(&(g_initState.mutex));
+    condvarInit(&(g_initState.cond));
+
+    u64 start_tick = armGetSystemTick();
+
+    /* Create worker threads. The current thread takes care of everything on its own if none of them could be created. */
+    for(u32 i = 0; i < UTILS_INIT_WORKER_COUNT; i++)
+    {
+        if (!utilsCreateThread(&(threads[thread_count]), utilsInitWorkerThreadFunc, &g_initState, (int)i)) break;
+        thread_count++;
+    }
+
+    /* Run initialization steps on the current thread as well. */
+    utilsInitWorkerThreadFunc(&g_initState);
+
+    /* Wait until all worker threads are done. */
+    for(u32 i = 0; i < thread_count; i++) utilsJoinThread(&(threads[i]));
+
+    ret = (!g_initState.failed && g_initState.completed == (BIT(UtilsInitStep_Count) - 1));
+
+    LOG_MSG_DEBUG("Initialization steps %s after %lu ms using %u worker thread(s).", ret ? "completed" : "failed", armTicksToNs(armGetSystemTick() - start_tick) / 1000000, thread_count);
+
+    return ret;
+}
+
+static void utilsInitWorkerThreadFunc(void *arg)
+{
+    UtilsInitState *state = (UtilsInitState*)arg;
+    const u32 all_steps = (BIT(UtilsInitStep_Count) - 1);
+
+    mutexLock(&(state->mutex));
+
+    while(!state->failed && state->started != all_steps)
+    {
+        /* Look for a step that hasn't been started yet, with all of its dependencies completed. */
+        u32 step = UtilsInitStep_Count;
+
+        for(u32 i = 0; i < UtilsInitStep_Count; i++)
+        {
+            if ((state->started & BIT(i)) || (g_initSteps[i].deps & state->completed) != g_initSteps[i].deps) continue;
+            step = i;
+            break;
+        }
+
+        /* Wait until another thread completes a step if nothing can be run right now. */
+        if (step == UtilsInitStep_Count)
+        {
+            condvarWait(&(state->cond), &(state->mutex));
+            continue;
+        }
+
+        state->started |= BIT(step);
+
+        /* Run the initialization step without holding the mutex. */
+        mutexUnlock(&(state->mutex));
+        bool success = g_initSteps[step].func();
+        mutexLock(&(state->mutex));
+
+        if (success)
+        {
+            state->completed |= BIT(step);
+        } else {
+            LOG_MSG_ERROR("Initialization step \"%s\" failed!", g_initSteps[step].name);
+            state->failed = true;
+        }
+
+        /* Wake up all waiting threads. New steps may be available, or we may have failed. */
+        condvarWakeAll(&(state->cond));
+    }
+
+    mutexUnlock(&(state->mutex));
+}
+
 const char *utilsGetLaunchPath(void)
 {
     return g_appLaunchPath;
@@ -402,6 +575,54 @@ bool utilsIsAppletMode(void)
     return (g_programAppletType > AppletType_Application && g_programAppletType < AppletType_SystemApplication);
 }
 
+u64 utilsGetMemoryBudgetHeapFree(void)
+{
+    return g_memoryBudgetHeapFree;
+}
+
+bool utilsIsMemoryBudgetReduced(void)
+{
+    return (g_memoryBudgetShift > 0);
+}
+
+u64 utilsGetBudgetedBufferSize(u64 size, u64 min_size)
+{
+    u64 budgeted_size = (size >> g_memoryBudgetShift);
+    return MIN(MAX(budgeted_size, min_size), size);
+}
+
+u32 utilsGetBudgetedBufferCount(u32 count, u32 min_count)
+{
+    u32 budgeted_count = (count >> g_memoryBudgetShift);
+    return MIN(MAX(budgeted_count, min_count), count);
+}
+
+void *utilsAllocateBudgetedBuffer(u64 size, u64 min_size, u64 alignment, u64 *out_size)
+{
+    if (!size || !min_size || min_size > size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    u64 cur_size = utilsGetBudgetedBufferSize(size, min_size);
+    void *buf = NULL;
+
+    while(true)
+    {
+        buf = (alignment ? memalign(alignment, cur_size) : malloc(cur_size));
+        if (buf || cur_size <= min_size) break;
+
+        /* Degrade gracefully by retrying with a smaller buffer. */
+        LOG_MSG_WARNING("Failed to allocate 0x%lX-byte long buffer! Retrying with a smaller size.", cur_size);
+        cur_size = MAX(cur_size >> 1, min_size);
+    }
+
+    if (buf && out_size) *out_size = cur_size;
+
+    return buf;
+}
+
 void utilsSetLongRunningProcessState(bool state)
 {
     SCOPED_LOCK(&g_resourcesMutex)
@@ -415,19 +636,44 @@ void utilsSetLongRunningProcessState(bool state)
         /* Enable/disable screen dimming and auto sleep. */
         appletSetMediaPlaybackState(state);
 
+        /* Update flag. Clock boost hints only apply to the current long-running process. */
+        g_longRunningProcess = state;
+        g_clockBoostHint = UtilsClockBoostHint_None;
+
         /* Enable/disable system overclock. */
-        utilsOverclockSystem(configGetBoolean("overclock") & state);
+        utilsUpdateClockBoost(false);
+    }
+}
 
-        /* Update flag. */
-        g_longRunningProcess = state;
+void utilsSetClockBoostHint(u8 hint)
+{
+    if (hint >= UtilsClockBoostHint_Count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return;
+    }
+
+    SCOPED_LOCK(&g_resourcesMutex)
+    {
+        if (!g_resourcesInit || !g_longRunningProcess || hint == g_clockBoostHint) break;
+
+        g_clockBoostHint = hint;
+        utilsUpdateClockBoost(false);
     }
 }
 
 bool utilsCreateThread(Thread *out_thread, ThreadFunc func, void *arg, int cpu_id)
+{
+    /* Enable preemptive multithreading by using priority 0x3B. */
+    return utilsCreateThreadWithPriority(out_thread, func, arg, cpu_id, 0x3B);
+}
+
+bool utilsCreateThreadWithPriority(Thread *out_thread, ThreadFunc func, void *arg, int cpu_id, int priority)
 {
     /* Core 3 is reserved for HOS, so we can only use cores 0, 1 and 2. */
     /* -2 can be provided to use the default process core. */
-    if (!out_thread || !func || (cpu_id < 0 && cpu_id != -2) || cpu_id > 2)
+    /* Priority values lower than 0x2C (main thread priority) are rejected by the kernel for homebrew applications. */
+    if (!out_thread || !func || (cpu_id < 0 && cpu_id != -2) || cpu_id > 2 || priority < 0x2C || priority > 0x3F)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -449,8 +695,7 @@ bool utilsCreateThread(Thread *out_thread, ThreadFunc func, void *arg, int cpu_i
     }
 
     /* Create thread. */
-    /* Enable preemptive multithreading by using priority 0x3B. */
-    rc = threadCreate(out_thread, func, arg, NULL, stack_size, 0x3B, cpu_id);
+    rc = threadCreate(out_thread, func, arg, NULL, stack_size, priority, cpu_id);
     if (R_FAILED(rc))
     {
         LOG_MSG_ERROR("threadCreate failed! (0x%X).", rc);
@@ -775,27 +1020,42 @@ void utilsGenerateFormattedSizeString(double size, char *dst, size_t dst_size)
 
 bool utilsGetFileSystemStatsByPath(const char *path, u64 *out_total, u64 *out_free)
 {
-    char *name_end = NULL, stat_path[32] = {0};
     struct statvfs info = {0};
-    int ret = -1;
 
-    if (!path || !*path || !(name_end = strchr(path, ':')) || *(name_end + 1) != '/' || (!out_total && !out_free))
+    if (!out_total && !out_free)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    name_end += 2;
-    snprintf(stat_path, MAX_ELEMENTS(stat_path), "%.*s", (int)(name_end - path), path);
+    if (!utilsGetFileSystemInfoByPath(path, &info)) return false;
+
+    if (out_total) *out_total = ((u64)info.f_blocks * (u64)info.f_frsize);
+    if (out_free) *out_free = ((u64)info.f_bfree * (u64)info.f_frsize);
+
+    return true;
+}
+
+bool utilsGetFileSystemClusterSizeByPath(const char *path, u64 *out_cluster_size)
+{
+    struct statvfs info = {0};
 
-    if ((ret = statvfs(stat_path, &info)) != 0)
+    if (!out_cluster_size)
     {
-        LOG_MSG_ERROR("statvfs failed for \"%s\"! (%d) (errno: %d).", stat_path, ret, errno);
+        LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    if (out_total) *out_total = ((u64)info.f_blocks * (u64)info.f_frsize);
-    if (out_free) *out_free = ((u64)info.f_bfree * (u64)info.f_frsize);
+    if (!utilsGetFileSystemInfoByPath(path, &info)) return false;
+
+    /* Some devoptab drivers (e.g. fsdev) report sizes in bytes instead of blocks, so we can't rely on the block size in that case. */
+    if (info.f_bsize <= 1 || !IS_POWER_OF_TWO(info.f_bsize))
+    {
+        LOG_MSG_DEBUG("Cluster size unavailable for \"%s\" (block size: 0x%lX).", path, (u64)info.f_bsize);
+        return false;
+    }
+
+    *out_cluster_size = (u64)info.f_bsize;
 
     return true;
 }
@@ -1182,71 +1442,53 @@ bool utilsParseGitHubReleaseJsonData(const char *json_buf, size_t json_buf_size,
         return false;
     }
 
+    JsonStreamReader reader = {0};
+    UtilsGitHubReleaseParseState state = { .out = out };
     bool ret = false;
-    const char *published_at = NULL;
-    struct json_object *assets = NULL;
 
     /* Free output buffer beforehand. */
     utilsFreeGitHubReleaseJsonData(out);
 
-    /* Parse JSON object. */
-    out->obj = jsonParseFromString(json_buf, json_buf_size);
-    if (!out->obj)
+    /* Ignore trailing NULL terminators. */
+    json_buf_size = strnlen(json_buf, json_buf_size);
+
+    /* Parse JSON data. Only the values we need are kept around. */
+    jsonStreamReaderInitialize(&reader, utilsGitHubReleaseJsonValueCallback, &state);
+
+    if (!jsonStreamReaderFeed(&reader, json_buf, json_buf_size) || !jsonStreamReaderFinish(&reader) || state.error)
     {
-        LOG_MSG_ERROR("Failed to parse JSON object!");
-        return false;
+        LOG_MSG_ERROR("Failed to parse JSON data!");
+        goto end;
     }
 
-    /* Get required JSON elements. */
-    out->version = jsonGetString(out->obj, "tag_name");
-    out->commit_hash = jsonGetString(out->obj, "target_commitish");
-    published_at = jsonGetString(out->obj, "published_at");
-    out->changelog = jsonGetString(out->obj, "body");
-    assets = jsonGetArray(out->obj, "assets");
+    /* Check the last asset. */
+    utilsCommitGitHubReleaseAsset(&state);
 
-    if (!out->version || !out->commit_hash || !published_at || !out->changelog || !assets)
+    if (!out->version || !out->commit_hash || !state.published_at || !out->changelog || !state.has_assets || !out->download_url)
     {
         LOG_MSG_ERROR("Failed to retrieve required elements from the provided JSON!");
         goto end;
     }
 
     /* Parse release date. */
-    if (!strptime(published_at, "%Y-%m-%dT%H:%M:%SZ", &(out->date)))
+    if (!strptime(state.published_at, "%Y-%m-%dT%H:%M:%SZ", &(out->date)))
     {
-        LOG_MSG_ERROR("Failed to parse release date \"%s\"!", published_at);
+        LOG_MSG_ERROR("Failed to parse release date \"%s\"!", state.published_at);
         goto end;
     }
 
-    /* Loop through the assets array until we find the NRO. */
-    size_t assets_len = json_object_array_length(assets);
-    for(size_t i = 0; i < assets_len; i++)
-    {
-        struct json_object *cur_asset = NULL;
-        const char *asset_name = NULL;
-
-        /* Get current asset object. */
-        cur_asset = json_object_array_get_idx(assets, i);
-        if (!cur_asset) continue;
+    /* Update return value. */
+    ret = true;
 
-        /* Get current asset name. */
-        asset_name = jsonGetString(cur_asset, "name");
-        if (!asset_name || strcmp(asset_name, NRO_NAME) != 0) continue;
+end:
+    if (state.asset_url) free(state.asset_url);
 
-        /* Jackpot. Get the download URL. */
-        out->download_url = jsonGetString(cur_asset, "browser_download_url");
-        break;
-    }
+    if (state.asset_name) free(state.asset_name);
 
-    if (!out->download_url)
-    {
-        LOG_MSG_ERROR("Failed to retrieve required elements from the provided JSON!");
-        goto end;
-    }
+    if (state.published_at) free(state.published_at);
 
-    /* Update return value. */
-    ret = true;
+    jsonStreamReaderFree(&reader);
 
-end:
     if (!ret) utilsFreeGitHubReleaseJsonData(out);
 
     return ret;
@@ -1308,6 +1550,29 @@ static void _utilsGetLaunchPath(void)
     }
 }
 
+static bool utilsGetFileSystemInfoByPath(const char *path, struct statvfs *out_info)
+{
+    char *name_end = NULL, stat_path[32] = {0};
+    int ret = -1;
+
+    if (!path || !*path || !(name_end = strchr(path, ':')) || *(name_end + 1) != '/' || !out_info)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    name_end += 2;
+    snprintf(stat_path, MAX_ELEMENTS(stat_path), "%.*s", (int)(name_end - path), path);
+
+    if ((ret = statvfs(stat_path, out_info)) != 0)
+    {
+        LOG_MSG_ERROR("statvfs failed for \"%s\"! (%d) (errno: %d).", stat_path, ret, errno);
+        return false;
+    }
+
+    return true;
+}
+
 static bool _utilsGetSdCardFileSystemObject(void)
 {
     g_sdCardFileSystem = fsdevGetDeviceFileSystem(DEVOPTAB_SDMC_DEVICE);
@@ -1415,6 +1680,28 @@ static bool utilsGetTerraUnitFlag(void)
     return R_SUCCEEDED(rc);
 }
 
+static void utilsInitializeMemoryBudget(void)
+{
+    extern char *fake_heap_start, *fake_heap_end;
+
+    /* Calculate the free heap size. Memory that has already been obtained by the allocator may hold free chunks as well. */
+    struct mallinfo info = mallinfo();
+    u64 heap_size = (u64)(fake_heap_end - fake_heap_start), heap_used = (u64)info.uordblks;
+    u64 threshold = UTILS_MEMORY_BUDGET_FULL_THRESHOLD;
+
+    g_memoryBudgetHeapFree = (heap_size > heap_used ? (heap_size - heap_used) : 0);
+    g_memoryBudgetShift = 0;
+
+    /* Applet mode only provides a fraction of the heap available under title override mode, so this is usually where reduced budgets come from. */
+    while(g_memoryBudgetShift < UTILS_MEMORY_BUDGET_MAX_SHIFT && g_memoryBudgetHeapFree < threshold)
+    {
+        g_memoryBudgetShift++;
+        threshold >>= 1;
+    }
+
+    LOG_MSG_INFO("Free heap: 0x%lX bytes. Large buffers scaled down by a factor of %u.", g_memoryBudgetHeapFree, 1U << g_memoryBudgetShift);
+}
+
 #if LOG_LEVEL <= LOG_LEVEL_INFO
 static void utilsLogEnvironmentInfo(void)
 {
@@ -1525,7 +1812,24 @@ static void utilsOverclockSystemAppletHook(AppletHookType hook, void *param)
     if (hook != AppletHookType_OnOperationMode && hook != AppletHookType_OnPerformanceMode) return;
 
     /* Overclock the system based on the overclock setting and the current long running state value. */
-    SCOPED_LOCK(&g_resourcesMutex) utilsOverclockSystem(configGetBoolean("overclock") & g_longRunningProcess);
+    /* Clock rates are always reapplied, since HOS may have changed them. */
+    SCOPED_LOCK(&g_resourcesMutex) utilsUpdateClockBoost(true);
+}
+
+static void utilsUpdateClockBoost(bool force)
+{
+    /* Must be called with the resources mutex held. */
+    bool boost = (g_longRunningProcess && configGetBoolean("overclock"));
+
+    /* Leave I/O-bound phases at normal clocks if adaptive overclocking is enabled. */
+    if (boost && g_clockBoostHint == UtilsClockBoostHint_IoBound && configGetBoolean("adaptive_overclock")) boost = false;
+
+    if (!force && boost == g_clockBoosted) return;
+
+    if (boost != g_clockBoosted) LOG_MSG_DEBUG("%s system overclock (hint %u).", boost ? "Enabling" : "Disabling", g_clockBoostHint);
+
+    utilsOverclockSystem(boost);
+    g_clockBoosted = boost;
 }
 
 static void utilsChangeHomeButtonBlockStatus(bool block)
@@ -1572,3 +1876,110 @@ static char utilsConvertHexDigitToBinary(char c)
     if ('0' <= c && c <= '9') return (c - '0');
     return 'z';
 }
+
+static bool utilsGitHubReleaseJsonValueCallback(void *user_data, const char *path, u8 type, const char *value, size_t value_len)
+{
+    UtilsGitHubReleaseParseState *state = (UtilsGitHubReleaseParseState*)user_data;
+    UtilsGitHubReleaseJsonData *out = state->out;
+    bool is_string = (type == JsonStreamValueType_String);
+    char **dst = NULL;
+
+    /* Top-level values. */
+    if (!strcmp(path, "tag_name"))
+    {
+        dst = &(out->version);
+    } else
+    if (!strcmp(path, "target_commitish"))
+    {
+        dst = &(out->commit_hash);
+    } else
+    if (!strcmp(path, "published_at"))
+    {
+        dst = &(state->published_at);
+    } else
+    if (!strcmp(path, "body"))
+    {
+        dst = &(out->changelog);
+    } else
+    if (!strncmp(path, "assets/", 7))
+    {
+        /* Asset values. Each asset is only committed once all of its values have been parsed. */
+        char *field = NULL;
+        u32 asset_idx = (u32)strtoul(path + 7, &field, 10);
+        if (!field || *field != '/') return true;
+        field++;
+
+        if (!state->has_assets || asset_idx != state->asset_idx)
+        {
+            utilsCommitGitHubReleaseAsset(state);
+            state->has_assets = true;
+            state->asset_idx = asset_idx;
+        }
+
+        if (!strcmp(field, "name"))
+        {
+            dst = &(state->asset_name);
+        } else
+        if (!strcmp(field, "browser_download_url"))
+        {
+            dst = &(state->asset_url);
+        } else
+        if (!strcmp(field, "size") && type == JsonStreamValueType_Number)
+        {
+            state->asset_size = (*value != '-' ? strtoull(value, NULL, 10) : 0);
+        } else
+        if (!strcmp(field, "digest") && is_string)
+        {
+            state->asset_has_sha256 = (!strncmp(value, "sha256:", 7) && (value_len - 7) == (SHA256_HASH_SIZE * 2) && \
+                                       utilsParseHexString(state->asset_sha256, SHA256_HASH_SIZE, value + 7, SHA256_HASH_SIZE * 2));
+        }
+    }
+
+    if (!dst || !is_string) return true;
+
+    if (!utilsReplaceString(dst, value, value_len))
+    {
+        LOG_MSG_ERROR("Failed to duplicate \"%s\" value!", path);
+        state->error = true;
+        return false;
+    }
+
+    return true;
+}
+
+static void utilsCommitGitHubReleaseAsset(UtilsGitHubReleaseParseState *state)
+{
+    UtilsGitHubReleaseJsonData *out = state->out;
+
+    if (!out->download_url && state->asset_name && state->asset_url && !strcmp(state->asset_name, NRO_NAME))
+    {
+        /* Jackpot. Ownership of the download URL is transferred to the output buffer. */
+        out->download_url = state->asset_url;
+        state->asset_url = NULL;
+
+        /* The asset size and its SHA-256 digest are used to verify the downloaded NRO. */
+        out->download_size = state->asset_size;
+        out->has_download_sha256 = state->asset_has_sha256;
+        memcpy(out->download_sha256, state->asset_sha256, SHA256_HASH_SIZE);
+    }
+
+    /* Reset asset data. */
+    if (state->asset_name) free(state->asset_name);
+    if (state->asset_url) free(state->asset_url);
+
+    state->asset_name = state->asset_url = NULL;
+    state->asset_size = 0;
+    state->asset_has_sha256 = false;
+    memset(state->asset_sha256, 0, SHA256_HASH_SIZE);
+}
+
+static bool utilsReplaceString(char **dst, const char *value, size_t value_len)
+{
+    char *str = strndup(value, value_len);
+    if (!str) return false;
+
+    if (*dst) free(*dst);
+    *dst = str;
+
+    return true;
+}
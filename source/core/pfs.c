@@ -24,6 +24,16 @@
 #include <core/npdm.h>
 
 #define PFS_HEADER_PADDING_ALIGNMENT    0x20
+#define PFS_NAME_INDEX_MIN_ENTRY_COUNT  8
+
+#define PFS_IMAGE_MIN_ENTRY_CAPACITY    8
+#define PFS_IMAGE_MIN_NAME_TABLE_SIZE   0x200
+
+/* Function prototypes. */
+
+static bool pfsBuildNameIndex(PartitionFileSystemContext *ctx);
+static bool pfsLookupNameIndex(PartitionFileSystemContext *ctx, const char *name, u32 *out_idx);
+NX_INLINE u32 pfsCalculateNameHash(const char *name);
 
 bool pfsInitializeContext(PartitionFileSystemContext *out, NcaFsSectionContext *nca_fs_ctx)
 {
@@ -168,26 +178,32 @@ bool pfsGetEntryIndexByName(PartitionFileSystemContext *ctx, const char *name, u
         return false;
     }
 
-    name_table_size = ((PartitionFileSystemHeader*)ctx->header)->name_table_size;
-
-    for(u32 i = 0; i < entry_count; i++)
+    /* Use the name index if we're dealing with a big enough partition. It's built right before the first lookup takes place. */
+    if (entry_count >= PFS_NAME_INDEX_MIN_ENTRY_COUNT && (ctx->name_index || pfsBuildNameIndex(ctx)))
     {
-        if (!(fs_entry = pfsGetEntryByIndex(ctx, i)))
-        {
-            LOG_MSG_ERROR("Failed to retrieve Partition FS entry #%u!", i);
-            return false;
-        }
-
-        if (fs_entry->name_offset >= name_table_size)
-        {
-            LOG_MSG_ERROR("Name offset from Partition FS entry #%u exceeds name table size!", i);
-            return false;
-        }
+        if (pfsLookupNameIndex(ctx, name, out_idx)) return true;
+    } else {
+        name_table_size = ((PartitionFileSystemHeader*)ctx->header)->name_table_size;
 
-        if (!strcmp(name_table + fs_entry->name_offset, name))
+        for(u32 i = 0; i < entry_count; i++)
         {
-            *out_idx = i;
-            return true;
+            if (!(fs_entry = pfsGetEntryByIndex(ctx, i)))
+            {
+                LOG_MSG_ERROR("Failed to retrieve Partition FS entry #%u!", i);
+                return false;
+            }
+
+            if (fs_entry->name_offset >= name_table_size)
+            {
+                LOG_MSG_ERROR("Name offset from Partition FS entry #%u exceeds name table size!", i);
+                return false;
+            }
+
+            if (!strcmp(name_table + fs_entry->name_offset, name))
+            {
+                *out_idx = i;
+                return true;
+            }
         }
     }
 
@@ -258,15 +274,21 @@ bool pfsAddEntryInformationToImageContext(PartitionFileSystemImageContext *ctx,
     PartitionFileSystemEntry *tmp_pfs_entries = NULL, *cur_pfs_entry = NULL, *prev_pfs_entry = NULL;
     u32 unpadded_name_table_size = 0;
 
-    /* Reallocate Partition FS entries. */
-    if (!(tmp_pfs_entries = realloc(ctx->entries, (header->entry_count + 1) * sizeof(PartitionFileSystemEntry))))
+    /* Reallocate Partition FS entries, if needed. Capacity grows geometrically to avoid reallocating the whole array each time an entry is added. */
+    if (header->entry_count >= ctx->entry_capacity)
     {
-        LOG_MSG_ERROR("Failed to reallocate Partition FS entries! (%u).", header->entry_count + 1);
-        return false;
-    }
+        u32 entry_capacity = (ctx->entry_capacity ? (ctx->entry_capacity * 2) : PFS_IMAGE_MIN_ENTRY_CAPACITY);
 
-    ctx->entries = tmp_pfs_entries;
-    tmp_pfs_entries = NULL;
+        if (!(tmp_pfs_entries = realloc(ctx->entries, entry_capacity * sizeof(PartitionFileSystemEntry))))
+        {
+            LOG_MSG_ERROR("Failed to reallocate Partition FS entries! (%u).", entry_capacity);
+            return false;
+        }
+
+        ctx->entries = tmp_pfs_entries;
+        ctx->entry_capacity = entry_capacity;
+        tmp_pfs_entries = NULL;
+    }
 
     /* Update Partition FS entry information. */
     cur_pfs_entry = &(ctx->entries[header->entry_count]);
@@ -276,7 +298,7 @@ bool pfsAddEntryInformationToImageContext(PartitionFileSystemImageContext *ctx,
 
     cur_pfs_entry->offset = (prev_pfs_entry ? (prev_pfs_entry->offset + prev_pfs_entry->size) : 0);
     cur_pfs_entry->size = entry_size;
-    cur_pfs_entry->name_offset = (prev_pfs_entry ? (prev_pfs_entry->name_offset + strlen(ctx->name_table + prev_pfs_entry->name_offset) + 1) : 0);
+    cur_pfs_entry->name_offset = ctx->name_table_used;
 
     /* Calculate unpadded name table size. Reserve space for a NULL terminator. */
     unpadded_name_table_size = (cur_pfs_entry->name_offset + (u32)entry_name_len + 1);
@@ -285,25 +307,31 @@ bool pfsAddEntryInformationToImageContext(PartitionFileSystemImageContext *ctx,
     if (unpadded_name_table_size >= header->name_table_size)
     {
         /* Calculate padded name table size. */
-        char *tmp_name_table = NULL;
         u32 nameless_header_size = (u32)(sizeof(PartitionFileSystemHeader) + ((header->entry_count + 1) * sizeof(PartitionFileSystemEntry)));
         u32 padded_name_table_size = (ALIGN_UP(nameless_header_size + unpadded_name_table_size, PFS_HEADER_PADDING_ALIGNMENT) - nameless_header_size);
 
         /* Add manual padding if the full Partition FS header would already be properly aligned. */
         if (padded_name_table_size == unpadded_name_table_size) padded_name_table_size += PFS_HEADER_PADDING_ALIGNMENT;
 
-        /* Reallocate Partition FS name table. */
-        if (!(tmp_name_table = realloc(ctx->name_table, padded_name_table_size)))
+        /* Reallocate Partition FS name table, if needed. */
+        if (padded_name_table_size > ctx->name_table_capacity)
         {
-            LOG_MSG_ERROR("Failed to reallocate Partition FS name table! (0x%X).", padded_name_table_size);
-            return false;
-        }
+            char *tmp_name_table = NULL;
+            u32 name_table_capacity = MAX(ctx->name_table_capacity ? (ctx->name_table_capacity * 2) : PFS_IMAGE_MIN_NAME_TABLE_SIZE, padded_name_table_size);
 
-        ctx->name_table = tmp_name_table;
-        tmp_name_table = NULL;
+            if (!(tmp_name_table = realloc(ctx->name_table, name_table_capacity)))
+            {
+                LOG_MSG_ERROR("Failed to reallocate Partition FS name table! (0x%X).", name_table_capacity);
+                return false;
+            }
 
-        /* Clear new allocated area. */
-        memset(ctx->name_table + cur_pfs_entry->name_offset, 0, padded_name_table_size - cur_pfs_entry->name_offset);
+            /* Clear new allocated area. */
+            memset(tmp_name_table + ctx->name_table_capacity, 0, name_table_capacity - ctx->name_table_capacity);
+
+            ctx->name_table = tmp_name_table;
+            ctx->name_table_capacity = name_table_capacity;
+            tmp_name_table = NULL;
+        }
 
         /* Update Partition FS name table size. */
         header->name_table_size = padded_name_table_size;
@@ -315,8 +343,9 @@ bool pfsAddEntryInformationToImageContext(PartitionFileSystemImageContext *ctx,
     /* Update output entry index. */
     if (out_entry_idx) *out_entry_idx = header->entry_count;
 
-    /* Update Partition FS entry count and data size. */
+    /* Update Partition FS entry count, used name table size and data size. */
     header->entry_count++;
+    ctx->name_table_used = unpadded_name_table_size;
     ctx->fs_size += entry_size;
 
     return true;
@@ -389,3 +418,79 @@ bool pfsWriteImageContextHeaderToMemoryBuffer(PartitionFileSystemImageContext *c
 
     return true;
 }
+
+static bool pfsBuildNameIndex(PartitionFileSystemContext *ctx)
+{
+    u32 entry_count = pfsGetEntryCount(ctx), name_table_size = ((PartitionFileSystemHeader*)ctx->header)->name_table_size, capacity = 16, mask = 0;
+    char *name_table = pfsGetNameTable(ctx);
+    u32 *name_index = NULL;
+
+    /* Keep the load factor at or below 50%. */
+    while(capacity < (entry_count * 2)) capacity <<= 1;
+    mask = (capacity - 1);
+
+    if (!(name_index = malloc(capacity * sizeof(u32))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for Partition FS name index!");
+        return false;
+    }
+
+    /* Mark all slots as unused. */
+    for(u32 i = 0; i < capacity; i++) name_index[i] = UINT32_MAX;
+
+    for(u32 i = 0; i < entry_count; i++)
+    {
+        PartitionFileSystemEntry *fs_entry = pfsGetEntryByIndex(ctx, i);
+        if (!fs_entry || fs_entry->name_offset >= name_table_size)
+        {
+            /* Let the linear scan report the actual error. */
+            free(name_index);
+            return false;
+        }
+
+        /* Use linear probing. The load factor guarantees we'll always find a free slot. */
+        u32 slot = (pfsCalculateNameHash(name_table + fs_entry->name_offset) & mask);
+        while(name_index[slot] != UINT32_MAX) slot = ((slot + 1) & mask);
+
+        name_index[slot] = i;
+    }
+
+    ctx->name_index = name_index;
+    ctx->name_index_capacity = capacity;
+
+    return true;
+}
+
+static bool pfsLookupNameIndex(PartitionFileSystemContext *ctx, const char *name, u32 *out_idx)
+{
+    u32 mask = (ctx->name_index_capacity - 1);
+    char *name_table = pfsGetNameTable(ctx);
+
+    for(u32 slot = (pfsCalculateNameHash(name) & mask); ctx->name_index[slot] != UINT32_MAX; slot = ((slot + 1) & mask))
+    {
+        u32 idx = ctx->name_index[slot];
+        PartitionFileSystemEntry *fs_entry = pfsGetEntryByIndex(ctx, idx);
+
+        if (fs_entry && !strcmp(name_table + fs_entry->name_offset, name))
+        {
+            *out_idx = idx;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+NX_INLINE u32 pfsCalculateNameHash(const char *name)
+{
+    /* FNV-1a. */
+    u32 hash = 0x811C9DC5;
+
+    for(; *name; name++)
+    {
+        hash ^= (u8)*name;
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
@@ -27,8 +27,67 @@
 
 /* Helper macros. */
 
-#define PI_ADD_FMT_STR_T1(fmt, ...) utilsAppendFormattedStringToBuffer(&xml_buf, &xml_buf_size, fmt, ##__VA_ARGS__)
-#define PI_ADD_FMT_STR_T2(fmt, ...) utilsAppendFormattedStringToBuffer(xml_buf, xml_buf_size, fmt, ##__VA_ARGS__)
+#define PI_ADD_FMT_STR_T1(fmt, ...) stringBuilderAppendFormatted(&xml_sb, fmt, ##__VA_ARGS__)
+#define PI_ADD_FMT_STR_T2(fmt, ...) stringBuilderAppendFormatted(xml_sb, fmt, ##__VA_ARGS__)
+
+#define PI_XML_BASE_SIZE_HINT       0x2000  /* Doesn't include the NPDM ACID section Base64 string. */
+
+#define PI_NSO_THREAD_COUNT         3   /* Includes the calling thread. Each NSO is initialized on its own, so this also limits the amount of segment data held in memory at once. */
+
+#define PI_API_ENTRY_MIN_SIZE       9   /* Shortest SDK prefix + two '+' separators + NULL terminator. Used to get an upper bound for the API entry count. */
+#define PI_HASH_SET_MIN_CAPACITY    0x10
+
+#define PI_FNV1A_OFFSET_BASIS       0xCBF29CE484222325ULL
+#define PI_FNV1A_PRIME              0x100000001B3ULL
+
+/* Type definitions. */
+
+typedef struct {
+    PartitionFileSystemContext *pfs_ctx;
+    PartitionFileSystemEntry **pfs_entries;
+    NsoContext *nso_ctx;
+    u32 nso_count;
+    atomic_uint next_idx;
+    atomic_bool failed;
+} ProgramInfoNsoThreadData;
+
+typedef enum {
+    ProgramInfoApiListType_Middleware   = 0,
+    ProgramInfoApiListType_DebugApi     = 1,
+    ProgramInfoApiListType_PrivateApi   = 2,
+    ProgramInfoApiListType_GuidelineApi = 3,
+    ProgramInfoApiListType_Count        = 4     ///< Total values supported by this enum.
+} ProgramInfoApiListType;
+
+typedef struct {
+    const char *list_tag;
+    const char *entry_prefix;
+    const char *sdk_prefix;
+    size_t sdk_prefix_len;
+} ProgramInfoApiListInfo;
+
+typedef struct {
+    char *name;
+    char *vender;
+    int vender_len;
+    u32 nso_idx;
+    u8 type;        ///< ProgramInfoApiListType.
+} ProgramInfoApiEntry;
+
+/* Holds the SDK API entries from all NSOs, classified in a single pass. */
+typedef struct {
+    ProgramInfoApiEntry *entries;
+    u32 count;
+} ProgramInfoApiEntryList;
+
+/* Open addressing hash set used to discard duplicate API entries and symbols. */
+/* Each slot holds an item index plus one, which means zero is used to represent empty slots. */
+typedef struct {
+    u32 *slots;
+    u32 mask;
+} ProgramInfoHashSet;
+
+typedef bool (*ProgramInfoHashSetCompareFunction)(const void *items, u32 idx_a, u32 idx_b);
 
 /* Global variables. */
 
@@ -37,6 +96,13 @@ static const char *g_trueString = "True", *g_falseString = "False";
 static const char g_nnSdkString[] = "NintendoSdk_nnSdk";
 static const size_t g_nnSdkStringLength = (MAX_ELEMENTS(g_nnSdkString) - 1);
 
+static const ProgramInfoApiListInfo g_programInfoApiListInfo[ProgramInfoApiListType_Count] = {
+    [ProgramInfoApiListType_Middleware]   = { "Middleware",   "Module", "SDK MW",        6  },
+    [ProgramInfoApiListType_DebugApi]     = { "DebugApi",     "Api",    "SDK Debug",     9  },
+    [ProgramInfoApiListType_PrivateApi]   = { "PrivateApi",   "Api",    "SDK Private",   11 },
+    [ProgramInfoApiListType_GuidelineApi] = { "GuidelineApi", "Api",    "SDK Guideline", 13 }
+};
+
 static const char *g_facAccessibilityStrings[] = {
     "None",
     "Read",
@@ -46,17 +112,29 @@ static const char *g_facAccessibilityStrings[] = {
 
 /* Function prototypes. */
 
+static bool programInfoInitializeNsoContexts(ProgramInfoContext *program_info_ctx, PartitionFileSystemEntry **pfs_entries, u32 nso_count);
+static void programInfoProcessNsoContexts(ProgramInfoNsoThreadData *nso_thread_data);
+static void programInfoNsoThreadFunc(void *arg);
+
 static bool programInfoGetSdkVersionAndBuildTypeFromSdkNso(ProgramInfoContext *program_info_ctx, char **sdk_version, char **build_type);
-static bool programInfoAddNsoApiListToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx, const char *api_list_tag, const char *api_entry_prefix, \
-                                                       const char *sdk_prefix);
+static bool programInfoCollectNsoApiEntries(ProgramInfoContext *program_info_ctx, ProgramInfoApiEntryList *out);
+static bool programInfoAddNsoApiListToAuthoringToolXml(StringBuilder *xml_sb, ProgramInfoContext *program_info_ctx, const ProgramInfoApiEntryList *api_entry_list, u8 type);
 static bool programInfoIsApiInfoEntryValid(const char *sdk_prefix, size_t sdk_prefix_len, char *sdk_entry, char **sdk_entry_vender, int *sdk_entry_vender_len, char **sdk_entry_name, bool nnsdk);
 
-static bool programInfoAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const char *value);
+static bool programInfoAddStringFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, const char *value);
 
-static bool programInfoAddNsoSymbolsToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx);
+static bool programInfoAddNsoSymbolsToAuthoringToolXml(StringBuilder *xml_sb, ProgramInfoContext *program_info_ctx);
 static bool programInfoIsElfSymbolValid(u8 *dynsym_ptr, char *dynstr_base_ptr, u64 dynstr_size, bool is_64bit, char **symbol_str);
 
-static bool programInfoAddFsAccessControlDataToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx);
+static bool programInfoAddFsAccessControlDataToAuthoringToolXml(StringBuilder *xml_sb, ProgramInfoContext *program_info_ctx);
+
+static bool programInfoHashSetInitialize(ProgramInfoHashSet *set, u32 max_count);
+static bool programInfoHashSetInsert(ProgramInfoHashSet *set, u64 hash, u32 idx, const void *items, ProgramInfoHashSetCompareFunction cmp_func);
+static bool programInfoCompareApiEntries(const void *items, u32 idx_a, u32 idx_b);
+static bool programInfoCompareSymbols(const void *items, u32 idx_a, u32 idx_b);
+
+NX_INLINE void programInfoHashSetFree(ProgramInfoHashSet *set);
+NX_INLINE u64 programInfoCalculateFnv1aHash(u64 hash, const void *data, size_t size);
 
 bool programInfoInitializeContext(ProgramInfoContext *out, NcaContext *nca_ctx)
 {
@@ -68,8 +146,8 @@ bool programInfoInitializeContext(ProgramInfoContext *out, NcaContext *nca_ctx)
         return false;
     }
 
-    u32 i = 0, pfs_entry_count = 0, magic = 0;
-    NsoContext *tmp_nso_ctx = NULL;
+    u32 i = 0, pfs_entry_count = 0, magic = 0, nso_count = 0;
+    PartitionFileSystemEntry **nso_pfs_entries = NULL;
 
     bool success = false;
 
@@ -77,7 +155,7 @@ bool programInfoInitializeContext(ProgramInfoContext *out, NcaContext *nca_ctx)
     programInfoFreeContext(out);
 
     /* Initialize Partition FS context. */
-    if (!pfsInitializeContext(&(out->pfs_ctx), &(nca_ctx->fs_ctx[0])))
+    if (!pfsInitializeContext(&(out->pfs_ctx), ncaGetFsSectionContext(nca_ctx, 0)))
     {
         LOG_MSG_ERROR("Failed to initialize Partition FS context!");
         goto end;
@@ -104,7 +182,14 @@ bool programInfoInitializeContext(ProgramInfoContext *out, NcaContext *nca_ctx)
         goto end;
     }
 
-    /* Initialize NSO contexts. */
+    /* Allocate memory for the NSO Partition FS entry pointers. */
+    if (!(nso_pfs_entries = calloc(pfs_entry_count, sizeof(PartitionFileSystemEntry*))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for NSO Partition FS entry pointers!");
+        goto end;
+    }
+
+    /* Look for NSOs. */
     for(i = 0; i < pfs_entry_count; i++)
     {
         /* Skip the main.npdm entry, as well as any other entries without a NSO header. */
@@ -113,36 +198,19 @@ bool programInfoInitializeContext(ProgramInfoContext *out, NcaContext *nca_ctx)
         if (!pfs_entry || !pfs_entry_name || !strcmp(pfs_entry_name, "main.npdm") || !pfsReadEntryData(&(out->pfs_ctx), pfs_entry, &magic, sizeof(u32), 0) || \
             __builtin_bswap32(magic) != NSO_HEADER_MAGIC) continue;
 
-        /* Reallocate NSO context buffer. */
-        if (!(tmp_nso_ctx = realloc(out->nso_ctx, (out->nso_count + 1) * sizeof(NsoContext))))
-        {
-            LOG_MSG_ERROR("Failed to reallocate NSO context buffer for NSO \"%s\"! (entry #%u).", pfs_entry_name, i);
-            goto end;
-        }
-
-        out->nso_ctx = tmp_nso_ctx;
-        tmp_nso_ctx = NULL;
-
-        memset(&(out->nso_ctx[out->nso_count]), 0, sizeof(NsoContext));
-
-        /* Initialize NSO context. */
-        if (!nsoInitializeContext(&(out->nso_ctx[out->nso_count]), &(out->pfs_ctx), pfs_entry))
-        {
-            LOG_MSG_ERROR("Failed to initialize context for NSO \"%s\"! (entry #%u).", pfs_entry_name, i);
-            goto end;
-        }
-
-        /* Update NSO count. */
-        out->nso_count++;
+        nso_pfs_entries[nso_count++] = pfs_entry;
     }
 
     /* Safety check. */
-    if (!out->nso_count)
+    if (!nso_count)
     {
         LOG_MSG_ERROR("ExeFS has no NSOs!");
         goto end;
     }
 
+    /* Initialize NSO contexts. */
+    if (!programInfoInitializeNsoContexts(out, nso_pfs_entries, nso_count)) goto end;
+
     /* Update output context. */
     out->nca_ctx = nca_ctx;
 
@@ -153,6 +221,8 @@ bool programInfoInitializeContext(ProgramInfoContext *out, NcaContext *nca_ctx)
     success = true;
 
 end:
+    if (nso_pfs_entries) free(nso_pfs_entries);
+
     if (!success) programInfoFreeContext(out);
 
     return success;
@@ -166,8 +236,8 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
         return false;
     }
 
-    char *xml_buf = NULL;
-    u64 xml_buf_size = 0;
+    StringBuilder xml_sb = {0};
+    ProgramInfoApiEntryList api_entry_list = {0};
 
     char *sdk_version = NULL, *build_type = NULL;
     bool is_64bit = (program_info_ctx->npdm_ctx.meta_header->flags.is_64bit_instruction == 1);
@@ -208,11 +278,14 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
     /* Get SDK version and build type strings. */
     if (!programInfoGetSdkVersionAndBuildTypeFromSdkNso(program_info_ctx, &sdk_version, &build_type)) goto end;
 
+    /* Reserve enough space for most XMLs right away. */
+    if (!stringBuilderReserve(&xml_sb, PI_XML_BASE_SIZE_HINT + npdm_acid_b64_size)) goto end;
+
     if (!PI_ADD_FMT_STR_T1("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" \
                            "<ProgramInfo>\n")) goto end;
 
     /* SdkVersion. */
-    if (!programInfoAddStringFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, "SdkVersion", sdk_version)) goto end;
+    if (!programInfoAddStringFieldToAuthoringToolXml(&xml_sb, "SdkVersion", sdk_version)) goto end;
 
     if (!PI_ADD_FMT_STR_T1("  <ToolVersion />\n"                        /* Impossible to get. */ \
                            "  <NxAddonVersion>%s</NxAddonVersion>\n" \
@@ -222,7 +295,7 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
                            is_64bit ? 64 : 32)) goto end;
 
     /* BuildType. */
-    if (!programInfoAddStringFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, "BuildType", build_type)) goto end;
+    if (!programInfoAddStringFieldToAuthoringToolXml(&xml_sb, "BuildType", build_type)) goto end;
 
     if (!PI_ADD_FMT_STR_T1("  <EnableDeadStrip />\n"                                /* Impossible to get. */ \
                            "  <EnableDeadStripSpecified />\n"                       /* Impossible to get. */ \
@@ -236,23 +309,20 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
                            program_info_ctx->npdm_ctx.acid_header->flags.production ? g_trueString : g_falseString, \
                            program_info_ctx->npdm_ctx.acid_header->flags.unqualified_approval ? g_trueString : g_falseString)) goto end;
 
-    /* MiddlewareList. */
-    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx, "Middleware", "Module", "SDK MW")) goto end;
-
-    /* DebugApiList. */
-    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx, "DebugApi", "Api", "SDK Debug")) goto end;
+    /* Classify the SDK API entries from all NSOs in a single pass. */
+    if (!programInfoCollectNsoApiEntries(program_info_ctx, &api_entry_list)) goto end;
 
-    /* PrivateApiList. */
-    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx, "PrivateApi", "Api", "SDK Private")) goto end;
-
-    /* GuidelineApiList. */
-    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx, "GuidelineApi", "Api", "SDK Guideline")) goto end;
+    /* MiddlewareList, DebugApiList, PrivateApiList and GuidelineApiList. */
+    for(u8 i = 0; i < ProgramInfoApiListType_Count; i++)
+    {
+        if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_sb, program_info_ctx, &api_entry_list, i)) goto end;
+    }
 
     /* UnresolvedApiList. */
-    if (!programInfoAddNsoSymbolsToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx)) goto end;
+    if (!programInfoAddNsoSymbolsToAuthoringToolXml(&xml_sb, program_info_ctx)) goto end;
 
     /* FsAccessControlData. */
-    if (!programInfoAddFsAccessControlDataToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx)) goto end;
+    if (!programInfoAddFsAccessControlDataToAuthoringToolXml(&xml_sb, program_info_ctx)) goto end;
 
     if (!(success = PI_ADD_FMT_STR_T1("  <EnableGlobalDestructor />\n"          /* Impossible to get. */ \
                                       "  <EnableGlobalDestructorSpecified />\n" /* Impossible to get. */ \
@@ -263,10 +333,11 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
                                       "</ProgramInfo>"))) goto end;
 
     /* Update ProgramInfo context. */
-    program_info_ctx->authoring_tool_xml = xml_buf;
-    program_info_ctx->authoring_tool_xml_size = strlen(xml_buf);
+    program_info_ctx->authoring_tool_xml = stringBuilderDetach(&xml_sb, &(program_info_ctx->authoring_tool_xml_size));
 
 end:
+    if (api_entry_list.entries) free(api_entry_list.entries);
+
     if (npdm_acid_b64) free(npdm_acid_b64);
 
     if (build_type) free(build_type);
@@ -275,13 +346,76 @@ end:
 
     if (!success)
     {
-        if (xml_buf) free(xml_buf);
+        stringBuilderFree(&xml_sb);
         LOG_MSG_ERROR("Failed to generate ProgramInfo AuthoringTool XML!");
     }
 
     return success;
 }
 
+static bool programInfoInitializeNsoContexts(ProgramInfoContext *program_info_ctx, PartitionFileSystemEntry **pfs_entries, u32 nso_count)
+{
+    ProgramInfoNsoThreadData nso_thread_data = {0};
+    Thread nso_threads[PI_NSO_THREAD_COUNT - 1] = {0};
+    u32 nso_thread_count = 0;
+
+    /* Allocate memory for the NSO contexts. */
+    if (!(program_info_ctx->nso_ctx = calloc(nso_count, sizeof(NsoContext))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for %u NSO context(s)!", nso_count);
+        return false;
+    }
+
+    /* The NSO count is set right away, so programInfoFreeContext() takes care of every context -- even those that couldn't be initialized. */
+    program_info_ctx->nso_count = nso_count;
+
+    nso_thread_data.pfs_ctx = &(program_info_ctx->pfs_ctx);
+    nso_thread_data.pfs_entries = pfs_entries;
+    nso_thread_data.nso_ctx = program_info_ctx->nso_ctx;
+    nso_thread_data.nso_count = nso_count;
+    atomic_init(&(nso_thread_data.next_idx), 0);
+    atomic_init(&(nso_thread_data.failed), false);
+
+    /* Spawn additional threads to decompress NSO segments in parallel, using a different CPU core for each one. */
+    /* Everything is processed on the calling thread if they can't be created. */
+    for(u32 i = 0; i < MIN(nso_count - 1, PI_NSO_THREAD_COUNT - 1); i++)
+    {
+        if (!utilsCreateThread(&(nso_threads[i]), programInfoNsoThreadFunc, &nso_thread_data, (int)(i + 1))) break;
+        nso_thread_count++;
+    }
+
+    /* Process NSOs on the calling thread as well. */
+    programInfoProcessNsoContexts(&nso_thread_data);
+
+    for(u32 i = 0; i < nso_thread_count; i++) utilsJoinThread(&(nso_threads[i]));
+
+    return !atomic_load(&(nso_thread_data.failed));
+}
+
+static void programInfoProcessNsoContexts(ProgramInfoNsoThreadData *nso_thread_data)
+{
+    while(!atomic_load(&(nso_thread_data->failed)))
+    {
+        /* Pick the next NSO. */
+        u32 idx = atomic_fetch_add(&(nso_thread_data->next_idx), 1);
+        if (idx >= nso_thread_data->nso_count) break;
+
+        /* Initialize NSO context. */
+        PartitionFileSystemEntry *pfs_entry = nso_thread_data->pfs_entries[idx];
+        if (!nsoInitializeContext(&(nso_thread_data->nso_ctx[idx]), nso_thread_data->pfs_ctx, pfs_entry))
+        {
+            LOG_MSG_ERROR("Failed to initialize context for NSO \"%s\"!", pfsGetEntryName(nso_thread_data->pfs_ctx, pfs_entry));
+            atomic_store(&(nso_thread_data->failed), true);
+        }
+    }
+}
+
+static void programInfoNsoThreadFunc(void *arg)
+{
+    programInfoProcessNsoContexts((ProgramInfoNsoThreadData*)arg);
+    threadExit();
+}
+
 static bool programInfoGetSdkVersionAndBuildTypeFromSdkNso(ProgramInfoContext *program_info_ctx, char **sdk_version, char **build_type)
 {
     if (!program_info_ctx || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx || !sdk_version || !build_type)
@@ -358,53 +492,49 @@ end:
     return success;
 }
 
-static bool programInfoAddNsoApiListToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx, const char *api_list_tag, const char *api_entry_prefix, \
-                                                       const char *sdk_prefix)
+static bool programInfoCollectNsoApiEntries(ProgramInfoContext *program_info_ctx, ProgramInfoApiEntryList *out)
 {
-    size_t sdk_prefix_len = 0;
-    int sdk_entry_vender_len = 0;
-    char *sdk_entry = NULL, *sdk_entry_vender = NULL, *sdk_entry_name = NULL;
-    bool success = false, api_list_exists = false;
-
-    if (!xml_buf || !xml_buf_size || !program_info_ctx || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx || !api_list_tag || !*api_list_tag || !api_entry_prefix || \
-        !*api_entry_prefix || !sdk_prefix || !(sdk_prefix_len = strlen(sdk_prefix)))
+    if (!program_info_ctx || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx || !out)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    /* Check if any entries for this API list exist. */
+    u64 max_entry_count = 0;
+    ProgramInfoHashSet entry_set = {0};
+    bool success = false;
+
+    memset(out, 0, sizeof(ProgramInfoApiEntryList));
+
+    /* Get an upper bound for the number of API entries. */
     for(u32 i = 0; i < program_info_ctx->nso_count; i++)
     {
         NsoContext *nso_ctx = &(program_info_ctx->nso_ctx[i]);
         if (!nso_ctx->nso_filename || !*(nso_ctx->nso_filename) || !nso_ctx->rodata_api_info_section || !nso_ctx->rodata_api_info_section_size) continue;
+        max_entry_count += ((nso_ctx->rodata_api_info_section_size / PI_API_ENTRY_MIN_SIZE) + 1);
+    }
 
-        for(u64 j = 0; j < nso_ctx->rodata_api_info_section_size; j++)
-        {
-            sdk_entry = (nso_ctx->rodata_api_info_section + j);
-
-            if (programInfoIsApiInfoEntryValid(sdk_prefix, sdk_prefix_len, sdk_entry, &sdk_entry_vender, NULL, &sdk_entry_name, false))
-            {
-                api_list_exists = true;
-                break;
-            }
-
-            j += strlen(sdk_entry);
-        }
+    /* Bail out early if there's nothing to classify. */
+    if (!max_entry_count) return true;
 
-        if (api_list_exists) break;
+    if (max_entry_count > (UINT32_MAX / 2))
+    {
+        LOG_MSG_ERROR("Invalid API entry count! (0x%lX).", max_entry_count);
+        return false;
     }
 
-    /* Append an empty XML element if no entries for this API list exist. */
-    if (!api_list_exists)
+    /* Allocate memory for the API entries. */
+    out->entries = calloc(max_entry_count, sizeof(ProgramInfoApiEntry));
+    if (!out->entries)
     {
-        success = PI_ADD_FMT_STR_T2("  <%sList />\n", api_list_tag);
+        LOG_MSG_ERROR("Failed to allocate memory for 0x%lX API entries!", max_entry_count);
         goto end;
     }
 
-    if (!PI_ADD_FMT_STR_T2("  <%sList>\n", api_list_tag)) goto end;
+    /* Initialize hash set. */
+    if (!programInfoHashSetInitialize(&entry_set, (u32)max_entry_count)) goto end;
 
-    /* Retrieve full API list. */
+    /* Validate and classify every entry only once. */
     for(u32 i = 0; i < program_info_ctx->nso_count; i++)
     {
         NsoContext *nso_ctx = &(program_info_ctx->nso_ctx[i]);
@@ -412,32 +542,84 @@ static bool programInfoAddNsoApiListToAuthoringToolXml(char **xml_buf, u64 *xml_
 
         for(u64 j = 0; j < nso_ctx->rodata_api_info_section_size; j++)
         {
-            sdk_entry = (nso_ctx->rodata_api_info_section + j);
+            char *sdk_entry = (nso_ctx->rodata_api_info_section + j);
+            ProgramInfoApiEntry *entry = &(out->entries[out->count]);
 
-            if (programInfoIsApiInfoEntryValid(sdk_prefix, sdk_prefix_len, sdk_entry, &sdk_entry_vender, &sdk_entry_vender_len, &sdk_entry_name, false))
+            for(u8 k = 0; k < ProgramInfoApiListType_Count; k++)
             {
-                if (!PI_ADD_FMT_STR_T2("    <%s>\n" \
-                                       "      <%sName>%s</%sName>\n" \
-                                       "      <VenderName>%.*s</VenderName>\n" \
-                                       "      <NsoName>%s</NsoName>\n" \
-                                       "    </%s>\n", \
-                                       api_list_tag, \
-                                       api_entry_prefix, sdk_entry_name, api_entry_prefix, \
-                                       sdk_entry_vender_len, sdk_entry_vender, \
-                                       nso_ctx->nso_filename, \
-                                       api_list_tag)) goto end;
+                const ProgramInfoApiListInfo *list_info = &(g_programInfoApiListInfo[k]);
+
+                if (!programInfoIsApiInfoEntryValid(list_info->sdk_prefix, list_info->sdk_prefix_len, sdk_entry, &(entry->vender), &(entry->vender_len), &(entry->name), false)) continue;
+
+                entry->nso_idx = i;
+                entry->type = k;
+
+                /* Duplicate entries from the same NSO would just generate identical XML elements. */
+                u64 hash = programInfoCalculateFnv1aHash(PI_FNV1A_OFFSET_BASIS, entry->name, strlen(entry->name));
+                hash = programInfoCalculateFnv1aHash(hash, entry->vender, (size_t)entry->vender_len);
+                hash = programInfoCalculateFnv1aHash(hash, &(entry->nso_idx), sizeof(entry->nso_idx));
+                hash = programInfoCalculateFnv1aHash(hash, &(entry->type), sizeof(entry->type));
+
+                if (programInfoHashSetInsert(&entry_set, hash, out->count, out->entries, &programInfoCompareApiEntries)) out->count++;
+
+                break;
             }
 
             j += strlen(sdk_entry);
         }
     }
 
-    success = PI_ADD_FMT_STR_T2("  </%sList>\n", api_list_tag);
+    success = true;
 
 end:
+    programInfoHashSetFree(&entry_set);
+
+    if (!success && out->entries)
+    {
+        free(out->entries);
+        memset(out, 0, sizeof(ProgramInfoApiEntryList));
+    }
+
     return success;
 }
 
+static bool programInfoAddNsoApiListToAuthoringToolXml(StringBuilder *xml_sb, ProgramInfoContext *program_info_ctx, const ProgramInfoApiEntryList *api_entry_list, u8 type)
+{
+    if (!xml_sb || !program_info_ctx || !program_info_ctx->nso_ctx || !api_entry_list || (api_entry_list->count && !api_entry_list->entries) || type >= ProgramInfoApiListType_Count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    const ProgramInfoApiListInfo *list_info = &(g_programInfoApiListInfo[type]);
+    const char *api_list_tag = list_info->list_tag, *api_entry_prefix = list_info->entry_prefix;
+    bool api_list_exists = false;
+
+    for(u32 i = 0; i < api_entry_list->count; i++)
+    {
+        const ProgramInfoApiEntry *entry = &(api_entry_list->entries[i]);
+        if (entry->type != type) continue;
+
+        if (!api_list_exists)
+        {
+            if (!PI_ADD_FMT_STR_T2("  <%sList>\n", api_list_tag)) return false;
+            api_list_exists = true;
+        }
+
+        /* Build this element piece by piece to avoid going through printf for every single entry. */
+        if (!stringBuilderAppend(xml_sb, "    <") || !stringBuilderAppend(xml_sb, api_list_tag) || \
+            !stringBuilderAppend(xml_sb, ">\n      <") || !stringBuilderAppend(xml_sb, api_entry_prefix) || !stringBuilderAppend(xml_sb, "Name>") || \
+            !stringBuilderAppend(xml_sb, entry->name) || \
+            !stringBuilderAppend(xml_sb, "</") || !stringBuilderAppend(xml_sb, api_entry_prefix) || !stringBuilderAppend(xml_sb, "Name>\n      <VenderName>") || \
+            !stringBuilderAppendWithLength(xml_sb, entry->vender, (size_t)entry->vender_len) || \
+            !stringBuilderAppend(xml_sb, "</VenderName>\n      <NsoName>") || !stringBuilderAppend(xml_sb, program_info_ctx->nso_ctx[entry->nso_idx].nso_filename) || \
+            !stringBuilderAppend(xml_sb, "</NsoName>\n    </") || !stringBuilderAppend(xml_sb, api_list_tag) || !stringBuilderAppend(xml_sb, ">\n")) return false;
+    }
+
+    /* Append an empty XML element if no entries for this API list exist. */
+    return (api_list_exists ? PI_ADD_FMT_STR_T2("  </%sList>\n", api_list_tag) : PI_ADD_FMT_STR_T2("  <%sList />\n", api_list_tag));
+}
+
 static bool programInfoIsApiInfoEntryValid(const char *sdk_prefix, size_t sdk_prefix_len, char *sdk_entry, char **sdk_entry_vender, int *sdk_entry_vender_len, char **sdk_entry_name, bool nnsdk)
 {
     if (!sdk_prefix || !sdk_prefix_len || !sdk_entry || !sdk_entry_vender || !sdk_entry_name || strncmp(sdk_entry, sdk_prefix, sdk_prefix_len) != 0) return false;
@@ -458,9 +640,9 @@ static bool programInfoIsApiInfoEntryValid(const char *sdk_prefix, size_t sdk_pr
     return true;
 }
 
-static bool programInfoAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const char *value)
+static bool programInfoAddStringFieldToAuthoringToolXml(StringBuilder *xml_sb, const char *tag_name, const char *value)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name)
+    if (!xml_sb || !tag_name || !*tag_name)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -469,19 +651,22 @@ static bool programInfoAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml
     return ((value && *value) ? PI_ADD_FMT_STR_T2("  <%s>%s</%s>\n", tag_name, value, tag_name) : PI_ADD_FMT_STR_T2("  <%s />\n", tag_name));
 }
 
-static bool programInfoAddNsoSymbolsToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx)
+static bool programInfoAddNsoSymbolsToAuthoringToolXml(StringBuilder *xml_sb, ProgramInfoContext *program_info_ctx)
 {
-    if (!xml_buf || !xml_buf_size || !program_info_ctx || !program_info_ctx->npdm_ctx.meta_header || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx)
+    if (!xml_sb || !program_info_ctx || !program_info_ctx->npdm_ctx.meta_header || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
     NsoContext *nso_ctx = NULL;
-    bool success = false, symbols_exist = false, is_64bit = (program_info_ctx->npdm_ctx.meta_header->flags.is_64bit_instruction == 1);
+    bool success = false, empty_list = false, is_64bit = (program_info_ctx->npdm_ctx.meta_header->flags.is_64bit_instruction == 1);
+
+    char **symbols = NULL;
+    u32 symbol_count = 0;
+    u64 symbol_size = (!is_64bit ? sizeof(Elf32Symbol) : sizeof(Elf64Symbol)), max_symbol_count = 0;
 
-    char *symbol_str = NULL;
-    u64 symbol_size = (!is_64bit ? sizeof(Elf32Symbol) : sizeof(Elf64Symbol));
+    ProgramInfoHashSet symbol_set = {0};
 
     /* Locate "main" NSO. */
     for(u32 i = 0; i < program_info_ctx->nso_count; i++)
@@ -493,45 +678,70 @@ static bool programInfoAddNsoSymbolsToAuthoringToolXml(char **xml_buf, u64 *xml_
     }
 
     /* Check if we found the "main" NSO. */
-    if (!nso_ctx) goto end;
+    max_symbol_count = (nso_ctx ? (nso_ctx->rodata_dynsym_section_size / symbol_size) : 0);
+    if (!max_symbol_count)
+    {
+        empty_list = true;
+        goto end;
+    }
 
-    /* Check if any symbols matching the required filters exist. */
-    for(u64 i = 0; i < nso_ctx->rodata_dynsym_section_size; i += symbol_size)
+    if (max_symbol_count > (UINT32_MAX / 2))
     {
-        if ((nso_ctx->rodata_dynsym_section_size - i) < symbol_size) break;
+        LOG_MSG_ERROR("Invalid ELF symbol count! (0x%lX).", max_symbol_count);
+        goto end;
+    }
 
-        if (programInfoIsElfSymbolValid(nso_ctx->rodata_dynsym_section + i, nso_ctx->rodata_dynstr_section, nso_ctx->rodata_dynstr_section_size, is_64bit, NULL))
-        {
-            symbols_exist = true;
-            break;
-        }
+    /* Allocate memory for the symbol string pointers. */
+    symbols = calloc(max_symbol_count, sizeof(char*));
+    if (!symbols)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for 0x%lX ELF symbols!", max_symbol_count);
+        goto end;
     }
 
-    /* Bail out if we couldn't find any valid symbols. */
-    if (!symbols_exist) goto end;
+    /* Initialize hash set. */
+    if (!programInfoHashSetInitialize(&symbol_set, (u32)max_symbol_count)) goto end;
 
-    if (!PI_ADD_FMT_STR_T2("  <UnresolvedApiList>\n")) goto end;
+    /* Parse ELF dynamic symbol table to retrieve the symbol strings. Each symbol is only validated once, and duplicate strings are discarded. */
+    for(u64 i = 0; i < max_symbol_count; i++)
+    {
+        char *symbol_str = NULL;
 
-    /* Parse ELF dynamic symbol table to retrieve the symbol strings. */
-    for(u64 i = 0; i < nso_ctx->rodata_dynsym_section_size; i += symbol_size)
+        if (!programInfoIsElfSymbolValid(nso_ctx->rodata_dynsym_section + (i * symbol_size), nso_ctx->rodata_dynstr_section, nso_ctx->rodata_dynstr_section_size, is_64bit, \
+                                         &symbol_str)) continue;
+
+        symbols[symbol_count] = symbol_str;
+
+        u64 hash = programInfoCalculateFnv1aHash(PI_FNV1A_OFFSET_BASIS, symbol_str, strlen(symbol_str));
+        if (programInfoHashSetInsert(&symbol_set, hash, symbol_count, symbols, &programInfoCompareSymbols)) symbol_count++;
+    }
+
+    /* Bail out if we couldn't find any valid symbols. */
+    if (!symbol_count)
     {
-        if ((nso_ctx->rodata_dynsym_section_size - i) < symbol_size) break;
+        empty_list = true;
+        goto end;
+    }
 
-        if (!programInfoIsElfSymbolValid(nso_ctx->rodata_dynsym_section + i, nso_ctx->rodata_dynstr_section, nso_ctx->rodata_dynstr_section_size, is_64bit, &symbol_str)) continue;
+    if (!PI_ADD_FMT_STR_T2("  <UnresolvedApiList>\n")) goto end;
 
-        if (!PI_ADD_FMT_STR_T2("    <UnresolvedApi>\n" \
-                               "      <ApiName>%s</ApiName>\n" \
-                               "      <NsoName>%s</NsoName>\n" \
-                               "    </UnresolvedApi>\n", \
-                               symbol_str, \
-                               nso_ctx->nso_filename)) goto end;
+    for(u32 i = 0; i < symbol_count; i++)
+    {
+        /* Build this element piece by piece to avoid going through printf for every single symbol. */
+        if (!stringBuilderAppend(xml_sb, "    <UnresolvedApi>\n      <ApiName>") || !stringBuilderAppend(xml_sb, symbols[i]) || \
+            !stringBuilderAppend(xml_sb, "</ApiName>\n      <NsoName>") || !stringBuilderAppend(xml_sb, nso_ctx->nso_filename) || \
+            !stringBuilderAppend(xml_sb, "</NsoName>\n    </UnresolvedApi>\n")) goto end;
     }
 
     success = PI_ADD_FMT_STR_T2("  </UnresolvedApiList>\n");
 
 end:
+    programInfoHashSetFree(&symbol_set);
+
+    if (symbols) free(symbols);
+
     /* Append an empty XML element if no valid symbols exist. */
-    if (!success && (!nso_ctx || !symbols_exist)) success = PI_ADD_FMT_STR_T2("  <UnresolvedApiList />\n");
+    if (empty_list) success = PI_ADD_FMT_STR_T2("  <UnresolvedApiList />\n");
 
     return success;
 }
@@ -561,14 +771,14 @@ static bool programInfoIsElfSymbolValid(u8 *dynsym_ptr, char *dynstr_base_ptr, u
     return is_valid;
 }
 
-static bool programInfoAddFsAccessControlDataToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx)
+static bool programInfoAddFsAccessControlDataToAuthoringToolXml(StringBuilder *xml_sb, ProgramInfoContext *program_info_ctx)
 {
     NpdmFsAccessControlData *aci_fac_data = NULL;
     NpdmFsAccessControlDataSaveDataOwnerBlock *save_data_owner_block = NULL;
     u64 *save_data_owner_ids = NULL;
     bool success = false, sdo_data_available = false;
 
-    if (!xml_buf || !xml_buf_size || !program_info_ctx || !(aci_fac_data = program_info_ctx->npdm_ctx.aci_fac_data))
+    if (!xml_sb || !program_info_ctx || !(aci_fac_data = program_info_ctx->npdm_ctx.aci_fac_data))
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -611,3 +821,75 @@ end:
 
     return success;
 }
+
+static bool programInfoHashSetInitialize(ProgramInfoHashSet *set, u32 max_count)
+{
+    if (!set || !max_count || max_count > (UINT32_MAX / 2))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Keep the load factor at 50% or less. */
+    u32 capacity = PI_HASH_SET_MIN_CAPACITY;
+    while(capacity < (max_count * 2)) capacity <<= 1;
+
+    set->slots = calloc(capacity, sizeof(u32));
+    if (!set->slots)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for a 0x%X-slot hash set!", capacity);
+        return false;
+    }
+
+    set->mask = (capacity - 1);
+
+    return true;
+}
+
+static bool programInfoHashSetInsert(ProgramInfoHashSet *set, u64 hash, u32 idx, const void *items, ProgramInfoHashSetCompareFunction cmp_func)
+{
+    u32 slot = (u32)(hash & set->mask);
+
+    /* Linear probing. Returns false if an equal item is already stored in the set. */
+    while(set->slots[slot])
+    {
+        if (cmp_func(items, set->slots[slot] - 1, idx)) return false;
+        slot = ((slot + 1) & set->mask);
+    }
+
+    set->slots[slot] = (idx + 1);
+
+    return true;
+}
+
+static bool programInfoCompareApiEntries(const void *items, u32 idx_a, u32 idx_b)
+{
+    const ProgramInfoApiEntry *a = &(((const ProgramInfoApiEntry*)items)[idx_a]), *b = &(((const ProgramInfoApiEntry*)items)[idx_b]);
+    return (a->type == b->type && a->nso_idx == b->nso_idx && a->vender_len == b->vender_len && !strncmp(a->vender, b->vender, (size_t)a->vender_len) && !strcmp(a->name, b->name));
+}
+
+static bool programInfoCompareSymbols(const void *items, u32 idx_a, u32 idx_b)
+{
+    const char * const *symbols = (const char * const*)items;
+    return !strcmp(symbols[idx_a], symbols[idx_b]);
+}
+
+NX_INLINE void programInfoHashSetFree(ProgramInfoHashSet *set)
+{
+    if (!set) return;
+    if (set->slots) free(set->slots);
+    memset(set, 0, sizeof(ProgramInfoHashSet));
+}
+
+NX_INLINE u64 programInfoCalculateFnv1aHash(u64 hash, const void *data, size_t size)
+{
+    const u8 *data_u8 = (const u8*)data;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= data_u8[i];
+        hash *= PI_FNV1A_PRIME;
+    }
+
+    return hash;
+}
@@ -26,243 +26,126 @@
 
 #define ROMFS_ENTRY_OFFSET(entry, table) (u32)((uintptr_t)entry - (uintptr_t)table)
 
+#define ROMFS_TABLE_PAGE_BUFFER_SIZE    (ROMFS_TABLE_PAGE_SIZE + ROMFS_TABLE_PAGE_OVERLAP)
+
+#define ROMFS_ENTRY_HASH_SEED           123456789
+#define ROMFS_PATH_INDEX_MAX_DEPTH      0x100
+
+/* Type definitions. */
+
+typedef struct {
+    u64 physical_offset;
+    u32 file_entry_offset;
+} RomFileSystemReadPlanEntry;
+
 /* Function prototypes. */
 
+static bool romfsInitializeContextInternal(RomFileSystemContext *out, NcaFsSectionContext *base_nca_fs_ctx, NcaFsSectionContext *patch_nca_fs_ctx, bool paged);
+static RomFileSystemTablePageCache *romfsAllocateTablePageCache(u64 table_offset);
+static u32 romfsGetDirectoryEntryOffset(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry);
+
 static RomFileSystemDirectoryEntry *romfsGetChildDirectoryEntryByName(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry, const char *name);
 static RomFileSystemFileEntry *romfsGetChildFileEntryByName(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry, const char *name);
 
 static u32 romfsCalculateEntryHash(RomFileSystemContext *ctx, u32 parent_offset, const char *name, size_t name_len, bool is_file);
+NX_INLINE u32 romfsUpdateEntryHash(u32 hash, const char *name, size_t name_len);
+
+static bool romfsInitializePathIndex(RomFileSystemPathIndex *index, u64 table_size, u64 entry_size);
+static bool romfsAddDirectoryToPathIndex(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry, u32 path_hash, u32 depth);
+static void romfsInsertPathIndexEntry(RomFileSystemPathIndex *index, u32 hash, u32 offset);
+static void *romfsLookupPathIndex(RomFileSystemContext *ctx, const char *path, bool is_file);
+static bool romfsIsEntryPathMatch(RomFileSystemContext *ctx, u32 parent_offset, const char *name, u32 name_len, const char *path, size_t path_len);
+static bool romfsIsCanonicalPath(const char *path);
+
+static bool romfsAppendPathElement(char *out_path, size_t out_path_size, size_t *path_len, const char *name, u32 name_len, bool add_separator, u8 illegal_char_replace_type);
+
+static int romfsReadPlanEntrySortFunction(const void *a, const void *b);
+
+static bool romfsQueryExtents(RomFileSystemContext *ctx, StorageExtentList *out, u64 size, u64 offset, u64 base_offset);
 
 bool romfsInitializeContext(RomFileSystemContext *out, NcaFsSectionContext *base_nca_fs_ctx, NcaFsSectionContext *patch_nca_fs_ctx)
 {
-    u64 dir_bucket_offset = 0, dir_table_offset = 0;
-    u64 file_bucket_offset = 0, file_table_offset = 0;
-    NcaContext *base_nca_ctx = NULL, *patch_nca_ctx = NULL;
-    bool dump_fs_header = false, success = false;
+    return romfsInitializeContextInternal(out, base_nca_fs_ctx, patch_nca_fs_ctx, false);
+}
 
-    /* Check if the base RomFS is missing (e.g. Fortnite, World of Tanks Blitz, etc.). */
-    bool missing_base_romfs = (!base_nca_fs_ctx || !base_nca_fs_ctx->enabled || (base_nca_fs_ctx->section_type != NcaFsSectionType_RomFs && \
-                               base_nca_fs_ctx->section_type != NcaFsSectionType_Nca0RomFs));
+bool romfsInitializePagedContext(RomFileSystemContext *out, NcaFsSectionContext *base_nca_fs_ctx, NcaFsSectionContext *patch_nca_fs_ctx)
+{
+    return romfsInitializeContextInternal(out, base_nca_fs_ctx, patch_nca_fs_ctx, true);
+}
 
-    if (!out || (!patch_nca_fs_ctx && (missing_base_romfs || base_nca_fs_ctx->has_sparse_layer)) || \
-        (!missing_base_romfs && (!(base_nca_ctx = base_nca_fs_ctx->nca_ctx) || (base_nca_ctx->format_version == NcaVersion_Nca0 && \
-        (base_nca_fs_ctx->section_type != NcaFsSectionType_Nca0RomFs || base_nca_fs_ctx->hash_type != NcaHashType_HierarchicalSha256)) || \
-        (base_nca_ctx->format_version != NcaVersion_Nca0 && (base_nca_fs_ctx->section_type != NcaFsSectionType_RomFs || \
-        (base_nca_fs_ctx->hash_type != NcaHashType_HierarchicalIntegrity && base_nca_fs_ctx->hash_type != NcaHashType_HierarchicalIntegritySha3))) || \
-        (base_nca_ctx->rights_id_available && !base_nca_ctx->titlekey_retrieved))) || (patch_nca_fs_ctx && (!patch_nca_fs_ctx->enabled || \
-        !(patch_nca_ctx = patch_nca_fs_ctx->nca_ctx) || (!missing_base_romfs && patch_nca_ctx->format_version != base_nca_ctx->format_version) || \
-        patch_nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs || (patch_nca_ctx->rights_id_available && !patch_nca_ctx->titlekey_retrieved))))
+bool romfsReadFileSystemData(RomFileSystemContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    if (!romfsIsValidContext(ctx) || !out || !read_size || (offset + read_size) > ctx->size)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    /* Free output context beforehand. */
-    romfsFreeContext(out);
-
-    NcaStorageContext *base_storage_ctx = &(out->storage_ctx[0]), *patch_storage_ctx = &(out->storage_ctx[1]);
-    bool is_nca0_romfs = (base_nca_fs_ctx && base_nca_fs_ctx->section_type == NcaFsSectionType_Nca0RomFs);
+    /* Read filesystem data. Big reads are split into smaller chunks if a cancellation token has been bound to the calling thread. */
+    u64 chunk_size = (cancelTokenIsCurrentBound() ? CANCEL_TOKEN_CHUNK_SIZE : read_size);
 
-    /* Initialize base NCA storage context. */
-    if (!missing_base_romfs && !ncaStorageInitializeContext(base_storage_ctx, base_nca_fs_ctx, NULL))
+    for(u64 cur_offset = 0, cur_size = 0; cur_offset < read_size; cur_offset += cur_size)
     {
-        LOG_MSG_ERROR("Failed to initialize base NCA storage context!");
-        goto end;
-    }
+        cur_size = MIN(chunk_size, read_size - cur_offset);
 
-    if (patch_nca_fs_ctx)
-    {
-        /* Initialize base NCA storage context. */
-        if (!ncaStorageInitializeContext(patch_storage_ctx, patch_nca_fs_ctx, missing_base_romfs ? NULL : base_storage_ctx))
+        if (cancelTokenIsCurrentCancelled())
         {
-            LOG_MSG_ERROR("Failed to initialize patch NCA storage context!");
-            goto end;
+            LOG_MSG_DEBUG("RomFS read cancelled at offset 0x%lX.", offset + cur_offset);
+            return false;
         }
 
-        /* Set default NCA FS storage context. */
-        out->is_patch = true;
-        out->default_storage_ctx = patch_storage_ctx;
-    } else {
-        /* Set default NCA FS storage context. */
-        out->is_patch = false;
-        out->default_storage_ctx = base_storage_ctx;
-    }
-
-    /* Get RomFS offset and size. */
-    if (!ncaStorageGetHashTargetExtents(out->default_storage_ctx, &(out->offset), &(out->size)))
-    {
-        LOG_MSG_ERROR("Failed to get target hash layer extents!");
-        goto end;
-    }
-
-    /* Read RomFS header. */
-    if (!ncaStorageRead(out->default_storage_ctx, &(out->header), sizeof(RomFileSystemHeader), out->offset))
-    {
-        LOG_MSG_ERROR("Failed to read RomFS header!");
-        goto end;
-    }
-
-    if ((is_nca0_romfs && out->header.old_format.header_size != ROMFS_OLD_HEADER_SIZE) || (!is_nca0_romfs && out->header.cur_format.header_size != ROMFS_HEADER_SIZE))
-    {
-        LOG_MSG_ERROR("Invalid RomFS header size!");
-        dump_fs_header = true;
-        goto end;
-    }
-
-    /* Read directory bucket. */
-    dir_bucket_offset = (is_nca0_romfs ? (u64)out->header.old_format.directory_bucket_offset : out->header.cur_format.directory_bucket_offset);
-    out->dir_bucket_size = (is_nca0_romfs ? (u64)out->header.old_format.directory_bucket_size : out->header.cur_format.directory_bucket_size);
-
-    if (!out->dir_bucket_size || (dir_bucket_offset + out->dir_bucket_size) > out->size)
-    {
-        LOG_MSG_ERROR("Invalid RomFS directory bucket!");
-        dump_fs_header = true;
-        goto end;
-    }
-
-    out->dir_bucket = malloc(out->dir_bucket_size);
-    if (!out->dir_bucket)
-    {
-        LOG_MSG_ERROR("Unable to allocate memory for RomFS directory bucket!");
-        goto end;
-    }
-
-    if (!ncaStorageRead(out->default_storage_ctx, out->dir_bucket, out->dir_bucket_size, out->offset + dir_bucket_offset))
-    {
-        LOG_MSG_ERROR("Failed to read RomFS directory bucket!");
-        goto end;
-    }
-
-    /* Read directory entries table. */
-    dir_table_offset = (is_nca0_romfs ? (u64)out->header.old_format.directory_entry_offset : out->header.cur_format.directory_entry_offset);
-    out->dir_table_size = (is_nca0_romfs ? (u64)out->header.old_format.directory_entry_size : out->header.cur_format.directory_entry_size);
-
-    if (!out->dir_table_size || (dir_table_offset + out->dir_table_size) > out->size)
-    {
-        LOG_MSG_ERROR("Invalid RomFS directory entries table!");
-        dump_fs_header = true;
-        goto end;
-    }
-
-    out->dir_table = malloc(out->dir_table_size);
-    if (!out->dir_table)
-    {
-        LOG_MSG_ERROR("Unable to allocate memory for RomFS directory entries table!");
-        goto end;
-    }
-
-    if (!ncaStorageRead(out->default_storage_ctx, out->dir_table, out->dir_table_size, out->offset + dir_table_offset))
-    {
-        LOG_MSG_ERROR("Failed to read RomFS directory entries table!");
-        goto end;
-    }
-
-    /* Read file bucket. */
-    file_bucket_offset = (is_nca0_romfs ? (u64)out->header.old_format.file_bucket_offset : out->header.cur_format.file_bucket_offset);
-    out->file_bucket_size = (is_nca0_romfs ? (u64)out->header.old_format.file_bucket_size : out->header.cur_format.file_bucket_size);
-
-    if (!out->file_bucket_size || (file_bucket_offset + out->file_bucket_size) > out->size)
-    {
-        LOG_MSG_ERROR("Invalid RomFS file bucket!");
-        dump_fs_header = true;
-        goto end;
-    }
-
-    out->file_bucket = malloc(out->file_bucket_size);
-    if (!out->file_bucket)
-    {
-        LOG_MSG_ERROR("Unable to allocate memory for RomFS file bucket!");
-        goto end;
-    }
-
-    if (!ncaStorageRead(out->default_storage_ctx, out->file_bucket, out->file_bucket_size, out->offset + file_bucket_offset))
-    {
-        LOG_MSG_ERROR("Failed to read RomFS file bucket!");
-        goto end;
-    }
-
-    /* Read file entries table. */
-    file_table_offset = (is_nca0_romfs ? (u64)out->header.old_format.file_entry_offset : out->header.cur_format.file_entry_offset);
-    out->file_table_size = (is_nca0_romfs ? (u64)out->header.old_format.file_entry_size : out->header.cur_format.file_entry_size);
-
-    if (!out->file_table_size || (file_table_offset + out->file_table_size) > out->size)
-    {
-        LOG_MSG_ERROR("Invalid RomFS file entries table!");
-        dump_fs_header = true;
-        goto end;
-    }
-
-    out->file_table = malloc(out->file_table_size);
-    if (!out->file_table)
-    {
-        LOG_MSG_ERROR("Unable to allocate memory for RomFS file entries table!");
-        goto end;
-    }
-
-    if (!ncaStorageRead(out->default_storage_ctx, out->file_table, out->file_table_size, out->offset + file_table_offset))
-    {
-        LOG_MSG_ERROR("Failed to read RomFS file entries table!");
-        goto end;
-    }
-
-    /* Get file data body offset. */
-    out->body_offset = (is_nca0_romfs ? (u64)out->header.old_format.body_offset : out->header.cur_format.body_offset);
-    if (out->body_offset >= out->size)
-    {
-        LOG_MSG_ERROR("Invalid RomFS file data body!");
-        dump_fs_header = true;
-        goto end;
-    }
-
-    /* Update flag. */
-    success = true;
-
-end:
-    if (!success)
-    {
-        if (dump_fs_header) LOG_DATA_DEBUG(&(out->header), sizeof(RomFileSystemHeader), "RomFS header dump:");
-
-        romfsFreeContext(out);
+        if (!ncaStorageRead(ctx->default_storage_ctx, (u8*)out + cur_offset, cur_size, ctx->offset + offset + cur_offset))
+        {
+            LOG_MSG_ERROR("Failed to read RomFS data!");
+            return false;
+        }
     }
 
-    return success;
+    return true;
 }
 
-bool romfsReadFileSystemData(RomFileSystemContext *ctx, void *out, u64 read_size, u64 offset)
+bool romfsReadFileEntryData(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, void *out, u64 read_size, u64 offset)
 {
-    if (!romfsIsValidContext(ctx) || !out || !read_size || (offset + read_size) > ctx->size)
+    if (!romfsIsValidContext(ctx) || !file_entry || !file_entry->size || (file_entry->offset + file_entry->size) > ctx->size || !out || !read_size || \
+        (offset + read_size) > file_entry->size)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    /* Read filesystem data. */
-    if (!ncaStorageRead(ctx->default_storage_ctx, out, read_size, ctx->offset + offset))
+    /* Read entry data. */
+    if (!romfsReadFileSystemData(ctx, out, read_size, ctx->body_offset + file_entry->offset + offset))
     {
-        LOG_MSG_ERROR("Failed to read RomFS data!");
+        LOG_MSG_ERROR("Failed to read RomFS file entry data!");
         return false;
     }
 
     return true;
 }
 
-bool romfsReadFileEntryData(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, void *out, u64 read_size, u64 offset)
+bool romfsQueryFileSystemDataExtents(RomFileSystemContext *ctx, StorageExtentList *out, u64 size, u64 offset)
 {
-    if (!romfsIsValidContext(ctx) || !file_entry || !file_entry->size || (file_entry->offset + file_entry->size) > ctx->size || !out || !read_size || \
-        (offset + read_size) > file_entry->size)
+    if (!romfsIsValidContext(ctx) || !out || !size || (offset + size) > ctx->size)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    /* Read entry data. */
-    if (!romfsReadFileSystemData(ctx, out, read_size, ctx->body_offset + file_entry->offset + offset))
+    return romfsQueryExtents(ctx, out, size, offset, 0);
+}
+
+bool romfsQueryFileEntryExtents(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, StorageExtentList *out, u64 size, u64 offset)
+{
+    if (!romfsIsValidContext(ctx) || !file_entry || !file_entry->size || (file_entry->offset + file_entry->size) > ctx->size || !out || !size || \
+        (offset + size) > file_entry->size)
     {
-        LOG_MSG_ERROR("Failed to read RomFS file entry data!");
+        LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    return true;
+    u64 base_offset = (ctx->body_offset + file_entry->offset);
+
+    return romfsQueryExtents(ctx, out, size, base_offset + offset, base_offset);
 }
 
 bool romfsGetTotalDataSize(RomFileSystemContext *ctx, bool only_updated, u64 *out_size)
@@ -289,8 +172,8 @@ bool romfsGetTotalDataSize(RomFileSystemContext *ctx, bool only_updated, u64 *ou
             goto end;
         }
 
-        /* Update total data size, taking into account the only_updated flag. */
-        if (only_updated && !romfsIsFileEntryUpdated(ctx, file_entry, &updated))
+        /* Update total data size, taking into account the only_updated flag. Empty file entries can't be checked, but they don't add anything to the total size anyway. */
+        if (only_updated && file_entry->size && !romfsIsFileEntryUpdated(ctx, file_entry, &updated))
         {
             LOG_MSG_ERROR("Failed to determine if file entry is updated or not! (0x%lX, 0x%lX).", cur_entry_offset, ctx->file_table_size);
             goto end;
@@ -359,6 +242,9 @@ bool romfsGetDirectoryDataSize(RomFileSystemContext *ctx, RomFileSystemDirectory
             goto end;
         }
 
+        /* Save the next directory entry offset. Entry pointers may be invalidated by the recursive call if we're dealing with a paged context. */
+        u64 next_entry_offset = cur_dir_entry->next_offset;
+
         /* Calculate directory size. */
         if (!romfsGetDirectoryDataSize(ctx, cur_dir_entry, &child_dir_size))
         {
@@ -370,7 +256,7 @@ bool romfsGetDirectoryDataSize(RomFileSystemContext *ctx, RomFileSystemDirectory
         total_size += child_dir_size;
 
         /* Update current directory entry offset. */
-        cur_entry_offset = cur_dir_entry->next_offset;
+        cur_entry_offset = next_entry_offset;
     }
 
     /* Update output values. */
@@ -381,6 +267,52 @@ end:
     return success;
 }
 
+bool romfsBuildPathIndex(RomFileSystemContext *ctx)
+{
+    RomFileSystemDirectoryEntry *root_dir_entry = NULL;
+    bool success = false;
+
+    if (!romfsIsValidContext(ctx) || !(root_dir_entry = romfsGetDirectoryEntryByOffset(ctx, 0)))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Return right away if the path index has already been built. */
+    if (ctx->dir_path_index.entries && ctx->file_path_index.entries) return true;
+
+    /* Allocate memory for the hash tables. Table sizes are used to calculate upper bounds for the number of entries. */
+    if (!romfsInitializePathIndex(&(ctx->dir_path_index), ctx->dir_table_size, sizeof(RomFileSystemDirectoryEntry)) || \
+        !romfsInitializePathIndex(&(ctx->file_path_index), ctx->file_table_size, sizeof(RomFileSystemFileEntry)))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for RomFS path index!");
+        goto end;
+    }
+
+    /* Add all entries, starting from the root directory. Paths are hashed without their leading slash. */
+    u32 root_hash = ROMFS_ENTRY_HASH_SEED;
+    romfsInsertPathIndexEntry(&(ctx->dir_path_index), root_hash, 0);
+
+    if (!romfsAddDirectoryToPathIndex(ctx, root_dir_entry, root_hash, 0))
+    {
+        LOG_MSG_ERROR("Failed to build RomFS path index!");
+        goto end;
+    }
+
+    success = true;
+
+end:
+    if (!success)
+    {
+        if (ctx->dir_path_index.entries) free(ctx->dir_path_index.entries);
+        if (ctx->file_path_index.entries) free(ctx->file_path_index.entries);
+        memset(&(ctx->dir_path_index), 0, sizeof(RomFileSystemPathIndex));
+        memset(&(ctx->file_path_index), 0, sizeof(RomFileSystemPathIndex));
+    }
+
+    return success;
+}
+
 RomFileSystemDirectoryEntry *romfsGetDirectoryEntryByPath(RomFileSystemContext *ctx, const char *path)
 {
     size_t path_len = 0;
@@ -399,6 +331,9 @@ RomFileSystemDirectoryEntry *romfsGetDirectoryEntryByPath(RomFileSystemContext *
     /* Short-circuit: check if the root directory was requested. */
     if (path_len == 1) return dir_entry;
 
+    /* Use the path index, if available. Lookup results are authoritative for canonical paths. */
+    if (ctx->dir_path_index.entries && romfsIsCanonicalPath(path)) return (RomFileSystemDirectoryEntry*)romfsLookupPathIndex(ctx, path, false);
+
     /* Duplicate path to avoid problems with strtok_r(). */
     if (!(path_dup = strdup(path)))
     {
@@ -449,6 +384,9 @@ RomFileSystemFileEntry *romfsGetFileEntryByPath(RomFileSystemContext *ctx, const
         return NULL;
     }
 
+    /* Use the path index, if available. Lookup results are authoritative for canonical paths. */
+    if (ctx->file_path_index.entries && romfsIsCanonicalPath(path)) return (RomFileSystemFileEntry*)romfsLookupPathIndex(ctx, path, true);
+
     /* Retrieve path length. */
     path_len = strlen(path);
 
@@ -496,9 +434,9 @@ end:
 bool romfsGeneratePathFromDirectoryEntry(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry, char *out_path, size_t out_path_size, u8 illegal_char_replace_type)
 {
     size_t path_len = 0;
-    u64 dir_offset = ROMFS_VOID_ENTRY;
-    u32 dir_entries_count = 0;
-    RomFileSystemDirectoryEntry **dir_entries = NULL, **tmp_dir_entries = NULL;
+    u32 dir_offset = ROMFS_VOID_ENTRY, dir_entries_count = 0;
+    u32 *dir_offsets = NULL, *tmp_dir_offsets = NULL;
+    RomFileSystemDirectoryEntry *cur_dir_entry = dir_entry;
     bool success = false;
 
     if (!romfsIsValidContext(ctx) || !dir_entry || (!dir_entry->name_length && dir_entry->parent_offset) || !out_path || out_path_size < 2 || \
@@ -515,46 +453,46 @@ bool romfsGeneratePathFromDirectoryEntry(RomFileSystemContext *ctx, RomFileSyste
         return true;
     }
 
-    /* Allocate memory for our directory entries pointer array. */
-    dir_entries = calloc(1, sizeof(RomFileSystemDirectoryEntry*));
-    if (!dir_entries)
+    /* Allocate memory for our directory entry offsets array. */
+    /* Offsets are stored instead of pointers because entry pointers may be invalidated while walking the tree if we're dealing with a paged context. */
+    dir_offsets = calloc(1, sizeof(u32));
+    if (!dir_offsets)
     {
-        LOG_MSG_ERROR("Unable to allocate memory for directory entries!");
+        LOG_MSG_ERROR("Unable to allocate memory for directory entry offsets!");
         goto end;
     }
 
     /* Update stats. */
     path_len = (1 + dir_entry->name_length);
-    *dir_entries = dir_entry;
+    *dir_offsets = romfsGetDirectoryEntryOffset(ctx, dir_entry);
     dir_entries_count++;
 
     while(true)
     {
         /* Get parent directory offset. Break out of the loop if we reached the root directory. */
-        dir_offset = dir_entries[dir_entries_count - 1]->parent_offset;
+        dir_offset = cur_dir_entry->parent_offset;
         if (!dir_offset) break;
 
-        /* Reallocate directory entries pointer array. */
-        if (!(tmp_dir_entries = realloc(dir_entries, (dir_entries_count + 1) * sizeof(RomFileSystemDirectoryEntry*))))
+        /* Reallocate directory entry offsets array. */
+        if (!(tmp_dir_offsets = realloc(dir_offsets, (dir_entries_count + 1) * sizeof(u32))))
         {
-            LOG_MSG_ERROR("Unable to reallocate directory entries buffer!");
+            LOG_MSG_ERROR("Unable to reallocate directory entry offsets buffer!");
             goto end;
         }
 
-        dir_entries = tmp_dir_entries;
-        tmp_dir_entries = NULL;
+        dir_offsets = tmp_dir_offsets;
+        tmp_dir_offsets = NULL;
 
         /* Retrieve parent directory entry using the offset we got earlier. */
-        RomFileSystemDirectoryEntry **cur_dir_entry = &(dir_entries[dir_entries_count]);
-        if (!(*cur_dir_entry = romfsGetDirectoryEntryByOffset(ctx, dir_offset)) || !(*cur_dir_entry)->name_length)
+        if (!(cur_dir_entry = romfsGetDirectoryEntryByOffset(ctx, dir_offset)) || !cur_dir_entry->name_length)
         {
             LOG_MSG_ERROR("Failed to retrieve directory entry!");
             goto end;
         }
 
         /* Update stats. */
-        path_len += (1 + (*cur_dir_entry)->name_length);
-        dir_entries_count++;
+        path_len += (1 + cur_dir_entry->name_length);
+        dir_offsets[dir_entries_count++] = dir_offset;
     }
 
     /* Make sure the output buffer is big enough to hold the full path + NULL terminator. */
@@ -564,36 +502,28 @@ bool romfsGeneratePathFromDirectoryEntry(RomFileSystemContext *ctx, RomFileSyste
         goto end;
     }
 
-    /* Generate output path, looping through our directory entries pointer array in reverse order. */
+    /* Generate output path, looping through our directory entry offsets array in reverse order. */
     *out_path = '\0';
     path_len = 0;
 
     for(u32 i = dir_entries_count; i > 0; i--)
     {
         /* Get current directory entry. */
-        RomFileSystemDirectoryEntry *cur_dir_entry = dir_entries[i - 1];
-
-        /* Concatenate path separator and current directory name to the output buffer. */
-        strcat(out_path, "/");
-        strncat(out_path, cur_dir_entry->name, cur_dir_entry->name_length);
-        path_len++;
-
-        if (illegal_char_replace_type)
+        if (!(cur_dir_entry = romfsGetDirectoryEntryByOffset(ctx, dir_offsets[i - 1])))
         {
-            /* Replace illegal characters within this directory name, then update the full path length. */
-            utilsReplaceIllegalCharacters(out_path + path_len, illegal_char_replace_type == RomFileSystemPathIllegalCharReplaceType_KeepAsciiCharsOnly);
-            path_len += strlen(out_path + path_len);
-        } else {
-            /* Update full path length. */
-            path_len += cur_dir_entry->name_length;
+            LOG_MSG_ERROR("Failed to retrieve directory entry!");
+            goto end;
         }
+
+        /* Concatenate path separator and current directory name to the output buffer. */
+        if (!romfsAppendPathElement(out_path, out_path_size, &path_len, cur_dir_entry->name, cur_dir_entry->name_length, true, illegal_char_replace_type)) goto end;
     }
 
     /* Update return value. */
     success = true;
 
 end:
-    if (dir_entries) free(dir_entries);
+    if (dir_offsets) free(dir_offsets);
 
     return success;
 }
@@ -618,26 +548,9 @@ bool romfsGeneratePathFromFileEntry(RomFileSystemContext *ctx, RomFileSystemFile
         goto end;
     }
 
-    /* Make sure the output buffer is big enough to hold the full path + NULL terminator. */
+    /* Concatenate file entry name, using a path separator if our parent directory isn't the root directory. */
     path_len = strlen(out_path);
-    if ((path_len + 1 + file_entry->name_length) >= out_path_size)
-    {
-        LOG_MSG_ERROR("Output path length exceeds output buffer size! (%lu >= %lu).", path_len + 1 + file_entry->name_length, out_path_size);
-        goto end;
-    }
-
-    /* Concatenate path separator if our parent directory isn't the root directory. */
-    if (file_entry->parent_offset)
-    {
-        strcat(out_path, "/");
-        path_len++;
-    }
-
-    /* Concatenate file entry name. */
-    strncat(out_path, file_entry->name, file_entry->name_length);
-
-    /* Replace illegal characters within the file name, if needed. */
-    if (illegal_char_replace_type) utilsReplaceIllegalCharacters(out_path + path_len, illegal_char_replace_type == RomFileSystemPathIllegalCharReplaceType_KeepAsciiCharsOnly);
+    if (!romfsAppendPathElement(out_path, out_path_size, &path_len, file_entry->name, file_entry->name_length, file_entry->parent_offset != 0, illegal_char_replace_type)) goto end;
 
     /* Update return value. */
     success = true;
@@ -646,11 +559,177 @@ end:
     return success;
 }
 
-bool romfsIsFileEntryUpdated(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, bool *out)
+bool romfsGeneratePathFromFileEntryWithMemo(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, RomFileSystemPathMemo *memo, char *out_path, size_t out_path_size, u8 illegal_char_replace_type)
 {
-    if (!romfsIsValidContext(ctx) || !ctx->is_patch || ctx->default_storage_ctx->nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs || \
-        !file_entry || !file_entry->size || (file_entry->offset + file_entry->size) > ctx->size || !out)
-    {
+    RomFileSystemDirectoryEntry *dir_entry = NULL;
+    size_t path_len = 0;
+
+    if (!romfsIsValidContext(ctx) || !file_entry || !file_entry->name_length || !memo || !out_path || out_path_size < 2 || \
+        illegal_char_replace_type > RomFileSystemPathIllegalCharReplaceType_KeepAsciiCharsOnly)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Update the memo if it doesn't hold the path for our parent directory. */
+    if (memo->dir_offset != file_entry->parent_offset || memo->illegal_char_replace_type != illegal_char_replace_type)
+    {
+        if (!(dir_entry = romfsGetDirectoryEntryByOffset(ctx, file_entry->parent_offset)))
+        {
+            LOG_MSG_ERROR("Failed to retrieve parent directory entry! (0x%X).", file_entry->parent_offset);
+            romfsInitializePathMemo(memo);
+            return false;
+        }
+
+        if (memo->dir_offset != ROMFS_VOID_ENTRY && memo->dir_offset == dir_entry->parent_offset && memo->illegal_char_replace_type == illegal_char_replace_type)
+        {
+            /* Our parent directory is a child of the memoized directory (e.g. while walking the tree depth-first). Just append its name. */
+            if (!romfsAppendPathElement(memo->path, sizeof(memo->path), &(memo->path_len), dir_entry->name, dir_entry->name_length, memo->dir_offset != 0, illegal_char_replace_type))
+            {
+                romfsInitializePathMemo(memo);
+                return false;
+            }
+        } else {
+            /* Generate the full directory path. */
+            if (!romfsGeneratePathFromDirectoryEntry(ctx, dir_entry, memo->path, sizeof(memo->path), illegal_char_replace_type))
+            {
+                LOG_MSG_ERROR("Failed to retrieve RomFS directory path!");
+                romfsInitializePathMemo(memo);
+                return false;
+            }
+
+            memo->path_len = strlen(memo->path);
+        }
+
+        memo->dir_offset = file_entry->parent_offset;
+        memo->illegal_char_replace_type = illegal_char_replace_type;
+    }
+
+    /* Copy the memoized directory path. */
+    if (memo->path_len >= out_path_size)
+    {
+        LOG_MSG_ERROR("Output path length exceeds output buffer size! (%lu >= %lu).", memo->path_len, out_path_size);
+        return false;
+    }
+
+    memcpy(out_path, memo->path, memo->path_len + 1);
+    path_len = memo->path_len;
+
+    /* Concatenate file entry name, using a path separator if our parent directory isn't the root directory. */
+    return romfsAppendPathElement(out_path, out_path_size, &path_len, file_entry->name, file_entry->name_length, file_entry->parent_offset != 0, illegal_char_replace_type);
+}
+
+bool romfsGenerateFileEntryReadPlan(RomFileSystemContext *ctx, bool only_updated, u32 **out_file_entry_offsets, u32 *out_count)
+{
+    if (!romfsIsValidContext(ctx) || (only_updated && (!ctx->is_patch || ctx->default_storage_ctx->nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs)) || \
+        !out_file_entry_offsets || !out_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    RomFileSystemFileEntry *file_entry = NULL;
+    RomFileSystemReadPlanEntry *plan_entries = NULL;
+    u32 *file_entry_offsets = NULL, count = 0;
+    u64 cur_entry_offset = 0, max_count = (ctx->file_table_size / sizeof(RomFileSystemFileEntry));
+    bool success = false;
+
+    /* Allocate memory for our read plan. The file entries table size is used to calculate an upper bound for the number of entries. */
+    if (!max_count || !(plan_entries = malloc(max_count * sizeof(RomFileSystemReadPlanEntry))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for RomFS read plan!");
+        goto end;
+    }
+
+    /* Loop through all file entries. */
+    while(cur_entry_offset < ctx->file_table_size)
+    {
+        RomFileSystemReadPlanEntry *plan_entry = &(plan_entries[count]);
+
+        /* Get current file entry. */
+        if (count >= max_count || !(file_entry = romfsGetFileEntryByOffset(ctx, cur_entry_offset)))
+        {
+            LOG_MSG_ERROR("Failed to retrieve current file entry! (0x%lX, 0x%lX).", cur_entry_offset, ctx->file_table_size);
+            goto end;
+        }
+
+        /* Skip file entries that haven't been updated, if needed. Their data is read from the base RomFS. */
+        if (only_updated)
+        {
+            bool updated = false;
+
+            if (file_entry->size && !romfsIsFileEntryUpdated(ctx, file_entry, &updated))
+            {
+                LOG_MSG_ERROR("Failed to determine if file entry is updated or not! (0x%lX, 0x%lX).", cur_entry_offset, ctx->file_table_size);
+                goto end;
+            }
+
+            if (!updated)
+            {
+                cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+                continue;
+            }
+        }
+
+        plan_entry->file_entry_offset = (u32)cur_entry_offset;
+        plan_entry->physical_offset = 0;
+
+        /* Translate the file data offset. */
+        if (file_entry->size && !ncaStorageGetPhysicalOffset(ctx->default_storage_ctx, ctx->offset + ctx->body_offset + file_entry->offset, &(plan_entry->physical_offset)))
+        {
+            LOG_MSG_ERROR("Failed to get physical offset for file entry! (0x%lX, 0x%lX).", cur_entry_offset, ctx->file_table_size);
+            goto end;
+        }
+
+        count++;
+
+        /* Get the offset for the next file entry. */
+        cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+    }
+
+    if (!count)
+    {
+        /* Nothing to read if no file entries have been updated. */
+        if (only_updated)
+        {
+            *out_file_entry_offsets = NULL;
+            *out_count = 0;
+            success = true;
+        } else {
+            LOG_MSG_ERROR("RomFS file entries table is empty!");
+        }
+
+        goto end;
+    }
+
+    /* Sort read plan. */
+    if (count > 1) qsort(plan_entries, count, sizeof(RomFileSystemReadPlanEntry), &romfsReadPlanEntrySortFunction);
+
+    /* Generate output file entry offsets array. */
+    if (!(file_entry_offsets = malloc(count * sizeof(u32))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for RomFS read plan file entry offsets!");
+        goto end;
+    }
+
+    for(u32 i = 0; i < count; i++) file_entry_offsets[i] = plan_entries[i].file_entry_offset;
+
+    /* Update output values. */
+    *out_file_entry_offsets = file_entry_offsets;
+    *out_count = count;
+    success = true;
+
+end:
+    if (plan_entries) free(plan_entries);
+
+    return success;
+}
+
+bool romfsIsFileEntryUpdated(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, bool *out)
+{
+    if (!romfsIsValidContext(ctx) || !ctx->is_patch || ctx->default_storage_ctx->nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs || \
+        !file_entry || !file_entry->size || (file_entry->offset + file_entry->size) > ctx->size || !out)
+    {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
@@ -679,6 +758,34 @@ end:
     return success;
 }
 
+bool romfsIsFileSystemDataZeroFilled(RomFileSystemContext *ctx, u64 offset, u64 size, bool *out)
+{
+    if (!romfsIsValidContext(ctx) || !size || (offset + size) > ctx->size || !out)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    if (!ncaStorageIsBlockZeroFilled(ctx->default_storage_ctx, ctx->offset + offset, size, out))
+    {
+        LOG_MSG_ERROR("Failed to determine if RomFS data block is zero-filled!");
+        return false;
+    }
+
+    return true;
+}
+
+bool romfsIsFileEntryDataZeroFilled(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, u64 offset, u64 size, bool *out)
+{
+    if (!romfsIsValidContext(ctx) || !file_entry || !file_entry->size || (file_entry->offset + file_entry->size) > ctx->size || !size || (offset + size) > file_entry->size || !out)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    return romfsIsFileSystemDataZeroFilled(ctx, ctx->body_offset + file_entry->offset + offset, size, out);
+}
+
 bool romfsGenerateFileEntryPatch(RomFileSystemContext *ctx, RomFileSystemFileEntry *file_entry, const void *data, u64 data_size, u64 data_offset, RomFileSystemFileEntryPatch *out)
 {
     if (!romfsIsValidContext(ctx) || ctx->is_patch || ctx->default_storage_ctx->base_storage_type != NcaStorageBaseStorageType_Regular || \
@@ -710,6 +817,341 @@ bool romfsGenerateFileEntryPatch(RomFileSystemContext *ctx, RomFileSystemFileEnt
     return success;
 }
 
+void *romfsGetPagedEntryByOffset(RomFileSystemContext *ctx, bool is_file, u64 entry_offset)
+{
+    RomFileSystemTablePageCache *cache = NULL;
+    u64 table_size = 0, entry_size = 0;
+
+    if (!romfsIsValidContext(ctx) || !ctx->is_paged) return NULL;
+
+    cache = (is_file ? ctx->file_table_cache : ctx->dir_table_cache);
+    table_size = (is_file ? ctx->file_table_size : ctx->dir_table_size);
+    entry_size = (is_file ? sizeof(RomFileSystemFileEntry) : sizeof(RomFileSystemDirectoryEntry));
+
+    if ((entry_offset + entry_size) > table_size) return NULL;
+
+    RomFileSystemTablePage *page = NULL;
+    u64 page_offset = ALIGN_DOWN(entry_offset, ROMFS_TABLE_PAGE_SIZE), name_length = 0;
+    u8 *entry = NULL;
+
+    SCOPED_LOCK(&(cache->mutex))
+    {
+        /* Look for the page that holds this entry. Evict the least recently used page if it isn't available. */
+        for(u32 i = 0; i < ROMFS_TABLE_PAGE_CACHE_COUNT; i++)
+        {
+            RomFileSystemTablePage *cur_page = &(cache->pages[i]);
+
+            if (cur_page->size && cur_page->page_offset == page_offset)
+            {
+                page = cur_page;
+                break;
+            }
+
+            if (!page || !cur_page->size || (page->size && cur_page->last_used < page->last_used)) page = cur_page;
+        }
+
+        if (!page->size || page->page_offset != page_offset)
+        {
+            /* Load table page. */
+            u64 page_size = MIN(ROMFS_TABLE_PAGE_BUFFER_SIZE, table_size - page_offset);
+
+            page->size = 0;
+
+            if (!ncaStorageRead(ctx->default_storage_ctx, page->data, page_size, ctx->offset + cache->table_offset + page_offset))
+            {
+                LOG_MSG_ERROR("Failed to read 0x%lX bytes long RomFS %s entries table page at offset 0x%lX!", page_size, is_file ? "file" : "directory", page_offset);
+                break;
+            }
+
+            page->page_offset = page_offset;
+            page->size = page_size;
+        }
+
+        page->last_used = ++(cache->counter);
+
+        /* Make sure the whole entry fits within the loaded data, including its name. */
+        entry = (page->data + (entry_offset - page_offset));
+        name_length = (is_file ? ((RomFileSystemFileEntry*)entry)->name_length : ((RomFileSystemDirectoryEntry*)entry)->name_length);
+
+        if (((entry_offset - page_offset) + entry_size + name_length) > page->size)
+        {
+            LOG_MSG_ERROR("RomFS %s entry at offset 0x%lX exceeds table page boundaries!", is_file ? "file" : "directory", entry_offset);
+            entry = NULL;
+        }
+    }
+
+    return entry;
+}
+
+static bool romfsInitializeContextInternal(RomFileSystemContext *out, NcaFsSectionContext *base_nca_fs_ctx, NcaFsSectionContext *patch_nca_fs_ctx, bool paged)
+{
+    u64 dir_bucket_offset = 0, dir_table_offset = 0;
+    u64 file_bucket_offset = 0, file_table_offset = 0;
+    NcaContext *base_nca_ctx = NULL, *patch_nca_ctx = NULL;
+    bool dump_fs_header = false, success = false;
+
+    /* Check if the base RomFS is missing (e.g. Fortnite, World of Tanks Blitz, etc.). */
+    bool missing_base_romfs = (!base_nca_fs_ctx || !base_nca_fs_ctx->enabled || (base_nca_fs_ctx->section_type != NcaFsSectionType_RomFs && \
+                               base_nca_fs_ctx->section_type != NcaFsSectionType_Nca0RomFs));
+
+    if (!out || (!patch_nca_fs_ctx && (missing_base_romfs || base_nca_fs_ctx->has_sparse_layer)) || \
+        (!missing_base_romfs && (!(base_nca_ctx = base_nca_fs_ctx->nca_ctx) || (base_nca_ctx->format_version == NcaVersion_Nca0 && \
+        (base_nca_fs_ctx->section_type != NcaFsSectionType_Nca0RomFs || base_nca_fs_ctx->hash_type != NcaHashType_HierarchicalSha256)) || \
+        (base_nca_ctx->format_version != NcaVersion_Nca0 && (base_nca_fs_ctx->section_type != NcaFsSectionType_RomFs || \
+        (base_nca_fs_ctx->hash_type != NcaHashType_HierarchicalIntegrity && base_nca_fs_ctx->hash_type != NcaHashType_HierarchicalIntegritySha3))) || \
+        (base_nca_ctx->rights_id_available && !base_nca_ctx->titlekey_retrieved))) || (patch_nca_fs_ctx && (!patch_nca_fs_ctx->enabled || \
+        !(patch_nca_ctx = patch_nca_fs_ctx->nca_ctx) || (!missing_base_romfs && patch_nca_ctx->format_version != base_nca_ctx->format_version) || \
+        patch_nca_fs_ctx->section_type != NcaFsSectionType_PatchRomFs || (patch_nca_ctx->rights_id_available && !patch_nca_ctx->titlekey_retrieved))))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Free output context beforehand. */
+    romfsFreeContext(out);
+
+    out->is_paged = paged;
+
+    NcaStorageContext *base_storage_ctx = &(out->storage_ctx[0]), *patch_storage_ctx = &(out->storage_ctx[1]);
+    bool is_nca0_romfs = (base_nca_fs_ctx && base_nca_fs_ctx->section_type == NcaFsSectionType_Nca0RomFs);
+
+    /* Initialize base NCA storage context. */
+    if (!missing_base_romfs && !ncaStorageInitializeContext(base_storage_ctx, base_nca_fs_ctx, NULL))
+    {
+        LOG_MSG_ERROR("Failed to initialize base NCA storage context!");
+        goto end;
+    }
+
+    if (patch_nca_fs_ctx)
+    {
+        /* Initialize base NCA storage context. */
+        if (!ncaStorageInitializeContext(patch_storage_ctx, patch_nca_fs_ctx, missing_base_romfs ? NULL : base_storage_ctx))
+        {
+            LOG_MSG_ERROR("Failed to initialize patch NCA storage context!");
+            goto end;
+        }
+
+        /* Build Patch storage coverage map if base NCA data is available. This lets us check if any file entry has been updated without walking the Indirect Storage each time. */
+        /* Not a fatal error if this fails. */
+        if (!missing_base_romfs && !ncaStorageBuildPatchCoverageMap(patch_storage_ctx)) LOG_MSG_WARNING("Failed to build Patch storage coverage map. Falling back to Indirect Storage lookups.");
+
+        /* Set default NCA FS storage context. */
+        out->is_patch = true;
+        out->default_storage_ctx = patch_storage_ctx;
+    } else {
+        /* Set default NCA FS storage context. */
+        out->is_patch = false;
+        out->default_storage_ctx = base_storage_ctx;
+    }
+
+    /* Build zero-filled range map. This lets dumpers skip zero-filled blocks from Sparse / Compressed storages. */
+    /* Not a fatal error if this fails. */
+    if (!ncaStorageBuildZeroRangeMap(out->default_storage_ctx)) LOG_MSG_WARNING("Failed to build zero-filled range map. Zero-filled blocks will be read as usual.");
+
+    /* Get RomFS offset and size. */
+    if (!ncaStorageGetHashTargetExtents(out->default_storage_ctx, &(out->offset), &(out->size)))
+    {
+        LOG_MSG_ERROR("Failed to get target hash layer extents!");
+        goto end;
+    }
+
+    /* Read RomFS header. */
+    if (!ncaStorageRead(out->default_storage_ctx, &(out->header), sizeof(RomFileSystemHeader), out->offset))
+    {
+        LOG_MSG_ERROR("Failed to read RomFS header!");
+        goto end;
+    }
+
+    if ((is_nca0_romfs && out->header.old_format.header_size != ROMFS_OLD_HEADER_SIZE) || (!is_nca0_romfs && out->header.cur_format.header_size != ROMFS_HEADER_SIZE))
+    {
+        LOG_MSG_ERROR("Invalid RomFS header size!");
+        dump_fs_header = true;
+        goto end;
+    }
+
+    /* Read directory bucket. */
+    dir_bucket_offset = (is_nca0_romfs ? (u64)out->header.old_format.directory_bucket_offset : out->header.cur_format.directory_bucket_offset);
+    out->dir_bucket_size = (is_nca0_romfs ? (u64)out->header.old_format.directory_bucket_size : out->header.cur_format.directory_bucket_size);
+
+    if (!out->dir_bucket_size || (dir_bucket_offset + out->dir_bucket_size) > out->size)
+    {
+        LOG_MSG_ERROR("Invalid RomFS directory bucket!");
+        dump_fs_header = true;
+        goto end;
+    }
+
+    out->dir_bucket = malloc(out->dir_bucket_size);
+    if (!out->dir_bucket)
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for RomFS directory bucket!");
+        goto end;
+    }
+
+    if (!ncaStorageRead(out->default_storage_ctx, out->dir_bucket, out->dir_bucket_size, out->offset + dir_bucket_offset))
+    {
+        LOG_MSG_ERROR("Failed to read RomFS directory bucket!");
+        goto end;
+    }
+
+    /* Read directory entries table. */
+    dir_table_offset = (is_nca0_romfs ? (u64)out->header.old_format.directory_entry_offset : out->header.cur_format.directory_entry_offset);
+    out->dir_table_size = (is_nca0_romfs ? (u64)out->header.old_format.directory_entry_size : out->header.cur_format.directory_entry_size);
+
+    if (!out->dir_table_size || (dir_table_offset + out->dir_table_size) > out->size)
+    {
+        LOG_MSG_ERROR("Invalid RomFS directory entries table!");
+        dump_fs_header = true;
+        goto end;
+    }
+
+    if (paged)
+    {
+        /* Directory entries table pages will be loaded on demand. */
+        if (!(out->dir_table_cache = romfsAllocateTablePageCache(dir_table_offset)))
+        {
+            LOG_MSG_ERROR("Unable to allocate memory for RomFS directory entries table page cache!");
+            goto end;
+        }
+    } else {
+        out->dir_table = malloc(out->dir_table_size);
+        if (!out->dir_table)
+        {
+            LOG_MSG_ERROR("Unable to allocate memory for RomFS directory entries table!");
+            goto end;
+        }
+
+        if (!ncaStorageRead(out->default_storage_ctx, out->dir_table, out->dir_table_size, out->offset + dir_table_offset))
+        {
+            LOG_MSG_ERROR("Failed to read RomFS directory entries table!");
+            goto end;
+        }
+    }
+
+    /* Read file bucket. */
+    file_bucket_offset = (is_nca0_romfs ? (u64)out->header.old_format.file_bucket_offset : out->header.cur_format.file_bucket_offset);
+    out->file_bucket_size = (is_nca0_romfs ? (u64)out->header.old_format.file_bucket_size : out->header.cur_format.file_bucket_size);
+
+    if (!out->file_bucket_size || (file_bucket_offset + out->file_bucket_size) > out->size)
+    {
+        LOG_MSG_ERROR("Invalid RomFS file bucket!");
+        dump_fs_header = true;
+        goto end;
+    }
+
+    out->file_bucket = malloc(out->file_bucket_size);
+    if (!out->file_bucket)
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for RomFS file bucket!");
+        goto end;
+    }
+
+    if (!ncaStorageRead(out->default_storage_ctx, out->file_bucket, out->file_bucket_size, out->offset + file_bucket_offset))
+    {
+        LOG_MSG_ERROR("Failed to read RomFS file bucket!");
+        goto end;
+    }
+
+    /* Read file entries table. */
+    file_table_offset = (is_nca0_romfs ? (u64)out->header.old_format.file_entry_offset : out->header.cur_format.file_entry_offset);
+    out->file_table_size = (is_nca0_romfs ? (u64)out->header.old_format.file_entry_size : out->header.cur_format.file_entry_size);
+
+    if (!out->file_table_size || (file_table_offset + out->file_table_size) > out->size)
+    {
+        LOG_MSG_ERROR("Invalid RomFS file entries table!");
+        dump_fs_header = true;
+        goto end;
+    }
+
+    if (paged)
+    {
+        /* File entries table pages will be loaded on demand. */
+        if (!(out->file_table_cache = romfsAllocateTablePageCache(file_table_offset)))
+        {
+            LOG_MSG_ERROR("Unable to allocate memory for RomFS file entries table page cache!");
+            goto end;
+        }
+    } else {
+        out->file_table = malloc(out->file_table_size);
+        if (!out->file_table)
+        {
+            LOG_MSG_ERROR("Unable to allocate memory for RomFS file entries table!");
+            goto end;
+        }
+
+        if (!ncaStorageRead(out->default_storage_ctx, out->file_table, out->file_table_size, out->offset + file_table_offset))
+        {
+            LOG_MSG_ERROR("Failed to read RomFS file entries table!");
+            goto end;
+        }
+    }
+
+    /* Get file data body offset. */
+    out->body_offset = (is_nca0_romfs ? (u64)out->header.old_format.body_offset : out->header.cur_format.body_offset);
+    if (out->body_offset >= out->size)
+    {
+        LOG_MSG_ERROR("Invalid RomFS file data body!");
+        dump_fs_header = true;
+        goto end;
+    }
+
+    /* Update flag. */
+    success = true;
+
+end:
+    if (!success)
+    {
+        if (dump_fs_header) LOG_DATA_DEBUG(&(out->header), sizeof(RomFileSystemHeader), "RomFS header dump:");
+
+        romfsFreeContext(out);
+    }
+
+    return success;
+}
+
+static RomFileSystemTablePageCache *romfsAllocateTablePageCache(u64 table_offset)
+{
+    RomFileSystemTablePageCache *cache = calloc(1, sizeof(RomFileSystemTablePageCache));
+    if (!cache) return NULL;
+
+    for(u32 i = 0; i < ROMFS_TABLE_PAGE_CACHE_COUNT; i++)
+    {
+        if (!(cache->pages[i].data = malloc(ROMFS_TABLE_PAGE_BUFFER_SIZE)))
+        {
+            romfsFreeTablePageCache(cache);
+            return NULL;
+        }
+    }
+
+    cache->table_offset = table_offset;
+
+    return cache;
+}
+
+static u32 romfsGetDirectoryEntryOffset(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry)
+{
+    if (!ctx->is_paged) return ROMFS_ENTRY_OFFSET(dir_entry, ctx->dir_table);
+
+    RomFileSystemTablePageCache *cache = ctx->dir_table_cache;
+    u32 offset = ROMFS_VOID_ENTRY;
+
+    /* Look for the loaded page that holds this entry. Entry pointers are only valid while their page remains in the cache. */
+    SCOPED_LOCK(&(cache->mutex))
+    {
+        for(u32 i = 0; i < ROMFS_TABLE_PAGE_CACHE_COUNT; i++)
+        {
+            RomFileSystemTablePage *page = &(cache->pages[i]);
+
+            if (page->size && (u8*)dir_entry >= page->data && (u8*)dir_entry < (page->data + page->size))
+            {
+                offset = (u32)(page->page_offset + ROMFS_ENTRY_OFFSET(dir_entry, page->data));
+                break;
+            }
+        }
+    }
+
+    return offset;
+}
+
 static RomFileSystemDirectoryEntry *romfsGetChildDirectoryEntryByName(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry, const char *name)
 {
     size_t name_len = 0;
@@ -723,7 +1165,7 @@ static RomFileSystemDirectoryEntry *romfsGetChildDirectoryEntryByName(RomFileSys
     }
 
     /* Calculate hash for the child directory entry. */
-    parent_offset = ROMFS_ENTRY_OFFSET(dir_entry, ctx->dir_table);
+    parent_offset = romfsGetDirectoryEntryOffset(ctx, dir_entry);
     hash = romfsCalculateEntryHash(ctx, parent_offset, name, name_len, false);
 
     //LOG_MSG_DEBUG("parent_offset: 0x%X, parent_name: \"%.*s\", name: \"%s\", hash: 0x%X", parent_offset, (int)dir_entry->name_length, dir_entry->name, name, hash);
@@ -766,7 +1208,7 @@ static RomFileSystemFileEntry *romfsGetChildFileEntryByName(RomFileSystemContext
     }
 
     /* Calculate hash for the child file entry. */
-    parent_offset = ROMFS_ENTRY_OFFSET(dir_entry, ctx->dir_table);
+    parent_offset = romfsGetDirectoryEntryOffset(ctx, dir_entry);
     hash = romfsCalculateEntryHash(ctx, parent_offset, name, name_len, true);
 
     //LOG_MSG_DEBUG("parent_offset: 0x%X, parent_name: \"%.*s\", name: \"%s\", hash: 0x%X", parent_offset, (int)dir_entry->name_length, dir_entry->name, name, hash);
@@ -798,10 +1240,247 @@ static RomFileSystemFileEntry *romfsGetChildFileEntryByName(RomFileSystemContext
 
 static u32 romfsCalculateEntryHash(RomFileSystemContext *ctx, u32 parent_offset, const char *name, size_t name_len, bool is_file)
 {
-    u32 hash = (parent_offset ^ 123456789);
+    u32 hash = romfsUpdateEntryHash(parent_offset ^ ROMFS_ENTRY_HASH_SEED, name, name_len);
     u32 total = ((u32)(is_file ? ctx->file_bucket_size : ctx->dir_bucket_size) / sizeof(u32));
 
+    return (hash % total);
+}
+
+NX_INLINE u32 romfsUpdateEntryHash(u32 hash, const char *name, size_t name_len)
+{
     for(size_t i = 0; i < name_len; i++) hash = (((hash >> 5) | (hash << 27)) ^ name[i]);
+    return hash;
+}
 
-    return (hash % total);
+static bool romfsInitializePathIndex(RomFileSystemPathIndex *index, u64 table_size, u64 entry_size)
+{
+    /* Keep the load factor at or below 50%. */
+    u64 max_entry_count = (table_size / entry_size), capacity = 16;
+    while(capacity < (max_entry_count * 2)) capacity <<= 1;
+
+    if (capacity > UINT32_MAX) return false;
+
+    index->entries = malloc(capacity * sizeof(RomFileSystemPathIndexEntry));
+    if (!index->entries) return false;
+
+    /* Mark all slots as unused. */
+    for(u64 i = 0; i < capacity; i++) index->entries[i].offset = ROMFS_VOID_ENTRY;
+
+    index->capacity = (u32)capacity;
+
+    return true;
 }
+
+static bool romfsAddDirectoryToPathIndex(RomFileSystemContext *ctx, RomFileSystemDirectoryEntry *dir_entry, u32 path_hash, u32 depth)
+{
+    RomFileSystemFileEntry *cur_file_entry = NULL;
+    RomFileSystemDirectoryEntry *cur_dir_entry = NULL;
+    u64 cur_entry_offset = 0;
+
+    if (depth >= ROMFS_PATH_INDEX_MAX_DEPTH)
+    {
+        LOG_MSG_ERROR("Maximum RomFS directory depth exceeded!");
+        return false;
+    }
+
+    /* Children from the root directory don't use a path separator. */
+    if (depth > 0) path_hash = romfsUpdateEntryHash(path_hash, "/", 1);
+
+    /* Loop through the child file entries' linked list. */
+    cur_entry_offset = dir_entry->file_offset;
+    while(cur_entry_offset != ROMFS_VOID_ENTRY)
+    {
+        if (!(cur_file_entry = romfsGetFileEntryByOffset(ctx, cur_entry_offset)))
+        {
+            LOG_MSG_ERROR("Failed to retrieve file entry! (0x%lX, 0x%lX).", cur_entry_offset, ctx->file_table_size);
+            return false;
+        }
+
+        romfsInsertPathIndexEntry(&(ctx->file_path_index), romfsUpdateEntryHash(path_hash, cur_file_entry->name, cur_file_entry->name_length), (u32)cur_entry_offset);
+
+        cur_entry_offset = cur_file_entry->next_offset;
+    }
+
+    /* Loop through the child directory entries' linked list. */
+    cur_entry_offset = dir_entry->directory_offset;
+    while(cur_entry_offset != ROMFS_VOID_ENTRY)
+    {
+        if (!(cur_dir_entry = romfsGetDirectoryEntryByOffset(ctx, cur_entry_offset)))
+        {
+            LOG_MSG_ERROR("Failed to retrieve directory entry! (0x%lX, 0x%lX).", cur_entry_offset, ctx->dir_table_size);
+            return false;
+        }
+
+        u32 dir_hash = romfsUpdateEntryHash(path_hash, cur_dir_entry->name, cur_dir_entry->name_length);
+        romfsInsertPathIndexEntry(&(ctx->dir_path_index), dir_hash, (u32)cur_entry_offset);
+
+        /* Entry pointers may be invalidated by the recursive call if we're dealing with a paged context. */
+        u64 next_entry_offset = cur_dir_entry->next_offset;
+
+        if (!romfsAddDirectoryToPathIndex(ctx, cur_dir_entry, dir_hash, depth + 1)) return false;
+
+        cur_entry_offset = next_entry_offset;
+    }
+
+    return true;
+}
+
+static void romfsInsertPathIndexEntry(RomFileSystemPathIndex *index, u32 hash, u32 offset)
+{
+    /* The load factor guarantees we'll always find a free slot. */
+    u32 mask = (index->capacity - 1);
+    for(u32 i = (hash & mask); ; i = ((i + 1) & mask))
+    {
+        RomFileSystemPathIndexEntry *entry = &(index->entries[i]);
+        if (entry->offset != ROMFS_VOID_ENTRY) continue;
+
+        entry->hash = hash;
+        entry->offset = offset;
+        break;
+    }
+}
+
+static void *romfsLookupPathIndex(RomFileSystemContext *ctx, const char *path, bool is_file)
+{
+    RomFileSystemPathIndex *index = (is_file ? &(ctx->file_path_index) : &(ctx->dir_path_index));
+
+    /* Skip the leading slash and ignore any trailing slashes. */
+    path++;
+
+    size_t path_len = strlen(path);
+    while(path_len && path[path_len - 1] == '/') path_len--;
+
+    if (!path_len) return (is_file ? NULL : romfsGetDirectoryEntryByOffset(ctx, 0));
+
+    u32 hash = romfsUpdateEntryHash(ROMFS_ENTRY_HASH_SEED, path, path_len), mask = (index->capacity - 1);
+
+    /* Probe the hash table. Hash collisions are resolved by comparing the full path against the entry tree. */
+    for(u32 i = (hash & mask); index->entries[i].offset != ROMFS_VOID_ENTRY; i = ((i + 1) & mask))
+    {
+        RomFileSystemPathIndexEntry *index_entry = &(index->entries[i]);
+        if (index_entry->hash != hash) continue;
+
+        if (is_file)
+        {
+            RomFileSystemFileEntry *file_entry = romfsGetFileEntryByOffset(ctx, index_entry->offset);
+            if (file_entry && romfsIsEntryPathMatch(ctx, file_entry->parent_offset, file_entry->name, file_entry->name_length, path, path_len)) return file_entry;
+        } else {
+            RomFileSystemDirectoryEntry *dir_entry = romfsGetDirectoryEntryByOffset(ctx, index_entry->offset);
+            if (dir_entry && romfsIsEntryPathMatch(ctx, dir_entry->parent_offset, dir_entry->name, dir_entry->name_length, path, path_len)) return dir_entry;
+        }
+    }
+
+    return NULL;
+}
+
+static bool romfsIsEntryPathMatch(RomFileSystemContext *ctx, u32 parent_offset, const char *name, u32 name_len, const char *path, size_t path_len)
+{
+    RomFileSystemDirectoryEntry *parent_dir_entry = NULL;
+
+    /* Compare path elements from the end of the path, moving up through the parent directories. */
+    for(u32 depth = 0; depth < ROMFS_PATH_INDEX_MAX_DEPTH; depth++)
+    {
+        if (path_len < name_len || strncmp(path + path_len - name_len, name, name_len) != 0) return false;
+        path_len -= name_len;
+
+        /* Check if we reached the root directory. */
+        if (!parent_offset) return (path_len == 0);
+
+        /* Make sure there's a path separator right before the current element. */
+        if (!path_len || path[--path_len] != '/') return false;
+
+        if (!(parent_dir_entry = romfsGetDirectoryEntryByOffset(ctx, parent_offset))) return false;
+
+        parent_offset = parent_dir_entry->parent_offset;
+        name = parent_dir_entry->name;
+        name_len = parent_dir_entry->name_length;
+    }
+
+    return false;
+}
+
+static bool romfsIsCanonicalPath(const char *path)
+{
+    /* Paths with empty elements (e.g. "/a//b") must be resolved by walking the entry tree. */
+    return (strstr(path, "//") == NULL);
+}
+
+static bool romfsAppendPathElement(char *out_path, size_t out_path_size, size_t *path_len, const char *name, u32 name_len, bool add_separator, u8 illegal_char_replace_type)
+{
+    size_t cur_path_len = *path_len;
+
+    /* Make sure the output buffer is big enough to hold the path element + NULL terminator. */
+    if ((cur_path_len + (add_separator ? 1 : 0) + name_len) >= out_path_size)
+    {
+        LOG_MSG_ERROR("Output path length exceeds output buffer size! (%lu >= %lu).", cur_path_len + (add_separator ? 1 : 0) + name_len, out_path_size);
+        return false;
+    }
+
+    /* Concatenate path separator, if needed. */
+    if (add_separator) out_path[cur_path_len++] = '/';
+
+    /* Concatenate path element. Names stored in RomFS sections are not always NULL terminated. */
+    memcpy(out_path + cur_path_len, name, name_len);
+    out_path[cur_path_len + name_len] = '\0';
+
+    if (illegal_char_replace_type)
+    {
+        /* Replace illegal characters within this path element, then update the full path length. */
+        utilsReplaceIllegalCharacters(out_path + cur_path_len, illegal_char_replace_type == RomFileSystemPathIllegalCharReplaceType_KeepAsciiCharsOnly);
+        cur_path_len += strlen(out_path + cur_path_len);
+    } else {
+        cur_path_len += name_len;
+    }
+
+    *path_len = cur_path_len;
+
+    return true;
+}
+
+static bool romfsQueryExtents(RomFileSystemContext *ctx, StorageExtentList *out, u64 size, u64 offset, u64 base_offset)
+{
+    StorageExtentList tmp_list = {0};
+    bool success = false;
+
+    /* Query extents from the NCA storage. They're relative to the start of the NCA FS section. */
+    if (!ncaStorageQueryExtents(ctx->default_storage_ctx, &tmp_list, size, ctx->offset + offset))
+    {
+        LOG_MSG_ERROR("Failed to query RomFS data extents!");
+        goto end;
+    }
+
+    /* Rebase extent offsets before appending them to the output list. */
+    for(u32 i = 0; i < tmp_list.count; i++)
+    {
+        StorageExtent *extent = &(tmp_list.extents[i]);
+        extent->offset -= (ctx->offset + base_offset);
+        if (!storageExtentListAppend(out, extent)) goto end;
+    }
+
+    /* Update return value. */
+    success = true;
+
+end:
+    storageExtentListFree(&tmp_list);
+
+    return success;
+}
+
+static int romfsReadPlanEntrySortFunction(const void *a, const void *b)
+{
+    const RomFileSystemReadPlanEntry *plan_entry_1 = (const RomFileSystemReadPlanEntry*)a;
+    const RomFileSystemReadPlanEntry *plan_entry_2 = (const RomFileSystemReadPlanEntry*)b;
+
+    if (plan_entry_1->physical_offset < plan_entry_2->physical_offset)
+    {
+        return -1;
+    } else
+    if (plan_entry_1->physical_offset > plan_entry_2->physical_offset)
+    {
+        return 1;
+    }
+
+    /* Keep file entries table order for ties. */
+    return (plan_entry_1->file_entry_offset < plan_entry_2->file_entry_offset ? -1 : (plan_entry_1->file_entry_offset > plan_entry_2->file_entry_offset ? 1 : 0));
+}
+
@@ -28,11 +28,64 @@
 #include <mbedtls/ctr_drbg.h>
 #include <mbedtls/pk.h>
 
+#define RSA_SIG_CACHE_MAGIC             0x52534143  /* "RSAC". */
+#define RSA_SIG_CACHE_VERSION           1
+#define RSA_SIG_CACHE_MAX_ENTRY_COUNT   0x10000     /* 2 MiB worth of entries. */
+
+/* Type definitions. */
+
+/// Signature verification cache file layout:
+///     - RsaSignatureCacheHeader.
+///     - RsaSignatureCacheEntry array with 'entry_count' elements, sorted in ascending order.
+typedef struct {
+    u32 magic;          ///< RSA_SIG_CACHE_MAGIC.
+    u32 version;        ///< RSA_SIG_CACHE_VERSION.
+    u32 entry_count;    ///< Number of RsaSignatureCacheEntry elements.
+    u8 reserved[0x4];
+} RsaSignatureCacheHeader;
+
+NXDT_ASSERT(RsaSignatureCacheHeader, 0x10);
+
+/// SHA-256 checksum calculated over the concatenation of the SHA-256 checksum from the signed area, the signature, the modulus, the public exponent and the padding scheme.
+/// Only successfully verified signatures are ever stored.
+typedef struct {
+    u8 hash[SHA256_HASH_SIZE];
+} RsaSignatureCacheEntry;
+
+NXDT_ASSERT(RsaSignatureCacheEntry, 0x20);
+
+/* Global variables. */
+
+static Mutex g_rsaSigCacheMutex = 0;
+static bool g_rsaSigCacheLoaded = false, g_rsaSigCacheChanged = false;
+
+static RsaSignatureCacheEntry *g_rsaSigCacheEntries = NULL;
+static u32 g_rsaSigCacheEntryCount = 0;
+
 /* Function prototypes. */
 
 static bool rsa2048VerifySha256BasedSignature(const void *data, size_t data_size, const void *signature, const void *modulus, const void *public_exponent, size_t public_exponent_size, \
                                               bool use_pss);
 
+static void rsaGenerateSignatureCacheEntry(RsaSignatureCacheEntry *out, const u8 *hash, const void *signature, const void *modulus, const void *public_exponent, size_t public_exponent_size, \
+                                           bool use_pss);
+
+static bool rsaLookupSignatureCacheEntry(const RsaSignatureCacheEntry *entry, u32 *out_idx);
+static void rsaAddSignatureCacheEntry(const RsaSignatureCacheEntry *entry);
+
+static void rsaLoadSignatureCache(void);
+static void rsaSaveSignatureCache(void);
+static void rsaFreeSignatureCache(void);
+
+void rsaExit(void)
+{
+    SCOPED_LOCK(&g_rsaSigCacheMutex)
+    {
+        if (g_rsaSigCacheChanged) rsaSaveSignatureCache();
+        rsaFreeSignatureCache();
+    }
+}
+
 bool rsa2048VerifySha256BasedPssSignature(const void *data, size_t data_size, const void *signature, const void *modulus, const void *public_exponent, size_t public_exponent_size)
 {
     return rsa2048VerifySha256BasedSignature(data, data_size, signature, modulus, public_exponent, public_exponent_size, true);
@@ -120,8 +173,18 @@ static bool rsa2048VerifySha256BasedSignature(const void *data, size_t data_size
     int mbedtls_ret = 0;
     mbedtls_rsa_context rsa = {0};
     u8 hash[SHA256_HASH_SIZE] = {0};
+    RsaSignatureCacheEntry cache_entry = {0};
     bool ret = false;
 
+    /* Calculate SHA-256 checksum for the input data. */
+    sha256CalculateHash(hash, data, data_size);
+
+    /* Skip the modular exponentiation altogether if this exact signature was successfully verified before. */
+    rsaGenerateSignatureCacheEntry(&cache_entry, hash, signature, modulus, public_exponent, public_exponent_size, use_pss);
+
+    SCOPED_LOCK(&g_rsaSigCacheMutex) ret = rsaLookupSignatureCacheEntry(&cache_entry, NULL);
+    if (ret) return true;
+
     /* Initialize RSA context. */
     mbedtls_rsa_init(&rsa, use_pss ? MBEDTLS_RSA_PKCS_V21 : MBEDTLS_RSA_PKCS_V15, MBEDTLS_MD_SHA256);
 
@@ -133,9 +196,6 @@ static bool rsa2048VerifySha256BasedSignature(const void *data, size_t data_size
         goto end;
     }
 
-    /* Calculate SHA-256 checksum for the input data. */
-    sha256CalculateHash(hash, data, data_size);
-
     /* Verify signature. */
     mbedtls_ret = (use_pss ? mbedtls_rsa_rsassa_pss_verify(&rsa, NULL, NULL, MBEDTLS_RSA_PUBLIC, MBEDTLS_MD_SHA256, SHA256_HASH_SIZE, hash, (const u8*)signature) : \
                              mbedtls_rsa_rsassa_pkcs1_v15_verify(&rsa, NULL, NULL, MBEDTLS_RSA_PUBLIC, MBEDTLS_MD_SHA256, SHA256_HASH_SIZE, hash, (const u8*)signature));
@@ -145,6 +205,9 @@ static bool rsa2048VerifySha256BasedSignature(const void *data, size_t data_size
         goto end;
     }
 
+    /* Update signature verification cache. */
+    SCOPED_LOCK(&g_rsaSigCacheMutex) rsaAddSignatureCacheEntry(&cache_entry);
+
     ret = true;
 
 end:
@@ -152,3 +215,187 @@ end:
 
     return ret;
 }
+
+static void rsaGenerateSignatureCacheEntry(RsaSignatureCacheEntry *out, const u8 *hash, const void *signature, const void *modulus, const void *public_exponent, size_t public_exponent_size, \
+                                           bool use_pss)
+{
+    Sha256Context sha256_ctx = {0};
+    u8 padding_scheme = (use_pss ? MBEDTLS_RSA_PKCS_V21 : MBEDTLS_RSA_PKCS_V15);
+
+    /* The modulus is part of the key, so NCA key generations and ticket signature issuers are implicitly taken into account. */
+    sha256ContextCreate(&sha256_ctx);
+    sha256ContextUpdate(&sha256_ctx, hash, SHA256_HASH_SIZE);
+    sha256ContextUpdate(&sha256_ctx, signature, RSA2048_SIG_SIZE);
+    sha256ContextUpdate(&sha256_ctx, modulus, RSA2048_PUBKEY_SIZE);
+    sha256ContextUpdate(&sha256_ctx, public_exponent, public_exponent_size);
+    sha256ContextUpdate(&sha256_ctx, &padding_scheme, sizeof(padding_scheme));
+    sha256ContextGetHash(&sha256_ctx, out->hash);
+}
+
+static bool rsaLookupSignatureCacheEntry(const RsaSignatureCacheEntry *entry, u32 *out_idx)
+{
+    /* Load signature verification cache, if needed. */
+    if (!g_rsaSigCacheLoaded) rsaLoadSignatureCache();
+
+    /* Perform a binary search. If no match is found, the insertion index for the provided entry is returned. */
+    u32 low = 0, high = g_rsaSigCacheEntryCount;
+
+    while(low < high)
+    {
+        u32 mid = (low + ((high - low) / 2));
+        int cmp = memcmp(g_rsaSigCacheEntries[mid].hash, entry->hash, SHA256_HASH_SIZE);
+
+        if (cmp == 0)
+        {
+            if (out_idx) *out_idx = mid;
+            return true;
+        }
+
+        if (cmp < 0)
+        {
+            low = (mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+
+    if (out_idx) *out_idx = low;
+
+    return false;
+}
+
+static void rsaAddSignatureCacheEntry(const RsaSignatureCacheEntry *entry)
+{
+    RsaSignatureCacheEntry *tmp_entries = NULL;
+    u32 idx = 0;
+
+    /* Bail out if this entry already exists (e.g. another thread verified the same signature in the meantime), or if the cache is full. */
+    if (rsaLookupSignatureCacheEntry(entry, &idx) || g_rsaSigCacheEntryCount >= RSA_SIG_CACHE_MAX_ENTRY_COUNT) return;
+
+    /* Reallocate entry buffer. */
+    if (!(tmp_entries = realloc(g_rsaSigCacheEntries, (g_rsaSigCacheEntryCount + 1) * sizeof(RsaSignatureCacheEntry))))
+    {
+        LOG_MSG_ERROR("Failed to reallocate signature verification cache entries!");
+        return;
+    }
+
+    g_rsaSigCacheEntries = tmp_entries;
+    tmp_entries = NULL;
+
+    /* Insert new entry, keeping the array sorted. */
+    memmove(g_rsaSigCacheEntries + idx + 1, g_rsaSigCacheEntries + idx, (g_rsaSigCacheEntryCount - idx) * sizeof(RsaSignatureCacheEntry));
+    memcpy(&(g_rsaSigCacheEntries[idx]), entry, sizeof(RsaSignatureCacheEntry));
+
+    g_rsaSigCacheEntryCount++;
+    g_rsaSigCacheChanged = true;
+}
+
+static void rsaLoadSignatureCache(void)
+{
+    FILE *fp = NULL;
+    RsaSignatureCacheHeader header = {0};
+    RsaSignatureCacheEntry *entries = NULL;
+    u64 size = 0;
+
+    /* Only try to load the cache once, even if it's unavailable. */
+    g_rsaSigCacheLoaded = true;
+
+    /* Open cache file. */
+    if (!(fp = fopen(RSA_SIG_CACHE_PATH, "rb")))
+    {
+        LOG_MSG_DEBUG("Signature verification cache unavailable at \"" RSA_SIG_CACHE_PATH "\".");
+        return;
+    }
+
+    /* Get cache file size. */
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+
+    /* Read and validate cache header. */
+    if (size < sizeof(RsaSignatureCacheHeader) || fread(&header, 1, sizeof(RsaSignatureCacheHeader), fp) != sizeof(RsaSignatureCacheHeader) || header.magic != __builtin_bswap32(RSA_SIG_CACHE_MAGIC) || \
+        header.version != RSA_SIG_CACHE_VERSION || !header.entry_count || header.entry_count > RSA_SIG_CACHE_MAX_ENTRY_COUNT || \
+        size != (sizeof(RsaSignatureCacheHeader) + (header.entry_count * sizeof(RsaSignatureCacheEntry))))
+    {
+        LOG_MSG_ERROR("Invalid signature verification cache! Discarding it.");
+        goto end;
+    }
+
+    /* Read cache entries. */
+    if (!(entries = malloc(header.entry_count * sizeof(RsaSignatureCacheEntry))) || fread(entries, sizeof(RsaSignatureCacheEntry), header.entry_count, fp) != header.entry_count)
+    {
+        LOG_MSG_ERROR("Failed to read %u signature verification cache entries!", header.entry_count);
+        goto end;
+    }
+
+    /* Make sure entries are sorted. Binary searches rely on this. */
+    for(u32 i = 1; i < header.entry_count; i++)
+    {
+        if (memcmp(entries[i - 1].hash, entries[i].hash, SHA256_HASH_SIZE) >= 0)
+        {
+            LOG_MSG_ERROR("Signature verification cache entry #%u is out of order! Discarding cache.", i);
+            goto end;
+        }
+    }
+
+    g_rsaSigCacheEntries = entries;
+    g_rsaSigCacheEntryCount = header.entry_count;
+    entries = NULL;
+
+    LOG_MSG_DEBUG("Loaded %u signature verification cache entries.", g_rsaSigCacheEntryCount);
+
+end:
+    if (entries) free(entries);
+
+    fclose(fp);
+}
+
+static void rsaSaveSignatureCache(void)
+{
+    FILE *fp = NULL;
+    RsaSignatureCacheHeader header = { .magic = __builtin_bswap32(RSA_SIG_CACHE_MAGIC), .version = RSA_SIG_CACHE_VERSION, .entry_count = g_rsaSigCacheEntryCount };
+    bool write_ok = false;
+
+    if (!g_rsaSigCacheEntries || !g_rsaSigCacheEntryCount) return;
+
+    /* Write cache data to a temporary file, then replace the current cache file. */
+    utilsCreateDirectoryTree(RSA_SIG_CACHE_PATH, false);
+
+    if (!(fp = fopen(RSA_SIG_CACHE_TMP_PATH, "wb")))
+    {
+        LOG_MSG_ERROR("Failed to open \"" RSA_SIG_CACHE_TMP_PATH "\" for writing!");
+        return;
+    }
+
+    write_ok = (fwrite(&header, 1, sizeof(RsaSignatureCacheHeader), fp) == sizeof(RsaSignatureCacheHeader) && \
+                fwrite(g_rsaSigCacheEntries, sizeof(RsaSignatureCacheEntry), g_rsaSigCacheEntryCount, fp) == g_rsaSigCacheEntryCount);
+    fclose(fp);
+
+    if (!write_ok)
+    {
+        LOG_MSG_ERROR("Failed to write %u signature verification cache entries!", g_rsaSigCacheEntryCount);
+        remove(RSA_SIG_CACHE_TMP_PATH);
+        return;
+    }
+
+    remove(RSA_SIG_CACHE_PATH);
+    rename(RSA_SIG_CACHE_TMP_PATH, RSA_SIG_CACHE_PATH);
+
+    utilsCommitSdCardFileSystemChanges();
+
+    g_rsaSigCacheChanged = false;
+
+    LOG_MSG_DEBUG("Saved %u signature verification cache entries.", g_rsaSigCacheEntryCount);
+}
+
+static void rsaFreeSignatureCache(void)
+{
+    if (g_rsaSigCacheEntries)
+    {
+        free(g_rsaSigCacheEntries);
+        g_rsaSigCacheEntries = NULL;
+    }
+
+    g_rsaSigCacheEntryCount = 0;
+    g_rsaSigCacheLoaded = g_rsaSigCacheChanged = false;
+}
@@ -38,9 +38,39 @@ static inline u8 save_bitmap_check_bit(const void *buffer, size_t bit_offset)
     return (*((u8*)buffer + (bit_offset >> 3)) & (1 << (bit_offset & 7)));
 }
 
+/* Returns the number of consecutive bits set to 'value', starting at 'bit_offset' and up to 'bit_count' bits. */
+/* The bitmap is processed one 64-bit word at a time, so its buffer size must be aligned to 8 bytes. */
+static u32 save_bitmap_get_run_length(const void *buffer, u32 bit_offset, u32 bit_count, bool value)
+{
+    u32 run_length = 0;
+
+    while(run_length < bit_count)
+    {
+        u32 cur_bit = (bit_offset + run_length), word_bit = (cur_bit & 63), word_bits = (64 - word_bit);
+        u64 word = 0;
+
+        /* Bits are stored in LSB-first order, so a little endian load puts each one of them at its own position within the word. */
+        memcpy(&word, (const u8*)buffer + ((cur_bit >> 6) << 3), sizeof(u64));
+
+        /* Flip the word if we're looking for set bits, then get rid of the bits we already went past. The first set bit marks the end of the run. */
+        if (value) word = ~word;
+        word >>= word_bit;
+
+        u32 same_bits = (word ? (u32)__builtin_ctzll(word) : 64);
+        if (same_bits > word_bits) same_bits = word_bits;
+
+        run_length += same_bits;
+        if (same_bits < word_bits) break;
+    }
+
+    return (run_length < bit_count ? run_length : bit_count);
+}
+
+static u64 save_remap_read(remap_storage_ctx_t *ctx, void *buffer, u64 offset, size_t count);
+
 static bool save_duplex_storage_init(duplex_storage_ctx_t *ctx, duplex_fs_layer_info_t *layer, void *bitmap, u64 bitmap_size)
 {
-    if (!ctx || !layer || !layer->data_a || !layer->data_b || !layer->info.block_size_power || !bitmap || !bitmap_size)
+    if (!ctx || !layer || ((!layer->data_a || !layer->data_b) && !layer->base_storage) || !layer->info.block_size_power || !bitmap || !bitmap_size)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -48,11 +78,15 @@ static bool save_duplex_storage_init(duplex_storage_ctx_t *ctx, duplex_fs_layer_
 
     ctx->data_a = layer->data_a;
     ctx->data_b = layer->data_b;
+    ctx->base_storage = layer->base_storage;
+    ctx->base_offset_a = layer->base_offset_a;
+    ctx->base_offset_b = layer->base_offset_b;
     ctx->bitmap_storage = (u8*)bitmap;
     ctx->block_size = (1 << layer->info.block_size_power);
     ctx->bitmap.data = ctx->bitmap_storage;
 
-    ctx->bitmap.bitmap = calloc(1, bitmap_size >> 3);
+    /* The bitmap size is aligned to 64 bits, since save_bitmap_get_run_length() reads it one word at a time. */
+    ctx->bitmap.bitmap = calloc(1, ALIGN_UP(bitmap_size, 64) >> 3);
     if (!ctx->bitmap.bitmap)
     {
         LOG_MSG_ERROR("Failed to allocate memory for duplex bitmap!");
@@ -104,10 +138,28 @@ static u32 save_duplex_storage_read(duplex_storage_ctx_t *ctx, void *buffer, u64
     {
         u32 block_num = (u32)(in_pos / ctx->block_size);
         u32 block_pos = (u32)(in_pos % ctx->block_size);
-        u32 bytes_to_read = ((ctx->block_size - block_pos) < remaining ? (ctx->block_size - block_pos) : remaining);
+        u32 block_count = (u32)(((u64)block_pos + remaining + ctx->block_size - 1) / ctx->block_size);
+
+        /* Find the longest run of consecutive blocks stored on the same duplex side, starting at the current one. The whole run is read at once. */
+        bool use_b = (save_bitmap_check_bit(ctx->bitmap.bitmap, block_num) != 0);
+        u32 run_block_count = save_bitmap_get_run_length(ctx->bitmap.bitmap, block_num, block_count, use_b);
+        u64 run_size = (((u64)run_block_count * ctx->block_size) - block_pos);
+        u32 bytes_to_read = (u32)(run_size < remaining ? run_size : remaining);
 
-        u8 *data = (save_bitmap_check_bit(ctx->bitmap.bitmap, block_num) ? ctx->data_b : ctx->data_a);
-        memcpy((u8*)buffer + out_pos, data + in_pos, bytes_to_read);
+        u8 *data = (use_b ? ctx->data_b : ctx->data_a);
+
+        if (data)
+        {
+            memcpy((u8*)buffer + out_pos, data + in_pos, bytes_to_read);
+        } else {
+            /* Lazily read layer. Only the copy selected by the bitmap is read. */
+            u64 base_offset = ((use_b ? ctx->base_offset_b : ctx->base_offset_a) + in_pos);
+            if (save_remap_read(ctx->base_storage, (u8*)buffer + out_pos, base_offset, bytes_to_read) != bytes_to_read)
+            {
+                LOG_MSG_ERROR("Failed to read 0x%X-byte long duplex block run from remap storage offset 0x%lX!", bytes_to_read, base_offset);
+                return out_pos;
+            }
+        }
 
         out_pos += bytes_to_read;
         in_pos += bytes_to_read;
@@ -139,35 +191,31 @@ static remap_segment_ctx_t *save_remap_init_segments(remap_header_t *header, rem
     {
         remap_segment_ctx_t *seg = &(segments[i]);
 
-        seg->entry_count = 0;
+        if (entry_idx >= num_map_entries)
+        {
+            LOG_MSG_ERROR("Remap segment #%u has no map entries!", i);
+            goto end;
+        }
 
-        seg->entries = calloc(1, sizeof(remap_entry_ctx_t*));
+        /* Count contiguous map entries for this segment, so its entry array (sorted by virtual offset) can be allocated at once. */
+        u32 entry_count = 1;
+        while((entry_idx + entry_count) < num_map_entries && map_entries[entry_idx + entry_count - 1].virtual_offset_end == map_entries[entry_idx + entry_count].virtual_offset) entry_count++;
+
+        seg->entries = calloc(entry_count, sizeof(remap_entry_ctx_t*));
         if (!seg->entries)
         {
-            LOG_MSG_ERROR("Failed to allocate memory for remap segment entry #%u!", entry_idx);
+            LOG_MSG_ERROR("Failed to allocate memory for remap segment #%u entries!", i);
             goto end;
         }
 
-        seg->entries[seg->entry_count++] = &map_entries[entry_idx];
+        seg->entry_count = entry_count;
         seg->offset = map_entries[entry_idx].virtual_offset;
-        map_entries[entry_idx++].segment = seg;
 
-        while(entry_idx < num_map_entries && map_entries[entry_idx - 1].virtual_offset_end == map_entries[entry_idx].virtual_offset)
+        for(u32 j = 0; j < entry_count; j++, entry_idx++)
         {
             map_entries[entry_idx].segment = seg;
-            map_entries[entry_idx - 1].next = &map_entries[entry_idx];
-
-            remap_entry_ctx_t **ptr = calloc(sizeof(remap_entry_ctx_t*), seg->entry_count + 1);
-            if (!ptr)
-            {
-                LOG_MSG_ERROR("Failed to allocate memory for remap segment entry #%u!", entry_idx);
-                goto end;
-            }
-
-            memcpy(ptr, seg->entries, sizeof(remap_entry_ctx_t*) * seg->entry_count);
-            free(seg->entries);
-            seg->entries = ptr;
-            seg->entries[seg->entry_count++] = &map_entries[entry_idx++];
+            if (j > 0) map_entries[entry_idx - 1].next = &map_entries[entry_idx];
+            seg->entries[j] = &map_entries[entry_idx];
         }
 
         seg->length = (seg->entries[seg->entry_count - 1]->virtual_offset_end - seg->entries[0]->virtual_offset);
@@ -178,34 +226,15 @@ static remap_segment_ctx_t *save_remap_init_segments(remap_header_t *header, rem
 end:
     if (!success)
     {
-        entry_idx = 0;
-
-        for(u32 j = 0; j <= i; j++)
+        for(u32 j = 0; j < header->map_segment_count; j++)
         {
-            if (!map_entries[entry_idx].segment) break;
-
-            if (map_entries[entry_idx].segment->entries)
-            {
-                free(map_entries[entry_idx].segment->entries);
-                map_entries[entry_idx].segment->entries = NULL;
-            }
-
-            map_entries[entry_idx++].segment = NULL;
-
-            while(entry_idx < num_map_entries && map_entries[entry_idx - 1].virtual_offset_end == map_entries[entry_idx].virtual_offset)
-            {
-                map_entries[entry_idx - 1].next = NULL;
-
-                if (!map_entries[entry_idx].segment) break;
-
-                if (map_entries[entry_idx].segment->entries)
-                {
-                    free(map_entries[entry_idx].segment->entries);
-                    map_entries[entry_idx].segment->entries = NULL;
-                }
+            if (segments[j].entries) free(segments[j].entries);
+        }
 
-                map_entries[entry_idx++].segment = NULL;
-            }
+        for(u32 j = 0; j < num_map_entries; j++)
+        {
+            map_entries[j].segment = NULL;
+            map_entries[j].next = NULL;
         }
 
         free(segments);
@@ -223,13 +252,42 @@ static remap_entry_ctx_t *save_remap_get_map_entry(remap_storage_ctx_t *ctx, u64
         return NULL;
     }
 
+    remap_entry_ctx_t *entry = ctx->last_entry;
+
+    /* Check the last entry we returned, as well as the one right after it. This takes care of sequential access. */
+    for(u32 i = 0; i < 2 && entry; i++, entry = entry->next)
+    {
+        if (offset >= entry->virtual_offset && offset < entry->virtual_offset_end)
+        {
+            ctx->last_entry = entry;
+            return entry;
+        }
+    }
+
     u32 segment_idx = (u32)(offset >> (64 - ctx->header->segment_bits));
 
     if (segment_idx < ctx->header->map_segment_count)
     {
-        for(u32 i = 0; i < ctx->segments[segment_idx].entry_count; i++)
+        remap_segment_ctx_t *seg = &(ctx->segments[segment_idx]);
+        u64 low = 0, high = seg->entry_count;
+
+        /* Binary search for the first entry whose end offset is past the provided offset. */
+        while(low < high)
+        {
+            u64 mid = (low + ((high - low) / 2));
+
+            if (seg->entries[mid]->virtual_offset_end > offset)
+            {
+                high = mid;
+            } else {
+                low = (mid + 1);
+            }
+        }
+
+        if (low < seg->entry_count)
         {
-            if (ctx->segments[segment_idx].entries[i]->virtual_offset_end > offset) return ctx->segments[segment_idx].entries[i];
+            ctx->last_entry = seg->entries[low];
+            return ctx->last_entry;
         }
     }
 
@@ -299,7 +357,14 @@ static u64 save_remap_read(remap_storage_ctx_t *ctx, void *buffer, u64 offset, s
         in_pos += bytes_to_read;
         remaining -= bytes_to_read;
 
-        if (in_pos >= entry->virtual_offset_end) entry = entry->next;
+        if (remaining && in_pos >= entry->virtual_offset_end)
+        {
+            if (!(entry = entry->next))
+            {
+                LOG_MSG_ERROR("Remap read at offset 0x%lX exceeds segment boundaries!", offset);
+                break;
+            }
+        }
     }
 
     return out_pos;
@@ -509,27 +574,35 @@ static size_t save_ivfc_level_fread(ivfc_level_save_ctx_t *ctx, void *buffer, u6
     return count;
 }
 
-static bool save_ivfc_storage_read(integrity_verification_storage_ctx_t *ctx, void *buffer, u64 offset, size_t count, u32 verify)
+static bool save_ivfc_storage_read(integrity_verification_storage_ctx_t *ctx, void *buffer, u64 offset, size_t count, u32 verify);
+
+static u8 *save_ivfc_storage_get_block(integrity_verification_storage_ctx_t *ctx, u64 block_index, u32 verify)
 {
-    if (!ctx || !ctx->sector_size || (!ctx->next_level && !ctx->hash_storage && !ctx->base_storage) || !buffer || !count)
+    if (ctx->block_validities[block_index] == VALIDITY_INVALID && verify)
     {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return false;
+        LOG_MSG_ERROR("Hash error from previous check found in block #%lu!", block_index);
+        return NULL;
     }
 
-    if (count > ctx->sector_size)
+    /* Allocate block cache, if needed. The salt is stored right before the block data, so the whole buffer can be hashed at once. */
+    if (!ctx->block_cache)
     {
-        LOG_MSG_ERROR("IVFC read exceeds sector size!");
-        return false;
+        ctx->block_cache = malloc(0x20 + ctx->sector_size);
+        if (!ctx->block_cache)
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for IVFC block cache!");
+            return NULL;
+        }
+
+        memcpy(ctx->block_cache, ctx->salt, 0x20);
+        ctx->block_cached = false;
     }
 
-    u64 block_index = (offset / ctx->sector_size);
+    u8 *block = (ctx->block_cache + 0x20);
+    bool cached = (ctx->block_cached && ctx->block_cache_index == block_index);
 
-    if (ctx->block_validities[block_index] == VALIDITY_INVALID && verify)
-    {
-        LOG_MSG_ERROR("Hash error from previous check found at offset 0x%lX, count 0x%lX!", offset, count);
-        return false;
-    }
+    /* Skip both the I/O and the hash check if the block has already been cached (and validated, if needed). */
+    if (cached && !(verify && ctx->block_validities[block_index] == VALIDITY_UNCHECKED)) return block;
 
     u8 hash_buffer[0x20] = {0};
     u8 zeroes[0x20] = {0};
@@ -540,54 +613,92 @@ static bool save_ivfc_storage_read(integrity_verification_storage_ctx_t *ctx, vo
         if (!save_ivfc_storage_read(ctx->next_level, hash_buffer, hash_pos, 0x20, verify))
         {
             LOG_MSG_ERROR("Failed to read hash from next IVFC level!");
-            return false;
+            return NULL;
         }
     } else {
         if (save_ivfc_level_fread(ctx->hash_storage, hash_buffer, hash_pos, 0x20) != 0x20)
         {
             LOG_MSG_ERROR("Failed to read hash from hash storage!");
-            return false;
+            return NULL;
         }
     }
 
     if (!memcmp(hash_buffer, zeroes, 0x20))
     {
-        memset(buffer, 0, count);
+        memset(block, 0, ctx->sector_size);
+        ctx->block_cache_index = block_index;
+        ctx->block_cached = true;
         ctx->block_validities[block_index] = VALIDITY_VALID;
-        return true;
+        return block;
     }
 
-    if (save_ivfc_level_fread(ctx->base_storage, buffer, offset, count) != count)
+    if (!cached)
     {
-        LOG_MSG_ERROR("Failed to read IVFC level from base storage!");
-        return false;
+        /* The last block may be shorter than the sector size. Pad it with zeroes. */
+        u64 block_offset = (block_index * ctx->sector_size);
+        size_t block_size = (size_t)MIN((u64)ctx->sector_size, ctx->_length - block_offset);
+
+        ctx->block_cached = false;
+
+        if (save_ivfc_level_fread(ctx->base_storage, block, block_offset, block_size) != block_size)
+        {
+            LOG_MSG_ERROR("Failed to read IVFC level from base storage!");
+            return NULL;
+        }
+
+        if (block_size < ctx->sector_size) memset(block + block_size, 0, ctx->sector_size - block_size);
+
+        ctx->block_cache_index = block_index;
+        ctx->block_cached = true;
     }
 
-    if (!(verify && ctx->block_validities[block_index] == VALIDITY_UNCHECKED)) return true;
+    if (!(verify && ctx->block_validities[block_index] == VALIDITY_UNCHECKED)) return block;
 
     u8 hash[0x20] = {0};
 
-    u8 *data_buffer = calloc(1, ctx->sector_size + 0x20);
-    if (!data_buffer)
+    sha256CalculateHash(hash, ctx->block_cache, 0x20 + ctx->sector_size);
+    hash[0x1F] |= 0x80;
+
+    ctx->block_validities[block_index] = (!memcmp(hash_buffer, hash, 0x20) ? VALIDITY_VALID : VALIDITY_INVALID);
+
+    if (ctx->block_validities[block_index] == VALIDITY_INVALID)
+    {
+        LOG_MSG_ERROR("Hash error from current check found in block #%lu!", block_index);
+        return NULL;
+    }
+
+    return block;
+}
+
+static bool save_ivfc_storage_read(integrity_verification_storage_ctx_t *ctx, void *buffer, u64 offset, size_t count, u32 verify)
+{
+    if (!ctx || !ctx->sector_size || (!ctx->next_level && !ctx->hash_storage && !ctx->base_storage) || !buffer || !count || offset >= ctx->_length || count > (ctx->_length - offset))
     {
-        LOG_MSG_ERROR("Failed to allocate memory for data buffer!");
+        LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    memcpy(data_buffer, ctx->salt, 0x20);
-    memcpy(data_buffer + 0x20, buffer, ctx->sector_size);
+    u8 *out = (u8*)buffer;
 
-    sha256CalculateHash(hash, data_buffer, ctx->sector_size + 0x20);
-    hash[0x1F] |= 0x80;
+    /* Copy data from each block through the block cache. */
+    while(count)
+    {
+        u64 block_index = (offset / ctx->sector_size);
+        u64 block_data_offset = (offset % ctx->sector_size);
+        size_t copy_size = (size_t)MIN((u64)count, ctx->sector_size - block_data_offset);
 
-    free(data_buffer);
+        u8 *block = save_ivfc_storage_get_block(ctx, block_index, verify);
+        if (!block)
+        {
+            LOG_MSG_ERROR("Failed to get IVFC block at offset 0x%lX!", offset);
+            return false;
+        }
 
-    ctx->block_validities[block_index] = (!memcmp(hash_buffer, hash, 0x20) ? VALIDITY_VALID : VALIDITY_INVALID);
+        memcpy(out, block + block_data_offset, copy_size);
 
-    if (ctx->block_validities[block_index] == VALIDITY_INVALID && verify)
-    {
-        LOG_MSG_ERROR("Hash error from current check found at offset 0x%lX, count 0x%lX!", offset, count);
-        return false;
+        out += copy_size;
+        offset += copy_size;
+        count -= copy_size;
     }
 
     return true;
@@ -634,27 +745,43 @@ static u32 save_allocation_table_read_entry_with_length(allocation_table_ctx_t *
     return length;
 }
 
-static u32 save_allocation_table_get_list_length(allocation_table_ctx_t *ctx, u32 block_index)
+static bool save_allocation_table_storage_build_extents(allocation_table_storage_ctx_t *ctx)
 {
-    if (!ctx || !ctx->header->allocation_table_block_count)
+    if (!ctx || !ctx->fat || !ctx->fat->header->allocation_table_block_count)
     {
         LOG_MSG_ERROR("Invalid parameters!");
-        return 0;
+        return false;
     }
 
     allocation_table_entry_t entry = {0};
-    entry.next = block_index;
+    entry.next = ctx->initial_block;
     u32 total_length = 0;
-    u32 table_size = ctx->header->allocation_table_block_count;
+    u32 table_size = ctx->fat->header->allocation_table_block_count;
     u32 nodes_iterated = 0;
 
+    ctx->extent_count = 0;
+    ctx->extents_complete = true;
+
+    /* Walk the whole FAT chain once. Segments are stored in virtual block order, which makes it possible to look them up using a binary search. */
     while(entry.next != 0xFFFFFFFF)
     {
-        u32 entry_length = save_allocation_table_read_entry_with_length(ctx, &entry);
+        u32 physical_block = entry.next;
+
+        u32 entry_length = save_allocation_table_read_entry_with_length(ctx->fat, &entry);
         if (!entry_length)
         {
             LOG_MSG_ERROR("Failed to retrieve FAT entry length!");
-            return 0;
+            return false;
+        }
+
+        if (ctx->extent_count < SAVE_FAT_STORAGE_MAX_EXTENTS)
+        {
+            allocation_table_extent_t *extent = &(ctx->extents[ctx->extent_count++]);
+            extent->virtual_block = total_length;
+            extent->physical_block = physical_block;
+            extent->block_count = entry_length;
+        } else {
+            ctx->extents_complete = false;
         }
 
         total_length += entry_length;
@@ -663,14 +790,22 @@ static u32 save_allocation_table_get_list_length(allocation_table_ctx_t *ctx, u3
         if (nodes_iterated > table_size)
         {
             LOG_MSG_ERROR("Cycle detected in allocation table!");
-            return 0;
+            return false;
         }
     }
 
-    return total_length;
+    if (!total_length)
+    {
+        LOG_MSG_ERROR("Empty FAT chain!");
+        return false;
+    }
+
+    ctx->_length = ((u64)total_length * ctx->block_size);
+
+    return true;
 }
 
-static bool save_allocation_table_iterator_begin(allocation_table_iterator_ctx_t *ctx, allocation_table_ctx_t *table, u32 initial_block)
+static bool save_allocation_table_iterator_begin(allocation_table_iterator_ctx_t *ctx, allocation_table_ctx_t *table, u32 initial_block, u32 virtual_block)
 {
     if (!ctx || !table)
     {
@@ -680,7 +815,7 @@ static bool save_allocation_table_iterator_begin(allocation_table_iterator_ctx_t
 
     ctx->fat = table;
     ctx->physical_block = initial_block;
-    ctx->virtual_block = 0;
+    ctx->virtual_block = virtual_block;
 
     allocation_table_entry_t entry = {0};
     entry.next = initial_block;
@@ -695,7 +830,7 @@ static bool save_allocation_table_iterator_begin(allocation_table_iterator_ctx_t
     ctx->next_block = entry.next;
     ctx->prev_block = entry.prev;
 
-    if (ctx->prev_block != 0xFFFFFFFF)
+    if (!virtual_block && ctx->prev_block != 0xFFFFFFFF)
     {
         LOG_MSG_ERROR("Attempted to start FAT iteration from invalid block 0x%X!", initial_block);
         return false;
@@ -776,18 +911,63 @@ static bool save_allocation_table_iterator_seek(allocation_table_iterator_ctx_t
     }
 }
 
-u32 save_allocation_table_storage_read(allocation_table_storage_ctx_t *ctx, void *buffer, u64 offset, size_t count)
+static bool save_allocation_table_storage_get_extent(allocation_table_storage_ctx_t *ctx, u32 block, allocation_table_extent_t *out_extent)
 {
-    if (!ctx || !ctx->fat || !ctx->block_size || !buffer || !count)
+    allocation_table_extent_t *last_extent = (ctx->extent_count ? &(ctx->extents[ctx->extent_count - 1]) : NULL);
+
+    if (last_extent && block < (last_extent->virtual_block + last_extent->block_count))
     {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return 0;
+        /* Binary search. */
+        u32 low = 0, high = (ctx->extent_count - 1);
+
+        while(low < high)
+        {
+            u32 mid = (low + ((high - low + 1) / 2));
+
+            if (ctx->extents[mid].virtual_block <= block)
+            {
+                low = mid;
+            } else {
+                high = (mid - 1);
+            }
+        }
+
+        memcpy(out_extent, &(ctx->extents[low]), sizeof(allocation_table_extent_t));
+        return true;
+    }
+
+    if (!last_extent || ctx->extents_complete)
+    {
+        LOG_MSG_ERROR("Block #%u is out of bounds!", block);
+        return false;
     }
 
+    /* The requested block is located past the last stored extent. Walk the rest of the FAT chain from there. */
     allocation_table_iterator_ctx_t iterator;
-    if (!save_allocation_table_iterator_begin(&iterator, ctx->fat, ctx->initial_block))
+    if (!save_allocation_table_iterator_begin(&iterator, ctx->fat, last_extent->physical_block, last_extent->virtual_block))
     {
         LOG_MSG_ERROR("Failed to initialize FAT interator!");
+        return false;
+    }
+
+    if (!save_allocation_table_iterator_seek(&iterator, block))
+    {
+        LOG_MSG_ERROR("Failed to seek to block #%u!", block);
+        return false;
+    }
+
+    out_extent->virtual_block = iterator.virtual_block;
+    out_extent->physical_block = iterator.physical_block;
+    out_extent->block_count = iterator.current_segment_size;
+
+    return true;
+}
+
+u32 save_allocation_table_storage_read(allocation_table_storage_ctx_t *ctx, void *buffer, u64 offset, size_t count)
+{
+    if (!ctx || !ctx->fat || !ctx->block_size || !buffer || !count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
         return 0;
     }
 
@@ -798,33 +978,26 @@ u32 save_allocation_table_storage_read(allocation_table_storage_ctx_t *ctx, void
     while(remaining)
     {
         u32 block_num = (u32)(in_pos / ctx->block_size);
-        if (!save_allocation_table_iterator_seek(&iterator, block_num))
+        allocation_table_extent_t extent = {0};
+
+        if (!save_allocation_table_storage_get_extent(ctx, block_num, &extent))
         {
-            LOG_MSG_ERROR("Failed to seek to block #%u within offset 0x%lX!", block_num, offset);
+            LOG_MSG_ERROR("Failed to retrieve FAT extent for block #%u within offset 0x%lX!", block_num, offset);
             return out_pos;
         }
 
-        u32 segment_pos = (u32)(in_pos - ((u64)iterator.virtual_block * ctx->block_size));
-        u64 physical_offset = ((iterator.physical_block * ctx->block_size) + segment_pos);
+        u32 segment_pos = (u32)(in_pos - ((u64)extent.virtual_block * ctx->block_size));
+        u64 physical_offset = (((u64)extent.physical_block * ctx->block_size) + segment_pos);
 
-        u32 remaining_in_segment = ((iterator.current_segment_size * ctx->block_size) - segment_pos);
+        u32 remaining_in_segment = ((extent.block_count * ctx->block_size) - segment_pos);
         u32 bytes_to_read = (remaining < remaining_in_segment ? remaining : remaining_in_segment);
 
-        u32 sector_size = ctx->base_storage->integrity_storages[3].sector_size;
-        u32 chunk_remaining = bytes_to_read;
-
-        for(u32 i = 0; i < bytes_to_read; i += sector_size)
+        /* Read the whole contiguous chunk at once. The IVFC storage splits it along its own block boundaries. */
+        if (!save_ivfc_storage_read(&ctx->base_storage->integrity_storages[3], (u8*)buffer + out_pos, physical_offset, bytes_to_read, \
+                                    ctx->base_storage->data_level->save_ctx->tool_ctx.action & ACTION_VERIFY))
         {
-            u32 bytes_to_request = (chunk_remaining < sector_size ? chunk_remaining : sector_size);
-
-            if (!save_ivfc_storage_read(&ctx->base_storage->integrity_storages[3], (u8*)buffer + out_pos + i, physical_offset + i, bytes_to_request, \
-                                        ctx->base_storage->data_level->save_ctx->tool_ctx.action & ACTION_VERIFY))
-            {
-                LOG_MSG_ERROR("Failed to read %u bytes chunk from IVFC storage at physical offset 0x%lX!", bytes_to_request, physical_offset + i);
-                return (out_pos + bytes_to_read - chunk_remaining);
-            }
-
-            chunk_remaining -= bytes_to_request;
+            LOG_MSG_ERROR("Failed to read %u bytes chunk from IVFC storage at physical offset 0x%lX!", bytes_to_read, physical_offset);
+            return out_pos;
         }
 
         out_pos += bytes_to_read;
@@ -1038,15 +1211,14 @@ bool save_open_fat_storage(save_filesystem_ctx_t *ctx, allocation_table_storage_
     if (block_index == 0xFFFFFFFF)
     {
         storage_ctx->_length = 0;
+        storage_ctx->extent_count = 0;
+        storage_ctx->extents_complete = true;
     } else {
-        u32 fat_list_length = save_allocation_table_get_list_length(storage_ctx->fat, block_index);
-        if (!fat_list_length)
+        if (!save_allocation_table_storage_build_extents(storage_ctx))
         {
-            LOG_MSG_ERROR("Failed to retrieve FAT list length!");
+            LOG_MSG_ERROR("Failed to build FAT extent list!");
             return false;
         }
-
-        storage_ctx->_length = (fat_list_length * storage_ctx->block_size);
     }
 
     return true;
@@ -1342,30 +1514,38 @@ bool save_process(save_ctx_t *ctx)
 
     memcpy(&ctx->duplex_layers[1].info, &ctx->header.duplex_header.layers[1], sizeof(duplex_info_t));
 
-    ctx->duplex_layers[2].data_a = calloc(1, ctx->header.layout.duplex_data_size);
-    if (!ctx->duplex_layers[2].data_a)
+    if ((ctx->tool_ctx.action & ACTION_LAZY) && !(ctx->tool_ctx.action & ACTION_VERIFY))
     {
-        LOG_MSG_ERROR("Failed to allocate memory for data_a block in duplex layer #2!");
-        goto end;
-    }
+        /* Don't load both copies from the duplex data layer. Blocks will be read from the data remap storage as needed. */
+        ctx->duplex_layers[2].base_storage = &ctx->data_remap_storage;
+        ctx->duplex_layers[2].base_offset_a = ctx->header.layout.duplex_data_offset_a;
+        ctx->duplex_layers[2].base_offset_b = ctx->header.layout.duplex_data_offset_b;
+    } else {
+        ctx->duplex_layers[2].data_a = calloc(1, ctx->header.layout.duplex_data_size);
+        if (!ctx->duplex_layers[2].data_a)
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for data_a block in duplex layer #2!");
+            goto end;
+        }
 
-    if (save_remap_read(&ctx->data_remap_storage, ctx->duplex_layers[2].data_a, ctx->header.layout.duplex_data_offset_a, ctx->header.layout.duplex_data_size) != ctx->header.layout.duplex_data_size)
-    {
-        LOG_MSG_ERROR("Failed to read data_a block from duplex layer #2 in data remap storage!");
-        goto end;
-    }
+        if (save_remap_read(&ctx->data_remap_storage, ctx->duplex_layers[2].data_a, ctx->header.layout.duplex_data_offset_a, ctx->header.layout.duplex_data_size) != ctx->header.layout.duplex_data_size)
+        {
+            LOG_MSG_ERROR("Failed to read data_a block from duplex layer #2 in data remap storage!");
+            goto end;
+        }
 
-    ctx->duplex_layers[2].data_b = calloc(1, ctx->header.layout.duplex_data_size);
-    if (!ctx->duplex_layers[2].data_b)
-    {
-        LOG_MSG_ERROR("Failed to allocate memory for data_b block in duplex layer #2!");
-        goto end;
-    }
+        ctx->duplex_layers[2].data_b = calloc(1, ctx->header.layout.duplex_data_size);
+        if (!ctx->duplex_layers[2].data_b)
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for data_b block in duplex layer #2!");
+            goto end;
+        }
 
-    if (save_remap_read(&ctx->data_remap_storage, ctx->duplex_layers[2].data_b, ctx->header.layout.duplex_data_offset_b, ctx->header.layout.duplex_data_size) != ctx->header.layout.duplex_data_size)
-    {
-        LOG_MSG_ERROR("Failed to read data_b block from duplex layer #2 in data remap storage!");
-        goto end;
+        if (save_remap_read(&ctx->data_remap_storage, ctx->duplex_layers[2].data_b, ctx->header.layout.duplex_data_offset_b, ctx->header.layout.duplex_data_size) != ctx->header.layout.duplex_data_size)
+        {
+            LOG_MSG_ERROR("Failed to read data_b block from duplex layer #2 in data remap storage!");
+            goto end;
+        }
     }
 
     memcpy(&ctx->duplex_layers[2].info, &ctx->header.duplex_header.layers[2], sizeof(duplex_info_t));
@@ -1606,6 +1786,7 @@ void save_free_contexts(save_ctx_t *ctx)
 
         free(ctx->data_remap_storage.segments);
         ctx->data_remap_storage.segments = NULL;
+        ctx->data_remap_storage.last_entry = NULL;
     }
 
     if (ctx->data_remap_storage.map_entries)
@@ -1626,6 +1807,7 @@ void save_free_contexts(save_ctx_t *ctx)
 
         free(ctx->meta_remap_storage.segments);
         ctx->meta_remap_storage.segments = NULL;
+        ctx->meta_remap_storage.last_entry = NULL;
     }
 
     if (ctx->meta_remap_storage.map_entries)
@@ -1686,6 +1868,12 @@ void save_free_contexts(save_ctx_t *ctx)
             free(ctx->core_data_ivfc_storage.integrity_storages[i].block_validities);
             ctx->core_data_ivfc_storage.integrity_storages[i].block_validities = NULL;
         }
+
+        if (ctx->core_data_ivfc_storage.integrity_storages[i].block_cache)
+        {
+            free(ctx->core_data_ivfc_storage.integrity_storages[i].block_cache);
+            ctx->core_data_ivfc_storage.integrity_storages[i].block_cache = NULL;
+        }
     }
 
     if (ctx->core_data_ivfc_storage.level_validities)
@@ -1703,6 +1891,12 @@ void save_free_contexts(save_ctx_t *ctx)
                 free(ctx->fat_ivfc_storage.integrity_storages[i].block_validities);
                 ctx->fat_ivfc_storage.integrity_storages[i].block_validities = NULL;
             }
+
+            if (ctx->fat_ivfc_storage.integrity_storages[i].block_cache)
+            {
+                free(ctx->fat_ivfc_storage.integrity_storages[i].block_cache);
+                ctx->fat_ivfc_storage.integrity_storages[i].block_cache = NULL;
+            }
         }
     }
 
@@ -0,0 +1,218 @@
+/*
+ * sha256_mb.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <core/nxdt_utils.h>
+#include <arm_neon.h>
+
+#define SHA256_MB_LANE_COUNT    2       /* Number of buffers processed in parallel by the interleaved SHA-256 kernel. */
+#define SHA256_MB_BLOCK_SIZE    0x40
+
+/* Global constants. */
+
+static const u32 g_sha256RoundConstants[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static const u32 g_sha256InitialState[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+/* Function prototypes. */
+
+static void sha256MbCalculateHashes(u8 *dst, const u8 * const *src, const size_t *size, u32 lane_count);
+static u32 sha256MbGeneratePaddingBlocks(u8 *out, const u8 *tail, size_t tail_size, u64 total_size);
+
+NX_INLINE void sha256MbProcessBlocks(uint32x4_t *state, const u8 * const *src, u32 lane_count, size_t block_count);
+
+void sha256CalculateMultiBufferHash(void *dst, const void * const *src, const size_t *size, size_t count)
+{
+    if (!dst || !src || !size || !count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return;
+    }
+
+    u8 *dst_u8 = (u8*)dst;
+
+    for(size_t i = 0; i < count; i += SHA256_MB_LANE_COUNT)
+    {
+        u32 lane_count = (u32)MIN(count - i, SHA256_MB_LANE_COUNT);
+        sha256MbCalculateHashes(dst_u8 + (i * SHA256_HASH_SIZE), (const u8* const*)src + i, size + i, lane_count);
+    }
+}
+
+void sha256CalculateBlockHashes(void *dst, const void *src, size_t size, size_t block_size)
+{
+    if (!dst || !src || !size || !block_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return;
+    }
+
+    u8 *dst_u8 = (u8*)dst;
+    const u8 *src_u8 = (const u8*)src;
+
+    for(size_t offset = 0; offset < size;)
+    {
+        const u8 *lane_src[SHA256_MB_LANE_COUNT] = {0};
+        size_t lane_size[SHA256_MB_LANE_COUNT] = {0};
+        u32 lane_count = 0;
+
+        /* Pick the next blocks. */
+        for(; lane_count < SHA256_MB_LANE_COUNT && offset < size; lane_count++)
+        {
+            lane_src[lane_count] = (src_u8 + offset);
+            lane_size[lane_count] = MIN(block_size, size - offset);
+            offset += lane_size[lane_count];
+        }
+
+        sha256MbCalculateHashes(dst_u8, lane_src, lane_size, lane_count);
+        dst_u8 += (lane_count * SHA256_HASH_SIZE);
+    }
+}
+
+static void sha256MbCalculateHashes(u8 *dst, const u8 * const *src, const size_t *size, u32 lane_count)
+{
+    uint32x4_t state[SHA256_MB_LANE_COUNT * 2];
+    u8 padding[SHA256_MB_LANE_COUNT][SHA256_MB_BLOCK_SIZE * 2];
+    const u8 *padding_src[SHA256_MB_LANE_COUNT] = {0};
+    size_t block_count[SHA256_MB_LANE_COUNT] = {0}, common_block_count = SIZE_MAX;
+    u32 padding_block_count[SHA256_MB_LANE_COUNT] = {0};
+    bool joint_tail = true;
+
+    for(u32 i = 0; i < lane_count; i++)
+    {
+        /* Initialize hash state. */
+        state[i * 2] = vld1q_u32(g_sha256InitialState);
+        state[(i * 2) + 1] = vld1q_u32(g_sha256InitialState + 4);
+
+        /* Generate padding blocks right away. They hold the last partial block from each buffer. */
+        block_count[i] = (size[i] / SHA256_MB_BLOCK_SIZE);
+        padding_block_count[i] = sha256MbGeneratePaddingBlocks(padding[i], src[i] + (block_count[i] * SHA256_MB_BLOCK_SIZE), size[i] % SHA256_MB_BLOCK_SIZE, size[i]);
+        padding_src[i] = padding[i];
+
+        statsAddCounter(StatsCounterType_Sha256, size[i]);
+
+        if (block_count[i] < common_block_count) common_block_count = block_count[i];
+        if (i > 0 && (block_count[i] != block_count[0] || padding_block_count[i] != padding_block_count[0])) joint_tail = false;
+    }
+
+    if (lane_count == SHA256_MB_LANE_COUNT)
+    {
+        /* Process all the full blocks shared by every buffer at once. */
+        sha256MbProcessBlocks(state, src, SHA256_MB_LANE_COUNT, common_block_count);
+
+        /* Process padding blocks at once if all buffers have the same size (by far the most common case). */
+        if (joint_tail)
+        {
+            sha256MbProcessBlocks(state, padding_src, SHA256_MB_LANE_COUNT, padding_block_count[0]);
+            goto end;
+        }
+    } else {
+        common_block_count = 0;
+    }
+
+    /* Process the remaining blocks from each buffer on its own. */
+    for(u32 i = 0; i < lane_count; i++)
+    {
+        const u8 *cur_src = (src[i] + (common_block_count * SHA256_MB_BLOCK_SIZE));
+        sha256MbProcessBlocks(&(state[i * 2]), &cur_src, 1, block_count[i] - common_block_count);
+        sha256MbProcessBlocks(&(state[i * 2]), &(padding_src[i]), 1, padding_block_count[i]);
+    }
+
+end:
+    /* Store output hashes in big endian order. */
+    for(u32 i = 0; i < lane_count; i++)
+    {
+        vst1q_u8(dst + (i * SHA256_HASH_SIZE), vrev32q_u8(vreinterpretq_u8_u32(state[i * 2])));
+        vst1q_u8(dst + (i * SHA256_HASH_SIZE) + 0x10, vrev32q_u8(vreinterpretq_u8_u32(state[(i * 2) + 1])));
+    }
+}
+
+static u32 sha256MbGeneratePaddingBlocks(u8 *out, const u8 *tail, size_t tail_size, u64 total_size)
+{
+    /* Another block is needed if there's no room left for the 0x80 byte and the 64-bit message length. */
+    u32 block_count = ((tail_size + 1 + sizeof(u64)) > SHA256_MB_BLOCK_SIZE ? 2 : 1);
+    size_t padding_size = (block_count * SHA256_MB_BLOCK_SIZE);
+    u64 bit_count = __builtin_bswap64(total_size * 8);
+
+    memset(out, 0, padding_size);
+    if (tail_size) memcpy(out, tail, tail_size);
+
+    out[tail_size] = 0x80;
+    memcpy(out + padding_size - sizeof(u64), &bit_count, sizeof(u64));
+
+    return block_count;
+}
+
+NX_INLINE void sha256MbProcessBlocks(uint32x4_t *state, const u8 * const *src, u32 lane_count, size_t block_count)
+{
+    uint32x4_t abcd[SHA256_MB_LANE_COUNT], efgh[SHA256_MB_LANE_COUNT], msg[SHA256_MB_LANE_COUNT][4];
+
+    for(size_t i = 0; i < block_count; i++)
+    {
+        /* Load current blocks. Message words are stored in big endian order. */
+        #pragma GCC unroll 2
+        for(u32 j = 0; j < lane_count; j++)
+        {
+            abcd[j] = state[j * 2];
+            efgh[j] = state[(j * 2) + 1];
+
+            #pragma GCC unroll 4
+            for(u32 k = 0; k < 4; k++) msg[j][k] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(src[j] + (i * SHA256_MB_BLOCK_SIZE) + (k * 0x10))));
+        }
+
+        /* Perform all rounds, four at a time. Interleave them across all blocks to hide SHA256H/SHA256H2/SHA256SU0/SHA256SU1 latency. */
+        #pragma GCC unroll 16
+        for(u32 k = 0; k < 16; k++)
+        {
+            uint32x4_t round_constants = vld1q_u32(g_sha256RoundConstants + (k * 4));
+
+            #pragma GCC unroll 2
+            for(u32 j = 0; j < lane_count; j++)
+            {
+                uint32x4_t wk = vaddq_u32(msg[j][k & 3], round_constants);
+                uint32x4_t prev_abcd = abcd[j];
+
+                /* Expand the message schedule for the next rounds. */
+                if (k < 12) msg[j][k & 3] = vsha256su1q_u32(vsha256su0q_u32(msg[j][k & 3], msg[j][(k + 1) & 3]), msg[j][(k + 2) & 3], msg[j][(k + 3) & 3]);
+
+                abcd[j] = vsha256hq_u32(abcd[j], efgh[j], wk);
+                efgh[j] = vsha256h2q_u32(efgh[j], prev_abcd, wk);
+            }
+        }
+
+        /* Update hash state. */
+        #pragma GCC unroll 2
+        for(u32 j = 0; j < lane_count; j++)
+        {
+            state[j * 2] = vaddq_u32(state[j * 2], abcd[j]);
+            state[(j * 2) + 1] = vaddq_u32(state[(j * 2) + 1], efgh[j]);
+        }
+    }
+}
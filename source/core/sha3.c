@@ -26,6 +26,40 @@
 
 #define SHA3_NUM_ROUNDS 24
 
+/* Lane operations used by the unrolled Keccak-f[1600] permutation. */
+/* The Switch CPU (Cortex-A57) doesn't implement the ARMv8.2 SHA3 extension, and the ID registers needed to detect it at runtime can't be read from EL0 under Horizon. */
+/* As such, the implementation is picked at build time: the SHA3 instructions are used if the target supports them, and plain 64-bit scalar operations are used otherwise. */
+/* NEON without the SHA3 extension is slower than scalar code for a single Keccak state, since it lacks 64-bit rotations and only holds two lanes per register. */
+#ifdef __ARM_FEATURE_SHA3
+
+#include <arm_neon.h>
+
+typedef uint64x2_t Sha3Lane;
+
+#define SHA3_LOAD(x)                vdupq_n_u64(x)
+#define SHA3_STORE(x)               vgetq_lane_u64((x), 0)
+#define SHA3_XOR5(a, b, c, d, e)    veor3q_u64(veor3q_u64((a), (b), (c)), (d), (e))
+#define SHA3_RAX1(a, b)             vrax1q_u64((a), (b))                        /* a ^ rotl(b, 1). */
+#define SHA3_XAR(a, d, r)           vxarq_u64((a), (d), (64 - (r)) & 63)        /* rotl(a ^ d, r). */
+#define SHA3_BCAX(a, b, c)          vbcaxq_u64((a), (b), (c))                   /* a ^ (b & ~c). */
+#define SHA3_IOTA(a, rc)            veorq_u64((a), vdupq_n_u64(rc))
+
+#else   /* __ARM_FEATURE_SHA3 */
+
+typedef u64 Sha3Lane;
+
+#define SHA3_ROL(x, r)              (((x) << (r)) | ((x) >> ((64 - (r)) & 63)))
+
+#define SHA3_LOAD(x)                (x)
+#define SHA3_STORE(x)               (x)
+#define SHA3_XOR5(a, b, c, d, e)    ((a) ^ (b) ^ (c) ^ (d) ^ (e))
+#define SHA3_RAX1(a, b)             ((a) ^ SHA3_ROL((b), 1))
+#define SHA3_XAR(a, d, r)           SHA3_ROL((a) ^ (d), (r))
+#define SHA3_BCAX(a, b, c)          ((a) ^ ((b) & ~(c)))
+#define SHA3_IOTA(a, rc)            ((a) ^ (rc))
+
+#endif  /* __ARM_FEATURE_SHA3 */
+
 #define _SHA3_CTX_OPS(bits) \
 void sha3##bits##ContextCreate(Sha3Context *out) { \
     sha3ContextCreate(out, bits); \
@@ -54,25 +88,10 @@ static const u64 g_iotaRoundConstant[SHA3_NUM_ROUNDS] = {
     0x0000000080000001, 0x8000000080008008
 };
 
-static const int g_rhoShiftBit[SHA3_NUM_ROUNDS] = {
-     1,  3,  6, 10, 15, 21, 28, 36,
-    45, 55,  2, 14, 27, 41, 56,  8,
-    25, 43, 62, 18, 39, 61, 20, 44
-};
-
-static const int g_rhoNextIndex[SHA3_NUM_ROUNDS] = {
-    10,  7, 11, 17, 18,  3,  5, 16,
-     8, 21, 24,  4, 15, 23, 19, 13,
-    12,  2, 20, 14, 22,  9,  6,  1
-};
-
 static const u64 g_finalMask = 0x8000000000000000;
 
 /* Function prototypes. */
 
-static u64 rotl_u64(u64 x, int s);
-static u64 rotr_u64(u64 x, int s);
-
 static void sha3ContextCreate(Sha3Context *out, u32 hash_size);
 
 static void sha3ProcessBlock(Sha3Context *ctx);
@@ -86,6 +105,8 @@ void sha3ContextUpdate(Sha3Context *ctx, const void *src, size_t size)
         return;
     }
 
+    statsAddCounter(StatsCounterType_Sha3, size);
+
     const u8 *src_u8 = (u8*)src;
     size_t remaining = size;
 
@@ -115,9 +136,13 @@ void sha3ContextUpdate(Sha3Context *ctx, const void *src, size_t size)
     /* Process blocks, if we have any. */
     while(remaining >= ctx->block_size)
     {
-        /* Mix the bytes into our state. */
-        u8 *dst = (u8*)ctx->internal_state;
-        for(size_t i = 0; i < ctx->block_size; ++i) dst[i] ^= src_u8[i];
+        /* Mix the bytes into our state, one lane at a time. Block sizes are always a multiple of the lane size. */
+        for(size_t i = 0; i < (ctx->block_size / sizeof(u64)); ++i)
+        {
+            u64 lane = 0;
+            memcpy(&lane, src_u8 + (i * sizeof(u64)), sizeof(u64));
+            ctx->internal_state[i] ^= lane;
+        }
 
         sha3ProcessBlock(ctx);
 
@@ -162,40 +187,6 @@ _SHA3_CTX_OPS(512);
 
 #undef _SHA3_CTX_OPS
 
-static u64 rotl_u64(u64 x, int s)
-{
-    int N = (sizeof(u64) * 8);
-    int r = (s % N);
-
-    if (r == 0)
-    {
-        return x;
-    } else
-    if (r > 0)
-    {
-        return ((x << r) | (x >> (N - r)));
-    }
-
-    return rotr_u64(x, -r);
-}
-
-static u64 rotr_u64(u64 x, int s)
-{
-    int N = (sizeof(u64) * 8);
-    int r = (s % N);
-
-    if (r == 0)
-    {
-        return x;
-    } else
-    if (r > 0)
-    {
-        return ((x >> r) | (x << (N - r)));
-    }
-
-    return rotl_u64(x, -r);
-}
-
 static void sha3ContextCreate(Sha3Context *out, u32 hash_size)
 {
     if (!out)
@@ -212,43 +203,99 @@ static void sha3ContextCreate(Sha3Context *out, u32 hash_size)
 
 static void sha3ProcessBlock(Sha3Context *ctx)
 {
-    u64 tmp = 0, C[5] = {0};
+    u64 *st = ctx->internal_state;
+
+    Sha3Lane a00, a01, a02, a03, a04, a05, a06, a07, a08, a09, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19, a20, a21, a22, a23, a24;
+    Sha3Lane b00, b01, b02, b03, b04, b05, b06, b07, b08, b09, b10, b11, b12, b13, b14, b15, b16, b17, b18, b19, b20, b21, b22, b23, b24;
+    Sha3Lane c0, c1, c2, c3, c4, d0, d1, d2, d3, d4;
 
-    /* Perform all rounds. */
+    /* Load the state into local variables, so it can be kept in registers across all rounds. */
+    a00 = SHA3_LOAD(st[ 0]); a01 = SHA3_LOAD(st[ 1]); a02 = SHA3_LOAD(st[ 2]); a03 = SHA3_LOAD(st[ 3]); a04 = SHA3_LOAD(st[ 4]);
+    a05 = SHA3_LOAD(st[ 5]); a06 = SHA3_LOAD(st[ 6]); a07 = SHA3_LOAD(st[ 7]); a08 = SHA3_LOAD(st[ 8]); a09 = SHA3_LOAD(st[ 9]);
+    a10 = SHA3_LOAD(st[10]); a11 = SHA3_LOAD(st[11]); a12 = SHA3_LOAD(st[12]); a13 = SHA3_LOAD(st[13]); a14 = SHA3_LOAD(st[14]);
+    a15 = SHA3_LOAD(st[15]); a16 = SHA3_LOAD(st[16]); a17 = SHA3_LOAD(st[17]); a18 = SHA3_LOAD(st[18]); a19 = SHA3_LOAD(st[19]);
+    a20 = SHA3_LOAD(st[20]); a21 = SHA3_LOAD(st[21]); a22 = SHA3_LOAD(st[22]); a23 = SHA3_LOAD(st[23]); a24 = SHA3_LOAD(st[24]);
+
+    /* Perform all rounds. Each round is fully unrolled, with rotation amounts and lane indexes known at build time. */
     for(u8 round = 0; round < SHA3_NUM_ROUNDS; ++round)
     {
         /* Handle theta. */
-        for(size_t i = 0; i < 5; ++i)
-        {
-            C[i] = (ctx->internal_state[i] ^ ctx->internal_state[i + 5] ^ ctx->internal_state[i + 10] ^ ctx->internal_state[i + 15] ^ ctx->internal_state[i + 20]);
-        }
-
-        for(size_t i = 0; i < 5; ++i)
-        {
-            tmp = (C[(i + 4) % 5] ^ rotl_u64(C[(i + 1) % 5], 1));
-            for(size_t j = 0; j < 5; ++j) ctx->internal_state[(5 * j) + i] ^= tmp;
-        }
+        c0 = SHA3_XOR5(a00, a05, a10, a15, a20);
+        c1 = SHA3_XOR5(a01, a06, a11, a16, a21);
+        c2 = SHA3_XOR5(a02, a07, a12, a17, a22);
+        c3 = SHA3_XOR5(a03, a08, a13, a18, a23);
+        c4 = SHA3_XOR5(a04, a09, a14, a19, a24);
+
+        d0 = SHA3_RAX1(c4, c1);
+        d1 = SHA3_RAX1(c0, c2);
+        d2 = SHA3_RAX1(c1, c3);
+        d3 = SHA3_RAX1(c2, c4);
+        d4 = SHA3_RAX1(c3, c0);
 
         /* Handle rho/pi. */
-        tmp = ctx->internal_state[1];
-        for(size_t i = 0; i < SHA3_NUM_ROUNDS; ++i)
-        {
-            const int rho_next_idx = g_rhoNextIndex[i];
-            C[0] = ctx->internal_state[rho_next_idx];
-            ctx->internal_state[rho_next_idx] = rotl_u64(tmp, g_rhoShiftBit[i]);
-            tmp = C[0];
-        }
+        b00 = SHA3_XAR(a00, d0,  0);
+        b10 = SHA3_XAR(a01, d1,  1);
+        b20 = SHA3_XAR(a02, d2, 62);
+        b05 = SHA3_XAR(a03, d3, 28);
+        b15 = SHA3_XAR(a04, d4, 27);
+        b16 = SHA3_XAR(a05, d0, 36);
+        b01 = SHA3_XAR(a06, d1, 44);
+        b11 = SHA3_XAR(a07, d2,  6);
+        b21 = SHA3_XAR(a08, d3, 55);
+        b06 = SHA3_XAR(a09, d4, 20);
+        b07 = SHA3_XAR(a10, d0,  3);
+        b17 = SHA3_XAR(a11, d1, 10);
+        b02 = SHA3_XAR(a12, d2, 43);
+        b12 = SHA3_XAR(a13, d3, 25);
+        b22 = SHA3_XAR(a14, d4, 39);
+        b23 = SHA3_XAR(a15, d0, 41);
+        b08 = SHA3_XAR(a16, d1, 45);
+        b18 = SHA3_XAR(a17, d2, 15);
+        b03 = SHA3_XAR(a18, d3, 21);
+        b13 = SHA3_XAR(a19, d4,  8);
+        b14 = SHA3_XAR(a20, d0, 18);
+        b24 = SHA3_XAR(a21, d1,  2);
+        b09 = SHA3_XAR(a22, d2, 61);
+        b19 = SHA3_XAR(a23, d3, 56);
+        b04 = SHA3_XAR(a24, d4, 14);
 
         /* Handle chi. */
-        for(size_t i = 0; i < 5; ++i)
-        {
-            for(size_t j = 0; j < 5; ++j) C[j] = ctx->internal_state[(5 * i) + j];
-            for(size_t j = 0; j < 5; ++j) ctx->internal_state[(5 * i) + j] ^= ((~C[(j + 1) % 5]) & C[(j + 2) % 5]);
-        }
+        a00 = SHA3_BCAX(b00, b02, b01);
+        a01 = SHA3_BCAX(b01, b03, b02);
+        a02 = SHA3_BCAX(b02, b04, b03);
+        a03 = SHA3_BCAX(b03, b00, b04);
+        a04 = SHA3_BCAX(b04, b01, b00);
+        a05 = SHA3_BCAX(b05, b07, b06);
+        a06 = SHA3_BCAX(b06, b08, b07);
+        a07 = SHA3_BCAX(b07, b09, b08);
+        a08 = SHA3_BCAX(b08, b05, b09);
+        a09 = SHA3_BCAX(b09, b06, b05);
+        a10 = SHA3_BCAX(b10, b12, b11);
+        a11 = SHA3_BCAX(b11, b13, b12);
+        a12 = SHA3_BCAX(b12, b14, b13);
+        a13 = SHA3_BCAX(b13, b10, b14);
+        a14 = SHA3_BCAX(b14, b11, b10);
+        a15 = SHA3_BCAX(b15, b17, b16);
+        a16 = SHA3_BCAX(b16, b18, b17);
+        a17 = SHA3_BCAX(b17, b19, b18);
+        a18 = SHA3_BCAX(b18, b15, b19);
+        a19 = SHA3_BCAX(b19, b16, b15);
+        a20 = SHA3_BCAX(b20, b22, b21);
+        a21 = SHA3_BCAX(b21, b23, b22);
+        a22 = SHA3_BCAX(b22, b24, b23);
+        a23 = SHA3_BCAX(b23, b20, b24);
+        a24 = SHA3_BCAX(b24, b21, b20);
 
         /* Handle iota. */
-        ctx->internal_state[0] ^= g_iotaRoundConstant[round];
+        a00 = SHA3_IOTA(a00, g_iotaRoundConstant[round]);
     }
+
+    /* Store the updated state. */
+    st[ 0] = SHA3_STORE(a00); st[ 1] = SHA3_STORE(a01); st[ 2] = SHA3_STORE(a02); st[ 3] = SHA3_STORE(a03); st[ 4] = SHA3_STORE(a04);
+    st[ 5] = SHA3_STORE(a05); st[ 6] = SHA3_STORE(a06); st[ 7] = SHA3_STORE(a07); st[ 8] = SHA3_STORE(a08); st[ 9] = SHA3_STORE(a09);
+    st[10] = SHA3_STORE(a10); st[11] = SHA3_STORE(a11); st[12] = SHA3_STORE(a12); st[13] = SHA3_STORE(a13); st[14] = SHA3_STORE(a14);
+    st[15] = SHA3_STORE(a15); st[16] = SHA3_STORE(a16); st[17] = SHA3_STORE(a17); st[18] = SHA3_STORE(a18); st[19] = SHA3_STORE(a19);
+    st[20] = SHA3_STORE(a20); st[21] = SHA3_STORE(a21); st[22] = SHA3_STORE(a22); st[23] = SHA3_STORE(a23); st[24] = SHA3_STORE(a24);
 }
 
 static void sha3ProcessLastBlock(Sha3Context *ctx)
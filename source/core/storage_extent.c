@@ -0,0 +1,70 @@
+/*
+ * storage_extent.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <core/nxdt_utils.h>
+
+#define STORAGE_EXTENT_LIST_MIN_CAPACITY    0x10
+
+bool storageExtentListAppend(StorageExtentList *list, const StorageExtent *extent)
+{
+    if (!list || (list->capacity && list->count > list->capacity) || !extent || !extent->size || extent->type >= StorageExtentType_Count || \
+        extent->source >= StorageExtentSource_Count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Merge this extent with the last one if they're contiguous. */
+    if (list->count && extent->type != StorageExtentType_Compressed)
+    {
+        StorageExtent *prev = &(list->extents[list->count - 1]);
+
+        if (prev->type == extent->type && prev->source == extent->source && prev->source_ctx == extent->source_ctx && (prev->offset + prev->size) == extent->offset && \
+            (extent->type == StorageExtentType_Zero || (prev->physical_offset + prev->physical_size) == extent->physical_offset))
+        {
+            prev->size += extent->size;
+            prev->physical_size += extent->physical_size;
+            return true;
+        }
+    }
+
+    /* Grow array geometrically, if needed. */
+    if (list->count >= list->capacity)
+    {
+        u32 capacity = (list->capacity ? (list->capacity * 2) : STORAGE_EXTENT_LIST_MIN_CAPACITY);
+
+        StorageExtent *tmp = realloc(list->extents, capacity * sizeof(StorageExtent));
+        if (!tmp)
+        {
+            LOG_MSG_ERROR("Failed to resize extent array to %u element(s).", capacity);
+            return false;
+        }
+
+        list->extents = tmp;
+        list->capacity = capacity;
+    }
+
+    /* Append new extent. */
+    memcpy(&(list->extents[list->count++]), extent, sizeof(StorageExtent));
+
+    return true;
+}
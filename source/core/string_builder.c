@@ -0,0 +1,196 @@
+/*
+ * string_builder.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <core/nxdt_utils.h>
+
+#define STRING_BUILDER_MIN_CAPACITY 0x400
+#define STRING_BUILDER_NUM_BUF_SIZE 0x18    /* Enough to hold the decimal representation of UINT64_MAX. */
+
+/* Global constants. */
+
+static const char g_stringBuilderHexDigitsLower[0x10] = "0123456789abcdef";
+static const char g_stringBuilderHexDigitsUpper[0x10] = "0123456789ABCDEF";
+
+bool stringBuilderReserve(StringBuilder *sb, size_t extra)
+{
+    if (!sb || (sb->capacity && sb->length >= sb->capacity))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    size_t required = (sb->length + extra + 1);
+    if (sb->data && required <= sb->capacity) return true;
+
+    /* Grow buffer geometrically. */
+    size_t capacity = (sb->capacity ? sb->capacity : STRING_BUILDER_MIN_CAPACITY);
+    while(capacity < required) capacity *= 2;
+
+    char *tmp = realloc(sb->data, capacity);
+    if (!tmp)
+    {
+        LOG_MSG_ERROR("Failed to resize buffer to 0x%lX byte(s).", capacity);
+        return false;
+    }
+
+    if (!sb->data) *tmp = '\0';
+
+    sb->data = tmp;
+    sb->capacity = capacity;
+
+    return true;
+}
+
+bool stringBuilderAppend(StringBuilder *sb, const char *str)
+{
+    if (!str)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    return stringBuilderAppendWithLength(sb, str, strlen(str));
+}
+
+bool stringBuilderAppendWithLength(StringBuilder *sb, const char *str, size_t len)
+{
+    if (!sb || (len && !str))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    if (!stringBuilderReserve(sb, len)) return false;
+
+    if (len) memcpy(sb->data + sb->length, str, len);
+    sb->length += len;
+    sb->data[sb->length] = '\0';
+
+    return true;
+}
+
+__attribute__((format(printf, 2, 3))) bool stringBuilderAppendFormatted(StringBuilder *sb, const char *fmt, ...)
+{
+    if (!sb || !fmt || !*fmt)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    va_list args, args_copy;
+    int formatted_len = 0;
+    size_t free_space = 0;
+    bool success = false;
+
+    /* Make sure the buffer has been allocated. */
+    if (!stringBuilderReserve(sb, 0)) return false;
+
+    va_start(args, fmt);
+    va_copy(args_copy, args);
+
+    /* Try to format the string right into the free space from the buffer. */
+    free_space = (sb->capacity - sb->length);
+
+    formatted_len = vsnprintf(sb->data + sb->length, free_space, fmt, args);
+    if (formatted_len < 0)
+    {
+        LOG_MSG_ERROR("Failed to format string!");
+        sb->data[sb->length] = '\0';
+        goto end;
+    }
+
+    /* Grow the buffer and try again if the formatted string was truncated. */
+    if ((size_t)formatted_len >= free_space)
+    {
+        if (!stringBuilderReserve(sb, (size_t)formatted_len))
+        {
+            sb->data[sb->length] = '\0';
+            goto end;
+        }
+
+        vsnprintf(sb->data + sb->length, sb->capacity - sb->length, fmt, args_copy);
+    }
+
+    sb->length += (size_t)formatted_len;
+
+    success = true;
+
+end:
+    va_end(args_copy);
+    va_end(args);
+
+    return success;
+}
+
+bool stringBuilderAppendUnsigned(StringBuilder *sb, u64 value)
+{
+    char buf[STRING_BUILDER_NUM_BUF_SIZE] = {0};
+    size_t pos = sizeof(buf);
+
+    /* Generate digits from right to left. */
+    do {
+        buf[--pos] = (char)('0' + (value % 10));
+        value /= 10;
+    } while(value);
+
+    return stringBuilderAppendWithLength(sb, buf + pos, sizeof(buf) - pos);
+}
+
+bool stringBuilderAppendHex(StringBuilder *sb, u64 value, u8 min_digits, bool uppercase)
+{
+    const char *digits = (uppercase ? g_stringBuilderHexDigitsUpper : g_stringBuilderHexDigitsLower);
+    char buf[STRING_BUILDER_NUM_BUF_SIZE] = {0};
+    size_t pos = sizeof(buf), max_digits = (sizeof(u64) * 2);
+
+    if (min_digits > max_digits)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Generate digits from right to left. */
+    do {
+        buf[--pos] = digits[value & 0xF];
+        value >>= 4;
+    } while(value);
+
+    /* Add zero padding. */
+    while((sizeof(buf) - pos) < min_digits) buf[--pos] = '0';
+
+    return stringBuilderAppendWithLength(sb, buf + pos, sizeof(buf) - pos);
+}
+
+char *stringBuilderDetach(StringBuilder *sb, size_t *out_length)
+{
+    if (!sb)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    char *str = sb->data;
+    if (out_length) *out_length = (str ? sb->length : 0);
+
+    memset(sb, 0, sizeof(StringBuilder));
+
+    return str;
+}
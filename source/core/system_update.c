@@ -24,7 +24,41 @@
 #include <core/cnmt.h>
 #include <core/romfs.h>
 
-#define SYSTEM_VERSION_FILE_PATH    "/file"
+#define SYSTEM_VERSION_FILE_PATH            "/file"
+
+#define SYSTEM_UPDATE_PREFETCH_SLOT_COUNT   8                   /* Maximum number of NCAs held in memory at once, including the current one. */
+#define SYSTEM_UPDATE_PREFETCH_THREAD_COUNT 2
+#define SYSTEM_UPDATE_PREFETCH_BUDGET       0x2000000           /* 32 MiB, split evenly across all prefetch slots. */
+#define SYSTEM_UPDATE_PREFETCH_SLOT_SIZE    (SYSTEM_UPDATE_PREFETCH_BUDGET / SYSTEM_UPDATE_PREFETCH_SLOT_COUNT)
+
+/* Type definitions. */
+
+typedef enum {
+    SystemUpdatePrefetchSlotState_Free    = 0,  ///< No NCA assigned.
+    SystemUpdatePrefetchSlotState_Pending = 1,  ///< Waiting for a worker thread.
+    SystemUpdatePrefetchSlotState_Reading = 2,  ///< Being filled by a worker thread.
+    SystemUpdatePrefetchSlotState_Ready   = 3,
+    SystemUpdatePrefetchSlotState_Failed  = 4   ///< Data must be read directly from the NCA.
+} SystemUpdatePrefetchSlotState;
+
+typedef struct {
+    u8 state;           ///< SystemUpdatePrefetchSlotState.
+    u32 content_idx;    ///< NCA context index. Each NCA always uses slot (content_idx % SYSTEM_UPDATE_PREFETCH_SLOT_COUNT).
+    u64 size;           ///< Number of bytes prefetched from the start of the NCA.
+    u8 *data;           ///< SYSTEM_UPDATE_PREFETCH_SLOT_SIZE bytes long.
+} SystemUpdatePrefetchSlot;
+
+struct SystemUpdatePrefetchContext {
+    Mutex mutex;
+    CondVar cond;
+    NcaContext **nca_ctxs;  ///< Borrowed from the dump context.
+    u32 content_count;
+    u32 next_content_idx;   ///< Next NCA context index to be assigned a prefetch slot.
+    bool exit;
+    Thread threads[SYSTEM_UPDATE_PREFETCH_THREAD_COUNT];
+    u32 thread_count;
+    SystemUpdatePrefetchSlot slots[SYSTEM_UPDATE_PREFETCH_SLOT_COUNT];
+};
 
 /* Global variables. */
 
@@ -46,6 +80,11 @@ static int systemUpdateNcaContextSortFunction(const void *a, const void *b);
 
 static bool systemUpdateGetSystemVersionFileData(SystemUpdateDumpContext *ctx);
 
+static void systemUpdatePrefetchThreadFunc(void *arg);
+static void systemUpdateAssignPrefetchSlots(SystemUpdatePrefetchContext *prefetch_ctx);
+static u64 systemUpdateReadPrefetchedContentData(SystemUpdateDumpContext *ctx, void *out, u64 read_size);
+static void systemUpdateReleasePrefetchSlot(SystemUpdateDumpContext *ctx);
+
 NX_INLINE NcaContext *systemUpdateGetCurrentNcaContextFromDumpContext(SystemUpdateDumpContext *ctx);
 
 bool systemUpdateInitialize(void)
@@ -74,7 +113,7 @@ bool systemUpdateInitialize(void)
 
         /* Initialize NCA context. */
         /* Don't allow invalid NCA signatures. */
-        if (!ncaInitializeContext(g_systemUpdateNcaContext, g_systemUpdateTitleInfo->storage_id, 0, &(g_systemUpdateTitleInfo->meta_key), \
+        if (!ncaInitializeContextLazy(g_systemUpdateNcaContext, g_systemUpdateTitleInfo->storage_id, 0, &(g_systemUpdateTitleInfo->meta_key), \
             titleGetContentInfoByTypeAndIdOffset(g_systemUpdateTitleInfo, NcmContentType_Meta, 0), NULL) || !g_systemUpdateNcaContext->valid_main_signature)
         {
             LOG_MSG_ERROR("Failed to initialize SystemUpdate Meta NCA context!");
@@ -181,10 +220,14 @@ bool systemUpdateReadCurrentContentFileFromDumpContext(SystemUpdateDumpContext *
     }
 
     u8 nca_hash[SHA256_HASH_SIZE] = {0};
+    u64 prefetched_size = 0;
     bool success = false;
 
-    /* Read NCA data. */
-    if (!ncaReadContentFile(nca_ctx, out, read_size, ctx->cur_content_offset))
+    /* Copy prefetched NCA data, if available. */
+    if (ctx->prefetch_ctx) prefetched_size = systemUpdateReadPrefetchedContentData(ctx, out, read_size);
+
+    /* Read remaining NCA data. */
+    if (prefetched_size < read_size && !ncaReadContentFile(nca_ctx, (u8*)out + prefetched_size, read_size - prefetched_size, ctx->cur_content_offset + prefetched_size))
     {
         LOG_MSG_ERROR("Failed to read %s NCA \"%s\"! (title %016lX).", titleGetNcmContentTypeName(nca_ctx->content_type), \
                                                                        nca_ctx->content_id_str, nca_ctx->title_id);
@@ -214,6 +257,9 @@ bool systemUpdateReadCurrentContentFileFromDumpContext(SystemUpdateDumpContext *
             goto end;
         }
 
+        /* Hand the prefetch slot for this content over to an upcoming content. */
+        if (ctx->prefetch_ctx) systemUpdateReleasePrefetchSlot(ctx);
+
         /* Update system update context. */
         ctx->content_idx++;
         ctx->cur_content_offset = 0;
@@ -226,6 +272,96 @@ end:
     return success;
 }
 
+bool systemUpdateEnableDumpContextPrefetch(SystemUpdateDumpContext *ctx)
+{
+    if (!systemUpdateIsValidDumpContext(ctx) || ctx->prefetch_ctx || ctx->content_idx || ctx->cur_content_offset)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    SystemUpdatePrefetchContext *prefetch_ctx = NULL;
+    bool success = false;
+
+    /* Allocate memory for the prefetch context. */
+    prefetch_ctx = calloc(1, sizeof(SystemUpdatePrefetchContext));
+    if (!prefetch_ctx)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the prefetch context!");
+        goto end;
+    }
+
+    mutexInit(&(prefetch_ctx->mutex));
+    condvarInit(&(prefetch_ctx->cond));
+    prefetch_ctx->nca_ctxs = ctx->nca_ctxs;
+    prefetch_ctx->content_count = ctx->content_count;
+
+    /* Allocate prefetch buffers. */
+    for(u32 i = 0; i < SYSTEM_UPDATE_PREFETCH_SLOT_COUNT; i++)
+    {
+        if (!(prefetch_ctx->slots[i].data = malloc(SYSTEM_UPDATE_PREFETCH_SLOT_SIZE)))
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for prefetch buffer #%u!", i);
+            goto end;
+        }
+    }
+
+    /* Assign prefetch slots to the first contents. The one for the first content is used right away, so it'll probably end up being read directly. */
+    systemUpdateAssignPrefetchSlots(prefetch_ctx);
+
+    /* Create prefetch worker threads. */
+    for(u32 i = 0; i < SYSTEM_UPDATE_PREFETCH_THREAD_COUNT; i++)
+    {
+        if (!utilsCreateThread(&(prefetch_ctx->threads[i]), systemUpdatePrefetchThreadFunc, prefetch_ctx, 1)) break;
+        prefetch_ctx->thread_count++;
+    }
+
+    if (!prefetch_ctx->thread_count)
+    {
+        LOG_MSG_ERROR("Failed to create prefetch worker threads!");
+        goto end;
+    }
+
+    ctx->prefetch_ctx = prefetch_ctx;
+    success = true;
+
+    LOG_MSG_DEBUG("System update prefetch enabled (%u thread[s], %u slot[s], 0x%X bytes per slot).", prefetch_ctx->thread_count, SYSTEM_UPDATE_PREFETCH_SLOT_COUNT,                   SYSTEM_UPDATE_PREFETCH_SLOT_SIZE);
+
+end:
+    if (!success && prefetch_ctx)
+    {
+        for(u32 i = 0; i < SYSTEM_UPDATE_PREFETCH_SLOT_COUNT; i++)
+        {
+            if (prefetch_ctx->slots[i].data) free(prefetch_ctx->slots[i].data);
+        }
+
+        free(prefetch_ctx);
+    }
+
+    return success;
+}
+
+void systemUpdateDisableDumpContextPrefetch(SystemUpdateDumpContext *ctx)
+{
+    SystemUpdatePrefetchContext *prefetch_ctx = (ctx ? ctx->prefetch_ctx : NULL);
+    if (!prefetch_ctx) return;
+
+    /* Ask the worker threads to exit. Any in-progress reads are completed first. */
+    SCOPED_LOCK(&(prefetch_ctx->mutex))
+    {
+        prefetch_ctx->exit = true;
+        condvarWakeAll(&(prefetch_ctx->cond));
+    }
+
+    for(u32 i = 0; i < prefetch_ctx->thread_count; i++) utilsJoinThread(&(prefetch_ctx->threads[i]));
+
+    /* Free prefetch buffers. */
+    for(u32 i = 0; i < SYSTEM_UPDATE_PREFETCH_SLOT_COUNT; i++) free(prefetch_ctx->slots[i].data);
+
+    free(prefetch_ctx);
+    ctx->prefetch_ctx = NULL;
+}
+
 static bool _systemUpdateInitializeDumpContext(SystemUpdateDumpContext *ctx)
 {
     if (!g_systemUpdateInterfaceInit || !ctx)
@@ -455,7 +591,7 @@ static bool systemUpdateGetSystemVersionFileData(SystemUpdateDumpContext *ctx)
     LOG_MSG_DEBUG("Found Data NCA \"%s\" for SystemVersion title.", nca_ctx->content_id_str);
 
     /* Initialize RomFS context. */
-    if (!romfsInitializeContext(&romfs_ctx, &(nca_ctx->fs_ctx[0]), NULL))
+    if (!romfsInitializeContext(&romfs_ctx, ncaGetFsSectionContext(nca_ctx, 0), NULL))
     {
         LOG_MSG_ERROR("Failed to initialize RomFS context for SystemVersion Data NCA!");
         goto end;
@@ -495,3 +631,115 @@ NX_INLINE NcaContext *systemUpdateGetCurrentNcaContextFromDumpContext(SystemUpda
 {
     return ((systemUpdateIsValidDumpContext(ctx) && !systemUpdateIsDumpContextFinished(ctx)) ? ctx->nca_ctxs[ctx->content_idx] : NULL);
 }
+
+static void systemUpdatePrefetchThreadFunc(void *arg)
+{
+    SystemUpdatePrefetchContext *prefetch_ctx = (SystemUpdatePrefetchContext*)arg;
+
+    while(true)
+    {
+        SystemUpdatePrefetchSlot *slot = NULL;
+        bool exit_requested = false;
+
+        SCOPED_LOCK(&(prefetch_ctx->mutex))
+        {
+            while(true)
+            {
+                /* Exit right away if requested. */
+                if ((exit_requested = prefetch_ctx->exit)) break;
+
+                /* Pick the pending slot assigned to the earliest content, since that's the one the reader will be waiting on first. */
+                for(u32 i = 0; i < SYSTEM_UPDATE_PREFETCH_SLOT_COUNT; i++)
+                {
+                    SystemUpdatePrefetchSlot *cur_slot = &(prefetch_ctx->slots[i]);
+                    if (cur_slot->state == SystemUpdatePrefetchSlotState_Pending && (!slot || cur_slot->content_idx < slot->content_idx)) slot = cur_slot;
+                }
+
+                if (slot) break;
+
+                /* Wait for new work. */
+                condvarWait(&(prefetch_ctx->cond), &(prefetch_ctx->mutex));
+            }
+
+            if (slot) slot->state = SystemUpdatePrefetchSlotState_Reading;
+        }
+
+        if (exit_requested) break;
+
+        /* Read NCA data without holding the mutex. Nobody else touches this slot while it's being read. */
+        NcaContext *nca_ctx = prefetch_ctx->nca_ctxs[slot->content_idx];
+        bool success = ncaReadContentFile(nca_ctx, slot->data, slot->size, 0);
+        if (!success) LOG_MSG_WARNING("Failed to prefetch %s NCA \"%s\"! It'll be read directly. (title %016lX).", titleGetNcmContentTypeName(nca_ctx->content_type), \
+                                      nca_ctx->content_id_str, nca_ctx->title_id);
+
+        SCOPED_LOCK(&(prefetch_ctx->mutex))
+        {
+            slot->state = (success ? SystemUpdatePrefetchSlotState_Ready : SystemUpdatePrefetchSlotState_Failed);
+            condvarWakeAll(&(prefetch_ctx->cond));
+        }
+    }
+
+    threadExit();
+}
+
+static void systemUpdateAssignPrefetchSlots(SystemUpdatePrefetchContext *prefetch_ctx)
+{
+    /* Must be called with the prefetch mutex held (or before creating the worker threads). */
+    while(prefetch_ctx->next_content_idx < prefetch_ctx->content_count)
+    {
+        SystemUpdatePrefetchSlot *slot = &(prefetch_ctx->slots[prefetch_ctx->next_content_idx % SYSTEM_UPDATE_PREFETCH_SLOT_COUNT]);
+        if (slot->state != SystemUpdatePrefetchSlotState_Free) break;
+
+        slot->content_idx = prefetch_ctx->next_content_idx++;
+        slot->size = MIN(prefetch_ctx->nca_ctxs[slot->content_idx]->content_size, SYSTEM_UPDATE_PREFETCH_SLOT_SIZE);
+        slot->state = SystemUpdatePrefetchSlotState_Pending;
+    }
+}
+
+static u64 systemUpdateReadPrefetchedContentData(SystemUpdateDumpContext *ctx, void *out, u64 read_size)
+{
+    SystemUpdatePrefetchContext *prefetch_ctx = ctx->prefetch_ctx;
+    SystemUpdatePrefetchSlot *slot = &(prefetch_ctx->slots[ctx->content_idx % SYSTEM_UPDATE_PREFETCH_SLOT_COUNT]);
+    u64 copy_size = 0;
+
+    SCOPED_LOCK(&(prefetch_ctx->mutex))
+    {
+        /* Bail out if this content wasn't assigned a prefetch slot, or if the requested data is past the prefetched area. */
+        if (slot->state == SystemUpdatePrefetchSlotState_Free || slot->content_idx != ctx->content_idx || ctx->cur_content_offset >= slot->size) break;
+
+        /* Read this content directly if no worker thread has started prefetching it yet (e.g. the very first content), instead of waiting for one. */
+        if (slot->state == SystemUpdatePrefetchSlotState_Pending)
+        {
+            slot->state = SystemUpdatePrefetchSlotState_Failed;
+            break;
+        }
+
+        /* Wait until the prefetch worker is done with this content. */
+        while(slot->state == SystemUpdatePrefetchSlotState_Reading) condvarWait(&(prefetch_ctx->cond), &(prefetch_ctx->mutex));
+        if (slot->state != SystemUpdatePrefetchSlotState_Ready) break;
+
+        /* Copy prefetched data. */
+        copy_size = MIN(read_size, slot->size - ctx->cur_content_offset);
+        memcpy(out, slot->data + ctx->cur_content_offset, copy_size);
+    }
+
+    return copy_size;
+}
+
+static void systemUpdateReleasePrefetchSlot(SystemUpdateDumpContext *ctx)
+{
+    SystemUpdatePrefetchContext *prefetch_ctx = ctx->prefetch_ctx;
+    SystemUpdatePrefetchSlot *slot = &(prefetch_ctx->slots[ctx->content_idx % SYSTEM_UPDATE_PREFETCH_SLOT_COUNT]);
+
+    SCOPED_LOCK(&(prefetch_ctx->mutex))
+    {
+        /* Slots are never released while being read, since the reader always waits for the worker before moving past them. */
+        if (slot->content_idx != ctx->content_idx || slot->state == SystemUpdatePrefetchSlotState_Reading) break;
+
+        slot->state = SystemUpdatePrefetchSlotState_Free;
+
+        /* Assign slots to upcoming contents and wake up the worker threads. */
+        systemUpdateAssignPrefetchSlots(prefetch_ctx);
+        condvarWakeAll(&(prefetch_ctx->cond));
+    }
+}
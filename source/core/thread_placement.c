@@ -0,0 +1,347 @@
+/*
+ * thread_placement.c
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <core/nxdt_utils.h>
+
+#define THREAD_PLACEMENT_MAX_THREAD_COUNT   16
+
+#define THREAD_PLACEMENT_UI_PENALTY         2   /* Extra load assigned to the UI core in application mode. */
+#define THREAD_PLACEMENT_UI_APPLET_PENALTY  4   /* Extra load assigned to the UI core in applet mode. */
+
+/* Type definitions. */
+
+typedef struct {
+    const char *name;
+    u8 weight;                                          ///< Load added to a core while this stage is placed on it.
+    u8 core_prefs[THREAD_PLACEMENT_CORE_COUNT];         ///< Cores ordered by preference. Used to break ties between equally loaded cores.
+} ThreadPlacementStageInfo;
+
+typedef struct {
+    bool initialized;
+    u64 core_mask;                                      ///< Process core mask.
+    int ui_core;                                        ///< Core used by the main (UI) thread.
+    u8 ui_penalty;
+} ThreadPlacementProfile;
+
+typedef struct {
+    Handle handle;
+    u8 stage;
+    int core;
+    u64 start_tick;
+} ThreadPlacementThreadEntry;
+
+/* Global variables. */
+
+static Mutex g_threadPlacementMutex = 0;
+
+/* Read and decrypt stages prefer core 1, while hash, write and USB stages prefer core 2. This way, a full pipeline splits evenly between both cores. */
+/* Core 0 is used by the UI thread, which makes it the last resort for every stage. */
+static const ThreadPlacementStageInfo g_threadPlacementStageInfo[ThreadPlacementStage_Count] = {
+    [ThreadPlacementStage_Read]    = { "Read",    1, { 1, 2, 0 } },
+    [ThreadPlacementStage_Decrypt] = { "Decrypt", 2, { 1, 2, 0 } },
+    [ThreadPlacementStage_Hash]    = { "Hash",    2, { 2, 1, 0 } },
+    [ThreadPlacementStage_Write]   = { "Write",   1, { 2, 1, 0 } },
+    [ThreadPlacementStage_Usb]     = { "USB",     1, { 2, 1, 0 } }
+};
+
+static ThreadPlacementProfile g_threadPlacementProfile = {0};
+
+static u32 g_threadPlacementCoreLoad[THREAD_PLACEMENT_CORE_COUNT] = {0};
+static ThreadPlacementThreadEntry g_threadPlacementThreads[THREAD_PLACEMENT_MAX_THREAD_COUNT] = {0};
+static ThreadPlacementStats g_threadPlacementStats[ThreadPlacementStage_Count] = {0};
+
+/* Function prototypes. */
+
+static void threadPlacementInitializeProfile(void);
+static int threadPlacementPickCore(u8 stage);
+
+static void threadPlacementReserveCore(u8 stage, int core);
+static void threadPlacementReleaseCore(u8 stage, int core, u64 wall_ticks, u64 cpu_ticks);
+
+static u64 threadPlacementGetThreadTickCount(Handle handle);
+
+int threadPlacementGetCore(u8 stage)
+{
+    if (stage >= ThreadPlacementStage_Count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return -2;
+    }
+
+    int core = -2;
+    SCOPED_LOCK(&g_threadPlacementMutex) core = threadPlacementPickCore(stage);
+    return core;
+}
+
+bool threadPlacementCreateThread(Thread *out_thread, ThreadFunc func, void *arg, u8 stage)
+{
+    if (!out_thread || !func || stage >= ThreadPlacementStage_Count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    bool success = false;
+
+    SCOPED_LOCK(&g_threadPlacementMutex)
+    {
+        /* The thread is created while holding the lock. This makes sure concurrent placements see each other. */
+        int core = threadPlacementPickCore(stage);
+
+        success = utilsCreateThread(out_thread, func, arg, core);
+        if (!success) break;
+
+        /* Keep track of the thread. If the thread table is full, the thread still runs, but it won't count towards the core load. */
+        for(u32 i = 0; i < THREAD_PLACEMENT_MAX_THREAD_COUNT; i++)
+        {
+            ThreadPlacementThreadEntry *entry = &(g_threadPlacementThreads[i]);
+            if (entry->handle != INVALID_HANDLE) continue;
+
+            entry->handle = out_thread->handle;
+            entry->stage = stage;
+            entry->core = core;
+            entry->start_tick = armGetSystemTick();
+
+            threadPlacementReserveCore(stage, core);
+
+            break;
+        }
+
+        LOG_MSG_DEBUG("%s stage thread placed on core %d.", g_threadPlacementStageInfo[stage].name, core);
+    }
+
+    return success;
+}
+
+void threadPlacementJoinThread(Thread *thread)
+{
+    if (!thread || thread->handle == INVALID_HANDLE)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return;
+    }
+
+    Result rc = threadWaitForExit(thread);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("threadWaitForExit failed! (0x%X).", rc);
+        return;
+    }
+
+    /* The thread handle must still be open to retrieve its CPU time. */
+    u64 end_tick = armGetSystemTick(), cpu_ticks = threadPlacementGetThreadTickCount(thread->handle);
+
+    SCOPED_LOCK(&g_threadPlacementMutex)
+    {
+        for(u32 i = 0; i < THREAD_PLACEMENT_MAX_THREAD_COUNT; i++)
+        {
+            ThreadPlacementThreadEntry *entry = &(g_threadPlacementThreads[i]);
+            if (entry->handle != thread->handle) continue;
+
+            threadPlacementReleaseCore(entry->stage, entry->core, end_tick - entry->start_tick, cpu_ticks);
+            memset(entry, 0, sizeof(ThreadPlacementThreadEntry));
+
+            break;
+        }
+    }
+
+    threadClose(thread);
+
+    memset(thread, 0, sizeof(Thread));
+}
+
+bool threadPlacementEnterStage(u8 stage, ThreadPlacementScope *out_scope)
+{
+    if (stage >= ThreadPlacementStage_Count || !out_scope)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    Result rc = 0;
+
+    memset(out_scope, 0, sizeof(ThreadPlacementScope));
+
+    SCOPED_LOCK(&g_threadPlacementMutex)
+    {
+        int core = threadPlacementPickCore(stage);
+
+        /* Save current affinity. */
+        rc = svcGetThreadCoreMask(&(out_scope->prev_core), &(out_scope->prev_mask), CUR_THREAD_HANDLE);
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_ERROR("svcGetThreadCoreMask failed! (0x%X).", rc);
+            break;
+        }
+
+        /* Move the current thread. Just like utilsCreateThread(), the process core mask is kept as the affinity mask. */
+        rc = svcSetThreadCoreMask(CUR_THREAD_HANDLE, core, g_threadPlacementProfile.core_mask);
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_ERROR("svcSetThreadCoreMask failed! (0x%X).", rc);
+            break;
+        }
+
+        out_scope->stage = stage;
+        out_scope->core = core;
+        out_scope->start_tick = armGetSystemTick();
+        out_scope->start_cpu_tick = threadPlacementGetThreadTickCount(CUR_THREAD_HANDLE);
+        out_scope->active = true;
+
+        threadPlacementReserveCore(stage, core);
+    }
+
+    return out_scope->active;
+}
+
+void threadPlacementExitStage(ThreadPlacementScope *scope)
+{
+    if (!scope || !scope->active) return;
+
+    u64 end_tick = armGetSystemTick(), end_cpu_tick = threadPlacementGetThreadTickCount(CUR_THREAD_HANDLE);
+
+    /* Restore previous affinity. */
+    Result rc = svcSetThreadCoreMask(CUR_THREAD_HANDLE, scope->prev_core, scope->prev_mask);
+    if (R_FAILED(rc)) LOG_MSG_ERROR("svcSetThreadCoreMask failed! (0x%X).", rc);
+
+    SCOPED_LOCK(&g_threadPlacementMutex) threadPlacementReleaseCore(scope->stage, scope->core, end_tick - scope->start_tick, \
+                                                                     end_cpu_tick >= scope->start_cpu_tick ? (end_cpu_tick - scope->start_cpu_tick) : 0);
+
+    memset(scope, 0, sizeof(ThreadPlacementScope));
+}
+
+void threadPlacementGetStats(u8 stage, ThreadPlacementStats *out_stats)
+{
+    if (stage >= ThreadPlacementStage_Count || !out_stats)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return;
+    }
+
+    SCOPED_LOCK(&g_threadPlacementMutex) memcpy(out_stats, &(g_threadPlacementStats[stage]), sizeof(ThreadPlacementStats));
+}
+
+void threadPlacementLogStats(void)
+{
+    SCOPED_LOCK(&g_threadPlacementMutex)
+    {
+        for(u8 i = 0; i < ThreadPlacementStage_Count; i++)
+        {
+            ThreadPlacementStats *stats = &(g_threadPlacementStats[i]);
+            if (!stats->run_count) continue;
+
+            u64 cpu_usage = (stats->wall_ns ? ((stats->cpu_ns * 100) / stats->wall_ns) : 0);
+
+            LOG_MSG_DEBUG("%s stage: %u run(s), %lu ms wall time, %lu ms CPU time (%lu%% CPU usage). Placements per core: %u, %u, %u.", \
+                          g_threadPlacementStageInfo[i].name, stats->run_count, stats->wall_ns / 1000000, stats->cpu_ns / 1000000, cpu_usage, \
+                          stats->core_count[0], stats->core_count[1], stats->core_count[2]);
+        }
+    }
+}
+
+static void threadPlacementInitializeProfile(void)
+{
+    /* Must be called with the thread placement mutex held. */
+    ThreadPlacementProfile *profile = &g_threadPlacementProfile;
+    if (profile->initialized) return;
+
+    Result rc = 0;
+    s32 ui_core = 0;
+    u64 ui_mask = 0;
+
+    /* Get process core mask, limited to the cores usable by utilsCreateThread(). */
+    rc = svcGetInfo(&(profile->core_mask), InfoType_CoreMask, CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("svcGetInfo failed! (0x%X).", rc);
+        profile->core_mask = (BIT(THREAD_PLACEMENT_CORE_COUNT) - 1);
+    }
+
+    if (!(profile->core_mask & (BIT(THREAD_PLACEMENT_CORE_COUNT) - 1))) profile->core_mask |= BIT(0);
+
+    /* Get the core used by the main thread, which runs the UI. */
+    rc = svcGetThreadCoreMask(&ui_core, &ui_mask, envGetMainThreadHandle());
+    if (R_FAILED(rc) || ui_core < 0 || ui_core >= THREAD_PLACEMENT_CORE_COUNT) ui_core = 0;
+
+    profile->ui_core = ui_core;
+    profile->ui_penalty = (utilsIsAppletMode() ? THREAD_PLACEMENT_UI_APPLET_PENALTY : THREAD_PLACEMENT_UI_PENALTY);
+    profile->initialized = true;
+
+    LOG_MSG_DEBUG("Thread placement profile: core mask 0x%lX, UI core %d, %s mode.", profile->core_mask, profile->ui_core, utilsIsAppletMode() ? "applet" : "application");
+}
+
+static int threadPlacementPickCore(u8 stage)
+{
+    /* Must be called with the thread placement mutex held. */
+    threadPlacementInitializeProfile();
+
+    const ThreadPlacementStageInfo *info = &(g_threadPlacementStageInfo[stage]);
+    ThreadPlacementProfile *profile = &g_threadPlacementProfile;
+    int best_core = -1;
+    u32 best_load = 0;
+
+    /* Pick the least loaded core. Preferred cores win ties. */
+    for(u8 i = 0; i < THREAD_PLACEMENT_CORE_COUNT; i++)
+    {
+        int core = info->core_prefs[i];
+        if (!(profile->core_mask & BIT(core))) continue;
+
+        u32 load = (g_threadPlacementCoreLoad[core] + (core == profile->ui_core ? profile->ui_penalty : 0));
+        if (best_core >= 0 && load >= best_load) continue;
+
+        best_core = core;
+        best_load = load;
+    }
+
+    /* Fall back to the default process core if no core is available. This shouldn't happen. */
+    return (best_core >= 0 ? best_core : -2);
+}
+
+static void threadPlacementReserveCore(u8 stage, int core)
+{
+    if (core >= 0) g_threadPlacementCoreLoad[core] += g_threadPlacementStageInfo[stage].weight;
+}
+
+static void threadPlacementReleaseCore(u8 stage, int core, u64 wall_ticks, u64 cpu_ticks)
+{
+    ThreadPlacementStats *stats = &(g_threadPlacementStats[stage]);
+
+    if (core >= 0)
+    {
+        u8 weight = g_threadPlacementStageInfo[stage].weight;
+        g_threadPlacementCoreLoad[core] = (g_threadPlacementCoreLoad[core] > weight ? (g_threadPlacementCoreLoad[core] - weight) : 0);
+        stats->core_count[core]++;
+    }
+
+    stats->run_count++;
+    stats->wall_ns += armTicksToNs(wall_ticks);
+    stats->cpu_ns += armTicksToNs(cpu_ticks);
+}
+
+static u64 threadPlacementGetThreadTickCount(Handle handle)
+{
+    /* Returns the total CPU time used by the provided thread, across all cores. */
+    u64 ticks = 0;
+    Result rc = svcGetInfo(&ticks, InfoType_ThreadTickCount, handle, (u64)-1);
+    if (R_FAILED(rc)) LOG_MSG_WARNING("svcGetInfo failed! (0x%X).", rc);
+    return ticks;
+}
@@ -35,9 +35,14 @@
 #define TIK_COMMON_BIS_SYSTEM_SAVEFILE_PATH         "/save/80000000000000e1"
 #define TIK_PERSONALIZED_BIS_SYSTEM_SAVEFILE_PATH   "/save/80000000000000e2"
 
+#define TIK_ES_SAVEFILE_IDLE_TIMEOUT                30  /* Seconds. Cached ES ticket savefiles are reopened after staying idle for this long, in case the ticket database was modified. */
+
 #define TIK_LIST_SAVEFILE_STORAGE_PATH              "/ticket_list.bin"
 #define TIK_DB_SAVEFILE_STORAGE_PATH                "/ticket.bin"
 
+#define TIK_LIST_INDEX_MIN_CAPACITY                 0x100   /* Must be a power of two. */
+#define TIK_LIST_READ_BUF_SIZE                      (SIGNED_TIK_MAX_SIZE * 0x100)
+
 #define TIK_COMMON_CERT_NAME                        "XS00000020"
 #define TIK_DEV_CERT_ISSUER                         "CA00000004"
 
@@ -53,6 +58,29 @@ typedef struct {
 
 NXDT_ASSERT(TikListEntry, 0x20);
 
+/// Used to hold a single ticket_list.bin entry within a TikListIndex.
+typedef struct {
+    FsRightsId rights_id;
+    u64 ticket_offset;      ///< Ticket offset within ticket.bin.
+    bool occupied;
+} TikListIndexEntry;
+
+/// Rights ID -> ticket.bin offset lookup table built from ticket_list.bin. Uses open addressing with linear probing.
+typedef struct {
+    TikListIndexEntry *entries;
+    u32 capacity;           ///< Always a power of two.
+    u32 count;
+    u32 es_ticket_count;    ///< ES ticket count retrieved right before building the index. Used to detect changes to the ticket database.
+} TikListIndex;
+
+/// Used by tikRetrieveTicketsByRightsIds() to keep track of each ES ticket lookup.
+typedef struct {
+    u32 idx;                ///< Index within the input rights ID and output ticket arrays.
+    u8 titlekey_type;       ///< TikTitleKeyType. Set to TikTitleKeyType_Count if no matching ticket_list.bin entry was found.
+    u64 ticket_offset;      ///< Ticket offset within ticket.bin.
+    bool retrieved;
+} TikBatchLookup;
+
 /// 9.x+ CTR key entry in ES .data segment. Used to store CTR key/IV data for encrypted volatile tickets in ticket.bin and/or encrypted entries in ticket_list.bin.
 /// This is always stored in pairs. The first entry holds the key/IV for the encrypted volatile ticket, while the second entry holds the key/IV for the encrypted entry in ticket_list.bin.
 /// First index in this list is always 0.
@@ -73,9 +101,18 @@ typedef struct {
 
 NXDT_ASSERT(TikEsCtrKeyPattern9x, 0x28);
 
+/// Used while scanning ES program memory for the TikEsCtrKeyEntry9x that decrypts a volatile ticket.
+typedef struct {
+    u8 *buf;            ///< Encrypted signed ticket. Replaced with the decrypted ticket if a matching key entry is found.
+    u64 ticket_offset;  ///< Ticket offset within the ES ticket system savefile.
+} TikEsCtrKeyScanContext;
+
 /* Global variables. */
 
 static Mutex g_esTikSaveMutex = 0;
+static save_ctx_t *g_esTikSaveCtx[TikTitleKeyType_Count] = {NULL};
+static u64 g_esTikSaveLastAccessTick[TikTitleKeyType_Count] = {0};
+static TikListIndex g_esTikListIndex[TikTitleKeyType_Count] = {0};
 
 #if LOG_LEVEL <= LOG_LEVEL_ERROR
 static const char *g_tikTitleKeyTypeStrings[] = {
@@ -84,30 +121,41 @@ static const char *g_tikTitleKeyTypeStrings[] = {
 };
 #endif
 
-static MemoryLocation g_esMemoryLocation = {
-    .program_id = ES_SYSMODULE_TID,
-    .mask = 0,
-    .data = NULL,
-    .data_size = 0
-};
-
 /* Function prototypes. */
 
 static bool tikRetrieveTicketFromGameCardByRightsId(Ticket *dst, const FsRightsId *id);
 static bool tikRetrieveTicketFromEsSaveDataByRightsId(Ticket *dst, const FsRightsId *id);
 
+static void tikRetrieveTicketsFromEsSaveDataByRightsIds(Ticket *dst, const FsRightsId *ids, TikBatchLookup *lookups, u32 lookup_count);
+static int tikSortBatchLookups(const void *a, const void *b);
+
+static bool tikPrepareTicket(Ticket *dst, const FsRightsId *id, u8 key_generation);
+static bool tikProcessRetrievedTicket(Ticket *tik);
+
+static save_ctx_t *tikGetEsSaveFile(u8 titlekey_type);
+static void tikCloseEsSaveFile(u8 titlekey_type);
+
 static bool tikFixTamperedCommonTicket(Ticket *tik);
 static bool tikVerifyRsa2048Sha256Signature(const TikCommonBlock *tik_common_block, u64 hash_area_size, const u8 *signature);
 
 static bool tikGetEncryptedTitleKey(Ticket *tik);
 static bool tikGetDecryptedTitleKey(void *dst, const void *src, u8 key_generation);
 
-static bool tikGetTitleKeyTypeForRightsId(const FsRightsId *id, u8 *out);
-static bool tikRetrieveRightsIdsByTitleKeyType(FsRightsId **out, u32 *out_count, bool personalized);
+static bool tikGetEsTicketCount(u8 titlekey_type, u32 *out_count);
+
+static bool tikBuildTicketListIndex(save_ctx_t *save_ctx, u8 titlekey_type, u32 es_ticket_count);
+static bool tikInsertTicketListIndexEntry(TikListIndex *index, const FsRightsId *id, u64 ticket_offset);
+static bool tikResizeTicketListIndex(TikListIndex *index, u32 capacity);
+static TikListIndexEntry *tikGetTicketListIndexEntry(TikListIndex *index, const FsRightsId *id);
+static void tikFreeTicketListIndex(u8 titlekey_type);
+
+NX_INLINE u32 tikGetTicketListIndexSlot(const FsRightsId *id, u32 capacity);
 
-static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, u64 *out_offset);
-static bool tikRetrieveTicketEntryFromTicketBin(save_ctx_t *save_ctx, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, u64 ticket_offset);
+static bool tikGetTicketBinStorage(save_ctx_t *save_ctx, u8 titlekey_type, allocation_table_storage_ctx_t *out_fat_storage, u64 *out_size);
+static bool tikRetrieveTicketEntryFromTicketBin(allocation_table_storage_ctx_t *fat_storage, u64 ticket_bin_size, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, \
+                                                u64 ticket_offset);
 static bool tikDecryptVolatileTicket(u8 *buf, u64 ticket_offset);
+static bool tikEsCtrKeyScanCallback(const u8 *data, u64 data_size, void *user_data);
 
 static bool tikGetTicketTypeAndSize(void *data, u64 data_size, u8 *out_type, u64 *out_size);
 
@@ -132,21 +180,8 @@ bool tikRetrieveTicketByRightsId(Ticket *dst, const FsRightsId *id, u8 key_gener
         goto end;
     }
 
-    /* Clear output ticket. */
-    memset(dst, 0, sizeof(Ticket));
-
-    /* Validate the key generation field within the rights ID. */
-    u8 key_gen_rid = id->c[0xF];
-    bool old_key_gen = (key_generation < NcaKeyGeneration_Since301NUP);
-
-    if ((old_key_gen && key_gen_rid) || (!old_key_gen && key_gen_rid != key_generation))
-    {
-        LOG_MSG_ERROR("Invalid rights ID key generation! Got 0x%02X, expected 0x%02X.", key_gen_rid, old_key_gen ? 0 : key_generation);
-        goto end;
-    }
-
-    /* Update key generation field. */
-    dst->key_generation = key_generation;
+    /* Prepare output ticket. */
+    if (!tikPrepareTicket(dst, id, key_generation)) goto end;
 
     /* Retrieve ticket data. */
     if (use_gamecard)
@@ -162,32 +197,78 @@ bool tikRetrieveTicketByRightsId(Ticket *dst, const FsRightsId *id, u8 key_gener
         goto end;
     }
 
-    /* Fix tampered common ticket, if needed. */
-    if (!tikFixTamperedCommonTicket(dst)) goto end;
+    /* Process retrieved ticket. */
+    success = tikProcessRetrievedTicket(dst);
 
-    /* Get encrypted titlekey. */
-    if (!tikGetEncryptedTitleKey(dst))
+end:
+    return success;
+}
+
+u32 tikRetrieveTicketsByRightsIds(Ticket *dst, const FsRightsId *ids, const u8 *key_generations, u32 count, bool use_gamecard)
+{
+    if (!dst || !ids || !key_generations || !count)
     {
-        LOG_MSG_ERROR("Unable to retrieve encrypted titlekey from ticket!");
+        LOG_MSG_ERROR("Invalid parameters!");
+        return 0;
+    }
+
+    TikBatchLookup *lookups = NULL;
+    u32 lookup_count = 0, retrieved_count = 0;
+
+    /* Gamecard tickets are stored as individual files, so there's nothing to gain by batching them. */
+    if (use_gamecard)
+    {
+        for(u32 i = 0; i < count; i++)
+        {
+            memset(&(dst[i]), 0, sizeof(Ticket));
+            if (tikRetrieveTicketByRightsId(&(dst[i]), &(ids[i]), key_generations[i], true)) retrieved_count++;
+        }
+
         goto end;
     }
 
-    /* Get decrypted titlekey. */
-    if (!(success = tikGetDecryptedTitleKey(dst->dec_titlekey, dst->enc_titlekey, dst->key_generation)))
+    /* Allocate memory for the lookup entries. */
+    if (!(lookups = calloc(count, sizeof(TikBatchLookup))))
     {
-        LOG_MSG_ERROR("Unable to decrypt titlekey!");
+        LOG_MSG_ERROR("Unable to allocate memory for %u ticket lookup entries!", count);
         goto end;
     }
 
-    /* Generate hex strings. */
-    tik_common_block = tikGetCommonBlockFromSignedTicketBlob(dst->data);
+    /* Prepare output tickets. */
+    for(u32 i = 0; i < count; i++)
+    {
+        if (key_generations[i] > NcaKeyGeneration_Max)
+        {
+            LOG_MSG_ERROR("Invalid key generation value for rights ID #%u! (0x%02X).", i, key_generations[i]);
+            memset(&(dst[i]), 0, sizeof(Ticket));
+            continue;
+        }
+
+        if (tikPrepareTicket(&(dst[i]), &(ids[i]), key_generations[i])) lookups[lookup_count++].idx = i;
+    }
 
-    utilsGenerateHexString(dst->enc_titlekey_str, sizeof(dst->enc_titlekey_str), dst->enc_titlekey, sizeof(dst->enc_titlekey), false);
-    utilsGenerateHexString(dst->dec_titlekey_str, sizeof(dst->dec_titlekey_str), dst->dec_titlekey, sizeof(dst->dec_titlekey), false);
-    utilsGenerateHexString(dst->rights_id_str, sizeof(dst->rights_id_str), tik_common_block->rights_id.c, sizeof(tik_common_block->rights_id.c), false);
+    if (!lookup_count) goto end;
+
+    /* Retrieve ticket data. */
+    SCOPED_LOCK(&g_esTikSaveMutex) tikRetrieveTicketsFromEsSaveDataByRightsIds(dst, ids, lookups, lookup_count);
+
+    /* Process retrieved tickets. */
+    for(u32 i = 0; i < lookup_count; i++)
+    {
+        Ticket *tik = &(dst[lookups[i].idx]);
+
+        if (lookups[i].retrieved && tikProcessRetrievedTicket(tik))
+        {
+            retrieved_count++;
+        } else {
+            memset(tik, 0, sizeof(Ticket));
+        }
+    }
 
 end:
-    return success;
+    if (lookups) free(lookups);
+
+    return retrieved_count;
 }
 
 bool tikConvertPersonalizedTicketToCommonTicket(Ticket *tik, u8 **out_raw_cert_chain, u64 *out_raw_cert_chain_size)
@@ -268,6 +349,14 @@ bool tikConvertPersonalizedTicketToCommonTicket(Ticket *tik, u8 **out_raw_cert_c
     return true;
 }
 
+void tikCloseCachedSaveFiles(void)
+{
+    SCOPED_LOCK(&g_esTikSaveMutex)
+    {
+        for(u8 i = 0; i < TikTitleKeyType_Count; i++) tikCloseEsSaveFile(i);
+    }
+}
+
 static bool tikRetrieveTicketFromGameCardByRightsId(Ticket *dst, const FsRightsId *id)
 {
     if (!dst || !id)
@@ -319,15 +408,16 @@ static bool tikRetrieveTicketFromEsSaveDataByRightsId(Ticket *dst, const FsRight
         return false;
     }
 
-    u8 titlekey_type = 0;
+    u8 titlekey_type = TikTitleKeyType_Count;
 
-    const char *mount_name = NULL;
-    char savefile_path[64] = {0};
     save_ctx_t *save_ctx = NULL;
+    TikListIndexEntry *index_entry = NULL;
+
+    allocation_table_storage_ctx_t fat_storage = {0};
+    u64 ticket_bin_size = 0;
 
-    u64 buf_size = (SIGNED_TIK_MAX_SIZE * 0x100);
+    u64 buf_size = SIGNED_TIK_MAX_SIZE;
     u8 *buf = NULL;
-    u64 ticket_offset = 0;
 
     bool success = false;
 
@@ -338,45 +428,37 @@ static bool tikRetrieveTicketFromEsSaveDataByRightsId(Ticket *dst, const FsRight
         goto end;
     }
 
-    /* Get titlekey type. */
-    if (!tikGetTitleKeyTypeForRightsId(id, &titlekey_type))
+    /* Look for the provided rights ID in the ticket_list.bin index from each ES system savefile. */
+    /* This also gets us the titlekey type. */
+    for(u8 i = TikTitleKeyType_Common; i < TikTitleKeyType_Count; i++)
     {
-        LOG_MSG_ERROR("Unable to retrieve ticket titlekey type!");
-        goto end;
-    }
-
-#if LOG_LEVEL <= LOG_LEVEL_ERROR
-    const char *tik_titlekey_type_str = g_tikTitleKeyTypeStrings[titlekey_type];
-#endif
+        /* Get ES common/personalized system savefile. */
+        if (!(save_ctx = tikGetEsSaveFile(i)))
+        {
+            LOG_MSG_ERROR("Failed to open ES %s ticket system savefile!", g_tikTitleKeyTypeStrings[i]);
+            continue;
+        }
 
-    /* Retrieve mount name for the eMMC BIS System partition. */
-    if (!(mount_name = bisStorageGetMountNameByBisPartitionId(FsBisPartitionId_System)))
-    {
-        LOG_MSG_ERROR("Failed to mount eMMC BIS System partition!");
-        goto end;
+        if ((index_entry = tikGetTicketListIndexEntry(&(g_esTikListIndex[i]), id)))
+        {
+            titlekey_type = i;
+            break;
+        }
     }
 
-    /* Generate savefile path. */
-    snprintf(savefile_path, sizeof(savefile_path), "%s:%s", mount_name, titlekey_type == TikTitleKeyType_Common ? TIK_COMMON_BIS_SYSTEM_SAVEFILE_PATH : TIK_PERSONALIZED_BIS_SYSTEM_SAVEFILE_PATH);
-
-    /* Open ES common/personalized system savefile. */
-    if (!(save_ctx = save_open_savefile(savefile_path, 0)))
+    if (!index_entry)
     {
-        LOG_MSG_ERROR("Failed to open ES %s ticket system savefile!", tik_titlekey_type_str);
+        LOG_MSG_ERROR("Unable to find an entry with a matching Rights ID in \"%s\" from any ES ticket system save!", TIK_LIST_SAVEFILE_STORAGE_PATH);
         goto end;
     }
 
-    /* Get ticket entry offset from ticket_list.bin. */
-    if (!tikGetTicketEntryOffsetFromTicketList(save_ctx, buf, buf_size, id, titlekey_type, &ticket_offset))
-    {
-        LOG_MSG_ERROR("Unable to find an entry with a matching Rights ID in \"%s\" from ES %s ticket system save!", TIK_LIST_SAVEFILE_STORAGE_PATH, tik_titlekey_type_str);
-        goto end;
-    }
+    /* Get FAT storage info for ticket.bin. */
+    if (!tikGetTicketBinStorage(save_ctx, titlekey_type, &fat_storage, &ticket_bin_size)) goto end;
 
     /* Get ticket entry from ticket.bin. */
-    if (!tikRetrieveTicketEntryFromTicketBin(save_ctx, buf, buf_size, id, titlekey_type, ticket_offset))
+    if (!tikRetrieveTicketEntryFromTicketBin(&fat_storage, ticket_bin_size, buf, buf_size, id, titlekey_type, index_entry->ticket_offset))
     {
-        LOG_MSG_ERROR("Unable to find a matching %s ticket entry for the provided Rights ID!", tik_titlekey_type_str);
+        LOG_MSG_ERROR("Unable to find a matching %s ticket entry for the provided Rights ID!", g_tikTitleKeyTypeStrings[titlekey_type]);
         goto end;
     }
 
@@ -391,13 +473,216 @@ static bool tikRetrieveTicketFromEsSaveDataByRightsId(Ticket *dst, const FsRight
     memcpy(dst->data, buf, dst->size);
 
 end:
-    if (save_ctx) save_close_savefile(&save_ctx);
+    /* Close the cached savefile if something went wrong. Both the savefile and its ticket_list.bin index will be regenerated on the next call. */
+    if (!success && titlekey_type < TikTitleKeyType_Count) tikCloseEsSaveFile(titlekey_type);
 
     if (buf) free(buf);
 
     return success;
 }
 
+static save_ctx_t *tikGetEsSaveFile(u8 titlekey_type)
+{
+    const char *mount_name = NULL;
+    char savefile_path[64] = {0};
+    u64 cur_tick = armGetSystemTick();
+    u32 es_ticket_count = 0;
+
+    /* Close idle savefiles. */
+    for(u8 i = 0; i < TikTitleKeyType_Count; i++)
+    {
+        if (g_esTikSaveCtx[i] && armTicksToNs(cur_tick - g_esTikSaveLastAccessTick[i]) >= (TIK_ES_SAVEFILE_IDLE_TIMEOUT * 1000000000UL)) tikCloseEsSaveFile(i);
+    }
+
+    /* Get the current ES ticket count for this titlekey type. */
+    if (!tikGetEsTicketCount(titlekey_type, &es_ticket_count)) return NULL;
+
+    /* Close the cached savefile if tickets were installed or removed since its ticket_list.bin index was built. */
+    if (g_esTikSaveCtx[titlekey_type] && g_esTikListIndex[titlekey_type].es_ticket_count != es_ticket_count) tikCloseEsSaveFile(titlekey_type);
+
+    if (!g_esTikSaveCtx[titlekey_type])
+    {
+        /* Retrieve mount name for the eMMC BIS System partition. */
+        if (!(mount_name = bisStorageGetMountNameByBisPartitionId(FsBisPartitionId_System)))
+        {
+            LOG_MSG_ERROR("Failed to mount eMMC BIS System partition!");
+            return NULL;
+        }
+
+        /* Generate savefile path. */
+        snprintf(savefile_path, sizeof(savefile_path), "%s:%s", mount_name, titlekey_type == TikTitleKeyType_Common ? TIK_COMMON_BIS_SYSTEM_SAVEFILE_PATH : TIK_PERSONALIZED_BIS_SYSTEM_SAVEFILE_PATH);
+
+        /* Open ES common/personalized system savefile. */
+        if (!(g_esTikSaveCtx[titlekey_type] = save_open_savefile(savefile_path, ACTION_LAZY))) return NULL;
+
+        /* Build ticket_list.bin index. */
+        if (!tikBuildTicketListIndex(g_esTikSaveCtx[titlekey_type], titlekey_type, es_ticket_count))
+        {
+            LOG_MSG_ERROR("Failed to build \"%s\" index for ES %s ticket system save!", TIK_LIST_SAVEFILE_STORAGE_PATH, g_tikTitleKeyTypeStrings[titlekey_type]);
+            tikCloseEsSaveFile(titlekey_type);
+            return NULL;
+        }
+    }
+
+    /* Update last access tick. */
+    g_esTikSaveLastAccessTick[titlekey_type] = cur_tick;
+
+    return g_esTikSaveCtx[titlekey_type];
+}
+
+static void tikCloseEsSaveFile(u8 titlekey_type)
+{
+    tikFreeTicketListIndex(titlekey_type);
+
+    if (!g_esTikSaveCtx[titlekey_type]) return;
+
+    save_close_savefile(&(g_esTikSaveCtx[titlekey_type]));
+    g_esTikSaveLastAccessTick[titlekey_type] = 0;
+}
+
+static void tikRetrieveTicketsFromEsSaveDataByRightsIds(Ticket *dst, const FsRightsId *ids, TikBatchLookup *lookups, u32 lookup_count)
+{
+    save_ctx_t *save_ctx[TikTitleKeyType_Count] = {0};
+    bool save_failed[TikTitleKeyType_Count] = {0};
+
+    allocation_table_storage_ctx_t fat_storage = {0};
+    u64 ticket_bin_size = 0;
+    u8 cur_titlekey_type = TikTitleKeyType_Count;
+    bool fat_storage_ok = false;
+
+    /* Get both ES system savefiles right away. Their ticket_list.bin indexes are built at this point, if needed. */
+    for(u8 i = TikTitleKeyType_Common; i < TikTitleKeyType_Count; i++)
+    {
+        if (!(save_ctx[i] = tikGetEsSaveFile(i))) LOG_MSG_ERROR("Failed to open ES %s ticket system savefile!", g_tikTitleKeyTypeStrings[i]);
+    }
+
+    /* Look for each rights ID in the ticket_list.bin indexes. */
+    for(u32 i = 0; i < lookup_count; i++)
+    {
+        TikBatchLookup *lookup = &(lookups[i]);
+        TikListIndexEntry *index_entry = NULL;
+
+        lookup->titlekey_type = TikTitleKeyType_Count;
+
+        for(u8 j = TikTitleKeyType_Common; j < TikTitleKeyType_Count; j++)
+        {
+            if (save_ctx[j] && (index_entry = tikGetTicketListIndexEntry(&(g_esTikListIndex[j]), &(ids[lookup->idx]))))
+            {
+                lookup->titlekey_type = j;
+                lookup->ticket_offset = index_entry->ticket_offset;
+                break;
+            }
+        }
+    }
+
+    /* Sort lookups by savefile and ticket.bin offset, so we can stream through each ticket.bin in order. */
+    /* Lookups without a matching ticket_list.bin entry are placed at the end. */
+    qsort(lookups, lookup_count, sizeof(TikBatchLookup), &tikSortBatchLookups);
+
+    for(u32 i = 0; i < lookup_count; i++)
+    {
+        TikBatchLookup *lookup = &(lookups[i]);
+        Ticket *tik = &(dst[lookup->idx]);
+        const FsRightsId *id = &(ids[lookup->idx]);
+
+        if (lookup->titlekey_type >= TikTitleKeyType_Count)
+        {
+            LOG_DATA_ERROR(id->c, sizeof(id->c), "Unable to find an entry with a matching Rights ID in \"%s\" from any ES ticket system save! Rights ID:", TIK_LIST_SAVEFILE_STORAGE_PATH);
+            continue;
+        }
+
+        /* Get FAT storage info for the ticket.bin from the current savefile. */
+        if (lookup->titlekey_type != cur_titlekey_type)
+        {
+            cur_titlekey_type = lookup->titlekey_type;
+            fat_storage_ok = tikGetTicketBinStorage(save_ctx[cur_titlekey_type], cur_titlekey_type, &fat_storage, &ticket_bin_size);
+            if (!fat_storage_ok) save_failed[cur_titlekey_type] = true;
+        }
+
+        if (!fat_storage_ok) continue;
+
+        /* Get ticket entry from ticket.bin, then get its type and size. */
+        if (!tikRetrieveTicketEntryFromTicketBin(&fat_storage, ticket_bin_size, tik->data, sizeof(tik->data), id, cur_titlekey_type, lookup->ticket_offset) || \
+            !tikGetTicketTypeAndSize(tik->data, sizeof(tik->data), &(tik->type), &(tik->size)))
+        {
+            LOG_DATA_ERROR(id->c, sizeof(id->c), "Unable to retrieve %s ticket entry! Rights ID:", g_tikTitleKeyTypeStrings[cur_titlekey_type]);
+            save_failed[cur_titlekey_type] = true;
+            continue;
+        }
+
+        lookup->retrieved = true;
+    }
+
+    /* Close the cached savefiles that ran into errors. They'll be regenerated on the next call. */
+    for(u8 i = TikTitleKeyType_Common; i < TikTitleKeyType_Count; i++)
+    {
+        if (save_failed[i]) tikCloseEsSaveFile(i);
+    }
+}
+
+static int tikSortBatchLookups(const void *a, const void *b)
+{
+    const TikBatchLookup *lookup_a = (const TikBatchLookup*)a;
+    const TikBatchLookup *lookup_b = (const TikBatchLookup*)b;
+
+    if (lookup_a->titlekey_type != lookup_b->titlekey_type) return (lookup_a->titlekey_type < lookup_b->titlekey_type ? -1 : 1);
+    if (lookup_a->ticket_offset != lookup_b->ticket_offset) return (lookup_a->ticket_offset < lookup_b->ticket_offset ? -1 : 1);
+
+    return 0;
+}
+
+static bool tikPrepareTicket(Ticket *dst, const FsRightsId *id, u8 key_generation)
+{
+    /* Clear output ticket. */
+    memset(dst, 0, sizeof(Ticket));
+
+    /* Validate the key generation field within the rights ID. */
+    u8 key_gen_rid = id->c[0xF];
+    bool old_key_gen = (key_generation < NcaKeyGeneration_Since301NUP);
+
+    if ((old_key_gen && key_gen_rid) || (!old_key_gen && key_gen_rid != key_generation))
+    {
+        LOG_MSG_ERROR("Invalid rights ID key generation! Got 0x%02X, expected 0x%02X.", key_gen_rid, old_key_gen ? 0 : key_generation);
+        return false;
+    }
+
+    /* Update key generation field. */
+    dst->key_generation = key_generation;
+
+    return true;
+}
+
+static bool tikProcessRetrievedTicket(Ticket *tik)
+{
+    TikCommonBlock *tik_common_block = NULL;
+
+    /* Fix tampered common ticket, if needed. */
+    if (!tikFixTamperedCommonTicket(tik)) return false;
+
+    /* Get encrypted titlekey. */
+    if (!tikGetEncryptedTitleKey(tik))
+    {
+        LOG_MSG_ERROR("Unable to retrieve encrypted titlekey from ticket!");
+        return false;
+    }
+
+    /* Get decrypted titlekey. */
+    if (!tikGetDecryptedTitleKey(tik->dec_titlekey, tik->enc_titlekey, tik->key_generation))
+    {
+        LOG_MSG_ERROR("Unable to decrypt titlekey!");
+        return false;
+    }
+
+    /* Generate hex strings. */
+    tik_common_block = tikGetCommonBlockFromSignedTicketBlob(tik->data);
+
+    utilsGenerateHexString(tik->enc_titlekey_str, sizeof(tik->enc_titlekey_str), tik->enc_titlekey, sizeof(tik->enc_titlekey), false);
+    utilsGenerateHexString(tik->dec_titlekey_str, sizeof(tik->dec_titlekey_str), tik->dec_titlekey, sizeof(tik->dec_titlekey), false);
+    utilsGenerateHexString(tik->rights_id_str, sizeof(tik->rights_id_str), tik_common_block->rights_id.c, sizeof(tik_common_block->rights_id.c), false);
+
+    return true;
+}
+
 static bool tikFixTamperedCommonTicket(Ticket *tik)
 {
     TikCommonBlock *tik_common_block = NULL;
@@ -559,118 +844,47 @@ static bool tikGetDecryptedTitleKey(void *dst, const void *src, u8 key_generatio
     return true;
 }
 
-static bool tikGetTitleKeyTypeForRightsId(const FsRightsId *id, u8 *out)
-{
-    if (!id || !out)
-    {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return false;
-    }
-
-    u32 count = 0;
-    FsRightsId *rights_ids = NULL;
-    bool found = false;
-
-    for(u8 i = TikTitleKeyType_Common; i < TikTitleKeyType_Count; i++)
-    {
-        /* Get all rights IDs for the current titlekey type. */
-        if (!tikRetrieveRightsIdsByTitleKeyType(&rights_ids, &count, i == TikTitleKeyType_Personalized))
-        {
-            LOG_MSG_ERROR("Unable to retrieve %s rights IDs!", g_tikTitleKeyTypeStrings[i]);
-            continue;
-        }
-
-        /* Look for the provided rights ID. */
-        for(u32 j = 0; j < count; j++)
-        {
-            if (!memcmp(rights_ids[j].c, id->c, sizeof(id->c)))
-            {
-                *out = i;
-                found = true;
-                break;
-            }
-        }
-
-        if (rights_ids) free(rights_ids);
-
-        if (found) break;
-    }
-
-    return found;
-}
-
-static bool tikRetrieveRightsIdsByTitleKeyType(FsRightsId **out, u32 *out_count, bool personalized)
+static bool tikGetEsTicketCount(u8 titlekey_type, u32 *out_count)
 {
-    if (!out || !out_count)
+    if (titlekey_type >= TikTitleKeyType_Count || !out_count)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
     Result rc = 0;
-    u32 count = 0, ids_written = 0;
-    FsRightsId *rights_ids = NULL;
-    bool success = false;
+    s32 count = 0;
 
 #if LOG_LEVEL <= LOG_LEVEL_ERROR
-    const char *tik_titlekey_type_str = (personalized ? g_tikTitleKeyTypeStrings[TikTitleKeyType_Personalized] : g_tikTitleKeyTypeStrings[TikTitleKeyType_Common]);
+    const char *tik_titlekey_type_str = g_tikTitleKeyTypeStrings[titlekey_type];
 #endif
 
-    *out = NULL;
-    *out_count = 0;
-
     /* Get ticket count for the provided titlekey type. */
-    rc = (personalized ? esCountPersonalizedTicket((s32*)&count) : esCountCommonTicket((s32*)&count));
+    rc = (titlekey_type == TikTitleKeyType_Personalized ? esCountPersonalizedTicket(&count) : esCountCommonTicket(&count));
     if (R_FAILED(rc))
     {
         LOG_MSG_ERROR("esCount%c%sTicket failed! (0x%X).", toupper(*tik_titlekey_type_str), tik_titlekey_type_str + 1, rc);
-        goto end;
-    }
-
-    if (!count)
-    {
-        LOG_MSG_WARNING("No %s tickets available!", tik_titlekey_type_str);
-        success = true;
-        goto end;
-    }
-
-    /* Allocate memory for our rights ID array. */
-    rights_ids = calloc(count, sizeof(FsRightsId));
-    if (!rights_ids)
-    {
-        LOG_MSG_ERROR("Unable to allocate memory for %s rights IDs!", tik_titlekey_type_str);
-        goto end;
-    }
-
-    /* Get rights IDs from all tickets that match the provided titlekey type. */
-    rc = (personalized ? esListPersonalizedTicket((s32*)&ids_written, rights_ids, (s32)count) : esListCommonTicket((s32*)&ids_written, rights_ids, (s32)count));
-    success = (R_SUCCEEDED(rc) && ids_written);
-    if (!success)
-    {
-        LOG_MSG_ERROR("esList%c%sTicket failed! (0x%X). Wrote %u entries, expected %u entries.", toupper(*tik_titlekey_type_str), tik_titlekey_type_str + 1, rc, ids_written, count);
-        goto end;
+        return false;
     }
 
-    /* Update output values. */
-    *out = rights_ids;
-    *out_count = ids_written;
-
-end:
-    if (!success && rights_ids) free(rights_ids);
+    *out_count = (u32)count;
 
-    return success;
+    return true;
 }
 
-static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, u64 *out_offset)
+static bool tikBuildTicketListIndex(save_ctx_t *save_ctx, u8 titlekey_type, u32 es_ticket_count)
 {
-    if (!save_ctx || !buf || !buf_size || (buf_size % sizeof(TikListEntry)) != 0 || !id || titlekey_type >= TikTitleKeyType_Count || !out_offset)
+    if (!save_ctx || titlekey_type >= TikTitleKeyType_Count)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
+    TikListIndex *index = &(g_esTikListIndex[titlekey_type]);
+
     allocation_table_storage_ctx_t fat_storage = {0};
-    u64 ticket_list_bin_size = 0, br = 0, total_br = 0;
+    u64 ticket_list_bin_size = 0, buf_size = TIK_LIST_READ_BUF_SIZE, br = 0, total_br = 0;
+    u8 *buf = NULL;
 
     u8 last_rights_id[0x10] = {0};
     memset(last_rights_id, 0xFF, sizeof(last_rights_id));
@@ -681,6 +895,9 @@ static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf,
     const char *tik_titlekey_type_str = g_tikTitleKeyTypeStrings[titlekey_type];
 #endif
 
+    /* Free previous index, if needed. */
+    tikFreeTicketListIndex(titlekey_type);
+
     /* Get FAT storage info for the ticket_list.bin stored within the opened system savefile. */
     if (!save_get_fat_storage_from_file_entry_by_path(save_ctx, TIK_LIST_SAVEFILE_STORAGE_PATH, &fat_storage, &ticket_list_bin_size))
     {
@@ -695,7 +912,17 @@ static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf,
         goto end;
     }
 
-    /* Look for an entry matching our rights ID in ticket_list.bin. */
+    /* Allocate memory for the read buffer. */
+    if (!(buf = malloc(buf_size)))
+    {
+        LOG_MSG_ERROR("Unable to allocate 0x%lX bytes block for temporary read buffer!", buf_size);
+        goto end;
+    }
+
+    /* Allocate memory for the index. */
+    if (!tikResizeTicketListIndex(index, TIK_LIST_INDEX_MIN_CAPACITY)) goto end;
+
+    /* Add every single ticket list entry to the index. */
     while(total_br < ticket_list_bin_size)
     {
         /* Update chunk size, if needed. */
@@ -705,14 +932,12 @@ static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf,
         if ((br = save_allocation_table_storage_read(&fat_storage, buf, total_br, buf_size)) != buf_size)
         {
             LOG_MSG_ERROR("Failed to read 0x%lX bytes chunk at offset 0x%lX from \"%s\" in ES %s ticket system save!", buf_size, total_br, TIK_LIST_SAVEFILE_STORAGE_PATH, tik_titlekey_type_str);
-            break;
+            goto end;
         }
 
         /* Process individual ticket list entries. */
         for(u64 i = 0; i < buf_size; i += sizeof(TikListEntry))
         {
-            if ((buf_size - i) < sizeof(TikListEntry)) break;
-
             u64 entry_offset = (total_br + i);
             TikListEntry *entry = (TikListEntry*)(buf + i);
 
@@ -723,60 +948,175 @@ static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf,
                 break;
             }
 
-            /* Check if this is the entry we're looking for. */
-            if (!memcmp(entry->rights_id.c, id->c, sizeof(id->c)))
-            {
-                /* Jackpot. */
-                *out_offset = (entry_offset << 5); /* (entry_offset / sizeof(TikListEntry)) * SIGNED_TIK_MAX_SIZE */
-                success = true;
-                break;
-            }
+            /* Add entry to the index. */
+            /* Ticket offset: (entry_offset / sizeof(TikListEntry)) * SIGNED_TIK_MAX_SIZE. */
+            if (!tikInsertTicketListIndexEntry(index, &(entry->rights_id), entry_offset << 5)) goto end;
         }
 
         total_br += br;
 
-        if (last_entry_found || success) break;
+        if (last_entry_found) break;
     }
 
+    /* Update ES ticket count. */
+    index->es_ticket_count = es_ticket_count;
+
+    LOG_MSG_DEBUG("Indexed %u entries from \"%s\" in ES %s ticket system save.", index->count, TIK_LIST_SAVEFILE_STORAGE_PATH, tik_titlekey_type_str);
+
+    success = true;
+
 end:
+    if (!success) tikFreeTicketListIndex(titlekey_type);
+
+    if (buf) free(buf);
+
     return success;
 }
 
-static bool tikRetrieveTicketEntryFromTicketBin(save_ctx_t *save_ctx, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, u64 ticket_offset)
+static bool tikInsertTicketListIndexEntry(TikListIndex *index, const FsRightsId *id, u64 ticket_offset)
 {
-    if (!save_ctx || !buf || buf_size < SIGNED_TIK_MAX_SIZE || !id || titlekey_type >= TikTitleKeyType_Count || (ticket_offset % SIGNED_TIK_MAX_SIZE) != 0)
+    TikListIndexEntry *entry = NULL;
+    u32 slot = 0;
+
+    /* Keep the load factor at or below 50%. */
+    if (((index->count + 1) * 2) > index->capacity && !tikResizeTicketListIndex(index, index->capacity * 2)) return false;
+
+    /* Look for the first free slot. Rights IDs that have already been indexed are skipped, just like a linear search over ticket_list.bin would do. */
+    for(slot = tikGetTicketListIndexSlot(id, index->capacity); index->entries[slot].occupied; slot = ((slot + 1) & (index->capacity - 1)))
     {
-        LOG_MSG_ERROR("Invalid parameters!");
+        if (!memcmp(index->entries[slot].rights_id.c, id->c, sizeof(id->c))) return true;
+    }
+
+    entry = &(index->entries[slot]);
+    memcpy(&(entry->rights_id), id, sizeof(FsRightsId));
+    entry->ticket_offset = ticket_offset;
+    entry->occupied = true;
+
+    index->count++;
+
+    return true;
+}
+
+static bool tikResizeTicketListIndex(TikListIndex *index, u32 capacity)
+{
+    TikListIndexEntry *entries = NULL, *old_entries = index->entries;
+    u32 old_capacity = index->capacity;
+
+    /* Allocate memory for the new table. */
+    if (!(entries = calloc(capacity, sizeof(TikListIndexEntry))))
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for %u ticket list index entries!", capacity);
         return false;
     }
 
-    allocation_table_storage_ctx_t fat_storage = {0};
-    u64 ticket_bin_size = 0, br = 0;
+    index->entries = entries;
+    index->capacity = capacity;
+    index->count = 0;
 
-    TikCommonBlock *tik_common_block = NULL;
+    /* Rehash previous entries. */
+    for(u32 i = 0; i < old_capacity; i++)
+    {
+        if (!old_entries[i].occupied) continue;
 
-    bool is_volatile = false, success = false;
+        u32 slot = tikGetTicketListIndexSlot(&(old_entries[i].rights_id), capacity);
+        while(entries[slot].occupied) slot = ((slot + 1) & (capacity - 1));
+
+        memcpy(&(entries[slot]), &(old_entries[i]), sizeof(TikListIndexEntry));
+        index->count++;
+    }
+
+    if (old_entries) free(old_entries);
+
+    return true;
+}
+
+static TikListIndexEntry *tikGetTicketListIndexEntry(TikListIndex *index, const FsRightsId *id)
+{
+    if (!index->entries || !index->count) return NULL;
+
+    for(u32 slot = tikGetTicketListIndexSlot(id, index->capacity); index->entries[slot].occupied; slot = ((slot + 1) & (index->capacity - 1)))
+    {
+        if (!memcmp(index->entries[slot].rights_id.c, id->c, sizeof(id->c))) return &(index->entries[slot]);
+    }
+
+    return NULL;
+}
+
+static void tikFreeTicketListIndex(u8 titlekey_type)
+{
+    TikListIndex *index = &(g_esTikListIndex[titlekey_type]);
+    if (index->entries) free(index->entries);
+    memset(index, 0, sizeof(TikListIndex));
+}
+
+NX_INLINE u32 tikGetTicketListIndexSlot(const FsRightsId *id, u32 capacity)
+{
+    u64 lo = 0, hi = 0;
+
+    memcpy(&lo, id->c, sizeof(u64));
+    memcpy(&hi, id->c + sizeof(u64), sizeof(u64));
+
+    /* Rights IDs are mostly made of title ID bits, so mix both halves before picking a slot. */
+    return ((u32)(((lo ^ hi) * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1));
+}
+
+static bool tikGetTicketBinStorage(save_ctx_t *save_ctx, u8 titlekey_type, allocation_table_storage_ctx_t *out_fat_storage, u64 *out_size)
+{
+    if (!save_ctx || titlekey_type >= TikTitleKeyType_Count || !out_fat_storage || !out_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
 
 #if LOG_LEVEL <= LOG_LEVEL_ERROR
     const char *tik_titlekey_type_str = g_tikTitleKeyTypeStrings[titlekey_type];
 #endif
 
     /* Get FAT storage info for the ticket.bin stored within the opened system savefile. */
-    if (!save_get_fat_storage_from_file_entry_by_path(save_ctx, TIK_DB_SAVEFILE_STORAGE_PATH, &fat_storage, &ticket_bin_size))
+    if (!save_get_fat_storage_from_file_entry_by_path(save_ctx, TIK_DB_SAVEFILE_STORAGE_PATH, out_fat_storage, out_size))
     {
         LOG_MSG_ERROR("Failed to locate \"%s\" in ES %s ticket system save!", TIK_DB_SAVEFILE_STORAGE_PATH, tik_titlekey_type_str);
-        goto end;
+        return false;
     }
 
     /* Validate ticket.bin size. */
-    if (ticket_bin_size < SIGNED_TIK_MIN_SIZE || (ticket_bin_size % SIGNED_TIK_MAX_SIZE) != 0 || ticket_bin_size < (ticket_offset + SIGNED_TIK_MAX_SIZE))
+    if (*out_size < SIGNED_TIK_MIN_SIZE || (*out_size % SIGNED_TIK_MAX_SIZE) != 0)
     {
-        LOG_MSG_ERROR("Invalid size for \"%s\" in ES %s ticket system save! (0x%lX).", TIK_DB_SAVEFILE_STORAGE_PATH, tik_titlekey_type_str, ticket_bin_size);
+        LOG_MSG_ERROR("Invalid size for \"%s\" in ES %s ticket system save! (0x%lX).", TIK_DB_SAVEFILE_STORAGE_PATH, tik_titlekey_type_str, *out_size);
+        return false;
+    }
+
+    return true;
+}
+
+static bool tikRetrieveTicketEntryFromTicketBin(allocation_table_storage_ctx_t *fat_storage, u64 ticket_bin_size, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, \
+                                                u64 ticket_offset)
+{
+    if (!fat_storage || !buf || buf_size < SIGNED_TIK_MAX_SIZE || !id || titlekey_type >= TikTitleKeyType_Count || (ticket_offset % SIGNED_TIK_MAX_SIZE) != 0)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u64 br = 0;
+
+    TikCommonBlock *tik_common_block = NULL;
+
+    bool is_volatile = false, success = false;
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+    const char *tik_titlekey_type_str = g_tikTitleKeyTypeStrings[titlekey_type];
+#endif
+
+    /* Make sure the ticket offset falls within ticket.bin. */
+    if (ticket_bin_size < (ticket_offset + SIGNED_TIK_MAX_SIZE))
+    {
+        LOG_MSG_ERROR("Ticket offset 0x%lX exceeds \"%s\" size in ES %s ticket system save! (0x%lX).", ticket_offset, TIK_DB_SAVEFILE_STORAGE_PATH, tik_titlekey_type_str, ticket_bin_size);
         goto end;
     }
 
     /* Read ticket data. */
-    if ((br = save_allocation_table_storage_read(&fat_storage, buf, ticket_offset, SIGNED_TIK_MAX_SIZE)) != SIGNED_TIK_MAX_SIZE)
+    if ((br = save_allocation_table_storage_read(fat_storage, buf, ticket_offset, SIGNED_TIK_MAX_SIZE)) != SIGNED_TIK_MAX_SIZE)
     {
         LOG_MSG_ERROR("Failed to read 0x%X-byte long ticket at offset 0x%lX from \"%s\" in ES %s ticket system save!", SIGNED_TIK_MAX_SIZE, ticket_offset, TIK_DB_SAVEFILE_STORAGE_PATH, \
                                                                                                                        tik_titlekey_type_str);
@@ -816,59 +1156,70 @@ static bool tikDecryptVolatileTicket(u8 *buf, u64 ticket_offset)
         return false;
     }
 
-    Aes128CtrContext ctr_ctx = {0};
-    u8 null_ctr[AES_128_KEY_SIZE] = {0}, ctr[AES_128_KEY_SIZE] = {0}, dec_tik[SIGNED_TIK_MAX_SIZE] = {0};
-    TikCommonBlock *tik_common_block = NULL;
-    bool success = false;
-
     /* Don't proceed if HOS version isn't at least 9.0.0. */
     if (!hosversionAtLeast(9, 0, 0))
     {
         LOG_MSG_ERROR("Unable to retrieve ES key entry for volatile tickets under HOS versions below 9.0.0!");
-        goto end;
+        return false;
     }
 
-    /* Retrieve ES program memory. */
-    if (!memRetrieveFullProgramMemory(&g_esMemoryLocation))
+    /* Scan ES program memory for the CTR key/IV needed to decrypt this ticket. These are generated at runtime, so they can only be found within writable memory. */
+    /* This avoids retrieving a full ES program memory dump. */
+    TikEsCtrKeyScanContext scan_ctx = { .buf = buf, .ticket_offset = ticket_offset };
+
+    MemoryScanFilter filter = {
+        .program_id = ES_SYSMODULE_TID,
+        .perm = Perm_Rw,
+        .type_mask = 0,
+        .min_size = 0,
+        .max_size = 0,
+        .pattern_size = (sizeof(TikEsCtrKeyEntry9x) * 2),
+        .callback = &tikEsCtrKeyScanCallback,
+        .user_data = &scan_ctx
+    };
+
+    if (!memScanProgramMemory(&filter))
     {
-        LOG_MSG_ERROR("Failed to retrieve ES program memory!");
-        goto end;
+        LOG_MSG_ERROR("Unable to find ES memory key entry!");
+        return false;
     }
 
-    /* Retrieve the CTR key/IV from ES program memory in order to decrypt this ticket. */
-    for(u64 i = 0; i < g_esMemoryLocation.data_size; i++)
-    {
-        if ((g_esMemoryLocation.data_size - i) < (sizeof(TikEsCtrKeyEntry9x) * 2)) break;
+    return true;
+}
+
+static bool tikEsCtrKeyScanCallback(const u8 *data, u64 data_size, void *user_data)
+{
+    TikEsCtrKeyScanContext *scan_ctx = (TikEsCtrKeyScanContext*)user_data;
 
+    Aes128CtrContext ctr_ctx = {0};
+    u8 null_ctr[AES_128_KEY_SIZE] = {0}, ctr[AES_128_KEY_SIZE] = {0}, dec_tik[SIGNED_TIK_MAX_SIZE] = {0};
+    TikCommonBlock *tik_common_block = NULL;
+
+    for(u64 i = 0; i <= (data_size - (sizeof(TikEsCtrKeyEntry9x) * 2)); i++)
+    {
         /* Check if the key indexes are valid. idx2 should always be an odd number equal to idx + 1. */
-        TikEsCtrKeyPattern9x *pattern = (TikEsCtrKeyPattern9x*)(g_esMemoryLocation.data + i);
+        const TikEsCtrKeyPattern9x *pattern = (const TikEsCtrKeyPattern9x*)(data + i);
         if (pattern->idx2 != (pattern->idx1 + 1) || !(pattern->idx2 & 1)) continue;
 
         /* Check if the key is not null and if the CTR is. */
-        TikEsCtrKeyEntry9x *key_entry = (TikEsCtrKeyEntry9x*)pattern;
+        const TikEsCtrKeyEntry9x *key_entry = (const TikEsCtrKeyEntry9x*)pattern;
         if (!memcmp(key_entry->key, null_ctr, sizeof(null_ctr)) || memcmp(key_entry->ctr, null_ctr, sizeof(null_ctr)) != 0) continue;
 
         /* Check if we can decrypt the current ticket with this data. */
         memset(&ctr_ctx, 0, sizeof(Aes128CtrContext));
-        aes128CtrInitializePartialCtr(ctr, key_entry->ctr, ticket_offset);
+        aes128CtrInitializePartialCtr(ctr, key_entry->ctr, scan_ctx->ticket_offset);
         aes128CtrContextCreate(&ctr_ctx, key_entry->key, ctr);
-        aes128CtrCrypt(&ctr_ctx, dec_tik, buf, SIGNED_TIK_MAX_SIZE);
+        aes128CtrCrypt(&ctr_ctx, dec_tik, scan_ctx->buf, SIGNED_TIK_MAX_SIZE);
 
         /* Check if we successfully decrypted this ticket. */
         if ((tik_common_block = tikGetCommonBlockFromSignedTicketBlob(dec_tik)) != NULL && !strncmp(tik_common_block->issuer, "Root-", 5))
         {
-            memcpy(buf, dec_tik, SIGNED_TIK_MAX_SIZE);
-            success = true;
-            break;
+            memcpy(scan_ctx->buf, dec_tik, SIGNED_TIK_MAX_SIZE);
+            return true;
         }
     }
 
-    if (!success) LOG_MSG_ERROR("Unable to find ES memory key entry!");
-
-end:
-    memFreeMemoryLocation(&g_esMemoryLocation);
-
-    return success;
+    return false;
 }
 
 static bool tikGetTicketTypeAndSize(void *data, u64 data_size, u8 *out_type, u64 *out_size)
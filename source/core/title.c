@@ -24,6 +24,7 @@
 #include <core/gamecard.h>
 #include <core/nacp.h>
 #include <core/cnmt.h>
+#include <core/nxdt_json.h>
 
 #define NS_APPLICATION_RECORD_BLOCK_SIZE    1024
 
@@ -32,6 +33,30 @@
 
 #define NCM_CMT_APP_OFFSET                  0x7A
 
+#define TITLE_CONTROL_NCA_THREAD_COUNT      3                                       /* Cores 0, 1 and 2. */
+
+#define TITLE_METADATA_CACHE_MAGIC          0x544D4443                              /* "TMDC". */
+#define TITLE_METADATA_CACHE_VERSION        1
+
+#define TITLE_ID_INDEX_MIN_CAPACITY         0x40                                    /* Must be a power of two. */
+
+#define TITLE_LINKED_LIST_INDEX(type)       ((type) - NcmContentMetaType_Application)
+#define TITLE_LINKED_LIST_COUNT             (TITLE_LINKED_LIST_INDEX(NcmContentMetaType_DataPatch) + 1)
+
+#define TITLE_QUERY_META_TYPE_BIT(type)     BIT((type) < NcmContentMetaType_Application ? (type) : ((type) - NcmContentMetaType_Application + 8))
+#define TITLE_QUERY_TRIGRAM(str)            (((u32)(u8)(str)[0] << 16) | ((u32)(u8)(str)[1] << 8) | (u32)(u8)(str)[2])
+#define TITLE_QUERY_TRIGRAM_LENGTH          3
+
+#define TITLE_INFO_SNAPSHOT_MAGIC           0x54534E50                              /* "TSNP". */
+#define TITLE_INFO_SNAPSHOT_CACHE_SIZE      16
+
+#define TITLE_RECORDS_EXPORT_CHUNK_SIZE     0x10000                                 /* Title records are handed over to the write callback in chunks of at least this size. */
+
+#define TITLE_META_KEY_PAGE_COUNT           0x400                                   /* Content meta keys requested by the first ncmContentMetaDatabaseList call. Covers most storages. */
+#define TITLE_CONTENT_INFO_PAGE_COUNT       0x10                                    /* Initial capacity for the content info scratch buffer. Grown as needed. */
+
+#define TITLE_GAMECARD_PREFETCH_PRIORITY    0x3F                                    /* Lowest priority available to homebrew threads. Used while prefetching gamecard metadata. */
+
 /* Type definitions. */
 
 typedef struct {
@@ -39,12 +64,26 @@ typedef struct {
     char name[32];
 } TitleSystemEntry;
 
+/// Used to hold a single entry within a TitleIdIndex.
+typedef struct {
+    u64 title_id;
+    void *value;            ///< Set to NULL if the slot is empty.
+} TitleIdIndexEntry;
+
+/// Title ID -> entry lookup table. Uses open addressing with linear probing.
+typedef struct {
+    TitleIdIndexEntry *entries;
+    u32 capacity;           ///< Always a power of two.
+    u32 count;
+} TitleIdIndex;
+
 typedef struct {
     u8 storage_id;                  ///< NcmStorageId.
     NcmContentMetaDatabase ncm_db;
     NcmContentStorage ncm_storage;
     TitleInfo **titles;
     u32 title_count;
+    TitleIdIndex title_index;       ///< Points to the first entry from 'titles' with each title ID. Rebuilt each time 'titles' is sorted.
 } TitleStorage;
 
 typedef struct {
@@ -53,22 +92,157 @@ typedef struct {
     NcmContentMetaKey meta_key;
 } TitleGameCardContentMetaContext;
 
+/// User application metadata cache file layout:
+///     - TitleMetadataCacheHeader.
+///     - TitleMetadataCacheEntry array with 'entry_count' elements, sorted by application ID in ascending order.
+///       Each entry is immediately followed by 'icon_size' bytes of JPEG icon data.
+typedef struct {
+    u32 magic;              ///< TITLE_METADATA_CACHE_MAGIC.
+    u32 version;            ///< TITLE_METADATA_CACHE_VERSION.
+    u32 entry_count;        ///< Number of TitleMetadataCacheEntry elements.
+    u8 reserved_1[0x4];
+    u64 language_code;      ///< System language code used to pick each language entry. The whole cache is discarded if it changes.
+    u8 reserved_2[0x8];
+} TitleMetadataCacheHeader;
+
+NXDT_ASSERT(TitleMetadataCacheHeader, 0x20);
+
+typedef struct {
+    NsApplicationRecord record;     ///< NS application record this entry was generated from. The entry is refreshed if the current record doesn't match.
+    u32 icon_size;
+    u8 reserved[0x4];
+    NacpLanguageEntry lang_entry;
+} TitleMetadataCacheEntry;
+
+NXDT_ASSERT(TitleMetadataCacheEntry, 0x320);
+
+/// Loaded user application metadata cache.
+typedef struct {
+    u8 *data;                                   ///< Raw cache file contents.
+    const TitleMetadataCacheEntry **entries;    ///< Pointers to each entry within 'data', sorted by application ID.
+    u32 entry_count;
+} TitleMetadataCache;
+
+/// Immutable, reference-counted copy of a TitleInfo linked list, allocated as a single block.
+/// This header is immediately followed by the requested TitleInfo element, then by the rest of the TitleInfo elements and all of their content infos.
+typedef struct {
+    u32 magic;              ///< TITLE_INFO_SNAPSHOT_MAGIC.
+    u32 ref_count;          ///< Only updated using atomic operations, since titleFreeTitleInfo() doesn't lock the title interface mutex.
+    u64 generation;         ///< Title database generation this snapshot was built from.
+} TitleInfoSnapshotHeader;
+
+NXDT_ASSERT(TitleInfoSnapshotHeader, 0x10);
+
+/// Used to share snapshots for frequently requested TitleInfo elements.
+typedef struct {
+    const TitleInfo *source;
+    TitleInfo *snapshot;    ///< Holds its own reference.
+} TitleInfoSnapshotCacheEntry;
+
+/// Used by titleExportTitleRecords() to batch title records before handing them over to the write callback.
+typedef struct {
+    u8 format;                          ///< TitleRecordsFormat.
+    TitleRecordsWriteCallback write_cb;
+    void *user_data;
+    char *buf;                          ///< Reused after each flush.
+    size_t buf_size;
+    u32 record_count;
+} TitleRecordsExportContext;
+
+/// Used by titleGenerateTitleRecordsCsv() to collect all the exported title records.
+typedef struct {
+    char *data;
+    size_t size;
+} TitleRecordsBuffer;
+
+/// Used to hold a single trigram posting within a TitleQueryIndex.
+typedef struct {
+    u32 trigram;            ///< Three consecutive bytes from a lowercase string.
+    u32 entry_idx;          ///< Index of the filtered application metadata entry this trigram belongs to.
+} TitleQueryTrigram;
+
+/// Holds precomputed attributes for a single filtered application metadata entry.
+typedef struct {
+    char *name;             ///< Lowercase copy of the application name.
+    char *author;           ///< Lowercase copy of the publisher name.
+    u64 size;               ///< Combined size from all titles that belong to this entry.
+    u16 meta_type_mask;     ///< Built using TITLE_QUERY_META_TYPE_BIT().
+    u8 storage_mask;        ///< Built using BIT(TITLE_STORAGE_INDEX()).
+} TitleQueryEntry;
+
+/// Secondary indexes over a filtered application metadata pointer array. Built on demand by titleQueryApplicationMetadataEntries().
+typedef struct {
+    bool built;
+    TitleQueryEntry *entries;                   ///< Same length and order as the filtered application metadata pointer array.
+    u32 entry_count;
+    TitleQueryTrigram *name_trigrams;           ///< Sorted by trigram, then by entry index. Duplicates are removed.
+    u32 name_trigram_count;
+    TitleQueryTrigram *author_trigrams;         ///< Sorted by trigram, then by entry index. Duplicates are removed.
+    u32 author_trigram_count;
+} TitleQueryIndex;
+
+/// Precomputed sort key for a single element from a pointer array. Sorting an array of these only involves integer comparisons in most cases.
+typedef struct {
+    u64 key[2];             ///< Compared as unsigned integers, in order.
+    const char *name;       ///< Only set while sorting by name. Used with strcasecmp() if both keys match.
+    void *ptr;              ///< Element from the pointer array.
+} TitleSortKey;
+
+NXDT_ASSERT(TitleSortKey, 0x20);
+
+typedef enum {
+    TitleSortKeyType_SystemMetadata = 0,   ///< TitleApplicationMetadata. Sorted by title ID.
+    TitleSortKeyType_UserMetadata   = 1,   ///< TitleApplicationMetadata. Sorted by name (case insensitive).
+    TitleSortKeyType_TitleInfo      = 2    ///< TitleInfo. Sorted by title ID, version and storage ID.
+} TitleSortKeyType;
+
+/// Used to keep track of NS application records we couldn't find in the user application metadata cache during initialization.
+/// Their metadata is retrieved by the gamecard title info thread, which takes ownership of this data once titleInitialize() returns.
+typedef struct {
+    NsApplicationRecord *records;
+    TitleApplicationMetadata **record_metadata; ///< NULL elements belong to records that are still pending.
+    u32 record_count;
+    u32 pending_count;
+    u64 language_code;
+    bool use_cache;
+} TitleDeferredMetadataContext;
+
+typedef struct {
+    TitleInfo *title_info;
+    TitleApplicationMetadata *app_metadata;     ///< Set by a Control NCA worker thread.
+} TitleControlNcaJob;
+
+typedef struct {
+    Mutex mutex;
+    TitleControlNcaJob *jobs;
+    u32 job_count;
+    u32 next_job_idx;
+    CancelToken *cancel_token;                  ///< Cancellation token bound to the thread that created the queue, if any. Also bound to every worker thread.
+} TitleControlNcaJobQueue;
+
 /* Global variables. */
 
 static Mutex g_titleMutex = 0;
 
 static Thread g_titleGameCardInfoThread = {0};
 static UEvent g_titleGameCardInfoThreadExitEvent = {0}, *g_titleGameCardStatusChangeUserEvent = NULL;
+static CancelToken g_titleGameCardInfoThreadCancelToken = {0};
 static bool g_titleInterfaceInit = false, g_titleGameCardInfoThreadCreated = false, g_titleGameCardAvailable = false, g_titleGameCardInfoUpdated = false;
+static bool g_titleUserTitleInfoUpdated = false;
+
+static TitleDeferredMetadataContext g_titleDeferredMetadata = {0};
 
 static NsApplicationControlData *g_nsAppControlData = NULL;
 
 static TitleApplicationMetadata **g_systemMetadata = NULL, **g_userMetadata = NULL;
 static u32 g_systemMetadataCount = 0, g_userMetadataCount = 0;
+static TitleIdIndex g_systemMetadataIndex = {0}, g_userMetadataIndex = {0};
 
 static TitleApplicationMetadata **g_filteredSystemMetadata = NULL, **g_filteredUserMetadata = NULL;
 static u32 g_filteredSystemMetadataCount = 0, g_filteredUserMetadataCount = 0;
 
+static TitleQueryIndex g_systemQueryIndex = {0}, g_userQueryIndex = {0};
+
 static TitleGameCardApplicationMetadata *g_titleGameCardApplicationMetadata = NULL;
 static u32 g_titleGameCardApplicationMetadataCount = 0;
 
@@ -76,6 +250,10 @@ static char *g_titleGameCardFileNames[TitleNamingConvention_Count] = {NULL};
 
 static TitleStorage g_titleStorage[TITLE_STORAGE_COUNT] = {0};
 
+static u64 g_titleInfoGeneration = 0;
+static TitleInfoSnapshotCacheEntry g_titleInfoSnapshotCache[TITLE_INFO_SNAPSHOT_CACHE_SIZE] = {0};
+static u32 g_titleInfoSnapshotCacheNextIdx = 0;
+
 static TitleInfo **g_orphanTitleInfo = NULL;
 static u32 g_orphanTitleInfoCount = 0;
 
@@ -554,6 +732,7 @@ static const u32 g_systemTitlesCount = MAX_ELEMENTS(g_systemTitles);
 
 NX_INLINE void titleFreeApplicationMetadata(void);
 static bool titleReallocateApplicationMetadata(u32 extra_app_count, bool is_system, bool free_entries);
+static void titleSortApplicationMetadata(bool is_system);
 
 NX_INLINE bool titleInitializePersistentTitleStorages(void);
 NX_INLINE void titleCloseTitleStorages(void);
@@ -562,12 +741,22 @@ static bool titleInitializeTitleStorage(u8 storage_id);
 static bool titleInitializeGameCardTitleStorageByHashFileSystem(u8 hfs_partition_type);
 static void titleCloseTitleStorage(u8 storage_id);
 static bool titleReallocateTitleInfoFromStorage(TitleStorage *title_storage, u32 extra_title_count, bool free_entries);
+static void titleSortTitleInfoFromStorage(TitleStorage *title_storage);
 
 NX_INLINE void titleFreeOrphanTitleInfoEntries(void);
 static void titleAddOrphanTitleInfoEntry(TitleInfo *orphan_title);
+static void titleLogOrphanTitleInfoEntries(void);
 
 static bool titleGenerateMetadataEntriesFromSystemTitles(void);
 static bool titleGenerateMetadataEntriesFromNsRecords(void);
+static bool titleLoadDeferredApplicationMetadata(Waiter exit_event_waiter);
+static void titleFreeDeferredApplicationMetadata(void);
+
+static bool titleLoadMetadataCache(TitleMetadataCache *out, u64 language_code);
+static const TitleMetadataCacheEntry *titleFindMetadataCacheEntry(const TitleMetadataCache *cache, const NsApplicationRecord *record);
+static TitleApplicationMetadata *titleGenerateUserMetadataEntryFromCache(const TitleMetadataCacheEntry *entry);
+static void titleSaveMetadataCache(const NsApplicationRecord *records, TitleApplicationMetadata **record_metadata, u32 record_count, u64 language_code);
+static void titleFreeMetadataCache(TitleMetadataCache *cache);
 
 static TitleApplicationMetadata *titleGetSystemMetadataEntry(u64 title_id);
 static TitleApplicationMetadata *titleGenerateUserMetadataEntryFromNs(u64 title_id);
@@ -581,6 +770,19 @@ static TitleApplicationMetadata *titleInitializeUserMetadataEntryFromControlData
 static void titleGenerateFilteredApplicationMetadataPointerArray(bool is_system);
 static bool titleIsUserApplicationContentAvailable(u64 app_id);
 
+static bool titleAppendTitleRecord(TitleRecordsExportContext *ctx, const char *name, bool escaped_name, TitleInfo *title_info);
+static bool titleAppendTitleRecordsExportString(TitleRecordsExportContext *ctx, const char *str);
+static bool titleFlushTitleRecordsExportBuffer(TitleRecordsExportContext *ctx);
+static bool titleAppendTitleRecordsToBuffer(const void *data, size_t data_size, void *user_data);
+
+static bool titleBuildQueryIndex(bool is_system);
+static bool titleGenerateQueryIndexTrigrams(TitleQueryIndex *index, bool author);
+static void titleUpdateQueryIndexEntryAttributes(TitleQueryIndex *index, bool is_system);
+static const TitleQueryTrigram *titleGetQueryIndexTrigramRange(const TitleQueryTrigram *trigrams, u32 trigram_count, u32 trigram, u32 *out_count);
+static bool titleQueryIndexEntryMatches(const TitleQueryEntry *entry, const char *name, const char *author, const TitleQueryFilter *filter);
+static void titleFreeQueryIndex(bool is_system);
+static char *titleGenerateLowercaseString(const char *str, size_t max_len);
+
 NX_INLINE TitleApplicationMetadata *titleFindApplicationMetadataByTitleId(u64 title_id, bool is_system, u32 extra_app_count);
 
 NX_INLINE u64 titleGetApplicationIdByContentMetaKey(const NcmContentMetaKey *meta_key);
@@ -588,31 +790,54 @@ NX_INLINE u64 titleGetApplicationIdByContentMetaKey(const NcmContentMetaKey *met
 static bool titleGenerateTitleInfoEntriesForTitleStorage(TitleStorage *title_storage);
 static bool titleGenerateTitleInfoEntriesByHashFileSystemForGameCardTitleStorage(TitleStorage *title_storage, HashFileSystemContext *hfs_ctx);
 
-static TitleInfo *titleGenerateTitleInfoEntry(u8 storage_id, const NcmContentMetaKey *meta_key, NcmContentInfo *content_infos, u32 content_count, bool get_control_nca_metadata);
+static TitleInfo *titleGenerateTitleInfoEntry(u8 storage_id, const NcmContentMetaKey *meta_key, NcmContentInfo *content_infos, u32 content_count);
 static bool titleInitializeTitleInfoApplicationMetadataFromControlNca(TitleInfo *title_info);
+static void titleInitializeTitleInfoApplicationMetadataFromControlNcas(TitleInfo **titles, u32 title_count);
+static void titleControlNcaWorkerThreadFunc(void *arg);
 
 static bool titleGetMetaKeysFromContentDatabase(NcmContentMetaDatabase *ncm_db, NcmContentMetaKey **out_meta_keys, u32 *out_meta_key_count);
-static bool titleGetContentInfosByMetaKey(NcmContentMetaDatabase *ncm_db, const NcmContentMetaKey *meta_key, NcmContentInfo **out_content_infos, u32 *out_content_count);
+static bool titleGetContentInfosByMetaKey(NcmContentMetaDatabase *ncm_db, const NcmContentMetaKey *meta_key, NcmContentInfo **scratch_buf, u32 *scratch_buf_count, \
+                                          NcmContentInfo **out_content_infos, u32 *out_content_count);
 
 static bool titleGetGameCardContentMetaContexts(HashFileSystemContext *hfs_ctx, TitleGameCardContentMetaContext **out_gc_meta_ctxs, u32 *out_gc_meta_ctx_count);
 static void titleFreeGameCardContentMetaContexts(TitleGameCardContentMetaContext **gc_meta_ctxs, u32 gc_meta_ctx_count);
+static bool titleStageGameCardHashFileSystemEntries(HashFileSystemContext *hfs_ctx, const u32 *entry_indices, u32 entry_index_count);
 
+static TitleInfo *_titleGetGameCardUpdateTitleInfoList(void);
 static bool titleGetContentInfosByGameCardContentMetaContext(TitleGameCardContentMetaContext *gc_meta_ctx, HashFileSystemContext *hfs_ctx, NcmContentInfo **out_content_infos, u32 *out_content_count);
 
 static void titleUpdateTitleInfoLinkedLists(void);
+static void titleUpdateGameCardTitleInfoLinkedLists(void);
+static void titleUnlinkGameCardTitleInfoEntries(void);
+static bool titlePrepareTitleInfoEntryForLinkedLists(TitleInfo *child_info);
+static void titleLinkPreviousTitleInfoEntry(TitleInfo *child_info, TitleIdIndex *tails, bool update_tail);
+static bool titleIsOrphanTitleInfoEntry(TitleInfo *title_info);
+static void titleFreeLinkedListTails(TitleIdIndex *tails);
+
+NX_INLINE u64 titleGetLinkedListIdByContentMetaKey(const NcmContentMetaKey *meta_key);
+
+static bool titleInsertTitleIdIndexEntry(TitleIdIndex *index, u64 title_id, void *value, bool replace);
+static bool titleResizeTitleIdIndex(TitleIdIndex *index, u32 capacity);
+static void *titleGetTitleIdIndexEntry(const TitleIdIndex *index, u64 title_id);
+static void titleFreeTitleIdIndex(TitleIdIndex *index);
+
+NX_INLINE u32 titleGetTitleIdIndexSlot(u64 title_id, u32 capacity);
 
 static TitleInfo *_titleGetTitleInfoEntryFromStorageByTitleId(u8 storage_id, u64 title_id);
 
 static bool _titleGetUserApplicationData(u64 app_id, TitleUserApplicationData *out);
 
-static TitleInfo *titleDuplicateTitleInfoFull(TitleInfo *title_info, TitleInfo *previous, TitleInfo *next);
-static TitleInfo *titleDuplicateTitleInfo(TitleInfo *title_info);
+static TitleInfo *titleGetTitleInfoSnapshot(TitleInfo *title_info, bool use_cache);
+static TitleInfo *titleCreateTitleInfoSnapshot(TitleInfo **nodes, u32 node_count, u32 ret_idx);
+static void titleReleaseTitleInfoSnapshot(TitleInfo *snapshot);
+static void titleUpdateTitleInfoGeneration(void);
 
 static char *titleGetDisplayVersionString(TitleInfo *title_info);
 
 static bool titleCreateGameCardInfoThread(void);
 static void titleDestroyGameCardInfoThread(void);
 static void titleGameCardInfoThreadFunc(void *arg);
+static bool titlePrefetchGameCardMetadata(Waiter exit_event_waiter);
 
 static bool titleRefreshGameCardTitleInfo(void);
 
@@ -622,11 +847,16 @@ NX_INLINE void titleGenerateGameCardFileNames(void);
 NX_INLINE void titleFreeGameCardFileNames(void);
 static char *_titleGenerateGameCardFileName(u8 naming_convention);
 
+static void titleSortPointerArray(void **ptrs, u32 count, u8 type);
+NX_INLINE u64 titleGetNameSortKey(const char *name, size_t offset);
+
+static int titleSortKeySortFunction(const void *a, const void *b);
 static int titleSystemMetadataSortFunction(const void *a, const void *b);
 static int titleUserMetadataSortFunction(const void *a, const void *b);
 static int titleInfoSortFunction(const void *a, const void *b);
 static int titleGameCardApplicationMetadataSortFunction(const void *a, const void *b);
 static int titleGameCardContentMetaContextSortFunction(const void *a, const void *b);
+static int titleQueryTrigramSortFunction(const void *a, const void *b);
 
 bool titleInitialize(void)
 {
@@ -656,6 +886,7 @@ bool titleInitialize(void)
         /* Generate application metadata entries from ns records. */
         /* Theoretically speaking, we should only need to do this once. */
         /* However, if any new gamecard is inserted while the application is running, we *will* have to retrieve the metadata from its application(s). */
+        /* Only cached metadata is loaded at this point. Everything else is retrieved by the gamecard title info thread, which lets the UI show up right away. */
         if (!titleGenerateMetadataEntriesFromNsRecords())
         {
             LOG_MSG_ERROR("Failed to generate application metadata from ns records!");
@@ -678,6 +909,7 @@ bool titleInitialize(void)
 
         /* Create user-mode exit event. */
         ueventCreate(&g_titleGameCardInfoThreadExitEvent, true);
+        cancelTokenReset(&g_titleGameCardInfoThreadCancelToken);
 
         /* Retrieve gamecard status change user event. */
         g_titleGameCardStatusChangeUserEvent = gamecardGetStatusChangeUserEvent();
@@ -699,6 +931,9 @@ bool titleInitialize(void)
 
 void titleExit(void)
 {
+    /* Cancel any in-progress gamecard title scan right away. Otherwise, we'd have to wait for it to complete before being able to lock the title mutex. */
+    cancelTokenCancel(&g_titleGameCardInfoThreadCancelToken);
+
     SCOPED_LOCK(&g_titleMutex)
     {
         /* Destroy gamecard detection thread. */
@@ -708,6 +943,9 @@ void titleExit(void)
             g_titleGameCardInfoThreadCreated = false;
         }
 
+        /* Free deferred application metadata context, in case the gamecard detection thread didn't get to process it. */
+        titleFreeDeferredApplicationMetadata();
+
         /* Close title storages. */
         titleCloseTitleStorages();
 
@@ -724,7 +962,7 @@ void titleExit(void)
             g_nsAppControlData = NULL;
         }
 
-        g_titleInterfaceInit = false;
+        g_titleInterfaceInit = g_titleUserTitleInfoUpdated = false;
     }
 }
 
@@ -773,6 +1011,99 @@ TitleApplicationMetadata **titleGetApplicationMetadataEntries(bool is_system, u3
     return dup_filtered_app_metadata;
 }
 
+TitleApplicationMetadata **titleQueryApplicationMetadataEntries(bool is_system, const TitleQueryFilter *filter, u32 *out_count)
+{
+    TitleApplicationMetadata **out = NULL;
+    char *name = NULL, *author = NULL;
+
+    SCOPED_LOCK(&g_titleMutex)
+    {
+        TitleApplicationMetadata **filtered_app_metadata = (is_system ? g_filteredSystemMetadata : g_filteredUserMetadata);
+        TitleQueryIndex *index = (is_system ? &g_systemQueryIndex : &g_userQueryIndex);
+        const TitleQueryTrigram *seed = NULL;
+        u32 seed_count = 0, out_idx = 0;
+        bool use_seed = false;
+
+        if (!g_titleInterfaceInit || !filtered_app_metadata || !filter || !out_count)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        *out_count = 0;
+
+        /* Build secondary indexes, if needed. */
+        if (!index->built && !titleBuildQueryIndex(is_system)) break;
+
+        /* Generate lowercase copies of the provided strings. */
+        if ((filter->name && *(filter->name) && !(name = titleGenerateLowercaseString(filter->name, SIZE_MAX))) || \
+            (filter->author && *(filter->author) && !(author = titleGenerateLowercaseString(filter->author, SIZE_MAX))))
+        {
+            LOG_MSG_ERROR("Failed to generate lowercase query strings!");
+            break;
+        }
+
+        /* Pick the shortest trigram posting list from all the provided strings. Its entries are the only candidates that may hold all of them. */
+        for(u8 i = 0; i < 2; i++)
+        {
+            const char *str = (i == 0 ? name : author);
+            const TitleQueryTrigram *trigrams = (i == 0 ? index->name_trigrams : index->author_trigrams);
+            u32 trigram_count = (i == 0 ? index->name_trigram_count : index->author_trigram_count);
+            size_t len = (str ? strlen(str) : 0);
+
+            for(size_t j = 0; (j + TITLE_QUERY_TRIGRAM_LENGTH) <= len; j++)
+            {
+                u32 cur_count = 0;
+                const TitleQueryTrigram *cur = titleGetQueryIndexTrigramRange(trigrams, trigram_count, TITLE_QUERY_TRIGRAM(str + j), &cur_count);
+
+                if (!use_seed || cur_count < seed_count)
+                {
+                    seed = cur;
+                    seed_count = cur_count;
+                    use_seed = true;
+                }
+
+                if (!seed_count) break;
+            }
+
+            if (use_seed && !seed_count) break;
+        }
+
+        /* Return right away if no entries can match. */
+        if (use_seed && !seed_count) break;
+
+        /* Allocate memory for the output pointer array. */
+        out = malloc((use_seed ? seed_count : index->entry_count) * sizeof(TitleApplicationMetadata*));
+        if (!out)
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for the query output pointer array!");
+            break;
+        }
+
+        /* Check candidates. Trigram posting lists are sorted by entry index, so the original order is preserved. */
+        for(u32 i = 0; i < (use_seed ? seed_count : index->entry_count); i++)
+        {
+            u32 entry_idx = (use_seed ? seed[i].entry_idx : i);
+            if (titleQueryIndexEntryMatches(&(index->entries[entry_idx]), name, author, filter)) out[out_idx++] = filtered_app_metadata[entry_idx];
+        }
+
+        if (!out_idx)
+        {
+            free(out);
+            out = NULL;
+            break;
+        }
+
+        /* Update output counter. */
+        *out_count = out_idx;
+    }
+
+    if (name) free(name);
+    if (author) free(author);
+
+    return out;
+}
+
 TitleGameCardApplicationMetadata *titleGetGameCardApplicationMetadataEntries(u32 *out_count)
 {
     TitleGameCardApplicationMetadata *dup_gc_app_metadata = NULL;
@@ -812,8 +1143,8 @@ TitleInfo *titleGetTitleInfoEntryFromStorageByTitleId(u8 storage_id, u64 title_i
         TitleInfo *title_info = (g_titleInterfaceInit ? _titleGetTitleInfoEntryFromStorageByTitleId(storage_id, title_id) : NULL);
         if (title_info)
         {
-            ret = titleDuplicateTitleInfoFull(title_info, NULL, NULL);
-            if (!ret) LOG_MSG_ERROR("Failed to duplicate title info for %016lX!", title_id);
+            ret = titleGetTitleInfoSnapshot(title_info, true);
+            if (!ret) LOG_MSG_ERROR("Failed to get title info snapshot for %016lX!", title_id);
         }
     }
 
@@ -822,33 +1153,10 @@ TitleInfo *titleGetTitleInfoEntryFromStorageByTitleId(u8 storage_id, u64 title_i
 
 void titleFreeTitleInfo(TitleInfo **info)
 {
-    TitleInfo *ptr = NULL, *tmp1 = NULL, *tmp2 = NULL;
-    if (!info || !(ptr = *info)) return;
-
-    /* Free content infos. */
-    if (ptr->content_infos) free(ptr->content_infos);
+    if (!info || !*info) return;
 
-    /* Free previous sibling(s). */
-    tmp1 = ptr->previous;
-    while(tmp1)
-    {
-        tmp2 = tmp1->previous;
-        tmp1->previous = tmp1->next = NULL;
-        titleFreeTitleInfo(&tmp1);
-        tmp1 = tmp2;
-    }
-
-    /* Free next sibling(s). */
-    tmp1 = ptr->next;
-    while(tmp1)
-    {
-        tmp2 = tmp1->next;
-        tmp1->previous = tmp1->next = NULL;
-        titleFreeTitleInfo(&tmp1);
-        tmp1 = tmp2;
-    }
-
-    free(ptr);
+    /* Release our reference to the snapshot. The whole linked list is freed along with it once it's no longer referenced. */
+    titleReleaseTitleInfoSnapshot(*info);
     *info = NULL;
 }
 
@@ -873,14 +1181,14 @@ bool titleGetUserApplicationData(u64 app_id, TitleUserApplicationData *out)
 
 #define TITLE_DUPLICATE_USER_APP_DATA(elem, msg) \
     if (user_app_data.elem##_info) { \
-        out->elem##_info = titleDuplicateTitleInfoFull(user_app_data.elem##_info, NULL, NULL); \
+        out->elem##_info = titleGetTitleInfoSnapshot(user_app_data.elem##_info, true); \
         if (!out->elem##_info) { \
-            LOG_MSG_ERROR("Failed to duplicate %s info for %016lX!", msg, app_id); \
+            LOG_MSG_ERROR("Failed to get %s info snapshot for %016lX!", msg, app_id); \
             break; \
         } \
     }
 
-        /* Duplicate user application data. */
+        /* Get user application data snapshots. */
         TITLE_DUPLICATE_USER_APP_DATA(app, "user application");
         TITLE_DUPLICATE_USER_APP_DATA(patch, "patch");
         TITLE_DUPLICATE_USER_APP_DATA(aoc, "add-on content");
@@ -929,49 +1237,45 @@ TitleInfo *titleGetAddOnContentBaseOrPatchList(TitleInfo *title_info)
             break;
         }
 
-        TitleInfo *aoc_info = NULL, *tmp = NULL;
+        TitleInfo *aoc_info = NULL, **nodes = NULL;
         u64 ref_tid = title_info->meta_key.id;
         u64 lookup_tid = (title_info->meta_key.type == NcmContentMetaType_AddOnContent ? titleGetDataPatchIdByAddOnContentId(ref_tid) : titleGetAddOnContentIdByDataPatchId(ref_tid));
-        bool error = false;
+        u32 node_count = 0;
 
         /* Get info for the first add-on content (patch) title matching the lookup title ID. */
         aoc_info = _titleGetTitleInfoEntryFromStorageByTitleId(NcmStorageId_Any, lookup_tid);
         if (!aoc_info) break;
 
-        /* Create our own custom linked list using entries that match our lookup title ID. */
-        while(aoc_info)
+        /* Count entries that match our lookup title ID. */
+        for(TitleInfo *cur = aoc_info; cur; cur = cur->next)
         {
-            /* Check if this entry's title ID matches our lookup title ID. */
-            if (aoc_info->meta_key.id != lookup_tid)
-            {
-                aoc_info = aoc_info->next;
-                continue;
-            }
-
-            /* Duplicate current entry. */
-            tmp = titleDuplicateTitleInfo(aoc_info);
-            if (!tmp)
-            {
-                LOG_MSG_ERROR("Failed to duplicate TitleInfo object!");
-                error = true;
-                break;
-            }
+            if (cur->meta_key.id == lookup_tid) node_count++;
+        }
 
-            /* Update pointer. */
-            if (out)
-            {
-                out->next = tmp;
-            } else {
-                out = tmp;
-            }
+        /* Allocate memory for the node pointer array. */
+        nodes = calloc(node_count, sizeof(TitleInfo*));
+        if (!nodes)
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for TitleInfo node pointer array!");
+            break;
+        }
 
-            tmp = NULL;
+        node_count = 0;
 
-            /* Proceed onto the next entry. */
-            aoc_info = aoc_info->next;
+        for(TitleInfo *cur = aoc_info; cur; cur = cur->next)
+        {
+            if (cur->meta_key.id == lookup_tid) nodes[node_count++] = cur;
         }
 
-        if (error) break;
+        /* Create our own custom linked list using entries that match our lookup title ID. */
+        out = titleCreateTitleInfoSnapshot(nodes, node_count, 0);
+        free(nodes);
+
+        if (!out)
+        {
+            LOG_MSG_ERROR("Failed to create TitleInfo snapshot!");
+            break;
+        }
 
         /* Update flag. */
         success = true;
@@ -982,6 +1286,24 @@ TitleInfo *titleGetAddOnContentBaseOrPatchList(TitleInfo *title_info)
     return out;
 }
 
+TitleInfo *titleGetGameCardUpdateTitleInfoList(void)
+{
+    TitleInfo *out = NULL;
+
+    SCOPED_LOCK(&g_titleMutex)
+    {
+        if (!g_titleInterfaceInit || !g_titleGameCardAvailable)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        out = _titleGetGameCardUpdateTitleInfoList();
+    }
+
+    return out;
+}
+
 bool titleAreOrphanTitlesAvailable(void)
 {
     bool ret = false;
@@ -1010,13 +1332,14 @@ TitleInfo **titleGetOrphanTitles(u32 *out_count)
             break;
         }
 
-        /* Duplicate orphan title info entries. */
+        /* Get orphan title info snapshots. */
         for(u32 i = 0; i < g_orphanTitleInfoCount; i++)
         {
-            orphan_info[i] = titleDuplicateTitleInfoFull(g_orphanTitleInfo[i], NULL, NULL);
+            /* Orphan titles are usually requested all at once, so they don't go through the snapshot cache. */
+            orphan_info[i] = titleGetTitleInfoSnapshot(g_orphanTitleInfo[i], false);
             if (!orphan_info[i])
             {
-                LOG_MSG_ERROR("Failed to duplicate info for orphan title %016lX!", g_orphanTitleInfo[i]->meta_key.id);
+                LOG_MSG_ERROR("Failed to get info snapshot for orphan title %016lX!", g_orphanTitleInfo[i]->meta_key.id);
                 titleFreeOrphanTitles(&orphan_info);
                 break;
             }
@@ -1031,20 +1354,30 @@ TitleInfo **titleGetOrphanTitles(u32 *out_count)
 
 void titleFreeOrphanTitles(TitleInfo ***orphan_info)
 {
-    TitleInfo **ptr = NULL, *tmp = NULL;
+    TitleInfo **ptr = NULL;
     if (!orphan_info || !(ptr = *orphan_info)) return;
 
-    tmp = *ptr;
-    while(tmp)
-    {
-        titleFreeTitleInfo(&tmp);
-        tmp++;
-    }
+    /* The pointer array is NULL-terminated. */
+    for(TitleInfo **cur = ptr; *cur; cur++) titleFreeTitleInfo(cur);
 
     free(ptr);
     *orphan_info = NULL;
 }
 
+bool titleIsUserTitleInfoUpdated(void)
+{
+    bool ret = false;
+
+    SCOPED_TRY_LOCK(&g_titleMutex)
+    {
+        /* Check if the gamecard thread finished loading deferred user application metadata. */
+        ret = (g_titleInterfaceInit && g_titleUserTitleInfoUpdated);
+        if (ret) g_titleUserTitleInfoUpdated = false;
+    }
+
+    return ret;
+}
+
 bool titleIsGameCardInfoUpdated(void)
 {
     bool ret = false;
@@ -1137,10 +1470,9 @@ char *titleGenerateGameCardFileName(u8 naming_convention, u8 illegal_char_replac
     return filename;
 }
 
-char *titleGenerateTitleRecordsCsv(size_t *out_csv_size, u32 *out_proc_title_cnt, bool is_system, bool use_gamecard)
+bool titleExportTitleRecords(u8 format, bool is_system, bool use_gamecard, TitleRecordsWriteCallback write_cb, void *user_data, u32 *out_proc_title_cnt)
 {
-    char *csv_buf = NULL;
-    size_t csv_buf_size = 0;
+    bool success = false;
 
     SCOPED_LOCK(&g_titleMutex)
     {
@@ -1152,23 +1484,19 @@ char *titleGenerateTitleRecordsCsv(size_t *out_csv_size, u32 *out_proc_title_cnt
         TitleInfo *title_info = NULL;
         char *escaped_title_name = NULL;
 
-        u32 proc_title_cnt = 0;
+        TitleRecordsExportContext ctx = { .format = format, .write_cb = write_cb, .user_data = user_data };
 
         const u8 start_val = (!is_system ? NcmContentMetaType_Application : NcmContentMetaType_Unknown);
         const u8 end_val = (!is_system ? NcmContentMetaType_DataPatch : NcmContentMetaType_Unknown);
 
-        bool success = false;
-
-        if (!g_titleInterfaceInit || !filtered_app_metadata || !filtered_app_metadata_count || !out_csv_size || (is_system && use_gamecard))
+        if (!g_titleInterfaceInit || !filtered_app_metadata || !filtered_app_metadata_count || format >= TitleRecordsFormat_Count || !write_cb || (is_system && use_gamecard))
         {
             LOG_MSG_ERROR("Invalid parameters!");
             break;
         }
 
-#define TITLE_CSV_ADD_FMT_STR(fmt, ...) utilsAppendFormattedStringToBuffer(&csv_buf, &csv_buf_size, fmt, ##__VA_ARGS__)
-
-        /* Append CSV header. */
-        if (!TITLE_CSV_ADD_FMT_STR("Name,Type,Title ID,Version,Source Storage,Content Count,Size\r\n")) goto end;
+        /* Append header. */
+        if (!titleAppendTitleRecordsExportString(&ctx, format == TitleRecordsFormat_Csv ? "Name,Type,Title ID,Version,Source Storage,Content Count,Size\r\n" : "[")) goto end;
 
         /* Loop through our filtered application metadata entries. */
         for(u32 i = 0; i < filtered_app_metadata_count; i++)
@@ -1189,10 +1517,11 @@ char *titleGenerateTitleRecordsCsv(size_t *out_csv_size, u32 *out_proc_title_cnt
                 continue;
             }
 
-            /* Escape title name, if needed. */
-            if (strchr(cur_app_metadata->lang_entry.name, ',') != NULL || strchr(cur_app_metadata->lang_entry.name, '"') != NULL)
+            /* Escape title name, if needed. JSON names are always escaped, while CSV names are only escaped if they hold commas or double quotes. */
+            if (format == TitleRecordsFormat_Json || strchr(cur_app_metadata->lang_entry.name, ',') != NULL || strchr(cur_app_metadata->lang_entry.name, '"') != NULL)
             {
-                escaped_title_name = utilsEscapeCharacters(cur_app_metadata->lang_entry.name, "\"", '"');
+                escaped_title_name = (format == TitleRecordsFormat_Json ? jsonGenerateEscapedString(cur_app_metadata->lang_entry.name) : \
+                                                                          utilsEscapeCharacters(cur_app_metadata->lang_entry.name, "\"", '"'));
                 if (!escaped_title_name)
                 {
                     LOG_MSG_ERROR("Failed to generate escaped title name for %016lX!", cur_app_metadata->title_id);
@@ -1225,25 +1554,13 @@ char *titleGenerateTitleRecordsCsv(size_t *out_csv_size, u32 *out_proc_title_cnt
                         continue;
                     }
 
-                    /* Append title name. */
-                    if (!TITLE_CSV_ADD_FMT_STR(escaped_title_name ? "\"%s\"," : "%s,", escaped_title_name ? escaped_title_name : cur_app_metadata->lang_entry.name))
-                    {
-                        LOG_MSG_ERROR("Failed to append title name for %016lX!", cur_app_metadata->title_id);
-                        goto end;
-                    }
-
-                    /* Append title record to output CSV buffer. */
-                    if (!TITLE_CSV_ADD_FMT_STR("%s,%016lX,%u,%s,%u,%s (%lu bytes)\r\n", titleGetNcmContentMetaTypeName(title_info->meta_key.type), title_info->meta_key.id, \
-                                                                                        title_info->version.value, titleGetNcmStorageIdName(title_info->storage_id), \
-                                                                                        title_info->content_count, title_info->size_str, title_info->size))
+                    /* Append title record. */
+                    if (!titleAppendTitleRecord(&ctx, escaped_title_name ? escaped_title_name : cur_app_metadata->lang_entry.name, escaped_title_name != NULL, title_info))
                     {
                         LOG_MSG_ERROR("Failed to append title record for %016lX!", cur_app_metadata->title_id);
                         goto end;
                     }
 
-                    /* Increase processed titles counter. */
-                    proc_title_cnt++;
-
                     /* Get next pointer in the current linked list. */
                     /* This is guaranteed to be NULL for system titles. */
                     title_info = title_info->next;
@@ -1264,28 +1581,24 @@ char *titleGenerateTitleRecordsCsv(size_t *out_csv_size, u32 *out_proc_title_cnt
                 title_info = g_orphanTitleInfo[i];
                 if (!title_info) continue;
 
-                /* Append title record to output CSV buffer. */
-                if (!TITLE_CSV_ADD_FMT_STR("[UNKNOWN],%s,%016lX,%u,%s,%u,%s (%lu bytes)\r\n", titleGetNcmContentMetaTypeName(title_info->meta_key.type), title_info->meta_key.id, \
-                                                                                            title_info->version.value, titleGetNcmStorageIdName(title_info->storage_id), \
-                                                                                            title_info->content_count, title_info->size_str, title_info->size))
+                /* Append title record. */
+                if (!titleAppendTitleRecord(&ctx, NULL, false, title_info))
                 {
-                    LOG_MSG_ERROR("Failed to append orphan title record for %016lX!", cur_app_metadata->title_id);
+                    LOG_MSG_ERROR("Failed to append orphan title record for %016lX!", title_info->meta_key.id);
                     goto end;
                 }
-
-                /* Increase processed titles counter. */
-                proc_title_cnt++;
             }
         }
 
-#undef TITLE_CSV_ADD_FMT_STR
+        /* Append footer, then flush whatever is left. */
+        if ((format == TitleRecordsFormat_Json && !titleAppendTitleRecordsExportString(&ctx, ctx.record_count ? "\r\n]\r\n" : "]\r\n")) || \
+            !titleFlushTitleRecordsExportBuffer(&ctx)) goto end;
 
         /* Check if we actually processed any titles. */
-        if (proc_title_cnt)
+        if (ctx.record_count)
         {
             /* Update output. */
-            *out_csv_size = strlen(csv_buf);
-            if (out_proc_title_cnt) *out_proc_title_cnt = proc_title_cnt;
+            if (out_proc_title_cnt) *out_proc_title_cnt = ctx.record_count;
 
             /* Update flag. */
             success = true;
@@ -1296,14 +1609,32 @@ char *titleGenerateTitleRecordsCsv(size_t *out_csv_size, u32 *out_proc_title_cnt
 end:
         if (escaped_title_name) free(escaped_title_name);
 
-        if (!success && csv_buf)
-        {
-            free(csv_buf);
-            csv_buf = NULL;
-        }
+        if (ctx.buf) free(ctx.buf);
+    }
+
+    return success;
+}
+
+char *titleGenerateTitleRecordsCsv(size_t *out_csv_size, u32 *out_proc_title_cnt, bool is_system, bool use_gamecard)
+{
+    TitleRecordsBuffer csv = {0};
+
+    if (!out_csv_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    /* Collect the whole CSV in a single buffer. */
+    if (!titleExportTitleRecords(TitleRecordsFormat_Csv, is_system, use_gamecard, &titleAppendTitleRecordsToBuffer, &csv, out_proc_title_cnt))
+    {
+        if (csv.data) free(csv.data);
+        return NULL;
     }
 
-    return csv_buf;
+    *out_csv_size = csv.size;
+
+    return csv.data;
 }
 
 const char *titleGetNcmStorageIdName(u8 storage_id)
@@ -1349,6 +1680,9 @@ NX_INLINE void titleFreeApplicationMetadata(void)
     g_systemMetadata = g_userMetadata = NULL;
     g_systemMetadataCount = g_userMetadataCount = 0;
 
+    titleFreeTitleIdIndex(&g_systemMetadataIndex);
+    titleFreeTitleIdIndex(&g_userMetadataIndex);
+
     /* Free filtered application metadata. */
     if (g_filteredSystemMetadata) free(g_filteredSystemMetadata);
 
@@ -1357,6 +1691,9 @@ NX_INLINE void titleFreeApplicationMetadata(void)
     g_filteredSystemMetadata = g_filteredUserMetadata = NULL;
     g_filteredSystemMetadataCount = g_filteredUserMetadataCount = 0;
 
+    titleFreeQueryIndex(true);
+    titleFreeQueryIndex(false);
+
     /* Free gamecard application metadata. */
     if (g_titleGameCardApplicationMetadata) free(g_titleGameCardApplicationMetadata);
 
@@ -1431,43 +1768,43 @@ end:
     return success;
 }
 
-NX_INLINE bool titleInitializePersistentTitleStorages(void)
+static void titleSortApplicationMetadata(bool is_system)
 {
-    for(u8 i = NcmStorageId_BuiltInSystem; i <= NcmStorageId_SdCard; i++)
-    {
-        if (!titleInitializeTitleStorage(i))
-        {
-            LOG_MSG_ERROR("Failed to initialize title storage with ID %u!", i);
-            return false;
-        }
-    }
-
-#if LOG_LEVEL <= LOG_LEVEL_INFO
-#define ORPHAN_INFO_LOG(fmt, ...) utilsAppendFormattedStringToBuffer(&orphan_info_buf, &orphan_info_buf_size, fmt, ##__VA_ARGS__)
+    TitleApplicationMetadata **cached_app_metadata = (is_system ? g_systemMetadata : g_userMetadata);
+    u32 cached_app_metadata_count = (is_system ? g_systemMetadataCount : g_userMetadataCount);
+    TitleIdIndex *index = (is_system ? &g_systemMetadataIndex : &g_userMetadataIndex);
 
-    if (g_orphanTitleInfo && g_orphanTitleInfoCount)
-    {
-        char *orphan_info_buf = NULL;
-        size_t orphan_info_buf_size = 0;
+    /* Sort application metadata entries. System entries are sorted by title ID, while user entries are sorted by name. */
+    if (cached_app_metadata_count > 1) titleSortPointerArray((void**)cached_app_metadata, cached_app_metadata_count, \
+                                                             is_system ? TitleSortKeyType_SystemMetadata : TitleSortKeyType_UserMetadata);
 
-        ORPHAN_INFO_LOG("Identified %u orphan title(s) across all initialized title storages.\r\n", g_orphanTitleInfoCount);
+    /* Rebuild title ID index. Lookups fall back to a linear search if this fails. */
+    titleFreeTitleIdIndex(index);
 
-        for(u32 i = 0; i < g_orphanTitleInfoCount; i++)
+    for(u32 i = 0; i < cached_app_metadata_count; i++)
+    {
+        TitleApplicationMetadata *cur_app_metadata = cached_app_metadata[i];
+        if (cur_app_metadata && !titleInsertTitleIdIndexEntry(index, cur_app_metadata->title_id, cur_app_metadata, false))
         {
-            TitleInfo *orphan_info = g_orphanTitleInfo[i];
-            ORPHAN_INFO_LOG("- %016lX v%u (%s, %s).%s", orphan_info->meta_key.id, orphan_info->version.value, titleGetNcmContentMetaTypeName(orphan_info->meta_key.type), \
-                                                      titleGetNcmStorageIdName(orphan_info->storage_id), (i + 1) < g_orphanTitleInfoCount ? "\r\n" : "");
+            titleFreeTitleIdIndex(index);
+            break;
         }
+    }
+}
 
-        if (orphan_info_buf)
+NX_INLINE bool titleInitializePersistentTitleStorages(void)
+{
+    for(u8 i = NcmStorageId_BuiltInSystem; i <= NcmStorageId_SdCard; i++)
+    {
+        if (!titleInitializeTitleStorage(i))
         {
-            LOG_MSG_INFO("%s", orphan_info_buf);
-            free(orphan_info_buf);
+            LOG_MSG_ERROR("Failed to initialize title storage with ID %u!", i);
+            return false;
         }
     }
 
-#undef ORPHAN_INFO_LOG
-#endif  /* LOG_LEVEL <= LOG_LEVEL_INFO */
+    /* Log orphan titles. If we have deferred NS records, this will be taken care of by the gamecard title info thread once their metadata is retrieved. */
+    if (!g_titleDeferredMetadata.pending_count) titleLogOrphanTitleInfoEntries();
 
     return true;
 }
@@ -1587,6 +1924,12 @@ static void titleCloseTitleStorage(u8 storage_id)
     NcmContentMetaDatabase *ncm_db = &(title_storage->ncm_db);
     NcmContentStorage *ncm_storage = &(title_storage->ncm_storage);
 
+    /* Remove gamecard titles from all linked lists before freeing them. */
+    if (storage_id == NcmStorageId_GameCard) titleUnlinkGameCardTitleInfoEntries();
+
+    /* Stop handing out snapshots that may reference titles from this storage. */
+    titleUpdateTitleInfoGeneration();
+
     /* Free title infos from this title storage. */
     if (title_storage->titles)
     {
@@ -1607,6 +1950,9 @@ static void titleCloseTitleStorage(u8 storage_id)
     /* Reset title count. */
     title_storage->title_count = 0;
 
+    /* Free title ID index. */
+    titleFreeTitleIdIndex(&(title_storage->title_index));
+
     /* Check if the ncm storage handle for this title storage has already been retrieved. If so, close it. */
     if (serviceIsActive(&(ncm_storage->s))) ncmContentStorageClose(ncm_storage);
 
@@ -1685,6 +2031,30 @@ end:
     return success;
 }
 
+static void titleSortTitleInfoFromStorage(TitleStorage *title_storage)
+{
+    TitleIdIndex *index = &(title_storage->title_index);
+
+    /* Stop handing out snapshots built from the previous title list. */
+    titleUpdateTitleInfoGeneration();
+
+    if (title_storage->title_count > 1) titleSortPointerArray((void**)title_storage->titles, title_storage->title_count, TitleSortKeyType_TitleInfo);
+
+    /* Rebuild title ID index. Only the first entry with each title ID is indexed, which matches the behaviour of a linear search over the sorted array. */
+    /* Lookups fall back to a linear search if this fails. */
+    titleFreeTitleIdIndex(index);
+
+    for(u32 i = 0; i < title_storage->title_count; i++)
+    {
+        TitleInfo *title_info = title_storage->titles[i];
+        if (title_info && !titleInsertTitleIdIndexEntry(index, title_info->meta_key.id, title_info, false))
+        {
+            titleFreeTitleIdIndex(index);
+            break;
+        }
+    }
+}
+
 NX_INLINE void titleFreeOrphanTitleInfoEntries(void)
 {
     if (g_orphanTitleInfo)
@@ -1715,21 +2085,51 @@ static void titleAddOrphanTitleInfoEntry(TitleInfo *orphan_title)
     g_orphanTitleInfo[g_orphanTitleInfoCount++] = orphan_title;
 
     /* Sort orphan title info entries by title ID, version and storage ID. */
-    if (g_orphanTitleInfoCount > 1) qsort(g_orphanTitleInfo, g_orphanTitleInfoCount, sizeof(TitleInfo*), &titleInfoSortFunction);
+    if (g_orphanTitleInfoCount > 1) titleSortPointerArray((void**)g_orphanTitleInfo, g_orphanTitleInfoCount, TitleSortKeyType_TitleInfo);
 }
 
-static bool titleGenerateMetadataEntriesFromSystemTitles(void)
+static void titleLogOrphanTitleInfoEntries(void)
 {
-    u32 extra_app_count = 0;
-    bool success = false;
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define ORPHAN_INFO_LOG(fmt, ...) utilsAppendFormattedStringToBuffer(&orphan_info_buf, &orphan_info_buf_size, fmt, ##__VA_ARGS__)
 
-    /* Reallocate application metadata pointer array. */
-    if (!titleReallocateApplicationMetadata(g_systemTitlesCount, true, false))
+    if (g_orphanTitleInfo && g_orphanTitleInfoCount)
     {
-        LOG_MSG_ERROR("Failed to reallocate application metadata pointer array for system titles!");
-        return false;
-    }
-
+        char *orphan_info_buf = NULL;
+        size_t orphan_info_buf_size = 0;
+
+        ORPHAN_INFO_LOG("Identified %u orphan title(s) across all initialized title storages.\r\n", g_orphanTitleInfoCount);
+
+        for(u32 i = 0; i < g_orphanTitleInfoCount; i++)
+        {
+            TitleInfo *orphan_info = g_orphanTitleInfo[i];
+            ORPHAN_INFO_LOG("- %016lX v%u (%s, %s).%s", orphan_info->meta_key.id, orphan_info->version.value, titleGetNcmContentMetaTypeName(orphan_info->meta_key.type), \
+                                                      titleGetNcmStorageIdName(orphan_info->storage_id), (i + 1) < g_orphanTitleInfoCount ? "\r\n" : "");
+        }
+
+        if (orphan_info_buf)
+        {
+            LOG_MSG_INFO("%s", orphan_info_buf);
+            free(orphan_info_buf);
+        }
+    }
+
+#undef ORPHAN_INFO_LOG
+#endif  /* LOG_LEVEL <= LOG_LEVEL_INFO */
+}
+
+static bool titleGenerateMetadataEntriesFromSystemTitles(void)
+{
+    u32 extra_app_count = 0;
+    bool success = false;
+
+    /* Reallocate application metadata pointer array. */
+    if (!titleReallocateApplicationMetadata(g_systemTitlesCount, true, false))
+    {
+        LOG_MSG_ERROR("Failed to reallocate application metadata pointer array for system titles!");
+        return false;
+    }
+
     /* Fill new application metadata entries. */
     for(extra_app_count = 0; extra_app_count < g_systemTitlesCount; extra_app_count++)
     {
@@ -1754,7 +2154,7 @@ static bool titleGenerateMetadataEntriesFromSystemTitles(void)
     g_systemMetadataCount += g_systemTitlesCount;
 
     /* Sort application metadata entries by title ID. */
-    if (g_systemMetadataCount > 1) qsort(g_systemMetadata, g_systemMetadataCount, sizeof(TitleApplicationMetadata*), &titleSystemMetadataSortFunction);
+    titleSortApplicationMetadata(true);
 
     /* Update flag. */
     success = true;
@@ -1774,6 +2174,12 @@ static bool titleGenerateMetadataEntriesFromNsRecords(void)
     u32 app_records_block_count = 0, app_records_count = 0, extra_app_count = 0;
     size_t app_records_size = 0, app_records_block_size = (NS_APPLICATION_RECORD_BLOCK_SIZE * sizeof(NsApplicationRecord));
 
+    TitleMetadataCache cache = {0};
+    TitleApplicationMetadata **record_metadata = NULL;
+    u64 language_code = 0;
+    u32 pending_count = 0;
+    bool use_cache = false;
+
     bool success = false, free_entries = false;
 
     /* Retrieve NS application records in a loop until we get them all. */
@@ -1822,27 +2228,46 @@ static bool titleGenerateMetadataEntriesFromNsRecords(void)
 
     free_entries = true;
 
-    /* Retrieve application metadata for each NS application record. */
+    /* Allocate memory for the record metadata pointer array. This is used to keep track of pending records. */
+    record_metadata = calloc(app_records_count, sizeof(TitleApplicationMetadata*));
+    if (!record_metadata)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the NS record metadata pointer array!");
+        goto end;
+    }
+
+    /* Load user application metadata cache. It can only be used with the language code it was generated with. */
+    rc = setGetSystemLanguage(&language_code);
+    if (R_SUCCEEDED(rc))
+    {
+        use_cache = true;
+        titleLoadMetadataCache(&cache, language_code);
+    } else {
+        LOG_MSG_ERROR("setGetSystemLanguage failed! (0x%X). User application metadata cache won't be used.", rc);
+    }
+
+    /* Retrieve cached application metadata for each NS application record. */
+    /* Records we have no cached metadata for are left for the gamecard title info thread, since retrieving control data from ns takes a while. */
     for(u32 i = 0; i < app_records_count; i++)
     {
-        /* Retrieve application metadata. */
-        TitleApplicationMetadata *cur_app_metadata = titleGenerateUserMetadataEntryFromNs(app_records[i].application_id);
-        if (!cur_app_metadata) continue;
+        TitleApplicationMetadata *cur_app_metadata = NULL;
+        const TitleMetadataCacheEntry *cache_entry = (use_cache ? titleFindMetadataCacheEntry(&cache, &(app_records[i])) : NULL);
+
+        if (cache_entry) cur_app_metadata = titleGenerateUserMetadataEntryFromCache(cache_entry);
+
+        if (!cur_app_metadata)
+        {
+            pending_count++;
+            continue;
+        }
 
         /* Set application metadata entry pointer. */
-        g_userMetadata[g_userMetadataCount + extra_app_count] = cur_app_metadata;
+        g_userMetadata[g_userMetadataCount + extra_app_count] = record_metadata[i] = cur_app_metadata;
 
         /* Increase extra application metadata counter. */
         extra_app_count++;
     }
 
-    /* Check retrieved application metadata count. */
-    if (!extra_app_count)
-    {
-        LOG_MSG_ERROR("Unable to retrieve application metadata from NS application records! (%u element[s]).", app_records_count);
-        goto end;
-    }
-
     /* Update application metadata count. */
     g_userMetadataCount += extra_app_count;
 
@@ -1850,12 +2275,37 @@ static bool titleGenerateMetadataEntriesFromNsRecords(void)
     if (extra_app_count < app_records_count) titleReallocateApplicationMetadata(0, false, false);
 
     /* Sort application metadata entries by name. */
-    if (g_userMetadataCount > 1) qsort(g_userMetadata, g_userMetadataCount, sizeof(TitleApplicationMetadata*), &titleUserMetadataSortFunction);
+    if (extra_app_count) titleSortApplicationMetadata(false);
+
+    if (pending_count)
+    {
+        /* Hand pending records over to the gamecard title info thread. It'll also take care of updating the user application metadata cache. */
+        g_titleDeferredMetadata.records = app_records;
+        g_titleDeferredMetadata.record_metadata = record_metadata;
+        g_titleDeferredMetadata.record_count = app_records_count;
+        g_titleDeferredMetadata.pending_count = pending_count;
+        g_titleDeferredMetadata.language_code = language_code;
+        g_titleDeferredMetadata.use_cache = use_cache;
+
+        app_records = NULL;
+        record_metadata = NULL;
+
+        LOG_MSG_INFO("Deferred application metadata retrieval for %u NS application record(s).", pending_count);
+    } else
+    if (use_cache && cache.entry_count != extra_app_count)
+    {
+        /* Update user application metadata cache if entries were removed. */
+        titleSaveMetadataCache(app_records, record_metadata, app_records_count, language_code);
+    }
 
     /* Update flag. */
     success = true;
 
 end:
+    titleFreeMetadataCache(&cache);
+
+    if (record_metadata) free(record_metadata);
+
     if (app_records) free(app_records);
 
     /* Free previously allocated application metadata pointers. Ignore return value. */
@@ -1864,232 +2314,597 @@ end:
     return success;
 }
 
-static TitleApplicationMetadata *titleGetSystemMetadataEntry(u64 title_id)
+static bool titleLoadDeferredApplicationMetadata(Waiter exit_event_waiter)
 {
-    if (!title_id)
-    {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return NULL;
-    }
+    TitleDeferredMetadataContext *ctx = &g_titleDeferredMetadata;
+    TitleApplicationMetadata **app_metadata = NULL;
+    u32 app_count = 0;
+    bool exit_requested = false, stored = false;
 
-    TitleApplicationMetadata *app_metadata = NULL;
-    bool success = false;
+    /* Return right away if there's nothing to do. */
+    if (!ctx->records || !ctx->record_metadata || !ctx->pending_count) goto end;
 
-    /* Make sure we have no application metadata entry for the requested title ID. */
-    /* If we do, we'll just return a pointer to the existing entry. */
-    app_metadata = titleFindApplicationMetadataByTitleId(title_id, true, 0);
-    if (app_metadata)
+    /* Allocate memory for the retrieved application metadata pointer array. */
+    app_metadata = calloc(ctx->record_count, sizeof(TitleApplicationMetadata*));
+    if (!app_metadata)
     {
-        success = true;
+        LOG_MSG_ERROR("Failed to allocate memory for the deferred application metadata pointer array!");
         goto end;
     }
 
-    /* Allocate memory for the current entry. */
-    app_metadata = calloc(1, sizeof(TitleApplicationMetadata));
-    if (!app_metadata)
+    /* Retrieve application metadata for pending records from ns, without holding the title interface mutex. */
+    /* We can safely use the global ns application control data buffer here, since it's only ever used by this thread once titleInitialize() returns. */
+    for(u32 i = 0; i < ctx->record_count; i++)
     {
-        LOG_MSG_ERROR("Failed to allocate memory for application metadata entry for %016lX!", title_id);
-        goto end;
-    }
+        if (ctx->record_metadata[i]) continue;
 
-    /* Fill information for our dummy entry. */
-    app_metadata->title_id = title_id;
-    sprintf(app_metadata->lang_entry.name, "Unknown");
+        /* Bail out if the exit event was triggered. */
+        if (R_SUCCEEDED(waitSingle(exit_event_waiter, 0)))
+        {
+            exit_requested = true;
+            goto end;
+        }
 
-    /* Reallocate application metadata pointer array. */
-    if (!titleReallocateApplicationMetadata(1, true, false))
-    {
-        LOG_MSG_ERROR("Failed to reallocate application metadata pointer array for %016lX!", title_id);
-        goto end;
+        app_metadata[i] = titleGenerateUserMetadataEntryFromNs(ctx->records[i].application_id);
+        if (app_metadata[i]) app_count++;
     }
 
-    /* Set application metadata entry pointer. */
-    g_systemMetadata[g_systemMetadataCount++] = app_metadata;
-
-    /* Sort application metadata entries by title ID. */
-    if (g_systemMetadataCount > 1) qsort(g_systemMetadata, g_systemMetadataCount, sizeof(TitleApplicationMetadata*), &titleSystemMetadataSortFunction);
+    LOG_MSG_INFO("Retrieved deferred application metadata for %u out of %u NS application record(s).", app_count, ctx->pending_count);
 
-    /* Update flag. */
-    success = true;
+    if (!app_count) goto end;
 
-end:
-    if (!success && app_metadata)
+    SCOPED_LOCK(&g_titleMutex)
     {
-        free(app_metadata);
-        app_metadata = NULL;
-    }
+        /* Reallocate application metadata pointer array. */
+        if (!titleReallocateApplicationMetadata(app_count, false, false))
+        {
+            LOG_MSG_ERROR("Failed to reallocate application metadata pointer array for deferred NS records!");
+            break;
+        }
 
-    return app_metadata;
-}
+        /* Set application metadata entry pointers. */
+        for(u32 i = 0; i < ctx->record_count; i++)
+        {
+            if (!app_metadata[i]) continue;
 
-static TitleApplicationMetadata *titleGenerateUserMetadataEntryFromNs(u64 title_id)
-{
-    if (!g_nsAppControlData || !title_id)
-    {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return NULL;
-    }
+            g_userMetadata[g_userMetadataCount++] = ctx->record_metadata[i] = app_metadata[i];
+            app_metadata[i] = NULL;
+        }
 
-    u64 control_data_size = 0;
-    TitleApplicationMetadata *app_metadata = NULL;
+        stored = true;
 
-    /* Retrieve application control data from ns. */
-    if (!titleGetApplicationControlDataFromNs(title_id, g_nsAppControlData, &control_data_size))
-    {
-        LOG_MSG_ERROR("Failed to retrieve application control data for %016lX!", title_id);
-        goto end;
-    }
+        /* Sort application metadata entries by name. */
+        titleSortApplicationMetadata(false);
 
-    /* Initialize application metadata entry using the control data we just retrieved. */
-    app_metadata = titleInitializeUserMetadataEntryFromControlData(title_id, g_nsAppControlData, control_data_size);
-    if (!app_metadata) LOG_MSG_ERROR("Failed to generate application metadata entry for %016lX!", title_id);
+        /* Update application metadata pointers for titles we had no metadata for. */
+        for(u8 i = NcmStorageId_GameCard; i <= NcmStorageId_SdCard; i++)
+        {
+            if (i == NcmStorageId_BuiltInSystem) continue;
 
-end:
-    return app_metadata;
-}
+            TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(i)]);
 
-static TitleApplicationMetadata *titleGenerateUserMetadataEntryFromControlNca(TitleInfo *title_info)
-{
-    if (!g_nsAppControlData || !title_info || !title_info->meta_key.id || title_info->app_metadata || \
-        (title_info->meta_key.type != NcmContentMetaType_Application && title_info->meta_key.type != NcmContentMetaType_Patch))
-    {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return NULL;
-    }
+            for(u32 j = 0; j < title_storage->title_count; j++)
+            {
+                TitleInfo *title_info = title_storage->titles[j];
+                if (title_info && !title_info->app_metadata) title_info->app_metadata = titleFindApplicationMetadataByTitleId(titleGetApplicationIdByContentMetaKey(&(title_info->meta_key)), false, 0);
+            }
+        }
 
-    u64 control_data_size = 0, app_id = titleGetApplicationIdByContentMetaKey(&(title_info->meta_key));
-    TitleApplicationMetadata *app_metadata = NULL;
+        /* Update linked lists for user applications, patches and add-on contents. */
+        /* This will take care of orphan titles we now have application metadata for. */
+        titleUpdateTitleInfoLinkedLists();
+        titleLogOrphanTitleInfoEntries();
 
-    /* Retrieve application control data from Control NCA. */
-    if (!titleGetApplicationControlDataFromControlNca(title_info, g_nsAppControlData, &control_data_size))
-    {
-        LOG_MSG_ERROR("Failed to retrieve application control data for %016lX!", title_info->meta_key.id);
-        goto end;
+        /* Generate filtered user application metadata pointer array. */
+        titleGenerateFilteredApplicationMetadataPointerArray(false);
+
+        /* Update flag. */
+        g_titleUserTitleInfoUpdated = true;
     }
 
-    /* Initialize application metadata entry using the control data we just retrieved. */
-    app_metadata = titleInitializeUserMetadataEntryFromControlData(app_id, g_nsAppControlData, control_data_size);
-    if (!app_metadata) LOG_MSG_ERROR("Failed to generate application metadata entry for %016lX!", title_info->meta_key.id);
+    /* Update user application metadata cache. */
+    if (stored && ctx->use_cache) titleSaveMetadataCache(ctx->records, ctx->record_metadata, ctx->record_count, ctx->language_code);
 
 end:
-    return app_metadata;
-}
-
-static bool titleGetApplicationControlDataFromNs(u64 title_id, NsApplicationControlData *out_control_data, u64 *out_control_data_size)
-{
-    if (!title_id || !out_control_data || !out_control_data_size)
+    if (app_metadata)
     {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return false;
-    }
+        /* Free application metadata entries we couldn't store. */
+        for(u32 i = 0; i < ctx->record_count; i++)
+        {
+            if (!app_metadata[i]) continue;
 
-    Result rc = 0;
-    u64 control_data_size = 0;
+            if (app_metadata[i]->icon) free(app_metadata[i]->icon);
+            free(app_metadata[i]);
+        }
 
-    /* Retrieve application control data from ns. */
-    rc = nsGetApplicationControlData(NsApplicationControlSource_Storage, title_id, out_control_data, sizeof(NsApplicationControlData), &control_data_size);
-    if (R_FAILED(rc))
-    {
-        LOG_MSG_ERROR("nsGetApplicationControlData failed for title ID \"%016lX\"! (0x%X).", title_id, rc);
-        return false;
+        free(app_metadata);
     }
 
-    /* Sanity check. */
-    if (control_data_size < sizeof(NacpStruct))
-    {
-        LOG_MSG_ERROR("Retrieved application control data buffer for title ID \"%016lX\" is too small! (0x%lX).", title_id, control_data_size);
-        return false;
-    }
+    titleFreeDeferredApplicationMetadata();
 
-    /* Update output size. */
-    *out_control_data_size = control_data_size;
+    return !exit_requested;
+}
 
-    return true;
+static void titleFreeDeferredApplicationMetadata(void)
+{
+    if (g_titleDeferredMetadata.records) free(g_titleDeferredMetadata.records);
+    if (g_titleDeferredMetadata.record_metadata) free(g_titleDeferredMetadata.record_metadata);
+    memset(&g_titleDeferredMetadata, 0, sizeof(TitleDeferredMetadataContext));
 }
 
-static bool titleGetApplicationControlDataFromControlNca(TitleInfo *title_info, NsApplicationControlData *out_control_data, u64 *out_control_data_size)
+static bool titleLoadMetadataCache(TitleMetadataCache *out, u64 language_code)
 {
-    NcmContentInfo *nacp_content = NULL;
+    FILE *fp = NULL;
+    TitleMetadataCacheHeader *header = NULL;
+    u64 size = 0, offset = 0, prev_app_id = 0;
+    bool success = false;
 
-    if (!title_info || !title_info->meta_key.id || (title_info->meta_key.type != NcmContentMetaType_Application && title_info->meta_key.type != NcmContentMetaType_Patch) || \
-        !(nacp_content = titleGetContentInfoByTypeAndIdOffset(title_info, NcmContentType_Control, 0)) || !out_control_data || !out_control_data_size)
+    /* Open cache file. */
+    if (!(fp = fopen(TITLE_METADATA_CACHE_PATH, "rb")))
     {
-        LOG_MSG_ERROR("Invalid parameters!");
+        LOG_MSG_DEBUG("User application metadata cache unavailable at \"" TITLE_METADATA_CACHE_PATH "\".");
         return false;
     }
 
-    u8 storage_id = title_info->storage_id;
-    u8 hfs_partition_type = (storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : HashFileSystemPartitionType_None);
-
-    NcaContext *nca_ctx = NULL;
-    NacpContext nacp_ctx = {0};
-
-    Result rc = 0;
-    NacpLanguageEntry *lang_entry = NULL;
-    u8 lang_id = NacpLanguage_AmericanEnglish;  /* Fallback value. */
-
-    NacpIconContext *icon_ctx = NULL;
+    /* Get cache file size. */
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
 
-    bool success = false;
-
-    LOG_MSG_DEBUG("Retrieving application control data for %s %016lX in %s...", titleGetNcmContentMetaTypeName(title_info->meta_key.type), title_info->meta_key.id, \
-                                                                                titleGetNcmStorageIdName(title_info->storage_id));
+    if (size < sizeof(TitleMetadataCacheHeader))
+    {
+        LOG_MSG_ERROR("Invalid user application metadata cache size! Discarding it.");
+        goto end;
+    }
 
-    /* Allocate memory for the NCA context. */
-    nca_ctx = calloc(1, sizeof(NcaContext));
-    if (!nca_ctx)
+    /* Read the whole cache file at once. */
+    if (!(out->data = malloc(size)) || fread(out->data, 1, size, fp) != size)
     {
-        LOG_MSG_ERROR("Failed to allocate memory for NCA context!");
+        LOG_MSG_ERROR("Failed to read user application metadata cache! (0x%lX).", size);
         goto end;
     }
 
-    /* Initialize NCA context. */
-    if (!ncaInitializeContext(nca_ctx, storage_id, hfs_partition_type, &(title_info->meta_key), nacp_content, NULL))
+    /* Validate cache header. */
+    header = (TitleMetadataCacheHeader*)out->data;
+    if (header->magic != __builtin_bswap32(TITLE_METADATA_CACHE_MAGIC) || header->version != TITLE_METADATA_CACHE_VERSION || !header->entry_count)
     {
-        LOG_MSG_ERROR("Failed to initialize NCA context for Control NCA from %016lX!", title_info->meta_key.id);
+        LOG_MSG_ERROR("Invalid user application metadata cache! Discarding it.");
         goto end;
     }
 
-    /* Initialize NACP context. */
-    if (!nacpInitializeContext(&nacp_ctx, nca_ctx))
+    if (header->language_code != language_code)
     {
-        LOG_MSG_ERROR("Failed to initialize NACP context for %016lX!", title_info->meta_key.id);
+        LOG_MSG_INFO("System language changed. Discarding user application metadata cache.");
         goto end;
     }
 
-    /* Get language entry. */
-    rc = nacpGetLanguageEntry((NacpStruct*)nacp_ctx.data, &lang_entry);
-    if (R_FAILED(rc))
+    /* Allocate memory for the entry pointers. */
+    if (!(out->entries = calloc(header->entry_count, sizeof(TitleMetadataCacheEntry*))))
     {
-        LOG_MSG_ERROR("nacpGetLanguageEntry failed! (0x%X).", rc);
+        LOG_MSG_ERROR("Failed to allocate memory for %u user application metadata cache entries!", header->entry_count);
         goto end;
     }
 
-    /* Determine language ID from the selected entry. */
-    for(u8 i = NacpLanguage_AmericanEnglish; i < NacpLanguage_Count; i++)
+    /* Validate cache entries. Binary searches rely on them being sorted. */
+    offset = sizeof(TitleMetadataCacheHeader);
+
+    for(u32 i = 0; i < header->entry_count; i++)
     {
-        /* Don't proceed any further if no language entry was retrieved. */
-        if (!lang_entry) break;
+        const TitleMetadataCacheEntry *entry = (const TitleMetadataCacheEntry*)(out->data + offset);
 
-        NacpTitle *cur_title = &(nacp_ctx.data->title[i]);
-        if (cur_title == (NacpTitle*)lang_entry)
+        if ((size - offset) < sizeof(TitleMetadataCacheEntry) || entry->icon_size > NACP_MAX_ICON_SIZE || (size - offset - sizeof(TitleMetadataCacheEntry)) < entry->icon_size || \
+            (i > 0 && entry->record.application_id <= prev_app_id))
         {
-            lang_id = i;
-            LOG_MSG_DEBUG("Selected language ID for %016lX: %u (%s).", title_info->meta_key.id, lang_id, nacpGetLanguageString(lang_id));
-            break;
+            LOG_MSG_ERROR("User application metadata cache entry #%u is invalid! Discarding cache.", i);
+            goto end;
         }
+
+        out->entries[i] = entry;
+        prev_app_id = entry->record.application_id;
+        offset += (sizeof(TitleMetadataCacheEntry) + entry->icon_size);
     }
 
-    /* Find the right NACP icon for the selected language entry. */
-    for(u8 i = 0; i < nacp_ctx.icon_count; i++)
+    if (offset != size)
     {
-        icon_ctx = &(nacp_ctx.icon_ctx[i]);
-        if (icon_ctx->language == lang_id) break;
-        icon_ctx = NULL;
+        LOG_MSG_ERROR("User application metadata cache holds trailing data! Discarding it.");
+        goto end;
     }
 
-    /* Fallback to the first available icon if we couldn't find one for our language ID. */
-    if (!icon_ctx && nacp_ctx.icon_ctx) icon_ctx = &(nacp_ctx.icon_ctx[0]);
+    out->entry_count = header->entry_count;
+
+    LOG_MSG_DEBUG("Loaded %u user application metadata cache entries.", out->entry_count);
+
+    success = true;
+
+end:
+    if (!success) titleFreeMetadataCache(out);
+
+    fclose(fp);
+
+    return success;
+}
+
+static const TitleMetadataCacheEntry *titleFindMetadataCacheEntry(const TitleMetadataCache *cache, const NsApplicationRecord *record)
+{
+    if (!cache->entries || !cache->entry_count) return NULL;
+
+    u32 low = 0, high = cache->entry_count;
+
+    while(low < high)
+    {
+        u32 mid = (low + ((high - low) / 2));
+        const TitleMetadataCacheEntry *entry = cache->entries[mid];
+
+        if (entry->record.application_id == record->application_id)
+        {
+            /* Only use this entry if the NS application record hasn't changed at all. */
+            return (!memcmp(&(entry->record), record, sizeof(NsApplicationRecord)) ? entry : NULL);
+        }
+
+        if (entry->record.application_id < record->application_id)
+        {
+            low = (mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+
+    return NULL;
+}
+
+static TitleApplicationMetadata *titleGenerateUserMetadataEntryFromCache(const TitleMetadataCacheEntry *entry)
+{
+    TitleApplicationMetadata *app_metadata = NULL;
+
+    /* Allocate memory for our application metadata entry. */
+    app_metadata = calloc(1, sizeof(TitleApplicationMetadata));
+    if (!app_metadata)
+    {
+        LOG_MSG_ERROR("Error allocating memory for application metadata entry for %016lX!", entry->record.application_id);
+        return NULL;
+    }
+
+    if (entry->icon_size)
+    {
+        /* Allocate memory for our icon. */
+        app_metadata->icon = malloc(entry->icon_size);
+        if (!app_metadata->icon)
+        {
+            LOG_MSG_ERROR("Error allocating memory for the icon buffer! (0x%X, %016lX).", entry->icon_size, entry->record.application_id);
+            free(app_metadata);
+            return NULL;
+        }
+
+        /* Copy icon data. It's stored right after the cache entry. */
+        memcpy(app_metadata->icon, (const u8*)entry + sizeof(TitleMetadataCacheEntry), entry->icon_size);
+        app_metadata->icon_size = entry->icon_size;
+    }
+
+    /* Fill the rest of the information. */
+    app_metadata->title_id = entry->record.application_id;
+    memcpy(&(app_metadata->lang_entry), &(entry->lang_entry), sizeof(NacpLanguageEntry));
+
+    return app_metadata;
+}
+
+static void titleSaveMetadataCache(const NsApplicationRecord *records, TitleApplicationMetadata **record_metadata, u32 record_count, u64 language_code)
+{
+    FILE *fp = NULL;
+    TitleMetadataCacheHeader header = { .magic = __builtin_bswap32(TITLE_METADATA_CACHE_MAGIC), .version = TITLE_METADATA_CACHE_VERSION, .language_code = language_code };
+    u32 *order = NULL;
+    bool write_ok = false;
+
+    if (!records || !record_metadata || !record_count) return;
+
+    /* Get the indexes for all records we have metadata for, then sort them by application ID. */
+    if (!(order = malloc(record_count * sizeof(u32))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for user application metadata cache order!");
+        return;
+    }
+
+    for(u32 i = 0; i < record_count; i++)
+    {
+        if (!record_metadata[i]) continue;
+
+        /* Insertion sort. NS application records are usually already sorted by date, not by ID, and there's only a few hundred of them. */
+        u32 j = header.entry_count++;
+        while(j > 0 && records[order[j - 1]].application_id > records[i].application_id)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+
+        order[j] = i;
+    }
+
+    /* Skip duplicate application IDs, if there are any. */
+    u32 unique_count = 0;
+    for(u32 i = 0; i < header.entry_count; i++)
+    {
+        if (unique_count && records[order[unique_count - 1]].application_id == records[order[i]].application_id) continue;
+        order[unique_count++] = order[i];
+    }
+
+    header.entry_count = unique_count;
+    if (!header.entry_count) goto end;
+
+    /* Write cache data to a temporary file, then replace the current cache file. */
+    utilsCreateDirectoryTree(TITLE_METADATA_CACHE_PATH, false);
+
+    if (!(fp = fopen(TITLE_METADATA_CACHE_TMP_PATH, "wb")))
+    {
+        LOG_MSG_ERROR("Failed to open \"" TITLE_METADATA_CACHE_TMP_PATH "\" for writing!");
+        goto end;
+    }
+
+    write_ok = (fwrite(&header, 1, sizeof(TitleMetadataCacheHeader), fp) == sizeof(TitleMetadataCacheHeader));
+
+    for(u32 i = 0; write_ok && i < header.entry_count; i++)
+    {
+        const TitleApplicationMetadata *app_metadata = record_metadata[order[i]];
+        TitleMetadataCacheEntry entry = { .icon_size = (app_metadata->icon ? app_metadata->icon_size : 0) };
+
+        memcpy(&(entry.record), &(records[order[i]]), sizeof(NsApplicationRecord));
+        memcpy(&(entry.lang_entry), &(app_metadata->lang_entry), sizeof(NacpLanguageEntry));
+
+        write_ok = (fwrite(&entry, 1, sizeof(TitleMetadataCacheEntry), fp) == sizeof(TitleMetadataCacheEntry) && \
+                    (!entry.icon_size || fwrite(app_metadata->icon, 1, entry.icon_size, fp) == entry.icon_size));
+    }
+
+    fclose(fp);
+
+    if (!write_ok)
+    {
+        LOG_MSG_ERROR("Failed to write %u user application metadata cache entries!", header.entry_count);
+        remove(TITLE_METADATA_CACHE_TMP_PATH);
+        goto end;
+    }
+
+    remove(TITLE_METADATA_CACHE_PATH);
+    rename(TITLE_METADATA_CACHE_TMP_PATH, TITLE_METADATA_CACHE_PATH);
+
+    utilsCommitSdCardFileSystemChanges();
+
+    LOG_MSG_DEBUG("Saved %u user application metadata cache entries.", header.entry_count);
+
+end:
+    free(order);
+}
+
+static void titleFreeMetadataCache(TitleMetadataCache *cache)
+{
+    if (cache->entries) free(cache->entries);
+    if (cache->data) free(cache->data);
+    memset(cache, 0, sizeof(TitleMetadataCache));
+}
+
+static TitleApplicationMetadata *titleGetSystemMetadataEntry(u64 title_id)
+{
+    if (!title_id)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    TitleApplicationMetadata *app_metadata = NULL;
+    bool success = false;
+
+    /* Make sure we have no application metadata entry for the requested title ID. */
+    /* If we do, we'll just return a pointer to the existing entry. */
+    app_metadata = titleFindApplicationMetadataByTitleId(title_id, true, 0);
+    if (app_metadata)
+    {
+        success = true;
+        goto end;
+    }
+
+    /* Allocate memory for the current entry. */
+    app_metadata = calloc(1, sizeof(TitleApplicationMetadata));
+    if (!app_metadata)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for application metadata entry for %016lX!", title_id);
+        goto end;
+    }
+
+    /* Fill information for our dummy entry. */
+    app_metadata->title_id = title_id;
+    sprintf(app_metadata->lang_entry.name, "Unknown");
+
+    /* Reallocate application metadata pointer array. */
+    if (!titleReallocateApplicationMetadata(1, true, false))
+    {
+        LOG_MSG_ERROR("Failed to reallocate application metadata pointer array for %016lX!", title_id);
+        goto end;
+    }
+
+    /* Set application metadata entry pointer. */
+    g_systemMetadata[g_systemMetadataCount++] = app_metadata;
+
+    /* Sort application metadata entries by title ID. */
+    titleSortApplicationMetadata(true);
+
+    /* Update flag. */
+    success = true;
+
+end:
+    if (!success && app_metadata)
+    {
+        free(app_metadata);
+        app_metadata = NULL;
+    }
+
+    return app_metadata;
+}
+
+static TitleApplicationMetadata *titleGenerateUserMetadataEntryFromNs(u64 title_id)
+{
+    if (!g_nsAppControlData || !title_id)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    u64 control_data_size = 0;
+    TitleApplicationMetadata *app_metadata = NULL;
+
+    /* Retrieve application control data from ns. */
+    if (!titleGetApplicationControlDataFromNs(title_id, g_nsAppControlData, &control_data_size))
+    {
+        LOG_MSG_ERROR("Failed to retrieve application control data for %016lX!", title_id);
+        goto end;
+    }
+
+    /* Initialize application metadata entry using the control data we just retrieved. */
+    app_metadata = titleInitializeUserMetadataEntryFromControlData(title_id, g_nsAppControlData, control_data_size);
+    if (!app_metadata) LOG_MSG_ERROR("Failed to generate application metadata entry for %016lX!", title_id);
+
+end:
+    return app_metadata;
+}
+
+static TitleApplicationMetadata *titleGenerateUserMetadataEntryFromControlNca(TitleInfo *title_info)
+{
+    if (!g_nsAppControlData || !title_info || !title_info->meta_key.id || title_info->app_metadata || \
+        (title_info->meta_key.type != NcmContentMetaType_Application && title_info->meta_key.type != NcmContentMetaType_Patch))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return NULL;
+    }
+
+    u64 control_data_size = 0, app_id = titleGetApplicationIdByContentMetaKey(&(title_info->meta_key));
+    TitleApplicationMetadata *app_metadata = NULL;
+
+    /* Retrieve application control data from Control NCA. */
+    if (!titleGetApplicationControlDataFromControlNca(title_info, g_nsAppControlData, &control_data_size))
+    {
+        LOG_MSG_ERROR("Failed to retrieve application control data for %016lX!", title_info->meta_key.id);
+        goto end;
+    }
+
+    /* Initialize application metadata entry using the control data we just retrieved. */
+    app_metadata = titleInitializeUserMetadataEntryFromControlData(app_id, g_nsAppControlData, control_data_size);
+    if (!app_metadata) LOG_MSG_ERROR("Failed to generate application metadata entry for %016lX!", title_info->meta_key.id);
+
+end:
+    return app_metadata;
+}
+
+static bool titleGetApplicationControlDataFromNs(u64 title_id, NsApplicationControlData *out_control_data, u64 *out_control_data_size)
+{
+    if (!title_id || !out_control_data || !out_control_data_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    Result rc = 0;
+    u64 control_data_size = 0;
+
+    /* Retrieve application control data from ns. */
+    rc = nsGetApplicationControlData(NsApplicationControlSource_Storage, title_id, out_control_data, sizeof(NsApplicationControlData), &control_data_size);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("nsGetApplicationControlData failed for title ID \"%016lX\"! (0x%X).", title_id, rc);
+        return false;
+    }
+
+    /* Sanity check. */
+    if (control_data_size < sizeof(NacpStruct))
+    {
+        LOG_MSG_ERROR("Retrieved application control data buffer for title ID \"%016lX\" is too small! (0x%lX).", title_id, control_data_size);
+        return false;
+    }
+
+    /* Update output size. */
+    *out_control_data_size = control_data_size;
+
+    return true;
+}
+
+static bool titleGetApplicationControlDataFromControlNca(TitleInfo *title_info, NsApplicationControlData *out_control_data, u64 *out_control_data_size)
+{
+    NcmContentInfo *nacp_content = NULL;
+
+    if (!title_info || !title_info->meta_key.id || (title_info->meta_key.type != NcmContentMetaType_Application && title_info->meta_key.type != NcmContentMetaType_Patch) || \
+        !(nacp_content = titleGetContentInfoByTypeAndIdOffset(title_info, NcmContentType_Control, 0)) || !out_control_data || !out_control_data_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    u8 storage_id = title_info->storage_id;
+    u8 hfs_partition_type = (storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : HashFileSystemPartitionType_None);
+
+    NcaContext *nca_ctx = NULL;
+    NacpContext nacp_ctx = {0};
+
+    Result rc = 0;
+    NacpLanguageEntry *lang_entry = NULL;
+    u8 lang_id = NacpLanguage_AmericanEnglish;  /* Fallback value. */
+
+    NacpIconContext *icon_ctx = NULL;
+
+    bool success = false;
+
+    LOG_MSG_DEBUG("Retrieving application control data for %s %016lX in %s...", titleGetNcmContentMetaTypeName(title_info->meta_key.type), title_info->meta_key.id, \
+                                                                                titleGetNcmStorageIdName(title_info->storage_id));
+
+    /* Allocate memory for the NCA context. */
+    nca_ctx = calloc(1, sizeof(NcaContext));
+    if (!nca_ctx)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for NCA context!");
+        goto end;
+    }
+
+    /* Initialize NCA context. */
+    if (!ncaInitializeContextLazy(nca_ctx, storage_id, hfs_partition_type, &(title_info->meta_key), nacp_content, NULL))
+    {
+        LOG_MSG_ERROR("Failed to initialize NCA context for Control NCA from %016lX!", title_info->meta_key.id);
+        goto end;
+    }
+
+    /* Initialize NACP context. */
+    if (!nacpInitializeContext(&nacp_ctx, nca_ctx))
+    {
+        LOG_MSG_ERROR("Failed to initialize NACP context for %016lX!", title_info->meta_key.id);
+        goto end;
+    }
+
+    /* Get language entry. */
+    rc = nacpGetLanguageEntry((NacpStruct*)nacp_ctx.data, &lang_entry);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("nacpGetLanguageEntry failed! (0x%X).", rc);
+        goto end;
+    }
+
+    /* Determine language ID from the selected entry. */
+    for(u8 i = NacpLanguage_AmericanEnglish; i < NacpLanguage_Count; i++)
+    {
+        /* Don't proceed any further if no language entry was retrieved. */
+        if (!lang_entry) break;
+
+        NacpTitle *cur_title = &(nacp_ctx.data->title[i]);
+        if (cur_title == (NacpTitle*)lang_entry)
+        {
+            lang_id = i;
+            LOG_MSG_DEBUG("Selected language ID for %016lX: %u (%s).", title_info->meta_key.id, lang_id, nacpGetLanguageString(lang_id));
+            break;
+        }
+    }
+
+    /* Find the right NACP icon for the selected language entry. */
+    for(u8 i = 0; i < nacp_ctx.icon_count; i++)
+    {
+        icon_ctx = &(nacp_ctx.icon_ctx[i]);
+        if (icon_ctx->language == lang_id) break;
+        icon_ctx = NULL;
+    }
+
+    /* Fallback to the first available icon if we couldn't find one for our language ID. */
+    if (!icon_ctx && nacp_ctx.icon_ctx) icon_ctx = &(nacp_ctx.icon_ctx[0]);
 
     /* Sanity check. */
     if (icon_ctx && (!icon_ctx->icon_size || icon_ctx->icon_size > NACP_MAX_ICON_SIZE))
@@ -2187,121 +3002,439 @@ static TitleApplicationMetadata *titleInitializeUserMetadataEntryFromControlData
         LOG_DATA_DEBUG(&(control_data->nacp), sizeof(NacpStruct), "NACP dump (ID %016lX):", title_id);
     }
 
-    /* Update flag. */
-    success = true;
+    /* Update flag. */
+    success = true;
+
+end:
+    if (!success && out)
+    {
+        free(out);
+        out = NULL;
+    }
+
+    return out;
+}
+
+static void titleGenerateFilteredApplicationMetadataPointerArray(bool is_system)
+{
+    TitleApplicationMetadata **filtered_app_metadata = NULL, **tmp_filtered_app_metadata = NULL;
+    u32 filtered_app_metadata_count = 0;
+
+    TitleApplicationMetadata **cached_app_metadata = (is_system ? g_systemMetadata : g_userMetadata);
+    u32 cached_app_metadata_count = (is_system ? g_systemMetadataCount : g_userMetadataCount);
+
+    /* Free secondary indexes. They'll be rebuilt on demand. */
+    titleFreeQueryIndex(is_system);
+
+    /* Reset the right pointer and counter based on the input flag. */
+    if (is_system)
+    {
+        if (g_filteredSystemMetadata)
+        {
+            free(g_filteredSystemMetadata);
+            g_filteredSystemMetadata = NULL;
+        }
+
+        g_filteredSystemMetadataCount = 0;
+    } else {
+        if (g_filteredUserMetadata)
+        {
+            free(g_filteredUserMetadata);
+            g_filteredUserMetadata = NULL;
+        }
+
+        g_filteredUserMetadataCount = 0;
+    }
+
+    /* Make sure we actually have cached application metadata entries we can work with. */
+    if (!cached_app_metadata || !cached_app_metadata_count)
+    {
+        LOG_MSG_ERROR("Cached %s application metadata array is empty!", is_system ? "system" : "user");
+        return;
+    }
+
+    /* Loop through our cached application metadata entries. */
+    for(u32 i = 0; i < cached_app_metadata_count; i++)
+    {
+        TitleApplicationMetadata *cur_app_metadata = cached_app_metadata[i];
+        if (!cur_app_metadata) continue;
+
+        /* Skip current metadata entry if content data for this title isn't available. */
+        if ((is_system && !_titleGetTitleInfoEntryFromStorageByTitleId(NcmStorageId_BuiltInSystem, cur_app_metadata->title_id)) || \
+            (!is_system && !titleIsUserApplicationContentAvailable(cur_app_metadata->title_id))) continue;
+
+        /* Reallocate filtered application metadata pointer array. */
+        tmp_filtered_app_metadata = realloc(filtered_app_metadata, (filtered_app_metadata_count + 1) * sizeof(TitleApplicationMetadata*));
+        if (!tmp_filtered_app_metadata)
+        {
+            LOG_MSG_ERROR("Failed to reallocate filtered application metadata pointer array!");
+            if (filtered_app_metadata) free(filtered_app_metadata);
+            return;
+        }
+
+        filtered_app_metadata = tmp_filtered_app_metadata;
+        tmp_filtered_app_metadata = NULL;
+
+        /* Set current pointer and increase counter. */
+        filtered_app_metadata[filtered_app_metadata_count++] = cur_app_metadata;
+    }
+
+    if (!filtered_app_metadata || !filtered_app_metadata_count)
+    {
+        LOG_MSG_ERROR("No content data found for %s!", is_system ? "system titles" : "user applications");
+        return;
+    }
+
+    /* Update the right pointer and counter based on the input flag. */
+    if (is_system)
+    {
+        g_filteredSystemMetadata = filtered_app_metadata;
+        g_filteredSystemMetadataCount = filtered_app_metadata_count;
+    } else {
+        g_filteredUserMetadata = filtered_app_metadata;
+        g_filteredUserMetadataCount = filtered_app_metadata_count;
+    }
+}
+
+static bool titleIsUserApplicationContentAvailable(u64 app_id)
+{
+    if (!app_id) return false;
+
+    for(u8 i = NcmStorageId_GameCard; i <= NcmStorageId_SdCard; i++)
+    {
+        if (i == NcmStorageId_BuiltInSystem) continue;
+
+        TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(i)]);
+        if (!title_storage->titles || !*(title_storage->titles) || !title_storage->title_count) continue;
+
+        for(u32 j = 0; j < title_storage->title_count; j++)
+        {
+            TitleInfo *title_info = title_storage->titles[j];
+            if (!title_info) continue;
+
+            if ((title_info->meta_key.type == NcmContentMetaType_Application && title_info->meta_key.id == app_id) || \
+                (title_info->meta_key.type == NcmContentMetaType_Patch && titleCheckIfPatchIdBelongsToApplicationId(app_id, title_info->meta_key.id)) || \
+                (title_info->meta_key.type == NcmContentMetaType_AddOnContent && titleCheckIfAddOnContentIdBelongsToApplicationId(app_id, title_info->meta_key.id)) || \
+                (title_info->meta_key.type == NcmContentMetaType_DataPatch && titleCheckIfDataPatchIdBelongsToApplicationId(app_id, title_info->meta_key.id))) return true;
+        }
+    }
+
+    return false;
+}
+
+static bool titleAppendTitleRecord(TitleRecordsExportContext *ctx, const char *name, bool escaped_name, TitleInfo *title_info)
+{
+    bool success = false;
+
+    /* Name must have already been escaped, if needed. Escaped JSON strings are already quoted, while escaped CSV strings aren't. Orphan titles have no name. */
+    if (ctx->format == TitleRecordsFormat_Json)
+    {
+        success = utilsAppendFormattedStringToBuffer(&(ctx->buf), &(ctx->buf_size), "%s\r\n  { \"name\": %s, \"type\": \"%s\", \"title_id\": \"%016lX\", \"version\": %u, " \
+                                                                                    "\"storage\": \"%s\", \"content_count\": %u, \"size\": %lu }", ctx->record_count ? "," : "", \
+                                                                                    name ? name : "null", titleGetNcmContentMetaTypeName(title_info->meta_key.type), \
+                                                                                    title_info->meta_key.id, title_info->version.value, titleGetNcmStorageIdName(title_info->storage_id), \
+                                                                                    title_info->content_count, title_info->size);
+    } else {
+        success = utilsAppendFormattedStringToBuffer(&(ctx->buf), &(ctx->buf_size), escaped_name ? "\"%s\",%s,%016lX,%u,%s,%u,%s (%lu bytes)\r\n" : \
+                                                                                    "%s,%s,%016lX,%u,%s,%u,%s (%lu bytes)\r\n", name ? name : "[UNKNOWN]", \
+                                                                                    titleGetNcmContentMetaTypeName(title_info->meta_key.type), title_info->meta_key.id, \
+                                                                                    title_info->version.value, titleGetNcmStorageIdName(title_info->storage_id), \
+                                                                                    title_info->content_count, title_info->size_str, title_info->size);
+    }
+
+    if (!success) return false;
+
+    /* Increase processed titles counter. */
+    ctx->record_count++;
+
+    /* Hand the current chunk over to the write callback once it's big enough. */
+    return (strlen(ctx->buf) < TITLE_RECORDS_EXPORT_CHUNK_SIZE || titleFlushTitleRecordsExportBuffer(ctx));
+}
+
+static bool titleAppendTitleRecordsExportString(TitleRecordsExportContext *ctx, const char *str)
+{
+    return utilsAppendFormattedStringToBuffer(&(ctx->buf), &(ctx->buf_size), "%s", str);
+}
+
+static bool titleFlushTitleRecordsExportBuffer(TitleRecordsExportContext *ctx)
+{
+    size_t len = (ctx->buf ? strlen(ctx->buf) : 0);
+    if (!len) return true;
+
+    if (!ctx->write_cb(ctx->buf, len, ctx->user_data))
+    {
+        LOG_MSG_ERROR("Failed to write 0x%lX-byte long title records chunk!", len);
+        return false;
+    }
+
+    /* Reuse the same buffer for the next chunk. */
+    *(ctx->buf) = '\0';
+
+    return true;
+}
+
+static bool titleAppendTitleRecordsToBuffer(const void *data, size_t data_size, void *user_data)
+{
+    TitleRecordsBuffer *out = (TitleRecordsBuffer*)user_data;
+    char *tmp = NULL;
+
+    /* Reallocate output buffer. Keep it NULL-terminated. */
+    if (!(tmp = realloc(out->data, out->size + data_size + 1)))
+    {
+        LOG_MSG_ERROR("Failed to reallocate title records buffer! (0x%lX).", out->size + data_size + 1);
+        return false;
+    }
+
+    out->data = tmp;
+    memcpy(out->data + out->size, data, data_size);
+    out->size += data_size;
+    out->data[out->size] = '\0';
+
+    return true;
+}
+
+static bool titleBuildQueryIndex(bool is_system)
+{
+    TitleApplicationMetadata **filtered_app_metadata = (is_system ? g_filteredSystemMetadata : g_filteredUserMetadata);
+    u32 filtered_app_metadata_count = (is_system ? g_filteredSystemMetadataCount : g_filteredUserMetadataCount);
+    TitleQueryIndex *index = (is_system ? &g_systemQueryIndex : &g_userQueryIndex);
+    bool success = false;
+
+    titleFreeQueryIndex(is_system);
+
+    /* Allocate memory for the query entries. */
+    index->entries = calloc(filtered_app_metadata_count, sizeof(TitleQueryEntry));
+    if (!index->entries)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for %u query index entries!", filtered_app_metadata_count);
+        goto end;
+    }
+
+    index->entry_count = filtered_app_metadata_count;
+
+    /* Generate lowercase strings. */
+    for(u32 i = 0; i < filtered_app_metadata_count; i++)
+    {
+        const NacpLanguageEntry *lang_entry = &(filtered_app_metadata[i]->lang_entry);
+        TitleQueryEntry *entry = &(index->entries[i]);
+
+        entry->name = titleGenerateLowercaseString(lang_entry->name, sizeof(lang_entry->name));
+        entry->author = titleGenerateLowercaseString(lang_entry->author, sizeof(lang_entry->author));
+
+        if (!entry->name || !entry->author)
+        {
+            LOG_MSG_ERROR("Failed to generate lowercase strings for %016lX!", filtered_app_metadata[i]->title_id);
+            goto end;
+        }
+    }
+
+    /* Generate trigram posting lists. */
+    if (!titleGenerateQueryIndexTrigrams(index, false) || !titleGenerateQueryIndexTrigrams(index, true)) goto end;
+
+    /* Retrieve sizes, storages and content meta types from all available titles. */
+    titleUpdateQueryIndexEntryAttributes(index, is_system);
+
+    /* Update flags. */
+    success = index->built = true;
+
+end:
+    if (!success) titleFreeQueryIndex(is_system);
+
+    return success;
+}
+
+static bool titleGenerateQueryIndexTrigrams(TitleQueryIndex *index, bool author)
+{
+    TitleQueryTrigram *trigrams = NULL;
+    u32 trigram_count = 0, unique_count = 0;
+
+    /* Get the total trigram count. */
+    for(u32 i = 0; i < index->entry_count; i++)
+    {
+        size_t len = strlen(author ? index->entries[i].author : index->entries[i].name);
+        if (len >= TITLE_QUERY_TRIGRAM_LENGTH) trigram_count += (u32)(len - TITLE_QUERY_TRIGRAM_LENGTH + 1);
+    }
+
+    if (trigram_count)
+    {
+        /* Allocate memory for the trigram postings. */
+        trigrams = malloc(trigram_count * sizeof(TitleQueryTrigram));
+        if (!trigrams)
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for %u query index trigrams!", trigram_count);
+            return false;
+        }
+
+        /* Fill trigram postings. */
+        trigram_count = 0;
+
+        for(u32 i = 0; i < index->entry_count; i++)
+        {
+            const char *str = (author ? index->entries[i].author : index->entries[i].name);
+            size_t len = strlen(str);
+
+            for(size_t j = 0; (j + TITLE_QUERY_TRIGRAM_LENGTH) <= len; j++)
+            {
+                trigrams[trigram_count].trigram = TITLE_QUERY_TRIGRAM(str + j);
+                trigrams[trigram_count++].entry_idx = i;
+            }
+        }
+
+        /* Sort trigram postings, then remove duplicates. */
+        if (trigram_count > 1) qsort(trigrams, trigram_count, sizeof(TitleQueryTrigram), &titleQueryTrigramSortFunction);
 
-end:
-    if (!success && out)
+        for(u32 i = 0; i < trigram_count; i++)
+        {
+            if (unique_count && trigrams[unique_count - 1].trigram == trigrams[i].trigram && trigrams[unique_count - 1].entry_idx == trigrams[i].entry_idx) continue;
+            trigrams[unique_count++] = trigrams[i];
+        }
+    }
+
+    if (author)
     {
-        free(out);
-        out = NULL;
+        index->author_trigrams = trigrams;
+        index->author_trigram_count = unique_count;
+    } else {
+        index->name_trigrams = trigrams;
+        index->name_trigram_count = unique_count;
     }
 
-    return out;
+    return true;
 }
 
-static void titleGenerateFilteredApplicationMetadataPointerArray(bool is_system)
+static void titleUpdateQueryIndexEntryAttributes(TitleQueryIndex *index, bool is_system)
 {
-    TitleApplicationMetadata **filtered_app_metadata = NULL, **tmp_filtered_app_metadata = NULL;
-    u32 filtered_app_metadata_count = 0;
+    TitleIdIndex entry_index = {0};
 
-    TitleApplicationMetadata **cached_app_metadata = (is_system ? g_systemMetadata : g_userMetadata);
-    u32 cached_app_metadata_count = (is_system ? g_systemMetadataCount : g_userMetadataCount);
-
-    /* Reset the right pointer and counter based on the input flag. */
-    if (is_system)
+    /* Map title IDs to query entries. */
+    for(u32 i = 0; i < index->entry_count; i++)
     {
-        if (g_filteredSystemMetadata)
+        TitleApplicationMetadata *app_metadata = (is_system ? g_filteredSystemMetadata[i] : g_filteredUserMetadata[i]);
+        if (!titleInsertTitleIdIndexEntry(&entry_index, app_metadata->title_id, &(index->entries[i]), false))
         {
-            free(g_filteredSystemMetadata);
-            g_filteredSystemMetadata = NULL;
+            LOG_MSG_ERROR("Failed to map query index entries! Size, storage and content meta type filters won't match anything.");
+            goto end;
         }
+    }
 
-        g_filteredSystemMetadataCount = 0;
-    } else {
-        if (g_filteredUserMetadata)
+    /* Loop through all the title storages that may hold titles for these entries. */
+    for(u8 i = NcmStorageId_GameCard; i <= NcmStorageId_SdCard; i++)
+    {
+        if ((is_system && i != NcmStorageId_BuiltInSystem) || (!is_system && i == NcmStorageId_BuiltInSystem)) continue;
+
+        TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(i)]);
+        if (!title_storage->titles || !title_storage->title_count) continue;
+
+        for(u32 j = 0; j < title_storage->title_count; j++)
         {
-            free(g_filteredUserMetadata);
-            g_filteredUserMetadata = NULL;
-        }
+            TitleInfo *title_info = title_storage->titles[j];
+            if (!title_info) continue;
 
-        g_filteredUserMetadataCount = 0;
-    }
+            u64 title_id = (is_system ? title_info->meta_key.id : titleGetApplicationIdByContentMetaKey(&(title_info->meta_key)));
 
-    /* Make sure we actually have cached application metadata entries we can work with. */
-    if (!cached_app_metadata || !cached_app_metadata_count)
-    {
-        LOG_MSG_ERROR("Cached %s application metadata array is empty!", is_system ? "system" : "user");
-        return;
+            TitleQueryEntry *entry = (TitleQueryEntry*)titleGetTitleIdIndexEntry(&entry_index, title_id);
+            if (!entry) continue;
+
+            entry->size += title_info->size;
+            entry->meta_type_mask |= TITLE_QUERY_META_TYPE_BIT(title_info->meta_key.type);
+            entry->storage_mask |= BIT(TITLE_STORAGE_INDEX(i));
+        }
     }
 
-    /* Loop through our cached application metadata entries. */
-    for(u32 i = 0; i < cached_app_metadata_count; i++)
-    {
-        TitleApplicationMetadata *cur_app_metadata = cached_app_metadata[i];
-        if (!cur_app_metadata) continue;
+end:
+    titleFreeTitleIdIndex(&entry_index);
+}
 
-        /* Skip current metadata entry if content data for this title isn't available. */
-        if ((is_system && !_titleGetTitleInfoEntryFromStorageByTitleId(NcmStorageId_BuiltInSystem, cur_app_metadata->title_id)) || \
-            (!is_system && !titleIsUserApplicationContentAvailable(cur_app_metadata->title_id))) continue;
+static const TitleQueryTrigram *titleGetQueryIndexTrigramRange(const TitleQueryTrigram *trigrams, u32 trigram_count, u32 trigram, u32 *out_count)
+{
+    u32 low = 0, high = trigram_count, start = 0;
 
-        /* Reallocate filtered application metadata pointer array. */
-        tmp_filtered_app_metadata = realloc(filtered_app_metadata, (filtered_app_metadata_count + 1) * sizeof(TitleApplicationMetadata*));
-        if (!tmp_filtered_app_metadata)
+    *out_count = 0;
+    if (!trigrams || !trigram_count) return NULL;
+
+    /* Look for the first posting with the provided trigram. */
+    while(low < high)
+    {
+        u32 mid = (low + ((high - low) / 2));
+
+        if (trigrams[mid].trigram < trigram)
         {
-            LOG_MSG_ERROR("Failed to reallocate filtered application metadata pointer array!");
-            if (filtered_app_metadata) free(filtered_app_metadata);
-            return;
+            low = (mid + 1);
+        } else {
+            high = mid;
         }
+    }
 
-        filtered_app_metadata = tmp_filtered_app_metadata;
-        tmp_filtered_app_metadata = NULL;
+    start = low;
 
-        /* Set current pointer and increase counter. */
-        filtered_app_metadata[filtered_app_metadata_count++] = cur_app_metadata;
-    }
+    /* Look for the first posting past the provided trigram. */
+    high = trigram_count;
 
-    if (!filtered_app_metadata || !filtered_app_metadata_count)
+    while(low < high)
     {
-        LOG_MSG_ERROR("No content data found for %s!", is_system ? "system titles" : "user applications");
-        return;
-    }
+        u32 mid = (low + ((high - low) / 2));
 
-    /* Update the right pointer and counter based on the input flag. */
-    if (is_system)
-    {
-        g_filteredSystemMetadata = filtered_app_metadata;
-        g_filteredSystemMetadataCount = filtered_app_metadata_count;
-    } else {
-        g_filteredUserMetadata = filtered_app_metadata;
-        g_filteredUserMetadataCount = filtered_app_metadata_count;
+        if (trigrams[mid].trigram <= trigram)
+        {
+            low = (mid + 1);
+        } else {
+            high = mid;
+        }
     }
+
+    *out_count = (low - start);
+
+    return (*out_count ? &(trigrams[start]) : NULL);
 }
 
-static bool titleIsUserApplicationContentAvailable(u64 app_id)
+static bool titleQueryIndexEntryMatches(const TitleQueryEntry *entry, const char *name, const char *author, const TitleQueryFilter *filter)
 {
-    if (!app_id) return false;
+    u8 storage_id = filter->storage_id, meta_type = filter->content_meta_type;
 
-    for(u8 i = NcmStorageId_GameCard; i <= NcmStorageId_SdCard; i++)
-    {
-        if (i == NcmStorageId_BuiltInSystem) continue;
+    if (storage_id >= NcmStorageId_GameCard && storage_id <= NcmStorageId_SdCard && !(entry->storage_mask & BIT(TITLE_STORAGE_INDEX(storage_id)))) return false;
 
-        TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(i)]);
-        if (!title_storage->titles || !*(title_storage->titles) || !title_storage->title_count) continue;
+    if (meta_type != NcmContentMetaType_Unknown && !(entry->meta_type_mask & TITLE_QUERY_META_TYPE_BIT(meta_type))) return false;
 
-        for(u32 j = 0; j < title_storage->title_count; j++)
-        {
-            TitleInfo *title_info = title_storage->titles[j];
-            if (!title_info) continue;
+    if ((filter->min_size && entry->size < filter->min_size) || (filter->max_size && entry->size > filter->max_size)) return false;
 
-            if ((title_info->meta_key.type == NcmContentMetaType_Application && title_info->meta_key.id == app_id) || \
-                (title_info->meta_key.type == NcmContentMetaType_Patch && titleCheckIfPatchIdBelongsToApplicationId(app_id, title_info->meta_key.id)) || \
-                (title_info->meta_key.type == NcmContentMetaType_AddOnContent && titleCheckIfAddOnContentIdBelongsToApplicationId(app_id, title_info->meta_key.id)) || \
-                (title_info->meta_key.type == NcmContentMetaType_DataPatch && titleCheckIfDataPatchIdBelongsToApplicationId(app_id, title_info->meta_key.id))) return true;
+    /* Trigram matches only narrow down the candidates, so substrings must always be checked. */
+    if ((name && !strstr(entry->name, name)) || (author && !strstr(entry->author, author))) return false;
+
+    return true;
+}
+
+static void titleFreeQueryIndex(bool is_system)
+{
+    TitleQueryIndex *index = (is_system ? &g_systemQueryIndex : &g_userQueryIndex);
+
+    if (index->entries)
+    {
+        for(u32 i = 0; i < index->entry_count; i++)
+        {
+            if (index->entries[i].name) free(index->entries[i].name);
+            if (index->entries[i].author) free(index->entries[i].author);
         }
+
+        free(index->entries);
     }
 
-    return false;
+    if (index->name_trigrams) free(index->name_trigrams);
+    if (index->author_trigrams) free(index->author_trigrams);
+
+    memset(index, 0, sizeof(TitleQueryIndex));
+}
+
+static char *titleGenerateLowercaseString(const char *str, size_t max_len)
+{
+    size_t len = strnlen(str, max_len);
+    char *out = malloc(len + 1);
+    if (!out) return NULL;
+
+    /* Only ASCII characters are converted. UTF-8 sequences are left untouched. */
+    for(size_t i = 0; i < len; i++) out[i] = ((str[i] >= 'A' && str[i] <= 'Z') ? (str[i] + 0x20) : str[i]);
+    out[len] = '\0';
+
+    return out;
 }
 
 NX_INLINE TitleApplicationMetadata *titleFindApplicationMetadataByTitleId(u64 title_id, bool is_system, u32 extra_app_count)
@@ -2310,8 +3443,18 @@ NX_INLINE TitleApplicationMetadata *titleFindApplicationMetadataByTitleId(u64 ti
 
     TitleApplicationMetadata **cached_app_metadata = (is_system ? g_systemMetadata : g_userMetadata);
     u32 cached_app_metadata_count = ((is_system ? g_systemMetadataCount : g_userMetadataCount) + extra_app_count);
+    const TitleIdIndex *index = (is_system ? &g_systemMetadataIndex : &g_userMetadataIndex);
+    u32 start_idx = 0;
 
-    for(u32 i = 0; i < cached_app_metadata_count; i++)
+    /* Use the title ID index, if available. Extra entries haven't been indexed yet, so they're always checked one by one. */
+    if (index->entries)
+    {
+        TitleApplicationMetadata *app_metadata = (TitleApplicationMetadata*)titleGetTitleIdIndexEntry(index, title_id);
+        if (app_metadata) return app_metadata;
+        start_idx = (cached_app_metadata_count - extra_app_count);
+    }
+
+    for(u32 i = start_idx; i < cached_app_metadata_count; i++)
     {
         TitleApplicationMetadata *cur_app_metadata = cached_app_metadata[i];
         if (cur_app_metadata && cur_app_metadata->title_id == title_id) return cur_app_metadata;
@@ -2358,8 +3501,9 @@ static bool titleGenerateTitleInfoEntriesForTitleStorage(TitleStorage *title_sto
     u8 storage_id = title_storage->storage_id;
     NcmContentMetaDatabase *ncm_db = &(title_storage->ncm_db);
 
-    u32 meta_key_count = 0, extra_title_count = 0;
+    u32 meta_key_count = 0, extra_title_count = 0, content_info_buf_count = 0;
     NcmContentMetaKey *meta_keys = NULL;
+    NcmContentInfo *content_info_buf = NULL;
 
     bool success = false, free_entries = false;
 
@@ -2388,15 +3532,22 @@ static bool titleGenerateTitleInfoEntriesForTitleStorage(TitleStorage *title_sto
 
         TitleInfo *title_info = NULL;
 
-        /* Get content infos. */
-        if (!titleGetContentInfosByMetaKey(ncm_db, cur_meta_key, &content_infos, &content_count))
+        /* Check if the title storage scan has been cancelled. */
+        if (cancelTokenIsCurrentCancelled())
+        {
+            LOG_MSG_DEBUG("Title storage scan cancelled! (%u / %u).", i, meta_key_count);
+            goto end;
+        }
+
+        /* Get content infos. The scratch buffer is reused across all meta keys from this storage. */
+        if (!titleGetContentInfosByMetaKey(ncm_db, cur_meta_key, &content_info_buf, &content_info_buf_count, &content_infos, &content_count))
         {
             LOG_MSG_ERROR("Failed to get content infos for %016lX!", cur_meta_key->id);
             continue;
         }
 
         /* Generate TitleInfo entry. */
-        title_info = titleGenerateTitleInfoEntry(storage_id, cur_meta_key, content_infos, content_count, false);
+        title_info = titleGenerateTitleInfoEntry(storage_id, cur_meta_key, content_infos, content_count);
         if (!title_info)
         {
             LOG_MSG_ERROR("Failed to generate TitleInfo entry for %016lX!", cur_meta_key->id);
@@ -2425,11 +3576,17 @@ static bool titleGenerateTitleInfoEntriesForTitleStorage(TitleStorage *title_sto
     if (extra_title_count < meta_key_count) titleReallocateTitleInfoFromStorage(title_storage, 0, false);
 
     /* Sort title info entries by title ID, version and storage ID. */
-    if (title_storage->title_count > 1) qsort(title_storage->titles, title_storage->title_count, sizeof(TitleInfo*), &titleInfoSortFunction);
+    titleSortTitleInfoFromStorage(title_storage);
 
     /* Update linked lists for user applications, patches and add-on contents. */
     /* This will also keep track of orphan titles - titles with no available application metadata. */
-    titleUpdateTitleInfoLinkedLists();
+    /* Gamecard titles are linked on their own, without touching the rest of the linked lists. */
+    if (storage_id == NcmStorageId_GameCard)
+    {
+        titleUpdateGameCardTitleInfoLinkedLists();
+    } else {
+        titleUpdateTitleInfoLinkedLists();
+    }
 
     /* Update flag. */
     success = true;
@@ -2438,6 +3595,8 @@ end:
     /* Free previously allocated title info pointers. Ignore return value. */
     if (!success && free_entries) titleReallocateTitleInfoFromStorage(title_storage, extra_title_count, true);
 
+    if (content_info_buf) free(content_info_buf);
+
     if (meta_keys) free(meta_keys);
 
     return success;
@@ -2485,6 +3644,13 @@ static bool titleGenerateTitleInfoEntriesByHashFileSystemForGameCardTitleStorage
 
         TitleInfo *title_info = NULL;
 
+        /* Check if the gamecard title scan has been cancelled. */
+        if (cancelTokenIsCurrentCancelled())
+        {
+            LOG_MSG_DEBUG("Gamecard title scan cancelled! (%u / %u) (%s partition).", i, gc_meta_ctx_count, hfsGetPartitionNameString(hfs_ctx->type));
+            goto end;
+        }
+
         /* Get content infos. */
         if (!titleGetContentInfosByGameCardContentMetaContext(cur_gc_meta_ctx, hfs_ctx, &content_infos, &content_count))
         {
@@ -2493,7 +3659,7 @@ static bool titleGenerateTitleInfoEntriesByHashFileSystemForGameCardTitleStorage
         }
 
         /* Generate TitleInfo entry. */
-        title_info = titleGenerateTitleInfoEntry(NcmStorageId_GameCard, meta_key, content_infos, content_count, true);
+        title_info = titleGenerateTitleInfoEntry(NcmStorageId_GameCard, meta_key, content_infos, content_count);
         if (!title_info)
         {
             LOG_MSG_ERROR("Failed to generate TitleInfo entry for %016lX! (%s partition).", meta_key->id, hfsGetPartitionNameString(hfs_ctx->type));
@@ -2521,11 +3687,14 @@ static bool titleGenerateTitleInfoEntriesByHashFileSystemForGameCardTitleStorage
     /* Free extra allocated pointers if we didn't use them. */
     if (extra_title_count < gc_meta_ctx_count) titleReallocateTitleInfoFromStorage(title_storage, 0, false);
 
+    /* Manually retrieve application metadata from Control NCAs for user applications and patches we have no metadata for. */
+    titleInitializeTitleInfoApplicationMetadataFromControlNcas(title_storage->titles, title_storage->title_count);
+
     /* Sort title info entries by title ID, version and storage ID. */
-    if (title_storage->title_count > 1) qsort(title_storage->titles, title_storage->title_count, sizeof(TitleInfo*), &titleInfoSortFunction);
+    titleSortTitleInfoFromStorage(title_storage);
 
     /* Update linked lists for user applications, patches and add-on contents. */
-    titleUpdateTitleInfoLinkedLists();
+    titleUpdateGameCardTitleInfoLinkedLists();
 
     /* Update flag. */
     success = true;
@@ -2539,7 +3708,7 @@ end:
     return success;
 }
 
-static TitleInfo *titleGenerateTitleInfoEntry(u8 storage_id, const NcmContentMetaKey *meta_key, NcmContentInfo *content_infos, u32 content_count, bool get_control_nca_metadata)
+static TitleInfo *titleGenerateTitleInfoEntry(u8 storage_id, const NcmContentMetaKey *meta_key, NcmContentInfo *content_infos, u32 content_count)
 {
     if (storage_id < NcmStorageId_GameCard || storage_id > NcmStorageId_SdCard || !meta_key || !meta_key->id || !content_infos || !content_count)
     {
@@ -2583,11 +3752,6 @@ static TitleInfo *titleGenerateTitleInfoEntry(u8 storage_id, const NcmContentMet
         /* Dig through what we have. */
         u64 app_id = titleGetApplicationIdByContentMetaKey(meta_key);
         title_info->app_metadata = titleFindApplicationMetadataByTitleId(app_id, false, 0);
-        if (!title_info->app_metadata && get_control_nca_metadata && (meta_key->type == NcmContentMetaType_Application || meta_key->type == NcmContentMetaType_Patch))
-        {
-            /* Manually retrieve application metadata from this title's Control NCA. */
-            titleInitializeTitleInfoApplicationMetadataFromControlNca(title_info);
-        }
     }
 
     return title_info;
@@ -2631,7 +3795,7 @@ static bool titleInitializeTitleInfoApplicationMetadataFromControlNca(TitleInfo
     g_userMetadata[g_userMetadataCount++] = app_metadata;
 
     /* Sort application metadata entries by name. */
-    if (g_userMetadataCount > 1) qsort(g_userMetadata, g_userMetadataCount, sizeof(TitleApplicationMetadata*), &titleUserMetadataSortFunction);
+    titleSortApplicationMetadata(false);
 
     /* Update flag. */
     success = true;
@@ -2650,6 +3814,163 @@ end:
     return success;
 }
 
+static void titleInitializeTitleInfoApplicationMetadataFromControlNcas(TitleInfo **titles, u32 title_count)
+{
+    if (!titles || !title_count) return;
+
+    TitleControlNcaJobQueue queue = {0};
+    Thread threads[TITLE_CONTROL_NCA_THREAD_COUNT] = {0};
+    u32 thread_count = 0, app_count = 0;
+
+    mutexInit(&(queue.mutex));
+    queue.cancel_token = cancelTokenGetCurrent();
+
+    /* Allocate memory for the job list. */
+    queue.jobs = calloc(title_count, sizeof(TitleControlNcaJob));
+    if (!queue.jobs)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for Control NCA job list!");
+        goto end;
+    }
+
+    /* Pick a single user application or patch per application ID. Every other title sharing it will reuse the same application metadata entry. */
+    for(u32 i = 0; i < title_count; i++)
+    {
+        TitleInfo *title_info = titles[i];
+        if (!title_info || title_info->app_metadata || (title_info->meta_key.type != NcmContentMetaType_Application && title_info->meta_key.type != NcmContentMetaType_Patch)) continue;
+
+        u64 app_id = titleGetApplicationIdByContentMetaKey(&(title_info->meta_key));
+        bool dup = false;
+
+        for(u32 j = 0; j < queue.job_count; j++)
+        {
+            if (titleGetApplicationIdByContentMetaKey(&(queue.jobs[j].title_info->meta_key)) == app_id)
+            {
+                dup = true;
+                break;
+            }
+        }
+
+        if (!dup) queue.jobs[queue.job_count++].title_info = title_info;
+    }
+
+    if (!queue.job_count) goto end;
+
+    /* Parse Control NCAs using multiple threads. NCA crypto buffers are allocated on a per-thread basis, so we can do this. */
+    /* The current thread takes care of everything on its own if there's a single job, or if no worker threads could be created. */
+    if (queue.job_count > 1)
+    {
+        for(u32 i = 0; i < MIN(queue.job_count, TITLE_CONTROL_NCA_THREAD_COUNT); i++)
+        {
+            if (!utilsCreateThread(&(threads[thread_count]), titleControlNcaWorkerThreadFunc, &queue, (int)i)) break;
+            thread_count++;
+        }
+    }
+
+    if (!thread_count) titleControlNcaWorkerThreadFunc(&queue);
+
+    for(u32 i = 0; i < thread_count; i++) utilsJoinThread(&(threads[i]));
+
+    /* Get retrieved application metadata count. */
+    for(u32 i = 0; i < queue.job_count; i++)
+    {
+        if (queue.jobs[i].app_metadata) app_count++;
+    }
+
+    if (app_count)
+    {
+        /* Reallocate application metadata pointer array. */
+        if (titleReallocateApplicationMetadata(app_count, false, false))
+        {
+            /* Set application metadata entry pointers. */
+            for(u32 i = 0; i < queue.job_count; i++)
+            {
+                TitleControlNcaJob *job = &(queue.jobs[i]);
+                if (!job->app_metadata) continue;
+
+                g_userMetadata[g_userMetadataCount++] = job->title_info->app_metadata = job->app_metadata;
+                job->app_metadata = NULL;
+            }
+
+            /* Sort application metadata entries by name. */
+            titleSortApplicationMetadata(false);
+        } else {
+            LOG_MSG_ERROR("Failed to reallocate application metadata pointer array for %u Control NCA entries!", app_count);
+        }
+    }
+
+    /* Update the rest of the titles. Control NCAs from titles we still have no metadata for are parsed right here, one at a time. */
+    for(u32 i = 0; i < title_count; i++)
+    {
+        TitleInfo *title_info = titles[i];
+        if (!title_info || title_info->app_metadata) continue;
+
+        title_info->app_metadata = titleFindApplicationMetadataByTitleId(titleGetApplicationIdByContentMetaKey(&(title_info->meta_key)), false, 0);
+
+        if (!title_info->app_metadata && (title_info->meta_key.type == NcmContentMetaType_Application || title_info->meta_key.type == NcmContentMetaType_Patch))
+        {
+            titleInitializeTitleInfoApplicationMetadataFromControlNca(title_info);
+        }
+    }
+
+end:
+    if (queue.jobs)
+    {
+        /* Free application metadata entries we couldn't store. */
+        for(u32 i = 0; i < queue.job_count; i++)
+        {
+            TitleApplicationMetadata *app_metadata = queue.jobs[i].app_metadata;
+            if (!app_metadata) continue;
+
+            if (app_metadata->icon) free(app_metadata->icon);
+            free(app_metadata);
+        }
+
+        free(queue.jobs);
+    }
+}
+
+static void titleControlNcaWorkerThreadFunc(void *arg)
+{
+    TitleControlNcaJobQueue *queue = (TitleControlNcaJobQueue*)arg;
+    CANCEL_TOKEN_SCOPE(queue->cancel_token);
+    NsApplicationControlData *control_data = NULL;
+
+    /* Allocate memory for our own control data buffer. The global one can't be shared. */
+    control_data = malloc(sizeof(NsApplicationControlData));
+    if (!control_data)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the application control data buffer!");
+        return;
+    }
+
+    while(true)
+    {
+        TitleControlNcaJob *job = NULL;
+        u64 control_data_size = 0;
+
+        /* Get the next job. Stop right away if the scan has been cancelled. */
+        SCOPED_LOCK(&(queue->mutex))
+        {
+            if (queue->next_job_idx < queue->job_count && !cancelTokenIsCancelled(queue->cancel_token)) job = &(queue->jobs[queue->next_job_idx++]);
+        }
+
+        if (!job) break;
+
+        /* Retrieve application control data from Control NCA, then initialize an application metadata entry with it. */
+        if (!titleGetApplicationControlDataFromControlNca(job->title_info, control_data, &control_data_size))
+        {
+            LOG_MSG_ERROR("Failed to retrieve application control data for %016lX!", job->title_info->meta_key.id);
+            continue;
+        }
+
+        job->app_metadata = titleInitializeUserMetadataEntryFromControlData(titleGetApplicationIdByContentMetaKey(&(job->title_info->meta_key)), control_data, control_data_size);
+        if (!job->app_metadata) LOG_MSG_ERROR("Failed to generate application metadata entry for %016lX!", job->title_info->meta_key.id);
+    }
+
+    free(control_data);
+}
+
 static bool titleGetMetaKeysFromContentDatabase(NcmContentMetaDatabase *ncm_db, NcmContentMetaKey **out_meta_keys, u32 *out_meta_key_count)
 {
     if (!ncm_db || !serviceIsActive(&(ncm_db->s)) || !out_meta_keys || !out_meta_key_count)
@@ -2659,13 +3980,12 @@ static bool titleGetMetaKeysFromContentDatabase(NcmContentMetaDatabase *ncm_db,
     }
 
     Result rc = 0;
-    u32 written = 0, total = 0;
+    u32 written = 0, total = 0, capacity = TITLE_META_KEY_PAGE_COUNT;
     NcmContentMetaKey *meta_keys = NULL, *meta_keys_tmp = NULL;
-    size_t meta_keys_size = sizeof(NcmContentMetaKey);
     bool success = false;
 
-    /* Allocate memory for the ncm application content meta keys. */
-    meta_keys = calloc(1, meta_keys_size);
+    /* Allocate memory for the first page of ncm application content meta keys. */
+    meta_keys = calloc(capacity, sizeof(NcmContentMetaKey));
     if (!meta_keys)
     {
         LOG_MSG_ERROR("Unable to allocate memory for the ncm application meta keys!");
@@ -2674,10 +3994,11 @@ static bool titleGetMetaKeysFromContentDatabase(NcmContentMetaDatabase *ncm_db,
 
     /* Get a full list of all titles available in this storage. */
     /* Meta type '0' means all title types will be retrieved. */
-    rc = ncmContentMetaDatabaseList(ncm_db, (s32*)&total, (s32*)&written, meta_keys, 1, 0, 0, 0, UINT64_MAX, NcmContentInstallType_Full);
+    /* A whole page is requested right away, which means a single call is enough for most storages. */
+    rc = ncmContentMetaDatabaseList(ncm_db, (s32*)&total, (s32*)&written, meta_keys, (s32)capacity, 0, 0, 0, UINT64_MAX, NcmContentInstallType_Full);
     if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("ncmContentMetaDatabaseList failed! (0x%X) (first entry).", rc);
+        LOG_MSG_ERROR("ncmContentMetaDatabaseList failed! (0x%X) (first page).", rc);
         goto end;
     }
 
@@ -2693,11 +4014,8 @@ static bool titleGetMetaKeysFromContentDatabase(NcmContentMetaDatabase *ncm_db,
     /* Check if we need to resize our application meta keys buffer. */
     if (total > written)
     {
-        /* Update application meta keys buffer size. */
-        meta_keys_size *= total;
-
         /* Reallocate application meta keys buffer. */
-        meta_keys_tmp = realloc(meta_keys, meta_keys_size);
+        meta_keys_tmp = realloc(meta_keys, total * sizeof(NcmContentMetaKey));
         if (!meta_keys_tmp)
         {
             LOG_MSG_ERROR("Unable to reallocate application meta keys buffer! (%u entries).", total);
@@ -2714,13 +4032,21 @@ static bool titleGetMetaKeysFromContentDatabase(NcmContentMetaDatabase *ncm_db,
             LOG_MSG_ERROR("ncmContentMetaDatabaseList failed! (0x%X) (%u %s).", rc, total, total > 1 ? "entries" : "entry");
             goto end;
         }
+    }
 
-        /* Safety check. */
-        if (written != total)
-        {
-            LOG_MSG_ERROR("Application meta key count mismatch! (%u != %u).", written, total);
-            goto end;
-        }
+    /* Safety check. */
+    if (written != total)
+    {
+        LOG_MSG_ERROR("Application meta key count mismatch! (%u != %u).", written, total);
+        goto end;
+    }
+
+    /* Free unused meta key entries from the first page. */
+    if (total < capacity)
+    {
+        meta_keys_tmp = realloc(meta_keys, total * sizeof(NcmContentMetaKey));
+        if (meta_keys_tmp) meta_keys = meta_keys_tmp;
+        meta_keys_tmp = NULL;
     }
 
     /* Update output. */
@@ -2735,9 +4061,10 @@ end:
     return success;
 }
 
-static bool titleGetContentInfosByMetaKey(NcmContentMetaDatabase *ncm_db, const NcmContentMetaKey *meta_key, NcmContentInfo **out_content_infos, u32 *out_content_count)
+static bool titleGetContentInfosByMetaKey(NcmContentMetaDatabase *ncm_db, const NcmContentMetaKey *meta_key, NcmContentInfo **scratch_buf, u32 *scratch_buf_count, \
+                                          NcmContentInfo **out_content_infos, u32 *out_content_count)
 {
-    if (!ncm_db || !serviceIsActive(&(ncm_db->s)) || !meta_key || !out_content_infos || !out_content_count)
+    if (!ncm_db || !serviceIsActive(&(ncm_db->s)) || !meta_key || !scratch_buf || !scratch_buf_count || !out_content_infos || !out_content_count)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -2745,57 +4072,64 @@ static bool titleGetContentInfosByMetaKey(NcmContentMetaDatabase *ncm_db, const
 
     Result rc = 0;
 
-    NcmContentMetaHeader content_meta_header = {0};
-    u64 content_meta_header_read_size = 0;
-
-    NcmContentInfo *content_infos = NULL;
+    NcmContentInfo *content_infos = NULL, *buf_tmp = NULL;
     u32 content_count = 0, written = 0;
 
     bool success = false;
 
-    /* Retrieve content meta header. */
-    rc = ncmContentMetaDatabaseGet(ncm_db, meta_key, &content_meta_header_read_size, &content_meta_header, sizeof(NcmContentMetaHeader));
-    if (R_FAILED(rc))
+    /* Allocate the scratch buffer, if needed. It's kept around by the caller, so it only grows a few times per storage. */
+    if (!*scratch_buf)
     {
-        LOG_MSG_ERROR("ncmContentMetaDatabaseGet failed! (0x%X).", rc);
-        goto end;
+        if (!(*scratch_buf = calloc(TITLE_CONTENT_INFO_PAGE_COUNT, sizeof(NcmContentInfo))))
+        {
+            LOG_MSG_ERROR("Unable to allocate memory for the content info scratch buffer!");
+            goto end;
+        }
+
+        *scratch_buf_count = TITLE_CONTENT_INFO_PAGE_COUNT;
     }
 
-    if (content_meta_header_read_size != sizeof(NcmContentMetaHeader))
-    {
-        LOG_MSG_ERROR("Content meta header size mismatch! (0x%lX != 0x%lX).", content_meta_header_read_size, sizeof(NcmContentMetaHeader));
-        goto end;
+    /* Retrieve content infos straight into the scratch buffer, without querying the content meta header first. */
+    /* A completely filled buffer means there may be more content infos, so we'll grow the buffer and keep reading from where we left off. */
+    while(true)
+    {
+        rc = ncmContentMetaDatabaseListContentInfo(ncm_db, (s32*)&written, *scratch_buf + content_count, (s32)(*scratch_buf_count - content_count), meta_key, (s32)content_count);
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_ERROR("ncmContentMetaDatabaseListContentInfo failed! (0x%X).", rc);
+            goto end;
+        }
+
+        content_count += written;
+        if (content_count < *scratch_buf_count) break;
+
+        buf_tmp = realloc(*scratch_buf, (*scratch_buf_count * 2) * sizeof(NcmContentInfo));
+        if (!buf_tmp)
+        {
+            LOG_MSG_ERROR("Unable to reallocate content info scratch buffer! (%u entries).", *scratch_buf_count * 2);
+            goto end;
+        }
+
+        *scratch_buf = buf_tmp;
+        *scratch_buf_count *= 2;
+        buf_tmp = NULL;
     }
 
-    /* Get content count. */
-    content_count = (u32)content_meta_header.content_count;
     if (!content_count)
     {
         LOG_MSG_ERROR("Content count is zero!");
         goto end;
     }
 
-    /* Allocate memory for the content infos. */
-    content_infos = calloc(content_count, sizeof(NcmContentInfo));
+    /* Allocate memory for the content infos. This buffer is owned by the TitleInfo entry generated from it. */
+    content_infos = malloc(content_count * sizeof(NcmContentInfo));
     if (!content_infos)
     {
         LOG_MSG_ERROR("Unable to allocate memory for the content infos buffer! (%u content[s]).", content_count);
         goto end;
     }
 
-    /* Retrieve content infos. */
-    rc = ncmContentMetaDatabaseListContentInfo(ncm_db, (s32*)&written, content_infos, (s32)content_count, meta_key, 0);
-    if (R_FAILED(rc))
-    {
-        LOG_MSG_ERROR("ncmContentMetaDatabaseListContentInfo failed! (0x%X).", rc);
-        goto end;
-    }
-
-    if (written != content_count)
-    {
-        LOG_MSG_ERROR("Content count mismatch! (%u != %u).", written, content_count);
-        goto end;
-    }
+    memcpy(content_infos, *scratch_buf, content_count * sizeof(NcmContentInfo));
 
     /* Update output. */
     *out_content_infos = content_infos;
@@ -2804,8 +4138,6 @@ static bool titleGetContentInfosByMetaKey(NcmContentMetaDatabase *ncm_db, const
     success = true;
 
 end:
-    if (!success && content_infos) free(content_infos);
-
     return success;
 }
 
@@ -2819,10 +4151,16 @@ static bool titleGetGameCardContentMetaContexts(HashFileSystemContext *hfs_ctx,
         return false;
     }
 
-    TitleGameCardContentMetaContext *gc_meta_ctxs = NULL, *gc_meta_ctxs_tmp = NULL;
-    u32 gc_meta_ctx_count = 0;
+    TitleGameCardContentMetaContext *gc_meta_ctxs = NULL;
+    u32 *meta_nca_indices = NULL, meta_nca_count = 0;
+    bool staged = false, success = false;
 
-    bool success = false;
+    /* Allocate memory for the Meta NCA index array. */
+    if (!(meta_nca_indices = malloc(hfs_entry_count * sizeof(u32))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for Meta NCA index array! (%s partition).", hfsGetPartitionNameString(hfs_ctx->type));
+        goto end;
+    }
 
     /* Loop through all Hash FS file entries. */
     for(u32 i = 0; i < hfs_entry_count; i++)
@@ -2846,37 +4184,49 @@ static bool titleGetGameCardContentMetaContexts(HashFileSystemContext *hfs_ctx,
             continue;
         }
 
-        /* Reallocate contexts buffer. */
-        gc_meta_ctxs_tmp = realloc(gc_meta_ctxs, (gc_meta_ctx_count + 1) * sizeof(TitleGameCardContentMetaContext));
-        if (!gc_meta_ctxs_tmp)
-        {
-            LOG_MSG_ERROR("Unable to reallocate gamecard Content Meta contexts buffer! (%u entries, index %u, %s partition).", \
-                          gc_meta_ctx_count + 1, i, hfsGetPartitionNameString(hfs_ctx->type));
-            goto end;
-        }
+        meta_nca_indices[meta_nca_count++] = i;
+    }
+
+    if (!meta_nca_count)
+    {
+        LOG_MSG_INFO("No Meta NCAs available in gamecard %s partition.", hfsGetPartitionNameString(hfs_ctx->type));
+        *out_gc_meta_ctx_count = 0;
+        success = true;
+        goto end;
+    }
+
+    /* Allocate memory for the gamecard Content Meta contexts. */
+    if (!(gc_meta_ctxs = calloc(meta_nca_count, sizeof(TitleGameCardContentMetaContext))))
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for gamecard Content Meta contexts! (%u entries, %s partition).", meta_nca_count, hfsGetPartitionNameString(hfs_ctx->type));
+        goto end;
+    }
 
-        gc_meta_ctxs = gc_meta_ctxs_tmp;
+    /* Read all Meta NCAs in a single coalesced pass. This isn't a fatal error: regular gamecard reads are used if it fails. */
+    staged = titleStageGameCardHashFileSystemEntries(hfs_ctx, meta_nca_indices, meta_nca_count);
 
-        /* Clear current context and increase counter. */
-        gc_meta_ctxs_tmp = &(gc_meta_ctxs[gc_meta_ctx_count++]);
-        memset(gc_meta_ctxs_tmp, 0, sizeof(TitleGameCardContentMetaContext));
+    for(u32 i = 0; i < meta_nca_count; i++)
+    {
+        u32 hfs_entry_idx = meta_nca_indices[i];
+        HashFileSystemEntry *hfs_entry = hfsGetEntryByIndex(hfs_ctx, hfs_entry_idx);
+        char *hfs_entry_name = hfsGetEntryName(hfs_ctx, hfs_entry);
 
         /* Get pointers for NCA and Content Meta contexts. */
-        NcaContext *nca_ctx = &(gc_meta_ctxs_tmp->nca_ctx);
-        ContentMetaContext *cnmt_ctx = &(gc_meta_ctxs_tmp->cnmt_ctx);
-        NcmContentMetaKey *meta_key = &(gc_meta_ctxs_tmp->meta_key);
+        NcaContext *nca_ctx = &(gc_meta_ctxs[i].nca_ctx);
+        ContentMetaContext *cnmt_ctx = &(gc_meta_ctxs[i].cnmt_ctx);
+        NcmContentMetaKey *meta_key = &(gc_meta_ctxs[i].meta_key);
 
         /* Initialize NCA context. */
         if (!ncaInitializeContextByHashFileSystemEntry(nca_ctx, hfs_ctx, hfs_entry, NULL))
         {
-            LOG_MSG_ERROR("Failed to initialize NCA context for \"%s\" (index %u, %s partition).", hfs_entry_name, i, hfsGetPartitionNameString(hfs_ctx->type));
+            LOG_MSG_ERROR("Failed to initialize NCA context for \"%s\" (index %u, %s partition).", hfs_entry_name, hfs_entry_idx, hfsGetPartitionNameString(hfs_ctx->type));
             goto end;
         }
 
         /* Initialize Content Meta context. */
         if (!cnmtInitializeContext(cnmt_ctx, nca_ctx))
         {
-            LOG_MSG_ERROR("Failed to initialize Content Meta context for \"%s\" (index %u, %s partition).", hfs_entry_name, i, hfsGetPartitionNameString(hfs_ctx->type));
+            LOG_MSG_ERROR("Failed to initialize Content Meta context for \"%s\" (index %u, %s partition).", hfs_entry_name, hfs_entry_idx, hfsGetPartitionNameString(hfs_ctx->type));
             goto end;
         }
 
@@ -2887,25 +4237,55 @@ static bool titleGetGameCardContentMetaContexts(HashFileSystemContext *hfs_ctx,
         meta_key->install_type = cnmt_ctx->packaged_header->content_install_type;
     }
 
-    if (gc_meta_ctx_count)
-    {
-        /* Sort gamecard Content Meta contexts in descendent order. */
-        /* This is done to make sure control data from patches is processed first. */
-        if (gc_meta_ctx_count > 1) qsort(gc_meta_ctxs, gc_meta_ctx_count, sizeof(TitleGameCardContentMetaContext), &titleGameCardContentMetaContextSortFunction);
+    /* Sort gamecard Content Meta contexts in descendent order. */
+    /* This is done to make sure control data from patches is processed first. */
+    if (meta_nca_count > 1) qsort(gc_meta_ctxs, meta_nca_count, sizeof(TitleGameCardContentMetaContext), &titleGameCardContentMetaContextSortFunction);
 
-        /* Update output. */
-        *out_gc_meta_ctxs = gc_meta_ctxs;
-        *out_gc_meta_ctx_count = gc_meta_ctx_count;
-    } else {
-        LOG_MSG_INFO("No Meta NCAs available in gamecard %s partition.", hfsGetPartitionNameString(hfs_ctx->type));
-        *out_gc_meta_ctx_count = 0;
-    }
+    /* Update output. */
+    *out_gc_meta_ctxs = gc_meta_ctxs;
+    *out_gc_meta_ctx_count = meta_nca_count;
 
     /* Update flag. */
     success = true;
 
 end:
-    if (!success && gc_meta_ctxs) titleFreeGameCardContentMetaContexts(&gc_meta_ctxs, gc_meta_ctx_count);
+    if (staged) gamecardReleaseStagedStorage();
+
+    if (!success && gc_meta_ctxs) titleFreeGameCardContentMetaContexts(&gc_meta_ctxs, meta_nca_count);
+
+    if (meta_nca_indices) free(meta_nca_indices);
+
+    return success;
+}
+
+static bool titleStageGameCardHashFileSystemEntries(HashFileSystemContext *hfs_ctx, const u32 *entry_indices, u32 entry_index_count)
+{
+    HashFileSystemReadPlan read_plan = {0};
+    GameCardStorageRegion *regions = NULL;
+    bool success = false;
+
+    /* Generate a read plan that only covers the provided entries. */
+    if (!hfsGenerateReadPlanForEntries(hfs_ctx, entry_indices, entry_index_count, &read_plan) || !read_plan.run_count) goto end;
+
+    if (!(regions = calloc(read_plan.run_count, sizeof(GameCardStorageRegion))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for gamecard storage regions! (%s partition).", hfsGetPartitionNameString(hfs_ctx->type));
+        goto end;
+    }
+
+    /* Read plan runs are relative to the start of the Hash FS partition. */
+    for(u32 i = 0; i < read_plan.run_count; i++)
+    {
+        regions[i].offset = (hfs_ctx->offset + read_plan.runs[i].offset);
+        regions[i].size = read_plan.runs[i].size;
+    }
+
+    success = gamecardStageStorage(regions, read_plan.run_count);
+
+end:
+    if (regions) free(regions);
+
+    hfsFreeReadPlan(&read_plan);
 
     return success;
 }
@@ -2921,6 +4301,83 @@ static void titleFreeGameCardContentMetaContexts(TitleGameCardContentMetaContext
     *gc_meta_ctxs = NULL;
 }
 
+static TitleInfo *_titleGetGameCardUpdateTitleInfoList(void)
+{
+    HashFileSystemContext hfs_ctx = {0};
+    TitleGameCardContentMetaContext *gc_meta_ctxs = NULL;
+    u32 gc_meta_ctx_count = 0, title_count = 0;
+    TitleInfo **titles = NULL, *out = NULL;
+
+    /* Get gamecard update partition Hash FS context. */
+    if (!gamecardGetHashFileSystemContext(HashFileSystemPartitionType_Update, &hfs_ctx))
+    {
+        LOG_MSG_ERROR("Failed to get gamecard update partition Hash FS context!");
+        goto end;
+    }
+
+    /* Parse all Meta NCAs from the update partition in a single pass. */
+    if (!titleGetGameCardContentMetaContexts(&hfs_ctx, &gc_meta_ctxs, &gc_meta_ctx_count) || !gc_meta_ctx_count) goto end;
+
+    /* Allocate memory for the temporary TitleInfo pointer array. */
+    if (!(titles = calloc(gc_meta_ctx_count, sizeof(TitleInfo*))))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for gamecard update TitleInfo pointer array!");
+        goto end;
+    }
+
+    for(u32 i = 0; i < gc_meta_ctx_count; i++)
+    {
+        TitleGameCardContentMetaContext *cur_gc_meta_ctx = &(gc_meta_ctxs[i]);
+        NcmContentInfo *content_infos = NULL;
+        u32 content_count = 0;
+
+        /* Generate content infos. */
+        if (!titleGetContentInfosByGameCardContentMetaContext(cur_gc_meta_ctx, &hfs_ctx, &content_infos, &content_count))
+        {
+            LOG_MSG_ERROR("Failed to generate content infos for %016lX!", cur_gc_meta_ctx->meta_key.id);
+            goto end;
+        }
+
+        /* Generate TitleInfo entry. */
+        if (!(titles[title_count] = titleGenerateTitleInfoEntry(NcmStorageId_GameCard, &(cur_gc_meta_ctx->meta_key), content_infos, content_count)))
+        {
+            LOG_MSG_ERROR("Failed to generate TitleInfo entry for %016lX!", cur_gc_meta_ctx->meta_key.id);
+            free(content_infos);
+            goto end;
+        }
+
+        /* Update titles are system titles, so we'll use system metadata entries. */
+        /* If no application metadata entry is found, titleGetSystemMetadataEntry() will take care of generating a dummy one. */
+        titles[title_count++]->app_metadata = titleGetSystemMetadataEntry(cur_gc_meta_ctx->meta_key.id);
+    }
+
+    /* Sort TitleInfo entries by title ID. */
+    if (title_count > 1) titleSortPointerArray((void**)titles, title_count, TitleSortKeyType_TitleInfo);
+
+    /* Create a linked list snapshot using all our TitleInfo entries. */
+    /* Keep in mind their contents can only be accessed through HashFileSystemPartitionType_Update. */
+    out = titleCreateTitleInfoSnapshot(titles, title_count, 0);
+    if (!out) LOG_MSG_ERROR("Failed to create gamecard update TitleInfo snapshot!");
+
+end:
+    if (titles)
+    {
+        for(u32 i = 0; i < title_count; i++)
+        {
+            if (titles[i]->content_infos) free(titles[i]->content_infos);
+            free(titles[i]);
+        }
+
+        free(titles);
+    }
+
+    titleFreeGameCardContentMetaContexts(&gc_meta_ctxs, gc_meta_ctx_count);
+
+    hfsFreeContext(&hfs_ctx);
+
+    return out;
+}
+
 static bool titleGetContentInfosByGameCardContentMetaContext(TitleGameCardContentMetaContext *gc_meta_ctx, HashFileSystemContext *hfs_ctx, NcmContentInfo **out_content_infos, u32 *out_content_count)
 {
     if (!gc_meta_ctx || !cnmtIsValidContext(&(gc_meta_ctx->cnmt_ctx)) || !hfsIsValidContext(hfs_ctx) || !gc_meta_ctx->cnmt_ctx.packaged_header->content_count || !out_content_infos || !out_content_count)
@@ -2948,131 +4405,361 @@ static bool titleGetContentInfosByGameCardContentMetaContext(TitleGameCardConten
     meta_content_info->content_type = NcmContentType_Meta;
     meta_content_info->id_offset = 0;
 
-    //LOG_DATA_DEBUG(meta_content_info, sizeof(NcmContentInfo), "Forged Meta content record:");
+    //LOG_DATA_DEBUG(meta_content_info, sizeof(NcmContentInfo), "Forged Meta content record:");
+
+    /* Loop through our NcmPackagedContentInfo entries. */
+    for(u32 i = 0; i < (content_count - 1); i++)
+    {
+        char nca_filename[0x30] = {0};
+        NcmContentInfo *cur_content_info = &(gc_meta_ctx->cnmt_ctx.packaged_content_info[i].info);
+
+        /* Make sure this content exists on the inserted gamecard. */
+        utilsGenerateHexString(nca_filename, sizeof(nca_filename), cur_content_info->content_id.c, sizeof(cur_content_info->content_id.c), false);
+        strcat(nca_filename, cur_content_info->content_type == NcmContentType_Meta ? ".cnmt.nca" : ".nca");
+
+        if (!hfsGetEntryByName(hfs_ctx, nca_filename))
+        {
+            LOG_MSG_DEBUG("Unable to locate %s NCA \"%s\" in Hash FS by name (%s partition).", titleGetNcmContentTypeName(cur_content_info->content_type), nca_filename, \
+                                                                                                hfsGetPartitionNameString(hfs_ctx->type));
+            continue;
+        }
+
+        /* Copy content info data and update available content count. */
+        memcpy(&(content_infos[available_count++]), cur_content_info, sizeof(NcmContentInfo));
+    }
+
+    if (available_count < content_count)
+    {
+        /* Reallocate output buffer, if needed. */
+        content_infos_tmp = realloc(content_infos, available_count * sizeof(NcmContentInfo));
+        if (content_infos_tmp) content_infos = content_infos_tmp;
+        content_infos_tmp = NULL;
+    }
+
+    /* Update output. */
+    *out_content_infos = content_infos;
+    *out_content_count = available_count;
+
+    return true;
+}
+
+static void titleUpdateTitleInfoLinkedLists(void)
+{
+    TitleIdIndex tails[TITLE_LINKED_LIST_COUNT] = {0};
+
+    /* Snapshots hold copies of the current linked lists. */
+    titleUpdateTitleInfoGeneration();
+
+    /* Free orphan title info entries. */
+    titleFreeOrphanTitleInfoEntries();
+
+    /* Loop through all available title storages. */
+    for(u8 i = NcmStorageId_GameCard; i <= NcmStorageId_SdCard; i++)
+    {
+        /* Don't process system titles. */
+        if (i == NcmStorageId_BuiltInSystem) continue;
+
+        TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(i)]);
+        TitleInfo **titles = title_storage->titles;
+        u32 title_count = title_storage->title_count;
+
+        /* Don't proceed if the current storage holds no titles. */
+        if (!titles || !title_count) continue;
+
+        /* Process titles from the current storage. */
+        for(u32 j = 0; j < title_count; j++)
+        {
+            TitleInfo *child_info = titles[j];
+            if (!child_info || !titlePrepareTitleInfoEntryForLinkedLists(child_info)) continue;
+
+            /* Locate previous entry. */
+            titleLinkPreviousTitleInfoEntry(child_info, tails, true);
+        }
+    }
+
+    titleFreeLinkedListTails(tails);
+}
+
+static void titleUpdateGameCardTitleInfoLinkedLists(void)
+{
+    TitleStorage *gc_title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(NcmStorageId_GameCard)]);
+    TitleInfo **gc_titles = gc_title_storage->titles;
+    u32 gc_title_count = gc_title_storage->title_count;
+    TitleIdIndex tails[TITLE_LINKED_LIST_COUNT] = {0};
+
+    /* Orphan titles from other storages that depend on a gamecard user application need a full update, since they may start new linked lists at any position. */
+    /* This barely ever happens, though. */
+    for(u32 i = 0; i < g_orphanTitleInfoCount; i++)
+    {
+        TitleInfo *orphan_info = g_orphanTitleInfo[i];
+        u8 orphan_type = orphan_info->meta_key.type;
+
+        if (orphan_info->storage_id == NcmStorageId_GameCard || orphan_info->app_metadata || (orphan_type != NcmContentMetaType_Patch && orphan_type != NcmContentMetaType_AddOnContent && \
+            orphan_type != NcmContentMetaType_DataPatch)) continue;
+
+        u64 app_id = titleGetApplicationIdByContentMetaKey(&(orphan_info->meta_key));
+        bool found = false;
+
+        if (gc_title_storage->title_index.entries)
+        {
+            found = (titleGetTitleIdIndexEntry(&(gc_title_storage->title_index), app_id) != NULL);
+        } else {
+            for(u32 j = 0; j < gc_title_count && !found; j++) found = (gc_titles[j] && gc_titles[j]->meta_key.id == app_id);
+        }
+
+        if (found)
+        {
+            titleUpdateTitleInfoLinkedLists();
+            return;
+        }
+    }
+
+    /* Start from scratch. */
+    titleUnlinkGameCardTitleInfoEntries();
+
+    /* Snapshots hold copies of the current linked lists. */
+    titleUpdateTitleInfoGeneration();
+
+    if (!gc_titles || !gc_title_count) return;
+
+    /* Process gamecard titles. These are always placed at the start of each linked list. */
+    for(u32 i = 0; i < gc_title_count; i++)
+    {
+        TitleInfo *child_info = gc_titles[i];
+        if (!child_info || !titlePrepareTitleInfoEntryForLinkedLists(child_info)) continue;
+
+        /* Locate previous gamecard entry. */
+        titleLinkPreviousTitleInfoEntry(child_info, tails, true);
+    }
+
+    /* Attach the first entry from each linked list in the rest of the title storages to the last matching gamecard entry, if there's any. */
+    for(u8 i = NcmStorageId_BuiltInUser; i <= NcmStorageId_SdCard; i++)
+    {
+        TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(i)]);
+        TitleInfo **titles = title_storage->titles;
+        u32 title_count = title_storage->title_count;
+
+        /* Don't proceed if the current storage holds no titles. */
+        if (!titles || !title_count) continue;
+
+        for(u32 j = 0; j < title_count; j++)
+        {
+            TitleInfo *child_info = titles[j];
+            if (!child_info || child_info->previous || titleIsOrphanTitleInfoEntry(child_info)) continue;
+
+            /* Gamecard tails are left untouched. There's only a single linked list head per linked list ID in the rest of the title storages. */
+            titleLinkPreviousTitleInfoEntry(child_info, tails, false);
+        }
+    }
+
+    titleFreeLinkedListTails(tails);
+}
+
+static void titleUnlinkGameCardTitleInfoEntries(void)
+{
+    TitleStorage *gc_title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(NcmStorageId_GameCard)]);
+    u32 orphan_count = 0;
+
+    /* Remove gamecard titles from the orphan title info list. This keeps it sorted. */
+    for(u32 i = 0; i < g_orphanTitleInfoCount; i++)
+    {
+        if (g_orphanTitleInfo[i]->storage_id != NcmStorageId_GameCard) g_orphanTitleInfo[orphan_count++] = g_orphanTitleInfo[i];
+    }
+
+    if (orphan_count)
+    {
+        g_orphanTitleInfoCount = orphan_count;
+    } else {
+        titleFreeOrphanTitleInfoEntries();
+    }
+
+    if (!gc_title_storage->titles || !gc_title_storage->title_count) return;
+
+    /* Detach gamecard titles from all linked lists. */
+    for(u32 i = 0; i < gc_title_storage->title_count; i++)
+    {
+        TitleInfo *title_info = gc_title_storage->titles[i];
+        if (!title_info) continue;
+
+        if (title_info->next && title_info->next->storage_id != NcmStorageId_GameCard) title_info->next->previous = NULL;
+        title_info->previous = title_info->next = NULL;
+    }
+}
+
+static bool titlePrepareTitleInfoEntryForLinkedLists(TitleInfo *child_info)
+{
+    /* Reset linked list pointers. */
+    child_info->previous = child_info->next = NULL;
+
+    /* If we're dealing with a title that's not an user application, patch, add-on content or add-on content patch, flag it as orphan. */
+    if (child_info->meta_key.type < NcmContentMetaType_Application || (child_info->meta_key.type > NcmContentMetaType_AddOnContent && \
+        child_info->meta_key.type != NcmContentMetaType_DataPatch))
+    {
+        titleAddOrphanTitleInfoEntry(child_info);
+        return false;
+    }
+
+    if (child_info->meta_key.type != NcmContentMetaType_Application && !child_info->app_metadata)
+    {
+        /* We're dealing with a patch, an add-on content or an add-on content patch. */
+        /* We'll just retrieve a pointer to the first matching user application entry and use it to set a pointer to an application metadata entry. */
+        u64 app_id = titleGetApplicationIdByContentMetaKey(&(child_info->meta_key));
+        TitleInfo *parent = _titleGetTitleInfoEntryFromStorageByTitleId(NcmStorageId_Any, app_id);
+        if (parent)
+        {
+            /* Set pointer to application metadata. */
+            child_info->app_metadata = parent->app_metadata;
+        } else {
+            /* Add orphan title info entry since we have no application metadata. */
+            titleAddOrphanTitleInfoEntry(child_info);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void titleLinkPreviousTitleInfoEntry(TitleInfo *child_info, TitleIdIndex *tails, bool update_tail)
+{
+    /* Locate previous user application, patch, add-on content or add-on content patch entry. */
+    /* Titles must be processed in linked list order: 'tails' holds the last processed title from each linked list, using a separate index per content meta type. */
+    /* If it's found, we will update both its next pointer and the previous pointer from the current entry. */
+    u64 list_id = titleGetLinkedListIdByContentMetaKey(&(child_info->meta_key));
+    if (!list_id) return;
+
+    TitleIdIndex *tail_index = &(tails[TITLE_LINKED_LIST_INDEX(child_info->meta_key.type)]);
+
+    TitleInfo *prev_info = (TitleInfo*)titleGetTitleIdIndexEntry(tail_index, list_id);
+    if (prev_info)
+    {
+        prev_info->next = child_info;
+        child_info->previous = prev_info;
+    }
+
+    /* Update linked list tail. */
+    if (update_tail && !titleInsertTitleIdIndexEntry(tail_index, list_id, child_info, true)) LOG_MSG_ERROR("Failed to update linked list tail for %016lX!", child_info->meta_key.id);
+}
 
-    /* Loop through our NcmPackagedContentInfo entries. */
-    for(u32 i = 0; i < (content_count - 1); i++)
+static bool titleIsOrphanTitleInfoEntry(TitleInfo *title_info)
+{
+    for(u32 i = 0; i < g_orphanTitleInfoCount; i++)
     {
-        char nca_filename[0x30] = {0};
-        NcmContentInfo *cur_content_info = &(gc_meta_ctx->cnmt_ctx.packaged_content_info[i].info);
+        if (g_orphanTitleInfo[i] == title_info) return true;
+    }
 
-        /* Make sure this content exists on the inserted gamecard. */
-        utilsGenerateHexString(nca_filename, sizeof(nca_filename), cur_content_info->content_id.c, sizeof(cur_content_info->content_id.c), false);
-        strcat(nca_filename, cur_content_info->content_type == NcmContentType_Meta ? ".cnmt.nca" : ".nca");
+    return false;
+}
 
-        if (!hfsGetEntryByName(hfs_ctx, nca_filename))
-        {
-            LOG_MSG_DEBUG("Unable to locate %s NCA \"%s\" in Hash FS by name (%s partition).", titleGetNcmContentTypeName(cur_content_info->content_type), nca_filename, \
-                                                                                                hfsGetPartitionNameString(hfs_ctx->type));
-            continue;
-        }
+static void titleFreeLinkedListTails(TitleIdIndex *tails)
+{
+    for(u8 i = 0; i < TITLE_LINKED_LIST_COUNT; i++) titleFreeTitleIdIndex(&(tails[i]));
+}
 
-        /* Copy content info data and update available content count. */
-        memcpy(&(content_infos[available_count++]), cur_content_info, sizeof(NcmContentInfo));
+NX_INLINE u64 titleGetLinkedListIdByContentMetaKey(const NcmContentMetaKey *meta_key)
+{
+    u64 app_id = 0;
+
+    /* Returns an ID shared by all the titles from the same linked list, or zero if the title can't be linked to any other title. */
+    switch(meta_key->type)
+    {
+        case NcmContentMetaType_Application:
+        case NcmContentMetaType_Patch:
+            return meta_key->id;
+        case NcmContentMetaType_AddOnContent:
+            app_id = titleGetApplicationIdByAddOnContentId(meta_key->id);
+            return (titleCheckIfAddOnContentIdBelongsToApplicationId(app_id, meta_key->id) ? app_id : 0);
+        case NcmContentMetaType_DataPatch:
+            app_id = titleGetApplicationIdByDataPatchId(meta_key->id);
+            return (titleCheckIfDataPatchIdBelongsToApplicationId(app_id, meta_key->id) ? app_id : 0);
+        default:
+            break;
     }
 
-    if (available_count < content_count)
+    return 0;
+}
+
+static bool titleInsertTitleIdIndexEntry(TitleIdIndex *index, u64 title_id, void *value, bool replace)
+{
+    TitleIdIndexEntry *entry = NULL;
+    u32 slot = 0;
+
+    if (!value) return false;
+
+    /* Keep the load factor at or below 50%. */
+    if (((index->count + 1) * 2) > index->capacity && !titleResizeTitleIdIndex(index, index->capacity ? (index->capacity * 2) : TITLE_ID_INDEX_MIN_CAPACITY)) return false;
+
+    /* Look for the first free slot. Title IDs that have already been indexed are only updated if requested. */
+    for(slot = titleGetTitleIdIndexSlot(title_id, index->capacity); index->entries[slot].value; slot = ((slot + 1) & (index->capacity - 1)))
     {
-        /* Reallocate output buffer, if needed. */
-        content_infos_tmp = realloc(content_infos, available_count * sizeof(NcmContentInfo));
-        if (content_infos_tmp) content_infos = content_infos_tmp;
-        content_infos_tmp = NULL;
+        if (index->entries[slot].title_id != title_id) continue;
+        if (replace) index->entries[slot].value = value;
+        return true;
     }
 
-    /* Update output. */
-    *out_content_infos = content_infos;
-    *out_content_count = available_count;
+    entry = &(index->entries[slot]);
+    entry->title_id = title_id;
+    entry->value = value;
+
+    index->count++;
 
     return true;
 }
 
-static void titleUpdateTitleInfoLinkedLists(void)
+static bool titleResizeTitleIdIndex(TitleIdIndex *index, u32 capacity)
 {
-    /* Free orphan title info entries. */
-    titleFreeOrphanTitleInfoEntries();
+    TitleIdIndexEntry *entries = NULL, *old_entries = index->entries;
+    u32 old_capacity = index->capacity;
 
-    /* Loop through all available title storages. */
-    for(u8 i = NcmStorageId_GameCard; i <= NcmStorageId_SdCard; i++)
+    /* Allocate memory for the new table. */
+    if (!(entries = calloc(capacity, sizeof(TitleIdIndexEntry))))
     {
-        /* Don't process system titles. */
-        if (i == NcmStorageId_BuiltInSystem) continue;
-
-        TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(i)]);
-        TitleInfo **titles = title_storage->titles;
-        u32 title_count = title_storage->title_count;
+        LOG_MSG_ERROR("Unable to allocate memory for %u title ID index entries!", capacity);
+        return false;
+    }
 
-        /* Don't proceed if the current storage holds no titles. */
-        if (!titles || !title_count) continue;
+    index->entries = entries;
+    index->capacity = capacity;
+    index->count = 0;
 
-        /* Process titles from the current storage. */
-        for(u32 j = 0; j < title_count; j++)
-        {
-            /* Get pointer to the current title info and reset its linked list pointers. */
-            TitleInfo *child_info = titles[j];
-            if (!child_info) continue;
+    /* Rehash previous entries. */
+    for(u32 i = 0; i < old_capacity; i++)
+    {
+        if (!old_entries[i].value) continue;
 
-            child_info->previous = child_info->next = NULL;
+        u32 slot = titleGetTitleIdIndexSlot(old_entries[i].title_id, capacity);
+        while(entries[slot].value) slot = ((slot + 1) & (capacity - 1));
 
-            /* If we're dealing with a title that's not an user application, patch, add-on content or add-on content patch, flag it as orphan and proceed onto the next one. */
-            if (child_info->meta_key.type < NcmContentMetaType_Application || (child_info->meta_key.type > NcmContentMetaType_AddOnContent && \
-                child_info->meta_key.type != NcmContentMetaType_DataPatch))
-            {
-                titleAddOrphanTitleInfoEntry(child_info);
-                continue;
-            }
+        memcpy(&(entries[slot]), &(old_entries[i]), sizeof(TitleIdIndexEntry));
+        index->count++;
+    }
 
-            if (child_info->meta_key.type != NcmContentMetaType_Application && !child_info->app_metadata)
-            {
-                /* We're dealing with a patch, an add-on content or an add-on content patch. */
-                /* We'll just retrieve a pointer to the first matching user application entry and use it to set a pointer to an application metadata entry. */
-                u64 app_id = titleGetApplicationIdByContentMetaKey(&(child_info->meta_key));
-                TitleInfo *parent = _titleGetTitleInfoEntryFromStorageByTitleId(NcmStorageId_Any, app_id);
-                if (parent)
-                {
-                    /* Set pointer to application metadata. */
-                    child_info->app_metadata = parent->app_metadata;
-                } else {
-                    /* Add orphan title info entry since we have no application metadata. */
-                    titleAddOrphanTitleInfoEntry(child_info);
-                    continue;
-                }
-            }
+    if (old_entries) free(old_entries);
 
-            /* Locate previous user application, patch, add-on content or add-on content patch entry. */
-            /* If it's found, we will update both its next pointer and the previous pointer from the current entry. */
-            for(u8 k = i; k >= NcmStorageId_GameCard; k--)
-            {
-                /* Don't process system titles. And don't proceed if we're currently dealing with the first entry from a storage. */
-                if (k == NcmStorageId_BuiltInSystem || (k == i && j == 0)) continue;
+    return true;
+}
 
-                TitleStorage *prev_title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(k)]);
-                TitleInfo **prev_titles = prev_title_storage->titles;
-                u32 prev_title_count = prev_title_storage->title_count;
-                u32 start_idx = (k == i ? j : prev_title_count);
+static void *titleGetTitleIdIndexEntry(const TitleIdIndex *index, u64 title_id)
+{
+    if (!index->entries || !index->count) return NULL;
 
-                /* Don't proceed if the current storage holds no titles. */
-                if (!prev_titles || !prev_title_count) continue;
+    for(u32 slot = titleGetTitleIdIndexSlot(title_id, index->capacity); index->entries[slot].value; slot = ((slot + 1) & (index->capacity - 1)))
+    {
+        if (index->entries[slot].title_id == title_id) return index->entries[slot].value;
+    }
 
-                for(u32 l = start_idx; l > 0; l--)
-                {
-                    TitleInfo *prev_info = prev_titles[l - 1];
-                    if (!prev_info) continue;
+    return NULL;
+}
 
-                    if (prev_info->meta_key.type == child_info->meta_key.type && \
-                        (((child_info->meta_key.type == NcmContentMetaType_Application || child_info->meta_key.type == NcmContentMetaType_Patch) && prev_info->meta_key.id == child_info->meta_key.id) || \
-                        (child_info->meta_key.type == NcmContentMetaType_AddOnContent && titleCheckIfAddOnContentIdsAreSiblings(prev_info->meta_key.id, child_info->meta_key.id)) || \
-                        (child_info->meta_key.type == NcmContentMetaType_DataPatch && titleCheckIfDataPatchIdsAreSiblings(prev_info->meta_key.id, child_info->meta_key.id))))
-                    {
-                        prev_info->next = child_info;
-                        child_info->previous = prev_info;
-                        break;
-                    }
-                }
+static void titleFreeTitleIdIndex(TitleIdIndex *index)
+{
+    if (index->entries) free(index->entries);
+    memset(index, 0, sizeof(TitleIdIndex));
+}
 
-                if (child_info->previous) break;
-            }
-        }
-    }
+NX_INLINE u32 titleGetTitleIdIndexSlot(u64 title_id, u32 capacity)
+{
+    /* Title IDs from the same application only differ in their lower bits, so mix them all before picking a slot. */
+    return ((u32)((title_id * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1));
 }
 
 static TitleInfo *_titleGetTitleInfoEntryFromStorageByTitleId(u8 storage_id, u64 title_id)
@@ -3093,13 +4780,18 @@ static TitleInfo *_titleGetTitleInfoEntryFromStorageByTitleId(u8 storage_id, u64
         TitleStorage *title_storage = &(g_titleStorage[i]);
         if (!title_storage->titles || !*(title_storage->titles) || !title_storage->title_count) continue;
 
-        for(u32 j = 0; j < title_storage->title_count; j++)
+        if (title_storage->title_index.entries)
         {
-            TitleInfo *title_info = title_storage->titles[j];
-            if (title_info && title_info->meta_key.id == title_id)
+            out = (TitleInfo*)titleGetTitleIdIndexEntry(&(title_storage->title_index), title_id);
+        } else {
+            for(u32 j = 0; j < title_storage->title_count; j++)
             {
-                out = title_info;
-                break;
+                TitleInfo *title_info = title_storage->titles[j];
+                if (title_info && title_info->meta_key.id == title_id)
+                {
+                    out = title_info;
+                    break;
+                }
             }
         }
 
@@ -3165,7 +4857,7 @@ static bool _titleGetUserApplicationData(u64 app_id, TitleUserApplicationData *o
     return ret;
 }
 
-static TitleInfo *titleDuplicateTitleInfoFull(TitleInfo *title_info, TitleInfo *previous, TitleInfo *next)
+static TitleInfo *titleGetTitleInfoSnapshot(TitleInfo *title_info, bool use_cache)
 {
     if (!titleIsValidInfoBlock(title_info))
     {
@@ -3173,129 +4865,163 @@ static TitleInfo *titleDuplicateTitleInfoFull(TitleInfo *title_info, TitleInfo *
         return NULL;
     }
 
-    TitleInfo *title_info_dup = NULL, *tmp1 = NULL, *tmp2 = NULL;
-    bool dup_previous = false, dup_next = false, success = false;
+    TitleInfo **nodes = NULL, *snapshot = NULL, *cur = NULL;
+    TitleInfoSnapshotCacheEntry *cache_entry = NULL;
+    u32 prev_count = 0, node_count = 1, idx = 0;
 
-    /* Duplicate TitleInfo object. */
-    title_info_dup = titleDuplicateTitleInfo(title_info);
-    if (!title_info_dup)
+    /* Check if we already have a snapshot for this element. Cached snapshots always belong to the current generation. */
+    if (use_cache)
     {
-        LOG_MSG_ERROR("Failed to duplicate TitleInfo object!");
-        return NULL;
-    }
+        for(u32 i = 0; i < TITLE_INFO_SNAPSHOT_CACHE_SIZE; i++)
+        {
+            cache_entry = &(g_titleInfoSnapshotCache[i]);
+            if (cache_entry->source != title_info) continue;
 
-#define TITLE_DUPLICATE_LINKED_LIST(elem, prv, nxt) \
-    if (title_info->elem) { \
-        if (elem) { \
-            title_info_dup->elem = elem; \
-        } else { \
-            title_info_dup->elem = titleDuplicateTitleInfoFull(title_info->elem, prv, nxt); \
-            if (!title_info_dup->elem) goto end; \
-            dup_##elem = true; \
-        } \
+            TitleInfoSnapshotHeader *header = ((TitleInfoSnapshotHeader*)cache_entry->snapshot - 1);
+            if (header->generation != g_titleInfoGeneration) break;
+
+            __atomic_add_fetch(&(header->ref_count), 1, __ATOMIC_RELAXED);
+            return cache_entry->snapshot;
+        }
     }
 
-#define TITLE_FREE_DUPLICATED_LINKED_LIST(elem) \
-    if (dup_##elem) { \
-        tmp1 = title_info_dup->elem; \
-        while(tmp1) { \
-            tmp2 = tmp1->elem; \
-            tmp1->previous = tmp1->next = NULL; \
-            titleFreeTitleInfo(&tmp1); \
-            tmp1 = tmp2; \
-        } \
+    /* Count linked list elements. */
+    for(cur = title_info->previous; cur; cur = cur->previous) prev_count++;
+    for(cur = title_info->next; cur; cur = cur->next) node_count++;
+    node_count += prev_count;
+
+    /* Allocate memory for the node pointer array. */
+    nodes = calloc(node_count, sizeof(TitleInfo*));
+    if (!nodes)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for TitleInfo node pointer array!");
+        return NULL;
     }
 
-    /* Duplicate linked lists based on two different principles: */
-    /* 1) Linked list pointers will only be populated if their corresponding pointer is also populated in the TitleInfo element to duplicate. */
-    /* 2) Pointers passed into this function take precedence before actual data duplication. */
-    TITLE_DUPLICATE_LINKED_LIST(previous, NULL, title_info_dup);
-    TITLE_DUPLICATE_LINKED_LIST(next, title_info_dup, NULL);
+    /* Fill node pointer array, from the head of the linked list to its tail. */
+    idx = prev_count;
+    for(cur = title_info; cur; cur = cur->previous) nodes[idx--] = cur;
 
-    /* Update flag. */
-    success = true;
+    idx = (prev_count + 1);
+    for(cur = title_info->next; cur; cur = cur->next) nodes[idx++] = cur;
 
-end:
-    /* We can't directly use titleFreeTitleInfo() on title_info_dup because some or all of the linked list data may have been provided as function arguments. */
-    /* So we'll take care of freeing data the old fashioned way. */
-    if (!success && title_info_dup)
-    {
-        /* Free content infos pointer. */
-        if (title_info_dup->content_infos) free(title_info_dup->content_infos);
+    /* Create snapshot. */
+    snapshot = titleCreateTitleInfoSnapshot(nodes, node_count, prev_count);
+    free(nodes);
 
-        /* Free previous and next linked lists (if duplicated). */
-        /* We need to take care of not freeing the linked lists right away, either because we may have already freed them, or because they may have been passed as arguments. */
-        /* Furthermore, both the next pointer from the previous sibling and the previous pointer from the next sibling reference our current duplicated entry. */
-        /* To avoid issues, we'll just clear all linked list pointers. */
-        TITLE_FREE_DUPLICATED_LINKED_LIST(previous);
-        TITLE_FREE_DUPLICATED_LINKED_LIST(next);
+    if (!snapshot || !use_cache) return snapshot;
 
-        /* Free allocated buffer and update return pointer. */
-        free(title_info_dup);
-        title_info_dup = NULL;
-    }
+    /* Cache our new snapshot, replacing the oldest entry if needed. The cache holds its own reference. */
+    cache_entry = &(g_titleInfoSnapshotCache[g_titleInfoSnapshotCacheNextIdx]);
+    if (cache_entry->snapshot) titleReleaseTitleInfoSnapshot(cache_entry->snapshot);
 
-#undef TITLE_DUPLICATE_LINKED_LIST
+    __atomic_add_fetch(&(((TitleInfoSnapshotHeader*)snapshot - 1)->ref_count), 1, __ATOMIC_RELAXED);
 
-#undef TITLE_FREE_DUPLICATED_LINKED_LIST
+    cache_entry->source = title_info;
+    cache_entry->snapshot = snapshot;
 
-    return title_info_dup;
+    g_titleInfoSnapshotCacheNextIdx = ((g_titleInfoSnapshotCacheNextIdx + 1) % TITLE_INFO_SNAPSHOT_CACHE_SIZE);
+
+    return snapshot;
 }
 
-static TitleInfo *titleDuplicateTitleInfo(TitleInfo *title_info)
+static TitleInfo *titleCreateTitleInfoSnapshot(TitleInfo **nodes, u32 node_count, u32 ret_idx)
 {
-    if (!titleIsValidInfoBlock(title_info))
+    if (!nodes || !node_count || ret_idx >= node_count)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return NULL;
     }
 
-    TitleInfo *title_info_dup = NULL;
-    NcmContentInfo *content_infos_dup = NULL;
-    bool success = false;
+    TitleInfoSnapshotHeader *header = NULL;
+    TitleInfo *dst_nodes = NULL, *dst = NULL, *prev = NULL;
+    NcmContentInfo *dst_content_infos = NULL;
+    u64 content_count = 0, block_size = 0;
+
+    /* Get total content info count. */
+    for(u32 i = 0; i < node_count; i++)
+    {
+        if (!titleIsValidInfoBlock(nodes[i]))
+        {
+            LOG_MSG_ERROR("Invalid TitleInfo element! (#%u).", i);
+            return NULL;
+        }
+
+        content_count += nodes[i]->content_count;
+    }
+
+    /* Allocate a single block for the header, all TitleInfo elements and all content infos. */
+    block_size = (sizeof(TitleInfoSnapshotHeader) + (node_count * sizeof(TitleInfo)) + (content_count * sizeof(NcmContentInfo)));
 
-    /* Allocate memory for the new TitleInfo element. */
-    title_info_dup = calloc(1, sizeof(TitleInfo));
-    if (!title_info_dup)
+    header = malloc(block_size);
+    if (!header)
     {
-        LOG_MSG_ERROR("Failed to allocate memory for TitleInfo duplicate!");
+        LOG_MSG_ERROR("Failed to allocate 0x%lX bytes for TitleInfo snapshot!", block_size);
         return NULL;
     }
 
-    /* Copy TitleInfo data. */
-    memcpy(title_info_dup, title_info, sizeof(TitleInfo));
-    title_info_dup->previous = title_info_dup->next = NULL;
+    header->magic = TITLE_INFO_SNAPSHOT_MAGIC;
+    header->ref_count = 1;
+    header->generation = g_titleInfoGeneration;
 
-    /* Allocate memory for NcmContentInfo elements. */
-    content_infos_dup = calloc(title_info->content_count, sizeof(NcmContentInfo));
-    if (!content_infos_dup)
+    dst_nodes = (TitleInfo*)(header + 1);
+    dst_content_infos = (NcmContentInfo*)(dst_nodes + node_count);
+
+    /* Copy TitleInfo elements in linked list order. */
+    /* The requested element is always placed right after the header, which is what lets titleReleaseTitleInfoSnapshot() find it. */
+    for(u32 i = 0; i < node_count; i++)
     {
-        LOG_MSG_ERROR("Failed to allocate memory for NcmContentInfo duplicates!");
-        goto end;
+        dst = &(dst_nodes[i == ret_idx ? 0 : (i < ret_idx ? (i + 1) : i)]);
+        memcpy(dst, nodes[i], sizeof(TitleInfo));
+
+        /* Copy content infos. */
+        dst->content_infos = dst_content_infos;
+        memcpy(dst_content_infos, nodes[i]->content_infos, nodes[i]->content_count * sizeof(NcmContentInfo));
+        dst_content_infos += nodes[i]->content_count;
+
+        /* Update linked list pointers. */
+        dst->previous = prev;
+        dst->next = NULL;
+        if (prev) prev->next = dst;
+
+        prev = dst;
     }
 
-    /* Copy NcmContentInfo data. */
-    memcpy(content_infos_dup, title_info->content_infos, title_info->content_count * sizeof(NcmContentInfo));
+    return dst_nodes;
+}
 
-    /* Update content infos pointer. */
-    title_info_dup->content_infos = content_infos_dup;
+static void titleReleaseTitleInfoSnapshot(TitleInfo *snapshot)
+{
+    TitleInfoSnapshotHeader *header = ((TitleInfoSnapshotHeader*)snapshot - 1);
 
-    /* Update flag. */
-    success = true;
+    if (header->magic != TITLE_INFO_SNAPSHOT_MAGIC)
+    {
+        LOG_MSG_ERROR("Invalid TitleInfo snapshot! Only pointers returned by the title interface can be freed.");
+        return;
+    }
 
-end:
-    if (!success)
+    if (__atomic_sub_fetch(&(header->ref_count), 1, __ATOMIC_ACQ_REL) > 0) return;
+
+    header->magic = 0;
+    free(header);
+}
+
+static void titleUpdateTitleInfoGeneration(void)
+{
+    /* Snapshots from the previous generation remain valid for as long as they're referenced, but they're no longer handed out. */
+    g_titleInfoGeneration++;
+
+    for(u32 i = 0; i < TITLE_INFO_SNAPSHOT_CACHE_SIZE; i++)
     {
-        if (content_infos_dup) free(content_infos_dup);
+        TitleInfoSnapshotCacheEntry *cache_entry = &(g_titleInfoSnapshotCache[i]);
 
-        if (title_info_dup)
-        {
-            free(title_info_dup);
-            title_info_dup = NULL;
-        }
+        if (cache_entry->snapshot) titleReleaseTitleInfoSnapshot(cache_entry->snapshot);
+
+        cache_entry->source = NULL;
+        cache_entry->snapshot = NULL;
     }
 
-    return title_info_dup;
+    g_titleInfoSnapshotCacheNextIdx = 0;
 }
 
 static char *titleGetDisplayVersionString(TitleInfo *title_info)
@@ -3327,7 +5053,7 @@ static char *titleGetDisplayVersionString(TitleInfo *title_info)
     }
 
     /* Initialize NCA context. */
-    if (!ncaInitializeContext(nca_ctx, storage_id, hfs_partition_type, &(title_info->meta_key), nacp_content, NULL))
+    if (!ncaInitializeContextLazy(nca_ctx, storage_id, hfs_partition_type, &(title_info->meta_key), nacp_content, NULL))
     {
         LOG_MSG_ERROR("Failed to initialize NCA context for Control NCA from %016lX!", title_info->meta_key.id);
         goto end;
@@ -3393,8 +5119,17 @@ static void titleGameCardInfoThreadFunc(void *arg)
     Waiter gamecard_status_event_waiter = waiterForUEvent(g_titleGameCardStatusChangeUserEvent);
     Waiter exit_event_waiter = waiterForUEvent(&g_titleGameCardInfoThreadExitEvent);
 
-    while(true)
+    /* Bind the cancellation token for this thread. Gamecard title scans performed by it will be cancelled by titleExit(). */
+    cancelTokenBindCurrent(&g_titleGameCardInfoThreadCancelToken);
+
+    /* Retrieve application metadata we skipped during initialization. */
+    /* We won't enter the event loop if the exit event was triggered in the meantime. */
+    bool exit_thread = !titleLoadDeferredApplicationMetadata(exit_event_waiter);
+
+    while(!exit_thread)
     {
+        bool prefetch = false;
+
         /* Wait until an event is triggered. */
         rc = waitMulti(&idx, -1, gamecard_status_event_waiter, exit_event_waiter);
         if (R_FAILED(rc)) continue;
@@ -3415,7 +5150,12 @@ static void titleGameCardInfoThreadFunc(void *arg)
 
             /* Generate filtered user application metadata pointer array. */
             if (g_titleGameCardInfoUpdated) titleGenerateFilteredApplicationMetadataPointerArray(false);
+
+            prefetch = (g_titleGameCardInfoUpdated && g_titleGameCardAvailable);
         }
+
+        /* Warm up metadata caches for the newly inserted gamecard while the user is still browsing menus. */
+        if (prefetch) exit_thread = !titlePrefetchGameCardMetadata(exit_event_waiter);
     }
 
     /* Update gamecard flags. */
@@ -3427,6 +5167,70 @@ static void titleGameCardInfoThreadFunc(void *arg)
     threadExit();
 }
 
+static bool titlePrefetchGameCardMetadata(Waiter exit_event_waiter)
+{
+    TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(NcmStorageId_GameCard)]);
+    NcaContext *nca_ctx = NULL;
+    Ticket *tik = NULL;
+    s32 prio = 0;
+    u32 title_count = 0, content_count = 0;
+    bool prio_changed = false, exit_requested = false;
+    u64 start_tick = armGetSystemTick();
+
+    /* Allocate memory for the NCA context and the ticket. */
+    nca_ctx = calloc(1, sizeof(NcaContext));
+    tik = calloc(1, sizeof(Ticket));
+    if (!nca_ctx || !tik)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the gamecard metadata prefetch buffers!");
+        goto end;
+    }
+
+    /* Lower the priority of this thread, so the prefetch never competes with the UI or with a dump started in the meantime. */
+    if (R_SUCCEEDED(svcGetThreadPriority(&prio, CUR_THREAD_HANDLE)) && R_SUCCEEDED(svcSetThreadPriority(CUR_THREAD_HANDLE, TITLE_GAMECARD_PREFETCH_PRIORITY))) prio_changed = true;
+
+    /* Initialize NCA contexts for every gamecard title, without holding the title interface mutex. */
+    /* We can safely access the gamecard title storage here, since it's only ever modified by this thread once titleInitialize() returns. */
+    /* This populates the NCA header cache, retrieves tickets from the secure Hash FS partition and leaves the accessed gamecard areas in the gamecard read cache. */
+    /* Contents are processed in title order and we stop once the NCA header cache is full, so we don't evict entries we just stored. */
+    for(u32 i = 0; i < title_storage->title_count && content_count < NCA_HEADER_CACHE_ENTRY_COUNT; i++)
+    {
+        TitleInfo *title_info = title_storage->titles[i];
+        if (!title_info || !title_info->content_infos || !title_info->content_count) continue;
+
+        /* Contents from the same title share the same ticket, so it only needs to be retrieved once. */
+        memset(tik, 0, sizeof(Ticket));
+
+        for(u32 j = 0; j < title_info->content_count && content_count < NCA_HEADER_CACHE_ENTRY_COUNT; j++)
+        {
+            /* Bail out if the exit event was triggered. */
+            if (R_SUCCEEDED(waitSingle(exit_event_waiter, 0)))
+            {
+                exit_requested = true;
+                goto end;
+            }
+
+            /* Stop right away if the gamecard was removed. The gamecard status change event will take care of the rest. */
+            if (gamecardGetStatus() != GameCardStatus_InsertedAndInfoLoaded || cancelTokenIsCurrentCancelled()) goto end;
+
+            if (ncaInitializeContext(nca_ctx, NcmStorageId_GameCard, HashFileSystemPartitionType_Secure, &(title_info->meta_key), &(title_info->content_infos[j]), tik)) content_count++;
+        }
+
+        title_count++;
+    }
+
+end:
+    if (prio_changed) svcSetThreadPriority(CUR_THREAD_HANDLE, (u32)prio);
+
+    if (content_count) LOG_MSG_INFO("Prefetched metadata for %u NCA(s) from %u gamecard title(s) in %lu ms.", content_count, title_count, armTicksToNs(armGetSystemTick() - start_tick) / 1000000);
+
+    if (tik) free(tik);
+
+    if (nca_ctx) free(nca_ctx);
+
+    return !exit_requested;
+}
+
 static bool titleRefreshGameCardTitleInfo(void)
 {
     TitleStorage *title_storage = NULL;
@@ -3516,11 +5320,11 @@ static bool titleRefreshGameCardTitleInfo(void)
         g_userMetadataCount += extra_app_count;
 
         /* Sort application metadata entries by name. */
-        if (g_userMetadataCount > 1) qsort(g_userMetadata, g_userMetadataCount, sizeof(TitleApplicationMetadata*), &titleUserMetadataSortFunction);
+        titleSortApplicationMetadata(false);
 
         /* Update linked lists for user applications, patches and add-on contents. */
         /* This will take care of orphan titles we might now have application metadata for. */
-        titleUpdateTitleInfoLinkedLists();
+        titleUpdateGameCardTitleInfoLinkedLists();
     }
 
     /* Free extra allocated pointers if we didn't use them. */
@@ -3537,14 +5341,8 @@ end:
     /* Free previously allocated application metadata pointers. Ignore return value. */
     if (!success && free_entries) titleReallocateApplicationMetadata(extra_app_count, false, true);
 
-    if (cleanup)
-    {
-        /* Close gamecard title storage. */
-        titleCloseTitleStorage(NcmStorageId_GameCard);
-
-        /* Update linked lists for user applications, patches and add-on contents. */
-        titleUpdateTitleInfoLinkedLists();
-    }
+    /* Close gamecard title storage. This also removes gamecard titles from all linked lists. */
+    if (cleanup) titleCloseTitleStorage(NcmStorageId_GameCard);
 
     return success;
 }
@@ -3781,6 +5579,102 @@ fallback:
     return filename;
 }
 
+static void titleSortPointerArray(void **ptrs, u32 count, u8 type)
+{
+    TitleSortKey *keys = NULL;
+
+    if (!ptrs || count < 2) return;
+
+    /* Fall back to sorting the pointer array directly if we can't allocate the sort keys. */
+    if (!(keys = malloc(count * sizeof(TitleSortKey))))
+    {
+        LOG_MSG_WARNING("Failed to allocate memory for %u sort key(s)! Falling back to a regular sort.", count);
+        qsort(ptrs, count, sizeof(void*), type == TitleSortKeyType_TitleInfo ? &titleInfoSortFunction : \
+                                          (type == TitleSortKeyType_UserMetadata ? &titleUserMetadataSortFunction : &titleSystemMetadataSortFunction));
+        return;
+    }
+
+    /* Generate sort keys. This is the only step that needs to access the actual elements. */
+    for(u32 i = 0; i < count; i++)
+    {
+        TitleSortKey *cur_key = &(keys[i]);
+
+        cur_key->name = NULL;
+        cur_key->ptr = ptrs[i];
+
+        switch(type)
+        {
+            case TitleSortKeyType_SystemMetadata:
+            {
+                const TitleApplicationMetadata *app_metadata = (const TitleApplicationMetadata*)ptrs[i];
+                cur_key->key[0] = app_metadata->title_id;
+                cur_key->key[1] = 0;
+                break;
+            }
+            case TitleSortKeyType_UserMetadata:
+            {
+                /* The first 16 lowercase name bytes are packed into both keys, so only names sharing that prefix need a string comparison. */
+                const TitleApplicationMetadata *app_metadata = (const TitleApplicationMetadata*)ptrs[i];
+                cur_key->key[0] = titleGetNameSortKey(app_metadata->lang_entry.name, 0);
+                cur_key->key[1] = titleGetNameSortKey(app_metadata->lang_entry.name, sizeof(u64));
+                cur_key->name = app_metadata->lang_entry.name;
+                break;
+            }
+            case TitleSortKeyType_TitleInfo:
+            {
+                const TitleInfo *title_info = (const TitleInfo*)ptrs[i];
+                cur_key->key[0] = title_info->meta_key.id;
+                cur_key->key[1] = (((u64)title_info->version.value << 8) | title_info->storage_id);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    /* Sort keys and write the pointer array back. */
+    qsort(keys, count, sizeof(TitleSortKey), &titleSortKeySortFunction);
+
+    for(u32 i = 0; i < count; i++) ptrs[i] = keys[i].ptr;
+
+    free(keys);
+}
+
+NX_INLINE u64 titleGetNameSortKey(const char *name, size_t offset)
+{
+    u64 key = 0;
+    size_t len = strnlen(name, offset + sizeof(u64));
+
+    /* Lowercase bytes are stored in big endian order, which makes integer comparisons match strcasecmp(). Missing bytes are set to zero. */
+    for(size_t i = 0; i < sizeof(u64); i++)
+    {
+        u8 c = ((offset + i) < len ? (u8)tolower((u8)name[offset + i]) : 0);
+        key = ((key << 8) | c);
+    }
+
+    return key;
+}
+
+static int titleSortKeySortFunction(const void *a, const void *b)
+{
+    const TitleSortKey *sort_key_1 = (const TitleSortKey*)a;
+    const TitleSortKey *sort_key_2 = (const TitleSortKey*)b;
+
+    for(u32 i = 0; i < MAX_ELEMENTS(sort_key_1->key); i++)
+    {
+        if (sort_key_1->key[i] < sort_key_2->key[i])
+        {
+            return -1;
+        } else
+        if (sort_key_1->key[i] > sort_key_2->key[i])
+        {
+            return 1;
+        }
+    }
+
+    return ((sort_key_1->name && sort_key_2->name) ? strcasecmp(sort_key_1->name, sort_key_2->name) : 0);
+}
+
 static int titleSystemMetadataSortFunction(const void *a, const void *b)
 {
     const TitleApplicationMetadata *app_metadata_1 = *((const TitleApplicationMetadata**)a);
@@ -3883,3 +5777,29 @@ static int titleGameCardContentMetaContextSortFunction(const void *a, const void
 
     return 0;
 }
+
+static int titleQueryTrigramSortFunction(const void *a, const void *b)
+{
+    const TitleQueryTrigram *trigram_1 = (const TitleQueryTrigram*)a;
+    const TitleQueryTrigram *trigram_2 = (const TitleQueryTrigram*)b;
+
+    if (trigram_1->trigram < trigram_2->trigram)
+    {
+        return -1;
+    } else
+    if (trigram_1->trigram > trigram_2->trigram)
+    {
+        return 1;
+    }
+
+    if (trigram_1->entry_idx < trigram_2->entry_idx)
+    {
+        return -1;
+    } else
+    if (trigram_1->entry_idx > trigram_2->entry_idx)
+    {
+        return 1;
+    }
+
+    return 0;
+}
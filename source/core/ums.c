@@ -21,6 +21,33 @@
 
 #include <core/nxdt_utils.h>
 
+#define UMS_PROBE_FILE_NAME         "nxdt_probe.tmp"
+#define UMS_PROBE_DATA_SIZE         0x800000    /* 8 MiB. Written (and read) once per probe block size. */
+
+#define UMS_PROBE_MIN_QUEUE_DEPTH   2
+#define UMS_PROBE_MAX_QUEUE_DEPTH   8
+
+/* Type definitions. */
+
+typedef enum {
+    UmsDeviceProbeState_Pending  = 0,
+    UmsDeviceProbeState_Running  = 1,
+    UmsDeviceProbeState_Finished = 2,
+    UmsDeviceProbeState_Skipped  = 3    ///< Write-protected device, not enough free space or probe failure.
+} UmsDeviceProbeState;
+
+/* Holds the speed probe state for a single mounted device. Entries are stored in the same order as the mounted device array. */
+typedef struct {
+    u8 state;                   ///< UmsDeviceProbeState.
+    UmsDeviceProfile profile;   ///< Only valid if 'state' is set to UmsDeviceProbeState_Finished.
+} UmsDeviceProbeEntry;
+
+/* Global constants. */
+
+/* Sizes are sorted in ascending order. Bigger blocks are only picked if they're noticeably faster. */
+static const u32 g_umsProbeBlockSizes[] = { 0x10000, 0x40000, 0x100000, 0x400000 };
+static const u32 g_umsProbeBlockSizesCount = MAX_ELEMENTS(g_umsProbeBlockSizes);
+
 /* Global variables. */
 
 static Mutex g_umsMutex = 0;
@@ -28,6 +55,11 @@ static bool g_umsInterfaceInit = false, g_umsDeviceInfoUpdated = false;
 
 static u32 g_umsDeviceCount = 0;
 static UsbHsFsDevice *g_umsDevices = NULL;
+static UmsDeviceProbeEntry *g_umsDeviceProbes = NULL;
+
+static Thread g_umsProbeThread = {0};
+static UEvent g_umsProbeEvent = {0}, g_umsProbeThreadExitEvent = {0}, g_umsDeviceInfoUpdateEvent = {0};
+static bool g_umsProbeThreadCreated = false;
 
 /* Function prototypes. */
 
@@ -35,6 +67,20 @@ static void umsFreeDeviceData(void);
 static void umsPopulateCallback(const UsbHsFsDevice *devices, u32 device_count, void *user_data);
 static bool umsDuplicateDeviceArray(const UsbHsFsDevice *in_devices, u32 in_device_count, UsbHsFsDevice **out_devices, u32 *out_device_count);
 
+NX_INLINE bool umsIsSameDevice(const UsbHsFsDevice *a, const UsbHsFsDevice *b);
+
+static bool umsCreateProbeThread(void);
+static void umsDestroyProbeThread(void);
+static void umsProbeThreadFunc(void *arg);
+
+static bool umsGetNextPendingDevice(UsbHsFsDevice *out_device);
+static void umsSetDeviceProbeResult(const UsbHsFsDevice *device, const UmsDeviceProfile *profile);
+
+static bool umsProbeDevice(const UsbHsFsDevice *device, UmsDeviceProfile *out_profile);
+static bool umsProbeBlockSize(const char *path, void *buf, u32 block_size, u64 *out_write_time, u64 *out_read_time, u64 *out_max_write_latency);
+
+NX_INLINE bool umsIsProbeThreadExitRequested(void);
+
 bool umsInitialize(void)
 {
     bool ret = false;
@@ -44,6 +90,16 @@ bool umsInitialize(void)
         ret = g_umsInterfaceInit;
         if (ret) break;
 
+        /* Create user events for the speed probe thread. */
+        ueventCreate(&g_umsProbeEvent, true);
+        ueventCreate(&g_umsProbeThreadExitEvent, false);
+
+        /* Create device info update user event. */
+        ueventCreate(&g_umsDeviceInfoUpdateEvent, true);
+
+        /* Create speed probe thread. Dumps to UMS devices that haven't been probed just use the default write parameters. */
+        g_umsProbeThreadCreated = umsCreateProbeThread();
+
         /* Set populate callback function. */
         usbHsFsSetPopulateCallback(&umsPopulateCallback, NULL);
 
@@ -64,6 +120,13 @@ bool umsInitialize(void)
 
 void umsExit(void)
 {
+    /* Destroy speed probe thread. This is done without holding the mutex, since the probe thread locks it on its own. */
+    if (g_umsProbeThreadCreated)
+    {
+        umsDestroyProbeThread();
+        g_umsProbeThreadCreated = false;
+    }
+
     SCOPED_LOCK(&g_umsMutex)
     {
         /* Close USB Mass Storage Host interface. */
@@ -90,6 +153,18 @@ bool umsIsDeviceInfoUpdated(void)
     return ret;
 }
 
+UEvent *umsGetDeviceInfoUpdateUserEvent(void)
+{
+    UEvent *event = NULL;
+
+    SCOPED_LOCK(&g_umsMutex)
+    {
+        if (g_umsInterfaceInit) event = &g_umsDeviceInfoUpdateEvent;
+    }
+
+    return event;
+}
+
 UsbHsFsDevice *umsGetDevices(u32 *out_count)
 {
     UsbHsFsDevice *devices = NULL;
@@ -109,6 +184,36 @@ UsbHsFsDevice *umsGetDevices(u32 *out_count)
     return devices;
 }
 
+bool umsGetDeviceProfileByPath(const char *path, UmsDeviceProfile *out_profile)
+{
+    const char *name_end = NULL;
+    bool ret = false;
+
+    if (!path || !*path || !(name_end = strchr(path, ':')) || !out_profile)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    size_t name_len = (size_t)(name_end - path + 1);
+
+    SCOPED_LOCK(&g_umsMutex)
+    {
+        if (!g_umsInterfaceInit || !g_umsDeviceProbes) break;
+
+        for(u32 i = 0; i < g_umsDeviceCount; i++)
+        {
+            /* Device names include the trailing colon. */
+            if (strlen(g_umsDevices[i].name) != name_len || strncmp(g_umsDevices[i].name, path, name_len) != 0) continue;
+
+            if ((ret = (g_umsDeviceProbes[i].state == UmsDeviceProbeState_Finished))) memcpy(out_profile, &(g_umsDeviceProbes[i].profile), sizeof(UmsDeviceProfile));
+            break;
+        }
+    }
+
+    return ret;
+}
+
 bool umsUnmountDevice(const UsbHsFsDevice *device)
 {
     if (!device)
@@ -133,6 +238,13 @@ static void umsFreeDeviceData(void)
         g_umsDevices = NULL;
     }
 
+    /* Free speed probe entries. */
+    if (g_umsDeviceProbes)
+    {
+        free(g_umsDeviceProbes);
+        g_umsDeviceProbes = NULL;
+    }
+
     /* Reset device count. */
     g_umsDeviceCount = 0;
 }
@@ -143,19 +255,51 @@ static void umsPopulateCallback(const UsbHsFsDevice *devices, u32 device_count,
 
     SCOPED_LOCK(&g_umsMutex)
     {
-        /* Free USB Mass Storage device data. */
-        umsFreeDeviceData();
+        /* Keep the previous device data around, so speed probe results can be carried over for devices that are still mounted. */
+        UsbHsFsDevice *prev_devices = g_umsDevices;
+        UmsDeviceProbeEntry *prev_probes = g_umsDeviceProbes;
+        u32 prev_device_count = g_umsDeviceCount;
+
+        g_umsDevices = NULL;
+        g_umsDeviceProbes = NULL;
+        g_umsDeviceCount = 0;
 
         LOG_MSG_INFO("Mounted USB Mass Storage device count: %u.", device_count);
 
         if (devices && device_count)
         {
             /* Duplicate device data. */
-            if (!umsDuplicateDeviceArray(devices, device_count, &g_umsDevices, &g_umsDeviceCount)) LOG_MSG_ERROR("Failed to duplicate USB Mass Storage device data!");
+            if (!umsDuplicateDeviceArray(devices, device_count, &g_umsDevices, &g_umsDeviceCount))
+            {
+                LOG_MSG_ERROR("Failed to duplicate USB Mass Storage device data!");
+            } else
+            if (!(g_umsDeviceProbes = calloc(g_umsDeviceCount, sizeof(UmsDeviceProbeEntry))))
+            {
+                LOG_MSG_ERROR("Failed to allocate memory for %u speed probe entries!", g_umsDeviceCount);
+            } else {
+                for(u32 i = 0; i < g_umsDeviceCount; i++)
+                {
+                    for(u32 j = 0; prev_probes && j < prev_device_count; j++)
+                    {
+                        /* Probes that were still running are started over. */
+                        if (!umsIsSameDevice(&(g_umsDevices[i]), &(prev_devices[j])) || prev_probes[j].state == UmsDeviceProbeState_Running) continue;
+                        memcpy(&(g_umsDeviceProbes[i]), &(prev_probes[j]), sizeof(UmsDeviceProbeEntry));
+                        break;
+                    }
+                }
+
+                /* Wake up the speed probe thread. */
+                ueventSignal(&g_umsProbeEvent);
+            }
         }
 
-        /* Update USB Mass Storage device info updated flag. */
+        /* Free previous device data. */
+        if (prev_devices) free(prev_devices);
+        if (prev_probes) free(prev_probes);
+
+        /* Update USB Mass Storage device info updated flag and signal the device info update event. */
         g_umsDeviceInfoUpdated = true;
+        ueventSignal(&g_umsDeviceInfoUpdateEvent);
     }
 }
 
@@ -202,3 +346,259 @@ static bool umsDuplicateDeviceArray(const UsbHsFsDevice *in_devices, u32 in_devi
 end:
     return ret;
 }
+
+NX_INLINE bool umsIsSameDevice(const UsbHsFsDevice *a, const UsbHsFsDevice *b)
+{
+    return (a->usb_if_id == b->usb_if_id && a->lun == b->lun && a->fs_idx == b->fs_idx);
+}
+
+static bool umsCreateProbeThread(void)
+{
+    if (!utilsCreateThread(&g_umsProbeThread, umsProbeThreadFunc, NULL, 2))
+    {
+        LOG_MSG_ERROR("Failed to create UMS speed probe thread!");
+        return false;
+    }
+
+    return true;
+}
+
+static void umsDestroyProbeThread(void)
+{
+    /* Signal the exit event to terminate the speed probe thread. */
+    ueventSignal(&g_umsProbeThreadExitEvent);
+
+    /* Wait for the speed probe thread to exit. */
+    utilsJoinThread(&g_umsProbeThread);
+}
+
+static void umsProbeThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    Result rc = 0;
+    int idx = 0;
+
+    Waiter probe_event_waiter = waiterForUEvent(&g_umsProbeEvent);
+    Waiter exit_event_waiter = waiterForUEvent(&g_umsProbeThreadExitEvent);
+
+    while(true)
+    {
+        /* Wait until an event is triggered. */
+        rc = waitMulti(&idx, -1, probe_event_waiter, exit_event_waiter);
+        if (R_FAILED(rc)) continue;
+
+        /* Exit event triggered. */
+        if (idx == 1) break;
+
+        /* Probe every pending device, one at a time. The mutex isn't held while probing, so device info retrieval isn't blocked. */
+        UsbHsFsDevice device = {0};
+
+        while(!umsIsProbeThreadExitRequested() && umsGetNextPendingDevice(&device))
+        {
+            UmsDeviceProfile profile = {0};
+            bool success = umsProbeDevice(&device, &profile);
+            umsSetDeviceProbeResult(&device, success ? &profile : NULL);
+        }
+    }
+
+    threadExit();
+}
+
+static bool umsGetNextPendingDevice(UsbHsFsDevice *out_device)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_umsMutex)
+    {
+        if (!g_umsDeviceProbes) break;
+
+        for(u32 i = 0; i < g_umsDeviceCount; i++)
+        {
+            if (g_umsDeviceProbes[i].state != UmsDeviceProbeState_Pending) continue;
+
+            g_umsDeviceProbes[i].state = UmsDeviceProbeState_Running;
+            memcpy(out_device, &(g_umsDevices[i]), sizeof(UsbHsFsDevice));
+            ret = true;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+static void umsSetDeviceProbeResult(const UsbHsFsDevice *device, const UmsDeviceProfile *profile)
+{
+    SCOPED_LOCK(&g_umsMutex)
+    {
+        if (!g_umsDeviceProbes) break;
+
+        for(u32 i = 0; i < g_umsDeviceCount; i++)
+        {
+            /* Discard results if the device was remounted in the meantime. */
+            if (!umsIsSameDevice(&(g_umsDevices[i]), device) || g_umsDeviceProbes[i].state != UmsDeviceProbeState_Running) continue;
+
+            if (profile)
+            {
+                memcpy(&(g_umsDeviceProbes[i].profile), profile, sizeof(UmsDeviceProfile));
+                g_umsDeviceProbes[i].state = UmsDeviceProbeState_Finished;
+            } else {
+                g_umsDeviceProbes[i].state = UmsDeviceProbeState_Skipped;
+            }
+
+            break;
+        }
+    }
+}
+
+static bool umsProbeDevice(const UsbHsFsDevice *device, UmsDeviceProfile *out_profile)
+{
+    char path[FS_MAX_PATH] = {0};
+    u64 free_space = 0, best_speed = 0;
+    void *buf = NULL;
+    bool ret = false;
+
+    /* Don't touch write-protected devices. */
+    if (device->write_protect)
+    {
+        LOG_MSG_INFO("Skipping speed probe for write-protected UMS device \"%s\".", device->name);
+        goto end;
+    }
+
+    /* Make sure there's enough free space for the probe file. */
+    snprintf(path, MAX_ELEMENTS(path), "%s/", device->name);
+    if (!utilsGetFileSystemStatsByPath(path, NULL, &free_space) || free_space < (UMS_PROBE_DATA_SIZE * 2))
+    {
+        LOG_MSG_INFO("Skipping speed probe for UMS device \"%s\" (not enough free space).", device->name);
+        goto end;
+    }
+
+    /* Allocate probe buffer. Fill it with random data, since some flash controllers compress data on their own. */
+    if (!(buf = malloc(g_umsProbeBlockSizes[g_umsProbeBlockSizesCount - 1])))
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for the speed probe buffer!");
+        goto end;
+    }
+
+    randomGet(buf, g_umsProbeBlockSizes[g_umsProbeBlockSizesCount - 1]);
+
+    snprintf(path, MAX_ELEMENTS(path), "%s/" UMS_PROBE_FILE_NAME, device->name);
+
+    for(u32 i = 0; i < g_umsProbeBlockSizesCount; i++)
+    {
+        u32 block_size = g_umsProbeBlockSizes[i];
+        u64 write_time = 0, read_time = 0, max_write_latency = 0;
+
+        if (umsIsProbeThreadExitRequested()) break;
+
+        if (!umsProbeBlockSize(path, buf, block_size, &write_time, &read_time, &max_write_latency)) break;
+
+        u64 write_speed = ((UMS_PROBE_DATA_SIZE * 1000000000ULL) / write_time);
+        u64 read_speed = ((UMS_PROBE_DATA_SIZE * 1000000000ULL) / read_time);
+
+        LOG_MSG_DEBUG("UMS device \"%s\" | Block size: 0x%X | Write: %lu KiB/s | Read: %lu KiB/s | Max write latency: %lu us.", device->name, block_size, write_speed / 1024, \
+                      read_speed / 1024, max_write_latency / 1000);
+
+        /* Only pick bigger blocks if they're at least 10% faster. */
+        if (best_speed && write_speed <= (best_speed + (best_speed / 10))) continue;
+
+        /* Calculate the number of blocks that must be kept queued to absorb the worst write stall we've seen. */
+        u64 avg_write_latency = (write_time / (UMS_PROBE_DATA_SIZE / block_size));
+        u64 queue_depth = (avg_write_latency ? ((max_write_latency + avg_write_latency - 1) / avg_write_latency) + 1 : UMS_PROBE_MIN_QUEUE_DEPTH);
+
+        best_speed = write_speed;
+        out_profile->block_size = block_size;
+        out_profile->queue_depth = (u32)MIN(MAX(queue_depth, UMS_PROBE_MIN_QUEUE_DEPTH), UMS_PROBE_MAX_QUEUE_DEPTH);
+        out_profile->write_speed = write_speed;
+        out_profile->read_speed = read_speed;
+    }
+
+    /* Remove probe file. */
+    remove(path);
+
+    if (!(ret = (best_speed > 0))) goto end;
+
+    LOG_MSG_INFO("UMS device \"%s\" speed probe results: block size 0x%X, queue depth %u, write speed %lu KiB/s, read speed %lu KiB/s.", device->name, out_profile->block_size, \
+                 out_profile->queue_depth, out_profile->write_speed / 1024, out_profile->read_speed / 1024);
+
+end:
+    if (buf) free(buf);
+
+    return ret;
+}
+
+static bool umsProbeBlockSize(const char *path, void *buf, u32 block_size, u64 *out_write_time, u64 *out_read_time, u64 *out_max_write_latency)
+{
+    FILE *fp = NULL;
+    u64 start_tick = 0, block_tick = 0, latency = 0;
+    bool ret = false;
+
+    /* Write probe data. Closing the file is part of the measurement, since it flushes filesystem metadata. */
+    if (!(fp = fopen(path, "wb")))
+    {
+        LOG_MSG_ERROR("Failed to create probe file \"%s\"! (%d).", path, errno);
+        goto end;
+    }
+
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    start_tick = armGetSystemTick();
+
+    for(size_t offset = 0; offset < UMS_PROBE_DATA_SIZE; offset += block_size)
+    {
+        block_tick = armGetSystemTick();
+
+        if (fwrite(buf, 1, block_size, fp) != block_size)
+        {
+            LOG_MSG_ERROR("Failed to write 0x%X-byte long probe block at offset 0x%lX!", block_size, offset);
+            goto end;
+        }
+
+        latency = armTicksToNs(armGetSystemTick() - block_tick);
+        if (latency > *out_max_write_latency) *out_max_write_latency = latency;
+    }
+
+    fclose(fp);
+    fp = NULL;
+
+    *out_write_time = armTicksToNs(armGetSystemTick() - start_tick);
+
+    /* Read probe data back. */
+    if (!(fp = fopen(path, "rb")))
+    {
+        LOG_MSG_ERROR("Failed to open probe file \"%s\"! (%d).", path, errno);
+        goto end;
+    }
+
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    start_tick = armGetSystemTick();
+
+    for(size_t offset = 0; offset < UMS_PROBE_DATA_SIZE; offset += block_size)
+    {
+        if (fread(buf, 1, block_size, fp) != block_size)
+        {
+            LOG_MSG_ERROR("Failed to read 0x%X-byte long probe block at offset 0x%lX!", block_size, offset);
+            goto end;
+        }
+    }
+
+    *out_read_time = armTicksToNs(armGetSystemTick() - start_tick);
+
+    /* Make sure we never divide by zero. */
+    if (!*out_write_time) *out_write_time = 1;
+    if (!*out_read_time) *out_read_time = 1;
+
+    ret = true;
+
+end:
+    if (fp) fclose(fp);
+
+    return ret;
+}
+
+NX_INLINE bool umsIsProbeThreadExitRequested(void)
+{
+    /* The exit event isn't automatically cleared, so it can be polled. */
+    return R_SUCCEEDED(waitSingle(waiterForUEvent(&g_umsProbeThreadExitEvent), 0));
+}
@@ -26,13 +26,17 @@
 #include <core/usb.h>
 
 #define USB_ABI_VERSION_MAJOR       1
-#define USB_ABI_VERSION_MINOR       2
+#define USB_ABI_VERSION_MINOR       13
 #define USB_ABI_VERSION             ((USB_ABI_VERSION_MAJOR << 4) | USB_ABI_VERSION_MINOR)
 
 #define USB_CMD_HEADER_MAGIC        0x4E584454                  /* "NXDT". */
 
 #define USB_TRANSFER_ALIGNMENT      0x1000                      /* 4 KiB. */
 #define USB_TRANSFER_TIMEOUT        10                          /* 10 seconds. */
+#define USB_TRANSFER_MIN_CHUNK_SIZE 0x100000                    /* 1 MiB. Smallest file data chunk size the host device is allowed to request. */
+
+#define USB_COMPRESSION_BUFFER_COUNT    2                                                               /* Lets us compress the next file data chunk while the previous one is being transferred. */
+#define USB_COMPRESSION_BUFFER_SIZE     (g_usbTransferBufferSize + USB_TRANSFER_ALIGNMENT)              /* Holds a frame header + a raw file data chunk. Compressed frames are never larger than raw ones. */
 
 #define USB_DEV_VID                 0x057E                      /* VID officially used by Nintendo in usb:ds. */
 #define USB_DEV_PID                 0x3000                      /* PID officially used by Nintendo in usb:ds. */
@@ -64,7 +68,18 @@ typedef enum {
     UsbCommandType_EndSession           = 4,
     UsbCommandType_StartExtractedFsDump = 5,
     UsbCommandType_EndExtractedFsDump   = 6,
-    UsbCommandType_Count                = 7     ///< Total values supported by this enum.
+    UsbCommandType_SendFileReference    = 7,
+    UsbCommandType_SendFileBatch        = 8,
+    UsbCommandType_VerifyFileChecksum   = 9,
+    UsbCommandType_ResumeFile           = 10,
+    UsbCommandType_StartNspLayout       = 11,
+    UsbCommandType_SendNspLayoutData    = 12,
+    UsbCommandType_StartLinkBenchmark   = 13,
+    UsbCommandType_StartFileDelta       = 14,
+    UsbCommandType_GetFileDeltaHashes   = 15,
+    UsbCommandType_SendFileDeltaData    = 16,
+    UsbCommandType_EndFileDelta         = 17,
+    UsbCommandType_Count                = 18    ///< Total values supported by this enum.
 } UsbCommandType;
 
 typedef struct {
@@ -82,7 +97,9 @@ typedef struct {
     u8 app_ver_micro;
     u8 abi_version;
     char git_commit[8];
-    u8 reserved[0x4];
+    u16 max_chunk_size;             ///< Largest file data chunk size we can handle, expressed in KiB. Matches the USB transfer buffer size, which depends on the memory budget.
+    u8 max_pending_transfers;       ///< Largest number of file data chunks we can keep in flight. Always USB_MAX_PENDING_TRANSFERS.
+    u8 data_endpoints;              ///< Set if a dedicated bulk endpoint pair for file data is available. Only under HOS 5.0.0+.
 } UsbCommandStartSession;
 
 NXDT_ASSERT(UsbCommandStartSession, 0x10);
@@ -92,7 +109,10 @@ typedef struct {
     u32 filename_length;
     u32 nsp_header_size;
     char filename[FS_MAX_PATH];
-    u8 reserved[0xF];
+    u8 checksum_type;           ///< UsbChecksumType. If set, the host device calculates this checksum over the file data as it arrives.
+    u8 compression_type;        ///< UsbCompressionType. If set, file data is sent as a sequence of UsbFileDataFrame entries.
+    u8 reserved[0x5];
+    u64 resume_offset;          ///< If set, the host device keeps this many bytes from the incomplete file it already holds. Only the remaining file data is sent.
 } UsbCommandSendFileProperties;
 
 NXDT_ASSERT(UsbCommandSendFileProperties, 0x320);
@@ -105,6 +125,153 @@ typedef struct {
 
 NXDT_ASSERT(UsbCommandStartExtractedFsDump, 0x310);
 
+typedef struct {
+    u64 file_size;
+    u64 src_offset;
+    u32 filename_length;
+    u32 src_filename_length;
+    char filename[FS_MAX_PATH];
+    char src_filename[FS_MAX_PATH];
+    u8 reserved[0x2];
+    u32 layout_entry_idx;       ///< NSP layout region filled with the referenced data. Only used under NSP layout mode (always non-zero), set to zero otherwise.
+} UsbCommandSendFileReference;
+
+NXDT_ASSERT(UsbCommandSendFileReference, 0x620);
+
+/* Followed by 'entry_count' UsbFileBatchRecord entries. */
+typedef struct {
+    u64 total_size;             ///< Sum of all file sizes from this batch.
+    u32 entry_count;
+    u8 reserved[0x4];
+} UsbCommandSendFileBatch;
+
+NXDT_ASSERT(UsbCommandSendFileBatch, 0x10);
+
+/* Followed by 'filename_length' bytes from the filename (without a NULL terminator), padded to an 8-byte boundary. */
+typedef struct {
+    u64 file_size;
+    u32 filename_length;
+    u8 reserved[0x4];
+} UsbFileBatchRecord;
+
+NXDT_ASSERT(UsbFileBatchRecord, 0x10);
+
+typedef struct {
+    u8 checksum_type;           ///< UsbChecksumType.
+    u8 reserved[0xF];
+    u8 checksum[0x20];          ///< CRC32 checksums are stored in little endian order, using the first 4 bytes.
+} UsbCommandVerifyFileChecksum;
+
+NXDT_ASSERT(UsbCommandVerifyFileChecksum, 0x30);
+
+/* The host device replies with a UsbFileResumeInfo block right after a successful status block. */
+typedef struct {
+    u64 file_size;
+    u32 filename_length;
+    u8 reserved_1[0x4];
+    char filename[FS_MAX_PATH];
+    u8 reserved_2[0x7];
+} UsbCommandResumeFile;
+
+NXDT_ASSERT(UsbCommandResumeFile, 0x318);
+
+/* Followed by 'entry_count' UsbNspLayoutEntry entries. */
+typedef struct {
+    u64 nsp_size;
+    u32 filename_length;
+    u32 entry_count;
+    char filename[FS_MAX_PATH];
+    u8 reserved[0x7];
+} UsbCommandStartNspLayout;
+
+NXDT_ASSERT(UsbCommandStartNspLayout, 0x318);
+
+NXDT_ASSERT(UsbNspLayoutEntry, 0x10);
+
+/* Followed by a data transfer stage for 'data_size' bytes, just like UsbCommandSendFileProperties. */
+typedef struct {
+    u32 entry_idx;
+    u8 checksum_type;           ///< UsbChecksumType. Only set if 'entry_offset' is zero. The host device calculates this checksum over the whole region.
+    u8 compression_type;        ///< UsbCompressionType.
+    u8 reserved_1[0x2];
+    u64 entry_offset;
+    u64 data_size;
+    u8 reserved_2[0x8];
+} UsbCommandSendNspLayoutData;
+
+NXDT_ASSERT(UsbCommandSendNspLayoutData, 0x20);
+
+/* Followed by a data transfer stage for 'data_size' bytes, split into 'chunk_size' bytes long transfers. The host device discards the generated data, unless 'echo' is set. */
+/* The host device replies with a UsbLinkBenchmarkHostResult block right after the status block sent at the end of the data transfer stage. */
+typedef struct {
+    u64 data_size;              ///< Always a multiple of 'chunk_size'.
+    u32 chunk_size;             ///< Always a multiple of USB_TRANSFER_ALIGNMENT, so no ZLT packets are ever involved.
+    u8 queue_depth;             ///< Number of in-flight transfers. Always 1 if 'echo' is set.
+    u8 echo;                    ///< If set, the host device writes each chunk back to us as soon as it has been received.
+    u8 reserved[0x2];
+} UsbCommandStartLinkBenchmark;
+
+NXDT_ASSERT(UsbCommandStartLinkBenchmark, 0x10);
+
+/* All times are expressed in nanoseconds. */
+typedef struct {
+    u64 elapsed_time;           ///< Time between the start of the first chunk read and the end of the last chunk read (or write, under echo mode).
+    u64 min_latency;            ///< Per-chunk read latency (read + write, under echo mode).
+    u64 max_latency;
+    u64 total_latency;
+} UsbLinkBenchmarkHostResult;
+
+NXDT_ASSERT(UsbLinkBenchmarkHostResult, 0x20);
+
+/* No data transfer stage follows this command. The host device keeps the file it already holds (if any), resized to 'file_size'. */
+typedef struct {
+    u64 file_size;
+    u32 filename_length;
+    u32 block_size;             ///< Always USB_FILE_DELTA_BLOCK_SIZE.
+    char filename[FS_MAX_PATH];
+    u8 reserved[0x7];
+} UsbCommandStartFileDelta;
+
+NXDT_ASSERT(UsbCommandStartFileDelta, 0x318);
+
+/* The host device replies with 'block_count' SHA-256 checksums right after a successful status block. Blocks it didn't fully hold before file delta mode was enabled get zeroed checksums. */
+typedef struct {
+    u64 block_idx;
+    u32 block_count;            ///< Never exceeds USB_FILE_DELTA_HASH_BATCH_COUNT.
+    u8 reserved[0x4];
+} UsbCommandGetFileDeltaHashes;
+
+NXDT_ASSERT(UsbCommandGetFileDeltaHashes, 0x10);
+
+/* Followed by a data transfer stage for 'data_size' bytes, just like UsbCommandSendFileProperties. The host device writes this data at 'offset'. */
+typedef struct {
+    u64 offset;
+    u64 data_size;
+    u8 compression_type;        ///< UsbCompressionType.
+    u8 reserved[0x7];
+} UsbCommandSendFileDeltaData;
+
+NXDT_ASSERT(UsbCommandSendFileDeltaData, 0x18);
+
+NXDT_ASSERT(UsbFileResumeInfo, 0x30);
+
+typedef enum {
+    UsbCompressionType_None  = 0,   ///< Raw data.
+    UsbCompressionType_Lz4   = 1,   ///< LZ4 block.
+    UsbCompressionType_Count = 2    ///< Total values supported by this enum.
+} UsbCompressionType;
+
+/* Used under compressed transfers. Every file data chunk is sent as a single frame, using a single transfer. Followed by 'stored_size' bytes. */
+/* Chunks that don't compress well enough are stored as-is. */
+typedef struct {
+    u32 raw_size;               ///< File data chunk size. Never exceeds the chunk size negotiated with the host device.
+    u32 stored_size;            ///< Size of the data that follows this header. Never exceeds 'raw_size'.
+    u8 compression_type;        ///< UsbCompressionType.
+    u8 reserved[0x7];
+} UsbFileDataFrame;
+
+NXDT_ASSERT(UsbFileDataFrame, 0x10);
+
 typedef enum {
     ///< Expected response code.
     UsbStatusType_Success               = 0,
@@ -120,15 +287,20 @@ typedef enum {
     UsbStatusType_UnsupportedAbiVersion = 6,
     UsbStatusType_MalformedCommand      = 7,
     UsbStatusType_HostIoError           = 8,
+    UsbStatusType_ChecksumMismatch      = 9,
 
-    UsbStatusType_Count                 = 9         ///< Total values supported by this enum.
+    UsbStatusType_Count                 = 10        ///< Total values supported by this enum.
 } UsbStatusType;
 
 typedef struct {
     u32 magic;
     u32 status;             ///< UsbStatusType.
     u16 max_packet_size;    ///< USB host endpoint max packet size.
-    u8 reserved[0x6];
+    u16 chunk_size;         ///< File data chunk size selected by the host device, expressed in KiB. Only checked in StartSession responses.
+    u8 pending_transfers;   ///< Number of in-flight file data chunks selected by the host device. Only checked in StartSession responses.
+    u8 compression_mask;    ///< Bitmask of UsbCompressionType values supported by the host device (BIT(type)). Only checked in StartSession responses.
+    u8 data_endpoints;      ///< Set if the host device will use the dedicated file data endpoint pair. Only checked in StartSession responses.
+    u8 reserved;
 } UsbStatus;
 
 NXDT_ASSERT(UsbStatus, 0x10);
@@ -193,23 +365,66 @@ struct NX_PACKED usb_ss_usb_device_capability_descriptor {
 
 NXDT_ASSERT(struct usb_ss_usb_device_capability_descriptor, 0xA);
 
+/* Reference: https://github.com/Atmosphere-NX/Atmosphere/blob/master/libraries/libstratosphere/include/stratosphere/usb/usb_types.hpp. */
+typedef enum {
+    UsbUrbStatus_Invalid   = 0,
+    UsbUrbStatus_Pending   = 1,
+    UsbUrbStatus_Running   = 2,
+    UsbUrbStatus_Finished  = 3,
+    UsbUrbStatus_Cancelled = 4,
+    UsbUrbStatus_Failed    = 5
+} UsbUrbStatus;
+
+/* Holds an asynchronous file data transfer posted to the input endpoint. */
+typedef struct {
+    u32 urb_id;
+    u64 size;
+    u64 post_tick;      ///< System tick at which the transfer was posted. Used to calculate its latency.
+    UsbFileDataTransferCallback callback;
+    void *user_data;
+} UsbPendingTransfer;
+
 /* Global variables. */
 
 static Mutex g_usbInterfaceMutex = 0;
 static UsbDsInterface *g_usbInterface = NULL;
-static UsbDsEndpoint *g_usbEndpointIn = NULL, *g_usbEndpointOut = NULL;
-static bool g_usbInterfaceInit = false, g_usbHos5xEnabled = false;
+static UsbDsEndpoint *g_usbEndpointIn = NULL, *g_usbEndpointOut = NULL, *g_usbDataEndpointIn = NULL, *g_usbDataEndpointOut = NULL;
+static bool g_usbInterfaceInit = false, g_usbHos5xEnabled = false, g_usbDataEndpointsEnabled = false;
 
 static Event *g_usbStateChangeEvent = NULL;
 static Thread g_usbDetectionThread = {0};
-static UEvent g_usbDetectionThreadExitEvent = {0}, g_usbTimeoutEvent = {0};
-static bool g_usbHostAvailable = false, g_usbSessionStarted = false, g_usbDetectionThreadExitFlag = false, g_nspTransferMode = false;
+static UEvent g_usbDetectionThreadExitEvent = {0}, g_usbTimeoutEvent = {0}, g_usbAbortEvent = {0};
+static bool g_usbHostAvailable = false, g_usbSessionStarted = false, g_usbDetectionThreadExitFlag = false, g_nspTransferMode = false, g_usbTransferAborted = false;
 static atomic_bool g_usbDetectionThreadCreated = false;
 
 static u8 *g_usbTransferBuffer = NULL;
+static u64 g_usbTransferBufferSize = 0;
 static u64 g_usbTransferRemainingSize = 0, g_usbTransferWrittenSize = 0;
 static atomic_ushort g_usbEndpointMaxPacketSize = 0;
 
+static UsbPendingTransfer g_usbPendingTransfers[USB_MAX_PENDING_TRANSFERS] = {0};
+static u32 g_usbPendingTransferIdx = 0, g_usbPendingTransferCount = 0;
+
+static u64 g_usbTransferChunkSize = USB_TRANSFER_BUFFER_SIZE;
+static u32 g_usbMaxPendingTransfers = USB_MAX_PENDING_TRANSFERS;
+
+static u8 g_usbHostCompressionMask = 0;
+static bool g_usbTransferCompressed = false;
+static u8 *g_usbCompressionBuffers[USB_COMPRESSION_BUFFER_COUNT] = {0};
+static u32 g_usbCompressionBufferIdx = 0;
+static LZ4_stream_t g_usbCompressionState = {0};
+
+static UsbTransferStats g_usbSessionTransferStats = {0}, g_usbFileTransferStats = {0};
+
+static bool g_nspLayoutMode = false;
+static UsbNspLayoutEntry g_usbNspLayoutEntries[USB_NSP_LAYOUT_MAX_ENTRY_COUNT] = {0};
+static u64 g_usbNspLayoutSentSizes[USB_NSP_LAYOUT_MAX_ENTRY_COUNT] = {0};
+static u32 g_usbNspLayoutEntryCount = 0;
+static u64 g_usbNspLayoutRemainingSize = 0;
+
+static bool g_usbFileDeltaMode = false;
+static u64 g_usbFileDeltaFileSize = 0;
+
 /* Function prototypes. */
 
 static bool usbCreateDetectionThread(void);
@@ -220,7 +435,9 @@ static bool usbStartSession(void);
 static void usbEndSession(void);
 
 NX_INLINE void usbPrepareCommandHeader(u32 cmd, u32 cmd_block_size);
-static bool usbSendCommand(void);
+NX_INLINE bool usbSendCommand(void);
+static bool usbSendCommandWithStatus(u32 *out_status);
+static bool usbSendCommandToEndpoint(UsbDsEndpoint *endpoint, u32 *out_status);
 #if LOG_LEVEL <= LOG_LEVEL_INFO
 static void usbLogStatusDetail(u32 status);
 #endif
@@ -233,15 +450,47 @@ static bool usbInitializeComms5x(void);
 static bool usbInitializeComms1x(void);
 static void usbCloseComms(void);
 
-static bool _usbSendFileProperties(u64 file_size, const char *filename, u32 nsp_header_size, bool enforce_nsp_mode);
+static bool _usbSendFileProperties(u64 file_size, const char *filename, u32 nsp_header_size, bool enforce_nsp_mode, u8 checksum_type, u64 resume_offset);
+static bool _usbSendFileData(const void *data, u64 data_size);
+
+static bool _usbRunLinkBenchmark(u64 data_size, u32 chunk_size, u32 queue_depth, bool echo, UsbLinkBenchmarkResult *out);
+static void usbGenerateLinkBenchmarkData(u8 *buf, u32 size);
+
+static bool usbValidateNspLayout(u64 nsp_size, const UsbNspLayoutEntry *entries, u32 entry_count);
+static bool usbUpdateNspLayout(u32 entry_idx, u64 data_size);
+
+static bool usbAllocateCompressionBuffers(void);
+static void usbFreeCompressionBuffers(void);
+static u64 usbGenerateFileDataFrame(const void *data, u64 data_size, void **out_frame);
+
+static bool usbWaitForPendingTransfers(bool wait_all);
+static bool usbWaitForFreePendingTransferSlot(void);
+static void usbCancelPendingTransfers(void);
+static void usbFailPendingTransfers(void);
+
+NX_INLINE void usbResetAbortState(void);
+
+static void usbResetFileTransferStats(void);
+static void usbRecordTransferLatency(u64 size, u64 start_tick);
+static void usbRecordQueueDepth(void);
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+static void usbLogTransferStats(const char *label, const UsbTransferStats *stats);
+static void usbLogLinkBenchmarkResult(const UsbLinkBenchmarkResult *result);
+#endif
 
 NX_INLINE bool usbIsHostAvailable(void);
 
-NX_INLINE void usbSetZltPacket(bool enable);
+NX_INLINE UsbDsEndpoint *usbGetDataEndpointIn(void);
+NX_INLINE UsbDsEndpoint *usbGetDataEndpointOut(void);
+
+NX_INLINE void usbSetZltPacket(UsbDsEndpoint *endpoint, bool enable);
 
 NX_INLINE bool usbRead(void *buf, size_t size);
-NX_INLINE bool usbWrite(void *buf, size_t size);
-static bool usbTransferData(void *buf, size_t size, UsbDsEndpoint *endpoint);
+static bool usbTransferData(void *buf, size_t size, UsbDsEndpoint *endpoint, bool abortable);
+
+static bool usbPostTransfer(void *buf, u64 size, UsbDsEndpoint *endpoint, u32 *out_urb_id);
+static bool usbWaitForTransfer(UsbDsEndpoint *endpoint, u32 urb_id, u64 size, bool abortable);
+static u8 usbGetTransferStatus(UsbDsEndpoint *endpoint, u32 urb_id, u32 *out_transferred_size);
 
 bool usbInitialize(void)
 {
@@ -280,6 +529,9 @@ bool usbInitialize(void)
         /* Create user-mode USB timeout event. */
         ueventCreate(&g_usbTimeoutEvent, true);
 
+        /* Create user-mode file transfer abort event. It stays signaled until the aborted file transfer is cancelled, or until a new one is started. */
+        ueventCreate(&g_usbAbortEvent, false);
+
         /* Create USB detection thread. */
         atomic_store(&g_usbDetectionThreadCreated, usbCreateDetectionThread());
         if (!atomic_load(&g_usbDetectionThreadCreated)) break;
@@ -312,6 +564,9 @@ void usbExit(void)
         /* Free USB transfer buffer. */
         usbFreeTransferBuffer();
 
+        /* Free compression buffers, if needed. */
+        usbFreeCompressionBuffers();
+
         /* Update flag. */
         g_usbInterfaceInit = false;
     }
@@ -349,128 +604,250 @@ u8 usbIsReady(void)
 bool usbSendFileProperties(u64 file_size, const char *filename)
 {
     bool ret = false;
-    SCOPED_LOCK(&g_usbInterfaceMutex) ret = _usbSendFileProperties(file_size, filename, 0, false);
+    SCOPED_LOCK(&g_usbInterfaceMutex) ret = _usbSendFileProperties(file_size, filename, 0, false, UsbChecksumType_None, 0);
     return ret;
 }
 
-bool usbSendNspProperties(u64 nsp_size, const char *filename, u32 nsp_header_size)
+bool usbSendFilePropertiesWithChecksum(u64 file_size, const char *filename, u8 checksum_type)
 {
     bool ret = false;
-    SCOPED_LOCK(&g_usbInterfaceMutex) ret = _usbSendFileProperties(nsp_size, filename, nsp_header_size, true);
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        if (checksum_type >= UsbChecksumType_Count)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        ret = _usbSendFileProperties(file_size, filename, 0, false, checksum_type, 0);
+    }
+
     return ret;
 }
 
-bool usbSendFileData(const void *data, u64 data_size)
+bool usbGetFileResumeInfo(u64 file_size, const char *filename, UsbFileResumeInfo *out)
 {
     bool ret = false;
 
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        void *buf = NULL;
-        bool zlt_required = false;
+        size_t filename_length = 0;
 
-        if (!g_usbTransferBuffer || !g_usbInterfaceInit || !g_usbHostAvailable || !g_usbSessionStarted || !g_usbTransferRemainingSize || !data || !data_size || \
-            data_size > USB_TRANSFER_BUFFER_SIZE || data_size > g_usbTransferRemainingSize)
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_nspTransferMode || g_nspLayoutMode || g_usbFileDeltaMode || g_usbTransferRemainingSize || \
+            !file_size || !filename || !(filename_length = strlen(filename)) || filename_length >= FS_MAX_PATH || !out)
         {
             LOG_MSG_ERROR("Invalid parameters!");
-            goto end;
+            break;
         }
 
-        /* Optimization for buffers that already are page aligned. */
-        if (IS_ALIGNED((u64)data, USB_TRANSFER_ALIGNMENT))
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_ResumeFile, (u32)sizeof(UsbCommandResumeFile));
+
+        UsbCommandResumeFile *cmd_block = (UsbCommandResumeFile*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandResumeFile));
+
+        cmd_block->file_size = file_size;
+        cmd_block->filename_length = (u32)filename_length;
+        snprintf(cmd_block->filename, sizeof(cmd_block->filename), "%s", filename);
+
+        /* Send command. */
+        if (!usbSendCommand()) break;
+
+        /* Read resume info block. It's smaller than the endpoint max packet size under all USB speeds, so no ZLT packet is involved. */
+        if (!usbRead(g_usbTransferBuffer, sizeof(UsbFileResumeInfo)))
         {
-            buf = (void*)data;
-        } else {
-            buf = g_usbTransferBuffer;
-            memcpy(buf, data, data_size);
+            LOG_MSG_ERROR("Failed to read 0x%lX bytes long resume info block!", sizeof(UsbFileResumeInfo));
+            break;
         }
 
-        /* Determine if we'll need to set a Zero Length Termination (ZLT) packet. */
-        /* This is automatically handled by usbDsEndpoint_PostBufferAsync(), depending on the ZLT setting from the input (write) endpoint. */
-        /* First, check if this is the last data chunk for this file. */
-        if ((g_usbTransferRemainingSize - data_size) == 0)
+        memcpy(out, g_usbTransferBuffer, sizeof(UsbFileResumeInfo));
+
+        /* Discard inconsistent resume info. */
+        if (out->offset >= file_size || out->check_size > out->offset || (out->offset && !out->check_size))
         {
-            /* Enable ZLT if the last chunk size is aligned to the USB endpoint max packet size. */
-            if (IS_ALIGNED(data_size, atomic_load(&g_usbEndpointMaxPacketSize)))
-            {
-                zlt_required = true;
-                usbSetZltPacket(true);
-                LOG_MSG_DEBUG("ZLT enabled. Last chunk size: 0x%lX bytes.", data_size);
-            }
-        } else {
-            /* Disable ZLT if this is the first of multiple data chunks. */
-            if (!g_usbTransferWrittenSize)
-            {
-                usbSetZltPacket(false);
-                LOG_MSG_DEBUG("ZLT disabled (first chunk).");
-            }
+            LOG_MSG_WARNING("Invalid resume info received from USB host! (offset 0x%lX, check size 0x%X).", out->offset, out->check_size);
+            memset(out, 0, sizeof(UsbFileResumeInfo));
+        }
+
+        LOG_MSG_DEBUG("USB host resume offset for \"%s\": 0x%lX.", filename, out->offset);
+
+        ret = true;
+    }
+
+    return ret;
+}
+
+bool usbSendFilePropertiesWithResumeOffset(u64 file_size, const char *filename, u64 resume_offset)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        if (resume_offset >= file_size)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
         }
 
-        /* Send data chunk. */
-        if (!(ret = usbWrite(buf, data_size)))
+        ret = _usbSendFileProperties(file_size, filename, 0, false, UsbChecksumType_None, resume_offset);
+    }
+
+    return ret;
+}
+
+bool usbSendNspProperties(u64 nsp_size, const char *filename, u32 nsp_header_size)
+{
+    bool ret = false;
+    SCOPED_LOCK(&g_usbInterfaceMutex) ret = _usbSendFileProperties(nsp_size, filename, nsp_header_size, true, UsbChecksumType_None, 0);
+    return ret;
+}
+
+bool usbSendFileData(const void *data, u64 data_size)
+{
+    bool ret = false;
+    SCOPED_LOCK(&g_usbInterfaceMutex) ret = (usbWaitForPendingTransfers(true) && _usbSendFileData(data, data_size));
+    return ret;
+}
+
+bool usbSendFileDataAsync(const void *data, u64 data_size, UsbFileDataTransferCallback callback, void *user_data)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        u32 urb_id = 0;
+
+        if (!g_usbTransferBuffer || !g_usbInterfaceInit || !g_usbHostAvailable || !g_usbSessionStarted || !g_usbTransferRemainingSize || !data || \
+            !IS_ALIGNED((u64)data, USB_TRANSFER_ALIGNMENT) || !data_size || data_size > USB_TRANSFER_BUFFER_SIZE || data_size > g_usbTransferRemainingSize)
         {
-            LOG_MSG_ERROR("Failed to write 0x%lX bytes long file data chunk from offset 0x%lX! (total size: 0x%lX).", data_size, g_usbTransferWrittenSize, \
-                                                                                                                      g_usbTransferRemainingSize + g_usbTransferWrittenSize);
-            goto end;
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        /* The last data chunk is always sent synchronously. The ZLT setting applies to the whole endpoint, and the host device replies with a status block right afterwards. */
+        if (data_size == g_usbTransferRemainingSize)
+        {
+            ret = (usbWaitForPendingTransfers(true) && _usbSendFileData(data, data_size));
+            if (ret && callback) callback(user_data, true);
+            break;
+        }
+
+        /* Disable ZLT if this is the first of multiple data chunks. Compressed transfers need it for every single frame (see _usbSendFileData()). */
+        if (g_usbTransferCompressed)
+        {
+            usbSetZltPacket(usbGetDataEndpointIn(), true);
+        } else if (!g_usbTransferWrittenSize)
+        {
+            usbSetZltPacket(usbGetDataEndpointIn(), false);
+            LOG_MSG_DEBUG("ZLT disabled (first chunk).");
         }
 
-        g_usbTransferRemainingSize -= data_size;
-        g_usbTransferWrittenSize += data_size;
+        /* Compressed transfers can't have more frames in flight than compression buffers. */
+        u32 max_pending_transfers = (g_usbTransferCompressed ? MIN(g_usbMaxPendingTransfers, USB_COMPRESSION_BUFFER_COUNT) : g_usbMaxPendingTransfers);
+
+        /* Split the data chunk into multiple transfers if it exceeds the chunk size negotiated with the host device. */
+        /* The callback is only attached to the last transfer. */
+        ret = true;
 
-        /* Check if this is the last chunk. */
-        if (!g_usbTransferRemainingSize)
+        for(u64 offset = 0, chunk_size = 0; offset < data_size; offset += chunk_size)
         {
-            /* Check response from host device. */
-            if (!(ret = usbRead(g_usbTransferBuffer, sizeof(UsbStatus))))
+            void *transfer_buf = ((u8*)data + offset);
+            u64 transfer_size = 0;
+
+            chunk_size = MIN(data_size - offset, g_usbTransferChunkSize);
+            transfer_size = chunk_size;
+
+            /* Wait for the oldest pending transfer to complete if we already reached the maximum number of in-flight transfers. */
+            if (g_usbPendingTransferCount >= max_pending_transfers && !usbWaitForFreePendingTransferSlot())
             {
-                LOG_MSG_ERROR("Failed to read 0x%lX bytes long status block!", sizeof(UsbStatus));
-                goto end;
+                ret = false;
+                break;
             }
 
-            UsbStatus *cmd_status = (UsbStatus*)g_usbTransferBuffer;
+            /* Compress the current data chunk. Compression buffers are used in order, so the next one is no longer in use by any pending transfer at this point. */
+            if (g_usbTransferCompressed) transfer_size = usbGenerateFileDataFrame(transfer_buf, chunk_size, &transfer_buf);
 
-            if (!(ret = (cmd_status->magic == __builtin_bswap32(USB_CMD_HEADER_MAGIC))))
+            /* Post transfer. The next one can be posted right away, so the host device never has to wait for us in between transfers. */
+            if (!usbPostTransfer(transfer_buf, transfer_size, usbGetDataEndpointIn(), &urb_id))
             {
-                LOG_MSG_ERROR("Invalid status block magic word! (0x%08X).", __builtin_bswap32(cmd_status->magic));
-                goto end;
+                LOG_MSG_ERROR("Failed to post 0x%lX bytes long file data chunk from offset 0x%lX! (total size: 0x%lX).", chunk_size, g_usbTransferWrittenSize, \
+                                                                                                                         g_usbTransferRemainingSize + g_usbTransferWrittenSize);
+                usbCancelPendingTransfers();
+                ret = false;
+                break;
             }
 
-            ret = (cmd_status->status == UsbStatusType_Success);
-#if LOG_LEVEL <= LOG_LEVEL_INFO
-            if (!ret) usbLogStatusDetail(cmd_status->status);
-#endif
+            /* Append transfer to the pending queue. */
+            bool last_chunk = ((offset + chunk_size) >= data_size);
+            UsbPendingTransfer *transfer = &(g_usbPendingTransfers[(g_usbPendingTransferIdx + g_usbPendingTransferCount) % USB_MAX_PENDING_TRANSFERS]);
+            transfer->urb_id = urb_id;
+            transfer->size = transfer_size;
+            transfer->post_tick = armGetSystemTick();
+            transfer->callback = (last_chunk ? callback : NULL);
+            transfer->user_data = (last_chunk ? user_data : NULL);
+            g_usbPendingTransferCount++;
+            usbRecordQueueDepth();
+
+            g_usbTransferRemainingSize -= chunk_size;
+            g_usbTransferWrittenSize += chunk_size;
         }
+    }
 
-end:
-        /* Disable ZLT if it was previously enabled. */
-        if (zlt_required) usbSetZltPacket(false);
+    return ret;
+}
 
-        /* Reset variables in case of errors. */
-        if (!ret)
-        {
-            g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
-            g_nspTransferMode = false;
-        }
-    }
+void usbGetTransferStats(UsbTransferStats *out)
+{
+    if (!out) return;
+    SCOPED_LOCK(&g_usbInterfaceMutex) memcpy(out, &g_usbSessionTransferStats, sizeof(UsbTransferStats));
+}
+
+void usbResetTransferStats(void)
+{
+    SCOPED_LOCK(&g_usbInterfaceMutex) memset(&g_usbSessionTransferStats, 0, sizeof(UsbTransferStats));
+}
 
+bool usbFlushFileDataTransfers(void)
+{
+    bool ret = false;
+    SCOPED_LOCK(&g_usbInterfaceMutex) ret = usbWaitForPendingTransfers(true);
     return ret;
 }
 
+void usbAbortFileTransfer(void)
+{
+    /* Don't lock: the thread that's blocked on a file data transfer is holding the interface mutex. */
+    if (atomic_load(&g_usbDetectionThreadCreated)) ueventSignal(&g_usbAbortEvent);
+}
+
 void usbCancelFileTransfer(void)
 {
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || (!g_usbTransferRemainingSize && !g_nspTransferMode)) break;
+        /* Transfer variables have already been reset if the ongoing file transfer was aborted, but the host device still expects a CancelFileTransfer command. */
+        bool aborted = g_usbTransferAborted, data_stage = (g_usbTransferRemainingSize || aborted);
+
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || (!g_usbTransferRemainingSize && !g_nspTransferMode && !g_nspLayoutMode && \
+            !g_usbFileDeltaMode && !aborted)) break;
+
+        usbResetAbortState();
+
+        /* Cancel pending asynchronous file data transfers, if any. */
+        usbCancelPendingTransfers();
 
         /* Reset variables right away. */
         g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
-        g_nspTransferMode = false;
+        g_usbTransferCompressed = false;
+        g_nspTransferMode = g_nspLayoutMode = g_usbFileDeltaMode = false;
 
         /* Prepare command data. */
         usbPrepareCommandHeader(UsbCommandType_CancelFileTransfer, 0);
 
         /* Send command. We don't care about the result here. */
-        usbSendCommand();
+        /* If a data transfer stage is taking place, the command header must be written to the same endpoint the host device is reading file data from. */
+        /* The status block is still read from the main endpoint pair. */
+        usbSendCommandToEndpoint(data_stage ? usbGetDataEndpointIn() : g_usbEndpointIn, NULL);
     }
 }
 
@@ -481,7 +858,7 @@ bool usbSendNspHeader(const void *nsp_header, u32 nsp_header_size)
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
         if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || !g_nspTransferMode || !nsp_header || \
-            !nsp_header_size || nsp_header_size > (USB_TRANSFER_BUFFER_SIZE - sizeof(UsbCommandHeader)))
+            !nsp_header_size || nsp_header_size > (g_usbTransferBufferSize - sizeof(UsbCommandHeader)))
         {
             LOG_MSG_ERROR("Invalid parameters!");
             break;
@@ -501,438 +878,1311 @@ bool usbSendNspHeader(const void *nsp_header, u32 nsp_header_size)
     return ret;
 }
 
-bool usbStartExtractedFsDump(u64 extracted_fs_size, const char *extracted_fs_root_path)
+bool usbSendFileReference(u64 file_size, const char *filename, const char *src_filename, u64 src_offset)
 {
     bool ret = false;
 
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode || !extracted_fs_size || \
-            !extracted_fs_root_path || !*extracted_fs_root_path) break;
+        size_t filename_length = 0, src_filename_length = 0;
+
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || !g_nspTransferMode || !file_size || \
+            !filename || !(filename_length = strlen(filename)) || filename_length >= FS_MAX_PATH || !src_filename || !(src_filename_length = strlen(src_filename)) || \
+            src_filename_length >= FS_MAX_PATH)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
 
         /* Prepare command data. */
-        usbPrepareCommandHeader(UsbCommandType_StartExtractedFsDump, (u32)sizeof(UsbCommandStartExtractedFsDump));
+        usbPrepareCommandHeader(UsbCommandType_SendFileReference, (u32)sizeof(UsbCommandSendFileReference));
 
-        UsbCommandStartExtractedFsDump *cmd_block = (UsbCommandStartExtractedFsDump*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
-        memset(cmd_block, 0, sizeof(UsbCommandStartExtractedFsDump));
+        UsbCommandSendFileReference *cmd_block = (UsbCommandSendFileReference*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandSendFileReference));
 
-        cmd_block->extracted_fs_size = extracted_fs_size;
-        snprintf(cmd_block->extracted_fs_root_path, sizeof(cmd_block->extracted_fs_root_path), "%s", extracted_fs_root_path);
+        cmd_block->file_size = file_size;
+        cmd_block->src_offset = src_offset;
+        cmd_block->filename_length = (u32)filename_length;
+        cmd_block->src_filename_length = (u32)src_filename_length;
+        snprintf(cmd_block->filename, sizeof(cmd_block->filename), "%s", filename);
+        snprintf(cmd_block->src_filename, sizeof(cmd_block->src_filename), "%s", src_filename);
 
-        /* Send command. */
-        ret = usbSendCommand();
+        /* Send command. The host device takes care of copying the referenced data, so no data transfer stage follows. */
+        if (!(ret = usbSendCommand())) g_nspTransferMode = false;
     }
 
     return ret;
 }
 
-void usbEndExtractedFsDump(void)
+bool usbStartNspLayout(u64 nsp_size, const char *filename, const UsbNspLayoutEntry *entries, u32 entry_count)
 {
+    bool ret = false;
+
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode) break;
+        size_t filename_length = 0;
 
-        /* Prepare command data. */
-        usbPrepareCommandHeader(UsbCommandType_EndExtractedFsDump, 0);
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode || g_nspLayoutMode || g_usbFileDeltaMode || \
+            !filename || !(filename_length = strlen(filename)) || filename_length >= FS_MAX_PATH || !usbValidateNspLayout(nsp_size, entries, entry_count))
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
 
-        /* Send command. We don't care about the result here. */
-        usbSendCommand();
-    }
-}
+        UsbCommandStartNspLayout *cmd_block = (UsbCommandStartNspLayout*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        u64 layout_size = (entry_count * sizeof(UsbNspLayoutEntry));
 
-static bool usbCreateDetectionThread(void)
-{
-    if (!utilsCreateThread(&g_usbDetectionThread, usbDetectionThreadFunc, NULL, 1))
-    {
-        LOG_MSG_ERROR("Failed to create USB detection thread!");
-        return false;
-    }
+        memset(cmd_block, 0, sizeof(UsbCommandStartNspLayout));
 
-    return true;
-}
+        cmd_block->nsp_size = nsp_size;
+        cmd_block->filename_length = (u32)filename_length;
+        cmd_block->entry_count = entry_count;
+        snprintf(cmd_block->filename, sizeof(cmd_block->filename), "%s", filename);
 
-static void usbDestroyDetectionThread(void)
-{
-    /* Signal the exit event to terminate the USB detection thread */
-    ueventSignal(&g_usbDetectionThreadExitEvent);
+        /* Region records are placed right after the command block. Even with USB_NSP_LAYOUT_MAX_ENTRY_COUNT records, this is way smaller than the transfer buffer. */
+        memcpy((u8*)cmd_block + sizeof(UsbCommandStartNspLayout), entries, layout_size);
 
-    /* Wait for the USB detection thread to exit. */
-    utilsJoinThread(&g_usbDetectionThread);
-}
+        /* Prepare command header. The command block size depends on the number of regions. */
+        usbPrepareCommandHeader(UsbCommandType_StartNspLayout, (u32)(sizeof(UsbCommandStartNspLayout) + layout_size));
 
-static void usbDetectionThreadFunc(void *arg)
-{
-    NX_IGNORE_ARG(arg);
+        /* Send command. No data transfer stage follows it. */
+        if (!(ret = usbSendCommand())) break;
 
-    Result rc = 0;
-    int idx = 0;
+        /* Keep track of the data sent for each region, so we can tell when the whole NSP has been sent. */
+        memcpy(g_usbNspLayoutEntries, entries, layout_size);
+        memset(g_usbNspLayoutSentSizes, 0, sizeof(g_usbNspLayoutSentSizes));
+        g_usbNspLayoutEntryCount = entry_count;
+        g_usbNspLayoutRemainingSize = nsp_size;
+        g_nspLayoutMode = true;
 
-    Waiter usb_change_event_waiter = waiterForEvent(g_usbStateChangeEvent);
-    Waiter usb_timeout_event_waiter = waiterForUEvent(&g_usbTimeoutEvent);
-    Waiter exit_event_waiter = waiterForUEvent(&g_usbDetectionThreadExitEvent);
+        LOG_MSG_DEBUG("NSP layout mode enabled for \"%s\" (0x%lX bytes, %u region[s]).", filename, nsp_size, entry_count);
+    }
 
-    bool exit_flag = false;
+    return ret;
+}
 
-    while(true)
-    {
-        /* Wait until an event is triggered. */
-        rc = waitMulti(&idx, -1, usb_change_event_waiter, usb_timeout_event_waiter, exit_event_waiter);
-        if (R_FAILED(rc)) continue;
+bool usbSendNspLayoutData(u32 entry_idx, u64 entry_offset, u64 data_size, u8 checksum_type)
+{
+    bool ret = false;
 
-        /* Exit event triggered. */
-        if (idx == 2) break;
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        bool compressed = false;
 
-        SCOPED_LOCK(&g_usbInterfaceMutex)
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || !g_nspLayoutMode || \
+            entry_idx >= g_usbNspLayoutEntryCount || !data_size || checksum_type >= UsbChecksumType_Count || (checksum_type != UsbChecksumType_None && entry_offset) || \
+            entry_offset >= g_usbNspLayoutEntries[entry_idx].size || data_size > (g_usbNspLayoutEntries[entry_idx].size - entry_offset) || \
+            data_size > (g_usbNspLayoutEntries[entry_idx].size - g_usbNspLayoutSentSizes[entry_idx]))
         {
-            /* Retrieve current USB connection status. */
-            /* Only proceed if we're dealing with a status change. */
-            g_usbHostAvailable = usbIsHostAvailable();
-            g_usbSessionStarted = false;
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_SendNspLayoutData, (u32)sizeof(UsbCommandSendNspLayoutData));
+
+        UsbCommandSendNspLayoutData *cmd_block = (UsbCommandSendNspLayoutData*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandSendNspLayoutData));
+
+        cmd_block->entry_idx = entry_idx;
+        cmd_block->checksum_type = checksum_type;
+        cmd_block->entry_offset = entry_offset;
+        cmd_block->data_size = data_size;
+
+        /* Compress region data if the user asked us to and the USB host supports it. Falls back to raw transfers if we can't allocate the compression buffers. */
+        compressed = ((g_usbHostCompressionMask & BIT(UsbCompressionType_Lz4)) && configGetBoolean("usb_compression") && usbAllocateCompressionBuffers());
+        cmd_block->compression_type = (compressed ? UsbCompressionType_Lz4 : UsbCompressionType_None);
+
+        /* Send command. The data transfer stage works just like the one from a regular file. */
+        usbResetAbortState();
+        ret = usbSendCommand();
+        if (ret)
+        {
+            g_usbTransferRemainingSize = data_size;
+            g_usbTransferWrittenSize = 0;
+            usbResetFileTransferStats();
+            g_usbTransferCompressed = compressed;
+
+            /* NSP layout mode ends with the last region data sent. The pending data transfer stage still keeps other commands from being issued. */
+            if (!usbUpdateNspLayout(entry_idx, data_size)) LOG_MSG_DEBUG("NSP layout mode disabled (last region data).");
+        } else {
             g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
-            atomic_store(&g_usbEndpointMaxPacketSize, 0);
+            g_usbTransferCompressed = false;
+            g_nspLayoutMode = false;
+        }
+    }
 
-            /* Start a USB session if we're connected to a host device. */
-            /* This will essentially hang this thread and all other threads that call USB-related functions until: */
-            /* a) A session is successfully established. */
-            /* b) The console is disconnected from the USB host. */
-            /* c) The thread exit event is triggered. */
-            if (g_usbHostAvailable)
-            {
-                /* Wait until a session is established. */
-                g_usbSessionStarted = usbStartSession();
-                if (g_usbSessionStarted)
-                {
-                    LOG_MSG_INFO("USB session successfully established. Endpoint max packet size: 0x%04X.", atomic_load(&g_usbEndpointMaxPacketSize));
-                } else {
-                    /* Update exit flag. */
-                    exit_flag = g_usbDetectionThreadExitFlag;
-                }
-            }
+    return ret;
+}
+
+bool usbSendNspLayoutReference(u32 entry_idx, const char *entry_name, const char *src_filename, u64 src_offset)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        size_t filename_length = 0, src_filename_length = 0;
+
+        /* The NSP header region can't be referenced. */
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || !g_nspLayoutMode || !entry_idx || \
+            entry_idx >= g_usbNspLayoutEntryCount || g_usbNspLayoutSentSizes[entry_idx] || !entry_name || !(filename_length = strlen(entry_name)) || filename_length >= FS_MAX_PATH || \
+            !src_filename || !(src_filename_length = strlen(src_filename)) || src_filename_length >= FS_MAX_PATH)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
         }
 
-        /* Check if the exit event was triggered while waiting for a session to be established. */
-        if (exit_flag) break;
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_SendFileReference, (u32)sizeof(UsbCommandSendFileReference));
+
+        UsbCommandSendFileReference *cmd_block = (UsbCommandSendFileReference*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandSendFileReference));
+
+        cmd_block->file_size = g_usbNspLayoutEntries[entry_idx].size;
+        cmd_block->src_offset = src_offset;
+        cmd_block->filename_length = (u32)filename_length;
+        cmd_block->src_filename_length = (u32)src_filename_length;
+        snprintf(cmd_block->filename, sizeof(cmd_block->filename), "%s", entry_name);
+        snprintf(cmd_block->src_filename, sizeof(cmd_block->src_filename), "%s", src_filename);
+        cmd_block->layout_entry_idx = entry_idx;
+
+        /* Send command. The host device takes care of copying the referenced data to the region offset, so no data transfer stage follows. */
+        if (!(ret = usbSendCommand()))
+        {
+            g_nspLayoutMode = false;
+            break;
+        }
+
+        if (!usbUpdateNspLayout(entry_idx, g_usbNspLayoutEntries[entry_idx].size)) LOG_MSG_DEBUG("NSP layout mode disabled (last region reference).");
     }
 
+    return ret;
+}
+
+bool usbStartFileDelta(u64 file_size, const char *filename)
+{
+    bool ret = false;
+
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        /* Close USB session if needed. */
-        if (g_usbHostAvailable && g_usbSessionStarted) usbEndSession();
-        g_usbHostAvailable = g_usbSessionStarted = g_usbDetectionThreadExitFlag = false;
-        g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
-        atomic_store(&g_usbEndpointMaxPacketSize, 0);
+        size_t filename_length = 0;
+
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode || g_nspLayoutMode || g_usbFileDeltaMode || \
+            !file_size || !filename || !(filename_length = strlen(filename)) || filename_length >= FS_MAX_PATH)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_StartFileDelta, (u32)sizeof(UsbCommandStartFileDelta));
+
+        UsbCommandStartFileDelta *cmd_block = (UsbCommandStartFileDelta*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandStartFileDelta));
+
+        cmd_block->file_size = file_size;
+        cmd_block->filename_length = (u32)filename_length;
+        cmd_block->block_size = USB_FILE_DELTA_BLOCK_SIZE;
+        snprintf(cmd_block->filename, sizeof(cmd_block->filename), "%s", filename);
+
+        /* Send command. No data transfer stage follows it. */
+        if (!(ret = usbSendCommand())) break;
+
+        g_usbFileDeltaMode = true;
+        g_usbFileDeltaFileSize = file_size;
+
+        LOG_MSG_DEBUG("File delta mode enabled for \"%s\" (0x%lX bytes).", filename, file_size);
     }
 
-    threadExit();
+    return ret;
 }
 
-static bool usbStartSession(void)
+bool usbGetFileDeltaHashes(u64 block_idx, u32 block_count, u8 *out_hashes)
 {
-    UsbCommandStartSession *cmd_block = NULL;
     bool ret = false;
 
-    if (!g_usbInterfaceInit || !g_usbTransferBuffer)
+    SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        LOG_MSG_ERROR("Invalid parameters!");
-        goto end;
-    }
+        u64 total_block_count = (ALIGN_UP(g_usbFileDeltaFileSize, USB_FILE_DELTA_BLOCK_SIZE) / USB_FILE_DELTA_BLOCK_SIZE);
+        u64 hashes_size = ((u64)block_count * SHA256_HASH_SIZE);
 
-    usbPrepareCommandHeader(UsbCommandType_StartSession, (u32)sizeof(UsbCommandStartSession));
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || !g_usbFileDeltaMode || !block_count || \
+            block_count > USB_FILE_DELTA_HASH_BATCH_COUNT || block_idx >= total_block_count || block_count > (total_block_count - block_idx) || !out_hashes)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
 
-    cmd_block = (UsbCommandStartSession*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
-    memset(cmd_block, 0, sizeof(UsbCommandStartSession));
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_GetFileDeltaHashes, (u32)sizeof(UsbCommandGetFileDeltaHashes));
 
-    cmd_block->app_ver_major = VERSION_MAJOR;
-    cmd_block->app_ver_minor = VERSION_MINOR;
-    cmd_block->app_ver_micro = VERSION_MICRO;
-    cmd_block->abi_version = USB_ABI_VERSION;
-    snprintf(cmd_block->git_commit, sizeof(cmd_block->git_commit), "%s", GIT_COMMIT);
+        UsbCommandGetFileDeltaHashes *cmd_block = (UsbCommandGetFileDeltaHashes*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandGetFileDeltaHashes));
 
-    ret = usbSendCommand();
-    if (ret)
+        cmd_block->block_idx = block_idx;
+        cmd_block->block_count = block_count;
+
+        /* Send command. */
+        if (!usbSendCommand()) break;
+
+        /* Read block checksums. We ask for their exact size, so no ZLT packet is involved. */
+        if (!usbRead(g_usbTransferBuffer, hashes_size))
+        {
+            LOG_MSG_ERROR("Failed to read 0x%lX bytes long block checksum list!", hashes_size);
+            break;
+        }
+
+        memcpy(out_hashes, g_usbTransferBuffer, hashes_size);
+
+        ret = true;
+    }
+
+    return ret;
+}
+
+bool usbSendFileDeltaData(u64 offset, u64 data_size)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        /* Get the endpoint max packet size from the response sent by the USB host. */
-        /* This is done to accurately know when and where to enable Zero Length Termination (ZLT) packets during bulk transfers. */
-        /* As much as I'd like to avoid this, the GetUsbDeviceSpeed cmd from usb:ds is only available in HOS 8.0.0+ -- and we definitely want to provide USB comms under older versions. */
-        u16 max_packet_size = ((UsbStatus*)g_usbTransferBuffer)->max_packet_size;
-        if (max_packet_size != USB_FS_EP_MAX_PACKET_SIZE && max_packet_size != USB_HS_EP_MAX_PACKET_SIZE && max_packet_size != USB_SS_EP_MAX_PACKET_SIZE)
+        bool compressed = false;
+
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || !g_usbFileDeltaMode || !data_size || \
+            offset >= g_usbFileDeltaFileSize || data_size > (g_usbFileDeltaFileSize - offset))
         {
-            LOG_MSG_ERROR("Invalid endpoint max packet size value received from USB host: 0x%04X.", max_packet_size);
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
 
-            /* Reset flags. */
-            ret = false;
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_SendFileDeltaData, (u32)sizeof(UsbCommandSendFileDeltaData));
+
+        UsbCommandSendFileDeltaData *cmd_block = (UsbCommandSendFileDeltaData*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandSendFileDeltaData));
+
+        cmd_block->offset = offset;
+        cmd_block->data_size = data_size;
+
+        /* Compress file data if the user asked us to and the USB host supports it. Falls back to raw transfers if we can't allocate the compression buffers. */
+        compressed = ((g_usbHostCompressionMask & BIT(UsbCompressionType_Lz4)) && configGetBoolean("usb_compression") && usbAllocateCompressionBuffers());
+        cmd_block->compression_type = (compressed ? UsbCompressionType_Lz4 : UsbCompressionType_None);
+
+        /* Send command. The data transfer stage works just like the one from a regular file. */
+        usbResetAbortState();
+        ret = usbSendCommand();
+        if (ret)
+        {
+            g_usbTransferRemainingSize = data_size;
+            g_usbTransferWrittenSize = 0;
+            usbResetFileTransferStats();
+            g_usbTransferCompressed = compressed;
         } else {
-            atomic_store(&g_usbEndpointMaxPacketSize, max_packet_size);
+            g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
+            g_usbTransferCompressed = false;
+            g_usbFileDeltaMode = false;
         }
     }
 
-end:
     return ret;
 }
 
-static void usbEndSession(void)
+bool usbEndFileDelta(void)
 {
-    if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted)
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return;
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || !g_usbFileDeltaMode)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        /* Disable file delta mode right away. */
+        g_usbFileDeltaMode = false;
+
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_EndFileDelta, 0);
+
+        /* Send command. */
+        ret = usbSendCommand();
+        if (ret) LOG_MSG_DEBUG("File delta mode disabled.");
     }
 
-    /* Prepare command data. */
-    usbPrepareCommandHeader(UsbCommandType_EndSession, 0);
+    return ret;
+}
 
-    /* Send command. We don't care about the result here. */
-    usbSendCommand();
+bool usbSendFileBatch(const UsbFileBatchEntry *entries, u32 entry_count)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode || g_nspLayoutMode || g_usbFileDeltaMode || \
+            !entries || !entry_count || entry_count > USB_FILE_BATCH_MAX_ENTRY_COUNT)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        UsbCommandSendFileBatch *cmd_block = (UsbCommandSendFileBatch*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        u8 *record_ptr = ((u8*)cmd_block + sizeof(UsbCommandSendFileBatch));
+        u64 total_size = 0;
+        bool success = true;
+
+        memset(cmd_block, 0, sizeof(UsbCommandSendFileBatch));
+
+        /* Generate file records. They're placed right after the command block header. */
+        for(u32 i = 0; i < entry_count; i++)
+        {
+            const UsbFileBatchEntry *entry = &(entries[i]);
+            size_t filename_length = 0, record_size = 0;
+
+            if (!entry->filename || !(filename_length = strlen(entry->filename)) || filename_length >= FS_MAX_PATH)
+            {
+                LOG_MSG_ERROR("Invalid filename for file batch entry #%u!", i);
+                success = false;
+                break;
+            }
+
+            /* The worst case scenario (USB_FILE_BATCH_MAX_ENTRY_COUNT records with FS_MAX_PATH long filenames) still fits within the transfer buffer. */
+            record_size = ALIGN_UP(sizeof(UsbFileBatchRecord) + filename_length, 8);
+
+            UsbFileBatchRecord *record = (UsbFileBatchRecord*)record_ptr;
+            memset(record, 0, record_size);
+
+            record->file_size = entry->file_size;
+            record->filename_length = (u32)filename_length;
+            memcpy(record_ptr + sizeof(UsbFileBatchRecord), entry->filename, filename_length);
+
+            total_size += entry->file_size;
+            record_ptr += record_size;
+        }
+
+        if (!success) break;
+
+        cmd_block->total_size = total_size;
+        cmd_block->entry_count = entry_count;
+
+        /* Prepare command header. The command block size depends on the length of every filename. */
+        usbPrepareCommandHeader(UsbCommandType_SendFileBatch, (u32)(record_ptr - (u8*)cmd_block));
+
+        /* Send command. The data from all file entries follows as if it were a single file. */
+        usbResetAbortState();
+        ret = usbSendCommand();
+        if (ret) usbResetFileTransferStats();
+        g_usbTransferRemainingSize = (ret ? total_size : 0);
+        g_usbTransferWrittenSize = 0;
+        g_usbTransferCompressed = false;
+    }
+
+    return ret;
 }
 
-NX_INLINE void usbPrepareCommandHeader(u32 cmd, u32 cmd_block_size)
+bool usbVerifyFileChecksum(u8 checksum_type, const void *checksum, bool *out_match)
 {
-    if (cmd >= UsbCommandType_Count) return;
-    UsbCommandHeader *cmd_header = (UsbCommandHeader*)g_usbTransferBuffer;
-    memset(cmd_header, 0, sizeof(UsbCommandHeader));
-    cmd_header->magic = __builtin_bswap32(USB_CMD_HEADER_MAGIC);
-    cmd_header->cmd = cmd;
-    cmd_header->cmd_block_size = cmd_block_size;
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        u32 status = UsbStatusType_Success;
+
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || checksum_type == UsbChecksumType_None || \
+            checksum_type >= UsbChecksumType_Count || !checksum || !out_match)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_VerifyFileChecksum, (u32)sizeof(UsbCommandVerifyFileChecksum));
+
+        UsbCommandVerifyFileChecksum *cmd_block = (UsbCommandVerifyFileChecksum*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandVerifyFileChecksum));
+
+        cmd_block->checksum_type = checksum_type;
+        memcpy(cmd_block->checksum, checksum, checksum_type == UsbChecksumType_Crc32 ? sizeof(u32) : SHA256_HASH_SIZE);
+
+        /* Send command. A checksum mismatch isn't considered a communication error. */
+        ret = (usbSendCommandWithStatus(&status) || status == UsbStatusType_ChecksumMismatch);
+        if (ret) *out_match = (status == UsbStatusType_Success);
+    }
+
+    return ret;
 }
 
-static bool usbSendCommand(void)
+bool usbRunLinkBenchmark(u64 data_size, u32 chunk_size, u32 queue_depth, bool echo, UsbLinkBenchmarkResult *out)
 {
-    UsbCommandHeader *cmd_header = (UsbCommandHeader*)g_usbTransferBuffer;
-    u32 cmd_block_size = cmd_header->cmd_block_size;
+    bool ret = false;
+    SCOPED_LOCK(&g_usbInterfaceMutex) ret = _usbRunLinkBenchmark(data_size, chunk_size, queue_depth, echo, out);
+    return ret;
+}
 
-#if LOG_LEVEL <= LOG_LEVEL_ERROR
-    u32 cmd = cmd_header->cmd;
-#endif
+bool usbRunLinkBenchmarkSweep(u64 data_size, UsbLinkBenchmarkResult *out_best)
+{
+    bool ret = false;
 
-#if LOG_LEVEL <= LOG_LEVEL_INFO
-    UsbCommandHeader cmd_header_bkp = {0};
-    memcpy(&cmd_header_bkp, cmd_header, sizeof(UsbCommandHeader));
-#endif
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        UsbLinkBenchmarkResult result = {0};
+        double best_throughput = 0.0;
+
+        if (!data_size || !out_best)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        memset(out_best, 0, sizeof(UsbLinkBenchmarkResult));
+
+        /* Chunk sizes and queue depths are tried in ascending order. */
+        /* Larger values only replace the current best result if they're at least 2% faster, since they take up more memory on both sides. */
+        ret = true;
+
+        for(u64 chunk_size = USB_LINK_BENCHMARK_MIN_CHUNK_SIZE; ret && chunk_size <= g_usbTransferBufferSize; chunk_size <<= 1)
+        {
+            for(u32 queue_depth = 1; queue_depth <= USB_MAX_PENDING_TRANSFERS; queue_depth <<= 1)
+            {
+                if (!(ret = _usbRunLinkBenchmark(ALIGN_UP(data_size, chunk_size), (u32)chunk_size, queue_depth, false, &result))) break;
+
+                double throughput = usbGetLinkBenchmarkThroughput(&result, false);
+                if (throughput <= (best_throughput * 1.02)) continue;
+
+                memcpy(out_best, &result, sizeof(UsbLinkBenchmarkResult));
+                best_throughput = throughput;
+            }
+        }
+
+        if (ret) LOG_MSG_INFO("Recommended USB transfer parameters: chunk size 0x%X, %u in-flight chunk(s).", out_best->chunk_size, out_best->queue_depth);
+    }
+
+    return ret;
+}
+
+bool usbStartExtractedFsDump(u64 extracted_fs_size, const char *extracted_fs_root_path)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode || g_nspLayoutMode || g_usbFileDeltaMode || \
+            !extracted_fs_size || !extracted_fs_root_path || !*extracted_fs_root_path) break;
+
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_StartExtractedFsDump, (u32)sizeof(UsbCommandStartExtractedFsDump));
+
+        UsbCommandStartExtractedFsDump *cmd_block = (UsbCommandStartExtractedFsDump*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+        memset(cmd_block, 0, sizeof(UsbCommandStartExtractedFsDump));
+
+        cmd_block->extracted_fs_size = extracted_fs_size;
+        snprintf(cmd_block->extracted_fs_root_path, sizeof(cmd_block->extracted_fs_root_path), "%s", extracted_fs_root_path);
+
+        /* Send command. */
+        ret = usbSendCommand();
+    }
+
+    return ret;
+}
+
+void usbEndExtractedFsDump(void)
+{
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode || g_nspLayoutMode || \
+            g_usbFileDeltaMode) break;
+
+        /* Prepare command data. */
+        usbPrepareCommandHeader(UsbCommandType_EndExtractedFsDump, 0);
+
+        /* Send command. We don't care about the result here. */
+        usbSendCommand();
+    }
+}
+
+static bool usbCreateDetectionThread(void)
+{
+    if (!utilsCreateThread(&g_usbDetectionThread, usbDetectionThreadFunc, NULL, 1))
+    {
+        LOG_MSG_ERROR("Failed to create USB detection thread!");
+        return false;
+    }
+
+    return true;
+}
+
+static void usbDestroyDetectionThread(void)
+{
+    /* Signal the exit event to terminate the USB detection thread */
+    ueventSignal(&g_usbDetectionThreadExitEvent);
+
+    /* Wait for the USB detection thread to exit. */
+    utilsJoinThread(&g_usbDetectionThread);
+}
+
+static void usbDetectionThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    Result rc = 0;
+    int idx = 0;
+
+    Waiter usb_change_event_waiter = waiterForEvent(g_usbStateChangeEvent);
+    Waiter usb_timeout_event_waiter = waiterForUEvent(&g_usbTimeoutEvent);
+    Waiter exit_event_waiter = waiterForUEvent(&g_usbDetectionThreadExitEvent);
+
+    bool exit_flag = false;
+
+    while(true)
+    {
+        /* Wait until an event is triggered. */
+        rc = waitMulti(&idx, -1, usb_change_event_waiter, usb_timeout_event_waiter, exit_event_waiter);
+        if (R_FAILED(rc)) continue;
+
+        /* Exit event triggered. */
+        if (idx == 2) break;
+
+        SCOPED_LOCK(&g_usbInterfaceMutex)
+        {
+            /* Retrieve current USB connection status. */
+            /* Only proceed if we're dealing with a status change. */
+            g_usbHostAvailable = usbIsHostAvailable();
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+            if (g_usbSessionStarted) usbLogTransferStats("USB session", &g_usbSessionTransferStats);
+#endif
+            g_usbSessionStarted = false;
+            usbCancelPendingTransfers();
+            usbResetAbortState();
+            g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
+            g_usbTransferCompressed = g_usbDataEndpointsEnabled = false;
+            atomic_store(&g_usbEndpointMaxPacketSize, 0);
+
+            /* Start a USB session if we're connected to a host device. */
+            /* This will essentially hang this thread and all other threads that call USB-related functions until: */
+            /* a) A session is successfully established. */
+            /* b) The console is disconnected from the USB host. */
+            /* c) The thread exit event is triggered. */
+            if (g_usbHostAvailable)
+            {
+                /* Wait until a session is established. */
+                g_usbSessionStarted = usbStartSession();
+                if (g_usbSessionStarted)
+                {
+                    memset(&g_usbSessionTransferStats, 0, sizeof(UsbTransferStats));
+                    LOG_MSG_INFO("USB session successfully established. Endpoint max packet size: 0x%04X. Chunk size: 0x%lX. Pending transfers: %u. Data endpoints: %s.", \
+                                 atomic_load(&g_usbEndpointMaxPacketSize), g_usbTransferChunkSize, g_usbMaxPendingTransfers, g_usbDataEndpointsEnabled ? "yes" : "no");
+                } else {
+                    /* Update exit flag. */
+                    exit_flag = g_usbDetectionThreadExitFlag;
+                }
+            }
+        }
+
+        /* Check if the exit event was triggered while waiting for a session to be established. */
+        if (exit_flag) break;
+    }
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        /* Close USB session if needed. */
+        usbCancelPendingTransfers();
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+        if (g_usbSessionStarted) usbLogTransferStats("USB session", &g_usbSessionTransferStats);
+#endif
+        if (g_usbHostAvailable && g_usbSessionStarted) usbEndSession();
+        g_usbHostAvailable = g_usbSessionStarted = g_usbDetectionThreadExitFlag = false;
+        g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
+        g_usbTransferCompressed = false;
+        atomic_store(&g_usbEndpointMaxPacketSize, 0);
+    }
+
+    threadExit();
+}
+
+static bool usbStartSession(void)
+{
+    UsbCommandStartSession *cmd_block = NULL;
+    bool ret = false, data_endpoints = (g_usbDataEndpointIn && g_usbDataEndpointOut);
+
+    if (!g_usbInterfaceInit || !g_usbTransferBuffer)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        goto end;
+    }
+
+    usbPrepareCommandHeader(UsbCommandType_StartSession, (u32)sizeof(UsbCommandStartSession));
+
+    cmd_block = (UsbCommandStartSession*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+    memset(cmd_block, 0, sizeof(UsbCommandStartSession));
+
+    cmd_block->app_ver_major = VERSION_MAJOR;
+    cmd_block->app_ver_minor = VERSION_MINOR;
+    cmd_block->app_ver_micro = VERSION_MICRO;
+    cmd_block->abi_version = USB_ABI_VERSION;
+    snprintf(cmd_block->git_commit, sizeof(cmd_block->git_commit), "%s", GIT_COMMIT);
+    cmd_block->max_chunk_size = (u16)(g_usbTransferBufferSize / 0x400);
+    cmd_block->max_pending_transfers = USB_MAX_PENDING_TRANSFERS;
+    cmd_block->data_endpoints = data_endpoints;
+
+    ret = usbSendCommand();
+    if (ret)
+    {
+        UsbStatus *cmd_status = (UsbStatus*)g_usbTransferBuffer;
+
+        /* Get the endpoint max packet size from the response sent by the USB host. */
+        /* This is done to accurately know when and where to enable Zero Length Termination (ZLT) packets during bulk transfers. */
+        /* As much as I'd like to avoid this, the GetUsbDeviceSpeed cmd from usb:ds is only available in HOS 8.0.0+ -- and we definitely want to provide USB comms under older versions. */
+        u16 max_packet_size = cmd_status->max_packet_size;
+        if (max_packet_size != USB_FS_EP_MAX_PACKET_SIZE && max_packet_size != USB_HS_EP_MAX_PACKET_SIZE && max_packet_size != USB_SS_EP_MAX_PACKET_SIZE)
+        {
+            LOG_MSG_ERROR("Invalid endpoint max packet size value received from USB host: 0x%04X.", max_packet_size);
+
+            /* Reset flags. */
+            ret = false;
+            goto end;
+        }
+
+        /* Get the file data chunk size and the number of in-flight chunks selected by the USB host. */
+        /* These are picked by the host device based on the link speed and its available memory, and must never exceed the values we sent. */
+        u64 chunk_size = ((u64)cmd_status->chunk_size * 0x400);
+        u8 pending_transfers = cmd_status->pending_transfers;
+        if (chunk_size < USB_TRANSFER_MIN_CHUNK_SIZE || chunk_size > g_usbTransferBufferSize || !IS_ALIGNED(chunk_size, USB_TRANSFER_ALIGNMENT) || \
+            !pending_transfers || pending_transfers > USB_MAX_PENDING_TRANSFERS)
+        {
+            LOG_MSG_ERROR("Invalid transfer parameters received from USB host! (chunk size: 0x%lX, pending transfers: %u).", chunk_size, pending_transfers);
+
+            /* Reset flags. */
+            ret = false;
+            goto end;
+        }
+
+        atomic_store(&g_usbEndpointMaxPacketSize, max_packet_size);
+        g_usbTransferChunkSize = chunk_size;
+        g_usbMaxPendingTransfers = pending_transfers;
+
+        /* Get the compression types supported by the USB host. Raw data is always supported. */
+        g_usbHostCompressionMask = (cmd_status->compression_mask & (u8)(BIT(UsbCompressionType_Count) - 1) & (u8)~BIT(UsbCompressionType_None));
+        LOG_MSG_DEBUG("USB host compression mask: 0x%02X.", g_usbHostCompressionMask);
+
+        /* Check if the USB host will read file data from the dedicated endpoint pair. If so, only commands and status blocks go through the main one. */
+        /* This stops file data chunks from sharing an endpoint queue and its ZLT setting with command traffic. */
+        g_usbDataEndpointsEnabled = (data_endpoints && cmd_status->data_endpoints);
+    }
+
+end:
+    return ret;
+}
+
+static void usbEndSession(void)
+{
+    if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return;
+    }
+
+    /* Prepare command data. */
+    usbPrepareCommandHeader(UsbCommandType_EndSession, 0);
+
+    /* Send command. We don't care about the result here. */
+    usbSendCommand();
+}
+
+NX_INLINE void usbPrepareCommandHeader(u32 cmd, u32 cmd_block_size)
+{
+    if (cmd >= UsbCommandType_Count) return;
+    UsbCommandHeader *cmd_header = (UsbCommandHeader*)g_usbTransferBuffer;
+    memset(cmd_header, 0, sizeof(UsbCommandHeader));
+    cmd_header->magic = __builtin_bswap32(USB_CMD_HEADER_MAGIC);
+    cmd_header->cmd = cmd;
+    cmd_header->cmd_block_size = cmd_block_size;
+}
+
+NX_INLINE bool usbSendCommand(void)
+{
+    return usbSendCommandWithStatus(NULL);
+}
+
+static bool usbSendCommandWithStatus(u32 *out_status)
+{
+    return usbSendCommandToEndpoint(g_usbEndpointIn, out_status);
+}
+
+static bool usbSendCommandToEndpoint(UsbDsEndpoint *endpoint, u32 *out_status)
+{
+    UsbCommandHeader *cmd_header = (UsbCommandHeader*)g_usbTransferBuffer;
+    u32 cmd_block_size = cmd_header->cmd_block_size;
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+    u32 cmd = cmd_header->cmd;
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+    UsbCommandHeader cmd_header_bkp = {0};
+    memcpy(&cmd_header_bkp, cmd_header, sizeof(UsbCommandHeader));
+#endif
+
+    UsbStatus *cmd_status = (UsbStatus*)g_usbTransferBuffer;
+    u32 status = UsbStatusType_Success;
+
+    bool ret = false, zlt_required = false, cmd_block_written = false;
+
+    if ((sizeof(UsbCommandHeader) + cmd_block_size) > g_usbTransferBufferSize)
+    {
+        LOG_MSG_ERROR("Invalid command size!");
+        status = UsbStatusType_InvalidCommandSize;
+        goto end;
+    }
+
+    /* Wait for all pending asynchronous file data transfers before sending anything else. */
+    if (!usbWaitForPendingTransfers(true))
+    {
+        status = UsbStatusType_WriteCommandFailed;
+        goto end;
+    }
+
+    /* Write command header first. */
+    if (!usbTransferData(cmd_header, sizeof(UsbCommandHeader), endpoint, false))
+    {
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+        if (!g_usbDetectionThreadExitFlag) LOG_MSG_ERROR("Failed to write header for type 0x%X command!", cmd);
+#endif
+        status = UsbStatusType_WriteCommandFailed;
+        goto end;
+    }
+
+    /* Check if we need to transfer a command block. */
+    if (cmd_block_size)
+    {
+        /* Move command block data within the transfer buffer to guarantee we'll work with proper alignment. */
+        memmove(g_usbTransferBuffer, g_usbTransferBuffer + sizeof(UsbCommandHeader), cmd_block_size);
+
+        /* Determine if we'll need to set a Zero Length Termination (ZLT) packet after sending the command block. */
+        zlt_required = IS_ALIGNED(cmd_block_size, atomic_load(&g_usbEndpointMaxPacketSize));
+        if (zlt_required) usbSetZltPacket(endpoint, true);
+
+        /* Write command block. */
+        cmd_block_written = usbTransferData(g_usbTransferBuffer, cmd_block_size, endpoint, false);
+        if (!cmd_block_written)
+        {
+            LOG_MSG_ERROR("Failed to write command block for type 0x%X command!", cmd);
+            status = UsbStatusType_WriteCommandFailed;
+        }
+
+        /* Disable ZLT if it was previously enabled. */
+        if (zlt_required) usbSetZltPacket(endpoint, false);
+
+        /* Bail out if we failed to write the command block. */
+        if (!cmd_block_written) goto end;
+    }
+
+    /* Read status block. */
+    if (!usbRead(cmd_status, sizeof(UsbStatus)))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes long status block for type 0x%X command!", sizeof(UsbStatus), cmd);
+        status = UsbStatusType_ReadStatusFailed;
+        goto end;
+    }
+
+    /* Verify magic word in status block. */
+    if (cmd_status->magic != __builtin_bswap32(USB_CMD_HEADER_MAGIC))
+    {
+        LOG_MSG_ERROR("Invalid status block magic word! (0x%08X).", __builtin_bswap32(cmd_status->magic));
+        status = UsbStatusType_InvalidMagicWord;
+        goto end;
+    }
+
+    /* Update return value. */
+    ret = ((status = cmd_status->status) == UsbStatusType_Success);
+
+end:
+    if (out_status) *out_status = status;
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+    if (!ret)
+    {
+        usbLogStatusDetail(status);
+
+        if (status > UsbStatusType_ReadStatusFailed)
+        {
+            LOG_DATA_INFO(&cmd_header_bkp, sizeof(cmd_header_bkp), "USB command header dump:");
+            if (cmd_block_size) LOG_DATA_INFO(g_usbTransferBuffer, cmd_block_size, "USB command block dump:");
+        }
+    }
+#endif
+
+    return ret;
+}
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+static void usbLogStatusDetail(u32 status)
+{
+    switch(status)
+    {
+        case UsbStatusType_Success:
+        case UsbStatusType_InvalidCommandSize:
+        case UsbStatusType_WriteCommandFailed:
+        case UsbStatusType_ReadStatusFailed:
+            break;
+        case UsbStatusType_InvalidMagicWord:
+            LOG_MSG_INFO("Host replied with Invalid Magic Word status code.");
+            break;
+        case UsbStatusType_UnsupportedCommand:
+            LOG_MSG_INFO("Host replied with Unsupported Command status code.");
+            break;
+        case UsbStatusType_UnsupportedAbiVersion:
+            LOG_MSG_INFO("Host replied with Unsupported ABI Version status code.");
+            break;
+        case UsbStatusType_MalformedCommand:
+            LOG_MSG_INFO("Host replied with Malformed Command status code.");
+            break;
+        case UsbStatusType_HostIoError:
+            LOG_MSG_INFO("Host replied with I/O Error status code.");
+            break;
+        case UsbStatusType_ChecksumMismatch:
+            LOG_MSG_INFO("Host replied with Checksum Mismatch status code.");
+            break;
+        default:
+            LOG_MSG_INFO("Unknown status code: 0x%X.", status);
+            break;
+    }
+}
+#endif
+
+NX_INLINE bool usbAllocateTransferBuffer(void)
+{
+    if (g_usbTransferBuffer) return true;
+
+    /* The transfer buffer size is determined by the memory budget. It also limits the file data chunk size the host device may ask for. */
+    /* It's leased from the shared buffer pool, so retry with halved sizes if the lease fails. */
+    u64 cur_size = utilsGetBudgetedBufferSize(USB_TRANSFER_BUFFER_SIZE, USB_TRANSFER_MIN_CHUNK_SIZE);
+
+    while(true)
+    {
+        g_usbTransferBuffer = bufferPoolLease(cur_size, false);
+        if (g_usbTransferBuffer || cur_size <= USB_TRANSFER_MIN_CHUNK_SIZE) break;
+        cur_size = MAX(cur_size >> 1, USB_TRANSFER_MIN_CHUNK_SIZE);
+    }
+
+    if (g_usbTransferBuffer) g_usbTransferBufferSize = g_usbTransferChunkSize = cur_size;
+
+    return (g_usbTransferBuffer != NULL);
+}
+
+NX_INLINE void usbFreeTransferBuffer(void)
+{
+    if (!g_usbTransferBuffer) return;
+    bufferPoolReturn(g_usbTransferBuffer);
+    g_usbTransferBuffer = NULL;
+    g_usbTransferBufferSize = 0;
+}
+
+static bool usbInitializeComms(void)
+{
+    Result rc = 0;
+    bool ret = false, is_5x = hosversionAtLeast(5, 0, 0);
+
+    /* Carry out USB comms initialization steps for this HOS version. */
+    ret = (is_5x ? usbInitializeComms5x() : usbInitializeComms1x());
+    if (!ret) goto end;
+
+    /* Enable USB interface. */
+    /* This is always needed regardless of the HOS version. */
+    rc = usbDsInterface_EnableInterface(g_usbInterface);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_EnableInterface failed! (0x%X).", rc);
+        goto end;
+    }
+
+    /* Additional step needed under HOS 5.0.0+. */
+    if (is_5x)
+    {
+        rc = usbDsEnable();
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_ERROR("usbDsEnable failed! (0x%X).", rc);
+            goto end;
+        }
+
+        g_usbHos5xEnabled = true;
+    }
+
+    ret = true;
+
+end:
+    if (!ret) usbCloseComms();
+
+    return ret;
+}
+
+static bool usbInitializeComms5x(void)
+{
+    Result rc = 0;
+    bool ret = false;
+
+    struct usb_device_descriptor device_descriptor = {
+        .bLength = USB_DT_DEVICE_SIZE,
+        .bDescriptorType = USB_DT_DEVICE,
+        .bcdUSB = USB_FS_BCD_REVISION,                  /* USB 1.1. Updated before setting new device descriptors for USB 2.0 and 3.0. */
+        .bDeviceClass = 0,                              /* Defined at interface level. */
+        .bDeviceSubClass = 0,                           /* Defined at interface level. */
+        .bDeviceProtocol = 0,                           /* Defined at interface level. */
+        .bMaxPacketSize0 = USB_FS_EP0_MAX_PACKET_SIZE,  /* Updated before setting the USB 3.0 device descriptor. */
+        .idVendor = USB_DEV_VID,
+        .idProduct = USB_DEV_PID,
+        .bcdDevice = USB_DEV_BCD_REL,
+        .iManufacturer = 0,                             /* Filled at a later time. */
+        .iProduct = 0,                                  /* Filled at a later time. */
+        .iSerialNumber = 0,                             /* Filled at a later time. */
+        .bNumConfigurations = 1
+    };
+
+    static const u16 supported_langs[] = { USB_LANGID_ENUS };
+    static const u16 num_supported_langs = (u16)MAX_ELEMENTS(supported_langs);
+
+    u8 bos[USB_BOS_SIZE] = {0};
+
+    struct usb_bos_descriptor *bos_desc = (struct usb_bos_descriptor*)bos;
+    struct usb_2_0_extension_descriptor *usb2_ext_desc = (struct usb_2_0_extension_descriptor*)(bos + sizeof(struct usb_bos_descriptor));
+    struct usb_ss_usb_device_capability_descriptor *usb3_devcap_desc = (struct usb_ss_usb_device_capability_descriptor*)((u8*)usb2_ext_desc + sizeof(struct usb_2_0_extension_descriptor));
+
+    bos_desc->bLength = sizeof(struct usb_bos_descriptor);
+    bos_desc->bDescriptorType = USB_DT_BOS;
+    bos_desc->wTotalLength = sizeof(bos);
+    bos_desc->bNumDeviceCaps = 2;   /* USB 2.0 + USB 3.0. No extra capabilities for USB 1.x. */
+
+    usb2_ext_desc->bLength = sizeof(struct usb_2_0_extension_descriptor);
+    usb2_ext_desc->bDescriptorType = USB_DT_DEVICE_CAPABILITY;
+    usb2_ext_desc->bDevCapabilityType = USB_BT_USB_2_0_EXTENSION;
+    usb2_ext_desc->bmAttributes = USB_BM_LPM_SUPPORT;
+
+    usb3_devcap_desc->bLength = sizeof(struct usb_ss_usb_device_capability_descriptor);
+    usb3_devcap_desc->bDescriptorType = USB_DT_DEVICE_CAPABILITY;
+    usb3_devcap_desc->bDevCapabilityType = USB_BT_SS_USB_DEVICE_CAPABILITY;
+    usb3_devcap_desc->bmAttributes = 0;
+    usb3_devcap_desc->wSpeedsSupported = (USB_SUPER_SPEED_OPERATION | USB_HIGH_SPEED_OPERATION | USB_FULL_SPEED_OPERATION);
+    usb3_devcap_desc->bFunctionalitySupport = 1;    /* We can fully work under USB 1.x. */
+    usb3_devcap_desc->bU1DevExitLat = 0;
+    usb3_devcap_desc->bU2DevExitLat = 0;
+
+    struct usb_interface_descriptor interface_descriptor = {
+        .bLength = USB_DT_INTERFACE_SIZE,
+        .bDescriptorType = USB_DT_INTERFACE,
+        .bInterfaceNumber = USBDS_DEFAULT_InterfaceNumber,
+        .bAlternateSetting = 0,
+        .bNumEndpoints = 4,                             /* Main endpoint pair (commands and status blocks) + file data endpoint pair. */
+        .bInterfaceClass = USB_CLASS_VENDOR_SPEC,
+        .bInterfaceSubClass = USB_CLASS_VENDOR_SPEC,
+        .bInterfaceProtocol = USB_CLASS_VENDOR_SPEC,
+        .iInterface = 0
+    };
+
+    struct usb_endpoint_descriptor endpoint_descriptor_in = {
+        .bLength = USB_DT_ENDPOINT_SIZE,
+        .bDescriptorType = USB_DT_ENDPOINT,
+        .bEndpointAddress = USB_ENDPOINT_IN,
+        .bmAttributes = USB_TRANSFER_TYPE_BULK,
+        .wMaxPacketSize = USB_FS_EP_MAX_PACKET_SIZE,    /* Updated before setting new device descriptors for USB 2.0 and 3.0. */
+        .bInterval = 0
+    };
+
+    struct usb_endpoint_descriptor endpoint_descriptor_out = {
+        .bLength = USB_DT_ENDPOINT_SIZE,
+        .bDescriptorType = USB_DT_ENDPOINT,
+        .bEndpointAddress = USB_ENDPOINT_OUT,
+        .bmAttributes = USB_TRANSFER_TYPE_BULK,
+        .wMaxPacketSize = USB_FS_EP_MAX_PACKET_SIZE,    /* Updated before setting new device descriptors for USB 2.0 and 3.0. */
+        .bInterval = 0
+    };
+
+    /* Only used to transfer file data if the host device supports it. */
+    struct usb_endpoint_descriptor data_endpoint_descriptor_in = endpoint_descriptor_in;
+    struct usb_endpoint_descriptor data_endpoint_descriptor_out = endpoint_descriptor_out;
+
+    struct usb_ss_endpoint_companion_descriptor endpoint_companion = {
+        .bLength = sizeof(struct usb_ss_endpoint_companion_descriptor),
+        .bDescriptorType = USB_DT_SS_ENDPOINT_COMPANION,
+        .bMaxBurst = 0x0F,
+        .bmAttributes = 0,
+        .wBytesPerInterval = 0
+    };
+
+    /* Set language string descriptor. */
+    rc = usbDsAddUsbLanguageStringDescriptor(NULL, supported_langs, num_supported_langs);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsAddUsbLanguageStringDescriptor failed! (0x%X).", rc);
+        goto end;
+    }
+
+    /* Set manufacturer string descriptor. */
+    rc = usbDsAddUsbStringDescriptor(&(device_descriptor.iManufacturer), APP_AUTHOR);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsAddUsbStringDescriptor failed! (0x%X) (manufacturer).", rc);
+        goto end;
+    }
+
+    /* Set product string descriptor. */
+    rc = usbDsAddUsbStringDescriptor(&(device_descriptor.iProduct), APP_TITLE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsAddUsbStringDescriptor failed! (0x%X) (product).", rc);
+        goto end;
+    }
+
+    /* Set serial number string descriptor. */
+    rc = usbDsAddUsbStringDescriptor(&(device_descriptor.iSerialNumber), APP_VERSION);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsAddUsbStringDescriptor failed! (0x%X) (serial number).", rc);
+        goto end;
+    }
+
+    /* Set device descriptors. */
+    rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_Full, &device_descriptor);  /* Full Speed is USB 1.1. */
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsSetUsbDeviceDescriptor failed! (0x%X) (USB 1.1).", rc);
+        goto end;
+    }
+
+    device_descriptor.bcdUSB = USB_HS_BCD_REVISION;
+    rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_High, &device_descriptor);  /* High Speed is USB 2.0. */
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsSetUsbDeviceDescriptor failed! (0x%X) (USB 2.0).", rc);
+        goto end;
+    }
+
+    device_descriptor.bcdUSB = USB_SS_BCD_REVISION;
+    device_descriptor.bMaxPacketSize0 = USB_SS_EP0_MAX_PACKET_SIZE;
+    rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_Super, &device_descriptor); /* Super Speed is USB 3.0. */
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsSetUsbDeviceDescriptor failed! (0x%X) (USB 3.0).", rc);
+        goto end;
+    }
+
+    /* Set Binary Object Store. */
+    rc = usbDsSetBinaryObjectStore(bos, sizeof(bos));
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsSetBinaryObjectStore failed! (0x%X).", rc);
+        goto end;
+    }
+
+    /* Setup interface. */
+    rc = usbDsRegisterInterface(&g_usbInterface);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsRegisterInterface failed! (0x%X).", rc);
+        goto end;
+    }
+
+    interface_descriptor.bInterfaceNumber = g_usbInterface->interface_index;
+    endpoint_descriptor_in.bEndpointAddress += (interface_descriptor.bInterfaceNumber + 1);
+    endpoint_descriptor_out.bEndpointAddress += (interface_descriptor.bInterfaceNumber + 1);
+    data_endpoint_descriptor_in.bEndpointAddress += (interface_descriptor.bInterfaceNumber + 2);
+    data_endpoint_descriptor_out.bEndpointAddress += (interface_descriptor.bInterfaceNumber + 2);
+
+    /* Full Speed config (USB 1.1). */
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Full, &interface_descriptor, USB_DT_INTERFACE_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 1.1) (interface).", rc);
+        goto end;
+    }
+
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Full, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 1.1) (in endpoint).", rc);
+        goto end;
+    }
+
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Full, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 1.1) (out endpoint).", rc);
+        goto end;
+    }
+
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Full, &data_endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 1.1) (data in endpoint).", rc);
+        goto end;
+    }
 
-    UsbStatus *cmd_status = (UsbStatus*)g_usbTransferBuffer;
-    u32 status = UsbStatusType_Success;
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Full, &data_endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 1.1) (data out endpoint).", rc);
+        goto end;
+    }
 
-    bool ret = false, zlt_required = false, cmd_block_written = false;
+    /* High Speed config (USB 2.0). */
+    endpoint_descriptor_in.wMaxPacketSize = endpoint_descriptor_out.wMaxPacketSize = USB_HS_EP_MAX_PACKET_SIZE;
+    data_endpoint_descriptor_in.wMaxPacketSize = data_endpoint_descriptor_out.wMaxPacketSize = USB_HS_EP_MAX_PACKET_SIZE;
 
-    if ((sizeof(UsbCommandHeader) + cmd_block_size) > USB_TRANSFER_BUFFER_SIZE)
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_High, &interface_descriptor, USB_DT_INTERFACE_SIZE);
+    if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("Invalid command size!");
-        status = UsbStatusType_InvalidCommandSize;
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 2.0) (interface).", rc);
         goto end;
     }
 
-    /* Write command header first. */
-    if (!usbWrite(cmd_header, sizeof(UsbCommandHeader)))
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_High, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
     {
-#if LOG_LEVEL <= LOG_LEVEL_ERROR
-        if (!g_usbDetectionThreadExitFlag) LOG_MSG_ERROR("Failed to write header for type 0x%X command!", cmd);
-#endif
-        status = UsbStatusType_WriteCommandFailed;
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 2.0) (in endpoint).", rc);
         goto end;
     }
 
-    /* Check if we need to transfer a command block. */
-    if (cmd_block_size)
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_High, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
     {
-        /* Move command block data within the transfer buffer to guarantee we'll work with proper alignment. */
-        memmove(g_usbTransferBuffer, g_usbTransferBuffer + sizeof(UsbCommandHeader), cmd_block_size);
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 2.0) (out endpoint).", rc);
+        goto end;
+    }
 
-        /* Determine if we'll need to set a Zero Length Termination (ZLT) packet after sending the command block. */
-        zlt_required = IS_ALIGNED(cmd_block_size, atomic_load(&g_usbEndpointMaxPacketSize));
-        if (zlt_required) usbSetZltPacket(true);
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_High, &data_endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 2.0) (data in endpoint).", rc);
+        goto end;
+    }
 
-        /* Write command block. */
-        cmd_block_written = usbWrite(g_usbTransferBuffer, cmd_block_size);
-        if (!cmd_block_written)
-        {
-            LOG_MSG_ERROR("Failed to write command block for type 0x%X command!", cmd);
-            status = UsbStatusType_WriteCommandFailed;
-        }
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_High, &data_endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 2.0) (data out endpoint).", rc);
+        goto end;
+    }
 
-        /* Disable ZLT if it was previously enabled. */
-        if (zlt_required) usbSetZltPacket(false);
+    /* Super Speed config (USB 3.0). */
+    endpoint_descriptor_in.wMaxPacketSize = endpoint_descriptor_out.wMaxPacketSize = USB_SS_EP_MAX_PACKET_SIZE;
+    data_endpoint_descriptor_in.wMaxPacketSize = data_endpoint_descriptor_out.wMaxPacketSize = USB_SS_EP_MAX_PACKET_SIZE;
 
-        /* Bail out if we failed to write the command block. */
-        if (!cmd_block_written) goto end;
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &interface_descriptor, USB_DT_INTERFACE_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (interface).", rc);
+        goto end;
     }
 
-    /* Read status block. */
-    if (!usbRead(cmd_status, sizeof(UsbStatus)))
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("Failed to read 0x%lX bytes long status block for type 0x%X command!", sizeof(UsbStatus), cmd);
-        status = UsbStatusType_ReadStatusFailed;
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (in endpoint).", rc);
         goto end;
     }
 
-    /* Verify magic word in status block. */
-    if (cmd_status->magic != __builtin_bswap32(USB_CMD_HEADER_MAGIC))
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_companion, USB_DT_SS_ENDPOINT_COMPANION_SIZE);
+    if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("Invalid status block magic word! (0x%08X).", __builtin_bswap32(cmd_status->magic));
-        status = UsbStatusType_InvalidMagicWord;
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (in endpoint companion).", rc);
         goto end;
     }
 
-    /* Update return value. */
-    ret = ((status = cmd_status->status) == UsbStatusType_Success);
-
-end:
-#if LOG_LEVEL <= LOG_LEVEL_INFO
-    if (!ret)
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
     {
-        usbLogStatusDetail(status);
-
-        if (status > UsbStatusType_ReadStatusFailed)
-        {
-            LOG_DATA_INFO(&cmd_header_bkp, sizeof(cmd_header_bkp), "USB command header dump:");
-            if (cmd_block_size) LOG_DATA_INFO(g_usbTransferBuffer, cmd_block_size, "USB command block dump:");
-        }
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (out endpoint).", rc);
+        goto end;
     }
-#endif
 
-    return ret;
-}
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_companion, USB_DT_SS_ENDPOINT_COMPANION_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (out endpoint companion).", rc);
+        goto end;
+    }
 
-#if LOG_LEVEL <= LOG_LEVEL_INFO
-static void usbLogStatusDetail(u32 status)
-{
-    switch(status)
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &data_endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
     {
-        case UsbStatusType_Success:
-        case UsbStatusType_InvalidCommandSize:
-        case UsbStatusType_WriteCommandFailed:
-        case UsbStatusType_ReadStatusFailed:
-            break;
-        case UsbStatusType_InvalidMagicWord:
-            LOG_MSG_INFO("Host replied with Invalid Magic Word status code.");
-            break;
-        case UsbStatusType_UnsupportedCommand:
-            LOG_MSG_INFO("Host replied with Unsupported Command status code.");
-            break;
-        case UsbStatusType_UnsupportedAbiVersion:
-            LOG_MSG_INFO("Host replied with Unsupported ABI Version status code.");
-            break;
-        case UsbStatusType_MalformedCommand:
-            LOG_MSG_INFO("Host replied with Malformed Command status code.");
-            break;
-        case UsbStatusType_HostIoError:
-            LOG_MSG_INFO("Host replied with I/O Error status code.");
-            break;
-        default:
-            LOG_MSG_INFO("Unknown status code: 0x%X.", status);
-            break;
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (data in endpoint).", rc);
+        goto end;
     }
-}
-#endif
 
-NX_INLINE bool usbAllocateTransferBuffer(void)
-{
-    if (g_usbTransferBuffer) return true;
-    g_usbTransferBuffer = memalign(USB_TRANSFER_ALIGNMENT, USB_TRANSFER_BUFFER_SIZE);
-    return (g_usbTransferBuffer != NULL);
-}
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_companion, USB_DT_SS_ENDPOINT_COMPANION_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (data in endpoint companion).", rc);
+        goto end;
+    }
 
-NX_INLINE void usbFreeTransferBuffer(void)
-{
-    if (!g_usbTransferBuffer) return;
-    free(g_usbTransferBuffer);
-    g_usbTransferBuffer = NULL;
-}
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &data_endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (data out endpoint).", rc);
+        goto end;
+    }
 
-static bool usbInitializeComms(void)
-{
-    Result rc = 0;
-    bool ret = false, is_5x = hosversionAtLeast(5, 0, 0);
+    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_companion, USB_DT_SS_ENDPOINT_COMPANION_SIZE);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (data out endpoint companion).", rc);
+        goto end;
+    }
 
-    /* Carry out USB comms initialization steps for this HOS version. */
-    ret = (is_5x ? usbInitializeComms5x() : usbInitializeComms1x());
-    if (!ret) goto end;
+    /* Setup endpoints. */
+    rc = usbDsInterface_RegisterEndpoint(g_usbInterface, &g_usbEndpointIn, endpoint_descriptor_in.bEndpointAddress);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_RegisterEndpoint failed! (0x%X) (in endpoint).", rc);
+        goto end;
+    }
 
-    /* Enable USB interface. */
-    /* This is always needed regardless of the HOS version. */
-    rc = usbDsInterface_EnableInterface(g_usbInterface);
+    rc = usbDsInterface_RegisterEndpoint(g_usbInterface, &g_usbEndpointOut, endpoint_descriptor_out.bEndpointAddress);
     if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("usbDsInterface_EnableInterface failed! (0x%X).", rc);
+        LOG_MSG_ERROR("usbDsInterface_RegisterEndpoint failed! (0x%X) (out endpoint).", rc);
         goto end;
     }
 
-    /* Additional step needed under HOS 5.0.0+. */
-    if (is_5x)
+    rc = usbDsInterface_RegisterEndpoint(g_usbInterface, &g_usbDataEndpointIn, data_endpoint_descriptor_in.bEndpointAddress);
+    if (R_FAILED(rc))
     {
-        rc = usbDsEnable();
-        if (R_FAILED(rc))
-        {
-            LOG_MSG_ERROR("usbDsEnable failed! (0x%X).", rc);
-            goto end;
-        }
+        LOG_MSG_ERROR("usbDsInterface_RegisterEndpoint failed! (0x%X) (data in endpoint).", rc);
+        goto end;
+    }
 
-        g_usbHos5xEnabled = true;
+    rc = usbDsInterface_RegisterEndpoint(g_usbInterface, &g_usbDataEndpointOut, data_endpoint_descriptor_out.bEndpointAddress);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsInterface_RegisterEndpoint failed! (0x%X) (data out endpoint).", rc);
+        goto end;
     }
 
     ret = true;
 
 end:
-    if (!ret) usbCloseComms();
-
     return ret;
 }
 
-static bool usbInitializeComms5x(void)
+static bool usbInitializeComms1x(void)
 {
     Result rc = 0;
     bool ret = false;
 
-    struct usb_device_descriptor device_descriptor = {
-        .bLength = USB_DT_DEVICE_SIZE,
-        .bDescriptorType = USB_DT_DEVICE,
-        .bcdUSB = USB_FS_BCD_REVISION,                  /* USB 1.1. Updated before setting new device descriptors for USB 2.0 and 3.0. */
-        .bDeviceClass = 0,                              /* Defined at interface level. */
-        .bDeviceSubClass = 0,                           /* Defined at interface level. */
-        .bDeviceProtocol = 0,                           /* Defined at interface level. */
-        .bMaxPacketSize0 = USB_FS_EP0_MAX_PACKET_SIZE,  /* Updated before setting the USB 3.0 device descriptor. */
+    static const UsbDsDeviceInfo device_info = {
         .idVendor = USB_DEV_VID,
         .idProduct = USB_DEV_PID,
         .bcdDevice = USB_DEV_BCD_REL,
-        .iManufacturer = 0,                             /* Filled at a later time. */
-        .iProduct = 0,                                  /* Filled at a later time. */
-        .iSerialNumber = 0,                             /* Filled at a later time. */
-        .bNumConfigurations = 1
+        .Manufacturer = APP_AUTHOR,
+        .Product = APP_TITLE,
+        .SerialNumber = APP_VERSION
     };
 
-    static const u16 supported_langs[] = { USB_LANGID_ENUS };
-    static const u16 num_supported_langs = (u16)MAX_ELEMENTS(supported_langs);
-
-    u8 bos[USB_BOS_SIZE] = {0};
-
-    struct usb_bos_descriptor *bos_desc = (struct usb_bos_descriptor*)bos;
-    struct usb_2_0_extension_descriptor *usb2_ext_desc = (struct usb_2_0_extension_descriptor*)(bos + sizeof(struct usb_bos_descriptor));
-    struct usb_ss_usb_device_capability_descriptor *usb3_devcap_desc = (struct usb_ss_usb_device_capability_descriptor*)((u8*)usb2_ext_desc + sizeof(struct usb_2_0_extension_descriptor));
-
-    bos_desc->bLength = sizeof(struct usb_bos_descriptor);
-    bos_desc->bDescriptorType = USB_DT_BOS;
-    bos_desc->wTotalLength = sizeof(bos);
-    bos_desc->bNumDeviceCaps = 2;   /* USB 2.0 + USB 3.0. No extra capabilities for USB 1.x. */
-
-    usb2_ext_desc->bLength = sizeof(struct usb_2_0_extension_descriptor);
-    usb2_ext_desc->bDescriptorType = USB_DT_DEVICE_CAPABILITY;
-    usb2_ext_desc->bDevCapabilityType = USB_BT_USB_2_0_EXTENSION;
-    usb2_ext_desc->bmAttributes = USB_BM_LPM_SUPPORT;
-
-    usb3_devcap_desc->bLength = sizeof(struct usb_ss_usb_device_capability_descriptor);
-    usb3_devcap_desc->bDescriptorType = USB_DT_DEVICE_CAPABILITY;
-    usb3_devcap_desc->bDevCapabilityType = USB_BT_SS_USB_DEVICE_CAPABILITY;
-    usb3_devcap_desc->bmAttributes = 0;
-    usb3_devcap_desc->wSpeedsSupported = (USB_SUPER_SPEED_OPERATION | USB_HIGH_SPEED_OPERATION | USB_FULL_SPEED_OPERATION);
-    usb3_devcap_desc->bFunctionalitySupport = 1;    /* We can fully work under USB 1.x. */
-    usb3_devcap_desc->bU1DevExitLat = 0;
-    usb3_devcap_desc->bU2DevExitLat = 0;
-
     struct usb_interface_descriptor interface_descriptor = {
         .bLength = USB_DT_INTERFACE_SIZE,
         .bDescriptorType = USB_DT_INTERFACE,
-        .bInterfaceNumber = USBDS_DEFAULT_InterfaceNumber,
+        .bInterfaceNumber = 0,
         .bAlternateSetting = 0,
-        .bNumEndpoints = 2,
         .bInterfaceClass = USB_CLASS_VENDOR_SPEC,
         .bInterfaceSubClass = USB_CLASS_VENDOR_SPEC,
         .bInterfaceProtocol = USB_CLASS_VENDOR_SPEC,
@@ -944,7 +2194,7 @@ static bool usbInitializeComms5x(void)
         .bDescriptorType = USB_DT_ENDPOINT,
         .bEndpointAddress = USB_ENDPOINT_IN,
         .bmAttributes = USB_TRANSFER_TYPE_BULK,
-        .wMaxPacketSize = USB_FS_EP_MAX_PACKET_SIZE,    /* Updated before setting new device descriptors for USB 2.0 and 3.0. */
+        .wMaxPacketSize = USB_HS_EP_MAX_PACKET_SIZE,
         .bInterval = 0
     };
 
@@ -953,353 +2203,695 @@ static bool usbInitializeComms5x(void)
         .bDescriptorType = USB_DT_ENDPOINT,
         .bEndpointAddress = USB_ENDPOINT_OUT,
         .bmAttributes = USB_TRANSFER_TYPE_BULK,
-        .wMaxPacketSize = USB_FS_EP_MAX_PACKET_SIZE,    /* Updated before setting new device descriptors for USB 2.0 and 3.0. */
+        .wMaxPacketSize = USB_HS_EP_MAX_PACKET_SIZE,
         .bInterval = 0
     };
 
-    struct usb_ss_endpoint_companion_descriptor endpoint_companion = {
-        .bLength = sizeof(struct usb_ss_endpoint_companion_descriptor),
-        .bDescriptorType = USB_DT_SS_ENDPOINT_COMPANION,
-        .bMaxBurst = 0x0F,
-        .bmAttributes = 0,
-        .wBytesPerInterval = 0
-    };
-
-    /* Set language string descriptor. */
-    rc = usbDsAddUsbLanguageStringDescriptor(NULL, supported_langs, num_supported_langs);
+    /* Set VID, PID and BCD. */
+    rc = usbDsSetVidPidBcd(&device_info);
     if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("usbDsAddUsbLanguageStringDescriptor failed! (0x%X).", rc);
+        LOG_MSG_ERROR("usbDsSetVidPidBcd failed! (0x%X).", rc);
         goto end;
     }
 
-    /* Set manufacturer string descriptor. */
-    rc = usbDsAddUsbStringDescriptor(&(device_descriptor.iManufacturer), APP_AUTHOR);
+    /* Setup interface. */
+    rc = usbDsGetDsInterface(&g_usbInterface, &interface_descriptor, "usb");
     if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("usbDsAddUsbStringDescriptor failed! (0x%X) (manufacturer).", rc);
+        LOG_MSG_ERROR("usbDsGetDsInterface failed! (0x%X).", rc);
         goto end;
     }
 
-    /* Set product string descriptor. */
-    rc = usbDsAddUsbStringDescriptor(&(device_descriptor.iProduct), APP_TITLE);
+    /* Setup endpoints. */
+    rc = usbDsInterface_GetDsEndpoint(g_usbInterface, &g_usbEndpointIn, &endpoint_descriptor_in);
     if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("usbDsAddUsbStringDescriptor failed! (0x%X) (product).", rc);
+        LOG_MSG_ERROR("usbDsInterface_GetDsEndpoint failed! (0x%X) (in endpoint).", rc);
         goto end;
     }
 
-    /* Set serial number string descriptor. */
-    rc = usbDsAddUsbStringDescriptor(&(device_descriptor.iSerialNumber), APP_VERSION);
+    rc = usbDsInterface_GetDsEndpoint(g_usbInterface, &g_usbEndpointOut, &endpoint_descriptor_out);
     if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("usbDsAddUsbStringDescriptor failed! (0x%X) (serial number).", rc);
+        LOG_MSG_ERROR("usbDsInterface_GetDsEndpoint failed! (0x%X) (out endpoint).", rc);
         goto end;
     }
 
-    /* Set device descriptors. */
-    rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_Full, &device_descriptor);  /* Full Speed is USB 1.1. */
-    if (R_FAILED(rc))
+    ret = true;
+
+end:
+    return ret;
+}
+
+static void usbCloseComms(void)
+{
+    bool is_5x = hosversionAtLeast(5, 0, 0);
+
+    if (is_5x && g_usbHos5xEnabled)
     {
-        LOG_MSG_ERROR("usbDsSetUsbDeviceDescriptor failed! (0x%X) (USB 1.1).", rc);
-        goto end;
+        usbDsDisable();
+        g_usbHos5xEnabled = false;
     }
 
-    device_descriptor.bcdUSB = USB_HS_BCD_REVISION;
-    rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_High, &device_descriptor);  /* High Speed is USB 2.0. */
-    if (R_FAILED(rc))
+    g_usbDataEndpointsEnabled = false;
+
+    if (g_usbDataEndpointOut)
     {
-        LOG_MSG_ERROR("usbDsSetUsbDeviceDescriptor failed! (0x%X) (USB 2.0).", rc);
-        goto end;
+        usbDsEndpoint_Close(g_usbDataEndpointOut);
+        g_usbDataEndpointOut = NULL;
     }
 
-    device_descriptor.bcdUSB = USB_SS_BCD_REVISION;
-    device_descriptor.bMaxPacketSize0 = USB_SS_EP0_MAX_PACKET_SIZE;
-    rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_Super, &device_descriptor); /* Super Speed is USB 3.0. */
-    if (R_FAILED(rc))
+    if (g_usbDataEndpointIn)
     {
-        LOG_MSG_ERROR("usbDsSetUsbDeviceDescriptor failed! (0x%X) (USB 3.0).", rc);
-        goto end;
+        usbDsEndpoint_Close(g_usbDataEndpointIn);
+        g_usbDataEndpointIn = NULL;
     }
 
-    /* Set Binary Object Store. */
-    rc = usbDsSetBinaryObjectStore(bos, sizeof(bos));
-    if (R_FAILED(rc))
+    if (g_usbEndpointOut)
     {
-        LOG_MSG_ERROR("usbDsSetBinaryObjectStore failed! (0x%X).", rc);
-        goto end;
+        usbDsEndpoint_Close(g_usbEndpointOut);
+        g_usbEndpointOut = NULL;
     }
 
-    /* Setup interface. */
-    rc = usbDsRegisterInterface(&g_usbInterface);
-    if (R_FAILED(rc))
+    if (g_usbEndpointIn)
     {
-        LOG_MSG_ERROR("usbDsRegisterInterface failed! (0x%X).", rc);
-        goto end;
+        usbDsEndpoint_Close(g_usbEndpointIn);
+        g_usbEndpointIn = NULL;
     }
 
-    interface_descriptor.bInterfaceNumber = g_usbInterface->interface_index;
-    endpoint_descriptor_in.bEndpointAddress += (interface_descriptor.bInterfaceNumber + 1);
-    endpoint_descriptor_out.bEndpointAddress += (interface_descriptor.bInterfaceNumber + 1);
+    if (g_usbInterface)
+    {
+        /* usbDsInterface_DisableInterface() is internally called here. */
+        usbDsInterface_Close(g_usbInterface);
+        g_usbInterface = NULL;
+    }
 
-    /* Full Speed config (USB 1.1). */
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Full, &interface_descriptor, USB_DT_INTERFACE_SIZE);
-    if (R_FAILED(rc))
+    if (is_5x) usbDsClearDeviceData();
+}
+
+static bool _usbSendFileProperties(u64 file_size, const char *filename, u32 nsp_header_size, bool enforce_nsp_mode, u8 checksum_type, u64 resume_offset)
+{
+    bool ret = false, compressed = false;
+    size_t filename_length = 0;
+
+    /* Disallow sending new files if we're not in NSP transfer mode and the remaining transfer size isn't zero. */
+    /* Allow empty files if we're not in NSP transfer mode. */
+    /* Disallow sending new NSPs if we're already in NSP transfer mode. */
+    if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || (!g_nspTransferMode && g_usbTransferRemainingSize) || g_nspLayoutMode || g_usbFileDeltaMode || \
+        !filename || !(filename_length = strlen(filename)) || filename_length >= FS_MAX_PATH || (!enforce_nsp_mode && nsp_header_size) || \
+        (enforce_nsp_mode && (g_nspTransferMode || !file_size || !nsp_header_size || nsp_header_size >= file_size)))
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 1.1) (interface).", rc);
-        goto end;
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
     }
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Full, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
-    if (R_FAILED(rc))
+    /* Prepare command data. */
+    usbPrepareCommandHeader(UsbCommandType_SendFileProperties, (u32)sizeof(UsbCommandSendFileProperties));
+
+    UsbCommandSendFileProperties *cmd_block = (UsbCommandSendFileProperties*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+    memset(cmd_block, 0, sizeof(UsbCommandSendFileProperties));
+
+    cmd_block->file_size = file_size;
+    cmd_block->filename_length = (u32)filename_length;
+    cmd_block->nsp_header_size = nsp_header_size;
+    snprintf(cmd_block->filename, sizeof(cmd_block->filename), "%s", filename);
+    cmd_block->checksum_type = checksum_type;
+    cmd_block->resume_offset = resume_offset;
+
+    /* Compress file data if the user asked us to and the USB host supports it. The data transfer stage that follows the first SendFileProperties command from a NSP is skipped. */
+    /* Falls back to raw transfers if we can't allocate the compression buffers. */
+    compressed = (file_size && !enforce_nsp_mode && (g_usbHostCompressionMask & BIT(UsbCompressionType_Lz4)) && configGetBoolean("usb_compression") && \
+                  usbAllocateCompressionBuffers());
+    cmd_block->compression_type = (compressed ? UsbCompressionType_Lz4 : UsbCompressionType_None);
+
+    /* Send command. */
+    usbResetAbortState();
+    ret = usbSendCommand();
+    if (ret)
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 1.1) (in endpoint).", rc);
-        goto end;
+        g_usbTransferRemainingSize = (file_size - resume_offset);
+        g_usbTransferWrittenSize = 0;
+        usbResetFileTransferStats();
+        g_usbTransferCompressed = compressed;
+        if (!g_nspTransferMode && enforce_nsp_mode) g_nspTransferMode = true;
+    } else {
+        g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
+        g_usbTransferCompressed = false;
+        g_nspTransferMode = false;
     }
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Full, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
-    if (R_FAILED(rc))
+    return ret;
+}
+
+static bool _usbSendFileData(const void *data, u64 data_size)
+{
+    void *buf = NULL;
+    bool ret = false, zlt_required = false;
+
+    if (!g_usbTransferBuffer || !g_usbInterfaceInit || !g_usbHostAvailable || !g_usbSessionStarted || !g_usbTransferRemainingSize || !data || !data_size || \
+        data_size > USB_TRANSFER_BUFFER_SIZE || data_size > g_usbTransferRemainingSize)
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 1.1) (out endpoint).", rc);
+        LOG_MSG_ERROR("Invalid parameters!");
         goto end;
     }
 
-    /* High Speed config (USB 2.0). */
-    endpoint_descriptor_in.wMaxPacketSize = endpoint_descriptor_out.wMaxPacketSize = USB_HS_EP_MAX_PACKET_SIZE;
+    /* Optimization for buffers that already are page aligned. Compressed transfers never send data straight from the input buffer. */
+    /* Otherwise, each chunk is copied to the transfer buffer right before being sent, since it may be smaller than the input data (see usbAllocateTransferBuffer()). */
+    bool use_transfer_buffer = (!g_usbTransferCompressed && !IS_ALIGNED((u64)data, USB_TRANSFER_ALIGNMENT));
+    buf = (void*)data;
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_High, &interface_descriptor, USB_DT_INTERFACE_SIZE);
-    if (R_FAILED(rc))
+    /* Split the data chunk into multiple transfers if it exceeds the chunk size negotiated with the host device. */
+    for(u64 offset = 0, chunk_size = 0; offset < data_size; offset += chunk_size)
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 2.0) (interface).", rc);
-        goto end;
+        void *transfer_buf = ((u8*)buf + offset);
+        u64 transfer_size = 0;
+
+        chunk_size = MIN(data_size - offset, g_usbTransferChunkSize);
+        transfer_size = chunk_size;
+
+        if (use_transfer_buffer)
+        {
+            memcpy(g_usbTransferBuffer, transfer_buf, chunk_size);
+            transfer_buf = g_usbTransferBuffer;
+        }
+
+        /* Determine if we'll need to set a Zero Length Termination (ZLT) packet. */
+        /* This is automatically handled by usbDsEndpoint_PostBufferAsync(), depending on the ZLT setting from the input (write) endpoint. */
+        /* Under compressed transfers, frames are variable-sized and the host device reads each one of them using a separate transfer, so ZLT is enabled for all of them. */
+        /* Otherwise, check if this is the last data chunk for this file. */
+        if (g_usbTransferCompressed)
+        {
+            if (!zlt_required)
+            {
+                zlt_required = true;
+                usbSetZltPacket(usbGetDataEndpointIn(), true);
+            }
+
+            /* Compress the current data chunk. Pending asynchronous transfers have already been waited for, so any compression buffer can be used. */
+            transfer_size = usbGenerateFileDataFrame(transfer_buf, chunk_size, &transfer_buf);
+        } else if ((g_usbTransferRemainingSize - chunk_size) == 0)
+        {
+            /* Enable ZLT if the last chunk size is aligned to the USB endpoint max packet size. */
+            if (IS_ALIGNED(chunk_size, atomic_load(&g_usbEndpointMaxPacketSize)))
+            {
+                zlt_required = true;
+                usbSetZltPacket(usbGetDataEndpointIn(), true);
+                LOG_MSG_DEBUG("ZLT enabled. Last chunk size: 0x%lX bytes.", chunk_size);
+            }
+        } else {
+            /* Disable ZLT if this is the first of multiple data chunks. */
+            if (!g_usbTransferWrittenSize)
+            {
+                usbSetZltPacket(usbGetDataEndpointIn(), false);
+                LOG_MSG_DEBUG("ZLT disabled (first chunk).");
+            }
+        }
+
+        /* Send data chunk. It's aborted right away if usbAbortFileTransfer() is called. */
+        u64 start_tick = armGetSystemTick();
+
+        if (!(ret = usbTransferData(transfer_buf, transfer_size, usbGetDataEndpointIn(), true)))
+        {
+            if (g_usbTransferAborted) goto end;
+            LOG_MSG_ERROR("Failed to write 0x%lX bytes long file data chunk from offset 0x%lX! (total size: 0x%lX).", chunk_size, g_usbTransferWrittenSize, \
+                                                                                                                      g_usbTransferRemainingSize + g_usbTransferWrittenSize);
+            goto end;
+        }
+
+        usbRecordTransferLatency(transfer_size, start_tick);
+
+        g_usbTransferRemainingSize -= chunk_size;
+        g_usbTransferWrittenSize += chunk_size;
     }
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_High, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
-    if (R_FAILED(rc))
+    /* Check if this is the last chunk. */
+    if (!g_usbTransferRemainingSize)
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 2.0) (in endpoint).", rc);
-        goto end;
+        /* Check response from host device. */
+        if (!(ret = usbRead(g_usbTransferBuffer, sizeof(UsbStatus))))
+        {
+            LOG_MSG_ERROR("Failed to read 0x%lX bytes long status block!", sizeof(UsbStatus));
+            goto end;
+        }
+
+        UsbStatus *cmd_status = (UsbStatus*)g_usbTransferBuffer;
+
+        if (!(ret = (cmd_status->magic == __builtin_bswap32(USB_CMD_HEADER_MAGIC))))
+        {
+            LOG_MSG_ERROR("Invalid status block magic word! (0x%08X).", __builtin_bswap32(cmd_status->magic));
+            goto end;
+        }
+
+        ret = (cmd_status->status == UsbStatusType_Success);
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+        if (!ret) usbLogStatusDetail(cmd_status->status);
+        if (ret) usbLogTransferStats("File transfer", &g_usbFileTransferStats);
+#endif
     }
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_High, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
-    if (R_FAILED(rc))
+end:
+    /* Disable ZLT if it was previously enabled. */
+    if (zlt_required) usbSetZltPacket(usbGetDataEndpointIn(), false);
+
+    /* Reset variables in case of errors. */
+    if (!ret)
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 2.0) (out endpoint).", rc);
-        goto end;
+        g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
+        g_usbTransferCompressed = false;
+        g_nspTransferMode = g_nspLayoutMode = g_usbFileDeltaMode = false;
     }
 
-    /* Super Speed config (USB 3.0). */
-    endpoint_descriptor_in.wMaxPacketSize = endpoint_descriptor_out.wMaxPacketSize = USB_SS_EP_MAX_PACKET_SIZE;
+    return ret;
+}
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &interface_descriptor, USB_DT_INTERFACE_SIZE);
-    if (R_FAILED(rc))
+static bool _usbRunLinkBenchmark(u64 data_size, u32 chunk_size, u32 queue_depth, bool echo, UsbLinkBenchmarkResult *out)
+{
+    if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode || g_nspLayoutMode || g_usbFileDeltaMode || \
+        !chunk_size || !IS_ALIGNED(chunk_size, USB_TRANSFER_ALIGNMENT) || chunk_size > g_usbTransferBufferSize || !data_size || !IS_ALIGNED(data_size, chunk_size) || \
+        (!echo && (!queue_depth || queue_depth > USB_MAX_PENDING_TRANSFERS)) || !out)
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (interface).", rc);
-        goto end;
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
     }
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
-    if (R_FAILED(rc))
+    u32 urb_ids[USB_MAX_PENDING_TRANSFERS] = {0};
+    u64 post_ticks[USB_MAX_PENDING_TRANSFERS] = {0};
+    u32 pending_idx = 0, pending_count = 0;
+
+    u64 offset = 0, start_tick = 0, latency = 0, total_latency = 0, chunk_count = (data_size / chunk_size);
+    u8 *echo_buf = NULL;
+    bool ret = false;
+
+    /* Echoed chunks are read back one at a time. */
+    if (echo) queue_depth = 1;
+
+    memset(out, 0, sizeof(UsbLinkBenchmarkResult));
+    out->data_size = data_size;
+    out->chunk_size = chunk_size;
+    out->queue_depth = queue_depth;
+    out->echo = echo;
+
+    /* Allocate a buffer for the echoed chunks, if needed. */
+    if (echo && !(echo_buf = usbAllocatePageAlignedBuffer(chunk_size)))
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (in endpoint).", rc);
+        LOG_MSG_ERROR("Failed to allocate 0x%X bytes long echo buffer!", chunk_size);
         goto end;
     }
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_companion, USB_DT_SS_ENDPOINT_COMPANION_SIZE);
-    if (R_FAILED(rc))
+    /* Prepare command data. */
+    usbPrepareCommandHeader(UsbCommandType_StartLinkBenchmark, (u32)sizeof(UsbCommandStartLinkBenchmark));
+
+    UsbCommandStartLinkBenchmark *cmd_block = (UsbCommandStartLinkBenchmark*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
+    memset(cmd_block, 0, sizeof(UsbCommandStartLinkBenchmark));
+
+    cmd_block->data_size = data_size;
+    cmd_block->chunk_size = chunk_size;
+    cmd_block->queue_depth = (u8)queue_depth;
+    cmd_block->echo = (u8)echo;
+
+    /* Send command. */
+    if (!usbSendCommand()) goto end;
+
+    /* Fill the transfer buffer with generated data. The same data is sent in every chunk, so it never stays in the way of the measurements. */
+    usbGenerateLinkBenchmarkData(g_usbTransferBuffer, chunk_size);
+
+    /* Every chunk is aligned to the endpoint max packet size and the host device knows the size of all of them beforehand, so ZLT isn't needed. */
+    usbSetZltPacket(usbGetDataEndpointIn(), false);
+
+    start_tick = armGetSystemTick();
+
+    while(offset < data_size || pending_count)
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (in endpoint companion).", rc);
-        goto end;
+        /* Keep posting chunks until we reach the requested queue depth. All of them are posted from the same buffer. */
+        if (offset < data_size && pending_count < queue_depth)
+        {
+            u32 idx = ((pending_idx + pending_count) % USB_MAX_PENDING_TRANSFERS);
+
+            if (!usbPostTransfer(g_usbTransferBuffer, chunk_size, usbGetDataEndpointIn(), &(urb_ids[idx])))
+            {
+                LOG_MSG_ERROR("Failed to post 0x%X bytes long benchmark chunk from offset 0x%lX!", chunk_size, offset);
+                goto end;
+            }
+
+            post_ticks[idx] = armGetSystemTick();
+            pending_count++;
+            offset += chunk_size;
+
+            continue;
+        }
+
+        /* Wait for the oldest in-flight chunk. */
+        if (!usbWaitForTransfer(usbGetDataEndpointIn(), urb_ids[pending_idx], chunk_size, false))
+        {
+            LOG_MSG_ERROR("Benchmark chunk transfer failed! (URB ID %u).", urb_ids[pending_idx]);
+            goto end;
+        }
+
+        /* Read the chunk back from the host device, if needed. */
+        if (echo && !usbTransferData(echo_buf, chunk_size, usbGetDataEndpointOut(), false))
+        {
+            LOG_MSG_ERROR("Failed to read 0x%X bytes long echoed benchmark chunk!", chunk_size);
+            goto end;
+        }
+
+        latency = armTicksToNs(armGetSystemTick() - post_ticks[pending_idx]);
+
+        if (!out->min_latency || latency < out->min_latency) out->min_latency = latency;
+        if (latency > out->max_latency) out->max_latency = latency;
+        total_latency += latency;
+
+        /* Don't bail out on mismatches. The host device still expects the rest of the chunks. */
+        if (echo && memcmp(echo_buf, g_usbTransferBuffer, chunk_size) != 0) out->echo_mismatch_count++;
+
+        pending_idx = ((pending_idx + 1) % USB_MAX_PENDING_TRANSFERS);
+        pending_count--;
     }
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
-    if (R_FAILED(rc))
+    out->elapsed_time = armTicksToNs(armGetSystemTick() - start_tick);
+    out->avg_latency = (total_latency / chunk_count);
+
+    /* Check response from host device. */
+    if (!usbRead(g_usbTransferBuffer, sizeof(UsbStatus)))
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (out endpoint).", rc);
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes long status block!", sizeof(UsbStatus));
         goto end;
     }
 
-    rc = usbDsInterface_AppendConfigurationData(g_usbInterface, UsbDeviceSpeed_Super, &endpoint_companion, USB_DT_SS_ENDPOINT_COMPANION_SIZE);
-    if (R_FAILED(rc))
+    UsbStatus *cmd_status = (UsbStatus*)g_usbTransferBuffer;
+
+    if (cmd_status->magic != __builtin_bswap32(USB_CMD_HEADER_MAGIC))
     {
-        LOG_MSG_ERROR("usbDsInterface_AppendConfigurationData failed! (0x%X) (USB 3.0) (out endpoint companion).", rc);
+        LOG_MSG_ERROR("Invalid status block magic word! (0x%08X).", __builtin_bswap32(cmd_status->magic));
         goto end;
     }
 
-    /* Setup endpoints. */
-    rc = usbDsInterface_RegisterEndpoint(g_usbInterface, &g_usbEndpointIn, endpoint_descriptor_in.bEndpointAddress);
-    if (R_FAILED(rc))
+    if (cmd_status->status != UsbStatusType_Success)
     {
-        LOG_MSG_ERROR("usbDsInterface_RegisterEndpoint failed! (0x%X) (in endpoint).", rc);
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+        usbLogStatusDetail(cmd_status->status);
+#endif
         goto end;
     }
 
-    rc = usbDsInterface_RegisterEndpoint(g_usbInterface, &g_usbEndpointOut, endpoint_descriptor_out.bEndpointAddress);
-    if (R_FAILED(rc))
+    /* Read host device measurements. This block is smaller than the endpoint max packet size under all USB speeds, so no ZLT packet is involved. */
+    if (!usbRead(g_usbTransferBuffer, sizeof(UsbLinkBenchmarkHostResult)))
     {
-        LOG_MSG_ERROR("usbDsInterface_RegisterEndpoint failed! (0x%X) (out endpoint).", rc);
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes long benchmark result block!", sizeof(UsbLinkBenchmarkHostResult));
         goto end;
     }
 
+    UsbLinkBenchmarkHostResult *host_result = (UsbLinkBenchmarkHostResult*)g_usbTransferBuffer;
+    out->host_elapsed_time = host_result->elapsed_time;
+    out->host_min_latency = host_result->min_latency;
+    out->host_max_latency = host_result->max_latency;
+    out->host_avg_latency = (host_result->total_latency / chunk_count);
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+    usbLogLinkBenchmarkResult(out);
+#endif
+
     ret = true;
 
 end:
+    /* Cancel any chunks still in flight. The host device will time out on its own. */
+    if (pending_count)
+    {
+        UsbDsEndpoint *endpoint = usbGetDataEndpointIn();
+        usbDsEndpoint_Cancel(endpoint);
+        eventWait(&(endpoint->CompletionEvent), USB_TRANSFER_TIMEOUT * (u64)1000000000);
+        eventClear(&(endpoint->CompletionEvent));
+    }
+
+    if (echo_buf) free(echo_buf);
+
     return ret;
 }
 
-static bool usbInitializeComms1x(void)
+static void usbGenerateLinkBenchmarkData(u8 *buf, u32 size)
 {
-    Result rc = 0;
-    bool ret = false;
+    /* Use a xorshift32 sequence. Unlike a constant pattern, it makes corrupted or shifted echoed data easy to spot. */
+    u32 state = 0x4E584454, *ptr = (u32*)buf;
 
-    static const UsbDsDeviceInfo device_info = {
-        .idVendor = USB_DEV_VID,
-        .idProduct = USB_DEV_PID,
-        .bcdDevice = USB_DEV_BCD_REL,
-        .Manufacturer = APP_AUTHOR,
-        .Product = APP_TITLE,
-        .SerialNumber = APP_VERSION
-    };
-
-    struct usb_interface_descriptor interface_descriptor = {
-        .bLength = USB_DT_INTERFACE_SIZE,
-        .bDescriptorType = USB_DT_INTERFACE,
-        .bInterfaceNumber = 0,
-        .bAlternateSetting = 0,
-        .bInterfaceClass = USB_CLASS_VENDOR_SPEC,
-        .bInterfaceSubClass = USB_CLASS_VENDOR_SPEC,
-        .bInterfaceProtocol = USB_CLASS_VENDOR_SPEC,
-        .iInterface = 0
-    };
+    for(u32 i = 0; i < (size / sizeof(u32)); i++)
+    {
+        state ^= (state << 13);
+        state ^= (state >> 17);
+        state ^= (state << 5);
+        ptr[i] = state;
+    }
+}
 
-    struct usb_endpoint_descriptor endpoint_descriptor_in = {
-        .bLength = USB_DT_ENDPOINT_SIZE,
-        .bDescriptorType = USB_DT_ENDPOINT,
-        .bEndpointAddress = USB_ENDPOINT_IN,
-        .bmAttributes = USB_TRANSFER_TYPE_BULK,
-        .wMaxPacketSize = USB_HS_EP_MAX_PACKET_SIZE,
-        .bInterval = 0
-    };
+static bool usbValidateNspLayout(u64 nsp_size, const UsbNspLayoutEntry *entries, u32 entry_count)
+{
+    /* The first region always holds the NSP header. */
+    if (!nsp_size || !entries || entry_count < 2 || entry_count > USB_NSP_LAYOUT_MAX_ENTRY_COUNT || entries[0].offset || !entries[0].size) return false;
 
-    struct usb_endpoint_descriptor endpoint_descriptor_out = {
-        .bLength = USB_DT_ENDPOINT_SIZE,
-        .bDescriptorType = USB_DT_ENDPOINT,
-        .bEndpointAddress = USB_ENDPOINT_OUT,
-        .bmAttributes = USB_TRANSFER_TYPE_BULK,
-        .wMaxPacketSize = USB_HS_EP_MAX_PACKET_SIZE,
-        .bInterval = 0
-    };
+    /* Regions must be contiguous and must cover the whole NSP. Empty NSP file entries are allowed. */
+    u64 offset = 0;
 
-    /* Set VID, PID and BCD. */
-    rc = usbDsSetVidPidBcd(&device_info);
-    if (R_FAILED(rc))
+    for(u32 i = 0; i < entry_count; i++)
     {
-        LOG_MSG_ERROR("usbDsSetVidPidBcd failed! (0x%X).", rc);
-        goto end;
+        const UsbNspLayoutEntry *entry = &(entries[i]);
+
+        if (entry->offset != offset || entry->size > (nsp_size - offset))
+        {
+            LOG_MSG_ERROR("Invalid NSP layout entry #%u! (offset 0x%lX, size 0x%lX).", i, entry->offset, entry->size);
+            return false;
+        }
+
+        offset += entry->size;
     }
 
-    /* Setup interface. */
-    rc = usbDsGetDsInterface(&g_usbInterface, &interface_descriptor, "usb");
-    if (R_FAILED(rc))
+    if (offset != nsp_size)
     {
-        LOG_MSG_ERROR("usbDsGetDsInterface failed! (0x%X).", rc);
-        goto end;
+        LOG_MSG_ERROR("NSP layout size mismatch! (0x%lX != 0x%lX).", offset, nsp_size);
+        return false;
     }
 
-    /* Setup endpoints. */
-    rc = usbDsInterface_GetDsEndpoint(g_usbInterface, &g_usbEndpointIn, &endpoint_descriptor_in);
-    if (R_FAILED(rc))
+    return true;
+}
+
+static bool usbUpdateNspLayout(u32 entry_idx, u64 data_size)
+{
+    g_usbNspLayoutSentSizes[entry_idx] += data_size;
+    g_usbNspLayoutRemainingSize -= data_size;
+
+    /* Empty regions (e.g. empty NSP file entries) never get any data, so they're already complete. */
+    if (!g_usbNspLayoutRemainingSize) g_nspLayoutMode = false;
+
+    return g_nspLayoutMode;
+}
+
+static bool usbAllocateCompressionBuffers(void)
+{
+    for(u32 i = 0; i < USB_COMPRESSION_BUFFER_COUNT; i++)
     {
-        LOG_MSG_ERROR("usbDsInterface_GetDsEndpoint failed! (0x%X) (in endpoint).", rc);
-        goto end;
+        if (g_usbCompressionBuffers[i]) continue;
+
+        g_usbCompressionBuffers[i] = bufferPoolLease(USB_COMPRESSION_BUFFER_SIZE, false);
+        if (!g_usbCompressionBuffers[i])
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for USB compression buffer #%u!", i);
+            usbFreeCompressionBuffers();
+            return false;
+        }
     }
 
-    rc = usbDsInterface_GetDsEndpoint(g_usbInterface, &g_usbEndpointOut, &endpoint_descriptor_out);
-    if (R_FAILED(rc))
+    return true;
+}
+
+static void usbFreeCompressionBuffers(void)
+{
+    for(u32 i = 0; i < USB_COMPRESSION_BUFFER_COUNT; i++)
     {
-        LOG_MSG_ERROR("usbDsInterface_GetDsEndpoint failed! (0x%X) (out endpoint).", rc);
-        goto end;
+        if (!g_usbCompressionBuffers[i]) continue;
+        bufferPoolReturn(g_usbCompressionBuffers[i]);
+        g_usbCompressionBuffers[i] = NULL;
     }
 
-    ret = true;
-
-end:
-    return ret;
+    g_usbCompressionBufferIdx = 0;
 }
 
-static void usbCloseComms(void)
+static u64 usbGenerateFileDataFrame(const void *data, u64 data_size, void **out_frame)
 {
-    bool is_5x = hosversionAtLeast(5, 0, 0);
+    u8 *frame = g_usbCompressionBuffers[g_usbCompressionBufferIdx];
+    UsbFileDataFrame *frame_header = (UsbFileDataFrame*)frame;
+    int stored_size = 0;
 
-    if (is_5x && g_usbHos5xEnabled)
-    {
-        usbDsDisable();
-        g_usbHos5xEnabled = false;
-    }
+    g_usbCompressionBufferIdx = ((g_usbCompressionBufferIdx + 1) % USB_COMPRESSION_BUFFER_COUNT);
 
-    if (g_usbEndpointOut)
+    memset(frame_header, 0, sizeof(UsbFileDataFrame));
+    frame_header->raw_size = (u32)data_size;
+
+    /* Compressed data must be smaller than raw data. LZ4_compress_fast_extState() returns zero if it doesn't fit within the output buffer, which is what */
+    /* usually happens with encrypted data. Store the chunk as-is in that case. */
+    stored_size = LZ4_compress_fast_extState(&g_usbCompressionState, (const char*)data, (char*)(frame + sizeof(UsbFileDataFrame)), (int)data_size, (int)data_size - 1, 1);
+    if (stored_size > 0)
     {
-        usbDsEndpoint_Close(g_usbEndpointOut);
-        g_usbEndpointOut = NULL;
+        frame_header->compression_type = UsbCompressionType_Lz4;
+    } else {
+        frame_header->compression_type = UsbCompressionType_None;
+        memcpy(frame + sizeof(UsbFileDataFrame), data, data_size);
+        stored_size = (int)data_size;
     }
 
-    if (g_usbEndpointIn)
+    frame_header->stored_size = (u32)stored_size;
+
+    *out_frame = frame;
+
+    return (sizeof(UsbFileDataFrame) + (u64)stored_size);
+}
+
+static bool usbWaitForPendingTransfers(bool wait_all)
+{
+    while(g_usbPendingTransferCount)
     {
-        usbDsEndpoint_Close(g_usbEndpointIn);
-        g_usbEndpointIn = NULL;
+        UsbPendingTransfer transfer = g_usbPendingTransfers[g_usbPendingTransferIdx];
+
+        if (!usbWaitForTransfer(usbGetDataEndpointIn(), transfer.urb_id, transfer.size, true))
+        {
+            if (!g_usbTransferAborted) LOG_MSG_ERROR("Asynchronous 0x%lX bytes long file data transfer failed! (URB ID %u).", transfer.size, transfer.urb_id);
+
+            /* Cancel every other transfer posted to the input endpoint. Their completion statuses are checked before waiting on the completion event, so a stale event is harmless. */
+            usbDsEndpoint_Cancel(usbGetDataEndpointIn());
+            usbFailPendingTransfers();
+            return false;
+        }
+
+        /* The transfer may have been completed way before we started waiting for it, so this is actually an upper bound. */
+        usbRecordTransferLatency(transfer.size, transfer.post_tick);
+
+        /* Remove the transfer from the queue before issuing its callback. */
+        g_usbPendingTransferIdx = ((g_usbPendingTransferIdx + 1) % USB_MAX_PENDING_TRANSFERS);
+        g_usbPendingTransferCount--;
+
+        if (transfer.callback) transfer.callback(transfer.user_data, true);
+
+        if (!wait_all) break;
     }
 
-    if (g_usbInterface)
+    return true;
+}
+
+static bool usbWaitForFreePendingTransferSlot(void)
+{
+    /* Keep track of the time the producer spends waiting for the oldest pending transfer. */
+    u64 start_tick = armGetSystemTick();
+    bool ret = usbWaitForPendingTransfers(false);
+
+    u64 elapsed_time = armTicksToNs(armGetSystemTick() - start_tick);
+
+    g_usbSessionTransferStats.stall_count++;
+    g_usbSessionTransferStats.stall_time += elapsed_time;
+    g_usbFileTransferStats.stall_count++;
+    g_usbFileTransferStats.stall_time += elapsed_time;
+
+    return ret;
+}
+
+static void usbCancelPendingTransfers(void)
+{
+    if (!g_usbPendingTransferCount) return;
+
+    UsbDsEndpoint *endpoint = usbGetDataEndpointIn();
+
+    /* Cancel all transfers posted to the input endpoint. */
+    usbDsEndpoint_Cancel(endpoint);
+
+    /* Safety measure: wait until the completion event is triggered again before proceeding. */
+    eventWait(&(endpoint->CompletionEvent), USB_TRANSFER_TIMEOUT * (u64)1000000000);
+    eventClear(&(endpoint->CompletionEvent));
+
+    usbFailPendingTransfers();
+}
+
+static void usbFailPendingTransfers(void)
+{
+    /* Issue callbacks for all pending transfers, in order. */
+    while(g_usbPendingTransferCount)
     {
-        /* usbDsInterface_DisableInterface() is internally called here. */
-        usbDsInterface_Close(g_usbInterface);
-        g_usbInterface = NULL;
+        UsbPendingTransfer transfer = g_usbPendingTransfers[g_usbPendingTransferIdx];
+
+        g_usbPendingTransferIdx = ((g_usbPendingTransferIdx + 1) % USB_MAX_PENDING_TRANSFERS);
+        g_usbPendingTransferCount--;
+
+        if (transfer.callback) transfer.callback(transfer.user_data, false);
     }
 
-    if (is_5x) usbDsClearDeviceData();
+    g_usbPendingTransferIdx = 0;
+
+    /* Reset variables. The current file transfer can't be completed anymore. */
+    g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
+    g_usbTransferCompressed = false;
+    g_nspTransferMode = g_nspLayoutMode = g_usbFileDeltaMode = false;
 }
 
-static bool _usbSendFileProperties(u64 file_size, const char *filename, u32 nsp_header_size, bool enforce_nsp_mode)
+NX_INLINE void usbResetAbortState(void)
 {
-    bool ret = false;
-    size_t filename_length = 0;
+    ueventClear(&g_usbAbortEvent);
+    g_usbTransferAborted = false;
+}
 
-    /* Disallow sending new files if we're not in NSP transfer mode and the remaining transfer size isn't zero. */
-    /* Allow empty files if we're not in NSP transfer mode. */
-    /* Disallow sending new NSPs if we're already in NSP transfer mode. */
-    if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || (!g_nspTransferMode && g_usbTransferRemainingSize) || \
-        !filename || !(filename_length = strlen(filename)) || filename_length >= FS_MAX_PATH || (!enforce_nsp_mode && nsp_header_size) || \
-        (enforce_nsp_mode && (g_nspTransferMode || !file_size || !nsp_header_size || nsp_header_size >= file_size)))
+static void usbResetFileTransferStats(void)
+{
+    memset(&g_usbFileTransferStats, 0, sizeof(UsbTransferStats));
+}
+
+static void usbRecordTransferLatency(u64 size, u64 start_tick)
+{
+    u64 latency = armTicksToNs(armGetSystemTick() - start_tick);
+    UsbTransferStats *stats[] = { &g_usbSessionTransferStats, &g_usbFileTransferStats };
+
+    for(u32 i = 0; i < MAX_ELEMENTS(stats); i++)
     {
-        LOG_MSG_ERROR("Invalid parameters!");
-        return false;
-    }
+        UsbTransferStats *cur_stats = stats[i];
 
-    /* Prepare command data. */
-    usbPrepareCommandHeader(UsbCommandType_SendFileProperties, (u32)sizeof(UsbCommandSendFileProperties));
+        if (!cur_stats->chunk_count || latency < cur_stats->min_latency) cur_stats->min_latency = latency;
+        if (latency > cur_stats->max_latency) cur_stats->max_latency = latency;
 
-    UsbCommandSendFileProperties *cmd_block = (UsbCommandSendFileProperties*)(g_usbTransferBuffer + sizeof(UsbCommandHeader));
-    memset(cmd_block, 0, sizeof(UsbCommandSendFileProperties));
+        cur_stats->chunk_count++;
+        cur_stats->chunk_size += size;
+        cur_stats->total_latency += latency;
+    }
+}
 
-    cmd_block->file_size = file_size;
-    cmd_block->filename_length = (u32)filename_length;
-    cmd_block->nsp_header_size = nsp_header_size;
-    snprintf(cmd_block->filename, sizeof(cmd_block->filename), "%s", filename);
+static void usbRecordQueueDepth(void)
+{
+    UsbTransferStats *stats[] = { &g_usbSessionTransferStats, &g_usbFileTransferStats };
 
-    /* Send command. */
-    ret = usbSendCommand();
-    if (ret)
+    for(u32 i = 0; i < MAX_ELEMENTS(stats); i++)
     {
-        g_usbTransferRemainingSize = file_size;
-        g_usbTransferWrittenSize = 0;
-        if (!g_nspTransferMode && enforce_nsp_mode) g_nspTransferMode = true;
-    } else {
-        g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
-        g_nspTransferMode = false;
+        UsbTransferStats *cur_stats = stats[i];
+
+        cur_stats->async_chunk_count++;
+        cur_stats->queue_depth_sum += g_usbPendingTransferCount;
+        if (g_usbPendingTransferCount > cur_stats->max_queue_depth) cur_stats->max_queue_depth = g_usbPendingTransferCount;
     }
+}
 
-    return ret;
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+static void usbLogTransferStats(const char *label, const UsbTransferStats *stats)
+{
+    if (!stats->chunk_count) return;
+
+    LOG_MSG_INFO("%s stats: %lu chunk(s), 0x%lX bytes. Latency (us): avg %lu, min %lu, max %lu. Stalls: %lu (%lu ms). Queue depth: avg %lu.%02lu, max %u.", label, \
+                 stats->chunk_count, stats->chunk_size, (stats->total_latency / stats->chunk_count) / 1000, stats->min_latency / 1000, stats->max_latency / 1000, \
+                 stats->stall_count, stats->stall_time / 1000000, \
+                 (stats->async_chunk_count ? (stats->queue_depth_sum / stats->async_chunk_count) : 0), \
+                 (stats->async_chunk_count ? (((stats->queue_depth_sum % stats->async_chunk_count) * 100) / stats->async_chunk_count) : 0), stats->max_queue_depth);
+}
+
+static void usbLogLinkBenchmarkResult(const UsbLinkBenchmarkResult *result)
+{
+    LOG_MSG_INFO("Link benchmark (%s, 0x%lX bytes, 0x%X-byte chunks, queue depth %u): console %.2f MiB/s, latency (us) avg %lu, min %lu, max %lu | host %.2f MiB/s, latency (us) avg %lu, min %lu, max %lu.", \
+                 result->echo ? "echo" : "discard", result->data_size, result->chunk_size, result->queue_depth, \
+                 usbGetLinkBenchmarkThroughput(result, false), result->avg_latency / 1000, result->min_latency / 1000, result->max_latency / 1000, \
+                 usbGetLinkBenchmarkThroughput(result, true), result->host_avg_latency / 1000, result->host_min_latency / 1000, result->host_max_latency / 1000);
+
+    if (result->echo_mismatch_count) LOG_MSG_WARNING("%u echoed chunk(s) didn't match the data we sent!", result->echo_mismatch_count);
 }
+#endif
 
 NX_INLINE bool usbIsHostAvailable(void)
 {
@@ -1308,24 +2900,36 @@ NX_INLINE bool usbIsHostAvailable(void)
     return (R_SUCCEEDED(rc) && state == UsbState_Configured);
 }
 
-NX_INLINE void usbSetZltPacket(bool enable)
+NX_INLINE UsbDsEndpoint *usbGetDataEndpointIn(void)
+{
+    return (g_usbDataEndpointsEnabled ? g_usbDataEndpointIn : g_usbEndpointIn);
+}
+
+NX_INLINE UsbDsEndpoint *usbGetDataEndpointOut(void)
+{
+    return (g_usbDataEndpointsEnabled ? g_usbDataEndpointOut : g_usbEndpointOut);
+}
+
+NX_INLINE void usbSetZltPacket(UsbDsEndpoint *endpoint, bool enable)
 {
-    usbDsEndpoint_SetZlt(g_usbEndpointIn, enable);
+    usbDsEndpoint_SetZlt(endpoint, enable);
 }
 
 NX_INLINE bool usbRead(void *buf, u64 size)
 {
-    return usbTransferData(buf, size, g_usbEndpointOut);
+    return usbTransferData(buf, size, g_usbEndpointOut, false);
 }
 
-NX_INLINE bool usbWrite(void *buf, u64 size)
+static bool usbTransferData(void *buf, u64 size, UsbDsEndpoint *endpoint, bool abortable)
 {
-    return usbTransferData(buf, size, g_usbEndpointIn);
+    TRACE_FUNC();
+    u32 urb_id = 0;
+    return (usbPostTransfer(buf, size, endpoint, &urb_id) && usbWaitForTransfer(endpoint, urb_id, size, abortable));
 }
 
-static bool usbTransferData(void *buf, u64 size, UsbDsEndpoint *endpoint)
+static bool usbPostTransfer(void *buf, u64 size, UsbDsEndpoint *endpoint, u32 *out_urb_id)
 {
-    if (!buf || !IS_ALIGNED((u64)buf, USB_TRANSFER_ALIGNMENT) || !size || !endpoint)
+    if (!buf || !IS_ALIGNED((u64)buf, USB_TRANSFER_ALIGNMENT) || !size || !endpoint || !out_urb_id)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -1337,71 +2941,102 @@ static bool usbTransferData(void *buf, u64 size, UsbDsEndpoint *endpoint)
         return false;
     }
 
-    Result rc = 0;
-    UsbDsReportData report_data = {0};
-    u32 urb_id = 0, transferred_size = 0;
-    bool thread_exit = false;
-
     /* Start a USB transfer using the provided endpoint. */
-    rc = usbDsEndpoint_PostBufferAsync(endpoint, buf, size, &urb_id);
+    statsAddCounter(StatsCounterType_UsbTransfer, size);
+    Result rc = usbDsEndpoint_PostBufferAsync(endpoint, buf, size, out_urb_id);
     if (R_FAILED(rc))
     {
-        LOG_MSG_ERROR("usbDsEndpoint_PostBufferAsync failed! (0x%X) (URB ID %u).", rc, urb_id);
+        LOG_MSG_ERROR("usbDsEndpoint_PostBufferAsync failed! (0x%X) (URB ID %u).", rc, *out_urb_id);
         return false;
     }
 
-    /* Wait for the transfer to finish. */
-    if (g_usbSessionStarted)
+    return true;
+}
+
+static bool usbWaitForTransfer(UsbDsEndpoint *endpoint, u32 urb_id, u64 size, bool abortable)
+{
+    Result rc = 0;
+    u32 transferred_size = 0;
+    u8 status = UsbUrbStatus_Invalid;
+    bool thread_exit = false, aborted = false;
+
+    while(true)
     {
-        /* If the USB session has already been established, then use a regular timeout value. */
-        rc = eventWait(&(endpoint->CompletionEvent), USB_TRANSFER_TIMEOUT * (u64)1000000000);
-    } else {
-        /* If we're starting a USB session, wait indefinitely inside a loop to let the user start the host script. */
-        int idx = 0;
-        Waiter completion_event_waiter = waiterForEvent(&(endpoint->CompletionEvent));
-        Waiter exit_event_waiter = waiterForUEvent(&g_usbDetectionThreadExitEvent);
+        /* Check if the transfer is already done. If multiple transfers are in flight, the completion event may have been consumed while waiting for a previous one. */
+        status = usbGetTransferStatus(endpoint, urb_id, &transferred_size);
+        if (status != UsbUrbStatus_Invalid && status != UsbUrbStatus_Pending && status != UsbUrbStatus_Running) break;
 
-        rc = waitMulti(&idx, -1, completion_event_waiter, exit_event_waiter);
-        if (R_SUCCEEDED(rc) && idx == 1)
+        /* Wait for the transfer to finish. */
+        if (g_usbSessionStarted && abortable)
         {
-            /* Exit event triggered. */
-            rc = MAKERESULT(Module_Kernel, KernelError_TimedOut);
-            g_usbDetectionThreadExitFlag = thread_exit = true;
+            /* Same as below, but let usbAbortFileTransfer() interrupt the wait. */
+            int idx = 0;
+            Waiter completion_event_waiter = waiterForEvent(&(endpoint->CompletionEvent));
+            Waiter abort_event_waiter = waiterForUEvent(&g_usbAbortEvent);
+
+            rc = waitMulti(&idx, USB_TRANSFER_TIMEOUT * (u64)1000000000, completion_event_waiter, abort_event_waiter);
+            aborted = (R_SUCCEEDED(rc) && idx == 1);
+        } else
+        if (g_usbSessionStarted)
+        {
+            /* If the USB session has already been established, then use a regular timeout value. */
+            rc = eventWait(&(endpoint->CompletionEvent), USB_TRANSFER_TIMEOUT * (u64)1000000000);
+        } else {
+            /* If we're starting a USB session, wait indefinitely inside a loop to let the user start the host script. */
+            int idx = 0;
+            Waiter completion_event_waiter = waiterForEvent(&(endpoint->CompletionEvent));
+            Waiter exit_event_waiter = waiterForUEvent(&g_usbDetectionThreadExitEvent);
+
+            rc = waitMulti(&idx, -1, completion_event_waiter, exit_event_waiter);
+            if (R_SUCCEEDED(rc) && idx == 1)
+            {
+                /* Exit event triggered. */
+                rc = MAKERESULT(Module_Kernel, KernelError_TimedOut);
+                g_usbDetectionThreadExitFlag = thread_exit = true;
+            }
         }
-    }
 
-    /* Clear the endpoint completion event. */
-    if (!thread_exit) eventClear(&(endpoint->CompletionEvent));
+        if (aborted)
+        {
+            /* Cancel all transfers posted to this endpoint. The host device receives whatever was already sent, followed by the CancelFileTransfer command. */
+            /* The USB session is kept alive. */
+            usbDsEndpoint_Cancel(endpoint);
 
-    if (R_FAILED(rc))
-    {
-        /* Cancel transfer. */
-        usbDsEndpoint_Cancel(endpoint);
+            /* Safety measure: wait until the completion event is triggered again before proceeding. This happens right away. */
+            eventWait(&(endpoint->CompletionEvent), USB_TRANSFER_TIMEOUT * (u64)1000000000);
+            eventClear(&(endpoint->CompletionEvent));
 
-        /* Safety measure: wait until the completion event is triggered again before proceeding. */
-        eventWait(&(endpoint->CompletionEvent), UINT64_MAX);
-        eventClear(&(endpoint->CompletionEvent));
+            g_usbTransferAborted = true;
+            LOG_MSG_DEBUG("USB transfer aborted (URB ID %u).", urb_id);
 
-        /* Signal user-mode USB timeout event if needed. */
-        /* This will "reset" the USB connection by making the background thread wait until a new session is established. */
-        if (g_usbSessionStarted) ueventSignal(&g_usbTimeoutEvent);
+            return false;
+        }
 
-        if (!thread_exit) LOG_MSG_ERROR("eventWait failed! (0x%X) (URB ID %u).", rc, urb_id);
+        /* Clear the endpoint completion event. */
+        if (!thread_exit) eventClear(&(endpoint->CompletionEvent));
 
-        return false;
-    }
+        if (R_FAILED(rc))
+        {
+            /* Cancel transfer. */
+            usbDsEndpoint_Cancel(endpoint);
 
-    rc = usbDsEndpoint_GetReportData(endpoint, &report_data);
-    if (R_FAILED(rc))
-    {
-        LOG_MSG_ERROR("usbDsEndpoint_GetReportData failed! (0x%X) (URB ID %u).", rc, urb_id);
-        return false;
+            /* Safety measure: wait until the completion event is triggered again before proceeding. */
+            eventWait(&(endpoint->CompletionEvent), UINT64_MAX);
+            eventClear(&(endpoint->CompletionEvent));
+
+            /* Signal user-mode USB timeout event if needed. */
+            /* This will "reset" the USB connection by making the background thread wait until a new session is established. */
+            if (g_usbSessionStarted) ueventSignal(&g_usbTimeoutEvent);
+
+            if (!thread_exit) LOG_MSG_ERROR("eventWait failed! (0x%X) (URB ID %u).", rc, urb_id);
+
+            return false;
+        }
     }
 
-    rc = usbDsParseReportData(&report_data, urb_id, NULL, &transferred_size);
-    if (R_FAILED(rc))
+    if (status != UsbUrbStatus_Finished)
     {
-        LOG_MSG_ERROR("usbDsParseReportData failed! (0x%X) (URB ID %u).", rc, urb_id);
+        LOG_MSG_ERROR("USB transfer failed! URB status: %u (URB ID %u).", status, urb_id);
         return false;
     }
 
@@ -1413,3 +3048,29 @@ static bool usbTransferData(void *buf, u64 size, UsbDsEndpoint *endpoint)
 
     return true;
 }
+
+static u8 usbGetTransferStatus(UsbDsEndpoint *endpoint, u32 urb_id, u32 *out_transferred_size)
+{
+    UsbDsReportData report_data = {0};
+
+    Result rc = usbDsEndpoint_GetReportData(endpoint, &report_data);
+    if (R_FAILED(rc))
+    {
+        LOG_MSG_ERROR("usbDsEndpoint_GetReportData failed! (0x%X) (URB ID %u).", rc, urb_id);
+        return UsbUrbStatus_Failed;
+    }
+
+    /* Look for the report entry that matches the provided URB ID. Its status is left as invalid if it isn't available yet. */
+    u32 report_count = MIN(report_data.report_count, (u32)MAX_ELEMENTS(report_data.report));
+
+    for(u32 i = 0; i < report_count; i++)
+    {
+        UsbDsReportEntry *entry = &(report_data.report[i]);
+        if (entry->id != urb_id) continue;
+
+        *out_transferred_size = entry->transferredSize;
+        return (u8)entry->urb_status;
+    }
+
+    return UsbUrbStatus_Invalid;
+}
@@ -0,0 +1,392 @@
+/*
+ * bis_partition_dump_task.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include <tasks/bis_partition_dump_task.hpp>
+#include <utils/scope_guard.hpp>
+#include <utils/file_writer.hpp>
+
+namespace i18n = brls::i18n;    /* For getStr(). */
+using namespace i18n::literals; /* For _i18n. */
+
+namespace nxdt::tasks
+{
+    /* Allocated cluster runs separated by unallocated gaps smaller than this are read with a single call. The gaps are still zeroed out afterwards. */
+    static constexpr size_t BisPartitionMinSkippedRunSize = 0x40000; /* 256 KiB. */
+
+    BisPartitionDumpTaskError BisPartitionDumpTask::DoInBackground(const std::string& output_path, const u8& bis_partition_id, const bool& skip_unallocated,
+                                                                   const bool& calculate_checksum)
+    {
+        std::scoped_lock lock(this->task_mtx);
+
+        u64 partition_size = 0;
+        bool usb_host = (nxdt::utils::FileWriter::GetStorageTypeByPath(output_path) == nxdt::utils::FileWriter::StorageType::UsbHost);
+
+        Thread write_thread{}, hash_thread{};
+
+        /* Update private variables. */
+        this->calculate_checksum = calculate_checksum;
+        memset(this->image_hash, 0, sizeof(this->image_hash));
+
+        LOG_MSG_DEBUG("Starting dump with parameters:\n- Output path: \"%s\".\n- BIS partition ID: %u.\n- Skip unallocated clusters: %u.\n- Calculate checksum: %u.", \
+                      output_path.c_str(), bis_partition_id, skip_unallocated, calculate_checksum);
+
+        /* Retrieve partition size. */
+        if (!bisStorageGetPartitionSize(bis_partition_id, &partition_size) || !partition_size) return "tasks/bis/partition/get_size_failed"_i18n;
+
+        /* Retrieve cluster allocation bitmap, if needed. Fall back to a full dump if it can't be generated. */
+        ON_SCOPE_EXIT { bisStorageFreeClusterBitmap(&(this->cluster_bitmap)); };
+        if (skip_unallocated && !bisStorageGetClusterBitmap(bis_partition_id, &(this->cluster_bitmap)))
+        {
+            LOG_MSG_WARNING("Failed to generate cluster bitmap for BIS partition %u! Unallocated clusters will be dumped.", bis_partition_id);
+        }
+
+        /* Push progress onto the class. */
+        this->progress.total_size = partition_size;
+        this->progress.xfer_size = 0;
+        this->PublishProgress(this->progress);
+
+        /* Open output file. */
+        try {
+            this->file = new nxdt::utils::FileWriter(output_path, partition_size);
+        } catch(const std::string& msg) {
+            LOG_MSG_ERROR("%s", msg.c_str());
+            return msg;
+        }
+
+        ON_SCOPE_EXIT {
+            delete this->file;
+            this->file = nullptr;
+        };
+
+        /* Reset dump buffer ring. */
+        this->ring_committed_cnt = this->ring_written_cnt = this->ring_hashed_cnt = 0;
+        this->read_finished = this->write_failed = false;
+        this->failed_write_size = this->failed_write_offset = 0;
+
+        /* Write and hash threads consume each block in parallel, so they're both reported as stages that follow the read stage. */
+        /* The write stage becomes CPU-bound if it has to compress data. */
+        u32 cpu_bound_stage_mask = DataTransferPipelineStats::DefaultCpuBoundStageMask;
+        if (usb_host && configGetBoolean("usb_compression")) cpu_bound_stage_mask |= BIT(DataTransferStage_Write);
+
+        this->UpdatePipelineStats();
+        this->GetPipelineStats()->Enable(DumpBufferCount, BIT(DataTransferStage_Read) | BIT(DataTransferStage_Write) | (calculate_checksum ? BIT(DataTransferStage_Hash) : 0), \
+                                         cpu_bound_stage_mask);
+
+        ON_SCOPE_EXIT {
+            for(DumpBuffer& dump_buf : this->ring)
+            {
+                if (dump_buf.data) bufferPoolReturn(dump_buf.data);
+                dump_buf = {};
+            }
+        };
+
+        /* Lease memory buffers for the dump process from the shared buffer pool. */
+        for(DumpBuffer& dump_buf : this->ring)
+        {
+            dump_buf.data = bufferPoolLease(USB_TRANSFER_BUFFER_SIZE, false);
+            if (!dump_buf.data) return "generic/mem_alloc_failed"_i18n;
+        }
+
+        if (calculate_checksum) sha256ContextCreate(&(this->image_sha256_ctx));
+
+        /* Make sure all consumer threads are always joined before returning. */
+        ON_SCOPE_EXIT {
+            if (write_thread.handle == INVALID_HANDLE && hash_thread.handle == INVALID_HANDLE) return;
+            this->FinishDumpBufferRing();
+            if (write_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&write_thread);
+            if (hash_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&hash_thread);
+        };
+
+        /* Create consumer threads. The hash thread is only needed if checksum calculation was requested. */
+        if (!threadPlacementCreateThread(&write_thread, BisPartitionDumpTask::WriteThreadFunc, this, usb_host ? ThreadPlacementStage_Usb : ThreadPlacementStage_Write) || \
+            (calculate_checksum && !threadPlacementCreateThread(&hash_thread, BisPartitionDumpTask::HashThreadFunc, this, ThreadPlacementStage_Hash))) return "tasks/bis/partition/thread_create_failed"_i18n;
+
+        /* Move the task thread off the UI core while reading. */
+        ThreadPlacementScope read_scope{};
+        threadPlacementEnterStage(ThreadPlacementStage_Read, &read_scope);
+        ON_SCOPE_EXIT { threadPlacementExitStage(&read_scope); };
+
+        /* Dump partition image. */
+        for(size_t offset = 0, blksize = USB_TRANSFER_BUFFER_SIZE; offset < partition_size; offset += blksize)
+        {
+            /* Don't proceed if the task has been cancelled. */
+            if (this->IsCancelled()) return {};
+
+            /* Adjust current block size, if needed. */
+            if (blksize > (partition_size - offset)) blksize = (partition_size - offset);
+
+            /* Wait until an empty buffer is available. */
+            DumpBuffer *dump_buf = this->GetEmptyDumpBuffer();
+            if (!dump_buf) break;
+
+            /* Read current block. */
+            size_t data_size = 0;
+            if (!this->ReadPartitionBlock(bis_partition_id, static_cast<u8*>(dump_buf->data), offset, blksize, data_size))
+            {
+                return i18n::getStr("tasks/bis/partition/io_failed", "generic/read"_i18n, blksize, offset);
+            }
+
+            /* Hand the current block over to the consumer threads. */
+            dump_buf->size = blksize;
+            dump_buf->offset = offset;
+            dump_buf->data_size = data_size;
+            this->CommitDumpBuffer();
+        }
+
+        /* Wait for the consumer threads to process all pending blocks. */
+        this->FinishDumpBufferRing();
+        threadPlacementJoinThread(&write_thread);
+        if (calculate_checksum) threadPlacementJoinThread(&hash_thread);
+        threadPlacementExitStage(&read_scope);
+        threadPlacementLogStats();
+
+        /* Check if the write thread failed. */
+        if (this->write_failed) return i18n::getStr("tasks/bis/partition/io_failed", "generic/write"_i18n, this->failed_write_size, this->failed_write_offset);
+
+        /* Get partition image checksum. */
+        if (calculate_checksum) sha256ContextGetHash(&(this->image_sha256_ctx), this->image_hash);
+
+        return {};
+    }
+
+    void BisPartitionDumpTask::WriteThreadFunc(void *arg)
+    {
+        BisPartitionDumpTask *task = static_cast<BisPartitionDumpTask*>(arg);
+        DumpBuffer *dump_buf = nullptr;
+        size_t last_size = 0, last_offset = 0;
+
+        while((dump_buf = task->GetFilledDumpBuffer(task->ring_written_cnt)))
+        {
+            /* Write current block. The ring mutex isn't held here, which lets the read thread fill the next buffer in the meantime. */
+            if (!task->file->Write(dump_buf->data, dump_buf->size))
+            {
+                {
+                    /* Keep track of the failed block. */
+                    std::scoped_lock ring_lock(task->ring_mtx);
+                    task->write_failed = true;
+                    task->failed_write_size = dump_buf->size;
+                    task->failed_write_offset = dump_buf->offset;
+                }
+
+                /* Wake up the read and hash threads. */
+                task->ring_read_cv.notify_all();
+                task->ring_consume_cv.notify_all();
+                break;
+            }
+
+            last_size = dump_buf->size;
+            last_offset = dump_buf->offset;
+
+            /* Push progress onto the class. */
+            task->AddTransferredSize(dump_buf->size);
+
+            /* Release the current buffer. */
+            task->ReleaseDumpBuffer(task->ring_written_cnt);
+        }
+
+        /* Make sure all queued writes made it to the output file. Write errors are reported one call late, so the last block may still fail at this point. */
+        if (!task->write_failed && !task->file->Flush())
+        {
+            std::scoped_lock ring_lock(task->ring_mtx);
+            task->write_failed = true;
+            task->failed_write_size = last_size;
+            task->failed_write_offset = last_offset;
+        }
+
+        threadExit();
+    }
+
+    void BisPartitionDumpTask::HashThreadFunc(void *arg)
+    {
+        BisPartitionDumpTask *task = static_cast<BisPartitionDumpTask*>(arg);
+        DumpBuffer *dump_buf = nullptr;
+
+        while((dump_buf = task->GetFilledDumpBuffer(task->ring_hashed_cnt)))
+        {
+            /* Update image checksum. Zeroed out cluster runs must be hashed as well, since they're part of the output file. */
+            sha256ContextUpdate(&(task->image_sha256_ctx), dump_buf->data, dump_buf->size);
+
+            /* Release the current buffer. */
+            task->ReleaseDumpBuffer(task->ring_hashed_cnt);
+        }
+
+        threadExit();
+    }
+
+    bool BisPartitionDumpTask::ReadPartitionBlock(u8 bis_partition_id, u8 *buf, size_t offset, size_t size, size_t& data_size)
+    {
+        const BisStorageClusterBitmap *bitmap = &(this->cluster_bitmap);
+        size_t end_offset = (offset + size);
+
+        data_size = 0;
+
+        /* Read the whole block if there's no cluster bitmap available. */
+        if (!bitmap->bitmap)
+        {
+            if (!bisStorageReadPartition(bis_partition_id, buf, offset, size)) return false;
+            data_size = size;
+            return true;
+        }
+
+        /* Returns the end offset for the cluster run starting at the provided offset. Everything outside of the data area is considered to be allocated. */
+        auto get_run_end = [bitmap, end_offset](size_t cur_offset, bool& allocated) -> size_t {
+            if (cur_offset < bitmap->data_offset)
+            {
+                allocated = true;
+                return std::min(end_offset, static_cast<size_t>(bitmap->data_offset));
+            }
+
+            u32 cluster_idx = static_cast<u32>((cur_offset - bitmap->data_offset) / bitmap->cluster_size);
+            if (cluster_idx >= bitmap->cluster_count)
+            {
+                allocated = true;
+                return end_offset;
+            }
+
+            allocated = bisStorageIsClusterAllocated(bitmap, cluster_idx);
+
+            u32 next_idx = (cluster_idx + 1);
+            while(next_idx < bitmap->cluster_count && (bitmap->data_offset + (static_cast<size_t>(next_idx) * bitmap->cluster_size)) < end_offset && \
+                  bisStorageIsClusterAllocated(bitmap, next_idx) == allocated) next_idx++;
+
+            return std::min(end_offset, static_cast<size_t>(bitmap->data_offset + (static_cast<size_t>(next_idx) * bitmap->cluster_size)));
+        };
+
+        /* Read allocated cluster runs. Small unallocated gaps between them are read as well, which cuts down the number of FS calls. */
+        size_t read_start = 0, read_end = 0;
+        bool read_pending = false, allocated = false;
+
+        for(size_t cur_offset = offset; cur_offset < end_offset;)
+        {
+            size_t run_end = get_run_end(cur_offset, allocated);
+
+            if (allocated)
+            {
+                if (read_pending && (cur_offset - read_end) < BisPartitionMinSkippedRunSize)
+                {
+                    read_end = run_end;
+                } else {
+                    if (read_pending && !bisStorageReadPartition(bis_partition_id, buf + (read_start - offset), read_start, read_end - read_start)) return false;
+                    if (read_pending) data_size += (read_end - read_start);
+
+                    read_start = cur_offset;
+                    read_end = run_end;
+                    read_pending = true;
+                }
+            }
+
+            cur_offset = run_end;
+        }
+
+        if (read_pending)
+        {
+            if (!bisStorageReadPartition(bis_partition_id, buf + (read_start - offset), read_start, read_end - read_start)) return false;
+            data_size += (read_end - read_start);
+        }
+
+        /* Zero out unallocated cluster runs, including the ones that were read alongside allocated clusters. This keeps the output deterministic. */
+        for(size_t cur_offset = offset; cur_offset < end_offset;)
+        {
+            size_t run_end = get_run_end(cur_offset, allocated);
+            if (!allocated) memset(buf + (cur_offset - offset), 0, run_end - cur_offset);
+            cur_offset = run_end;
+        }
+
+        return true;
+    }
+
+    BisPartitionDumpTask::DumpBuffer *BisPartitionDumpTask::GetEmptyDumpBuffer(void)
+    {
+        std::unique_lock<std::mutex> ring_lock(this->ring_mtx);
+
+        /* A ring slot is only empty once it has been processed by all consumer threads. */
+        this->ring_read_cv.wait(ring_lock, [this]() {
+            size_t consumed_cnt = (this->calculate_checksum ? std::min(this->ring_written_cnt, this->ring_hashed_cnt) : this->ring_written_cnt);
+            return ((this->ring_committed_cnt - consumed_cnt) < DumpBufferCount || this->write_failed);
+        });
+
+        return (this->write_failed ? nullptr : &(this->ring[this->ring_committed_cnt % DumpBufferCount]));
+    }
+
+    void BisPartitionDumpTask::CommitDumpBuffer(void)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+            this->GetPipelineStats()->AddStageSize(DataTransferStage_Read, this->ring[this->ring_committed_cnt % DumpBufferCount].size);
+            this->ring_committed_cnt++;
+            this->UpdatePipelineStats();
+        }
+
+        this->ring_consume_cv.notify_all();
+    }
+
+    void BisPartitionDumpTask::FinishDumpBufferRing(void)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+            this->read_finished = true;
+        }
+
+        this->ring_consume_cv.notify_all();
+    }
+
+    BisPartitionDumpTask::DumpBuffer *BisPartitionDumpTask::GetFilledDumpBuffer(size_t& consumed_cnt)
+    {
+        std::unique_lock<std::mutex> ring_lock(this->ring_mtx);
+
+        /* Wait until a filled buffer is available, or until the read thread is done. */
+        this->ring_consume_cv.wait(ring_lock, [this, &consumed_cnt]() { return (consumed_cnt < this->ring_committed_cnt || this->read_finished || this->write_failed); });
+
+        /* Bail out if there's nothing left to consume. Pending blocks are discarded if the task was cancelled or if the write thread failed. */
+        if (consumed_cnt >= this->ring_committed_cnt || this->write_failed || this->IsCancelled()) return nullptr;
+
+        return &(this->ring[consumed_cnt % DumpBufferCount]);
+    }
+
+    void BisPartitionDumpTask::ReleaseDumpBuffer(size_t& consumed_cnt)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+
+            DataTransferStage stage = (&consumed_cnt == &(this->ring_hashed_cnt) ? DataTransferStage_Hash : DataTransferStage_Write);
+            this->GetPipelineStats()->AddStageSize(stage, this->ring[consumed_cnt % DumpBufferCount].size);
+
+            consumed_cnt++;
+            this->UpdatePipelineStats();
+        }
+
+        this->ring_read_cv.notify_one();
+    }
+
+    void BisPartitionDumpTask::UpdatePipelineStats(void)
+    {
+        DataTransferPipelineStats *stats = this->GetPipelineStats();
+
+        /* A ring slot is only empty once it has been processed by all consumer threads. */
+        size_t consumed_cnt = (this->calculate_checksum ? std::min(this->ring_written_cnt, this->ring_hashed_cnt) : this->ring_written_cnt);
+        stats->SetStageQueued(DataTransferStage_Read, DumpBufferCount - (this->ring_committed_cnt - consumed_cnt));
+        stats->SetStageQueued(DataTransferStage_Write, this->ring_committed_cnt - this->ring_written_cnt);
+        stats->SetStageQueued(DataTransferStage_Hash, this->calculate_checksum ? (this->ring_committed_cnt - this->ring_hashed_cnt) : 0);
+    }
+}
@@ -0,0 +1,526 @@
+/*
+ * content_verify_task.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <tasks/content_verify_task.hpp>
+#include <utils/scope_guard.hpp>
+
+namespace i18n = brls::i18n;    /* For getStr(). */
+using namespace i18n::literals; /* For _i18n. */
+
+namespace nxdt::tasks
+{
+    ContentVerifyTaskError ContentVerifyTask::DoInBackground(const std::vector<ContentVerifyTarget>& targets)
+    {
+        std::scoped_lock lock(this->task_mtx);
+
+        Thread hash_thread{}, fs_thread{};
+
+        if (targets.empty()) return "tasks/verify/empty"_i18n;
+
+        /* Reset private variables. */
+        {
+            std::scoped_lock result_lock(this->result_mtx);
+            this->results.clear();
+            this->failed_count = 0;
+        }
+
+        this->progress = {};
+
+        /* Calculate the total size from all titles. */
+        for(const ContentVerifyTarget& target : targets)
+        {
+            TitleInfo *title_info = titleGetTitleInfoEntryFromStorageByTitleId(target.storage_id, target.title_id);
+            if (!title_info) continue;
+
+            this->progress.total_size += title_info->size;
+            titleFreeTitleInfo(&title_info);
+        }
+
+        /* Push progress onto the class. */
+        this->PublishProgress(this->progress);
+
+        LOG_MSG_DEBUG("Starting verification of %lu title(s). Total size: 0x%lX.", targets.size(), this->progress.total_size);
+
+        /* Reset verify buffer ring. */
+        this->ring_stage_cnt.fill(0);
+        this->read_finished = false;
+
+        ON_SCOPE_EXIT {
+            for(VerifyBuffer& verify_buf : this->ring)
+            {
+                if (verify_buf.data) bufferPoolReturn(verify_buf.data);
+                verify_buf = {};
+            }
+        };
+
+        /* Lease memory buffers for the verification process from the shared buffer pool. The ring depth is scaled down under low memory conditions. */
+        /* If we still run out of memory (or hit the in-flight size cap from the pool), just stick to the buffers we already have, as long as there's enough of them to keep the pipeline going. */
+        this->ring_depth = utilsGetBudgetedBufferCount(VerifyBufferCount, VerifyBufferMinCount);
+
+        for(size_t i = 0; i < this->ring_depth; i++)
+        {
+            VerifyBuffer& verify_buf = this->ring[i];
+
+            verify_buf.data = bufferPoolLease(USB_TRANSFER_BUFFER_SIZE, false);
+            if (verify_buf.data) continue;
+
+            if (i < VerifyBufferMinCount) return "generic/mem_alloc_failed"_i18n;
+
+            LOG_MSG_WARNING("Failed to allocate verify buffer #%lu! Using %lu buffer(s).", i, i);
+            this->ring_depth = i;
+        }
+
+        this->UpdatePipelineStats();
+        this->GetPipelineStats()->Enable(this->ring_depth, BIT(DataTransferStage_Read) | BIT(DataTransferStage_Decrypt) | BIT(DataTransferStage_Hash));
+
+        /* Make sure all pipeline threads are always joined before freeing title data. */
+        ON_SCOPE_EXIT {
+            if (hash_thread.handle != INVALID_HANDLE || fs_thread.handle != INVALID_HANDLE)
+            {
+                this->FinishVerifyBufferRing();
+                if (hash_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&hash_thread);
+                if (fs_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&fs_thread);
+                threadPlacementLogStats();
+            }
+
+            this->FreeTitleData();
+        };
+
+        /* Create pipeline threads. The FS stage decrypts data before verifying it, so it's placed as a decrypt stage. */
+        if (!threadPlacementCreateThread(&hash_thread, ContentVerifyTask::HashThreadFunc, this, ThreadPlacementStage_Hash) || \
+            !threadPlacementCreateThread(&fs_thread, ContentVerifyTask::FsThreadFunc, this, ThreadPlacementStage_Decrypt))
+        {
+            return "tasks/verify/thread_create_failed"_i18n;
+        }
+
+        /* Move the task thread off the UI core while reading. */
+        ThreadPlacementScope read_scope{};
+        threadPlacementEnterStage(ThreadPlacementStage_Read, &read_scope);
+        ON_SCOPE_EXIT { threadPlacementExitStage(&read_scope); };
+
+        for(const ContentVerifyTarget& target : targets)
+        {
+            /* Don't proceed if the task has been cancelled. Title data is freed once the pipeline threads have been joined. */
+            if (!this->VerifyTitle(target)) return {};
+
+            /* Title data can only be freed once all pending blocks have been processed. */
+            this->WaitForVerifyBuffers();
+            if (this->IsCancelled()) return {};
+
+            this->FreeTitleData();
+        }
+
+        size_t content_count = 0, failed_count = 0;
+
+        {
+            std::scoped_lock result_lock(this->result_mtx);
+            content_count = this->results.size();
+            failed_count = this->failed_count;
+        }
+
+        LOG_MSG_DEBUG("Verification finished. %lu out of %lu content(s) failed.", failed_count, content_count);
+
+        if (failed_count) return i18n::getStr("tasks/verify/contents_failed", failed_count, content_count);
+
+        return {};
+    }
+
+    bool ContentVerifyTask::VerifyTitle(const ContentVerifyTarget& target)
+    {
+        /* Retrieve title info. */
+        this->title_info = titleGetTitleInfoEntryFromStorageByTitleId(target.storage_id, target.title_id);
+        if (!this->title_info || !this->title_info->content_count || !this->title_info->content_infos)
+        {
+            LOG_MSG_ERROR("Failed to retrieve title info for %016lX! (storage ID %u).", target.title_id, target.storage_id);
+            this->AddResult({ target.storage_id, target.title_id, {}, 0, 0, 0, ContentVerifyStatus_Failed, ContentVerifyStatus_Failed, "tasks/nsp/get_title_info_failed"_i18n });
+            return true;
+        }
+
+        TitleInfo *title_info = this->title_info;
+        u32 content_count = title_info->content_count;
+        u8 hfs_partition_type = (title_info->storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : 0);
+
+        this->nca_ctx.resize(content_count);
+        this->nca_result_idx.resize(content_count);
+        this->nca_fs_verify.resize(content_count);
+        this->tik = {};
+
+        /* Initialize NCA contexts. */
+        for(u32 i = 0; i < content_count; i++)
+        {
+            NcmContentInfo *content_info = &(title_info->content_infos[i]);
+            NcaContext *cur_nca_ctx = &(this->nca_ctx[i]);
+
+            ContentVerifyResult result = { title_info->storage_id, title_info->meta_key.id, content_info->content_id, content_info->content_type, content_info->id_offset, 0, \
+                                           ContentVerifyStatus_Skipped, ContentVerifyStatus_Skipped, std::string() };
+            ncmContentInfoSizeToU64(content_info, &(result.content_size));
+
+            this->nca_result_idx[i] = this->AddResult(result);
+            this->nca_fs_verify[i].fill(false);
+
+            if (!ncaInitializeContext(cur_nca_ctx, title_info->storage_id, hfs_partition_type, &(title_info->meta_key), content_info, &(this->tik)))
+            {
+                std::string error = i18n::getStr("tasks/nsp/nca_init_failed", titleGetNcmContentTypeName(content_info->content_type), content_info->id_offset);
+                this->SetResultStatus(this->nca_result_idx[i], false, ContentVerifyStatus_Failed, error);
+                this->SetResultStatus(this->nca_result_idx[i], true, ContentVerifyStatus_Failed);
+
+                /* Don't read this NCA. */
+                this->UpdateProgress(result.content_size);
+                *cur_nca_ctx = {};
+                continue;
+            }
+
+            /* Initialize the CNMT context using the Meta NCA. Content IDs are used to validate NCA hashes if this fails. */
+            if (content_info->content_type == NcmContentType_Meta && !cnmtInitializeContext(&(this->cnmt_ctx), cur_nca_ctx))
+            {
+                LOG_MSG_WARNING("Failed to initialize CNMT context for %016lX! Content IDs will be used to validate NCA hashes.", title_info->meta_key.id);
+            }
+        }
+
+        /* Read NCAs. The remaining pipeline stages take care of hashing and verifying the data we read. */
+        for(u32 i = 0; i < content_count; i++)
+        {
+            NcaContext *cur_nca_ctx = &(this->nca_ctx[i]);
+            size_t result_idx = this->nca_result_idx[i];
+            if (!cur_nca_ctx->content_size) continue;
+
+            /* Verify the hash layers from all supported FS sections before reading any data. */
+            if (!this->EnableFsSectionVerification(i))
+            {
+                this->SetResultStatus(result_idx, true, ContentVerifyStatus_Failed, i18n::getStr("tasks/verify/fs_verify_failed", cur_nca_ctx->content_id_str));
+            }
+
+            for(size_t offset = 0, blksize = USB_TRANSFER_BUFFER_SIZE; offset < cur_nca_ctx->content_size; offset += blksize)
+            {
+                /* Don't proceed if the task has been cancelled. */
+                if (this->IsCancelled()) return false;
+
+                /* Adjust current block size, if needed. */
+                if (blksize > (cur_nca_ctx->content_size - offset)) blksize = (cur_nca_ctx->content_size - offset);
+
+                /* Wait until an empty buffer is available. */
+                VerifyBuffer *verify_buf = this->GetVerifyBuffer(VerifyStage::Read);
+                if (!verify_buf) return false;
+
+                /* Read current block. */
+                if (!ncaReadContentFile(cur_nca_ctx, verify_buf->data, blksize, offset))
+                {
+                    std::string error = i18n::getStr("tasks/nsp/io_failed", "generic/read"_i18n, blksize, offset, cur_nca_ctx->content_id_str);
+                    LOG_MSG_ERROR("%s", error.c_str());
+
+                    /* The last block from this NCA will never reach the other stages, so its checks will remain failed. */
+                    this->SetResultStatus(result_idx, false, ContentVerifyStatus_Failed, error);
+                    this->SetResultStatus(result_idx, true, ContentVerifyStatus_Failed);
+                    this->UpdateProgress(cur_nca_ctx->content_size - offset);
+                    break;
+                }
+
+                /* Hand the current block over to the hash stage. */
+                verify_buf->size = blksize;
+                verify_buf->offset = offset;
+                verify_buf->nca_idx = i;
+                this->ReleaseVerifyBuffer(VerifyStage::Read);
+            }
+        }
+
+        return true;
+    }
+
+    void ContentVerifyTask::FreeTitleData(void)
+    {
+        for(size_t i = 0; i < this->nca_fs_verify.size(); i++)
+        {
+            for(u8 j = 0; j < NCA_FS_HEADER_COUNT; j++)
+            {
+                if (this->nca_fs_verify[i][j]) ncaSetFsSectionReadVerification(&(this->nca_ctx[i].fs_ctx[j]), false);
+            }
+        }
+
+        this->nca_fs_verify.clear();
+        this->nca_result_idx.clear();
+        this->nca_ctx.clear();
+
+        cnmtFreeContext(&(this->cnmt_ctx));
+
+        if (this->title_info) titleFreeTitleInfo(&(this->title_info));
+    }
+
+    bool ContentVerifyTask::EnableFsSectionVerification(u32 nca_idx)
+    {
+        NcaContext *cur_nca_ctx = &(this->nca_ctx[nca_idx]);
+        std::array<bool, NCA_FS_HEADER_COUNT>& fs_verify = this->nca_fs_verify[nca_idx];
+
+        /* FS section data can't be decrypted without a titlekey. */
+        if (cur_nca_ctx->rights_id_available && !cur_nca_ctx->titlekey_retrieved)
+        {
+            LOG_MSG_WARNING("Unable to retrieve titlekey for NCA \"%s\"! Hash trees won't be verified.", cur_nca_ctx->content_id_str);
+            return true;
+        }
+
+        for(u8 i = 0; i < NCA_FS_HEADER_COUNT; i++)
+        {
+            NcaFsSectionContext *cur_fs_ctx = &(cur_nca_ctx->fs_ctx[i]);
+
+            /* Skip FS sections that can't be verified on their own (e.g. patch sections, which depend on data from base titles). */
+            if (!cur_fs_ctx->enabled || cur_fs_ctx->has_sparse_layer || cur_fs_ctx->has_compression_layer || cur_fs_ctx->has_patch_indirect_layer || \
+                cur_fs_ctx->has_patch_aes_ctr_ex_layer || (cur_fs_ctx->hash_type != NcaHashType_HierarchicalSha256 && cur_fs_ctx->hash_type != NcaHashType_HierarchicalSha3256 && \
+                cur_fs_ctx->hash_type != NcaHashType_HierarchicalIntegrity && cur_fs_ctx->hash_type != NcaHashType_HierarchicalIntegritySha3)) continue;
+
+            if (!ncaSetFsSectionReadVerification(cur_fs_ctx, true)) return false;
+
+            fs_verify[i] = true;
+        }
+
+        return true;
+    }
+
+    void ContentVerifyTask::HashThreadFunc(void *arg)
+    {
+        ContentVerifyTask *task = static_cast<ContentVerifyTask*>(arg);
+        VerifyBuffer *verify_buf = nullptr;
+
+        Sha256Context sha256_ctx{};
+        u8 sha256_hash[SHA256_HASH_SIZE] = {0};
+
+        while((verify_buf = task->GetVerifyBuffer(VerifyStage::Hash)))
+        {
+            NcaContext *cur_nca_ctx = &(task->nca_ctx[verify_buf->nca_idx]);
+
+            /* Update hash calculation. */
+            if (!verify_buf->offset) sha256ContextCreate(&sha256_ctx);
+            sha256ContextUpdate(&sha256_ctx, verify_buf->data, verify_buf->size);
+            statsAddCounter(StatsCounterType_Sha256, verify_buf->size);
+
+            if ((verify_buf->offset + verify_buf->size) >= cur_nca_ctx->content_size)
+            {
+                sha256ContextGetHash(&sha256_ctx, sha256_hash);
+
+                /* The CNMT doesn't hold a record for the Meta NCA, so its content ID is used instead. */
+                bool use_content_id = (cur_nca_ctx->content_type == NcmContentType_Meta || !cnmtIsValidContext(&(task->cnmt_ctx)));
+                bool valid = (use_content_id ? !memcmp(sha256_hash, &(cur_nca_ctx->content_id), sizeof(NcmContentId)) : cnmtVerifyContentHash(&(task->cnmt_ctx), cur_nca_ctx, sha256_hash));
+
+                if (!valid) LOG_MSG_ERROR("SHA-256 checksum mismatch for NCA \"%s\"!", cur_nca_ctx->content_id_str);
+
+                task->SetResultStatus(task->nca_result_idx[verify_buf->nca_idx], false, valid ? ContentVerifyStatus_Passed : ContentVerifyStatus_Failed,
+                                      valid ? std::string() : i18n::getStr("tasks/verify/hash_mismatch", cur_nca_ctx->content_id_str));
+            }
+
+            /* Hand the current block over to the FS stage. Raw data must not be touched after this point. */
+            task->ReleaseVerifyBuffer(VerifyStage::Hash);
+        }
+
+        /* Wake up the read thread in case we bailed out early. */
+        task->ring_cv.notify_all();
+
+        threadExit();
+    }
+
+    void ContentVerifyTask::FsThreadFunc(void *arg)
+    {
+        ContentVerifyTask *task = static_cast<ContentVerifyTask*>(arg);
+        VerifyBuffer *verify_buf = nullptr;
+
+        /* Set to true if a hash tree check failed for the current NCA. Its remaining blocks are skipped. */
+        bool nca_failed = false;
+
+        while((verify_buf = task->GetVerifyBuffer(VerifyStage::Fs)))
+        {
+            u32 nca_idx = verify_buf->nca_idx;
+            NcaContext *cur_nca_ctx = &(task->nca_ctx[nca_idx]);
+            const std::array<bool, NCA_FS_HEADER_COUNT>& fs_verify = task->nca_fs_verify[nca_idx];
+            bool verified = false;
+
+            if (!verify_buf->offset) nca_failed = false;
+
+            /* Verify the data from every FS section overlapped by this block. */
+            for(u8 i = 0; i < NCA_FS_HEADER_COUNT && !nca_failed; i++)
+            {
+                if (!fs_verify[i]) continue;
+
+                NcaFsSectionContext *cur_fs_ctx = &(cur_nca_ctx->fs_ctx[i]);
+                size_t start_offset = MAX(verify_buf->offset, cur_fs_ctx->section_offset);
+                size_t end_offset = MIN(verify_buf->offset + verify_buf->size, cur_fs_ctx->section_offset + cur_fs_ctx->section_size);
+
+                verified = true;
+                if (start_offset >= end_offset) continue;
+
+                u8 *data = (static_cast<u8*>(verify_buf->data) + (start_offset - verify_buf->offset));
+
+                if (!ncaVerifyRawFsSectionData(cur_fs_ctx, data, end_offset - start_offset, start_offset - cur_fs_ctx->section_offset))
+                {
+                    task->SetResultStatus(task->nca_result_idx[nca_idx], true, ContentVerifyStatus_Failed, i18n::getStr("tasks/verify/fs_verify_failed", cur_nca_ctx->content_id_str));
+                    nca_failed = true;
+                }
+            }
+
+            /* Hash tree checks are only reported as passed once the whole NCA has been verified. */
+            if (verified && !nca_failed && (verify_buf->offset + verify_buf->size) >= cur_nca_ctx->content_size)
+            {
+                task->SetResultStatus(task->nca_result_idx[nca_idx], true, ContentVerifyStatus_Passed);
+            }
+
+            task->UpdateProgress(verify_buf->size);
+
+            /* Release the current buffer. */
+            task->ReleaseVerifyBuffer(VerifyStage::Fs);
+        }
+
+        /* Wake up the read thread in case we bailed out early. */
+        task->ring_cv.notify_all();
+
+        threadExit();
+    }
+
+    ContentVerifyTask::VerifyBuffer *ContentVerifyTask::GetVerifyBuffer(VerifyStage stage)
+    {
+        std::unique_lock<std::mutex> ring_lock(this->ring_mtx);
+        size_t& stage_cnt = this->ring_stage_cnt[stage];
+
+        if (stage == VerifyStage::Read)
+        {
+            /* A ring slot is only empty once it has been verified. */
+            this->ring_cv.wait(ring_lock, [this, &stage_cnt]() { return ((stage_cnt - this->ring_stage_cnt[VerifyStage::Fs]) < this->ring_depth || this->IsCancelled()); });
+            return (this->IsCancelled() ? nullptr : &(this->ring[stage_cnt % this->ring_depth]));
+        }
+
+        /* Wait until the previous stage is done with the next block, or until the read thread is done. */
+        size_t& prev_stage_cnt = this->ring_stage_cnt[stage - 1];
+        this->ring_cv.wait(ring_lock, [this, &stage_cnt, &prev_stage_cnt]() { return (stage_cnt < prev_stage_cnt || this->read_finished || this->IsCancelled()); });
+
+        /* Bail out if there's nothing left to process. Pending blocks are discarded if the task was cancelled. */
+        if (stage_cnt >= prev_stage_cnt || this->IsCancelled()) return nullptr;
+
+        return &(this->ring[stage_cnt % this->ring_depth]);
+    }
+
+    void ContentVerifyTask::ReleaseVerifyBuffer(VerifyStage stage)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+            this->GetPipelineStats()->AddStageSize(VerifyStageMap[stage], this->ring[this->ring_stage_cnt[stage] % this->ring_depth].size);
+            this->ring_stage_cnt[stage]++;
+            this->UpdatePipelineStats();
+        }
+
+        this->ring_cv.notify_all();
+    }
+
+    void ContentVerifyTask::UpdatePipelineStats(void)
+    {
+        DataTransferPipelineStats *stats = this->GetPipelineStats();
+
+        /* A ring slot is only empty once it has been verified by the FS stage. */
+        stats->SetStageQueued(VerifyStageMap[VerifyStage::Read], this->ring_depth - (this->ring_stage_cnt[VerifyStage::Read] - this->ring_stage_cnt[VerifyStage::Fs]));
+
+        for(u8 i = VerifyStage::Hash; i < VerifyStage::Count; i++) stats->SetStageQueued(VerifyStageMap[i], this->ring_stage_cnt[i - 1] - this->ring_stage_cnt[i]);
+    }
+
+    void ContentVerifyTask::FinishVerifyBufferRing(void)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+            this->read_finished = true;
+        }
+
+        this->ring_cv.notify_all();
+    }
+
+    void ContentVerifyTask::WaitForVerifyBuffers(void)
+    {
+        std::unique_lock<std::mutex> ring_lock(this->ring_mtx);
+        this->ring_cv.wait(ring_lock, [this]() { return (this->ring_stage_cnt[VerifyStage::Fs] >= this->ring_stage_cnt[VerifyStage::Read] || this->IsCancelled()); });
+    }
+
+    size_t ContentVerifyTask::AddResult(const ContentVerifyResult& result)
+    {
+        std::scoped_lock result_lock(this->result_mtx);
+
+        this->results.push_back(result);
+        if (result.hash_status == ContentVerifyStatus_Failed || result.fs_status == ContentVerifyStatus_Failed) this->failed_count++;
+
+        return (this->results.size() - 1);
+    }
+
+    void ContentVerifyTask::SetResultStatus(size_t result_idx, bool fs_check, ContentVerifyStatus status, const std::string& error)
+    {
+        std::scoped_lock result_lock(this->result_mtx);
+
+        ContentVerifyResult& result = this->results[result_idx];
+        u8& cur_status = (fs_check ? result.fs_status : result.hash_status);
+
+        /* Failed checks can't be overridden. */
+        if (cur_status == ContentVerifyStatus_Failed) return;
+
+        /* Only count each content once. */
+        if (status == ContentVerifyStatus_Failed && result.hash_status != ContentVerifyStatus_Failed && result.fs_status != ContentVerifyStatus_Failed) this->failed_count++;
+
+        cur_status = status;
+        if (!error.empty() && result.error.empty()) result.error = error;
+    }
+
+    void ContentVerifyTask::UpdateProgress(size_t size)
+    {
+        /* Push progress onto the class. */
+        this->AddTransferredSize(size);
+    }
+
+    std::vector<ContentVerifyTarget> ContentVerifyTask::GetApplicationTargets(u64 app_id, u8 storage_id)
+    {
+        std::vector<ContentVerifyTarget> targets{};
+        TitleUserApplicationData user_app_data{};
+
+        if (!titleGetUserApplicationData(app_id, &user_app_data)) return targets;
+
+        TitleInfo *title_infos[] = { user_app_data.app_info, user_app_data.patch_info, user_app_data.aoc_info, user_app_data.aoc_patch_info };
+
+        for(TitleInfo *cur_title_info : title_infos)
+        {
+            for(; cur_title_info; cur_title_info = cur_title_info->next)
+            {
+                if (storage_id != NcmStorageId_Any && cur_title_info->storage_id != storage_id) continue;
+                targets.push_back({ cur_title_info->storage_id, cur_title_info->meta_key.id });
+            }
+        }
+
+        titleFreeUserApplicationData(&user_app_data);
+
+        return targets;
+    }
+
+    std::vector<ContentVerifyTarget> ContentVerifyTask::GetGameCardTargets(void)
+    {
+        std::vector<ContentVerifyTarget> targets{};
+        u32 app_count = 0;
+
+        TitleGameCardApplicationMetadata *gc_app_metadata = titleGetGameCardApplicationMetadataEntries(&app_count);
+        if (!gc_app_metadata) return targets;
+
+        for(u32 i = 0; i < app_count; i++)
+        {
+            std::vector<ContentVerifyTarget> app_targets = ContentVerifyTask::GetApplicationTargets(gc_app_metadata[i].app_metadata->title_id, NcmStorageId_GameCard);
+            targets.insert(targets.end(), app_targets.begin(), app_targets.end());
+        }
+
+        free(gc_app_metadata);
+
+        return targets;
+    }
+}
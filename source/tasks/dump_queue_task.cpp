@@ -0,0 +1,429 @@
+/*
+ * dump_queue_task.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <tasks/dump_queue_task.hpp>
+#include <utils/scope_guard.hpp>
+
+namespace i18n = brls::i18n;    /* For getStr(). */
+using namespace i18n::literals; /* For _i18n. */
+
+namespace nxdt::tasks
+{
+    DumpQueueTaskError DumpQueueTask::DoInBackground(const std::vector<DumpQueueJob>& jobs)
+    {
+        std::scoped_lock lock(this->task_mtx);
+
+        std::vector<size_t> job_order{};
+        size_t failed_count = 0;
+
+        if (jobs.empty()) return "tasks/queue/empty"_i18n;
+
+        /* Validate jobs. */
+        for(size_t i = 0; i < jobs.size(); i++)
+        {
+            const DumpQueueJob& job = jobs[i];
+            if (job.type != DumpQueueJobType_Nsp || !*(job.output_path)) return i18n::getStr("tasks/queue/invalid_job", i);
+            if (job.status != DumpQueueJobStatus_Done) job_order.push_back(i);
+        }
+
+        /* Update private variables. */
+        {
+            std::scoped_lock job_lock(this->job_mtx);
+
+            this->jobs = jobs;
+            this->job_errors.assign(jobs.size(), std::string());
+
+            /* Estimate output sizes for all pending jobs using their title sizes. These are refined once each job is prepared. */
+            this->progress = {};
+
+            for(DumpQueueJob& job : this->jobs)
+            {
+                if (job.status == DumpQueueJobStatus_Done) continue;
+
+                job.status = DumpQueueJobStatus_Pending;
+                job.xfer_size = 0;
+
+                TitleInfo *title_info = titleGetTitleInfoEntryFromStorageByTitleId(job.storage_id, job.title_id);
+                if (title_info)
+                {
+                    job.total_size = title_info->size;
+                    titleFreeTitleInfo(&title_info);
+                }
+
+                this->progress.total_size += job.total_size;
+            }
+        }
+
+        /* Push progress onto the class. */
+        this->PublishProgress(this->progress);
+
+        LOG_MSG_DEBUG("Starting dump queue with %lu job(s) (%lu pending). Estimated size: 0x%lX.", jobs.size(), job_order.size(), this->progress.total_size);
+
+        /* Nothing else to do if all jobs are already done. */
+        if (job_order.empty()) return {};
+
+        /* Resources shared by all jobs. */
+        NspDumpSharedResources shared_res;
+        this->shared_res = &shared_res;
+
+        ON_SCOPE_EXIT { this->shared_res = nullptr; };
+
+        /* Two dumpers are used in turns: one of them is being prepared for the next job while the other one writes the current job. */
+        auto cancel_cb = [this]() { return this->IsCancelled(); };
+        auto progress_cb = [this](size_t size) { this->UpdateProgress(size); };
+
+        NspDumper dumper_a(cancel_cb, progress_cb, this->GetPipelineStats()), dumper_b(cancel_cb, progress_cb, this->GetPipelineStats());
+        NspDumper *dumpers[2] = { &dumper_a, &dumper_b };
+
+        /* Prepare the first job right away. */
+        NspDumpTaskError cur_error = this->PrepareJob(dumpers[0], job_order[0]);
+
+        for(size_t i = 0; i < job_order.size(); i++)
+        {
+            size_t job_idx = job_order[i];
+            NspDumper *cur_dumper = dumpers[i % 2];
+            std::future<NspDumpTaskError> prep_future{};
+
+            /* Start preparing the next job on a shared worker thread. */
+            if ((i + 1) < job_order.size())
+            {
+                NspDumper *prep_dumper = dumpers[(i + 1) % 2];
+                size_t prep_job_idx = job_order[i + 1];
+
+                /* Our cancellation token is bound to the worker thread as well, so a cancelled queue doesn't have to wait for the next job to be fully prepared. */
+                prep_future = ThreadPool::GetInstance().Submit([this, prep_dumper, prep_job_idx]() {
+                    CANCEL_TOKEN_SCOPE(this->GetCancelToken());
+                    return this->PrepareJob(prep_dumper, prep_job_idx);
+                }, 1);
+
+                /* Fall back to preparing the next job right after the current one is done. */
+                if (!prep_future.valid()) LOG_MSG_WARNING("%s", "tasks/queue/thread_create_failed"_i18n.c_str());
+            }
+
+            /* Dump current job. */
+            if (!cur_error)
+            {
+                {
+                    std::scoped_lock job_lock(this->job_mtx);
+
+                    /* Replace the estimated job size with the actual NSP size. */
+                    DumpQueueJob& job = this->jobs[job_idx];
+                    this->progress.total_size = (this->progress.total_size - job.total_size + cur_dumper->GetNspSize());
+                    this->PublishTotalSize(this->progress.total_size);
+                    job.total_size = cur_dumper->GetNspSize();
+                    this->cur_job_idx = job_idx;
+                }
+
+                this->SetJobStatus(job_idx, DumpQueueJobStatus_Running);
+
+                cur_error = cur_dumper->Dump(this->jobs[job_idx].output_path);
+            }
+
+            /* Update job status. */
+            if (this->IsCancelled())
+            {
+                this->SetJobStatus(job_idx, DumpQueueJobStatus_Cancelled);
+            } else
+            if (cur_error)
+            {
+                LOG_MSG_ERROR("Dump queue job #%lu (%016lX) failed: %s", job_idx, this->jobs[job_idx].title_id, cur_error.value().c_str());
+                this->SetJobStatus(job_idx, DumpQueueJobStatus_Failed, cur_error);
+                failed_count++;
+            } else {
+                this->SetJobStatus(job_idx, DumpQueueJobStatus_Done);
+            }
+
+            /* Wait for the next job to be prepared. */
+            if (prep_future.valid())
+            {
+                cur_error = prep_future.get();
+            } else
+            if ((i + 1) < job_order.size() && !this->IsCancelled())
+            {
+                cur_error = this->PrepareJob(dumpers[(i + 1) % 2], job_order[i + 1]);
+            }
+
+            /* Don't proceed if the task has been cancelled. Jobs that didn't finish remain pending in the dump queue file. */
+            if (this->IsCancelled()) return {};
+        }
+
+        LOG_MSG_DEBUG("Dump queue finished. %lu out of %lu job(s) failed.", failed_count, job_order.size());
+
+        if (failed_count) return i18n::getStr("tasks/queue/jobs_failed", failed_count, job_order.size());
+
+        return {};
+    }
+
+    NspDumpTaskError DumpQueueTask::PrepareJob(NspDumper *dumper, size_t job_idx)
+    {
+        DumpQueueJob job{};
+
+        {
+            std::scoped_lock job_lock(this->job_mtx);
+            job = this->jobs[job_idx];
+        }
+
+        return dumper->Prepare(job.storage_id, job.title_id, job.nsp_options, this->shared_res);
+    }
+
+    void DumpQueueTask::SetJobStatus(size_t job_idx, DumpQueueJobStatus status, const NspDumpTaskError& error)
+    {
+        std::vector<DumpQueueJob> snapshot{};
+
+        {
+            std::scoped_lock job_lock(this->job_mtx);
+
+            DumpQueueJob& job = this->jobs[job_idx];
+            job.status = status;
+
+            /* Don't count unwritten data from jobs that didn't finish. Keeps the overall percentage meaningful. */
+            if (status == DumpQueueJobStatus_Failed || status == DumpQueueJobStatus_Cancelled)
+            {
+                this->progress.total_size -= (job.total_size - job.xfer_size);
+                this->PublishTotalSize(this->progress.total_size);
+                job.total_size = job.xfer_size;
+            }
+
+            if (error) this->job_errors[job_idx] = error.value();
+
+            snapshot = this->jobs;
+        }
+
+        DumpQueueTask::SaveQueue(snapshot);
+    }
+
+    void DumpQueueTask::UpdateProgress(size_t size)
+    {
+        {
+            std::scoped_lock job_lock(this->job_mtx);
+            this->jobs[this->cur_job_idx].xfer_size += size;
+        }
+
+        /* Push progress onto the class. */
+        this->AddTransferredSize(size);
+    }
+
+    DumpQueueSummary DumpQueueTask::GetSummary(void)
+    {
+        std::scoped_lock job_lock(this->job_mtx);
+        DumpQueueSummary summary{};
+
+        summary.job_count = this->jobs.size();
+
+        for(const DumpQueueJob& job : this->jobs)
+        {
+            switch(job.status)
+            {
+                case DumpQueueJobStatus_Pending:
+                case DumpQueueJobStatus_Running:
+                    summary.pending_count++;
+                    break;
+                case DumpQueueJobStatus_Done:
+                    summary.done_count++;
+                    break;
+                case DumpQueueJobStatus_Failed:
+                    summary.failed_count++;
+                    break;
+                case DumpQueueJobStatus_Cancelled:
+                    summary.cancelled_count++;
+                    break;
+                default:
+                    break;
+            }
+
+            summary.total_size += job.total_size;
+            summary.xfer_size += job.xfer_size;
+        }
+
+        return summary;
+    }
+
+    bool DumpQueueTask::GenerateGameCardJobs(const NspDumpOptions& options, const std::string& output_dir, std::vector<DumpQueueJob>& out_jobs)
+    {
+        TitleGameCardApplicationMetadata *gc_app_metadata = nullptr;
+        u32 gc_app_metadata_count = 0;
+        u8 naming_convention = static_cast<u8>(configGetInteger("naming_convention"));
+
+        std::vector<std::pair<u64, DumpQueueJob>> planned_jobs{};
+
+        out_jobs.clear();
+
+        /* Retrieve gamecard application metadata. */
+        gc_app_metadata = titleGetGameCardApplicationMetadataEntries(&gc_app_metadata_count);
+        if (!gc_app_metadata) return false;
+
+        ON_SCOPE_EXIT { free(gc_app_metadata); };
+
+        auto plan_title = [&](TitleInfo *title_info) -> bool {
+            /* Skip titles that aren't stored in the inserted gamecard, as well as titles we already planned (e.g. add-on contents listed for more than one application). */
+            if (title_info->storage_id != NcmStorageId_GameCard) return true;
+
+            for(const auto& planned_job : planned_jobs)
+            {
+                if (planned_job.second.title_id == title_info->meta_key.id) return true;
+            }
+
+            /* Each job is placed according to the lowest physical offset from its NCAs. */
+            u64 sweep_offset = UINT64_MAX;
+
+            for(u32 i = 0; i < title_info->content_count; i++)
+            {
+                u64 offset = NspDumper::GetGameCardContentOffset(&(title_info->content_infos[i]));
+                if (offset) sweep_offset = std::min(sweep_offset, offset);
+            }
+
+            /* Generate output path. */
+            char *filename = titleGenerateFileName(title_info, naming_convention, TitleFileNameIllegalCharReplaceType_IllegalFsChars);
+            if (!filename) return false;
+
+            char *output_path = utilsGeneratePath(output_dir.c_str(), filename, ".nsp");
+            free(filename);
+
+            if (!output_path) return false;
+
+            DumpQueueJob job{};
+            job.type = DumpQueueJobType_Nsp;
+            job.storage_id = NcmStorageId_GameCard;
+            job.status = DumpQueueJobStatus_Pending;
+            job.title_id = title_info->meta_key.id;
+            job.nsp_options = options;
+            job.total_size = title_info->size;
+            snprintf(job.output_path, sizeof(job.output_path), "%s", output_path);
+            free(output_path);
+
+            planned_jobs.push_back({ sweep_offset, job });
+
+            return true;
+        };
+
+        for(u32 i = 0; i < gc_app_metadata_count; i++)
+        {
+            TitleUserApplicationData user_app_data{};
+            bool success = true;
+
+            if (!titleGetUserApplicationData(gc_app_metadata[i].app_metadata->title_id, &user_app_data)) continue;
+
+            for(TitleInfo *title_list : { user_app_data.app_info, user_app_data.patch_info, user_app_data.aoc_info, user_app_data.aoc_patch_info })
+            {
+                for(TitleInfo *cur_title_info = title_list; cur_title_info && success; cur_title_info = cur_title_info->next) success = plan_title(cur_title_info);
+            }
+
+            titleFreeUserApplicationData(&user_app_data);
+
+            if (!success)
+            {
+                LOG_MSG_ERROR("Failed to generate output path for gamecard title(s) from %016lX!", gc_app_metadata[i].app_metadata->title_id);
+                return false;
+            }
+        }
+
+        /* Sort jobs by physical offset. */
+        std::stable_sort(planned_jobs.begin(), planned_jobs.end(), [](const auto& a, const auto& b) { return (a.first < b.first); });
+
+        for(const auto& planned_job : planned_jobs) out_jobs.push_back(planned_job.second);
+
+        LOG_MSG_DEBUG("Generated %lu gamecard NSP dump job(s).", out_jobs.size());
+
+        return !out_jobs.empty();
+    }
+
+    bool DumpQueueTask::LoadQueue(std::vector<DumpQueueJob>& out_jobs)
+    {
+        DumpQueueHeader header{};
+        bool ret = false;
+
+        out_jobs.clear();
+
+        FILE *fp = fopen(DUMP_QUEUE_PATH, "rb");
+        if (!fp) return false;
+
+        if (fread(&header, 1, sizeof(DumpQueueHeader), fp) == sizeof(DumpQueueHeader) && header.magic == DumpQueueMagic && header.version == DumpQueueVersion && header.job_count)
+        {
+            out_jobs.resize(header.job_count);
+            ret = (fread(out_jobs.data(), 1, out_jobs.size() * sizeof(DumpQueueJob), fp) == (out_jobs.size() * sizeof(DumpQueueJob)));
+        }
+
+        fclose(fp);
+
+        if (!ret)
+        {
+            LOG_MSG_WARNING("Ignoring invalid dump queue file \"" DUMP_QUEUE_PATH "\".");
+            remove(DUMP_QUEUE_PATH);
+            out_jobs.clear();
+            return false;
+        }
+
+        /* Jobs that were running when the queue was interrupted must be started over. */
+        for(DumpQueueJob& job : out_jobs)
+        {
+            job.output_path[sizeof(job.output_path) - 1] = '\0';
+            if (job.status != DumpQueueJobStatus_Done) job.status = DumpQueueJobStatus_Pending;
+        }
+
+        return true;
+    }
+
+    bool DumpQueueTask::SaveQueue(const std::vector<DumpQueueJob>& jobs)
+    {
+        DumpQueueHeader header{};
+        bool ret = false;
+
+        if (jobs.empty())
+        {
+            remove(DUMP_QUEUE_PATH);
+            utilsCommitSdCardFileSystemChanges();
+            return true;
+        }
+
+        header.magic = DumpQueueMagic;
+        header.version = DumpQueueVersion;
+        header.job_count = static_cast<u32>(jobs.size());
+
+        /* Write queue data to a temporary file, then replace the current dump queue file. */
+        utilsCreateDirectoryTree(DUMP_QUEUE_PATH, false);
+
+        FILE *fp = fopen(DUMP_QUEUE_TMP_PATH, "wb");
+        if (!fp)
+        {
+            LOG_MSG_ERROR("Failed to open \"" DUMP_QUEUE_TMP_PATH "\" for writing!");
+            return false;
+        }
+
+        ret = (fwrite(&header, 1, sizeof(DumpQueueHeader), fp) == sizeof(DumpQueueHeader) && \
+               fwrite(jobs.data(), 1, jobs.size() * sizeof(DumpQueueJob), fp) == (jobs.size() * sizeof(DumpQueueJob)));
+
+        fclose(fp);
+
+        if (ret)
+        {
+            remove(DUMP_QUEUE_PATH);
+            rename(DUMP_QUEUE_TMP_PATH, DUMP_QUEUE_PATH);
+        } else {
+            LOG_MSG_ERROR("Failed to write dump queue file!");
+            remove(DUMP_QUEUE_TMP_PATH);
+        }
+
+        /* Commit SD card filesystem changes. */
+        utilsCommitSdCardFileSystemChanges();
+
+        return ret;
+    }
+}
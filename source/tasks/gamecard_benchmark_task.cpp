@@ -0,0 +1,198 @@
+/*
+ * gamecard_benchmark_task.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <tasks/gamecard_benchmark_task.hpp>
+#include <utils/scope_guard.hpp>
+#include <core/gamecard.h>
+#include <core/usb.h>
+
+namespace i18n = brls::i18n;    /* For getStr(). */
+using namespace i18n::literals; /* For _i18n. */
+
+namespace nxdt::tasks
+{
+    /* Block sizes and alignments used by each benchmark pass. */
+    static constexpr size_t g_benchmarkBlockSizes[] = { GAMECARD_PAGE_SIZE, 0x10000, 0x100000, USB_TRANSFER_BUFFER_SIZE };
+    static constexpr size_t g_benchmarkAlignments[] = { 0, GAMECARD_PAGE_SIZE / 2 };
+
+    static constexpr size_t g_benchmarkSwitchBlockSize = 0x10000;
+
+    GameCardBenchmarkTaskError GameCardBenchmarkTask::DoInBackground(void)
+    {
+        std::scoped_lock lock(this->task_mtx);
+
+        GameCardInfo gc_info{};
+        GameCardReadCacheStats cache_stats{};
+        u64 gc_total_size = 0, gc_normal_area_size = 0;
+        void *buf = nullptr;
+
+        this->results.clear();
+        this->switch_cost = 0;
+
+        /* Retrieve gamecard storage area sizes. */
+        if (!gamecardGetTotalSize(&gc_total_size) || !gamecardGetNormalAreaSize(&gc_normal_area_size) || gc_normal_area_size >= gc_total_size) return "tasks/gamecard/image/get_size_failed"_i18n;
+
+        /* Log gamecard properties, so results can be properly correlated. */
+        if (gamecardGetPlaintextCardInfoArea(&gc_info)) LOG_MSG_INFO("gcbench_info,lafw_version=%lu,total_size=%lu,normal_area_size=%lu", gc_info.fw_version, gc_total_size, gc_normal_area_size);
+
+        /* All passes read data from the start of the secure storage area. */
+        size_t secure_area_size = (gc_total_size - gc_normal_area_size);
+        size_t max_pass_size = ALIGN_DOWN(std::min(BenchmarkPassSize, secure_area_size - GAMECARD_PAGE_SIZE), GAMECARD_PAGE_SIZE);
+        if (max_pass_size < (2 * g_benchmarkSwitchBlockSize)) return "tasks/gamecard/image/get_size_failed"_i18n;
+
+        /* Calculate the total amount of data we're going to read. */
+        this->progress.total_size = (BenchmarkSwitchCount * 3 * g_benchmarkSwitchBlockSize);
+
+        for(size_t block_size : g_benchmarkBlockSizes)
+        {
+            size_t pass_size = ALIGN_DOWN(std::min(max_pass_size, block_size * BenchmarkMaxReadCount), block_size);
+            if (pass_size) this->progress.total_size += (pass_size * MAX_ELEMENTS(g_benchmarkAlignments));
+        }
+
+        this->PublishProgress(this->progress);
+
+        /* Lease memory buffer from the shared buffer pool. */
+        buf = bufferPoolLease(USB_TRANSFER_BUFFER_SIZE, false);
+        if (!buf) return "generic/mem_alloc_failed"_i18n;
+
+        ON_SCOPE_EXIT { bufferPoolReturn(buf); };
+
+        /* Disable the gamecard read cache, so small reads actually hit the gamecard. It's restored right before returning. */
+        gamecardGetReadCacheStats(&cache_stats);
+        gamecardSetReadCacheSize(0);
+
+        ON_SCOPE_EXIT { gamecardSetReadCacheSize(cache_stats.cache_size); };
+
+        /* Run benchmark passes. */
+        for(size_t block_size : g_benchmarkBlockSizes)
+        {
+            size_t pass_size = ALIGN_DOWN(std::min(max_pass_size, block_size * BenchmarkMaxReadCount), block_size);
+            if (!pass_size) continue;
+
+            for(size_t alignment : g_benchmarkAlignments)
+            {
+                GameCardBenchmarkResult result{};
+
+                if (!this->RunPass(buf, gc_normal_area_size + alignment, pass_size, block_size, alignment, result))
+                {
+                    /* Don't report the read error if the task was cancelled. */
+                    if (this->IsCancelled()) return {};
+                    return i18n::getStr("tasks/gamecard/image/io_failed", "generic/read"_i18n, block_size, gc_normal_area_size + alignment);
+                }
+
+                LOG_MSG_INFO("gcbench,block_size=%lu,alignment=%lu,reads=%lu,mib_per_sec=%.2f,p50_us=%lu,p90_us=%lu,p99_us=%lu,max_us=%lu", result.block_size, result.alignment, \
+                             result.read_count, result.speed, result.p50_latency, result.p90_latency, result.p99_latency, result.max_latency);
+
+                this->results.push_back(result);
+            }
+        }
+
+        /* Estimate the normal -> secure storage area switch cost. */
+        if (!this->MeasureSwitchCost(buf, gc_normal_area_size, g_benchmarkSwitchBlockSize))
+        {
+            if (this->IsCancelled()) return {};
+            return i18n::getStr("tasks/gamecard/image/io_failed", "generic/read"_i18n, g_benchmarkSwitchBlockSize, gc_normal_area_size);
+        }
+
+        LOG_MSG_INFO("gcbench_switch,block_size=%lu,switches=%lu,normal_to_secure_us=%lu", g_benchmarkSwitchBlockSize, BenchmarkSwitchCount, this->switch_cost);
+
+        return {};
+    }
+
+    bool GameCardBenchmarkTask::RunPass(void *buf, size_t base_offset, size_t pass_size, size_t block_size, size_t alignment, GameCardBenchmarkResult& out)
+    {
+        std::vector<u64> latencies{};
+        latencies.reserve(pass_size / block_size);
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        for(size_t offset = 0; offset < pass_size; offset += block_size)
+        {
+            /* Don't proceed if the task has been cancelled. */
+            if (this->IsCancelled()) return false;
+
+            /* Read current block and measure its latency. */
+            auto read_start_time = std::chrono::steady_clock::now();
+            if (!gamecardReadStorage(buf, block_size, base_offset + offset)) return false;
+            auto read_end_time = std::chrono::steady_clock::now();
+
+            latencies.push_back(static_cast<u64>(std::chrono::duration_cast<std::chrono::microseconds>(read_end_time - read_start_time).count()));
+
+            /* Push progress onto the class. */
+            this->AddTransferredSize(block_size);
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+        /* Calculate latency percentiles. */
+        std::sort(latencies.begin(), latencies.end());
+
+        auto percentile = [&latencies](size_t pct) -> u64 {
+            return latencies[std::min(latencies.size() - 1, (latencies.size() * pct) / 100)];
+        };
+
+        out.block_size = block_size;
+        out.alignment = alignment;
+        out.read_count = latencies.size();
+        out.speed = (elapsed > 0.0 ? ((static_cast<double>(pass_size) / elapsed) / 1048576.0) : 0.0);
+        out.p50_latency = percentile(50);
+        out.p90_latency = percentile(90);
+        out.p99_latency = percentile(99);
+        out.max_latency = latencies.back();
+
+        return true;
+    }
+
+    bool GameCardBenchmarkTask::MeasureSwitchCost(void *buf, size_t secure_offset, size_t block_size)
+    {
+        u64 switch_time = 0, baseline_time = 0;
+
+        for(size_t i = 0; i < BenchmarkSwitchCount; i++)
+        {
+            /* Don't proceed if the task has been cancelled. */
+            if (this->IsCancelled()) return false;
+
+            /* Read a block from the normal storage area. */
+            if (!gamecardReadStorage(buf, block_size, 0)) return false;
+
+            /* Read a block from the secure storage area right afterwards. This includes the switch cost. */
+            auto start_time = std::chrono::steady_clock::now();
+            if (!gamecardReadStorage(buf, block_size, secure_offset)) return false;
+            auto mid_time = std::chrono::steady_clock::now();
+
+            /* Read the next block from the secure storage area. This doesn't include the switch cost. */
+            if (!gamecardReadStorage(buf, block_size, secure_offset + block_size)) return false;
+            auto end_time = std::chrono::steady_clock::now();
+
+            switch_time += static_cast<u64>(std::chrono::duration_cast<std::chrono::microseconds>(mid_time - start_time).count());
+            baseline_time += static_cast<u64>(std::chrono::duration_cast<std::chrono::microseconds>(end_time - mid_time).count());
+
+            /* Push progress onto the class. */
+            this->AddTransferredSize(3 * block_size);
+        }
+
+        this->switch_cost = (switch_time > baseline_time ? ((switch_time - baseline_time) / BenchmarkSwitchCount) : 0);
+
+        return true;
+    }
+}
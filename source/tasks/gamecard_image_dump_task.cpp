@@ -19,10 +19,13 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include <tasks/gamecard_image_dump_task.hpp>
 #include <utils/scope_guard.hpp>
 #include <utils/file_writer.hpp>
 #include <core/gamecard.h>
+#include <core/nointro.h>
 
 namespace i18n = brls::i18n;    /* For getStr(). */
 using namespace i18n::literals; /* For _i18n. */
@@ -30,115 +33,615 @@ using namespace i18n::literals; /* For _i18n. */
 namespace nxdt::tasks
 {
     GameCardDumpTaskError GameCardImageDumpTask::DoInBackground(const std::string& output_path, const bool& prepend_key_area, const bool& keep_certificate, const bool& trim_dump,
-                                                                const bool& calculate_checksum, const bool& lookup_checksum)
+                                                                const bool& skip_padding, const bool& calculate_checksum, const bool& lookup_checksum,
+                                                                const bool& compress_output, const std::string& mirror_output_path, const bool& verify_hfs_hashes)
     {
         std::scoped_lock lock(this->task_mtx);
 
-        GameCardKeyArea gc_key_area{};
         GameCardSecurityInformation gc_security_information{};
 
         u32 gc_key_area_crc = 0;
-        size_t gc_img_size = 0;
+        size_t gc_img_size = 0, gc_trimmed_size = 0, gc_key_area_size = (prepend_key_area ? sizeof(GameCardKeyArea) : 0);
+        size_t start_offset = 0, last_checkpoint_offset = 0;
 
-        nxdt::utils::FileWriter *file = nullptr;
-        void *buf = nullptr;
+        bool usb_host = (nxdt::utils::FileWriter::GetStorageTypeByPath(output_path) == nxdt::utils::FileWriter::StorageType::UsbHost);
+        bool mirror = !mirror_output_path.empty();
 
-        DataTransferProgress progress{};
+        Thread write_thread{}, hash_thread{};
 
         /* Update private variables. */
         this->calculate_checksum = calculate_checksum;
         this->lookup_checksum = lookup_checksum;
+        this->verify_hfs_hashes = verify_hfs_hashes;
+        this->use_hash_thread = (calculate_checksum || verify_hfs_hashes);
+        this->checksum_lookup_result = std::nullopt;
+
+        LOG_MSG_DEBUG("Starting dump with parameters:\n- Output path: \"%s\".\n- Prepend key area: %u.\n- Keep certificate: %u.\n- Trim dump: %u.\n- Skip padding: %u.\n- Calculate checksum: %u.\n- Lookup checksum: %d.\n- Compress output: %u.\n- Mirror output path: \"%s\".\n- Verify HFS hashes: %u.", \
+                      output_path.c_str(), prepend_key_area, keep_certificate, trim_dump, skip_padding, calculate_checksum, lookup_checksum, compress_output, mirror_output_path.c_str(), \
+                      verify_hfs_hashes);
 
-        LOG_MSG_DEBUG("Starting dump with parameters:\n- Output path: \"%s\".\n- Prepend key area: %u.\n- Keep certificate: %u.\n- Trim dump: %u.\n- Calculate checksum: %u.\n- Lookup checksum: %d.", \
-                      output_path.c_str(), prepend_key_area, keep_certificate, trim_dump, calculate_checksum, lookup_checksum);
+        /* Retrieve hashed HFS entry regions, if needed. */
+        ON_SCOPE_EXIT { hfsFreeHashVerifier(&(this->hfs_verifier)); };
+        if (verify_hfs_hashes && !this->InitializeHfsVerifier()) return "tasks/gamecard/image/hfs_init_failed"_i18n;
 
         /* Retrieve gamecard image size. */
         if ((!trim_dump && !gamecardGetTotalSize(&gc_img_size)) || (trim_dump && !gamecardGetTrimmedSize(&gc_img_size)) || !gc_img_size) return "tasks/gamecard/image/get_size_failed"_i18n;
 
+        /* Retrieve the trimmed gamecard image size if we're supposed to skip padding reads. */
+        /* Everything past this point is 0xFF padding, which we can generate on our own instead of reading it from the gamecard. */
+        gc_trimmed_size = gc_img_size;
+        if (skip_padding && !trim_dump && (!gamecardGetTrimmedSize(&gc_trimmed_size) || !gc_trimmed_size || gc_trimmed_size > gc_img_size)) return "tasks/gamecard/image/get_size_failed"_i18n;
+
         /* Check if we're supposed to prepend the key area to the gamecard image. */
         if (prepend_key_area)
         {
             /* Update gamecard image size. */
             gc_img_size += sizeof(GameCardKeyArea);
 
-            /* Retrieve the GameCardSecurityInformation area. */
+            /* Retrieve the GameCardSecurityInformation area. The GameCardKeyArea object is generated out of it once the output file is open. */
             if (!gamecardGetSecurityInformation(&gc_security_information)) return "tasks/gamecard/image/get_security_info_failed"_i18n;
+        }
 
-            /* Copy the GameCardInitialData area from the GameCardSecurityInformation area to our GameCardKeyArea object. */
-            memcpy(&(gc_key_area.initial_data), &(gc_security_information.initial_data), sizeof(GameCardInitialData));
+        /* Prepare checkpoint data. Checkpointing is disabled if we can't uniquely identify the inserted gamecard. */
+        /* Checkpoints are never used with USB hosts, since they keep track of incomplete files on their own. Mirrored and compressed dumps can't be resumed at all. */
+        this->checkpoint = {};
+        this->checkpoint.magic = DumpCheckpointMagic;
+        this->checkpoint.version = DumpCheckpointVersion;
+        this->checkpoint.prepend_key_area = prepend_key_area;
+        this->checkpoint.keep_certificate = keep_certificate;
+        this->checkpoint.trim_dump = trim_dump;
+        this->checkpoint.calculate_checksum = calculate_checksum;
+        this->checkpoint.image_size = (gc_img_size - gc_key_area_size);
 
-            if (calculate_checksum)
-            {
-                /* Update gamecard image checksum if we're prepending the key area to it. */
-                gc_key_area_crc = crc32Calculate(&gc_key_area, sizeof(GameCardKeyArea));
-                this->full_gc_img_crc = gc_key_area_crc;
-            }
+        this->checkpoint_path = (output_path + ".ckpt");
+        this->checkpoint_enabled = (!usb_host && !mirror && !compress_output && gamecardGetCardIdSet(&(this->checkpoint.card_id_set)));
+        if (!usb_host && !mirror && !compress_output && !this->checkpoint_enabled) LOG_MSG_WARNING("Failed to retrieve gamecard ID set! Dump checkpoints will be disabled.");
+
+        /* Check if we can resume a previously interrupted dump. */
+        if (this->checkpoint_enabled && this->LoadDumpCheckpoint())
+        {
+            start_offset = last_checkpoint_offset = this->checkpoint.offset;
+            this->gc_img_crc = this->checkpoint.crc;
+            LOG_MSG_INFO("Resuming gamecard image dump from offset 0x%lX.", start_offset);
+        } else
+        if (usb_host && !mirror)
+        {
+            start_offset = this->GetUsbHostResumeOffset(output_path, gc_img_size, gc_trimmed_size, prepend_key_area ? &gc_security_information : nullptr, keep_certificate);
+            if (start_offset) LOG_MSG_INFO("Resuming gamecard image dump to USB host from offset 0x%lX.", start_offset);
         }
 
         /* Push progress onto the class. */
-        progress.total_size = gc_img_size;
-        this->PublishProgress(progress);
+        this->progress.total_size = gc_img_size;
+        this->progress.xfer_size = (start_offset ? (gc_key_area_size + start_offset) : 0);
+        this->PublishProgress(this->progress);
 
-        /* Open output file. */
+        /* Open output file. Start over if the incomplete output file can't be resumed. */
         try {
-            file = new nxdt::utils::FileWriter(output_path, gc_img_size);
+            try {
+                this->file = new nxdt::utils::FileWriter(output_path, gc_img_size, 0, start_offset ? (gc_key_area_size + start_offset) : 0, nullptr, compress_output);
+            } catch(const std::string& msg) {
+                if (!start_offset) throw;
+
+                LOG_MSG_WARNING("%s Starting over.", msg.c_str());
+                if (this->checkpoint_enabled) remove(this->checkpoint_path.c_str());
+
+                start_offset = last_checkpoint_offset = 0;
+                this->gc_img_crc = 0;
+                this->progress.xfer_size = 0;
+                this->PublishProgress(this->progress);
+
+                this->file = new nxdt::utils::FileWriter(output_path, gc_img_size);
+            }
         } catch(const std::string& msg) {
             LOG_MSG_ERROR("%s", msg.c_str());
             return msg;
         }
 
-        ON_SCOPE_EXIT { delete file; };
+        ON_SCOPE_EXIT {
+            /* Keep incomplete output files around if the dump was interrupted by an error and a checkpoint could be saved. */
+            if (this->checkpoint_enabled && this->file->GetCurrentOffset() != this->progress.total_size)
+            {
+                if (!this->IsCancelled() && this->SaveDumpCheckpoint())
+                {
+                    this->file->SetKeepIncompleteFile(true);
+                } else {
+                    remove(this->checkpoint_path.c_str());
+                }
+            }
+
+            delete this->file;
+            this->file = nullptr;
+        };
+
+        /* Create mirror output file, if needed. The same read buffers feed both output files. */
+        if (mirror)
+        {
+            if (auto error = this->file->AddMirror(mirror_output_path)) return error;
+        }
 
         if (prepend_key_area)
         {
-            /* Write GameCardKeyArea object. */
-            if (!file->Write(&gc_key_area, sizeof(GameCardKeyArea))) return "tasks/gamecard/image/write_key_area_failed"_i18n;
+            /* Generate the GameCardKeyArea object right within a buffer leased from the output file, so it can be written without any additional copies. */
+            GameCardKeyArea *gc_key_area = static_cast<GameCardKeyArea*>(this->file->AcquireBuffer(sizeof(GameCardKeyArea)));
+            if (!gc_key_area) return "tasks/gamecard/image/write_key_area_failed"_i18n;
 
-            /* Push progress onto the class. */
-            progress.xfer_size += sizeof(GameCardKeyArea);
-            this->PublishProgress(progress);
+            /* Copy the GameCardInitialData area from the GameCardSecurityInformation area to our GameCardKeyArea object. */
+            memset(gc_key_area, 0, sizeof(GameCardKeyArea));
+            memcpy(&(gc_key_area->initial_data), &(gc_security_information.initial_data), sizeof(GameCardInitialData));
+
+            /* Calculate the key area checksum if we're prepending the key area to the gamecard image. */
+            /* It will be combined with the gamecard image checksum once the dump process is complete. */
+            if (calculate_checksum) gc_key_area_crc = crc32FastCalculate(gc_key_area, sizeof(GameCardKeyArea));
+
+            /* Write GameCardKeyArea object. This is skipped while resuming a dump, since it's already part of the output file. */
+            if (!this->file->Commit(start_offset ? 0 : sizeof(GameCardKeyArea))) return "tasks/gamecard/image/write_key_area_failed"_i18n;
+
+            if (!start_offset)
+            {
+                /* Push progress onto the class. */
+                this->AddTransferredSize(sizeof(GameCardKeyArea));
+            }
 
             /* Update gamecard image size. */
             gc_img_size -= sizeof(GameCardKeyArea);
         }
 
-        /* Allocate memory buffer for the dump process. */
-        buf = usbAllocatePageAlignedBuffer(USB_TRANSFER_BUFFER_SIZE);
-        if (!buf) return "generic/mem_alloc_failed"_i18n;
+        /* Reset dump buffer ring. */
+        this->ring_committed_cnt = this->ring_written_cnt = this->ring_hashed_cnt = 0;
+        this->read_finished = this->write_failed = false;
+        this->failed_write_size = this->failed_write_offset = 0;
+        this->ring_checkpoint_cnt = 0;
+        this->checkpoint.offset = start_offset;
+        this->checkpoint.crc = this->gc_img_crc;
+
+        /* Write and hash threads consume each block in parallel, so they're both reported as stages that follow the read stage. */
+        /* The write stage becomes CPU-bound if it has to compress data. */
+        u32 cpu_bound_stage_mask = DataTransferPipelineStats::DefaultCpuBoundStageMask;
+        if (compress_output || (usb_host && configGetBoolean("usb_compression"))) cpu_bound_stage_mask |= BIT(DataTransferStage_Write);
+
+        this->UpdatePipelineStats();
+        this->GetPipelineStats()->Enable(DumpBufferCount, BIT(DataTransferStage_Read) | BIT(DataTransferStage_Write) | (this->use_hash_thread ? BIT(DataTransferStage_Hash) : 0), \
+                                         cpu_bound_stage_mask);
 
-        ON_SCOPE_EXIT { free(buf); };
+        ON_SCOPE_EXIT {
+            for(DumpBuffer& dump_buf : this->ring)
+            {
+                if (dump_buf.data) bufferPoolReturn(dump_buf.data);
+                dump_buf = {};
+            }
+        };
+
+        /* Lease memory buffers for the dump process from the shared buffer pool. */
+        for(DumpBuffer& dump_buf : this->ring)
+        {
+            dump_buf.data = bufferPoolLease(USB_TRANSFER_BUFFER_SIZE, false);
+            if (!dump_buf.data) return "generic/mem_alloc_failed"_i18n;
+        }
+
+        /* Calculate the checksum of a full padding block, if needed. */
+        this->padding_block_crc = 0;
+        if (calculate_checksum && (gc_img_size - gc_trimmed_size) >= USB_TRANSFER_BUFFER_SIZE)
+        {
+            memset(this->ring[0].data, 0xFF, USB_TRANSFER_BUFFER_SIZE);
+            this->padding_block_crc = crc32FastCalculate(this->ring[0].data, USB_TRANSFER_BUFFER_SIZE);
+        }
+
+        /* Make sure all consumer threads are always joined before returning. */
+        ON_SCOPE_EXIT {
+            if (write_thread.handle == INVALID_HANDLE && hash_thread.handle == INVALID_HANDLE) return;
+            this->FinishDumpBufferRing();
+            if (write_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&write_thread);
+            if (hash_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&hash_thread);
+        };
+
+        /* Create consumer threads. The hash thread is only needed if checksum calculation and/or HFS hash verification were requested. */
+        if (!threadPlacementCreateThread(&write_thread, GameCardImageDumpTask::WriteThreadFunc, this, usb_host ? ThreadPlacementStage_Usb : ThreadPlacementStage_Write) || \
+            (this->use_hash_thread && !threadPlacementCreateThread(&hash_thread, GameCardImageDumpTask::HashThreadFunc, this, ThreadPlacementStage_Hash))) return "tasks/gamecard/image/thread_create_failed"_i18n;
+
+        /* Move the task thread off the UI core while reading. */
+        ThreadPlacementScope read_scope{};
+        threadPlacementEnterStage(ThreadPlacementStage_Read, &read_scope);
+        ON_SCOPE_EXIT { threadPlacementExitStage(&read_scope); };
 
         /* Dump gamecard image. */
-        for(size_t offset = 0, blksize = USB_TRANSFER_BUFFER_SIZE; offset < gc_img_size; offset += blksize)
+        for(size_t offset = start_offset, blksize = USB_TRANSFER_BUFFER_SIZE; offset < gc_img_size; offset += blksize)
         {
             /* Don't proceed if the task has been cancelled. */
             if (this->IsCancelled()) return {};
 
+            /* Periodically save a checkpoint, so the dump can be resumed even if the console loses power. */
+            if (this->checkpoint_enabled && offset >= (last_checkpoint_offset + DumpCheckpointInterval))
+            {
+                size_t saved_offset = this->SaveDumpCheckpoint();
+                if (saved_offset) last_checkpoint_offset = saved_offset;
+            }
+
             /* Adjust current block size, if needed. */
             if (blksize > (gc_img_size - offset)) blksize = (gc_img_size - offset);
 
+            /* Wait until an empty buffer is available. */
+            DumpBuffer *dump_buf = this->GetEmptyDumpBuffer();
+            if (!dump_buf) break;
+
+            /* Don't read padding data past the trimmed gamecard image size. */
+            size_t read_size = (offset >= gc_trimmed_size ? 0 : std::min(blksize, gc_trimmed_size - offset));
+
             /* Read current block. */
-            if (!gamecardReadStorage(buf, blksize, offset)) return i18n::getStr("tasks/gamecard/image/io_failed", "generic/read"_i18n, blksize, offset);
+            if (read_size && !gamecardReadStorage(dump_buf->data, read_size, offset)) return i18n::getStr("tasks/gamecard/image/io_failed", "generic/read"_i18n, read_size, offset);
+
+            /* Generate padding data, if needed. */
+            if (read_size < blksize) memset(static_cast<u8*>(dump_buf->data) + read_size, 0xFF, blksize - read_size);
 
             /* Remove certificate, if needed. */
-            if (!keep_certificate && offset == 0) memset(static_cast<u8*>(buf) + GAMECARD_CERT_OFFSET, 0xFF, sizeof(FsGameCardCertificate));
+            if (!keep_certificate) GameCardImageDumpTask::RemoveCertificate(dump_buf->data, offset, blksize);
 
-            /* Update image checksum. */
-            if (calculate_checksum)
+            /* Hand the current block over to the consumer threads. */
+            dump_buf->size = blksize;
+            dump_buf->offset = offset;
+            dump_buf->data_size = read_size;
+            this->CommitDumpBuffer();
+        }
+
+        /* Wait for the consumer threads to process all pending blocks. */
+        this->FinishDumpBufferRing();
+        threadPlacementJoinThread(&write_thread);
+        if (this->use_hash_thread) threadPlacementJoinThread(&hash_thread);
+        threadPlacementExitStage(&read_scope);
+        threadPlacementLogStats();
+
+        /* Check if the write thread failed. */
+        if (this->write_failed) return i18n::getStr("tasks/gamecard/image/io_failed", "generic/write"_i18n, this->failed_write_size, this->failed_write_offset);
+
+        /* Check HFS hash verification results. The output file is kept, since it holds exactly what the gamecard returned. */
+        if (verify_hfs_hashes && !hfsFinalizeHashVerifier(&(this->hfs_verifier)))
+        {
+            const HashFileSystemHashVerifier& verifier = this->hfs_verifier;
+            const HashFileSystemHashRegion *region = std::find_if(verifier.regions, verifier.regions + verifier.region_count, [](const HashFileSystemHashRegion& cur) {
+                return (cur.status == HashFileSystemHashStatus_Failed);
+            });
+
+            return i18n::getStr("tasks/gamecard/image/hfs_hash_mismatch", region->name, hfsGetPartitionNameString(region->hfs_partition_type), verifier.failed_count);
+        }
+
+        /* Remove checkpoint file, if needed. */
+        if (this->checkpoint_enabled && (start_offset || last_checkpoint_offset)) remove(this->checkpoint_path.c_str());
+
+        /* Calculate the full gamecard image checksum by combining the key area checksum with the gamecard image checksum. */
+        /* This avoids hashing every gamecard image block twice. */
+        if (calculate_checksum && prepend_key_area) this->full_gc_img_crc = crc32Combine(gc_key_area_crc, this->gc_img_crc, gc_img_size);
+
+        /* Look up the gamecard image checksum using the offline No-Intro index. No network access is needed for this. */
+        /* The index holds checksums for plain XCI images, so this is only meaningful if the certificate was removed and the dump wasn't trimmed. */
+        if (calculate_checksum && lookup_checksum)
+        {
+            if (!keep_certificate && !trim_dump)
+            {
+                NoIntroRecord record{};
+                this->checksum_lookup_result = (noIntroLookupChecksum(this->gc_img_crc, nullptr, &record) ? std::string(record.name) : std::string());
+            } else {
+                LOG_MSG_WARNING("Skipping checksum lookup for gamecard image with certificate and/or trimmed data.");
+            }
+        }
+
+        return {};
+    }
+
+    void GameCardImageDumpTask::WriteThreadFunc(void *arg)
+    {
+        GameCardImageDumpTask *task = static_cast<GameCardImageDumpTask*>(arg);
+        DumpBuffer *dump_buf = nullptr;
+        size_t last_size = 0, last_offset = 0;
+
+        while((dump_buf = task->GetFilledDumpBuffer(task->ring_written_cnt)))
+        {
+            /* Write current block. The ring mutex isn't held here, which lets the read thread fill the next buffer in the meantime. */
+            if (!task->file->Write(dump_buf->data, dump_buf->size))
             {
-                this->gc_img_crc = crc32CalculateWithSeed(this->gc_img_crc, buf, blksize);
-                if (prepend_key_area) this->full_gc_img_crc = crc32CalculateWithSeed(this->full_gc_img_crc, buf, blksize);
+                {
+                    /* Keep track of the failed block. */
+                    std::scoped_lock ring_lock(task->ring_mtx);
+                    task->write_failed = true;
+                    task->failed_write_size = dump_buf->size;
+                    task->failed_write_offset = dump_buf->offset;
+                }
+
+                /* Wake up the read and hash threads. */
+                task->ring_read_cv.notify_all();
+                task->ring_consume_cv.notify_all();
+                break;
             }
 
-            /* Write current block. */
-            if (!file->Write(buf, blksize)) return i18n::getStr("tasks/gamecard/image/io_failed", "generic/write"_i18n, blksize, offset);
+            last_size = dump_buf->size;
+            last_offset = dump_buf->offset;
 
             /* Push progress onto the class. */
-            progress.xfer_size += blksize;
-            progress.percentage = static_cast<int>((progress.xfer_size * 100) / progress.total_size);
-            this->PublishProgress(progress);
+            task->AddTransferredSize(dump_buf->size);
+
+            /* Release the current buffer. */
+            task->ReleaseDumpBuffer(task->ring_written_cnt);
         }
 
-        return {};
+        /* Make sure all queued writes made it to the output file. Write errors are reported one call late, so the last block may still fail at this point. */
+        if (!task->write_failed && !task->file->Flush())
+        {
+            std::scoped_lock ring_lock(task->ring_mtx);
+            task->write_failed = true;
+            task->failed_write_size = last_size;
+            task->failed_write_offset = last_offset;
+        }
+
+        threadExit();
+    }
+
+    void GameCardImageDumpTask::HashThreadFunc(void *arg)
+    {
+        GameCardImageDumpTask *task = static_cast<GameCardImageDumpTask*>(arg);
+        DumpBuffer *dump_buf = nullptr;
+
+        while((dump_buf = task->GetFilledDumpBuffer(task->ring_hashed_cnt)))
+        {
+            if (task->calculate_checksum)
+            {
+                /* Update image checksum. Full padding blocks don't need to be hashed at all. */
+                if (!dump_buf->data_size && dump_buf->size == USB_TRANSFER_BUFFER_SIZE)
+                {
+                    task->gc_img_crc = crc32Combine(task->gc_img_crc, task->padding_block_crc, dump_buf->size);
+                } else {
+                    task->gc_img_crc = crc32FastCalculateWithSeed(task->gc_img_crc, dump_buf->data, dump_buf->size);
+                }
+
+                /* Keep track of the running checksum for this block. */
+                dump_buf->crc = task->gc_img_crc;
+            }
+
+            /* Check hashed HFS entry regions covered by this block. Generated padding data is never covered by any of them. */
+            if (task->verify_hfs_hashes) hfsUpdateHashVerifier(&(task->hfs_verifier), dump_buf->data, dump_buf->data_size, dump_buf->offset);
+
+            /* Release the current buffer. */
+            task->ReleaseDumpBuffer(task->ring_hashed_cnt);
+        }
+
+        threadExit();
+    }
+
+    bool GameCardImageDumpTask::InitializeHfsVerifier(void)
+    {
+        hfsFreeHashVerifier(&(this->hfs_verifier));
+
+        for(u8 i = HashFileSystemPartitionType_Root; i < HashFileSystemPartitionType_Count; i++)
+        {
+            HashFileSystemContext hfs_ctx{};
+
+            /* Not all HFS partitions are available in every gamecard. The root partition must always be available, though. */
+            if (!gamecardGetHashFileSystemContext(i, &hfs_ctx))
+            {
+                if (i == HashFileSystemPartitionType_Root) return false;
+                continue;
+            }
+
+            bool ret = hfsAddHashVerifierContext(&(this->hfs_verifier), &hfs_ctx);
+            hfsFreeContext(&hfs_ctx);
+            if (!ret) return false;
+        }
+
+        LOG_MSG_DEBUG("Verifying %u hashed HFS entry region(s).", this->hfs_verifier.region_count);
+
+        return true;
+    }
+
+    GameCardImageDumpTask::DumpBuffer *GameCardImageDumpTask::GetEmptyDumpBuffer(void)
+    {
+        std::unique_lock<std::mutex> ring_lock(this->ring_mtx);
+
+        /* A ring slot is only empty once it has been processed by all consumer threads. */
+        this->ring_read_cv.wait(ring_lock, [this]() {
+            size_t consumed_cnt = (this->use_hash_thread ? std::min(this->ring_written_cnt, this->ring_hashed_cnt) : this->ring_written_cnt);
+            return ((this->ring_committed_cnt - consumed_cnt) < DumpBufferCount || this->write_failed);
+        });
+
+        return (this->write_failed ? nullptr : &(this->ring[this->ring_committed_cnt % DumpBufferCount]));
+    }
+
+    void GameCardImageDumpTask::CommitDumpBuffer(void)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+            this->GetPipelineStats()->AddStageSize(DataTransferStage_Read, this->ring[this->ring_committed_cnt % DumpBufferCount].size);
+            this->ring_committed_cnt++;
+            this->UpdatePipelineStats();
+        }
+
+        this->ring_consume_cv.notify_all();
+    }
+
+    void GameCardImageDumpTask::FinishDumpBufferRing(void)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+            this->read_finished = true;
+        }
+
+        this->ring_consume_cv.notify_all();
+    }
+
+    GameCardImageDumpTask::DumpBuffer *GameCardImageDumpTask::GetFilledDumpBuffer(size_t& consumed_cnt)
+    {
+        std::unique_lock<std::mutex> ring_lock(this->ring_mtx);
+
+        /* Wait until a filled buffer is available, or until the read thread is done. */
+        this->ring_consume_cv.wait(ring_lock, [this, &consumed_cnt]() { return (consumed_cnt < this->ring_committed_cnt || this->read_finished || this->write_failed); });
+
+        /* Bail out if there's nothing left to consume. Pending blocks are discarded if the task was cancelled or if the write thread failed. */
+        if (consumed_cnt >= this->ring_committed_cnt || this->write_failed || this->IsCancelled()) return nullptr;
+
+        return &(this->ring[consumed_cnt % DumpBufferCount]);
+    }
+
+    void GameCardImageDumpTask::ReleaseDumpBuffer(size_t& consumed_cnt)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+
+            DataTransferStage stage = (&consumed_cnt == &(this->ring_hashed_cnt) ? DataTransferStage_Hash : DataTransferStage_Write);
+            this->GetPipelineStats()->AddStageSize(stage, this->ring[consumed_cnt % DumpBufferCount].size);
+
+            consumed_cnt++;
+            this->UpdatePipelineStats();
+
+            /* Update checkpoint data once a block has been processed by all consumer threads. */
+            /* The ring slot can't be reused until the ring mutex is released, so it's safe to access it here. */
+            size_t done_cnt = (this->use_hash_thread ? std::min(this->ring_written_cnt, this->ring_hashed_cnt) : this->ring_written_cnt);
+            if (done_cnt > this->ring_checkpoint_cnt)
+            {
+                const DumpBuffer& dump_buf = this->ring[(done_cnt - 1) % DumpBufferCount];
+                this->checkpoint.offset = (dump_buf.offset + dump_buf.size);
+                this->checkpoint.crc = (this->calculate_checksum ? dump_buf.crc : 0);
+                this->ring_checkpoint_cnt = done_cnt;
+            }
+        }
+
+        this->ring_read_cv.notify_one();
+    }
+
+    void GameCardImageDumpTask::UpdatePipelineStats(void)
+    {
+        DataTransferPipelineStats *stats = this->GetPipelineStats();
+
+        /* A ring slot is only empty once it has been processed by all consumer threads. */
+        size_t consumed_cnt = (this->use_hash_thread ? std::min(this->ring_written_cnt, this->ring_hashed_cnt) : this->ring_written_cnt);
+        stats->SetStageQueued(DataTransferStage_Read, DumpBufferCount - (this->ring_committed_cnt - consumed_cnt));
+        stats->SetStageQueued(DataTransferStage_Write, this->ring_committed_cnt - this->ring_written_cnt);
+        stats->SetStageQueued(DataTransferStage_Hash, this->use_hash_thread ? (this->ring_committed_cnt - this->ring_hashed_cnt) : 0);
+    }
+
+    size_t GameCardImageDumpTask::GetUsbHostResumeOffset(const std::string& output_path, size_t gc_img_size, size_t gc_trimmed_size, const GameCardSecurityInformation *gc_security_information,
+                                                         bool keep_certificate)
+    {
+        UsbFileResumeInfo resume_info{};
+        GameCardKeyArea gc_key_area{};
+        size_t gc_key_area_size = (gc_security_information ? sizeof(GameCardKeyArea) : 0);
+        u8 check_hash[SHA256_HASH_SIZE] = {0};
+
+        /* Check if the USB host holds any data we can use. There's no point in resuming a dump if nothing but the key area was written. */
+        if (!usbGetFileResumeInfo(gc_img_size, output_path.c_str(), &resume_info) || resume_info.offset <= gc_key_area_size || resume_info.check_size > USB_TRANSFER_BUFFER_SIZE) return 0;
+
+        u8 *check_buf = static_cast<u8*>(malloc(resume_info.check_size));
+        if (!check_buf) return 0;
+
+        ON_SCOPE_EXIT { free(check_buf); };
+
+        /* Regenerate the output file block covered by the check hash, just like DoInBackground() would. */
+        size_t check_offset = (resume_info.offset - resume_info.check_size), img_offset = check_offset, img_size = resume_info.check_size;
+        u8 *img_buf = check_buf;
+
+        if (gc_security_information)
+        {
+            memcpy(&(gc_key_area.initial_data), &(gc_security_information->initial_data), sizeof(GameCardInitialData));
+
+            if (check_offset < gc_key_area_size)
+            {
+                size_t key_area_chunk_size = (gc_key_area_size - check_offset);
+                memcpy(check_buf, reinterpret_cast<u8*>(&gc_key_area) + check_offset, key_area_chunk_size);
+
+                img_buf += key_area_chunk_size;
+                img_size -= key_area_chunk_size;
+                img_offset = 0;
+            } else {
+                img_offset -= gc_key_area_size;
+            }
+        }
+
+        /* Don't read padding data past the trimmed gamecard image size. */
+        size_t read_size = (img_offset >= gc_trimmed_size ? 0 : std::min(img_size, gc_trimmed_size - img_offset));
+        if (read_size && !gamecardReadStorage(img_buf, read_size, img_offset)) return 0;
+        if (read_size < img_size) memset(img_buf + read_size, 0xFF, img_size - read_size);
+        if (!keep_certificate) GameCardImageDumpTask::RemoveCertificate(img_buf, img_offset, img_size);
+
+        sha256CalculateHash(check_hash, check_buf, resume_info.check_size);
+        if (memcmp(check_hash, resume_info.check_hash, SHA256_HASH_SIZE) != 0)
+        {
+            LOG_MSG_WARNING("Incomplete gamecard image held by the USB host doesn't match the inserted gamecard. Starting over.");
+            return 0;
+        }
+
+        /* The checksum calculated by the USB host covers the key area, if available. */
+        /* Cancel its contribution out to get the running gamecard image checksum: crc(key_area || image) == (crc32Combine(crc(key_area), 0, image_size) ^ crc(image)). */
+        size_t offset = (resume_info.offset - gc_key_area_size);
+        this->gc_img_crc = resume_info.crc;
+        if (gc_security_information) this->gc_img_crc ^= crc32Combine(crc32FastCalculate(&gc_key_area, sizeof(GameCardKeyArea)), 0, offset);
+
+        return offset;
+    }
+
+    void GameCardImageDumpTask::RemoveCertificate(void *buf, size_t offset, size_t size)
+    {
+        /* The certificate may be partially covered by the provided block while resuming a dump. */
+        size_t cert_start = std::max(offset, static_cast<size_t>(GAMECARD_CERT_OFFSET));
+        size_t cert_end = std::min(offset + size, static_cast<size_t>(GAMECARD_CERT_OFFSET) + sizeof(FsGameCardCertificate));
+        if (cert_start < cert_end) memset(static_cast<u8*>(buf) + (cert_start - offset), 0xFF, cert_end - cert_start);
+    }
+
+    bool GameCardImageDumpTask::LoadDumpCheckpoint(void)
+    {
+        DumpCheckpoint stored{};
+        bool ret = false;
+
+        FILE *fp = fopen(this->checkpoint_path.c_str(), "rb");
+        if (!fp) return false;
+
+        /* Everything before the offset field must match the current dump parameters. */
+        ret = (fread(&stored, 1, sizeof(DumpCheckpoint), fp) == sizeof(DumpCheckpoint) && !memcmp(&stored, &(this->checkpoint), offsetof(DumpCheckpoint, offset)) && \
+               stored.offset && stored.offset < stored.image_size && !(stored.offset % USB_TRANSFER_BUFFER_SIZE));
+
+        fclose(fp);
+
+        if (ret)
+        {
+            this->checkpoint.offset = stored.offset;
+            this->checkpoint.crc = stored.crc;
+        } else {
+            LOG_MSG_WARNING("Ignoring mismatching checkpoint file \"%s\".", this->checkpoint_path.c_str());
+            remove(this->checkpoint_path.c_str());
+        }
+
+        return ret;
+    }
+
+    size_t GameCardImageDumpTask::SaveDumpCheckpoint(void)
+    {
+        DumpCheckpoint ckpt{};
+        bool ret = false;
+
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+            ckpt = this->checkpoint;
+        }
+
+        /* Don't bother if nothing has been dumped yet. */
+        if (!ckpt.offset) return 0;
+
+        FILE *fp = fopen(this->checkpoint_path.c_str(), "wb");
+        if (!fp)
+        {
+            LOG_MSG_ERROR("Failed to open checkpoint file \"%s\" for writing!", this->checkpoint_path.c_str());
+            return 0;
+        }
+
+        ret = (fwrite(&ckpt, 1, sizeof(DumpCheckpoint), fp) == sizeof(DumpCheckpoint));
+
+        fclose(fp);
+
+        if (!ret)
+        {
+            LOG_MSG_ERROR("Failed to write checkpoint file \"%s\"!", this->checkpoint_path.c_str());
+            remove(this->checkpoint_path.c_str());
+        }
+
+        /* Commit SD card filesystem changes. */
+        utilsCommitSdCardFileSystemChanges();
+
+        if (ret) LOG_MSG_DEBUG("Saved dump checkpoint at offset 0x%lX.", ckpt.offset);
+
+        return (ret ? static_cast<size_t>(ckpt.offset) : 0);
     }
 }
@@ -25,7 +25,7 @@ using namespace brls::i18n::literals;   /* For _i18n. */
 
 namespace nxdt::tasks
 {
-    GameCardStatusTask::GameCardStatusTask() : brls::RepeatingTask(REPEATING_TASK_INTERVAL)
+    GameCardStatusTask::GameCardStatusTask() : brls::RepeatingTask(USER_EVENT_TASK_INTERVAL), gc_status_waiter(gamecardGetStatusUpdateUserEvent())
     {
         brls::RepeatingTask::start();
 
@@ -43,6 +43,9 @@ namespace nxdt::tasks
     {
         brls::RepeatingTask::run(current_time);
 
+        /* Fall back to polling if the waiter thread isn't available. */
+        if (this->gc_status_waiter.IsActive() && !this->gc_status_waiter.Consume()) return;
+
         this->cur_gc_status = static_cast<GameCardStatus>(gamecardGetStatus());
         if (this->cur_gc_status != this->prev_gc_status)
         {
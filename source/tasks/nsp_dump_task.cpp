@@ -0,0 +1,1185 @@
+/*
+ * nsp_dump_task.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <tasks/nsp_dump_task.hpp>
+#include <utils/scope_guard.hpp>
+#include <utils/file_writer.hpp>
+#include <core/cert.h>
+
+namespace i18n = brls::i18n;    /* For getStr(). */
+using namespace i18n::literals; /* For _i18n. */
+
+namespace nxdt::tasks
+{
+    u8 *NspDumpSharedResources::GetRawCertificateChain(const char *issuer, u64 *out_size)
+    {
+        if (!issuer || !*issuer || !out_size) return nullptr;
+
+        std::scoped_lock lock(this->res_mtx);
+
+        /* Generate the certificate chain if we haven't done so already. */
+        auto it = this->cert_chains.find(issuer);
+        if (it == this->cert_chains.end())
+        {
+            u64 raw_chain_size = 0;
+            u8 *raw_chain = certGenerateRawCertificateChainBySignatureIssuer(issuer, &raw_chain_size);
+            if (!raw_chain) return nullptr;
+
+            it = this->cert_chains.emplace(issuer, std::vector<u8>(raw_chain, raw_chain + raw_chain_size)).first;
+            free(raw_chain);
+        }
+
+        /* Return a copy of the certificate chain. */
+        u8 *out = static_cast<u8*>(malloc(it->second.size()));
+        if (!out) return nullptr;
+
+        memcpy(out, it->second.data(), it->second.size());
+        *out_size = it->second.size();
+
+        return out;
+    }
+
+    bool NspDumpSharedResources::GetNcaDedupEntry(const std::string& key, NcaDedupEntry& out_entry)
+    {
+        std::scoped_lock lock(this->res_mtx);
+
+        auto it = this->nca_dedup_entries.find(key);
+        if (it == this->nca_dedup_entries.end()) return false;
+
+        out_entry = it->second;
+
+        return true;
+    }
+
+    void NspDumpSharedResources::AddNcaDedupEntry(const std::string& key, const NcaDedupEntry& entry)
+    {
+        std::scoped_lock lock(this->res_mtx);
+        this->nca_dedup_entries.emplace(key, entry);
+    }
+
+    NspDumper::~NspDumper()
+    {
+        this->FreeData();
+    }
+
+    void NspDumper::FreeData(void)
+    {
+        if (this->raw_cert_chain) free(this->raw_cert_chain);
+        this->raw_cert_chain = nullptr;
+        this->raw_cert_chain_size = 0;
+
+        pfsFreeImageContext(&(this->pfs_img_ctx));
+
+        for(LegalInfoContext& cur_legal_info_ctx : this->legal_info_ctx) legalInfoFreeContext(&cur_legal_info_ctx);
+        this->legal_info_ctx.clear();
+
+        for(NacpContext& cur_nacp_ctx : this->nacp_ctx) nacpFreeContext(&cur_nacp_ctx);
+        this->nacp_ctx.clear();
+        this->deferred_nacp_ctx.clear();
+
+        for(ProgramInfoContext& cur_program_info_ctx : this->program_info_ctx) programInfoFreeContext(&cur_program_info_ctx);
+        this->program_info_ctx.clear();
+
+        cnmtFreeContext(&(this->cnmt_ctx));
+        this->nca_ctx.clear();
+
+        if (this->title_info) titleFreeTitleInfo(&(this->title_info));
+
+        this->nsp_header.clear();
+        this->nsp_size = 0;
+        this->prepared = false;
+
+        this->shared_res = nullptr;
+        this->nca_dedup_keys.clear();
+        this->nca_hashes.clear();
+    }
+
+    NspDumpTaskError NspDumper::Prepare(u8 storage_id, u64 title_id, const NspDumpOptions& options, NspDumpSharedResources *shared_res)
+    {
+        u32 content_count = 0, program_count = 0, control_count = 0, legal_info_count = 0;
+        u32 program_idx = 0, control_idx = 0, legal_info_idx = 0;
+        TikCommonBlock *tik_common_block = nullptr;
+        char entry_name[0x40] = {0};
+        u64 nsp_header_size = 0;
+        bool success = false;
+
+        /* Free any previously prepared data. */
+        this->FreeData();
+        this->options = options;
+        this->tik = {};
+
+        ON_SCOPE_EXIT { if (!success) this->FreeData(); };
+
+        /* Retrieve title info. */
+        this->title_info = titleGetTitleInfoEntryFromStorageByTitleId(storage_id, title_id);
+        if (!this->title_info || !this->title_info->content_count || !this->title_info->content_infos) return "tasks/nsp/get_title_info_failed"_i18n;
+
+        TitleInfo *title_info = this->title_info;
+        content_count = title_info->content_count;
+        u8 hfs_partition_type = (title_info->storage_id == NcmStorageId_GameCard ? HashFileSystemPartitionType_Secure : 0);
+
+        /* Allocate contexts. Program info contexts and legal info contexts are only needed to generate AuthoringTool data. */
+        if (options.generate_authoringtool_data)
+        {
+            program_count = titleGetContentCountByType(title_info, NcmContentType_Program);
+            legal_info_count = titleGetContentCountByType(title_info, NcmContentType_LegalInformation);
+        }
+
+        if (options.patch_sua || options.patch_screenshot || options.patch_video_capture || options.patch_hdcp || options.generate_authoringtool_data)
+        {
+            control_count = titleGetContentCountByType(title_info, NcmContentType_Control);
+        }
+
+        this->nca_ctx.resize(content_count);
+        this->nca_hashes.resize(content_count);
+        this->program_info_ctx.resize(program_count);
+        this->nacp_ctx.resize(control_count);
+        this->legal_info_ctx.resize(legal_info_count);
+
+        /* NACP patches don't affect the NSP size, so their generation can be deferred to the streaming pass if no AuthoringTool data is needed. */
+        if (control_count && !options.generate_authoringtool_data) this->deferred_nacp_ctx.resize(content_count, nullptr);
+
+        pfsInitializeImageContext(&(this->pfs_img_ctx));
+
+        /* Initialize the Meta NCA context. It's always placed at the end of the NCA context list. */
+        NcaContext *meta_nca_ctx = &(this->nca_ctx[content_count - 1]);
+
+        if (!ncaInitializeContext(meta_nca_ctx, title_info->storage_id, hfs_partition_type, &(title_info->meta_key), titleGetContentInfoByTypeAndIdOffset(title_info, NcmContentType_Meta, 0), &(this->tik)))
+        {
+            return i18n::getStr("tasks/nsp/nca_init_failed", titleGetNcmContentTypeName(NcmContentType_Meta), 0);
+        }
+
+        if (!cnmtInitializeContext(&(this->cnmt_ctx), meta_nca_ctx)) return "tasks/nsp/cnmt_init_failed"_i18n;
+
+        /* Determine the NCA order. The Meta NCA is skipped, since we already initialized it. */
+        /* Gamecard NCAs are sorted by their physical offset, which lets Dump() read them in a single near-sequential sweep. The PFS entry order follows the NCA context order. */
+        std::vector<std::pair<u64, u32>> content_order{};
+
+        for(u32 i = 0; i < content_count; i++)
+        {
+            NcmContentInfo *content_info = &(title_info->content_infos[i]);
+            if (content_info->content_type == NcmContentType_Meta) continue;
+
+            u64 gamecard_offset = (title_info->storage_id == NcmStorageId_GameCard ? NspDumper::GetGameCardContentOffset(content_info) : 0);
+            content_order.push_back({ gamecard_offset, i });
+        }
+
+        if (title_info->storage_id == NcmStorageId_GameCard) std::stable_sort(content_order.begin(), content_order.end(), [](const auto& a, const auto& b) { return (a.first < b.first); });
+
+        if (content_order.size() != (content_count - 1)) return "tasks/nsp/get_title_info_failed"_i18n;
+
+        /* Initialize the rest of the NCA contexts, as well as their content type contexts. Generate NCA patches, if needed. */
+        bool titlekey_warning_logged = false;
+
+        for(u32 nca_idx = 0; nca_idx < (content_count - 1); nca_idx++)
+        {
+            NcmContentInfo *content_info = &(title_info->content_infos[content_order[nca_idx].second]);
+            NcaContext *cur_nca_ctx = &(this->nca_ctx[nca_idx]);
+
+            if (!ncaInitializeContext(cur_nca_ctx, title_info->storage_id, hfs_partition_type, &(title_info->meta_key), content_info, &(this->tik)))
+            {
+                return i18n::getStr("tasks/nsp/nca_init_failed", titleGetNcmContentTypeName(content_info->content_type), content_info->id_offset);
+            }
+
+            /* NCA modifications are disabled if we can't access the FS section data from this NCA. */
+            /* Content decryption won't be possible for external tools either. */
+            if (cur_nca_ctx->rights_id_available && !cur_nca_ctx->titlekey_retrieved)
+            {
+                if (!titlekey_warning_logged) LOG_MSG_WARNING("Unable to retrieve titlekey for %016lX! NCA modifications will be disabled.", title_info->meta_key.id);
+                titlekey_warning_logged = true;
+                continue;
+            }
+
+            /* Set download distribution type. Has no effect if this NCA already uses NcaDistributionType_Download. */
+            if (options.set_download_type) ncaSetDownloadDistributionType(cur_nca_ctx);
+
+            /* Remove titlekey crypto. Has no effect if this NCA doesn't use titlekey crypto. */
+            if (options.remove_titlekey_crypto && !ncaRemoveTitleKeyCrypto(cur_nca_ctx)) return i18n::getStr("tasks/nsp/nca_patch_failed", cur_nca_ctx->content_id_str);
+
+            if (!cur_nca_ctx->fs_ctx[0].has_sparse_layer)
+            {
+                switch(content_info->content_type)
+                {
+                    case NcmContentType_Program:
+                    {
+                        if (program_idx >= program_count) break;
+
+                        ProgramInfoContext *cur_program_info_ctx = &(this->program_info_ctx[program_idx++]);
+
+                        if (!programInfoInitializeContext(cur_program_info_ctx, cur_nca_ctx) || !programInfoGenerateAuthoringToolXml(cur_program_info_ctx))
+                        {
+                            return i18n::getStr("tasks/nsp/authoringtool_data_failed", cur_nca_ctx->content_id_str);
+                        }
+
+                        break;
+                    }
+                    case NcmContentType_Control:
+                    {
+                        if (control_idx >= control_count) break;
+
+                        NacpContext *cur_nacp_ctx = &(this->nacp_ctx[control_idx++]);
+
+                        /* Defer NACP patch generation, if possible. */
+                        if (!this->deferred_nacp_ctx.empty())
+                        {
+                            this->deferred_nacp_ctx[nca_idx] = cur_nacp_ctx;
+                            break;
+                        }
+
+                        if (!nacpInitializeContext(cur_nacp_ctx, cur_nca_ctx) || \
+                            !nacpGenerateNcaPatch(cur_nacp_ctx, options.patch_sua, options.patch_screenshot, options.patch_video_capture, options.patch_hdcp))
+                        {
+                            return i18n::getStr("tasks/nsp/nca_patch_failed", cur_nca_ctx->content_id_str);
+                        }
+
+                        if (options.generate_authoringtool_data && !nacpGenerateAuthoringToolXml(cur_nacp_ctx, title_info->version.value, cnmtGetRequiredTitleVersion(&(this->cnmt_ctx))))
+                        {
+                            return i18n::getStr("tasks/nsp/authoringtool_data_failed", cur_nca_ctx->content_id_str);
+                        }
+
+                        break;
+                    }
+                    case NcmContentType_LegalInformation:
+                    {
+                        if (legal_info_idx >= legal_info_count) break;
+
+                        LegalInfoContext *cur_legal_info_ctx = &(this->legal_info_ctx[legal_info_idx++]);
+
+                        if (!legalInfoInitializeContext(cur_legal_info_ctx, cur_nca_ctx)) return i18n::getStr("tasks/nsp/authoringtool_data_failed", cur_nca_ctx->content_id_str);
+
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            if (!ncaEncryptHeader(cur_nca_ctx)) return i18n::getStr("tasks/nsp/nca_patch_failed", cur_nca_ctx->content_id_str);
+        }
+
+        /* Generate deduplication keys, if needed. NCAs written by previous NSP dumps from the same session can be reused. */
+        if (shared_res)
+        {
+            this->shared_res = shared_res;
+            this->nca_dedup_keys.resize(content_count);
+            for(u32 i = 0; i < (content_count - 1); i++) this->nca_dedup_keys[i] = this->GenerateNcaDedupKey(&(this->nca_ctx[i]));
+        }
+
+        /* Generate the CNMT XML right away, even though we don't have all the data we need yet. We need its size to calculate the full NSP size. */
+        if (options.generate_authoringtool_data && !cnmtGenerateAuthoringToolXml(&(this->cnmt_ctx), this->nca_ctx.data(), content_count))
+        {
+            return i18n::getStr("tasks/nsp/authoringtool_data_failed", meta_nca_ctx->content_id_str);
+        }
+
+        /* Retrieve ticket and certificate chain, if needed. */
+        this->retrieve_tik_cert = (!options.remove_titlekey_crypto && tikIsValidTicket(&(this->tik)));
+        if (this->retrieve_tik_cert)
+        {
+            if (!(tik_common_block = tikGetCommonBlockFromTicket(&(this->tik)))) return "tasks/nsp/ticket_failed"_i18n;
+
+            if (options.remove_console_data && tik_common_block->titlekey_type == TikTitleKeyType_Personalized)
+            {
+                if (!tikConvertPersonalizedTicketToCommonTicket(&(this->tik), &(this->raw_cert_chain), &(this->raw_cert_chain_size))) return "tasks/nsp/ticket_failed"_i18n;
+            } else
+            if (title_info->storage_id == NcmStorageId_GameCard)
+            {
+                this->raw_cert_chain = certRetrieveRawCertificateChainFromGameCardByRightsId(&(tik_common_block->rights_id), &(this->raw_cert_chain_size));
+            } else {
+                this->raw_cert_chain = (shared_res ? shared_res->GetRawCertificateChain(tik_common_block->issuer, &(this->raw_cert_chain_size)) : \
+                                                     certGenerateRawCertificateChainBySignatureIssuer(tik_common_block->issuer, &(this->raw_cert_chain_size)));
+            }
+
+            if (!this->raw_cert_chain) return "tasks/nsp/ticket_failed"_i18n;
+        }
+
+        /* Add NCA entries. */
+        for(NcaContext& cur_nca_ctx : this->nca_ctx)
+        {
+            snprintf(entry_name, sizeof(entry_name), "%s.%s", cur_nca_ctx.content_id_str, cur_nca_ctx.content_type == NcmContentType_Meta ? "cnmt.nca" : "nca");
+            if (!pfsAddEntryInformationToImageContext(&(this->pfs_img_ctx), entry_name, cur_nca_ctx.content_size, nullptr)) return "tasks/nsp/header_failed"_i18n;
+        }
+
+        /* Add AuthoringTool data entries. */
+        if (options.generate_authoringtool_data)
+        {
+            snprintf(entry_name, sizeof(entry_name), "%s.cnmt.xml", meta_nca_ctx->content_id_str);
+            if (!pfsAddEntryInformationToImageContext(&(this->pfs_img_ctx), entry_name, this->cnmt_ctx.authoring_tool_xml_size, &(meta_nca_ctx->content_type_ctx_data_idx)))
+            {
+                return "tasks/nsp/header_failed"_i18n;
+            }
+
+            for(u32 i = 0; i < (content_count - 1); i++)
+            {
+                NcaContext *cur_nca_ctx = &(this->nca_ctx[i]);
+                if (!cur_nca_ctx->content_type_ctx) continue;
+
+                bool ret = false;
+
+                switch(cur_nca_ctx->content_type)
+                {
+                    case NcmContentType_Program:
+                    {
+                        ProgramInfoContext *cur_program_info_ctx = static_cast<ProgramInfoContext*>(cur_nca_ctx->content_type_ctx);
+                        snprintf(entry_name, sizeof(entry_name), "%s.programinfo.xml", cur_nca_ctx->content_id_str);
+                        ret = pfsAddEntryInformationToImageContext(&(this->pfs_img_ctx), entry_name, cur_program_info_ctx->authoring_tool_xml_size, &(cur_nca_ctx->content_type_ctx_data_idx));
+                        break;
+                    }
+                    case NcmContentType_Control:
+                    {
+                        NacpContext *cur_nacp_ctx = static_cast<NacpContext*>(cur_nca_ctx->content_type_ctx);
+                        ret = true;
+
+                        for(u8 k = 0; k < cur_nacp_ctx->icon_count && ret; k++)
+                        {
+                            NacpIconContext *icon_ctx = &(cur_nacp_ctx->icon_ctx[k]);
+                            snprintf(entry_name, sizeof(entry_name), "%s.nx.%s.jpg", cur_nca_ctx->content_id_str, nacpGetLanguageString(icon_ctx->language));
+                            ret = pfsAddEntryInformationToImageContext(&(this->pfs_img_ctx), entry_name, icon_ctx->icon_size, k == 0 ? &(cur_nca_ctx->content_type_ctx_data_idx) : nullptr);
+                        }
+
+                        if (!ret) break;
+
+                        snprintf(entry_name, sizeof(entry_name), "%s.nacp.xml", cur_nca_ctx->content_id_str);
+                        ret = pfsAddEntryInformationToImageContext(&(this->pfs_img_ctx), entry_name, cur_nacp_ctx->authoring_tool_xml_size, \
+                                                                   !cur_nacp_ctx->icon_count ? &(cur_nca_ctx->content_type_ctx_data_idx) : nullptr);
+                        break;
+                    }
+                    case NcmContentType_LegalInformation:
+                    {
+                        LegalInfoContext *cur_legal_info_ctx = static_cast<LegalInfoContext*>(cur_nca_ctx->content_type_ctx);
+                        snprintf(entry_name, sizeof(entry_name), "%s.legalinfo.xml", cur_nca_ctx->content_id_str);
+                        ret = pfsAddEntryInformationToImageContext(&(this->pfs_img_ctx), entry_name, cur_legal_info_ctx->authoring_tool_xml_size, &(cur_nca_ctx->content_type_ctx_data_idx));
+                        break;
+                    }
+                    default:
+                        ret = true;
+                        break;
+                }
+
+                if (!ret) return "tasks/nsp/header_failed"_i18n;
+            }
+        }
+
+        /* Add ticket and certificate chain entries. */
+        if (this->retrieve_tik_cert)
+        {
+            snprintf(entry_name, sizeof(entry_name), "%s.tik", this->tik.rights_id_str);
+            if (!pfsAddEntryInformationToImageContext(&(this->pfs_img_ctx), entry_name, this->tik.size, nullptr)) return "tasks/nsp/header_failed"_i18n;
+
+            snprintf(entry_name, sizeof(entry_name), "%s.cert", this->tik.rights_id_str);
+            if (!pfsAddEntryInformationToImageContext(&(this->pfs_img_ctx), entry_name, this->raw_cert_chain_size, nullptr)) return "tasks/nsp/header_failed"_i18n;
+        }
+
+        /* Generate the placeholder NSP header. Its size won't change, since updated entry names always have the same length. */
+        PartitionFileSystemHeader *pfs_header = &(this->pfs_img_ctx.header);
+        this->nsp_header.resize(sizeof(PartitionFileSystemHeader) + (pfs_header->entry_count * sizeof(PartitionFileSystemEntry)) + pfs_header->name_table_size);
+
+        if (!pfsWriteImageContextHeaderToMemoryBuffer(&(this->pfs_img_ctx), this->nsp_header.data(), this->nsp_header.size(), &nsp_header_size)) return "tasks/nsp/header_failed"_i18n;
+
+        this->nsp_size = (nsp_header_size + this->pfs_img_ctx.fs_size);
+        this->prepared = success = true;
+
+        LOG_MSG_DEBUG("Prepared NSP for %016lX (storage ID %u). Header size: 0x%lX. Full size: 0x%lX.", title_id, storage_id, nsp_header_size, this->nsp_size);
+
+        return {};
+    }
+
+    NspDumpTaskError NspDumper::Dump(const std::string& output_path)
+    {
+        if (!this->prepared) return "tasks/nsp/get_title_info_failed"_i18n;
+
+        u32 content_count = this->title_info->content_count;
+        NcaContext *meta_nca_ctx = &(this->nca_ctx[content_count - 1]);
+        u64 nsp_header_size = this->nsp_header.size();
+
+        Thread patch_thread{}, hash_thread{}, write_thread{};
+
+        /* Don't let anyone call Dump() twice on the same prepared data. */
+        ON_SCOPE_EXIT { this->FreeData(); };
+
+        /* Reset dump buffer ring. */
+        this->ring_stage_cnt.fill(0);
+        this->ring_posted_cnt = 0;
+        this->read_finished = this->pipeline_failed = false;
+        this->pipeline_error.clear();
+
+        ON_SCOPE_EXIT {
+            for(DumpBuffer& dump_buf : this->ring)
+            {
+                if (dump_buf.data) bufferPoolReturn(dump_buf.data);
+                dump_buf = {};
+            }
+        };
+
+        /* Lease memory buffers for the dump process from the shared buffer pool. The ring depth is scaled down under low memory conditions. */
+        /* If we still run out of memory (or hit the in-flight size cap from the pool), just stick to the buffers we already have, as long as there's enough of them to keep the pipeline going. */
+        this->ring_depth = utilsGetBudgetedBufferCount(DumpBufferCount, DumpBufferMinCount);
+
+        for(size_t i = 0; i < this->ring_depth; i++)
+        {
+            DumpBuffer& dump_buf = this->ring[i];
+
+            dump_buf.data = bufferPoolLease(USB_TRANSFER_BUFFER_SIZE, false);
+            if (dump_buf.data) continue;
+
+            if (i < DumpBufferMinCount) return "generic/mem_alloc_failed"_i18n;
+
+            LOG_MSG_WARNING("Failed to allocate dump buffer #%lu! Using %lu buffer(s).", i, i);
+            this->ring_depth = i;
+        }
+
+        if (this->pipeline_stats)
+        {
+            /* The write stage becomes CPU-bound if data sent to the USB host gets compressed. */
+            u32 cpu_bound_stage_mask = DataTransferPipelineStats::DefaultCpuBoundStageMask;
+            if (nxdt::utils::FileWriter::GetStorageTypeByPath(output_path) == nxdt::utils::FileWriter::StorageType::UsbHost && configGetBoolean("usb_compression"))
+            {
+                cpu_bound_stage_mask |= BIT(DataTransferStage_Write);
+            }
+
+            this->UpdatePipelineStats();
+            this->pipeline_stats->Enable(this->ring_depth, BIT(DataTransferStage_Read) | BIT(DataTransferStage_Decrypt) | BIT(DataTransferStage_Hash) | BIT(DataTransferStage_Write), \
+                                         cpu_bound_stage_mask);
+        }
+
+        /* Generate the NSP layout. USB hosts use it to assemble the NSP on their own, writing each NSP file entry straight into its final offset. */
+        /* The NSP header size never changes, even if entry names are updated later on. */
+        std::vector<UsbNspLayoutEntry> nsp_layout{};
+        u32 pfs_entry_count = pfsGetEntryCountFromImageContext(&(this->pfs_img_ctx));
+
+        if (pfs_entry_count < USB_NSP_LAYOUT_MAX_ENTRY_COUNT)
+        {
+            nsp_layout.push_back({ 0, nsp_header_size });
+
+            for(u32 i = 0; i < pfs_entry_count; i++)
+            {
+                PartitionFileSystemEntry *pfs_entry = pfsGetEntryByIndexFromImageContext(&(this->pfs_img_ctx), i);
+                nsp_layout.push_back({ nsp_header_size + pfs_entry->offset, pfs_entry->size });
+            }
+        }
+
+        /* Open output file. */
+        try {
+            /* The NSP header from Prepare() is written right away. If no NCAs get modified, it's already final and it won't have to be rewritten. */
+            this->file = new nxdt::utils::FileWriter(output_path, this->nsp_size, static_cast<u32>(nsp_header_size), 0, this->nsp_header.data(), false, nsp_layout);
+        } catch(const std::string& msg) {
+            LOG_MSG_ERROR("%s", msg.c_str());
+            return msg;
+        }
+
+        ON_SCOPE_EXIT {
+            delete this->file;
+            this->file = nullptr;
+        };
+
+        nxdt::utils::FileWriter::StorageType storage_type = this->file->GetStorageType();
+
+        /* Make sure all pipeline threads are always joined before returning. */
+        ON_SCOPE_EXIT {
+            if (patch_thread.handle == INVALID_HANDLE && hash_thread.handle == INVALID_HANDLE && write_thread.handle == INVALID_HANDLE) return;
+            this->FinishDumpBufferRing();
+            if (patch_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&patch_thread);
+            if (hash_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&hash_thread);
+            if (write_thread.handle != INVALID_HANDLE) threadPlacementJoinThread(&write_thread);
+        };
+
+        /* Create pipeline threads. Each one is placed on the least loaded core for its stage, away from the UI core whenever possible. */
+        u8 write_stage = (storage_type == nxdt::utils::FileWriter::StorageType::UsbHost ? ThreadPlacementStage_Usb : ThreadPlacementStage_Write);
+
+        if (!threadPlacementCreateThread(&patch_thread, NspDumper::PatchThreadFunc, this, ThreadPlacementStage_Decrypt) || \
+            !threadPlacementCreateThread(&hash_thread, NspDumper::HashThreadFunc, this, ThreadPlacementStage_Hash) || \
+            !threadPlacementCreateThread(&write_thread, NspDumper::WriteThreadFunc, this, write_stage)) return "tasks/nsp/thread_create_failed"_i18n;
+
+        /* Move the task thread off the UI core while reading. */
+        ThreadPlacementScope read_scope{};
+        threadPlacementEnterStage(ThreadPlacementStage_Read, &read_scope);
+        ON_SCOPE_EXIT { threadPlacementExitStage(&read_scope); };
+
+        /* Installed NCAs are read using multiple outstanding ncm requests. Regular reads are used if the striped reader can't be created. */
+        NcaStripedReader *striped_reader = (this->title_info->storage_id != NcmStorageId_GameCard ? ncaCreateStripedReader(this->title_info->storage_id) : nullptr);
+        ON_SCOPE_EXIT { ncaFreeStripedReader(striped_reader); };
+
+        /* Read NCAs. The remaining pipeline stages take care of patching, hashing and writing the data we read. */
+        bool pipeline_ok = true;
+
+        for(u32 i = 0; i < content_count && pipeline_ok; i++)
+        {
+            NcaContext *cur_nca_ctx = &(this->nca_ctx[i]);
+
+            if (cur_nca_ctx->content_type == NcmContentType_Meta)
+            {
+                /* The CNMT patch depends on the updated content IDs and hashes from all the other NCAs. */
+                if (!(pipeline_ok = this->WaitForDumpBuffers(DumpStage::Hash))) break;
+
+                if (!cnmtGenerateNcaPatch(&(this->cnmt_ctx)) || !ncaEncryptHeader(cur_nca_ctx)) return i18n::getStr("tasks/nsp/nca_patch_failed", cur_nca_ctx->content_id_str);
+            } else
+            if (!this->deferred_nacp_ctx.empty() && this->deferred_nacp_ctx[i] && !this->GenerateDeferredNacpPatch(cur_nca_ctx, this->deferred_nacp_ctx[i]))
+            {
+                return i18n::getStr("tasks/nsp/nca_patch_failed", cur_nca_ctx->content_id_str);
+            }
+
+            /* Look for a copy of this NCA written by a previous NSP dump from the same session. */
+            /* The USB host copies it by itself, while SD card and UMS device copies are read back instead of reading (and hashing) the original NCA. */
+            NspDumpSharedResources::NcaDedupEntry dedup_entry{};
+            FILE *dedup_fp = nullptr;
+
+            bool dedup = (!this->nca_dedup_keys.empty() && !this->nca_dedup_keys[i].empty() && this->shared_res->GetNcaDedupEntry(this->nca_dedup_keys[i], dedup_entry) && \
+                          dedup_entry.storage_type == storage_type && dedup_entry.size == cur_nca_ctx->content_size && dedup_entry.output_path != output_path);
+
+            if (dedup && storage_type != nxdt::utils::FileWriter::StorageType::UsbHost)
+            {
+                dedup = ((dedup_fp = fopen(dedup_entry.output_path.c_str(), "rb")) && fseek(dedup_fp, static_cast<long>(dedup_entry.offset), SEEK_SET) == 0);
+                if (!dedup && dedup_fp)
+                {
+                    fclose(dedup_fp);
+                    dedup_fp = nullptr;
+                }
+            }
+
+            ON_SCOPE_EXIT { if (dedup_fp) fclose(dedup_fp); };
+
+            if (dedup)
+            {
+                LOG_MSG_DEBUG("Reusing NCA \"%s\" from \"%s\" (offset 0x%lX).", cur_nca_ctx->content_id_str, dedup_entry.output_path.c_str(), dedup_entry.offset);
+
+                /* Keep the hash stage from touching NCA, CNMT and PFS data while we update it. File references must also be sent right after all pending blocks. */
+                if (!(pipeline_ok = this->WaitForDumpBuffers(storage_type == nxdt::utils::FileWriter::StorageType::UsbHost ? DumpStage::Write : DumpStage::Hash))) break;
+
+                memcpy(this->nca_hashes[i].data(), dedup_entry.hash, SHA256_HASH_SIZE);
+
+                if (memcmp(&(dedup_entry.content_id), &(cur_nca_ctx->content_id), sizeof(NcmContentId)) != 0)
+                {
+                    if (auto error = this->UpdateNcaHash(i, dedup_entry.hash)) return error;
+                }
+
+                if (storage_type == nxdt::utils::FileWriter::StorageType::UsbHost)
+                {
+                    const char *entry_name = pfsGetEntryNameByIndexFromImageContext(&(this->pfs_img_ctx), i);
+
+                    if (!this->file->WriteReference(i, entry_name, dedup_entry.output_path, dedup_entry.offset, dedup_entry.size))
+                    {
+                        return i18n::getStr("tasks/nsp/entry_write_failed", entry_name);
+                    }
+
+                    if (this->progress_cb) this->progress_cb(dedup_entry.size);
+
+                    continue;
+                }
+            }
+
+            /* Let the USB host verify this NCA on our behalf if it's never going to be patched. Its hash stays the same as the one from its CNMT content record. */
+            /* Meta NCAs aren't verified at all. The NCA patch state is final at this point. */
+            NcmPackagedContentInfo *packaged_content_info = nullptr;
+
+            bool hash_offload = (!dedup && this->options.offload_hash_verification && storage_type == nxdt::utils::FileWriter::StorageType::UsbHost && \
+                                 cur_nca_ctx->content_type != NcmContentType_Meta && !ncaIsHeaderDirty(cur_nca_ctx) && (packaged_content_info = this->GetPackagedContentInfo(cur_nca_ctx)));
+
+            if (hash_offload) memcpy(this->nca_hashes[i].data(), packaged_content_info->hash, SHA256_HASH_SIZE);
+
+            for(size_t offset = 0, blksize = USB_TRANSFER_BUFFER_SIZE; offset < cur_nca_ctx->content_size; offset += blksize)
+            {
+                /* Don't proceed if the dump has been cancelled. */
+                if (this->IsCancelled()) return {};
+
+                /* Adjust current block size, if needed. */
+                if (blksize > (cur_nca_ctx->content_size - offset)) blksize = (cur_nca_ctx->content_size - offset);
+
+                /* Wait until an empty buffer is available. */
+                DumpBuffer *dump_buf = this->GetDumpBuffer(DumpStage::Read);
+                if (!(pipeline_ok = (dump_buf != nullptr))) break;
+
+                /* Take a snapshot of the PFS entry name. The hash stage may update it before the write stage gets to this NCA. */
+                if (!offset) snprintf(dump_buf->entry_name, sizeof(dump_buf->entry_name), "%s", pfsGetEntryNameByIndexFromImageContext(&(this->pfs_img_ctx), i));
+
+                /* Read current block. */
+                if ((dedup && fread(dump_buf->data, 1, blksize, dedup_fp) != blksize) || (!dedup && !ncaStripedReaderReadContentFile(striped_reader, cur_nca_ctx, dump_buf->data, blksize, offset)))
+                {
+                    return i18n::getStr("tasks/nsp/io_failed", "generic/read"_i18n, blksize, offset, dedup ? dedup_entry.output_path.c_str() : cur_nca_ctx->content_id_str);
+                }
+
+                /* Hand the current block over to the patch stage. */
+                dump_buf->size = blksize;
+                dump_buf->offset = offset;
+                dump_buf->nca_idx = i;
+                dump_buf->dedup = dedup;
+                dump_buf->hash_offload = hash_offload;
+                this->ReleaseDumpBuffer(DumpStage::Read);
+            }
+        }
+
+        /* Wait for the pipeline threads to process all pending blocks. */
+        this->FinishDumpBufferRing();
+        threadPlacementJoinThread(&patch_thread);
+        threadPlacementJoinThread(&hash_thread);
+        threadPlacementJoinThread(&write_thread);
+        threadPlacementExitStage(&read_scope);
+        threadPlacementLogStats();
+
+        /* Don't proceed if the dump has been cancelled. */
+        if (this->IsCancelled()) return {};
+
+        /* Check if any of the pipeline stages failed. */
+        if (this->pipeline_failed) return this->pipeline_error;
+
+        if (this->options.generate_authoringtool_data)
+        {
+            /* Regenerate the CNMT XML, then write it. */
+            if (!cnmtGenerateAuthoringToolXml(&(this->cnmt_ctx), this->nca_ctx.data(), content_count)) return i18n::getStr("tasks/nsp/authoringtool_data_failed", meta_nca_ctx->content_id_str);
+
+            u32 data_idx = meta_nca_ctx->content_type_ctx_data_idx;
+
+            if (!this->WriteEntryData(data_idx, this->cnmt_ctx.authoring_tool_xml, this->cnmt_ctx.authoring_tool_xml_size) || \
+                !pfsUpdateEntryNameFromImageContext(&(this->pfs_img_ctx), data_idx, meta_nca_ctx->content_id_str))
+            {
+                return i18n::getStr("tasks/nsp/entry_write_failed", pfsGetEntryNameByIndexFromImageContext(&(this->pfs_img_ctx), data_idx));
+            }
+
+            /* Write content type context data. */
+            for(u32 i = 0; i < (content_count - 1); i++)
+            {
+                NcaContext *cur_nca_ctx = &(this->nca_ctx[i]);
+                if (!cur_nca_ctx->content_type_ctx) continue;
+
+                char *authoring_tool_xml = nullptr;
+                u64 authoring_tool_xml_size = 0;
+                data_idx = cur_nca_ctx->content_type_ctx_data_idx;
+
+                switch(cur_nca_ctx->content_type)
+                {
+                    case NcmContentType_Program:
+                    {
+                        ProgramInfoContext *cur_program_info_ctx = static_cast<ProgramInfoContext*>(cur_nca_ctx->content_type_ctx);
+                        authoring_tool_xml = cur_program_info_ctx->authoring_tool_xml;
+                        authoring_tool_xml_size = cur_program_info_ctx->authoring_tool_xml_size;
+                        break;
+                    }
+                    case NcmContentType_Control:
+                    {
+                        NacpContext *cur_nacp_ctx = static_cast<NacpContext*>(cur_nca_ctx->content_type_ctx);
+                        authoring_tool_xml = cur_nacp_ctx->authoring_tool_xml;
+                        authoring_tool_xml_size = cur_nacp_ctx->authoring_tool_xml_size;
+
+                        /* Write icons. */
+                        for(u8 k = 0; k < cur_nacp_ctx->icon_count; k++, data_idx++)
+                        {
+                            NacpIconContext *icon_ctx = &(cur_nacp_ctx->icon_ctx[k]);
+
+                            if (!this->WriteEntryData(data_idx, icon_ctx->icon_data, icon_ctx->icon_size) || \
+                                !pfsUpdateEntryNameFromImageContext(&(this->pfs_img_ctx), data_idx, cur_nca_ctx->content_id_str))
+                            {
+                                return i18n::getStr("tasks/nsp/entry_write_failed", pfsGetEntryNameByIndexFromImageContext(&(this->pfs_img_ctx), data_idx));
+                            }
+                        }
+
+                        break;
+                    }
+                    case NcmContentType_LegalInformation:
+                    {
+                        LegalInfoContext *cur_legal_info_ctx = static_cast<LegalInfoContext*>(cur_nca_ctx->content_type_ctx);
+                        authoring_tool_xml = cur_legal_info_ctx->authoring_tool_xml;
+                        authoring_tool_xml_size = cur_legal_info_ctx->authoring_tool_xml_size;
+                        break;
+                    }
+                    default:
+                        break;
+                }
+
+                /* Write XML. */
+                if (!this->WriteEntryData(data_idx, authoring_tool_xml, authoring_tool_xml_size) || \
+                    !pfsUpdateEntryNameFromImageContext(&(this->pfs_img_ctx), data_idx, cur_nca_ctx->content_id_str))
+                {
+                    return i18n::getStr("tasks/nsp/entry_write_failed", pfsGetEntryNameByIndexFromImageContext(&(this->pfs_img_ctx), data_idx));
+                }
+            }
+        }
+
+        /* Write ticket and certificate chain. */
+        if (this->retrieve_tik_cert)
+        {
+            u32 entry_count = pfsGetEntryCountFromImageContext(&(this->pfs_img_ctx));
+
+            if (!this->WriteEntryData(entry_count - 2, this->tik.data, this->tik.size))
+            {
+                return i18n::getStr("tasks/nsp/entry_write_failed", pfsGetEntryNameByIndexFromImageContext(&(this->pfs_img_ctx), entry_count - 2));
+            }
+
+            if (!this->WriteEntryData(entry_count - 1, this->raw_cert_chain, this->raw_cert_chain_size))
+            {
+                return i18n::getStr("tasks/nsp/entry_write_failed", pfsGetEntryNameByIndexFromImageContext(&(this->pfs_img_ctx), entry_count - 1));
+            }
+        }
+
+        /* Write the final NSP header. */
+        if (!pfsWriteImageContextHeaderToMemoryBuffer(&(this->pfs_img_ctx), this->nsp_header.data(), this->nsp_header.size(), &nsp_header_size) || \
+            !this->file->WriteNspHeader(this->nsp_header.data(), static_cast<u32>(nsp_header_size))) return "tasks/nsp/header_failed"_i18n;
+
+        if (this->progress_cb) this->progress_cb(nsp_header_size);
+
+        /* Register all written NCAs, so other NSP dumps from the same session can reuse them. */
+        for(u32 i = 0; i < this->nca_dedup_keys.size(); i++)
+        {
+            if (this->nca_dedup_keys[i].empty()) continue;
+
+            NspDumpSharedResources::NcaDedupEntry dedup_entry{};
+            dedup_entry.output_path = output_path;
+            dedup_entry.storage_type = storage_type;
+            dedup_entry.offset = (nsp_header_size + pfsGetEntryByIndexFromImageContext(&(this->pfs_img_ctx), i)->offset);
+            dedup_entry.size = this->nca_ctx[i].content_size;
+            memcpy(&(dedup_entry.content_id), &(this->nca_ctx[i].content_id), sizeof(NcmContentId));
+            memcpy(dedup_entry.hash, this->nca_hashes[i].data(), SHA256_HASH_SIZE);
+
+            this->shared_res->AddNcaDedupEntry(this->nca_dedup_keys[i], dedup_entry);
+        }
+
+        return {};
+    }
+
+    void NspDumper::PatchThreadFunc(void *arg)
+    {
+        NspDumper *dumper = static_cast<NspDumper*>(arg);
+        DumpBuffer *dump_buf = nullptr;
+
+        Sha256Context clean_sha256_ctx{};
+        bool dirty_header = false, hash_shared = false;
+
+        while((dump_buf = dumper->GetDumpBuffer(DumpStage::Patch)))
+        {
+            NcaContext *cur_nca_ctx = &(dumper->nca_ctx[dump_buf->nca_idx]);
+
+            /* Deduplicated blocks have already been patched and hashed, while offloaded blocks are hashed by the USB host. */
+            if (dump_buf->dedup || dump_buf->hash_offload)
+            {
+                dumper->ReleaseDumpBuffer(DumpStage::Patch);
+                continue;
+            }
+
+            if (!dump_buf->offset)
+            {
+                sha256ContextCreate(&clean_sha256_ctx);
+                dirty_header = ncaIsHeaderDirty(cur_nca_ctx);
+                hash_shared = true;
+            }
+
+            /* Fork the dirty hash calculation right before the first block that may get patched. */
+            /* Both hashes are identical up to this point, so the hash stage doesn't need to process any of the previous blocks. */
+            dump_buf->hash_fork = (hash_shared && dirty_header);
+            if (dump_buf->hash_fork)
+            {
+                memcpy(&(dump_buf->fork_ctx), &clean_sha256_ctx, sizeof(Sha256Context));
+                hash_shared = false;
+            }
+
+            dump_buf->hash_shared = hash_shared;
+
+            /* Update clean hash calculation. It's validated by the hash stage once the whole NCA has been processed. */
+            sha256ContextUpdate(&clean_sha256_ctx, dump_buf->data, dump_buf->size);
+            statsAddCounter(StatsCounterType_Sha256, dump_buf->size);
+            if ((dump_buf->offset + dump_buf->size) >= cur_nca_ctx->content_size) sha256ContextGetHash(&clean_sha256_ctx, dump_buf->clean_hash);
+
+            /* Apply NCA patches. */
+            if (dirty_header)
+            {
+                /* Write re-encrypted headers. */
+                if (!cur_nca_ctx->header_written) ncaWriteEncryptedHeaderDataToMemoryBuffer(cur_nca_ctx, dump_buf->data, dump_buf->size, dump_buf->offset);
+
+                /* Write content type context patch. */
+                if (cur_nca_ctx->content_type_ctx_patch)
+                {
+                    switch(cur_nca_ctx->content_type)
+                    {
+                        case NcmContentType_Meta:
+                            cnmtWriteNcaPatch(&(dumper->cnmt_ctx), dump_buf->data, dump_buf->size, dump_buf->offset);
+                            break;
+                        case NcmContentType_Control:
+                            nacpWriteNcaPatch(static_cast<NacpContext*>(cur_nca_ctx->content_type_ctx), dump_buf->data, dump_buf->size, dump_buf->offset);
+                            break;
+                        default:
+                            break;
+                    }
+                }
+
+                /* Avoid entering this code block if it's not needed anymore. */
+                dirty_header = (!cur_nca_ctx->header_written || cur_nca_ctx->content_type_ctx_patch);
+            }
+
+            /* Hand the current block over to the hash stage. */
+            dumper->ReleaseDumpBuffer(DumpStage::Patch);
+        }
+
+        threadExit();
+    }
+
+    void NspDumper::HashThreadFunc(void *arg)
+    {
+        NspDumper *dumper = static_cast<NspDumper*>(arg);
+        DumpBuffer *dump_buf = nullptr;
+
+        Sha256Context dirty_sha256_ctx{};
+        u8 dirty_sha256_hash[SHA256_HASH_SIZE] = {0};
+
+        while((dump_buf = dumper->GetDumpBuffer(DumpStage::Hash)))
+        {
+            NcaContext *cur_nca_ctx = &(dumper->nca_ctx[dump_buf->nca_idx]);
+
+            /* Deduplicated blocks have already been patched and hashed, while offloaded blocks are hashed by the USB host. */
+            if (dump_buf->dedup || dump_buf->hash_offload)
+            {
+                dumper->ReleaseDumpBuffer(DumpStage::Hash);
+                continue;
+            }
+
+            /* Pick up the clean hash state if the dirty hash calculation was forked on this block. */
+            if (dump_buf->hash_fork) memcpy(&dirty_sha256_ctx, &(dump_buf->fork_ctx), sizeof(Sha256Context));
+
+            /* Update dirty hash calculation. Skip it altogether if no patches have been applied so far. */
+            if (!dump_buf->hash_shared)
+            {
+                sha256ContextUpdate(&dirty_sha256_ctx, dump_buf->data, dump_buf->size);
+                statsAddCounter(StatsCounterType_Sha256, dump_buf->size);
+            }
+
+            if ((dump_buf->offset + dump_buf->size) >= cur_nca_ctx->content_size)
+            {
+                /* Get dirty hash. */
+                if (dump_buf->hash_shared)
+                {
+                    memcpy(dirty_sha256_hash, dump_buf->clean_hash, SHA256_HASH_SIZE);
+                } else {
+                    sha256ContextGetHash(&dirty_sha256_ctx, dirty_sha256_hash);
+                }
+
+                /* Validate clean hash and update NCA / CNMT / PFS data, if needed. */
+                if (auto error = dumper->FinalizeNcaHash(dump_buf->nca_idx, dump_buf->clean_hash, dirty_sha256_hash))
+                {
+                    dumper->FailDumpBufferRing(error.value());
+                    break;
+                }
+            }
+
+            /* Hand the current block over to the write stage. */
+            dumper->ReleaseDumpBuffer(DumpStage::Hash);
+        }
+
+        threadExit();
+    }
+
+    void NspDumper::WriteThreadFunc(void *arg)
+    {
+        NspDumper *dumper = static_cast<NspDumper*>(arg);
+        DumpBuffer *dump_buf = nullptr;
+
+        while((dump_buf = dumper->GetDumpBuffer(DumpStage::Write)))
+        {
+            NcaContext *cur_nca_ctx = &(dumper->nca_ctx[dump_buf->nca_idx]);
+
+            u32 nca_idx = dump_buf->nca_idx;
+            bool hash_offload = dump_buf->hash_offload, last_block = ((dump_buf->offset + dump_buf->size) >= cur_nca_ctx->content_size);
+
+            /* Start each NCA right before its first block, if needed. The USB host calculates the NCA hash on its own if it was offloaded. */
+            if (!dump_buf->offset && !dumper->file->StartNspEntry(nca_idx, dump_buf->entry_name, cur_nca_ctx->content_size, \
+                                                                  hash_offload ? UsbChecksumType_Sha256 : UsbChecksumType_None))
+            {
+                dumper->FailDumpBufferRing(i18n::getStr("tasks/nsp/io_failed", "generic/write"_i18n, dump_buf->size, dump_buf->offset, dump_buf->entry_name));
+                break;
+            }
+
+            /* Hand the current block over to the output file. The ring mutex isn't held here, which lets the other stages process the next blocks in the meantime. */
+            /* USB transfers complete in the background, and the current ring slot is released by WriteCompletionCallback() once they do. */
+            /* The last block from each NCA is always written synchronously, so the ring slot may already be gone once this returns. */
+            if (!dumper->file->WriteAsync(dump_buf->data, dump_buf->size, NspDumper::WriteCompletionCallback, dumper))
+            {
+                dumper->FailDumpBufferRing(i18n::getStr("tasks/nsp/io_failed", "generic/write"_i18n, dump_buf->size, dump_buf->offset, dump_buf->entry_name));
+                break;
+            }
+
+            /* Ask the USB host to verify the whole NCA once its last block has been written. */
+            if (hash_offload && last_block)
+            {
+                bool match = false;
+
+                if (!usbVerifyFileChecksum(UsbChecksumType_Sha256, dumper->nca_hashes[nca_idx].data(), &match))
+                {
+                    dumper->FailDumpBufferRing(i18n::getStr("tasks/nsp/io_failed", "generic/write"_i18n, cur_nca_ctx->content_size, 0, cur_nca_ctx->content_id_str));
+                    break;
+                }
+
+                if (!match)
+                {
+                    dumper->FailDumpBufferRing(i18n::getStr("tasks/nsp/hash_mismatch", cur_nca_ctx->content_id_str));
+                    break;
+                }
+            }
+
+            {
+                std::scoped_lock ring_lock(dumper->ring_mtx);
+                dumper->ring_posted_cnt++;
+            }
+        }
+
+        /* Make sure no ring slot is still in use by a pending USB transfer. */
+        dumper->file->Flush();
+
+        threadExit();
+    }
+
+    void NspDumper::WriteCompletionCallback(void *user_data, bool success)
+    {
+        NspDumper *dumper = static_cast<NspDumper*>(user_data);
+        DumpBuffer *dump_buf = nullptr;
+
+        {
+            /* Writes always complete in order, so this is the oldest ring slot that hasn't been released by the write stage yet. */
+            std::scoped_lock ring_lock(dumper->ring_mtx);
+            dump_buf = &(dumper->ring[dumper->ring_stage_cnt[DumpStage::Write] % dumper->ring_depth]);
+        }
+
+        if (!success)
+        {
+            dumper->FailDumpBufferRing(i18n::getStr("tasks/nsp/io_failed", "generic/write"_i18n, dump_buf->size, dump_buf->offset, dump_buf->entry_name));
+            return;
+        }
+
+        if (dumper->progress_cb) dumper->progress_cb(dump_buf->size);
+
+        /* Release the current buffer. */
+        dumper->ReleaseDumpBuffer(DumpStage::Write);
+    }
+
+    NspDumper::DumpBuffer *NspDumper::GetDumpBuffer(DumpStage stage)
+    {
+        std::unique_lock<std::mutex> ring_lock(this->ring_mtx);
+
+        /* The write stage keeps track of the blocks it handed over to the output file on its own. */
+        size_t& stage_cnt = (stage == DumpStage::Write ? this->ring_posted_cnt : this->ring_stage_cnt[stage]);
+
+        if (stage == DumpStage::Read)
+        {
+            /* A ring slot is only empty once it has been written. */
+            this->ring_cv.wait(ring_lock, [this, &stage_cnt]() { return ((stage_cnt - this->ring_stage_cnt[DumpStage::Write]) < this->ring_depth || this->pipeline_failed); });
+            return (this->pipeline_failed ? nullptr : &(this->ring[stage_cnt % this->ring_depth]));
+        }
+
+        /* Wait until the previous stage is done with the next block, or until the read thread is done. */
+        size_t& prev_stage_cnt = this->ring_stage_cnt[stage - 1];
+        auto pred = [this, &stage_cnt, &prev_stage_cnt]() { return (stage_cnt < prev_stage_cnt || this->read_finished || this->pipeline_failed); };
+
+        if (stage == DumpStage::Write && !pred())
+        {
+            /* Don't wait while asynchronous writes are still pending, since the other stages may be waiting for them to complete. */
+            ring_lock.unlock();
+            this->file->Flush();
+            ring_lock.lock();
+        }
+
+        this->ring_cv.wait(ring_lock, pred);
+
+        /* Bail out if there's nothing left to process. Pending blocks are discarded if the dump was cancelled or if the pipeline failed. */
+        if (stage_cnt >= prev_stage_cnt || this->pipeline_failed || this->IsCancelled()) return nullptr;
+
+        return &(this->ring[stage_cnt % this->ring_depth]);
+    }
+
+    void NspDumper::ReleaseDumpBuffer(DumpStage stage)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+
+            if (this->pipeline_stats)
+            {
+                /* Blocks that skip the patch and hash stages don't count towards their throughput. */
+                DumpBuffer *dump_buf = &(this->ring[this->ring_stage_cnt[stage] % this->ring_depth]);
+                bool skipped = ((stage == DumpStage::Patch || stage == DumpStage::Hash) && (dump_buf->dedup || dump_buf->hash_offload));
+                if (!skipped) this->pipeline_stats->AddStageSize(DumpStageMap[stage], dump_buf->size);
+            }
+
+            this->ring_stage_cnt[stage]++;
+
+            if (this->pipeline_stats) this->UpdatePipelineStats();
+        }
+
+        this->ring_cv.notify_all();
+    }
+
+    void NspDumper::UpdatePipelineStats(void)
+    {
+        /* Empty ring slots count towards the read stage. Blocks that are still being written count towards the write stage. */
+        this->pipeline_stats->SetStageQueued(DumpStageMap[DumpStage::Read], this->ring_depth - (this->ring_stage_cnt[DumpStage::Read] - this->ring_stage_cnt[DumpStage::Write]));
+
+        for(u8 i = DumpStage::Patch; i < DumpStage::Count; i++) this->pipeline_stats->SetStageQueued(DumpStageMap[i], this->ring_stage_cnt[i - 1] - this->ring_stage_cnt[i]);
+    }
+
+    void NspDumper::FinishDumpBufferRing(void)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+            this->read_finished = true;
+        }
+
+        this->ring_cv.notify_all();
+    }
+
+    bool NspDumper::WaitForDumpBuffers(DumpStage stage)
+    {
+        std::unique_lock<std::mutex> ring_lock(this->ring_mtx);
+
+        this->ring_cv.wait(ring_lock, [this, stage]() { return (this->ring_stage_cnt[stage] >= this->ring_stage_cnt[DumpStage::Read] || this->pipeline_failed); });
+
+        return !this->pipeline_failed;
+    }
+
+    void NspDumper::FailDumpBufferRing(const std::string& error_msg)
+    {
+        {
+            std::scoped_lock ring_lock(this->ring_mtx);
+
+            /* Only keep the first error. */
+            if (!this->pipeline_failed) this->pipeline_error = error_msg;
+            this->pipeline_failed = true;
+        }
+
+        this->ring_cv.notify_all();
+    }
+
+    bool NspDumper::WriteEntryData(u32 entry_idx, const void *data, size_t data_size)
+    {
+        if (!this->file->StartNspEntry(entry_idx, pfsGetEntryNameByIndexFromImageContext(&(this->pfs_img_ctx), entry_idx), data_size)) return false;
+
+        if (!this->file->Write(data, data_size)) return false;
+
+        if (this->progress_cb) this->progress_cb(data_size);
+
+        return true;
+    }
+
+    bool NspDumper::GenerateDeferredNacpPatch(NcaContext *cur_nca_ctx, NacpContext *cur_nacp_ctx)
+    {
+        /* The NCA header must be re-encrypted, since the NACP patch updates the FS section hash data. */
+        return (nacpInitializeContext(cur_nacp_ctx, cur_nca_ctx) && \
+                nacpGenerateNcaPatch(cur_nacp_ctx, this->options.patch_sua, this->options.patch_screenshot, this->options.patch_video_capture, this->options.patch_hdcp) && \
+                ncaEncryptHeader(cur_nca_ctx));
+    }
+
+    NspDumpTaskError NspDumper::FinalizeNcaHash(u32 nca_idx, const u8 *clean_hash, const u8 *dirty_hash)
+    {
+        NcaContext *cur_nca_ctx = &(this->nca_ctx[nca_idx]);
+
+        /* Validate clean hash. */
+        if (!cnmtVerifyContentHash(&(this->cnmt_ctx), cur_nca_ctx, clean_hash)) return i18n::getStr("tasks/nsp/hash_mismatch", cur_nca_ctx->content_id_str);
+
+        memcpy(this->nca_hashes[nca_idx].data(), dirty_hash, SHA256_HASH_SIZE);
+
+        if (!memcmp(clean_hash, dirty_hash, SHA256_HASH_SIZE)) return {};
+
+        return this->UpdateNcaHash(nca_idx, dirty_hash);
+    }
+
+    NspDumpTaskError NspDumper::UpdateNcaHash(u32 nca_idx, const u8 *hash)
+    {
+        NcaContext *cur_nca_ctx = &(this->nca_ctx[nca_idx]);
+
+        /* Update content ID and hash. */
+        ncaUpdateContentIdAndHash(cur_nca_ctx, hash);
+
+        /* Update CNMT and PFS entry name. */
+        if (!cnmtUpdateContentInfo(&(this->cnmt_ctx), cur_nca_ctx) || !pfsUpdateEntryNameFromImageContext(&(this->pfs_img_ctx), nca_idx, cur_nca_ctx->content_id_str))
+        {
+            return i18n::getStr("tasks/nsp/nca_patch_failed", cur_nca_ctx->content_id_str);
+        }
+
+        return {};
+    }
+
+    u64 NspDumper::GetGameCardContentOffset(const NcmContentInfo *content_info)
+    {
+        char content_id_str[0x21] = {0}, nca_filename[0x30] = {0};
+        u64 offset = 0;
+
+        if (!content_info) return 0;
+
+        utilsGenerateHexString(content_id_str, sizeof(content_id_str), content_info->content_id.c, sizeof(content_info->content_id.c), false);
+        snprintf(nca_filename, sizeof(nca_filename), "%s.%s", content_id_str, content_info->content_type == NcmContentType_Meta ? "cnmt.nca" : "nca");
+
+        if (!gamecardGetHashFileSystemEntryInfoByName(HashFileSystemPartitionType_Secure, nca_filename, &offset, nullptr)) return 0;
+
+        return offset;
+    }
+
+    NcmPackagedContentInfo *NspDumper::GetPackagedContentInfo(NcaContext *nca_ctx)
+    {
+        for(u16 i = 0; i < this->cnmt_ctx.packaged_header->content_count; i++)
+        {
+            NcmPackagedContentInfo *packaged_content_info = &(this->cnmt_ctx.packaged_content_info[i]);
+            if (!memcmp(&(packaged_content_info->info.content_id), &(nca_ctx->content_id), sizeof(NcmContentId))) return packaged_content_info;
+        }
+
+        return nullptr;
+    }
+
+    std::string NspDumper::GenerateNcaDedupKey(NcaContext *nca_ctx)
+    {
+        char hash_str[SHA256_HASH_STR_SIZE] = {0};
+
+        /* Meta NCAs are always unique, and NACP patches depend on the title they belong to. */
+        if (nca_ctx->content_type == NcmContentType_Meta || (nca_ctx->content_type == NcmContentType_Control && (this->options.patch_sua || this->options.patch_screenshot || \
+            this->options.patch_video_capture || this->options.patch_hdcp))) return {};
+
+        /* Retrieve the original NCA hash. */
+        NcmPackagedContentInfo *packaged_content_info = this->GetPackagedContentInfo(nca_ctx);
+        if (!packaged_content_info) return {};
+
+        utilsGenerateHexString(hash_str, sizeof(hash_str), packaged_content_info->hash, sizeof(packaged_content_info->hash), false);
+
+        /* NCA modifications are disabled if the titlekey couldn't be retrieved. */
+        bool modifiable = (!nca_ctx->rights_id_available || nca_ctx->titlekey_retrieved);
+
+        return fmt::format("{}_{}_{:d}{:d}", hash_str, nca_ctx->content_size, modifiable && this->options.set_download_type, modifiable && this->options.remove_titlekey_crypto);
+    }
+
+    NspDumpTaskError NspDumpTask::DoInBackground(const std::string& output_path, const u8& storage_id, const u64& title_id, const bool& set_download_type, const bool& remove_console_data,
+                                                 const bool& remove_titlekey_crypto, const bool& patch_sua, const bool& patch_screenshot, const bool& patch_video_capture,
+                                                 const bool& patch_hdcp, const bool& generate_authoringtool_data, const bool& offload_hash_verification)
+    {
+        std::scoped_lock lock(this->task_mtx);
+
+        NspDumpOptions options = { set_download_type, remove_console_data, remove_titlekey_crypto, patch_sua, patch_screenshot, patch_video_capture, patch_hdcp, generate_authoringtool_data,
+                                   offload_hash_verification };
+
+        LOG_MSG_DEBUG("Starting dump with parameters:\n- Output path: \"%s\".\n- Storage ID: %u.\n- Title ID: %016lX.\n- Set download distribution type: %u.\n- Remove console data: %u.\n" \
+                      "- Remove titlekey crypto: %u.\n- Disable linked account requirement: %u.\n- Enable screenshots: %u.\n- Enable video capture: %u.\n- Disable HDCP: %u.\n" \
+                      "- Generate AuthoringTool data: %u.\n- Offload hash verification: %u.", output_path.c_str(), storage_id, title_id, set_download_type, remove_console_data, \
+                      remove_titlekey_crypto, patch_sua, patch_screenshot, patch_video_capture, patch_hdcp, generate_authoringtool_data, offload_hash_verification);
+
+        NspDumper dumper([this]() { return this->IsCancelled(); }, [this](size_t size) {
+            /* Push progress onto the class. */
+            this->AddTransferredSize(size);
+        }, this->GetPipelineStats());
+
+        /* Prepare NSP. */
+        if (auto error = dumper.Prepare(storage_id, title_id, options)) return error;
+
+        /* Push progress onto the class. */
+        this->progress.total_size = dumper.GetNspSize();
+        this->progress.xfer_size = 0;
+        this->PublishProgress(this->progress);
+
+        /* Generate NSP. */
+        return dumper.Dump(output_path);
+    }
+}
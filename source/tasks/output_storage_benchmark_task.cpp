@@ -0,0 +1,378 @@
+/*
+ * output_storage_benchmark_task.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <tasks/output_storage_benchmark_task.hpp>
+#include <utils/scope_guard.hpp>
+#include <utils/file_writer.hpp>
+#include <core/usb.h>
+
+namespace i18n = brls::i18n;    /* For getStr(). */
+using namespace i18n::literals; /* For _i18n. */
+
+namespace nxdt::tasks
+{
+    /* Returns the rate for the provided amount of elements processed within 'elapsed' seconds. */
+    static u64 OutputStorageBenchmarkGetRate(size_t count, double elapsed)
+    {
+        return (elapsed > 0.0 ? static_cast<u64>(static_cast<double>(count) / elapsed) : 0);
+    }
+
+    OutputStorageBenchmarkTaskError OutputStorageBenchmarkTask::DoInBackground(const std::string& storage_root)
+    {
+        std::scoped_lock lock(this->task_mtx);
+
+        std::string work_dir = (storage_root + APP_BASE_PATH "benchmark");
+        std::string seq_path = (work_dir + "/sequential.bin"), split_path = (work_dir + "/split.bin");
+        double elapsed = 0.0, write_time = 0.0, read_time = 0.0;
+        u64 free_space = 0;
+        void *buf = nullptr;
+
+        this->result = {};
+        this->split_supported = false;
+
+        /* Only the SD card and UMS volumes can be benchmarked. */
+        nxdt::utils::FileWriter::StorageType storage_type = nxdt::utils::FileWriter::GetStorageTypeByPath(storage_root);
+        std::string target_id = OutputStorageBenchmarkTask::GetTargetId(storage_root);
+        if (storage_type == nxdt::utils::FileWriter::StorageType::UsbHost || target_id.empty()) return "tasks/output_benchmark/unsupported_storage"_i18n;
+
+        /* Split files are always supported by the SD card. UMS volumes only need them if they're not formatted as exFAT or NTFS. */
+        if (storage_type == nxdt::utils::FileWriter::StorageType::UmsDevice)
+        {
+            UsbHsFsDevice ums_device{};
+            if (!usbHsFsGetDeviceByPath(storage_root.c_str(), &ums_device)) return "utils/file_writer/ums_device_info_error"_i18n;
+            this->split_supported = (ums_device.fs_type < UsbHsFsDeviceFileSystemType_exFAT);
+        } else {
+            this->split_supported = true;
+        }
+
+        /* Make sure there's enough free space for the largest temporary file, plus some headroom. */
+        size_t required_size = (std::max(BenchmarkSequentialSize, BenchmarkStormFileCount * BenchmarkStormFileSize) + 0x100000);
+        std::string root_path = (storage_root + "/");
+        if (!utilsGetFileSystemStatsByPath(root_path.c_str(), nullptr, &free_space) || free_space < required_size) return "tasks/output_benchmark/not_enough_free_space"_i18n;
+
+        /* Calculate the total amount of data we're going to write and read back. */
+        this->progress.total_size = ((BenchmarkSequentialSize + (BenchmarkStormFileCount * BenchmarkStormFileSize) + (this->split_supported ? BenchmarkSplitSize : 0)) * 2);
+        this->progress.xfer_size = 0;
+        this->PublishProgress(this->progress);
+
+        /* Lease memory buffer from the shared buffer pool. */
+        buf = bufferPoolLease(USB_TRANSFER_BUFFER_SIZE, false);
+        if (!buf) return "generic/mem_alloc_failed"_i18n;
+
+        ON_SCOPE_EXIT { bufferPoolReturn(buf); };
+
+        /* Remove leftovers from a previous, interrupted run, then make sure all temporary files are deleted before returning. */
+        utilsDeleteDirectoryRecursively(work_dir.c_str());
+
+        ON_SCOPE_EXIT {
+            utilsRemoveConcatenationFile(split_path.c_str());
+            utilsDeleteDirectoryRecursively(work_dir.c_str());
+            if (storage_type == nxdt::utils::FileWriter::StorageType::SdCard) utilsCommitSdCardFileSystemChanges();
+        };
+
+        /* Sequential pass. */
+        OutputStorageBenchmarkTaskError res = this->WriteFile(seq_path, buf, BenchmarkSequentialSize, 0, false, write_time);
+        if (!res.has_value()) res = this->ReadFile(seq_path, buf, BenchmarkSequentialSize, 0, read_time);
+        if (res.has_value() || this->IsCancelled()) return res;
+
+        this->result.seq_write_speed = OutputStorageBenchmarkGetRate(BenchmarkSequentialSize, write_time);
+        this->result.seq_read_speed = OutputStorageBenchmarkGetRate(BenchmarkSequentialSize, read_time);
+
+        remove(seq_path.c_str());
+
+        /* Small file storm pass. All files are written first, then read back in the same order. */
+        write_time = read_time = 0.0;
+
+        for(size_t i = 0; i < BenchmarkStormFileCount; i++)
+        {
+            res = this->WriteFile(fmt::format("{}/storm/{:04d}.bin", work_dir, i), buf, BenchmarkStormFileSize, i + 1, false, elapsed);
+            if (res.has_value() || this->IsCancelled()) return res;
+            write_time += elapsed;
+        }
+
+        for(size_t i = 0; i < BenchmarkStormFileCount; i++)
+        {
+            res = this->ReadFile(fmt::format("{}/storm/{:04d}.bin", work_dir, i), buf, BenchmarkStormFileSize, i + 1, elapsed);
+            if (res.has_value() || this->IsCancelled()) return res;
+            read_time += elapsed;
+        }
+
+        this->result.storm_write_speed = OutputStorageBenchmarkGetRate(BenchmarkStormFileCount * BenchmarkStormFileSize, write_time);
+        this->result.storm_read_speed = OutputStorageBenchmarkGetRate(BenchmarkStormFileCount * BenchmarkStormFileSize, read_time);
+        this->result.storm_files_per_sec = OutputStorageBenchmarkGetRate(BenchmarkStormFileCount, write_time);
+
+        /* Split file pass. UMS part files are read back directly, while SD card concatenation files are handled by the FS sysmodule. */
+        if (this->split_supported)
+        {
+            std::string split_read_path = (storage_type == nxdt::utils::FileWriter::StorageType::UmsDevice ? (split_path + "/00") : split_path);
+
+            res = this->WriteFile(split_path, buf, BenchmarkSplitSize, BenchmarkStormFileCount + 1, true, write_time);
+            if (!res.has_value()) res = this->ReadFile(split_read_path, buf, BenchmarkSplitSize, BenchmarkStormFileCount + 1, read_time);
+            if (res.has_value() || this->IsCancelled()) return res;
+
+            this->result.split_write_speed = OutputStorageBenchmarkGetRate(BenchmarkSplitSize, write_time);
+            this->result.split_read_speed = OutputStorageBenchmarkGetRate(BenchmarkSplitSize, read_time);
+        }
+
+        LOG_MSG_INFO("outbench,target=%s,seq_write=%lu,seq_read=%lu,storm_write=%lu,storm_read=%lu,storm_files_per_sec=%lu,split_write=%lu,split_read=%lu", target_id.c_str(), \
+                     this->result.seq_write_speed, this->result.seq_read_speed, this->result.storm_write_speed, this->result.storm_read_speed, this->result.storm_files_per_sec, \
+                     this->result.split_write_speed, this->result.split_read_speed);
+
+        /* Store benchmark result. */
+        snprintf(this->result.target_id, sizeof(this->result.target_id), "%s", target_id.c_str());
+        this->result.timestamp = static_cast<u64>(time(NULL));
+
+        if (!OutputStorageBenchmarkTask::SaveResult(this->result)) LOG_MSG_WARNING("Failed to store output storage benchmark result for \"%s\"!", target_id.c_str());
+
+        return {};
+    }
+
+    OutputStorageBenchmarkTaskError OutputStorageBenchmarkTask::WriteFile(const std::string& path, void *buf, size_t size, size_t file_idx, bool split, double& elapsed)
+    {
+        nxdt::utils::FileWriter *file = nullptr;
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        /* Open output file. Its parent directory tree is created by FileWriter itself. */
+        try {
+            file = new nxdt::utils::FileWriter(path, size, 0, 0, nullptr, false, {}, split);
+        } catch(const std::string& msg) {
+            LOG_MSG_ERROR("%s", msg.c_str());
+            return msg;
+        }
+
+        ON_SCOPE_EXIT { delete file; };
+
+        for(size_t offset = 0, blksize = USB_TRANSFER_BUFFER_SIZE; offset < size; offset += blksize)
+        {
+            /* Don't proceed if the task has been cancelled. The incomplete file is deleted by FileWriter. */
+            if (this->IsCancelled()) return {};
+
+            /* Adjust current block size, if needed. */
+            if (blksize > (size - offset)) blksize = (size - offset);
+
+            /* Generate and write current block. */
+            OutputStorageBenchmarkTask::FillBlock(static_cast<u8*>(buf), blksize, file_idx, offset);
+            if (!file->Write(buf, blksize)) return i18n::getStr("tasks/output_benchmark/io_failed", "generic/write"_i18n, blksize, offset, path);
+
+            /* Push progress onto the class. */
+            this->AddTransferredSize(blksize);
+        }
+
+        /* Wait for all queued writes. Close() deletes the output file if any of them failed. */
+        bool flushed = file->Flush();
+        file->Close();
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+        if (!flushed) return i18n::getStr("tasks/output_benchmark/io_failed", "generic/write"_i18n, size, 0, path);
+
+        return {};
+    }
+
+    OutputStorageBenchmarkTaskError OutputStorageBenchmarkTask::ReadFile(const std::string& path, void *buf, size_t size, size_t file_idx, double& elapsed)
+    {
+        u8 *read_buf = static_cast<u8*>(buf);
+        std::vector<u8> expected{};
+
+        elapsed = 0.0;
+
+        FILE *fp = fopen(path.c_str(), "rb");
+        if (!fp) return i18n::getStr("tasks/output_benchmark/io_failed", "generic/read"_i18n, size, 0, path);
+
+        ON_SCOPE_EXIT { fclose(fp); };
+
+        /* Disable stdio buffering, so each block is read with a single call. */
+        setvbuf(fp, nullptr, _IONBF, 0);
+
+        expected.resize(std::min(size, static_cast<size_t>(USB_TRANSFER_BUFFER_SIZE)));
+
+        for(size_t offset = 0, blksize = USB_TRANSFER_BUFFER_SIZE; offset < size; offset += blksize)
+        {
+            /* Don't proceed if the task has been cancelled. */
+            if (this->IsCancelled()) return {};
+
+            /* Adjust current block size, if needed. */
+            if (blksize > (size - offset)) blksize = (size - offset);
+
+            /* Read current block. Only the read itself is timed. */
+            auto start_time = std::chrono::steady_clock::now();
+            size_t read_size = fread(read_buf, 1, blksize, fp);
+            elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+            if (read_size != blksize) return i18n::getStr("tasks/output_benchmark/io_failed", "generic/read"_i18n, blksize, offset, path);
+
+            /* Verify current block. */
+            OutputStorageBenchmarkTask::FillBlock(expected.data(), blksize, file_idx, offset);
+            if (memcmp(read_buf, expected.data(), blksize) != 0) return i18n::getStr("tasks/output_benchmark/data_mismatch", path, offset);
+
+            /* Push progress onto the class. */
+            this->AddTransferredSize(blksize);
+        }
+
+        return {};
+    }
+
+    void OutputStorageBenchmarkTask::FillBlock(u8 *buf, size_t size, size_t file_idx, size_t offset)
+    {
+        /* Each 8-byte word holds its own file offset mixed with the file index, so misplaced, stale or truncated data can't go unnoticed. */
+        u64 seed = ((static_cast<u64>(file_idx) << 48) ^ 0x9E3779B97F4A7C15ULL);
+        size_t word_count = (size / sizeof(u64));
+        u64 *words = reinterpret_cast<u64*>(buf);
+
+        for(size_t i = 0; i < word_count; i++) words[i] = (seed ^ static_cast<u64>(offset + (i * sizeof(u64))));
+
+        /* Handle trailing bytes, if there are any. */
+        for(size_t i = (word_count * sizeof(u64)); i < size; i++) buf[i] = static_cast<u8>((offset + i) ^ file_idx);
+    }
+
+    std::string OutputStorageBenchmarkTask::GetTargetId(const std::string& path)
+    {
+        switch(nxdt::utils::FileWriter::GetStorageTypeByPath(path))
+        {
+            case nxdt::utils::FileWriter::StorageType::SdCard:
+            {
+                /* The SD card is identified by its capacity, which is good enough to tell apart different cards used with the same console. */
+                u64 total_size = 0;
+                if (!utilsGetFileSystemStatsByPath(DEVOPTAB_SDMC_DEVICE "/", &total_size, nullptr)) break;
+                return fmt::format("sdmc_{:X}", total_size);
+            }
+            case nxdt::utils::FileWriter::StorageType::UmsDevice:
+            {
+                /* UMS volumes are identified by the USB device properties, since their devoptab device names are assigned in mount order. */
+                UsbHsFsDevice ums_device{};
+                if (!usbHsFsGetDeviceByPath(path.c_str(), &ums_device)) break;
+                return fmt::format("ums_{:04X}_{:04X}_{}_{}_{}", ums_device.vid, ums_device.pid, ums_device.serial_number, ums_device.lun, ums_device.fs_idx);
+            }
+            default:
+                break;
+        }
+
+        return {};
+    }
+
+    bool OutputStorageBenchmarkTask::GetStoredResult(const std::string& path, OutputStorageBenchmarkResult& out)
+    {
+        std::vector<OutputStorageBenchmarkResult> results{};
+
+        std::string target_id = OutputStorageBenchmarkTask::GetTargetId(path);
+        if (target_id.empty() || !OutputStorageBenchmarkTask::LoadResults(results)) return false;
+
+        for(const OutputStorageBenchmarkResult& result : results)
+        {
+            if (target_id != result.target_id) continue;
+            out = result;
+            return true;
+        }
+
+        return false;
+    }
+
+    u64 OutputStorageBenchmarkTask::EstimateWriteTime(const std::string& path, size_t size)
+    {
+        OutputStorageBenchmarkResult result{};
+        if (!size || !OutputStorageBenchmarkTask::GetStoredResult(path, result)) return 0;
+
+        /* Use split file speeds if this dump would be split. The SD card always splits big files, while UMS volumes only do so if split speeds were measured. */
+        u64 speed = ((size > FAT32_FILESIZE_LIMIT && result.split_write_speed) ? result.split_write_speed : result.seq_write_speed);
+        if (!speed) return 0;
+
+        return ((size + speed - 1) / speed);
+    }
+
+    bool OutputStorageBenchmarkTask::LoadResults(std::vector<OutputStorageBenchmarkResult>& out_results)
+    {
+        OutputStorageBenchmarkResultsHeader header{};
+        bool ret = false;
+
+        out_results.clear();
+
+        FILE *fp = fopen(OUTPUT_BENCHMARK_PATH, "rb");
+        if (!fp) return false;
+
+        if (fread(&header, 1, sizeof(OutputStorageBenchmarkResultsHeader), fp) == sizeof(OutputStorageBenchmarkResultsHeader) && header.magic == BenchmarkResultsMagic && \
+            header.version == BenchmarkResultsVersion && header.result_count)
+        {
+            out_results.resize(header.result_count);
+            ret = (fread(out_results.data(), 1, out_results.size() * sizeof(OutputStorageBenchmarkResult), fp) == (out_results.size() * sizeof(OutputStorageBenchmarkResult)));
+        }
+
+        fclose(fp);
+
+        if (!ret)
+        {
+            LOG_MSG_WARNING("Ignoring invalid output storage benchmark file \"" OUTPUT_BENCHMARK_PATH "\".");
+            remove(OUTPUT_BENCHMARK_PATH);
+            out_results.clear();
+            return false;
+        }
+
+        for(OutputStorageBenchmarkResult& result : out_results) result.target_id[sizeof(result.target_id) - 1] = '\0';
+
+        return true;
+    }
+
+    bool OutputStorageBenchmarkTask::SaveResult(const OutputStorageBenchmarkResult& result)
+    {
+        std::vector<OutputStorageBenchmarkResult> results{};
+        OutputStorageBenchmarkResultsHeader header{};
+        bool ret = false;
+
+        /* Replace any previous entry for the same output storage. */
+        OutputStorageBenchmarkTask::LoadResults(results);
+        std::erase_if(results, [&result](const OutputStorageBenchmarkResult& entry) { return !strcmp(entry.target_id, result.target_id); });
+        results.push_back(result);
+
+        header.magic = BenchmarkResultsMagic;
+        header.version = BenchmarkResultsVersion;
+        header.result_count = static_cast<u32>(results.size());
+
+        /* Write results to a temporary file, then replace the current benchmark file. */
+        utilsCreateDirectoryTree(OUTPUT_BENCHMARK_PATH, false);
+
+        FILE *fp = fopen(OUTPUT_BENCHMARK_TMP_PATH, "wb");
+        if (!fp)
+        {
+            LOG_MSG_ERROR("Failed to open \"" OUTPUT_BENCHMARK_TMP_PATH "\" for writing!");
+            return false;
+        }
+
+        ret = (fwrite(&header, 1, sizeof(OutputStorageBenchmarkResultsHeader), fp) == sizeof(OutputStorageBenchmarkResultsHeader) && \
+               fwrite(results.data(), 1, results.size() * sizeof(OutputStorageBenchmarkResult), fp) == (results.size() * sizeof(OutputStorageBenchmarkResult)));
+
+        fclose(fp);
+
+        if (ret)
+        {
+            remove(OUTPUT_BENCHMARK_PATH);
+            rename(OUTPUT_BENCHMARK_TMP_PATH, OUTPUT_BENCHMARK_PATH);
+        } else {
+            LOG_MSG_ERROR("Failed to write output storage benchmark file!");
+            remove(OUTPUT_BENCHMARK_TMP_PATH);
+        }
+
+        /* Commit SD card filesystem changes. */
+        utilsCommitSdCardFileSystemChanges();
+
+        return ret;
+    }
+}
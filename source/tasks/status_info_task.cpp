@@ -66,6 +66,9 @@ namespace nxdt::tasks
             if (addr.s_addr != INADDR_NONE && (ip_addr = inet_ntoa(addr))) snprintf(status_info_data->ip_addr, MAX_ELEMENTS(status_info_data->ip_addr), "%s", ip_addr);
         }
 
+        /* Get I/O and crypto counters. */
+        statsGetSnapshot(&(status_info_data->stats));
+
         /* Fire task event. */
         this->status_info_event.fire(this->status_info_data);
     }
@@ -0,0 +1,155 @@
+/*
+ * thread_pool.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <tasks/thread_pool.hpp>
+
+namespace nxdt::tasks
+{
+    ThreadPool::~ThreadPool()
+    {
+        for(Slot& slot : this->slots)
+        {
+            /* Ask all workers to exit once they're done with the jobs from their queue. */
+            {
+                std::scoped_lock lock(slot.mtx);
+                slot.exit = true;
+            }
+
+            slot.cv.notify_all();
+
+            for(Thread& worker : slot.workers) utilsJoinThread(&worker);
+            slot.workers.clear();
+        }
+    }
+
+    ThreadPool& ThreadPool::GetInstance(void)
+    {
+        static ThreadPool instance;
+        return instance;
+    }
+
+    ThreadPool::Slot *ThreadPool::GetSlot(int cpu_id, ThreadPriority priority)
+    {
+        size_t core_idx = 0, priority_idx = 0;
+
+        if (cpu_id == -2)
+        {
+            core_idx = (CoreSlotCount - 1);
+        } else
+        if (cpu_id >= 0 && cpu_id < static_cast<int>(CoreSlotCount - 1))
+        {
+            core_idx = static_cast<size_t>(cpu_id);
+        } else {
+            return nullptr;
+        }
+
+        switch(priority)
+        {
+            case ThreadPriority::High:
+                priority_idx = 0;
+                break;
+            case ThreadPriority::Normal:
+                priority_idx = 1;
+                break;
+            case ThreadPriority::Low:
+                priority_idx = 2;
+                break;
+            default:
+                return nullptr;
+        }
+
+        return &(this->slots[(core_idx * PrioritySlotCount) + priority_idx]);
+    }
+
+    bool ThreadPool::Enqueue(Job&& job, int cpu_id, ThreadPriority priority)
+    {
+        Slot *slot = this->GetSlot(cpu_id, priority);
+        if (!slot || !job)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            return false;
+        }
+
+        {
+            std::scoped_lock lock(slot->mtx);
+
+            if (slot->exit) return false;
+
+            /* Create a new worker if there aren't enough idle workers to take this job right away. */
+            /* The new worker blocks on the slot mutex until we're done here. */
+            if ((slot->jobs.size() + 1) > slot->idle_count && slot->workers.size() < MaxWorkersPerSlot)
+            {
+                Thread& worker = slot->workers.emplace_back();
+
+                if (!utilsCreateThreadWithPriority(&worker, ThreadPool::WorkerThreadFunc, slot, cpu_id, static_cast<int>(priority)))
+                {
+                    slot->workers.pop_back();
+
+                    /* Only bail out if there are no workers at all. Otherwise, the job will just wait for a busy worker. */
+                    if (slot->workers.empty())
+                    {
+                        LOG_MSG_ERROR("Failed to create worker thread for core %d, priority 0x%X!", cpu_id, static_cast<int>(priority));
+                        return false;
+                    }
+                }
+            }
+
+            slot->jobs.push_back(std::move(job));
+        }
+
+        slot->cv.notify_one();
+
+        return true;
+    }
+
+    void ThreadPool::WorkerThreadFunc(void *arg)
+    {
+        Slot *slot = static_cast<Slot*>(arg);
+
+        /* Keep everything within its own scope -- threadExit() doesn't return, so destructors wouldn't be called otherwise. */
+        {
+            std::unique_lock lock(slot->mtx);
+
+            while(true)
+            {
+                /* Wait for a job. */
+                slot->idle_count++;
+                slot->cv.wait(lock, [slot]() { return (slot->exit || !slot->jobs.empty()); });
+                slot->idle_count--;
+
+                /* Pending jobs are always processed before exiting. */
+                if (slot->jobs.empty()) break;
+
+                Job job = std::move(slot->jobs.front());
+                slot->jobs.pop_front();
+
+                /* Run job without holding the slot mutex. */
+                lock.unlock();
+                job();
+                job = nullptr;
+                lock.lock();
+            }
+        }
+
+        threadExit();
+    }
+}
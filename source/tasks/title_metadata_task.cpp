@@ -52,7 +52,8 @@ namespace nxdt::tasks
     {
         brls::RepeatingTask::run(current_time);
 
-        if (titleIsGameCardInfoUpdated())
+        /* User titles may be updated either by a gamecard status change or by deferred application metadata retrieval. */
+        if (titleIsGameCardInfoUpdated() || titleIsUserTitleInfoUpdated())
         {
             /* Update user metadata array. */
             this->PopulateApplicationMetadataInfo(false);
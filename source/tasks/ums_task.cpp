@@ -25,7 +25,7 @@ using namespace brls::i18n::literals;   /* For _i18n. */
 
 namespace nxdt::tasks
 {
-    UmsTask::UmsTask() : brls::RepeatingTask(REPEATING_TASK_INTERVAL)
+    UmsTask::UmsTask() : brls::RepeatingTask(USER_EVENT_TASK_INTERVAL), ums_waiter(umsGetDeviceInfoUpdateUserEvent())
     {
         brls::RepeatingTask::start();
         LOG_MSG_DEBUG("UMS task started.");
@@ -46,7 +46,10 @@ namespace nxdt::tasks
     {
         brls::RepeatingTask::run(current_time);
 
-        if (umsIsDeviceInfoUpdated())
+        /* Fall back to polling if the waiter thread isn't available. */
+        bool updated = (this->ums_waiter.IsActive() ? this->ums_waiter.Consume() : umsIsDeviceInfoUpdated());
+
+        if (updated)
         {
             LOG_MSG_DEBUG("UMS device info updated.");
             brls::Application::notify("tasks/notifications/ums_device"_i18n);
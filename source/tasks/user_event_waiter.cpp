@@ -0,0 +1,77 @@
+/*
+ * user_event_waiter.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <tasks/user_event_waiter.hpp>
+
+namespace nxdt::tasks
+{
+    UserEventWaiter::UserEventWaiter(UEvent *event) : event(event)
+    {
+        if (!this->event)
+        {
+            LOG_MSG_ERROR("Invalid user event!");
+            return;
+        }
+
+        /* Create exit event. */
+        ueventCreate(&(this->exit_event), true);
+
+        /* Create waiter thread. */
+        this->thread_created = utilsCreateThread(&(this->thread), UserEventWaiter::ThreadFunc, this, 1);
+        if (!this->thread_created) LOG_MSG_ERROR("Failed to create user event waiter thread!");
+    }
+
+    UserEventWaiter::~UserEventWaiter()
+    {
+        if (!this->thread_created) return;
+
+        /* Signal the exit event and wait for the waiter thread to exit. */
+        ueventSignal(&(this->exit_event));
+        utilsJoinThread(&(this->thread));
+    }
+
+    void UserEventWaiter::ThreadFunc(void *arg)
+    {
+        UserEventWaiter *waiter = static_cast<UserEventWaiter*>(arg);
+
+        Result rc = 0;
+        int idx = 0;
+
+        Waiter user_event_waiter = waiterForUEvent(waiter->event);
+        Waiter exit_event_waiter = waiterForUEvent(&(waiter->exit_event));
+
+        while(true)
+        {
+            /* Wait until an event is triggered. */
+            rc = waitMulti(&idx, -1, user_event_waiter, exit_event_waiter);
+            if (R_FAILED(rc)) continue;
+
+            /* Exit event triggered. */
+            if (idx == 1) break;
+
+            /* Latch the event for the UI thread. */
+            waiter->signaled.store(true, std::memory_order_release);
+        }
+
+        threadExit();
+    }
+}
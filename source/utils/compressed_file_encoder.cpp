@@ -0,0 +1,157 @@
+/*
+ * compressed_file_encoder.cpp
+ *
+ * Copyright (c) 2020-2024, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include <utils/compressed_file_encoder.hpp>
+
+namespace nxdt::utils
+{
+    CompressedFileEncoder::CompressedFileEncoder(const size_t& input_size, const u32& block_size) : input_size(input_size), block_size(block_size)
+    {
+        this->block_buf.reserve(this->block_size);
+        this->compressed_buf.resize(this->block_size);
+        this->block_index.reserve(static_cast<size_t>(ALIGN_UP(this->input_size, static_cast<size_t>(this->block_size)) / this->block_size));
+
+        /* Use a heap-allocated LZ4 state instead of LZ4_compress_default(), which places it on the stack. */
+        this->lz4_state = malloc(static_cast<size_t>(LZ4_sizeofState()));
+        if (!this->lz4_state) LOG_MSG_ERROR("Failed to allocate LZ4 compression state!");
+    }
+
+    CompressedFileEncoder::~CompressedFileEncoder()
+    {
+        if (this->lz4_state) free(this->lz4_state);
+    }
+
+    void CompressedFileEncoder::Append(std::vector<u8>& out, const void *data, const size_t& data_size)
+    {
+        const u8 *data_u8 = static_cast<const u8*>(data);
+        out.insert(out.end(), data_u8, data_u8 + data_size);
+        this->output_offset += data_size;
+    }
+
+    bool CompressedFileEncoder::EncodeBlock(const u8 *data, const size_t& data_size, std::vector<u8>& out)
+    {
+        BlockEntry entry{};
+        entry.offset = this->output_offset;
+
+        if (data_size == 1 || !memcmp(data, data + 1, data_size - 1))
+        {
+            /* The whole block is filled with a single byte value. */
+            entry.type = BlockType::Fill;
+            entry.fill_value = data[0];
+        } else {
+            /* Only keep compressed blocks that are actually smaller than the input data. LZ4 bails out as soon as the output buffer is full. */
+            int compressed_size = LZ4_compress_fast_extState(this->lz4_state, reinterpret_cast<const char*>(data), reinterpret_cast<char*>(this->compressed_buf.data()),
+                                                             static_cast<int>(data_size), static_cast<int>(data_size - 1), 1);
+            if (compressed_size > 0)
+            {
+                entry.type = BlockType::Lz4;
+                entry.size = static_cast<u32>(compressed_size);
+                this->Append(out, this->compressed_buf.data(), entry.size);
+            } else {
+                entry.type = BlockType::Stored;
+                entry.size = static_cast<u32>(data_size);
+                this->Append(out, data, entry.size);
+            }
+        }
+
+        this->block_index.push_back(entry);
+
+        return true;
+    }
+
+    bool CompressedFileEncoder::Encode(const void *data, const size_t& data_size, std::vector<u8>& out)
+    {
+        /* Sanity check. */
+        if (!data || !data_size || !this->lz4_state || !this->block_size || (this->input_offset + data_size) > this->input_size) return false;
+
+        const u8 *data_u8 = static_cast<const u8*>(data);
+        size_t remaining = data_size;
+
+        /* Write the container header before anything else. */
+        if (!this->input_offset)
+        {
+            Header header{};
+            header.magic = HeaderMagic;
+            header.version = ContainerVersion;
+            header.block_size = this->block_size;
+            header.block_count = static_cast<u32>(ALIGN_UP(this->input_size, static_cast<size_t>(this->block_size)) / this->block_size);
+            header.uncompressed_size = this->input_size;
+
+            this->Append(out, &header, sizeof(Header));
+        }
+
+        while(remaining)
+        {
+            /* Encode whole blocks straight from the input buffer if there's nothing staged. */
+            if (this->block_buf.empty() && remaining >= this->block_size)
+            {
+                if (!this->EncodeBlock(data_u8, this->block_size, out)) return false;
+                data_u8 += this->block_size;
+                remaining -= this->block_size;
+                continue;
+            }
+
+            /* Stage data until a whole block is available. */
+            size_t stage_size = std::min(remaining, this->block_size - this->block_buf.size());
+            this->block_buf.insert(this->block_buf.end(), data_u8, data_u8 + stage_size);
+            data_u8 += stage_size;
+            remaining -= stage_size;
+
+            if (this->block_buf.size() < this->block_size) continue;
+
+            if (!this->EncodeBlock(this->block_buf.data(), this->block_buf.size(), out)) return false;
+            this->block_buf.clear();
+        }
+
+        this->input_offset += data_size;
+        if (this->input_offset < this->input_size) return true;
+
+        /* Encode the last partial block, if needed. */
+        if (!this->block_buf.empty())
+        {
+            if (!this->EncodeBlock(this->block_buf.data(), this->block_buf.size(), out)) return false;
+            this->block_buf.clear();
+        }
+
+        /* Append block index and footer. */
+        Footer footer{};
+        footer.index_offset = this->output_offset;
+        footer.block_count = static_cast<u32>(this->block_index.size());
+        footer.magic = FooterMagic;
+
+        this->Append(out, this->block_index.data(), this->block_index.size() * sizeof(BlockEntry));
+        this->Append(out, &footer, sizeof(Footer));
+
+        LOG_MSG_DEBUG("Compressed 0x%lX bytes into a 0x%lX-byte long container (%u blocks).", this->input_size, this->output_offset, footer.block_count);
+
+        return true;
+    }
+
+    size_t CompressedFileEncoder::GetMaxContainerSize(const size_t& input_size, const u32& block_size)
+    {
+        if (!block_size) return 0;
+        size_t block_count = (ALIGN_UP(input_size, static_cast<size_t>(block_size)) / block_size);
+        return (sizeof(Header) + input_size + (block_count * sizeof(BlockEntry)) + sizeof(Footer));
+    }
+}
@@ -22,6 +22,7 @@
  */
 
 #include <core/nxdt_utils.h>
+#include <tasks/data_transfer_task.hpp>
 #include <borealis.hpp>
 
 /* Helper macros. */
@@ -92,6 +93,86 @@ namespace nxdt::utils {
     }
 #endif  /* LOG_LEVEL < LOG_LEVEL_NONE */
 
+    /* Saves the state from the active data transfer pipeline, I/O counters and the most recent tracing spans to the SD card. */
+    /* Everything is read without taking any locks, since the crashing thread may be holding any of them. Values from other threads may be slightly out of date. */
+    static void WriteCrashSnapshot(const char *reason)
+    {
+        static const char *stage_names[nxdt::tasks::DataTransferStage_Count] = { "Read", "Decrypt", "Hash", "Write" };
+        static bool snapshot_written = false;
+
+        /* Don't proceed if we crash while writing the snapshot itself. */
+        if (snapshot_written) return;
+        snapshot_written = true;
+
+        FILE *fp = fopen(CRASH_SNAPSHOT_PATH, "w");
+        if (!fp)
+        {
+            LOG_MSG_ERROR("Unable to open \"%s\" for writing! (%d).", CRASH_SNAPSHOT_PATH, errno);
+            return;
+        }
+
+        u64 cur_tick = armGetSystemTick();
+
+        fprintf(fp, "Reason: %s\r\n", reason);
+        fprintf(fp, "Uptime: %lu ms\r\n\r\n", armTicksToNs(cur_tick) / 1000000);
+
+        /* Pipeline stage states. */
+        nxdt::tasks::DataTransferPipelineStats *pipeline_stats = nxdt::tasks::DataTransferPipelineStats::GetActive();
+        size_t buffer_count = (pipeline_stats ? pipeline_stats->GetBufferCount() : 0);
+
+        if (buffer_count)
+        {
+            fprintf(fp, "Pipeline (%lu buffer(s)):\r\n", buffer_count);
+
+            for(u8 i = 0; i < nxdt::tasks::DataTransferStage_Count; i++)
+            {
+                nxdt::tasks::DataTransferStage stage = static_cast<nxdt::tasks::DataTransferStage>(i);
+                if (!pipeline_stats->IsStageEnabled(stage)) continue;
+
+                u64 stage_tick = pipeline_stats->GetStageTick(stage);
+
+                fprintf(fp, "    %s%s: 0x%lX bytes processed, %lu buffer(s) queued, last buffer released %lu ms ago.\r\n", stage_names[i], \
+                        pipeline_stats->IsStageCpuBound(stage) ? " (CPU-bound)" : "", pipeline_stats->GetStageSize(stage), pipeline_stats->GetStageQueued(stage), \
+                        cur_tick > stage_tick ? (armTicksToNs(cur_tick - stage_tick) / 1000000) : 0);
+            }
+        } else {
+            fprintf(fp, "Pipeline: none active.\r\n");
+        }
+
+        /* I/O and crypto counters. */
+        StatsSnapshot stats = {0};
+        statsGetSnapshot(&stats);
+
+        fprintf(fp, "\r\nCounters (%lu ms since last reset):\r\n", stats.elapsed_ns / 1000000);
+
+        for(u8 i = 0; i < StatsCounterType_Count; i++)
+        {
+            const StatsCounter *counter = &(stats.counters[i]);
+            if (counter->call_count) fprintf(fp, "    %s: %lu call(s), 0x%lX bytes.\r\n", statsGetCounterName(i), counter->call_count, counter->byte_count);
+        }
+
+        /* Latency histograms. A high max latency along with a stalled pipeline stage usually points to the culprit. */
+        fprintf(fp, "\r\nLatencies:\r\n");
+
+        for(u8 i = 0; i < StatsLatencyType_Count; i++)
+        {
+            StatsLatencyHistogram histogram = {0};
+            statsGetLatencyHistogram(i, &histogram);
+            if (!histogram.call_count) continue;
+
+            fprintf(fp, "    %s: %lu call(s), %lu us average, %lu us max.\r\n", statsGetLatencyName(i), histogram.call_count, (histogram.total_ns / histogram.call_count) / 1000, \
+                    histogram.max_ns / 1000);
+        }
+
+        fclose(fp);
+        utilsCommitSdCardFileSystemChanges();
+
+        /* Tracing spans, if enabled at build time. */
+        traceWriteCrashTraceFile();
+
+        LOG_MSG_INFO("Saved crash snapshot to \"%s\".", CRASH_SNAPSHOT_PATH);
+    }
+
     static void NX_NORETURN AbortProgramExecution(std::string str)
     {
         if (g_borealisInitialized)
@@ -122,6 +203,9 @@ extern "C" {
         /* Log error. */
         LOG_MSG_ERROR("*** libnx aborted with error code: 0x%X ***", res);
 
+        /* Save crash snapshot. */
+        nxdt::utils::WriteCrashSnapshot(fmt::format("libnx abort (0x{:08X})", res).c_str());
+
         /* Abort program execution. */
         std::string crash_str = (g_borealisInitialized ? i18n::getStr("utils/exception_handler/libnx_abort", res) : fmt::format("Fatal error triggered in libnx!\nError code: 0x{:08X}.", res));
         nxdt::utils::AbortProgramExecution(crash_str);
@@ -222,6 +306,10 @@ extern "C" {
         if (exception_str) free(exception_str);
 #endif  /* LOG_LEVEL < LOG_LEVEL_NONE */
 
+        /* Save crash snapshot. */
+        nxdt::utils::WriteCrashSnapshot((fmt::format("{} (0x{:X}), PC 0x{:X}", error_desc_str, ctx->error_desc, ctx->pc.x) + \
+                                         (IS_HB_ADDR(ctx->pc.x) ? fmt::format(" (BASE + 0x{:X})", ctx->pc.x - info.addr) : "")).c_str());
+
         /* Abort program execution. */
         crash_str = (g_borealisInitialized ? i18n::getStr("utils/exception_handler/exception_triggered", error_desc_str, ctx->error_desc) : \
                                              fmt::format("Fatal exception triggered!\nReason: {} (0x{:X}).", error_desc_str, ctx->error_desc));
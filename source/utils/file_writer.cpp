@@ -19,6 +19,8 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include <utils/file_writer.hpp>
 
 namespace i18n = brls::i18n;    /* For getStr(). */
@@ -26,41 +28,86 @@ using namespace i18n::literals; /* For _i18n. */
 
 namespace nxdt::utils
 {
-    FileWriter::FileWriter(const std::string& output_path, const size_t& total_size, const u32& nsp_header_size) : output_path(output_path), total_size(total_size), nsp_header_size(nsp_header_size)
+    FileWriter::FileWriter(const std::string& output_path, const size_t& total_size, const u32& nsp_header_size, const size_t& resume_offset, const void *nsp_header, const bool& compress,
+                           const std::vector<UsbNspLayoutEntry>& nsp_layout, const bool& force_split) : output_path(output_path),
+                                                                                                      total_size(total_size),
+                                                                                                      nsp_header_size(nsp_header_size)
     {
         const char *output_path_str = this->output_path.c_str();
 
         LOG_MSG_DEBUG("Creating FileWriter object with arguments:\r\n" \
                       "- output_path: \"%s\".\r\n" \
                       "- total_size: 0x%lX.\r\n" \
-                      "- nsp_header_size: 0x%X.", \
-                      output_path_str, total_size, nsp_header_size);
+                      "- nsp_header_size: 0x%X.\r\n" \
+                      "- resume_offset: 0x%lX.\r\n" \
+                      "- compress: %u.\r\n" \
+                      "- force_split: %u.", \
+                      output_path_str, total_size, nsp_header_size, resume_offset, compress, force_split);
 
         /* Determine the storage device based on the input path. */
-        this->storage_type = (this->output_path.starts_with(DEVOPTAB_SDMC_DEVICE) ? StorageType::SdCard  :
-                             (this->output_path.starts_with('/')                  ? StorageType::UsbHost : StorageType::UmsDevice));
+        this->storage_type = FileWriter::GetStorageTypeByPath(this->output_path);
+
+        /* Set up the compressed container encoder, if needed. */
+        /* The final container size isn't known beforehand, so the worst-case container size is used for the free space check, file splitting and preallocation. */
+        /* Preallocated space is trimmed once the file is closed. */
+        if (compress)
+        {
+            if (this->storage_type == StorageType::UsbHost || this->nsp_header_size || resume_offset || !this->total_size) throw "utils/file_writer/compression/unsupported_error"_i18n;
+
+            this->encoder = std::make_unique<CompressedFileEncoder>(this->total_size);
+            this->input_total_size = this->total_size;
+            this->total_size = CompressedFileEncoder::GetMaxContainerSize(this->input_total_size);
+        }
 
         if (this->storage_type != StorageType::UsbHost)
         {
             if (this->storage_type == StorageType::SdCard)
             {
                 /* Always split big files if we're dealing with the SD card. */
-                this->split_file = (this->total_size > FAT32_FILESIZE_LIMIT);
+                this->split_file = (this->total_size > FAT32_FILESIZE_LIMIT || force_split);
             } else {
                 /* Get UMS device info. */
                 UsbHsFsDevice ums_device{};
                 if (!usbHsFsGetDeviceByPath(output_path_str, &ums_device)) throw "utils/file_writer/ums_device_info_error"_i18n;
 
                 /* Determine if we should split the output file based on the UMS device's filesystem type. */
-                this->split_file = (this->total_size > FAT32_FILESIZE_LIMIT && ums_device.fs_type < UsbHsFsDeviceFileSystemType_exFAT);
+                this->split_file = ((this->total_size > FAT32_FILESIZE_LIMIT || force_split) && ums_device.fs_type < UsbHsFsDeviceFileSystemType_exFAT);
 
                 /* Calculate the number of part files we'll need, if applicable. */
                 if (this->split_file) this->split_file_part_cnt = static_cast<u8>(ceil(static_cast<double>(this->total_size) / static_cast<double>(CONCATENATION_FILE_PART_SIZE)));
             }
         }
 
+        /* Keep the NSP layout around if we're sending a NSP to a USB host. */
+        if (this->storage_type == StorageType::UsbHost && this->nsp_header_size && !nsp_layout.empty())
+        {
+            if (nsp_layout.front().offset || nsp_layout.front().size != this->nsp_header_size) throw "utils/file_writer/initial_file/usb_host_error"_i18n;
+            this->nsp_layout = nsp_layout;
+        }
+
         LOG_MSG_DEBUG("storage_type: %d | split_file: %u | split_file_part_cnt: %u", this->storage_type, this->split_file, this->split_file_part_cnt);
 
+        /* Resume a previously created file, if needed. */
+        if (resume_offset)
+        {
+            if (this->nsp_header_size || resume_offset >= this->total_size) throw "utils/file_writer/resume/unsupported_error"_i18n;
+
+            /* Only the remaining data has to fit in the target storage. */
+            this->cur_size = resume_offset;
+            if (auto chk = this->CheckFreeSpace()) throw chk.value();
+
+            if (!this->ResumeInitialFile(resume_offset))
+            {
+                this->CloseCurrentFile();
+                throw (this->storage_type == StorageType::UsbHost ? "utils/file_writer/initial_file/usb_host_error"_i18n : "utils/file_writer/resume/generic_error"_i18n);
+            }
+
+            /* Start background I/O thread. */
+            this->StartIoThread();
+
+            return;
+        }
+
         /* Check free space. */
         if (auto chk = this->CheckFreeSpace()) throw chk.value();
 
@@ -71,29 +118,43 @@ namespace nxdt::utils
             throw (this->storage_type == StorageType::UsbHost ? "utils/file_writer/initial_file/usb_host_error"_i18n : "utils/file_writer/initial_file/generic_error"_i18n);
         }
 
+        /* Start background I/O thread. The NSP header placeholder is staged along with the first data chunk. */
+        this->StartIoThread();
+
         /* Handle NSP header placeholder if a NSP header size was provided. */
         if (this->nsp_header_size)
         {
             if (this->storage_type != StorageType::UsbHost)
             {
-                /* Write placeholder NSP header. */
-                std::vector<u8> zeroes(static_cast<size_t>(this->nsp_header_size), 0);
-                if (!this->Write(zeroes.data(), zeroes.size()))
+                /* Write the initial NSP header, if available. Otherwise, write a zeroed placeholder. */
+                if (nsp_header)
+                {
+                    const u8 *nsp_header_u8 = static_cast<const u8*>(nsp_header);
+                    this->initial_nsp_header.assign(nsp_header_u8, nsp_header_u8 + this->nsp_header_size);
+                } else {
+                    this->initial_nsp_header.resize(static_cast<size_t>(this->nsp_header_size), 0);
+                }
+
+                bool ret = this->Write(this->initial_nsp_header.data(), this->initial_nsp_header.size());
+                if (!nsp_header) this->initial_nsp_header.clear();
+
+                if (!ret)
                 {
-                    zeroes.clear();
                     this->Close(true);
                     throw "utils/file_writer/nsp_header_placeholder_error"_i18n;
                 }
+            } else {
+                /* Manually adjust current file offset. */
+                this->cur_size += this->nsp_header_size;
             }
-
-            /* Manually adjust current file offset. */
-            this->cur_size += this->nsp_header_size;
         }
     }
 
     FileWriter::~FileWriter()
     {
         this->Close();
+
+        if (this->lease_buf) bufferPoolReturn(this->lease_buf);
     }
 
     std::optional<std::string> FileWriter::CheckFreeSpace(void)
@@ -112,11 +173,13 @@ namespace nxdt::utils
         LOG_MSG_DEBUG("Free space in \"%.*s\": 0x%lX.", static_cast<int>(strchr(output_path_str, '/') + 1 - output_path_str), output_path_str, free_space);
 
         /* Perform the actual free space check. */
-        bool ret = (free_space > this->total_size);
+        /* Data that has already been written (e.g. while resuming a file) doesn't need to be taken into account. */
+        size_t needed_size = (this->total_size - this->cur_size);
+        bool ret = (free_space > needed_size);
         if (!ret)
         {
             char needed_size_str[0x40] = {0};
-            utilsGenerateFormattedSizeString(static_cast<double>(this->total_size), needed_size_str, sizeof(needed_size_str));
+            utilsGenerateFormattedSizeString(static_cast<double>(needed_size), needed_size_str, sizeof(needed_size_str));
             return i18n::getStr("utils/file_writer/free_space_check/insufficient_space_error", needed_size_str);
         }
 
@@ -125,6 +188,14 @@ namespace nxdt::utils
 
     void FileWriter::CloseCurrentFile(void)
     {
+        if (this->sd_file_open)
+        {
+            LOG_MSG_DEBUG("Closing current file.");
+            fsFileFlush(&(this->sd_file));
+            fsFileClose(&(this->sd_file));
+            this->sd_file_open = false;
+        }
+
         if (this->fp)
         {
             LOG_MSG_DEBUG("Closing current file.");
@@ -133,6 +204,45 @@ namespace nxdt::utils
         }
     }
 
+    bool FileWriter::OpenSdCardFile(bool resume)
+    {
+        FsFileSystem *sdmc_fs = utilsGetSdCardFileSystemObject();
+        const char *fs_path = (this->output_path.c_str() + strlen(DEVOPTAB_SDMC_DEVICE));
+        Result rc = 0;
+
+        if (!sdmc_fs)
+        {
+            LOG_MSG_ERROR("Failed to retrieve SD card filesystem object!");
+            return false;
+        }
+
+        /* Replace any existing file (or concatenation file), just like fopen() does under "wb" mode. Concatenation files for split dumps have already been created by CreateInitialFile(). */
+        if (!resume && !this->split_file)
+        {
+            utilsRemoveConcatenationFile(this->output_path.c_str());
+
+            rc = fsFsCreateFile(sdmc_fs, fs_path, 0, 0);
+            if (R_FAILED(rc))
+            {
+                LOG_MSG_ERROR("fsFsCreateFile failed for \"%s\"! (0x%X).", fs_path, rc);
+                return false;
+            }
+        }
+
+        /* Appending is still allowed in case the file can't be preallocated. */
+        rc = fsFsOpenFile(sdmc_fs, fs_path, FsOpenMode_Write | FsOpenMode_Append, &(this->sd_file));
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_ERROR("fsFsOpenFile failed for \"%s\"! (0x%X).", fs_path, rc);
+            return false;
+        }
+
+        this->sd_file_open = true;
+        this->sd_file_offset = 0;
+
+        return true;
+    }
+
     bool FileWriter::OpenNextFile(void)
     {
         /* Return immediately if: */
@@ -149,32 +259,42 @@ namespace nxdt::utils
         /* Close current file. */
         this->CloseCurrentFile();
 
-        if (this->storage_type == StorageType::SdCard || !this->split_file)
+        if (this->storage_type == StorageType::SdCard)
         {
-            /* Open file using the provided output path, but only if we're dealing with the SD card or if we're not dealing with a split file. */
-            const char *output_path_str = this->output_path.c_str();
-            LOG_MSG_DEBUG("Opening output file: \"%s\".", output_path_str);
-            this->fp = fopen(output_path_str, "wb");
+            /* Open file using the SD card filesystem object. This skips newlib and the fsdev devoptab layer altogether. */
+            LOG_MSG_DEBUG("Opening output file: \"%s\".", this->output_path.c_str());
+            if (!this->OpenSdCardFile(false)) return false;
         } else {
-            /* Open next part file using our stored part file index. */
-            std::string part_file_path = fmt::format("{}/{:02d}", this->output_path, this->split_file_part_idx);
-            LOG_MSG_DEBUG("Opening next part file: \"%s\".", part_file_path.c_str());
-            this->fp = fopen(part_file_path.c_str(), "wb");
-            if (this->fp)
+            if (!this->split_file)
             {
-                /* Update part file index. */
-                this->split_file_part_idx++;
+                /* Open file using the provided output path, but only if we're not dealing with a split file. */
+                const char *output_path_str = this->output_path.c_str();
+                LOG_MSG_DEBUG("Opening output file: \"%s\".", output_path_str);
+                this->fp = fopen(output_path_str, "wb");
+            } else {
+                /* Open next part file using our stored part file index. */
+                std::string part_file_path = fmt::format("{}/{:02d}", this->output_path, this->split_file_part_idx);
+                LOG_MSG_DEBUG("Opening next part file: \"%s\".", part_file_path.c_str());
+                this->fp = fopen(part_file_path.c_str(), "wb");
+                if (this->fp)
+                {
+                    /* Update part file index. */
+                    this->split_file_part_idx++;
 
-                /* Reset part file size. */
-                this->split_file_part_size = 0;
+                    /* Reset part file size. */
+                    this->split_file_part_size = 0;
+                }
             }
-        }
 
-        /* Return immediately if we couldn't open the file in creation mode. */
-        if (!this->fp)
-        {
-            LOG_MSG_ERROR("fopen() failed! (%d).", errno);
-            return false;
+            /* Return immediately if we couldn't open the file in creation mode. */
+            if (!this->fp)
+            {
+                LOG_MSG_ERROR("fopen() failed! (%d).", errno);
+                return false;
+            }
+
+            /* Disable file stream buffering. */
+            setvbuf(this->fp, nullptr, _IONBF, 0);
         }
 
         /* Close file and return immediately if we're dealing with an empty file. */
@@ -184,12 +304,46 @@ namespace nxdt::utils
             return true;
         }
 
-        /* Disable file stream buffering. */
-        setvbuf(this->fp, nullptr, _IONBF, 0);
+        /* Preallocate the new file. */
+        this->PreallocateCurrentFile();
 
         return true;
     }
 
+    void FileWriter::PreallocateCurrentFile(void)
+    {
+        size_t file_size = this->total_size;
+
+        /* Part files hold up to CONCATENATION_FILE_PART_SIZE bytes each. The part file index always points to the next part file. */
+        if (this->storage_type == StorageType::UmsDevice && this->split_file)
+        {
+            size_t part_offset = (static_cast<size_t>(this->split_file_part_idx - 1) * CONCATENATION_FILE_PART_SIZE);
+            file_size = std::min(this->total_size - part_offset, static_cast<size_t>(CONCATENATION_FILE_PART_SIZE));
+        }
+
+        /* Grab the whole cluster chain right away instead of growing it with each write. The file pointer isn't moved. */
+        /* Concatenation files on the SD card are transparently handled by FS, while ftruncate() is handled by the FS driver on UMS devices. */
+        /* Best effort: data is still appended to the file if this fails. */
+        if (!this->IsCurrentFileOpen() || !file_size) return;
+
+        if (this->storage_type == StorageType::SdCard)
+        {
+            Result rc = fsFileSetSize(&(this->sd_file), static_cast<s64>(file_size));
+            if (R_FAILED(rc))
+            {
+                LOG_MSG_WARNING("fsFileSetSize failed to preallocate 0x%lX bytes for the current output file! (0x%X).", file_size, rc);
+                return;
+            }
+        } else
+        if (ftruncate(fileno(this->fp), static_cast<off_t>(file_size)) != 0)
+        {
+            LOG_MSG_WARNING("Failed to preallocate 0x%lX bytes for the current output file! (%d).", file_size, errno);
+            return;
+        }
+
+        LOG_MSG_DEBUG("Preallocated 0x%lX bytes for the current output file.", file_size);
+    }
+
     bool FileWriter::CreateInitialFile(void)
     {
         /* Don't proceed if the file has already been created. */
@@ -199,10 +353,24 @@ namespace nxdt::utils
 
         if (this->storage_type == StorageType::UsbHost)
         {
+            /* Compare regular files against a previous dump held by the USB host, if the user asked us to. */
+            this->usb_delta = (!this->nsp_header_size && this->total_size && configGetBoolean("usb_delta_transfer"));
+            if (this->usb_delta)
+            {
+                LOG_MSG_DEBUG("Starting file delta transfer with USB host...");
+                if (!usbStartFileDelta(this->total_size, output_path_str)) return false;
+
+                /* Update flag. */
+                this->file_created = true;
+
+                return true;
+            }
+
             /* Send file properties to USB host. */
             LOG_MSG_DEBUG("Sending file properties to USB host...");
             if ((!this->nsp_header_size && !usbSendFileProperties(this->total_size, output_path_str)) ||
-                (this->nsp_header_size && !usbSendNspProperties(this->total_size, output_path_str, this->nsp_header_size))) return false;
+                (this->nsp_header_size && this->nsp_layout.empty() && !usbSendNspProperties(this->total_size, output_path_str, this->nsp_header_size)) ||
+                (!this->nsp_layout.empty() && !usbStartNspLayout(this->total_size, output_path_str, this->nsp_layout.data(), static_cast<u32>(this->nsp_layout.size())))) return false;
         } else {
             /* Create directory tree. */
             /* We'll only create a directory for the last path element if we're dealing with a split file in a FAT-formatted UMS volume. */
@@ -226,70 +394,605 @@ namespace nxdt::utils
         return true;
     }
 
-    bool FileWriter::Write(const void *data, const size_t& data_size)
+    bool FileWriter::ResumeInitialFile(const size_t& resume_offset)
     {
-        /* Sanity check. */
-        if (!data || !data_size || !this->file_created || this->cur_size >= this->total_size || (this->storage_type != StorageType::UsbHost && !this->fp)) return false;
+        size_t file_offset = resume_offset;
 
-        /* Make sure we don't write past the established file size. */
-        size_t write_size = ((this->cur_size + data_size) > this->total_size ? (this->total_size - this->cur_size) : data_size);
+        if (this->storage_type == StorageType::UsbHost)
+        {
+            /* Make the USB host keep the data it already holds. */
+            LOG_MSG_DEBUG("Sending file properties to USB host (resume offset 0x%lX)...", resume_offset);
+            if (!usbSendFilePropertiesWithResumeOffset(this->total_size, this->output_path.c_str(), resume_offset)) return false;
+
+            /* Update flag. */
+            this->file_created = true;
+
+            return true;
+        }
+
+        if (this->storage_type == StorageType::SdCard)
+        {
+            /* Reopen the output file. Concatenation files are transparently handled by FS. */
+            LOG_MSG_DEBUG("Reopening output file: \"%s\".", this->output_path.c_str());
+            if (!this->OpenSdCardFile(true)) return false;
+
+            /* Make sure the file actually holds enough data. */
+            s64 file_size = 0;
+            Result rc = fsFileGetSize(&(this->sd_file), &file_size);
+            if (R_FAILED(rc) || static_cast<size_t>(file_size) < file_offset)
+            {
+                LOG_MSG_ERROR("Unable to seek to offset 0x%lX within the output file! (0x%X).", file_offset, rc);
+                return false;
+            }
+
+            this->sd_file_offset = file_offset;
+        } else {
+            if (this->storage_type == StorageType::UmsDevice && this->split_file)
+            {
+                /* Reopen the part file that holds the last byte written so far. Write() takes care of switching to the next part file if this one is already full. */
+                this->split_file_part_idx = static_cast<u8>((resume_offset - 1) / CONCATENATION_FILE_PART_SIZE);
+                this->split_file_part_size = file_offset = (resume_offset - (static_cast<size_t>(this->split_file_part_idx) * CONCATENATION_FILE_PART_SIZE));
+
+                std::string part_file_path = fmt::format("{}/{:02d}", this->output_path, this->split_file_part_idx);
+                LOG_MSG_DEBUG("Reopening part file: \"%s\".", part_file_path.c_str());
+                this->fp = fopen(part_file_path.c_str(), "rb+");
+                if (this->fp) this->split_file_part_idx++;
+            } else {
+                /* Reopen the output file. */
+                const char *output_path_str = this->output_path.c_str();
+                LOG_MSG_DEBUG("Reopening output file: \"%s\".", output_path_str);
+                this->fp = fopen(output_path_str, "rb+");
+            }
+
+            if (!this->fp)
+            {
+                LOG_MSG_ERROR("fopen() failed! (%d).", errno);
+                return false;
+            }
+
+            /* Disable file stream buffering. */
+            setvbuf(this->fp, nullptr, _IONBF, 0);
 
+            /* Make sure the file actually holds enough data, then seek to the resume offset. */
+            if (fseek(this->fp, 0, SEEK_END) != 0 || static_cast<size_t>(ftell(this->fp)) < file_offset || fseek(this->fp, static_cast<long>(file_offset), SEEK_SET) != 0)
+            {
+                LOG_MSG_ERROR("Unable to seek to offset 0x%lX within the output file!", file_offset);
+                return false;
+            }
+        }
+
+        /* Extend the file to its final size, if needed. */
+        this->PreallocateCurrentFile();
+
+        /* Update flag. */
+        this->file_created = true;
+
+        return true;
+    }
+
+    bool FileWriter::WriteData(const void *data, const size_t& data_size, const size_t& offset)
+    {
         if (this->storage_type == StorageType::UmsDevice && this->split_file)
         {
             /* Switch to the next part file if we need to. */
             if (this->split_file_part_size >= CONCATENATION_FILE_PART_SIZE && !this->OpenNextFile()) return false;
 
             /* Make sure we don't write past the part file size limit. */
-            size_t part_file_write_size = ((this->split_file_part_size + write_size) > CONCATENATION_FILE_PART_SIZE ? (CONCATENATION_FILE_PART_SIZE - this->split_file_part_size) : write_size);
+            size_t part_file_write_size = ((this->split_file_part_size + data_size) > CONCATENATION_FILE_PART_SIZE ? (CONCATENATION_FILE_PART_SIZE - this->split_file_part_size) : data_size);
 
             /* Write data to current part file. */
-            size_t n = fwrite(data, 1, part_file_write_size, this->fp);
-            if (n != part_file_write_size)
+            if (!this->WriteFileStream(data, part_file_write_size))
             {
                 LOG_MSG_ERROR("fwrite() failed to write 0x%lX-byte long block at offset 0x%lX to part file #%u (absolute offset 0x%lX).",
-                              part_file_write_size, this->split_file_part_size, this->split_file_part_idx - 1, this->cur_size);
+                              part_file_write_size, this->split_file_part_size, this->split_file_part_idx - 1, offset);
                 return false;
             }
 
             /* Update part file size. */
             this->split_file_part_size += part_file_write_size;
 
-            /* Update the written data size. */
-            this->cur_size += part_file_write_size;
-
             /* Write the rest of the data to the next part file if we need to. */
-            if (part_file_write_size < write_size && !this->Write(static_cast<const u8*>(data) + part_file_write_size, write_size - part_file_write_size)) return false;
+            if (part_file_write_size < data_size && !this->WriteData(static_cast<const u8*>(data) + part_file_write_size, data_size - part_file_write_size, \
+                                                                     offset + part_file_write_size)) return false;
         } else {
             if (this->storage_type == StorageType::UsbHost)
             {
                 /* Send data to USB host. */
-                if (!usbSendFileData(data, write_size))
+                if (this->usb_delta ? !this->WriteDeltaData(data, data_size) : !usbSendFileData(data, data_size))
                 {
-                    LOG_MSG_ERROR("Failed to send 0x%lX-byte long block at offset 0x%lX to USB host.", write_size, this->cur_size);
+                    LOG_MSG_ERROR("Failed to send 0x%lX-byte long block at offset 0x%lX to USB host.", data_size, offset);
                     return false;
                 }
+            } else
+            if (this->storage_type == StorageType::SdCard)
+            {
+                /* Write data to output file. Data is flushed once the file is closed. */
+                statsAddCounter(StatsCounterType_SdCardWrite, data_size);
+                Result rc = fsFileWrite(&(this->sd_file), static_cast<s64>(this->sd_file_offset), data, data_size, FsWriteOption_None);
+                if (R_FAILED(rc))
+                {
+                    LOG_MSG_ERROR("fsFileWrite failed to write 0x%lX-byte long block at offset 0x%lX to output file! (0x%X).", data_size, offset, rc);
+                    return false;
+                }
+
+                this->sd_file_offset += data_size;
             } else {
                 /* Write data to output file. */
-                size_t n = fwrite(data, 1, write_size, this->fp);
-                if (n != write_size)
+                if (!this->WriteFileStream(data, data_size))
                 {
-                    LOG_MSG_ERROR("fwrite() failed to write 0x%lX-byte long block at offset 0x%lX to output file.", write_size, this->cur_size);
+                    LOG_MSG_ERROR("fwrite() failed to write 0x%lX-byte long block at offset 0x%lX to output file.", data_size, offset);
                     return false;
                 }
             }
+        }
+
+        return true;
+    }
+
+    bool FileWriter::WriteDeltaData(const void *data, const size_t& data_size)
+    {
+        const u8 *data_u8 = static_cast<const u8*>(data);
+        size_t remaining_size = data_size;
+
+        while(remaining_size)
+        {
+            /* Batches are always full, except for the last one. */
+            size_t batch_size = std::min(static_cast<size_t>(USB_FILE_DELTA_BATCH_SIZE), this->total_size - this->usb_delta_offset);
+            if (this->usb_delta_buf.capacity() < batch_size) this->usb_delta_buf.reserve(batch_size);
+
+            size_t copy_size = std::min(remaining_size, batch_size - this->usb_delta_buf.size());
+            this->usb_delta_buf.insert(this->usb_delta_buf.end(), data_u8, data_u8 + copy_size);
+
+            data_u8 += copy_size;
+            remaining_size -= copy_size;
+
+            if (this->usb_delta_buf.size() < batch_size) break;
+
+            if (!this->SendDeltaBatch()) return false;
+
+            this->usb_delta_offset += batch_size;
+            this->usb_delta_buf.clear();
+        }
+
+        /* Disable file delta mode as soon as the last batch has been processed. */
+        if (this->usb_delta_offset >= this->total_size)
+        {
+            this->usb_delta = false;
+            if (!usbEndFileDelta()) return false;
+
+            LOG_MSG_INFO("File delta transfer complete (0x%lX out of 0x%lX bytes sent).", this->usb_delta_sent_size, this->total_size);
+        }
+
+        return true;
+    }
+
+    bool FileWriter::SendDeltaBatch(void)
+    {
+        u8 host_hashes[USB_FILE_DELTA_HASH_BATCH_COUNT * SHA256_HASH_SIZE] = {0}, local_hashes[USB_FILE_DELTA_HASH_BATCH_COUNT * SHA256_HASH_SIZE] = {0};
+
+        const u8 *batch_data = this->usb_delta_buf.data();
+        size_t batch_size = this->usb_delta_buf.size();
+        u32 block_count = static_cast<u32>(ALIGN_UP(batch_size, USB_FILE_DELTA_BLOCK_SIZE) / USB_FILE_DELTA_BLOCK_SIZE);
+
+        /* Retrieve checksums from the USB host, then calculate our own while blocks are still hot in the cache. */
+        if (!usbGetFileDeltaHashes(this->usb_delta_offset / USB_FILE_DELTA_BLOCK_SIZE, block_count, host_hashes))
+        {
+            LOG_MSG_ERROR("Failed to retrieve block checksums at offset 0x%lX from USB host.", this->usb_delta_offset);
+            return false;
+        }
+
+        sha256CalculateBlockHashes(local_hashes, batch_data, batch_size, USB_FILE_DELTA_BLOCK_SIZE);
+
+        /* Send runs of consecutive mismatching blocks using a single data transfer stage each. */
+        for(u32 i = 0; i < block_count;)
+        {
+            if (!memcmp(host_hashes + (i * SHA256_HASH_SIZE), local_hashes + (i * SHA256_HASH_SIZE), SHA256_HASH_SIZE))
+            {
+                i++;
+                continue;
+            }
+
+            u32 run_start = i;
+            while(i < block_count && memcmp(host_hashes + (i * SHA256_HASH_SIZE), local_hashes + (i * SHA256_HASH_SIZE), SHA256_HASH_SIZE) != 0) i++;
+
+            size_t run_offset = (static_cast<size_t>(run_start) * USB_FILE_DELTA_BLOCK_SIZE);
+            size_t run_size = (std::min(static_cast<size_t>(i) * USB_FILE_DELTA_BLOCK_SIZE, batch_size) - run_offset);
+
+            if (!usbSendFileDeltaData(this->usb_delta_offset + run_offset, run_size) || !usbSendFileData(batch_data + run_offset, run_size))
+            {
+                LOG_MSG_ERROR("Failed to send 0x%lX-byte long delta block at offset 0x%lX to USB host.", run_size, this->usb_delta_offset + run_offset);
+                return false;
+            }
+
+            this->usb_delta_sent_size += run_size;
+        }
+
+        return true;
+    }
+
+    bool FileWriter::WriteFileStream(const void *data, const size_t& data_size)
+    {
+        const u8 *data_u8 = static_cast<const u8*>(data);
+        size_t block_size = (this->write_block_size ? this->write_block_size : data_size);
+
+        for(size_t offset = 0; offset < data_size; offset += block_size)
+        {
+            size_t cur_size = ((data_size - offset) > block_size ? block_size : (data_size - offset));
+            statsAddCounter(StatsCounterType_UmsWrite, cur_size);
+            if (fwrite(data_u8 + offset, 1, cur_size, this->fp) != cur_size) return false;
+        }
+
+        return true;
+    }
+
+    void FileWriter::StartIoThread(void)
+    {
+        if (this->storage_type == StorageType::UsbHost || !this->total_size || this->io_thread.handle != INVALID_HANDLE) return;
+
+        this->queue_exit = false;
+
+        /* Merge queued writes into batches aligned to the cluster size from the target filesystem, if available. */
+        /* Huge clusters are capped, since up to a cluster worth of data may be kept staged at any given time. */
+        u64 cluster_size = 0;
+        if (utilsGetFileSystemClusterSizeByPath(this->output_path.c_str(), &cluster_size)) this->cluster_size = static_cast<size_t>(MIN(cluster_size, USB_TRANSFER_BUFFER_SIZE));
+        /* Use the speed probe profile from the UMS device, if available. Write blocks must still cover whole clusters. */
+        UmsDeviceProfile ums_profile{};
+        if (this->storage_type == StorageType::UmsDevice && umsGetDeviceProfileByPath(this->output_path.c_str(), &ums_profile))
+        {
+            this->write_block_size = ALIGN_UP(static_cast<size_t>(ums_profile.block_size), this->cluster_size);
+            this->queue_max_size = std::clamp(this->write_block_size * ums_profile.queue_depth, WriteQueueMaxSize, WriteQueueMaxSizeLimit);
+        }
+
+        /* Keep less data queued under low memory conditions. A single write request is always accepted if the queue is empty. */
+        this->queue_max_size = static_cast<size_t>(utilsGetBudgetedBufferSize(this->queue_max_size, USB_TRANSFER_BUFFER_SIZE));
+
+        LOG_MSG_DEBUG("Write granularity: 0x%lX | Write block size: 0x%lX | Queue size: 0x%lX.", this->cluster_size, this->write_block_size, this->queue_max_size);
+
+        /* The I/O thread spends most of its time blocked on fwrite() calls, so it's placed as a lightweight write stage. */
+        if (!threadPlacementCreateThread(&(this->io_thread), FileWriter::IoThreadFunc, this, ThreadPlacementStage_Write)) LOG_MSG_WARNING("Failed to create I/O thread! Writes will be carried out synchronously.");
+    }
+
+    void FileWriter::StopIoThread(void)
+    {
+        if (this->io_thread.handle == INVALID_HANDLE) return;
+
+        /* Queue whatever is left. Errors are recorded by the I/O thread. */
+        this->QueueStagedData(true);
+
+        {
+            std::scoped_lock queue_lock(this->queue_mtx);
+            this->queue_exit = true;
+        }
+
+        this->queue_cv.notify_all();
+
+        threadPlacementJoinThread(&(this->io_thread));
+
+        /* Free spare and staging buffers. */
+        this->queue_spare_bufs.clear();
+        this->staging = WriteRequest{};
+    }
+
+    bool FileWriter::QueueStagedData(bool all)
+    {
+        size_t staged_size = this->staging.data.size();
+        if (!staged_size) return true;
+
+        /* Cluster boundaries are calculated using absolute file offsets. Data that doesn't reach one is kept staged. */
+        size_t end_offset = (this->staging.offset + staged_size);
+        size_t queue_end_offset = (all ? end_offset : (end_offset - (end_offset % this->cluster_size)));
+        if (queue_end_offset <= this->staging.offset) return true;
+
+        WriteRequest request = std::move(this->staging);
+        size_t request_size = (queue_end_offset - request.offset);
+
+        this->staging = WriteRequest{};
+
+        if (request_size < staged_size)
+        {
+            /* Move the trailing partial cluster to a new staging buffer. */
+            {
+                std::scoped_lock queue_lock(this->queue_mtx);
+                this->staging.data = this->GetSpareBuffer();
+            }
+
+            this->staging.data.assign(request.data.begin() + request_size, request.data.end());
+            this->staging.offset = queue_end_offset;
+
+            request.data.resize(request_size);
+        }
+
+        return this->QueueWriteRequest(std::move(request));
+    }
+
+    bool FileWriter::QueueWriteRequest(WriteRequest&& request)
+    {
+        size_t request_size = request.data.size();
+
+        {
+            /* Wait until there's enough room in the queue. This also reports errors from previously queued writes. */
+            std::unique_lock<std::mutex> queue_lock(this->queue_mtx);
+            this->queue_cv.wait(queue_lock, [this, &request_size]() { return (this->queue_failed || !this->queue_size || (this->queue_size + request_size) <= this->queue_max_size); });
+            if (this->queue_failed) return false;
+
+            /* Queue write request. */
+            this->queue_size += request_size;
+            this->queue.push_back(std::move(request));
+        }
+
+        this->queue_cv.notify_all();
+
+        return true;
+    }
+
+    std::vector<u8> FileWriter::GetSpareBuffer(void)
+    {
+        std::vector<u8> buf{};
+
+        if (!this->queue_spare_bufs.empty())
+        {
+            buf = std::move(this->queue_spare_bufs.back());
+            this->queue_spare_bufs.pop_back();
+        }
+
+        return buf;
+    }
+
+    bool FileWriter::WaitForWriteQueue(void)
+    {
+        /* Staged data is only ever available while the I/O thread is running. */
+        if (!this->QueueStagedData(true)) return false;
+
+        std::unique_lock<std::mutex> queue_lock(this->queue_mtx);
+        this->queue_cv.wait(queue_lock, [this]() { return this->queue.empty(); });
+        return !this->queue_failed;
+    }
+
+    void FileWriter::IoThreadFunc(void *arg)
+    {
+        FileWriter *writer = static_cast<FileWriter*>(arg);
+        std::unique_lock<std::mutex> queue_lock(writer->queue_mtx);
+
+        while(true)
+        {
+            /* Wait until there's something to write. Queued data is always written before exiting. */
+            writer->queue_cv.wait(queue_lock, [writer]() { return (!writer->queue.empty() || writer->queue_exit); });
+            if (writer->queue.empty()) break;
+
+            /* Keep the current request in the queue while it's being written, so its size is still accounted for. */
+            /* References to deque elements remain valid while producers append new elements. */
+            WriteRequest& request = writer->queue.front();
+            bool skip = writer->queue_failed;
+
+            queue_lock.unlock();
+
+            /* Skip every request that follows a failed one. */
+            bool ret = (!skip && writer->WriteData(request.data.data(), request.data.size(), request.offset));
+
+            queue_lock.lock();
+
+            if (!ret) writer->queue_failed = true;
+
+            /* Keep a single data buffer around, so its capacity can be reused by the next request. */
+            writer->queue_size -= request.data.size();
+            if (writer->queue_spare_bufs.empty()) writer->queue_spare_bufs.push_back(std::move(request.data));
+            writer->queue.pop_front();
+
+            writer->queue_cv.notify_all();
+        }
+
+        queue_lock.unlock();
+
+        threadExit();
+    }
+
+    bool FileWriter::Write(const void *data, const size_t& data_size)
+    {
+        TRACE_SCOPE("FileWriter::Write");
+        return (this->encoder ? this->WriteCompressedData(data, data_size) : this->WriteOutput(data, data_size));
+    }
+
+    bool FileWriter::WriteOutput(const void *data, const size_t& data_size)
+    {
+        /* Sanity check. The output file stream is owned by the I/O thread while it's running, and it may be switching to a new part file right now. */
+        if (!data || !data_size || !this->file_created || this->cur_size >= this->total_size || \
+            (this->storage_type != StorageType::UsbHost && this->io_thread.handle == INVALID_HANDLE && !this->IsCurrentFileOpen())) return false;
+
+        /* Make sure we don't write past the established file size. */
+        size_t write_size = ((this->cur_size + data_size) > this->total_size ? (this->total_size - this->cur_size) : data_size);
+
+        /* Hand data over to all mirror files. */
+        if (!this->WriteMirrors(data, write_size)) return false;
+
+        if (this->io_thread.handle == INVALID_HANDLE)
+        {
+            /* Write data right away. */
+            if (!this->WriteData(data, write_size, this->cur_size)) return false;
+        } else {
+            {
+                /* Report errors from previously queued writes right away. */
+                std::scoped_lock queue_lock(this->queue_mtx);
+                if (this->queue_failed) return false;
+
+                /* Start a new staging request, reusing a spare buffer if available. */
+                if (this->staging.data.empty())
+                {
+                    if (!this->staging.data.capacity()) this->staging.data = this->GetSpareBuffer();
+                    this->staging.offset = this->cur_size;
+                }
+            }
+
+            /* Copy data outside of the lock, so the I/O thread can keep on writing in the meantime. */
+            const u8 *data_u8 = static_cast<const u8*>(data);
+            this->staging.data.insert(this->staging.data.end(), data_u8, data_u8 + write_size);
+
+            /* Queue staged data. Everything is queued right away once the last chunk has been written. */
+            if (!this->QueueStagedData((this->cur_size + write_size) >= this->total_size)) return false;
+        }
+
+        /* Update the written data size. */
+        this->cur_size += write_size;
+
+        return true;
+    }
+
+    bool FileWriter::WriteCompressedData(const void *data, const size_t& data_size)
+    {
+        /* Sanity check. */
+        if (!data || !data_size || !this->file_created || this->input_cur_size >= this->input_total_size) return false;
+
+        /* Make sure we don't go past the established input size. */
+        size_t write_size = ((this->input_cur_size + data_size) > this->input_total_size ? (this->input_total_size - this->input_cur_size) : data_size);
+
+        /* Compress data. Whole blocks (if any) are written right away, while the rest is kept by the encoder until more data is provided. */
+        this->encoder_out.clear();
+        if (!this->encoder->Encode(data, write_size, this->encoder_out))
+        {
+            LOG_MSG_ERROR("Failed to compress 0x%lX-byte long block at input offset 0x%lX!", write_size, this->input_cur_size);
+            return false;
+        }
+
+        this->input_cur_size += write_size;
+
+        /* The final container size is known as soon as all input data has been provided. */
+        if (this->input_cur_size >= this->input_total_size) this->total_size = (this->cur_size + this->encoder_out.size());
+
+        return (this->encoder_out.empty() || this->WriteOutput(this->encoder_out.data(), this->encoder_out.size()));
+    }
+
+    void *FileWriter::AcquireBuffer(const size_t& size)
+    {
+        /* Sanity check. */
+        if (!size || size > USB_TRANSFER_BUFFER_SIZE || this->lease_active) return nullptr;
+
+        /* Reallocate the lease buffer if it's too small. */
+        if (size > this->lease_buf_size)
+        {
+            if (this->lease_buf) bufferPoolReturn(this->lease_buf);
+
+            if (!(this->lease_buf = bufferPoolLeaseWithSize(size, false, &(this->lease_buf_size))))
+            {
+                LOG_MSG_ERROR("Failed to lease 0x%lX-byte long buffer!", size);
+                this->lease_buf_size = 0;
+                return nullptr;
+            }
+        }
+
+        /* Update flag. */
+        this->lease_active = true;
+
+        return this->lease_buf;
+    }
+
+    bool FileWriter::Commit(const size_t& data_size)
+    {
+        /* Sanity check. */
+        if (!this->lease_active || data_size > this->lease_buf_size) return false;
+
+        /* End the lease right away. */
+        this->lease_active = false;
+
+        /* The lease buffer is page aligned, so it goes straight to the USB endpoint. */
+        return (!data_size || this->Write(this->lease_buf, data_size));
+    }
+
+    bool FileWriter::WriteAsync(const void *data, const size_t& data_size, UsbFileDataTransferCallback callback, void *user_data)
+    {
+        /* Data sent under file delta mode must be staged until a whole batch is available, so it's never transferred asynchronously. */
+        if (this->storage_type != StorageType::UsbHost || this->usb_delta)
+        {
+            if (!this->Write(data, data_size)) return false;
+            if (callback) callback(user_data, true);
+            return true;
+        }
+
+        /* Sanity check. */
+        if (!data || !data_size || !this->file_created || this->cur_size >= this->total_size) return false;
+
+        /* Make sure we don't write past the established file size. */
+        size_t write_size = ((this->cur_size + data_size) > this->total_size ? (this->total_size - this->cur_size) : data_size);
+
+        /* Hand data over to all mirror files. */
+        if (!this->WriteMirrors(data, write_size)) return false;
+
+        /* Post data to USB host. */
+        if (!usbSendFileDataAsync(data, write_size, callback, user_data))
+        {
+            LOG_MSG_ERROR("Failed to post 0x%lX-byte long block at offset 0x%lX to USB host.", write_size, this->cur_size);
+            return false;
+        }
+
+        /* Update the written data size. */
+        this->cur_size += write_size;
+
+        return true;
+    }
+
+    bool FileWriter::Flush(void)
+    {
+        bool ret = this->WaitForMirrors();
+        if (this->storage_type != StorageType::UsbHost) return (this->WaitForWriteQueue() && ret);
+        return (usbFlushFileDataTransfers() && ret);
+    }
+
+    bool FileWriter::StartNspEntry(const u32& entry_idx, const char *entry_name, const size_t& data_size, const u8& checksum_type)
+    {
+        if (this->storage_type != StorageType::UsbHost) return true;
+
+        /* Sanity check. */
+        if (!entry_name || !*entry_name || !this->nsp_header_size || !this->file_created || (this->cur_size + data_size) > this->total_size || \
+            (!this->nsp_layout.empty() && ((entry_idx + 1) >= this->nsp_layout.size() || data_size != this->nsp_layout[entry_idx + 1].size))) return false;
+
+        /* Empty NSP file entries don't need a data transfer stage under NSP layout mode. */
+        if (!this->nsp_layout.empty()) return (!data_size || usbSendNspLayoutData(entry_idx + 1, 0, data_size, checksum_type));
+
+        return usbSendFilePropertiesWithChecksum(data_size, entry_name, checksum_type);
+    }
+
+    bool FileWriter::WriteReference(const u32& entry_idx, const char *entry_name, const std::string& src_path, const size_t& src_offset, const size_t& data_size)
+    {
+        /* Sanity check. */
+        if (!entry_name || !*entry_name || src_path.empty() || src_path == this->output_path || !data_size || !this->nsp_header_size || !this->file_created || \
+            this->storage_type != StorageType::UsbHost || (this->cur_size + data_size) > this->total_size || \
+            (!this->nsp_layout.empty() && ((entry_idx + 1) >= this->nsp_layout.size() || data_size != this->nsp_layout[entry_idx + 1].size))) return false;
 
-            /* Update the written data size. */
-            this->cur_size += write_size;
+        /* Send file reference to USB host. */
+        bool ret = (this->nsp_layout.empty() ? usbSendFileReference(data_size, entry_name, src_path.c_str(), src_offset) : \
+                                               usbSendNspLayoutReference(entry_idx + 1, entry_name, src_path.c_str(), src_offset));
+        if (!ret)
+        {
+            LOG_MSG_ERROR("Failed to send 0x%lX-byte long file reference at offset 0x%lX to USB host.", data_size, this->cur_size);
+            return false;
         }
 
+        /* Update the written data size. */
+        this->cur_size += data_size;
+
         return true;
     }
 
     bool FileWriter::WriteNspHeader(const void *nsp_header, const u32& nsp_header_size)
     {
+        /* The output file must not be in use by the I/O thread. */
+        if (this->storage_type != StorageType::UsbHost && !this->WaitForWriteQueue()) return false;
+
         /* Sanity check. */
         if (!nsp_header || !nsp_header_size || nsp_header_size != this->nsp_header_size || !this->file_created || this->cur_size < this->total_size || this->nsp_header_written ||
-            (this->storage_type != StorageType::UsbHost && !this->fp)) return false;
+            (this->storage_type != StorageType::UsbHost && !this->IsCurrentFileOpen())) return false;
+
+        /* Skip the rewrite pass altogether if the initial NSP header is already final (e.g. no NCAs were modified). */
+        if (this->initial_nsp_header.size() == nsp_header_size && !memcmp(this->initial_nsp_header.data(), nsp_header, nsp_header_size))
+        {
+            LOG_MSG_DEBUG("Initial NSP header is final. Skipping rewrite.");
+
+            this->CloseCurrentFile();
+            this->initial_nsp_header.clear();
+            this->nsp_header_written = true;
+
+            return true;
+        }
+
+        this->initial_nsp_header.clear();
 
         if (this->storage_type == StorageType::UmsDevice && this->split_file)
         {
@@ -304,8 +1007,17 @@ namespace nxdt::utils
 
         if (this->storage_type == StorageType::UsbHost)
         {
-            /* Send NSP header to USB host. */
-            if (!usbSendNspHeader(nsp_header, this->nsp_header_size)) return false;
+            /* Send NSP header to USB host. Under NSP layout mode, it's sent just like any other region. */
+            if ((this->nsp_layout.empty() && !usbSendNspHeader(nsp_header, this->nsp_header_size)) || \
+                (!this->nsp_layout.empty() && (!usbSendNspLayoutData(0, 0, this->nsp_header_size, UsbChecksumType_None) || !usbSendFileData(nsp_header, this->nsp_header_size)))) return false;
+        } else
+        if (this->storage_type == StorageType::SdCard)
+        {
+            /* Write NSP header. */
+            if (R_FAILED(fsFileWrite(&(this->sd_file), 0, nsp_header, this->nsp_header_size, FsWriteOption_None))) return false;
+
+            /* Close current file. */
+            this->CloseCurrentFile();
         } else {
             /* Seek to the beginning of the file stream. */
             rewind(this->fp);
@@ -328,11 +1040,22 @@ namespace nxdt::utils
         /* Return immediately if the file has already been closed. */
         if (this->file_closed) return;
 
+        /* Wait for all queued writes. */
+        this->StopIoThread();
+
+        /* Trim the worst-case preallocation from complete compressed files. */
+        if (this->encoder && this->cur_size == this->total_size && !this->queue_failed) this->PreallocateCurrentFile();
+
+        /* Close mirror files. */
+        this->CloseMirrors(force_delete);
+
         /* Close current file. */
         this->CloseCurrentFile();
 
-        /* Delete created file(s), if needed. */
-        if (this->cur_size != this->total_size && (this->file_created || force_delete))
+        /* Delete created file(s), if needed. Files are also deleted if a queued write failed, since part of the accepted data never made it to the output file. */
+        /* NSPs sent to a USB host are also incomplete if their NSP header was never sent, since the USB host is still waiting for it. */
+        bool incomplete = (this->cur_size != this->total_size || this->queue_failed || (this->storage_type == StorageType::UsbHost && this->nsp_header_size && !this->nsp_header_written));
+        if (incomplete && (this->file_created || force_delete) && (force_delete || !this->keep_incomplete_file || this->storage_type == StorageType::UsbHost))
         {
             if (this->storage_type == StorageType::UsbHost)
             {
@@ -369,8 +1092,195 @@ namespace nxdt::utils
         this->file_closed = true;
     }
 
+    std::optional<std::string> FileWriter::AddMirror(const std::string& output_path)
+    {
+        StorageType storage_type = FileWriter::GetStorageTypeByPath(output_path);
+
+        /* Sanity check. Only a single USB host file transfer may take place at any given time. */
+        if (output_path.empty() || output_path == this->output_path || !this->file_created || this->file_closed || this->cur_size || this->nsp_header_size || this->encoder || \
+            (storage_type == StorageType::UsbHost && this->storage_type == StorageType::UsbHost)) return "utils/file_writer/mirror/unsupported_error"_i18n;
+
+        for(const std::unique_ptr<MirrorTarget>& mirror : this->mirrors)
+        {
+            if (output_path == mirror->writer->output_path || (storage_type == StorageType::UsbHost && mirror->writer->storage_type == StorageType::UsbHost)) return "utils/file_writer/mirror/unsupported_error"_i18n;
+        }
+
+        LOG_MSG_DEBUG("Adding mirror output file \"%s\".", output_path.c_str());
+
+        std::unique_ptr<MirrorTarget> mirror = std::make_unique<MirrorTarget>();
+        mirror->parent = this;
+
+        /* Create mirror file. */
+        try {
+            mirror->writer = new FileWriter(output_path, this->total_size);
+        } catch(const std::string& msg) {
+            LOG_MSG_ERROR("%s", msg.c_str());
+            return msg;
+        }
+
+        /* Mirror writes are already carried out by the mirror I/O thread, so the mirror file doesn't need a write-behind queue of its own. */
+        mirror->writer->StopIoThread();
+
+        /* Start mirror I/O thread. */
+        if (!threadPlacementCreateThread(&(mirror->thread), FileWriter::MirrorThreadFunc, mirror.get(), ThreadPlacementStage_Write))
+        {
+            mirror->writer->Close(true);
+            delete mirror->writer;
+            return "utils/file_writer/mirror/thread_create_error"_i18n;
+        }
+
+        this->mirrors.push_back(std::move(mirror));
+
+        return {};
+    }
+
+    bool FileWriter::WriteMirrors(const void *data, const size_t& data_size)
+    {
+        if (this->mirrors.empty()) return true;
+
+        /* Copy data a single time. The copy is shared by all mirror I/O threads, and it's freed as soon as the last one is done with it. */
+        std::shared_ptr<WriteRequest> request = std::make_shared<WriteRequest>();
+        const u8 *data_u8 = static_cast<const u8*>(data);
+        request->data.assign(data_u8, data_u8 + data_size);
+        request->offset = this->cur_size;
+
+        {
+            /* Wait until there's enough room in every mirror queue. This also reports errors from previous mirror writes. */
+            const size_t mirror_queue_max_size = static_cast<size_t>(utilsGetBudgetedBufferSize(WriteQueueMaxSize, USB_TRANSFER_BUFFER_SIZE));
+
+            std::unique_lock<std::mutex> mirror_lock(this->mirror_mtx);
+            this->mirror_cv.wait(mirror_lock, [this, &data_size, &mirror_queue_max_size]() {
+                for(const std::unique_ptr<MirrorTarget>& mirror : this->mirrors)
+                {
+                    if (!mirror->failed && mirror->queue_size && (mirror->queue_size + data_size) > mirror_queue_max_size) return false;
+                }
+
+                return true;
+            });
+
+            for(const std::unique_ptr<MirrorTarget>& mirror : this->mirrors)
+            {
+                if (mirror->failed) return false;
+            }
+
+            /* Queue shared write request. */
+            for(std::unique_ptr<MirrorTarget>& mirror : this->mirrors)
+            {
+                mirror->queue_size += data_size;
+                mirror->queue.push_back(request);
+            }
+        }
+
+        this->mirror_cv.notify_all();
+
+        return true;
+    }
+
+    bool FileWriter::WaitForMirrors(void)
+    {
+        if (this->mirrors.empty()) return true;
+
+        bool ret = true;
+
+        {
+            std::unique_lock<std::mutex> mirror_lock(this->mirror_mtx);
+            this->mirror_cv.wait(mirror_lock, [this]() {
+                for(const std::unique_ptr<MirrorTarget>& mirror : this->mirrors)
+                {
+                    if (!mirror->queue.empty()) return false;
+                }
+
+                return true;
+            });
+
+            for(const std::unique_ptr<MirrorTarget>& mirror : this->mirrors) ret = (ret && !mirror->failed);
+        }
+
+        /* Mirror I/O threads are idle at this point, so pending asynchronous writes can be safely flushed from this thread. */
+        for(std::unique_ptr<MirrorTarget>& mirror : this->mirrors) ret = (mirror->writer->Flush() && ret);
+
+        return ret;
+    }
+
+    void FileWriter::CloseMirrors(bool force_delete)
+    {
+        if (this->mirrors.empty()) return;
+
+        {
+            std::scoped_lock mirror_lock(this->mirror_mtx);
+            this->mirror_exit = true;
+        }
+
+        this->mirror_cv.notify_all();
+
+        for(std::unique_ptr<MirrorTarget>& mirror : this->mirrors)
+        {
+            threadPlacementJoinThread(&(mirror->thread));
+
+            /* Incomplete mirror files are deleted on their own. */
+            mirror->writer->Close(force_delete);
+            delete mirror->writer;
+        }
+
+        this->mirrors.clear();
+    }
+
+    void FileWriter::MirrorThreadFunc(void *arg)
+    {
+        MirrorTarget *mirror = static_cast<MirrorTarget*>(arg);
+        FileWriter *parent = mirror->parent;
+        std::unique_lock<std::mutex> mirror_lock(parent->mirror_mtx);
+
+        while(true)
+        {
+            /* Wait until there's something to write. Queued data is always written before exiting. */
+            parent->mirror_cv.wait(mirror_lock, [mirror, parent]() { return (!mirror->queue.empty() || parent->mirror_exit); });
+            if (mirror->queue.empty()) break;
+
+            /* Keep the current request in the queue while it's being written, so its size is still accounted for. */
+            std::shared_ptr<const WriteRequest> request = mirror->queue.front();
+            bool skip = mirror->failed;
+
+            mirror_lock.unlock();
+
+            /* Skip every request that follows a failed one. */
+            bool ret = (skip || mirror->writer->Write(request->data.data(), request->data.size()));
+            if (!ret) LOG_MSG_ERROR("Failed to write 0x%lX-byte long block at offset 0x%lX to mirror file \"%s\".", request->data.size(), request->offset, mirror->writer->output_path.c_str());
+
+            mirror_lock.lock();
+
+            if (!ret) mirror->failed = true;
+
+            mirror->queue_size -= request->data.size();
+            mirror->queue.pop_front();
+
+            parent->mirror_cv.notify_all();
+        }
+
+        mirror_lock.unlock();
+
+        threadExit();
+    }
+
+    void FileWriter::SetKeepIncompleteFile(bool keep)
+    {
+        /* Compressed files can't be resumed. */
+        this->keep_incomplete_file = (keep && !this->encoder);
+    }
+
+    size_t FileWriter::GetCurrentOffset(void)
+    {
+        return (this->encoder ? this->input_cur_size : this->cur_size);
+    }
+
     FileWriter::StorageType FileWriter::GetStorageType(void)
     {
         return this->storage_type;
     }
+
+    FileWriter::StorageType FileWriter::GetStorageTypeByPath(const std::string& output_path)
+    {
+        return (output_path.starts_with(DEVOPTAB_SDMC_DEVICE) ? StorageType::SdCard  :
+               (output_path.starts_with('/')                  ? StorageType::UsbHost : StorageType::UmsDevice));
+    }
 }
@@ -21,6 +21,8 @@
 
 #include <views/data_transfer_progress_display.hpp>
 
+namespace i18n = brls::i18n;    /* For getStr(). */
+
 namespace nxdt::views
 {
     DataTransferProgressDisplay::DataTransferProgressDisplay()
@@ -35,6 +37,10 @@ namespace nxdt::views
         this->speed_eta_lbl = new brls::Label(brls::LabelStyle::MEDIUM, "", false);
         this->speed_eta_lbl->setVerticalAlign(NVG_ALIGN_TOP);
         this->speed_eta_lbl->setParent(this);
+
+        this->stages_lbl = new brls::Label(brls::LabelStyle::SMALL, "", false);
+        this->stages_lbl->setVerticalAlign(NVG_ALIGN_TOP);
+        this->stages_lbl->setParent(this);
     }
 
     DataTransferProgressDisplay::~DataTransferProgressDisplay()
@@ -42,6 +48,7 @@ namespace nxdt::views
         delete this->progress_display;
         delete this->size_lbl;
         delete this->speed_eta_lbl;
+        delete this->stages_lbl;
     }
 
     void DataTransferProgressDisplay::draw(NVGcontext* vg, int x, int y, unsigned width, unsigned height, brls::Style* style, brls::FrameContext* ctx)
@@ -54,6 +61,9 @@ namespace nxdt::views
 
         /* Speed / ETA label. */
         this->speed_eta_lbl->frame(ctx);
+
+        /* Pipeline stages label. */
+        this->stages_lbl->frame(ctx);
     }
 
     void DataTransferProgressDisplay::layout(NVGcontext* vg, brls::Style* style, brls::FontStash* stash)
@@ -88,6 +98,16 @@ namespace nxdt::views
             this->progress_display->getY() + this->progress_display->getHeight() + this->progress_display->getHeight() / 8,
             this->speed_eta_lbl->getWidth(),
             this->speed_eta_lbl->getHeight());
+
+        /* Pipeline stages label. */
+        this->stages_lbl->setWidth(elem_width);
+        this->stages_lbl->invalidate(true);
+
+        this->stages_lbl->setBoundaries(
+            this->x + (this->width - this->stages_lbl->getWidth()) / 2,
+            this->speed_eta_lbl->getY() + this->speed_eta_lbl->getHeight() + this->progress_display->getHeight() / 8,
+            this->stages_lbl->getWidth(),
+            this->stages_lbl->getHeight());
     }
 
     void DataTransferProgressDisplay::SetProgress(const nxdt::tasks::DataTransferProgress& progress)
@@ -107,6 +127,21 @@ namespace nxdt::views
             this->speed_eta_lbl->setText(fmt::format("{}/s", this->GetFormattedSizeString(progress.speed)));
         }
 
+        /* Update pipeline stages string. */
+        std::string stages_str{};
+
+        for(u8 i = 0; progress.has_stages && i < nxdt::tasks::DataTransferStage_Count; i++)
+        {
+            static const char *stage_names[nxdt::tasks::DataTransferStage_Count] = { "read", "decrypt", "hash", "write" };
+            const nxdt::tasks::DataTransferStageProgress& stage = progress.stages[i];
+            if (!stage.enabled) continue;
+
+            if (!stages_str.empty()) stages_str += " | ";
+            stages_str += fmt::format("{}: {}/s ({}%)", i18n::getStr(std::string("tasks/stages/") + stage_names[i]), this->GetFormattedSizeString(stage.speed), stage.occupancy);
+        }
+
+        this->stages_lbl->setText(stages_str);
+
         this->invalidate();
     }
 
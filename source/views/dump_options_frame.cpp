@@ -20,6 +20,7 @@
  */
 
 #include <views/dump_options_frame.hpp>
+#include <tasks/output_storage_benchmark_task.hpp>
 
 namespace i18n = brls::i18n;    /* For getStr(). */
 using namespace i18n::literals; /* For _i18n. */
@@ -124,6 +125,15 @@ namespace nxdt::views
                 /* Set the current output storage once more. This will make sure the string for the selected storage gets updated. */
                 this->output_storage->setSelectedValue(selected);
             }
+
+            if (this->mirror_storage)
+            {
+                /* Do the same with the mirror storage, if available. UMS devices are replaced with no mirror storage at all. */
+                this->mirror_storage->updateValues(this->GenerateMirrorStoragesVector(ums_devices));
+
+                selected = this->mirror_storage->getSelectedValue();
+                this->mirror_storage->setSelectedValue(selected > (ConfigOutputStorage_UsbHost + 1) ? 0 : selected);
+            }
         });
 
         /* Start dump button. */
@@ -188,25 +198,34 @@ namespace nxdt::views
         return storages;
     }
 
-    void DumpOptionsFrame::UpdateStoragePrefix(u32 selected)
+    std::vector<std::string> DumpOptionsFrame::GenerateMirrorStoragesVector(const nxdt::tasks::UmsDeviceVector& ums_devices)
+    {
+        std::vector<std::string> storages = this->GenerateOutputStoragesVector(ums_devices);
+        storages.insert(storages.begin(), "dump_options/mirror_storage/value_none"_i18n);
+        return storages;
+    }
+
+    std::string DumpOptionsFrame::GetStoragePrefix(u32 selected)
     {
         switch(selected)
         {
             case ConfigOutputStorage_SdCard:
-                this->storage_prefix = DEVOPTAB_SDMC_DEVICE "/";
-                break;
+                return DEVOPTAB_SDMC_DEVICE "/";
             case ConfigOutputStorage_UsbHost:
-                this->storage_prefix = "/";
-                break;
+                return "/";
             default:
             {
                 const nxdt::tasks::UmsDeviceVector& ums_devices = this->root_view->GetUmsDevices();
-                this->storage_prefix = std::string(ums_devices.at(selected - ConfigOutputStorage_Count).first->name);
-                break;
+                return std::string(ums_devices.at(selected - ConfigOutputStorage_Count).first->name);
             }
         }
     }
 
+    void DumpOptionsFrame::UpdateStoragePrefix(u32 selected)
+    {
+        this->storage_prefix = this->GetStoragePrefix(selected);
+    }
+
     bool DumpOptionsFrame::onCancel(void)
     {
         /* Pop view. This will invoke this class' destructor. */
@@ -221,8 +240,51 @@ namespace nxdt::views
 
     bool DumpOptionsFrame::GetOutputFilePath(const std::string& extension, std::string& output)
     {
-        std::string tmp = this->storage_prefix;
-        u32 selected = this->output_storage->getSelectedValue();
+        return this->GenerateOutputFilePath(this->storage_prefix, this->output_storage->getSelectedValue(), extension, output);
+    }
+
+    void DumpOptionsFrame::AddMirrorStorageItem(void)
+    {
+        if (this->mirror_storage) return;
+
+        /* Mirror storage. No mirror storage is selected by default. */
+        this->mirror_storage = new brls::SelectListItem("dump_options/mirror_storage/label"_i18n, this->GenerateMirrorStoragesVector(this->root_view->GetUmsDevices()), 0,
+                                                        "dump_options/mirror_storage/description"_i18n);
+
+        this->list->addView(this->mirror_storage);
+    }
+
+    void DumpOptionsFrame::NotifySlowOutputStorage(const std::string& output_path, size_t dump_size)
+    {
+        /* Only warn about dumps that would take at least an hour. */
+        u64 estimated_time = nxdt::tasks::OutputStorageBenchmarkTask::EstimateWriteTime(output_path, dump_size);
+        if (estimated_time < 3600) return;
+
+        brls::Application::notify(i18n::getStr("dump_options/notifications/slow_output_storage", estimated_time / 3600, (estimated_time % 3600) / 60));
+    }
+
+    bool DumpOptionsFrame::GetMirrorOutputFilePath(const std::string& extension, std::string& output)
+    {
+        output.clear();
+
+        u32 selected = (this->mirror_storage ? this->mirror_storage->getSelectedValue() : 0);
+        if (!selected) return true;
+
+        /* Skip the "None" value. */
+        selected--;
+
+        if (selected == this->output_storage->getSelectedValue())
+        {
+            brls::Application::notify("dump_options/notifications/mirror_storage_conflict"_i18n);
+            return false;
+        }
+
+        return this->GenerateOutputFilePath(this->GetStoragePrefix(selected), selected, extension, output);
+    }
+
+    bool DumpOptionsFrame::GenerateOutputFilePath(const std::string& storage_prefix, u32 selected, const std::string& extension, std::string& output)
+    {
+        std::string tmp = storage_prefix;
         char *sanitized_path = nullptr;
 
         if (selected == ConfigOutputStorage_SdCard || selected >= ConfigOutputStorage_Count)
@@ -238,8 +300,22 @@ namespace nxdt::views
         /* Append the base output path string. */
         tmp += this->base_output_path;
 
+        /* The filename has already been sanitized for the output storage. Make sure it only holds ASCII characters if the SD card is only being used as the mirror storage. */
+        std::string filename = this->filename->getValue();
+
+        if (selected == ConfigOutputStorage_SdCard && this->output_storage->getSelectedValue() != ConfigOutputStorage_SdCard)
+        {
+            char *filename_dup = strdup(filename.c_str());
+            if (filename_dup)
+            {
+                utilsReplaceIllegalCharacters(filename_dup, true);
+                filename = std::string(filename_dup);
+                free(filename_dup);
+            }
+        }
+
         /* Generate the sanitized file path. */
-        sanitized_path = utilsGeneratePath(tmp.c_str(), this->filename->getValue().c_str(), extension.c_str());
+        sanitized_path = utilsGeneratePath(tmp.c_str(), filename.c_str(), extension.c_str());
         if (!sanitized_path)
         {
             brls::Application::notify("dump_options/notifications/get_output_path_error"_i18n);
@@ -55,6 +55,9 @@ namespace nxdt::views
             brls::Application::popView();
         });
 
+        /* "Mirror storage" item. */
+        this->AddMirrorStorageItem();
+
         /* "Prepend KeyArea data" toggle. */
         GAMECARD_TOGGLE_ITEM(prepend_key_area);
 
@@ -64,11 +67,20 @@ namespace nxdt::views
         /* "Trim dump" toggle. */
         GAMECARD_TOGGLE_ITEM(trim_dump);
 
+        /* "Skip padding" toggle. */
+        GAMECARD_TOGGLE_ITEM(skip_padding, "dump_options/gamecard/image/trim_dump/label"_i18n);
+
         /* "Calculate checksum" toggle. */
         GAMECARD_TOGGLE_ITEM(calculate_checksum);
 
         /* "Lookup checksum" toggle. */
-        GAMECARD_TOGGLE_ITEM(lookup_checksum, "dump_options/gamecard/image/calculate_checksum/label"_i18n, "No-Intro");
+        GAMECARD_TOGGLE_ITEM(lookup_checksum, "dump_options/gamecard/image/calculate_checksum/label"_i18n, "No-Intro", NOINTRO_INDEX_PATH);
+
+        /* "Compress output" toggle. */
+        GAMECARD_TOGGLE_ITEM(compress_output, "host/nxdt_host.py");
+
+        /* "Verify HFS hashes" toggle. */
+        GAMECARD_TOGGLE_ITEM(verify_hfs_hashes);
 
         /* Register dump button callback. */
         this->RegisterButtonListener([this](brls::View *view) {
@@ -76,19 +88,30 @@ namespace nxdt::views
             bool prepend_key_area_val = this->prepend_key_area->getToggleState();
             bool keep_certificate_val = this->keep_certificate->getToggleState();
             bool trim_dump_val = this->trim_dump->getToggleState();
+            bool skip_padding_val = this->skip_padding->getToggleState();
             bool calculate_checksum_val = this->calculate_checksum->getToggleState();
             bool lookup_checksum_val = this->lookup_checksum->getToggleState();
+            bool compress_output_val = this->compress_output->getToggleState();
+            bool verify_hfs_hashes_val = this->verify_hfs_hashes->getToggleState();
 
             /* Generate file extension. */
             std::string extension = fmt::format(" [{}][{}][{}].xci", prepend_key_area_val ? "KA" : "NKA", keep_certificate_val ? "C" : "NC", trim_dump_val ? "T" : "NT");
 
             /* Get output path. */
-            std::string output_path{};
-            if (!this->GetOutputFilePath(extension, output_path)) return;
+            std::string output_path{}, mirror_output_path{};
+            if (!this->GetOutputFilePath(extension, output_path) || !this->GetMirrorOutputFilePath(extension, mirror_output_path)) return;
+
+            /* Compressed output files can't be sent to a USB host nor mirrored. */
+            compress_output_val = (compress_output_val && mirror_output_path.empty() && utils::FileWriter::GetStorageTypeByPath(output_path) != utils::FileWriter::StorageType::UsbHost);
+            if (compress_output_val) output_path += ".nxz";
+
+            /* Warn the user if the selected output storage is known to be slow for a dump this big. */
+            u64 dump_size = 0;
+            if (trim_dump_val ? gamecardGetTrimmedSize(&dump_size) : gamecardGetTotalSize(&dump_size)) this->NotifySlowOutputStorage(output_path, dump_size);
 
             /* Display task frame. */
-            brls::Application::pushView(new GameCardImageDumpTaskFrame(output_path, prepend_key_area_val, keep_certificate_val, trim_dump_val, calculate_checksum_val,
-                                        lookup_checksum_val), brls::ViewAnimation::SLIDE_LEFT, false);
+            brls::Application::pushView(new GameCardImageDumpTaskFrame(output_path, prepend_key_area_val, keep_certificate_val, trim_dump_val, skip_padding_val,
+                                        calculate_checksum_val, lookup_checksum_val, compress_output_val, mirror_output_path, verify_hfs_hashes_val), brls::ViewAnimation::SLIDE_LEFT, false);
         });
     }
 
@@ -23,6 +23,7 @@
 #include <views/gamecard_tab.hpp>
 #include <views/titles_tab.hpp>
 #include <views/gamecard_image_dump_options_frame.hpp>
+#include <views/gamecard_benchmark_task_frame.hpp>
 #include <utils/scope_guard.hpp>
 
 #define GAMECARD_TAB_TABLE_PROPERTY(name)           brls::TableRow *name = properties_table->addRow(brls::TableRowType::BODY, i18n::getStr("gamecard_tab/list/properties_table/" #name))
@@ -145,6 +146,7 @@ namespace nxdt::views
         GAMECARD_TAB_LISTITEM_ELEMENT(dump_hfs_partitions);
         GAMECARD_TAB_LISTITEM_ELEMENT(browse_hfs_partitions);
         GAMECARD_TAB_LISTITEM_ELEMENT(dump_lafw);
+        GAMECARD_TAB_LISTITEM_ELEMENT(benchmark_card_reads);
 
         /* Set ListItem callbacks. */
         dump_card_image->getClickEvent()->subscribe([this](brls::View *view) {
@@ -153,6 +155,11 @@ namespace nxdt::views
             brls::Application::pushView(new GameCardImageDumpOptionsFrame(this->root_view, raw_filename), brls::ViewAnimation::SLIDE_LEFT);
         });
 
+        benchmark_card_reads->getClickEvent()->subscribe([](brls::View *view) {
+            /* Display gamecard benchmark task frame. */
+            brls::Application::pushView(new GameCardBenchmarkTaskFrame(), brls::ViewAnimation::SLIDE_LEFT, false);
+        });
+
         /* Update focus stack, if needed. */
         if (focus_stack_index > -1) this->UpdateFocusStackViewAtIndex(focus_stack_index, this->GetListFirstFocusableChild());
 
@@ -22,6 +22,7 @@
 #include <sstream>
 #include <views/options_tab.hpp>
 #include <views/focusable_item.hpp>
+#include <views/output_storage_benchmark_task_frame.hpp>
 #include <core/title.h>
 
 namespace i18n = brls::i18n;    /* For getStr(). */
@@ -225,13 +226,101 @@ namespace nxdt::views
             }
         });
 
-        /* Start NRO task. */
-        this->nro_task.Execute(NRO_TMP_PATH, std::string(this->json_data.download_url), true);
+        /* Start NRO task. The NRO is verified using the asset size and digest from the release JSON, if available. */
+        std::vector<u8> nro_sha256{};
+        if (this->json_data.has_download_sha256) nro_sha256.assign(this->json_data.download_sha256, this->json_data.download_sha256 + SHA256_HASH_SIZE);
+
+        this->nro_task.Execute(NRO_TMP_PATH, std::string(this->json_data.download_url), true, this->json_data.download_size, nro_sha256);
 
         /* Go to the next stage. */
         this->nextStage();
     }
 
+    OptionsTabDiagnosticsFrame::OptionsTabDiagnosticsFrame(RootView *root_view) : brls::AppletFrame(true, true), root_view(root_view)
+    {
+        /* Counter names. Must match the order from StatsCounterType. */
+        static const std::array<const char*, StatsCounterType_Count> counter_names = {
+            "gamecard_read", "ncm_read", "bis_read", "aes_xts", "aes_ctr", "sha256", "sha3", "crc32", "usb_transfer", "sd_card_write", "ums_write"
+        };
+
+        /* Set UI properties. */
+        this->setTitle("options_tab/diagnostics/label"_i18n);
+        this->setIcon(BOREALIS_ASSET("icon/" APP_TITLE ".jpg"));
+
+        this->list = new brls::List();
+        this->list->setSpacing(this->list->getSpacing() / 2);
+        this->list->setMarginBottom(20);
+
+        /* Time elapsed since the counters were last reset. */
+        this->elapsed_time = new brls::ListItem("options_tab/diagnostics/frame/elapsed_time"_i18n);
+        this->list->addView(this->elapsed_time);
+
+        /* Counters. */
+        for(size_t i = 0; i < StatsCounterType_Count; i++)
+        {
+            this->counters[i] = new brls::ListItem(i18n::getStr(std::string("options_tab/diagnostics/frame/counters/") + counter_names[i]));
+            this->list->addView(this->counters[i]);
+        }
+
+        /* Log latency histograms. */
+        brls::ListItem *log_latency = new brls::ListItem("options_tab/diagnostics/frame/log_latency"_i18n, "options_tab/diagnostics/frame/log_latency_description"_i18n);
+
+        log_latency->getClickEvent()->subscribe([](brls::View* view) {
+            statsLogLatencyHistograms();
+            brls::Application::notify("options_tab/notifications/latency_logged"_i18n);
+        });
+
+        this->list->addView(log_latency);
+
+        /* Reset counters. */
+        brls::ListItem *reset_counters = new brls::ListItem("options_tab/diagnostics/frame/reset_counters"_i18n);
+
+        reset_counters->getClickEvent()->subscribe([this](brls::View* view) {
+            statsResetCounters();
+
+            /* Refresh values right away instead of waiting for the next status info event. */
+            StatsSnapshot stats{};
+            statsGetSnapshot(&stats);
+            this->UpdateCounters(stats);
+
+            brls::Application::notify("options_tab/notifications/counters_reset"_i18n);
+        });
+
+        this->list->addView(reset_counters);
+
+        this->setContentView(this->list);
+
+        /* Display current values. */
+        StatsSnapshot stats{};
+        statsGetSnapshot(&stats);
+        this->UpdateCounters(stats);
+
+        /* Subscribe to the status info task. */
+        this->status_info_task_sub = this->root_view->RegisterStatusInfoTaskListener([this](const nxdt::tasks::StatusInfoData& status_info_data) {
+            this->UpdateCounters(status_info_data.stats);
+        });
+    }
+
+    OptionsTabDiagnosticsFrame::~OptionsTabDiagnosticsFrame()
+    {
+        this->root_view->UnregisterStatusInfoTaskListener(this->status_info_task_sub);
+    }
+
+    void OptionsTabDiagnosticsFrame::UpdateCounters(const StatsSnapshot& stats)
+    {
+        char strbuf[0x40] = {0};
+
+        u64 elapsed_secs = (stats.elapsed_ns / 1000000000UL);
+        this->elapsed_time->setValue(fmt::format("{:02}H{:02}M{:02}S", elapsed_secs / 3600, (elapsed_secs / 60) % 60, elapsed_secs % 60));
+
+        for(size_t i = 0; i < StatsCounterType_Count; i++)
+        {
+            const StatsCounter *counter = &(stats.counters[i]);
+            utilsGenerateFormattedSizeString(static_cast<double>(counter->byte_count), strbuf, sizeof(strbuf));
+            this->counters[i]->setValue(i18n::getStr("options_tab/diagnostics/frame/counter_value", counter->call_count, strbuf));
+        }
+    }
+
     OptionsTab::OptionsTab(RootView *root_view) : brls::List(), root_view(root_view)
     {
         /* Set custom spacing. */
@@ -261,6 +350,24 @@ namespace nxdt::views
 
         this->addView(overclock);
 
+        /* Adaptive overclock. */
+        brls::ToggleListItem *adaptive_overclock = new brls::ToggleListItem("options_tab/adaptive_overclock/label"_i18n, configGetBoolean("adaptive_overclock"), \
+                                                                            "options_tab/adaptive_overclock/description"_i18n, "generic/value_enabled"_i18n, \
+                                                                            "generic/value_disabled"_i18n);
+
+        adaptive_overclock->getClickEvent()->subscribe([](brls::View* view) {
+            /* Get current value. */
+            brls::ToggleListItem *item = static_cast<brls::ToggleListItem*>(view);
+            bool value = item->getToggleState();
+
+            /* Update configuration. */
+            configSetBoolean("adaptive_overclock", value);
+
+            LOG_MSG_DEBUG("Adaptive overclock setting changed by user.");
+        });
+
+        this->addView(adaptive_overclock);
+
         /* Naming convention. */
         brls::SelectListItem *naming_convention = new brls::SelectListItem("options_tab/naming_convention/label"_i18n, {
                                                                                "options_tab/naming_convention/value_00"_i18n,
@@ -280,6 +387,42 @@ namespace nxdt::views
 
         this->addView(naming_convention);
 
+        /* USB compression. */
+        brls::ToggleListItem *usb_compression = new brls::ToggleListItem("options_tab/usb_compression/label"_i18n, configGetBoolean("usb_compression"), \
+                                                                         "options_tab/usb_compression/description"_i18n, "generic/value_enabled"_i18n, \
+                                                                         "generic/value_disabled"_i18n);
+
+        usb_compression->getClickEvent()->subscribe([](brls::View* view) {
+            /* Get current value. */
+            brls::ToggleListItem *item = static_cast<brls::ToggleListItem*>(view);
+            bool value = item->getToggleState();
+
+            /* Update configuration. */
+            configSetBoolean("usb_compression", value);
+
+            LOG_MSG_DEBUG("USB compression setting changed by user.");
+        });
+
+        this->addView(usb_compression);
+
+        /* USB delta transfer. */
+        brls::ToggleListItem *usb_delta_transfer = new brls::ToggleListItem("options_tab/usb_delta_transfer/label"_i18n, configGetBoolean("usb_delta_transfer"), \
+                                                                            "options_tab/usb_delta_transfer/description"_i18n, "generic/value_enabled"_i18n, \
+                                                                            "generic/value_disabled"_i18n);
+
+        usb_delta_transfer->getClickEvent()->subscribe([](brls::View* view) {
+            /* Get current value. */
+            brls::ToggleListItem *item = static_cast<brls::ToggleListItem*>(view);
+            bool value = item->getToggleState();
+
+            /* Update configuration. */
+            configSetBoolean("usb_delta_transfer", value);
+
+            LOG_MSG_DEBUG("USB delta transfer setting changed by user.");
+        });
+
+        this->addView(usb_delta_transfer);
+
         /* Unmount USB Mass Storage devices. */
         /* We will replace its default click event with a new one that will: */
         /*     1. Check if any UMS devices are available before displaying the dropdown and display a notification if there are none. */
@@ -338,6 +481,43 @@ namespace nxdt::views
 
         this->addView(unmount_ums_device);
 
+        /* Benchmark output storage. */
+        /* We will replace its default click event with a new one that will generate the dropdown values using the SD card and all available UMS devices. */
+        brls::SelectListItem *benchmark_output_storage = new brls::SelectListItem("options_tab/benchmark_output_storage/label"_i18n, { "dummy" }, 0,
+                                                                                  "options_tab/benchmark_output_storage/description"_i18n, false);
+
+        benchmark_output_storage->getClickEvent()->unsubscribeAll();
+
+        benchmark_output_storage->getClickEvent()->subscribe([this](brls::View* view) {
+            /* Generate values vector for the dropdown. The SD card always comes first. */
+            std::vector<std::string> values{};
+            values.push_back("options_tab/benchmark_output_storage/value_00"_i18n);
+            for(nxdt::tasks::UmsDeviceVectorEntry ums_device_entry : this->ums_devices) values.push_back(ums_device_entry.second);
+
+            /* Display dropdown. */
+            brls::SelectListItem *benchmark_output_storage = static_cast<brls::SelectListItem*>(view);
+
+            brls::Dropdown::open(benchmark_output_storage->getLabel(), values, [this](int idx) {
+                /* Make sure the current value isn't out of bounds. */
+                if (idx < 0 || idx > static_cast<int>(this->ums_devices.size())) return;
+
+                /* Get the storage root for the selected output storage. */
+                const UsbHsFsDevice *ums_device = (idx > 0 ? this->ums_devices.at(idx - 1).first : nullptr);
+                if (ums_device && ums_device->write_protect)
+                {
+                    this->DisplayNotification("options_tab/notifications/ums_device_write_protected"_i18n);
+                    return;
+                }
+
+                std::string storage_root(ums_device ? ums_device->name : DEVOPTAB_SDMC_DEVICE);
+
+                /* Display output storage benchmark task frame. */
+                brls::Application::pushView(new OutputStorageBenchmarkTaskFrame(storage_root), brls::ViewAnimation::SLIDE_LEFT, false);
+            });
+        });
+
+        this->addView(benchmark_output_storage);
+
         /* Update application. */
         brls::ListItem *update_app = new brls::ListItem("options_tab/update_app/label"_i18n, "options_tab/update_app/description"_i18n);
 
@@ -367,6 +547,15 @@ namespace nxdt::views
 
         this->addView(update_app);
 
+        /* I/O and crypto counters. */
+        brls::ListItem *diagnostics = new brls::ListItem("options_tab/diagnostics/label"_i18n, "options_tab/diagnostics/description"_i18n);
+
+        diagnostics->getClickEvent()->subscribe([this](brls::View* view) {
+            brls::Application::pushView(new OptionsTabDiagnosticsFrame(this->root_view), brls::ViewAnimation::SLIDE_LEFT, false);
+        });
+
+        this->addView(diagnostics);
+
         /* Reset settings. */
         brls::ListItem *reset_settings = new brls::ListItem("options_tab/reset_settings/label"_i18n, "options_tab/reset_settings/description"_i18n);
 
@@ -25,6 +25,8 @@ using namespace brls::i18n::literals;   /* For _i18n. */
 
 namespace nxdt::views
 {
+    std::list<TitlesTabItem*> TitlesTabItem::icon_cache{};
+
     TitlesTabPopup::TitlesTabPopup(const TitleApplicationMetadata *app_metadata, bool is_system) : brls::TabFrame(), app_metadata(app_metadata), is_system(is_system)
     {
         u64 title_id = this->app_metadata->title_id;
@@ -67,18 +69,65 @@ namespace nxdt::views
         /* Set sublabel. */
         if (!this->is_system) this->setSubLabel(std::string(app_metadata->lang_entry.author));
 
-        /* Set thumbnail (if needed). */
-        if (app_metadata->icon && app_metadata->icon_size) this->setThumbnail(app_metadata->icon, app_metadata->icon_size);
+        /* Set an empty thumbnail (if needed). This reserves room for the icon, which is only decoded once this item is about to be displayed. */
+        if (app_metadata->icon && app_metadata->icon_size) this->setThumbnail(new brls::Image());
 
         /* Set value. */
         this->setValue(fmt::format("{:016X}", this->app_metadata->title_id), false, false);
     }
 
+    TitlesTabItem::~TitlesTabItem()
+    {
+        /* Remove this item from the icon cache. The thumbnail itself is freed by ListItem. */
+        if (this->icon_loaded) TitlesTabItem::icon_cache.erase(this->icon_cache_it);
+    }
+
+    void TitlesTabItem::draw(NVGcontext* vg, int x, int y, unsigned width, unsigned height, brls::Style* style, brls::FrameContext* ctx)
+    {
+        /* Load our icon if we're within a screen's worth of distance from the visible area. */
+        int screen_height = static_cast<int>(brls::Application::contentHeight);
+        if (this->app_metadata->icon && this->app_metadata->icon_size && (y + static_cast<int>(height)) >= -screen_height && y <= (screen_height * 2)) this->LoadIcon();
+
+        brls::ListItem::draw(vg, x, y, width, height, style, ctx);
+    }
+
     void TitlesTabItem::playClickAnimation(void)
     {
         if (this->click_anim) brls::View::playClickAnimation();
     }
 
+    void TitlesTabItem::LoadIcon(void)
+    {
+        std::list<TitlesTabItem*>& cache = TitlesTabItem::icon_cache;
+
+        /* Move our icon to the front of the cache if it has already been decoded. */
+        if (this->icon_loaded)
+        {
+            if (this->icon_cache_it != cache.begin()) cache.splice(cache.begin(), cache, this->icon_cache_it);
+            return;
+        }
+
+        /* Evict the least recently used icon if the cache is full. */
+        if (cache.size() >= TitlesTabItem::IconCacheCapacity) cache.back()->UnloadIcon();
+
+        /* Decode icon. */
+        this->setThumbnail(this->app_metadata->icon, this->app_metadata->icon_size);
+
+        this->icon_cache_it = cache.insert(cache.begin(), this);
+        this->icon_loaded = true;
+    }
+
+    void TitlesTabItem::UnloadIcon(void)
+    {
+        if (!this->icon_loaded) return;
+
+        /* Replace our thumbnail with an empty one. ListItem takes care of freeing the previous thumbnail, along with its texture. */
+        this->setThumbnail(new brls::Image());
+
+        TitlesTabItem::icon_cache.erase(this->icon_cache_it);
+        this->icon_loaded = false;
+    }
+
     TitlesTab::TitlesTab(RootView *root_view, bool is_system) : LayeredErrorFrame("titles_tab/no_titles_available"_i18n), root_view(root_view), is_system(is_system)
     {
         /* Populate list. */
@@ -100,6 +149,19 @@ namespace nxdt::views
         if (!this->is_system) this->root_view->UnregisterTitleMetadataTaskListener(this->title_task_sub);
     }
 
+    void TitlesTab::draw(NVGcontext* vg, int x, int y, unsigned width, unsigned height, brls::Style* style, brls::FrameContext* ctx)
+    {
+        LayeredErrorFrame::draw(vg, x, y, width, height, style, ctx);
+
+        /* Create the next batch of list items if the last one is within a screen's worth of distance from the visible area. */
+        /* This is done after drawing our list, since its children can't be modified while they're being drawn. */
+        size_t list_count = this->list->getViewsCount();
+        if (!list_count || this->app_metadata_idx >= this->app_metadata_count) return;
+
+        brls::View *last_item = this->list->getChild(list_count - 1);
+        if (last_item && last_item->getY() <= (static_cast<int>(brls::Application::contentHeight) * 2)) this->AppendListItems();
+    }
+
     void TitlesTab::PopulateList(const nxdt::tasks::TitleApplicationMetadataInfo& app_metadata_info)
     {
         /* Block user inputs. */
@@ -119,6 +181,11 @@ namespace nxdt::views
         this->list->clear();
         this->list->invalidate(true);
 
+        /* Update application metadata used to create list items. */
+        this->app_metadata = app_metadata;
+        this->app_metadata_count = app_metadata_count;
+        this->app_metadata_idx = 0;
+
         /* Return immediately if we have no application metadata. */
         if (!app_metadata_count)
         {
@@ -126,11 +193,31 @@ namespace nxdt::views
             return;
         }
 
-        /* Populate list. */
-        for(u32 i = 0; i < app_metadata_count; i++)
+        /* Populate list with the first batch of items. */
+        this->AppendListItems();
+
+        /* Update focus stack, if needed. */
+        if (focus_stack_index > -1) this->UpdateFocusStackViewAtIndex(focus_stack_index, this->GetListFirstFocusableChild());
+
+        /* Switch to the list. */
+        this->list->invalidate(true);
+        this->SwitchLayerView(false, update_focused_view, focus_stack_index < 0);
+
+        /* Unblock user inputs. */
+        brls::Application::unblockInputs();
+    }
+
+    void TitlesTab::AppendListItems(void)
+    {
+        if (!this->app_metadata || this->app_metadata_idx >= this->app_metadata_count) return;
+
+        u32 batch_end = std::min(this->app_metadata_idx + TitlesTab::ItemBatchSize, this->app_metadata_count);
+
+        /* Create list items. */
+        for(; this->app_metadata_idx < batch_end; this->app_metadata_idx++)
         {
             /* Create list item. */
-            TitlesTabItem *item = new TitlesTabItem(app_metadata[i], this->is_system);
+            TitlesTabItem *item = new TitlesTabItem(this->app_metadata[this->app_metadata_idx], this->is_system);
 
             /* Register click event. */
             item->getClickEvent()->subscribe([](brls::View *view) {
@@ -167,14 +254,6 @@ namespace nxdt::views
             this->list->addView(item);
         }
 
-        /* Update focus stack, if needed. */
-        if (focus_stack_index > -1) this->UpdateFocusStackViewAtIndex(focus_stack_index, this->GetListFirstFocusableChild());
-
-        /* Switch to the list. */
         this->list->invalidate(true);
-        this->SwitchLayerView(false, update_focused_view, focus_stack_index < 0);
-
-        /* Unblock user inputs. */
-        brls::Application::unblockInputs();
     }
 }